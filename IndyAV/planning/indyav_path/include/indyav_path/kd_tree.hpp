@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace indyav_path
+{
+// Static 3d k-d tree over points held elsewhere, read through coord(i, axis). Stored implicitly as a permutation
+// of the point indices, each range's median splitting it on the range's axis.
+class KdTree
+{
+public:
+  template <class COORD>
+  void build(size_t _size, const COORD& _coord)
+  {
+    order_.resize(_size);
+    for (size_t i = 0; i < _size; ++i)
+      order_[i] = i;
+    build(0, _size, 0, _coord);
+  }
+
+  // Index of the point closest to q, size() if there are none
+  template <class COORD>
+  size_t nearest(const double* _q, const COORD& _coord) const
+  {
+    size_t best = order_.size();
+    double best_d2 = std::numeric_limits<double>::infinity();
+    search(0, order_.size(), 0, _q, _coord, best, best_d2);
+    return best;
+  }
+
+  size_t size() const
+  {
+    return order_.size();
+  }
+  void clear()
+  {
+    order_.clear();
+  }
+
+private:
+  template <class COORD>
+  void build(size_t _begin, size_t _end, int _axis, const COORD& _coord)
+  {
+    if (_end - _begin <= 1)
+      return;
+    size_t mid = _begin + (_end - _begin) / 2;
+    std::nth_element(order_.begin() + _begin, order_.begin() + mid, order_.begin() + _end,
+                     [&_coord, _axis](uint32_t a, uint32_t b) { return _coord(a, _axis) < _coord(b, _axis); });
+    build(_begin, mid, (_axis + 1) % 3, _coord);
+    build(mid + 1, _end, (_axis + 1) % 3, _coord);
+  }
+
+  template <class COORD>
+  void search(size_t _begin, size_t _end, int _axis, const double* _q, const COORD& _coord, size_t& _best,
+              double& _best_d2) const
+  {
+    if (_begin >= _end)
+      return;
+    size_t mid = _begin + (_end - _begin) / 2;
+    uint32_t i = order_[mid];
+    double d2 = 0.;
+    for (int a = 0; a < 3; ++a)
+    {
+      double d = _q[a] - _coord(i, a);
+      d2 += d * d;
+    }
+    if (d2 < _best_d2)
+    {
+      _best_d2 = d2;
+      _best = i;
+    }
+
+    // The side the query is on first, then the other only if it could hold something closer
+    double split = _q[_axis] - _coord(i, _axis);
+    int next = (_axis + 1) % 3;
+    if (split < 0.)
+    {
+      search(_begin, mid, next, _q, _coord, _best, _best_d2);
+      if (split * split < _best_d2)
+        search(mid + 1, _end, next, _q, _coord, _best, _best_d2);
+    }
+    else
+    {
+      search(mid + 1, _end, next, _q, _coord, _best, _best_d2);
+      if (split * split < _best_d2)
+        search(_begin, mid, next, _q, _coord, _best, _best_d2);
+    }
+  }
+
+  std::vector<uint32_t> order_;
+};
+}
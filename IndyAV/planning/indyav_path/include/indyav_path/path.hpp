@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <indyav_path/kd_tree.hpp>
+#include <indyav_path/path_file.hpp>
+
+namespace indyav_path
+{
+/*
+In memory path, as a polyline through its points parameterized by arc length, for path following controllers.
+
+closest() finds the projection of a position onto the path in O(log n) through a k-d tree of the points. track()
+and lookahead() instead start from the segment the last position tracked was projected onto and walk along the
+path, so following the car at a high rate is amortized O(1). They fall back to closest() when the car is far from
+where they leave it, so are safe to call with jumps. The tracking makes them not thread safe, unlike the rest.
+*/
+class Path
+{
+public:
+  struct Projection
+  {
+    size_t segment = 0;     // from point segment to segment + 1
+    double t = 0.;          // how far along the segment, 0 to 1
+    double arc_length = 0.;
+    double distance = 0.;   // from the position projected
+    PathPoint point;
+  };
+
+  Path() = default;
+  explicit Path(std::vector<PathPoint> _points);
+  // Loads a compact path file (see PathFileWriter)
+  bool load(const std::string& _file_name);
+
+  size_t size() const
+  {
+    return points_.size();
+  }
+  const PathPoint& operator[](size_t _i) const
+  {
+    return points_[_i];
+  }
+  double arcLength(size_t _i) const
+  {
+    return arc_length_[_i];
+  }
+  double length() const
+  {
+    return arc_length_.empty() ? 0. : arc_length_.back();
+  }
+
+  // The path must not be empty for these
+  Projection closest(double _x, double _y, double _z) const;
+  Projection track(double _x, double _y, double _z);
+  // Point distance further along the path than the projection of the position, clamped to the path's end
+  PathPoint lookahead(double _x, double _y, double _z, double _distance);
+  PathPoint atArcLength(double _arc_length) const;
+  void resetTracking()
+  {
+    tracking_ = false;
+  }
+
+  // Meters from the path past which track() searches the whole path again (10)
+  double relocalize_distance = 10.;
+
+private:
+  void index();
+  size_t segments() const
+  {
+    return points_.size() > 1 ? points_.size() - 1 : 1;
+  }
+  Projection project(size_t _segment, const double* _q) const;
+  PathPoint interpolate(size_t _segment, double _t) const;
+
+  std::vector<PathPoint> points_;
+  std::vector<double> arc_length_;
+  KdTree tree_;
+
+  bool tracking_ = false;
+  size_t last_segment_ = 0;
+};
+}
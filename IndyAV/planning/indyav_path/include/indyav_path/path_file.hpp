@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <nav_msgs/Odometry.h>
+
+#include <indyav_path/kd_tree.hpp>
+
+namespace indyav_path
+{
+// One point of a path, in ECEF, with the heading of the car there counterclockwise from east in the local
+// east north up frame, and its speed
+struct PathPoint
+{
+  double x = 0.;
+  double y = 0.;
+  double z = 0.;
+  double heading = 0.;
+  double speed = 0.;
+};
+
+PathPoint toPathPoint(const nav_msgs::Odometry& _odom);
+// The inverse of toPathPoint, in /ecef with the car level in the local east north up frame
+nav_msgs::Odometry toOdometry(const PathPoint& _point);
+
+/*
+Compact path file, a fraction of the size of the same path as a bag of nav_msgs::Odometry
+
+Layout: a 32 byte header of the magic "IAVP", a version and the ECEF origin of the path (its first point) as
+3 doubles, then 16 byte records of each point's offset from the origin in mm as 3 int32s, heading in 1e-4 rad
+as an int16 and speed in cm/s as a uint16. Offsets are from the origin, rather than from the previous point,
+so any record can be read on its own.
+*/
+class PathFileWriter
+{
+public:
+  ~PathFileWriter();
+  bool open(const std::string& _file_name);
+  bool isOpen() const
+  {
+    return file_ != nullptr;
+  }
+  // The first point written becomes the path's origin
+  void write(const PathPoint& _point);
+  void close();
+  size_t size() const
+  {
+    return count_;
+  }
+
+private:
+  FILE* file_ = nullptr;
+  bool have_origin_ = false;
+  double origin_[3] = { 0., 0., 0. };
+  size_t count_ = 0;
+};
+
+// Memory maps a path file, and finds the point closest to a position in O(log n) through a k-d tree of the
+// points built on open
+class PathFile
+{
+public:
+  ~PathFile();
+  bool open(const std::string& _file_name);
+  void close();
+  size_t size() const
+  {
+    return count_;
+  }
+  PathPoint operator[](size_t _i) const;
+  // Index of the point closest to an ECEF position, size() if the path is empty
+  size_t closest(double _x, double _y, double _z) const;
+
+private:
+  struct Record
+  {
+    int32_t offset[3];
+    int16_t heading;
+    uint16_t speed;
+  };
+
+  void* map_ = nullptr;
+  size_t map_size_ = 0;
+  const Record* records_ = nullptr;
+  size_t count_ = 0;
+  double origin_[3] = { 0., 0., 0. };
+  // Over the records' offsets in mm
+  KdTree tree_;
+};
+}
@@ -1,10 +1,21 @@
+#include <cmath>
 #include <string>
 
 #include <nav_msgs/Odometry.h>
 #include <ros/ros.h>
 
+#include <indyav_path/path_file.hpp>
 #include <mil_tools/mil_tools.hpp>
 
+/*
+ros params, besides those of mil_tools::TopicRecorder:
+  record_mode: rate, to record every 1 / record_rate, or distance, to record by how the path changes (rate)
+  record_rate: Hz to record at in rate mode
+  min_spacing, max_spacing: in distance mode, meters recorded points are at least and at most apart (0.5, 5)
+  max_heading_change: in distance mode, rad the heading may turn through before recording, so turns are recorded
+    densely and straights sparsely (0.05)
+  path_file: also record the path to this compact path file (see indyav_path::PathFileWriter) (none)
+*/
 template <class ROS_TIME, class ROS_DURATION>
 class PathRecorder : protected mil_tools::TopicRecorder<nav_msgs::Odometry>
 {
@@ -12,17 +23,75 @@ private:
   ROS_DURATION period_;
   ROS_TIME last_save_;
 
+  bool by_distance_ = false;
+  double min_spacing_ = 0.5;
+  double max_spacing_ = 5.;
+  double max_heading_change_ = 0.05;
+  bool have_last_point_ = false;
+  indyav_path::PathPoint last_point_;
+
+  std::string path_file_name_;
+  indyav_path::PathFileWriter path_file_;
+
+  // Whether the path has changed enough since the last recorded point to record this one
+  bool Changed(const indyav_path::PathPoint& _point) const
+  {
+    if (!have_last_point_)
+      return true;
+    double dx = _point.x - last_point_.x, dy = _point.y - last_point_.y, dz = _point.z - last_point_.z;
+    double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (distance >= max_spacing_)
+      return true;
+    double turned = std::fabs(std::remainder(_point.heading - last_point_.heading, 2. * M_PI));
+    return distance >= min_spacing_ && turned >= max_heading_change_;
+  }
+
 public:
   PathRecorder(ros::NodeHandle* _nh) : mil_tools::TopicRecorder<nav_msgs::Odometry>(_nh)
   {
-    double rate;
-    if (!_nh->getParam("record_rate", rate))
+    std::string mode;
+    _nh->param<std::string>("record_mode", mode, "rate");
+    by_distance_ = mode == "distance";
+    if (!by_distance_ && mode != "rate")
+      ROS_FATAL("path_recorder, record_mode %s not supported", mode.c_str());
+    if (by_distance_)
+    {
+      _nh->param<double>("min_spacing", min_spacing_, min_spacing_);
+      _nh->param<double>("max_spacing", max_spacing_, max_spacing_);
+      _nh->param<double>("max_heading_change", max_heading_change_, max_heading_change_);
+    }
+    else
     {
-      ROS_FATAL("path_recorder, no rate specified");
+      double rate;
+      if (!_nh->getParam("record_rate", rate))
+      {
+        ROS_FATAL("path_recorder, no rate specified");
+      }
+      period_ = ROS_DURATION(1.0 / rate);
     }
-    period_ = ROS_DURATION(1.0 / rate);
     last_save_ = ROS_TIME::now();
+    _nh->getParam("path_file", path_file_name_);
   }
+
+  bool Enable(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res) override
+  {
+    if (!path_file_name_.empty())
+    {
+      if (req.data && !path_file_.isOpen())
+      {
+        have_last_point_ = false;
+        if (!path_file_.open(path_file_name_))
+          ROS_ERROR("path_recorder could not open %s", path_file_name_.c_str());
+      }
+      else if (!req.data && path_file_.isOpen())
+      {
+        ROS_INFO("%lu points written to %s", path_file_.size(), path_file_name_.c_str());
+        path_file_.close();
+      }
+    }
+    return mil_tools::TopicRecorder<nav_msgs::Odometry>::Enable(req, res);
+  }
+
   // TODO: findout what the controller actually needs and place it here
   void CallBack(const nav_msgs::Odometry& _msg)
   {
@@ -35,12 +104,23 @@ public:
     else
     {
       auto now = ROS_TIME::now();
-      auto next = last_save_ + period_;
-      if (next >= now)
-        return;
-      ++message_count_;
-      bag_.write(topic_, ros::Time(now.sec, now.nsec), _msg);
+      indyav_path::PathPoint point = indyav_path::toPathPoint(_msg);
+      if (by_distance_)
+      {
+        if (!Changed(point))
+          return;
+      }
+      else
+      {
+        auto next = last_save_ + period_;
+        if (next >= now)
+          return;
+      }
+      Write(ros::Time(now.sec, now.nsec), _msg);
+      path_file_.write(point);
       last_save_ = now;
+      last_point_ = point;
+      have_last_point_ = true;
     }
   }
 };
@@ -0,0 +1,166 @@
+#include <indyav_path/path.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace indyav_path
+{
+Path::Path(std::vector<PathPoint> _points) : points_(std::move(_points))
+{
+  index();
+}
+
+bool Path::load(const std::string& _file_name)
+{
+  PathFile file;
+  if (!file.open(_file_name))
+    return false;
+  points_.resize(file.size());
+  for (size_t i = 0; i < file.size(); ++i)
+    points_[i] = file[i];
+  index();
+  return true;
+}
+
+void Path::index()
+{
+  arc_length_.resize(points_.size());
+  double s = 0.;
+  for (size_t i = 0; i < points_.size(); ++i)
+  {
+    if (i > 0)
+    {
+      double dx = points_[i].x - points_[i - 1].x, dy = points_[i].y - points_[i - 1].y,
+             dz = points_[i].z - points_[i - 1].z;
+      s += std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+    arc_length_[i] = s;
+  }
+
+  const std::vector<PathPoint>& points = points_;
+  tree_.build(points_.size(), [&points](size_t i, int axis) {
+    const PathPoint& p = points[i];
+    return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+  });
+  tracking_ = false;
+}
+
+Path::Projection Path::project(size_t _segment, const double* _q) const
+{
+  const PathPoint& a = points_[_segment];
+  const PathPoint& b = points_[std::min(_segment + 1, points_.size() - 1)];
+  double ab[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+  double aq[3] = { _q[0] - a.x, _q[1] - a.y, _q[2] - a.z };
+  double len2 = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+
+  Projection projection;
+  projection.segment = _segment;
+  if (len2 > 0.)
+    projection.t = std::min(1., std::max(0., (aq[0] * ab[0] + aq[1] * ab[1] + aq[2] * ab[2]) / len2));
+  projection.point = interpolate(_segment, projection.t);
+  double d[3] = { _q[0] - projection.point.x, _q[1] - projection.point.y, _q[2] - projection.point.z };
+  projection.distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  projection.arc_length = arc_length_[_segment] + projection.t * std::sqrt(len2);
+  return projection;
+}
+
+PathPoint Path::interpolate(size_t _segment, double _t) const
+{
+  const PathPoint& a = points_[_segment];
+  const PathPoint& b = points_[std::min(_segment + 1, points_.size() - 1)];
+  PathPoint point;
+  point.x = a.x + _t * (b.x - a.x);
+  point.y = a.y + _t * (b.y - a.y);
+  point.z = a.z + _t * (b.z - a.z);
+  point.heading = std::remainder(a.heading + _t * std::remainder(b.heading - a.heading, 2. * M_PI), 2. * M_PI);
+  point.speed = a.speed + _t * (b.speed - a.speed);
+  return point;
+}
+
+Path::Projection Path::closest(double _x, double _y, double _z) const
+{
+  double q[3] = { _x, _y, _z };
+  const std::vector<PathPoint>& points = points_;
+  size_t nearest = tree_.nearest(q, [&points](size_t i, int axis) {
+    const PathPoint& p = points[i];
+    return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+  });
+
+  // The closest segment is one of the two either side of the nearest point
+  Projection best = project(std::min(nearest, segments() - 1), q);
+  if (nearest > 0)
+  {
+    Projection before = project(nearest - 1, q);
+    if (before.distance < best.distance)
+      best = before;
+  }
+  return best;
+}
+
+Path::Projection Path::track(double _x, double _y, double _z)
+{
+  if (!tracking_)
+  {
+    Projection projection = closest(_x, _y, _z);
+    last_segment_ = projection.segment;
+    tracking_ = true;
+    return projection;
+  }
+
+  double q[3] = { _x, _y, _z };
+  size_t segment = std::min(last_segment_, segments() - 1);
+  Projection projection = project(segment, q);
+  bool moved = false;
+  while (segment + 1 < segments())
+  {
+    Projection next = project(segment + 1, q);
+    if (next.distance > projection.distance)
+      break;
+    projection = next;
+    ++segment;
+    moved = true;
+  }
+  while (!moved && segment > 0)
+  {
+    Projection previous = project(segment - 1, q);
+    if (previous.distance >= projection.distance)
+      break;
+    projection = previous;
+    --segment;
+  }
+
+  if (projection.distance > relocalize_distance)
+  {
+    Projection global = closest(_x, _y, _z);
+    if (global.distance < projection.distance)
+      projection = global;
+  }
+  last_segment_ = projection.segment;
+  return projection;
+}
+
+PathPoint Path::lookahead(double _x, double _y, double _z, double _distance)
+{
+  Projection projection = track(_x, _y, _z);
+  double target = projection.arc_length + _distance;
+  if (_distance < 0.)
+    return atArcLength(target);
+
+  // Walked from the projection, as lookahead distances are short
+  size_t segment = projection.segment;
+  while (segment + 1 < segments() && arc_length_[segment + 1] < target)
+    ++segment;
+  double len = arc_length_[std::min(segment + 1, points_.size() - 1)] - arc_length_[segment];
+  double t = len > 0. ? std::min(1., std::max(0., (target - arc_length_[segment]) / len)) : 0.;
+  return interpolate(segment, t);
+}
+
+PathPoint Path::atArcLength(double _arc_length) const
+{
+  auto it = std::upper_bound(arc_length_.begin(), arc_length_.end(), _arc_length);
+  size_t segment = it == arc_length_.begin() ? 0 : std::min<size_t>(it - arc_length_.begin() - 1, segments() - 1);
+  double len = arc_length_[std::min(segment + 1, points_.size() - 1)] - arc_length_[segment];
+  double t = len > 0. ? std::min(1., std::max(0., (_arc_length - arc_length_[segment]) / len)) : 0.;
+  return interpolate(segment, t);
+}
+}
@@ -0,0 +1,247 @@
+#include <indyav_path/path_file.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace indyav_path
+{
+namespace
+{
+const char kMagic[4] = { 'I', 'A', 'V', 'P' };
+const uint32_t kVersion = 1;
+
+struct Header
+{
+  char magic[4];
+  uint32_t version;
+  double origin[3];
+};
+static_assert(sizeof(Header) == 32, "path file header must be 32 bytes");
+
+// East, north and up unit vectors of the tangent plane at an ECEF position (geocentric, which is close enough
+// for headings)
+void localFrame(double _x, double _y, double _z, double* _east, double* _north, double* _up)
+{
+  double r = std::sqrt(_x * _x + _y * _y + _z * _z);
+  double r_xy = std::sqrt(_x * _x + _y * _y);
+  _up[0] = _x / r;
+  _up[1] = _y / r;
+  _up[2] = _z / r;
+  _east[0] = -_y / r_xy;
+  _east[1] = _x / r_xy;
+  _east[2] = 0.;
+  _north[0] = _up[1] * _east[2] - _up[2] * _east[1];
+  _north[1] = _up[2] * _east[0] - _up[0] * _east[2];
+  _north[2] = _up[0] * _east[1] - _up[1] * _east[0];
+}
+
+int32_t toMm(double _m)
+{
+  return static_cast<int32_t>(std::lround(_m * 1000.));
+}
+}  // namespace
+
+PathPoint toPathPoint(const nav_msgs::Odometry& _odom)
+{
+  PathPoint point;
+  point.x = _odom.pose.pose.position.x;
+  point.y = _odom.pose.pose.position.y;
+  point.z = _odom.pose.pose.position.z;
+
+  // The car's forward (x) axis, rotated into ECEF
+  const auto& q = _odom.pose.pose.orientation;
+  double forward[3] = { 1. - 2. * (q.y * q.y + q.z * q.z), 2. * (q.x * q.y + q.w * q.z), 2. * (q.x * q.z - q.w * q.y) };
+  double east[3], north[3], up[3];
+  localFrame(point.x, point.y, point.z, east, north, up);
+  point.heading = std::atan2(forward[0] * north[0] + forward[1] * north[1] + forward[2] * north[2],
+                             forward[0] * east[0] + forward[1] * east[1] + forward[2] * east[2]);
+
+  const auto& v = _odom.twist.twist.linear;
+  point.speed = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+  return point;
+}
+
+nav_msgs::Odometry toOdometry(const PathPoint& _point)
+{
+  nav_msgs::Odometry odom;
+  odom.header.frame_id = "/ecef";
+  odom.pose.pose.position.x = _point.x;
+  odom.pose.pose.position.y = _point.y;
+  odom.pose.pose.position.z = _point.z;
+
+  // Rotation with columns forward, left and up, as a quaternion
+  double east[3], north[3], up[3];
+  localFrame(_point.x, _point.y, _point.z, east, north, up);
+  double c = std::cos(_point.heading), s = std::sin(_point.heading);
+  double m[3][3];
+  for (int i = 0; i < 3; ++i)
+  {
+    m[i][0] = c * east[i] + s * north[i];
+    m[i][1] = -s * east[i] + c * north[i];
+    m[i][2] = up[i];
+  }
+  double trace = m[0][0] + m[1][1] + m[2][2];
+  auto& q = odom.pose.pose.orientation;
+  if (trace > 0.)
+  {
+    double r = 2. * std::sqrt(1. + trace);
+    q.w = r / 4.;
+    q.x = (m[2][1] - m[1][2]) / r;
+    q.y = (m[0][2] - m[2][0]) / r;
+    q.z = (m[1][0] - m[0][1]) / r;
+  }
+  else if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+  {
+    double r = 2. * std::sqrt(1. + m[0][0] - m[1][1] - m[2][2]);
+    q.w = (m[2][1] - m[1][2]) / r;
+    q.x = r / 4.;
+    q.y = (m[0][1] + m[1][0]) / r;
+    q.z = (m[0][2] + m[2][0]) / r;
+  }
+  else if (m[1][1] > m[2][2])
+  {
+    double r = 2. * std::sqrt(1. + m[1][1] - m[0][0] - m[2][2]);
+    q.w = (m[0][2] - m[2][0]) / r;
+    q.x = (m[0][1] + m[1][0]) / r;
+    q.y = r / 4.;
+    q.z = (m[1][2] + m[2][1]) / r;
+  }
+  else
+  {
+    double r = 2. * std::sqrt(1. + m[2][2] - m[0][0] - m[1][1]);
+    q.w = (m[1][0] - m[0][1]) / r;
+    q.x = (m[0][2] + m[2][0]) / r;
+    q.y = (m[1][2] + m[2][1]) / r;
+    q.z = r / 4.;
+  }
+
+  odom.twist.twist.linear.x = _point.speed;
+  return odom;
+}
+
+PathFileWriter::~PathFileWriter()
+{
+  close();
+}
+
+bool PathFileWriter::open(const std::string& _file_name)
+{
+  close();
+  file_ = fopen(_file_name.c_str(), "wb");
+  have_origin_ = false;
+  count_ = 0;
+  return file_ != nullptr;
+}
+
+void PathFileWriter::write(const PathPoint& _point)
+{
+  if (!file_)
+    return;
+  if (!have_origin_)
+  {
+    Header header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    origin_[0] = header.origin[0] = _point.x;
+    origin_[1] = header.origin[1] = _point.y;
+    origin_[2] = header.origin[2] = _point.z;
+    fwrite(&header, sizeof(header), 1, file_);
+    have_origin_ = true;
+  }
+
+  int32_t offset[3] = { toMm(_point.x - origin_[0]), toMm(_point.y - origin_[1]), toMm(_point.z - origin_[2]) };
+  int16_t heading = static_cast<int16_t>(std::lround(std::remainder(_point.heading, 2. * M_PI) * 1e4));
+  uint16_t speed = static_cast<uint16_t>(std::min(std::lround(_point.speed * 100.), 65535l));
+  fwrite(offset, sizeof(offset), 1, file_);
+  fwrite(&heading, sizeof(heading), 1, file_);
+  fwrite(&speed, sizeof(speed), 1, file_);
+  // Kept on disk as it is recorded, so a crash loses at most the point being written
+  fflush(file_);
+  ++count_;
+}
+
+void PathFileWriter::close()
+{
+  if (file_)
+    fclose(file_);
+  file_ = nullptr;
+}
+
+PathFile::~PathFile()
+{
+  close();
+}
+
+bool PathFile::open(const std::string& _file_name)
+{
+  close();
+  int fd = ::open(_file_name.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+  {
+    ::close(fd);
+    return false;
+  }
+  map_size_ = st.st_size;
+  map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping outlives the descriptor
+  ::close(fd);
+  if (map_ == MAP_FAILED)
+  {
+    map_ = nullptr;
+    return false;
+  }
+
+  const Header* header = static_cast<const Header*>(map_);
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 || header->version != kVersion)
+  {
+    close();
+    return false;
+  }
+  memcpy(origin_, header->origin, sizeof(origin_));
+  records_ = reinterpret_cast<const Record*>(header + 1);
+  // A partly written last record is ignored
+  count_ = (map_size_ - sizeof(Header)) / sizeof(Record);
+
+  const Record* records = records_;
+  tree_.build(count_, [records](size_t i, int axis) { return static_cast<double>(records[i].offset[axis]); });
+  return true;
+}
+
+void PathFile::close()
+{
+  if (map_)
+    munmap(map_, map_size_);
+  map_ = nullptr;
+  records_ = nullptr;
+  count_ = 0;
+  tree_.clear();
+}
+
+PathPoint PathFile::operator[](size_t _i) const
+{
+  const Record& record = records_[_i];
+  PathPoint point;
+  point.x = origin_[0] + record.offset[0] / 1000.;
+  point.y = origin_[1] + record.offset[1] / 1000.;
+  point.z = origin_[2] + record.offset[2] / 1000.;
+  point.heading = record.heading / 1e4;
+  point.speed = record.speed / 100.;
+  return point;
+}
+
+size_t PathFile::closest(double _x, double _y, double _z) const
+{
+  double q[3] = { (_x - origin_[0]) * 1000., (_y - origin_[1]) * 1000., (_z - origin_[2]) * 1000. };
+  const Record* records = records_;
+  return tree_.nearest(q, [records](size_t i, int axis) { return static_cast<double>(records[i].offset[axis]); });
+}
+}
@@ -3,14 +3,83 @@
 #include <nav_msgs/Odometry.h>
 #include <ros/ros.h>
 
+#include <indyav_path/QueryPath.h>
+#include <indyav_path/path.hpp>
 #include <mil_tools/mil_tools.hpp>
 
+/*
+Given a compact path file in the path_file param, follows odom on odom_topic and publishes the point of the path
+lookahead meters along from the car on play_topic, and answers QueryPath on query. Otherwise plays back the bag
+in file_name.
+*/
+class PathFollower
+{
+public:
+  PathFollower(ros::NodeHandle* _nh, const std::string& _path_file)
+  {
+    if (!path_.load(_path_file))
+    {
+      ROS_FATAL("path player could not open path file %s", _path_file.c_str());
+      return;
+    }
+    ROS_INFO("path player loaded %lu points, %f m, from %s", path_.size(), path_.length(), _path_file.c_str());
+
+    std::string play_topic, odom_topic;
+    _nh->param<std::string>("play_topic", play_topic, "/path");
+    _nh->param<std::string>("odom_topic", odom_topic, "/absodom");
+    _nh->param<double>("lookahead", lookahead_, 0.);
+    pub_ = _nh->advertise<nav_msgs::Odometry>(play_topic, 10);
+    sub_ = _nh->subscribe(odom_topic, 10, &PathFollower::CallBack, this);
+    query_service_ = _nh->advertiseService("query", &PathFollower::Query, this);
+  }
+
+private:
+  void CallBack(const nav_msgs::Odometry& _msg)
+  {
+    if (path_.size() == 0)
+      return;
+    const auto& p = _msg.pose.pose.position;
+    nav_msgs::Odometry odom = indyav_path::toOdometry(path_.lookahead(p.x, p.y, p.z, lookahead_));
+    odom.header.stamp = _msg.header.stamp;
+    pub_.publish(odom);
+  }
+
+  bool Query(indyav_path::QueryPath::Request& req, indyav_path::QueryPath::Response& res)
+  {
+    res.success = path_.size() > 0;
+    if (!res.success)
+      return true;
+    // Tracked like odom, as both are called from the one spinner thread
+    const auto& p = req.position;
+    indyav_path::Path::Projection projection = path_.track(p.x, p.y, p.z);
+    res.segment = projection.segment;
+    res.arc_length = projection.arc_length;
+    res.distance = projection.distance;
+    res.closest_point = indyav_path::toOdometry(projection.point);
+    res.lookahead_point = indyav_path::toOdometry(path_.atArcLength(projection.arc_length + req.lookahead));
+    return true;
+  }
+
+  indyav_path::Path path_;
+  double lookahead_ = 0.;
+  ros::Publisher pub_;
+  ros::Subscriber sub_;
+  ros::ServiceServer query_service_;
+};
+
 int main(int argc, char** argv)
 {
   // TODO: findout exactly what the controler would like instead of pulbshing
   //  every message on the topic that we happened to record
   ros::init(argc, argv, "path_recorder");
   ros::NodeHandle nh("~");
+  std::string path_file;
+  if (nh.getParam("path_file", path_file))
+  {
+    PathFollower path_follower(&nh, path_file);
+    ros::spin();
+    return 0;
+  }
   mil_tools::TopicPlayer<nav_msgs::Odometry> path_player(&nh);
   ros::spin();
   return 0;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cmath>
 #include <iostream>
 #include <memory>
@@ -23,6 +24,38 @@ namespace nav
 {
 class ShapeDetection;
 
+/*
+  Rotation and scale invariant description of a shape's outline, cheap to compare. Computed once for each template
+  and cached next to its image, see Shape::load.
+*/
+struct ShapeDescriptor
+{
+  static constexpr int SIGNATURE_SIZE = 64;  // angles the signature is sampled at
+  static constexpr int MASK_SIZE = 32;
+
+  std::array<double, 7> hu;
+  // Largest distance from the centroid to the outline in each of SIGNATURE_SIZE angle bins, divided by their mean
+  std::vector<float> signature;
+  // Filled outline, centered on the centroid and scaled so its largest distance from it fits in MASK_SIZE / 2
+  cv::Mat mask;
+
+  // Returns false for outlines too small to describe
+  bool compute(const std::vector<cv::Point>& contour);
+  /*
+    Relative distance between the first two Hu moments, the spread of the shape and how elongated it is. Cheap enough
+    to reject most mismatches before the full score is computed.
+  */
+  double huDistance(const ShapeDescriptor& other) const;
+  /*
+    Similarity in [0, 1], the product of the signature similarity at the rotation between the two that matches best
+    and the intersection over union of their masks at that rotation.
+  */
+  float score(const ShapeDescriptor& other) const;
+
+  void write(cv::FileStorage& fs) const;
+  bool read(const cv::FileNode& node);
+};
+
 class Shape
 {
   std::string _name;
@@ -30,10 +63,18 @@ class Shape
   float _pixels_per_meter;
   float _radial_symmetry_angle;
   cv::Mat _template;
+  ShapeDescriptor _descriptor;
   bool _ok = false;
 
+  bool loadCache(const std::string& cache_path, double template_time);
+  void saveCache(const std::string& cache_path, double template_time) const;
+
 public:
   static std::vector<Shape> loadShapes(std::string directory, float shape_area);
+  /*
+    The descriptor and radial symmetry angle of the template are read from a .yml file next to its image, and computed
+    and written there if the file is missing or older than the image.
+  */
   void load(std::string path, float shape_area);
   std::string name() const
   {
@@ -55,6 +96,10 @@ public:
   {
     return &_template;
   }
+  const ShapeDescriptor& descriptor() const
+  {
+    return _descriptor;
+  }
   std::unique_ptr<ShapeDetection const> detect(float threshold, bool try_rotation = false, int count = 10) const;
   bool ok() const
   {
@@ -62,6 +107,21 @@ public:
   }
 };
 
+struct ShapeMatch
+{
+  const Shape* shape;  // nullptr if no shape matched
+  float score;
+};
+
+/*
+  Best matching shape for each candidate outline, scoring the candidate and shape pairs on OpenCV's thread pool.
+  Pairs whose huDistance is above max_hu_distance are rejected without being scored, and matches scoring below
+  min_score are dropped.
+*/
+std::vector<ShapeMatch> matchCandidates(const std::vector<std::vector<cv::Point>>& candidates,
+                                        const std::vector<const Shape*>& shapes, double max_hu_distance,
+                                        float min_score);
+
 struct ShapeDetection
 {
   Shape* shape;
@@ -11,6 +11,10 @@ protected:
 
 public:
   virtual void GetShapes(cv::Mat& frame, navigator_msgs::DockShapes& symbols) = 0;
+  // Limits GetShapes to a region of the frames it is given, an empty one to search all of them
+  virtual void SetSearchROI(const cv::Rect& search_roi)
+  {
+  }
   static void DrawShapes(cv::Mat& frame, navigator_msgs::DockShapes& symbols);
   static int fontFace;
   static double fontScale;
@@ -1,4 +1,6 @@
 #include "GrayscaleContour.h"
+#include <algorithm>
+#include <numeric>
 #include <sstream>
 GrayscaleContour::GrayscaleContour(ros::NodeHandle& nh) : DockShapeVision(nh)
 {
@@ -18,6 +20,9 @@ GrayscaleContour::GrayscaleContour(ros::NodeHandle& nh) : DockShapeVision(nh)
   nh.param<double>("grayscale/cross/angle_mean_error_threshold", crossAngleMeanErrorThreshold, 5);
   nh.param<double>("grayscale/cross/angle_var_error_threshold", crossAngleVarErrorThreshold, 5);
   nh.param<double>("grayscale/circle/enclosing_circle_error_threshold", circleEnclosingErrorThreshold, 0.2);
+  nh.param<int>("grayscale/pyramid/levels", pyramidParams.levels, 0);
+  nh.param<int>("grayscale/pyramid/padding", pyramidParams.padding, 10);
+  nh.param<double>("grayscale/pyramid/canny_scale", pyramidParams.cannyScale, 0.75);
   nh.param<double>("grayscale/red_hue_min", redHueMin, 0);
   nh.param<double>("grayscale/red_hue_max", redHueMax, 255);
   nh.param<double>("grayscale/blue_hue", blueHue, 120);
@@ -43,6 +48,10 @@ void GrayscaleContour::init()
   createTrackbar("thresh2", "Menu", &cannyParams.thresh2, 255);
 #endif
 }
+void GrayscaleContour::SetSearchROI(const cv::Rect& search_roi)
+{
+  searchROI = search_roi;
+}
 void GrayscaleContour::GetShapes(cv::Mat& frame, navigator_msgs::DockShapes& symbols)
 {
   if (frame.empty())
@@ -51,12 +60,30 @@ void GrayscaleContour::GetShapes(cv::Mat& frame, navigator_msgs::DockShapes& sym
   frame_width = frame.cols;
   frame_height = frame.rows;
 
+  Rect frame_rect(0, 0, frame.cols, frame.rows);
+  Rect search = searchROI.area() > 0 ? searchROI & frame_rect : frame_rect;
+  std::vector<Rect> regions;
+  if (pyramidParams.levels > 0)
+    FindCandidateRegions(frame, search, regions);
+  else if (search.area() > 0)
+    regions.push_back(search);
+
+  // Only the regions are filtered and searched at full resolution, the rest of the frame is left as it is
   colorFrame = frame;
-  Mat temp = colorFrame.clone();
-  bilateralFilter(temp, colorFrame, blur_size, blur_size * 2, blur_size / 2);
-  ConvertToGrayscale();
-  DetectEdges();
-  FindContours();
+  grayscaleFrame = Mat::zeros(frame.size(), CV_8UC1);
+  edgesFrame = Mat::zeros(frame.size(), CV_8UC1);
+  contours.clear();
+  hierarchy.clear();
+  for (const Rect& region : regions)
+  {
+    Mat temp = colorFrame(region).clone();
+    Mat filtered = colorFrame(region);
+    bilateralFilter(temp, filtered, blur_size, blur_size * 2, blur_size / 2);
+    ConvertToGrayscale(region);
+    DetectEdges(region);
+    FindContours(region);
+  }
+  FilterContours();
 
 #ifdef DO_DEBUG
   Mat result = colorFrame.clone();
@@ -67,6 +94,9 @@ void GrayscaleContour::GetShapes(cv::Mat& frame, navigator_msgs::DockShapes& sym
   ros_color_debug.image = colorFrame.clone();
 #endif
 
+  // Shapes are found first, so their colors can all be measured in one pass over the frame
+  std::vector<navigator_msgs::DockShape> found;
+  std::vector<int> foundIndices;
   for (size_t i = 0; i < contours.size(); i++)
   {
     navigator_msgs::DockShape dockShape;
@@ -91,18 +121,25 @@ void GrayscaleContour::GetShapes(cv::Mat& frame, navigator_msgs::DockShapes& sym
     }
     else
       continue;
+    found.push_back(dockShape);
+    foundIndices.push_back(i);
+  }
 
-    if (!GetColor(i, dockShape.Color, dockShape.color_confidence))
+  std::vector<Scalar> meanColors;
+  GetMeanColors(foundIndices, meanColors);
+  for (size_t k = 0; k < found.size(); k++)
+  {
+    if (!GetColor(meanColors[k], found[k].Color, found[k].color_confidence))
       continue;
 
 #ifdef DO_DEBUG
-    drawContours(result, contours, i, Scalar(0, 0, 255));
+    drawContours(result, contours, foundIndices[k], Scalar(0, 0, 255));
 #endif
 #ifdef DO_ROS_DEBUG
-    drawContours(ros_color_debug.image, contours, i, Scalar(0, 0, 255));
+    drawContours(ros_color_debug.image, contours, foundIndices[k], Scalar(0, 0, 255));
 #endif
 
-    symbols.list.push_back(dockShape);
+    symbols.list.push_back(found[k]);
   }
 
 #ifdef DO_DEBUG
@@ -122,20 +159,82 @@ void GrayscaleContour::GetShapes(cv::Mat& frame, navigator_msgs::DockShapes& sym
   contour_debug_publisher.publish(ros_color_debug.toImageMsg());
 #endif
 }
-void GrayscaleContour::ConvertToGrayscale()
+void GrayscaleContour::FindCandidateRegions(const Mat& frame, const Rect& search, std::vector<Rect>& regions)
 {
-  cvtColor(colorFrame, grayscaleFrame, CV_BGR2GRAY);
+  regions.clear();
+  if (search.area() == 0)
+    return;
+
+  Mat coarse = frame(search), down;
+  for (int i = 0; i < pyramidParams.levels; i++)
+  {
+    pyrDown(coarse, down);
+    coarse = down.clone();
+  }
+  double scale = double(search.width) / coarse.cols;
+
+  Mat coarse_gray, coarse_edges;
+  cvtColor(coarse, coarse_gray, CV_BGR2GRAY);
+  Canny(coarse_gray, coarse_edges, cannyParams.thresh1 * pyramidParams.cannyScale,
+        cannyParams.thresh2 * pyramidParams.cannyScale);
+  std::vector<std::vector<Point> > coarse_contours;
+  findContours(coarse_edges, coarse_contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+
+  // Half the full resolution area filter, so shapes blurred at the coarse level are not lost
+  double min_coarse_area = 0.5 * minArea * frame_width * frame_height / (scale * scale);
+  for (auto& contour : coarse_contours)
+  {
+    if (contourArea(contour) < min_coarse_area)
+      continue;
+    Rect r = boundingRect(contour);
+    Rect region(search.x + r.x * scale - pyramidParams.padding, search.y + r.y * scale - pyramidParams.padding,
+                r.width * scale + 2 * pyramidParams.padding, r.height * scale + 2 * pyramidParams.padding);
+    region &= search;
+    if (region.area() > 0)
+      regions.push_back(region);
+  }
+
+  // Merge overlapping regions so no contour is found twice
+  for (size_t i = 0; i < regions.size(); i++)
+  {
+    for (size_t j = i + 1; j < regions.size(); j++)
+    {
+      if ((regions[i] & regions[j]).area() == 0)
+        continue;
+      regions[i] |= regions[j];
+      regions.erase(regions.begin() + j);
+      j = i;  // the grown region may overlap ones already checked
+    }
+  }
 }
-void GrayscaleContour::DetectEdges()
+void GrayscaleContour::ConvertToGrayscale(const Rect& region)
 {
-  Canny(grayscaleFrame, edgesFrame, cannyParams.thresh1, cannyParams.thresh2);
+  Mat gray = grayscaleFrame(region);
+  cvtColor(colorFrame(region), gray, CV_BGR2GRAY);
 }
-void GrayscaleContour::FindContours()
+void GrayscaleContour::DetectEdges(const Rect& region)
 {
-  contours.clear();
-  hierarchy.clear();
-  findContours(edgesFrame, contours, hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, Point(0, 0));
+  Mat edges = edgesFrame(region);
+  Canny(grayscaleFrame(region), edges, cannyParams.thresh1, cannyParams.thresh2);
+}
+void GrayscaleContour::FindContours(const Rect& region)
+{
+  std::vector<std::vector<Point> > region_contours;
+  std::vector<Vec4i> region_hierarchy;
+  Mat edges = edgesFrame(region).clone();  // findContours may modify its input
+  findContours(edges, region_contours, region_hierarchy, CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, region.tl());
 
+  int offset = contours.size();
+  for (Vec4i& h : region_hierarchy)
+  {
+    for (int k = 0; k < 4; k++)
+      h[k] = h[k] < 0 ? h[k] : h[k] + offset;
+  }
+  contours.insert(contours.end(), region_contours.begin(), region_contours.end());
+  hierarchy.insert(hierarchy.end(), region_hierarchy.begin(), region_hierarchy.end());
+}
+void GrayscaleContour::FilterContours()
+{
   // Filter out very small contours
   auto cit = contours.begin();
   auto hit = hierarchy.begin();
@@ -162,11 +261,81 @@ void GrayscaleContour::FindContours()
 #endif
 }
 
-bool GrayscaleContour::GetColor(int Index, std::string& color, float& confidence)
+void GrayscaleContour::GetMeanColors(const std::vector<int>& indices, std::vector<Scalar>& means)
+{
+  const size_t n = indices.size();
+  const Rect frame_rect(0, 0, colorFrame.cols, colorFrame.rows);
+  if (shapeLabels.size() != colorFrame.size())
+    shapeLabels = Mat::zeros(colorFrame.size(), CV_32SC1);
+
+  // Contours are nested or apart, never crossing. Drawn largest first, a shape inside another is drawn over it, and
+  // the label under its first point before it is drawn is the smallest shape around it, if any.
+  std::vector<double> areas(n);
+  for (size_t k = 0; k < n; k++)
+    areas[k] = contourArea(contours[indices[k]]);
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&areas](int a, int b) { return areas[a] > areas[b]; });
+  std::vector<int> parent(n, -1), root(n);
+  std::vector<Rect> bounds(n);
+  for (int k : order)
+  {
+    const std::vector<Point>& contour = contours[indices[k]];
+    bounds[k] = boundingRect(contour) & frame_rect;
+    if (frame_rect.contains(contour[0]))
+      parent[k] = shapeLabels.at<int>(contour[0]) - 1;
+    // A shape only touching the other at that point is not inside it
+    if (parent[k] >= 0 && (bounds[k] & bounds[parent[k]]) != bounds[k])
+      parent[k] = -1;
+    root[k] = parent[k] < 0 ? k : root[parent[k]];
+    drawContours(shapeLabels, contours, indices[k], Scalar(k + 1), CV_FILLED);
+  }
+
+  // One sweep over the bounding box of each outermost shape, which holds the shapes inside it. Boxes of separate
+  // shapes may overlap, so a pixel is only taken in the box of its own shape's outermost one.
+  std::vector<Vec3d> sums(n, Vec3d(0, 0, 0));
+  std::vector<int> counts(n, 0);
+  for (size_t k = 0; k < n; k++)
+  {
+    if (parent[k] >= 0)
+      continue;
+    for (int y = bounds[k].y; y < bounds[k].y + bounds[k].height; y++)
+    {
+      const int* label = shapeLabels.ptr<int>(y);
+      const Vec3b* pixel = colorFrame.ptr<Vec3b>(y);
+      for (int x = bounds[k].x; x < bounds[k].x + bounds[k].width; x++)
+      {
+        int l = label[x] - 1;
+        if (l < 0 || root[l] != int(k))
+          continue;
+        sums[l] += Vec3d(pixel[x][0], pixel[x][1], pixel[x][2]);
+        counts[l]++;
+      }
+    }
+  }
+
+  // Each shape's mean covers the shapes inside it, as its filled contour does, so smallest first they add theirs to
+  // the one around them
+  for (auto it = order.rbegin(); it != order.rend(); ++it)
+  {
+    if (parent[*it] < 0)
+      continue;
+    sums[parent[*it]] += sums[*it];
+    counts[parent[*it]] += counts[*it];
+  }
+
+  means.resize(n);
+  for (size_t k = 0; k < n; k++)
+  {
+    means[k] = counts[k] ? Scalar(sums[k][0], sums[k][1], sums[k][2]) / double(counts[k]) : Scalar(0, 0, 0);
+    if (parent[k] < 0)
+      shapeLabels(bounds[k]).setTo(0);
+  }
+}
+
+bool GrayscaleContour::GetColor(const Scalar& meanColorBGR, std::string& color, float& confidence)
 {
-  Mat mask = Mat::zeros(colorFrame.rows, colorFrame.cols, CV_8UC1);
-  drawContours(mask, contours, Index, Scalar(255), CV_FILLED);
-  Mat meanBGR(1, 1, colorFrame.type(), mean(colorFrame, mask));
+  Mat meanBGR(1, 1, colorFrame.type(), meanColorBGR);
   Mat mean_hsv_mat(1, 1, colorFrame.type(), Scalar(0, 0, 0));
   cvtColor(meanBGR, mean_hsv_mat, CV_BGR2HSV, 3);
   Vec3b meanColor = mean_hsv_mat.at<Vec3b>(0, 0);
@@ -22,13 +22,21 @@ private:
   std::vector<Vec4i> hierarchy;
   std::vector<std::vector<cv::Point> > shapes;
   Rect roi;
+  Rect searchROI;  // empty to search the whole frame
 
-  void ConvertToGrayscale();
-  void DetectEdges();
-  void FindContours();
-  bool GetColor(int shapeIndex, std::string& color, float& confidence);
+  // Bounding boxes, in frame coordinates and merged where they overlap, of the contours found at a coarse pyramid level
+  void FindCandidateRegions(const Mat& frame, const Rect& search, std::vector<Rect>& regions);
+  void ConvertToGrayscale(const Rect& region);
+  void DetectEdges(const Rect& region);
+  void FindContours(const Rect& region);
+  void FilterContours();
+  // Mean BGR color inside each of the contours at indices, as cv::mean masked by each filled contour would give, from
+  // one label image and one pass over their bounding boxes
+  void GetMeanColors(const std::vector<int>& indices, std::vector<Scalar>& means);
+  bool GetColor(const Scalar& meanColorBGR, std::string& color, float& confidence);
   Point findCenter(std::vector<Point>& points);
   Mat contoursFrame;
+  Mat shapeLabels;  // 1 + the index of the shape at each pixel, zero outside of GetMeanColors
   int frame_height;
   int frame_width;
 
@@ -69,6 +77,15 @@ private:
   double crossAngleVarErrorThreshold;
   double circleEnclosingErrorThreshold;
 
+  // Coarse to fine search. With 0 levels, the full resolution pipeline runs over the whole search region.
+  struct PyramidParams
+  {
+    int levels;
+    int padding;        // full resolution pixels added around each candidate region
+    double cannyScale;  // of the Canny thresholds at the coarse level, which pyrDown has already smoothed
+  };
+  PyramidParams pyramidParams;
+
   double redHueMin;
   double redHueMax;
   double blueHue;
@@ -77,5 +94,6 @@ private:
 public:
   GrayscaleContour(ros::NodeHandle& nh);
   void GetShapes(cv::Mat& frame, navigator_msgs::DockShapes& symbols);
+  void SetSearchROI(const cv::Rect& search_roi);
   void init();
 };
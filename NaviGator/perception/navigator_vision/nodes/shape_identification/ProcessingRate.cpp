@@ -0,0 +1,67 @@
+#include "ProcessingRate.h"
+#include <algorithm>
+#include "TrackedShape.h"
+
+ProcessingRate::ProcessingRate()
+  : enabled(false), farDistance(40), approachSpeed(0.5), haveDistance(false), distance(0), closingSpeed(0)
+{
+}
+void ProcessingRate::init(ros::NodeHandle& nh)
+{
+  double stableRate, farRate;
+  nh.param<bool>("processing_rate/enabled", enabled, false);
+  nh.param<double>("processing_rate/stable_rate", stableRate, 4);
+  nh.param<double>("processing_rate/far_rate", farRate, 1);
+  nh.param<double>("processing_rate/far_distance", farDistance, 40);
+  nh.param<double>("processing_rate/approach_speed", approachSpeed, 0.5);
+  // Shapes not seen within the tracker's gap go stale, so they are seen at least twice within it while stable
+  double maxStable = 0.5 * TrackedShape::maxTimeGap().toSec();
+  stablePeriod = ros::Duration(std::min(stableRate > 0 ? 1 / stableRate : maxStable, maxStable));
+  farPeriod = ros::Duration(farRate > 0 ? 1 / farRate : 0);
+  reset();
+}
+void ProcessingRate::reset()
+{
+  period = ros::Duration(0);
+  lastProcessed = ros::Time();
+  clearDockDistance();
+}
+bool ProcessingRate::shouldProcess(const ros::Time& stamp)
+{
+  // A stamp going backwards, as when a bag loops, restarts the period
+  if (enabled && stamp >= lastProcessed && stamp - lastProcessed < period)
+    return false;
+  lastProcessed = stamp;
+  return true;
+}
+void ProcessingRate::setDockDistance(const ros::Time& stamp, double dockDistance)
+{
+  if (haveDistance && stamp > distanceStamp)
+  {
+    double speed = (distance - dockDistance) / (stamp - distanceStamp).toSec();
+    closingSpeed = 0.5 * closingSpeed + 0.5 * speed;
+  }
+  else if (!haveDistance)
+    closingSpeed = 0;
+  haveDistance = true;
+  distance = dockDistance;
+  distanceStamp = stamp;
+}
+void ProcessingRate::clearDockDistance()
+{
+  haveDistance = false;
+  closingSpeed = 0;
+}
+void ProcessingRate::update(size_t tracked, size_t ready)
+{
+  bool far = haveDistance && distance > farDistance;
+  bool approaching = haveDistance && !far && closingSpeed > approachSpeed;
+  if (ready < tracked || approaching)
+    period = ros::Duration(0);
+  else if (tracked > 0)
+    period = stablePeriod;
+  else if (far)
+    period = farPeriod;
+  else
+    period = ros::Duration(0);
+}
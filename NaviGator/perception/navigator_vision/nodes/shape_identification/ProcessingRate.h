@@ -0,0 +1,38 @@
+#pragma once
+#include <ros/ros.h>
+#include <cstddef>
+
+/*
+  Picks how often frames are processed, so the node costs little while its shapes are stable or the dock is far off.
+  Every frame is processed while some tracked shape is not ready yet, while closing in on the dock, or with nothing
+  tracked and the dock near or unknown. With every tracked shape ready, frames are processed just often enough for
+  the shapes not to go stale, and with nothing tracked and the dock far off only now and then.
+*/
+class ProcessingRate
+{
+private:
+  bool enabled;
+  ros::Duration stablePeriod;
+  ros::Duration farPeriod;
+  double farDistance;
+  double approachSpeed;  // closing speed on the dock, in m/s, above which every frame is processed
+  ros::Duration period;
+  ros::Time lastProcessed;
+  bool haveDistance;
+  double distance;
+  ros::Time distanceStamp;
+  double closingSpeed;  // smoothed over the frames the distance is known in
+
+public:
+  ProcessingRate();
+  void init(ros::NodeHandle& nh);
+  // Processes every frame until update is next called
+  void reset();
+  // True if the frame should be processed, in which case it is counted as processed
+  bool shouldProcess(const ros::Time& stamp);
+  // Distance to the dock at stamp, from the last processed frame it was known in
+  void setDockDistance(const ros::Time& stamp, double dockDistance);
+  void clearDockDistance();
+  // Picks the period until the next processed frame from the number of tracked shapes and how many are ready
+  void update(size_t tracked, size_t ready);
+};
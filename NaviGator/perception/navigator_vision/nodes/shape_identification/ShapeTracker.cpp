@@ -1,5 +1,7 @@
 #include "ShapeTracker.h"
-ShapeTracker::ShapeTracker() : active(false)
+#include <cmath>
+#include <iterator>
+ShapeTracker::ShapeTracker() : nextId(0), active(false)
 {
 }
 void ShapeTracker::setActive(bool a)
@@ -13,15 +15,90 @@ void ShapeTracker::init(ros::NodeHandle& nh)
   getShapesService = nh.advertiseService(get_shapes_topic, &ShapeTracker::getShapesCallback, this);
   allFoundShapesPublish = nh.advertise<navigator_msgs::DockShapes>("filtered_shapes", 10);
 }
+int64_t ShapeTracker::cellOf(const navigator_msgs::DockShape& s, int dx, int dy)
+{
+  double size = std::max(TrackedShape::maxDistance(), 1.0);
+  int64_t x = int64_t(std::floor(s.CenterX / size)) + dx;
+  int64_t y = int64_t(std::floor(s.CenterY / size)) + dy;
+  return (x << 32) ^ (y & 0xFFFFFFFF);
+}
+void ShapeTracker::insert(EntryIt it, const navigator_msgs::DockShape& s)
+{
+  it->type = TypeKey(s.Color, s.Shape);
+  it->cell = cellOf(s);
+  buckets[it->type][it->cell].push_back(it);
+}
+void ShapeTracker::remove(EntryIt it)
+{
+  Grid& grid = buckets[it->type];
+  auto cell = grid.find(it->cell);
+  std::vector<EntryIt>& entries = cell->second;
+  entries.erase(std::find(entries.begin(), entries.end(), it));
+  if (entries.empty())
+    grid.erase(cell);
+}
+void ShapeTracker::publish(EntryIt it)
+{
+  if (it->published < 0)
+  {
+    it->published = foundShapes.list.size();
+    foundShapes.list.push_back(it->tracked.get());
+    foundEntries.push_back(it);
+  }
+  else
+    foundShapes.list[it->published] = it->tracked.get();
+}
+void ShapeTracker::unpublish(EntryIt it)
+{
+  if (it->published < 0)
+    return;
+  // Move the last published shape into the gap
+  foundShapes.list[it->published] = foundShapes.list.back();
+  foundEntries[it->published] = foundEntries.back();
+  foundEntries[it->published]->published = it->published;
+  foundShapes.list.pop_back();
+  foundEntries.pop_back();
+  it->published = -1;
+}
 void ShapeTracker::addShape(navigator_msgs::DockShape& s)
 {
-  for (auto& tracked : shapes)
+  // Any type can match, update keeps the more confident color of the two
+  EntryIt match = shapes.end();
+  for (auto& bucket : buckets)
   {
-    if (tracked.update(s))
-      return;
+    for (int dx = -1; dx <= 1; dx++)
+    {
+      for (int dy = -1; dy <= 1; dy++)
+      {
+        auto cell = bucket.second.find(cellOf(s, dx, dy));
+        if (cell == bucket.second.end())
+          continue;
+        for (EntryIt it : cell->second)
+        {
+          if ((match == shapes.end() || it->id < match->id) && it->tracked.canUpdate(s))
+            match = it;
+        }
+      }
+    }
   }
-  // ~printf("Inserting Shape \n");
-  shapes.push_back(TrackedShape(s));
+
+  if (match != shapes.end())
+  {
+    remove(match);
+    match->tracked.update(s);
+    shapes.splice(shapes.end(), shapes, match);
+  }
+  else
+  {
+    // ~printf("Inserting Shape \n");
+    shapes.push_back(Entry{ TrackedShape(s), nextId++, TypeKey(), 0, -1 });
+    match = std::prev(shapes.end());
+  }
+  insert(match, s);  // update made s the latest sighting of the shape
+  if (match->tracked.isReady())
+    publish(match);
+  else
+    unpublish(match);
 }
 void ShapeTracker::addShapes(navigator_msgs::DockShapes& newShapes)
 {
@@ -30,22 +107,24 @@ void ShapeTracker::addShapes(navigator_msgs::DockShapes& newShapes)
   {
     addShape(shape);
   }
-  shapes.erase(std::remove_if(shapes.begin(), shapes.end(),
-                              [](TrackedShape& s) {
-                                //  if (s.isStale()) printf("Shape is stale, removing\n");
-                                return s.isStale();
-                              }),
-               shapes.end());
-  // ~printf("Shapes size %d\n",shapes.size());
-  navigator_msgs::DockShapes found_shapes;
-  for (auto& tracked : shapes)
+  while (!shapes.empty() && shapes.front().tracked.isStale())
   {
-    if (tracked.isReady())
-    {
-      found_shapes.list.push_back(tracked.get());
-    }
+    //  printf("Shape is stale, removing\n");
+    EntryIt stale = shapes.begin();
+    remove(stale);
+    unpublish(stale);
+    shapes.pop_front();
   }
-  allFoundShapesPublish.publish(found_shapes);
+  // ~printf("Shapes size %d\n",shapes.size());
+  allFoundShapesPublish.publish(foundShapes);
+}
+size_t ShapeTracker::trackedCount() const
+{
+  return shapes.size();
+}
+size_t ShapeTracker::readyCount() const
+{
+  return foundShapes.list.size();
 }
 bool ShapeTracker::getShapesCallback(navigator_msgs::GetDockShapes::Request& req,
                                      navigator_msgs::GetDockShapes::Response& res)
@@ -62,11 +141,19 @@ bool ShapeTracker::getShapesCallback(navigator_msgs::GetDockShapes::Request& req
     res.error = navigator_msgs::GetDockShapes::Response::INVALID_REQUEST;
     return true;
   }
-  for (auto& tracked : shapes)
+  for (auto& bucket : buckets)
   {
-    if (tracked.sameType(req.Color, req.Shape) && tracked.isReady())
+    const TypeKey& type = bucket.first;
+    if ((req.Color != navigator_msgs::GetDockShape::Request::ANY && req.Color != type.first) ||
+        (req.Shape != navigator_msgs::GetDockShape::Request::ANY && req.Shape != type.second))
+      continue;
+    for (auto& cell : bucket.second)
     {
-      res.shapes.list.push_back(tracked.get());
+      for (EntryIt it : cell.second)
+      {
+        if (it->tracked.isReady())
+          res.shapes.list.push_back(it->tracked.get());
+      }
     }
   }
   if (res.shapes.list.size() > 0)
@@ -3,17 +3,46 @@
 #include <navigator_msgs/GetDockShapes.h>
 #include <ros/ros.h>
 #include <algorithm>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "TrackedShape.h"
 
 class ShapeTracker
 {
 private:
+  typedef std::pair<std::string, std::string> TypeKey;  // (Color, Shape)
+  struct Entry
+  {
+    TrackedShape tracked;
+    uint64_t id;   // order shapes were first seen in, the oldest wins when several match
+    TypeKey type;  // bucket and grid cell the shape is in
+    int64_t cell;
+    int published;  // index in foundShapes, or -1
+  };
+  typedef std::list<Entry>::iterator EntryIt;
+  // Shapes of one type, in a grid of cells as wide as TrackedShape::maxDistance() so a match is in the 3x3 cells around
+  typedef std::unordered_map<int64_t, std::vector<EntryIt> > Grid;
+
   ros::ServiceServer getShapesService;
   ros::Publisher allFoundShapesPublish;
-  std::vector<TrackedShape> shapes;
+  std::list<Entry> shapes;  // least recently updated first, so stale shapes are at the front
+  std::map<TypeKey, Grid> buckets;
+  uint64_t nextId;
+  // Ready shapes, kept up to date as shapes are updated and removed, and the entry of each
+  navigator_msgs::DockShapes foundShapes;
+  std::vector<EntryIt> foundEntries;
   bool active;
   static bool validRequest(std::string& color, std::string& shape);
+  static int64_t cellOf(const navigator_msgs::DockShape& s, int dx = 0, int dy = 0);
+  void insert(EntryIt it, const navigator_msgs::DockShape& s);
+  void remove(EntryIt it);
+  void publish(EntryIt it);
+  void unpublish(EntryIt it);
 
 public:
   ShapeTracker();
@@ -22,4 +51,7 @@ public:
   void init(ros::NodeHandle& nh);
   void addShape(navigator_msgs::DockShape& s);
   void addShapes(navigator_msgs::DockShapes& newShapes);
+  // Shapes being tracked, and how many of them are ready
+  size_t trackedCount() const;
+  size_t readyCount() const;
 };
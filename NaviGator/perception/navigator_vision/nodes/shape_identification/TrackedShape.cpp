@@ -24,7 +24,15 @@ double TrackedShape::centerDistance(navigator_msgs::DockShape& a, navigator_msgs
   // ~printf("A = (%d,%d) B= (%d,%d)\n",a.CenterX,a.CenterY,b.CenterX,b.CenterY);
   return sqrtf(powf(double(a.CenterX) - double(b.CenterX), 2) + powf(double(a.CenterY) - double(b.CenterY), 2));
 }
-bool TrackedShape::update(navigator_msgs::DockShape& s)
+double TrackedShape::maxDistance()
+{
+  return MAX_DISTANCE;
+}
+ros::Duration TrackedShape::maxTimeGap()
+{
+  return MAX_TIME_GAP;
+}
+bool TrackedShape::canUpdate(navigator_msgs::DockShape& s)
 {
   double distance = centerDistance(latest, s);
   if (distance > MAX_DISTANCE)
@@ -38,6 +46,12 @@ bool TrackedShape::update(navigator_msgs::DockShape& s)
     //  printf(" %s %s too old from %s %s\n",latest.Color.c_str(),latest.Shape.c_str(),s.Color.c_str(),s.Shape.c_str());
     return false;
   }
+  return true;
+}
+bool TrackedShape::update(navigator_msgs::DockShape& s)
+{
+  if (!canUpdate(s))
+    return false;
   if (latest.Color != s.Color)
   {
     // What to do if color is different with two nearby
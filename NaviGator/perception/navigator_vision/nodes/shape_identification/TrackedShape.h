@@ -20,9 +20,15 @@ public:
   TrackedShape();
   TrackedShape(navigator_msgs::DockShape& s);
   bool sameType(std::string& color, std::string& shape);
+  // True if update(s) would succeed, without changing anything
+  bool canUpdate(navigator_msgs::DockShape& s);
   bool update(navigator_msgs::DockShape& s);
   bool isReady();
   bool isStale();
   navigator_msgs::DockShape get();
   static void init(ros::NodeHandle& nh);
+  // Largest distance between the centers of consecutive sightings of a shape
+  static double maxDistance();
+  // Longest a shape can go unseen before it is stale
+  static ros::Duration maxTimeGap();
 };
@@ -1,18 +1,23 @@
 #include <cv_bridge/cv_bridge.h>
 #include <geometry_msgs/Point.h>
+#include <image_geometry/pinhole_camera_model.h>
 #include <image_transport/image_transport.h>
+#include <mil_msgs/PerceptionObjectArray.h>
+#include <mil_tools/trace.hpp>
 #include <navigator_msgs/DockShapes.h>
 #include <navigator_msgs/SetROI.h>
 #include <ros/ros.h>
 #include <sensor_msgs/RegionOfInterest.h>
 #include <sensor_msgs/image_encodings.h>
 #include <std_srvs/SetBool.h>
+#include <tf/transform_listener.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/opencv.hpp>
 #include "DockShapeVision.h"
 #include "GrayscaleContour/GrayscaleContour.h"
+#include "ProcessingRate.h"
 #include "ShapeTracker.h"
 #include "std_msgs/String.h"
 
@@ -22,6 +27,7 @@ class ShooterVision
 {
 private:
   ShapeTracker tracker;
+  ProcessingRate rate;
   std::unique_ptr<DockShapeVision> vision;
   navigator_msgs::DockShapes symbols;
   ros::NodeHandle nh_;
@@ -38,9 +44,28 @@ private:
   unsigned int width;
   unsigned int height;
 
+  // Limits the search to where the dock, as found by PCODAR, projects into the frame
+  struct DockROIParams
+  {
+    bool enabled;
+    std::string classification;
+    double padding;  // fraction of the projected size added to each side
+    ros::Duration timeout;
+    bool imageIsRectified;
+  };
+  DockROIParams dockROIParams;
+  ros::Subscriber objectsSub;
+  ros::Subscriber cameraInfoSub;
+  image_geometry::PinholeCameraModel cameraModel;
+  tf::TransformListener tfListener;
+  mil_msgs::PerceptionObject dock;
+  bool haveDock = false;
+  bool followDock = false;  // the dock is needed for the search ROI or the processing rate
+
 public:
   ShooterVision() : nh_(ros::this_node::getName()), it_(nh_)
   {
+    mil_tools::Tracer::instance().configure(nh_);
     nh_.param<bool>("auto_start", active, false);
     vision.reset(new GrayscaleContour(nh_));
     vision->init();
@@ -65,6 +90,97 @@ public:
     roi = Rect(x_offset, y_offset, width, height);
     TrackedShape::init(nh_);
     tracker.init(nh_);
+    rate.init(nh_);
+
+    std::string objects_topic;
+    double timeout;
+    nh_.param<bool>("dock_roi/enabled", dockROIParams.enabled, false);
+    nh_.param<std::string>("dock_roi/objects_topic", objects_topic, "/pcodar/objects");
+    nh_.param<std::string>("dock_roi/classification", dockROIParams.classification, "dock");
+    nh_.param<double>("dock_roi/padding", dockROIParams.padding, 0.2);
+    nh_.param<double>("dock_roi/timeout", timeout, 1.0);
+    nh_.param<bool>("dock_roi/image_is_rectified", dockROIParams.imageIsRectified, false);
+    dockROIParams.timeout = ros::Duration(timeout);
+    bool rate_enabled;
+    nh_.param<bool>("processing_rate/enabled", rate_enabled, false);
+    followDock = dockROIParams.enabled || rate_enabled;
+    if (followDock)
+    {
+      objectsSub = nh_.subscribe(objects_topic, 1, &ShooterVision::objectsCallback, this);
+      cameraInfoSub =
+          nh_.subscribe(image_transport::getCameraInfoTopic(camera_topic), 1, &ShooterVision::cameraInfoCallback, this);
+    }
+  }
+  void objectsCallback(const mil_msgs::PerceptionObjectArrayConstPtr &msg)
+  {
+    for (const mil_msgs::PerceptionObject &object : msg->objects)
+    {
+      if (object.labeled_classification == dockROIParams.classification)
+      {
+        dock = object;
+        haveDock = true;
+        return;
+      }
+    }
+  }
+  void cameraInfoCallback(const sensor_msgs::CameraInfoConstPtr &msg)
+  {
+    cameraModel.fromCameraInfo(msg);
+  }
+  // Pose of the dock in the camera frame at the time of header, giving false if the dock or the transform is not known
+  bool dockInCamera(const std_msgs::Header &header, tf::Transform &dock_to_camera)
+  {
+    if (!haveDock || header.stamp - dock.header.stamp > dockROIParams.timeout)
+      return false;
+
+    tf::StampedTransform object_to_camera;
+    try
+    {
+      tfListener.lookupTransform(header.frame_id, dock.header.frame_id, header.stamp, object_to_camera);
+    }
+    catch (tf::TransformException &ex)
+    {
+      ROS_WARN_THROTTLE(1.0, "Could not transform the dock into the camera frame: %s", ex.what());
+      return false;
+    }
+
+    tf::Pose pose;
+    tf::poseMsgToTF(dock.pose, pose);
+    dock_to_camera = object_to_camera * pose;
+    return true;
+  }
+  /*
+    Projects the corners of the dock's bounding box into the frame, giving false if the camera model is not known. The
+    box is given as an empty Rect when the dock is behind the camera or off the frame.
+  */
+  bool projectDock(const tf::Transform &dock_to_camera, const cv::Size &frame_size, cv::Rect &box)
+  {
+    if (!cameraModel.initialized())
+      return false;
+
+    std::vector<cv::Point> corners;
+    for (int i = 0; i < 8; i++)
+    {
+      tf::Vector3 corner(i & 1 ? 0.5 : -0.5, i & 2 ? 0.5 : -0.5, i & 4 ? 0.5 : -0.5);
+      corner *= tf::Vector3(dock.scale.x, dock.scale.y, dock.scale.z);
+      corner = dock_to_camera * corner;
+      if (corner.z() <= 0.1)
+      {
+        box = cv::Rect();
+        return true;
+      }
+      cv::Point2d pixel = cameraModel.project3dToPixel(cv::Point3d(corner.x(), corner.y(), corner.z()));
+      if (!dockROIParams.imageIsRectified)
+        pixel = cameraModel.unrectifyPoint(pixel);
+      corners.push_back(pixel);
+    }
+
+    box = cv::boundingRect(corners);
+    int pad_x = box.width * dockROIParams.padding;
+    int pad_y = box.height * dockROIParams.padding;
+    box = cv::Rect(box.x - pad_x, box.y - pad_y, box.width + 2 * pad_x, box.height + 2 * pad_y);
+    box &= cv::Rect(cv::Point(0, 0), frame_size);
+    return true;
   }
   void fixPoint(geometry_msgs::Point &p)
   {
@@ -75,6 +191,8 @@ public:
   }
   bool runCallback(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res)
   {
+    if (req.data && !active)
+      rate.reset();
     active = req.data;
     res.success = true;
     tracker.setActive(req.data);
@@ -95,8 +213,9 @@ public:
   }
   void run(const sensor_msgs::ImageConstPtr &msg)
   {
-    if (!active)
+    if (!active || !rate.shouldProcess(msg->header.stamp))
       return;
+    mil_tools::TraceSpan span("shape_identification.frame", msg->header.stamp);
     // Grab ros frame
     cv_bridge::CvImagePtr cv_ptr;
     try
@@ -113,6 +232,28 @@ public:
     height = frame.rows;
     symbols.list.clear();
 
+    tf::Transform dock_to_camera;
+    bool dock_known = followDock && dockInCamera(msg->header, dock_to_camera);
+    if (dock_known)
+      rate.setDockDistance(msg->header.stamp, dock_to_camera.getOrigin().length());
+    else
+      rate.clearDockDistance();
+
+    cv::Rect dock_box;
+    if (dockROIParams.enabled && dock_known && projectDock(dock_to_camera, frame.size(), dock_box))
+    {
+      // Frame coordinates to those of the resized ROI GetShapes is given
+      double scale_x = size.width / double(frame.cols);
+      double scale_y = size.height / double(frame.rows);
+      cv::Rect search(dock_box.x * scale_x, dock_box.y * scale_y, dock_box.width * scale_x, dock_box.height * scale_y);
+      search &= roi;
+      if (search.area() == 0)
+        return;  // the dock is not in view
+      vision->SetSearchROI(search - roi.tl());
+    }
+    else
+      vision->SetSearchROI(cv::Rect());
+
     cv::Mat resized;
     cv::resize(frame, resized, size);
     cv::Mat resized_roied = resized(roi);
@@ -132,6 +273,7 @@ public:
     }
     foundShapesPublisher.publish(symbols);
     tracker.addShapes(symbols);
+    rate.update(tracker.trackedCount(), tracker.readyCount());
   }
 };
 
@@ -7,6 +7,230 @@ using namespace cv;
 
 namespace fs = boost::filesystem;
 
+constexpr int ShapeDescriptor::SIGNATURE_SIZE;
+constexpr int ShapeDescriptor::MASK_SIZE;
+
+bool ShapeDescriptor::compute(const vector<Point>& contour)
+{
+  if (contour.size() < 3)
+    return false;
+  Moments m = moments(contour);
+  if (m.m00 <= 0)
+    return false;
+  HuMoments(m, hu.data());
+  Point2d centroid(m.m10 / m.m00, m.m01 / m.m00);
+
+  // Walk the outline a pixel at a time, as approximated contours only have their vertices
+  signature.assign(SIGNATURE_SIZE, 0.0f);
+  for (size_t i = 0; i < contour.size(); i++)
+  {
+    Point2d a = contour[i], b = contour[(i + 1) % contour.size()];
+    int steps = max(1, int(max(abs(b.x - a.x), abs(b.y - a.y))));
+    for (int t = 0; t < steps; t++)
+    {
+      Point2d d = a + (b - a) * (double(t) / steps) - centroid;
+      int bin = int((atan2(d.y, d.x) + CV_PI) * SIGNATURE_SIZE / (2 * CV_PI)) % SIGNATURE_SIZE;
+      signature[bin] = max(signature[bin], float(hypot(d.x, d.y)));
+    }
+  }
+  // Bins of small outlines may have no points, take the bin before them
+  for (int k = 1; k < 2 * SIGNATURE_SIZE; k++)
+  {
+    if (signature[k % SIGNATURE_SIZE] == 0.0f)
+      signature[k % SIGNATURE_SIZE] = signature[(k - 1) % SIGNATURE_SIZE];
+  }
+  float mean = 0, max_radius = 0;
+  for (float r : signature)
+  {
+    mean += r / SIGNATURE_SIZE;
+    max_radius = max(max_radius, r);
+  }
+  if (mean < 1.0f)
+    return false;
+  for (float& r : signature)
+    r /= mean;
+
+  const double center = MASK_SIZE / 2;
+  const double scale = (center - 1) / max_radius;
+  vector<vector<Point>> scaled(1);
+  for (const Point& pt : contour)
+  {
+    Point2d p = (Point2d(pt) - centroid) * scale;
+    scaled[0].push_back(Point(cvRound(p.x + center), cvRound(p.y + center)));
+  }
+  mask = Mat::zeros(MASK_SIZE, MASK_SIZE, CV_8U);
+  fillPoly(mask, scaled, Scalar(255));
+  return true;
+}
+
+double ShapeDescriptor::huDistance(const ShapeDescriptor& other) const
+{
+  // The second moment is the square of one
+  double spread = max(hu[0], other.hu[0]);
+  if (spread <= 0)
+    return 0;
+  return (abs(hu[0] - other.hu[0]) + abs(sqrt(hu[1]) - sqrt(other.hu[1]))) / spread;
+}
+
+float ShapeDescriptor::score(const ShapeDescriptor& other) const
+{
+  // Rotation of other that matches this best, as a shift of its signature
+  int best_shift = 0;
+  float best_distance = numeric_limits<float>::max();
+  for (int shift = 0; shift < SIGNATURE_SIZE; shift++)
+  {
+    float distance = 0;
+    for (int k = 0; k < SIGNATURE_SIZE; k++)
+      distance += abs(signature[k] - other.signature[(k + shift) % SIGNATURE_SIZE]);
+    if (distance < best_distance)
+    {
+      best_distance = distance;
+      best_shift = shift;
+    }
+  }
+  float signature_similarity = max(0.0f, 1.0f - best_distance / SIGNATURE_SIZE);
+  if (signature_similarity == 0.0f)
+    return 0.0f;
+
+  // Overlap with the mask of other rotated by the same angle, sampled at the nearest pixel
+  const double angle = best_shift * 2 * CV_PI / SIGNATURE_SIZE;
+  const double c = cos(angle), s = sin(angle), center = MASK_SIZE / 2;
+  int intersection = 0, combined = 0;
+  for (int y = 0; y < MASK_SIZE; y++)
+  {
+    const uint8_t* row = mask.ptr<uint8_t>(y);
+    for (int x = 0; x < MASK_SIZE; x++)
+    {
+      int ox = cvRound((x - center) * c - (y - center) * s + center);
+      int oy = cvRound((x - center) * s + (y - center) * c + center);
+      bool in_other = ox >= 0 && oy >= 0 && ox < MASK_SIZE && oy < MASK_SIZE && other.mask.at<uint8_t>(oy, ox);
+      intersection += row[x] && in_other;
+      combined += row[x] || in_other;
+    }
+  }
+  return combined ? signature_similarity * intersection / combined : 0.0f;
+}
+
+void ShapeDescriptor::write(FileStorage& fs) const
+{
+  fs << "hu" << vector<double>(hu.begin(), hu.end());
+  fs << "signature" << signature;
+  fs << "mask" << mask;
+}
+
+bool ShapeDescriptor::read(const FileNode& node)
+{
+  vector<double> hu_values;
+  node["hu"] >> hu_values;
+  node["signature"] >> signature;
+  node["mask"] >> mask;
+  if (hu_values.size() != hu.size() || signature.size() != size_t(SIGNATURE_SIZE) || mask.rows != MASK_SIZE ||
+      mask.cols != MASK_SIZE || mask.type() != CV_8U)
+    return false;
+  copy(hu_values.begin(), hu_values.end(), hu.begin());
+  return true;
+}
+
+namespace
+{
+// Outline of a template, the largest bright region that does not touch the border of the image
+bool templateContour(const Mat& image, vector<Point>& contour)
+{
+  Mat binary;
+  threshold(image, binary, 0, 255, THRESH_BINARY | THRESH_OTSU);
+  vector<vector<Point>> contours;
+  vector<Vec4i> hierarchy;
+  findContours(binary, contours, hierarchy, CV_RETR_CCOMP, CV_CHAIN_APPROX_NONE);
+  Rect inner(1, 1, image.cols - 2, image.rows - 2);
+  double best_area = 0;
+  for (size_t i = 0; i < contours.size(); i++)
+  {
+    Rect bounds = boundingRect(contours[i]);
+    double area = contourArea(contours[i]);
+    if (hierarchy[i][3] < 0 && (bounds & inner) == bounds && area > best_area)
+    {
+      best_area = area;
+      contour = contours[i];
+    }
+  }
+  return best_area > 0;
+}
+
+class CandidateDescriber : public ParallelLoopBody
+{
+public:
+  CandidateDescriber(const vector<vector<Point>>& candidates, vector<ShapeDescriptor>& descriptors,
+                     vector<uint8_t>& valid)
+    : candidates(candidates), descriptors(descriptors), valid(valid)
+  {
+  }
+
+  void operator()(const Range& range) const
+  {
+    for (int i = range.start; i < range.end; i++)
+      valid[i] = descriptors[i].compute(candidates[i]);
+  }
+
+private:
+  const vector<vector<Point>>& candidates;
+  vector<ShapeDescriptor>& descriptors;
+  vector<uint8_t>& valid;
+};
+
+class CandidateScorer : public ParallelLoopBody
+{
+public:
+  CandidateScorer(const vector<ShapeDescriptor>& descriptors, const vector<uint8_t>& valid,
+                  const vector<const Shape*>& shapes, double max_hu_distance, vector<float>& scores)
+    : descriptors(descriptors), valid(valid), shapes(shapes), max_hu_distance(max_hu_distance), scores(scores)
+  {
+  }
+
+  // Pair i is candidate i / shapes.size() and shape i % shapes.size()
+  void operator()(const Range& range) const
+  {
+    for (int i = range.start; i < range.end; i++)
+    {
+      size_t candidate = i / shapes.size();
+      const ShapeDescriptor& shape = shapes[i % shapes.size()]->descriptor();
+      if (!valid[candidate] || descriptors[candidate].huDistance(shape) > max_hu_distance)
+        scores[i] = 0.0f;
+      else
+        scores[i] = shape.score(descriptors[candidate]);
+    }
+  }
+
+private:
+  const vector<ShapeDescriptor>& descriptors;
+  const vector<uint8_t>& valid;
+  const vector<const Shape*>& shapes;
+  double max_hu_distance;
+  vector<float>& scores;
+};
+}  // namespace
+
+vector<ShapeMatch> matchCandidates(const vector<vector<Point>>& candidates, const vector<const Shape*>& shapes,
+                                   double max_hu_distance, float min_score)
+{
+  vector<ShapeMatch> matches(candidates.size(), ShapeMatch{ nullptr, 0.0f });
+  if (candidates.empty() || shapes.empty())
+    return matches;
+
+  vector<ShapeDescriptor> descriptors(candidates.size());
+  vector<uint8_t> valid(candidates.size());
+  parallel_for_(Range(0, candidates.size()), CandidateDescriber(candidates, descriptors, valid));
+  vector<float> scores(candidates.size() * shapes.size());
+  parallel_for_(Range(0, scores.size()), CandidateScorer(descriptors, valid, shapes, max_hu_distance, scores));
+
+  for (size_t i = 0; i < scores.size(); i++)
+  {
+    ShapeMatch& match = matches[i / shapes.size()];
+    if (scores[i] > 0.0f && scores[i] >= min_score && scores[i] > match.score)
+      match = ShapeMatch{ shapes[i % shapes.size()], scores[i] };
+  }
+  return matches;
+}
+
 vector<Shape> Shape::loadShapes(string directory, float shape_area)
 {
   fs::directory_iterator dir_end;  // default ctor --> past-the-end
@@ -72,8 +296,68 @@ void Shape::load(string path, float shape_area)
   }
   _pixels_per_meter = sqrt(template_area / shape_area);
 
+  fs::path cache_path{ template_path };
+  cache_path.replace_extension(".yml");
+  double template_time = fs::last_write_time(template_path);
+  if (loadCache(cache_path.string(), template_time))
+    return;
+
   // Find angle of radial symmetry
   _radial_symmetry_angle = mil_vision::getRadialSymmetryAngle(_template, 0.01);
+
+  vector<Point> contour;
+  if (!templateContour(_template, contour) || !_descriptor.compute(contour))
+  {
+    cout << __PRETTY_FUNCTION__ << ": no shape was found in the image at " << path << "." << endl;
+    _ok = false;
+    return;
+  }
+  saveCache(cache_path.string(), template_time);
+}
+
+bool Shape::loadCache(const string& cache_path, double template_time)
+{
+  if (!fs::exists(cache_path))
+    return false;
+  try
+  {
+    FileStorage storage(cache_path, FileStorage::READ);
+    if (!storage.isOpened() || double(storage["template_time"]) != template_time ||
+        int(storage["signature_size"]) != ShapeDescriptor::SIGNATURE_SIZE ||
+        int(storage["mask_size"]) != ShapeDescriptor::MASK_SIZE || !_descriptor.read(storage["descriptor"]))
+      return false;
+    _radial_symmetry_angle = float(storage["radial_symmetry_angle"]);
+    return true;
+  }
+  catch (const cv::Exception& e)
+  {
+    cout << __PRETTY_FUNCTION__ << ": the cache at " << cache_path << " could not be read: " << e.what() << endl;
+    return false;
+  }
+}
+
+void Shape::saveCache(const string& cache_path, double template_time) const
+{
+  try
+  {
+    FileStorage storage(cache_path, FileStorage::WRITE);
+    if (!storage.isOpened())
+    {
+      cout << __PRETTY_FUNCTION__ << ": could not write the cache at " << cache_path << "." << endl;
+      return;
+    }
+    storage << "template_time" << template_time;
+    storage << "signature_size" << ShapeDescriptor::SIGNATURE_SIZE;
+    storage << "mask_size" << ShapeDescriptor::MASK_SIZE;
+    storage << "radial_symmetry_angle" << _radial_symmetry_angle;
+    storage << "descriptor" << "{";
+    _descriptor.write(storage);
+    storage << "}";
+  }
+  catch (const cv::Exception& e)
+  {
+    cout << __PRETTY_FUNCTION__ << ": could not write the cache at " << cache_path << ": " << e.what() << endl;
+  }
 }
 
 UnderwaterShapeDetector::UnderwaterShapeDetector(ros::NodeHandle& nh, int img_buf_size, string name_space)
@@ -27,6 +27,9 @@
 #include <OGRE/OgreTextureManager.h>
 #include <OGRE/OgreImageCodec.h>
 #include <OGRE/OgreVector3.h>
+#include <OGRE/OgreQuaternion.h>
+#include <OGRE/OgreHardwarePixelBuffer.h>
+#include <OGRE/OgreTechnique.h>
 
 #include "rviz/frame_manager.h"
 #include "rviz/ogre_helpers/grid.h"
@@ -51,6 +54,14 @@
 static constexpr int kMaxBlocks = 8;
 // Max zoom level to support.
 static constexpr int kMaxZoom = 22;
+// Seconds of travel ahead of the vehicle to prefetch tiles for.
+static constexpr double kPrefetchSeconds = 30.0;
+// Speed (m/s) below which nothing is prefetched.
+static constexpr double kPrefetchMinSpeed = 0.5;
+// Priority of prefetched tiles, after every tile of the window shown.
+static constexpr double kPrefetchPriority = 1000.0;
+// Pixels along the side of a tile, and of its slot in the atlas.
+static constexpr int kTileSize = 256;
 
 void odomCallback(const nav_msgs::Odometry &msg);
 
@@ -58,32 +69,13 @@ void odomCallback(const nav_msgs::Odometry &msg);
 // int to long wherever applicable.
 static_assert((1 << kMaxZoom) < std::numeric_limits<unsigned int>::max(), "");
 
-Ogre::TexturePtr textureFromImage(const QImage &image,
-                                  const std::string &name) {
-  //  convert to 24bit rgb
-  QImage converted = image.convertToFormat(QImage::Format_RGB888).mirrored();
-
-  //  create texture
-  Ogre::TexturePtr texture;
-  Ogre::DataStreamPtr data_stream;
-  data_stream.bind(new Ogre::MemoryDataStream((void *)converted.constBits(),
-                                              converted.byteCount()));
-
-  const Ogre::String res_group =
-      Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME;
-  Ogre::TextureManager &texture_manager = Ogre::TextureManager::getSingleton();
-  //  swap byte order when going from QImage to Ogre
-  texture = texture_manager.loadRawData(name, res_group, data_stream,
-                                        converted.width(), converted.height(),
-                                        Ogre::PF_B8G8R8, Ogre::TEX_TYPE_2D, 0);
-  return texture;
-}
-
 namespace rviz {
 
 AerialMapDisplay::AerialMapDisplay()
-    : Display(), map_id_(0), scene_id_(0), dirty_(false),
-      received_msg_(false) {
+    : Display(), map_id_(0), scene_id_(0), tiles_node_(nullptr),
+      tiles_object_(nullptr), atlas_slots_(0), atlas_zoom_(-1),
+      anchor_x_(0), anchor_y_(0), tile_size_(0), dirty_(false),
+      received_msg_(false), tile_cache_(new TileCache()), have_odom_(false) {
 
   static unsigned int map_ids = 0;
   map_id_ = map_ids++; //  global counter of map ids
@@ -177,7 +169,9 @@ AerialMapDisplay::AerialMapDisplay()
 //  Navigator offsetting
 
 void AerialMapDisplay::odomCallback(const nav_msgs::Odometry &msg){
-  odom = &msg;
+  odom_ = msg;
+  have_odom_ = true;
+  prefetch();
 }
 
 AerialMapDisplay::~AerialMapDisplay() {
@@ -187,6 +181,7 @@ AerialMapDisplay::~AerialMapDisplay() {
 
 void AerialMapDisplay::onInitialize() {
   frame_property_->setFrameManager(context_->getFrameManager());
+  tiles_node_ = scene_node_->createChildSceneNode();
 }
 
 void AerialMapDisplay::onEnable() { subscribe(); }
@@ -265,8 +260,11 @@ void AerialMapDisplay::updateObjectURI() {
 void AerialMapDisplay::updateZoom() {
   const int zoom = std::max(0, std::min(kMaxZoom, zoom_property_->getInt()));
   if (zoom != zoom_) {
+    const int step = zoom > zoom_ ? 1 : -1;
     zoom_ = zoom;
     loadImagery();
+    //  likely to keep zooming the same way
+    prefetchZoom(zoom_ + step);
   }
 }
 
@@ -295,23 +293,28 @@ void AerialMapDisplay::clear() {
   received_msg_ = false;
   //  cancel current imagery, if any
   loader_.reset();
+  if (fetcher_) {
+    fetcher_->clearQueue();
+  }
 }
 
 void AerialMapDisplay::clearGeometry() {
-  for (MapObject &obj : objects_) {
-    //  destroy object
-    scene_node_->detachObject(obj.object);
-    scene_manager_->destroyManualObject(obj.object);
-    //  destroy texture
-    if (!obj.texture.isNull()) {
-      Ogre::TextureManager::getSingleton().remove(obj.texture->getName());
-    }
-    //  destroy material
-    if (!obj.material.isNull()) {
-      Ogre::MaterialManager::getSingleton().remove(obj.material->getName());
-    }
+  if (tiles_object_) {
+    tiles_node_->detachObject(tiles_object_);
+    scene_manager_->destroyManualObject(tiles_object_);
+    tiles_object_ = nullptr;
+  }
+  if (!atlas_material_.isNull()) {
+    Ogre::MaterialManager::getSingleton().remove(atlas_material_->getName());
+    atlas_material_.setNull();
   }
-  objects_.clear();
+  if (!atlas_texture_.isNull()) {
+    Ogre::TextureManager::getSingleton().remove(atlas_texture_->getName());
+    atlas_texture_.setNull();
+  }
+  slots_.clear();
+  atlas_slots_ = 0;
+  atlas_zoom_ = -1;
 }
 
 void AerialMapDisplay::update(float, float) {
@@ -356,9 +359,24 @@ void AerialMapDisplay::loadImagery() {
               "Received message but object URI is not set");
   }
 
+  //  room for the window shown, the one before it, so moving back over a
+  //  tile boundary does not reload anything, and those prefetched
+  const size_t window = (2 * blocks_ + 1) * (2 * blocks_ + 1);
+  tile_cache_->setCapacity(3 * window);
+
   try {
+    if (!fetcher_) {
+      fetcher_.reset(new TileFetcher(tile_cache_));
+      QObject::connect(fetcher_.get(), SIGNAL(initiatedRequest(QNetworkRequest)), this,
+                       SLOT(initiatedRequest(QNetworkRequest)));
+      QObject::connect(fetcher_.get(), SIGNAL(receivedImage(QNetworkRequest)), this,
+                       SLOT(receivedImage(QNetworkRequest)));
+    }
+    //  what was queued for the last window may no longer be needed
+    fetcher_->clearQueue();
     loader_.reset(new TileLoader(object_uri_, ref_fix_.latitude,
-                                 ref_fix_.longitude, zoom_, blocks_, this));
+                                 ref_fix_.longitude, zoom_, blocks_,
+                                 fetcher_.get(), this));
   } catch (std::exception &e) {
     setStatus(StatusProperty::Error, "Message", QString(e.what()));
     return;
@@ -368,12 +386,74 @@ void AerialMapDisplay::loadImagery() {
                    SLOT(errorOcurred(QString)));
   QObject::connect(loader_.get(), SIGNAL(finishedLoading()), this,
                    SLOT(finishedLoading()));
-  QObject::connect(loader_.get(), SIGNAL(initiatedRequest(QNetworkRequest)), this,
-                   SLOT(initiatedRequest(QNetworkRequest)));
-  QObject::connect(loader_.get(), SIGNAL(receivedImage(QNetworkRequest)), this,
-                   SLOT(receivedImage(QNetworkRequest)));
+  QObject::connect(loader_.get(), SIGNAL(loadedTile()), this,
+                   SLOT(loadedTile()));
   //  start loading images
   loader_->start();
+  //  move the tiles, and show those already cached, right away
+  dirty_ = true;
+  last_prefetch_ = ros::WallTime();
+  prefetch();
+}
+
+void AerialMapDisplay::prefetch() {
+  if (!loader_ || !fetcher_ || !have_odom_) {
+    return;
+  }
+  const ros::WallTime now = ros::WallTime::now();
+  if (now - last_prefetch_ < ros::WallDuration(1.0)) {
+    return;
+  }
+  last_prefetch_ = now;
+
+  //  velocity in the odom frame, taken to be ENU
+  const geometry_msgs::Quaternion &q = odom_.pose.pose.orientation;
+  const geometry_msgs::Vector3 &v = odom_.twist.twist.linear;
+  const Ogre::Vector3 velocity =
+      Ogre::Quaternion(q.w, q.x, q.y, q.z) * Ogre::Vector3(v.x, v.y, v.z);
+  const double speed = std::hypot(velocity.x, velocity.y);
+  if (speed < kPrefetchMinSpeed) {
+    return;
+  }
+
+  //  tiles are 256 pixels square, and tile y increases to the south
+  const double tile_size = 256 * loader_->resolution();
+  const double dx = velocity.x / speed;
+  const double dy = -velocity.y / speed;
+  const int steps = std::min<int>(
+      std::ceil(speed * kPrefetchSeconds / tile_size), 2 * blocks_ + 1);
+  const int max_tile = TileLoader::maxTiles(zoom_);
+  for (int step = 1; step <= steps; step++) {
+    //  window the display loads once the vehicle is this many tiles along
+    const int cx = loader_->centerTileX() + std::lround(step * dx);
+    const int cy = loader_->centerTileY() + std::lround(step * dy);
+    for (int y = std::max(0, cy - blocks_); y <= std::min(max_tile, cy + blocks_); y++) {
+      for (int x = std::max(0, cx - blocks_); x <= std::min(max_tile, cx + blocks_); x++) {
+        if (!loader_->insideWindow(x, y)) {
+          fetcher_->fetch(object_uri_, x, y, zoom_,
+                          kPrefetchPriority + 100 * step + std::hypot(x - cx, y - cy));
+        }
+      }
+    }
+  }
+}
+
+void AerialMapDisplay::prefetchZoom(int zoom) {
+  if (!loader_ || !fetcher_ || zoom < 0 || zoom > kMaxZoom) {
+    return;
+  }
+  double x, y;
+  TileLoader::latLonToTileCoords(ref_fix_.latitude, ref_fix_.longitude, zoom, x, y);
+  const int cx = std::floor(x);
+  const int cy = std::floor(y);
+  const int max_tile = TileLoader::maxTiles(zoom);
+  for (int ty = std::max(0, cy - blocks_); ty <= std::min(max_tile, cy + blocks_); ty++) {
+    for (int tx = std::max(0, cx - blocks_); tx <= std::min(max_tile, cx + blocks_); tx++) {
+      //  after the tiles ahead of the vehicle
+      fetcher_->fetch(object_uri_, tx, ty, zoom,
+                      2 * kPrefetchPriority + std::hypot(tx - cx, ty - cy));
+    }
+  }
 }
 
 void AerialMapDisplay::assembleScene() {
@@ -386,130 +466,184 @@ void AerialMapDisplay::assembleScene() {
     return; //  no tiles loaded, don't do anything
   }
 
-  //  get rid of old geometry, we will re-build this
-  clearGeometry();
+  //  a new window size or zoom needs a new atlas, anything else keeps it
+  const int slots = 2 * blocks_ + 1;
+  if (atlas_texture_.isNull() || slots != atlas_slots_ ||
+      static_cast<int>(zoom_) != atlas_zoom_) {
+    createAtlas(slots);
+  }
 
-  //  iterate over all tiles and create an object for each of them
+  //  upload only the tiles not already in their slot
+  bool added = false;
   for (const TileLoader::MapTile &tile : loader_->tiles()) {
-    // NOTE(gareth): We invert the y-axis so that positive y corresponds
-    // to north. We are in XYZ->ENU convention here.
-    const int w = tile.image().width();
-    const int h = tile.image().height();
-    const double tile_w = w * loader_->resolution();
-    const double tile_h = h * loader_->resolution();
-
-    // Shift back such that (0, 0) corresponds to the exact latitude and
-    // longitude the tile loader requested.
-    // This is the local origin, in the frame of the map node.
-    const double origin_x = -loader_->originOffsetX() * tile_w /*+ odom_x*/;
-    const double origin_y = -(1 - loader_->originOffsetY()) * tile_h /*+ odom_y*/;
-
-    // determine location of this tile, flipping y in the process
-    const double x = (tile.x() - loader_->centerTileX()) * tile_w + origin_x;
-    const double y = -(tile.y() - loader_->centerTileY()) * tile_h + origin_y;
-    //  don't re-use any ids
-    const std::string name_suffix =
-        std::to_string(tile.x()) + "_" + std::to_string(tile.y()) + "_" +
-        std::to_string(map_id_) + "_" + std::to_string(scene_id_);
-
-    if (tile.hasImage()) {
-      //  one material per texture
-      Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create(
-          "material_" + name_suffix,
-          Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
-      material->setReceiveShadows(false);
-      material->getTechnique(0)->setLightingEnabled(false);
-      material->setDepthBias(-16.0f, 0.0f);
-      material->setCullingMode(Ogre::CULL_NONE);
-      material->setDepthWriteEnabled(false);
-
-      //  create textureing unit
-      Ogre::Pass *pass = material->getTechnique(0)->getPass(0);
-      Ogre::TextureUnitState *tex_unit = nullptr;
-      if (pass->getNumTextureUnitStates() > 0) {
-        tex_unit = pass->getTextureUnitState(0);
-      } else {
-        tex_unit = pass->createTextureUnitState();
-      }
-
-      //  only add if we have a texture for it
-      Ogre::TexturePtr texture =
-          textureFromImage(tile.image(), "texture_" + name_suffix);
-
-      tex_unit->setTextureName(texture->getName());
-      tex_unit->setTextureFiltering(Ogre::TFO_BILINEAR);
-
-      //  create an object
-      const std::string obj_name = "object_" + name_suffix;
-      Ogre::ManualObject *obj = scene_manager_->createManualObject(obj_name);
-      scene_node_->attachObject(obj);
-
-      //  configure depth & alpha properties
-      if (alpha_ >= 0.9998) {
-        material->setDepthWriteEnabled(!draw_under_);
-        material->setSceneBlending(Ogre::SBT_REPLACE);
-      } else {
-        material->setSceneBlending(Ogre::SBT_TRANSPARENT_ALPHA);
-        material->setDepthWriteEnabled(false);
-      }
-
-      if (draw_under_) {
-        obj->setRenderQueueGroup(Ogre::RENDER_QUEUE_3);
-      } else {
-        obj->setRenderQueueGroup(Ogre::RENDER_QUEUE_MAIN);
-      }
-
-      tex_unit->setAlphaOperation(Ogre::LBX_SOURCE1, Ogre::LBS_MANUAL,
-                                  Ogre::LBS_CURRENT, alpha_);
-
-      //  create a quad for this tile
-      obj->begin(material->getName(), Ogre::RenderOperation::OT_TRIANGLE_LIST);
+    if (!tile.hasImage()) {
+      continue;
+    }
+    const int sx = tile.x() % atlas_slots_;
+    const int sy = tile.y() % atlas_slots_;
+    AtlasSlot &slot = slots_[sy * atlas_slots_ + sx];
+    if (slot.valid && slot.x == tile.x() && slot.y == tile.y()) {
+      continue;
+    }
+    uploadTile(tile.image(), sx, sy);
+    slot.x = tile.x();
+    slot.y = tile.y();
+    slot.valid = true;
+    added = true;
+  }
+  if (added) {
+    buildGeometry();
+  }
 
-      //  bottom left
-      obj->position(x, y, 0.0f);
-      obj->textureCoord(0.0f, 0.0f);
-      obj->normal(0.0f, 0.0f, 1.0f);
+  //  re-centring only moves the tiles, as they are placed relative to the
+  //  anchor rather than to the centre tile
+  const double loader_x = loader_->centerTileX() + loader_->originOffsetX();
+  const double loader_y = loader_->centerTileY() + loader_->originOffsetY();
+  tiles_node_->setPosition((anchor_x_ - loader_x) * tile_size_,
+                           (loader_y - anchor_y_) * tile_size_, 0);
 
-      // top right
-      obj->position(x + tile_w, y + tile_h, 0.0f);
-      obj->textureCoord(1.0f, 1.0f);
-      obj->normal(0.0f, 0.0f, 1.0f);
+  updateMaterial();
+}
 
-      // top left
-      obj->position(x, y + tile_h, 0.0f);
-      obj->textureCoord(0.0f, 1.0f);
-      obj->normal(0.0f, 0.0f, 1.0f);
+void AerialMapDisplay::createAtlas(int slots) {
+  clearGeometry();
 
-      //  bottom left
-      obj->position(x, y, 0.0f);
-      obj->textureCoord(0.0f, 0.0f);
-      obj->normal(0.0f, 0.0f, 1.0f);
+  // NOTE(gareth): We invert the y-axis so that positive y corresponds
+  // to north. We are in XYZ->ENU convention here.
+  atlas_slots_ = slots;
+  atlas_zoom_ = zoom_;
+  anchor_x_ = loader_->centerTileX() + loader_->originOffsetX();
+  anchor_y_ = loader_->centerTileY() + loader_->originOffsetY();
+  tile_size_ = kTileSize * loader_->resolution();
+  slots_.assign(slots * slots, AtlasSlot());
+
+  //  don't re-use any names
+  const std::string name_suffix =
+      std::to_string(map_id_) + "_" + std::to_string(scene_id_++);
+
+  atlas_texture_ = Ogre::TextureManager::getSingleton().createManual(
+      "texture_" + name_suffix,
+      Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+      Ogre::TEX_TYPE_2D, slots * kTileSize, slots * kTileSize, 0,
+      Ogre::PF_A8R8G8B8, Ogre::TU_DEFAULT);
+
+  //  one material for every tile
+  atlas_material_ = Ogre::MaterialManager::getSingleton().create(
+      "material_" + name_suffix,
+      Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+  atlas_material_->setReceiveShadows(false);
+  atlas_material_->getTechnique(0)->setLightingEnabled(false);
+  atlas_material_->setDepthBias(-16.0f, 0.0f);
+  atlas_material_->setCullingMode(Ogre::CULL_NONE);
+  Ogre::Pass *pass = atlas_material_->getTechnique(0)->getPass(0);
+  Ogre::TextureUnitState *tex_unit = pass->getNumTextureUnitStates() > 0
+                                         ? pass->getTextureUnitState(0)
+                                         : pass->createTextureUnitState();
+  tex_unit->setTextureName(atlas_texture_->getName());
+  tex_unit->setTextureFiltering(Ogre::TFO_BILINEAR);
+  tex_unit->setTextureAddressingMode(Ogre::TextureUnitState::TAM_CLAMP);
+
+  tiles_object_ = scene_manager_->createManualObject("object_" + name_suffix);
+  tiles_object_->setDynamic(true);
+  tiles_node_->attachObject(tiles_object_);
+}
 
-      // bottom right
-      obj->position(x + tile_w, y, 0.0f);
-      obj->textureCoord(1.0f, 0.0f);
-      obj->normal(0.0f, 0.0f, 1.0f);
+void AerialMapDisplay::uploadTile(const QImage &image, int sx, int sy) {
+  //  decoded JPEGs are already 32 bit BGRA in memory, as Ogre's A8R8G8B8
+  //  is on little endian machines, so only other tiles need converting
+  QImage converted;
+  const QImage *source = &image;
+  if ((image.format() != QImage::Format_RGB32 &&
+       image.format() != QImage::Format_ARGB32) ||
+      image.width() != kTileSize || image.height() != kTileSize) {
+    converted = image.convertToFormat(QImage::Format_RGB32)
+                    .scaled(kTileSize, kTileSize);
+    source = &converted;
+  }
 
-      // top right
-      obj->position(x + tile_w, y + tile_h, 0.0f);
-      obj->textureCoord(1.0f, 1.0f);
-      obj->normal(0.0f, 0.0f, 1.0f);
+  Ogre::PixelBox box(kTileSize, kTileSize, 1, Ogre::PF_A8R8G8B8,
+                     const_cast<uchar *>(source->constBits()));
+  box.rowPitch = source->bytesPerLine() / 4;
+  atlas_texture_->getBuffer()->blitFromMemory(
+      box, Ogre::Image::Box(sx * kTileSize, sy * kTileSize,
+                            (sx + 1) * kTileSize, (sy + 1) * kTileSize));
+}
 
-      obj->end();
+void AerialMapDisplay::buildGeometry() {
+  if (tiles_object_->getNumSections() == 0) {
+    tiles_object_->begin(atlas_material_->getName(),
+                         Ogre::RenderOperation::OT_TRIANGLE_LIST);
+  } else {
+    tiles_object_->beginUpdate(0);
+  }
 
-      if (draw_under_property_->getValue().toBool()) {
-        //  render under everything else
-        obj->setRenderQueueGroup(Ogre::RENDER_QUEUE_3);
+  //  half a texel in, so filtering never samples the neighbouring slot
+  const float texel = 0.5f / (atlas_slots_ * kTileSize);
+  for (int sy = 0; sy < atlas_slots_; sy++) {
+    for (int sx = 0; sx < atlas_slots_; sx++) {
+      const AtlasSlot &slot = slots_[sy * atlas_slots_ + sx];
+      if (!slot.valid) {
+        continue;
       }
-
-      MapObject object;
-      object.object = obj;
-      object.texture = texture;
-      object.material = material;
-      objects_.push_back(object);
+      //  bottom left corner, relative to the anchor, flipping y
+      const float x = (slot.x - anchor_x_) * tile_size_;
+      const float y = -(slot.y + 1 - anchor_y_) * tile_size_;
+      const float w = tile_size_;
+      //  the image's first row is the top of the tile, and of its slot
+      const float u0 = static_cast<float>(sx) / atlas_slots_ + texel;
+      const float u1 = static_cast<float>(sx + 1) / atlas_slots_ - texel;
+      const float v_top = static_cast<float>(sy) / atlas_slots_ + texel;
+      const float v_bottom = static_cast<float>(sy + 1) / atlas_slots_ - texel;
+
+      //  bottom left, top right, top left
+      tiles_object_->position(x, y, 0.0f);
+      tiles_object_->textureCoord(u0, v_bottom);
+      tiles_object_->normal(0.0f, 0.0f, 1.0f);
+      tiles_object_->position(x + w, y + w, 0.0f);
+      tiles_object_->textureCoord(u1, v_top);
+      tiles_object_->normal(0.0f, 0.0f, 1.0f);
+      tiles_object_->position(x, y + w, 0.0f);
+      tiles_object_->textureCoord(u0, v_top);
+      tiles_object_->normal(0.0f, 0.0f, 1.0f);
+
+      //  bottom left, bottom right, top right
+      tiles_object_->position(x, y, 0.0f);
+      tiles_object_->textureCoord(u0, v_bottom);
+      tiles_object_->normal(0.0f, 0.0f, 1.0f);
+      tiles_object_->position(x + w, y, 0.0f);
+      tiles_object_->textureCoord(u1, v_bottom);
+      tiles_object_->normal(0.0f, 0.0f, 1.0f);
+      tiles_object_->position(x + w, y + w, 0.0f);
+      tiles_object_->textureCoord(u1, v_top);
+      tiles_object_->normal(0.0f, 0.0f, 1.0f);
     }
   }
-  scene_id_++;
+  tiles_object_->end();
+}
+
+void AerialMapDisplay::updateMaterial() {
+  if (atlas_material_.isNull()) {
+    return;
+  }
+  //  configure depth & alpha properties
+  if (alpha_ >= 0.9998) {
+    atlas_material_->setDepthWriteEnabled(!draw_under_);
+    atlas_material_->setSceneBlending(Ogre::SBT_REPLACE);
+  } else {
+    atlas_material_->setSceneBlending(Ogre::SBT_TRANSPARENT_ALPHA);
+    atlas_material_->setDepthWriteEnabled(false);
+  }
+  Ogre::TextureUnitState *tex_unit =
+      atlas_material_->getTechnique(0)->getPass(0)->getTextureUnitState(0);
+  tex_unit->setAlphaOperation(Ogre::LBX_SOURCE1, Ogre::LBS_MANUAL,
+                              Ogre::LBS_CURRENT, alpha_);
+
+  if (draw_under_) {
+    //  render under everything else
+    tiles_object_->setRenderQueueGroup(Ogre::RENDER_QUEUE_3);
+  } else {
+    tiles_object_->setRenderQueueGroup(Ogre::RENDER_QUEUE_MAIN);
+  }
 }
 
 void AerialMapDisplay::initiatedRequest(QNetworkRequest request) {
@@ -520,6 +654,11 @@ void AerialMapDisplay::receivedImage(QNetworkRequest request) {
   ROS_DEBUG("Loaded tile %s", qPrintable(request.url().toString()));
 }
 
+void AerialMapDisplay::loadedTile() {
+  //  shown as each arrives, rather than once the window is complete
+  dirty_ = true;
+}
+
 void AerialMapDisplay::finishedLoading() {
   ROS_INFO("Finished loading all tiles.");
   dirty_ = true;
@@ -541,7 +680,7 @@ void AerialMapDisplay::transformAerialMap() {
   // pass in identity to get pose of robot wrt to the fixed frame
   // the map will be shifted so as to compensate for the center tile shifting
   geometry_msgs::Pose pose;
-  if (odom != nullptr) pose = odom->pose.pose;
+  if (have_odom_) pose = odom_.pose.pose;
 
   const std::string frame = frame_property_->getFrameStd();
   Ogre::Vector3 position{0, 0, 0};
@@ -41,6 +41,7 @@
 
 namespace Ogre {
 class ManualObject;
+class SceneNode;
 }
 
 namespace rviz {
@@ -83,6 +84,7 @@ protected Q_SLOTS:
   //  slots for TileLoader messages
   void initiatedRequest(QNetworkRequest request);
   void receivedImage(QNetworkRequest request);
+  void loadedTile();
   void finishedLoading();
   void errorOcurred(QString description);
 
@@ -102,22 +104,57 @@ protected:
 
   void assembleScene();
 
+  /// Create an atlas with slots x slots tiles, anchored at the loader's centre.
+  void createAtlas(int slots);
+
+  /// Upload a tile image into slot [sx,sy] of the atlas.
+  void uploadTile(const QImage &image, int sx, int sy);
+
+  /// Rebuild the quads of the tiles in the atlas.
+  void buildGeometry();
+
+  /// Apply alpha and draw under to the atlas material.
+  void updateMaterial();
+
   void clear();
 
   void clearGeometry();
 
   void transformAerialMap();
 
+  /// Fetch the tiles of the windows the vehicle is heading into.
+  void prefetch();
+
+  /// Fetch the window at another zoom level.
+  void prefetchZoom(int zoom);
+
   unsigned int map_id_;
   unsigned int scene_id_;
 
-  /// Instance of a tile w/ associated ogre data
-  struct MapObject {
-    Ogre::ManualObject *object;
-    Ogre::TexturePtr texture;
-    Ogre::MaterialPtr material;
+  /// The window of tiles is drawn as one object with one texture, an atlas
+  /// with a slot for each tile of the window. Tile [x,y] goes in slot
+  /// [x mod slots, y mod slots], so the tiles still in the window when it is
+  /// re-centred keep their slots and only the new ones are uploaded. Tiles are
+  /// placed relative to an anchor, so re-centring moves tiles_node_ instead of
+  /// rebuilding the geometry. A slot shows its last tile until a new one
+  /// replaces it, so the map is never blank while tiles load.
+  struct AtlasSlot {
+    int x = 0;
+    int y = 0;
+    bool valid = false;
   };
-  std::vector<MapObject> objects_;
+  Ogre::SceneNode *tiles_node_;
+  Ogre::ManualObject *tiles_object_;
+  Ogre::TexturePtr atlas_texture_;
+  Ogre::MaterialPtr atlas_material_;
+  std::vector<AtlasSlot> slots_;
+  int atlas_slots_;
+  int atlas_zoom_;
+  //  fractional tile coordinates the geometry is placed relative to
+  double anchor_x_;
+  double anchor_y_;
+  //  meters along the side of a tile
+  double tile_size_;
 
   ros::Subscriber coord_sub_;
   ros::Subscriber odom_sub_;
@@ -146,8 +183,13 @@ protected:
   bool received_msg_;
   sensor_msgs::NavSatFix ref_fix_;
   std::shared_ptr<TileLoader> loader_;
+  /// Decoded tiles, kept across reloads
+  std::shared_ptr<TileCache> tile_cache_;
+  std::shared_ptr<TileFetcher> fetcher_;
+  ros::WallTime last_prefetch_;
 
-  const nav_msgs::Odometry* odom;
+  nav_msgs::Odometry odom_;
+  bool have_odom_;
 };
 
 } // namespace rviz
@@ -0,0 +1,154 @@
+/*
+ * build_tile_pack.cpp
+ *
+ *  This file is part of rviz_satellite.
+ *
+ *  Builds the tile pack of a service for a region, so the display can be used
+ *  offline and serves its tiles without touching the file system:
+ *
+ *    rosrun rviz_satellite build_tile_pack <service> <min_lat> <min_lon>
+ *        <max_lat> <max_lon> <min_zoom> <max_zoom> [output]
+ *
+ *  Tiles are taken from the disk cache where they are, and fetched from the
+ *  server (and so added to the disk cache) where they are not. The pack is
+ *  written where the display looks for it unless output is given.
+ */
+
+#include "tile_pack.h"
+#include "tileloader.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QFile>
+#include <QEventLoop>
+#include <QImage>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Tile {
+  int x;
+  int y;
+  int z;
+  QString path;
+};
+
+/// Tiles fetched from the server at a time, so all of a batch stay in memory.
+const size_t kBatch = 256;
+
+void usage() {
+  std::cerr << "usage: build_tile_pack <service> <min_lat> <min_lon> <max_lat> "
+               "<max_lon> <min_zoom> <max_zoom> [output]"
+            << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  QCoreApplication app(argc, argv);
+  if (argc != 8 && argc != 9) {
+    usage();
+    return 1;
+  }
+
+  const std::string service = argv[1];
+  double min_lat, min_lon, max_lat, max_lon;
+  unsigned int min_zoom, max_zoom;
+  try {
+    min_lat = std::stod(argv[2]);
+    min_lon = std::stod(argv[3]);
+    max_lat = std::stod(argv[4]);
+    max_lon = std::stod(argv[5]);
+    min_zoom = std::stoul(argv[6]);
+    max_zoom = std::stoul(argv[7]);
+  } catch (const std::exception &) {
+    usage();
+    return 1;
+  }
+
+  std::shared_ptr<TileCache> cache = std::make_shared<TileCache>(kBatch);
+  std::unique_ptr<TileFetcher> fetcher;
+  std::vector<Tile> missing;
+  TilePackWriter writer;
+  try {
+    fetcher.reset(new TileFetcher(cache));
+    for (unsigned int z = min_zoom; z <= max_zoom; z++) {
+      //  y grows southwards
+      double x0, y0, x1, y1;
+      TileLoader::latLonToTileCoords(max_lat, min_lon, z, x0, y0);
+      TileLoader::latLonToTileCoords(min_lat, max_lon, z, x1, y1);
+      const int max_tile = TileLoader::maxTiles(z);
+      for (int y = std::max(0, int(std::floor(y0)));
+           y <= std::min(max_tile, int(std::floor(y1))); y++) {
+        for (int x = std::max(0, int(std::floor(x0)));
+             x <= std::min(max_tile, int(std::floor(x1))); x++) {
+          const QString path = fetcher->cachedPathForTile(service, x, y, z);
+          QFile file(path);
+          if (file.open(QIODevice::ReadOnly)) {
+            writer.add(x, y, z, file.readAll());
+          } else {
+            missing.push_back(Tile{x, y, z, path});
+          }
+        }
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  std::cout << writer.size() << " tiles cached, fetching " << missing.size()
+            << std::endl;
+
+  size_t failed = 0;
+  for (size_t begin = 0; begin < missing.size(); begin += kBatch) {
+    const size_t end = std::min(missing.size(), begin + kBatch);
+    for (size_t i = begin; i < end; i++) {
+      const Tile &tile = missing[i];
+      fetcher->fetch(service, tile.x, tile.y, tile.z, i);
+    }
+    auto pending = [&]() {
+      for (size_t i = begin; i < end; i++) {
+        if (fetcher->isPending(missing[i].path)) {
+          return true;
+        }
+      }
+      return false;
+    };
+    while (pending()) {
+      app.processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    //  encoded as the disk cache does, rather than waiting for its writes
+    for (size_t i = begin; i < end; i++) {
+      const Tile &tile = missing[i];
+      const QImage image = cache->find(tile.path);
+      if (image.isNull()) {
+        std::cerr << "failed to fetch " << tile.path.toStdString() << std::endl;
+        failed++;
+        continue;
+      }
+      QByteArray data;
+      QBuffer buffer(&data);
+      buffer.open(QIODevice::WriteOnly);
+      image.save(&buffer, "JPEG");
+      writer.add(tile.x, tile.y, tile.z, data);
+    }
+    std::cout << end << "/" << missing.size() << " fetched" << std::endl;
+  }
+
+  const QString output = argc == 9 ? QString(argv[8])
+                                   : fetcher->packPathForService(service);
+  if (!writer.write(output)) {
+    std::cerr << "failed to write " << output.toStdString() << std::endl;
+    return 1;
+  }
+  std::cout << "wrote " << writer.size() << " tiles to "
+            << output.toStdString() << std::endl;
+  return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,96 @@
+/*
+ * TilePack.cpp
+ *
+ *  This file is part of rviz_satellite.
+ */
+
+#include "tile_pack.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const char kMagic[4] = {'R', 'S', 'T', 'P'};
+static const uint32_t kVersion = 1;
+
+static_assert(sizeof(TilePack::Header) == 16, "tile pack header must be 16 bytes");
+static_assert(sizeof(TilePack::Entry) == 24, "tile pack entries must be 24 bytes");
+
+bool TilePack::open(const QString &path) {
+  file_.setFileName(path);
+  if (!file_.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  file_size_ = file_.size();
+  if (file_size_ < static_cast<qint64>(sizeof(Header))) {
+    file_.close();
+    return false;
+  }
+  data_ = file_.map(0, file_size_);
+  if (!data_) {
+    file_.close();
+    return false;
+  }
+
+  const Header *header = reinterpret_cast<const Header *>(data_);
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion ||
+      sizeof(Header) + header->count * sizeof(Entry) >
+          static_cast<uint64_t>(file_size_)) {
+    file_.unmap(const_cast<uchar *>(data_));
+    file_.close();
+    data_ = nullptr;
+    return false;
+  }
+  count_ = header->count;
+  index_ = reinterpret_cast<const Entry *>(data_ + sizeof(Header));
+  return true;
+}
+
+QByteArray TilePack::find(int x, int y, int z) const {
+  if (!index_) {
+    return QByteArray();
+  }
+  const uint64_t k = key(x, y, z);
+  const Entry *end = index_ + count_;
+  const Entry *it = std::lower_bound(
+      index_, end, k, [](const Entry &e, uint64_t k) { return e.key < k; });
+  if (it == end || it->key != k ||
+      it->offset + it->size > static_cast<uint64_t>(file_size_)) {
+    return QByteArray();
+  }
+  return QByteArray::fromRawData(
+      reinterpret_cast<const char *>(data_ + it->offset), it->size);
+}
+
+void TilePackWriter::add(int x, int y, int z, const QByteArray &data) {
+  tiles_[TilePack::key(x, y, z)] = data;
+}
+
+bool TilePackWriter::write(const QString &path) const {
+  QFile file(path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    return false;
+  }
+
+  TilePack::Header header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.count = tiles_.size();
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  //  the index, in key order as the map is, then the images in the same order
+  uint64_t offset = sizeof(header) + tiles_.size() * sizeof(TilePack::Entry);
+  for (const auto &tile : tiles_) {
+    TilePack::Entry entry;
+    entry.key = tile.first;
+    entry.offset = offset;
+    entry.size = tile.second.size();
+    entry.reserved = 0;
+    file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    offset += entry.size;
+  }
+  for (const auto &tile : tiles_) {
+    file.write(tile.second);
+  }
+  return file.error() == QFile::NoError;
+}
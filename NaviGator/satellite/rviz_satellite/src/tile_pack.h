@@ -0,0 +1,78 @@
+/*
+ * TilePack.h
+ *
+ *  This file is part of rviz_satellite.
+ */
+
+#ifndef TILE_PACK_H
+#define TILE_PACK_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <cstdint>
+#include <map>
+
+/// A whole region of tiles in one file, memory mapped, so serving a tile is a
+/// binary search and no file system calls.
+///
+/// Layout: a 16 byte header of the magic "RSTP", a version and the number of
+/// tiles, then an index entry per tile sorted by key (zoom, x, y), each the key,
+/// offset and size of the tile's encoded image, then the images.
+class TilePack {
+public:
+  TilePack() = default;
+  TilePack(const TilePack &) = delete;
+  TilePack &operator=(const TilePack &) = delete;
+
+  bool open(const QString &path);
+
+  bool isOpen() const { return index_ != nullptr; }
+
+  size_t size() const { return count_; }
+
+  /// Encoded image of tile [x,y,z], pointing into the mapping (so valid as
+  /// long as the pack), or an empty array if it is not in the pack.
+  /// Safe to call from any thread.
+  QByteArray find(int x, int y, int z) const;
+
+  static uint64_t key(int x, int y, int z) {
+    return (static_cast<uint64_t>(z) << 48) | (static_cast<uint64_t>(x) << 24) |
+           static_cast<uint64_t>(y);
+  }
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+  };
+
+  struct Entry {
+    uint64_t key;
+    uint64_t offset;
+    uint32_t size;
+    uint32_t reserved;
+  };
+
+private:
+  QFile file_;
+  const uchar *data_ = nullptr;
+  qint64 file_size_ = 0;
+  const Entry *index_ = nullptr;
+  uint64_t count_ = 0;
+};
+
+/// Collects tiles and writes them out as a TilePack.
+class TilePackWriter {
+public:
+  void add(int x, int y, int z, const QByteArray &data);
+
+  size_t size() const { return tiles_.size(); }
+
+  bool write(const QString &path) const;
+
+private:
+  std::map<uint64_t, QByteArray> tiles_;
+};
+
+#endif // TILE_PACK_H
@@ -9,6 +9,7 @@
  */
 
 #include "tileloader.h"
+#include "tile_pack.h"
 
 #include <QUrl>
 #include <QNetworkRequest>
@@ -18,6 +19,10 @@
 #include <QFile>
 #include <QImage>
 #include <QImageReader>
+#include <QtConcurrentRun>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <stdexcept>
 #include <boost/regex.hpp>
 #include <ros/ros.h>
@@ -38,6 +43,256 @@ static size_t replaceRegex(const boost::regex &ex, std::string &str,
   return count;
 }
 
+/// Run on the thread pool, so the GUI thread never waits on the disk or on decoding.
+static QImage readCachedTile(const QString &path) {
+  QImage image;
+  if (QFile::exists(path)) {
+    image.load(path);
+  }
+  return image;
+}
+
+/// Tries the pack first, which is only a lookup in memory mapped by the pack.
+static QImage loadTile(std::shared_ptr<TilePack> pack, int x, int y, int z,
+                       const QString &path) {
+  if (pack) {
+    const QByteArray data = pack->find(x, y, z);
+    QImage image;
+    if (!data.isEmpty() && image.loadFromData(data)) {
+      return image;
+    }
+  }
+  return readCachedTile(path);
+}
+
+static void writeCachedTile(const QImage &image, const QString &path) {
+  image.save(path, "JPEG");
+}
+
+QImage TileCache::find(const QString &key) {
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    return QImage();
+  }
+  //  move to the front, as most recently used
+  lru_.splice(lru_.begin(), lru_, it.value());
+  return lru_.front().second;
+}
+
+void TileCache::insert(const QString &key, const QImage &image) {
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    lru_.erase(it.value());
+  }
+  lru_.emplace_front(key, image);
+  index_[key] = lru_.begin();
+  evict();
+}
+
+void TileCache::setCapacity(size_t capacity) {
+  capacity_ = capacity;
+  evict();
+}
+
+void TileCache::evict() {
+  while (lru_.size() > capacity_) {
+    index_.remove(lru_.back().first);
+    lru_.pop_back();
+  }
+}
+
+TileFetcher::TileFetcher(std::shared_ptr<TileCache> cache, int max_requests,
+                         QObject *parent)
+    : QObject(parent), cache_(cache), max_requests_(std::max(max_requests, 1)),
+      qnam_(new QNetworkAccessManager(this)) {
+  const std::string package_path = ros::package::getPath("rviz_satellite");
+  if (package_path.empty()) {
+    throw std::runtime_error("package 'rviz_satellite' not found");
+  }
+  package_path_ = QString::fromStdString(package_path);
+
+  QObject::connect(qnam_, SIGNAL(finished(QNetworkReply *)), this,
+                   SLOT(finishedRequest(QNetworkReply *)));
+  qnam_->proxyFactory()->setUseSystemConfiguration ( true );
+}
+
+QString TileFetcher::cacheDirForService(const std::string &service) {
+  const QString service_key = QString::fromStdString(service);
+  auto it = cache_dirs_.find(service_key);
+  if (it == cache_dirs_.end()) {
+    std::hash<std::string> hash_fn;
+    const QString cache_path =
+        QDir::cleanPath(package_path_ + QDir::separator() +
+                        QString("mapscache") + QDir::separator() +
+                        QString::number(hash_fn(service)));
+    QDir dir(cache_path);
+    if (!dir.exists() && !dir.mkpath(".")) {
+      throw std::runtime_error("Failed to create cache folder: " +
+                               cache_path.toStdString());
+    }
+    it = cache_dirs_.insert(service_key, cache_path);
+  }
+  return it.value();
+}
+
+QString TileFetcher::cachedPathForTile(const std::string &service, int x,
+                                       int y, int z) {
+  const QString name = "x" + QString::number(x) + "_y" + QString::number(y) +
+                       "_z" + QString::number(z) + ".jpg";
+  return QDir::cleanPath(cacheDirForService(service) + QDir::separator() + name);
+}
+
+QString TileFetcher::packPathForService(const std::string &service) {
+  return cacheDirForService(service) + ".pack";
+}
+
+std::shared_ptr<TilePack>
+TileFetcher::packForService(const std::string &service) {
+  const QString service_key = QString::fromStdString(service);
+  auto it = packs_.find(service_key);
+  if (it == packs_.end()) {
+    //  remembered even when there is none, so it is only looked for once
+    std::shared_ptr<TilePack> pack = std::make_shared<TilePack>();
+    const QString path = packPathForService(service);
+    if (QFile::exists(path)) {
+      if (pack->open(path)) {
+        ROS_INFO("Serving %zu tiles from %s", pack->size(),
+                 path.toStdString().c_str());
+      } else {
+        ROS_WARN("Ignoring invalid tile pack %s", path.toStdString().c_str());
+      }
+    }
+    if (!pack->isOpen()) {
+      pack.reset();
+    }
+    it = packs_.insert(service_key, pack);
+  }
+  return it.value();
+}
+
+QUrl TileFetcher::uriForTile(const std::string &service, int x, int y, int z) {
+  std::string object = service;
+  //  place {x},{y},{z} with appropriate values
+  replaceRegex(boost::regex("\\{x\\}", boost::regex::icase), object,
+               std::to_string(x));
+  replaceRegex(boost::regex("\\{y\\}", boost::regex::icase), object,
+               std::to_string(y));
+  replaceRegex(boost::regex("\\{z\\}", boost::regex::icase), object,
+               std::to_string(z));
+
+  const QString qstr = QString::fromStdString(object);
+  return QUrl(qstr);
+}
+
+void TileFetcher::fetch(const std::string &service, int x, int y, int z,
+                        double priority) {
+  const QString path = cachedPathForTile(service, x, y, z);
+  if (cache_->contains(path)) {
+    return;
+  }
+
+  auto it = pending_.find(path);
+  if (it != pending_.end()) {
+    //  waiting for the server, so move it up the queue if more urgent now
+    Request &request = it.value();
+    if (priority < request.priority) {
+      auto range = queue_.equal_range(request.priority);
+      for (auto q = range.first; q != range.second; ++q) {
+        if (q->second == path) {
+          queue_.erase(q);
+          queue_.emplace(priority, path);
+          break;
+        }
+      }
+      request.priority = priority;
+    }
+    return;
+  }
+
+  pending_.insert(path, Request{service, x, y, z, priority});
+  //  check the pack and disk cache first, off the GUI thread
+  QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+  QObject::connect(watcher, SIGNAL(finished()), this, SLOT(finishedDiskLoad()));
+  disk_loads_.insert(watcher, path);
+  watcher->setFuture(
+      QtConcurrent::run(loadTile, packForService(service), x, y, z, path));
+}
+
+void TileFetcher::clearQueue() {
+  for (const auto &queued : queue_) {
+    pending_.remove(queued.second);
+  }
+  queue_.clear();
+}
+
+void TileFetcher::finishedDiskLoad() {
+  QFutureWatcher<QImage> *watcher =
+      static_cast<QFutureWatcher<QImage> *>(sender());
+  watcher->deleteLater();
+  const QString path = disk_loads_.take(watcher);
+  auto it = pending_.find(path);
+  if (it == pending_.end()) {
+    return;
+  }
+
+  const QImage image = watcher->result();
+  if (image.isNull()) {
+    queue_.emplace(it.value().priority, path);
+    startRequests();
+    return;
+  }
+  pending_.erase(it);
+  cache_->insert(path, image);
+  emit fetchedTile(path);
+}
+
+void TileFetcher::startRequests() {
+  while (in_flight_.size() < max_requests_ && !queue_.empty()) {
+    const QString path = queue_.begin()->second;
+    queue_.erase(queue_.begin());
+    const Request &tile = pending_[path];
+
+    //  send request
+    QNetworkRequest request = QNetworkRequest(uriForTile(tile.service, tile.x, tile.y, tile.z));
+    auto const userAgent = QByteArray("rviz_satellite/0.0.2 (+https://github.com/gareth-cross/rviz_satellite)");
+    request.setRawHeader(QByteArray("User-Agent"), userAgent);
+    QNetworkReply *rep = qnam_->get(request);
+    in_flight_.insert(rep, path);
+    emit initiatedRequest(request);
+  }
+}
+
+void TileFetcher::finishedRequest(QNetworkReply *reply) {
+  reply->deleteLater();
+  const QNetworkRequest request = reply->request();
+  const QString path = in_flight_.take(reply);
+  pending_.remove(path);
+
+  if (reply->error() == QNetworkReply::NoError) {
+    //  decode an image
+    QImageReader reader(reply);
+    if (reader.canRead()) {
+      QImage image = reader.read();
+      cache_->insert(path, image);
+      //  encode and write off the GUI thread
+      QtConcurrent::run(writeCachedTile, image, path);
+      emit receivedImage(request);
+      emit fetchedTile(path);
+    } else {
+      //  probably not an image
+      QString err;
+      err = "Unable to decode image at " + request.url().toString();
+      emit failedTile(path, err);
+    }
+  } else {
+    const QString err = "Failed loading " + request.url().toString() +
+                        " with code " + QString::number(reply->error());
+    emit failedTile(path, err);
+  }
+
+  startRequests();
+}
+
 void TileLoader::MapTile::abortLoading() {
   if (reply_) {
     reply_->abort();
@@ -49,28 +304,11 @@ bool TileLoader::MapTile::hasImage() const { return !image_.isNull(); }
 
 TileLoader::TileLoader(const std::string &service, double latitude,
                        double longitude, unsigned int zoom, unsigned int blocks,
-                       QObject *parent)
+                       TileFetcher *fetcher, QObject *parent)
     : QObject(parent), latitude_(latitude), longitude_(longitude), zoom_(zoom),
-      blocks_(blocks), object_uri_(service) {
+      blocks_(blocks), fetcher_(fetcher), object_uri_(service) {
   assert(blocks_ >= 0);
 
-  const std::string package_path = ros::package::getPath("rviz_satellite");
-  if (package_path.empty()) {
-    throw std::runtime_error("package 'rviz_satellite' not found");
-  }
-
-  std::hash<std::string> hash_fn;
-  cache_path_ =
-      QDir::cleanPath(QString::fromStdString(package_path) + QDir::separator() +
-                      QString("mapscache") + QDir::separator() +
-                      QString::number(hash_fn(object_uri_)));
-
-  QDir dir(cache_path_);
-  if (!dir.exists() && !dir.mkpath(".")) {
-    throw std::runtime_error("Failed to create cache folder: " +
-                             cache_path_.toStdString());
-  }
-
   /// @todo: some kind of error checking of the URL
 
   //  calculate center tile coordinates
@@ -81,6 +319,14 @@ TileLoader::TileLoader(const std::string &service, double latitude,
   //  fractional component
   origin_offset_x_ = x - center_tile_x_;
   origin_offset_y_ = y - center_tile_y_;
+
+  //  creates the cache folder, so fails here rather than while loading
+  fetcher_->cachedPathForTile(object_uri_, center_tile_x_, center_tile_y_, zoom_);
+
+  QObject::connect(fetcher_, SIGNAL(fetchedTile(QString)), this,
+                   SLOT(fetchedTile(QString)));
+  QObject::connect(fetcher_, SIGNAL(failedTile(QString, QString)), this,
+                   SLOT(failedTile(QString, QString)));
 }
 
 bool TileLoader::insideCentreTile(double lat, double lon) const {
@@ -89,17 +335,17 @@ bool TileLoader::insideCentreTile(double lat, double lon) const {
   return (std::floor(x) == center_tile_x_ && std::floor(y) == center_tile_y_);
 }
 
+bool TileLoader::insideWindow(int x, int y) const {
+  return std::abs(x - center_tile_x_) <= blocks_ &&
+         std::abs(y - center_tile_y_) <= blocks_;
+}
+
 void TileLoader::start() {
-  //  discard previous set of tiles and all pending requests
+  //  discard previous set of tiles
   abort();
 
   ROS_INFO("loading %d blocks around tile=(%d,%d)", blocks_, center_tile_x_, center_tile_y_ );
 
-  qnam_.reset( new QNetworkAccessManager(this) );
-  QObject::connect(qnam_.get(), SIGNAL(finished(QNetworkReply *)), this,
-                   SLOT(finishedRequest(QNetworkReply *)));
-  qnam_->proxyFactory()->setUseSystemConfiguration ( true );
-
   //  determine what range of tiles we can load
   const int min_x = std::max(0, center_tile_x_ - blocks_);
   const int min_y = std::max(0, center_tile_y_ - blocks_);
@@ -107,26 +353,23 @@ void TileLoader::start() {
   const int max_y = std::min(maxTiles(), center_tile_y_ + blocks_);
 
   //  initiate requests
+  tiles_.reserve((max_x - min_x + 1) * (max_y - min_y + 1));
   for (int y = min_y; y <= max_y; y++) {
     for (int x = min_x; x <= max_x; x++) {
-      // Generate filename
-      const QString full_path = cachedPathForTile(x, y, zoom_);
+      const QString path = fetcher_->cachedPathForTile(object_uri_, x, y, zoom_);
 
-      // Check if tile is already in the cache
-      QFile tile(full_path);
-      if (tile.exists()) {
-        QImage image(full_path);
+      // Check if tile is already decoded in memory
+      QImage image = fetcher_->cache().find(path);
+      if (!image.isNull()) {
         tiles_.push_back(MapTile(x, y, zoom_, image));
-      } else {
-        const QUrl uri = uriForTile(x, y);
-        //  send request
-        QNetworkRequest request = QNetworkRequest(uri);
-        auto const userAgent = QByteArray("rviz_satellite/0.0.2 (+https://github.com/gareth-cross/rviz_satellite)");
-        request.setRawHeader(QByteArray("User-Agent"), userAgent);
-        QNetworkReply *rep = qnam_->get(request);
-        emit initiatedRequest(request);
-        tiles_.push_back(MapTile(x, y, zoom_, rep));
+        continue;
       }
+
+      //  tiles nearest the centre first
+      tiles_.push_back(MapTile(x, y, zoom_));
+      pending_.insert(path, tiles_.size() - 1);
+      fetcher_->fetch(object_uri_, x, y, zoom_,
+                      std::hypot(x - center_tile_x_, y - center_tile_y_));
     }
   }
 
@@ -166,42 +409,27 @@ double TileLoader::zoomToResolution(double lat, unsigned int zoom) {
   return 156543.034 * std::cos(lat_rad) / (1 << zoom);
 }
 
-void TileLoader::finishedRequest(QNetworkReply *reply) {
-  const QNetworkRequest request = reply->request();
-
+void TileLoader::fetchedTile(QString path) {
   //  find corresponding tile
-  const std::vector<MapTile>::iterator it =
-      std::find_if(tiles_.begin(), tiles_.end(),
-                   [&](const MapTile &tile) { return tile.reply() == reply; });
-  if (it == tiles_.end()) {
-    //  removed from list already, ignore this reply
+  auto it = pending_.find(path);
+  if (it == pending_.end()) {
+    //  not one of ours, or removed from list already
     return;
   }
-  MapTile &tile = *it;
-
-  if (reply->error() == QNetworkReply::NoError) {
-    //  decode an image
-    QImageReader reader(reply);
-    if (reader.canRead()) {
-      QImage image = reader.read();
-      tile.setImage(image);
-      image.save(cachedPathForTile(tile.x(), tile.y(), tile.z()), "JPEG");
-      emit receivedImage(request);
-    } else {
-      //  probably not an image
-      QString err;
-      err = "Unable to decode image at " + request.url().toString();
-      emit errorOcurred(err);
-    }
-  } else {
-    const QString err = "Failed loading " + request.url().toString() +
-                        " with code " + QString::number(reply->error());
-    emit errorOcurred(err);
-  }
+  MapTile &tile = tiles_[it.value()];
+  pending_.erase(it);
+  tile.setImage(fetcher_->cache().find(path));
+  emit loadedTile();
 
   checkIfLoadingComplete();
 }
 
+void TileLoader::failedTile(QString path, QString description) {
+  if (pending_.contains(path)) {
+    emit errorOcurred(description);
+  }
+}
+
 bool TileLoader::checkIfLoadingComplete() {
   const bool loaded =
       std::all_of(tiles_.begin(), tiles_.end(),
@@ -212,34 +440,7 @@ bool TileLoader::checkIfLoadingComplete() {
   return loaded;
 }
 
-QUrl TileLoader::uriForTile(int x, int y) const {
-  std::string object = object_uri_;
-  //  place {x},{y},{z} with appropriate values
-  replaceRegex(boost::regex("\\{x\\}", boost::regex::icase), object,
-               std::to_string(x));
-  replaceRegex(boost::regex("\\{y\\}", boost::regex::icase), object,
-               std::to_string(y));
-  replaceRegex(boost::regex("\\{z\\}", boost::regex::icase), object,
-               std::to_string(zoom_));
-
-  const QString qstr = QString::fromStdString(object);
-  return QUrl(qstr);
-}
-
-QString TileLoader::cachedNameForTile(int x, int y, int z) const {
-  return "x" + QString::number(x) + "_y" + QString::number(y) + "_z" +
-         QString::number(z) + ".jpg";
-}
-
-QString TileLoader::cachedPathForTile(int x, int y, int z) const {
-  return QDir::cleanPath(cache_path_ + QDir::separator() +
-                         cachedNameForTile(x, y, z));
-}
-
-int TileLoader::maxTiles() const { return (1 << zoom_) - 1; }
-
 void TileLoader::abort() {
   tiles_.clear();
-  //  destroy network access manager
-  qnam_.reset();
+  pending_.clear();
 }
@@ -16,9 +16,128 @@
 #include <QNetworkAccessManager>
 #include <QString>
 #include <QNetworkReply>
+#include <QFutureWatcher>
+#include <QHash>
 #include <vector>
+#include <list>
+#include <map>
 #include <memory>
 
+class TilePack;
+
+/// Least recently used decoded tiles, by their cached path (so by service and x,y,z).
+/// Shared between loaders, so the tiles still in the window when the map is re-centred
+/// are neither read nor decoded again. Only used from the GUI thread.
+class TileCache {
+public:
+  explicit TileCache(size_t capacity = 128) : capacity_(capacity) {}
+
+  /// Cached image, or a null image.
+  QImage find(const QString &key);
+
+  bool contains(const QString &key) const { return index_.contains(key); }
+
+  void insert(const QString &key, const QImage &image);
+
+  size_t capacity() const { return capacity_; }
+  void setCapacity(size_t capacity);
+
+  size_t size() const { return lru_.size(); }
+
+private:
+  void evict();
+
+  size_t capacity_;
+  /// Most recently used first.
+  std::list<std::pair<QString, QImage>> lru_;
+  QHash<QString, std::list<std::pair<QString, QImage>>::iterator> index_;
+};
+
+/// Fetches tiles into a TileCache: from the service's tile pack or the disk
+/// cache, read and decoded on the global thread pool, or else from the server. Server requests are sent most
+/// urgent first and at most max_requests at a time, so the tiles about to be
+/// seen are never queued behind the rest. Shared by the loaders and the
+/// prefetching, and outlives both.
+class TileFetcher : public QObject {
+  Q_OBJECT
+public:
+  explicit TileFetcher(std::shared_ptr<TileCache> cache, int max_requests = 4,
+                       QObject *parent = nullptr);
+
+  /// Fetch a tile into the cache, unless it is there already. Lower priorities
+  /// are fetched first, and a tile already queued keeps the lower of its two.
+  void fetch(const std::string &service, int x, int y, int z, double priority);
+
+  /// Drop the requests still queued. Those already sent still finish.
+  void clearQueue();
+
+  TileCache &cache() { return *cache_; }
+
+  /// File path of tile [x,y,z] of service in the disk cache, which is also its
+  /// key in the memory cache. Throws if the cache folder can't be created.
+  QString cachedPathForTile(const std::string &service, int x, int y, int z);
+
+  /// File path of the tile pack of service, which need not exist. Tiles are
+  /// looked for in the pack before the disk cache. The pack is opened on the
+  /// first fetch from the service, so one built later is used by new fetchers.
+  QString packPathForService(const std::string &service);
+
+  /// Is the tile at path still being fetched?
+  bool isPending(const QString &path) const { return pending_.contains(path); }
+
+  /// URI for tile [x,y,z] of service.
+  static QUrl uriForTile(const std::string &service, int x, int y, int z);
+
+signals:
+
+  void initiatedRequest(QNetworkRequest request);
+
+  void receivedImage(QNetworkRequest request);
+
+  /// The tile at path is now in the cache.
+  void fetchedTile(QString path);
+
+  void failedTile(QString path, QString description);
+
+private slots:
+
+  void finishedDiskLoad();
+
+  void finishedRequest(QNetworkReply *reply);
+
+private:
+  struct Request {
+    std::string service;
+    int x;
+    int y;
+    int z;
+    double priority;
+  };
+
+  /// Cache folder of service, created if missing.
+  QString cacheDirForService(const std::string &service);
+
+  /// Tile pack of service, or null if it has none.
+  std::shared_ptr<TilePack> packForService(const std::string &service);
+
+  /// Send queued requests, most urgent first, until max_requests are in flight.
+  void startRequests();
+
+  std::shared_ptr<TileCache> cache_;
+  int max_requests_;
+  QNetworkAccessManager *qnam_;
+  QString package_path_;
+  QHash<QString, QString> cache_dirs_;
+  QHash<QString, std::shared_ptr<TilePack>> packs_;
+
+  /// Every tile being fetched, by path
+  QHash<QString, Request> pending_;
+  QHash<QFutureWatcher<QImage> *, QString> disk_loads_;
+  /// Tiles missing from disk waiting for the server, by priority
+  std::multimap<double, QString> queue_;
+  QHash<QNetworkReply *, QString> in_flight_;
+};
+
 class TileLoader : public QObject {
   Q_OBJECT
 public:
@@ -60,11 +179,13 @@ public:
     QImage image_;
   };
 
+  /// Tiles missing from the fetcher's cache are fetched through it.
   explicit TileLoader(const std::string &service, double latitude,
                       double longitude, unsigned int zoom, unsigned int blocks,
-                      QObject *parent = nullptr);
+                      TileFetcher *fetcher, QObject *parent = nullptr);
 
-  /// Start loading tiles asynchronously.
+  /// Start loading tiles asynchronously. Tiles in the memory cache are used
+  /// right away, and the rest are fetched closest to the centre first.
   void start();
 
   /// Meters/pixel of the tiles.
@@ -85,6 +206,9 @@ public:
   /// Test if (lat,lon) falls inside centre tile.
   bool insideCentreTile(double lat, double lon) const;
 
+  /// Test if tile [x,y] is in the window of tiles loaded.
+  bool insideWindow(int x, int y) const;
+
   /// Convert lat/lon to a tile index with mercator projection.
   static void latLonToTileCoords(double lat, double lon, unsigned int zoom,
                                  double &x, double &y);
@@ -92,6 +216,9 @@ public:
   /// Convert latitude and zoom level to ground resolution.
   static double zoomToResolution(double lat, unsigned int zoom);
 
+  /// Maximum tile index for the zoom level.
+  static int maxTiles(unsigned int zoom) { return (1 << zoom) - 1; }
+
   /// Path to tiles on the server.
   const std::string &objectURI() const { return object_uri_; }
 
@@ -103,9 +230,7 @@ public:
 
 signals:
 
-  void initiatedRequest(QNetworkRequest request);
-
-  void receivedImage(QNetworkRequest request);
+  void loadedTile();
 
   void finishedLoading();
 
@@ -115,24 +240,17 @@ public slots:
 
 private slots:
 
-  void finishedRequest(QNetworkReply *reply);
+  void fetchedTile(QString path);
+
+  void failedTile(QString path, QString description);
 
 private:
 
   /// Check if loading is complete. Emit signal if appropriate.
   bool checkIfLoadingComplete();
 
-  /// URI for tile [x,y]
-  QUrl uriForTile(int x, int y) const;
-
-  /// Get name for cached tile [x,y,z]
-  QString cachedNameForTile(int x, int y, int z) const;
-
-  /// Get file path for cached tile [x,y,z].
-  QString cachedPathForTile(int x, int y, int z) const;
-
   /// Maximum number of tiles for the zoom level
-  int maxTiles() const;
+  int maxTiles() const { return maxTiles(zoom_); }
 
   double latitude_;
   double longitude_;
@@ -143,12 +261,13 @@ private:
   double origin_offset_x_;
   double origin_offset_y_;
 
-  std::shared_ptr<QNetworkAccessManager> qnam_;
-  QString cache_path_;
+  TileFetcher *fetcher_;
 
   std::string object_uri_;
 
   std::vector<MapTile> tiles_;
+  /// Index in tiles_ of the tiles still being fetched, by path
+  QHash<QString, size_t> pending_;
 };
 
 #endif // TILELOADER_H
@@ -20,7 +20,8 @@ class Thruster
 {
 public:
   Thruster(std::string _name, gazebo::physics::LinkPtr _link, gazebo::physics::JointPtr _joint);
-  void Update(double& position, double& velocity, double& effort);
+  /// Apply the command at sim time, or nothing if none came in the second of sim time before
+  void Update(gazebo::common::Time const& sim_time, double& position, double& velocity, double& effort);
 
 private:
   void CommandCallback(const roboteq_msgs::Command& _cmd);
@@ -30,8 +31,11 @@ private:
   ros::NodeHandle nh_;
   ros::Subscriber command_sub_;
   std::mutex mutex_;
-  double command_;
-  ros::Time last_command_time_;
+  double command_ = 0.;
+  /// Sim times of the last update and of the update before the last command, so the timeout does not depend on the
+  /// real time factor
+  gazebo::common::Time sim_time_;
+  gazebo::common::Time last_command_time_;
 };
 
 class ThrusterPlugin : public gazebo::ModelPlugin
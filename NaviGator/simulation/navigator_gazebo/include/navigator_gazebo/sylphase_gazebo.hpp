@@ -1,6 +1,7 @@
 #pragma once
 
 #include <geometry_msgs/Vector3Stamped.h>
+#include <mil_gazebo/mil_gazebo_utils.hpp>
 #include <nav_msgs/Odometry.h>
 #include <ros/ros.h>
 #include <algorithm>
@@ -14,6 +15,11 @@
 
 namespace navigator_gazebo
 {
+/**
+ * Simulated Sylphase INS, publishing the pose and velocity of a point on the model in enu and ecef. At high rates
+ * (200Hz, like the real one) the physics thread only reads the model and fills messages reused from update to
+ * update, while each topic is published from a thread of its own (see mil_gazebo::ThrottledPublisher).
+ */
 class SylphaseGazebo : public gazebo::ModelPlugin
 {
 public:
@@ -23,22 +29,22 @@ public:
 
 private:
   ros::NodeHandle nh_;
-  ros::Publisher odom_pub_;
-  ros::Publisher absodom_pub_;
-  ros::Publisher acceleration_pub_;
+  mil_gazebo::ThrottledPublisher<nav_msgs::Odometry> odom_pub_;
+  mil_gazebo::ThrottledPublisher<nav_msgs::Odometry> absodom_pub_;
+  mil_gazebo::ThrottledPublisher<geometry_msgs::Vector3Stamped> acceleration_pub_;
+  /// Decides which updates publish, the same ones for all three topics
+  mil_gazebo::UpdateThrottle throttle_;
   gazebo::physics::ModelPtr model_;
   gazebo::common::SphericalCoordinatesPtr converter_;
   gazebo::event::ConnectionPtr update_connection_;
   std::string child_frame_;
-  double update_period_;
-  gazebo::common::Time last_update_time_;
 
   geometry_msgs::Point Convert(const ignition::math::Vector3d &);
   geometry_msgs::Pose Convert(const ignition::math::Pose3d &);
-  geometry_msgs::Vector3 Convert2(const ignition::math::Vector3d &);
   geometry_msgs::Quaternion Convert(const ignition::math::Quaterniond &);
 
   ignition::math::Pose3d pose_;
+  /// The world origin does not move, so these are found once on load
   ignition::math::Pose3d local_to_enu_;
   ignition::math::Pose3d local_to_ecef_;
 
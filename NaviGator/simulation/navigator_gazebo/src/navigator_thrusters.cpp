@@ -15,13 +15,14 @@ void Thruster::CommandCallback(const roboteq_msgs::Command& _cmd)
 {
   std::lock_guard<std::mutex> lock(mutex_);
   command_ = _cmd.setpoint;
-  last_command_time_ = ros::Time::now();
+  last_command_time_ = sim_time_;
 }
 
-void Thruster::Update(double& _position, double& _velocity, double& _effort)
+void Thruster::Update(gazebo::common::Time const& _sim_time, double& _position, double& _velocity, double& _effort)
 {
   std::lock_guard<std::mutex> lock(mutex_);
-  if (ros::Time::now() - last_command_time_ > ros::Duration(1))
+  sim_time_ = _sim_time;
+  if (_sim_time < last_command_time_ || (_sim_time - last_command_time_).Double() > 1.)
     command_ = 0.;
   joint_->SetForce(0, command_);
   _effort = command_;
@@ -76,7 +77,7 @@ void ThrusterPlugin::OnUpdate(const gazebo::common::UpdateInfo& info)
 {
   for (size_t i = 0; i < thrusters_.size(); ++i)
   {
-    thrusters_[i]->Update(joint_state_msg_.position[i], joint_state_msg_.velocity[i], joint_state_msg_.effort[i]);
+    thrusters_[i]->Update(info.simTime, joint_state_msg_.position[i], joint_state_msg_.velocity[i], joint_state_msg_.effort[i]);
   }
   joint_state_msg_.header.stamp.sec = info.simTime.sec;
   joint_state_msg_.header.stamp.nsec = info.simTime.nsec;
@@ -31,7 +31,7 @@ void SylphaseGazebo::Load(gazebo::physics::ModelPtr _model, sdf::ElementPtr _sdf
   double update_hz = 30.;
   if (_sdf->HasElement("update_rate"))
     update_hz = _sdf->Get<double>("update_rate");
-  update_period_ = 1.0 / update_hz;
+  throttle_.SetRate(update_hz);
 
   model_ = _model;
 
@@ -47,10 +47,10 @@ void SylphaseGazebo::Load(gazebo::physics::ModelPtr _model, sdf::ElementPtr _sdf
   local_to_enu_ = SphericalCoordinatesTransform(*converter_, CoordinateType::LOCAL, CoordinateType::GLOBAL);
   local_to_ecef_ = SphericalCoordinatesTransform(*converter_, CoordinateType::LOCAL, CoordinateType::ECEF);
 
-  // Output publishers
-  odom_pub_ = nh_.advertise<nav_msgs::Odometry>(odom_topic, 10);
-  absodom_pub_ = nh_.advertise<nav_msgs::Odometry>(absodom_topic, 10);
-  acceleration_pub_ = nh_.advertise<geometry_msgs::Vector3Stamped>("acceleration", 10);
+  // Output publishers, each publishing every message handed to it, as throttle_ already picks the updates
+  odom_pub_.Advertise(nh_, odom_topic, 10, 0.);
+  absodom_pub_.Advertise(nh_, absodom_topic, 10, 0.);
+  acceleration_pub_.Advertise(nh_, acceleration_topic, 10, 0.);
 
   update_connection_ =
       gazebo::event::Events::ConnectWorldUpdateBegin(std::bind(&SylphaseGazebo::OnUpdate, this, std::placeholders::_1));
@@ -98,22 +98,11 @@ geometry_msgs::Point SylphaseGazebo::Convert(const ignition::math::Vector3d& _in
   return out;
 }
 
-geometry_msgs::Vector3 SylphaseGazebo::Convert2(const ignition::math::Vector3d& _in)
-{
-  geometry_msgs::Vector3 out;
-  out.x = _in.X();
-  out.y = _in.Y();
-  out.z = _in.Z();
-  return out;
-}
-
 void SylphaseGazebo::OnUpdate(const gazebo::common::UpdateInfo& info)
 {
-  if ((info.simTime - last_update_time_).Double() < update_period_)
+  if (!throttle_.Due(info.simTime))
     return;
-  last_update_time_ = info.simTime;
 
-  // TODO: throttle
   auto pose = model_->WorldPose() + pose_;
   auto rot = pose_.Rot();
   auto vel_linear = rot * model_->RelativeLinearVel();
@@ -122,29 +111,29 @@ void SylphaseGazebo::OnUpdate(const gazebo::common::UpdateInfo& info)
   auto enu = ignition::math::Pose3d(local_to_enu_.CoordPositionAdd(pose.Pos()), local_to_enu_.Rot() * pose.Rot());
   auto ecef = ignition::math::Pose3d(local_to_ecef_.CoordPositionAdd(pose.Pos()), local_to_ecef_.Rot() * pose.Rot());
 
-  nav_msgs::Odometry odom;
+  // Each message is reused, so its strings keep their storage and are only copied into
+  nav_msgs::Odometry& odom = odom_pub_.Message();
   odom.header.frame_id = "enu";
-  odom.header.stamp.sec = info.simTime.sec;
-  odom.header.stamp.nsec = info.simTime.nsec;
+  mil_gazebo::Convert(info.simTime, odom.header.stamp);
   odom.child_frame_id = child_frame_;
   odom.pose.pose = Convert(enu);
-  odom.twist.twist.linear = Convert2(vel_linear);
-  odom.twist.twist.angular = Convert2(vel_angular);
+  mil_gazebo::Convert(vel_linear, odom.twist.twist.linear);
+  mil_gazebo::Convert(vel_angular, odom.twist.twist.angular);
 
-  nav_msgs::Odometry absodom;
+  nav_msgs::Odometry& absodom = absodom_pub_.Message();
   absodom.pose.pose = Convert(ecef);
   absodom.twist.twist = odom.twist.twist;
   absodom.header.frame_id = "ecef";
   absodom.child_frame_id = child_frame_;
   absodom.header.stamp = odom.header.stamp;
 
-  geometry_msgs::Vector3Stamped accel;
+  geometry_msgs::Vector3Stamped& accel = acceleration_pub_.Message();
   accel.header.stamp = odom.header.stamp;
   accel.header.frame_id = odom.header.frame_id;
-  accel.vector = Convert2(vel_angular);
+  mil_gazebo::Convert(accel_linear, accel.vector);
 
-  odom_pub_.publish(odom);
-  absodom_pub_.publish(absodom);
-  acceleration_pub_.publish(accel);
+  odom_pub_.Publish();
+  absodom_pub_.Publish();
+  acceleration_pub_.Publish();
 }
 }
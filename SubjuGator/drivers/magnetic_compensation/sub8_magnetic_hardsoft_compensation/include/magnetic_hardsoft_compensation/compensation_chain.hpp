@@ -0,0 +1,108 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <ros/time.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace magnetic_hardsoft_compensation
+{
+/*
+  Removes the magnetic fields the vehicle makes itself from magnetometer readings, so they can be compensated where
+  they are read instead of by a nodelet per step.
+
+  The readings first have the fields of other sources on the vehicle, e.g. thrusters, that have not expired yet
+  subtracted (dynamic compensation), then the hard iron shift subtracted and the soft iron scale undone (hard/soft
+  compensation). That is one affine map, scale^-1 * raw - scale^-1 * (shift + fields), whose offset is recomputed only
+  when the fields change or one of them expires.
+
+  Can be used from any thread.
+*/
+class CompensationChain
+{
+public:
+  CompensationChain() : scale_inverse_(Eigen::Matrix3d::Identity()), shift_(Eigen::Vector3d::Zero())
+  {
+    invalidate();
+  }
+
+  void set_hardsoft(const Eigen::Matrix3d& scale, const Eigen::Vector3d& shift)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    scale_inverse_ = scale.inverse();
+    shift_ = shift;
+    invalidate();
+  }
+
+  /// Sets the field of source id, in tesla, until stamp + lifetime. Older updates than the last one are ignored.
+  void set_field(const std::string& id, const ros::Time& stamp, const ros::Duration& lifetime,
+                 const Eigen::Vector3d& field)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, Field>::iterator it = fields_.find(id);
+    if (it != fields_.end() && stamp < it->second.stamp)
+      return;  // ignore out of order messages
+    Field& f = fields_[id];
+    f.stamp = stamp;
+    f.expiry = stamp + lifetime;
+    f.field = field;
+    invalidate();
+  }
+
+  /// Compensated reading of raw, read at stamp
+  Eigen::Vector3d apply(const Eigen::Vector3d& raw, const ros::Time& stamp)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!(stamp > valid_from_ && stamp <= valid_until_))
+      update_offset(stamp);
+    return scale_inverse_ * raw + offset_;
+  }
+
+private:
+  struct Field
+  {
+    ros::Time stamp;
+    ros::Time expiry;
+    Eigen::Vector3d field;
+  };
+
+  // The offset for stamp, and the stamps it holds for: after the last expiry of a field that has expired by stamp,
+  // up to the first expiry of one that has not
+  void update_offset(const ros::Time& stamp)
+  {
+    Eigen::Vector3d local = Eigen::Vector3d::Zero();
+    valid_from_ = ros::TIME_MIN;
+    valid_until_ = ros::TIME_MAX;
+    for (std::map<std::string, Field>::const_iterator it = fields_.begin(); it != fields_.end(); ++it)
+    {
+      const Field& f = it->second;
+      if (f.expiry < stamp)
+      {
+        valid_from_ = std::max(valid_from_, f.expiry);
+        continue;  // field has expired
+      }
+      local += f.field;
+      valid_until_ = std::min(valid_until_, f.expiry);
+    }
+    offset_ = -scale_inverse_ * (shift_ + local);
+  }
+
+  void invalidate()
+  {
+    valid_from_ = ros::TIME_MAX;
+    valid_until_ = ros::TIME_MIN;
+  }
+
+  std::mutex mutex_;
+  Eigen::Matrix3d scale_inverse_;
+  Eigen::Vector3d shift_;
+  std::map<std::string, Field> fields_;
+
+  Eigen::Vector3d offset_;
+  ros::Time valid_from_, valid_until_;
+};
+}
@@ -9,14 +9,15 @@
 
 #include <mil_tools/param_helpers.hpp>
 
+#include "magnetic_hardsoft_compensation/compensation_chain.hpp"
+
 namespace magnetic_hardsoft_compensation
 {
 class Nodelet : public nodelet::Nodelet
 {
 private:
   std::string frame_id;
-  Eigen::Matrix3d scale_inverse;
-  Eigen::Vector3d shift;
+  CompensationChain compensation;
   ros::Subscriber sub;
   ros::Publisher pub;
 
@@ -31,7 +32,7 @@ private:
     Eigen::Vector3d raw;
     tf::vectorMsgToEigen(msg->magnetic_field, raw);
 
-    Eigen::Vector3d processed = scale_inverse * (raw - shift);
+    Eigen::Vector3d processed = compensation.apply(raw, msg->header.stamp);
 
     sensor_msgs::MagneticField result;
     result.header = msg->header;
@@ -50,8 +51,8 @@ public:
     ros::NodeHandle& private_nh = getPrivateNodeHandle();
 
     frame_id = mil_tools::getParam<std::string>(private_nh, "frame_id");
-    scale_inverse = mil_tools::getParam<Eigen::Matrix3d>(private_nh, "scale").inverse();
-    shift = mil_tools::getParam<Eigen::Vector3d>(private_nh, "shift");
+    compensation.set_hardsoft(mil_tools::getParam<Eigen::Matrix3d>(private_nh, "scale"),
+                              mil_tools::getParam<Eigen::Vector3d>(private_nh, "shift"));
 
     ros::NodeHandle& nh = getNodeHandle();
 
@@ -2,73 +2,173 @@
 #define DRIVER_H
 
 #include <cmath>
-#include <fstream>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <utility>
+
+#include <mil_tools/framed_serial.hpp>
 
 #include <sensor_msgs/Imu.h>
 #include <sensor_msgs/MagneticField.h>
 
 namespace adis16400_imu
 {
-static uint16_t getu16(char *i)
+static uint16_t getu16(const char *i)
 {
   return reinterpret_cast<const boost::uint16_t &>(*i);
 }
-static int16_t get16(char *i)
+static int16_t get16(const char *i)
 {
   return reinterpret_cast<const boost::int16_t &>(*i);
 }
-static int64_t get64(char *i)
+static int64_t get64(const char *i)
 {
   return reinterpret_cast<const boost::int64_t &>(*i);
 }
 
-class Device
+/**
+ * Estimates the ROS time frames were sampled at from the device's time of each and the ROS time it was read at.
+ *
+ * A frame can not have been sampled after it was read, so device time is mapped to ROS time along a line under every
+ * read time. The earliest read of each window, the one delayed least, is a point where the line should be, and the
+ * slope is fit between those points, so the stamps keep the device's even spacing instead of the jitter of the reads.
+ */
+class ClockEstimator
 {
-private:
-  const std::string port;
-  std::ifstream is;
+public:
+  /**
+   * @param window seconds of device time each point of the line is picked from
+   * @param max_baseline seconds of device time the slope is fit over, to follow the device clock as it drifts
+   * @param max_error seconds a read can be from the line before the clocks are taken to have jumped
+   */
+  explicit ClockEstimator(double window = 1, double max_baseline = 60, double max_error = 0.1)
+    : window_(window), max_baseline_(max_baseline), max_error_(max_error)
+  {
+    reset();
+  }
 
-  bool open()
+  /**
+   * Starts over, as when the device restarts its clock
+   */
+  void reset()
   {
-    try
+    initialized_ = false;
+    points_.clear();
+  }
+
+  /**
+   * ROS time of a frame, from its device time in seconds and the ROS time it was read at
+   */
+  ros::Time stamp(double device_time, const ros::Time &read_time)
+  {
+    if (initialized_ && (device_time < last_device_time_ ||
+                         std::abs((read_time - predict(device_time)).toSec()) > max_error_))
     {
-      is.exceptions(std::ifstream::goodbit);
-      is.close();
-      is.clear();
-      is.exceptions(std::ifstream::eofbit | std::ifstream::failbit | std::ifstream::badbit);
-      is.open(port.c_str());
-      return true;
+      ROS_WARN_THROTTLE(1, "IMU clock jumped, resynchronizing");
+      reset();
     }
-    catch (const std::exception &exc)
+    if (!initialized_)
     {
-      ROS_ERROR("error on open(%s): %s; reopening after delay", port.c_str(), exc.what());
-      boost::this_thread::sleep(boost::posix_time::seconds(1));
-      return false;
+      initialized_ = true;
+      ref_device_time_ = window_start_ = device_time;
+      ref_time_ = read_time;
+      scale_ = 1;
+      window_min_ = std::numeric_limits<double>::infinity();
     }
+    last_device_time_ = device_time;
+
+    ros::Time stamp = predict(device_time);
+    double delay = (read_time - stamp).toSec();
+    if (delay < 0)
+    {
+      // Read before the line says it was sampled, so the line is moved down to it
+      ref_device_time_ = device_time;
+      ref_time_ = stamp = read_time;
+      delay = 0;
+    }
+    if (delay < window_min_)
+    {
+      window_min_ = delay;
+      window_min_device_time_ = device_time;
+    }
+
+    if (device_time - window_start_ >= window_)
+    {
+      ros::Time point = predict(window_min_device_time_) + ros::Duration(window_min_);
+      points_.push_back(std::make_pair(window_min_device_time_, point));
+      while (points_.size() > 2 && window_min_device_time_ - points_.front().first > max_baseline_)
+        points_.pop_front();
+      if (points_.size() >= 2)
+        scale_ = (point - points_.front().second).toSec() / (window_min_device_time_ - points_.front().first);
+      ref_device_time_ = window_min_device_time_;
+      ref_time_ = point;
+      window_start_ = device_time;
+      window_min_ = std::numeric_limits<double>::infinity();
+    }
+    return stamp;
+  }
+
+private:
+  ros::Time predict(double device_time) const
+  {
+    return ref_time_ + ros::Duration(scale_ * (device_time - ref_device_time_));
   }
 
+  double window_;
+  double max_baseline_;
+  double max_error_;
+
+  bool initialized_;
+  double last_device_time_;
+  // The line goes through ref_time_ at ref_device_time_, with scale_ seconds of ROS time per second of device time
+  double ref_device_time_;
+  ros::Time ref_time_;
+  double scale_;
+  double window_start_;
+  double window_min_;  // least delay of a read from the line in this window
+  double window_min_device_time_;
+  std::deque<std::pair<double, ros::Time> > points_;
+};
+
+class Device
+{
 public:
-  Device(const std::string port) : port(port)
+  typedef std::function<void(const sensor_msgs::Imu &, const sensor_msgs::MagneticField &)> Callback;
+
+private:
+  static const size_t FRAME_SIZE = 32;
+
+  const std::string frame_id;
+  const double sample_rate;
+  const double timestamp_tick;
+  Callback callback;
+  ClockEstimator clock;
+  mil_tools::FramedSerialPort p;
+
+  /*
+    Device time of a frame, in seconds. That is its timestamp, if it has one, or else its index in the stream over the
+    sample rate.
+  */
+  double device_time(const mil_tools::SerialFrame &frame) const
   {
-    is.exceptions(std::ifstream::eofbit | std::ifstream::failbit | std::ifstream::badbit);
+    if (timestamp_tick > 0)
+      return get64(reinterpret_cast<const char *>(frame.data) + 24) * timestamp_tick;
+    return frame.offset / FRAME_SIZE / sample_rate;
   }
 
-  bool read(const std::string frame_id, sensor_msgs::Imu &result, sensor_msgs::MagneticField &mag_result)
+  void handle_frame(const mil_tools::SerialFrame &frame)
   {
-    char data[32];
-    try
-    {
-      is.read(data, 32);
-    }
-    catch (const std::exception &exc)
-    {
-      ROS_ERROR("error on read: %s; reopening", exc.what());
-      open();
-      return false;
-    }
+    sensor_msgs::Imu imu;
+    sensor_msgs::MagneticField mag;
+    parse(reinterpret_cast<const char *>(frame.data), clock.stamp(device_time(frame), frame.stamp), imu, mag);
+    callback(imu, mag);
+  }
 
+  void parse(const char *data, const ros::Time &stamp, sensor_msgs::Imu &result, sensor_msgs::MagneticField &mag_result)
+  {
     result.header.frame_id = frame_id;
-    result.header.stamp = ros::Time::now();
+    result.header.stamp = stamp;
 
     result.orientation_covariance[0] = -1;  // indicate no orientation data
 
@@ -102,8 +202,37 @@ public:
     getu16(data + 0);              // flags unused
     getu16(data + 2) * 2.418e-3;   // supply voltage unused
     get16(data + 22) * 0.14 + 25;  // temperature unused
+  }
+
+public:
+  /**
+   * Opens the port and calls callback, on the serial I/O thread, with each frame received, stamped by the clock
+   * estimator from its device time rather than the time it was read
+   * @param sample_rate frames per second the IMU sends
+   * @param timestamp_tick seconds per count of the 64 bit timestamp that ends each frame, or 0 to time the frames by
+   *                       their count and the sample rate
+   * @param capture raw capture to write the port's bytes to, or to replay in place of the port
+   */
+  Device(const std::string port, const std::string frame_id, Callback callback, double sample_rate = 819.2,
+         double timestamp_tick = 0, const mil_tools::RawCaptureOptions &capture = mil_tools::RawCaptureOptions())
+    : frame_id(frame_id)
+    , sample_rate(sample_rate)
+    , timestamp_tick(timestamp_tick)
+    , callback(callback)
+    , p(port, 0, std::unique_ptr<mil_tools::FrameParser>(new mil_tools::FixedSizeFrameParser(FRAME_SIZE)),
+        std::bind(&Device::handle_frame, this, std::placeholders::_1), FRAME_SIZE, capture)
+  {
+  }
 
-    return true;
+  mil_tools::FramedSerialPort::Stats stats() const
+  {
+    return p.stats();
+  }
+
+  // Applies policy to the serial I/O thread the callback is called on
+  bool applyThreadPolicy(const mil_tools::ThreadPolicy& policy)
+  {
+    return p.applyThreadPolicy(policy);
   }
 };
 }
@@ -1,10 +1,16 @@
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/shared_ptr.hpp>
-#include <boost/thread.hpp>
 
 #include <nodelet/nodelet.h>
 #include <ros/ros.h>
 #include <pluginlib/class_list_macros.hpp>
 
+#include <cmath>
+
+#include <magnetic_dynamic_compensation/FieldInfo.h>
+#include <magnetic_hardsoft_compensation/compensation_chain.hpp>
+#include <mil_tools/driver_diagnostics.hpp>
 #include <mil_tools/param_helpers.hpp>
 
 #include "adis16400_imu/driver.h"
@@ -19,8 +25,8 @@ public:
   }
   ~Nodelet()
   {
-    running = false;
-    polling_thread_inst.join();
+    diagnostics.reset();
+    device.reset();
   }
 
   virtual void onInit()
@@ -28,42 +34,98 @@ public:
     std::string port = mil_tools::getParam<std::string>(getPrivateNodeHandle(), "port");
     frame_id = mil_tools::getParam<std::string>(getPrivateNodeHandle(), "frame_id");
     drop_every_ = mil_tools::getParam<unsigned int>(getPrivateNodeHandle(), "divide", 1);
+    sample_rate = mil_tools::getParam<double>(getPrivateNodeHandle(), "sample_rate", 819.2);
+    // Seconds per count of the timestamp in each frame, if the frames are timed by it rather than by their count
+    timestamp_tick = mil_tools::getParam<double>(getPrivateNodeHandle(), "timestamp_tick", 0);
+
+    // Compensate the magnetometer here, rather than with the magnetic_*_compensation nodelets, so that takes no more
+    // messages
+    compensate_mag = mil_tools::getParam<bool>(getPrivateNodeHandle(), "compensate_mag", false);
 
     ros::NodeHandle& nh = getNodeHandle();
     pub = nh.advertise<sensor_msgs::Imu>("imu/data_raw", 10);
     mag_pub = nh.advertise<sensor_msgs::MagneticField>("imu/mag_raw", 10);
+    if (compensate_mag)
+    {
+      compensation.set_hardsoft(
+          mil_tools::getParam<Eigen::Matrix3d>(getPrivateNodeHandle(), "scale", Eigen::Matrix3d::Identity()),
+          mil_tools::getParam<Eigen::Vector3d>(getPrivateNodeHandle(), "shift", Eigen::Vector3d::Zero()));
+      fieldinfo_sub = nh.subscribe<magnetic_dynamic_compensation::FieldInfo>(
+          "/imu/mag_generated_info", 1000, boost::bind(&Nodelet::fieldinfo_callback, this, _1));
+      mag_compensated_pub = nh.advertise<sensor_msgs::MagneticField>("imu/mag", 10);
+    }
+
+    diagnostics.reset(new mil_tools::DriverDiagnostics(nh, getPrivateNodeHandle(), getName(), port));
+    imu_monitor = &diagnostics->stream("imu");
 
     count = 0;
-    running = true;
-    device = boost::make_shared<Device>(port);
-    polling_thread_inst = boost::thread(boost::bind(&Nodelet::polling_thread, this));
+    device = boost::make_shared<Device>(port, frame_id, boost::bind(&Nodelet::frame_callback, this, _1, _2),
+                                        sample_rate, timestamp_tick,
+                                        mil_tools::RawCaptureOptions::from_params(getPrivateNodeHandle()));
+    diagnostics->add_status("serial", mil_tools::serial_port_status([this]() { return device->stats(); }));
+    // The serial port's latency on diagnostics is how late the I/O thread wakes for each frame
+    mil_tools::ThreadPolicy policy = mil_tools::ThreadPolicy::from_params(getPrivateNodeHandle(), "thread_policy");
+    if (!policy.empty())
+      device->applyThreadPolicy(policy);
   }
 
 private:
-  void polling_thread()
+  // Called on the serial I/O thread, for each frame of a read in turn
+  void frame_callback(const sensor_msgs::Imu& imu, const sensor_msgs::MagneticField& mag)
+  {
+    // Stamps follow the device's clock when frames carry its timestamp, so more than a sample between them is frames
+    // lost on the way. Without it, frames are timed by their count and a lost one can not be told apart.
+    if (timestamp_tick > 0 && !last_stamp.isZero())
+    {
+      int64_t missed = std::llround((imu.header.stamp - last_stamp).toSec() * sample_rate) - 1;
+      if (missed > 0)
+        imu_monitor->dropped(missed);
+    }
+    last_stamp = imu.header.stamp;
+
+    if (count++ % drop_every_ != 0)
+      return;
+    pub.publish(imu);
+    mag_pub.publish(mag);
+    imu_monitor->published(imu.header.stamp);
+    if (compensate_mag)
+    {
+      const geometry_msgs::Vector3& raw = mag.magnetic_field;
+      Eigen::Vector3d processed = compensation.apply(Eigen::Vector3d(raw.x, raw.y, raw.z), mag.header.stamp);
+      sensor_msgs::MagneticField result = mag;
+      result.magnetic_field.x = processed.x();
+      result.magnetic_field.y = processed.y();
+      result.magnetic_field.z = processed.z();
+      mag_compensated_pub.publish(result);
+    }
+  }
+
+  void fieldinfo_callback(const magnetic_dynamic_compensation::FieldInfo::ConstPtr& msg)
   {
-    while (running)
+    if (msg->header.frame_id != frame_id)
     {
-      sensor_msgs::Imu imu;
-      sensor_msgs::MagneticField mag;
-      if (device->read(frame_id, imu, mag))
-      {
-        if (count++ % drop_every_ != 0)
-          continue;
-        pub.publish(imu);
-        mag_pub.publish(mag);
-      }
+      ROS_ERROR("FieldInfo's frame_id != configured frame_id! ignoring FieldInfo %s", msg->id.c_str());
+      return;
     }
+    const geometry_msgs::Vector3& field = msg->magnetic_field;
+    compensation.set_field(msg->id, msg->header.stamp, msg->lifetime, Eigen::Vector3d(field.x, field.y, field.z));
   }
 
   boost::shared_ptr<Device> device;
   std::string frame_id;
   ros::Publisher pub;
   ros::Publisher mag_pub;
-  bool running;
-  boost::thread polling_thread_inst;
+  bool compensate_mag;
+  magnetic_hardsoft_compensation::CompensationChain compensation;
+  ros::Subscriber fieldinfo_sub;
+  ros::Publisher mag_compensated_pub;
   int count;
   unsigned int drop_every_;
+  double sample_rate;
+  double timestamp_tick;
+  ros::Time last_stamp;
+  std::unique_ptr<mil_tools::DriverDiagnostics> diagnostics;
+  mil_tools::StreamMonitor* imu_monitor;
 };
 
 PLUGINLIB_EXPORT_CLASS(adis16400_imu::Nodelet, nodelet::Nodelet);
@@ -1,31 +1,100 @@
 #ifndef DRIVER_H
 #define DRIVER_H
 
+#include <algorithm>
 #include <cmath>
-#include <fstream>
+#include <functional>
+#include <vector>
 
-#include <boost/asio/serial_port.hpp>
 #include <boost/crc.hpp>
 
+#include <mil_tools/framed_serial.hpp>
+
 namespace depth_driver
 {
-static uint16_t getu16le(uint8_t *i)
+static uint16_t getu16le(const uint8_t *i)
 {
   return *i + *(i + 1) * 256;
 }
 
 static const uint8_t flagbyte = 0x7E, escapebyte = 0x7D, maskbyte = 0x20;
 
+typedef boost::crc_optimal<16, 0x1021, 0, 0, false, false> CRCCalculator;
+
+/*
+  Frames the packets received from the depth sensor, between flag bytes with the flag and escape bytes in them
+  escaped, and checks their checksums
+*/
+class PacketParser : public mil_tools::FrameParser
+{
+public:
+  bool parse(const uint8_t *begin, const uint8_t *end, Match &match) override
+  {
+    const uint8_t *start = std::find(begin, end, flagbyte);
+    while (start != end)
+    {
+      // The flag ending a packet may also start the next one
+      const uint8_t *stop = std::find(start + 1, end, flagbyte);
+      if (stop == end)
+        break;
+      // Consecutive flags would be a zero length packet, so we're out of sync and ignoring it gets us back
+      if (stop != start + 1 && unescape(start + 1, stop, match))
+      {
+        match.start = start - begin;
+        match.consumed = stop - begin;
+        return true;
+      }
+      start = stop;
+    }
+    match.consumed = start - begin;
+    return false;
+  }
+
+private:
+  // Unescapes a packet and checks its checksum, setting the match to it without the checksum if it is valid
+  bool unescape(const uint8_t *begin, const uint8_t *end, Match &match)
+  {
+    unescaped.clear();
+    for (const uint8_t *i = begin; i != end; ++i)
+    {
+      if (*i == escapebyte && i + 1 != end)
+        unescaped.push_back(*++i ^ maskbyte);
+      else
+        unescaped.push_back(*i);
+    }
+
+    if (unescaped.size() < 2)
+    {  // message too short for checksum
+      ROS_INFO("packet too small");
+      ++match.errors;
+      return false;
+    }
+    CRCCalculator crc;
+    crc.process_block(unescaped.data(), unescaped.data() + unescaped.size() - 2);
+    if (*(unescaped.end() - 2) != (crc.checksum() & 0xFF) || *(unescaped.end() - 1) != (crc.checksum() >> 8))
+    {
+      ROS_INFO("packet with invalid checksum");
+      ++match.errors;
+      return false;
+    }
+    match.data = unescaped.data();
+    match.size = unescaped.size() - 2;
+    return true;
+  }
+
+  std::vector<uint8_t> unescaped;
+};
+
 class Device
 {
+public:
+  typedef std::function<void(double depth, const ros::Time &stamp)> Callback;
+
 private:
   typedef std::vector<boost::uint8_t> ByteVec;
-  typedef boost::crc_optimal<16, 0x1021, 0, 0, false, false> CRCCalculator;
 
-  const std::string port;
-  const int baudrate;
-  boost::asio::io_service io;
-  boost::asio::serial_port p;
+  Callback callback;
+  mil_tools::FramedSerialPort p;
 
   void send_packet(ByteVec unescaped)
   {
@@ -57,109 +126,29 @@ private:
 
     out.push_back(flagbyte);
 
-    try
-    {
-      size_t written = 0;
-      while (written < out.size())
-      {
-        written += p.write_some(boost::asio::buffer(out.data() + written, out.size() - written));
-      }
-    }
-    catch (const std::exception &exc)
-    {
-      ROS_ERROR("error on write: %s; dropping", exc.what());
-    }
-  }
-
-  bool read_byte(uint8_t &res)
-  {
-    try
-    {
-      p.read_some(boost::asio::buffer(&res, sizeof(res)));
-      return true;
-    }
-    catch (const std::exception &exc)
-    {
-      ROS_ERROR("error on read: %s; reopening", exc.what());
-      open();
-      return false;
-    }
+    p.write(out);
   }
 
-  void open()
+  void handle_packet(const mil_tools::SerialFrame &frame)
   {
-    try
-    {
-      p.close();
-      p.open(port);
-      p.set_option(boost::asio::serial_port::baud_rate(baudrate));
-    }
-    catch (const std::exception &exc)
-    {
-      ROS_ERROR("error on open(%s): %s; reopening after delay", port.c_str(), exc.what());
-      boost::this_thread::sleep(boost::posix_time::seconds(1));
-    }
+    if (frame.size < 8)
+      return;
+    double temp = getu16le(frame.data + frame.size - 8) / 1024.;
+    callback((temp - 10.62) * 1.45, frame.stamp);
   }
 
 public:
-  Device(const std::string port, int baudrate) : port(port), baudrate(baudrate), p(io)
+  /*
+    Opens the port and calls callback, on the serial I/O thread, with the depth in each packet received, stamped with
+    the time the packet started coming in, or replays a capture of the port's bytes in its place
+  */
+  Device(const std::string port, int baudrate, Callback callback,
+         const mil_tools::RawCaptureOptions &capture = mil_tools::RawCaptureOptions())
+    : callback(callback)
+    , p(port, baudrate, std::unique_ptr<mil_tools::FrameParser>(new PacketParser()),
+        std::bind(&Device::handle_packet, this, std::placeholders::_1),
+        mil_tools::FramedSerialPort::DEFAULT_MAX_FRAME_SIZE, capture)
   {
-    // open is called on first read() in the _polling_ thread
-  }
-
-  bool read(double &result)
-  {
-    if (!p.is_open())
-    {
-      open();
-      return false;
-    }
-
-    uint8_t firstbyte;
-    if (!read_byte(firstbyte))
-      return false;
-    if (firstbyte != flagbyte)
-      return false;
-
-    ByteVec unescaped;
-    while (true)
-    {
-      uint8_t b;
-      if (!read_byte(b))
-        return false;
-      if (b == flagbyte && unescaped.size() != 0)
-        break;
-      else if (b == flagbyte && unescaped.size() == 0)
-        continue;  // would be zero length message, so we're out of sync and ignoring it gets us
-                   // back
-      else if (b == escapebyte)
-      {
-        uint8_t b2;
-        if (!read_byte(b2))
-          return false;
-        unescaped.push_back(b2 ^ maskbyte);
-      }
-      else
-        unescaped.push_back(b);
-    }
-
-    if (unescaped.size() < 2)
-    {  // message too short for checksum
-      ROS_INFO("packet too small");
-      return false;
-    }
-    CRCCalculator crc;
-    crc.process_block(&*unescaped.begin(), &*(unescaped.end() - 2));
-    if (*(unescaped.end() - 2) != (crc.checksum() & 0xFF) || *(unescaped.end() - 1) != (crc.checksum() >> 8))
-    {
-      ROS_INFO("packet with invalid checksum");
-      return false;
-    }
-    unescaped.erase(unescaped.end() - 2, unescaped.end());
-
-    double temp = getu16le(&*unescaped.end() - 8) / 1024.;
-    result = (temp - 10.62) * 1.45;
-    return true;
   }
 
   void send_heartbeat()
@@ -169,9 +158,9 @@ public:
     send_packet(ByteVec(msg, msg + sizeof(msg) / sizeof(msg[0])));  // StartPublishing 20hz
   }
 
-  void abort()
+  mil_tools::FramedSerialPort::Stats stats() const
   {
-    p.close();
+    return p.stats();
   }
 };
 }
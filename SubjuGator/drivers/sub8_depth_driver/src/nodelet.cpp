@@ -1,11 +1,13 @@
 #include <boost/shared_ptr.hpp>
-#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 
 #include <nodelet/nodelet.h>
 #include <ros/ros.h>
 #include <pluginlib/class_list_macros.hpp>
 
 #include <mil_msgs/DepthStamped.h>
+#include <mil_tools/driver_diagnostics.hpp>
 #include <mil_tools/param_helpers.hpp>
 
 #include <depth_driver/driver.h>
@@ -21,9 +23,8 @@ public:
   ~Nodelet()
   {
     heartbeat_timer.stop();
-    running = false;
-    device->abort();
-    polling_thread_inst.join();
+    diagnostics.reset();
+    device.reset();
   }
 
   virtual void onInit()
@@ -34,11 +35,13 @@ public:
 
     pub = getNodeHandle().advertise<mil_msgs::DepthStamped>("depth", 10);
 
-    device = boost::make_shared<Device>(port, baudrate);
+    diagnostics.reset(new mil_tools::DriverDiagnostics(getNodeHandle(), getPrivateNodeHandle(), getName(), port));
+    depth_monitor = &diagnostics->stream("depth");
+    device = boost::make_shared<Device>(port, baudrate, boost::bind(&Nodelet::depth_callback, this, _1, _2),
+                                        mil_tools::RawCaptureOptions::from_params(getPrivateNodeHandle()));
+    diagnostics->add_status("serial", mil_tools::serial_port_status([this]() { return device->stats(); }));
     heartbeat_timer =
         getNodeHandle().createTimer(ros::Duration(0.5), boost::bind(&Nodelet::heartbeat_callback, this, _1));
-    running = true;
-    polling_thread_inst = boost::thread(boost::bind(&Nodelet::polling_thread, this));
   }
 
 private:
@@ -47,25 +50,23 @@ private:
     device->send_heartbeat();
   }
 
-  void polling_thread()
+  // Called on the serial I/O thread
+  void depth_callback(double depth, const ros::Time& stamp)
   {
-    while (running)
-    {
-      mil_msgs::DepthStamped msg;
-      if (!device->read(msg.depth))
-        continue;
-      msg.header.stamp = ros::Time::now();
-      msg.header.frame_id = frame_id;
-      pub.publish(msg);
-    }
+    mil_msgs::DepthStamped msg;
+    msg.depth = depth;
+    msg.header.stamp = stamp;
+    msg.header.frame_id = frame_id;
+    pub.publish(msg);
+    depth_monitor->published(stamp);
   }
 
   std::string frame_id;
   ros::Publisher pub;
   boost::shared_ptr<Device> device;
   ros::Timer heartbeat_timer;
-  bool running;
-  boost::thread polling_thread_inst;
+  std::unique_ptr<mil_tools::DriverDiagnostics> diagnostics;
+  mil_tools::StreamMonitor* depth_monitor;
 };
 
 PLUGINLIB_EXPORT_CLASS(depth_driver::Nodelet, nodelet::Nodelet);
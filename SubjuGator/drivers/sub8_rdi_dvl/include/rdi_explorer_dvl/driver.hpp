@@ -1,13 +1,17 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
-#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <vector>
 
-#include <boost/asio/serial_port.hpp>
-#include <boost/foreach.hpp>
 #include <boost/math/constants/constants.hpp>
 #include <boost/none.hpp>
+#include <boost/optional.hpp>
 
+#include <mil_tools/framed_serial.hpp>
 #include <mil_tools/msg_helpers.hpp>
 
 #include <mil_msgs/RangeStamped.h>
@@ -15,162 +19,147 @@
 
 namespace rdi_explorer_dvl
 {
-static uint16_t getu16le(uint8_t *i)
+static uint16_t getu16le(const uint8_t *i)
 {
   return *i | (*(i + 1) << 8);
 }
 
-static int32_t gets32le(uint8_t *i)
+static int32_t gets32le(const uint8_t *i)
 {
   return *i | (*(i + 1) << 8) | (*(i + 2) << 16) | (*(i + 3) << 24);
 }
 
-class Device
+/*
+  Frames the ensembles in the bytes received from the DVL, without copying them
+*/
+class EnsembleParser : public mil_tools::FrameParser
 {
-private:
-  typedef std::vector<boost::uint8_t> ByteVec;
-
-  const std::string port;
-  const int baudrate;
-  boost::asio::io_service io;
-  boost::asio::serial_port p;
-
-  /*
-    Reads byte into a uint8_t
-    res - uint8_t reference to write byte into
-  */
-  bool read_byte(uint8_t &res)
+public:
+  bool parse(const uint8_t *begin, const uint8_t *end, Match &match) override
   {
-    while (true)
+    // A header in the data of an ensemble can make it look like a longer one than there is. While the first header
+    // waits for the rest of its ensemble, a whole valid one after it shows it was not one.
+    const size_t length = end - begin;
+    size_t waiting = length;
+    for (size_t start = find_header(begin, end, 0); start < length; start = find_header(begin, end, start + 1))
     {
-      try
+      uint16_t size, checksum, received_checksum;
+      Framing framing = frame_at(begin + start, end, size, checksum, received_checksum);
+      if (framing == VALID)
       {
-        p.read_some(boost::asio::buffer(&res, sizeof(res)));
+        match.start = start;
+        match.data = begin + start;
+        match.size = size;
+        match.consumed = start + size + 2;
         return true;
       }
-      catch (const std::exception &exc)
+      if (framing == INCOMPLETE && waiting == length)
+        waiting = start;
+      else if (framing == BAD_CHECKSUM && waiting == length)
       {
-        ROS_ERROR_THROTTLE(0.5, "DVL: error on read: %s; reopening serial port", exc.what());
-        open();
-        return false;
+        ++match.errors;
+        ROS_ERROR_THROTTLE(0.5, "DVL: invalid ensemble checksum. received: %i calculated: %i size: %i",
+                           received_checksum, checksum, size);
       }
     }
+    match.consumed = waiting;
+    return false;
   }
 
+private:
+  enum Framing
+  {
+    VALID,
+    INCOMPLETE,
+    BAD_HEADER,
+    BAD_CHECKSUM
+  };
+
   /*
-    Reads 2 bytes into a uint16_t
-    res - uint16_t reference to write byte into
+    Offset of the first header at or after start, or of a header ID at the very end, which may be the start of one,
+    or the length of the bytes
   */
-  bool read_short(uint16_t &x)
+  static size_t find_header(const uint8_t *begin, const uint8_t *end, size_t start)
   {
-    uint8_t low;
-    if (!read_byte(low))
-      return false;
-    uint8_t high;
-    if (!read_byte(high))
-      return false;
-    x = 256 * high + low;
-    return true;
+    const uint8_t header[] = { 0x7F, 0x7F };
+    const uint8_t *found = std::search(begin + start, end, header, header + sizeof(header));
+    if (found == end && begin + start < end && end[-1] == 0x7F)
+      return end - begin - 1;
+    return found - begin;
   }
 
   /*
-    Attempts to close and reopen the serial port
-    Sleeps for one second before returning if an exception is caught
+    Checks whether the bytes from the header at ensemble to end hold a whole ensemble with a valid checksum
+    size - set to the size of the ensemble, without its checksum
+    checksum, received_checksum - set to the calculated and received checksums, if it is whole
   */
-  void open()
+  static Framing frame_at(const uint8_t *ensemble, const uint8_t *end, uint16_t &size, uint16_t &checksum,
+                          uint16_t &received_checksum)
   {
-    try
-    {
-      p.close();
-      p.open(port);
-      p.set_option(boost::asio::serial_port::baud_rate(baudrate));
-      return;
-    }
-    catch (const std::exception &exc)
-    {
-      ROS_ERROR("DVL: error on open(port=%s): %s; reopening after delay", port.c_str(), exc.what());
-      boost::this_thread::sleep(boost::posix_time::seconds(1));
-    }
+    const size_t length = end - ensemble;
+    if (length < 6)
+      return INCOMPLETE;
+    // Ensembles have at least one data type, a header without any is taken to be in the data of another
+    size = getu16le(ensemble + 2);
+    uint8_t data_types = ensemble[5];
+    if (data_types == 0 || size < 6 + 2 * data_types)
+      return BAD_HEADER;
+    if (length < size + 2u)
+      return INCOMPLETE;
+
+    checksum = 0;
+    for (uint16_t i = 0; i < size; i++)
+      checksum += ensemble[i];
+    received_checksum = getu16le(ensemble + size);
+    return checksum == received_checksum ? VALID : BAD_CHECKSUM;
   }
+};
 
+class Device
+{
 public:
-  Device(const std::string port, int baudrate) : port(port), baudrate(baudrate), p(io)
-  {
-    // open is called on first read() in the _polling_ thread
-  }
-
-  void read(boost::optional<mil_msgs::VelocityMeasurements> &res, boost::optional<mil_msgs::RangeStamped> &height_res)
-  {
-    res = boost::none;
-    height_res = boost::none;
-
-    if (!p.is_open())  // Open serial port if closed
-    {
-      open();
-      return;
-    }
-
-    ByteVec ensemble;
-    ensemble.resize(4);
-
-    // Header ID
-    if (!read_byte(ensemble[0]))
-      return;
-    if (ensemble[0] != 0x7F)
-      return;
-
-    ros::Time stamp = ros::Time::now();
+  typedef std::function<void(const boost::optional<mil_msgs::VelocityMeasurements> &,
+                             const boost::optional<mil_msgs::RangeStamped> &)>
+      Callback;
 
-    // Data Source ID
-    if (!read_byte(ensemble[1]))
-      return;
-    if (ensemble[1] != 0x7F)
-      return;
-
-    // Size low
-    if (!read_byte(ensemble[2]))
-      return;
-    // Size high
-    if (!read_byte(ensemble[3]))
-      return;
-
-    uint16_t ensemble_size = getu16le(ensemble.data() + 2);
-    ensemble.resize(ensemble_size);
-    for (int i = 4; i < ensemble_size; i++)
-    {
-      if (!read_byte(ensemble[i]))
-        return;
-    }
+private:
+  /// Largest ensemble the 16 bit size allows, and its checksum
+  static const size_t MAX_ENSEMBLE_SIZE = 0xFFFF + 2;
 
-    uint16_t checksum = 0;
-    BOOST_FOREACH (uint16_t b, ensemble)
-      checksum += b;
-    uint16_t received_checksum;
-    if (!read_short(received_checksum))
-      return;
-    if (received_checksum != checksum)
-    {
-      ROS_ERROR_THROTTLE(0.5, "DVL: invalid ensemble checksum. received: %i calculated: %i size: %i", received_checksum,
-                         checksum, ensemble_size);
-      return;
-    }
+  Callback callback;
+  mil_tools::FramedSerialPort p;
 
-    if (ensemble.size() < 6)
-      return;
+  void handle_ensemble(const mil_tools::SerialFrame &frame)
+  {
+    boost::optional<mil_msgs::VelocityMeasurements> res;
+    boost::optional<mil_msgs::RangeStamped> height_res;
+    parse_ensemble(frame.data, frame.size, frame.stamp, res, height_res);
+    if (res || height_res)
+      callback(res, height_res);
+  }
 
+  /*
+    Parses the velocity and height out of an ensemble with a valid checksum
+  */
+  void parse_ensemble(const uint8_t *ensemble, uint16_t size, const ros::Time &stamp,
+                      boost::optional<mil_msgs::VelocityMeasurements> &res,
+                      boost::optional<mil_msgs::RangeStamped> &height_res)
+  {
     std::vector<double> correlations(4, nan(""));
     for (int dt = 0; dt < ensemble[5]; dt++)
     {
-      int offset = getu16le(ensemble.data() + 6 + 2 * dt);
-      if (ensemble.size() - offset < 2)
+      if (size < 6 + 2 * dt + 2)
+        break;
+      int offset = getu16le(ensemble + 6 + 2 * dt);
+      if (size < offset + 2)
         continue;
       // Three modes, encoded by the section_id: Bottom Track High Resolution Velocity
       // Bottom Track, Bottom Track Range
-      uint16_t section_id = getu16le(ensemble.data() + offset);
+      uint16_t section_id = getu16le(ensemble + offset);
 
       if (section_id == 0x5803)  // Bottom Track High Resolution Velocity
       {
-        if (ensemble.size() - offset < 2 + 4 * 4)
+        if (size < offset + 2 + 4 * 4)
           continue;
         res = boost::make_optional(mil_msgs::VelocityMeasurements());
         res->header.stamp = stamp;
@@ -193,7 +182,7 @@ public:
         {
           mil_msgs::VelocityMeasurement m;
           m.direction = dirs[i];
-          int32_t vel = gets32le(ensemble.data() + offset + 2 + 4 * i);
+          int32_t vel = gets32le(ensemble + offset + 2 + 4 * i);
           m.velocity = -vel * .01e-3;
           if (vel == -3276801)  // -3276801 indicates no data
           {
@@ -214,21 +203,23 @@ public:
       }
       else if (section_id == 0x0600)  // Bottom Track
       {
+        if (size < offset + 32 + 4)
+          continue;
         for (int i = 0; i < 4; i++)
-          correlations[i] = *(ensemble.data() + offset + 32 + i);
+          correlations[i] = *(ensemble + offset + 32 + i);
       }
       else if (section_id == 0x5804)  // Bottom Track Range
       {
-        if (ensemble.size() - offset < 2 + 4 * 3)
+        if (size < offset + 2 + 4 * 3)
           continue;
-        if (gets32le(ensemble.data() + offset + 10) <= 0)
+        if (gets32le(ensemble + offset + 10) <= 0)
         {
           ROS_ERROR_THROTTLE(0.5, "%s", "DVL: didn't return height over bottom");
           continue;
         }
         height_res = boost::make_optional(mil_msgs::RangeStamped());
         height_res->header.stamp = stamp;
-        height_res->range = gets32le(ensemble.data() + offset + 10) * 0.1e-3;
+        height_res->range = gets32le(ensemble + offset + 10) * 0.1e-3;
       }
       if (res)
       {
@@ -240,6 +231,19 @@ public:
     }
   }
 
+public:
+  /*
+    Opens the port and calls callback, on the serial I/O thread, with what each ensemble received has, stamped with
+    the time its header came in, or replays a capture of the port's bytes in its place
+  */
+  Device(const std::string port, int baudrate, Callback callback,
+         const mil_tools::RawCaptureOptions &capture = mil_tools::RawCaptureOptions())
+    : callback(callback)
+    , p(port, baudrate, std::unique_ptr<mil_tools::FrameParser>(new EnsembleParser()),
+        std::bind(&Device::handle_ensemble, this, std::placeholders::_1), MAX_ENSEMBLE_SIZE, capture)
+  {
+  }
+
   void send_heartbeat()
   {
     double maxdepth = 15;
@@ -258,25 +262,18 @@ public:
     buf << "TT2012/03/04, 05:06:07\r";                                                       // set RTC
     buf << "CS\r";                                                                           // start pinging
 
-    std::string str = buf.str();
+    p.write(buf.str());
+  }
 
-    try  // Write heartbeat to serial port
-    {
-      size_t written = 0;
-      while (written < str.size())
-      {
-        written += p.write_some(boost::asio::buffer(str.data() + written, str.size() - written));
-      }
-    }
-    catch (const std::exception &exc)
-    {
-      ROS_ERROR_THROTTLE(0.5, "DVL: error on write: %s; dropping heartbeat", exc.what());
-    }
+  mil_tools::FramedSerialPort::Stats stats() const
+  {
+    return p.stats();
   }
 
-  void abort()
+  // Applies policy to the serial I/O thread the callback is called on
+  bool applyThreadPolicy(const mil_tools::ThreadPolicy& policy)
   {
-    p.close();
+    return p.applyThreadPolicy(policy);
   }
 };
 
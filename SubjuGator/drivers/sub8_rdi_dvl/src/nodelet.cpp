@@ -1,11 +1,13 @@
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
-#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
 
 #include <nodelet/nodelet.h>
 #include <ros/ros.h>
 #include <pluginlib/class_list_macros.hpp>
 
+#include <mil_tools/driver_diagnostics.hpp>
 #include <mil_tools/param_helpers.hpp>
 
 #include "rdi_explorer_dvl/driver.hpp"
@@ -21,9 +23,8 @@ public:
   ~Nodelet()
   {
     heartbeat_timer.stop();
-    running = false;
-    device->abort();
-    polling_thread_inst.join();
+    diagnostics.reset();
+    device.reset();
   }
 
   virtual void onInit()
@@ -37,11 +38,19 @@ public:
     pub = getNodeHandle().advertise<mil_msgs::VelocityMeasurements>("dvl", 10);
     range_pub = getNodeHandle().advertise<mil_msgs::RangeStamped>("dvl/range", 10);
 
-    device = boost::make_shared<Device>(port, baudrate);
+    diagnostics.reset(new mil_tools::DriverDiagnostics(getNodeHandle(), getPrivateNodeHandle(), getName(), port));
+    velocity_monitor = &diagnostics->stream("velocity");
+    // There is no range without bottom lock
+    range_monitor = &diagnostics->stream("range", true);
+    device = boost::make_shared<Device>(port, baudrate, boost::bind(&Nodelet::ensemble_callback, this, _1, _2),
+                                        mil_tools::RawCaptureOptions::from_params(getPrivateNodeHandle()));
+    diagnostics->add_status("serial", mil_tools::serial_port_status([this]() { return device->stats(); }));
+    // The serial port's latency on diagnostics is how late the I/O thread wakes for each ensemble
+    mil_tools::ThreadPolicy policy = mil_tools::ThreadPolicy::from_params(getPrivateNodeHandle(), "thread_policy");
+    if (!policy.empty())
+      device->applyThreadPolicy(policy);
     heartbeat_timer =
         getNodeHandle().createTimer(ros::Duration(0.5), boost::bind(&Nodelet::heartbeat_callback, this, _1));
-    running = true;
-    polling_thread_inst = boost::thread(boost::bind(&Nodelet::polling_thread, this));
   }
 
 private:
@@ -50,23 +59,21 @@ private:
     device->send_heartbeat();
   }
 
-  void polling_thread()
+  // Called on the serial I/O thread
+  void ensemble_callback(boost::optional<mil_msgs::VelocityMeasurements> msg,
+                         boost::optional<mil_msgs::RangeStamped> range_msg)
   {
-    while (running)
+    if (msg)
     {
-      boost::optional<mil_msgs::VelocityMeasurements> msg;
-      boost::optional<mil_msgs::RangeStamped> range_msg;
-      device->read(msg, range_msg);
-      if (msg)
-      {
-        msg->header.frame_id = frame_id;
-        pub.publish(*msg);
-      }
-      if (range_msg)
-      {
-        range_msg->header.frame_id = frame_id;
-        range_pub.publish(*range_msg);
-      }
+      msg->header.frame_id = frame_id;
+      pub.publish(*msg);
+      velocity_monitor->published(msg->header.stamp);
+    }
+    if (range_msg)
+    {
+      range_msg->header.frame_id = frame_id;
+      range_pub.publish(*range_msg);
+      range_monitor->published(range_msg->header.stamp);
     }
   }
 
@@ -75,8 +82,9 @@ private:
   ros::Publisher range_pub;
   boost::shared_ptr<Device> device;
   ros::Timer heartbeat_timer;
-  bool running;
-  boost::thread polling_thread_inst;
+  std::unique_ptr<mil_tools::DriverDiagnostics> diagnostics;
+  mil_tools::StreamMonitor* velocity_monitor;
+  mil_tools::StreamMonitor* range_monitor;
 };
 
 PLUGINLIB_EXPORT_CLASS(rdi_explorer_dvl::Nodelet, nodelet::Nodelet);
@@ -2,6 +2,7 @@
 #define C3TRAJECTORY_C3FILTER_H
 
 #include <Eigen/Dense>
+#include <vector>
 
 namespace subjugator
 {
@@ -71,6 +72,18 @@ public:
 
   PointWithAcceleration getCurrentPoint() const;
 
+  // Simulates update(dt, waypoint, ...) on a copy for the next steps updates, leaving this trajectory alone, and
+  // stores the point after each in points
+  void rollout(double dt, const Waypoint &waypoint, double waypoint_t, int steps, std::vector<Point> &points) const;
+  // Same, with the acceleration at each point
+  void rollout(double dt, const Waypoint &waypoint, double waypoint_t, int steps,
+               std::vector<PointWithAcceleration> &points) const;
+
+  // The C3 filter for all six axes at once, giving the jerk to apply on each
+  static Vector6d c3filter(const Vector6d &q, const Vector6d &qdot, const Vector6d &qdotdot, const Vector6d &r,
+                           const Vector6d &rdot, const Vector6d &rdotdot, const Vector6d &vmin, const Vector6d &vmax,
+                           const Vector6d &amin, const Vector6d &amax, const Vector6d &umax);
+
   bool do_waypoint_validation;
 
 private:
@@ -81,10 +94,10 @@ private:
 
   Limits limits;
 
-  static double c3filter(double q, double qdot, double qdotdot, double r, double rdot, double rdotdot, double vmin,
-                         double vmax, double amin, double amax, double umax);
-
-  static std::pair<Eigen::Matrix4d, Eigen::Matrix4d> transformation_pair(const Vector6d &q);
+  // BODY -> NED rotation for the attitude in q, kept while the attitude doesn't change
+  mutable Eigen::Vector3d rotation_rpy;
+  mutable Eigen::Matrix3d rotation_cache;
+  const Eigen::Matrix3d &rotation(const Vector6d &q) const;
   static std::pair<Eigen::Vector3d, Eigen::Vector3d> limit(const Eigen::Vector3d &vmin, const Eigen::Vector3d &vmax,
                                                            const Eigen::Vector3d &delta);
 };
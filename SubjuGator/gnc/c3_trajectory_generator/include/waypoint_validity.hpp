@@ -1,10 +1,19 @@
 #pragma once
 #include <geometry_msgs/PoseStamped.h>
+#include <map_msgs/OccupancyGridUpdate.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <ros/ros.h>
 
+#include <mil_ogrid/distance_field.hpp>
+#include <mil_ogrid/grid_geometry.hpp>
+#include <mil_tools/debug_publisher.hpp>
+
 #include <opencv2/core/core.hpp>
 
+#include <mutex>
+#include <string>
+#include <vector>
+
 enum class WAYPOINT_ERROR_TYPE
 {
   OCCUPIED = 99,
@@ -24,29 +33,118 @@ enum class OGRID_COLOR
   GREEN = 120
 };
 
+// The ogrid is received on the queue of the node handle given to the constructor, while the checks are called from
+// any other thread, so everything below about the ogrid is guarded by mutex_.
 class WaypointValidity
 {
 private:
-  ros::NodeHandle *nh_;
+  ros::NodeHandle *nh_ = nullptr;
+  mutable std::mutex mutex_;
   nav_msgs::OccupancyGridConstPtr ogrid_map_;
+  std::string ogrid_topic_;
+  std::string ogrid_updates_topic_;
   ros::Subscriber sub_;
+  // If true, apply partial updates from ogrid_updates_topic_ to a local copy of the last full ogrid
+  bool use_ogrid_updates_ = false;
+  nav_msgs::OccupancyGridPtr ogrid_copy_;
+  ros::Subscriber updates_sub_;
+  // map_load_time of the last full ogrid, the stamp of the data behind it, for latency tracing
+  ros::Time origin_;
+
+  // Footprints for viewing, only sent while someone subscribes
+  mil_tools::DebugPublisher<> pub_sub_ogrid_;
+  mil_tools::DebugPublisher<> pub_waypoint_ogrid_;
+  double sub_ogrid_size_ = 1.5;
+
+  // Footprints published by pub_size_ogrid, kept so a call only moves their origin. The sub's own footprint is sent
+  // at most once per sub_ogrid_period_.
+  nav_msgs::OccupancyGrid sub_ogrid_msg_;
+  nav_msgs::OccupancyGrid waypoint_ogrid_msg_;
+  ros::Duration sub_ogrid_period_;
+  ros::Time last_sub_ogrid_pub_;
+
+  // Usage: Resize and color a footprint message, only when the ogrid resolution or the color changed
+  void fill_size_ogrid(nav_msgs::OccupancyGrid &grid, int d, float resolution) const;
 
-  ros::Publisher pub_sub_ogrid_;
-  ros::Publisher pub_waypoint_ogrid_;
-  double sub_ogrid_size_;
+  // Chessboard distance, in cells, from each cell of ogrid_map_ to the nearest occupied cell or the outside of the
+  // ogrid, only kept up to sub_half_cells_ + 1 plus clearance_range_. Recomputed over the cells an update changes.
+  mil_ogrid::DistanceField clearance_;
+  // Half the width of the area checked around the sub, in cells of ogrid_map_
+  int sub_half_cells_ = 0;
+  // Meters of clearance around the sub's footprint that bulk checks measure up to
+  double clearance_range_ = 1.0;
+  // Where the clearance of a new ogrid is computed without mutex_ locked, before swapping it with clearance_. Only
+  // used by ogrid_callback.
+  mil_ogrid::DistanceField next_clearance_;
 
-  // Usage: Given a size and point, relative to ogrid, will check if there is an occupied grid
-  bool check_if_hit(cv::Point center, cv::Size sub_size);
+  // Usage: is_waypoint_valid with mutex_ already locked
+  std::pair<bool, WAYPOINT_ERROR_TYPE> waypoint_valid(const geometry_msgs::Pose &waypoint);
 
 public:
+  // Usage: The result of a bulk check of a pose or a polyline
+  struct Check
+  {
+    bool valid;
+    WAYPOINT_ERROR_TYPE error;
+    // Meters between the sub's footprint and the nearest occupied cell, the least along a polyline, up to
+    // clearance_range. 0 where not valid.
+    float clearance;
+    // Index of the pose, or of the start of the polyline segment, found not valid first, or -1
+    int first_invalid;
+  };
+
+private:
+  // Usage: waypoint_valid, and the clearance there, with mutex_ already locked
+  void check_point(const geometry_msgs::Pose &waypoint, Check &check);
+
+  // Usage: Given a point relative to ogrid, will check if the sub there would overlap an occupied cell
+  bool check_if_hit(cv::Point center) const;
+
+  // Usage: Find the ogrid cell of a waypoint, which may be outside of the ogrid
+  cv::Point to_cell(const geometry_msgs::Pose &waypoint) const;
+
+public:
+  // Usage: Read the params and advertise the footprints. The ogrid is not received until subscribe is called.
   WaypointValidity(ros::NodeHandle &nh);
 
+  // Usage: Start receiving the ogrid, once everything its callbacks may call into is built
+  void subscribe();
+
   // Usage: Store the reference to the previous ogrid in publisher
   void ogrid_callback(const nav_msgs::OccupancyGridConstPtr &ogrid_map);
 
+  // Usage: Apply a partial update to the stored ogrid, if updates are enabled
+  void ogrid_update_callback(const map_msgs::OccupancyGridUpdateConstPtr &update);
+
+  // Usage: The stamp of the sensor data behind the ogrid, to trace work done with it under. Updates do not carry one,
+  // so this is that of the last full ogrid.
+  ros::Time origin() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return origin_;
+  }
+
+  // Usage: Publish the sub's footprint at a waypoint, if anyone is listening. ORANGE is the sub itself, throttled to
+  // sub_ogrid_rate, anything else is a waypoint.
   void pub_size_ogrid(const geometry_msgs::Pose &waypoint, int d = 0);
 
   // Usage: Given a waypoint or trajectory, check what it will hit on the ogrid.
   std::pair<bool, WAYPOINT_ERROR_TYPE> is_waypoint_valid(const geometry_msgs::Pose &waypoint,
                                                          bool do_waypoint_validation);
+
+  /* Usage: Check every pose of a sampled trajectory, stopping at the first that is not valid
+     param first_invalid: set to the index of that pose, or to waypoints.size() if all are valid
+  */
+  std::pair<bool, WAYPOINT_ERROR_TYPE> is_trajectory_valid(const std::vector<geometry_msgs::Pose> &waypoints,
+                                                           bool do_waypoint_validation, size_t &first_invalid);
+
+  // Usage: Check each of poses on its own, all against the same ogrid, for a planner weighing many candidates
+  void check_poses(const std::vector<geometry_msgs::Pose> &poses, std::vector<Check> &checks);
+
+  /* Usage: Check polylines of poses against the same ogrid, at every cell along their segments
+     param ends: polyline i runs from ends[i - 1], or 0, up to but not including ends[i]
+     param checks: set to one per polyline
+  */
+  void check_polylines(const std::vector<geometry_msgs::Pose> &poses, const std::vector<uint32_t> &ends,
+                       std::vector<Check> &checks);
 };
\ No newline at end of file
@@ -8,46 +8,87 @@ using namespace Eigen;
 using namespace boost;
 using namespace std;
 
-static double sign(double x)
+typedef Array<double, 6, 1> Array6d;
+
+static Array6d sign(const Array6d &x)
 {
-  if (x > 0)
-    return 1;
-  if (x < 0)
-    return -1;
-  return 0;
+  return (x > 0).cast<double>() - (x < 0).cast<double>();
 }
 
 C3Trajectory::C3Trajectory(const Point &start, const Limits &limits)
-  : q(start.q), qdot(start.qdot), qdotdot_b(Vector6d::Zero()), u_b(Vector6d::Zero()), limits(limits)
+  : q(start.q)
+  , qdot(start.qdot)
+  , qdotdot_b(Vector6d::Zero())
+  , u_b(Vector6d::Zero())
+  , limits(limits)
+  , rotation_rpy(Vector3d::Constant(NAN))
 {
 }
 
-static Vector6d apply(const Matrix4d &T, const Vector6d &q, double w)
+const Matrix3d &C3Trajectory::rotation(const Vector6d &q) const
+{
+  // NaN never compares equal, so the first call always computes it
+  if (!(q.tail<3>().array() == rotation_rpy.array()).all())
+  {
+    rotation_rpy = q.tail<3>();
+    rotation_cache = AttitudeHelpers::EulerToRotation(rotation_rpy);
+  }
+  return rotation_cache;
+}
+
+// Linear part rotated by R, angular part unchanged
+static Vector6d rotate(const Matrix3d &R, const Vector6d &v)
 {
-  Vector6d q_t;
-  q_t << q.head(3), w, 0, 0;
-  q_t.head(4) = T * q_t.head(4);
-  q_t.tail(3) = q.tail(3);
-  return q_t;
+  Vector6d res;
+  res << R * v.head<3>(), v.tail<3>();
+  return res;
 }
 
 C3Trajectory::PointWithAcceleration C3Trajectory::getCurrentPoint() const
 {
-  return PointWithAcceleration(q, qdot, apply(C3Trajectory::transformation_pair(q).second, qdotdot_b, 0));
+  return PointWithAcceleration(q, qdot, rotate(rotation(q), qdotdot_b));
+}
+
+void C3Trajectory::rollout(double dt, const Waypoint &waypoint, double waypoint_t, int steps,
+                           std::vector<Point> &points) const
+{
+  C3Trajectory copy(*this);
+  points.clear();
+  points.reserve(steps);
+  for (int i = 0; i < steps; i++)
+  {
+    copy.update(dt, waypoint, waypoint_t + i * dt);
+    points.push_back(Point(copy.q, copy.qdot));
+  }
+}
+
+void C3Trajectory::rollout(double dt, const Waypoint &waypoint, double waypoint_t, int steps,
+                           std::vector<PointWithAcceleration> &points) const
+{
+  C3Trajectory copy(*this);
+  points.clear();
+  points.reserve(steps);
+  for (int i = 0; i < steps; i++)
+  {
+    copy.update(dt, waypoint, waypoint_t + i * dt);
+    points.push_back(copy.getCurrentPoint());
+  }
 }
 
 void C3Trajectory::update(double dt, const Waypoint &waypoint, double waypoint_t)
 {
   do_waypoint_validation = waypoint.do_waypoint_validation;
-  pair<Matrix4d, Matrix4d> Ts = transformation_pair(q);
-  const Matrix4d &T = Ts.first;
-  const Matrix4d &T_inv = Ts.second;
+  // BODY -> NED is rotating by R after shifting to q, so positions in the body frame are relative to q
+  const Matrix3d &R = rotation(q);
+  Matrix3d R_inv = R.transpose();
 
-  Vector6d q_b = apply(T, q, 1);
+  Vector6d q_b;
+  q_b << Vector3d::Zero(), q.tail<3>();
   Vector6d r = waypoint.r.q + waypoint_t * waypoint.r.qdot;
-  Vector6d r_b = apply(T, r, 1);
-  Vector6d qdot_b = apply(T, qdot, 0);
-  Vector6d rdot_b = apply(T, waypoint.r.qdot, 0);
+  Vector6d r_b;
+  r_b << R_inv * (r.head<3>() - q.head<3>()), r.tail<3>();
+  Vector6d qdot_b = rotate(R_inv, qdot);
+  Vector6d rdot_b = rotate(R_inv, waypoint.r.qdot);
 
   Vector6d vmin_b_prime = limits.vmin_b;
   Vector6d vmax_b_prime = limits.vmax_b;
@@ -55,11 +96,8 @@ void C3Trajectory::update(double dt, const Waypoint &waypoint, double waypoint_t
 
   if (waypoint.speed > 0)
   {
-    for (int i = 0; i < 6; i++)
-    {
-      vmin_b_prime(i) = max(vmin_b_prime(i), -waypoint.speed);
-      vmax_b_prime(i) = min(vmax_b_prime(i), waypoint.speed);
-    }
+    vmin_b_prime = vmin_b_prime.cwiseMax(-waypoint.speed);
+    vmax_b_prime = vmax_b_prime.cwiseMin(waypoint.speed);
   }
 
   if (posdelta.norm() > 0.01 && waypoint.coordinate_unaligned)
@@ -89,14 +127,11 @@ void C3Trajectory::update(double dt, const Waypoint &waypoint, double waypoint_t
       r_b(i) += 2 * M_PI;
   }
 
-  for (int i = 0; i < 6; i++)
-  {
-    u_b(i) = c3filter(q_b(i), qdot_b(i), qdotdot_b(i), r_b(i), rdot_b(i), 0, vmin_b_prime(i), vmax_b_prime(i),
-                      amin_b_prime(i), amax_b_prime(i), limits.umax_b(i));
-  }
+  u_b = c3filter(q_b, qdot_b, qdotdot_b, r_b, rdot_b, Vector6d::Zero(), vmin_b_prime, vmax_b_prime, amin_b_prime,
+                 amax_b_prime, limits.umax_b);
 
   qdotdot_b += dt * u_b;
-  Vector6d qdotdot = apply(T_inv, qdotdot_b, 0);
+  Vector6d qdotdot = rotate(R, qdotdot_b);
   qdot += dt * qdotdot;
   q += dt * qdot;
 
@@ -109,84 +144,65 @@ void C3Trajectory::update(double dt, const Waypoint &waypoint, double waypoint_t
   }
 }
 
-static double deltav(double v, double edot, double edotdot)
+static Array6d deltav(const Array6d &v, const Array6d &edot, const Array6d &edotdot)
 {
-  return edotdot * abs(edotdot) + 2 * (edot - v);
+  return edotdot * edotdot.abs() + 2 * (edot - v);
 }
 
-static double ucv(double v, double edot, double edotdot, double umax)
+static Array6d ucv(const Array6d &v, const Array6d &edot, const Array6d &edotdot, const Array6d &umax)
 {
-  double tmp = deltav(v, edot, edotdot);
-  return -umax * sign(tmp + (1 - abs(sign(tmp))) * edotdot);
+  Array6d tmp = deltav(v, edot, edotdot);
+  return -umax * sign(tmp + (1 - sign(tmp).abs()) * edotdot);
 }
 
-static double ua(double a, double edotdot, double umax)
+static Array6d ua(const Array6d &a, const Array6d &edotdot, const Array6d &umax)
 {
   return -umax * sign(edotdot - a);
 }
 
-static double uv(double v, double edot, double edotdot, double edotdotmin, double edotdotmax, double umax)
+static Array6d uv(const Array6d &v, const Array6d &edot, const Array6d &edotdot, const Array6d &edotdotmin,
+                  const Array6d &edotdotmax, const Array6d &umax)
 {
-  return max(ua(edotdotmin, edotdot, umax), min(ucv(v, edot, edotdot, umax), ua(edotdotmax, edotdot, umax)));
+  return ua(edotdotmin, edotdot, umax).max(ucv(v, edot, edotdot, umax).min(ua(edotdotmax, edotdot, umax)));
 }
 
-double C3Trajectory::c3filter(double q, double qdot, double qdotdot, double r, double rdot, double rdotdot, double vmin,
-                              double vmax, double amin, double amax, double umax)
+// Every axis evaluates all three switching curves, and the one that applies is selected per axis, so the whole
+// filter is branchless array math
+Vector6d C3Trajectory::c3filter(const Vector6d &q, const Vector6d &qdot, const Vector6d &qdotdot, const Vector6d &r,
+                                const Vector6d &rdot, const Vector6d &rdotdot, const Vector6d &vmin,
+                                const Vector6d &vmax, const Vector6d &amin, const Vector6d &amax,
+                                const Vector6d &umax_v)
 {
-  double e = (q - r) / umax;
-  double edot = (qdot - rdot) / umax;
-  double edotdot = (qdotdot - rdotdot) / umax;
-
-  double edotmin = (vmin - rdot) / umax;
-  double edotmax = (vmax - rdot) / umax;
-  double edotdotmin = (amin - rdotdot) / umax;
-  double edotdotmax = (amax - rdotdot) / umax;
-
-  double delta = edot + edotdot * abs(edotdot) / 2;
-  double sd = sign(delta);
-
-  double S;
-  if (edotdotmax != 0 && edotdot <= edotdotmax && edot <= pow(edotdot, 2) / 2 - pow(edotdotmax, 2))
-  {
-    S = e - edotdotmax * (pow(edotdot, 2) - 2 * edot) / 4 - pow(pow(edotdot, 2) - 2 * edot, 2) / (8 * edotdotmax) -
-        edotdot * (3 * edot - pow(edotdot, 2)) / 3;
-  }
-  else if (edotdotmin != 0 && edotdot >= edotdotmin && edot >= pow(edotdotmin, 2) - pow(edotdot, 2) / 2)
-  {
-    S = e - edotdotmin * (pow(edotdot, 2) + 2 * edot) / 4 - pow(pow(edotdot, 2) + 2 * edot, 2) / (8 * edotdotmin) +
-        edotdot * (3 * edot + pow(edotdot, 2)) / 3;
-  }
-  else
-  {
-    S = e + edot * edotdot * sd - (pow(edotdot, 3)) / 6 * (1 - 3 * abs(sd)) +
-        sd / 4 * sqrt(2 * pow(pow(edotdot, 2) + 2 * edot * sd, 3));
-  }
-
-  double uc = -umax * sign(S + (1 - abs(sign(S))) * (delta + (1 - abs(sd)) * edotdot));
-  double uv_emin = uv(edotmin, edot, edotdot, edotdotmin, edotdotmax, umax);
-  double uv_emax = uv(edotmax, edot, edotdot, edotdotmin, edotdotmax, umax);
-
-  return max(uv_emin, min(uc, uv_emax));
-}
-
-pair<Matrix4d, Matrix4d> C3Trajectory::transformation_pair(const Vector6d &q)
-{
-  Matrix4d R;
-  R.block<3, 3>(0, 0) = AttitudeHelpers::EulerToRotation(q.tail(3));
-  R.block<1, 3>(3, 0).fill(0);
-  R.block<3, 1>(0, 3).fill(0);
-  R(3, 3) = 1;
-
-  Matrix4d T = Matrix4d::Identity();
-  T.block<3, 1>(0, 3) = -q.head(3);
-
-  pair<Matrix4d, Matrix4d> result;
-  result.first = R.transpose() * T;  // NED -> BODY
-
-  T.block<3, 1>(0, 3) = q.head(3);
-  result.second = T * R;  // BODY -> NED
-
-  return result;
+  Array6d umax = umax_v.array();
+  Array6d e = (q - r).array() / umax;
+  Array6d edot = (qdot - rdot).array() / umax;
+  Array6d edotdot = (qdotdot - rdotdot).array() / umax;
+
+  Array6d edotmin = (vmin - rdot).array() / umax;
+  Array6d edotmax = (vmax - rdot).array() / umax;
+  Array6d edotdotmin = (amin - rdotdot).array() / umax;
+  Array6d edotdotmax = (amax - rdotdot).array() / umax;
+
+  Array6d delta = edot + edotdot * edotdot.abs() / 2;
+  Array6d sd = sign(delta);
+  Array6d edotdot2 = edotdot.square();
+
+  Array6d S_max = e - edotdotmax * (edotdot2 - 2 * edot) / 4 - (edotdot2 - 2 * edot).square() / (8 * edotdotmax) -
+                  edotdot * (3 * edot - edotdot2) / 3;
+  Array6d S_min = e - edotdotmin * (edotdot2 + 2 * edot) / 4 - (edotdot2 + 2 * edot).square() / (8 * edotdotmin) +
+                  edotdot * (3 * edot + edotdot2) / 3;
+  Array6d S_mid = e + edot * edotdot * sd - edotdot.cube() / 6 * (1 - 3 * sd.abs()) +
+                  sd / 4 * (2 * (edotdot2 + 2 * edot * sd).cube()).sqrt();
+  Array6d S = ((edotdotmax != 0) && (edotdot <= edotdotmax) && (edot <= edotdot2 / 2 - edotdotmax.square()))
+                  .select(S_max, ((edotdotmin != 0) && (edotdot >= edotdotmin) &&
+                                  (edot >= edotdotmin.square() - edotdot2 / 2))
+                                     .select(S_min, S_mid));
+
+  Array6d uc = -umax * sign(S + (1 - sign(S).abs()) * (delta + (1 - sd.abs()) * edotdot));
+  Array6d uv_emin = uv(edotmin, edot, edotdot, edotdotmin, edotdotmax, umax);
+  Array6d uv_emax = uv(edotmax, edot, edotdot, edotdotmin, edotdotmax, umax);
+
+  return uv_emin.max(uc.min(uv_emax)).matrix();
 }
 
 std::pair<Vector3d, Vector3d> C3Trajectory::limit(const Vector3d &vmin, const Vector3d &vmax, const Vector3d &delta)
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "C3Trajectory.h"
+
+using namespace subjugator;
+using namespace std;
+
+// Compares the six axis C3Trajectory::c3filter against the scalar filter it replaced, called once per axis, and
+// times C3Trajectory::update, to check the generator can keep up at a given rate.
+//
+// Usage: benchmark_c3filter [iterations]
+
+namespace
+{
+// is the scalar C3 filter as it was before it evaluated all six axes at once, to compare against
+double sign(double x)
+{
+  if (x > 0)
+    return 1;
+  if (x < 0)
+    return -1;
+  return 0;
+}
+
+double deltav(double v, double edot, double edotdot)
+{
+  return edotdot * abs(edotdot) + 2 * (edot - v);
+}
+
+double ucv(double v, double edot, double edotdot, double umax)
+{
+  double tmp = deltav(v, edot, edotdot);
+  return -umax * sign(tmp + (1 - abs(sign(tmp))) * edotdot);
+}
+
+double ua(double a, double edotdot, double umax)
+{
+  return -umax * sign(edotdot - a);
+}
+
+double uv(double v, double edot, double edotdot, double edotdotmin, double edotdotmax, double umax)
+{
+  return max(ua(edotdotmin, edotdot, umax), min(ucv(v, edot, edotdot, umax), ua(edotdotmax, edotdot, umax)));
+}
+
+double legacy_c3filter(double q, double qdot, double qdotdot, double r, double rdot, double rdotdot, double vmin,
+                       double vmax, double amin, double amax, double umax)
+{
+  double e = (q - r) / umax;
+  double edot = (qdot - rdot) / umax;
+  double edotdot = (qdotdot - rdotdot) / umax;
+
+  double edotmin = (vmin - rdot) / umax;
+  double edotmax = (vmax - rdot) / umax;
+  double edotdotmin = (amin - rdotdot) / umax;
+  double edotdotmax = (amax - rdotdot) / umax;
+
+  double delta = edot + edotdot * abs(edotdot) / 2;
+  double sd = sign(delta);
+
+  double S;
+  if (edotdotmax != 0 && edotdot <= edotdotmax && edot <= pow(edotdot, 2) / 2 - pow(edotdotmax, 2))
+  {
+    S = e - edotdotmax * (pow(edotdot, 2) - 2 * edot) / 4 - pow(pow(edotdot, 2) - 2 * edot, 2) / (8 * edotdotmax) -
+        edotdot * (3 * edot - pow(edotdot, 2)) / 3;
+  }
+  else if (edotdotmin != 0 && edotdot >= edotdotmin && edot >= pow(edotdotmin, 2) - pow(edotdot, 2) / 2)
+  {
+    S = e - edotdotmin * (pow(edotdot, 2) + 2 * edot) / 4 - pow(pow(edotdot, 2) + 2 * edot, 2) / (8 * edotdotmin) +
+        edotdot * (3 * edot + pow(edotdot, 2)) / 3;
+  }
+  else
+  {
+    S = e + edot * edotdot * sd - (pow(edotdot, 3)) / 6 * (1 - 3 * abs(sd)) +
+        sd / 4 * sqrt(2 * pow(pow(edotdot, 2) + 2 * edot * sd, 3));
+  }
+
+  double uc = -umax * sign(S + (1 - abs(sign(S))) * (delta + (1 - abs(sd)) * edotdot));
+  double uv_emin = uv(edotmin, edot, edotdot, edotdotmin, edotdotmax, umax);
+  double uv_emax = uv(edotmax, edot, edotdot, edotdotmin, edotdotmax, umax);
+
+  return max(uv_emin, min(uc, uv_emax));
+}
+
+// is one set of arguments to the filter
+struct FilterInput
+{
+  Vector6d q, qdot, qdotdot, r, rdot, rdotdot, vmin, vmax, amin, amax, umax;
+};
+
+template <typename Function>
+double time_per_call_us(unsigned int iterations, Function const &function)
+{
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (unsigned int i = 0; i < iterations; i++)
+    function(i);
+  chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int const iterations = argc > 1 ? atoi(argv[1]) : 200000;
+
+  // Limits like those the sub uses, with states and references around them
+  Vector6d vmax_b, amax_b, umax_b;
+  vmax_b << 0.7, 0.35, 0.5, 0.75, 0.5, 300;
+  amax_b << 0.35, 0.15, 0.25, 1.5, 0.2, 300;
+  umax_b << 1, 1, 1, 1, 1, 10;
+
+  mt19937 gen(0);
+  uniform_real_distribution<double> uniform(-1, 1);
+  auto random6 = [&]() { return Vector6d(Vector6d::NullaryExpr([&](Eigen::Index) { return uniform(gen); })); };
+  vector<FilterInput> inputs(1024);
+  for (FilterInput &in : inputs)
+  {
+    in.q = 3 * random6();
+    in.qdot = random6().cwiseProduct(vmax_b);
+    in.qdotdot = random6().cwiseProduct(amax_b);
+    in.r = 3 * random6();
+    in.rdot = 0.5 * random6().cwiseProduct(vmax_b);
+    in.rdotdot = Vector6d::Zero();
+    in.vmin = -vmax_b;
+    in.vmax = vmax_b;
+    in.amin = -amax_b;
+    in.amax = amax_b;
+    in.umax = umax_b;
+  }
+
+  unsigned int mismatches = 0;
+  for (FilterInput const &in : inputs)
+  {
+    Vector6d u = C3Trajectory::c3filter(in.q, in.qdot, in.qdotdot, in.r, in.rdot, in.rdotdot, in.vmin, in.vmax,
+                                        in.amin, in.amax, in.umax);
+    for (int i = 0; i < 6; i++)
+    {
+      double legacy = legacy_c3filter(in.q(i), in.qdot(i), in.qdotdot(i), in.r(i), in.rdot(i), in.rdotdot(i),
+                                      in.vmin(i), in.vmax(i), in.amin(i), in.amax(i), in.umax(i));
+      if (abs(u(i) - legacy) > 1e-9)
+        mismatches++;
+    }
+  }
+  cout << "six axis against scalar filter: " << mismatches << " of " << 6 * inputs.size() << " outputs differ"
+       << endl;
+
+  double checksum = 0;
+  double legacy_us = time_per_call_us(iterations, [&](unsigned int k) {
+    FilterInput const &in = inputs[k % inputs.size()];
+    for (int i = 0; i < 6; i++)
+      checksum += legacy_c3filter(in.q(i), in.qdot(i), in.qdotdot(i), in.r(i), in.rdot(i), in.rdotdot(i),
+                                  in.vmin(i), in.vmax(i), in.amin(i), in.amax(i), in.umax(i));
+  });
+  double vector_us = time_per_call_us(iterations, [&](unsigned int k) {
+    FilterInput const &in = inputs[k % inputs.size()];
+    checksum += C3Trajectory::c3filter(in.q, in.qdot, in.qdotdot, in.r, in.rdot, in.rdotdot, in.vmin, in.vmax,
+                                       in.amin, in.amax, in.umax)
+                    .sum();
+  });
+  cout << "scalar filter, six axes: " << legacy_us << " us" << endl;
+  cout << "six axis filter: " << vector_us << " us" << endl;
+
+  // A move with a turn, then holding heading, stepped at traj_dt as the node does
+  C3Trajectory::Limits limits;
+  limits.vmin_b = -vmax_b;
+  limits.vmax_b = vmax_b;
+  limits.amin_b = -amax_b;
+  limits.amax_b = amax_b;
+  limits.arevoffset_b = Eigen::Vector3d::Zero();
+  limits.umax_b = umax_b;
+  C3Trajectory trajectory(C3Trajectory::Point(Vector6d::Zero(), Vector6d::Zero()), limits);
+  Vector6d goal;
+  goal << 5, 2, -1, 0, 0, 1;
+  C3Trajectory::Waypoint waypoint(C3Trajectory::Point(goal, Vector6d::Zero()));
+  double const dt = 0.0001;
+  double update_us = time_per_call_us(iterations, [&](unsigned int k) { trajectory.update(dt, waypoint, k * dt); });
+  checksum += trajectory.getCurrentPoint().q.sum();
+  cout << "update: " << update_us << " us, " << 1e6 * dt / update_us << "x real time at dt = " << dt << " s" << endl;
+  cout << "(checksum " << checksum << ")" << endl;
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,18 @@
+#include <nodelet/loader.h>
+#include <ros/ros.h>
+
+// Runs the c3_trajectory_generator/nodelet plugin on its own, like nodelet standalone, under this node's name
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "c3_trajectory_generator");
+
+  nodelet::Loader loader(false);
+  nodelet::M_string remappings;
+  nodelet::V_string my_argv;
+  if (!loader.load(ros::this_node::getName(), "c3_trajectory_generator/nodelet", remappings, my_argv))
+    return 1;
+
+  ros::spin();
+
+  return 0;
+}
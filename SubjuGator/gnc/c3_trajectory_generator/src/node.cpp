@@ -1,23 +1,36 @@
 #include <actionlib/server/simple_action_server.h>
 #include <geometry_msgs/PoseStamped.h>
 #include <nav_msgs/Odometry.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.hpp>
 #include <ros/ros.h>
 #include <tf/transform_listener.h>
 
 #include <mil_msgs/PoseTwistStamped.h>
+#include <mil_msgs/PoseTwistTrajectory.h>
+#include <mil_tools/driver_diagnostics.hpp>
 #include <mil_tools/msg_helpers.hpp>
 #include <mil_tools/param_helpers.hpp>
+#include <mil_tools/thread_policy.hpp>
+#include <mil_tools/trace.hpp>
 #include <ros_alarms/listener.hpp>
 
 #include <mil_msgs/MoveToAction.h>
 #include "C3Trajectory.h"
+#include "c3_trajectory_generator/FollowPathAction.h"
+#include "c3_trajectory_generator/CheckPoses.h"
 #include "c3_trajectory_generator/SetDisabled.h"
 
 #include <waypoint_validity.hpp>
 
 #include <boost/assign/list_of.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/unordered_map.hpp>
 
+#include <atomic>
+#include <memory>
+#include <thread>
+
 using namespace std;
 using namespace geometry_msgs;
 using namespace nav_msgs;
@@ -25,6 +38,8 @@ using namespace mil_msgs;
 using namespace mil_tools;
 using namespace c3_trajectory_generator;
 
+namespace
+{
 const boost::unordered_map<WAYPOINT_ERROR_TYPE, const std::string> WAYPOINT_ERROR_TO_STRING =
     boost::assign::map_list_of(WAYPOINT_ERROR_TYPE::OCCUPIED, "OCCUPIED")(WAYPOINT_ERROR_TYPE::UNKNOWN, "UNKNOWN")(
         WAYPOINT_ERROR_TYPE::UNOCCUPIED, "UNOCCUPIED")(WAYPOINT_ERROR_TYPE::ABOVE_WATER, "ABOVE_WATER")(
@@ -83,10 +98,77 @@ Pose Pose_from_Waypoint(const subjugator::C3Trajectory::Waypoint &wp)
   return res;
 }
 
+// A path being followed. Each waypoint but the last is left for the next once the trajectory is within blend_radius
+// of it, without waiting for it to stop there, so velocity carries over from one segment to the next.
+struct Path
+{
+  std::vector<subjugator::C3Trajectory::Waypoint> waypoints;
+  double blend_radius;
+  double linear_tolerance, angular_tolerance;
+  size_t index;   // waypoint being moved to
+  bool checked;   // the plan was checked against the ogrid
+  ros::Time start_t;
+
+  // Only read once planned is set, written by plan_path before that
+  std::vector<Pose> samples;  // poses along the whole path, every sample_dt
+  double sample_dt;
+  double planned_time;  // seconds from the start to the last waypoint, or -1 if it was not reached
+  std::atomic<bool> planned;
+  std::atomic<bool> cancelled;
+
+  Path() : index(0), checked(false), planned_time(-1), planned(false), cancelled(false)
+  {
+  }
+
+  // Waypoint to move to from point, while moving to waypoint index
+  size_t next_index(size_t index, const subjugator::C3Trajectory::Point &point) const
+  {
+    if (index + 1 < waypoints.size() && (point.q.head(3) - waypoints[index].r.q.head(3)).norm() < blend_radius)
+      return index + 1;
+    return index;
+  }
+};
+
+// Simulates the whole path from trajectory with the same steps and the same rule for moving on as the timer, so
+// the result is what the sub will do, and stores the poses on it. Runs on its own thread, as a long path can take
+// a good part of a second to simulate.
+void plan_path(boost::shared_ptr<Path> path, subjugator::C3Trajectory trajectory, double dt, double max_time)
+{
+  int sample_steps = std::max(1, (int)std::round(path->sample_dt / dt));
+  long max_steps = max_time / dt;
+  size_t index = 0;
+  double waypoint_t = 0;
+  for (long step = 0; step < max_steps && !path->cancelled; step++)
+  {
+    subjugator::C3Trajectory::PointWithAcceleration p = trajectory.getCurrentPoint();
+    if (step % sample_steps == 0)
+      path->samples.push_back(Pose_from_Waypoint(p));
+    size_t next = path->next_index(index, p);
+    if (next != index)
+    {
+      index = next;
+      waypoint_t = 0;
+    }
+    if (index + 1 == path->waypoints.size() &&
+        p.is_approximately(path->waypoints[index].r, max(1e-3, path->linear_tolerance),
+                           max(1e-3, path->angular_tolerance)))
+    {
+      path->samples.push_back(Pose_from_Waypoint(p));
+      path->planned_time = step * dt;
+      break;
+    }
+    trajectory.update(dt, path->waypoints[index], waypoint_t);
+    waypoint_t += dt;
+  }
+  path->planned = true;
+}
+
 struct Node
 {
   ros::NodeHandle nh;
   ros::NodeHandle private_nh;
+  // nh on the bulk queue, for the ogrid and the action servers' goals, which are only polled from the update
+  ros::NodeHandle bulk_nh;
   tf::TransformListener tf_listener;
   ros_alarms::AlarmListener<> kill_listener;
 
@@ -97,12 +179,18 @@ struct Node
 
   ros::Subscriber odom_sub;
   actionlib::SimpleActionServer<mil_msgs::MoveToAction> actionserver;
+  actionlib::SimpleActionServer<FollowPathAction> path_server;
   ros::Publisher trajectory_pub;
+  ros::Publisher preview_pub;
   ros::Publisher trajectory_vis_pub;
   ros::Publisher waypoint_pose_pub;
   ros::ServiceServer set_disabled_service;
+  ros::ServiceServer check_poses_service;
 
   ros::Timer update_timer;
+  // Latency of update_timer is how late each update wakes up
+  std::unique_ptr<DriverDiagnostics> diagnostics;
+  StreamMonitor *update_monitor;
 
   bool disabled;
   boost::scoped_ptr<subjugator::C3Trajectory> c3trajectory;
@@ -116,6 +204,22 @@ struct Node
   WaypointValidity waypoint_validity_;
   bool waypoint_check_;
 
+  // How far ahead to check the trajectory, and the step it is simulated with for that
+  double lookahead_time_;
+  double lookahead_dt_;
+  std::vector<subjugator::C3Trajectory::Point> lookahead_points_;
+  std::vector<Pose> lookahead_poses_;
+
+  // How far ahead to publish the trajectory for the controller, and the step between its samples
+  double preview_time_;
+  double preview_dt_;
+  std::vector<subjugator::C3Trajectory::PointWithAcceleration> preview_points_;
+  PoseTwistTrajectory preview_msg_;
+
+  // Path being followed, if any, and how much of it plan_path may simulate
+  boost::shared_ptr<Path> path_;
+  double path_plan_time_;
+
   bool set_disabled(SetDisabledRequest &request, SetDisabledResponse &response)
   {
     disabled = request.disabled;
@@ -126,12 +230,36 @@ struct Node
     return true;
   }
 
-  Node()
-    : private_nh("~")
-    , actionserver(nh, "moveto", false)
+  bool check_poses(CheckPosesRequest &request, CheckPosesResponse &response)
+  {
+    std::vector<WaypointValidity::Check> checks;
+    if (request.polyline_ends.empty())
+      waypoint_validity_.check_poses(request.poses, checks);
+    else
+      waypoint_validity_.check_polylines(request.poses, request.polyline_ends, checks);
+    response.valid.resize(checks.size());
+    response.error.resize(checks.size());
+    response.clearance.resize(checks.size());
+    response.first_invalid.resize(checks.size());
+    for (size_t i = 0; i < checks.size(); ++i)
+    {
+      response.valid[i] = checks[i].valid;
+      response.error[i] = (uint8_t)checks[i].error;
+      response.clearance[i] = checks[i].clearance;
+      response.first_invalid[i] = checks[i].first_invalid;
+    }
+    return true;
+  }
+
+  Node(ros::NodeHandle nh_, ros::NodeHandle private_nh_, ros::NodeHandle bulk_nh_)
+    : nh(nh_)
+    , private_nh(private_nh_)
+    , bulk_nh(bulk_nh_)
+    , actionserver(bulk_nh, "moveto", false)
+    , path_server(bulk_nh, "follow_path", false)
     , disabled(false)
     , kill_listener(nh, "kill")
-    , waypoint_validity_(nh)
+    , waypoint_validity_(bulk_nh)
   {
     // Make sure alarm integration is ok
     kill_listener.waitForUpdate(ros::Duration(10));
@@ -139,6 +267,8 @@ struct Node
       throw std::runtime_error("The kill listener isn't connected to the alarm server");
     kill_listener.start();  // Fuck.
 
+    mil_tools::Tracer::instance().configure(private_nh);
+
     fixed_frame = mil_tools::getParam<std::string>(private_nh, "fixed_frame");
     body_frame = mil_tools::getParam<std::string>(private_nh, "body_frame");
 
@@ -151,19 +281,111 @@ struct Node
     traj_dt = mil_tools::getParam<ros::Duration>(private_nh, "traj_dt", ros::Duration(0.0001));
 
     waypoint_check_ = mil_tools::getParam<bool>(private_nh, "waypoint_check");
+    lookahead_time_ = mil_tools::getParam<double>(private_nh, "lookahead_time", 0);
+    lookahead_dt_ = mil_tools::getParam<double>(private_nh, "lookahead_dt", 0.05);
+    path_plan_time_ = mil_tools::getParam<double>(private_nh, "path_plan_time", 300);
+    preview_time_ = mil_tools::getParam<double>(private_nh, "preview_time", 0);
+    preview_dt_ = mil_tools::getParam<double>(private_nh, "preview_dt", 0.05);
 
     odom_sub = nh.subscribe<Odometry>("odom", 1, boost::bind(&Node::odom_callback, this, _1));
 
     trajectory_pub = nh.advertise<PoseTwistStamped>("trajectory", 1);
+    if (preview_time_ > 0)
+      preview_pub = nh.advertise<PoseTwistTrajectory>("trajectory_preview", 1);
     trajectory_vis_pub = private_nh.advertise<PoseStamped>("trajectory_v", 1);
     waypoint_pose_pub = private_nh.advertise<PoseStamped>("waypoint", 1);
 
+    diagnostics.reset(new DriverDiagnostics(nh, private_nh, private_nh.getNamespace(), "c3_trajectory_generator"));
+    update_monitor = &diagnostics->stream("update_timer");
     update_timer = nh.createTimer(ros::Duration(1. / 50), boost::bind(&Node::timer_callback, this, _1));
 
     actionserver.start();
+    path_server.start();
 
     set_disabled_service = private_nh.advertiseService<SetDisabledRequest, SetDisabledResponse>(
         "set_disabled", boost::bind(&Node::set_disabled, this, _1, _2));
+    // On the bulk thread, so a large query never holds up the update
+    check_poses_service = bulk_nh.advertiseService<CheckPosesRequest, CheckPosesResponse>(
+        private_nh.resolveName("check_poses"), boost::bind(&Node::check_poses, this, _1, _2));
+
+    // Last, since the ogrid is received on the bulk thread, which is already running
+    waypoint_validity_.subscribe();
+  }
+
+  // Stop following the path, if there is one, and end its goal with error
+  void abort_path(const std::string &error)
+  {
+    if (path_)
+      path_->cancelled = true;
+    path_.reset();
+    if (path_server.isActive())
+    {
+      FollowPathResult result;
+      result.error = error;
+      result.success = false;
+      path_server.setAborted(result);
+    }
+  }
+
+  // Start following the path in goal and planning it in the background, unless a waypoint on it can't be moved to
+  void start_path(const FollowPathGoal &goal)
+  {
+    FollowPathResult result;
+    result.success = false;
+    if (goal.posetwists.empty() || (!goal.speeds.empty() && goal.speeds.size() != goal.posetwists.size()))
+    {
+      result.error = "path needs waypoints, and a speed for each or none";
+      path_server.setAborted(result);
+      return;
+    }
+
+    boost::shared_ptr<Path> path = boost::make_shared<Path>();
+    for (size_t i = 0; i < goal.posetwists.size(); i++)
+    {
+      subjugator::C3Trajectory::Waypoint waypoint(
+          Point_from_PoseTwist(goal.posetwists[i].pose, goal.posetwists[i].twist),
+          goal.speeds.empty() ? 0 : goal.speeds[i], !goal.uncoordinated, !goal.blind);
+      std::pair<bool, WAYPOINT_ERROR_TYPE> checkWPResult =
+          waypoint_validity_.is_waypoint_valid(Pose_from_Waypoint(waypoint), waypoint.do_waypoint_validation);
+      if (checkWPResult.first == false && waypoint_check_ &&
+          (checkWPResult.second == WAYPOINT_ERROR_TYPE::OCCUPIED ||
+           checkWPResult.second == WAYPOINT_ERROR_TYPE::ABOVE_WATER))
+      {
+        ROS_ERROR("can't follow path! - waypoint %zu is %s", i,
+                  WAYPOINT_ERROR_TO_STRING.at(checkWPResult.second).c_str());
+        waypoint_validity_.pub_size_ogrid(Pose_from_Waypoint(waypoint), (int)OGRID_COLOR::RED);
+        result.error = WAYPOINT_ERROR_TO_STRING.at(checkWPResult.second);
+        path_server.setAborted(result);
+        return;
+      }
+      path->waypoints.push_back(waypoint);
+    }
+    path->linear_tolerance = goal.linear_tolerance;
+    path->angular_tolerance = goal.angular_tolerance;
+    path->blend_radius = max(goal.blend_radius, max(1e-3, goal.linear_tolerance));
+    path->sample_dt = lookahead_dt_;
+    path->start_t = c3trajectory_t;
+
+    path_ = path;
+    current_waypoint = path->waypoints[0];
+    current_waypoint_t = c3trajectory_t;
+    waypoint_validity_.pub_size_ogrid(Pose_from_Waypoint(path->waypoints.back()), (int)OGRID_COLOR::GREEN);
+    std::thread(plan_path, path, *c3trajectory, traj_dt.toSec(), path_plan_time_).detach();
+  }
+
+  // Simulates the next preview_time_ of the trajectory toward the current waypoint, the same way the look-ahead does,
+  // and publishes it with the current point first, so the controller can track what is coming
+  void publish_preview(const std_msgs::Header &header)
+  {
+    c3trajectory->rollout(preview_dt_, current_waypoint, (c3trajectory_t - current_waypoint_t).toSec(),
+                          std::ceil(preview_time_ / preview_dt_), preview_points_);
+    preview_msg_.header = header;
+    preview_msg_.dt = preview_dt_;
+    preview_msg_.posetwists.resize(preview_points_.size() + 1);
+    preview_msg_.posetwists[0] = PoseTwist_from_PointWithAcceleration(c3trajectory->getCurrentPoint());
+    for (size_t i = 0; i < preview_points_.size(); i++)
+      preview_msg_.posetwists[i + 1] = PoseTwist_from_PointWithAcceleration(preview_points_[i]);
+    preview_pub.publish(preview_msg_);
   }
 
   void odom_callback(const OdometryConstPtr &odom)
@@ -186,8 +408,9 @@ struct Node
     current_waypoint_t = now;
   }
 
-  void timer_callback(const ros::TimerEvent &)
+  void timer_callback(const ros::TimerEvent &event)
   {
+    update_monitor->published(event.current_expected, event.current_real);
     mil_msgs::MoveToResult actionresult;
 
     // Handle disabled, killed, or no odom before attempting to produce trajectory
@@ -213,9 +436,15 @@ struct Node
         actionresult.success = false;
         actionserver.setAborted(actionresult);
       }
+      if (path_server.isNewGoalAvailable())
+        path_server.acceptNewGoal();
+      abort_path(err);
       return;
     }
 
+    // Waypoints are checked against the ogrid, so each step is part of the trace of the data behind it
+    mil_tools::TraceSpan span("c3.update", waypoint_validity_.origin());
+
     ros::Time now = ros::Time::now();
 
     auto old_waypoint = current_waypoint;
@@ -223,6 +452,7 @@ struct Node
     if (actionserver.isNewGoalAvailable())
     {
       boost::shared_ptr<const mil_msgs::MoveToGoal> goal = actionserver.acceptNewGoal();
+      abort_path("preempted by a moveto goal");
       current_waypoint =
           subjugator::C3Trajectory::Waypoint(Point_from_PoseTwist(goal->posetwist.pose, goal->posetwist.twist),
                                              goal->speed, !goal->uncoordinated, !goal->blind);
@@ -270,7 +500,29 @@ struct Node
         }
       }
     }
-    if (actionserver.isPreemptRequested())
+    if (path_server.isNewGoalAvailable())
+    {
+      if (path_)
+        path_->cancelled = true;
+      path_.reset();
+      boost::shared_ptr<const FollowPathGoal> goal = path_server.acceptNewGoal();
+      if (actionserver.isActive())
+      {
+        actionresult.error = "preempted by a path";
+        actionresult.success = false;
+        actionserver.setAborted(actionresult);
+      }
+      start_path(*goal);
+    }
+    bool path_preempted = path_server.isPreemptRequested();
+    if (path_preempted)
+    {
+      if (path_)
+        path_->cancelled = true;
+      path_.reset();
+      path_server.setPreempted();
+    }
+    if (actionserver.isPreemptRequested() || path_preempted)
     {
       current_waypoint = c3trajectory->getCurrentPoint();
       current_waypoint.do_waypoint_validation = false;
@@ -287,10 +539,41 @@ struct Node
 
     while (c3trajectory_t + traj_dt < now)
     {
+      if (path_)
+      {
+        // Move on to the next waypoint the same way plan_path does
+        size_t next = path_->next_index(path_->index, c3trajectory->getCurrentPoint());
+        if (next != path_->index)
+        {
+          path_->index = next;
+          current_waypoint = path_->waypoints[next];
+          current_waypoint_t = c3trajectory_t;
+        }
+      }
       c3trajectory->update(traj_dt.toSec(), current_waypoint, (c3trajectory_t - current_waypoint_t).toSec());
       c3trajectory_t += traj_dt;
     }
 
+    // Once the path is planned, check all of it against the ogrid, and stop now rather than partway along it
+    if (path_ && path_->planned && !path_->checked)
+    {
+      path_->checked = true;
+      if (path_->planned_time < 0)
+        ROS_WARN("path does not reach its last waypoint within %.0fs", path_plan_time_);
+      size_t first_invalid;
+      std::pair<bool, WAYPOINT_ERROR_TYPE> pathResult =
+          waypoint_validity_.is_trajectory_valid(path_->samples, current_waypoint.do_waypoint_validation, first_invalid);
+      if (pathResult.first == false && pathResult.second == WAYPOINT_ERROR_TYPE::OCCUPIED && waypoint_check_)
+      {
+        ROS_ERROR("can't follow path! - trajectory hits something %.2fs in", first_invalid * path_->sample_dt);
+        current_waypoint = c3trajectory->getCurrentPoint();
+        current_waypoint.do_waypoint_validation = false;
+        current_waypoint.r.qdot = subjugator::Vector6d::Zero();  // zero velocities
+        current_waypoint_t = now;
+        abort_path(WAYPOINT_ERROR_TO_STRING.at(WAYPOINT_ERROR_TYPE::OCCUPIED_TRAJECTORY));
+      }
+    }
+
     // Check if we will hit something while in trajectory the new trajectory
     geometry_msgs::Pose traj_point;  // Convert messages to correct type
     auto p = c3trajectory->getCurrentPoint();
@@ -312,6 +595,32 @@ struct Node
       c3trajectory_t = now;
       actionresult.success = false;
       actionresult.error = WAYPOINT_ERROR_TO_STRING.at(WAYPOINT_ERROR_TYPE::OCCUPIED_TRAJECTORY);
+      abort_path(actionresult.error);
+    }
+    else if (lookahead_time_ > 0 && waypoint_check_ && c3trajectory->do_waypoint_validation)
+    {
+      // Simulate where the trajectory will be for the next lookahead_time_ with a coarser step, so a collision can be
+      // seen while there is still room to slow down
+      c3trajectory->rollout(lookahead_dt_, current_waypoint, (c3trajectory_t - current_waypoint_t).toSec(),
+                            std::ceil(lookahead_time_ / lookahead_dt_), lookahead_points_);
+      lookahead_poses_.resize(lookahead_points_.size());
+      for (size_t i = 0; i < lookahead_points_.size(); i++)
+        lookahead_poses_[i] = Pose_from_Waypoint(lookahead_points_[i]);
+      size_t first_invalid;
+      std::pair<bool, WAYPOINT_ERROR_TYPE> lookaheadResult =
+          waypoint_validity_.is_trajectory_valid(lookahead_poses_, true, first_invalid);
+      if (lookaheadResult.first == false && lookaheadResult.second == WAYPOINT_ERROR_TYPE::OCCUPIED)
+      {  // Trajectory will hit an occupied cell soon, so stop where it is now. The trajectory stays continuous, so
+         // it slows down within its limits.
+        ROS_ERROR("can't move there! - trajectory hits something in %.2fs", (first_invalid + 1) * lookahead_dt_);
+        current_waypoint = c3trajectory->getCurrentPoint();
+        current_waypoint.do_waypoint_validation = false;
+        current_waypoint.r.qdot = subjugator::Vector6d::Zero();  // zero velocities
+        current_waypoint_t = now;
+        actionresult.success = false;
+        actionresult.error = WAYPOINT_ERROR_TO_STRING.at(WAYPOINT_ERROR_TYPE::OCCUPIED_TRAJECTORY);
+        abort_path(actionresult.error);
+      }
     }
 
     PoseTwistStamped msg;
@@ -319,6 +628,8 @@ struct Node
     msg.header.frame_id = fixed_frame;
     msg.posetwist = PoseTwist_from_PointWithAcceleration(c3trajectory->getCurrentPoint());
     trajectory_pub.publish(msg);
+    if (preview_time_ > 0 && preview_pub.getNumSubscribers() > 0)
+      publish_preview(msg.header);
 
     waypoint_validity_.pub_size_ogrid(Pose_from_Waypoint(c3trajectory->getCurrentPoint()), 200);
 
@@ -342,16 +653,80 @@ struct Node
       actionresult.success = true;
       actionserver.setSucceeded(actionresult);
     }
+
+    if (path_ && path_server.isActive())
+    {
+      if (path_->index + 1 == path_->waypoints.size() &&
+          c3trajectory->getCurrentPoint().is_approximately(current_waypoint.r, max(1e-3, path_->linear_tolerance),
+                                                           max(1e-3, path_->angular_tolerance)) &&
+          current_waypoint.r.qdot == subjugator::Vector6d::Zero())
+      {
+        FollowPathResult result;
+        result.success = true;
+        path_server.setSucceeded(result);
+        path_.reset();
+      }
+      else
+      {
+        FollowPathFeedback feedback;
+        feedback.current_waypoint = path_->index;
+        feedback.time_remaining = -1;
+        if (path_->planned && path_->planned_time >= 0)
+          feedback.time_remaining = max(0., path_->planned_time - (c3trajectory_t - path_->start_t).toSec());
+        path_server.publishFeedback(feedback);
+      }
+    }
   }
 };
 
-int main(int argc, char **argv)
+}  // namespace
+
+namespace c3_trajectory_generator
+{
+// The trajectory generator as a nodelet, so odom and the ogrid are passed as pointers from nodelets in the same
+// manager. The c3_trajectory_generator executable loads it on its own.
+class Nodelet : public nodelet::Nodelet
 {
-  ros::init(argc, argv, "c3_trajectory_generator");
+public:
+  ~Nodelet()
+  {
+    // No callback may run while the node goes away, and none may be queued for the threads once it has
+    if (thread_)
+      thread_->stop();
+    bulk_thread_->stop();
+    node_.reset();
+    thread_.reset();
+    bulk_thread_.reset();
+  }
 
-  Node n;
+  virtual void onInit()
+  {
+    ros::NodeHandle nh = getNodeHandle();
+    ros::NodeHandle private_nh = getPrivateNodeHandle();
+    // With a thread_policy, the 50 Hz update and the other callbacks on nh run on a thread of its own under it rather
+    // than taking its turn on the manager's workers
+    ThreadPolicy policy = ThreadPolicy::from_params(private_nh, "thread_policy");
+    if (!policy.empty())
+    {
+      thread_.reset(new CallbackThread(getName(), policy));
+      nh.setCallbackQueue(thread_->queue());
+      private_nh.setCallbackQueue(thread_->queue());
+    }
+    // The ogrid, whose clearance can take a while to compute, and action goals are handled on a thread of their own,
+    // under bulk_thread_policy if set, so the update never waits behind them
+    bulk_thread_.reset(
+        new CallbackThread(getName() + "/bulk", ThreadPolicy::from_params(private_nh, "bulk_thread_policy")));
+    ros::NodeHandle bulk_nh = getNodeHandle();
+    bulk_nh.setCallbackQueue(bulk_thread_->queue());
+    node_.reset(new Node(nh, private_nh, bulk_nh));
+  }
 
-  ros::spin();
+private:
+  std::unique_ptr<CallbackThread> thread_;
+  std::unique_ptr<CallbackThread> bulk_thread_;
+  std::unique_ptr<Node> node_;
+};
 
-  return 0;
-}
+}  // namespace c3_trajectory_generator
+
+PLUGINLIB_EXPORT_CLASS(c3_trajectory_generator::Nodelet, nodelet::Nodelet);
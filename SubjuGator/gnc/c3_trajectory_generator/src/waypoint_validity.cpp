@@ -1,31 +1,62 @@
 #include "waypoint_validity.hpp"
 
-// Point and sub_size must be relative to ogrid (IE, in ogrid-cell units)
-bool WaypointValidity::check_if_hit(cv::Point center, cv::Size sub_size)
+#include <mil_ogrid/grid_delta.hpp>
+#include <mil_tools/trace.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+// Point must be relative to ogrid (IE, in ogrid-cell units)
+bool WaypointValidity::check_if_hit(cv::Point center) const
 {
-  for (int x = center.x - sub_size.width / 2; x < center.x + sub_size.width / 2; ++x)
+  if (!mil_ogrid::GridGeometry::from_info(ogrid_map_->info).contains(center))
+    return true;
+  // Something occupied within the sub's half width, in either axis, is under the sub
+  return sub_half_cells_ > 0 && clearance_.at(center) <= sub_half_cells_;
+}
+
+void WaypointValidity::ogrid_callback(const nav_msgs::OccupancyGridConstPtr &ogrid_map)
+{
+  mil_tools::TraceSpan span("waypoint_validity.ogrid", ogrid_map->info.map_load_time);
+  nav_msgs::OccupancyGridConstPtr map = ogrid_map;
+  nav_msgs::OccupancyGridPtr copy;
+  if (use_ogrid_updates_)
   {
-    for (int y = center.y - sub_size.height / 2; y < center.y + sub_size.height / 2; ++y)
-    {
-      try
-      {
-        if (ogrid_map_->data.at(x + y * ogrid_map_->info.width) == (uchar)WAYPOINT_ERROR_TYPE::OCCUPIED)
-        {
-          return true;
-        }
-      }
-      catch (std::out_of_range &e)
-      {
-        return true;
-      }
-    }
+    // Keep a mutable copy so partial updates can be applied in place
+    copy = boost::make_shared<nav_msgs::OccupancyGrid>(*ogrid_map);
+    map = copy;
   }
-  return false;
+  // The new ogrid's clearance is computed before locking, so checks only ever wait for it to be swapped in.
+  // check_if_hit only needs to know whether the distance is above sub_half_cells_.
+  // Bulk checks also measure up to clearance_range_ beyond that.
+  int sub_half_cells = int(sub_ogrid_size_ / map->info.resolution) / 2;
+  int range_cells = int(std::ceil(clearance_range_ / map->info.resolution));
+  next_clearance_.compute(map->data.data(), map->info.width, map->info.height, mil_ogrid::OCCUPIED,
+                          std::min(sub_half_cells + 1 + range_cells, 0xffff));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  origin_ = ogrid_map->info.map_load_time;
+  ogrid_map_ = map;
+  ogrid_copy_ = copy;
+  sub_half_cells_ = sub_half_cells;
+  std::swap(clearance_, next_clearance_);
 }
 
-void WaypointValidity::ogrid_callback(const nav_msgs::OccupancyGridConstPtr &ogrid_map)
+void WaypointValidity::ogrid_update_callback(const map_msgs::OccupancyGridUpdateConstPtr &update)
 {
-  this->ogrid_map_ = ogrid_map;
+  // Updates are small, so are applied in place with checks waiting on them
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Updates can only be applied once a full ogrid has been received
+  if (!ogrid_copy_)
+    return;
+  mil_tools::TraceSpan span("waypoint_validity.update", origin_);
+  cv::Rect changed = mil_ogrid::apply_update(*ogrid_copy_, *update);
+  if (changed.empty())
+    return;
+  ogrid_copy_->header.stamp = update->header.stamp;
+  clearance_.update(ogrid_copy_->data.data(), changed);
 }
 
 // Convert waypoint to be relative to ogrid, then do a series of checks (unknown, occupied, or above water).
@@ -35,6 +66,12 @@ std::pair<bool, WAYPOINT_ERROR_TYPE> WaypointValidity::is_waypoint_valid(const g
 {
   if (!do_waypoint_validation)
     return std::make_pair(true, WAYPOINT_ERROR_TYPE::NOT_CHECKED);
+  std::lock_guard<std::mutex> lock(mutex_);
+  return waypoint_valid(waypoint);
+}
+
+std::pair<bool, WAYPOINT_ERROR_TYPE> WaypointValidity::waypoint_valid(const geometry_msgs::Pose &waypoint)
+{
   if (waypoint.position.z > 0.2)
   {
     return std::make_pair(false, WAYPOINT_ERROR_TYPE::ABOVE_WATER);
@@ -45,64 +82,185 @@ std::pair<bool, WAYPOINT_ERROR_TYPE> WaypointValidity::is_waypoint_valid(const g
     return std::make_pair(false, WAYPOINT_ERROR_TYPE::NO_OGRID);
   }
 
-  cv::Point center_of_ogrid =
-      cv::Point(ogrid_map_->info.origin.position.x, ogrid_map_->info.origin.position.y) +
-      cv::Point(ogrid_map_->info.width, ogrid_map_->info.height) * ogrid_map_->info.resolution / 2;
-  cv::Point where_sub =
-      cv::Point((waypoint.position.x - center_of_ogrid.x) / ogrid_map_->info.resolution + ogrid_map_->info.width / 2,
-                (waypoint.position.y - center_of_ogrid.y) / ogrid_map_->info.resolution + ogrid_map_->info.height / 2);
-
-  // Area we want to check around the sub
-  int sub_x = sub_ogrid_size_ / ogrid_map_->info.resolution;
-  int sub_y = sub_ogrid_size_ / ogrid_map_->info.resolution;
-
-  if (check_if_hit(where_sub, cv::Size(sub_x, sub_y)))
+  cv::Point where_sub = to_cell(waypoint);
+  if (check_if_hit(where_sub))
   {
     return std::make_pair(false, WAYPOINT_ERROR_TYPE::OCCUPIED);
   }
-  try
+  // check_if_hit made sure where_sub is in the ogrid
+  if ((uchar)ogrid_map_->data[where_sub.x + where_sub.y * ogrid_map_->info.width] ==
+      (uchar)WAYPOINT_ERROR_TYPE::UNKNOWN)
   {
-    if (ogrid_map_->data.at(where_sub.x + where_sub.y * ogrid_map_->info.width) == (uchar)WAYPOINT_ERROR_TYPE::UNKNOWN)
+    return std::make_pair(false, WAYPOINT_ERROR_TYPE::UNKNOWN);
+  }
+
+  return std::make_pair(true, WAYPOINT_ERROR_TYPE::UNOCCUPIED);
+}
+
+std::pair<bool, WAYPOINT_ERROR_TYPE> WaypointValidity::is_trajectory_valid(
+    const std::vector<geometry_msgs::Pose> &waypoints, bool do_waypoint_validation, size_t &first_invalid)
+{
+  first_invalid = waypoints.size();
+  if (!do_waypoint_validation)
+    return std::make_pair(true, WAYPOINT_ERROR_TYPE::NOT_CHECKED);
+  // The whole trajectory is checked against the same ogrid
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < waypoints.size(); ++i)
+  {
+    std::pair<bool, WAYPOINT_ERROR_TYPE> result = waypoint_valid(waypoints[i]);
+    if (!result.first)
     {
-      return std::make_pair(false, WAYPOINT_ERROR_TYPE::UNKNOWN);
+      first_invalid = i;
+      return result;
     }
   }
-  catch (std::out_of_range &e)
+  return std::make_pair(true, WAYPOINT_ERROR_TYPE::UNOCCUPIED);
+}
+
+void WaypointValidity::check_point(const geometry_msgs::Pose &waypoint, Check &check)
+{
+  std::pair<bool, WAYPOINT_ERROR_TYPE> result = waypoint_valid(waypoint);
+  check.valid = result.first;
+  check.error = result.second;
+  check.clearance = 0;
+  if (!check.valid)
+    return;
+  // Cells between the footprint and the nearest occupied one, which waypoint_valid made sure is in the ogrid
+  int gap = int(clearance_.at(to_cell(waypoint))) - sub_half_cells_ - 1;
+  check.clearance = std::max(gap, 0) * ogrid_map_->info.resolution;
+}
+
+void WaypointValidity::check_poses(const std::vector<geometry_msgs::Pose> &poses, std::vector<Check> &checks)
+{
+  checks.resize(poses.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < poses.size(); ++i)
+  {
+    check_point(poses[i], checks[i]);
+    checks[i].first_invalid = checks[i].valid ? -1 : int(i);
+  }
+}
+
+void WaypointValidity::check_polylines(const std::vector<geometry_msgs::Pose> &poses,
+                                       const std::vector<uint32_t> &ends, std::vector<Check> &checks)
+{
+  checks.resize(ends.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  // Segments are sampled every cell, so no cell along them is skipped over
+  const double step = ogrid_map_ ? ogrid_map_->info.resolution : 1.;
+  geometry_msgs::Pose sample;
+  Check point;
+  size_t begin = 0;
+  for (size_t i = 0; i < ends.size(); ++i)
   {
-    return std::make_pair(false, WAYPOINT_ERROR_TYPE::OCCUPIED);
+    Check &check = checks[i];
+    check.valid = true;
+    check.error = WAYPOINT_ERROR_TYPE::UNOCCUPIED;
+    check.clearance = std::numeric_limits<float>::infinity();
+    check.first_invalid = -1;
+    size_t end = std::min<size_t>(ends[i], poses.size());
+    for (size_t j = begin; j < end && check.valid; ++j)
+    {
+      // The segment from pose j up to the next, whose own point is the first of the next segment, or the last pose
+      const geometry_msgs::Point &a = poses[j].position;
+      const geometry_msgs::Point &b = j + 1 < end ? poses[j + 1].position : a;
+      int samples = std::max(1, int(std::ceil(std::hypot(b.x - a.x, b.y - a.y) / step)));
+      for (int s = 0; s < samples; ++s)
+      {
+        double t = double(s) / samples;
+        sample.position.x = a.x + t * (b.x - a.x);
+        sample.position.y = a.y + t * (b.y - a.y);
+        sample.position.z = a.z + t * (b.z - a.z);
+        check_point(sample, point);
+        if (!point.valid)
+        {
+          check.valid = false;
+          check.error = point.error;
+          check.clearance = 0;
+          check.first_invalid = int(j);
+          break;
+        }
+        check.clearance = std::min(check.clearance, point.clearance);
+      }
+    }
+    // Nothing checked
+    if (std::isinf(check.clearance))
+      check.clearance = 0;
+    begin = std::max(begin, end);
   }
+}
 
-  return std::make_pair(true, WAYPOINT_ERROR_TYPE::UNOCCUPIED);
+cv::Point WaypointValidity::to_cell(const geometry_msgs::Pose &waypoint) const
+{
+  return mil_ogrid::GridGeometry::from_info(ogrid_map_->info).cell(waypoint.position.x, waypoint.position.y);
+}
+
+void WaypointValidity::fill_size_ogrid(nav_msgs::OccupancyGrid &grid, int d, float resolution) const
+{
+  unsigned int cells = sub_ogrid_size_ / resolution;
+  if (grid.info.resolution == resolution && grid.info.width == cells && !grid.data.empty() &&
+      grid.data[0] == int8_t(d))
+    return;
+  grid.header.frame_id = "map";
+  grid.info.resolution = resolution;
+  grid.info.width = cells;
+  grid.info.height = cells;
+  grid.data.assign(size_t(cells) * cells, d);
 }
 
 void WaypointValidity::pub_size_ogrid(const geometry_msgs::Pose &waypoint, int d)
 {
-  if (!this->ogrid_map_)
+  float resolution;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!this->ogrid_map_)
+      return;
+    resolution = ogrid_map_->info.resolution;
+  }
+  bool is_sub = d == (int)OGRID_COLOR::ORANGE;
+  mil_tools::DebugPublisher<> &pub = is_sub ? pub_sub_ogrid_ : pub_waypoint_ogrid_;
+  if (!pub.wanted())
     return;
-  std::vector<int8_t> sub_ogrid_data(std::pow(sub_ogrid_size_ / ogrid_map_->info.resolution, 2), d);
-  nav_msgs::OccupancyGrid rosGrid;
-  rosGrid.header.seq = 0;
-  rosGrid.info.resolution = ogrid_map_->info.resolution;
-  rosGrid.header.frame_id = "map";
-  rosGrid.header.stamp = ros::Time::now();
-  rosGrid.info.map_load_time = ros::Time::now();
-  rosGrid.info.width = sub_ogrid_size_ / ogrid_map_->info.resolution;
-  rosGrid.info.height = sub_ogrid_size_ / ogrid_map_->info.resolution;
+  ros::Time now = ros::Time::now();
+  if (is_sub)
+  {
+    if (now - last_sub_ogrid_pub_ < sub_ogrid_period_)
+      return;
+    last_sub_ogrid_pub_ = now;
+  }
+
+  nav_msgs::OccupancyGrid &rosGrid = is_sub ? sub_ogrid_msg_ : waypoint_ogrid_msg_;
+  fill_size_ogrid(rosGrid, d, resolution);
+  rosGrid.header.stamp = now;
+  rosGrid.info.map_load_time = now;
   rosGrid.info.origin.position.x = waypoint.position.x - sub_ogrid_size_ / 2;
   rosGrid.info.origin.position.y = waypoint.position.y - sub_ogrid_size_ / 2;
-  rosGrid.data = sub_ogrid_data;
-  if (d == (int)OGRID_COLOR::ORANGE)
-    pub_sub_ogrid_.publish(rosGrid);
-  else
-    pub_waypoint_ogrid_.publish(rosGrid);
+  pub.publish(rosGrid);
 }
 
 WaypointValidity::WaypointValidity(ros::NodeHandle &nh)
 {
   nh_ = &nh;
-  sub_ = nh_->subscribe<nav_msgs::OccupancyGrid>("/ogrid_pointcloud/ogrid", 1,
-                                                 boost::bind(&WaypointValidity::ogrid_callback, this, _1));
+  nh_->param<std::string>("ogrid_topic", ogrid_topic_, "/ogrid_pointcloud/ogrid");
+  nh_->param<bool>("use_ogrid_updates", use_ogrid_updates_, false);
+  // OGridGen publishes the updates to its ogrid next to it, as <ogrid_topic>_updates. PCODAR publishes them on
+  // /ogrid_updates instead, so reading its ogrid needs ogrid_updates_topic set too.
+  nh_->param<std::string>("ogrid_updates_topic", ogrid_updates_topic_, ogrid_topic_ + "_updates");
   nh_->param<double>("sub_ogrid_size", sub_ogrid_size_, 1.5);
+  nh_->param<double>("clearance_range", clearance_range_, 1.0);
+  double sub_ogrid_rate;
+  nh_->param<double>("sub_ogrid_rate", sub_ogrid_rate, 10);
+  sub_ogrid_period_ = ros::Duration(sub_ogrid_rate > 0 ? 1 / sub_ogrid_rate : 0);
   pub_waypoint_ogrid_ = nh_->advertise<nav_msgs::OccupancyGrid>("/c3_trajectory_generator/waypoint_ogrid", 1, true);
   pub_sub_ogrid_ = nh_->advertise<nav_msgs::OccupancyGrid>("/c3_trajectory_generator/sub_ogrid", 1, true);
+}
+
+void WaypointValidity::subscribe()
+{
+  // The ogrid is latched, so it may be received as soon as this returns
+  sub_ = nh_->subscribe<nav_msgs::OccupancyGrid>(ogrid_topic_, 1,
+                                                 boost::bind(&WaypointValidity::ogrid_callback, this, _1));
+  if (use_ogrid_updates_)
+    updates_sub_ = nh_->subscribe<map_msgs::OccupancyGridUpdate>(
+        ogrid_updates_topic_, 10, boost::bind(&WaypointValidity::ogrid_update_callback, this, _1));
 }
\ No newline at end of file
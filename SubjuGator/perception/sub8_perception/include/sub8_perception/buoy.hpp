@@ -22,9 +22,13 @@
 #include <tf/transform_listener.h>
 
 #include <eigen_conversions/eigen_msg.h>
+#include <image_geometry/stereo_camera_model.h>
 #include <Eigen/StdVector>
+#include <memory>
 #include <mil_vision_lib/cv_tools.hpp>
+#include <mil_vision_lib/image_acquisition/shared_streams.hpp>
 #include <mil_vision_lib/pcl_tools.hpp>
+#include <mil_vision_lib/roi_stereo.hpp>
 
 #include "ros/ros.h"
 
@@ -59,6 +63,25 @@ public:
                                Eigen::Vector3f &center);
   bool segment_buoy(cv::Mat &input_image, cv::Point &center, std::vector<sub::Contour> &output_contours,
                     std::string &target_name);
+  // Finds the largest region of the target's color in image. With buoy_tracking, only the region around where it was
+  // found last is searched, expanded for every frame it is missed, until it has been missed for more than
+  // buoy_max_misses frames and the whole frame is searched again.
+  bool find_buoy(const cv::Mat &image, const std::string &target_name, cv::Point &center,
+                 std::vector<sub::Contour> *buoy_contours = NULL);
+  bool segment_buoy_region(const cv::Mat &image, const cv::Rect &roi, const std::string &target_name,
+                           cv::Point &center, cv::Rect &bounds, std::vector<sub::Contour> *buoy_contours);
+  // Grows the tracked region of a buoy to the size it should have at a 3d position on it
+  void track_buoy_position(const image_geometry::PinholeCameraModel &camera_model, const std::string &target_name,
+                           const Eigen::Vector3f &center);
+  // Matches the stereo pair around a buoy found at centroid in the right image, for the points on it without a
+  // cloud of the whole pair
+  bool stereo_buoy_cloud(const std::string &target_name, const cv::Point &centroid, sub::PointCloudT::Ptr &cloud);
+  // Points of the stereo pipeline's cloud which project into bounds of an image of image_size, without those that
+  // have no position. In an organized cloud of the left camera's pixels only the rows of bounds, and the columns of
+  // them a point seen in bounds of the right image can be at, are looked at, so the cost grows with the buoy rather
+  // than the cloud. Any other cloud is projected point by point.
+  void crop_to_buoy(const image_geometry::PinholeCameraModel &camera_model, const sub::PointCloudT &cloud,
+                    const cv::Size &image_size, const cv::Rect &bounds, sub::PointCloudT &cropped);
   bool request_buoy_position_2d(sub8_msgs::VisionRequest2D::Request &req, sub8_msgs::VisionRequest2D::Response &resp);
   bool request_buoy_position(sub8_msgs::VisionRequest::Request &req, sub8_msgs::VisionRequest::Response &resp);
   // Visualize
@@ -75,8 +98,31 @@ public:
   double buoy_radius;
 
   std::map<std::string, sub::Range> color_ranges;
+
+  // Image region each buoy was last found in, by target name, and how many frames it has been missed since
+  struct BuoyTrack
+  {
+    cv::Rect roi;
+    int misses;
+  };
+  std::map<std::string, BuoyTrack> buoy_tracks;
+  bool buoy_tracking;
+  double buoy_roi_padding;  // fraction of the region's size added to each side of it
+  int buoy_max_misses;
   Eigen::Vector3f last_bump_target;
 
+  // Bounding box of each buoy in the last image it was found in, by target name, which the cloud is cropped to
+  std::map<std::string, cv::Rect> buoy_bounds;
+  double buoy_crop_padding;     // fraction of the box's size added to each side of it
+  int buoy_crop_max_disparity;  // pixels a point can be right of where it is seen in the right image
+
+  // In-process stereo of the front cameras, only around a buoy when its position is asked for, in place of the
+  // stereo pipeline's cloud of the whole pair. Null if disabled.
+  std::shared_ptr<mil_vision::StereoCameraStream<cv::Vec3b>> stereo_stream;
+  std::unique_ptr<mil_vision::RoiStereoMatcher> stereo_matcher;
+  image_geometry::StereoCameraModel stereo_model;
+  int stereo_window;  // side in pixels of the region matched around a buoy without a track
+
   image_transport::CameraSubscriber image_sub;
   image_transport::ImageTransport image_transport;
   image_transport::Publisher image_pub;
@@ -1,5 +1,6 @@
 #pragma once
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -13,6 +14,7 @@
 #include <sub8_msgs/VisionRequest2D.h>
 
 #include <sub8_vision_lib/stereo_base.hpp>
+#include <sub8_vision_lib/worker_pool.hpp>
 
 #include <tf2/convert.h>
 #include <tf2/transform_datatypes.h>
@@ -25,14 +27,20 @@ class Sub8StartGateDetector : public StereoBase
 {
 public:
   Sub8StartGateDetector();
+  // Reads its params from private_nh, which is ~ when run as its own node
+  explicit Sub8StartGateDetector(ros::NodeHandle private_nh);
+  ~Sub8StartGateDetector();
 
   virtual std::vector<cv::Point> get_2d_feature_points(cv::Mat image);
 
   ros::NodeHandle nh;
-  void run();
 
 private:
+  // Submits a frame to the shared worker pool refresh_rate_ times per second while active
+  void refresh(const ros::WallTimerEvent &);
   void determine_start_gate_position();
+  VisionWorkerPool::TaskId pool_task_;
+  ros::WallTimer refresh_timer_;
 
   // Some filtering params used by the 'process_image' function
   int canny_low_;
@@ -40,6 +48,9 @@ private:
   int blur_size_;
   int dilate_amount_;
 
+  // Track the corners of the last detection in small windows instead of detecting the gate again in every frame
+  bool track_gate_;
+
   double get_angle(cv::Point a, cv::Point b, cv::Point c);
   // Helper function that checks if a contour is of a gate shape
   bool valid_contour(std::vector<cv::Point> &contour);
@@ -54,6 +65,8 @@ private:
   void visualize_k_gate_normal();
   void visualize_3d_points_rviz(const std::vector<Eigen::Vector3d> &feature_pts_3d);
 
+  // Guards the gate estimate and its transform, which pool threads update while services read them
+  std::mutex gate_mtx_;
   Eigen::Affine3d gate_pose_;
   bool gate_found_;
   ros::Time last_time_found_;
@@ -1,6 +1,9 @@
 #pragma once
 #include <pcl/filters/statistical_outlier_removal.h>
 #include <pcl/filters/voxel_grid.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 #include "typedefs.hpp"
 
 namespace sub
@@ -15,11 +18,78 @@ void voxel_filter(const typename pcl::PointCloud<PointT>::Ptr input_cloud,
   voxel_filter.filter(*output_cloud);
 }
 
+// Statistical outlier removal for organized (image shaped) clouds, with the neighbors of each point taken from the
+// window of pixels around it instead of a kd-tree search. The window is the smallest one with at least mean_k
+// neighbors. Like pcl::StatisticalOutlierRemoval, the output is the unorganized cloud of the points kept.
+template <typename PointT>
+void organized_statistical_outlier_filter(const pcl::PointCloud<PointT>& input_cloud,
+                                          pcl::PointCloud<PointT>& output_cloud, float mean_k,
+                                          float std_dev_mul_thresh)
+{
+  const int width = input_cloud.width;
+  const int height = input_cloud.height;
+  const int radius = std::max(1, int(std::ceil((std::sqrt(mean_k + 1) - 1) / 2)));
+
+  // Mean distance from each valid point to the valid points in its window
+  std::vector<float> mean_distances(input_cloud.size(), -1);
+  double sum = 0, sq_sum = 0;
+  int valid = 0;
+  for (int v = 0; v < height; v++)
+  {
+    for (int u = 0; u < width; u++)
+    {
+      const PointT& pt = input_cloud.points[v * width + u];
+      if (!pcl::isFinite(pt))
+        continue;
+      double distance_sum = 0;
+      int neighbors = 0;
+      for (int nv = std::max(0, v - radius); nv <= std::min(height - 1, v + radius); nv++)
+      {
+        for (int nu = std::max(0, u - radius); nu <= std::min(width - 1, u + radius); nu++)
+        {
+          const PointT& neighbor = input_cloud.points[nv * width + nu];
+          if ((nu == u && nv == v) || !pcl::isFinite(neighbor))
+            continue;
+          distance_sum += (pt.getVector3fMap() - neighbor.getVector3fMap()).norm();
+          neighbors++;
+        }
+      }
+      if (neighbors == 0)
+        continue;
+      float mean_distance = distance_sum / neighbors;
+      mean_distances[v * width + u] = mean_distance;
+      sum += mean_distance;
+      sq_sum += mean_distance * mean_distance;
+      valid++;
+    }
+  }
+
+  output_cloud.clear();
+  output_cloud.header = input_cloud.header;
+  if (valid == 0)
+    return;
+  double mean = sum / valid;
+  double std_dev = std::sqrt(std::max(0.0, (sq_sum - sum * mean) / std::max(1, valid - 1)));
+  double distance_thresh = mean + std_dev_mul_thresh * std_dev;
+  for (size_t i = 0; i < input_cloud.size(); i++)
+  {
+    if (mean_distances[i] >= 0 && mean_distances[i] <= distance_thresh)
+      output_cloud.push_back(input_cloud.points[i]);
+  }
+}
+
+// Organized clouds take organized_statistical_outlier_filter
 template <typename PointT>
 void statistical_outlier_filter(const typename pcl::PointCloud<PointT>::Ptr input_cloud,
                                 const typename pcl::PointCloud<PointT>::Ptr output_cloud, float mean_k,
                                 float std_dev_mul_thresh)
 {
+  if (input_cloud->isOrganized())
+  {
+    organized_statistical_outlier_filter<PointT>(*input_cloud, *output_cloud, mean_k, std_dev_mul_thresh);
+    return;
+  }
+
   pcl::StatisticalOutlierRemoval<PointT> outlier_remover;
   outlier_remover.setInputCloud(input_cloud);
   outlier_remover.setMeanK(mean_k);
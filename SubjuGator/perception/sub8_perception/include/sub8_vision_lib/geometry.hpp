@@ -1,5 +1,7 @@
 #pragma once
 #include <image_geometry/pinhole_camera_model.h>
+#include <Eigen/Dense>
+#include <cmath>
 #include <iostream>
 #include <limits>
 #include <opencv2/opencv.hpp>
@@ -135,6 +137,114 @@ PointT project_uv_to_cloud(const pcl::PointCloud<PointT>& cloud, const cv::Point
   return (pt_pcl);
 }
 
+// Reads the coordinates of a point as (x, y, z, 0). The pcl types that keep them in a 16 byte aligned data[4] are
+// specialized to load them as one vector.
+template <typename PointT>
+struct PointCoordinates
+{
+  static constexpr bool aligned_load = false;
+
+  static Eigen::Vector4f get(const PointT& point)
+  {
+    return Eigen::Vector4f(point.x, point.y, point.z, 0);
+  }
+};
+
+template <typename PointT>
+struct AlignedPointCoordinates
+{
+  static constexpr bool aligned_load = true;
+
+  static Eigen::Vector4f get(const PointT& point)
+  {
+    Eigen::Vector4f coordinates = Eigen::Map<const Eigen::Vector4f, Eigen::Aligned>(point.data);
+    coordinates[3] = 0;
+    return coordinates;
+  }
+};
+
+// PointXYZT is a PointXYZRGB
+template <>
+struct PointCoordinates<pcl::PointXYZ> : AlignedPointCoordinates<pcl::PointXYZ>
+{
+};
+template <>
+struct PointCoordinates<pcl::PointXYZRGB> : AlignedPointCoordinates<pcl::PointXYZRGB>
+{
+};
+template <>
+struct PointCoordinates<pcl::PointNormal> : AlignedPointCoordinates<pcl::PointNormal>
+{
+};
+
+// Centroid, spread and extent of a set of points
+struct CloudStatistics
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  size_t count;
+  Eigen::Vector3f centroid;
+  Eigen::Matrix3f covariance;  // divided by count
+  Eigen::Vector3f min;         // corners of the axis aligned bounding box
+  Eigen::Vector3f max;
+  Eigen::Matrix3f axes;       // principal axes as columns, from the largest variance to the smallest
+  Eigen::Vector3f variances;  // along each of the axes
+};
+
+// Compute the statistics of $cloud in one pass over its points. Points with non-finite coordinates are skipped unless
+// the cloud is dense.
+// Moments are summed in double about the first point, so clouds far from the origin keep their precision.
+//
+// @param[in] cloud The point cloud to describe
+// @param[out] stats Its statistics, only valid if this returns true
+// @return False if the cloud has no finite points
+template <typename PointT>
+bool compute_cloud_statistics(const pcl::PointCloud<PointT>& cloud, CloudStatistics& stats)
+{
+  typedef PointCoordinates<PointT> Coordinates;
+  Eigen::Vector4f origin, min, max;
+  Eigen::Vector4d sum = Eigen::Vector4d::Zero();
+  Eigen::Matrix4d moments = Eigen::Matrix4d::Zero();
+  size_t count = 0;
+  for (const PointT& point : cloud.points)
+  {
+    const Eigen::Vector4f coordinates = Coordinates::get(point);
+    // Any infinite or NaN coordinate makes the sum NaN or infinite
+    if (!cloud.is_dense && !std::isfinite(coordinates.sum()))
+      continue;
+    if (count == 0)
+    {
+      origin = min = max = coordinates;
+    }
+    else
+    {
+      min = min.cwiseMin(coordinates);
+      max = max.cwiseMax(coordinates);
+    }
+    const Eigen::Vector4d offset = (coordinates - origin).cast<double>();
+    sum += offset;
+    moments.noalias() += offset * offset.transpose();
+    count++;
+  }
+  if (count == 0)
+    return false;
+
+  const Eigen::Vector3d mean = sum.head<3>() / count;
+  const Eigen::Matrix3d covariance = moments.topLeftCorner<3, 3>() / count - mean * mean.transpose();
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+  solver.computeDirect(covariance);
+
+  stats.count = count;
+  stats.centroid = (origin.head<3>().cast<double>() + mean).cast<float>();
+  stats.covariance = covariance.cast<float>();
+  stats.min = min.head<3>();
+  stats.max = max.head<3>();
+  // The eigenvalues come in increasing order
+  stats.axes = solver.eigenvectors().rowwise().reverse().cast<float>();
+  stats.variances = solver.eigenvalues().reverse().cwiseMax(0).cast<float>();
+  return true;
+}
+
 // Convert a pcl point to an eigen vector3f
 template <typename PointT>
 Eigen::Vector3f point_to_eigen(const PointT& pcl_point)
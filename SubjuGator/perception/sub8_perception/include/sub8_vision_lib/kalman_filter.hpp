@@ -0,0 +1,177 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Dense>
+
+namespace sub
+{
+/**
+* Linear Kalman filter with its state and measurement sizes fixed at compile time, so predict and correct run on
+* stack matrices without allocating
+*/
+template <int StateDim, int MeasurementDim>
+class KalmanFilter
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  typedef Eigen::Matrix<double, StateDim, 1> State;
+  typedef Eigen::Matrix<double, StateDim, StateDim> StateMatrix;
+  typedef Eigen::Matrix<double, MeasurementDim, 1> Measurement;
+  typedef Eigen::Matrix<double, MeasurementDim, MeasurementDim> MeasurementMatrix;
+  typedef Eigen::Matrix<double, MeasurementDim, StateDim> ObservationMatrix;
+
+  KalmanFilter()
+  {
+    reset(State::Zero(), StateMatrix::Identity());
+  }
+
+  void reset(const State &state, const StateMatrix &covariance)
+  {
+    x_ = state;
+    P_ = covariance;
+  }
+
+  /**
+  * @param transition F, the state becomes F * x
+  * @param process_noise Q, covariance added by the transition
+  */
+  void predict(const StateMatrix &transition, const StateMatrix &process_noise)
+  {
+    x_ = transition * x_;
+    P_ = transition * P_ * transition.transpose() + process_noise;
+  }
+
+  /**
+  * @param measurement z, measured as H * x
+  * @param observation H
+  * @param measurement_noise R, covariance of the measurement
+  */
+  void correct(const Measurement &measurement, const ObservationMatrix &observation,
+               const MeasurementMatrix &measurement_noise)
+  {
+    const Eigen::Matrix<double, StateDim, MeasurementDim> PHt = P_ * observation.transpose();
+    const MeasurementMatrix S = observation * PHt + measurement_noise;
+    // K = P H^T S^-1, with S symmetric
+    const Eigen::Matrix<double, StateDim, MeasurementDim> K = S.ldlt().solve(PHt.transpose()).transpose();
+    x_ += K * (measurement - observation * x_);
+    P_ -= K * PHt.transpose();
+  }
+
+  const State &state() const
+  {
+    return x_;
+  }
+
+  const StateMatrix &covariance() const
+  {
+    return P_;
+  }
+
+private:
+  State x_;
+  StateMatrix P_;
+};
+
+/**
+* Kalman filter of Axes independent quantities, each with a constant acceleration model and its value measured
+* directly, like the position and euler angles of a pose. The axes never mix, so the covariance is block diagonal and
+* only the 3x3 block of each axis is kept, making each update a few 3x3 products per axis instead of products of
+* 3 * Axes square matrices. The noises are the same for every axis and every derivative, as cv::setIdentity gives.
+*/
+template <int Axes>
+class ConstantAccelerationKalmanFilter
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  // Each column is an axis, its rows the value and its first and second derivatives
+  typedef Eigen::Matrix<double, 3, Axes> State;
+  typedef Eigen::Matrix<double, Axes, 1> Measurement;
+
+  /**
+  * @param process_noise variance added to each state per prediction
+  * @param measurement_noise variance of each measured value
+  * @param initial_covariance variance of each state after reset()
+  */
+  explicit ConstantAccelerationKalmanFilter(double process_noise = 1e-5, double measurement_noise = 5e-3,
+                                            double initial_covariance = 1)
+    : q_(process_noise), r_(measurement_noise), p0_(initial_covariance)
+  {
+    reset();
+  }
+
+  /**
+  * Clears the state to 0, with the initial covariance
+  */
+  void reset()
+  {
+    x_.setZero();
+    for (int i = 0; i < Axes; i++)
+      P_.template block<3, 3>(0, 3 * i) = p0_ * Eigen::Matrix3d::Identity();
+  }
+
+  void set_noise(double process_noise, double measurement_noise)
+  {
+    q_ = process_noise;
+    r_ = measurement_noise;
+  }
+
+  /**
+  * Advances the state by dt seconds. Can be called any number of times between measurements, e.g. at IMU rate.
+  */
+  void predict(double dt)
+  {
+    Eigen::Matrix3d F;
+    F << 1, dt, 0.5 * dt * dt, 0, 1, dt, 0, 0, 1;
+    x_ = F * x_;
+    for (int i = 0; i < Axes; i++)
+    {
+      auto P = P_.template block<3, 3>(0, 3 * i);
+      P = F * P * F.transpose();
+      P.diagonal().array() += q_;
+    }
+  }
+
+  /**
+  * Corrects the state with a measurement of the value of every axis
+  */
+  void correct(const Measurement &measurement)
+  {
+    for (int i = 0; i < Axes; i++)
+    {
+      // The observation picks the value out of the axis, so S is a scalar and the gain the first column of P over it
+      auto P = P_.template block<3, 3>(0, 3 * i);
+      const Eigen::Vector3d K = P.col(0) / (P(0, 0) + r_);
+      x_.col(i) += K * (measurement(i) - x_(0, i));
+      P -= K * P.row(0);
+    }
+  }
+
+  const State &state() const
+  {
+    return x_;
+  }
+
+  Measurement values() const
+  {
+    return x_.row(0).transpose();
+  }
+
+  /**
+  * Covariance of the value and derivatives of an axis
+  */
+  Eigen::Matrix3d covariance(int axis) const
+  {
+    return P_.template block<3, 3>(0, 3 * axis);
+  }
+
+private:
+  State x_;
+  Eigen::Matrix<double, 3, 3 * Axes> P_;  // block i is the covariance of axis i
+  double q_;
+  double r_;
+  double p0_;
+};
+
+}  // namespace sub
@@ -2,7 +2,9 @@
 #include <algorithm>
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <utility>  // std::pair
@@ -24,6 +26,7 @@
 #include <sub8_msgs/TorpBoardPoseRequest.h>
 #include <mil_vision_lib/cv_tools.hpp>
 #include <mil_vision_lib/visualization.hpp>
+#include <sub8_vision_lib/worker_pool.hpp>
 
 // #define SEGMENTATION_DEBUG
 
@@ -62,9 +65,22 @@ private:
   void right_image_callback(const sensor_msgs::ImageConstPtr &image_msg_ptr,
                             const sensor_msgs::CameraInfoConstPtr &info_msg_ptr);
 
+  // What each camera's task of the shared vision pool works on, kept across frames so its Mats are reused
+  struct CameraProcessing
+  {
+    const char *name;
+    VisionWorkerPool::TaskId task;
+    sub::ImageWithCameraInfo frame;
+    image_geometry::PinholeCameraModel *cam_model;
+    cv::Mat processing_size_image;
+    bool ok;
+  };
+
   // Detection / Processing
   void run();
   void determine_torpedo_board_position();
+  // Runs on the camera's pool task, converting and resizing its frame
+  void process_camera(CameraProcessing &camera);
 
   // ROS
   ros::NodeHandle nh;
@@ -80,6 +96,12 @@ private:
   // To prevent invalid img pointers from being passed to toCvCopy (segfault)
   boost::mutex left_mtx, right_mtx;
 
+  // The left and right images are processed at the same time, and the stereo part waits for both
+  CameraProcessing left_processing, right_processing;
+  int cameras_pending;
+  std::mutex cameras_mtx;
+  std::condition_variable cameras_cv;
+
 // Frames will be considered synchronized if their stamp difference is less than
 // this (in seconds)
 #if __cplusplus > 199711L
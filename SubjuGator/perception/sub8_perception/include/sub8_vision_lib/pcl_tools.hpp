@@ -1,5 +1,6 @@
 #pragma once
 
+#include <pcl/features/integral_image_normal.h>
 #include <pcl/features/normal_3d_omp.h>
 // #define BACKWARD_HAS_BFD 1
 // #include <sub8_build_tools/backward.hpp>
@@ -14,10 +15,23 @@
 
 namespace sub
 {
+// Organized (image shaped) clouds have their normals estimated from integral images, over normal_smoothing_size
+// pixels, instead of from neighbors searched within normal_radius
 template <typename PointT>
 void compute_normals(const typename pcl::PointCloud<PointT>::Ptr input_cloud, PointCloudNT& output_cloud,
-                     double normal_radius = 0.05)
+                     double normal_radius = 0.05, float normal_smoothing_size = 10.0)
 {
+  if (input_cloud->isOrganized())
+  {
+    pcl::IntegralImageNormalEstimation<PointT, PointNT> integral_estimator;
+    integral_estimator.setNormalEstimationMethod(integral_estimator.AVERAGE_3D_GRADIENT);
+    integral_estimator.setMaxDepthChangeFactor(0.02f);
+    integral_estimator.setNormalSmoothingSize(normal_smoothing_size);
+    integral_estimator.setInputCloud(input_cloud);
+    integral_estimator.compute(output_cloud);
+    return;
+  }
+
   pcl::NormalEstimationOMP<PointNT, PointNT> normal_estimator;
   normal_estimator.setRadiusSearch(normal_radius);
   normal_estimator.setInputCloud(input_cloud);
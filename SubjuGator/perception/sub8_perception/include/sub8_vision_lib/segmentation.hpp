@@ -5,11 +5,156 @@
 #include <pcl/search/kdtree.h>
 #include <pcl/search/search.h>
 #include <pcl/segmentation/region_growing_rgb.h>
+#include <algorithm>
 #include <vector>
 #include "typedefs.hpp"
 
 namespace sub
 {
+// Region growing for organized (image shaped) clouds, the same as pcl::RegionGrowingRGB with its defaults above except
+// that the neighbors of a point are the 4 pixels next to it instead of the results of a kd-tree search. Regions are
+// grown from neighbors within $distance_thresh and $point_color_thresh, then adjacent regions whose mean colors are
+// within $region_color_thresh are merged and regions smaller than $min_cluster_size are dropped.
+//
+// @param[in] target_cloud Organized cloud of interest
+// @param[in] indices Indices of the points to segment
+// @param[out] clusters Indices corresponding to clusters of points
+// @param[out] colored_cloud Cloud of the clustered points, colored by cluster (Only computed if not NULL)
+template <typename PointT>
+void organized_segment_rgb_region_growing(const pcl::PointCloud<PointT>& target_cloud, const std::vector<int>& indices,
+                                          std::vector<pcl::PointIndices>& clusters,
+                                          pcl::PointCloud<PointT>* colored_cloud, float distance_thresh = 10,
+                                          float point_color_thresh = 25, float region_color_thresh = 25,
+                                          size_t min_cluster_size = 5)
+{
+  const int width = target_cloud.width;
+  const int height = target_cloud.height;
+  clusters.clear();
+
+  // -1 for pixels outside of $indices, -2 for pixels in it not yet grown into a region
+  std::vector<int> labels(target_cloud.size(), -1);
+  for (int idx : indices)
+  {
+    if (pcl::isFinite(target_cloud.points[idx]))
+      labels[idx] = -2;
+  }
+
+  const float sq_distance_thresh = distance_thresh * distance_thresh;
+  const float sq_point_color_thresh = point_color_thresh * point_color_thresh;
+  auto color = [&](int idx) {
+    const PointT& pt = target_cloud.points[idx];
+    return Eigen::Vector3f(pt.r, pt.g, pt.b);
+  };
+  auto similar = [&](int a, int b) {
+    return (target_cloud.points[a].getVector3fMap() - target_cloud.points[b].getVector3fMap()).squaredNorm() <
+               sq_distance_thresh &&
+           (color(a) - color(b)).squaredNorm() < sq_point_color_thresh;
+  };
+
+  // Grow regions breadth first over adjacent pixels
+  std::vector<std::vector<int> > regions;
+  std::vector<Eigen::Vector3f> region_colors;
+  std::vector<int> frontier;
+  for (int idx : indices)
+  {
+    if (labels[idx] != -2)
+      continue;
+    const int label = regions.size();
+    regions.push_back(std::vector<int>(1, idx));
+    std::vector<int>& region = regions.back();
+    Eigen::Vector3f color_sum = color(idx);
+    labels[idx] = label;
+    frontier.assign(1, idx);
+    while (!frontier.empty())
+    {
+      const int current = frontier.back();
+      frontier.pop_back();
+      const int u = current % width;
+      const int v = current / width;
+      const int neighbors[4] = { u > 0 ? current - 1 : -1, u < width - 1 ? current + 1 : -1,
+                                 v > 0 ? current - width : -1, v < height - 1 ? current + width : -1 };
+      for (int neighbor : neighbors)
+      {
+        if (neighbor < 0 || labels[neighbor] != -2 || !similar(current, neighbor))
+          continue;
+        labels[neighbor] = label;
+        region.push_back(neighbor);
+        color_sum += color(neighbor);
+        frontier.push_back(neighbor);
+      }
+    }
+    region_colors.push_back(color_sum / region.size());
+  }
+
+  // Merge adjacent regions of similar color
+  std::vector<int> parent(regions.size());
+  for (size_t i = 0; i < parent.size(); i++)
+    parent[i] = i;
+  auto root = [&](int label) {
+    while (parent[label] != label)
+      label = parent[label] = parent[parent[label]];
+    return label;
+  };
+  const float sq_region_color_thresh = region_color_thresh * region_color_thresh;
+  for (size_t label = 0; label < regions.size(); label++)
+  {
+    for (int idx : regions[label])
+    {
+      const int u = idx % width;
+      const int v = idx / width;
+      const int neighbors[2] = { u < width - 1 ? idx + 1 : -1, v < height - 1 ? idx + width : -1 };
+      for (int neighbor : neighbors)
+      {
+        if (neighbor < 0 || labels[neighbor] < 0 || labels[neighbor] == int(label))
+          continue;
+        const int a = root(label);
+        const int b = root(labels[neighbor]);
+        if (a != b && (region_colors[label] - region_colors[labels[neighbor]]).squaredNorm() < sq_region_color_thresh)
+          parent[std::max(a, b)] = std::min(a, b);
+      }
+    }
+  }
+
+  std::vector<int> cluster_of_root(regions.size(), -1);
+  for (size_t label = 0; label < regions.size(); label++)
+  {
+    const int r = root(label);
+    if (cluster_of_root[r] < 0)
+    {
+      cluster_of_root[r] = clusters.size();
+      clusters.push_back(pcl::PointIndices());
+      clusters.back().header = target_cloud.header;
+    }
+    std::vector<int>& cluster = clusters[cluster_of_root[r]].indices;
+    cluster.insert(cluster.end(), regions[label].begin(), regions[label].end());
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < clusters.size(); i++)
+  {
+    if (clusters[i].indices.size() >= min_cluster_size)
+      std::swap(clusters[kept++], clusters[i]);
+  }
+  clusters.resize(kept);
+
+  if (colored_cloud == NULL)
+    return;
+  colored_cloud->clear();
+  colored_cloud->header = target_cloud.header;
+  for (size_t i = 0; i < clusters.size(); i++)
+  {
+    // Spread the colors of consecutive clusters apart
+    const uint8_t r = (i * 97) % 256, g = (i * 57 + 85) % 256, b = (i * 31 + 170) % 256;
+    for (int idx : clusters[i].indices)
+    {
+      PointT pt = target_cloud.points[idx];
+      pt.r = r;
+      pt.g = g;
+      pt.b = b;
+      colored_cloud->push_back(pt);
+    }
+  }
+}
+
 // Compute the point in $cloud that is closest to the ray defined by $direction and $line_pt
 //
 // Compute the minimum over the set of points $cloud: dist(line_pt + direction*t, point)
@@ -28,6 +173,12 @@ void segment_rgb_region_growing(const typename pcl::PointCloud<PointT>::Ptr targ
                                 const std::vector<int>& indices, std::vector<pcl::PointIndices>& clusters,
                                 typename pcl::PointCloud<PointT>::Ptr colored_cloud)
 {
+  if (target_cloud->isOrganized())
+  {
+    organized_segment_rgb_region_growing<PointT>(*target_cloud, indices, clusters, colored_cloud.get());
+    return;
+  }
+
   typename pcl::search::Search<PointT>::Ptr tree =
       boost::shared_ptr<pcl::search::Search<PointT> >(new pcl::search::KdTree<PointT>);
   // typename pcl::search::Search<PointT>::Ptr tree(new pcl::search::KdTree<PointT>);
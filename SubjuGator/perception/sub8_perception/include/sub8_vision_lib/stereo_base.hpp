@@ -6,7 +6,10 @@
 
 #include <mil_tools/mil_tools.hpp>
 #include <mil_vision_lib/cv_tools.hpp>
-#include <mil_vision_lib/image_acquisition/ros_camera_stream.hpp>
+#include <mil_vision_lib/image_acquisition/shared_streams.hpp>
+#include <mil_vision_lib/image_acquisition/stereo_camera_stream.hpp>
+#include <mil_vision_lib/sparse_stereo.hpp>
+#include <sub8_vision_lib/kalman_filter.hpp>
 
 #include <eigen_conversions/eigen_msg.h>
 #include <Eigen/Core>
@@ -14,30 +17,34 @@
 #include <Eigen/Geometry>
 #include <Eigen/StdVector>
 
-using ROSCameraStream_Vec3 = mil_vision::ROSCameraStream<cv::Vec3b>;
+using StereoCameraStream_Vec3 = mil_vision::StereoCameraStream<cv::Vec3b>;
 
 class StereoBase
 {
 public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
   StereoBase();
 
   /**
-  * Check if left+right cameras are publishing and are in sync
+  * Wait up to one refresh period for a left+right pair newer than the last one, and keep it in pair_
   * @see sync_thresh_
   */
   bool is_stereo_coherent();
 
   /**
   * A pure virtual method to segment left/right camera images
-  * @param image left and right ROSimagestream will pass to this method
+  * @param image left and right images of pair_ will pass to this method
   * @see get_3d_feature_points()
-  * @see ROSCameraStream
+  * @see StereoCameraStream
   * @return a vector of points that define the shape in 2d
   */
   virtual std::vector<cv::Point> get_2d_feature_points(cv::Mat image) = 0;
 
   /**
-  * Use stereo intinsics and triangulation to map 2d features to 3d in stereo frame
+  * Use stereo intinsics and triangulation to map 2d features of pair_ to 3d in stereo frame. With sparse_matcher_
+  * set, only the left image is segmented and its features are found in the right one by the matcher, otherwise both
+  * are segmented and their features paired by distance.
   * @param max_z filter points that are greater than the given z value
   * @see get_2d_feature_points()
   * @see mil_vision::triangulate_Linear_LS
@@ -45,6 +52,27 @@ public:
   */
   std::unique_ptr<std::vector<Eigen::Vector3d>> get_3d_feature_points(int max_z = 5);
 
+  /**
+  * Tracks the 3d feature points of the last detection instead of detecting them again. Each point, moved by the
+  * filtered pose, is projected into both images of pair_ and refined to the strongest sub-pixel corner within
+  * tracking_search_radius_ of its projection. Much cheaper than get_3d_feature_points(), as only small windows of the
+  * images are looked at.
+  * @param max_z filter points that are greater than the given z value
+  * @see set_tracked_features()
+  * @return the points in the order they were set in, or nullptr if nothing is tracked or tracking failed, in which
+  *         case get_3d_feature_points() should run instead
+  */
+  std::unique_ptr<std::vector<Eigen::Vector3d>> track_3d_feature_points(int max_z = 5);
+
+  /**
+  * Sets the points track_3d_feature_points() tracks
+  * @param feature_pts_3d points in stereo frame
+  * @param pose pose the points move with, usually the filtered one
+  */
+  void set_tracked_features(const std::vector<Eigen::Vector3d> &feature_pts_3d, const Eigen::Affine3d &pose);
+
+  void clear_tracked_features();
+
   /**
   * Use 3d points to estimate a normal and a center point and return a pose
   * @param feature_pts_3d a vector of 3d points (currently only supports 4 points)
@@ -55,8 +83,23 @@ public:
   std::unique_ptr<Eigen::Affine3d> get_3d_pose(std::vector<Eigen::Vector3d> feature_pts_3d, float z_vector_min = 0.5);
 
 protected:
-  std::unique_ptr<ROSCameraStream_Vec3> left_cam_stream_;
-  std::unique_ptr<ROSCameraStream_Vec3> right_cam_stream_;
+  /**
+  * pairs of the front cameras, shared with the other detectors of the process
+  * @see mil_vision::sharedStereoCameraStream()
+  */
+  std::shared_ptr<StereoCameraStream_Vec3> stereo_cam_stream_;
+
+  /**
+  * the pair the current image processing runs on
+  * @see is_stereo_coherent()
+  */
+  StereoCameraStream_Vec3::StereoPair pair_;
+
+  /**
+  * finds the features of the left image in the right one, if set
+  * @see get_3d_feature_points()
+  */
+  std::unique_ptr<mil_vision::SparseStereoMatcher> sparse_matcher_;
 
   /**
   * how often will image processing occur
@@ -67,7 +110,7 @@ protected:
 
   /**
   * maximum time difference between the left and right camera time stamps
-  * @see is_stereo_coherent()
+  * @see StereoCameraStream::init()
   */
   double sync_thresh_;
 
@@ -77,21 +120,22 @@ protected:
   bool active_;
 
   /**
-  * the number of states in the kalman filter
-  * default to 18 which includes x,y,z and euler angles, and their respective 1st and 2nd dervatives
+  * how far in pixels a tracked feature may be from its projection, and the half size of the window its corner is
+  * refined in
+  * @see track_3d_feature_points()
   */
-  int n_states_;
+  int tracking_search_radius_;
+  int tracking_corner_window_;
 
   /**
-  * number of measurments
-  * default to 6 which contains x,y,z, and euler angles
+  * largest RMS reprojection error in pixels of a tracked feature
   */
-  int n_measurements_;
+  double tracking_max_reprojection_error_;
 
   /**
-  * openCV's implementation of the kalman filter
+  * kalman filter of x,y,z and euler angles, each with its 1st and 2nd derivatives
   */
-  cv::KalmanFilter k_filter_;
+  sub::ConstantAccelerationKalmanFilter<6> k_filter_;
 
   /**
   * initializes/clears the kalman filter
@@ -102,9 +146,17 @@ protected:
   /**
   * Updates the kalman filter and returns the predicted pose
   * @param pose The estimated 3d pose
+  * @param dt time since the last update or predict_kalman_filter(), or 0 for one refresh period
+  * @return The predicted pose
+  */
+  Eigen::Affine3d update_kalman_filter(const Eigen::Affine3d &pose, double dt = 0);
+
+  /**
+  * Advances the kalman filter without a measurement, e.g. at IMU rate between detections
+  * @param dt time since the last update or prediction
   * @return The predicted pose
   */
-  Eigen::Affine3d update_kalman_filter(const Eigen::Affine3d &pose);
+  Eigen::Affine3d predict_kalman_filter(double dt);
 
 private:
   /**
@@ -125,9 +177,25 @@ private:
   std::vector<double> best_fit_plane_standard(const std::vector<Eigen::Vector3d> &feature_pts_3d);
 
   /**
-  * helper function for update_kalman_filter that converts to a cv::Mat
+  * Strongest corner within tracking_search_radius_ of predicted, refined to sub-pixel
+  * @return false if there is none or the window is not inside the image
+  */
+  bool refine_tracked_corner(const cv::Mat &image, const cv::Point2d &predicted, cv::Point2d &corner) const;
+
+  /**
+  * features set by set_tracked_features(), relative to the pose given with them
+  */
+  std::vector<Eigen::Vector3d> tracked_features_;
+
+  /**
+  * helper function for update_kalman_filter that converts a pose to the measurement of the filter
   * @param pose Estimated 3d pose
-  * @return pose in a cv::Mat form of size (n_measurments_ * 1)
+  * @return x,y,z and euler angles of the pose
+  */
+  static Eigen::Matrix<double, 6, 1> get_measurement(const Eigen::Affine3d &pose);
+
+  /**
+  * helper function for the kalman filter methods that converts its state to a pose
   */
-  cv::Mat get_measurement_as_cv_mat(const Eigen::Affine3d &pose);
+  Eigen::Affine3d get_filtered_pose() const;
 };
\ No newline at end of file
@@ -1,8 +1,13 @@
 #pragma once
 #include <algorithm>
+#include <array>
 #include <cstdint>
+#include <deque>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <numeric>
+#include <random>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -29,12 +34,76 @@
 #include <sub8_msgs/TBDetectionSwitch.h>
 #include <sub8_msgs/TorpBoardPoseRequest.h>
 #include <mil_vision_lib/cv_tools.hpp>
+#include <mil_vision_lib/image_acquisition/camera_model.hpp>
 #include <sub8_vision_lib/visualization.hpp>
+#include <sub8_vision_lib/worker_pool.hpp>
 
+#include <mil_tools/debug_publisher.hpp>
 #include <mil_tools/mil_tools.hpp>
 
 // #define SEGMENTATION_DEBUG
 
+class TorpedoBoardReprojectionCost
+{
+public:
+  TorpedoBoardReprojectionCost(cv::Matx34d &proj_L, cv::Matx34d &proj_R, std::vector<cv::Point> &corners_L,
+                               std::vector<cv::Point> &corners_R);
+  ~TorpedoBoardReprojectionCost();
+
+  template <typename T>
+  bool operator()(const T *const x, const T *const y, const T *const z, const T *const yaw, T *residual) const;
+
+  // Analytic alternative to the functor, laid out like a ceres::SizedCostFunction<16, 4>. Pose is the board center
+  // and its yaw about the y axis, in the frame of the projection matrices. Residuals are the x and y differences of
+  // each projected model corner from the nearest observed corner, left camera then right, and jacobian, if not
+  // NULL, their row major 16x4 derivatives. Returns false if a corner is behind either camera.
+  static const int num_residuals = 16;
+  bool evaluate(const double *pose, double *residuals, double *jacobian) const;
+
+private:
+  static std::vector<cv::Point> getProjectedCorners(double center_x, double center_y, double center_z, double yaw,
+                                                    cv::Matx34d &proj_matrix);
+
+#if __cplusplus > 199711L
+  static constexpr double height_m = 1.24;  // in meters, aka(49 in.)
+  static constexpr double width_m = 0.61;   // in meters, aka(24 in.)
+#else
+  static const double height_m = 1.24;  // in meters, aka(49 in.)
+  static const double width_m = 0.61;   // in meters, aka(24 in.)
+#endif
+
+  const cv::Matx34d proj_L;
+  const cv::Matx34d proj_R;
+
+  const std::vector<cv::Point> img_corners_L;
+  const std::vector<cv::Point> img_corners_R;
+};
+
+class TorpedoBoardPoseRefiner
+{
+  /*
+    Levenberg-Marquardt minimization of TorpedoBoardReprojectionCost, warm started from the pose it refined last,
+    so tracking a board takes a few iterations per frame. Each refinement is bounded by an iteration count and a
+    wall time budget.
+  */
+public:
+  TorpedoBoardPoseRefiner(int max_iterations = 10, double time_budget = 0.005);
+
+  // Forgets the last refined pose, so the next refinement starts from its initial guess
+  void reset();
+
+  // Refines pose (x, y, z, yaw), starting from it or from the last refined pose, whichever fits the observed corners
+  // better. Returns the final sum of squared residuals in pixels, or infinity if neither can be evaluated.
+  double refine(const TorpedoBoardReprojectionCost &cost, double pose[4]);
+
+  int max_iterations;
+  double time_budget;  // seconds
+
+private:
+  bool has_last_pose;
+  double last_pose[4];
+};
+
 /*
   Warning:
   Because of its multithreadedness, this class cannot be copy constructed.
@@ -57,6 +126,27 @@ public:
   mil_vision::ImageWithCameraInfo left_most_recent, right_most_recent;
 
 private:
+  // Left and right frames processed together
+  struct StereoPair
+  {
+    mil_vision::ImageWithCameraInfo left, right;
+  };
+
+  // What to do with a stereo pair that arrives while the processing queue is full
+  enum class DropPolicy
+  {
+    DROP_OLDEST,  // discard the oldest queued pair, keeping the latest frames
+    DROP_NEWEST   // discard the arriving pair, processing frames in the order they came
+  };
+
+  // How features of the left image are paired with features of the right one
+  enum class StereoMatching
+  {
+    NEAREST,   // nearest right feature that is about as high in the image
+    BLOCKS,    // most similar block around any right feature close by, see stereo_correspondence
+    RECTIFIED  // most similar block around a right feature in the epipolar band of rectified images
+  };
+
   // Callbacks
   bool detection_activation_switch(sub8_msgs::TBDetectionSwitch::Request &req,
                                    sub8_msgs::TBDetectionSwitch::Response &resp);
@@ -66,13 +156,19 @@ private:
                             const sensor_msgs::CameraInfoConstPtr &info_msg_ptr);
 
   // Detection / Processing
-  void run();
-  void determine_torpedo_board_position();
-  void segment_board(const cv::Mat &src, cv::Mat &dest, cv::Mat &dbg_img, bool draw_dbg_img = false);
+  void poll(const ros::WallTimerEvent &);
+  void process_queued_pair();
+  void queue_stereo_pair();
+  void determine_torpedo_board_position(const StereoPair &frames);
+  void segment_board(const cv::Mat &src, cv::Mat &dest, cv::Mat &dbg_img, bool left, bool draw_dbg_img = false);
   bool find_board_corners(const cv::Mat &segmented_board, std::vector<cv::Point> &corners, bool draw_dbg_left = true);
   void stereo_correspondence(const cv::Mat &gray_L, const cv::Mat &gray_R, const std::vector<cv::Point> &features_L,
                              const std::vector<cv::Point> &features_R,
                              std::vector<std::vector<int> > &corresponding_feat_idxs);
+  void rectified_stereo_correspondence(const cv::Mat &gray_L, const cv::Mat &gray_R,
+                                       const std::vector<cv::Point> &features_L,
+                                       const std::vector<cv::Point> &features_R,
+                                       std::vector<std::vector<int> > &corresponding_feat_idxs);
 
   // std::vector<cv::Point2d> project_rotated_model(Eigen::Matrix<double, 3, 4> cam_matx,
   //                                                Eigen::Quaterniond orientation);
@@ -83,8 +179,13 @@ private:
   ros::ServiceClient pose_client;
   image_transport::CameraSubscriber left_image_sub, right_image_sub;
   image_transport::ImageTransport image_transport;
-  image_transport::Publisher debug_image_pub;
-  image_geometry::PinholeCameraModel left_cam_model, right_cam_model;
+  // Only drawn to while someone subscribes, and never if generate_dbg_imgs is false
+  mil_tools::DebugPublisher<image_transport::Publisher> debug_image_pub;
+  // Camera models, and what rectifies features of unrectified images, made again only when the camera info changes
+  mil_vision::CameraRectifier left_rectifier, right_rectifier;
+
+  // False if the input topics are not rectified, in which case features are rectified before they are triangulated
+  bool rectified_input;
 
   // Torpedo Board detection will be attempted when true
   bool active;
@@ -100,47 +201,51 @@ private:
   static const double sync_thresh = 0.5;
 #endif
 
+  // Frames are processed by this task of the shared worker pool, which only runs while detection is active
+  VisionWorkerPool::TaskId pool_task;
+
+  // Event driven mode: frames from each camera whose stamps are within pair_sync_thresh of each other are paired
+  // as they arrive and queued, and the pool task is woken as soon as there is a pair in the queue. With polling,
+  // poll_timer submits the most recent frames 10 times per second.
+  bool event_driven;
+  double pair_sync_thresh;
+  mil_vision::ImageWithCameraInfo left_unpaired, right_unpaired;
+  std::deque<StereoPair> pair_queue;
+  size_t max_queued_pairs;
+  DropPolicy drop_policy;
+  size_t dropped_pairs;
+  boost::mutex pair_mtx;
+  ros::WallTimer poll_timer;
+
+  // Features are paired by stereo_matching. Rectified matches are searched for within epipolar_band rows.
+  StereoMatching stereo_matching;
+  int epipolar_band;
+
+  // The board corners are picked from the triangulated features by an exhaustive search when false
+  bool ransac_corner_search;
+  int ransac_hypotheses;
+  std::mt19937 corner_rng;
+
+  // Refines the board position and yaw from the reprojection error of its corners before it is sent when true
+  bool refine_pose;
+  TorpedoBoardPoseRefiner pose_refiner;
+
   // Goes into sequential id for pos_est srv request
   long long int run_id;
 
   // RVIZ
   sub::RvizVisualizer rviz;
 
-  // DBG images will be generated and published when true
+  // Segment the hue and saturation of each camera's frames, keeping their state between frames
+  mil_vision::StatisticalImageSegmenter hue_segmenter_left, sat_segmenter_left;
+  mil_vision::StatisticalImageSegmenter hue_segmenter_right, sat_segmenter_right;
+
+  // DBG images will be generated and published for the current frame when true
   bool generate_dbg_img;
   cv::Mat debug_image;
   cv::Rect upper_left, upper_right, lower_left, lower_right;
 };
 
-class TorpedoBoardReprojectionCost
-{
-public:
-  TorpedoBoardReprojectionCost(cv::Matx34d &proj_L, cv::Matx34d &proj_R, std::vector<cv::Point> &corners_L,
-                               std::vector<cv::Point> &corners_R);
-  ~TorpedoBoardReprojectionCost();
-
-  template <typename T>
-  bool operator()(const T *const x, const T *const y, const T *const z, const T *const yaw, T *residual) const;
-
-private:
-  static std::vector<cv::Point> getProjectedCorners(double center_x, double center_y, double center_z, double yaw,
-                                                    cv::Matx34d &proj_matrix);
-
-#if __cplusplus > 199711L
-  static constexpr double height_m = 1.24;  // in meters, aka(49 in.)
-  static constexpr double width_m = 0.61;   // in meters, aka(24 in.)
-#else
-  static const double height_m = 1.24;  // in meters, aka(49 in.)
-  static const double width_m = 0.61;   // in meters, aka(24 in.)
-#endif
-
-  const cv::Matx34d proj_L;
-  const cv::Matx34d proj_R;
-
-  const std::vector<cv::Point> img_corners_L;
-  const std::vector<cv::Point> img_corners_R;
-};
-
 /*
   Helper Functions
 */
@@ -151,6 +256,18 @@ void anisotropic_diffusion(const cv::Mat &src, cv::Mat &dest, int t_max);
 void best_plane_from_combination(const std::vector<Eigen::Vector3d> &point_list, double distance_threshold,
                                  std::vector<double> &result_coeffs);
 
+// Cost of four points as the corners of a rectangle of the given height and width, 0 for a perfect match
+double rectangle_model_cost(const std::vector<Eigen::Vector3d> &pts, const uint8_t idxs[4], double height,
+                            double width);
+
+// Pick the combination of 4 points from a vector of points that best matches a rectangle, if its cost is under
+// max_cost, exhaustively with pruning or from a bounded number of random hypotheses. Return its cost.
+double best_rectangle_combination(const std::vector<Eigen::Vector3d> &pts, double height, double width,
+                                  double max_cost, std::vector<uint8_t> &best_idxs);
+double best_rectangle_combination_ransac(const std::vector<Eigen::Vector3d> &pts, double height, double width,
+                                         double max_cost, int hypotheses, std::mt19937 &rng,
+                                         std::vector<uint8_t> &best_idxs);
+
 // Calculate coefficients of plane equation from 3 points
 void calc_plane_coeffs(Eigen::Vector3d &pt1, Eigen::Vector3d &pt2, Eigen::Vector3d &pt3,
                        std::vector<double> &plane_coeffs);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+* Threads shared by every detector of a process, so detectors do not each keep their own loop threads and timers
+* competing for the same cores. Each detector adds a task, then submits the work for each frame to it. A task holds
+* at most one piece of work that has not started, newer work replacing it, and never runs on two threads at once, so
+* a detector that falls behind skips frames instead of queueing them. Free threads take the pending work of the task
+* with the highest priority, the one waiting the longest among equal priorities. Tasks with a priority of 0 or less
+* are paused and keep their pending work until they are given a positive one.
+*/
+class VisionWorkerPool
+{
+public:
+  typedef size_t TaskId;
+
+  /**
+  * @param threads number of worker threads, or 0 for one per core
+  */
+  explicit VisionWorkerPool(size_t threads = 0);
+  ~VisionWorkerPool();
+
+  VisionWorkerPool(const VisionWorkerPool &) = delete;
+  VisionWorkerPool &operator=(const VisionWorkerPool &) = delete;
+
+  /**
+  * The pool of this process, made on first use with the number of threads in the /vision/worker_threads param
+  */
+  static VisionWorkerPool &shared();
+
+  /**
+  * Adds a task to submit work to
+  * @param name used in log messages
+  * @param priority see set_priority()
+  * @return id of the task for the other methods
+  */
+  TaskId add_task(const std::string &name, int priority);
+
+  /**
+  * Sets the priority of a task, 0 or less pauses it. Meant to be changed as missions activate detectors.
+  */
+  void set_priority(TaskId task, int priority);
+  int priority(TaskId task) const;
+
+  /**
+  * Pauses a task, drops its pending work and waits for the work it is running to finish. Call before destroying
+  * anything its work uses.
+  */
+  void stop_task(TaskId task);
+
+  /**
+  * Queues work for a task, replacing its work that has not started yet
+  * @return false if work was replaced
+  */
+  bool submit(TaskId task, std::function<void()> work);
+
+  size_t threads() const
+  {
+    return workers_.size();
+  }
+
+private:
+  struct Task
+  {
+    std::string name;
+    int priority;
+    std::function<void()> pending;
+    bool running;
+    uint64_t submitted;  // order the pending work was submitted in
+  };
+
+  void work();
+  // Call with mtx_ held. Returns the task whose pending work should run next, or tasks_.size() if there is none.
+  size_t next_task() const;
+
+  std::vector<Task> tasks_;
+  std::vector<std::thread> workers_;
+  mutable std::mutex mtx_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  uint64_t submitted_ = 0;
+  bool stop_ = false;
+};
@@ -0,0 +1,44 @@
+#include <nodelet/loader.h>
+#include <ros/ros.h>
+
+#include <string>
+
+// Runs the detectors as nodelets in one process, so they share its camera streams, the conversions of their frames and
+// the vision worker pool, rather than each decoding and converting the same frames. The detectors of the ~detectors
+// list, each a struct with a name and a nodelet type such as sub8_perception/start_gate, are loaded at start. Any
+// can be loaded or unloaded later through the ~load_nodelet and ~unload_nodelet services, as with a nodelet manager,
+// and a camera is unsubscribed once no loaded detector reads it.
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "perception_host");
+  ros::NodeHandle private_nh("~");
+
+  nodelet::Loader loader(true);
+  XmlRpc::XmlRpcValue detectors;
+  if (private_nh.getParam("detectors", detectors) && detectors.getType() == XmlRpc::XmlRpcValue::TypeArray)
+  {
+    for (int i = 0; i < detectors.size(); ++i)
+    {
+      XmlRpc::XmlRpcValue &detector = detectors[i];
+      if (detector.getType() != XmlRpc::XmlRpcValue::TypeStruct || !detector.hasMember("name") ||
+          !detector.hasMember("type"))
+      {
+        ROS_ERROR("perception_host: detector %d needs a name and a type", i);
+        continue;
+      }
+      std::string name = detector["name"];
+      std::string type = detector["type"];
+      nodelet::M_string remappings;
+      nodelet::V_string my_argv;
+      if (!loader.load(ros::names::resolve(name), type, remappings, my_argv))
+        ROS_ERROR("perception_host: could not load %s as %s", name.c_str(), type.c_str());
+    }
+  }
+
+  // The detectors' own callbacks are on the global queue, spun here on ~spinner_threads threads, or one per core
+  ros::AsyncSpinner spinner(private_nh.param<int>("spinner_threads", 0));
+  spinner.start();
+  ros::waitForShutdown();
+
+  return 0;
+}
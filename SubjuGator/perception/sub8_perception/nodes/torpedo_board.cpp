@@ -7,8 +7,23 @@ using namespace cv;
 // Class: Sub8TorpedoBoardDetector ////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
+namespace
+{
+// Histogram parameters of the segmented channels
+const int segmentation_hist_size = 256;
+const float segmentation_range[] = { 0, 255 };
+}
+
 Sub8TorpedoBoardDetector::Sub8TorpedoBoardDetector() try : image_transport(nh),
-                                                           rviz("/torpedo_board/visualization/detection")
+                                                           rviz("/torpedo_board/visualization/detection"),
+                                                           hue_segmenter_left(segmentation_hist_size,
+                                                                              segmentation_range, 6),
+                                                           sat_segmenter_left(segmentation_hist_size,
+                                                                              segmentation_range, 6),
+                                                           hue_segmenter_right(segmentation_hist_size,
+                                                                               segmentation_range, 6),
+                                                           sat_segmenter_right(segmentation_hist_size,
+                                                                               segmentation_range, 6)
 {
   using ros::param::param;
 
@@ -55,9 +70,73 @@ Sub8TorpedoBoardDetector::Sub8TorpedoBoardDetector() try : image_transport(nh),
   // Configure debug image generation
   generate_dbg_img = param<bool>("/torpedo_vision/generate_dbg_imgs", generate_dbg_img_default);
 
+  // Optionally take segmentation histograms over only the region around the last segmented board, blended over
+  // frames
+  int segmentation_roi_padding = param<int>("/torpedo_vision/segmentation_roi_padding", -1);
+  float segmentation_hist_memory = param<float>("/torpedo_vision/segmentation_hist_memory", 0.0);
+  for (mil_vision::StatisticalImageSegmenter *segmenter :
+       { &hue_segmenter_left, &sat_segmenter_left, &hue_segmenter_right, &sat_segmenter_right })
+  {
+    segmenter->set_roi_tracking(segmentation_roi_padding);
+    segmenter->set_histogram_memory(segmentation_hist_memory);
+  }
+  log_msg << setw(1 * tab_sz) << ""
+          << "Segmentation ROI Padding: \x1b[37m" << segmentation_roi_padding << "\x1b[0m\n";
+
+  // Configure the processing mode
+  event_driven = param<bool>("/torpedo_vision/event_driven", true);
+  pair_sync_thresh = min<double>(param<double>("/torpedo_vision/pair_sync_thresh", 0.05), sync_thresh);
+  max_queued_pairs = max(1, param<int>("/torpedo_vision/max_queued_pairs", 2));
+  string drop_policy_name = param<string>("/torpedo_vision/drop_policy", "drop_oldest");
+  drop_policy = drop_policy_name == "drop_newest" ? DropPolicy::DROP_NEWEST : DropPolicy::DROP_OLDEST;
+  dropped_pairs = 0;
+  pool_task = VisionWorkerPool::shared().add_task("torpedo_board", 0);
+  log_msg << setw(1 * tab_sz) << ""
+          << "Processing Mode: \x1b[37m" << (event_driven ? "event driven" : "polling at 10Hz") << "\x1b[0m\n";
+  if (event_driven)
+    log_msg << setw(2 * tab_sz) << ""
+            << "pair sync threshold = \x1b[37m" << pair_sync_thresh << "s\x1b[0m\n"
+            << setw(2 * tab_sz) << ""
+            << "queued pairs = \x1b[37m" << max_queued_pairs << ", "
+            << (drop_policy == DropPolicy::DROP_NEWEST ? "drop_newest" : "drop_oldest") << "\x1b[0m\n";
+
+  // Configure pose refinement
+  refine_pose = param<bool>("/torpedo_vision/refine_pose", true);
+  pose_refiner.max_iterations = param<int>("/torpedo_vision/pose_refinement_iterations", 10);
+  pose_refiner.time_budget = param<double>("/torpedo_vision/pose_refinement_time_budget", 0.005);
+  log_msg << setw(1 * tab_sz) << ""
+          << "Pose Refinement: \x1b[37m" << (refine_pose ? "on" : "off") << ", " << pose_refiner.max_iterations
+          << " iterations, " << pose_refiner.time_budget << "s\x1b[0m\n";
+
+  // Configure the search for the combination of triangulated features that are the board corners
+  ransac_corner_search = param<string>("/torpedo_vision/corner_search", "exhaustive") == "ransac";
+  ransac_hypotheses = param<int>("/torpedo_vision/ransac_hypotheses", 500);
+  log_msg << setw(1 * tab_sz) << ""
+          << "Corner Search: \x1b[37m" << (ransac_corner_search ? "ransac" : "exhaustive");
+  if (ransac_corner_search)
+    log_msg << ", " << ransac_hypotheses << " hypotheses";
+  log_msg << "\x1b[0m\n";
+
+  // Configure how features are paired between the cameras
+  string stereo_matching_name = param<string>("/torpedo_vision/stereo_matching", "nearest");
+  stereo_matching = stereo_matching_name == "rectified" ?
+                        StereoMatching::RECTIFIED :
+                        stereo_matching_name == "blocks" ? StereoMatching::BLOCKS : StereoMatching::NEAREST;
+  epipolar_band = max(0, param<int>("/torpedo_vision/epipolar_band", 2));
+  log_msg << setw(1 * tab_sz) << ""
+          << "Stereo Matching: \x1b[37m"
+          << (stereo_matching == StereoMatching::RECTIFIED ?
+                  "rectified" :
+                  stereo_matching == StereoMatching::BLOCKS ? "blocks" : "nearest");
+  if (stereo_matching == StereoMatching::RECTIFIED)
+    log_msg << ", epipolar band = " << epipolar_band << " rows";
+  log_msg << "\x1b[0m\n";
+
   // Subscribe to Cameras (image + camera_info)
   string left = param<string>("/torpedo_vision/input_left", img_topic_left_default);
   string right = param<string>("/torpedo_vision/input_right", img_topic_right_default);
+  // Same convention as mil_vision's camera streams
+  rectified_input = left.find("rect") != string::npos && right.find("rect") != string::npos;
   left_image_sub = image_transport.subscribeCamera(left, 10, &Sub8TorpedoBoardDetector::left_image_callback, this);
   right_image_sub = image_transport.subscribeCamera(right, 10, &Sub8TorpedoBoardDetector::right_image_callback, this);
   log_msg << setw(1 * tab_sz) << ""
@@ -78,6 +157,7 @@ Sub8TorpedoBoardDetector::Sub8TorpedoBoardDetector() try : image_transport(nh),
   // Advertise debug image topic
   string dbg_topic = param<string>("/torpedo_vision/dbg_imgs", dbg_topic_default);
   debug_image_pub = image_transport.advertise(dbg_topic, 1, true);
+  debug_image_pub.set_enabled(generate_dbg_img);
   log_msg << setw(1 * tab_sz) << ""
           << "Advertised debug image topic:\n"
           << setw(2 * tab_sz) << ""
@@ -106,12 +186,13 @@ Sub8TorpedoBoardDetector::Sub8TorpedoBoardDetector() try : image_transport(nh),
           << setw(2 * tab_sz) << ""
           << "\x1b[37m" << activation << "\x1b[0m\n";
 
-  // Start main detector loop
+  // Frames are processed by the shared vision worker pool, paused until detection is activated
   run_id = 0;
-  boost::thread main_loop_thread(boost::bind(&Sub8TorpedoBoardDetector::run, this));
-  main_loop_thread.detach();
+  if (!event_driven)
+    poll_timer = nh.createWallTimer(ros::WallDuration(0.1), &Sub8TorpedoBoardDetector::poll, this);
   log_msg << setw(1 * tab_sz) << ""
-          << "Running main detector loop in a background thread\n";
+          << "Processing frames in the shared vision worker pool (" << VisionWorkerPool::shared().threads()
+          << " threads)\n";
 
   log_msg << "Sub8TorpedoBoardDetector Initialized\n";
   ROS_INFO(log_msg.str().c_str());
@@ -125,19 +206,81 @@ catch (const exception &e)
 
 Sub8TorpedoBoardDetector::~Sub8TorpedoBoardDetector()
 {
+  poll_timer.stop();
+  VisionWorkerPool::shared().stop_task(pool_task);
   ROS_INFO("Killed Torpedo Board Detector");
 }
 
-void Sub8TorpedoBoardDetector::run()
+void Sub8TorpedoBoardDetector::poll(const ros::WallTimerEvent &)
+{
+  // process images 10 times per second
+  if (!active)
+    return;
+  StereoPair frames;
+  left_mtx.lock();
+  frames.left = left_most_recent;
+  left_mtx.unlock();
+  right_mtx.lock();
+  frames.right = right_most_recent;
+  right_mtx.unlock();
+  VisionWorkerPool::shared().submit(pool_task,
+                                    boost::bind(&Sub8TorpedoBoardDetector::determine_torpedo_board_position, this,
+                                                frames));
+}
+
+void Sub8TorpedoBoardDetector::process_queued_pair()
 {
-  ros::Rate loop_rate(10);  // process images 10 times per second
-  while (ros::ok())
+  StereoPair frames;
   {
-    if (active)
-      determine_torpedo_board_position();
-    loop_rate.sleep();
+    boost::lock_guard<boost::mutex> lock(pair_mtx);
+    if (pair_queue.empty())
+      return;
+    frames = pair_queue.front();
+    pair_queue.pop_front();
+    if (dropped_pairs > 0)
+    {
+      ROS_WARN_THROTTLE(5, "Torpedo Board Detector: dropped %zu stereo pairs, processing is slower than the cameras",
+                        dropped_pairs);
+      dropped_pairs = 0;
+    }
   }
-  return;
+  if (active)
+    determine_torpedo_board_position(frames);
+
+  // Come back for the next pair, after other tasks of the same priority waiting in the pool
+  boost::lock_guard<boost::mutex> lock(pair_mtx);
+  if (!pair_queue.empty())
+    VisionWorkerPool::shared().submit(pool_task, boost::bind(&Sub8TorpedoBoardDetector::process_queued_pair, this));
+}
+
+// Call with pair_mtx held. Queues the unpaired frames if they make a synchronized pair.
+void Sub8TorpedoBoardDetector::queue_stereo_pair()
+{
+  if (left_unpaired.image_msg_ptr == NULL || right_unpaired.image_msg_ptr == NULL)
+    return;
+  const ros::Time &left_stamp = left_unpaired.image_msg_ptr->header.stamp;
+  const ros::Time &right_stamp = right_unpaired.image_msg_ptr->header.stamp;
+  double sync_error = fabs((left_stamp - right_stamp).toSec());
+  if (sync_error > pair_sync_thresh)
+    return;  // The older frame is replaced when its camera sends the next one
+
+  StereoPair frames;
+  frames.left = left_unpaired;
+  frames.right = right_unpaired;
+  left_unpaired = mil_vision::ImageWithCameraInfo();
+  right_unpaired = mil_vision::ImageWithCameraInfo();
+  if (!active)
+    return;
+
+  if (pair_queue.size() >= max_queued_pairs)
+  {
+    dropped_pairs++;
+    if (drop_policy == DropPolicy::DROP_NEWEST)
+      return;
+    pair_queue.pop_front();
+  }
+  pair_queue.push_back(frames);
+  VisionWorkerPool::shared().submit(pool_task, boost::bind(&Sub8TorpedoBoardDetector::process_queued_pair, this));
 }
 
 bool Sub8TorpedoBoardDetector::detection_activation_switch(sub8_msgs::TBDetectionSwitch::Request &req,
@@ -148,7 +291,12 @@ bool Sub8TorpedoBoardDetector::detection_activation_switch(sub8_msgs::TBDetectio
   ros_log << "\x1b[1;31mSetting torpedo board detection to: \x1b[1;37m" << (req.detection_switch ? "on" : "off")
           << "\x1b[0m";
   ROS_INFO(ros_log.str().c_str());
+  if (active != req.detection_switch)
+    pose_refiner.reset();
   active = req.detection_switch;
+  // Mission code can set the priority before each activation
+  int priority = max(1, ros::param::param<int>("/torpedo_vision/priority", 1));
+  VisionWorkerPool::shared().set_priority(pool_task, active ? priority : 0);
   if (active == req.detection_switch)
   {
     resp.success = true;
@@ -164,6 +312,14 @@ void Sub8TorpedoBoardDetector::left_image_callback(const sensor_msgs::ImageConst
   left_most_recent.image_msg_ptr = image_msg_ptr;
   left_most_recent.info_msg_ptr = info_msg_ptr;
   left_mtx.unlock();
+
+  if (event_driven)
+  {
+    boost::lock_guard<boost::mutex> lock(pair_mtx);
+    left_unpaired.image_msg_ptr = image_msg_ptr;
+    left_unpaired.info_msg_ptr = info_msg_ptr;
+    queue_stereo_pair();
+  }
 }
 
 void Sub8TorpedoBoardDetector::right_image_callback(const sensor_msgs::ImageConstPtr &image_msg_ptr,
@@ -173,32 +329,38 @@ void Sub8TorpedoBoardDetector::right_image_callback(const sensor_msgs::ImageCons
   right_most_recent.image_msg_ptr = image_msg_ptr;
   right_most_recent.info_msg_ptr = info_msg_ptr;
   right_mtx.unlock();
+
+  if (event_driven)
+  {
+    boost::lock_guard<boost::mutex> lock(pair_mtx);
+    right_unpaired.image_msg_ptr = image_msg_ptr;
+    right_unpaired.info_msg_ptr = info_msg_ptr;
+    queue_stereo_pair();
+  }
 }
 
-void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
+void Sub8TorpedoBoardDetector::determine_torpedo_board_position(const StereoPair &frames)
 {
   stringstream dbg_str;
+  generate_dbg_img = debug_image_pub.wanted();
 
   // Prevent segfault if service is called before we get valid img_msg_ptr's
-  if (left_most_recent.image_msg_ptr == NULL || right_most_recent.image_msg_ptr == NULL)
+  if (frames.left.image_msg_ptr == NULL || frames.right.image_msg_ptr == NULL)
   {
     ROS_WARN("Torpedo Board Detector: Image Pointers are NULL.");
     return;
   }
 
-  // Get the most recent frames and camera info for both cameras
+  // Get the frames and camera info for both cameras, the messages they point to are never modified
   cv_bridge::CvImagePtr input_bridge;
   Mat current_image_left, current_image_right, processing_size_image_left, processing_size_image_right,
       segmented_board_left, segmented_board_right;
   try
   {
-    left_mtx.lock();
-    right_mtx.lock();
-
     // Left Camera
-    input_bridge = cv_bridge::toCvCopy(left_most_recent.image_msg_ptr, sensor_msgs::image_encodings::BGR8);
+    input_bridge = cv_bridge::toCvCopy(frames.left.image_msg_ptr, sensor_msgs::image_encodings::BGR8);
     current_image_left = input_bridge->image;
-    left_cam_model.fromCameraInfo(left_most_recent.info_msg_ptr);
+    left_rectifier.update(*frames.left.info_msg_ptr);
     resize(current_image_left, processing_size_image_left, Size(0, 0), image_proc_scale, image_proc_scale);
     if (current_image_left.channels() != 3)
     {
@@ -207,31 +369,26 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
     }
 
     // Right Camera
-    input_bridge = cv_bridge::toCvCopy(right_most_recent.image_msg_ptr, sensor_msgs::image_encodings::BGR8);
+    input_bridge = cv_bridge::toCvCopy(frames.right.image_msg_ptr, sensor_msgs::image_encodings::BGR8);
     current_image_right = input_bridge->image;
-    right_cam_model.fromCameraInfo(right_most_recent.info_msg_ptr);
+    right_rectifier.update(*frames.right.info_msg_ptr);
     resize(current_image_right, processing_size_image_right, Size(0, 0), image_proc_scale, image_proc_scale);
     if (current_image_right.channels() != 3)
     {
       ROS_ERROR("The right image topic does not contain a color image.");
       return;
     }
-
-    left_mtx.unlock();
-    right_mtx.unlock();
   }
   catch (const exception &ex)
   {
     ROS_ERROR("[torpedo_board] cv_bridge: Failed to convert images");
-    left_mtx.unlock();
-    right_mtx.unlock();
     return;
   }
 
   // Enforce approximate image synchronization
   double left_stamp, right_stamp;
-  left_stamp = left_most_recent.image_msg_ptr->header.stamp.toSec();
-  right_stamp = right_most_recent.image_msg_ptr->header.stamp.toSec();
+  left_stamp = frames.left.image_msg_ptr->header.stamp.toSec();
+  right_stamp = frames.right.image_msg_ptr->header.stamp.toSec();
   double sync_error = fabs(left_stamp - right_stamp);
   stringstream sync_msg;
   sync_msg << "Left and right images were not sufficiently synchronized"
@@ -321,11 +478,21 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
 
   // Calculate stereo correspondence
   vector<int> correspondence_pair_idxs;
-  // stereo_correspondence(l_diffused, r_diffused, features_l, features_r, correspondence_pair_idxs);
-
-  // Dumb stereo matching
-  cout << "Stereo matching..." << endl;
+  if (stereo_matching != StereoMatching::NEAREST)
   {
+    vector<vector<int> > corresponding_feat_idxs;
+    if (stereo_matching == StereoMatching::RECTIFIED)
+      rectified_stereo_correspondence(l_diffused, r_diffused, features_l, features_r, corresponding_feat_idxs);
+    else
+      stereo_correspondence(l_diffused, r_diffused, features_l, features_r, corresponding_feat_idxs);
+    correspondence_pair_idxs.assign(features_l.size(), -1);
+    for (const vector<int> &pair_idxs : corresponding_feat_idxs)
+      correspondence_pair_idxs[pair_idxs[0]] = pair_idxs[1];
+  }
+  else
+  {
+    // Dumb stereo matching
+    cout << "Stereo matching..." << endl;
     double curr_min_dist, xdiff, ydiff, dist;
     int curr_min_dist_idx;
     int y_diff_thresh = diffusion_size_left.rows * 0.02;
@@ -364,35 +531,41 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
   }
 
   // Get camera projection matrices
-  Matx34d left_cam_mat = left_cam_model.fullProjectionMatrix();
-  Matx34d right_cam_mat = right_cam_model.fullProjectionMatrix();
+  Matx34d left_cam_mat = left_rectifier.model()->fullProjectionMatrix();
+  Matx34d right_cam_mat = right_rectifier.model()->fullProjectionMatrix();
 
   // Calculate 3D stereo reconstructions
-  vector<Eigen::Vector3d> feature_pts_3d;
-  Eigen::Vector3d pt_3D;
+  vector<Point2d> pts_L, pts_R;
   double reset_scaling = 1 / image_proc_scale;
-  cout << "feature reconstructions(3D):\n";
   for (size_t i = 0; i < correspondence_pair_idxs.size(); i++)
   {
     if (correspondence_pair_idxs[i] == -1)
       continue;
-    Point2d pt_L = features_l[i];
-    Point2d pt_R = features_r[correspondence_pair_idxs[i]];
-
     // Undo the effects of working with coordinates from scaled images
-    pt_L = pt_L * reset_scaling;
-    pt_R = pt_R * reset_scaling;
-
+    pts_L.push_back(Point2d(features_l[i]) * reset_scaling);
+    pts_R.push_back(Point2d(features_r[correspondence_pair_idxs[i]]) * reset_scaling);
+  }
+  if (!rectified_input)
+  {
+    // Triangulation assumes rectified pixels, so the features are rectified all at once for each camera
+    vector<Point2f> raw, rectified;
+    raw.assign(pts_L.begin(), pts_L.end());
+    left_rectifier.rectifyPoints(raw, rectified);
+    pts_L.assign(rectified.begin(), rectified.end());
+    raw.assign(pts_R.begin(), pts_R.end());
+    right_rectifier.rectifyPoints(raw, rectified);
+    pts_R.assign(rectified.begin(), rectified.end());
+  }
+  vector<Eigen::Vector3d> feature_pts_3d(pts_L.size());
+  mil_vision::triangulate_Linear_LS(left_cam_mat, right_cam_mat, pts_L.data(), pts_R.data(), pts_L.size(),
+                                    feature_pts_3d.data());
+  cout << "feature reconstructions(3D):\n";
+  for (size_t i = 0; i < feature_pts_3d.size(); i++)
+  {
     // Print points in image coordinates
-    cout << "L: " << pt_L << "R: " << pt_R << endl;
-
-    Matx31d pt_L_hom(pt_L.x, pt_L.y, 1);
-    Matx31d pt_R_hom(pt_R.x, pt_R.y, 1);
-    Mat X_hom = mil_vision::triangulate_Linear_LS(Mat(left_cam_mat), Mat(right_cam_mat), Mat(pt_L_hom), Mat(pt_R_hom));
-    X_hom = X_hom / X_hom.at<double>(3, 0);
-    pt_3D << X_hom.at<double>(0, 0), X_hom.at<double>(1, 0), X_hom.at<double>(2, 0);
+    cout << "L: " << pts_L[i] << "R: " << pts_R[i] << endl;
+    const Eigen::Vector3d &pt_3D = feature_pts_3d[i];
     cout << "[ " << pt_3D(0) << ", " << pt_3D(1) << ", " << pt_3D(2) << "]" << endl;
-    feature_pts_3d.push_back(pt_3D);
   }
   cout << "num 3D features: " << feature_pts_3d.size() << endl;
 
@@ -414,165 +587,43 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
   waitKey(1);
 
   // Pick a combination of four points that closely matches our model
-  vector<vector<uint8_t> > four_pt_combo_idxs;
-  mil_tools::combinations(feature_pts_3d.size(), 4, four_pt_combo_idxs);
-
-  Eigen::Vector3d centroid;
   double model_height = 1.7;
   double model_width = 0.85;
-  double dist_to_centroid_ideal = sqrt(model_height * model_height / 4 + model_width * model_width / 4);
-  double sum_network_distances_ideal =
-      2 * sqrt(model_height * model_height + model_width * model_width) + 2 * model_height + 2 * model_width;
-  double xdiff, ydiff, zdiff;
-  double dist_to_centroid_relative_error_thresh = 0.05;
-  int curr_min_cost_idx = -1;
-  double curr_min_cost = 1E9;
-  cout << "dist_to_centroid_ideal: " << dist_to_centroid_ideal << endl;
-  cout << "dist_to_centroid_relative_error_thresh: " << dist_to_centroid_relative_error_thresh << endl;
-  cout << "sum_network_distances_ideal: " << sum_network_distances_ideal << endl;
-  cout << "dist_to_centroid_relative_error_thresh: " << dist_to_centroid_relative_error_thresh << endl;
-  vector<double> board_plane_coeffs;
-  vector<Eigen::Vector3d> corrected_corners(4, Eigen::Vector3d());
-  for (size_t i = 0; i < four_pt_combo_idxs.size(); i++)
+  double max_model_cost = 0.05;
+  vector<uint8_t> board_idxs;
+  double curr_min_cost =
+      ransac_corner_search ?
+          best_rectangle_combination_ransac(feature_pts_3d, model_height, model_width, max_model_cost,
+                                            ransac_hypotheses, corner_rng, board_idxs) :
+          best_rectangle_combination(feature_pts_3d, model_height, model_width, max_model_cost, board_idxs);
+  cout << "min_cost: " << curr_min_cost << endl;
+  if (curr_min_cost < max_model_cost)
   {
-    cout << i << " idxs: " << (int)four_pt_combo_idxs[i][0] << ", " << (int)four_pt_combo_idxs[i][1] << ", "
-         << (int)four_pt_combo_idxs[i][2] << ", " << (int)four_pt_combo_idxs[i][3] << endl;
-
-    // Calculate the avg distance to the centroid
-    double xsum = 0;
-    double ysum = 0;
-    double zsum = 0;
-    double dist_to_centroid_avg = 0;
-    for (uint8_t pt_idx : four_pt_combo_idxs[i])
-    {
-      xsum += feature_pts_3d[pt_idx][0];
-      ysum += feature_pts_3d[pt_idx][1];
-      zsum += feature_pts_3d[pt_idx][2];
-    }
-    for (uint8_t pt_idx : four_pt_combo_idxs[i])
-    {
-      xdiff = feature_pts_3d[pt_idx][0] - xsum / 4.0;
-      ydiff = feature_pts_3d[pt_idx][1] - ysum / 4.0;
-      zdiff = feature_pts_3d[pt_idx][2] - zsum / 4.0;
-      dist_to_centroid_avg += sqrt(xdiff * xdiff + ydiff * ydiff + zdiff * zdiff);
-    }
-    dist_to_centroid_avg /= 4.0;
-    double dist_to_centroid_avg_error = fabs(dist_to_centroid_avg - dist_to_centroid_ideal) / dist_to_centroid_ideal;
-    cout << "\tdist_to_centroid_avg: " << dist_to_centroid_avg << endl;
-    cout << "\tdist_error: " << dist_to_centroid_avg_error << endl;
-    // Disqualify if too far from model
-    // if(dist_to_centroid_avg_error > dist_to_centroid_relative_error_thresh) continue;
-
-    // Calc sum of all distances
-    double model_matching_cost = 0;
-    double sum_network_distances = 0;
-    vector<double> network_distances, model_match_costs;
-    vector<vector<uint8_t> > four_choose_2;
-    mil_tools::combinations(4, 2, four_choose_2);
-    for (vector<uint8_t> pair_idx : four_choose_2)
-    {
-      double dist =
-          (feature_pts_3d[four_pt_combo_idxs[i][pair_idx[0]]] - feature_pts_3d[four_pt_combo_idxs[i][pair_idx[1]]])
-              .norm();
-      network_distances.push_back(dist);
-      sum_network_distances += dist;
-      cout << "\t\t\x1b[32mdist:" << dist << endl << "\x1b[0m";
-    }
-    cout << "\t\t\x1b[32msum_network_distances:" << sum_network_distances << endl << "\x1b[0m";
-    // Disqualify if too far from model
-    // if(sum_network_distances_relative_error > sum_network_distances_relative_error_thresh) continue;
-
-    // Calculate a cost function for departure from model
-    sort(network_distances.begin(), network_distances.end());
-    // Compare graph edge lengths with expectations
-    model_match_costs.push_back(pow(network_distances[0] - model_width, 2.0));
-    model_match_costs.push_back(pow(network_distances[1] - model_width, 2.0));
-    model_match_costs.push_back(pow(network_distances[2] - model_height, 2.0));
-    model_match_costs.push_back(pow(network_distances[3] - model_height, 2.0));
-    model_match_costs.push_back(
-        pow(network_distances[4] - sqrt(model_height * model_height + model_width * model_width), 2.0));
-    model_match_costs.push_back(
-        pow(network_distances[5] - sqrt(model_height * model_height + model_width * model_width), 2.0));
-    for (double cost : model_match_costs)
-    {
-      cout << "\tcost: " << cost << endl;
-      model_matching_cost += cost;
-    }
-    // Add cost for departure from expected right angle corners
-    double orthogonality_measure = 0;
-    double orthogonality_weight = 1.0;
-    for (size_t j = 0; j < four_pt_combo_idxs[i].size(); j++)
-    {
-      // eliminate most distant point
-      int max_dist_idx = j;
-      int max_dist = -1;
-      for (size_t k = 0; k < four_pt_combo_idxs[i].size(); k++)
-      {
-        if (j == k)
-          continue;
-        double dist = (feature_pts_3d[four_pt_combo_idxs[i][j]] - feature_pts_3d[four_pt_combo_idxs[i][k]]).norm();
-        if (dist < max_dist)
-        {
-          max_dist_idx = k;
-          max_dist = dist;
-        }
-      }
-      // vectors formed with two other points should have zero dot product
-      Eigen::Vector3d v1, v2;
-      bool first = true;
-      for (size_t k = 0; k < four_pt_combo_idxs[i].size(); k++)
-      {
-        if (k == j || k == (size_t)max_dist_idx)
-          continue;
-        if (first)
-        {
-          v1 = feature_pts_3d[four_pt_combo_idxs[i][k]] - feature_pts_3d[four_pt_combo_idxs[i][j]];
-          first = false;
-        }
-        else
-          v2 = feature_pts_3d[four_pt_combo_idxs[i][k]] - feature_pts_3d[four_pt_combo_idxs[i][j]];
-      }
-      //  orthogonality_measure will be zero if perfectly orthogonal
-      orthogonality_measure += fabs(v1.dot(v2) / (v1.norm() * v2.norm()));
-    }
-    orthogonality_measure /= 4.0;
-    // increase cost if not close to right angle corners
-    model_matching_cost *= (1.0 + orthogonality_weight * orthogonality_measure);
-    cout << "orthogonality_measure: " << orthogonality_measure << endl;
-
-    cout << "\t\t\x1b[32mmodel_matching_cost:" << model_matching_cost << endl << "\x1b[0m";
-    if (model_matching_cost < curr_min_cost)
-    {
-      curr_min_cost = model_matching_cost;
-      curr_min_cost_idx = i;
-    }
-  }
-  cout << "min_cost_idx: " << curr_min_cost_idx << " min_cost: " << curr_min_cost << endl;
-  if (curr_min_cost < 0.05)
-  {
-    cout << "Model found at index: " << curr_min_cost_idx << endl;
+    cout << "Model found at: " << (int)board_idxs[0] << ", " << (int)board_idxs[1] << ", " << (int)board_idxs[2]
+         << ", " << (int)board_idxs[3] << endl;
   }
   else
   {
     cout << "Model not found" << endl;
     return;
   }
+  vector<Eigen::Vector3d> corrected_corners(4, Eigen::Vector3d());
 
   // Calculate best fit plane
   Eigen::Matrix<double, 4, 3> A;
   Eigen::Matrix<double, 4, 1> b_vec;
-  A << feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][0]][0],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][0]][1],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][0]][2],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][1]][0],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][1]][1],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][1]][2],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][2]][0],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][2]][1],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][2]][2],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][3]][0],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][3]][1],
-      feature_pts_3d[four_pt_combo_idxs[curr_min_cost_idx][3]][2];
+  A << feature_pts_3d[board_idxs[0]][0],
+      feature_pts_3d[board_idxs[0]][1],
+      feature_pts_3d[board_idxs[0]][2],
+      feature_pts_3d[board_idxs[1]][0],
+      feature_pts_3d[board_idxs[1]][1],
+      feature_pts_3d[board_idxs[1]][2],
+      feature_pts_3d[board_idxs[2]][0],
+      feature_pts_3d[board_idxs[2]][1],
+      feature_pts_3d[board_idxs[2]][2],
+      feature_pts_3d[board_idxs[3]][0],
+      feature_pts_3d[board_idxs[3]][1],
+      feature_pts_3d[board_idxs[3]][2];
   b_vec << 1, 1, 1, 1;
   Eigen::Matrix<double, 3, 1> x = A.colPivHouseholderQr().solve(b_vec);
   double a, b, c, d;
@@ -589,7 +640,7 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
   plane_unit_normal = plane_unit_normal / plane_unit_normal.norm();
   Eigen::Vector3d pt_on_plane;
   pt_on_plane << 0, 0, -d / c;
-  for (uint8_t pt_idx : four_pt_combo_idxs[curr_min_cost_idx])
+  for (uint8_t pt_idx : board_idxs)
   {
     Eigen::Vector3d pt = feature_pts_3d[pt_idx];
     Eigen::Vector3d plane_to_pt_vec = pt - pt_on_plane;
@@ -649,7 +700,7 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
   //   cout << distance << " ";
   // }
 
-  for (int idx : four_pt_combo_idxs[curr_min_cost_idx])
+  for (int idx : board_idxs)
   {
     Eigen::Vector3d pt = feature_pts_3d[idx];
     Matx41d position_hom(pt(0), pt(1), pt(2), 1);
@@ -770,8 +821,8 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
 
   // Segment Board and find image coordinates of board corners
   Mat left_segment_dbg_img, right_segment_dbg_img;
-  segment_board(processing_size_image_left, segmented_board_left, left_segment_dbg_img, false);
-  segment_board(processing_size_image_right, segmented_board_right, right_segment_dbg_img, true);
+  segment_board(processing_size_image_left, segmented_board_left, left_segment_dbg_img, true, false);
+  segment_board(processing_size_image_right, segmented_board_right, right_segment_dbg_img, false, true);
 #ifdef SEGMENTATION_DEBUG
   imshow("segmented right", segmented_board_right);
   waitKey(1);
@@ -825,19 +876,14 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
   }
 
   // Reconstruct 3d corners from corresponding image points
-  vector<Eigen::Vector3d> corners_3d;
-  Eigen::Vector3d X;
+  Point2d corners_L[4], corners_R[4];
   for (int i = 0; i < 4; i++)
   {
-    Point2d pt_L_ = left_corners[i];
-    Point2d pt_R_ = right_corners[i];
-    Matx31d pt_L(pt_L_.x, pt_L_.y, 1);
-    Matx31d pt_R(pt_R_.x, pt_R_.y, 1);
-    Mat X_hom = mil_vision::triangulate_Linear_LS(Mat(left_cam_mat), Mat(right_cam_mat), Mat(pt_L), Mat(pt_R));
-    X_hom = X_hom / X_hom.at<double>(3, 0);
-    X << X_hom.at<double>(0, 0), X_hom.at<double>(1, 0), X_hom.at<double>(2, 0);
-    corners_3d.push_back(X);
+    corners_L[i] = left_corners[i];
+    corners_R[i] = right_corners[i];
   }
+  vector<Eigen::Vector3d> corners_3d(4);
+  mil_vision::triangulate_Linear_LS(left_cam_mat, right_cam_mat, corners_L, corners_R, 4, corners_3d.data());
 
   // Calculate 3d board position (center of board)
   Eigen::Vector3d position(0, 0, 0);
@@ -881,44 +927,27 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
   Eigen::Quaterniond orientation;
   orientation.setFromTwoVectors(neg_z_axis, normal_vector);
 
-  /*
-    // In case we ever get CERES support on the sub
-
-    // Calculate quaternion encoding only the component of rotation about the
-    y-axis (yaw)
-    double mag, x, y, z, w;
-    x = z = 0;
-    y = orientation.y();
-    w = orientation.w();
-    mag = pow(y * y + w * w, 0.5);
-    y /= mag;
-    w /= mag;
-    Eigen::Quaterniond yaw_quat(w, x, y, z);
-    // Declare initial guess for optimization
-    double center_x = position(0);
-    double center_y = position(1);
-    double center_z = position(2);
-    double yaw = 2 * acos( yaw_quat.w());
-    // Define Problem and add residual block
-    ceres::Problem max_likelihood_pose_estimation;
-    TorpedoBoardReprojectionCost cost_functor(left_cam_mat, right_cam_mat,
-    left_corners, right_corners);
-    ceres::CostFunction* reprojection_error_cost = new
-    ceres::AutoDiffCostFunction<TorpedoBoardReprojectionCost ,1 ,1, 1, 1,
-    1>(&cost_functor);
-    max_likelihood_pose_estimation.AddResidualBlock(reprojection_error_cost,
-    NULL, &center_x, &center_y, &center_z, &yaw);
-    ceres::Solver::Options options;
-    options.max_num_iterations = 100;
-    options.linear_solver_type = ceres::DENSE_QR;
-    ceres::Solve(options, &max_likelihood_pose_estimation, &summary);
-  */
+  // Refine the board center and its yaw, the part of the orientation the board can have, by minimizing the
+  // reprojection error of its corners in both cameras
+  if (refine_pose)
+  {
+    double pose[4] = { position(0), position(1), position(2), 2 * atan2(orientation.y(), orientation.w()) };
+    TorpedoBoardReprojectionCost reprojection_cost(left_cam_mat, right_cam_mat, left_corners, right_corners);
+    double reprojection_error = pose_refiner.refine(reprojection_cost, pose);
+    dbg_str << "refined pose: " << pose[0] << ", " << pose[1] << ", " << pose[2] << ", yaw " << pose[3]
+            << " reprojection error: " << reprojection_error << endl;
+    if (reprojection_error < numeric_limits<double>::infinity())
+    {
+      position << pose[0], pose[1], pose[2];
+      orientation = Eigen::Quaterniond(Eigen::AngleAxisd(pose[3], Eigen::Vector3d::UnitY()));
+    }
+  }
 
   // Fill in TorpBoardPoseRequest (in order)
   sub8_msgs::TorpBoardPoseRequest pose_req;
   pose_req.request.pose_stamped.header.seq = run_id++;
   pose_req.request.pose_stamped.header.stamp.fromSec(0.5 * (left_stamp + right_stamp));
-  string tf_frame = left_cam_model.tfFrame();
+  string tf_frame = left_rectifier.model()->tfFrame();
   pose_req.request.pose_stamped.header.frame_id = tf_frame;
   tf::pointEigenToMsg(position, pose_req.request.pose_stamped.pose.position);
   tf::quaternionEigenToMsg(orientation, pose_req.request.pose_stamped.pose.orientation);
@@ -986,8 +1015,8 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
     stringstream left_text, right_text;
     int height = debug_image(lower_left).rows;
     Point header_text_pt(height / 20.0, height / 10.0);
-    left_text << "Left  " << left_most_recent.image_msg_ptr->header.stamp;
-    right_text << "Right " << right_most_recent.image_msg_ptr->header.stamp;
+    left_text << "Left  " << frames.left.image_msg_ptr->header.stamp;
+    right_text << "Right " << frames.right.image_msg_ptr->header.stamp;
     int font = FONT_HERSHEY_SIMPLEX;
     double font_scale = 0.0015 * height;
     putText(ll_dbg, left_text.str(), header_text_pt, font, font_scale, color);
@@ -1001,13 +1030,16 @@ void Sub8TorpedoBoardDetector::determine_torpedo_board_position()
   rviz.visualize_torpedo_board(pose_req.request.pose_stamped.pose, orientation, targets, corners_3d, tf_frame);
 
   // ROS dbg_img visualization
-  sensor_msgs::ImagePtr dbg_img_msg = cv_bridge::CvImage(std_msgs::Header(), "bgr8", debug_image).toImageMsg();
-  debug_image_pub.publish(dbg_img_msg);
+  if (generate_dbg_img)
+  {
+    sensor_msgs::ImagePtr dbg_img_msg = cv_bridge::CvImage(std_msgs::Header(), "bgr8", debug_image).toImageMsg();
+    debug_image_pub.publish(dbg_img_msg);
+  }
   ros::spinOnce();
   return;
 }
 
-void Sub8TorpedoBoardDetector::segment_board(const Mat &src, Mat &dest, Mat &dbg_img, bool draw_dbg_img)
+void Sub8TorpedoBoardDetector::segment_board(const Mat &src, Mat &dest, Mat &dbg_img, bool left, bool draw_dbg_img)
 {
   // Preprocessing
   Mat hsv_image, hue_segment_dbg_img, sat_segment_dbg_img;
@@ -1015,28 +1047,30 @@ void Sub8TorpedoBoardDetector::segment_board(const Mat &src, Mat &dest, Mat &dbg
   cvtColor(src, hsv_image, CV_BGR2HSV);
   split(hsv_image, hsv_channels);
 
-  // Histogram parameters
-  int hist_size = 256;  // bin size
-  float range[] = { 0, 255 };
-  const float *ranges[] = { range };
-
   // Segment out torpedo board
   Mat threshed_hue, threshed_sat, segmented_board;
   int target_yellow = 20;
   int target_saturation = 180;
-  mil_vision::statistical_image_segmentation(hsv_channels[0], threshed_hue, hue_segment_dbg_img, hist_size, ranges,
-                                             target_yellow, "Hue", draw_dbg_img, 6, 3.0, 3.0);
-  mil_vision::statistical_image_segmentation(hsv_channels[1], threshed_sat, sat_segment_dbg_img, hist_size, ranges,
-                                             target_saturation, "Saturation", draw_dbg_img, 6, 0.1, 0.1);
+  mil_vision::StatisticalImageSegmenter &hue_segmenter = left ? hue_segmenter_left : hue_segmenter_right;
+  mil_vision::StatisticalImageSegmenter &sat_segmenter = left ? sat_segmenter_left : sat_segmenter_right;
+  hue_segmenter.segment(hsv_channels[0], threshed_hue, target_yellow, 3.0, 3.0);
+  sat_segmenter.segment(hsv_channels[1], threshed_sat, target_saturation, 0.1, 0.1);
+  if (generate_dbg_img && draw_dbg_img)
+  {
+    hue_segmenter.draw_debug_image(threshed_hue, hue_segment_dbg_img, "Hue");
+    sat_segmenter.draw_debug_image(threshed_sat, sat_segment_dbg_img, "Saturation");
+  }
+  ROS_DEBUG("segment_board: hue %.2f ms, saturation %.2f ms", hue_segmenter.last_timing().total_ms,
+            sat_segmenter.last_timing().total_ms);
 #ifdef SEGMENTATION_DEBUG
   imshow("segment board input", src);
   imshow("hue segment", threshed_hue);
   imshow("sat segment", threshed_sat);
   waitKey(1);
 #endif
-  segmented_board = threshed_hue / 2.0 + threshed_sat / 2.0;
+  // Both segmentations, which is what averaging them, median filtering and keeping what is above 90% amounts to
+  bitwise_and(threshed_hue, threshed_sat, segmented_board);
   medianBlur(segmented_board, segmented_board, 5);
-  threshold(segmented_board, segmented_board, 255 * 0.9, 255, THRESH_BINARY);
   dest = segmented_board;
 
   if (generate_dbg_img && draw_dbg_img)
@@ -1327,6 +1361,96 @@ void Sub8TorpedoBoardDetector::stereo_correspondence(const Mat &gray_L, const Ma
   }
 }
 
+void Sub8TorpedoBoardDetector::rectified_stereo_correspondence(const Mat &gray_L, const Mat &gray_R,
+                                                               const vector<Point> &features_L,
+                                                               const vector<Point> &features_R,
+                                                               vector<vector<int> > &corresponding_feats_idxs)
+{
+  /*
+    Same as stereo_correspondence, for rectified images. The match of a left feature is then on the same row of the
+    right image, to its left. The right features are bucketed by row, so each left feature is only compared with
+    those within epipolar_band rows of its own, and a pair is only kept if each feature is the best match of the
+    other.
+  */
+
+  // Rounding the features to whole pixels can put the match a pixel to the right
+  int min_disparity = -1;
+  int max_disparity = 0.050 * gray_L.rows;
+
+  // Size of comparison block should be odd
+  int block_size = gray_L.rows / 30;
+  block_size = block_size + (block_size % 2) - 1;
+  if (block_size < 1)
+    return;
+  int half_block = block_size / 2;
+  int dissimilarity_thresh = 1000;
+
+  // Exclude features whose blocks cross the edge of the image
+  Rect inner_L(half_block, half_block, gray_L.cols - 2 * half_block, gray_L.rows - 2 * half_block);
+  Rect inner_R(half_block, half_block, gray_R.cols - 2 * half_block, gray_R.rows - 2 * half_block);
+
+  // Right features by row, those of row y being row_feats[row_start[y]] to row_feats[row_start[y + 1] - 1]
+  vector<int> row_start(gray_R.rows + 1, 0);
+  for (const Point &R : features_R)
+    if (inner_R.contains(R))
+      row_start[R.y + 1]++;
+  partial_sum(row_start.begin(), row_start.end(), row_start.begin());
+  vector<int> row_feats(row_start.back());
+  vector<int> row_end(row_start.begin(), row_start.end() - 1);
+  for (size_t i = 0; i < features_R.size(); i++)
+    if (inner_R.contains(features_R[i]))
+      row_feats[row_end[features_R[i].y]++] = i;
+
+  // Best match of each feature in the other image, and its dissimilarity
+  vector<int> match_of_L(features_L.size(), -1), match_of_R(features_R.size(), -1);
+  vector<int> dissimilarity_R(features_R.size(), numeric_limits<int>::max());
+  for (size_t i = 0; i < features_L.size(); i++)
+  {
+    const Point &L = features_L[i];
+    if (!inner_L.contains(L))
+      continue;
+    Mat block_L = gray_L(Rect(L.x - half_block, L.y - half_block, block_size, block_size));
+    int min_dissimilarity = dissimilarity_thresh + 1;
+
+    // The rows of the band are contiguous in row_feats
+    int first_row = max(L.y - epipolar_band, 0);
+    int last_row = min(L.y + epipolar_band, gray_R.rows - 1);
+    for (int k = row_start[first_row]; k < row_start[last_row + 1]; k++)
+    {
+      int j = row_feats[k];
+      const Point &R = features_R[j];
+      int disparity = L.x - R.x;
+      if (disparity < min_disparity || disparity > max_disparity)
+        continue;
+
+      // Sum of absolute differences, vectorized by norm and without the temporary of absdiff
+      Mat block_R = gray_R(Rect(R.x - half_block, R.y - half_block, block_size, block_size));
+      int dissimilarity = cvRound(norm(block_L, block_R, NORM_L1));
+      if (dissimilarity < min_dissimilarity)
+      {
+        min_dissimilarity = dissimilarity;
+        match_of_L[i] = j;
+      }
+      if (dissimilarity < dissimilarity_R[j])
+      {
+        dissimilarity_R[j] = dissimilarity;
+        match_of_R[j] = i;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < features_L.size(); i++)
+  {
+    int j = match_of_L[i];
+    if (j == -1 || match_of_R[j] != int(i))
+      continue;
+    vector<int> correspondence_idxs;
+    correspondence_idxs.push_back(i);
+    correspondence_idxs.push_back(j);
+    corresponding_feats_idxs.push_back(correspondence_idxs);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 // Class: TorpedoBoardReprojectionCost ////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1344,7 +1468,6 @@ TorpedoBoardReprojectionCost::TorpedoBoardReprojectionCost(Matx34d &proj_mat_L,
 
 TorpedoBoardReprojectionCost::~TorpedoBoardReprojectionCost()
 {
-  cout << "TorpedoBoardReprojectionCost being destructed." << endl;
 }
 
 vector<Point> TorpedoBoardReprojectionCost::getProjectedCorners(double center_x, double center_y, double center_z,
@@ -1439,6 +1562,141 @@ bool TorpedoBoardReprojectionCost::operator()(const T *const x, const T *const y
   return true;
 }
 
+bool TorpedoBoardReprojectionCost::evaluate(const double *pose, double *residuals, double *jacobian) const
+{
+  // Model corners, top left, top right, bottom right and bottom left, rotated by yaw about the y axis
+  const double c = cos(pose[3]), s = sin(pose[3]);
+  const double model_x[4] = { -0.5 * width_m, 0.5 * width_m, 0.5 * width_m, -0.5 * width_m };
+  const double model_y[4] = { -0.5 * height_m, -0.5 * height_m, 0.5 * height_m, 0.5 * height_m };
+
+  const Matx34d *proj[2] = { &proj_L, &proj_R };
+  const vector<Point> *observed[2] = { &img_corners_L, &img_corners_R };
+  for (int cam = 0; cam < 2; cam++)
+  {
+    const Matx34d &P = *proj[cam];
+    for (int i = 0; i < 4; i++)
+    {
+      const double X[3] = { pose[0] + c * model_x[i], pose[1] + model_y[i], pose[2] - s * model_x[i] };
+      const double dX_dyaw[3] = { -s * model_x[i], 0, -c * model_x[i] };
+      double p[3];
+      for (int r = 0; r < 3; r++)
+        p[r] = P(r, 0) * X[0] + P(r, 1) * X[1] + P(r, 2) * X[2] + P(r, 3);
+      if (!(p[2] > 0))
+        return false;
+      const double u = p[0] / p[2], v = p[1] / p[2];
+
+      // The nearest observed corner is taken to correspond to this one
+      int nearest = 0;
+      double least_dist = numeric_limits<double>::infinity();
+      for (int j = 0; j < 4; j++)
+      {
+        double du = u - (*observed[cam])[j].x, dv = v - (*observed[cam])[j].y;
+        if (du * du + dv * dv < least_dist)
+        {
+          least_dist = du * du + dv * dv;
+          nearest = j;
+        }
+      }
+      const int row = 8 * cam + 2 * i;
+      residuals[row] = u - (*observed[cam])[nearest].x;
+      residuals[row + 1] = v - (*observed[cam])[nearest].y;
+      if (jacobian == NULL)
+        continue;
+
+      // d(u, v)/dX, then through X to the pose
+      double du_dX[3], dv_dX[3];
+      for (int k = 0; k < 3; k++)
+      {
+        du_dX[k] = (P(0, k) - u * P(2, k)) / p[2];
+        dv_dX[k] = (P(1, k) - v * P(2, k)) / p[2];
+      }
+      double *J_u = jacobian + 4 * row, *J_v = jacobian + 4 * (row + 1);
+      for (int k = 0; k < 3; k++)
+      {
+        J_u[k] = du_dX[k];
+        J_v[k] = dv_dX[k];
+      }
+      J_u[3] = du_dX[0] * dX_dyaw[0] + du_dX[2] * dX_dyaw[2];
+      J_v[3] = dv_dX[0] * dX_dyaw[0] + dv_dX[2] * dX_dyaw[2];
+    }
+  }
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Class: TorpedoBoardPoseRefiner /////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+TorpedoBoardPoseRefiner::TorpedoBoardPoseRefiner(int max_iterations, double time_budget)
+  : max_iterations(max_iterations), time_budget(time_budget), has_last_pose(false)
+{
+}
+
+void TorpedoBoardPoseRefiner::reset()
+{
+  has_last_pose = false;
+}
+
+double TorpedoBoardPoseRefiner::refine(const TorpedoBoardReprojectionCost &cost, double pose[4])
+{
+  typedef Eigen::Matrix<double, TorpedoBoardReprojectionCost::num_residuals, 1> Residuals;
+  typedef Eigen::Matrix<double, TorpedoBoardReprojectionCost::num_residuals, 4, Eigen::RowMajor> Jacobian;
+  ros::WallTime start = ros::WallTime::now();
+  Residuals r;
+  Jacobian J;
+
+  // Warm start from the last pose if it fits better than the initial guess
+  Eigen::Vector4d x(pose[0], pose[1], pose[2], pose[3]);
+  double x_cost = cost.evaluate(x.data(), r.data(), NULL) ? r.squaredNorm() : numeric_limits<double>::infinity();
+  if (has_last_pose && cost.evaluate(last_pose, r.data(), NULL) && r.squaredNorm() < x_cost)
+  {
+    x = Eigen::Vector4d(last_pose[0], last_pose[1], last_pose[2], last_pose[3]);
+    x_cost = r.squaredNorm();
+  }
+  if (x_cost == numeric_limits<double>::infinity())
+  {
+    has_last_pose = false;
+    return x_cost;
+  }
+
+  double lambda = 1E-3;
+  cost.evaluate(x.data(), r.data(), J.data());
+  for (int iteration = 0; iteration < max_iterations; iteration++)
+  {
+    if ((ros::WallTime::now() - start).toSec() > time_budget)
+      break;
+
+    // Damped normal equations
+    Eigen::Matrix4d H = J.transpose() * J;
+    Eigen::Vector4d g = J.transpose() * r;
+    Eigen::Matrix4d damped = H;
+    damped.diagonal() += lambda * H.diagonal().cwiseMax(1E-9);
+    Eigen::Vector4d step = damped.ldlt().solve(-g);
+    if (!step.allFinite() || step.norm() < 1E-9)
+      break;
+
+    Eigen::Vector4d candidate = x + step;
+    Residuals candidate_r;
+    if (cost.evaluate(candidate.data(), candidate_r.data(), NULL) && candidate_r.squaredNorm() < x_cost)
+    {
+      double decrease = x_cost - candidate_r.squaredNorm();
+      x = candidate;
+      x_cost = candidate_r.squaredNorm();
+      cost.evaluate(x.data(), r.data(), J.data());
+      lambda = max(lambda / 10, 1E-9);
+      if (decrease < 1E-9 * x_cost)
+        break;
+    }
+    else
+      lambda *= 10;
+  }
+
+  for (int k = 0; k < 4; k++)
+    pose[k] = last_pose[k] = x[k];
+  has_last_pose = true;
+  return x_cost;
+}
+
 // vector<Point2d> project_model(Eigen::Matrix<double, 3, 4> cam_matx, Eigen::Vector3d position, Eigen::Quaterniond
 // orientation){
 //   // all units in meters
@@ -1460,169 +1718,303 @@ bool TorpedoBoardReprojectionCost::operator()(const T *const x, const T *const y
 // Helper Functions ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-void anisotropic_diffusion(const Mat &src, Mat &dest, int t_max)
+namespace
 {
-  Mat x = src;
-  Mat x0;
-  x.convertTo(x0, CV_32FC1);
-
-  double t = 0;
-  double lambda = 0.25;             // Defined in equation (7)
-  double K = 10, K2 = (1 / K / K);  // defined after equation(13) in text
-
-  Mat dI00 = Mat::zeros(x0.size(), CV_32F);
-
-  Mat x1, xc;
-
-  while (t < t_max)
+// Conduction coefficient and flux of one diffusion iteration for a band of rows, equations (5) and (7). The
+// coefficients of each row are computed once, in a ring of the three rows around the one whose flux is found.
+class DiffusionFlux : public ParallelLoopBody
+{
+public:
+  DiffusionFlux(const Mat &x, Mat &flux, vector<float> &row_max) : x(x), flux(flux), row_max(row_max)
   {
-    Mat D;               // defined just before equation (5) in text
-    Mat gradxX, gradyX;  // Image Gradient t time
-    Sobel(x0, gradxX, CV_32F, 1, 0, 3);
-    Sobel(x0, gradyX, CV_32F, 0, 1, 3);
-    D = Mat::zeros(x0.size(), CV_32F);
+  }
 
-    for (int i = 0; i < x0.rows; i++)
-      for (int j = 0; j < x0.cols; j++)
+  void operator()(const Range &range) const
+  {
+    const int rows = x.rows, cols = x.cols;
+    vector<float> ring(3 * cols);
+    int computed = max(range.start - 1, 0) - 1;  // last row whose coefficients are in the ring
+    for (int i = range.start; i < range.end; i++)
+    {
+      int up = max(i - 1, 0), down = min(i + 1, rows - 1);
+      while (computed < down)
       {
-        float gx = gradxX.at<float>(i, j), gy = gradyX.at<float>(i, j);
-        float d;
-        if (i == 0 || i == x0.rows - 1 || j == 0 || j == x0.cols - 1)  // conduction coefficient set to
-          d = 1;                                                       // 1 p633 after equation 13
-        else
-          d = 1.0 / (1 + (gx * gx + 0 * gy * gy) * K2);  // expression of g(gradient(I))
-                                                         // d =-exp(-(gx*gx+gy*gy)*K2); // expression of g(gradient(I))
-        D.at<float>(i, j) = d;
+        computed++;
+        conduction(computed, &ring[(computed % 3) * cols]);
       }
 
-    x1 = Mat::zeros(x0.size(), CV_32F);
-    double maxD = 0, intxx = 0;
-    {
-      int i = 0;
-      float *u1 = (float *)x1.ptr(i);
-      u1++;
-      for (int j = 1; j < x0.cols - 1; j++, u1++)
+      // Outside the image, use the pixel itself as neighbor so those terms of the flux are exactly 0
+      const float *xu = x.ptr<float>(up), *xc = x.ptr<float>(i), *xn = x.ptr<float>(down);
+      const float *du = &ring[(up % 3) * cols], *dc = &ring[(i % 3) * cols], *dn = &ring[(down % 3) * cols];
+      float *f = flux.ptr<float>(i);
+      float m = 0;
+      for (int j = 1; j < cols - 1; j++)
+        f[j] = (dn[j] + dc[j]) * (xn[j] - xc[j]) + (dc[j + 1] + dc[j]) * (xc[j + 1] - xc[j]) +
+               (du[j] + dc[j]) * (xu[j] - xc[j]) + (dc[j - 1] + dc[j]) * (xc[j - 1] - xc[j]);
+      // Kept out of the loop above, which vectorizes without it
+      for (int j = 1; j < cols - 1; j++)
+        m = max(m, fabs(f[j]));
+
+      // The corners have no flux, and the right column is held fixed as it always has been
+      int j = cols - 1;
+      f[j] = 0;
+      if (i == 0 || i == rows - 1)
+        f[0] = 0;
+      else
       {
-        // Value of I at (i+1,j),(i,j+1)...(i,j)
-        float ip10 = x0.at<float>(i + 1, j), i0p1 = x0.at<float>(i, j + 1);
-        float i0m1 = x0.at<float>(i, j - 1), i00 = x0.at<float>(i, j);
-
-        // Value of D at at (i+1,j),(i,j+1)...(i,j)
-        float cp10 = D.at<float>(i + 1, j), c0p1 = D.at<float>(i, j + 1);
-        float c0m1 = D.at<float>(i, j - 1), c00 = D.at<float>(i, j);
-
-        // Equation (7) p632
-        double xx = (cp10 + c00) * (ip10 - i00) + (c0p1 + c00) * (i0p1 - i00) + (c0m1 + c00) * (i0m1 - i00);
-        dI00.at<float>(i, j) = xx;
-        if (maxD < fabs(xx))
-          maxD = fabs(xx);
-        intxx += fabs(xx);
-        // equation (9)
+        f[0] = (dn[0] + dc[0]) * (xn[0] - xc[0]) + (dc[1] + dc[0]) * (xc[1] - xc[0]) +
+               (du[0] + dc[0]) * (xu[0] - xc[0]);
+        m = max(m, fabs(f[0]));
       }
+      row_max[i] = m;
     }
+  }
 
-    for (int i = 1; i < x0.rows - 1; i++)
+private:
+  // Conduction coefficients of row i, from the horizontal 3x3 Sobel gradient. They are 1 on the edges of the image,
+  // p633 after equation 13.
+  void conduction(int i, float *d) const
+  {
+    const int cols = x.cols;
+    const double K = 10, K2 = (1 / K / K);  // defined after equation(13) in text
+    d[0] = d[cols - 1] = 1;
+    if (i == 0 || i == x.rows - 1)
     {
-      float *u1 = (float *)x1.ptr(i);
-      int j = 0;
-      if (j == 0)
-      {
-        // Value of I at (i+1,j),(i,j+1)...(i,j)
-        float ip10 = x0.at<float>(i + 1, j), i0p1 = x0.at<float>(i, j + 1);
-        float im10 = x0.at<float>(i - 1, j), i00 = x0.at<float>(i, j);
-        // Value of D at at (i+1,j),(i,j+1)...(i,j)
-        float cp10 = D.at<float>(i + 1, j), c0p1 = D.at<float>(i, j + 1);
-        float cm10 = D.at<float>(i - 1, j), c00 = D.at<float>(i, j);
-        // Equation (7) p632
-        double xx = (cp10 + c00) * (ip10 - i00) + (c0p1 + c00) * (i0p1 - i00) + (cm10 + c00) * (im10 - i00);
-        dI00.at<float>(i, j) = xx;
-        if (maxD < fabs(xx))
-          maxD = fabs(xx);
-        intxx += fabs(xx);
-        // equation (9)
-      }
+      fill(d, d + cols, 1.f);
+      return;
+    }
+    const float *a = x.ptr<float>(i - 1), *b = x.ptr<float>(i), *c = x.ptr<float>(i + 1);
+    for (int j = 1; j < cols - 1; j++)
+    {
+      float gx = (a[j + 1] - a[j - 1]) + 2 * (b[j + 1] - b[j - 1]) + (c[j + 1] - c[j - 1]);
+      d[j] = 1.0 / (1 + gx * gx * K2);  // expression of g(gradient(I))
+    }
+  }
 
-      u1++;
-      j++;
-      for (int j = 1; j < x0.cols - 1; j++, u1++)
-      {
-        // Value of I at (i+1,j),(i,j+1)...(i,j)
-        float ip10 = x0.at<float>(i + 1, j), i0p1 = x0.at<float>(i, j + 1);
-        float im10 = x0.at<float>(i - 1, j), i0m1 = x0.at<float>(i, j - 1), i00 = x0.at<float>(i, j);
-        // Value of D at at (i+1,j),(i,j+1)...(i,j)
-        float cp10 = D.at<float>(i + 1, j), c0p1 = D.at<float>(i, j + 1);
-        float cm10 = D.at<float>(i - 1, j), c0m1 = D.at<float>(i, j - 1), c00 = D.at<float>(i, j);
-        // Equation (7) p632
-        double xx = (cp10 + c00) * (ip10 - i00) + (c0p1 + c00) * (i0p1 - i00) + (cm10 + c00) * (im10 - i00) +
-                    (c0m1 + c00) * (i0m1 - i00);
-        dI00.at<float>(i, j) = xx;
-        if (maxD < fabs(xx))
-          maxD = fabs(xx);
-        intxx += fabs(xx);
-        // equation (9)
-      }
+  const Mat &x;
+  Mat &flux;
+  vector<float> &row_max;
+};
 
-      j++;
-      if (j == x0.cols - 1)
-      {
-        // Value of I at (i+1,j),(i,j+1)...(i,j)
-        float ip10 = x0.at<float>(i + 1, j);
-        float im10 = x0.at<float>(i - 1, j), i0m1 = x0.at<float>(i, j - 1), i00 = x0.at<float>(i, j);
-
-        // Value of D at at (i+1,j),(i,j+1)...(i,j)
-        float cp10 = D.at<float>(i + 1, j);
-        float cm10 = D.at<float>(i - 1, j), c0m1 = D.at<float>(i, j - 1), c00 = D.at<float>(i, j);
-
-        // Equation (7) p632
-        double xx = (cp10 + c00) * (ip10 - i00) + (cm10 + c00) * (im10 - i00) + (c0m1 + c00) * (i0m1 - i00);
-        dI00.at<float>(i, j) = xx;
-        if (maxD < fabs(xx))
-          maxD = fabs(xx);
-        intxx += fabs(xx);
-        // equation (9)
-      }
+// Diffusion step of one iteration for a band of rows, equation (9)
+class DiffusionStep : public ParallelLoopBody
+{
+public:
+  DiffusionStep(Mat &x, const Mat &flux, double step) : x(x), flux(flux), step(step)
+  {
+  }
+
+  void operator()(const Range &range) const
+  {
+    for (int i = range.start; i < range.end; i++)
+    {
+      float *u = x.ptr<float>(i);
+      const float *f = flux.ptr<float>(i);
+      for (int j = 0; j < x.cols; j++)
+        u[j] = u[j] + step * f[j];
     }
+  }
+
+private:
+  Mat &x;
+  const Mat &flux;
+  double step;
+};
+}
+
+void anisotropic_diffusion(const Mat &src, Mat &dest, int t_max)
+{
+  Mat x;
+  src.convertTo(x, CV_32FC1);
+  if (x.rows < 3 || x.cols < 3)
+  {
+    x.convertTo(dest, CV_8U);
+    return;
+  }
+
+  // Buffers are reused by every iteration, and the rows of each pass are split between threads
+  Mat flux(x.size(), CV_32F);
+  vector<float> row_max(x.rows);
+  double t = 0;
+  while (t < t_max)
+  {
+    parallel_for_(Range(0, x.rows), DiffusionFlux(x, flux, row_max));
+    float max_flux = *max_element(row_max.begin(), row_max.end());
+    if (!(max_flux > 0))
+      break;  // Nothing left to diffuse
+    double lambda = 100 / max_flux;
+    parallel_for_(Range(0, x.rows), DiffusionStep(x, flux, lambda / 4));
+    t = t + lambda;
+  }
+
+  x.convertTo(dest, CV_8U);
+}
+
+double rectangle_model_cost(const vector<Eigen::Vector3d> &pts, const uint8_t idxs[4], double height, double width)
+{
+  /*
+    Sum of the squared differences of the sorted distances between the four points from the sides and diagonals of
+    the rectangle, increased by how far from right angles the corners are.
+  */
+  array<double, 6> distances;
+  int pair_idx = 0;
+  for (int j = 0; j < 4; j++)
+    for (int k = j + 1; k < 4; k++)
+      distances[pair_idx++] = (pts[idxs[j]] - pts[idxs[k]]).norm();
+  sort(distances.begin(), distances.end());
+
+  // Compare graph edge lengths with expectations
+  double diagonal = sqrt(height * height + width * width);
+  const double model_distances[6] = { width, width, height, height, diagonal, diagonal };
+  double model_matching_cost = 0;
+  for (int k = 0; k < 6; k++)
+    model_matching_cost += pow(distances[k] - model_distances[k], 2.0);
+
+  // Add cost for departure from expected right angle corners, vectors from each point to the first and the last of
+  // the others should have zero dot product
+  double orthogonality_measure = 0;
+  double orthogonality_weight = 1.0;
+  for (int j = 0; j < 4; j++)
+  {
+    int k1 = (j == 0) ? 1 : 0;
+    int k2 = (j == 3) ? 2 : 3;
+    Eigen::Vector3d v1 = pts[idxs[k1]] - pts[idxs[j]];
+    Eigen::Vector3d v2 = pts[idxs[k2]] - pts[idxs[j]];
+    orthogonality_measure += fabs(v1.dot(v2) / (v1.norm() * v2.norm()));
+  }
+  orthogonality_measure /= 4.0;
+  return model_matching_cost * (1.0 + orthogonality_weight * orthogonality_measure);
+}
+
+namespace
+{
+// Lowest cost each pair of points can add to rectangle_model_cost, whichever side or diagonal it turns out to be.
+// Distances are matched to the model in sorted order, which is the best match there is, so the sum of this over the
+// pairs of a combination is a lower bound of its cost.
+vector<double> rectangle_pair_cost_bounds(const vector<Eigen::Vector3d> &pts, double height, double width)
+{
+  const size_t n = pts.size();
+  double diagonal = sqrt(height * height + width * width);
+  vector<double> bounds(n * n, 0);
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = i + 1; j < n; j++)
     {
-      int i = x0.rows - 1;
-      float *u1 = (float *)x1.ptr(i);
-      u1++;
-      for (int j = 1; j < x0.cols - 1; j++, u1++)
+      double dist = (pts[i] - pts[j]).norm();
+      double bound = min(pow(dist - width, 2.0), min(pow(dist - height, 2.0), pow(dist - diagonal, 2.0)));
+      bounds[i * n + j] = bounds[j * n + i] = bound;
+    }
+  return bounds;
+}
+}
+
+double best_rectangle_combination(const vector<Eigen::Vector3d> &pts, double height, double width, double max_cost,
+                                  vector<uint8_t> &best_idxs)
+{
+  /*
+    Finds the combination of four points with the lowest rectangle_model_cost under max_cost, trying combinations in
+    order. Pairs of points too far from any model distance, and combinations whose bound is already past the best
+    cost so far, are skipped along with every combination containing them, so none of the rest has to be costed.
+    Returns the cost, or infinity if no combination is under max_cost.
+  */
+  const size_t n = min<size_t>(pts.size(), 256);  // indices are uint8_t
+  double best = max_cost;
+  best_idxs.clear();
+  if (n < 4)
+    return numeric_limits<double>::infinity();
+  vector<double> e = rectangle_pair_cost_bounds(pts, height, width);
+  const size_t stride = pts.size();
+
+  for (size_t a = 0; a < n; a++)
+    for (size_t b = a + 1; b < n; b++)
+    {
+      double bound_ab = e[a * stride + b];
+      if (bound_ab >= best)
+        continue;
+      for (size_t c = b + 1; c < n; c++)
       {
-        // Value of I at (i+1,j),(i,j+1)...(i,j)
-        float i0p1 = x0.at<float>(i, j + 1);
-        float im10 = x0.at<float>(i - 1, j), i0m1 = x0.at<float>(i, j - 1), i00 = x0.at<float>(i, j);
-
-        // Value of D at at (i+1,j),(i,j+1)...(i,j)
-        float c0p1 = D.at<float>(i, j + 1);
-        float cm10 = D.at<float>(i - 1, j), c0m1 = D.at<float>(i, j - 1), c00 = D.at<float>(i, j);
-
-        // Equation (7) p632
-        double xx = (c0p1 + c00) * (i0p1 - i00) + (cm10 + c00) * (im10 - i00) + (c0m1 + c00) * (i0m1 - i00);
-        dI00.at<float>(i, j) = xx;
-        if (maxD < fabs(xx))
-          maxD = fabs(xx);
-        intxx += fabs(xx);
-        // equation (9)
+        double bound_abc = bound_ab + e[a * stride + c] + e[b * stride + c];
+        if (bound_abc >= best)
+          continue;
+        for (size_t d = c + 1; d < n; d++)
+        {
+          if (bound_abc + e[a * stride + d] + e[b * stride + d] + e[c * stride + d] >= best)
+            continue;
+          const uint8_t idxs[4] = { uint8_t(a), uint8_t(b), uint8_t(c), uint8_t(d) };
+          double cost = rectangle_model_cost(pts, idxs, height, width);
+          if (cost < best)
+          {
+            best = cost;
+            best_idxs.assign(idxs, idxs + 4);
+          }
+        }
       }
     }
-    lambda = 100 / maxD;
-    // cout <<" lambda = "<< lambda<<"\t Maxd"<<maxD << "\t"<<intxx<<"\n";
-    for (int i = 0; i < x0.rows; i++)
+  return best_idxs.empty() ? numeric_limits<double>::infinity() : best;
+}
+
+double best_rectangle_combination_ransac(const vector<Eigen::Vector3d> &pts, double height, double width,
+                                         double max_cost, int hypotheses, mt19937 &rng, vector<uint8_t> &best_idxs)
+{
+  /*
+    Like best_rectangle_combination, but from at most hypotheses random combinations, so the time it takes does not
+    grow with the number of points. Each one is drawn a point at a time from the points whose pairs with the ones
+    already drawn are within max_cost of the model.
+  */
+  const size_t n = min<size_t>(pts.size(), 256);  // indices are uint8_t
+  double best = max_cost;
+  best_idxs.clear();
+  if (n < 4)
+    return numeric_limits<double>::infinity();
+  vector<double> e = rectangle_pair_cost_bounds(pts, height, width);
+  const size_t stride = pts.size();
+
+  vector<pair<uint8_t, uint8_t> > pairs;
+  for (size_t a = 0; a < n; a++)
+    for (size_t b = a + 1; b < n; b++)
+      if (e[a * stride + b] < max_cost)
+        pairs.push_back(make_pair(a, b));
+  if (pairs.empty())
+    return numeric_limits<double>::infinity();
+
+  vector<uint8_t> candidates;
+  for (int h = 0; h < hypotheses; h++)
+  {
+    const pair<uint8_t, uint8_t> &ab = pairs[uniform_int_distribution<size_t>(0, pairs.size() - 1)(rng)];
+    uint8_t idxs[4] = { ab.first, ab.second, 0, 0 };
+    double bound = e[ab.first * stride + ab.second];
+    bool drawn = true;
+    for (int k = 2; k < 4 && drawn; k++)
     {
-      float *u1 = (float *)x1.ptr(i);
-      for (int j = 0; j < x0.cols; j++, u1++)
+      candidates.clear();
+      for (size_t c = 0; c < n; c++)
       {
-        *u1 = x0.at<float>(i, j) + lambda / 4 * dI00.at<float>(i, j);
-        // equation (9)
+        if (find(idxs, idxs + k, c) != idxs + k)
+          continue;
+        double bound_c = 0;
+        for (int j = 0; j < k; j++)
+          bound_c += e[idxs[j] * stride + c];
+        if (bound + bound_c < best)
+          candidates.push_back(c);
       }
+      drawn = !candidates.empty();
+      if (!drawn)
+        break;
+      idxs[k] = candidates[uniform_int_distribution<size_t>(0, candidates.size() - 1)(rng)];
+      for (int j = 0; j < k; j++)
+        bound += e[idxs[j] * stride + idxs[k]];
     }
+    if (!drawn)
+      continue;
 
-    x1.copyTo(x0);
-    x0.convertTo(xc, CV_8U);
-    t = t + lambda;
+    sort(idxs, idxs + 4);
+    double cost = rectangle_model_cost(pts, idxs, height, width);
+    if (cost < best)
+    {
+      best = cost;
+      best_idxs.assign(idxs, idxs + 4);
+    }
   }
-
-  dest = xc.clone();
+  return best_idxs.empty() ? numeric_limits<double>::infinity() : best;
 }
 
 void best_plane_from_combination(const vector<Eigen::Vector3d> &point_list, double distance_threshold,
@@ -1718,15 +2110,3 @@ double point_to_plane_distance(double a, double b, double c, double d, Eigen::Ve
   double denominator = sqrt(a * a + b * b + c * c);
   return numerator / denominator;
 }
-
-///////////////////////////////////////////////////////////////////////////////////////////////////
-// Main ///////////////////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////////////////////////
-
-int main(int argc, char **argv)
-{
-  ros::init(argc, argv, "torpedo_board_perception");
-  ROS_INFO("Initializing node /torpedo_board_perception");
-  Sub8TorpedoBoardDetector torpedo_board_detector;
-  ros::spin();
-}
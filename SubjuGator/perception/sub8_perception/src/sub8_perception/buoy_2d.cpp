@@ -1,28 +1,27 @@
 #include <sub8_perception/buoy.hpp>
 
-bool Sub8BuoyDetector::segment_buoy(cv::Mat &input_image, cv::Point &center, std::vector<sub::Contour> &output_contours,
-                                    std::string &target_name)
+bool Sub8BuoyDetector::segment_buoy_region(const cv::Mat &image, const cv::Rect &roi, const std::string &target_name,
+                                           cv::Point &center, cv::Rect &bounds,
+                                           std::vector<sub::Contour> *buoy_contours)
 {
   cv::Mat image_hsv;
   cv::Mat image_thresh;
 
   // believe it or not, this is on purpose (So blue replaces red in HSV)
-  cv::cvtColor(input_image, image_hsv, CV_BGR2HSV);
+  cv::cvtColor(image(roi), image_hsv, CV_BGR2HSV);
 
   // Threshold -- > This is what must be replaced with better 2d vision
   sub::inParamRange(image_hsv, color_ranges[target_name], image_thresh);
   std::vector<cv::Vec4i> hierarchy;
   std::vector<sub::Contour> contours;
-  cv::findContours(image_thresh.clone(), contours, hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE,
-                   cv::Point(0, 0));
+  // Offset so contours are in the coordinates of the whole image
+  cv::findContours(image_thresh, contours, hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE, roi.tl());
 
-  cv::Point best_centroid;
-  std::vector<cv::Point> buoy_centers;
+  bool found = false;
   double max_area = 0;
   // Loop through the contours we found and find the positions
   for (size_t i = 0; i < contours.size(); i++)
   {
-    cv::Point contour_centroid = sub::contour_centroid(contours[i]);
     std::vector<cv::Point> approx;
 
     // Magic num: 5
@@ -37,15 +36,84 @@ bool Sub8BuoyDetector::segment_buoy(cv::Mat &input_image, cv::Point &center, std
 
     if (area > max_area)
     {
-      best_centroid = contour_centroid;
+      center = sub::contour_centroid(contours[i]);
+      bounds = cv::boundingRect(contours[i]);
       max_area = area;
+      found = true;
     }
 
-    buoy_centers.push_back(contour_centroid);
-    output_contours.push_back(contours[i]);
+    if (buoy_contours)
+      buoy_contours->push_back(contours[i]);
   }
+  return found;
+}
 
-  if (buoy_centers.size() == 0)
+bool Sub8BuoyDetector::find_buoy(const cv::Mat &image, const std::string &target_name, cv::Point &center,
+                                 std::vector<sub::Contour> *buoy_contours)
+{
+  const cv::Rect full_frame(0, 0, image.cols, image.rows);
+  cv::Rect bounds;
+  std::map<std::string, BuoyTrack>::iterator track = buoy_tracks.find(target_name);
+  if (!buoy_tracking || track == buoy_tracks.end())
+  {
+    if (!segment_buoy_region(image, full_frame, target_name, center, bounds, buoy_contours))
+      return false;
+    if (buoy_tracking)
+      buoy_tracks[target_name] = BuoyTrack{ bounds, 0 };
+    buoy_bounds[target_name] = bounds;
+    return true;
+  }
+
+  // Search around where the buoy was last seen, further around it for every frame it has been missed
+  BuoyTrack &t = track->second;
+  double padding = buoy_roi_padding * (1 + t.misses);
+  int pad_x = cvRound(padding * std::max(t.roi.width, 1));
+  int pad_y = cvRound(padding * std::max(t.roi.height, 1));
+  cv::Rect roi = cv::Rect(t.roi.x - pad_x, t.roi.y - pad_y, t.roi.width + 2 * pad_x, t.roi.height + 2 * pad_y) &
+                 full_frame;
+  if (roi.area() > 0 && segment_buoy_region(image, roi, target_name, center, bounds, buoy_contours))
+  {
+    t = BuoyTrack{ bounds, 0 };
+    buoy_bounds[target_name] = bounds;
+    return true;
+  }
+  if (++t.misses <= buoy_max_misses)
+    return false;
+
+  // Lost it, search the whole frame again
+  buoy_tracks.erase(track);
+  if (roi == full_frame)
+    return false;
+  if (buoy_contours)
+    buoy_contours->clear();
+  if (!segment_buoy_region(image, full_frame, target_name, center, bounds, buoy_contours))
+    return false;
+  buoy_tracks[target_name] = BuoyTrack{ bounds, 0 };
+  buoy_bounds[target_name] = bounds;
+  return true;
+}
+
+void Sub8BuoyDetector::track_buoy_position(const image_geometry::PinholeCameraModel &camera_model,
+                                           const std::string &target_name, const Eigen::Vector3f &center)
+{
+  // Only a known track is refined, a 3d position alone does not say the buoy was segmented
+  std::map<std::string, BuoyTrack>::iterator track = buoy_tracks.find(target_name);
+  if (!buoy_tracking || track == buoy_tracks.end() || !(center.z() > 0))
+    return;
+
+  // The size a buoy of buoy_radius has at that range, around where it projects to
+  cv::Point2d pixel = camera_model.project3dToPixel(cv::Point3d(center.x(), center.y(), center.z()));
+  double radius = std::max(camera_model.fx(), camera_model.fy()) * buoy_radius / center.z();
+  cv::Rect projected(cvRound(pixel.x - radius), cvRound(pixel.y - radius), cvRound(2 * radius) + 1,
+                     cvRound(2 * radius) + 1);
+  track->second.roi |= projected;
+}
+
+bool Sub8BuoyDetector::segment_buoy(cv::Mat &input_image, cv::Point &center, std::vector<sub::Contour> &output_contours,
+                                    std::string &target_name)
+{
+  cv::Point best_centroid;
+  if (!find_buoy(input_image, target_name, best_centroid, &output_contours))
   {
     // return false;
     return true;
@@ -88,48 +156,10 @@ bool Sub8BuoyDetector::request_buoy_position_2d(sub8_msgs::VisionRequest2D::Requ
     return false;
   }
 
-  cv::Mat image_hsv;
-  cv::Mat image_thresh;
-
-  // believe it or not, this is on purpose (So blue replaces red in HSV)
-  // cv::cvtColor(target_image, image_hsv, CV_RGB2HSV);
-  cv::cvtColor(target_image, image_hsv, CV_BGR2HSV);
-
-  // Threshold -- > This is what must be replaced with better 2d vision
-  sub::inParamRange(image_hsv, color_ranges[target_name], image_thresh);
-  std::vector<sub::Contour> contours;
-  std::vector<cv::Vec4i> hierarchy;
-  cv::findContours(image_thresh.clone(), contours, hierarchy, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE,
-                   cv::Point(0, 0));
-
   cv::Point best_centroid;
-  std::vector<cv::Point> buoy_centers;
-  double max_area = 0;
-  // Loop through the contours we found and find the positions
-  for (size_t i = 0; i < contours.size(); i++)
-  {
-    cv::Point contour_centroid = sub::contour_centroid(contours[i]);
-    std::vector<cv::Point> approx;
-
-    // Magic num: 5
-    cv::approxPolyDP(contours[i], approx, 5, true);
-    double area = cv::contourArea(approx);
-
-    // Ignore small regions
-    if (area < 20)
-    {
-      continue;
-    }
-
-    if (area > max_area)
-    {
-      best_centroid = contour_centroid;
-      max_area = area;
-    }
-    buoy_centers.push_back(contour_centroid);
-  }
+  bool found = find_buoy(target_image, target_name, best_centroid);
 
-  if (buoy_centers.size() == 0)
+  if (!found)
   {
     // return false;
     resp.found = false;
@@ -12,7 +12,7 @@ bool Sub8BuoyDetector::request_buoy_position(sub8_msgs::VisionRequest::Request &
   std::string target_name = req.target_name;
   ROS_ERROR("SERVICE CALL %s", target_name.c_str());
 
-  if ((!got_cloud) || (!got_image))
+  if ((!stereo_matcher && !got_cloud) || (!got_image))
   {
     // Failure, yo!
     ROS_ERROR("Requested buoy position before we had both image and point cloud data");
@@ -32,32 +32,9 @@ bool Sub8BuoyDetector::request_buoy_position(sub8_msgs::VisionRequest::Request &
     ROS_ERROR("Could not encode image");
     return false;
   }
-  // Filter the cached point cloud
-  sub::PointCloudT::Ptr denanned_cleaned_cloud(new sub::PointCloudT());
-  sub::PointCloudT::Ptr target_cloud(new sub::PointCloudT());
-  sub::PointCloudT::Ptr current_cloud_filtered(new sub::PointCloudT());
-  if (target_cloud->points.size() > 1)
-  {
-    return false;
-  }
-  std::vector<int> indices;
-  pcl::removeNaNFromPointCloud(*current_cloud, *denanned_cleaned_cloud, indices);
-
-  if (denanned_cleaned_cloud->size() == 0)
-  {
-    return false;
-  }
-
-  // Nothing clean in a genocide
-  target_cloud = denanned_cleaned_cloud->makeShared();
-  // sub::voxel_filter<sub::PointXYZT>(denanned_cleaned_cloud, current_cloud_filtered,
-  //                                   0.05f  // leaf size
-  //                                   );
-
-  // sub::statistical_outlier_filter<sub::PointXYZT>(current_cloud_filtered, target_cloud,
-  //                                                20,   // mean k
-  //                                                0.05  // std_dev threshold
-  //                                                );
+  // The cached point cloud is cropped to the buoy once it is found, before anything else is done with it. With
+  // in-process stereo, the cloud is made around the buoy instead.
+  sub::PointCloudT::Ptr target_cloud = current_cloud;
 
   bool detection_success;
   detection_success = determine_buoy_position(cam_model, target_name, target_image, target_cloud, position);
@@ -90,7 +67,9 @@ bool Sub8BuoyDetector::determine_buoy_position(const image_geometry::PinholeCame
 {
   sub8_msgs::VisionRequest2D::Request req;
   sub8_msgs::VisionRequest2D::Response resp;
+  pcl::console::TicToc timer;
 
+  timer.tic();
   req.target_name = target_color;
   bool got_good_response = ros::service::call("vision/buoy/2D", req, resp);
   if (!got_good_response)
@@ -98,13 +77,44 @@ bool Sub8BuoyDetector::determine_buoy_position(const image_geometry::PinholeCame
     ROS_ERROR("Got bad response when requesting 2d position");
     return false;
   }
+  if (!resp.found)
+    return false;
+  const double segment_ms = timer.toc();
 
   cv::Point contour_centroid(resp.pose.x, resp.pose.y);
-  std::cout << resp.pose.x << " " << resp.pose.y << "zzz" << std::endl;
 
+  timer.tic();
+  sub::PointCloudT::Ptr cloud(new sub::PointCloudT());
+  std::map<std::string, cv::Rect>::const_iterator bounds = buoy_bounds.find(target_color);
+  if (stereo_matcher)
+  {
+    if (!stereo_buoy_cloud(target_color, contour_centroid, cloud))
+    {
+      ROS_WARN("No stereo depth around the %s buoy", target_color.c_str());
+      return false;
+    }
+  }
+  else if (bounds != buoy_bounds.end() && bounds->second.contains(contour_centroid))
+  {
+    crop_to_buoy(camera_model, *point_cloud_raw, image_raw.size(), bounds->second, *cloud);
+  }
+  else
+  {
+    std::vector<int> indices;
+    pcl::removeNaNFromPointCloud(*point_cloud_raw, *cloud, indices);
+  }
+  const double cloud_ms = timer.toc();
+  if (cloud->empty())
+  {
+    ROS_WARN("No points of the cloud on the %s buoy", target_color.c_str());
+    return false;
+  }
+
+  timer.tic();
   double distance;
-  sub::PointXYZT centroid_projected =
-      sub::project_uv_to_cloud(*point_cloud_raw, contour_centroid, camera_model, distance);
+  sub::PointXYZT centroid_projected = sub::project_uv_to_cloud(*cloud, contour_centroid, camera_model, distance);
+  ROS_DEBUG_NAMED("timing", "%s buoy: segmented in %.2f ms, %zu points in %.2f ms, projected in %.2f ms",
+                  target_color.c_str(), segment_ms, cloud->size(), cloud_ms, timer.toc());
 
   Eigen::Vector3f surface_point = sub::point_to_eigen(centroid_projected);
   // Slide the surface point one buoy radius away from the camera to approximate the 3d center
@@ -115,6 +125,79 @@ bool Sub8BuoyDetector::determine_buoy_position(const image_geometry::PinholeCame
   // }
 
   center = approximate_center;
+  track_buoy_position(camera_model, target_color, surface_point);
 
   return true;
 }
+
+bool Sub8BuoyDetector::stereo_buoy_cloud(const std::string &target_name, const cv::Point &centroid,
+                                         sub::PointCloudT::Ptr &cloud)
+{
+  if (!stereo_stream->size())
+  {
+    ROS_ERROR("Requested buoy position before we had a stereo pair");
+    return false;
+  }
+  // The buoy was found in the last right image, so the pair must be near enough to it to still have it there
+  mil_vision::StereoCameraStream<cv::Vec3b>::StereoPair pair = (*stereo_stream)[0];
+  if (std::abs((pair.stamp() - image_time).toSec()) > 0.3)
+  {
+    ROS_WARN("The last stereo pair is too far from the image the buoy was found in");
+    return false;
+  }
+  stereo_model.fromCameraInfo(pair.left->getCameraModelPtr()->cameraInfo(),
+                              pair.right->getCameraModelPtr()->cameraInfo());
+
+  // Around the buoy's track if it has one there, which is sized to the buoy, otherwise a fixed window
+  cv::Rect roi(centroid.x - stereo_window / 2, centroid.y - stereo_window / 2, stereo_window, stereo_window);
+  std::map<std::string, BuoyTrack>::const_iterator track = buoy_tracks.find(target_name);
+  if (buoy_tracking && track != buoy_tracks.end() && track->second.roi.contains(centroid))
+    roi = track->second.roi;
+
+  sub::PointCloudT organized;
+  if (!stereo_matcher->cloud(stereo_model, pair.left->image(), pair.right->image(), roi,
+                             mil_vision::RoiStereoMatcher::Reference::RIGHT, organized))
+    return false;
+  cloud.reset(new sub::PointCloudT());
+  std::vector<int> indices;
+  pcl::removeNaNFromPointCloud(organized, *cloud, indices);
+  return !cloud->empty();
+}
+
+void Sub8BuoyDetector::crop_to_buoy(const image_geometry::PinholeCameraModel &camera_model,
+                                    const sub::PointCloudT &cloud, const cv::Size &image_size, const cv::Rect &bounds,
+                                    sub::PointCloudT &cropped)
+{
+  const int pad_x = cvRound(buoy_crop_padding * bounds.width);
+  const int pad_y = cvRound(buoy_crop_padding * bounds.height);
+  const cv::Rect box(bounds.x - pad_x, bounds.y - pad_y, bounds.width + 2 * pad_x, bounds.height + 2 * pad_y);
+
+  cropped.clear();
+  cropped.header = cloud.header;
+  // Keeps a point if it is in front of the camera and projects into the box
+  auto add = [&](const sub::PointXYZT &point) {
+    if (!(point.z > 0) || !std::isfinite(point.x) || !std::isfinite(point.y))
+      return;
+    const cv::Point2d pixel = camera_model.project3dToPixel(cv::Point3d(point.x, point.y, point.z));
+    if (pixel.x >= box.x && pixel.x < box.x + box.width && pixel.y >= box.y && pixel.y < box.y + box.height)
+      cropped.push_back(point);
+  };
+
+  if (!cloud.isOrganized() || cloud.width != static_cast<uint32_t>(image_size.width) ||
+      cloud.height != static_cast<uint32_t>(image_size.height))
+  {
+    for (const sub::PointXYZT &point : cloud.points)
+      add(point);
+    return;
+  }
+
+  // Rows are the same in both rectified images, and a point is its disparity right of where the right camera sees it
+  const cv::Rect rows = cv::Rect(box.x, box.y, box.width + std::max(buoy_crop_max_disparity, 0), box.height) &
+                        cv::Rect(0, 0, image_size.width, image_size.height);
+  for (int v = rows.y; v < rows.y + rows.height; ++v)
+  {
+    const sub::PointXYZT *row = &cloud.points[v * cloud.width];
+    for (int u = rows.x; u < rows.x + rows.width; ++u)
+      add(row[u]);
+  }
+}
@@ -25,6 +25,14 @@ Sub8BuoyDetector::Sub8BuoyDetector()
     buoy_radius = 0.1016;  // m
   }
 
+  // Segment within a region around the last detection of each buoy, searching the whole frame when it is lost
+  nh.param<bool>("vision/buoy_tracking", buoy_tracking, true);
+  nh.param<double>("vision/buoy_roi_padding", buoy_roi_padding, 0.5);
+  nh.param<int>("vision/buoy_max_misses", buoy_max_misses, 3);
+  // Crop the stereo pipeline's cloud to the buoy's box in the image before using it
+  nh.param<double>("vision/buoy_crop/padding", buoy_crop_padding, 0.25);
+  nh.param<int>("vision/buoy_crop/max_disparity", buoy_crop_max_disparity, 128);
+
   compute_timer = nh.createTimer(ros::Duration(0.09), &Sub8BuoyDetector::compute_loop, this);
   image_sub = image_transport.subscribeCamera("/camera/front/right/image_rect_color", 1,
                                               &Sub8BuoyDetector::image_callback, this);
@@ -43,7 +51,25 @@ Sub8BuoyDetector::Sub8BuoyDetector()
 
   // Not yet able to build with C++11, should be done with an initialized vector
 
-  data_sub = nh.subscribe("/camera/front/points2", 1, &Sub8BuoyDetector::cloud_callback, this);
+  // Match the stereo pair here, only around the buoy asked for, rather than taking the whole cloud of the stereo
+  // pipeline every frame to use a few of its points
+  if (nh.param<bool>("vision/buoy_stereo/enabled", true))
+  {
+    mil_vision::RoiStereoMatcher::Params params;
+    params.num_disparities = nh.param<int>("vision/buoy_stereo/num_disparities", params.num_disparities);
+    params.block_size = nh.param<int>("vision/buoy_stereo/block_size", params.block_size);
+    params.texture_threshold = nh.param<int>("vision/buoy_stereo/texture_threshold", params.texture_threshold);
+    params.uniqueness_ratio = nh.param<int>("vision/buoy_stereo/uniqueness_ratio", params.uniqueness_ratio);
+    params.use_gpu = nh.param<bool>("vision/buoy_stereo/use_gpu", params.use_gpu);
+    nh.param<int>("vision/buoy_stereo/window", stereo_window, 64);
+    stereo_matcher.reset(new mil_vision::RoiStereoMatcher(params));
+    stereo_stream = mil_vision::sharedStereoCameraStream<cv::Vec3b>(nh, "/camera/front/left/image_rect_color",
+                                                                    "/camera/front/right/image_rect_color", 0.05, 1);
+  }
+  else
+  {
+    data_sub = nh.subscribe("/camera/front/points2", 1, &Sub8BuoyDetector::cloud_callback, this);
+  }
   service_3d = nh.advertiseService("/vision/buoy/pose", &Sub8BuoyDetector::request_buoy_position, this);
   pcl::console::print_highlight("--PCL Sub8BuoyDetector Initialized\n");
 }
@@ -0,0 +1,38 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.hpp>
+
+#include <sub8_perception/start_gate.hpp>
+#include <sub8_vision_lib/torpedo_board.hpp>
+
+#include <memory>
+
+namespace sub8_perception
+{
+// The detectors as nodelets, so a perception_host runs them in one process, sharing its camera streams and vision
+// worker pool. Each is made on load and destroyed on unload, dropping the camera subscriptions no other detector
+// still uses.
+
+class StartGateNodelet : public nodelet::Nodelet
+{
+  virtual void onInit()
+  {
+    detector_.reset(new Sub8StartGateDetector(getPrivateNodeHandle()));
+  }
+
+  std::unique_ptr<Sub8StartGateDetector> detector_;
+};
+
+class TorpedoBoardNodelet : public nodelet::Nodelet
+{
+  virtual void onInit()
+  {
+    detector_.reset(new Sub8TorpedoBoardDetector());
+  }
+
+  std::unique_ptr<Sub8TorpedoBoardDetector> detector_;
+};
+
+}  // namespace sub8_perception
+
+PLUGINLIB_EXPORT_CLASS(sub8_perception::StartGateNodelet, nodelet::Nodelet);
+PLUGINLIB_EXPORT_CLASS(sub8_perception::TorpedoBoardNodelet, nodelet::Nodelet);
@@ -1,9 +1,13 @@
 #include <sub8_perception/start_gate.hpp>
-Sub8StartGateDetector::Sub8StartGateDetector() : nh("~"), timeout_for_found_(2), tf_listener_(tf_buffer_)
+Sub8StartGateDetector::Sub8StartGateDetector() : Sub8StartGateDetector(ros::NodeHandle("~"))
 {
-  // Start the camera streamers
-  left_cam_stream_ = std::unique_ptr<ROSCameraStream_Vec3>(new ROSCameraStream_Vec3(nh, 1));
-  right_cam_stream_ = std::unique_ptr<ROSCameraStream_Vec3>(new ROSCameraStream_Vec3(nh, 1));
+}
+
+Sub8StartGateDetector::Sub8StartGateDetector(ros::NodeHandle private_nh)
+  : nh(private_nh), timeout_for_found_(2), tf_listener_(tf_buffer_)
+{
+  // The maximum time difference between the two camera time stamps
+  sync_thresh_ = 0.5;
 
   std::string img_topic_left_default = "/camera/front/left/image_rect_color";
   std::string img_topic_right_default = "/camera/front/right/image_rect_color";
@@ -11,19 +15,32 @@ Sub8StartGateDetector::Sub8StartGateDetector() : nh("~"), timeout_for_found_(2),
   std::string left = nh.param<std::string>("left_camera_topic", img_topic_left_default);
   std::string right = nh.param<std::string>("right_camera_topic", img_topic_right_default);
 
-  // Initialize the streamers with the topic paths
-  left_cam_stream_->init(left);
-  right_cam_stream_->init(right);
+  // Start the stereo camera streamer, or share the one other detectors in the process already read these cameras from
+  stereo_cam_stream_ = mil_vision::sharedStereoCameraStream<cv::Vec3b>(nh, left, right, sync_thresh_, 1);
 
   canny_low_ = nh.param<int>("canny_low_", 100);
   canny_ratio_ = nh.param<int>("canny_ratio_", 3.0);
   blur_size_ = nh.param<int>("blur_size_", 1);
   dilate_amount_ = nh.param<int>("dilate_amount_", 3);
+  track_gate_ = nh.param<bool>("track_gate", false);
+  tracking_search_radius_ = nh.param<int>("tracking/search_radius", tracking_search_radius_);
+  tracking_corner_window_ = nh.param<int>("tracking/corner_window", tracking_corner_window_);
+  tracking_max_reprojection_error_ =
+      nh.param<double>("tracking/max_reprojection_error", tracking_max_reprojection_error_);
+
+  // Find the gate's corners in the right image by matching them, rather than by segmenting it too
+  if (nh.param<bool>("sparse_stereo/enabled", true))
+  {
+    mil_vision::CensusStereoMatcher::Params params;
+    params.max_disparity = nh.param<int>("sparse_stereo/max_disparity", params.max_disparity);
+    params.row_tolerance = nh.param<int>("sparse_stereo/row_tolerance", 1);
+    params.uniqueness = nh.param<double>("sparse_stereo/uniqueness", params.uniqueness);
+    params.max_cost = nh.param<int>("sparse_stereo/max_cost", params.max_cost);
+    sparse_matcher_.reset(new mil_vision::CensusStereoMatcher(params));
+  }
 
   // Should node be processing image
   active_ = false;
-  // The maximum time difference between the two camera time stamps
-  sync_thresh_ = 0.5;
   // process 10 times per second
   refresh_rate_ = 10;
 
@@ -38,7 +55,15 @@ Sub8StartGateDetector::Sub8StartGateDetector() : nh("~"), timeout_for_found_(2),
   active_service_ =
       nh.advertiseService("/vision/start_gate/enable", &Sub8StartGateDetector::set_active_enable_cb, this);
 
-  run();
+  // Frames are processed by the shared vision worker pool, paused until the detector is enabled
+  pool_task_ = VisionWorkerPool::shared().add_task("start_gate", 0);
+  refresh_timer_ = nh.createWallTimer(ros::WallDuration(1 / refresh_rate_), &Sub8StartGateDetector::refresh, this);
+}
+
+Sub8StartGateDetector::~Sub8StartGateDetector()
+{
+  refresh_timer_.stop();
+  VisionWorkerPool::shared().stop_task(pool_task_);
 }
 
 std::vector<cv::Point> Sub8StartGateDetector::get_2d_feature_points(cv::Mat image)
@@ -61,25 +86,21 @@ std::vector<cv::Point> Sub8StartGateDetector::get_2d_feature_points(cv::Mat imag
   return get_corner_center_points(features);
 }
 
-void Sub8StartGateDetector::run()
+void Sub8StartGateDetector::refresh(const ros::WallTimerEvent &)
 {
-  ros::Rate loop_rate(refresh_rate_);
-  while (ros::ok())
-  {
-    if (active_)
-      determine_start_gate_position();
-    loop_rate.sleep();
-    ros::spinOnce();
-  }
-  return;
+  // Work not started by the next refresh is replaced, so a slow frame does not queue others behind it
+  if (active_)
+    VisionWorkerPool::shared().submit(pool_task_,
+                                      std::bind(&Sub8StartGateDetector::determine_start_gate_position, this));
 }
 
 void Sub8StartGateDetector::determine_start_gate_position()
 {
   // Find transform between map frame and stereo frame
+  geometry_msgs::TransformStamped transform_to_map;
   try
   {
-    transform_to_map_ = tf_buffer_.lookupTransform("map", "front_stereo", ros::Time(0));
+    transform_to_map = tf_buffer_.lookupTransform("map", "front_stereo", ros::Time(0));
   }
   catch (tf2::TransformException &ex)
   {
@@ -88,35 +109,56 @@ void Sub8StartGateDetector::determine_start_gate_position()
   }
 
   // If no gates have been found in a while, reset kalman
-  if (gate_found_ && ros::Time::now() - last_time_found_ > timeout_for_found_)
   {
-    init_kalman_filter();
-    gate_found_ = false;
+    std::lock_guard<std::mutex> lock(gate_mtx_);
+    transform_to_map_ = transform_to_map;
+    if (gate_found_ && ros::Time::now() - last_time_found_ > timeout_for_found_)
+    {
+      init_kalman_filter();
+      gate_found_ = false;
+    }
   }
 
   // If cameras are out of sync or not publishing, don't do anything
   if (!is_stereo_coherent())
     return;
 
-  auto feature_pts_3d_ptr = get_3d_feature_points();
+  // Only a lost track runs the full frame detection
+  std::unique_ptr<std::vector<Eigen::Vector3d>> feature_pts_3d_ptr;
+  if (track_gate_)
+    feature_pts_3d_ptr = track_3d_feature_points();
   if (!feature_pts_3d_ptr)
+    feature_pts_3d_ptr = get_3d_feature_points();
+  if (!feature_pts_3d_ptr)
+  {
+    clear_tracked_features();
     return;
+  }
   // Use inherited function to find 3d points and then estimate a pose
   auto pose_ptr = get_3d_pose(*feature_pts_3d_ptr);
   if (pose_ptr)
   {
     auto pose = *pose_ptr;
-    gate_pose_ = update_kalman_filter(pose);
-    gate_found_ = true;
-    last_time_found_ = ros::Time::now();
+    {
+      std::lock_guard<std::mutex> lock(gate_mtx_);
+      gate_pose_ = update_kalman_filter(pose);
+      gate_found_ = true;
+      last_time_found_ = ros::Time::now();
+    }
+    if (track_gate_)
+      set_tracked_features(*feature_pts_3d_ptr, gate_pose_);
     visualize_3d_points_rviz(*feature_pts_3d_ptr);
     visualize_k_gate_normal();
   }
+  else
+    clear_tracked_features();
 }
 
 bool Sub8StartGateDetector::set_active_enable_cb(std_srvs::SetBool::Request &req, std_srvs::SetBool::Response &res)
 {
   active_ = req.data;
+  // Mission code can set the priority before enabling the detector
+  VisionWorkerPool::shared().set_priority(pool_task_, active_ ? std::max(1, nh.param<int>("priority", 1)) : 0);
   res.success = true;
   return true;
 }
@@ -124,6 +166,7 @@ bool Sub8StartGateDetector::set_active_enable_cb(std_srvs::SetBool::Request &req
 bool Sub8StartGateDetector::vision_request_cb(sub8_msgs::VisionRequest::Request &req,
                                               sub8_msgs::VisionRequest::Response &resp)
 {
+  std::lock_guard<std::mutex> lock(gate_mtx_);
   if (!gate_found_)
   {
     resp.found = false;
@@ -1,5 +1,6 @@
 #include <ros/console.h>
 #include <mil_vision_lib/cv_tools.hpp>
+#include <mil_vision_lib/gpu_image.hpp>
 
 namespace sub
 {
@@ -30,4 +31,9 @@ void inParamRange(cv::Mat &src, Range &range, cv::Mat &dest)
 {
   cv::inRange(src, range.lower, range.upper, dest);
 }
+
+bool inParamRange(const cv::cuda::GpuMat &src, Range &range, cv::cuda::GpuMat &dest)
+{
+  return mil_vision::gpuInRange(src, range.lower, range.upper, dest);
+}
 }
\ No newline at end of file
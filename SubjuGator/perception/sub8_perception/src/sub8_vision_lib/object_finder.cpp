@@ -67,6 +67,16 @@ Sub8ObjectFinder::Sub8ObjectFinder() try : image_transport(nh), rviz("/torpedo_b
           << std::setw(2 * tab_sz) << ""
           << "\x1b[37m" << activation << "\x1b[0m\n";
 
+  // Each camera gets a task of the shared vision pool. They only get work while the main loop waits for it, so they
+  // are never paused, which would leave the loop waiting.
+  left_processing.name = "left";
+  left_processing.task = VisionWorkerPool::shared().add_task("torpedo_board_left", 1);
+  left_processing.cam_model = &left_cam_model;
+  right_processing.name = "right";
+  right_processing.task = VisionWorkerPool::shared().add_task("torpedo_board_right", 1);
+  right_processing.cam_model = &right_cam_model;
+  cameras_pending = 0;
+
   // Start main detector loop
   run_id = 0;
   boost::thread main_loop_thread(boost::bind(&Sub8ObjectFinder::run, this));
@@ -86,6 +96,8 @@ catch (const std::exception &e)
 
 Sub8ObjectFinder::~Sub8ObjectFinder()
 {
+  VisionWorkerPool::shared().stop_task(left_processing.task);
+  VisionWorkerPool::shared().stop_task(right_processing.task);
   ROS_INFO("Killed Torpedo Board Detector");
 }
 
@@ -136,63 +148,60 @@ void Sub8ObjectFinder::right_image_callback(const sensor_msgs::ImageConstPtr &im
   right_mtx.unlock();
 }
 
-void Sub8ObjectFinder::determine_torpedo_board_position()
+void Sub8ObjectFinder::process_camera(CameraProcessing &camera)
 {
-  std::stringstream dbg_str;
-
-  // Prevent segfault if service is called before we get valid img_msg_ptr's
-  if (left_most_recent.image_msg_ptr == NULL || right_most_recent.image_msg_ptr == NULL)
-  {
-    ROS_WARN("Torpedo Board Detector: Image Pointers are NULL.");
-    return;
-  }
-
-  // Get the most recent frames and camera info for both cameras
-  cv_bridge::CvImagePtr input_bridge;
-  cv::Mat current_image_left, current_image_right, processing_size_image_left, processing_size_image_right,
-      segmented_board_left, segmented_board_right;
+  bool ok = false;
   try
   {
-    left_mtx.lock();
-    right_mtx.lock();
-
-    // Left Camera
-    input_bridge = cv_bridge::toCvCopy(left_most_recent.image_msg_ptr, sensor_msgs::image_encodings::BGR8);
-    current_image_left = input_bridge->image;
-    left_cam_model.fromCameraInfo(left_most_recent.info_msg_ptr);
-    cv::resize(current_image_left, processing_size_image_left, cv::Size(0, 0), image_proc_scale, image_proc_scale);
-    if (current_image_left.channels() != 3)
+    // Shares the message's buffer when it already is bgr8, and the resize reuses the Mat of the last frame
+    cv_bridge::CvImageConstPtr input_bridge =
+        cv_bridge::toCvShare(camera.frame.image_msg_ptr, sensor_msgs::image_encodings::BGR8);
+    camera.cam_model->fromCameraInfo(camera.frame.info_msg_ptr);
+    if (input_bridge->image.channels() != 3)
+      ROS_ERROR("The %s image topic does not contain a color image.", camera.name);
+    else
     {
-      ROS_ERROR("The left image topic does not contain a color image.");
-      return;
+      cv::resize(input_bridge->image, camera.processing_size_image, cv::Size(0, 0), image_proc_scale,
+                 image_proc_scale);
+      ok = true;
     }
+  }
+  catch (const std::exception &ex)
+  {
+    ROS_ERROR("[torpedo_board] cv_bridge: Failed to convert the %s image", camera.name);
+  }
 
-    // Right Camera
-    input_bridge = cv_bridge::toCvCopy(right_most_recent.image_msg_ptr, sensor_msgs::image_encodings::BGR8);
-    current_image_right = input_bridge->image;
-    right_cam_model.fromCameraInfo(right_most_recent.info_msg_ptr);
-    cv::resize(current_image_right, processing_size_image_right, cv::Size(0, 0), image_proc_scale, image_proc_scale);
-    if (current_image_right.channels() != 3)
-    {
-      ROS_ERROR("The right image topic does not contain a color image.");
-      return;
-    }
+  std::lock_guard<std::mutex> lock(cameras_mtx);
+  camera.ok = ok;
+  cameras_pending--;
+  cameras_cv.notify_all();
+}
+
+void Sub8ObjectFinder::determine_torpedo_board_position()
+{
+  std::stringstream dbg_str;
 
-    left_mtx.unlock();
-    right_mtx.unlock();
+  // Get the most recent frames and camera info for both cameras
+  {
+    boost::lock_guard<boost::mutex> left_lock(left_mtx);
+    left_processing.frame = left_most_recent;
   }
-  catch (const std::exception &ex)
   {
-    ROS_ERROR("[torpedo_board] cv_bridge: Failed to convert images");
-    left_mtx.unlock();
-    right_mtx.unlock();
+    boost::lock_guard<boost::mutex> right_lock(right_mtx);
+    right_processing.frame = right_most_recent;
+  }
+
+  // Prevent segfault if service is called before we get valid img_msg_ptr's
+  if (left_processing.frame.image_msg_ptr == NULL || right_processing.frame.image_msg_ptr == NULL)
+  {
+    ROS_WARN("Torpedo Board Detector: Image Pointers are NULL.");
     return;
   }
 
-  // Enforce approximate image synchronization
+  // Enforce approximate image synchronization, before spending any time on the images
   double left_stamp, right_stamp;
-  left_stamp = left_most_recent.image_msg_ptr->header.stamp.toSec();
-  right_stamp = right_most_recent.image_msg_ptr->header.stamp.toSec();
+  left_stamp = left_processing.frame.image_msg_ptr->header.stamp.toSec();
+  right_stamp = right_processing.frame.image_msg_ptr->header.stamp.toSec();
   if (std::abs(left_stamp - right_stamp) > sync_thresh)
   {
     ROS_WARN("Left and right images were not sufficiently synchronized");
@@ -200,6 +209,21 @@ void Sub8ObjectFinder::determine_torpedo_board_position()
     return;
   }
 
+  // Process both cameras at once, so a frame takes about as long as one image
+  {
+    std::unique_lock<std::mutex> lock(cameras_mtx);
+    cameras_pending = 2;
+    VisionWorkerPool::shared().submit(left_processing.task,
+                                      std::bind(&Sub8ObjectFinder::process_camera, this, std::ref(left_processing)));
+    VisionWorkerPool::shared().submit(right_processing.task,
+                                      std::bind(&Sub8ObjectFinder::process_camera, this, std::ref(right_processing)));
+    cameras_cv.wait(lock, [this] { return cameras_pending == 0; });
+  }
+  if (!left_processing.ok || !right_processing.ok)
+    return;
+  const cv::Mat &processing_size_image_left = left_processing.processing_size_image;
+  const cv::Mat &processing_size_image_right = right_processing.processing_size_image;
+
   // Denoise Images
   /*
     TODO:
@@ -2,34 +2,26 @@
 
 StereoBase::StereoBase()
 {
-  n_states_ = 18;
-  n_measurements_ = 6;
   refresh_rate_ = 10;
+  tracking_search_radius_ = 20;
+  tracking_corner_window_ = 5;
+  tracking_max_reprojection_error_ = 3;
   init_kalman_filter();
 }
 
 bool StereoBase::is_stereo_coherent()
 {
-  if (!left_cam_stream_->ok() || !right_cam_stream_->ok())
+  if (!stereo_cam_stream_->ok())
   {
     ROS_WARN("Start Gate Detector: not getting images.");
     return false;
   }
 
-  if (left_cam_stream_->size() < 1 || right_cam_stream_->size() < 1)
+  // Pairs are only made from images within sync_thresh_ of each other, so any new pair will do
+  ros::Time last_stamp = pair_.left ? pair_.stamp() : ros::Time();
+  if (!stereo_cam_stream_->waitForPair(pair_, last_stamp, ros::WallDuration(1 / refresh_rate_)))
   {
-    ROS_WARN("Calling too soon -- no images ready");
-    return false;
-  }
-
-  // Enforce approximate image synchronization
-  double left_stamp, right_stamp;
-  left_stamp = (*left_cam_stream_)[0]->stamp().toSec();
-  right_stamp = (*right_cam_stream_)[0]->stamp().toSec();
-  double sync_error = fabs(left_stamp - right_stamp);
-  if (sync_error > sync_thresh_)
-  {
-    ROS_WARN("Left and right not synchronized");
+    ROS_WARN("No new synchronized left and right images");
     return false;
   }
   return true;
@@ -37,44 +29,131 @@ bool StereoBase::is_stereo_coherent()
 
 std::unique_ptr<std::vector<Eigen::Vector3d>> StereoBase::get_3d_feature_points(int max_z)
 {
-  std::vector<cv::Point> features_l, features_r;
-  features_l = get_2d_feature_points((*left_cam_stream_)[0]->image());
-  features_r = get_2d_feature_points((*right_cam_stream_)[0]->image());
+  std::vector<cv::Point> features_l = get_2d_feature_points(pair_.left->image());
+  std::vector<cv::Point2d> pts_L, pts_R;
+  if (sparse_matcher_)
+  {
+    std::vector<cv::Point2f> points_l(features_l.begin(), features_l.end());
+    std::vector<mil_vision::SparseStereoMatch> matches;
+    sparse_matcher_->match(pair_.left->image(), pair_.right->image(), points_l, matches);
+    for (const mil_vision::SparseStereoMatch &match : matches)
+    {
+      if (!match.valid())
+        return nullptr;
+      pts_L.push_back(match.left);
+      pts_R.push_back(match.right);
+    }
+  }
+  else
+  {
+    std::vector<cv::Point> features_r = get_2d_feature_points(pair_.right->image());
+    std::vector<int> correspondence_pair_idxs =
+        shortest_pair_stereo_matching(features_l, features_r, pair_.left->image().rows * 0.02);
 
-  std::vector<int> correspondence_pair_idxs =
-      shortest_pair_stereo_matching(features_l, features_r, left_cam_stream_->rows() * 0.02);
+    // Check if we have any undefined correspondence pairs
+    if (std::count(correspondence_pair_idxs.begin(), correspondence_pair_idxs.end(), -1) != 0)
+      return nullptr;
 
-  // Check if we have any undefined correspondence pairs
-  if (std::count(correspondence_pair_idxs.begin(), correspondence_pair_idxs.end(), -1) != 0)
-    return nullptr;
+    for (size_t i = 0; i < correspondence_pair_idxs.size(); i++)
+    {
+      pts_L.push_back(features_l[i]);
+      pts_R.push_back(features_r[correspondence_pair_idxs[i]]);
+    }
+  }
 
-  cv::Matx34d left_cam_mat = (*left_cam_stream_)[0]->getCameraModelPtr()->fullProjectionMatrix();
-  cv::Matx34d right_cam_mat = (*right_cam_stream_)[0]->getCameraModelPtr()->fullProjectionMatrix();
+  cv::Matx34d left_cam_mat = pair_.left->getCameraModelPtr()->fullProjectionMatrix();
+  cv::Matx34d right_cam_mat = pair_.right->getCameraModelPtr()->fullProjectionMatrix();
 
   // Calculate 3D stereo reconstructions
-  std::vector<Eigen::Vector3d> feature_pts_3d;
-  Eigen::Vector3d pt_3D;
-  for (size_t i = 0; i < correspondence_pair_idxs.size(); i++)
+  std::vector<Eigen::Vector3d> feature_pts_3d(pts_L.size());
+  mil_vision::triangulate_Linear_LS(left_cam_mat, right_cam_mat, pts_L.data(), pts_R.data(), pts_L.size(),
+                                    feature_pts_3d.data());
+  for (const Eigen::Vector3d &pt_3D : feature_pts_3d)
   {
-    if (correspondence_pair_idxs[i] == -1)
-      continue;
-    cv::Point2d pt_L = features_l[i];
-    cv::Point2d pt_R = features_r[correspondence_pair_idxs[i]];
-    cv::Matx31d pt_L_hom(pt_L.x, pt_L.y, 1);
-    cv::Matx31d pt_R_hom(pt_R.x, pt_R.y, 1);
-    cv::Mat X_hom = mil_vision::triangulate_Linear_LS(cv::Mat(left_cam_mat), cv::Mat(right_cam_mat), cv::Mat(pt_L_hom),
-                                                      cv::Mat(pt_R_hom));
-    X_hom = X_hom / X_hom.at<double>(3, 0);
-    pt_3D << X_hom.at<double>(0, 0), X_hom.at<double>(1, 0), X_hom.at<double>(2, 0);
     if (pt_3D(2) < 0)
       return nullptr;
     if (pt_3D(2) > max_z)
       return nullptr;
-    feature_pts_3d.push_back(pt_3D);
   }
   return std::unique_ptr<std::vector<Eigen::Vector3d>>(new std::vector<Eigen::Vector3d>(feature_pts_3d));
 }
 
+std::unique_ptr<std::vector<Eigen::Vector3d>> StereoBase::track_3d_feature_points(int max_z)
+{
+  if (tracked_features_.empty())
+    return nullptr;
+
+  const cv::Matx34d left_cam_mat = pair_.left->getCameraModelPtr()->fullProjectionMatrix();
+  const cv::Matx34d right_cam_mat = pair_.right->getCameraModelPtr()->fullProjectionMatrix();
+  const Eigen::Affine3d pose = get_filtered_pose();
+
+  const size_t count = tracked_features_.size();
+  std::vector<cv::Point2d> pts_L(count), pts_R(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    Eigen::Vector3d pt = pose * tracked_features_[i];
+    if (pt(2) <= 0)
+      return nullptr;
+    cv::Vec4d homogeneous(pt(0), pt(1), pt(2), 1);
+    cv::Vec3d uv_l = left_cam_mat * homogeneous, uv_r = right_cam_mat * homogeneous;
+    cv::Point2d predicted_l(uv_l[0] / uv_l[2], uv_l[1] / uv_l[2]), predicted_r(uv_r[0] / uv_r[2], uv_r[1] / uv_r[2]);
+    if (!refine_tracked_corner(pair_.left->image(), predicted_l, pts_L[i]) ||
+        !refine_tracked_corner(pair_.right->image(), predicted_r, pts_R[i]))
+      return nullptr;
+    // Same threshold as shortest_pair_stereo_matching, the images being rectified
+    if (std::abs(pts_L[i].y - pts_R[i].y) > pair_.left->image().rows * 0.02)
+      return nullptr;
+  }
+
+  std::vector<Eigen::Vector3d> feature_pts_3d(count);
+  std::vector<double> errors(count);
+  mil_vision::triangulate_Linear_LS(left_cam_mat, right_cam_mat, pts_L.data(), pts_R.data(), count,
+                                    feature_pts_3d.data(), errors.data());
+  for (size_t i = 0; i < count; i++)
+  {
+    if (feature_pts_3d[i](2) < 0 || feature_pts_3d[i](2) > max_z || errors[i] > tracking_max_reprojection_error_)
+      return nullptr;
+  }
+  return std::unique_ptr<std::vector<Eigen::Vector3d>>(new std::vector<Eigen::Vector3d>(feature_pts_3d));
+}
+
+bool StereoBase::refine_tracked_corner(const cv::Mat &image, const cv::Point2d &predicted, cv::Point2d &corner) const
+{
+  // cornerSubPix needs the refinement window and a pixel around it inside the image it is given
+  const int half_size = tracking_search_radius_ + tracking_corner_window_ + 1;
+  cv::Rect window(cvRound(predicted.x) - half_size, cvRound(predicted.y) - half_size, 2 * half_size + 1,
+                  2 * half_size + 1);
+  if ((window & cv::Rect(0, 0, image.cols, image.rows)) != window)
+    return false;
+
+  cv::Mat gray;
+  cv::cvtColor(image(window), gray, cv::COLOR_BGR2GRAY);
+  cv::Mat search_mask = cv::Mat::zeros(gray.size(), CV_8U);
+  cv::circle(search_mask, cv::Point(half_size, half_size), tracking_search_radius_, cv::Scalar(255), -1);
+  std::vector<cv::Point2f> corners;
+  cv::goodFeaturesToTrack(gray, corners, 1, 0.01, 1, search_mask);
+  if (corners.empty())
+    return false;
+
+  cv::cornerSubPix(gray, corners, cv::Size(tracking_corner_window_, tracking_corner_window_), cv::Size(-1, -1),
+                   cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 20, 0.03));
+  corner = cv::Point2d(corners[0].x + window.x, corners[0].y + window.y);
+  return cv::norm(corner - predicted) <= tracking_search_radius_;
+}
+
+void StereoBase::set_tracked_features(const std::vector<Eigen::Vector3d> &feature_pts_3d, const Eigen::Affine3d &pose)
+{
+  const Eigen::Affine3d to_pose = pose.inverse();
+  tracked_features_.resize(feature_pts_3d.size());
+  for (size_t i = 0; i < feature_pts_3d.size(); i++)
+    tracked_features_[i] = to_pose * feature_pts_3d[i];
+}
+
+void StereoBase::clear_tracked_features()
+{
+  tracked_features_.clear();
+}
+
 std::unique_ptr<Eigen::Affine3d> StereoBase::get_3d_pose(std::vector<Eigen::Vector3d> feature_pts_3d,
                                                          float z_vector_min)
 {
@@ -190,78 +269,42 @@ std::vector<double> StereoBase::best_fit_plane_standard(const std::vector<Eigen:
 
 void StereoBase::init_kalman_filter()
 {
-  k_filter_.init(n_states_, n_measurements_, 0, CV_64F);
-  cv::setIdentity(k_filter_.processNoiseCov, cv::Scalar::all(1e-5));
   // How much to trust measurements
-  cv::setIdentity(k_filter_.measurementNoiseCov, cv::Scalar::all(0.005));
-  cv::setIdentity(k_filter_.errorCovPost, cv::Scalar::all(1));
-
-  // position
-  k_filter_.transitionMatrix.at<double>(0, 3) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(1, 4) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(2, 5) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(3, 6) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(4, 7) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(5, 8) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(0, 6) = 0.5 * pow(1 / refresh_rate_, 2);
-  k_filter_.transitionMatrix.at<double>(1, 7) = 0.5 * pow(1 / refresh_rate_, 2);
-  k_filter_.transitionMatrix.at<double>(2, 8) = 0.5 * pow(1 / refresh_rate_, 2);
-
-  // orientation
-  k_filter_.transitionMatrix.at<double>(9, 12) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(10, 13) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(11, 14) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(12, 15) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(13, 16) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(14, 17) = 1 / refresh_rate_;
-  k_filter_.transitionMatrix.at<double>(9, 15) = 0.5 * pow(1 / refresh_rate_, 2);
-  k_filter_.transitionMatrix.at<double>(10, 16) = 0.5 * pow(1 / refresh_rate_, 2);
-  k_filter_.transitionMatrix.at<double>(11, 17) = 0.5 * pow(1 / refresh_rate_, 2);
-
-  // x
-  k_filter_.measurementMatrix.at<double>(0, 0) = 1;
-  // y
-  k_filter_.measurementMatrix.at<double>(1, 1) = 1;
-  // z
-  k_filter_.measurementMatrix.at<double>(2, 2) = 1;
-  // roll
-  k_filter_.measurementMatrix.at<double>(3, 9) = 1;
-  // pitch
-  k_filter_.measurementMatrix.at<double>(4, 10) = 1;
-  // yaw
-  k_filter_.measurementMatrix.at<double>(5, 11) = 1;
+  k_filter_.set_noise(1e-5, 0.005);
+  k_filter_.reset();
+  // Tracked features move with the filtered pose
+  clear_tracked_features();
 }
 
-cv::Mat StereoBase::get_measurement_as_cv_mat(const Eigen::Affine3d &pose)
+Eigen::Matrix<double, 6, 1> StereoBase::get_measurement(const Eigen::Affine3d &pose)
 {
-  cv::Mat measurement(n_measurements_, 1, CV_64F);
-  Eigen::Vector3d euler = pose.rotation().eulerAngles(0, 1, 2);
-  measurement.at<double>(0) = pose.translation().x();
-  measurement.at<double>(1) = pose.translation().y();
-  measurement.at<double>(2) = pose.translation().z();
-  measurement.at<double>(3) = euler(0, 0);
-  measurement.at<double>(4) = euler(1, 0);
-  measurement.at<double>(5) = euler(2, 0);
+  Eigen::Matrix<double, 6, 1> measurement;
+  measurement << pose.translation(), pose.rotation().eulerAngles(0, 1, 2);
   return measurement;
 }
 
-Eigen::Affine3d StereoBase::update_kalman_filter(const Eigen::Affine3d &pose)
+Eigen::Affine3d StereoBase::get_filtered_pose() const
 {
-  cv::Mat prediction = k_filter_.predict();
-  cv::Mat measurement = get_measurement_as_cv_mat(pose);
-
-  cv::Mat estimated = k_filter_.correct(measurement);
-
-  Eigen::Vector3d euler;
-  euler(0, 0) = estimated.at<double>(9);
-  euler(1, 0) = estimated.at<double>(10);
-  euler(2, 0) = estimated.at<double>(11);
+  Eigen::Matrix<double, 6, 1> estimated = k_filter_.values();
 
-  Eigen::AngleAxisd rollAngle(euler(0, 0), Eigen::Vector3d::UnitX());
-  Eigen::AngleAxisd yawAngle(euler(1, 0), Eigen::Vector3d::UnitY());
-  Eigen::AngleAxisd pitchAngle(euler(2, 0), Eigen::Vector3d::UnitZ());
+  Eigen::AngleAxisd rollAngle(estimated(3), Eigen::Vector3d::UnitX());
+  Eigen::AngleAxisd yawAngle(estimated(4), Eigen::Vector3d::UnitY());
+  Eigen::AngleAxisd pitchAngle(estimated(5), Eigen::Vector3d::UnitZ());
 
-  Eigen::Translation3d translation(estimated.at<double>(0), estimated.at<double>(1), estimated.at<double>(2));
+  Eigen::Translation3d translation(estimated(0), estimated(1), estimated(2));
   Eigen::Quaterniond orientation = rollAngle * yawAngle * pitchAngle;
   return Eigen::Affine3d(translation * orientation);
 }
+
+Eigen::Affine3d StereoBase::update_kalman_filter(const Eigen::Affine3d &pose, double dt)
+{
+  k_filter_.predict(dt > 0 ? dt : 1 / refresh_rate_);
+  k_filter_.correct(get_measurement(pose));
+  return get_filtered_pose();
+}
+
+Eigen::Affine3d StereoBase::predict_kalman_filter(double dt)
+{
+  k_filter_.predict(dt);
+  return get_filtered_pose();
+}
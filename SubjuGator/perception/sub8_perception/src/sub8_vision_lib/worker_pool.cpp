@@ -0,0 +1,127 @@
+#include <sub8_vision_lib/worker_pool.hpp>
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <exception>
+
+VisionWorkerPool::VisionWorkerPool(size_t threads)
+{
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < threads; i++)
+    workers_.emplace_back(&VisionWorkerPool::work, this);
+}
+
+VisionWorkerPool::~VisionWorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (std::thread &worker : workers_)
+    worker.join();
+}
+
+VisionWorkerPool &VisionWorkerPool::shared()
+{
+  static VisionWorkerPool pool(std::max(0, ros::param::param<int>("/vision/worker_threads", 0)));
+  return pool;
+}
+
+VisionWorkerPool::TaskId VisionWorkerPool::add_task(const std::string &name, int priority)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  tasks_.push_back(Task{ name, priority, std::function<void()>(), false, 0 });
+  return tasks_.size() - 1;
+}
+
+void VisionWorkerPool::set_priority(TaskId task, int priority)
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    tasks_.at(task).priority = priority;
+  }
+  work_cv_.notify_all();
+}
+
+int VisionWorkerPool::priority(TaskId task) const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  return tasks_.at(task).priority;
+}
+
+void VisionWorkerPool::stop_task(TaskId task)
+{
+  std::unique_lock<std::mutex> lock(mtx_);
+  Task &t = tasks_.at(task);
+  t.priority = 0;
+  t.pending = nullptr;
+  done_cv_.wait(lock, [&] { return !tasks_[task].running; });  // tasks_ may grow while waiting
+}
+
+bool VisionWorkerPool::submit(TaskId task, std::function<void()> work)
+{
+  bool replaced;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    Task &t = tasks_.at(task);
+    replaced = static_cast<bool>(t.pending);
+    t.pending = std::move(work);
+    if (!replaced)
+      t.submitted = submitted_++;
+  }
+  work_cv_.notify_one();
+  return !replaced;
+}
+
+size_t VisionWorkerPool::next_task() const
+{
+  size_t next = tasks_.size();
+  for (size_t i = 0; i < tasks_.size(); i++)
+  {
+    const Task &t = tasks_[i];
+    if (!t.pending || t.running || t.priority <= 0)
+      continue;
+    if (next == tasks_.size() || t.priority > tasks_[next].priority ||
+        (t.priority == tasks_[next].priority && t.submitted < tasks_[next].submitted))
+      next = i;
+  }
+  return next;
+}
+
+void VisionWorkerPool::work()
+{
+  std::unique_lock<std::mutex> lock(mtx_);
+  for (;;)
+  {
+    size_t next;
+    work_cv_.wait(lock, [&] { return stop_ || (next = next_task()) != tasks_.size(); });
+    if (stop_)
+      return;
+
+    Task &t = tasks_[next];
+    std::function<void()> work = std::move(t.pending);
+    t.pending = nullptr;
+    t.running = true;
+    std::string name = t.name;
+    lock.unlock();
+
+    try
+    {
+      work();
+    }
+    catch (const std::exception &e)
+    {
+      ROS_ERROR("VisionWorkerPool: task %s threw: %s", name.c_str(), e.what());
+    }
+
+    lock.lock();
+    tasks_[next].running = false;
+    done_cv_.notify_all();
+    // Work submitted while this ran could not be taken by another thread
+    if (tasks_[next].pending)
+      work_cv_.notify_one();
+  }
+}
@@ -32,14 +32,6 @@ class Classification
 {
   ros::NodeHandle *nh_;
 
-  // Usage: Given starting point, and an angle, find the first occupied point in that direction.
-  cv::Point2d get_first_hit(cv::Mat &mat_ogrid, cv::Point2d start, float theta, int max_dis);
-
-  float certainty_as_hit_;
-  int hit_buffer_;
-  float uncertainty_as_hit_;
-  float not_hit_degrade_;
-
 public:
   Classification(ros::NodeHandle *nh);
 
@@ -48,12 +40,4 @@ public:
 
   // Usage: obtain a clustering from pointcloud
   std::vector<pcl::PointIndices> clustering(pcl::PointCloud<pcl::PointXYZI>::ConstPtr pointCloud);
-
-  /* Usage: Find all the first occupied points in an expanding circle, then color the ogrid
-     param mat_ogrid: what ogrid will be used for processing and drawn on
-     param resolution: used to convert meters to pixels
-     param transform: get subs pose
-     param mat_origin: where the center of the ogrid is in resepct to map frame
-  */
-  void zonify(cv::Mat &mat_ogrid, float resolution, const tf::StampedTransform &transform, cv::Point &mat_origin);
 };
@@ -0,0 +1,66 @@
+#pragma once
+#include <mil_ogrid/grid_geometry.hpp>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+  Connected components of the occupied ogrid cells, 8-connected, kept up to date as cells flip so clusters can be
+  read at any time without a pass over the grid or the point cloud. Each cell keeps the height of the return that
+  made it occupied, so clusters also have a vertical extent.
+
+  A union-find joins components as cells become occupied. A cell becoming free can split its component, so that
+  component is marked and only it is rebuilt from its remaining cells the next time clusters are read.
+*/
+class OGridClusters
+{
+public:
+  struct Cell
+  {
+    cv::Point index;
+    float z;
+  };
+  struct Cluster
+  {
+    std::vector<Cell> cells;
+    cv::Point min;
+    cv::Point max;
+    float min_z;
+    float max_z;
+    cv::Point2d mean;  // in cells
+  };
+
+  void set_occupied(cv::Point cell, float z);
+  void set_free(cv::Point cell);
+  void clear();
+
+  // Clusters with between min_cells and max_cells cells
+  std::vector<Cluster> clusters(int min_cells, int max_cells);
+
+private:
+  struct Node
+  {
+    Cell cell;
+    int parent;
+    bool alive;
+  };
+  // Everything about a component, only kept for its root
+  struct Component
+  {
+    std::vector<int> members;  // including freed cells until it is rebuilt
+    int cells;
+  };
+
+  int find(int node);
+  void join(int a, int b);
+  void join_neighbors(int node);
+  // Split a component that lost cells into the components of what is left
+  void rebuild(int root);
+
+  std::vector<Node> nodes_;
+  std::vector<Component> components_;
+  std::vector<int> unused_nodes_;
+  std::unordered_map<cv::Point, int, mil_ogrid::CellHash> index_;
+  std::unordered_set<int> broken_;  // roots of components that lost cells
+};
@@ -1,7 +1,10 @@
 #pragma once
 #include <geometry_msgs/Point.h>
+#include <geometry_msgs/PolygonStamped.h>
+#include <blueview_range_profile.hpp>
 #include <mil_blueview_driver/BlueViewPing.h>
 #include <nav_msgs/OccupancyGrid.h>
+#include <ros/callback_queue_interface.h>
 #include <ros/ros.h>
 
 #include <tf/transform_listener.h>
@@ -24,18 +27,25 @@
 
 #include <boost/circular_buffer.hpp>
 
-#include <sub8_msgs/Bounds.h>
+#include <mutex>
 
 #include <waypoint_validity.hpp>
 
 #include <Classification.hpp>
+#include <OGridClusters.hpp>
+
+#include <mil_ogrid/tiled_grid.hpp>
+#include <mil_ogrid/voxel_map.hpp>
 
 #include <mil_msgs/ObjectDBQuery.h>
+#include <mil_tools/debug_publisher.hpp>
+#include <mil_tools/driver_diagnostics.hpp>
+#include <mil_tools/memory_budget.hpp>
+#include <mil_tools/trace.hpp>
 #include <mil_msgs/PerceptionObject.h>
 #include <mil_msgs/PerceptionObjectArray.h>
 #include <mil_msgs/RangeStamped.h>
 #include <std_srvs/Trigger.h>
-#include <ros_alarms/listener.hpp>
 
 extern struct ogrid_param
 {
@@ -59,11 +69,19 @@ class OGridGen
 
 {
 public:
-  OGridGen();
+  // Topics, services and params are under nh, which is the node's or nodelet's private namespace. Pings are handled on
+  // nh's queue, while the point cloud is published and clustered from bulk_queue if given, so neither waits on the
+  // other.
+  explicit OGridGen(ros::NodeHandle nh, ros::CallbackQueueInterface *bulk_queue = nullptr);
   void publish_big_pointcloud(const ros::TimerEvent &);
 
-  void callback(const mil_blueview_driver::BlueViewPingPtr &ping_msg);
+  void callback(const mil_blueview_driver::BlueViewPingConstPtr &ping_msg);
+  // Compact alternative to callback, used when the compact param is set
+  void head_callback(const mil_blueview_driver::BlueViewHeadConstPtr &head_msg);
+  void range_profile_callback(const mil_blueview_driver::BlueViewRangeProfileConstPtr &profile_msg);
   void dvl_callback(const mil_msgs::RangeStampedConstPtr &dvl);
+  // Keep the bounds to draw on the ogrid, if they changed
+  void bounds_callback(const geometry_msgs::PolygonStampedConstPtr &bounds);
 
   bool clear_ogrid_callback(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res);
 
@@ -71,59 +89,129 @@ public:
 
   bool get_objects_callback(mil_msgs::ObjectDBQuery::Request &req, mil_msgs::ObjectDBQuery::Response &res);
 
-  // Publish mat_ogrid
+  // Publish mat_ogrid, in full or as updates to the tiles that changed
   void publish_ogrid();
-  // Project point_cloud and make a persistant ogrid
-  void process_persistant_ogrid(pcl::PointCloud<pcl::PointXYZI>::Ptr point_cloud_plane);
-  // Convert persistant ogrid to a mat_ogrid
+  // Add a ping's beams to the point clouds and ogrid, given as arrays of beams elements
+  void process_ping(ros::Time const &stamp, size_t beams, const float *ranges, const uint16_t *intensities, const float *cos_bearings,
+                    const float *sin_bearings);
+  // Project every beam of a ping into the map frame, filling beam_x_, beam_y_, beam_z_ and beam_mask_
+  void project_ping(size_t beams, const float *ranges, const uint16_t *intensities, const float *cos_bearings,
+                    const float *sin_bearings);
+  // Convert the window of the persistant ogrid to a mat_ogrid
   void populate_mat_ogrid();
-
+  // Draw the outline of bounds_msg_ into bounds_mask_ in map cells, returning false if it can't be transformed yet
+  bool rasterize_bounds();
+  // OR bounds_mask_ into mat_ogrid_
+  void draw_bounds();
+  // Publish the voxels within voxel_slice_height_ / 2 of z, flattened over ogrid_size_ around sonar
+  void publish_voxel_slice(ros::Time const &stamp, cv::Point sonar, float z);
+
+  // Copy point_cloud_buffer_ into pointCloud_, with pointcloud_mutex_ locked
+  void fill_pointcloud();
   mil_msgs::PerceptionObjectArray cluster(pcl::PointCloud<pcl::PointXYZI>::Ptr pc);
+  // Objects from the clusters of occupied ogrid cells
+  mil_msgs::PerceptionObjectArray ogrid_objects();
 
 private:
   ros::NodeHandle nh_;
+  // nh_ with the bulk queue, for the point cloud's timer and services
+  ros::NodeHandle bulk_nh_;
   ros::Subscriber sub_to_imaging_sonar_;
+  ros::Subscriber sub_to_imaging_sonar_head_;
   ros::Subscriber sub_to_dvl_;
+  ros::Subscriber sub_to_bounds_;
 
   tf::TransformListener listener_;
 
-  ros_alarms::AlarmListener<> kill_listener_;
-  // remember if the sub was killed or not in order to reset ogrid origin
-  bool was_killed_;
-  // where the ogrid is with respect to map frame
-  cv::Point mat_origin_;
-
   // Publish ogrid and pointclouds
   ros::Publisher pub_grid_;
-  ros::Publisher pub_point_cloud_filtered_;
-  ros::Publisher pub_point_cloud_raw_;
-  ros::Publisher pub_point_cloud_plane_;
-  ros::Publisher pub_markers_;
+  ros::Publisher pub_grid_updates_;
+  // Only built while someone subscribes
+  mil_tools::DebugPublisher<> pub_point_cloud_filtered_;
+  mil_tools::DebugPublisher<> pub_point_cloud_raw_;
+  mil_tools::DebugPublisher<> pub_point_cloud_plane_;
+  mil_tools::DebugPublisher<> pub_markers_;
   ros::Publisher pub_objects_;
+  ros::Publisher pub_voxel_grid_;
 
   ros::ServiceServer clear_pcl_service_;
   ros::ServiceServer clear_ogrid_service_;
   ros::ServiceServer get_objects_service_;
   ros::Timer timer_;
 
-  // A CV_32F Mat to store probability of occupied/unoccupied spaces
-  cv::Mat persistant_ogrid_;
-  float hit_prob_;
+  // Map frame coordinates to the index of their ogrid cell
+  cv::Point to_ogrid(double x, double y) const;
 
+  // Log-odds of occupied/unoccupied spaces, where 0 is unknown
+  mil_ogrid::TiledGrid ogrid_tiles_;
+  // Connected occupied cells of ogrid_tiles_
+  OGridClusters ogrid_clusters_;
+  int min_object_cells_;
+  int max_object_cells_;
+
+  // Published ogrid, reused for every ping. mat_ogrid_ points into its data.
+  nav_msgs::OccupancyGrid ogrid_msg_;
   cv::Mat mat_ogrid_;
+  // Stamp of the last ping in the ogrid, published as its map_load_time for latency tracing
+  ros::Time ping_stamp_;
+  // Tiles of mat_ogrid_ the last populate_mat_ogrid wrote, unless it wrote all of it
+  std::vector<cv::Rect> changed_tiles_;
+  bool ogrid_rewritten_;
+  // Pings between full ogrids, with only the changed tiles published on ogrid_updates in between, or 0 for every ping
+  int keyframe_period_;
+  int pings_since_keyframe_;
   float ogrid_size_;
   float resolution_;
   double dvl_range_;
+
+  // Every ping traced in 3D at the sub's actual depth and attitude, along with the DVL's bottom hits, if voxel_map
+  mil_ogrid::VoxelMap voxel_map_;
+  bool use_voxel_map_;
+  float voxel_slice_height_;
+  // Published slice of voxel_map_ around the sub's depth, reused for every ping
+  nav_msgs::OccupancyGrid voxel_msg_;
+  cv::Mat voxel_slice_;
   int min_intensity_;
 
-  ros::ServiceClient service_get_bounds_;
   tf::StampedTransform transform_;
 
-  // Storage container for the pointcloud
+  // Decodes compact pings, keeping the cos and sin of the head's bearings
+  BlueViewRangeProfileDecoder range_profile_decoder_;
+  // Sonar head bearings of the last uncompressed ping, with their cos and sin
+  std::vector<float> bearings_;
+  std::vector<float> cos_bearings_;
+  std::vector<float> sin_bearings_;
+  // Last ping's beams in the map frame, and whether each was ignored, only a miss, or a hit
+  enum BeamMask : uint8_t
+  {
+    BEAM_IGNORED = 0,
+    BEAM_MISS = 1,
+    BEAM_HIT = 2
+  };
+  std::vector<float> beam_x_;
+  std::vector<float> beam_y_;
+  std::vector<float> beam_z_;
+  std::vector<uint8_t> beam_mask_;
+  pcl::PointCloud<pcl::PointXYZI>::Ptr point_cloud_plane_;
+
+  // Storage container for the pointcloud, filled by pings and read from the bulk queue, guarded by buffer_mutex_
   boost::circular_buffer<pcl::PointXYZI> point_cloud_buffer_;
+  std::mutex buffer_mutex_;
+  // Copy of the buffer to publish and cluster, and classification_ which clusters it, guarded by pointcloud_mutex_.
+  // It is held for the whole of filtering and clustering, so is locked before buffer_mutex_ if both are.
   pcl::PointCloud<pcl::PointXYZI>::Ptr pointCloud_;
+  std::mutex pointcloud_mutex_;
 
-  std::vector<cv::Point> bounds_;
+  // Bounds from the latched bounds topic, drawn into bounds_mask_ once when they change and ORed into mat_ogrid_ after
+  // every ping. bounds_mask_ starts at the map cell bounds_origin_ and is empty without bounds.
+  geometry_msgs::PolygonStampedConstPtr bounds_msg_;
+  bool bounds_pending_;
+  cv::Mat bounds_mask_;
+  cv::Point bounds_origin_;
 
   Classification classification_;
+
+  // Bytes held by the point buffer, grids and voxel map, published on diagnostics and trimmed to memory_limit_mb
+  mil_tools::MemoryBudget memory_;
+  mil_tools::DriverDiagnostics diagnostics_;
 };
@@ -0,0 +1,150 @@
+#include "OGridClusters.hpp"
+
+#include <algorithm>
+
+void OGridClusters::set_occupied(cv::Point cell, float z)
+{
+  if (index_.count(cell))
+    return;
+  int node;
+  if (unused_nodes_.empty())
+  {
+    node = nodes_.size();
+    nodes_.emplace_back();
+    components_.emplace_back();
+  }
+  else
+  {
+    node = unused_nodes_.back();
+    unused_nodes_.pop_back();
+  }
+  nodes_[node] = Node{ Cell{ cell, z }, node, true };
+  components_[node].members.assign(1, node);
+  components_[node].cells = 1;
+  index_[cell] = node;
+  join_neighbors(node);
+}
+
+void OGridClusters::set_free(cv::Point cell)
+{
+  auto it = index_.find(cell);
+  if (it == index_.end())
+    return;
+  int node = it->second;
+  index_.erase(it);
+  nodes_[node].alive = false;
+  int root = find(node);
+  components_[root].cells--;
+  broken_.insert(root);
+}
+
+void OGridClusters::clear()
+{
+  nodes_.clear();
+  components_.clear();
+  unused_nodes_.clear();
+  index_.clear();
+  broken_.clear();
+}
+
+int OGridClusters::find(int node)
+{
+  // Path halving
+  while (nodes_[node].parent != node)
+  {
+    nodes_[node].parent = nodes_[nodes_[node].parent].parent;
+    node = nodes_[node].parent;
+  }
+  return node;
+}
+
+void OGridClusters::join(int a, int b)
+{
+  a = find(a);
+  b = find(b);
+  if (a == b)
+    return;
+  // Union by size, so the members moved are always the smaller list
+  if (components_[a].members.size() < components_[b].members.size())
+    std::swap(a, b);
+  nodes_[b].parent = a;
+  Component &into = components_[a];
+  Component &from = components_[b];
+  into.members.insert(into.members.end(), from.members.begin(), from.members.end());
+  into.cells += from.cells;
+  from.members.clear();
+  from.members.shrink_to_fit();
+  from.cells = 0;
+  if (broken_.erase(b))
+    broken_.insert(a);
+}
+
+void OGridClusters::join_neighbors(int node)
+{
+  cv::Point cell = nodes_[node].cell.index;
+  for (int dy = -1; dy <= 1; ++dy)
+  {
+    for (int dx = -1; dx <= 1; ++dx)
+    {
+      auto it = index_.find(cell + cv::Point(dx, dy));
+      if (it != index_.end() && it->second != node)
+        join(node, it->second);
+    }
+  }
+}
+
+void OGridClusters::rebuild(int root)
+{
+  std::vector<int> members;
+  members.swap(components_[root].members);
+  for (int node : members)
+  {
+    components_[node].members.clear();
+    components_[node].cells = 0;
+    if (!nodes_[node].alive)
+    {
+      unused_nodes_.push_back(node);
+      continue;
+    }
+    nodes_[node].parent = node;
+    components_[node].members.assign(1, node);
+    components_[node].cells = 1;
+  }
+  for (int node : members)
+    if (nodes_[node].alive)
+      join_neighbors(node);
+}
+
+std::vector<OGridClusters::Cluster> OGridClusters::clusters(int min_cells, int max_cells)
+{
+  for (int root : std::vector<int>(broken_.begin(), broken_.end()))
+    rebuild(root);
+  broken_.clear();
+
+  std::vector<Cluster> res;
+  for (size_t root = 0; root < nodes_.size(); ++root)
+  {
+    Component const &component = components_[root];
+    if (nodes_[root].parent != int(root) || !nodes_[root].alive || component.cells < min_cells ||
+        component.cells > max_cells)
+      continue;
+    Cluster cluster;
+    cluster.cells.reserve(component.cells);
+    cluster.min = cluster.max = nodes_[root].cell.index;
+    cluster.min_z = cluster.max_z = nodes_[root].cell.z;
+    cv::Point2d sum(0, 0);
+    for (int node : component.members)
+    {
+      Cell const &cell = nodes_[node].cell;
+      cluster.cells.push_back(cell);
+      cluster.min = cv::Point(std::min(cluster.min.x, cell.index.x), std::min(cluster.min.y, cell.index.y));
+      cluster.max = cv::Point(std::max(cluster.max.x, cell.index.x), std::max(cluster.max.y, cell.index.y));
+      cluster.min_z = std::min(cluster.min_z, cell.z);
+      cluster.max_z = std::max(cluster.max_z, cell.z);
+      sum += cv::Point2d(cell.index);
+    }
+    cluster.mean = sum * (1.0 / component.cells);
+    res.push_back(cluster);
+  }
+  return res;
+}
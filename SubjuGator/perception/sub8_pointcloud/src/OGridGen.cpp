@@ -1,26 +1,36 @@
 #include "OGridGen.hpp"
 
+#include <map_msgs/OccupancyGridUpdate.h>
+#include <mil_ogrid/grid_delta.hpp>
+#include <mil_tools/msg_helpers.hpp>
+
+#include <boost/make_shared.hpp>
+
+#include <algorithm>
+
 // TODO: Add service call to clear ogrid
 
 ogrid_param params;
 
-OGridGen::OGridGen()
-  : nh_(ros::this_node::getName())
-  , kill_listener_(nh_, "kill")
-  , was_killed_(true)
+OGridGen::OGridGen(ros::NodeHandle nh, ros::CallbackQueueInterface *bulk_queue)
+  : nh_(nh)
+  , bulk_nh_(nh)
   , classification_(&nh_)
   , pointCloud_(new pcl::PointCloud<pcl::PointXYZI>())
+  , memory_(nh)
+  , diagnostics_(nh, nh, ros::this_node::getName(), "ogrid_gen")
 {
+  if (bulk_queue)
+    bulk_nh_.setCallbackQueue(bulk_queue);
   // The publishers
   pub_grid_ = nh_.advertise<nav_msgs::OccupancyGrid>("ogrid", 10, true);
+  pub_grid_updates_ = nh_.advertise<map_msgs::OccupancyGridUpdate>("ogrid_updates", 10);
   pub_point_cloud_filtered_ = nh_.advertise<pcl::PointCloud<pcl::PointXYZI>>("point_cloud/filtered", 1);
   pub_point_cloud_raw_ = nh_.advertise<pcl::PointCloud<pcl::PointXYZI>>("point_cloud/raw", 1);
   pub_point_cloud_plane_ = nh_.advertise<pcl::PointCloud<pcl::PointXYZI>>("point_cloud/plane", 1);
   pub_markers_ = nh_.advertise<visualization_msgs::MarkerArray>("markers", 1);
   pub_objects_ = nh_.advertise<mil_msgs::PerceptionObjectArray>("objects", 1);
-  clear_ogrid_service_ = nh_.advertiseService("clear_ogrid", &OGridGen::clear_ogrid_callback, this);
-  clear_pcl_service_ = nh_.advertiseService("clear_pcl", &OGridGen::clear_pcl_callback, this);
-  get_objects_service_ = nh_.advertiseService("get_objects", &OGridGen::get_objects_callback, this);
+  mil_tools::Tracer::instance().configure(nh_);
   // Do ogrid?
   nh_.param<bool>("ogrid", params.ogrid, false);
   // Resolution is meters/pixel
@@ -36,91 +46,231 @@ OGridGen::OGridGen()
   nh_.param<float>("nearby_threshold", params.nearby_threshold, 1);
   nh_.param<float>("depth", params.depth, 10);
   nh_.param<bool>("debug", params.debug, false);
+  // Log-odds added to a cell when a beam returns from it, and when a beam passes through it
+  mil_ogrid::TiledGrid::Update update;
+  nh_.param<float>("hit_log_odds", update.hit, 0.85);
+  nh_.param<float>("miss_log_odds", update.miss, -0.4);
+  // Cells saturate here so they can still change quickly when the world does
+  nh_.param<float>("min_log_odds", update.min, -4);
+  nh_.param<float>("max_log_odds", update.max, 4);
+  // The ogrid is kept in tiles of tile_size cells. Tiles well away from the sub are written to tile_dir if it is set.
+  int tile_size;
+  std::string tile_dir;
+  nh_.param<int>("tile_size", tile_size, 64);
+  nh_.param<std::string>("tile_dir", tile_dir, "");
+  // Publish the full ogrid every ogrid_keyframe_period pings, and only the tiles that changed on ogrid_updates between
+  nh_.param<int>("ogrid_keyframe_period", keyframe_period_, 0);
+  pings_since_keyframe_ = 0;
+  ogrid_rewritten_ = true;
+  // Probabilities a cell must be above to be occupied, and below to be unoccupied
+  float occupied_prob, unoccupied_prob;
+  nh_.param<float>("occupied_prob", occupied_prob, 0.8);
+  nh_.param<float>("unoccupied_prob", unoccupied_prob, 0.1);
+  update.occupied = std::log(occupied_prob / (1 - occupied_prob));
+  update.unoccupied = std::log(unoccupied_prob / (1 - unoccupied_prob));
+  // Size of the ogrid clusters get_objects reports, in cells
+  nh_.param<int>("min_object_cells", min_object_cells_, 2);
+  nh_.param<int>("max_object_cells", max_object_cells_, 2500);
   dvl_range_ = 0;
+  // Trace pings and DVL ranges into a 3D map of voxel_resolution meters as well, and publish the part of it within
+  // voxel_slice_height / 2 of the sub's depth on voxel_ogrid
+  float voxel_resolution;
+  nh_.param<bool>("voxel_map", use_voxel_map_, false);
+  nh_.param<float>("voxel_resolution", voxel_resolution, 0.1);
+  nh_.param<float>("voxel_slice_height", voxel_slice_height_, 1.);
+  voxel_map_ = mil_ogrid::VoxelMap(voxel_resolution, update);
+  if (use_voxel_map_)
+    pub_voxel_grid_ = nh_.advertise<nav_msgs::OccupancyGrid>("voxel_ogrid", 1);
 
   // Buffer that will only hold a certain amount of points
   int point_cloud_buffer_Size;
   nh_.param<int>("buffer_size", point_cloud_buffer_Size, 5000);
   point_cloud_buffer_.set_capacity(point_cloud_buffer_Size);
 
-  // TODO: Publish bounds
-  service_get_bounds_ = nh_.serviceClient<sub8_msgs::Bounds>("get_bounds");
-
+  // Bounds are latched and only change now and then, so they are drawn again only when a new polygon arrives
+  bounds_pending_ = false;
+
+  // The published window covers at least ogrid_size_ meters around the sub, in whole tiles
+  int window_tiles = std::ceil(ogrid_size_ / resolution_ / tile_size);
+  ogrid_tiles_ = mil_ogrid::TiledGrid(tile_size, window_tiles, update, tile_dir);
+  ogrid_tiles_.set_flip_callback([this](cv::Point cell, bool occupied, float z) {
+    if (occupied)
+      ogrid_clusters_.set_occupied(cell, z);
+    else
+      ogrid_clusters_.set_free(cell);
+  });
+
+  // mat_ogrid_ is a view of the published message's data, so populating it fills the message in place
+  int ogrid_cells = ogrid_tiles_.window_cells();
+  ogrid_msg_.header.frame_id = "map";
+  ogrid_msg_.info.resolution = resolution_;
+  ogrid_msg_.info.width = ogrid_cells;
+  ogrid_msg_.info.height = ogrid_cells;
+  ogrid_msg_.data.assign(ogrid_cells * ogrid_cells, 0);
+  mat_ogrid_ = mil_ogrid::as_mat(ogrid_msg_);
+
+  // Over its limit, the point buffer keeps its newest points and the voxel map the blocks nearest the sub. The tiles
+  // are bounded by tile_dir and the grids by ogrid_size, so those are only counted.
+  memory_.add("point_buffer",
+              [this] {
+                std::lock_guard<std::mutex> cloud_lock(pointcloud_mutex_);
+                std::lock_guard<std::mutex> buffer_lock(buffer_mutex_);
+                return (point_cloud_buffer_.capacity() + pointCloud_->points.capacity()) * sizeof(pcl::PointXYZI);
+              },
+              [this](size_t bytes) {
+                std::lock_guard<std::mutex> cloud_lock(pointcloud_mutex_);
+                std::lock_guard<std::mutex> buffer_lock(buffer_mutex_);
+                point_cloud_buffer_.rset_capacity(std::max<size_t>(1, bytes / 2 / sizeof(pcl::PointXYZI)));
+                pointCloud_->points.shrink_to_fit();
+              });
+  memory_.add("ogrid_tiles", [this] { return ogrid_tiles_.bytes(); });
+  memory_.add("voxel_map", [this] { return voxel_map_.bytes(); },
+              [this](size_t bytes) {
+                tf::Vector3 const &sub = transform_.getOrigin();
+                voxel_map_.evict_far(cv::Point3f(sub.x(), sub.y(), sub.z()), bytes);
+              });
+  memory_.add("grids", [this] {
+    return ogrid_msg_.data.capacity() + voxel_msg_.data.capacity() + bounds_mask_.total() * bounds_mask_.elemSize();
+  });
+  diagnostics_.add_status("memory", [this](diagnostic_msgs::DiagnosticStatus &status) { memory_.to_msg(status); });
+
+  // Callbacks are only set up once everything they use is, as on a multi-threaded queue they may run at once
+
+  // The ogrid is only touched by pings, so is cleared in turn with them. With the ogrid, objects come from its
+  // clusters, so are served in turn with pings too, otherwise from clustering the point cloud on the bulk queue.
+  clear_ogrid_service_ = nh_.advertiseService("clear_ogrid", &OGridGen::clear_ogrid_callback, this);
+  clear_pcl_service_ = bulk_nh_.advertiseService("clear_pcl", &OGridGen::clear_pcl_callback, this);
+  get_objects_service_ =
+      (params.ogrid ? nh_ : bulk_nh_).advertiseService("get_objects", &OGridGen::get_objects_callback, this);
+  sub_to_bounds_ = nh_.subscribe("/bounds", 1, &OGridGen::bounds_callback, this);
   // Run the publisher
-  timer_ =
-      nh_.createTimer(ros::Duration(0.3), std::bind(&OGridGen::publish_big_pointcloud, this, std::placeholders::_1));
-  sub_to_imaging_sonar_ = nh_.subscribe("/blueview_driver/ranges", 1, &OGridGen::callback, this);
+  timer_ = bulk_nh_.createTimer(ros::Duration(0.3),
+                                std::bind(&OGridGen::publish_big_pointcloud, this, std::placeholders::_1));
+  // Take the compact range profile from the sonar rather than BlueViewPings
+  bool compact;
+  nh_.param<bool>("compact", compact, false);
+  if (compact)
+  {
+    sub_to_imaging_sonar_head_ = nh_.subscribe("/blueview_driver/head", 1, &OGridGen::head_callback, this);
+    sub_to_imaging_sonar_ =
+        nh_.subscribe("/blueview_driver/range_profile", 1, &OGridGen::range_profile_callback, this);
+  }
+  else
+  {
+    sub_to_imaging_sonar_ = nh_.subscribe("/blueview_driver/ranges", 1, &OGridGen::callback, this);
+  }
   sub_to_dvl_ = nh_.subscribe("/dvl/range", 1, &OGridGen::dvl_callback, this);
-
-  mat_ogrid_ = cv::Mat::zeros(int(ogrid_size_ / resolution_), int(ogrid_size_ / resolution_), CV_8U);
-  persistant_ogrid_ = cv::Mat(int(ogrid_size_) / resolution_, int(ogrid_size_ / resolution_), CV_32FC1);
-  persistant_ogrid_ = 0.5;
-
-  // Make sure alarm integration is ok
-  kill_listener_.waitForConnection(ros::Duration(2));
-  if (kill_listener_.getNumConnections() < 1)
-    throw std::runtime_error("The kill listener isn't connected to the alarm server");
-  kill_listener_.start();
-
-  mat_origin_ = cv::Point(0, 0);
 }
 
 void OGridGen::dvl_callback(const mil_msgs::RangeStampedConstPtr &dvl)
 {
   dvl_range_ = dvl->range;
-}
-/*
-  Looped based on timer_.
-  Reads point_cloud_buffer_ and publishes a PointCloud2
-  Reads mat_ogrid_ and publish a OccupencyGrid
-*/
-void OGridGen::publish_big_pointcloud(const ros::TimerEvent &)
-{
-  // Service call for 'get_bounds'
-  sub8_msgs::Bounds get_bound_data;
-  if (service_get_bounds_.call(get_bound_data))
+  if (!use_voxel_map_)
+    return;
+  // The range is the height over the bottom, so the bottom is straight down from the DVL, and the water above it clear
+  tf::StampedTransform transform;
+  try
   {
-    bounds_ = std::vector<cv::Point>();
-    bounds_.reserve(4);
-    // Populate bounds_ with the data from service call
-    for (auto &p : get_bound_data.response.bounds)
-    {
-      bounds_.push_back(cv::Point(p.x / resolution_ + mat_ogrid_.cols / 2, p.y / resolution_ + mat_ogrid_.rows / 2));
-    }
-
-    // Convert bounds_ vector to an array of array and use openCV function to draw a polygon
-    const cv::Point *pts = (const cv::Point *)cv::Mat(bounds_).data;
-    int npts = cv::Mat(bounds_).rows;
-    cv::polylines(mat_ogrid_, &pts, &npts, 1, true, 255, 3, CV_8U, 0);
+    listener_.lookupTransform("/map", dvl->header.frame_id, ros::Time(0), transform);
   }
-
-  // Populate a PCL pointcloud using the point_cloud_buffer_
+  catch (tf::TransformException ex)
+  {
+    ROS_DEBUG_STREAM("Did not get TF for the DVL");
+    return;
+  }
+  tf::Vector3 const &origin = transform.getOrigin();
+  voxel_map_.trace_ray(cv::Point3f(origin.x(), origin.y(), origin.z()),
+                       cv::Point3f(origin.x(), origin.y(), origin.z() - dvl->range), true);
+}
+void OGridGen::fill_pointcloud()
+{
+  std::lock_guard<std::mutex> lock(buffer_mutex_);
   pointCloud_->clear();
   pointCloud_->reserve(point_cloud_buffer_.capacity());
   for (auto &p : point_cloud_buffer_)
   {
     pointCloud_->push_back(p);
   }
-
-  // Publish the raw point cloud
   pointCloud_->header.frame_id = "map";
   pcl_conversions::toPCL(ros::Time::now(), pointCloud_->header.stamp);
-  pub_point_cloud_raw_.publish(pointCloud_);
+}
 
-  if (params.debug)
+/*
+  Looped based on timer_.
+  Reads point_cloud_buffer_ and publishes a PointCloud2, if anyone is listening
+*/
+void OGridGen::publish_big_pointcloud(const ros::TimerEvent &)
+{
+  bool debug = params.debug && mil_tools::any_wanted(pub_point_cloud_filtered_, pub_markers_);
+  if (!debug && !pub_point_cloud_raw_.wanted())
+    return;
+  std::lock_guard<std::mutex> lock(pointcloud_mutex_);
+  fill_pointcloud();
+
+  // Publish the raw point cloud
+  if (pub_point_cloud_raw_.wanted())
+    pub_point_cloud_raw_.publish(pointCloud_);
+
+  if (debug)
   {
     // For debugging a snapshot of current point cloud and filter it and show objects
     pcl::PointCloud<pcl::PointXYZI>::Ptr pointCloud_filtered = classification_.filtered(pointCloud_);
-    pub_point_cloud_filtered_.publish(pointCloud_filtered);
-    cluster(pointCloud_filtered);
+    if (pub_point_cloud_filtered_.wanted())
+      pub_point_cloud_filtered_.publish(pointCloud_filtered);
+    // Only for its markers
+    if (pub_markers_.wanted())
+      cluster(pointCloud_filtered);
   }
 }
 
 /*
   Subscribes to pingmsgs from blueview sonar and saves a plane of pings into a buffer based on sub pose
 */
-void OGridGen::callback(const mil_blueview_driver::BlueViewPingPtr &ping_msg)
+void OGridGen::callback(const mil_blueview_driver::BlueViewPingConstPtr &ping_msg)
+{
+  size_t beams = ping_msg->ranges.size();
+  if (ping_msg->bearings.size() != beams || ping_msg->intensities.size() != beams)
+  {
+    ROS_WARN_STREAM_THROTTLE(1, "Ignoring ping with " << ping_msg->bearings.size() << " bearings, " << beams
+                                                      << " ranges and " << ping_msg->intensities.size()
+                                                      << " intensities");
+    return;
+  }
+  // The bearings only change with the sonar head's configuration, so their sin and cos are kept between pings
+  if (ping_msg->bearings != bearings_)
+  {
+    bearings_ = ping_msg->bearings;
+    cos_bearings_.resize(beams);
+    sin_bearings_.resize(beams);
+    for (size_t i = 0; i < beams; ++i)
+    {
+      cos_bearings_[i] = std::cos(bearings_[i]);
+      sin_bearings_[i] = std::sin(bearings_[i]);
+    }
+  }
+  process_ping(ping_msg->header.stamp, beams, ping_msg->ranges.data(), ping_msg->intensities.data(),
+               cos_bearings_.data(), sin_bearings_.data());
+}
+void OGridGen::head_callback(const mil_blueview_driver::BlueViewHeadConstPtr &head_msg)
+{
+  range_profile_decoder_.setHead(*head_msg);
+}
+void OGridGen::range_profile_callback(const mil_blueview_driver::BlueViewRangeProfileConstPtr &profile_msg)
+{
+  if (!range_profile_decoder_.decode(*profile_msg))
+  {
+    ROS_WARN_STREAM_THROTTLE(1, "Ignoring range profile with geometry " << profile_msg->geometry_id
+                                                                        << " without a matching sonar head");
+    return;
+  }
+  process_ping(profile_msg->header.stamp, range_profile_decoder_.size(), range_profile_decoder_.ranges(),
+               range_profile_decoder_.intensities(), range_profile_decoder_.cosBearings(),
+               range_profile_decoder_.sinBearings());
+}
+void OGridGen::process_ping(ros::Time const &stamp, size_t beams, const float *ranges, const uint16_t *intensities,
+                            const float *cos_bearings, const float *sin_bearings)
 {
+  mil_tools::TraceSpan span("ogrid_gen.ping", stamp);
   try  // TODO: Switch to TF2
   {
     listener_.lookupTransform("/map", "/blueview", ros::Time(0), transform_);
@@ -130,125 +280,239 @@ void OGridGen::callback(const mil_blueview_driver::BlueViewPingPtr &ping_msg)
     ROS_DEBUG_STREAM("Did not get TF for imaging sonar");
     return;
   }
-  if (kill_listener_.isRaised())
-    was_killed_ = true;
-  else if (was_killed_)
+  project_ping(beams, ranges, intensities, cos_bearings, sin_bearings);
+
+  cv::Point sonar = to_ogrid(transform_.getOrigin().x(), transform_.getOrigin().y());
+  cv::Point3f sonar_3d(transform_.getOrigin().x(), transform_.getOrigin().y(), transform_.getOrigin().z());
+  if (params.ogrid)
+    ogrid_tiles_.center_window(sonar);
+  // The plane of this ping is only for viewing, so only built while someone subscribes. The last one is reused
+  // unless a subscriber still holds it.
+  bool publish_plane = pub_point_cloud_plane_.wanted();
+  if (publish_plane)
   {
-    was_killed_ = false;
-    mat_origin_ = cv::Point(transform_.getOrigin().x(), transform_.getOrigin().y());
+    if (!point_cloud_plane_ || !point_cloud_plane_.unique())
+      point_cloud_plane_.reset(new pcl::PointCloud<pcl::PointXYZI>());
+    point_cloud_plane_->clear();
+    point_cloud_plane_->reserve(beams);
   }
-
-  pcl::PointCloud<pcl::PointXYZI>::Ptr point_cloud_plane(new pcl::PointCloud<pcl::PointXYZI>());
-  for (size_t i = 0; i < ping_msg->ranges.size(); ++i)
+  // The bulk queue only copies the buffer out, so waits at most for this one ping
+  std::unique_lock<std::mutex> buffer_lock(buffer_mutex_);
+  for (size_t i = 0; i < beams; ++i)
   {
-    if (ping_msg->intensities.at(i) > min_intensity_)
-    {  // TODO: Better thresholding
-
-      // Get x and y of a ping. RIGHT TRIANGLES
-      double x_d = ping_msg->ranges.at(i) * cos(ping_msg->bearings.at(i));
-      double y_d = ping_msg->ranges.at(i) * sin(ping_msg->bearings.at(i));
-      if (std::hypot(x_d, y_d) < params.nearby_threshold)
-        continue;
-
-      // Rotate point using TF
-      tf::Vector3 vec = tf::Vector3(x_d, y_d, 0);
-      tf::Vector3 newVec = transform_.getBasis() * vec;
-
-      // Shift point relative to sub's location
-      pcl::PointXYZI point;
-      point.x = newVec.x() + transform_.getOrigin().x();
-      point.y = newVec.y() + transform_.getOrigin().y();
-      point.z = newVec.z() + transform_.getOrigin().z();
-      // Ignore points if they are below some depth in map frame
-      if (point.z < -params.depth)
-        continue;
-      point.intensity = ping_msg->intensities.at(i);
-      point_cloud_buffer_.push_back(point);
-      point_cloud_plane->push_back(point);
-    }
+    if (!beam_mask_[i])
+      continue;
+    bool hit = beam_mask_[i] == BEAM_HIT;
+    if (params.ogrid)
+      ogrid_tiles_.trace_beam(sonar, to_ogrid(beam_x_[i], beam_y_[i]), hit, beam_z_[i]);
+    // The voxel map keeps returns below the depth cutoff, at the height of the bottom they came from
+    if (use_voxel_map_)
+      voxel_map_.trace_ray(sonar_3d, cv::Point3f(beam_x_[i], beam_y_[i], beam_z_[i]),
+                           intensities[i] > min_intensity_);
+    if (!hit)
+      continue;
+    pcl::PointXYZI point;
+    point.x = beam_x_[i];
+    point.y = beam_y_[i];
+    point.z = beam_z_[i];
+    point.intensity = intensities[i];
+    point_cloud_buffer_.push_back(point);
+    if (publish_plane)
+      point_cloud_plane_->push_back(point);
+  }
+  buffer_lock.unlock();
+  if (publish_plane)
+  {
+    point_cloud_plane_->header.frame_id = "map";
+    pcl_conversions::toPCL(ros::Time::now(), point_cloud_plane_->header.stamp);
+    pub_point_cloud_plane_.publish(point_cloud_plane_);
   }
-  point_cloud_plane->header.frame_id = "map";
-  pcl_conversions::toPCL(ros::Time::now(), point_cloud_plane->header.stamp);
-  pub_point_cloud_plane_.publish(point_cloud_plane);
 
   if (params.ogrid)
   {
-    process_persistant_ogrid(point_cloud_plane);
+    ping_stamp_ = stamp;
+    if (bounds_pending_)
+      bounds_pending_ = !rasterize_bounds();
     populate_mat_ogrid();
+    draw_bounds();
     publish_ogrid();
   }
+  if (use_voxel_map_ && pub_voxel_grid_.getNumSubscribers() > 0)
+    publish_voxel_slice(stamp, sonar, sonar_3d.z);
+}
+void OGridGen::project_ping(size_t beams, const float *__restrict__ ranges, const uint16_t *__restrict__ intensities,
+                            const float *__restrict__ cos_bearings, const float *__restrict__ sin_bearings)
+{
+  beam_x_.resize(beams);
+  beam_y_.resize(beams);
+  beam_z_.resize(beams);
+  beam_mask_.resize(beams);
+
+  // Beams are in the sonar's xy plane, so only the first two columns of the rotation to map are needed
+  tf::Matrix3x3 const &basis = transform_.getBasis();
+  tf::Vector3 const &origin = transform_.getOrigin();
+  const float r00 = basis[0][0], r01 = basis[0][1], r10 = basis[1][0], r11 = basis[1][1], r20 = basis[2][0],
+              r21 = basis[2][1];
+  const float ox = origin.x(), oy = origin.y(), oz = origin.z();
+  const float nearby = params.nearby_threshold;
+  const float min_z = -params.depth;
+  const int min_intensity = min_intensity_;
+  const float no_return = std::numeric_limits<float>::infinity();
+
+  // Branchless over plain arrays, so the compiler can vectorize it
+  float *__restrict__ xs = beam_x_.data();
+  float *__restrict__ ys = beam_y_.data();
+  float *__restrict__ zs = beam_z_.data();
+  uint8_t *__restrict__ mask = beam_mask_.data();
+  for (size_t i = 0; i < beams; ++i)
+  {
+    // Get x and y of a ping. RIGHT TRIANGLES
+    float x = ranges[i] * cos_bearings[i];
+    float y = ranges[i] * sin_bearings[i];
+    // Rotate and shift relative to the sub's location
+    xs[i] = r00 * x + r01 * y + ox;
+    ys[i] = r10 * x + r11 * y + oy;
+    float z = r20 * x + r21 * y + oz;
+    zs[i] = z;
+    // A weak return, or one below some depth in map frame, still shows the water up to it is clear
+    uint8_t hit = (intensities[i] > min_intensity) & (z >= min_z);  // TODO: Better thresholding
+    // Beams without a return (infinite or NaN range) can't be traced
+    uint8_t far = (std::abs(ranges[i]) >= nearby) & (std::abs(ranges[i]) < no_return);
+    mask[i] = far * (BEAM_MISS + hit);
+  }
 }
+
 void OGridGen::populate_mat_ogrid()
 {
-  classification_.zonify(persistant_ogrid_, resolution_, transform_, mat_origin_);
-  for (int i = 0; i < persistant_ogrid_.cols; ++i)
+  changed_tiles_.clear();
+  ogrid_rewritten_ = ogrid_tiles_.threshold_window(mat_ogrid_, &changed_tiles_);
+}
+
+void OGridGen::publish_voxel_slice(ros::Time const &stamp, cv::Point sonar, float z)
+{
+  // Same resolution and size as the ogrid, centered on the sonar
+  int cells = ogrid_tiles_.window_cells();
+  cv::Point origin = sonar - cv::Point(cells / 2, cells / 2);
+  mil_ogrid::GridGeometry geometry(resolution_, origin.x * resolution_, origin.y * resolution_, cells, cells);
+  if (voxel_msg_.data.size() != size_t(cells) * cells)
   {
-    for (int j = 0; j < persistant_ogrid_.rows; ++j)
-    {
-      float val = persistant_ogrid_.at<float>(cv::Point(i, j));
-      if (val > .8)
-        mat_ogrid_.at<uchar>(cv::Point(i, j)) = (uchar)WAYPOINT_ERROR_TYPE::OCCUPIED;
-      else if (val < .1)
-        mat_ogrid_.at<uchar>(cv::Point(i, j)) = (uchar)WAYPOINT_ERROR_TYPE::UNOCCUPIED;
-      else
-        mat_ogrid_.at<uchar>(cv::Point(i, j)) = (uchar)WAYPOINT_ERROR_TYPE::UNKNOWN;
-    }
+    voxel_msg_.header.frame_id = "map";
+    voxel_msg_.data.assign(size_t(cells) * cells, 0);
+    voxel_slice_ = mil_ogrid::as_mat(voxel_msg_);
   }
+  geometry.to_info(voxel_msg_.info);
+  voxel_msg_.info.map_load_time = stamp;
+  voxel_msg_.header.stamp = ros::Time::now();
+  // voxel_slice_ is a view of voxel_msg_.data, which slice only creates again if its size changed
+  voxel_map_.slice(geometry, z - voxel_slice_height_ / 2, z + voxel_slice_height_ / 2, voxel_slice_);
+  pub_voxel_grid_.publish(nav_msgs::OccupancyGridConstPtr(boost::make_shared<nav_msgs::OccupancyGrid>(voxel_msg_)));
 }
 
-void OGridGen::publish_ogrid()
+void OGridGen::bounds_callback(const geometry_msgs::PolygonStampedConstPtr &bounds)
+{
+  auto same_point = [](geometry_msgs::Point32 const &a, geometry_msgs::Point32 const &b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+  };
+  if (bounds_msg_ && bounds->header.frame_id == bounds_msg_->header.frame_id &&
+      bounds->polygon.points.size() == bounds_msg_->polygon.points.size() &&
+      std::equal(bounds->polygon.points.begin(), bounds->polygon.points.end(), bounds_msg_->polygon.points.begin(),
+                 same_point))
+    return;
+  bounds_msg_ = bounds;
+  bounds_pending_ = true;
+}
+
+bool OGridGen::rasterize_bounds()
 {
-  // Flatten the mat_ogrid_ into a 1D vector for OccupencyGrid message
-  nav_msgs::OccupancyGrid rosGrid;
-  std::vector<int8_t> data(mat_ogrid_.cols * mat_ogrid_.rows);
-  auto out_it = data.begin();
-  for (int row = 0; row < mat_ogrid_.rows; ++row)
+  // Bounds are in a fixed frame, so the latest transform will do
+  tf::StampedTransform transform;
+  transform.setIdentity();
+  std::string const &frame = bounds_msg_->header.frame_id;
+  if (!frame.empty() && frame != "map" && frame != "/map")
   {
-    auto *p = mat_ogrid_.ptr(row);
-    for (int col = 0; col < mat_ogrid_.cols; ++col)
+    try
+    {
+      listener_.lookupTransform("/map", frame, ros::Time(0), transform);
+    }
+    catch (tf::TransformException ex)
     {
-      *out_it = int(*p++);
-      out_it++;
+      ROS_WARN_STREAM_THROTTLE(5, "Waiting for a transform from " << frame << " to map to draw the bounds");
+      return false;
     }
   }
 
-  // Publish the ogrid
-  rosGrid.header.seq = 0;
-  rosGrid.info.resolution = resolution_;
-  rosGrid.header.frame_id = "map";
-  rosGrid.header.stamp = ros::Time::now();
-  rosGrid.info.map_load_time = ros::Time::now();
-  rosGrid.info.width = mat_ogrid_.cols;
-  rosGrid.info.height = mat_ogrid_.rows;
-  rosGrid.info.origin.position.x = mat_origin_.x - ogrid_size_ / 2;
-  rosGrid.info.origin.position.y = mat_origin_.y - ogrid_size_ / 2;
-  rosGrid.data = data;
-  pub_grid_.publish(rosGrid);
+  std::vector<cv::Point> cells;
+  for (geometry_msgs::Point32 const &point : bounds_msg_->polygon.points)
+  {
+    tf::Vector3 p = transform * tf::Vector3(point.x, point.y, point.z);
+    cells.push_back(to_ogrid(p.x(), p.y()));
+  }
+  // Whatever was drawn before is in mat_ogrid_ until every tile is written again
+  ogrid_tiles_.invalidate_window();
+  if (cells.size() < 2)
+  {
+    bounds_mask_.release();
+    return true;
+  }
+
+  // Outline 3 cells thick, as it was drawn before, in a mask just big enough for it
+  cv::Rect rect = cv::boundingRect(cells);
+  bounds_origin_ = rect.tl() - cv::Point(2, 2);
+  bounds_mask_ = cv::Mat::zeros(rect.height + 4, rect.width + 4, CV_8UC1);
+  for (cv::Point &cell : cells)
+    cell -= bounds_origin_;
+  cv::polylines(bounds_mask_, cells, true, 255, 3, cv::LINE_8);
+  return true;
 }
 
-void OGridGen::process_persistant_ogrid(pcl::PointCloud<pcl::PointXYZI>::Ptr point_cloud_plane)
+void OGridGen::draw_bounds()
 {
-  nh_.param<float>("hit_prob", hit_prob_, 0.1);
+  if (bounds_mask_.empty())
+    return;
+  cv::Rect mask_rect(bounds_origin_ - ogrid_tiles_.window_origin(), bounds_mask_.size());
+  cv::Rect roi = mask_rect & cv::Rect(0, 0, mat_ogrid_.cols, mat_ogrid_.rows);
+  if (roi.empty())
+    return;
+  // bitwise_or is vectorized, and works in place on the part of mat_ogrid_ the mask covers
+  cv::Mat cells = mat_ogrid_(roi);
+  cv::bitwise_or(cells, bounds_mask_(roi - mask_rect.tl()), cells);
+}
 
-  for (auto &point_pcl : point_cloud_plane->points)
+void OGridGen::publish_ogrid()
+{
+  // ogrid_msg_.data already holds mat_ogrid_, so only the header and origin change
+  ogrid_msg_.header.stamp = ros::Time::now();
+  ogrid_msg_.info.map_load_time = ping_stamp_;
+  ogrid_msg_.info.origin.position.x = ogrid_tiles_.window_origin().x * resolution_;
+  ogrid_msg_.info.origin.position.y = ogrid_tiles_.window_origin().y * resolution_;
+
+  // A scrolled window moves every cell, so it always needs a full ogrid
+  if (keyframe_period_ <= 0 || ogrid_rewritten_ || ++pings_since_keyframe_ >= keyframe_period_)
   {
-    // Check if point is inside the potential ogrid
-    cv::Rect rect(cv::Point(0, 0), persistant_ogrid_.size());
-    cv::Point p(point_pcl.x / resolution_ + persistant_ogrid_.cols / 2 - mat_origin_.x / resolution_,
-                point_pcl.y / resolution_ + persistant_ogrid_.rows / 2 - mat_origin_.y / resolution_);
-    if (rect.contains(p))
-    {
-      if (persistant_ogrid_.at<float>(p.y, p.x) < 1)
-      {
-        persistant_ogrid_.at<float>(p.y, p.x) += hit_prob_;
-      }
-    }
+    pings_since_keyframe_ = 0;
+    // ogrid_msg_ is reused for the next ping, so subscribers get a copy. Published as a pointer, a subscriber in the
+    // same nodelet manager shares it rather than deserializing its own.
+    pub_grid_.publish(nav_msgs::OccupancyGridConstPtr(boost::make_shared<nav_msgs::OccupancyGrid>(ogrid_msg_)));
+    return;
+  }
+  for (cv::Rect const &tile : changed_tiles_)
+  {
+    boost::shared_ptr<map_msgs::OccupancyGridUpdate> update = boost::make_shared<map_msgs::OccupancyGridUpdate>();
+    update->header = ogrid_msg_.header;
+    mil_ogrid::make_update(mat_ogrid_, tile, *update);
+    pub_grid_updates_.publish(update);
   }
 }
 
+cv::Point OGridGen::to_ogrid(double x, double y) const
+{
+  return mil_ogrid::cell_of(x, y, resolution_);
+}
+
 mil_msgs::PerceptionObjectArray OGridGen::cluster(pcl::PointCloud<pcl::PointXYZI>::Ptr pc)
 {
   int id = 0;
+  bool publish_markers = pub_markers_.wanted();
   visualization_msgs::MarkerArray markers;
   mil_msgs::PerceptionObjectArray objects;
   // Cluster points into objects
@@ -260,19 +524,16 @@ mil_msgs::PerceptionObjectArray OGridGen::cluster(pcl::PointCloud<pcl::PointXYZI
     mil_msgs::PerceptionObject object;
     pcl::CentroidPoint<pcl::PointXYZI> centroid;
     pcl::PointCloud<pcl::PointXYZI>::Ptr cloud_cluster(new pcl::PointCloud<pcl::PointXYZI>);
+    cloud_cluster->reserve(it->indices.size());
     for (std::vector<int>::const_iterator pit = it->indices.begin(); pit != it->indices.end(); ++pit)
     {
-      auto p = pc->points[*pit];
-      cloud_cluster->push_back(p);
+      cloud_cluster->push_back(pc->points[*pit]);
       centroid.add(pc->points[*pit]);
-
-      // Add point to object's array
-      geometry_msgs::Point32 geo_p;
-      geo_p.x = p.x;
-      geo_p.y = p.y;
-      geo_p.z = p.z;
-      object.points.emplace_back(geo_p);
     }
+
+    // Copy the cluster's points into the object's array in one go
+    object.points.resize(cloud_cluster->size());
+    mil_tools::xyz_map(object.points) = cloud_cluster->getMatrixXfMap(3, sizeof(pcl::PointXYZI) / sizeof(float), 0);
     cloud_cluster->width = static_cast<uint32_t>(cloud_cluster->points.size());
     cloud_cluster->height = 1;
     cloud_cluster->is_dense = true;
@@ -296,6 +557,8 @@ mil_msgs::PerceptionObjectArray OGridGen::cluster(pcl::PointCloud<pcl::PointXYZI
     object.scale.z = maxPt.z - minPt.z;
     objects.objects.push_back(object);
 
+    if (!publish_markers)
+      continue;
     visualization_msgs::Marker marker;
     marker.header.frame_id = "map";
     marker.id = id++;
@@ -311,26 +574,73 @@ mil_msgs::PerceptionObjectArray OGridGen::cluster(pcl::PointCloud<pcl::PointXYZI
     markers.markers.push_back(marker);
   }
 
-  pub_markers_.publish(markers);
+  if (publish_markers)
+    pub_markers_.publish(markers);
   return objects;
 }
 
 bool OGridGen::clear_ogrid_callback(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
 {
-  persistant_ogrid_ = 0.5;
+  ogrid_tiles_.clear();
+  ogrid_clusters_.clear();
+  voxel_map_.clear();
   res.success = true;
   return true;
 }
 
 bool OGridGen::clear_pcl_callback(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
 {
+  std::lock_guard<std::mutex> lock(buffer_mutex_);
   point_cloud_buffer_.clear();
   res.success = true;
   return true;
 }
 
+mil_msgs::PerceptionObjectArray OGridGen::ogrid_objects()
+{
+  mil_msgs::PerceptionObjectArray objects;
+  for (OGridClusters::Cluster const &cluster : ogrid_clusters_.clusters(min_object_cells_, max_object_cells_))
+  {
+    mil_msgs::PerceptionObject object;
+    for (OGridClusters::Cell const &cell : cluster.cells)
+    {
+      // Add the center of each cell to object's array
+      geometry_msgs::Point32 geo_p;
+      geo_p.x = (cell.index.x + 0.5) * resolution_;
+      geo_p.y = (cell.index.y + 0.5) * resolution_;
+      geo_p.z = cell.z;
+      object.points.emplace_back(geo_p);
+    }
+
+    // Init object header
+    object.header.stamp = ros::Time::now();
+    object.header.frame_id = "map";
+    object.classification = "object";
+    object.labeled_classification = "unknown";
+    object.pose.position.x = (cluster.mean.x + 0.5) * resolution_;
+    object.pose.position.y = (cluster.mean.y + 0.5) * resolution_;
+    object.pose.position.z = (cluster.min_z + cluster.max_z) / 2;
+    object.pose.orientation.w = 1;
+    object.scale.x = (cluster.max.x - cluster.min.x + 1) * resolution_;
+    object.scale.y = (cluster.max.y - cluster.min.y + 1) * resolution_;
+    object.scale.z = cluster.max_z - cluster.min_z;
+    objects.objects.push_back(object);
+  }
+  return objects;
+}
+
 bool OGridGen::get_objects_callback(mil_msgs::ObjectDBQuery::Request &req, mil_msgs::ObjectDBQuery::Response &res)
 {
+  // The ogrid clusters are kept up to date with every ping, so only fall back to clustering the point cloud without it
+  if (params.ogrid)
+  {
+    res.objects = ogrid_objects().objects;
+    res.found = !res.objects.empty();
+    return res.found;
+  }
+  // pointCloud_ is only filled for subscribers, so may be stale
+  std::lock_guard<std::mutex> lock(pointcloud_mutex_);
+  fill_pointcloud();
   pcl::PointCloud<pcl::PointXYZI>::Ptr pointCloud_filtered = classification_.filtered(pointCloud_);
   if (pointCloud_filtered->size() < 1)
   {
@@ -342,10 +652,3 @@ bool OGridGen::get_objects_callback(mil_msgs::ObjectDBQuery::Request &req, mil_m
   res.objects = objects.objects;
   return true;
 }
-
-int main(int argc, char **argv)
-{
-  ros::init(argc, argv, "ogrid_pointcloud");
-  OGridGen oGridGen;
-  ros::spin();
-}
@@ -0,0 +1,16 @@
+#include "OGridGen.hpp"
+
+#include <ros/callback_queue.h>
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "ogrid_pointcloud");
+  ros::NodeHandle nh(ros::this_node::getName());
+  // Pings are handled on the main thread, the point cloud is published and clustered on a thread of its own
+  ros::CallbackQueue bulk_queue;
+  OGridGen oGridGen(nh, &bulk_queue);
+  ros::AsyncSpinner bulk_spinner(1, &bulk_queue);
+  bulk_spinner.start();
+  ros::spin();
+  bulk_spinner.stop();
+}
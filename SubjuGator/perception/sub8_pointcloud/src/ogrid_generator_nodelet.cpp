@@ -0,0 +1,26 @@
+#include "OGridGen.hpp"
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.hpp>
+
+#include <memory>
+
+namespace sub8_pointcloud
+{
+// OGridGen as a nodelet, with the same topics and params as ogrid_generator under the nodelet's name. Pings are
+// handled in order on the nodelet's queue, the point cloud on its multi-threaded one.
+class OGridGenNodelet : public nodelet::Nodelet
+{
+public:
+  virtual void onInit()
+  {
+    ogrid_gen_.reset(new OGridGen(getPrivateNodeHandle(), getMTPrivateNodeHandle().getCallbackQueue()));
+  }
+
+private:
+  std::unique_ptr<OGridGen> ogrid_gen_;
+};
+
+}  // namespace sub8_pointcloud
+
+PLUGINLIB_EXPORT_CLASS(sub8_pointcloud::OGridGenNodelet, nodelet::Nodelet);
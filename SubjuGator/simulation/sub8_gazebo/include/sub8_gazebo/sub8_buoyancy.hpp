@@ -19,6 +19,8 @@
 #define _GAZEBO_BUOYANCY_PLUGIN_HH_
 
 #include <map>
+#include <utility>
+#include <vector>
 #include "gazebo/common/Event.hh"
 #include "gazebo/common/Plugin.hh"
 #include "gazebo/physics/physics.hh"
@@ -109,6 +111,11 @@ protected:
   /// of volume) and volume of the link.
 protected:
   std::map<int, VolumeProperties> volPropsMap;
+
+  /// \brief Each link of the model with its volume properties, looked up
+  /// once in Init rather than on every update.
+protected:
+  std::vector<std::pair<physics::LinkPtr, VolumeProperties>> links;
 };
 }
 
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <ros/ros.h>
+#include <sub8_gazebo/sub8_thruster_config.hpp>
+
+#include <Eigen/Dense>
+#include <Eigen/Geometry>
+
+#include <vector>
+
+namespace sub8_gazebo
+{
+/*
+  6-DOF rigid body model of SubjuGator, with the same forces as the gazebo simulation: the sub8_thrusters
+  allocation and thruster response, mil_buoyancy_gazebo's buoyancy and mil_drag_gazebo's drag. Stepped at a fixed
+  time step, so controllers and trajectory generators can be run against it in process, far faster than real
+  time, without gazebo.
+
+  Positions and orientations are in the world frame (z up, the surface at z = 0), velocities and wrenches in the
+  body frame. The center of mass is at the body origin, as it is in sub8.urdf.
+*/
+class FastSim
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  typedef Eigen::Matrix<double, 6, 1> Vector6d;
+
+  struct Params
+  {
+    double mass = 47.6;
+    Eigen::Matrix3d inertia = (Eigen::Matrix3d() << 1.18, -0.003, 0.04, -0.003, 1.431, -0.034, 0.04, -0.034, 1.262)
+                                  .finished();
+    double volume = 0.04822;
+    double fluid_density = 997.0;
+    double gravity = 9.81;
+    /* Height of the sub, over which buoyancy falls off as it leaves the water */
+    double height = 0.59;
+    Eigen::Vector3d linear_drag = Eigen::Vector3d(250, 250, 250);
+    Eigen::Vector3d angular_drag = Eigen::Vector3d(100, 100, 100);
+    /* Thrust commands smaller than this are off, as in sub8_thrusters */
+    double min_abs_thrust = 2.2;
+    /* Seconds of each thruster's first order response, 0 for none */
+    double thruster_time_constant = 0.;
+    /* Seconds commands are applied for without another, as in sub8_thrusters */
+    double command_timeout = 2.;
+    double step = 1e-3;
+
+    /*
+      Reads the /robot_parameters the gazebo plugins use and the thruster layout, keeping the defaults for what is
+      not set
+    */
+    static Params from_params(ros::NodeHandle& private_nh, ThrusterAllocation& allocation);
+  };
+
+  struct State
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    Eigen::Vector3d position = Eigen::Vector3d::Zero();
+    Eigen::Quaterniond orientation = Eigen::Quaterniond::Identity();
+    Eigen::Vector3d linear = Eigen::Vector3d::Zero();
+    Eigen::Vector3d angular = Eigen::Vector3d::Zero();
+  };
+
+  FastSim(Params const& params, ThrusterAllocation const& allocation);
+
+  /* Thrust of each thruster in the allocation's order, as sent on thrusters/thrust */
+  void set_thrust(std::vector<double> const& thrust);
+  /* Wrench in the body frame, applied in place of thrusters, as the controller's wrench topic */
+  void set_wrench(Vector6d const& wrench);
+  void set_state(State const& state);
+
+  /* Advances one fixed step */
+  void step();
+  /* Advances until at least seconds more have been simulated */
+  void run(double seconds);
+
+  State const& state() const
+  {
+    return state_;
+  }
+  double time() const
+  {
+    return time_;
+  }
+  Params const& params() const
+  {
+    return params_;
+  }
+
+private:
+  Params params_;
+  ThrusterAllocation allocation_;
+  Eigen::Matrix3d inertia_inv_;
+  State state_;
+  double time_ = 0.;
+
+  /* Commanded and current thrust of each thruster, and the command's sim time */
+  std::vector<double> commands_;
+  std::vector<double> thrusts_;
+  double command_time_ = 0.;
+  bool use_wrench_ = false;
+  Vector6d wrench_ = Vector6d::Zero();
+  double wrench_time_ = 0.;
+};
+
+}  // namespace sub8_gazebo
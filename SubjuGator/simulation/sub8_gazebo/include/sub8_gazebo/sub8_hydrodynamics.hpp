@@ -0,0 +1,118 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "gazebo/common/Event.hh"
+#include "gazebo/common/Plugin.hh"
+#include "gazebo/common/UpdateInfo.hh"
+#include "gazebo/physics/physics.hh"
+
+namespace gazebo
+{
+/// \brief Buoyancy, added mass, damping and lift/drag of every link and surface of a model in one plugin.
+///
+/// In place of a BuoyancyPlugin and a LiftDragPlugin per blade, the properties of all links and surfaces are kept in
+/// arrays of each component, which every update gathers the links' states into, evaluates together in loops the
+/// compiler vectorizes, and scatters the forces back out of. Rotations are fetched once per link, not per surface,
+/// and surfaces are evaluated in their link's frame, where their directions are constant.
+///
+/// <plugin name="hydrodynamics" filename="libsub8_hydrodynamics.so">
+///   <fluid_density>1000</fluid_density>        kg/m^3, default 1000
+///   <fluid_level>0</fluid_level>               z of the surface, links above it are not buoyed, default 0
+///   <acceleration_smoothing>0.3</acceleration_smoothing>  weight of each new acceleration for added mass, default 0.3
+///   <link name="base_link">
+///     <volume>0.03</volume>                     m^3, default 0
+///     <center_of_volume>0 0 0.02</center_of_volume>  in the link frame, default 0 0 0
+///     <added_mass>10 20 20 1 1 1</added_mass>    diagonal of surge, sway, heave, roll, pitch, yaw, default 0
+///     <linear_damping>5 5 5 1 1 1</linear_damping>
+///     <quadratic_damping>20 40 40 2 2 2</quadratic_damping>
+///   </link>
+///   <surface link="fin">                        as LiftDragPlugin, with the fluid density for air_density
+///     <cp/> <forward/> <upward/> <area/> <a0/> <cla/> <cda/> <alpha_stall/> <cla_stall/> <cda_stall/>
+///   </surface>
+/// </plugin>
+///
+/// Added mass and damping act in the link frame about its center of mass, with the added mass Coriolis and
+/// centripetal terms of a diagonal added mass matrix.
+class HydrodynamicsPlugin : public ModelPlugin
+{
+public:
+  HydrodynamicsPlugin();
+  virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
+  virtual void Init();
+
+protected:
+  virtual void OnUpdate(const common::UpdateInfo &info);
+
+  /// Reads a link element, returning false if it is not usable
+  bool LoadLink(sdf::ElementPtr _elem);
+  /// Reads a surface element, returning false if it is not usable
+  bool LoadSurface(sdf::ElementPtr _elem);
+  /// Index of link in links, adding it with no volume, added mass or damping if it is not there
+  size_t LinkIndex(physics::LinkPtr link);
+
+  /// Forces, in the link frame, of buoyancy, added mass and damping
+  void EvaluateLinks(double dt);
+  /// Forces, in the link frame, of lift and drag on each surface
+  void EvaluateSurfaces();
+
+  event::ConnectionPtr updateConnection;
+  physics::ModelPtr model;
+  ignition::math::Vector3d gravity;
+  double fluidDensity;
+  double fluidLevel;
+  double accelerationSmoothing;
+  common::Time lastTime;
+  bool hasLastTime;
+
+  /// \brief Properties and state of each link, one element per link in each array
+  struct Links
+  {
+    std::vector<physics::LinkPtr> link;
+    std::vector<double> volume;
+    std::vector<double> covX, covY, covZ;
+    /// Diagonals of the added mass, linear and quadratic damping, 6 per link
+    std::vector<double> addedMass, linearDamping, quadraticDamping;
+
+    /// Gathered each update
+    std::vector<double> depth;  // below the fluid level, or negative above it
+    std::vector<double> rotW, rotX, rotY, rotZ;
+    /// Body frame linear and angular velocity, 6 per link, this update's and last update's
+    std::vector<double> vel, lastVel;
+    /// Smoothed body frame acceleration, 6 per link
+    std::vector<double> accel;
+
+    /// Evaluated each update, 6 per link: force and torque about the center of mass, in the link frame
+    std::vector<double> wrench;
+    /// Buoyancy, applied at the center of volume, in the link frame
+    std::vector<double> buoyX, buoyY, buoyZ;
+
+    size_t size() const
+    {
+      return link.size();
+    }
+  } links;
+
+  /// \brief Lift/drag surfaces, one element per surface in each array, all vectors in the link frame
+  struct Surfaces
+  {
+    std::vector<size_t> link;
+    std::vector<double> cpX, cpY, cpZ;
+    std::vector<double> fwdX, fwdY, fwdZ;
+    std::vector<double> upX, upY, upZ;
+    /// Normal to the lift/drag plane, forward x upward normalized
+    std::vector<double> nX, nY, nZ;
+    std::vector<double> area, alpha0, cla, cda, alphaStall, claStall, cdaStall;
+
+    /// Gathered each update: velocity of the center of pressure in the link frame
+    std::vector<double> velX, velY, velZ;
+    /// Evaluated each update: lift plus drag in the link frame
+    std::vector<double> forceX, forceY, forceZ;
+
+    size_t size() const
+    {
+      return link.size();
+    }
+  } surfaces;
+};
+}
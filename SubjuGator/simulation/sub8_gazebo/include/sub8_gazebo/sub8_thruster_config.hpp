@@ -46,4 +46,50 @@ void load_ports(XmlRpc::XmlRpcValue& ports_xmlrpc, std::vector<ThrusterPort>& po
 */
 void load_thrusters(XmlRpc::XmlRpcValue& thrusters_xmlrpc, std::map<std::string, ThrusterDef>& thruster_map);
 
+/*
+  Thruster allocation matrix: maps the thrust of each thruster to the wrench they exert together on the body, about
+  its origin, in one matrix multiply. Built once from the thruster definitions, so it can be shared by the simulation
+  and anything else needing the sub's allocation model.
+*/
+class ThrusterAllocation
+{
+public:
+  ThrusterAllocation() = default;
+  explicit ThrusterAllocation(const std::map<std::string, ThrusterDef>& thrusters);
+
+  size_t size() const
+  {
+    return names_.size();
+  }
+  const std::vector<std::string>& names() const
+  {
+    return names_;
+  }
+  /* Index of the named thruster, or -1 if there is none */
+  int index(const std::string& name) const;
+
+  /* Clamps each thrust to its thruster's bounds */
+  void saturate(std::vector<double>& thrusts) const;
+
+  /*
+    Wrench of thrusts, which has one entry per thruster, in order of names()
+    params:
+    - wrench: force x, y, z then torque x, y, z about the body origin
+  */
+  void wrench(const std::vector<double>& thrusts, double wrench[6]) const;
+
+  /* 6 x size() matrix, column major: each column is the wrench of one unit of a thruster's thrust */
+  const std::vector<double>& matrix() const
+  {
+    return matrix_;
+  }
+
+private:
+  std::vector<std::string> names_;
+  std::map<std::string, int> indices_;
+  std::vector<double> matrix_;
+  std::vector<double> min_;
+  std::vector<double> max_;
+};
+
 }  // sub8_gazebo
@@ -17,26 +17,12 @@
 
 namespace gazebo
 {
-struct Thruster
-{
-  Thruster()
-  {
-    min = 0;
-    max = 0;
-  }
-  Thruster(sub8_gazebo::ThrusterDef td)
-  {
-    position = ignition::math::Vector3d(td.position[0], td.position[1], td.position[2]);
-    direction = ignition::math::Vector3d(td.direction[0], td.direction[1], td.direction[2]);
-    min = td.bounds[0];
-    max = td.bounds[1];
-  }
-  ignition::math::Vector3d position;
-  ignition::math::Vector3d direction;
-  double min;
-  double max;
-};
-
+/// Applies the last thrusters/thrust command until 2 seconds of sim time pass without another. Everything is timed
+/// in sim time from the world updates, so the plugin behaves the same at any real time factor.
+///
+/// Commands are saturated to each thruster's bounds, then every thruster follows its command with first order
+/// dynamics of <time_constant> seconds (0, the default, for none), and the thrusts are mapped to one wrench on the
+/// link through the allocation matrix built from the layout at Load.
 class ThrusterPlugin : public ModelPlugin
 {
 public:
@@ -46,10 +32,9 @@ public:
   void ThrustCallback(const sub8_msgs::Thrust::ConstPtr &thrust);
 
 protected:
-  // virtual void OnUpdate();
   ros::NodeHandle nh;
   ros::Subscriber thrustSub;
-  virtual void OnUpdate();
+  virtual void OnUpdate(const common::UpdateInfo &info);
 
 protected:
   std::mutex mtx;
@@ -59,9 +44,19 @@ protected:
   sdf::ElementPtr sdf;
   std::string layoutParam;
   double minAbsThrust;
-  std::map<std::string, Thruster> thrusterMap;
+  double timeConstant = 0.;
+  sub8_gazebo::ThrusterAllocation allocation;
   physics::LinkPtr targetLink;
-  ros::Time lastTime;
-  std::vector<sub8_msgs::ThrusterCmd> cmdQueue;
+  /// Sim time of the last update, which stamps commands as they arrive
+  common::Time simTime;
+  /// Sim time the commands being applied arrived
+  common::Time lastTime;
+  /// Set by ThrustCallback, taken by OnUpdate
+  bool newCommands = false;
+  /// Commanded thrust of each thruster, in the allocation's order
+  std::vector<double> cmdQueue;
+  std::vector<double> commands;
+  /// Thrust each thruster is exerting, following commands
+  std::vector<double> thrusts;
 };
 }
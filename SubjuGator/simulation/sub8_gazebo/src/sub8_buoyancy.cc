@@ -143,17 +143,23 @@ void BuoyancyPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
 /////////////////////////////////////////////////
 void BuoyancyPlugin::Init()
 {
+  for (auto link : this->model->GetLinks())
+  {
+    VolumeProperties volumeProperties = this->volPropsMap[link->GetId()];
+    GZ_ASSERT(volumeProperties.volume > 0, "Nonpositive volume found in volume properties!");
+    this->links.push_back(std::make_pair(link, volumeProperties));
+  }
   this->updateConnection = event::Events::ConnectWorldUpdateBegin(std::bind(&BuoyancyPlugin::OnUpdate, this));
 }
 
 /////////////////////////////////////////////////
 void BuoyancyPlugin::OnUpdate()
 {
-  for (auto link : this->model->GetLinks())
+  for (const auto &linkProperties : this->links)
   {
-    VolumeProperties volumeProperties = this->volPropsMap[link->GetId()];
+    const physics::LinkPtr &link = linkProperties.first;
+    const VolumeProperties &volumeProperties = linkProperties.second;
     double volume = volumeProperties.volume;
-    GZ_ASSERT(volume > 0, "Nonpositive volume found in volume properties!");
 
     // By Archimedes' principle,
     // buoyancy = -(mass*gravity)*fluid_density/object_density
@@ -165,15 +171,11 @@ void BuoyancyPlugin::OnUpdate()
     // rotate buoyancy into the link frame before applying the force.
     ignition::math::Vector3d buoyancyLinkFrame = linkFrame.Rot().Inverse().RotateVector(buoyancy);
 
-    // Simple water resistance model
-    ignition::math::Vector3d bodyVelocity = link->WorldLinearVel();
-    ignition::math::Vector3d bodyAngVelocity = link->WorldAngularVel();
+    // Simple water resistance model, disabled, so not computed every update
+    // ignition::math::Vector3d bodyVelocity = link->WorldLinearVel();
     // drag_coeff * v**2
-    ignition::math::Vector3d linearResistance = -this->dragCoeff * bodyVelocity * bodyVelocity.Length();
-    ignition::math::Vector3d angularResistance = -this->dragCoeff * bodyVelocity * bodyVelocity.Length();
-
+    // ignition::math::Vector3d linearResistance = -this->dragCoeff * bodyVelocity * bodyVelocity.Length();
     // link->AddForce(linearResistance, volumeProperties.cov);
-    // link->AddTorque(angularResistance, volumeProperties.cov);
 
     if (linkFrame.Pos().Z() < 0.0)
     {
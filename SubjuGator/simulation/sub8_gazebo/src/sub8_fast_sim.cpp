@@ -0,0 +1,137 @@
+#include <sub8_gazebo/sub8_fast_sim.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace sub8_gazebo
+{
+namespace
+{
+void get_vector(ros::NodeHandle& nh, std::string const& name, Eigen::Vector3d& out)
+{
+  std::vector<double> values;
+  if (nh.getParam(name, values) && values.size() == 3)
+    out = Eigen::Vector3d(values[0], values[1], values[2]);
+}
+}  // namespace
+
+FastSim::Params FastSim::Params::from_params(ros::NodeHandle& private_nh, ThrusterAllocation& allocation)
+{
+  Params params;
+  ros::NodeHandle nh;
+  // Shared with the gazebo plugins, see sub8_launch upload_urdf.launch
+  nh.param("/robot_parameters/volume", params.volume, params.volume);
+  nh.param("/robot_parameters/fluid_density", params.fluid_density, params.fluid_density);
+  nh.param("/robot_parameters/height", params.height, params.height);
+  nh.param("/robot_parameters/G", params.gravity, params.gravity);
+  get_vector(nh, "/robot_parameters/drag/linear_coeffs", params.linear_drag);
+  get_vector(nh, "/robot_parameters/drag/angular_coeffs", params.angular_drag);
+
+  private_nh.param("mass", params.mass, params.mass);
+  private_nh.param("min_abs_thrust", params.min_abs_thrust, params.min_abs_thrust);
+  private_nh.param("thruster_time_constant", params.thruster_time_constant, params.thruster_time_constant);
+  private_nh.param("command_timeout", params.command_timeout, params.command_timeout);
+  private_nh.param("step", params.step, params.step);
+
+  std::string layout_param = private_nh.param<std::string>("layout_param", "/thruster_layout");
+  XmlRpc::XmlRpcValue layout;
+  std::map<std::string, ThrusterDef> thrusters;
+  if (nh.getParam(layout_param, layout) && layout.hasMember("thrusters"))
+    load_thrusters(layout["thrusters"], thrusters);
+  else
+    ROS_WARN("No thruster layout on %s, only wrenches can be applied", layout_param.c_str());
+  allocation = ThrusterAllocation(thrusters);
+  return params;
+}
+
+FastSim::FastSim(Params const& params, ThrusterAllocation const& allocation)
+  : params_(params)
+  , allocation_(allocation)
+  , inertia_inv_(params.inertia.inverse())
+  , commands_(allocation.size(), 0.)
+  , thrusts_(allocation.size(), 0.)
+{
+}
+
+void FastSim::set_thrust(std::vector<double> const& thrust)
+{
+  commands_.assign(allocation_.size(), 0.);
+  for (size_t i = 0; i < thrust.size() && i < commands_.size(); ++i)
+    if (std::abs(thrust[i]) >= params_.min_abs_thrust)
+      commands_[i] = thrust[i];
+  allocation_.saturate(commands_);
+  command_time_ = time_;
+  use_wrench_ = false;
+}
+
+void FastSim::set_wrench(Vector6d const& wrench)
+{
+  wrench_ = wrench;
+  wrench_time_ = time_;
+  use_wrench_ = true;
+}
+
+void FastSim::set_state(State const& state)
+{
+  state_ = state;
+  state_.orientation.normalize();
+}
+
+void FastSim::step()
+{
+  const double dt = params_.step;
+
+  // Body frame wrench of the thrusters, or the one applied directly, off once commands time out
+  Vector6d wrench;
+  if (use_wrench_)
+  {
+    wrench = time_ - wrench_time_ > params_.command_timeout ? Vector6d::Zero() : wrench_;
+  }
+  else
+  {
+    if (time_ - command_time_ > params_.command_timeout)
+      std::fill(commands_.begin(), commands_.end(), 0.);
+    const double gain = params_.thruster_time_constant > 0 ? 1. - std::exp(-dt / params_.thruster_time_constant) : 1.;
+    for (size_t i = 0; i < thrusts_.size(); ++i)
+      thrusts_[i] += gain * (commands_[i] - thrusts_[i]);
+    allocation_.wrench(thrusts_, wrench.data());
+  }
+
+  const Eigen::Matrix3d world_from_body = state_.orientation.toRotationMatrix();
+  Eigen::Vector3d force = wrench.head<3>();
+  Eigen::Vector3d torque = wrench.tail<3>();
+
+  // Gravity and buoyancy, the displaced volume shrinking as the sub leaves the water, as in mil_buoyancy_gazebo
+  double submerged = std::max(0., std::min(1., (params_.height / 2 - state_.position.z()) / params_.height));
+  double weight = params_.gravity * (params_.fluid_density * params_.volume * submerged - params_.mass);
+  force += world_from_body.transpose() * Eigen::Vector3d(0, 0, weight);
+
+  // Drag as in mil_drag_gazebo
+  force -= params_.linear_drag.cwiseProduct(state_.linear);
+  torque -= params_.angular_drag.cwiseProduct(state_.angular);
+
+  // Newton-Euler in the body frame, integrated semi-implicitly
+  const Eigen::Vector3d& w = state_.angular;
+  Eigen::Vector3d linear_accel = force / params_.mass - w.cross(state_.linear);
+  Eigen::Vector3d angular_accel = inertia_inv_ * (torque - w.cross(params_.inertia * w));
+  state_.linear += linear_accel * dt;
+  state_.angular += angular_accel * dt;
+
+  state_.position += world_from_body * state_.linear * dt;
+  double angle = state_.angular.norm() * dt;
+  if (angle > 0)
+  {
+    state_.orientation = state_.orientation * Eigen::Quaterniond(Eigen::AngleAxisd(angle, state_.angular.normalized()));
+    state_.orientation.normalize();
+  }
+  time_ += dt;
+}
+
+void FastSim::run(double seconds)
+{
+  const double end = time_ + seconds - params_.step / 2;
+  while (time_ < end)
+    step();
+}
+
+}  // namespace sub8_gazebo
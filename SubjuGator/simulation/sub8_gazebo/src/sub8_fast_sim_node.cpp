@@ -0,0 +1,140 @@
+#include <sub8_gazebo/sub8_fast_sim.hpp>
+
+#include <geometry_msgs/WrenchStamped.h>
+#include <nav_msgs/Odometry.h>
+#include <rosgraph_msgs/Clock.h>
+#include <sub8_msgs/Thrust.h>
+
+/*
+  Runs sub8_gazebo::FastSim as a stand in for gazebo, for testing the controller and trajectory generator:
+  subscribes to thrusters/thrust like sub8_thrusters, or to wrench like the dynamics_simulator, and publishes the
+  true state on odom, and sim time on /clock.
+
+  Private params:
+    rtf: real time factor to run at, 0 for as fast as it can (1)
+    odom_rate: Hz of sim time odom and /clock are published at (100)
+    and those of FastSim::Params::from_params
+*/
+namespace
+{
+class FastSimNode
+{
+public:
+  FastSimNode() : private_nh_("~")
+  {
+    sub8_gazebo::ThrusterAllocation allocation;
+    sub8_gazebo::FastSim::Params params = sub8_gazebo::FastSim::Params::from_params(private_nh_, allocation);
+    sim_.reset(new sub8_gazebo::FastSim(params, allocation));
+    allocation_ = allocation;
+    thrust_.resize(allocation.size());
+
+    sub8_gazebo::FastSim::State state;
+    std::vector<double> position;
+    if (private_nh_.getParam("initial_position", position) && position.size() == 3)
+      state.position = Eigen::Vector3d(position[0], position[1], position[2]);
+    sim_->set_state(state);
+
+    private_nh_.param("rtf", rtf_, 1.);
+    double odom_rate = private_nh_.param("odom_rate", 100.);
+    period_ = 1. / odom_rate;
+
+    odom_.header.frame_id = "/map";
+    odom_.child_frame_id = "base_link";
+    odom_pub_ = nh_.advertise<nav_msgs::Odometry>("odom", 10);
+    clock_pub_ = nh_.advertise<rosgraph_msgs::Clock>("/clock", 10);
+    thrust_sub_ = nh_.subscribe("thrusters/thrust", 10, &FastSimNode::thrust_cb, this);
+    wrench_sub_ = nh_.subscribe("wrench", 10, &FastSimNode::wrench_cb, this);
+  }
+
+  void run()
+  {
+    ros::WallTime next = ros::WallTime::now();
+    while (ros::ok())
+    {
+      ros::spinOnce();
+      sim_->run(period_);
+      publish();
+      if (rtf_ > 0)
+      {
+        next += ros::WallDuration(period_ / rtf_);
+        ros::WallTime now = ros::WallTime::now();
+        if (next > now)
+          (next - now).sleep();
+        else
+          next = now;  // behind, so do not try to catch up
+      }
+    }
+  }
+
+private:
+  void thrust_cb(sub8_msgs::Thrust const& msg)
+  {
+    std::fill(thrust_.begin(), thrust_.end(), 0.);
+    for (auto const& cmd : msg.thruster_commands)
+    {
+      int index = allocation_.index(cmd.name);
+      if (index < 0)
+      {
+        ROS_WARN_THROTTLE(1.0, "Thrust command for unknown thruster %s", cmd.name.c_str());
+        continue;
+      }
+      thrust_[index] = cmd.thrust;
+    }
+    sim_->set_thrust(thrust_);
+  }
+
+  void wrench_cb(geometry_msgs::WrenchStamped const& msg)
+  {
+    sub8_gazebo::FastSim::Vector6d wrench;
+    wrench << msg.wrench.force.x, msg.wrench.force.y, msg.wrench.force.z, msg.wrench.torque.x, msg.wrench.torque.y,
+        msg.wrench.torque.z;
+    sim_->set_wrench(wrench);
+  }
+
+  void publish()
+  {
+    ros::Time stamp(sim_->time());
+    rosgraph_msgs::Clock clock;
+    clock.clock = stamp;
+    clock_pub_.publish(clock);
+
+    sub8_gazebo::FastSim::State const& state = sim_->state();
+    odom_.header.stamp = stamp;
+    odom_.pose.pose.position.x = state.position.x();
+    odom_.pose.pose.position.y = state.position.y();
+    odom_.pose.pose.position.z = state.position.z();
+    odom_.pose.pose.orientation.x = state.orientation.x();
+    odom_.pose.pose.orientation.y = state.orientation.y();
+    odom_.pose.pose.orientation.z = state.orientation.z();
+    odom_.pose.pose.orientation.w = state.orientation.w();
+    odom_.twist.twist.linear.x = state.linear.x();
+    odom_.twist.twist.linear.y = state.linear.y();
+    odom_.twist.twist.linear.z = state.linear.z();
+    odom_.twist.twist.angular.x = state.angular.x();
+    odom_.twist.twist.angular.y = state.angular.y();
+    odom_.twist.twist.angular.z = state.angular.z();
+    odom_pub_.publish(odom_);
+  }
+
+  ros::NodeHandle nh_;
+  ros::NodeHandle private_nh_;
+  std::unique_ptr<sub8_gazebo::FastSim> sim_;
+  sub8_gazebo::ThrusterAllocation allocation_;
+  std::vector<double> thrust_;
+  double rtf_;
+  double period_;
+  nav_msgs::Odometry odom_;
+  ros::Publisher odom_pub_;
+  ros::Publisher clock_pub_;
+  ros::Subscriber thrust_sub_;
+  ros::Subscriber wrench_sub_;
+};
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "sub8_fast_sim");
+  FastSimNode node;
+  node.run();
+  return 0;
+}
@@ -0,0 +1,405 @@
+#include "sub8_gazebo/sub8_hydrodynamics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <string>
+#include "gazebo/common/Assert.hh"
+#include "gazebo/common/Events.hh"
+
+namespace gazebo
+{
+GZ_REGISTER_MODEL_PLUGIN(HydrodynamicsPlugin)
+
+namespace
+{
+/// Reads six space separated doubles from elem's child tag into out, leaving it unchanged if the tag is missing
+bool GetSix(sdf::ElementPtr elem, const std::string &tag, double *out)
+{
+  if (!elem->HasElement(tag))
+    return true;
+  std::istringstream stream(elem->GetElement(tag)->Get<std::string>());
+  double values[6];
+  for (double &value : values)
+    if (!(stream >> value))
+      return false;
+  std::copy(values, values + 6, out);
+  return true;
+}
+
+/// Rotates v by the inverse of the unit quaternion (w, x, y, z): v + 2w(v x r) + 2 r x (r x v) for r = (x, y, z)
+inline void InverseRotate(double w, double x, double y, double z, double &vx, double &vy, double &vz)
+{
+  // t = 2 (v x r), the inverse rotation negating r
+  double tx = 2 * (vy * z - vz * y);
+  double ty = 2 * (vz * x - vx * z);
+  double tz = 2 * (vx * y - vy * x);
+  double rx = vx + w * tx - (y * tz - z * ty);
+  double ry = vy + w * ty - (z * tx - x * tz);
+  double rz = vz + w * tz - (x * ty - y * tx);
+  vx = rx;
+  vy = ry;
+  vz = rz;
+}
+}  // namespace
+
+HydrodynamicsPlugin::HydrodynamicsPlugin()
+  : fluidDensity(1000.0), fluidLevel(0.0), accelerationSmoothing(0.3), hasLastTime(false)
+{
+}
+
+void HydrodynamicsPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
+{
+  GZ_ASSERT(_model != NULL, "Received NULL model pointer");
+  GZ_ASSERT(_sdf != NULL, "Received NULL SDF pointer");
+  this->model = _model;
+  physics::WorldPtr world = _model->GetWorld();
+  GZ_ASSERT(world != NULL, "Model is in a NULL world");
+  this->gravity = world->Gravity();
+
+  if (_sdf->HasElement("fluid_density"))
+    this->fluidDensity = _sdf->Get<double>("fluid_density");
+  if (_sdf->HasElement("fluid_level"))
+    this->fluidLevel = _sdf->Get<double>("fluid_level");
+  if (_sdf->HasElement("acceleration_smoothing"))
+    this->accelerationSmoothing = std::min(1.0, std::max(0.0, _sdf->Get<double>("acceleration_smoothing")));
+
+  if (_sdf->HasElement("link"))
+    for (sdf::ElementPtr elem = _sdf->GetElement("link"); elem; elem = elem->GetNextElement("link"))
+      LoadLink(elem);
+  if (_sdf->HasElement("surface"))
+    for (sdf::ElementPtr elem = _sdf->GetElement("surface"); elem; elem = elem->GetNextElement("surface"))
+      LoadSurface(elem);
+
+  size_t n = this->links.size();
+  this->links.depth.resize(n);
+  this->links.rotW.resize(n);
+  this->links.rotX.resize(n);
+  this->links.rotY.resize(n);
+  this->links.rotZ.resize(n);
+  this->links.vel.resize(6 * n);
+  this->links.lastVel.resize(6 * n);
+  this->links.accel.assign(6 * n, 0.0);
+  this->links.wrench.resize(6 * n);
+  this->links.buoyX.resize(n);
+  this->links.buoyY.resize(n);
+  this->links.buoyZ.resize(n);
+
+  size_t m = this->surfaces.size();
+  this->surfaces.velX.resize(m);
+  this->surfaces.velY.resize(m);
+  this->surfaces.velZ.resize(m);
+  this->surfaces.forceX.resize(m);
+  this->surfaces.forceY.resize(m);
+  this->surfaces.forceZ.resize(m);
+
+  gzmsg << "HydrodynamicsPlugin: " << n << " links, " << m << " lift/drag surfaces" << std::endl;
+}
+
+size_t HydrodynamicsPlugin::LinkIndex(physics::LinkPtr link)
+{
+  Links &l = this->links;
+  auto it = std::find(l.link.begin(), l.link.end(), link);
+  if (it != l.link.end())
+    return it - l.link.begin();
+  l.link.push_back(link);
+  l.volume.push_back(0.0);
+  l.covX.push_back(0.0);
+  l.covY.push_back(0.0);
+  l.covZ.push_back(0.0);
+  l.addedMass.resize(l.addedMass.size() + 6, 0.0);
+  l.linearDamping.resize(l.linearDamping.size() + 6, 0.0);
+  l.quadraticDamping.resize(l.quadraticDamping.size() + 6, 0.0);
+  return l.size() - 1;
+}
+
+bool HydrodynamicsPlugin::LoadLink(sdf::ElementPtr _elem)
+{
+  std::string name = _elem->HasAttribute("name") ? _elem->Get<std::string>("name") : "";
+  physics::LinkPtr link = this->model->GetLink(name);
+  if (!link)
+  {
+    gzwarn << "HydrodynamicsPlugin link [" << name << "] not found." << std::endl;
+    return false;
+  }
+  size_t i = LinkIndex(link);
+  Links &l = this->links;
+
+  if (_elem->HasElement("volume"))
+  {
+    double volume = _elem->Get<double>("volume");
+    if (volume < 0)
+      gzwarn << "Negative volume for link [" << name << "] in HydrodynamicsPlugin, ignoring it" << std::endl;
+    else
+      l.volume[i] = volume;
+  }
+  if (_elem->HasElement("center_of_volume"))
+  {
+    ignition::math::Vector3d cov = _elem->Get<ignition::math::Vector3d>("center_of_volume");
+    l.covX[i] = cov.X();
+    l.covY[i] = cov.Y();
+    l.covZ[i] = cov.Z();
+  }
+  if (!GetSix(_elem, "added_mass", &l.addedMass[6 * i]) ||
+      !GetSix(_elem, "linear_damping", &l.linearDamping[6 * i]) ||
+      !GetSix(_elem, "quadratic_damping", &l.quadraticDamping[6 * i]))
+  {
+    gzwarn << "HydrodynamicsPlugin link [" << name << "] needs 6 values for each of added_mass, linear_damping "
+           << "and quadratic_damping" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool HydrodynamicsPlugin::LoadSurface(sdf::ElementPtr _elem)
+{
+  std::string name = _elem->HasAttribute("link") ? _elem->Get<std::string>("link") : "";
+  physics::LinkPtr link = this->model->GetLink(name);
+  if (!link)
+  {
+    gzwarn << "HydrodynamicsPlugin surface link [" << name << "] not found." << std::endl;
+    return false;
+  }
+
+  // Defaults as LiftDragPlugin
+  auto get = [&_elem](const std::string &tag, double def) {
+    return _elem->HasElement(tag) ? _elem->Get<double>(tag) : def;
+  };
+  auto getVector = [&_elem](const std::string &tag, const ignition::math::Vector3d &def) {
+    return _elem->HasElement(tag) ? _elem->Get<ignition::math::Vector3d>(tag) : def;
+  };
+  ignition::math::Vector3d cp = getVector("cp", ignition::math::Vector3d(0, 0, 0));
+  ignition::math::Vector3d forward = getVector("forward", ignition::math::Vector3d(1, 0, 0));
+  ignition::math::Vector3d upward = getVector("upward", ignition::math::Vector3d(0, 0, 1));
+  ignition::math::Vector3d normal = forward.Cross(upward);
+  if (forward.Length() == 0 || upward.Length() == 0 || normal.Length() == 0)
+  {
+    gzwarn << "HydrodynamicsPlugin surface on [" << name << "] needs forward and upward not parallel" << std::endl;
+    return false;
+  }
+  normal.Normalize();
+  forward.Normalize();
+  upward.Normalize();
+
+  Surfaces &s = this->surfaces;
+  s.link.push_back(LinkIndex(link));
+  s.cpX.push_back(cp.X());
+  s.cpY.push_back(cp.Y());
+  s.cpZ.push_back(cp.Z());
+  s.fwdX.push_back(forward.X());
+  s.fwdY.push_back(forward.Y());
+  s.fwdZ.push_back(forward.Z());
+  s.upX.push_back(upward.X());
+  s.upY.push_back(upward.Y());
+  s.upZ.push_back(upward.Z());
+  s.nX.push_back(normal.X());
+  s.nY.push_back(normal.Y());
+  s.nZ.push_back(normal.Z());
+  s.area.push_back(get("area", 1.0));
+  s.alpha0.push_back(get("a0", 0.0));
+  s.cla.push_back(get("cla", 1.0));
+  s.cda.push_back(get("cda", 0.01));
+  s.alphaStall.push_back(get("alpha_stall", 0.5 * M_PI));
+  s.claStall.push_back(get("cla_stall", 0.0));
+  s.cdaStall.push_back(get("cda_stall", 1.0));
+  return true;
+}
+
+void HydrodynamicsPlugin::Init()
+{
+  this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+      std::bind(&HydrodynamicsPlugin::OnUpdate, this, std::placeholders::_1));
+}
+
+void HydrodynamicsPlugin::OnUpdate(const common::UpdateInfo &info)
+{
+  Links &l = this->links;
+  Surfaces &s = this->surfaces;
+  const size_t n = l.size();
+  const size_t m = s.size();
+
+  // A reset world goes back in time, so its first step has no acceleration
+  double dt = 0;
+  if (this->hasLastTime && info.simTime > this->lastTime)
+    dt = (info.simTime - this->lastTime).Double();
+  this->lastTime = info.simTime;
+  this->hasLastTime = true;
+
+  // Gather the state of each link once
+  std::swap(l.vel, l.lastVel);
+  for (size_t i = 0; i < n; ++i)
+  {
+    const physics::LinkPtr &link = l.link[i];
+    ignition::math::Pose3d pose = link->WorldPose();
+    l.depth[i] = this->fluidLevel - pose.Pos().Z();
+    l.rotW[i] = pose.Rot().W();
+    l.rotX[i] = pose.Rot().X();
+    l.rotY[i] = pose.Rot().Y();
+    l.rotZ[i] = pose.Rot().Z();
+    ignition::math::Vector3d linear = link->RelativeLinearVel();
+    ignition::math::Vector3d angular = link->RelativeAngularVel();
+    double *vel = &l.vel[6 * i];
+    vel[0] = linear.X();
+    vel[1] = linear.Y();
+    vel[2] = linear.Z();
+    vel[3] = angular.X();
+    vel[4] = angular.Y();
+    vel[5] = angular.Z();
+  }
+  for (size_t j = 0; j < m; ++j)
+  {
+    ignition::math::Vector3d vel =
+        l.link[s.link[j]]->WorldLinearVel(ignition::math::Vector3d(s.cpX[j], s.cpY[j], s.cpZ[j]));
+    s.velX[j] = vel.X();
+    s.velY[j] = vel.Y();
+    s.velZ[j] = vel.Z();
+  }
+
+  EvaluateLinks(dt);
+  EvaluateSurfaces();
+
+  // Scatter the forces back to the links
+  for (size_t i = 0; i < n; ++i)
+  {
+    const physics::LinkPtr &link = l.link[i];
+    const double *wrench = &l.wrench[6 * i];
+    if (l.depth[i] > 0 && l.volume[i] > 0)
+      link->AddLinkForce(ignition::math::Vector3d(l.buoyX[i], l.buoyY[i], l.buoyZ[i]),
+                         ignition::math::Vector3d(l.covX[i], l.covY[i], l.covZ[i]));
+    link->AddRelativeForce(ignition::math::Vector3d(wrench[0], wrench[1], wrench[2]));
+    link->AddRelativeTorque(ignition::math::Vector3d(wrench[3], wrench[4], wrench[5]));
+  }
+  for (size_t j = 0; j < m; ++j)
+    l.link[s.link[j]]->AddLinkForce(ignition::math::Vector3d(s.forceX[j], s.forceY[j], s.forceZ[j]),
+                                    ignition::math::Vector3d(s.cpX[j], s.cpY[j], s.cpZ[j]));
+}
+
+void HydrodynamicsPlugin::EvaluateLinks(double dt)
+{
+  Links &l = this->links;
+  const size_t n = l.size();
+
+  // Buoyancy by Archimedes' principle, rotated into the link frame
+  const double gx = this->gravity.X(), gy = this->gravity.Y(), gz = this->gravity.Z();
+  const double rho = this->fluidDensity;
+  for (size_t i = 0; i < n; ++i)
+  {
+    double fx = -rho * l.volume[i] * gx;
+    double fy = -rho * l.volume[i] * gy;
+    double fz = -rho * l.volume[i] * gz;
+    InverseRotate(l.rotW[i], l.rotX[i], l.rotY[i], l.rotZ[i], fx, fy, fz);
+    l.buoyX[i] = fx;
+    l.buoyY[i] = fy;
+    l.buoyZ[i] = fz;
+  }
+
+  // Body frame acceleration by differencing velocities, smoothed as added mass feeds it back into the forces
+  const double *__restrict__ vel = l.vel.data();
+  const double *__restrict__ lastVel = l.lastVel.data();
+  double *__restrict__ accel = l.accel.data();
+  if (dt > 0)
+  {
+    const double a = this->accelerationSmoothing;
+    const double invDt = 1.0 / dt;
+    for (size_t k = 0; k < 6 * n; ++k)
+      accel[k] = a * (vel[k] - lastVel[k]) * invDt + (1 - a) * accel[k];
+  }
+
+  // Damping and the added mass inertia, component by component: -(D_l + D_q |v|) v - M_A dv/dt
+  const double *__restrict__ ma = l.addedMass.data();
+  const double *__restrict__ dl = l.linearDamping.data();
+  const double *__restrict__ dq = l.quadraticDamping.data();
+  double *__restrict__ wrench = l.wrench.data();
+  for (size_t k = 0; k < 6 * n; ++k)
+    wrench[k] = -(dl[k] + dq[k] * std::abs(vel[k])) * vel[k] - ma[k] * accel[k];
+
+  // Added mass Coriolis and centripetal terms, -C_A(v) v for diagonal M_A, with p = M_A v split into linear pl and
+  // angular pa: pl x w on the force and pl x v + pa x w on the torque
+  for (size_t i = 0; i < n; ++i)
+  {
+    const double *v = &vel[6 * i];
+    const double *a = &ma[6 * i];
+    double *w = &wrench[6 * i];
+    double plx = a[0] * v[0], ply = a[1] * v[1], plz = a[2] * v[2];
+    double pax = a[3] * v[3], pay = a[4] * v[4], paz = a[5] * v[5];
+    w[0] += ply * v[5] - plz * v[4];
+    w[1] += plz * v[3] - plx * v[5];
+    w[2] += plx * v[4] - ply * v[3];
+    w[3] += ply * v[2] - plz * v[1] + pay * v[5] - paz * v[4];
+    w[4] += plz * v[0] - plx * v[2] + paz * v[3] - pax * v[5];
+    w[5] += plx * v[1] - ply * v[0] + pax * v[4] - pay * v[3];
+  }
+}
+
+void HydrodynamicsPlugin::EvaluateSurfaces()
+{
+  const Links &l = this->links;
+  Surfaces &s = this->surfaces;
+  const size_t m = s.size();
+  const double rho = this->fluidDensity;
+
+  for (size_t j = 0; j < m; ++j)
+  {
+    // Everything in the link frame, where the surface's directions are constant
+    size_t i = s.link[j];
+    double vx = s.velX[j], vy = s.velY[j], vz = s.velZ[j];
+    InverseRotate(l.rotW[i], l.rotX[i], l.rotY[i], l.rotZ[i], vx, vy, vz);
+
+    double fx = 0, fy = 0, fz = 0;
+    double speed = std::sqrt(vx * vx + vy * vy + vz * vz);
+    if (speed > 0.01)
+    {
+      // Sweep is the angle between the velocity and the lift/drag plane
+      double nv = s.nX[j] * vx + s.nY[j] * vy + s.nZ[j] * vz;
+      double sinSweep = nv / speed;
+      double cosSweep2 = 1.0 - sinSweep * sinSweep;
+
+      // Velocity in the lift/drag plane, drag opposing it and lift normal to it in the plane
+      double px = vx - nv * s.nX[j], py = vy - nv * s.nY[j], pz = vz - nv * s.nZ[j];
+      double planeSpeed = std::sqrt(px * px + py * py + pz * pz);
+      if (planeSpeed > 0)
+      {
+        double inv = 1.0 / planeSpeed;
+        double dragX = -px * inv, dragY = -py * inv, dragZ = -pz * inv;
+        double liftX = (s.nY[j] * pz - s.nZ[j] * py) * inv;
+        double liftY = (s.nZ[j] * px - s.nX[j] * pz) * inv;
+        double liftZ = (s.nX[j] * py - s.nY[j] * px) * inv;
+
+        // Angle of attack from forward, negative when the velocity in the plane is along upward
+        double cosAlpha = std::min(1.0, std::max(-1.0, (s.fwdX[j] * px + s.fwdY[j] * py + s.fwdZ[j] * pz) * inv));
+        double upDot = s.upX[j] * px + s.upY[j] * py + s.upZ[j] * pz;
+        double alpha = upDot < 0 ? s.alpha0[j] + std::acos(cosAlpha) : s.alpha0[j] - std::acos(cosAlpha);
+        while (std::fabs(alpha) > 0.5 * M_PI)
+          alpha = alpha > 0 ? alpha - M_PI : alpha + M_PI;
+
+        double stall = s.alphaStall[j];
+        double cl, cd;
+        if (alpha > stall)
+        {
+          cl = std::max(0.0, (s.cla[j] * stall + s.claStall[j] * (alpha - stall)) * cosSweep2);
+          cd = (s.cda[j] * stall + s.cdaStall[j] * (alpha - stall)) * cosSweep2;
+        }
+        else if (alpha < -stall)
+        {
+          cl = std::min(0.0, (-s.cla[j] * stall + s.claStall[j] * (alpha + stall)) * cosSweep2);
+          cd = (-s.cda[j] * stall + s.cdaStall[j] * (alpha + stall)) * cosSweep2;
+        }
+        else
+        {
+          cl = s.cla[j] * alpha * cosSweep2;
+          cd = s.cda[j] * alpha * cosSweep2;
+        }
+        cd = std::fabs(cd);
+
+        double qs = 0.5 * rho * planeSpeed * planeSpeed * s.area[j];
+        fx = (cl * liftX + cd * dragX) * qs;
+        fy = (cl * liftY + cd * dragY) * qs;
+        fz = (cl * liftZ + cd * dragZ) * qs;
+      }
+    }
+    s.forceX[j] = fx;
+    s.forceY[j] = fy;
+    s.forceZ[j] = fz;
+  }
+}
+}  // namespace gazebo
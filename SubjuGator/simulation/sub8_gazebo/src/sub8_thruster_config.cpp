@@ -1,5 +1,7 @@
 #include <sub8_gazebo/sub8_thruster_config.hpp>
 
+#include <algorithm>
+
 using XmlRpc::XmlRpcValue;
 using XmlRpc::XmlRpcException;
 using namespace std;
@@ -91,4 +93,44 @@ catch (XmlRpcException& e)
   return;
 }
 
+ThrusterAllocation::ThrusterAllocation(const map<string, ThrusterDef>& thrusters)
+{
+  matrix_.reserve(6 * thrusters.size());
+  for (const auto& thruster : thrusters)
+  {
+    const ThrusterDef& t = thruster.second;
+    indices_[thruster.first] = names_.size();
+    names_.push_back(thruster.first);
+    min_.push_back(t.bounds[0]);
+    max_.push_back(t.bounds[1]);
+
+    // Force along the direction, and its torque position x direction
+    const double* p = t.position;
+    const double* d = t.direction;
+    matrix_.insert(matrix_.end(), { d[0], d[1], d[2], p[1] * d[2] - p[2] * d[1], p[2] * d[0] - p[0] * d[2],
+                                    p[0] * d[1] - p[1] * d[0] });
+  }
+}
+
+int ThrusterAllocation::index(const string& name) const
+{
+  auto it = indices_.find(name);
+  return it == indices_.end() ? -1 : it->second;
+}
+
+void ThrusterAllocation::saturate(vector<double>& thrusts) const
+{
+  for (size_t i = 0; i < thrusts.size() && i < size(); ++i)
+    thrusts[i] = std::max(min_[i], std::min(max_[i], thrusts[i]));
+}
+
+void ThrusterAllocation::wrench(const vector<double>& thrusts, double wrench[6]) const
+{
+  std::fill(wrench, wrench + 6, 0.);
+  const size_t n = std::min(thrusts.size(), size());
+  for (size_t i = 0; i < n; ++i)
+    for (size_t r = 0; r < 6; ++r)
+      wrench[r] += matrix_[6 * i + r] * thrusts[i];
+}
+
 }  // namespace sub8_gazebo
@@ -46,6 +46,11 @@ void ThrusterPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
     GZ_ASSERT(false, "Requires layout_param to be set!");
   }
 
+  if (this->sdf->HasElement("time_constant"))
+  {
+    this->timeConstant = this->sdf->Get<double>("time_constant");
+  }
+
   // Apply to multiple links
   GZ_ASSERT(this->sdf->HasElement("link"), "Must have a link specified!");
 
@@ -61,60 +66,77 @@ void ThrusterPlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
 
   // Prevent silly warnings (WHO IS STILL USING VARIADIC MACROS!?)
   ROS_INFO("Found %d thrusters", static_cast<int>(thrusterDefs.size()));
-  for (const auto& td : thrusterDefs)
-  {
-    Thruster thruster(td.second);
-    thrusterMap[td.first] = thruster;
-  }
-  this->lastTime = ros::Time::now();
+  this->allocation = sub8_gazebo::ThrusterAllocation(thrusterDefs);
+  this->commands.assign(this->allocation.size(), 0.);
+  this->thrusts.assign(this->allocation.size(), 0.);
 }
 
 void ThrusterPlugin::Init()
 {
-  this->updateConnection = event::Events::ConnectWorldUpdateBegin(std::bind(&ThrusterPlugin::OnUpdate, this));
+  this->updateConnection =
+      event::Events::ConnectWorldUpdateBegin(std::bind(&ThrusterPlugin::OnUpdate, this, std::placeholders::_1));
 }
 
 void ThrusterPlugin::ThrustCallback(const sub8_msgs::Thrust::ConstPtr& thrust)
 {
-  ignition::math::Vector3d netForce = ignition::math::Vector3d::Zero;
-  ignition::math::Vector3d netTorque = ignition::math::Vector3d::Zero;
+  // Thrusters not in the command are off
+  std::vector<double> resolved(this->allocation.size(), 0.);
+  for (const auto &thrustCmd : thrust->thruster_commands)
+  {
+    int index = this->allocation.index(thrustCmd.name);
+    if (index < 0)
+    {
+      ROS_WARN_THROTTLE(1.0, "Thrust command for unknown thruster %s", thrustCmd.name.c_str());
+      continue;
+    }
+    if (std::abs(thrustCmd.thrust) >= this->minAbsThrust)
+      resolved[index] = thrustCmd.thrust;
+  }
+  this->allocation.saturate(resolved);
 
-  mtx.lock();
-  this->lastTime = ros::Time::now();
-  this->cmdQueue = thrust->thruster_commands;
-  mtx.unlock();
+  std::lock_guard<std::mutex> lock(mtx);
+  this->lastTime = this->simTime;
+  this->cmdQueue.swap(resolved);
+  this->newCommands = true;
 }
 
-void ThrusterPlugin::OnUpdate()
+void ThrusterPlugin::OnUpdate(const common::UpdateInfo &info)
 {
-  if ((ros::Time::now() - this->lastTime) > ros::Duration(2.0))
+  double dt;
   {
-    return;
+    std::lock_guard<std::mutex> lock(mtx);
+    dt = (info.simTime - this->simTime).Double();
+    this->simTime = info.simTime;
+    if (this->newCommands)
+    {
+      this->commands.swap(this->cmdQueue);
+      this->newCommands = false;
+    }
+    // A reset world goes back in time, which also stops the thrusters
+    if (info.simTime < this->lastTime || (info.simTime - this->lastTime).Double() > 2.0)
+      std::fill(this->commands.begin(), this->commands.end(), 0.);
+    if (dt < 0)
+      std::fill(this->thrusts.begin(), this->thrusts.end(), 0.);
   }
-  mtx.lock();
-  std::vector<sub8_msgs::ThrusterCmd> cmdBuffer;
-  cmdBuffer = this->cmdQueue;
-  mtx.unlock();
 
   GZ_ASSERT(this->targetLink, "Could not find specified link");
 
-  for (auto thrustCmd : cmdBuffer)
-  {
-    const std::string name = thrustCmd.name;
-    const double thrust = thrustCmd.thrust;
-
-    if (std::abs(thrust) < this->minAbsThrust)
-    {
-      // Apply no force
-      continue;
-    }
+  // First order response of each thruster to its command
+  const double gain = this->timeConstant > 0 ? 1. - std::exp(-std::max(dt, 0.) / this->timeConstant) : 1.;
+  for (size_t i = 0; i < this->thrusts.size(); ++i)
+    this->thrusts[i] += gain * (this->commands[i] - this->thrusts[i]);
 
-    // Clip thrust within range
-    double clipped_thrust = std::max(thrusterMap[name].min, std::min(thrusterMap[name].max, thrust));
-    ignition::math::Vector3d force = thrusterMap[name].direction * clipped_thrust;
+  double wrench[6];
+  this->allocation.wrench(this->thrusts, wrench);
+  ignition::math::Vector3d force(wrench[0], wrench[1], wrench[2]);
+  ignition::math::Vector3d torque(wrench[3], wrench[4], wrench[5]);
+  if (force == ignition::math::Vector3d::Zero && torque == ignition::math::Vector3d::Zero)
+    return;
 
-    targetLink->AddLinkForce(force, thrusterMap[name].position);
-  }
+  // The wrench is about the link origin, but forces are applied at the center of mass
+  ignition::math::Vector3d cog = this->targetLink->GetInertial()->CoG();
+  this->targetLink->AddRelativeForce(force);
+  this->targetLink->AddRelativeTorque(torque - cog.Cross(force));
 }
 
 }  // namespace gazebo
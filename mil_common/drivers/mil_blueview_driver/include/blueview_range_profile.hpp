@@ -0,0 +1,172 @@
+#pragma once
+#include <mil_blueview_driver/BlueViewHead.h>
+#include <mil_blueview_driver/BlueViewRangeProfile.h>
+#include <std_msgs/Header.h>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+/** Quantizes range profiles into BlueViewRangeProfile messages, sending bearings only in BlueViewHead.
+ *  A profile takes 4 bytes per beam, against 10 for a BlueViewPing.
+ */
+class BlueViewRangeProfileEncoder
+{
+public:
+  /// \param range_scale Meters per range count, ranges beyond 65534 counts are sent as NO_RETURN
+  explicit BlueViewRangeProfileEncoder(float range_scale) : has_head_(false)
+  {
+    if (!(range_scale > 0))
+      throw std::runtime_error("BlueViewRangeProfileEncoder range_scale must be positive");
+    head_.geometry_id = 0;
+    head_.range_scale = range_scale;
+  }
+
+  /** Fills profile with one ping's range profile, as returned by BlueViewSonar::getRanges
+   *  \param header Header of both profile and, if it changes, head
+   *  \return true if the bearings changed, so head() must be published before profile
+   */
+  bool encode(const std_msgs::Header& header, const std::vector<float>& bearings, const std::vector<float>& ranges,
+              const std::vector<uint16_t>& intensities, mil_blueview_driver::BlueViewRangeProfile& profile)
+  {
+    size_t beams = ranges.size();
+    if (bearings.size() != beams || intensities.size() != beams)
+      throw std::runtime_error("BlueViewRangeProfileEncoder given differing numbers of bearings, ranges and "
+                               "intensities");
+    bool head_changed = !has_head_ || bearings != head_.bearings;
+    if (head_changed)
+    {
+      head_.header = header;
+      head_.geometry_id++;
+      head_.bearings = bearings;
+      has_head_ = true;
+    }
+    profile.header = header;
+    profile.geometry_id = head_.geometry_id;
+    profile.intensities = intensities;
+    profile.ranges.resize(beams);
+
+    // Negative, NaN and out of range values all fail the comparison and become NO_RETURN
+    typedef mil_blueview_driver::BlueViewRangeProfile Profile;
+    const float inv_scale = 1 / head_.range_scale;
+    const float max_count = Profile::NO_RETURN - 1;
+    const float max_range = max_count * head_.range_scale;
+    const uint16_t no_return = Profile::NO_RETURN;
+    const float* __restrict__ in = ranges.data();
+    uint16_t* __restrict__ out = profile.ranges.data();
+    for (size_t i = 0; i < beams; ++i)
+    {
+      // Clamped first so the conversion is defined even for values that end up NO_RETURN
+      float count = in[i] * inv_scale + 0.5f;
+      count = count > 0 ? count : 0;
+      count = count < max_count ? count : max_count;
+      out[i] = (in[i] >= 0 && in[i] <= max_range) ? static_cast<uint16_t>(count) : no_return;
+    }
+    return head_changed;
+  }
+
+  /// Head describing the last encoded profile
+  const mil_blueview_driver::BlueViewHead& head() const
+  {
+    return head_;
+  }
+
+private:
+  mil_blueview_driver::BlueViewHead head_;
+  bool has_head_;
+};
+
+/** Decodes BlueViewRangeProfile messages into contiguous float arrays, one element per beam.
+ *  The bearings and their cos and sin are computed once per head, not per ping.
+ */
+class BlueViewRangeProfileDecoder
+{
+public:
+  BlueViewRangeProfileDecoder() : has_head_(false), geometry_id_(0), range_scale_(0)
+  {
+  }
+
+  /// Use head for following profiles, computing its bearing tables
+  void setHead(const mil_blueview_driver::BlueViewHead& head)
+  {
+    size_t beams = head.bearings.size();
+    geometry_id_ = head.geometry_id;
+    range_scale_ = head.range_scale;
+    bearings_ = head.bearings;
+    cos_bearings_.resize(beams);
+    sin_bearings_.resize(beams);
+    for (size_t i = 0; i < beams; ++i)
+    {
+      cos_bearings_[i] = std::cos(bearings_[i]);
+      sin_bearings_[i] = std::sin(bearings_[i]);
+    }
+    has_head_ = true;
+  }
+
+  /// \return True if setHead has been called
+  bool hasHead() const
+  {
+    return has_head_;
+  }
+
+  /** Fills ranges() and intensities() from profile, NO_RETURN ranges becoming infinity
+   *  \return false, leaving the arrays unchanged, if profile was not encoded with the current head
+   */
+  bool decode(const mil_blueview_driver::BlueViewRangeProfile& profile)
+  {
+    size_t beams = bearings_.size();
+    if (!has_head_ || profile.geometry_id != geometry_id_ || profile.ranges.size() != beams ||
+        profile.intensities.size() != beams)
+      return false;
+    ranges_.resize(beams);
+    intensities_ = profile.intensities;
+
+    typedef mil_blueview_driver::BlueViewRangeProfile Profile;
+    const float scale = range_scale_;
+    const uint16_t no_return = Profile::NO_RETURN;
+    const float infinity = std::numeric_limits<float>::infinity();
+    const uint16_t* __restrict__ in = profile.ranges.data();
+    float* __restrict__ out = ranges_.data();
+    for (size_t i = 0; i < beams; ++i)
+      out[i] = in[i] == no_return ? infinity : in[i] * scale;
+    return true;
+  }
+
+  /// Number of beams in each array
+  size_t size() const
+  {
+    return bearings_.size();
+  }
+  const float* bearings() const
+  {
+    return bearings_.data();
+  }
+  const float* cosBearings() const
+  {
+    return cos_bearings_.data();
+  }
+  const float* sinBearings() const
+  {
+    return sin_bearings_.data();
+  }
+  /// Ranges of the last decoded profile, in meters
+  const float* ranges() const
+  {
+    return ranges_.data();
+  }
+  /// Intensities of the last decoded profile
+  const uint16_t* intensities() const
+  {
+    return intensities_.data();
+  }
+
+private:
+  bool has_head_;
+  uint32_t geometry_id_;
+  float range_scale_;
+  std::vector<float> bearings_;
+  std::vector<float> cos_bearings_;
+  std::vector<float> sin_bearings_;
+  std::vector<float> ranges_;
+  std::vector<uint16_t> intensities_;
+};
@@ -2,39 +2,140 @@
 #include <cv_bridge/cv_bridge.h>
 #include <image_transport/image_transport.h>
 #include <mil_blueview_driver/BlueViewPing.h>
+#include <mil_tools/driver_diagnostics.hpp>
 #include <ros/console.h>
 #include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <blueview_range_profile.hpp>
 #include <blueview_wrapper.hpp>
+#include <condition_variable>
 #include <ctime>
+#include <exception>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <opencv2/core/core.hpp>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
-class BlueViewRosDriver
+/// How a head's pings are acquired and published, see the example launch file
+enum class BlueViewMode
+{
+  POLL,      // acquire and publish back to back
+  TIMER,     // acquire and publish every period_seconds
+  PIPELINE,  // acquire on one thread, publish the newest ping on another
+};
+
+/**
+ * One head of the sonar with its own settings, topics and buffers. Heads of one sonar share its connection, but each
+ * acquires and publishes on threads of its own, so with several heads each still runs at its full ping rate.
+ */
+class BlueViewRosHead
 {
 public:
-  BlueViewRosDriver();
+  /** Connects to a head and loads its settings
+   *  \param driver_nh Driver's namespace. Settings of the head are read from name's namespace in it, falling back to
+   *                   the driver's, and topics are published there, or in the driver's if name is empty.
+   *  \param connection Head of the same sonar already connected, or NULL to open the sonar
+   */
+  BlueViewRosHead(ros::NodeHandle driver_nh, const std::string& name, int head_id, const BlueViewSonar* connection,
+                  mil_tools::DriverDiagnostics& diagnostics);
 
-  /// Loads blue view settings such as range from ROS params, see example launch file
-  void initParams();
+  const BlueViewSonar& sonar() const
+  {
+    return sonar_;
+  }
 
-  /// Blocks until node is shutdown, generating pings and pushing them to ros
-  void run();
+  /// Starts acquiring and publishing pings
+  void start(BlueViewMode mode, double period_seconds);
+  /// Stops and joins the threads started by start, rethrowing the first exception thrown on them
+  void stop();
 
 private:
-  ros::NodeHandle nh;
-  BlueViewSonar sonar;
-  void loop(const ros::TimerEvent&);
+  /// Reads a setting of this head, or of the driver if the head does not set it
+  template <typename T>
+  bool getParam(const std::string& key, T& value)
+  {
+    return nh.getParam(key, value) || driver_nh.getParam(key, value);
+  }
+
+  void initParams();
   void get_ping();
 
+  /// Publishes images / ranges for ping, only generating outputs which have subscribers
+  void publish(BVTSDK::Ping& ping, const ros::Time& stamp);
+
+  /// Poll mode: acquires and publishes pings back to back
+  void poll_loop();
+  /// Pipelined mode: acquires pings back to back into the triple buffer below
+  void acquire_loop();
+  /// Pipelined mode: publishes the newest acquired ping, skipping any that arrived while busy
+  void process_loop();
+  /// Records the exception being handled, if it is the first, and shuts the node down
+  void fail();
+
+  ros::NodeHandle driver_nh, nh;
+  std::string name;
+  BlueViewSonar sonar_;
+
+  /// One acquired ping and when it was received
+  struct PingSlot
+  {
+    PingSlot() : ping(NULL)
+    {
+    }
+    BVTSDK::Ping ping;
+    ros::Time stamp;
+  };
+  // Triple buffer between acquire_loop and process_loop, indexes into slots are swapped, never the pings
+  PingSlot slots[3];
+  int write_slot, ready_slot, read_slot;
+  bool ready_fresh, acquire_done, stop_threads;
+  unsigned long dropped_pings;
+  std::exception_ptr thread_error;  // First exception thrown by this head's threads, rethrown by stop
+  std::mutex slot_mutex;
+  std::condition_variable slot_cond;
+  std::vector<std::thread> threads;
+  BlueViewMode mode;
+
   image_transport::ImageTransport image_transport;
   image_transport::Publisher grayscale_pub, color_pub;
-  ros::Publisher raw_pub;
+  ros::Publisher raw_pub, head_pub, range_profile_pub;
+  // Reused between pings, so a ping of unchanged size allocates nothing
   cv_bridge::CvImagePtr grayscale_img, color_img;
+  sensor_msgs::Image grayscale_msg, color_msg;
   mil_blueview_driver::BlueViewPingPtr ping_msg;
+  mil_blueview_driver::BlueViewRangeProfile range_profile_msg;
+  std::unique_ptr<BlueViewRangeProfileEncoder> range_profile_encoder;
 
-  double period_seconds_;
   ros::Timer timer;
-  bool do_grayscale, do_color, do_raw;
+  bool do_grayscale, do_color, do_raw, do_compact;
   std::string frame_id;
+
+  // Latency from a ping being acquired to it being published, the interval between pings, and pings skipped by the
+  // pipeline
+  mil_tools::StreamMonitor* ping_monitor;
+};
+
+class BlueViewRosDriver
+{
+public:
+  BlueViewRosDriver();
+
+  /// Loads blue view settings such as range from ROS params, see example launch file
+  void initParams();
+
+  /// Blocks until node is shutdown, generating pings and pushing them to ros
+  void run();
+
+private:
+  ros::NodeHandle nh;
+  /// The head given by head_id, or each head listed in heads, in that order
+  std::vector<std::unique_ptr<BlueViewRosHead>> heads;
+
+  BlueViewMode mode;
+  double period_seconds_;
+
+  std::unique_ptr<mil_tools::DriverDiagnostics> diagnostics;
 };
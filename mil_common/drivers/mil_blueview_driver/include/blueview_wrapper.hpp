@@ -1,5 +1,6 @@
 #include <iostream>
 #include <iterator>
+#include <memory>
 
 #include <bvt_sdk.h>
 
@@ -25,12 +26,28 @@ public:
    */
   void init(ConnectionType type, const std::string& params, int head_id = 0);
 
+  /**  Connects to another head of a sonar already connected to, sharing its connection
+   *   \param connected Sonar connected to with the other init
+   *   \param head_id Which head to connect to
+   */
+  void init(const BlueViewSonar& connected, int head_id);
+
+  /// Returns the number of heads of the connected sonar
+  int getHeadCount();
+
   /**
    * Retrieves a new ping from file or sonar, must be called before other processing functions
    * \return true if ping successful, false if error (like end of file)
    */
   bool getNextPing();
 
+  /** Retrieves a new ping from file or sonar into a caller owned ping, leaving the latest ping untouched.
+   *  Only touches the head, so it may run on a different thread than image / range generation.
+   *  \param ping Ping to fill
+   *  \return true if ping successful, false if error (like end of file)
+   */
+  bool getNextPing(BVTSDK::Ping& ping);
+
   /// \return True if a ping has been retrieved
   bool hasPing() const;
 
@@ -42,10 +59,15 @@ public:
    */
   void generateImage();
 
+  /** Generates a mag image from the given ping, call before getting images
+   *  \param ping Ping previously filled by getNextPing(ping)
+   */
+  void generateImage(BVTSDK::Ping& ping);
+
   /** Fills an opencv image with the XY mag image from latest ping
    *  \pre generateImage has been called
    *  \param img OpenCV image to fill with mag image
-   *  \post img will be a CV_16U OpenCV Mat with mag image
+   *  \post img will be a CV_16U OpenCV Mat with mag image, reusing img's buffer if already the right size
    */
   void getGrayscaleImage(cv::Mat& img);
 
@@ -53,7 +75,7 @@ public:
    *  \pre generateImage has been called
    *  \pre loadColorMapper has been called
    *  \param img OpenCV Mat to fil with color XY ping image
-   *  \post img is a CV_8UC4 mat with color image of latest ping
+   *  \post img is a CV_8UC4 mat with color image of latest ping, reusing img's buffer if already the right size
    */
   void getColorImage(cv::Mat& img);
 
@@ -67,6 +89,10 @@ public:
    */
   void getRanges(std::vector<float>& bearings, std::vector<float>& ranges, std::vector<uint16_t>& intensities);
 
+  /// Same as getRanges above, but for a ping filled by getNextPing(ping)
+  void getRanges(BVTSDK::Ping& ping, std::vector<float>& bearings, std::vector<float>& ranges,
+                 std::vector<uint16_t>& intensities);
+
   /// Return a reference to blueview sdk head object for configuration like setting range
   /// Note: Must call updateHead after making changes for all changes to be used
   BVTSDK::Head& getHead();
@@ -87,7 +113,8 @@ public:
 
 private:
   ConnectionType connection_type_;
-  BVTSDK::Sonar sonar_;
+  /// Shared by every head connected through it
+  std::shared_ptr<BVTSDK::Sonar> sonar_;
   BVTSDK::ColorMapper color_mapper_;
   BVTSDK::MagImage mag_img_;
   BVTSDK::Head head_;
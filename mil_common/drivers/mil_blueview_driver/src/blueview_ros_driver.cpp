@@ -1,18 +1,52 @@
 #include <blueview_ros_driver.hpp>
 
-BlueViewRosDriver::BlueViewRosDriver() : nh(ros::this_node::getName()), image_transport(nh)
+BlueViewRosHead::BlueViewRosHead(ros::NodeHandle _driver_nh, const std::string &_name, int head_id,
+                                 const BlueViewSonar *connection, mil_tools::DriverDiagnostics &diagnostics)
+  : driver_nh(_driver_nh)
+  , nh(_name.empty() ? _driver_nh : ros::NodeHandle(_driver_nh, _name))
+  , name(_name)
+  , write_slot(0)
+  , ready_slot(1)
+  , read_slot(2)
+  , ready_fresh(false)
+  , acquire_done(false)
+  , stop_threads(false)
+  , dropped_pings(0)
+  , mode(BlueViewMode::POLL)
+  , image_transport(nh)
 {
+  if (connection)
+  {
+    sonar_.init(*connection, head_id);
+  }
+  else
+  {
+    std::string params;
+    if (driver_nh.getParam("file", params))
+      sonar_.init(BlueViewSonar::ConnectionType::FILE, params, head_id);
+    else if (driver_nh.getParam("device", params))
+      sonar_.init(BlueViewSonar::ConnectionType::DEVICE, params, head_id);
+    else
+      throw std::runtime_error("Can not connect: neither 'file' or 'device' param set");
+  }
+  ping_monitor = &diagnostics.stream(name.empty() ? "pings" : name + "/pings");
   initParams();
 }
-void BlueViewRosDriver::initParams()
+void BlueViewRosHead::initParams()
 {
   // Get sonar frame_id for header
-  nh.param<std::string>("sonar_frame", frame_id, "blueview");
+  if (!getParam("sonar_frame", frame_id))
+    frame_id = "blueview";
 
   // Determine which topics to publish
-  nh.param<bool>("grayscale/enable", do_grayscale, false);
-  nh.param<bool>("color/enable", do_color, false);
-  nh.param<bool>("raw/enable", do_raw, true);
+  do_grayscale = false;
+  do_color = false;
+  do_raw = true;
+  do_compact = false;
+  getParam("grayscale/enable", do_grayscale);
+  getParam("color/enable", do_color);
+  getParam("raw/enable", do_raw);
+  getParam("compact/enable", do_compact);
   if (do_grayscale)
   {
     grayscale_img.reset(new cv_bridge::CvImage());
@@ -24,43 +58,44 @@ void BlueViewRosDriver::initParams()
   {
     // Get and load color map
     std::string color_map_file;
-    if (nh.getParam("color/map_file", color_map_file))
-      sonar.loadColorMapper(color_map_file);
+    if (getParam("color/map_file", color_map_file))
+      sonar_.loadColorMapper(color_map_file);
 
     color_img.reset(new cv_bridge::CvImage());
     color_img->encoding = "bgra8";
     color_img->header.frame_id = frame_id;
     color_pub = image_transport.advertise("image_color", 1);
   }
+  // Also holds the range profile the compact messages are encoded from
+  ping_msg.reset(new mil_blueview_driver::BlueViewPing());
+  ping_msg->header.frame_id = frame_id;
   if (do_raw)
-  {
-    ping_msg.reset(new mil_blueview_driver::BlueViewPing());
-    ping_msg->header.frame_id = frame_id;
     raw_pub = nh.advertise<mil_blueview_driver::BlueViewPing>("ranges", 5);
+  if (do_compact)
+  {
+    // Meters per quantized range count
+    double range_scale = 0.002;
+    getParam("compact/range_scale", range_scale);
+    range_profile_encoder.reset(new BlueViewRangeProfileEncoder(range_scale));
+    head_pub = nh.advertise<mil_blueview_driver::BlueViewHead>("head", 1, true);
+    range_profile_pub = nh.advertise<mil_blueview_driver::BlueViewRangeProfile>("range_profile", 5);
   }
-  std::string params;
-  if (nh.getParam("file", params))
-    sonar.init(BlueViewSonar::ConnectionType::FILE, params);
-  else if (nh.getParam("device", params))
-    sonar.init(BlueViewSonar::ConnectionType::DEVICE, params);
-  else
-    throw std::runtime_error("Can not connect: neither 'file' or 'device' param set");
 
   // Set Ranges, meters
-  BVTSDK::Head &head = sonar.getHead();
+  BVTSDK::Head &head = sonar_.getHead();
   float range_lower, range_upper;
-  if (nh.getParam("range/start", range_lower))
+  if (getParam("range/start", range_lower))
   {
     head.SetStartRange(range_lower);
   }
-  if (nh.getParam("range/stop", range_upper))
+  if (getParam("range/stop", range_upper))
   {
     head.SetStopRange(range_upper);
   }
 
   // Handle fluid type, enum string
   std::string fluid_type;
-  if (nh.getParam("fluid_type", fluid_type))
+  if (getParam("fluid_type", fluid_type))
   {
     if (fluid_type == "saltwater")
       head.SetFluidType(BVTSDK::FluidType::Saltwater);
@@ -76,95 +111,281 @@ void BlueViewRosDriver::initParams()
 
   // Set sound speed, m/s
   int sound_speed;
-  if (nh.getParam("sound_speed", sound_speed))
+  if (getParam("sound_speed", sound_speed))
     head.SetSoundSpeed(sound_speed);
 
   float range_resolution;
-  if (nh.getParam("range_resolution", range_resolution))
+  if (getParam("range_resolution", range_resolution))
     head.SetRangeResolution(range_resolution);
 
   // Set analog gain adjustment in dB
   float gain;
-  if (nh.getParam("gain_adjustment", gain))
+  if (getParam("gain_adjustment", gain))
     head.SetGainAdjustment(gain);
 
   // Set "time variable analog gain", in dB/meter,
   float tvg;
-  if (nh.getParam("tvg_slope", tvg))
+  if (getParam("tvg_slope", tvg))
     head.SetTVGSlope(tvg);
 
   // Set dynamic power managment
   bool dynamic_power;
-  if (nh.getParam("dynamic_power_management", dynamic_power))
+  if (getParam("dynamic_power_management", dynamic_power))
     head.SetDynamicPowerManagement(dynamic_power);
 
   // Set ping interval
   float ping_interval;
-  if (nh.getParam("ping_interval", ping_interval))
+  if (getParam("ping_interval", ping_interval))
     head.SetPingInterval(ping_interval);
-  sonar.updateHead();
+  sonar_.updateHead();
 
   int range_profile_thresh;
-  if (nh.param<int>("range_profile_intensity_threshold", range_profile_thresh))
-    sonar.SetRangeProfileMinIntensity(range_profile_thresh);
+  if (getParam("range_profile_intensity_threshold", range_profile_thresh))
+    sonar_.SetRangeProfileMinIntensity(range_profile_thresh);
 
   float noise_threshold;
-  if (nh.param<int>("noise_threshold", noise_threshold))
-    sonar.SetRangeProfileMinIntensity(noise_threshold);
-
-  // Start loop
-  nh.param<double>("period_seconds", period_seconds_, -1);
+  if (getParam("noise_threshold", noise_threshold))
+    sonar_.SetNoiseThreshold(noise_threshold);
 }
-void BlueViewRosDriver::run()
+void BlueViewRosHead::start(BlueViewMode _mode, double period_seconds)
 {
-  if (period_seconds_ <= 0.0)
+  mode = _mode;
+  if (mode == BlueViewMode::PIPELINE)
   {
-    while (ros::ok())
-    {
-      get_ping();
-      ros::spinOnce();
-    }
+    threads.emplace_back(&BlueViewRosHead::acquire_loop, this);
+    threads.emplace_back(&BlueViewRosHead::process_loop, this);
+  }
+  else if (mode == BlueViewMode::POLL)
+  {
+    threads.emplace_back(&BlueViewRosHead::poll_loop, this);
   }
   else
   {
-    timer = nh.createTimer(ros::Duration(period_seconds_),
-                           std::bind(&BlueViewRosDriver::loop, this, std::placeholders::_1));
-    ros::spin();
+    timer = nh.createTimer(ros::Duration(period_seconds), [this](const ros::TimerEvent &) { get_ping(); });
   }
 }
-void BlueViewRosDriver::get_ping()
+void BlueViewRosHead::stop()
 {
-  if (!sonar.getNextPing())
+  timer.stop();
+  {
+    std::lock_guard<std::mutex> lock(slot_mutex);
+    stop_threads = true;
+  }
+  slot_cond.notify_all();
+  for (std::thread &thread : threads)
+    thread.join();
+  threads.clear();
+  if (mode == BlueViewMode::PIPELINE)
+    ROS_INFO("%sSkipped %lu pings acquired while the previous ping was being published",
+             name.empty() ? "" : (name + ": ").c_str(), dropped_pings);
+  if (thread_error)
+    std::rethrow_exception(thread_error);
+}
+void BlueViewRosHead::get_ping()
+{
+  if (!sonar_.getNextPing(slots[read_slot].ping))
   {
     ROS_WARN("No pings remaining in file, shutting down...");
     ros::shutdown();
     return;
   }
-  // Do images
-  if (do_grayscale || do_color)
+  publish(slots[read_slot].ping, ros::Time::now());
+}
+void BlueViewRosHead::publish(BVTSDK::Ping &ping, const ros::Time &stamp)
+{
+  // Do images, skipping generation entirely when nobody is listening
+  bool want_grayscale = do_grayscale && grayscale_pub.getNumSubscribers() > 0;
+  bool want_color = do_color && color_pub.getNumSubscribers() > 0;
+  if (want_grayscale || want_color)
   {
-    sonar.generateImage();
-    if (do_grayscale)
+    sonar_.generateImage(ping);
+    if (want_grayscale)
     {
-      sonar.getGrayscaleImage(grayscale_img->image);
-      grayscale_pub.publish(grayscale_img->toImageMsg());
+      grayscale_img->header.stamp = stamp;
+      sonar_.getGrayscaleImage(grayscale_img->image);
+      grayscale_img->toImageMsg(grayscale_msg);
+      grayscale_pub.publish(grayscale_msg);
     }
-    if (do_color)
+    if (want_color)
     {
-      sonar.getColorImage(color_img->image);
-      color_pub.publish(color_img->toImageMsg());
+      color_img->header.stamp = stamp;
+      sonar_.getColorImage(color_img->image);
+      color_img->toImageMsg(color_msg);
+      color_pub.publish(color_msg);
     }
   }
-  if (do_raw)
+  bool want_raw = do_raw && raw_pub.getNumSubscribers() > 0;
+  bool want_compact = do_compact && range_profile_pub.getNumSubscribers() > 0;
+  if (want_raw || want_compact)
   {
-    ping_msg->header.stamp = ros::Time::now();
-    sonar.getRanges(ping_msg->bearings, ping_msg->ranges, ping_msg->intensities);
-    raw_pub.publish(ping_msg);
+    ping_msg->header.stamp = stamp;
+    sonar_.getRanges(ping, ping_msg->bearings, ping_msg->ranges, ping_msg->intensities);
+    // Published by reference so the message is serialized now and free to be refilled by the next ping
+    if (want_raw)
+      raw_pub.publish(*ping_msg);
+    if (want_compact)
+    {
+      if (range_profile_encoder->encode(ping_msg->header, ping_msg->bearings, ping_msg->ranges,
+                                        ping_msg->intensities, range_profile_msg))
+        head_pub.publish(range_profile_encoder->head());
+      range_profile_pub.publish(range_profile_msg);
+    }
   }
+  ping_monitor->published(stamp);
+}
+void BlueViewRosHead::fail()
+{
+  std::lock_guard<std::mutex> lock(slot_mutex);
+  if (!thread_error)
+    thread_error = std::current_exception();
+  ros::shutdown();
 }
-void BlueViewRosDriver::loop(const ros::TimerEvent &)
+void BlueViewRosHead::poll_loop()
 {
-  get_ping();
+  try
+  {
+    while (ros::ok())
+    {
+      {
+        std::lock_guard<std::mutex> lock(slot_mutex);
+        if (stop_threads)
+          break;
+      }
+      get_ping();
+    }
+  }
+  catch (...)
+  {
+    fail();
+  }
+}
+void BlueViewRosHead::acquire_loop()
+{
+  try
+  {
+    while (ros::ok())
+    {
+      // write_slot is only ever changed by this thread, so the ping can be filled without the lock
+      PingSlot &slot = slots[write_slot];
+      if (!sonar_.getNextPing(slot.ping))
+      {
+        ROS_WARN("No pings remaining in file, shutting down...");
+        break;
+      }
+      slot.stamp = ros::Time::now();
+
+      std::lock_guard<std::mutex> lock(slot_mutex);
+      if (stop_threads)
+        break;
+      std::swap(write_slot, ready_slot);
+      if (ready_fresh)
+      {
+        ++dropped_pings;
+        ping_monitor->dropped();
+      }
+      ready_fresh = true;
+      slot_cond.notify_one();
+    }
+  }
+  catch (...)
+  {
+    fail();
+  }
+  {
+    std::lock_guard<std::mutex> lock(slot_mutex);
+    acquire_done = true;
+  }
+  slot_cond.notify_one();
+}
+void BlueViewRosHead::process_loop()
+{
+  try
+  {
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(slot_mutex);
+        slot_cond.wait(lock, [this] { return ready_fresh || acquire_done || stop_threads; });
+        if (stop_threads)
+          return;
+        if (!ready_fresh)
+        {
+          // Acquisition ended and its last ping has been published
+          ros::shutdown();
+          return;
+        }
+        std::swap(read_slot, ready_slot);
+        ready_fresh = false;
+      }
+      publish(slots[read_slot].ping, slots[read_slot].stamp);
+    }
+  }
+  catch (...)
+  {
+    fail();
+  }
+}
+
+BlueViewRosDriver::BlueViewRosDriver() : nh(ros::this_node::getName()), mode(BlueViewMode::POLL)
+{
+  initParams();
+}
+void BlueViewRosDriver::initParams()
+{
+  std::string params;
+  if (!nh.getParam("file", params) && !nh.getParam("device", params))
+    throw std::runtime_error("Can not connect: neither 'file' or 'device' param set");
+  diagnostics.reset(new mil_tools::DriverDiagnostics(nh, nh, ros::this_node::getName(), params));
+
+  // Several heads share one connection, each publishing in its own namespace, otherwise the one head publishes in the
+  // driver's
+  std::vector<std::string> head_names;
+  if (nh.getParam("heads", head_names) && !head_names.empty())
+  {
+    for (size_t i = 0; i < head_names.size(); ++i)
+    {
+      int head_id = i;
+      nh.getParam(head_names[i] + "/head_id", head_id);
+      heads.emplace_back(new BlueViewRosHead(nh, head_names[i], head_id, heads.empty() ? NULL : &heads[0]->sonar(),
+                                             *diagnostics));
+    }
+  }
+  else
+  {
+    int head_id = 0;
+    nh.getParam("head_id", head_id);
+    heads.emplace_back(new BlueViewRosHead(nh, "", head_id, NULL, *diagnostics));
+  }
+
+  // Start loop
+  bool do_pipeline;
+  nh.param<double>("period_seconds", period_seconds_, -1);
+  nh.param<bool>("pipeline/enable", do_pipeline, false);
+  if (do_pipeline && period_seconds_ > 0.0)
+    ROS_WARN("period_seconds is ignored when pipeline/enable is set, pings are published as fast as they arrive");
+  mode = do_pipeline ? BlueViewMode::PIPELINE : period_seconds_ <= 0.0 ? BlueViewMode::POLL : BlueViewMode::TIMER;
+}
+void BlueViewRosDriver::run()
+{
+  for (auto &head : heads)
+    head->start(mode, period_seconds_);
+  ros::spin();
+  // Every head is stopped before the first error is rethrown
+  std::exception_ptr error;
+  for (auto &head : heads)
+  {
+    try
+    {
+      head->stop();
+    }
+    catch (...)
+    {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+  if (error)
+    std::rethrow_exception(error);
 }
 
 int main(int argc, char **argv)
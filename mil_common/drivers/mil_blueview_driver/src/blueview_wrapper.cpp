@@ -12,14 +12,31 @@ void BlueViewSonar::init(ConnectionType type, const std::string& params, int hea
 {
   connection_type_ = type;
   // Open the sonar as either a recorded data file or live device
+  sonar_ = std::make_shared<BVTSDK::Sonar>();
   if (connection_type_ == ConnectionType::FILE)
-    sonar_.Open("FILE", params);
+    sonar_->Open("FILE", params);
   else
-    sonar_.Open("NET", params);  // default ip address
-  head_ = sonar_.GetHead(head_id);
+    sonar_->Open("NET", params);  // default ip address
+  head_ = sonar_->GetHead(head_id);
   has_init_ = true;
   updateHead();
 }
+void BlueViewSonar::init(const BlueViewSonar& connected, int head_id)
+{
+  if (!connected.has_init_)
+    throw std::runtime_error("init called with a sonar not connected to");
+  connection_type_ = connected.connection_type_;
+  sonar_ = connected.sonar_;
+  head_ = sonar_->GetHead(head_id);
+  has_init_ = true;
+  updateHead();
+}
+int BlueViewSonar::getHeadCount()
+{
+  if (!has_init_)
+    throw std::runtime_error("getHeadCount called on sonar before init");
+  return sonar_->GetHeadCount();
+}
 void BlueViewSonar::updateHead()
 {
   if (!has_init_)
@@ -52,6 +69,13 @@ void BlueViewSonar::SetNoiseThreshold(float thresh)
   image_generator_.SetNoiseThreshold(thresh);
 }
 bool BlueViewSonar::getNextPing()
+{
+  if (!getNextPing(latest_ping_))
+    return false;
+  has_ping_ = true;
+  return true;
+}
+bool BlueViewSonar::getNextPing(BVTSDK::Ping& ping)
 {
   if (!has_init_)
     throw std::runtime_error("getNextPing called on sonar before init");
@@ -63,8 +87,7 @@ bool BlueViewSonar::getNextPing()
       return false;
     ping_num = cur_ping_;
   }
-  latest_ping_ = head_.GetPing(ping_num);
-  has_ping_ = true;
+  ping = head_.GetPing(ping_num);
   return true;
 }
 
@@ -80,7 +103,11 @@ void BlueViewSonar::generateImage()
 {
   if (!hasPing())
     throw std::runtime_error("Cannot generate image before calling getNextPing");
-  mag_img_ = image_generator_.GetImageXY(latest_ping_);
+  generateImage(latest_ping_);
+}
+void BlueViewSonar::generateImage(BVTSDK::Ping& ping)
+{
+  mag_img_ = image_generator_.GetImageXY(ping);
   has_image_ = true;
 }
 void BlueViewSonar::getGrayscaleImage(cv::Mat& img)
@@ -89,10 +116,9 @@ void BlueViewSonar::getGrayscaleImage(cv::Mat& img)
     throw std::runtime_error("Cannot get grayscale image before calling generateImages()");
   int height = mag_img_.GetHeight();
   int width = mag_img_.GetWidth();
-  size_t buffer_len = width * height;
-  uint16_t buffer[buffer_len];
-  mag_img_.CopyBits(buffer, buffer_len);
-  img = cv::Mat(height, width, CV_16U, buffer);
+  // Copy straight into img, create is a no-op when img already has this size and type
+  img.create(height, width, CV_16U);
+  mag_img_.CopyBits(img.ptr<uint16_t>(), width * height);
 }
 void BlueViewSonar::loadColorMapper(const std::string& file)
 {
@@ -108,17 +134,20 @@ void BlueViewSonar::getColorImage(cv::Mat& img)
   BVTSDK::ColorImage bv_img = color_mapper_.MapImage(mag_img_);
   int height = mag_img_.GetHeight();
   int width = mag_img_.GetWidth();
-  size_t buffer_len = height * width;
-  uint32_t buffer[buffer_len];
-  bv_img.CopyBits(buffer, buffer_len);
-  img = cv::Mat(height, width, CV_8UC4, buffer);
+  img.create(height, width, CV_8UC4);
+  bv_img.CopyBits(img.ptr<uint32_t>(), width * height);
 }
 void BlueViewSonar::getRanges(std::vector<float>& bearings, std::vector<float>& ranges,
                               std::vector<uint16_t>& intensities)
 {
   if (!hasPing())
     throw std::runtime_error("Cannot generate range profile before calling getNextPing");
-  BVTSDK::RangeProfile range_profile = image_generator_.GetRangeProfile(latest_ping_);
+  getRanges(latest_ping_, bearings, ranges, intensities);
+}
+void BlueViewSonar::getRanges(BVTSDK::Ping& ping, std::vector<float>& bearings, std::vector<float>& ranges,
+                              std::vector<uint16_t>& intensities)
+{
+  BVTSDK::RangeProfile range_profile = image_generator_.GetRangeProfile(ping);
 
   // Handles very annoying bug in library with older sonar files that don't support range profiles
   if (range_profile.Handle() == nullptr)
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <unsupported/Eigen/FFT>
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mil_passive_sonar
+{
+/// Bandpass filter of interleaved multichannel samples, as a cascade of biquad sections with their state kept between
+/// calls, so a stream can be filtered a message at a time
+class StreamedBandpass
+{
+public:
+  /**
+   * @param low, high edges of the pass band in Hz
+   * @param sections number of second order sections, each steepening the band edges
+   */
+  StreamedBandpass(size_t channels, double sample_rate, double low, double high, size_t sections);
+
+  /// Filter frames of interleaved samples into out, also interleaved
+  void filter(const int16_t* samples, size_t frames, float* out);
+  void reset();
+
+private:
+  struct Section
+  {
+    double b0, b1, b2, a1, a2;
+  };
+  size_t channels_;
+  std::vector<Section> sections_;
+  std::vector<double> state_;  // two per channel per section, transposed direct form II
+};
+
+/// A ping found in the stream, and the time it took to reach each hydrophone
+struct DetectedPing
+{
+  uint64_t onset_frame;  // frame of the stream the ping was detected in
+  uint64_t window_start_frame;
+  double frequency;  // of the strongest frequency in the pass band, in Hz
+  double amplitude;  // of that frequency in the filtered window of the first channel
+  // Arrival time at each channel minus that at the first channel, in seconds, and the peak of the GCC-PHAT
+  // correlation it was taken from, 1 for a perfect match
+  std::vector<double> tdoa;
+  std::vector<double> confidence;
+  bool direction_valid;
+  Eigen::Vector3d direction;  // unit vector to the pinger in the frame of the hydrophone positions
+  std::vector<int16_t> window;  // interleaved samples around the onset
+};
+
+/**
+ * Finds pings in a stream of interleaved hydrophone samples and how much later they reached each hydrophone than the
+ * first one.
+ *
+ * The stream is bandpass filtered around the pinger frequency. A ping starts where the short term power of the first
+ * channel rises threshold times above its noise floor. The filtered window around the onset is then cross correlated
+ * between the first channel and each other one with GCC-PHAT. That is the inverse FFT of their cross spectrum
+ * normalized to unit magnitude over the pass band, and its peak within the largest physically possible delay,
+ * interpolated to a fraction of a sample, gives the delay. The direction to the pinger is the least squares fit of
+ * a plane wave to the delays.
+ */
+class PingProcessor
+{
+public:
+  struct Config
+  {
+    size_t channels = 4;
+    double sample_rate = 1.2E6;
+    double frequency = 30000;   // pinger frequency, in Hz
+    double bandwidth = 200;     // of the bandpass filter around it, in Hz
+    size_t filter_sections = 2;
+    double short_window = 1E-4;  // time constants of the short term power and of the noise floor, in seconds
+    double noise_window = 5E-2;
+    double threshold = 10;  // ratio of short term power to noise floor for an onset
+    double min_time_between_pings = 1.5;
+    double window_before = 5E-4;  // of the correlated window around the onset, in seconds
+    double window_after = 1.5E-3;
+    double speed_of_sound = 1482;
+    double min_confidence = 0.2;  // of every channel for the direction to be valid
+    // Position of each hydrophone, in meters, as a column
+    Eigen::Matrix3Xd positions;
+  };
+
+  explicit PingProcessor(const Config& config);
+
+  /// Process the next frames of the stream, appending the pings whose windows end in them to pings
+  void process(const int16_t* samples, size_t frames, std::vector<DetectedPing>& pings);
+  /// Start over, as after a gap in the stream
+  void reset();
+  /// Frames processed since the stream started or was last reset
+  uint64_t frames() const
+  {
+    return frames_;
+  }
+  const Config& config() const
+  {
+    return config_;
+  }
+
+private:
+  void measure(DetectedPing& ping);
+  // Delay of channel, in frames, and the correlation peak it came from, from the spectra of the window
+  double delay(size_t channel, double& peak);
+  void locate(DetectedPing& ping) const;
+
+  Config config_;
+  StreamedBandpass bandpass_;
+  size_t before_frames_, after_frames_, max_lag_;
+  uint64_t warmup_frames_, holdoff_frames_;
+  double short_alpha_, noise_alpha_;
+
+  uint64_t frames_;
+  double short_power_, noise_power_;
+  bool pending_;  // an onset was found and its window has not been filled yet
+  uint64_t onset_frame_;
+  uint64_t last_onset_frame_;
+  bool have_onset_;
+
+  // Ring of the last frames of the stream, raw and filtered, large enough for a window
+  size_t ring_mask_;
+  std::vector<int16_t> raw_ring_;
+  std::vector<float> filtered_ring_;
+  std::vector<float> filtered_;
+
+  // FFT of the window, with its length and the pass band bins
+  Eigen::FFT<double> fft_;
+  size_t fft_size_, band_first_, band_last_;
+  std::vector<double> signal_, correlation_;
+  std::vector<std::vector<std::complex<double> > > spectra_;
+  std::vector<std::complex<double> > cross_;
+};
+
+}  // namespace mil_passive_sonar
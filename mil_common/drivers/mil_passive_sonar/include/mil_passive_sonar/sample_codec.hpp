@@ -0,0 +1,58 @@
+#pragma once
+
+#include <mil_passive_sonar/HydrophoneSamples.h>
+#include <mil_passive_sonar/HydrophoneSamplesCompressed.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mil_passive_sonar
+{
+/**
+ * Lossless compression of interleaved multichannel samples, for recording and sending hydrophone samples at a third
+ * or so of their size.
+ *
+ * The samples are cut into blocks of block_size frames, and each channel of a block is coded on its own. It is
+ * predicted from its previous samples with the fixed polynomial predictor of order 0, 1 or 2 (the sample, its
+ * difference from the last one, or the change in that difference) which leaves the smallest residuals, and the
+ * residuals are Rice coded with the parameter that suits their mean. Hydrophones mostly hear noise a few bits deep, so
+ * most of each 16 bit sample is predictable. A channel the residuals would not shrink, such as one clipping, is
+ * stored verbatim, so nothing ever grows by more than a few bits a block.
+ *
+ * Each channel of a block is, MSB first: the predictor order in 2 bits (3 for verbatim), then for a predictor the
+ * Rice parameter in 5 bits, its first order samples in 16 bits each, and the remaining residuals mapped to unsigned
+ * (0, -1, 1, -2 ... to 0, 1, 2, 3 ...). A residual is its quotient by 2^k in unary, as ones ended by a zero, then its
+ * low k bits, or ESCAPE ones and the whole of it in 20 bits if the quotient would be ESCAPE or more. The stream is
+ * padded with zeros to a whole byte.
+ */
+class SampleEncoder
+{
+public:
+  explicit SampleEncoder(size_t block_size = 4096);
+
+  size_t block_size() const
+  {
+    return block_size_;
+  }
+
+  /// Compress frames of channels interleaved samples, replacing out
+  void encode(const int16_t* samples, size_t channels, size_t frames, std::vector<uint8_t>& out);
+  /// Compress samples into compressed, reusing its data's storage
+  void encode(const HydrophoneSamples& samples, HydrophoneSamplesCompressed& compressed);
+
+private:
+  size_t block_size_;
+  // One channel of the block being coded, and its residuals for the chosen predictor, reused between blocks
+  std::vector<int32_t> channel_;
+  std::vector<uint32_t> residuals_;
+};
+
+/// Decompress frames of channels interleaved samples written by SampleEncoder::encode with block_size into samples,
+/// returning false if data is cut short or is not such a stream
+bool decode_samples(const uint8_t* data, size_t size, size_t channels, size_t frames, size_t block_size,
+                    int16_t* samples);
+/// Decompress compressed into samples, returning false if it is malformed
+bool decode_samples(const HydrophoneSamplesCompressed& compressed, HydrophoneSamples& samples);
+
+}  // namespace mil_passive_sonar
@@ -0,0 +1,29 @@
+/* ROS node to republish the compressed samples of the sylphase_ros_bridge as a mil_passive_sonar/HydrophoneSamples
+ * message, for the nodes which process them, e.g. on shore or playing back a recording of only the compressed samples
+ */
+#include <mil_passive_sonar/HydrophoneSamplesCompressedStamped.h>
+#include <mil_passive_sonar/HydrophoneSamplesStamped.h>
+#include <mil_passive_sonar/sample_codec.hpp>
+#include <ros/ros.h>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "decompress_samples");
+  ros::NodeHandle nh;
+
+  ros::Publisher pub = nh.advertise<mil_passive_sonar::HydrophoneSamplesStamped>("samples", 1);
+  ros::Subscriber sub = nh.subscribe<mil_passive_sonar::HydrophoneSamplesCompressedStamped>(
+      "samples_compressed", 1, [&pub](const mil_passive_sonar::HydrophoneSamplesCompressedStampedConstPtr& compressed) {
+        if (!pub.getNumSubscribers())
+          return;
+        mil_passive_sonar::HydrophoneSamplesStampedPtr samples(new mil_passive_sonar::HydrophoneSamplesStamped());
+        samples->header = compressed->header;
+        if (!mil_passive_sonar::decode_samples(compressed->hydrophone_samples, samples->hydrophone_samples))
+        {
+          ROS_WARN_STREAM_THROTTLE(1.0, "Dropping malformed compressed samples " << compressed->header.seq);
+          return;
+        }
+        pub.publish(samples);
+      });
+  ros::spin();
+}
@@ -0,0 +1,265 @@
+#include <mil_passive_sonar/ping_processor.hpp>
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace mil_passive_sonar
+{
+namespace
+{
+size_t next_power_of_two(size_t n)
+{
+  size_t power = 1;
+  while (power < n)
+    power <<= 1;
+  return power;
+}
+
+// Offset of the vertex of the parabola through (-1, left), (0, center), (1, right) from 0
+double parabola_vertex(double left, double center, double right)
+{
+  double curvature = left - 2 * center + right;
+  return curvature != 0 ? 0.5 * (left - right) / curvature : 0;
+}
+}  // namespace
+
+StreamedBandpass::StreamedBandpass(size_t channels, double sample_rate, double low, double high, size_t sections)
+  : channels_(channels)
+{
+  if (!(low > 0 && high > low && high < sample_rate / 2))
+    throw std::invalid_argument("The pass band has to be between 0 and half the sample rate");
+
+  // Constant peak gain bandpass biquad, from the Audio EQ Cookbook, centered on the geometric mean of the edges
+  double center = std::sqrt(low * high);
+  double w0 = 2 * M_PI * center / sample_rate;
+  double q = center / (high - low);
+  double alpha = std::sin(w0) / (2 * q);
+  double a0 = 1 + alpha;
+  Section section = { alpha / a0, 0, -alpha / a0, -2 * std::cos(w0) / a0, (1 - alpha) / a0 };
+  sections_.assign(std::max<size_t>(sections, 1), section);
+  reset();
+}
+
+void StreamedBandpass::reset()
+{
+  state_.assign(2 * channels_ * sections_.size(), 0);
+}
+
+void StreamedBandpass::filter(const int16_t* samples, size_t frames, float* out)
+{
+  for (size_t frame = 0; frame < frames; ++frame)
+  {
+    for (size_t channel = 0; channel < channels_; ++channel)
+    {
+      double x = samples[frame * channels_ + channel];
+      double* state = &state_[2 * channel * sections_.size()];
+      for (const Section& s : sections_)
+      {
+        double y = s.b0 * x + state[0];
+        state[0] = s.b1 * x - s.a1 * y + state[1];
+        state[1] = s.b2 * x - s.a2 * y;
+        x = y;
+        state += 2;
+      }
+      out[frame * channels_ + channel] = x;
+    }
+  }
+}
+
+PingProcessor::PingProcessor(const Config& config)
+  : config_(config)
+  , bandpass_(config.channels, config.sample_rate, config.frequency - config.bandwidth / 2,
+              config.frequency + config.bandwidth / 2, config.filter_sections)
+{
+  if (config_.channels < 2 || size_t(config_.positions.cols()) != config_.channels)
+    throw std::invalid_argument("There has to be a position for each of at least 2 hydrophones");
+
+  const double rate = config_.sample_rate;
+  before_frames_ = std::round(config_.window_before * rate);
+  after_frames_ = std::max<size_t>(std::round(config_.window_after * rate), 1);
+  double max_baseline = 0;
+  for (size_t i = 1; i < config_.channels; ++i)
+    max_baseline = std::max(max_baseline, (config_.positions.col(i) - config_.positions.col(0)).norm());
+  // With some margin, so that a peak at the edge of the search marks an impossible delay
+  max_lag_ = std::ceil(1.25 * max_baseline / config_.speed_of_sound * rate) + 1;
+  warmup_frames_ = 3 * config_.noise_window * rate;
+  holdoff_frames_ = config_.min_time_between_pings * rate;
+  short_alpha_ = 1 - std::exp(-1 / (config_.short_window * rate));
+  noise_alpha_ = 1 - std::exp(-1 / (config_.noise_window * rate));
+
+  size_t window = before_frames_ + after_frames_;
+  ring_mask_ = next_power_of_two(window) - 1;
+  raw_ring_.resize((ring_mask_ + 1) * config_.channels);
+  filtered_ring_.resize((ring_mask_ + 1) * config_.channels);
+
+  // Long enough for the correlation not to wrap around within the searched lags
+  fft_size_ = next_power_of_two(window + max_lag_);
+  fft_.SetFlag(fft_.HalfSpectrum);
+  fft_.SetFlag(fft_.Unscaled);
+  double bin_width = rate / fft_size_;
+  band_first_ = std::max<double>(std::floor((config_.frequency - config_.bandwidth / 2) / bin_width) - 2, 1);
+  band_last_ = std::min<double>(std::ceil((config_.frequency + config_.bandwidth / 2) / bin_width) + 2,
+                                fft_size_ / 2 - 1);
+  signal_.resize(fft_size_);
+  correlation_.resize(fft_size_);
+  spectra_.assign(config_.channels, std::vector<std::complex<double> >(fft_size_ / 2 + 1));
+  cross_.resize(fft_size_ / 2 + 1);
+
+  reset();
+}
+
+void PingProcessor::reset()
+{
+  bandpass_.reset();
+  frames_ = 0;
+  short_power_ = 0;
+  noise_power_ = 0;
+  pending_ = false;
+  have_onset_ = false;
+}
+
+void PingProcessor::process(const int16_t* samples, size_t frames, std::vector<DetectedPing>& pings)
+{
+  const size_t channels = config_.channels;
+  filtered_.resize(frames * channels);
+  bandpass_.filter(samples, frames, filtered_.data());
+
+  for (size_t frame = 0; frame < frames; ++frame)
+  {
+    size_t slot = (frames_ & ring_mask_) * channels;
+    std::copy(samples + frame * channels, samples + (frame + 1) * channels, &raw_ring_[slot]);
+    std::copy(&filtered_[frame * channels], &filtered_[(frame + 1) * channels], &filtered_ring_[slot]);
+
+    // Onsets are found on the first channel. The noise floor is left alone while a ping and its echoes are heard.
+    double power = filtered_[frame * channels] * filtered_[frame * channels];
+    short_power_ += short_alpha_ * (power - short_power_);
+    bool quiet = !have_onset_ || frames_ - last_onset_frame_ >= holdoff_frames_;
+    if (!pending_ && quiet)
+    {
+      if (frames_ >= warmup_frames_ && short_power_ > config_.threshold * noise_power_)
+      {
+        pending_ = true;
+        have_onset_ = true;
+        onset_frame_ = last_onset_frame_ = frames_;
+      }
+      else
+        noise_power_ += noise_alpha_ * (power - noise_power_);
+    }
+    ++frames_;
+
+    if (pending_ && frames_ >= onset_frame_ + after_frames_)
+    {
+      pending_ = false;
+      DetectedPing ping;
+      ping.onset_frame = onset_frame_;
+      ping.window_start_frame = onset_frame_ - before_frames_;  // the warmup is longer than the window
+      measure(ping);
+      pings.push_back(ping);
+    }
+  }
+}
+
+void PingProcessor::measure(DetectedPing& ping)
+{
+  const size_t channels = config_.channels;
+  const size_t window = before_frames_ + after_frames_;
+  ping.window.resize(window * channels);
+  for (size_t i = 0; i < window; ++i)
+  {
+    size_t slot = ((ping.window_start_frame + i) & ring_mask_) * channels;
+    std::copy(&raw_ring_[slot], &raw_ring_[slot + channels], &ping.window[i * channels]);
+  }
+
+  // Spectrum of each channel's filtered window, zero padded to the FFT size
+  for (size_t channel = 0; channel < channels; ++channel)
+  {
+    std::fill(signal_.begin(), signal_.end(), 0);
+    for (size_t i = 0; i < window; ++i)
+      signal_[i] = filtered_ring_[((ping.window_start_frame + i) & ring_mask_) * channels + channel];
+    fft_.fwd(spectra_[channel].data(), signal_.data(), fft_size_);
+  }
+
+  // Strongest frequency of the pass band on the first channel
+  const std::vector<std::complex<double> >& first = spectra_[0];
+  size_t peak_bin = band_first_;
+  for (size_t k = band_first_; k <= band_last_; ++k)
+    if (std::abs(first[k]) > std::abs(first[peak_bin]))
+      peak_bin = k;
+  double offset = parabola_vertex(std::abs(first[peak_bin - 1]), std::abs(first[peak_bin]),
+                                  std::abs(first[peak_bin + 1]));
+  ping.frequency = (peak_bin + offset) * config_.sample_rate / fft_size_;
+  ping.amplitude = 2 * std::abs(first[peak_bin]) / window;
+
+  ping.tdoa.assign(channels, 0);
+  ping.confidence.assign(channels, 1);
+  for (size_t channel = 1; channel < channels; ++channel)
+    ping.tdoa[channel] = delay(channel, ping.confidence[channel]) / config_.sample_rate;
+  locate(ping);
+}
+
+double PingProcessor::delay(size_t channel, double& peak)
+{
+  // Cross spectrum, whitened over the pass band, is the spectrum of the GCC-PHAT correlation
+  std::fill(cross_.begin(), cross_.end(), 0);
+  for (size_t k = band_first_; k <= band_last_; ++k)
+  {
+    std::complex<double> cross = spectra_[channel][k] * std::conj(spectra_[0][k]);
+    double magnitude = std::abs(cross);
+    if (magnitude > 0)
+      cross_[k] = cross / magnitude;
+  }
+  fft_.inv(correlation_.data(), cross_.data(), fft_size_);
+
+  // A channel delayed by d frames from the first peaks at lag d, wrapped around for negative lags
+  auto at = [this](long lag) { return correlation_[(lag + fft_size_) % fft_size_]; };
+  long best = 0;
+  for (long lag = -long(max_lag_); lag <= long(max_lag_); ++lag)
+    if (at(lag) > at(best))
+      best = lag;
+  // Each bin adds up to 2 to the unscaled correlation, with its mirror image
+  peak = at(best) / (2 * (band_last_ - band_first_ + 1));
+  return best + parabola_vertex(at(best - 1), at(best), at(best + 1));
+}
+
+void PingProcessor::locate(DetectedPing& ping) const
+{
+  // A plane wave from direction u reaches hydrophone i (p_i - p_0).u / c before the first one
+  const size_t baselines = config_.channels - 1;
+  Eigen::MatrixXd A(baselines, 3);
+  Eigen::VectorXd y(baselines);
+  ping.direction_valid = true;
+  for (size_t i = 0; i < baselines; ++i)
+  {
+    A.row(i) = (config_.positions.col(i + 1) - config_.positions.col(0)).transpose();
+    y(i) = -config_.speed_of_sound * ping.tdoa[i + 1];
+    // Sound can not take longer than the distance between two hydrophones to go from one to the other
+    if (std::abs(y(i)) > 1.1 * A.row(i).norm() || ping.confidence[i + 1] < config_.min_confidence)
+      ping.direction_valid = false;
+  }
+
+  Eigen::Vector3d direction = Eigen::Vector3d::Zero();
+  if (A.col(2).cwiseAbs().maxCoeff() < 1E-6 * A.cwiseAbs().maxCoeff())
+  {
+    // A flat array can not tell above from below it, the pinger is taken to be below
+    Eigen::MatrixXd planar = A.leftCols<2>();
+    direction.head<2>() = planar.jacobiSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(y);
+    double horizontal = direction.head<2>().squaredNorm();
+    if (horizontal < 1)
+      direction.z() = -std::sqrt(1 - horizontal);
+  }
+  else
+    direction = A.jacobiSvd(Eigen::ComputeThinU | Eigen::ComputeThinV).solve(y);
+
+  if (direction.norm() > 0)
+    ping.direction = direction.normalized();
+  else
+  {
+    ping.direction = direction;
+    ping.direction_valid = false;
+  }
+}
+
+}  // namespace mil_passive_sonar
@@ -0,0 +1,14 @@
+/* ROS node to record the compressed samples of the sylphase_ros_bridge to a bag while enabled, a third or so of the
+ * size of recording the samples themselves. See mil_tools/topic_recorder.hpp for its params and enable service.
+ */
+#include <mil_passive_sonar/HydrophoneSamplesCompressedStamped.h>
+#include <mil_tools/topic_recorder.hpp>
+#include <ros/ros.h>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "record_compressed_samples");
+  ros::NodeHandle nh("~");
+  mil_tools::TopicRecorder<mil_passive_sonar::HydrophoneSamplesCompressedStamped> recorder(&nh);
+  ros::spin();
+}
@@ -0,0 +1,241 @@
+#include <mil_passive_sonar/sample_codec.hpp>
+
+#include <mil_tools/bit_stream.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace mil_passive_sonar
+{
+namespace
+{
+using mil_tools::BitReader;
+using mil_tools::BitWriter;
+
+const uint32_t VERBATIM = 3;
+const uint32_t MAX_RICE = 20;
+// Quotients from here on are escaped, and the residual written in ESCAPE_BITS, which holds any of them
+const uint32_t ESCAPE = 24;
+const uint32_t ESCAPE_BITS = 20;
+
+// Residual of sample i from the fixed predictor of Order
+template <int Order>
+int32_t residual(const int32_t* x, size_t i)
+{
+  if (Order == 0)
+    return x[i];
+  if (Order == 1)
+    return x[i] - x[i - 1];
+  return x[i] - 2 * x[i - 1] + x[i - 2];
+}
+
+// Residuals of the samples from Order on, mapped to unsigned, returning their sum. A loop the compiler vectorizes.
+template <int Order>
+uint64_t make_residuals(const int32_t* __restrict__ x, size_t n, uint32_t* __restrict__ residuals)
+{
+  uint64_t sum = 0;
+  for (size_t i = Order; i < n; ++i)
+  {
+    int32_t r = residual<Order>(x, i);
+    uint32_t u = (static_cast<uint32_t>(r) << 1) ^ static_cast<uint32_t>(r >> 31);
+    residuals[i] = u;
+    sum += u;
+  }
+  return sum;
+}
+
+void encode_channel(BitWriter& writer, const int32_t* __restrict__ x, size_t n, uint32_t* __restrict__ residuals)
+{
+  // The predictor leaving the smallest residuals, compared over the samples all of them predict
+  uint32_t order = 0;
+  if (n > 2)
+  {
+    int64_t sum0 = 0, sum1 = 0, sum2 = 0;
+    for (size_t i = 2; i < n; ++i)
+    {
+      sum0 += std::abs(residual<0>(x, i));
+      sum1 += std::abs(residual<1>(x, i));
+      sum2 += std::abs(residual<2>(x, i));
+    }
+    if (sum1 < sum0)
+      order = sum2 < sum1 ? 2 : 1;
+    else if (sum2 < sum0)
+      order = 2;
+  }
+
+  uint64_t sum = order == 0 ? make_residuals<0>(x, n, residuals) :
+                              order == 1 ? make_residuals<1>(x, n, residuals) : make_residuals<2>(x, n, residuals);
+
+  // The Rice parameter is the log of the mean residual, about the best for the two sided geometric distribution
+  // residuals of noise follow
+  const size_t count = n - order;
+  const uint64_t mean = count ? sum / count : 0;
+  uint32_t k = 0;
+  while (k < MAX_RICE && (uint64_t(2) << k) <= mean)
+    ++k;
+  uint64_t bits = count * (k + 1);
+  for (size_t i = order; i < n; ++i)
+    bits += residuals[i] >> k;
+
+  if (5 + 16 * order + bits >= 16 * n)
+  {
+    writer.put(VERBATIM, 2);
+    for (size_t i = 0; i < n; ++i)
+      writer.put(static_cast<uint16_t>(x[i]), 16);
+    return;
+  }
+
+  writer.put(order, 2);
+  writer.put(k, 5);
+  for (size_t i = 0; i < order; ++i)
+    writer.put(static_cast<uint16_t>(x[i]), 16);
+  const uint32_t low_mask = (uint32_t(1) << k) - 1;
+  for (size_t i = order; i < n; ++i)
+  {
+    const uint32_t u = residuals[i];
+    const uint32_t q = u >> k;
+    if (q < ESCAPE)
+    {
+      writer.put(((uint32_t(1) << q) - 1) << 1, q + 1);
+      writer.put(u & low_mask, k);
+    }
+    else
+    {
+      writer.put((uint32_t(1) << ESCAPE) - 1, ESCAPE);
+      writer.put(u, ESCAPE_BITS);
+    }
+  }
+}
+}  // namespace
+
+SampleEncoder::SampleEncoder(size_t block_size) : block_size_(std::max<size_t>(block_size, 1))
+{
+}
+
+void SampleEncoder::encode(const int16_t* samples, size_t channels, size_t frames, std::vector<uint8_t>& out)
+{
+  out.clear();
+  // Enough for the usual third of the size, so the output is seldom grown
+  out.reserve(channels * frames * sizeof(int16_t) / 2 + 16);
+  BitWriter writer(out);
+  channel_.resize(block_size_);
+  residuals_.resize(block_size_);
+  for (size_t start = 0; start < frames; start += block_size_)
+  {
+    const size_t n = std::min(block_size_, frames - start);
+    for (size_t c = 0; c < channels; ++c)
+    {
+      const int16_t* in = samples + start * channels + c;
+      for (size_t i = 0; i < n; ++i)
+        channel_[i] = in[i * channels];
+      encode_channel(writer, channel_.data(), n, residuals_.data());
+    }
+  }
+  writer.flush();
+}
+
+void SampleEncoder::encode(const HydrophoneSamples& samples, HydrophoneSamplesCompressed& compressed)
+{
+  const size_t frames = samples.channels > 0 && samples.samples > 0 ?
+                            std::min<size_t>(samples.samples, samples.data.size() / samples.channels) :
+                            0;
+  compressed.channels = samples.channels;
+  compressed.samples = frames;
+  compressed.sample_rate = samples.sample_rate;
+  compressed.block_size = block_size_;
+  encode(samples.data.data(), std::max(samples.channels, 0), frames, compressed.data);
+}
+
+bool decode_samples(const uint8_t* data, size_t size, size_t channels, size_t frames, size_t block_size,
+                    int16_t* samples)
+{
+  if (!block_size)
+    return false;
+  BitReader reader(data, size);
+  for (size_t start = 0; start < frames; start += block_size)
+  {
+    const size_t n = std::min(block_size, frames - start);
+    for (size_t c = 0; c < channels; ++c)
+    {
+      int16_t* out = samples + start * channels + c;
+      uint32_t order, value;
+      if (!reader.get(2, order))
+        return false;
+      if (order == VERBATIM)
+      {
+        for (size_t i = 0; i < n; ++i)
+        {
+          if (!reader.get(16, value))
+            return false;
+          out[i * channels] = static_cast<int16_t>(value);
+        }
+        continue;
+      }
+
+      uint32_t k;
+      if (!reader.get(5, k) || k > MAX_RICE)
+        return false;
+      // The last two samples, which the predictors work from
+      int32_t last = 0, before_last = 0;
+      for (size_t i = 0; i < std::min<size_t>(order, n); ++i)
+      {
+        if (!reader.get(16, value))
+          return false;
+        before_last = last;
+        last = static_cast<int16_t>(value);
+        out[i * channels] = static_cast<int16_t>(last);
+      }
+      for (size_t i = order; i < n; ++i)
+      {
+        uint32_t q = 0, bit;
+        while (q < ESCAPE)
+        {
+          if (!reader.get(1, bit))
+            return false;
+          if (!bit)
+            break;
+          ++q;
+        }
+        uint32_t u;
+        if (q == ESCAPE)
+        {
+          if (!reader.get(ESCAPE_BITS, u))
+            return false;
+        }
+        else
+        {
+          if (!reader.get(k, u))
+            return false;
+          u |= q << k;
+        }
+        const int32_t r = static_cast<int32_t>(u >> 1) ^ -static_cast<int32_t>(u & 1);
+        const int32_t prediction = order == 0 ? 0 : order == 1 ? last : 2 * last - before_last;
+        const int32_t sample = prediction + r;
+        if (sample < INT16_MIN || sample > INT16_MAX)
+          return false;
+        before_last = last;
+        last = sample;
+        out[i * channels] = static_cast<int16_t>(sample);
+      }
+    }
+  }
+  return true;
+}
+
+bool decode_samples(const HydrophoneSamplesCompressed& compressed, HydrophoneSamples& samples)
+{
+  if (compressed.channels <= 0 || compressed.samples < 0 || compressed.block_size <= 0)
+    return false;
+  // Every sample takes at least a bit, which bounds what a corrupt header can allocate
+  const size_t count = size_t(compressed.channels) * size_t(compressed.samples);
+  if (count > 8 * compressed.data.size())
+    return false;
+  samples.channels = compressed.channels;
+  samples.samples = compressed.samples;
+  samples.sample_rate = compressed.sample_rate;
+  samples.data.resize(count);
+  return decode_samples(compressed.data.data(), compressed.data.size(), compressed.channels, compressed.samples,
+                        compressed.block_size, samples.data.data());
+}
+
+}  // namespace mil_passive_sonar
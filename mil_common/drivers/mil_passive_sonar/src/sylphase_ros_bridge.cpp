@@ -1,10 +1,27 @@
 /* ROS node to read in the TCP stream produced by the Sylphase passive sonar board
  * and publish it to ROS as a mil_passive_sonar/HydrophoneSamples message
  */
-#include <arpa/inet.h>
+#include <geometry_msgs/Vector3Stamped.h>
+#include <mil_passive_sonar/HydrophoneSamplesCompressedStamped.h>
 #include <mil_passive_sonar/HydrophoneSamplesStamped.h>
+#include <mil_passive_sonar/PingTdoa.h>
+#include <mil_passive_sonar/Triggered.h>
+#include <mil_passive_sonar/ping_processor.hpp>
+#include <mil_passive_sonar/sample_codec.hpp>
+#include <mil_tools/driver_diagnostics.hpp>
+#include <mil_tools/raw_capture.hpp>
 #include <ros/ros.h>
+#include <algorithm>
 #include <boost/asio.hpp>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 
 /// Class representing the node. Could easily be made into a Nodelet
 class SylphaseSonarToRosNode
@@ -16,28 +33,101 @@ public:
   const size_t CHANNELS = 4;
 
   SylphaseSonarToRosNode(ros::NodeHandle nh, ros::NodeHandle private_nh);
+  ~SylphaseSonarToRosNode();
 
-  /// Wait forever streaming messages
+  /// Wait forever streaming messages, or until the end of ~replay_file if one is given
   void run();
 
 private:
+  typedef mil_passive_sonar::HydrophoneSamplesStampedPtr Buffer;
+  /// Reads some bytes into the buffer, setting now to when they arrived, and returns how many or 0 at the end
+  typedef std::function<size_t(const boost::asio::mutable_buffers_1&, ros::Time& now)> ReadFunction;
+
   /// Connect to the socket
   boost::asio::ip::tcp::socket connect();
-  /// Wait forever reading messages and publishing that
-  void read_messages(boost::asio::ip::tcp::socket& socket);
+  /// Stream messages from the socket until it fails, writing what it reads to capture_ if capturing
+  void read_socket(boost::asio::ip::tcp::socket& socket);
+  /// Stream messages from ~replay_file, paced as it was captured or as fast as they are published
+  void replay();
+  /// Read messages until read returns 0 or ROS shuts down, queueing them to be published
+  void read_messages(const ReadFunction& read);
+  /// Allocate a message big enough for seconds_per_message_ of samples
+  Buffer make_buffer() const;
+  /// Buffer to fill next. When every buffer is full and waiting to be published, the oldest is dropped and reused,
+  /// except when replaying, which waits for one to be published instead so none are lost.
+  Buffer next_buffer();
+  /// Run by publish_thread_: byte swap and publish the full buffers as they are queued
+  void publish_buffers();
+  /// Configure processor_ from the parameters, if pings are to be found in this node
+  void init_processor();
+  /// Find the pings in a byte swapped buffer and publish their delays, direction and samples
+  void process_buffer(const Buffer& buffer);
+  /// Compress a byte swapped buffer and publish it on compressed_pub_
+  void publish_compressed(const Buffer& buffer);
 
   ros::NodeHandle nh_;
   ros::NodeHandle private_nh_;
   ros::Publisher pub_;
-  mil_passive_sonar::HydrophoneSamplesStamped msg;
   std::string frame_id_;
   std::string ip_;
   int port_;
   double seconds_per_message_;
+  mil_tools::RawCaptureOptions capture_options_;
+  std::unique_ptr<mil_tools::RawCaptureWriter> capture_;
+
+  /// Samples are read into one buffer while those filled before are byte swapped and published by publish_thread_,
+  /// so the socket is read while a message is published. Buffers are only reused once the last subscriber lets go.
+  size_t max_buffers_;
+  size_t allocated_buffers_ = 0;
+  std::deque<Buffer> full_buffers_;
+  std::deque<Buffer> free_buffers_;
+  Buffer filling_;
+  /// Full buffers dropped because publishing fell behind
+  size_t overruns_ = 0;
+  bool stop_ = false;
+  std::mutex buffers_mutex_;
+  std::condition_variable full_cv_;
+  std::condition_variable free_cv_;
+  std::thread publish_thread_;
+
+  /// Finds the pings in the stream on publish_thread_, in place of the triggering and ping_locator nodes. The samples
+  /// are then only published while something subscribes to them.
+  std::unique_ptr<mil_passive_sonar::PingProcessor> processor_;
+  std::vector<mil_passive_sonar::DetectedPing> pings_;
+  uint32_t processed_seq_ = 0;
+  ros::Publisher tdoa_pub_;
+  ros::Publisher direction_pub_;
+  ros::Publisher pings_pub_;
+
+  /// With ~publish_compressed, the samples are also published compressed without loss on samples_compressed, while
+  /// something subscribes to them. Only used on publish_thread_, which reuses the message once subscribers let go.
+  std::unique_ptr<mil_passive_sonar::SampleEncoder> encoder_;
+  ros::Publisher compressed_pub_;
+  mil_passive_sonar::HydrophoneSamplesCompressedStampedPtr compressed_;
+
+  /// Latency from the last sample of a message being taken to its publishing, and from a ping's onset to its TDOA's
+  std::unique_ptr<mil_tools::DriverDiagnostics> diagnostics_;
+  mil_tools::StreamMonitor* samples_monitor_;
+  mil_tools::StreamMonitor* tdoa_monitor_ = nullptr;
 };
 
+/// Convert big-endian samples to the host's byte order, in a loop the compiler vectorizes
+static void samples_to_host(int16_t* data, size_t count)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint16_t* samples = reinterpret_cast<uint16_t*>(data);
+  for (size_t i = 0; i < count; ++i)
+    samples[i] = static_cast<uint16_t>((samples[i] >> 8) | (samples[i] << 8));
+#endif
+}
+
 void SylphaseSonarToRosNode::run()
 {
+  if (!capture_options_.replay_file.empty())
+  {
+    replay();
+    return;
+  }
   while (ros::ok())
   {
     try
@@ -45,7 +135,7 @@ void SylphaseSonarToRosNode::run()
       // Connect to Sylphase TCP socket
       auto socket = connect();
       // Read messages infinitely
-      read_messages(socket);
+      read_socket(socket);
     }
     catch (boost::system::system_error const& e)
     {
@@ -67,6 +157,232 @@ SylphaseSonarToRosNode::SylphaseSonarToRosNode(ros::NodeHandle nh, ros::NodeHand
   port_ = private_nh.param<int>("port", 10001);
   frame_id_ = private_nh.param<std::string>("frame", "hydrophones");
   seconds_per_message_ = private_nh.param<double>("seconds_to_capture", 0.1);
+  max_buffers_ = std::max(2, private_nh.param<int>("buffers", 3));
+  capture_options_ = mil_tools::RawCaptureOptions::from_params(private_nh);
+  if (!capture_options_.capture_file.empty() && capture_options_.replay_file.empty())
+  {
+    try
+    {
+      capture_.reset(new mil_tools::RawCaptureWriter(capture_options_.capture_file));
+    }
+    catch (const std::runtime_error& e)
+    {
+      ROS_ERROR_STREAM("Not capturing: " << e.what());
+    }
+  }
+  diagnostics_.reset(new mil_tools::DriverDiagnostics(nh, private_nh, ros::this_node::getName(),
+                                                      ip_ + ":" + std::to_string(port_)));
+  samples_monitor_ = &diagnostics_->stream("samples");
+  if (private_nh.param<bool>("process_pings", false))
+    init_processor();
+  if (private_nh.param<bool>("publish_compressed", false))
+  {
+    int block_size = std::max(1, private_nh.param<int>("compressed_block_size", 4096));
+    encoder_.reset(new mil_passive_sonar::SampleEncoder(block_size));
+    compressed_pub_ = nh.advertise<mil_passive_sonar::HydrophoneSamplesCompressedStamped>("samples_compressed", 1);
+  }
+  publish_thread_ = std::thread(&SylphaseSonarToRosNode::publish_buffers, this);
+}
+
+SylphaseSonarToRosNode::~SylphaseSonarToRosNode()
+{
+  {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    stop_ = true;
+  }
+  full_cv_.notify_all();
+  free_cv_.notify_all();
+  publish_thread_.join();
+}
+
+SylphaseSonarToRosNode::Buffer SylphaseSonarToRosNode::make_buffer() const
+{
+  const size_t SAMPLES_TO_CAPTURE_PER_CHANNEL = seconds_per_message_ * SAMPLES_PER_SECOND;
+  Buffer buffer(new mil_passive_sonar::HydrophoneSamplesStamped());
+  buffer->header.frame_id = frame_id_;
+  buffer->hydrophone_samples.channels = CHANNELS;
+  buffer->hydrophone_samples.samples = SAMPLES_TO_CAPTURE_PER_CHANNEL;
+  buffer->hydrophone_samples.sample_rate = SAMPLES_PER_SECOND;
+  buffer->hydrophone_samples.data.resize(CHANNELS * SAMPLES_TO_CAPTURE_PER_CHANNEL);
+  return buffer;
+}
+
+SylphaseSonarToRosNode::Buffer SylphaseSonarToRosNode::next_buffer()
+{
+  std::unique_lock<std::mutex> lock(buffers_mutex_);
+  if (!capture_options_.replay_file.empty())
+    free_cv_.wait(lock, [this] {
+      return stop_ || !free_buffers_.empty() || allocated_buffers_ < max_buffers_ || full_buffers_.empty();
+    });
+  Buffer buffer;
+  if (!free_buffers_.empty())
+  {
+    buffer = free_buffers_.front();
+    free_buffers_.pop_front();
+  }
+  else if (allocated_buffers_ < max_buffers_ || full_buffers_.empty())
+  {
+    // The only other buffers are being published or still held by subscribers
+    ++allocated_buffers_;
+    return make_buffer();
+  }
+  else
+  {
+    buffer = full_buffers_.front();
+    full_buffers_.pop_front();
+    ++overruns_;
+    samples_monitor_->dropped();
+    ROS_WARN_STREAM_THROTTLE(1.0, "Publishing hydrophone samples fell behind, dropped message "
+                                      << buffer->header.seq << " (" << overruns_ << " dropped so far)");
+  }
+  return buffer;
+}
+
+void SylphaseSonarToRosNode::publish_buffers()
+{
+  std::unique_lock<std::mutex> lock(buffers_mutex_);
+  while (true)
+  {
+    full_cv_.wait(lock, [this] { return stop_ || !full_buffers_.empty(); });
+    if (stop_)
+      return;
+    Buffer buffer = full_buffers_.front();
+    full_buffers_.pop_front();
+    lock.unlock();
+
+    // Received packets are Big-Endian, convert to system
+    samples_to_host(buffer->hydrophone_samples.data.data(), buffer->hydrophone_samples.data.size());
+    if (processor_)
+      process_buffer(buffer);
+    if (!processor_ || pub_.getNumSubscribers() > 0)
+      pub_.publish(buffer);
+    if (encoder_ && compressed_pub_.getNumSubscribers() > 0)
+      publish_compressed(buffer);
+    samples_monitor_->published(buffer->header.stamp + ros::Duration(seconds_per_message_));
+
+    lock.lock();
+    // Intraprocess subscribers may keep the message, in which case it is replaced by a new one
+    if (buffer.unique() && allocated_buffers_ <= max_buffers_)
+      free_buffers_.push_back(buffer);
+    else
+      --allocated_buffers_;
+    free_cv_.notify_one();
+  }
+}
+
+void SylphaseSonarToRosNode::init_processor()
+{
+  mil_passive_sonar::PingProcessor::Config config;
+  config.channels = CHANNELS;
+  config.sample_rate = SAMPLES_PER_SECOND;
+  config.frequency = private_nh_.param<double>("target_frequency", config.frequency);
+  config.bandwidth = 2 * private_nh_.param<double>("frequency_tolerance", config.bandwidth / 2);
+  config.filter_sections = std::max(1, private_nh_.param<int>("filter_sections", config.filter_sections));
+  config.threshold = private_nh_.param<double>("onset_threshold", config.threshold);
+  config.min_time_between_pings = private_nh_.param<double>("min_time_between_pings", config.min_time_between_pings);
+  config.window_before = private_nh_.param<double>("window_before", config.window_before);
+  config.window_after = private_nh_.param<double>("window_after", config.window_after);
+  config.min_confidence = private_nh_.param<double>("min_confidence", config.min_confidence);
+  config.speed_of_sound = nh_.param<double>("v_sound", config.speed_of_sound);
+
+  // Same arrangement as the ping_locator node assumes, unless every position is given as x, y, z of each hydrophone
+  const double dist_h = nh_.param<double>("dist_h", 2.286E-2);
+  const double dist_h4 = nh_.param<double>("dist_h4", dist_h);
+  config.positions.setZero(3, CHANNELS);
+  config.positions.col(1) << dist_h, 0, 0;
+  config.positions.col(2) << -dist_h, 0, 0;
+  config.positions.col(3) << 0, dist_h4, 0;
+  std::vector<double> positions;
+  if (private_nh_.getParam("hydrophone_positions", positions))
+  {
+    if (positions.size() == 3 * CHANNELS)
+      config.positions = Eigen::Map<Eigen::Matrix3Xd>(positions.data(), 3, CHANNELS);
+    else
+      ROS_ERROR_STREAM("~hydrophone_positions needs x, y and z of each of the " << CHANNELS
+                                                                                << " hydrophones, ignoring it");
+  }
+
+  try
+  {
+    processor_.reset(new mil_passive_sonar::PingProcessor(config));
+  }
+  catch (const std::invalid_argument& e)
+  {
+    ROS_ERROR_STREAM("Not processing pings: " << e.what());
+    return;
+  }
+  tdoa_pub_ = nh_.advertise<mil_passive_sonar::PingTdoa>("tdoa", 10);
+  tdoa_monitor_ = &diagnostics_->stream("tdoa", true);
+  direction_pub_ = nh_.advertise<geometry_msgs::Vector3Stamped>("direction", 10);
+  pings_pub_ = nh_.advertise<mil_passive_sonar::Triggered>("pings", 1);
+}
+
+void SylphaseSonarToRosNode::process_buffer(const Buffer& buffer)
+{
+  // Only consecutive messages are one stream, a dropped one or a new connection starts a new one
+  if (buffer->header.seq != processed_seq_ + 1)
+    processor_->reset();
+  processed_seq_ = buffer->header.seq;
+
+  const int64_t first_frame = processor_->frames();
+  pings_.clear();
+  processor_->process(buffer->hydrophone_samples.data.data(), buffer->hydrophone_samples.samples, pings_);
+
+  for (const mil_passive_sonar::DetectedPing& ping : pings_)
+  {
+    mil_passive_sonar::PingTdoa msg;
+    msg.header.frame_id = frame_id_;
+    // The onset may be in the message before
+    msg.header.stamp =
+        buffer->header.stamp + ros::Duration(double(int64_t(ping.onset_frame) - first_frame) / SAMPLES_PER_SECOND);
+    msg.frequency = ping.frequency;
+    msg.amplitude = ping.amplitude;
+    msg.tdoa = ping.tdoa;
+    msg.tdoa_confidence = ping.confidence;
+    msg.direction_valid = ping.direction_valid;
+    msg.direction.x = ping.direction.x();
+    msg.direction.y = ping.direction.y();
+    msg.direction.z = ping.direction.z();
+    msg.heading = std::atan2(ping.direction.y(), ping.direction.x());
+    msg.declination = std::atan2(-ping.direction.z(), ping.direction.head<2>().norm());
+    tdoa_pub_.publish(msg);
+    tdoa_monitor_->published(msg.header.stamp);
+    ROS_DEBUG_STREAM("Ping at " << ping.frequency << " Hz, heading " << msg.heading << " declination "
+                                << msg.declination << (ping.direction_valid ? "" : " (invalid)"));
+
+    if (ping.direction_valid)
+    {
+      geometry_msgs::Vector3Stamped direction;
+      direction.header = msg.header;
+      direction.vector = msg.direction;
+      direction_pub_.publish(direction);
+    }
+
+    if (pings_pub_.getNumSubscribers() > 0)
+    {
+      mil_passive_sonar::Triggered triggered;
+      triggered.header = msg.header;
+      triggered.hydrophone_samples.channels = CHANNELS;
+      triggered.hydrophone_samples.samples = ping.window.size() / CHANNELS;
+      triggered.hydrophone_samples.sample_rate = SAMPLES_PER_SECOND;
+      triggered.hydrophone_samples.data = ping.window;
+      // Onset relative to the center of the window
+      triggered.trigger_time =
+          (double(ping.onset_frame - ping.window_start_frame) - 0.5 * triggered.hydrophone_samples.samples) /
+          SAMPLES_PER_SECOND;
+      pings_pub_.publish(triggered);
+    }
+  }
+}
+
+void SylphaseSonarToRosNode::publish_compressed(const Buffer& buffer)
+{
+  // Intraprocess subscribers may keep the message, in which case a new one is compressed into
+  if (!compressed_ || !compressed_.unique())
+    compressed_.reset(new mil_passive_sonar::HydrophoneSamplesCompressedStamped());
+  compressed_->header = buffer->header;
+  encoder_->encode(buffer->hydrophone_samples, compressed_->hydrophone_samples);
+  compressed_pub_.publish(compressed_);
 }
 
 boost::asio::ip::tcp::socket SylphaseSonarToRosNode::connect()
@@ -80,51 +396,101 @@ boost::asio::ip::tcp::socket SylphaseSonarToRosNode::connect()
   return socket;
 }
 
-void SylphaseSonarToRosNode::read_messages(boost::asio::ip::tcp::socket& socket)
+void SylphaseSonarToRosNode::read_socket(boost::asio::ip::tcp::socket& socket)
 {
-  const size_t SAMPLES_TO_CAPTURE_PER_CHANNEL = seconds_per_message_ * SAMPLES_PER_SECOND;
-  const size_t SAMPLES_TO_CAPTURE = CHANNELS * SAMPLES_TO_CAPTURE_PER_CHANNEL;
-  const size_t BYTES_TO_CAPTURE = sizeof(uint16_t) * SAMPLES_TO_CAPTURE;
+  read_messages([this, &socket](const boost::asio::mutable_buffers_1& buffer, ros::Time& now) -> size_t {
+    size_t bytes_read = socket.read_some(buffer);
+    now = ros::Time::now();
+    if (capture_)
+    {
+      try
+      {
+        capture_->append(now, boost::asio::buffer_cast<const uint8_t*>(buffer), bytes_read);
+      }
+      catch (const std::runtime_error& e)
+      {
+        ROS_ERROR_STREAM("Stopped capturing: " << e.what());
+        capture_.reset();
+      }
+    }
+    return bytes_read;
+  });
+}
 
-  // Pre-allocate message
-  mil_passive_sonar::HydrophoneSamplesStamped msg;
-  msg.header.frame_id = frame_id_;
-  msg.header.seq = 0;
-  msg.hydrophone_samples.channels = CHANNELS;
-  msg.hydrophone_samples.samples = SAMPLES_TO_CAPTURE_PER_CHANNEL;
-  msg.hydrophone_samples.sample_rate = SAMPLES_PER_SECOND;
-  msg.hydrophone_samples.data.resize(SAMPLES_TO_CAPTURE);
+void SylphaseSonarToRosNode::replay()
+{
+  std::unique_ptr<mil_tools::RawCaptureReplay> replay;
+  try
+  {
+    replay.reset(new mil_tools::RawCaptureReplay(capture_options_.replay_file, capture_options_.replay_speed));
+  }
+  catch (const std::runtime_error& e)
+  {
+    ROS_ERROR_STREAM("Can not replay: " << e.what());
+    return;
+  }
+  ROS_INFO_STREAM("Replaying " << capture_options_.replay_file);
+  read_messages([&replay](const boost::asio::mutable_buffers_1& buffer, ros::Time& now) -> size_t {
+    ros::WallTime due;
+    if (!replay->next_due(due))
+      return 0;
+    ros::WallDuration wait = due - ros::WallTime::now();
+    if (wait > ros::WallDuration())
+      wait.sleep();
+    return replay->read(boost::asio::buffer_cast<uint8_t*>(buffer), boost::asio::buffer_size(buffer), now);
+  });
+
+  // Let the last messages be published, rather than dropped by the destructor
+  std::unique_lock<std::mutex> lock(buffers_mutex_);
+  free_cv_.wait(lock, [this] { return stop_ || full_buffers_.empty(); });
+  ROS_INFO_STREAM("Finished replaying " << capture_options_.replay_file);
+}
+
+void SylphaseSonarToRosNode::read_messages(const ReadFunction& read)
+{
+  const size_t BYTES_PER_SAMPLE_SET = sizeof(uint16_t) * CHANNELS;
 
-  auto buffer = boost::asio::buffer(msg.hydrophone_samples.data);
-  bool first_packet = true;
+  // A message cut short by a dropped connection is started over
+  if (!filling_)
+    filling_ = next_buffer();
+  auto buffer = boost::asio::buffer(filling_->hydrophone_samples.data);
+
+  // Samples are stamped from their index in the stream and the sample rate. The last sample read can not have been
+  // taken after it arrived, so the start of the stream is moved back whenever the sample clock would put it in the
+  // future, leaving the stamps behind by the smallest delay seen.
+  ros::Time stream_start;
+  uint64_t bytes_received = 0;
+  uint64_t message_start_byte = 0;
+  uint32_t seq = 0;
 
   while (ros::ok())
   {
-    // If the buffer is now full, ship the message off
+    // If the buffer is now full, queue the message to be published
     if (!boost::asio::buffer_size(buffer))
     {
-      // Received packets are Big-Endian, convert to system
-      for (size_t i = 0; i < msg.hydrophone_samples.data.size(); ++i)
+      filling_->header.seq = ++seq;
+      filling_->header.stamp =
+          stream_start + ros::Duration(double(message_start_byte / BYTES_PER_SAMPLE_SET) / SAMPLES_PER_SECOND);
       {
-        msg.hydrophone_samples.data[i] = ntohs(msg.hydrophone_samples.data[i]);
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        full_buffers_.push_back(filling_);
       }
-      ++msg.header.seq;
-      pub_.publish(msg);
+      full_cv_.notify_one();
 
-      // Reset the buffer to the start of the vector and reset first_packet
-      buffer = boost::asio::buffer(msg.hydrophone_samples.data);
-      first_packet = true;
+      filling_ = next_buffer();
+      buffer = boost::asio::buffer(filling_->hydrophone_samples.data);
+      message_start_byte = bytes_received;
     }
 
     // Read up to the remaining size of the buffer or how ever many are available in the socket
-    size_t bytes_read = socket.read_some(buffer);
-    // If this is the first packet for this message, store now as the message time
-    // as it will be close to the beginning
-    if (first_packet)
-    {
-      msg.header.stamp = ros::Time::now();
-      first_packet = false;
-    }
+    ros::Time now;
+    size_t bytes_read = read(buffer, now);
+    if (!bytes_read)
+      return;
+    bytes_received += bytes_read;
+    ros::Duration stream_length(double(bytes_received / BYTES_PER_SAMPLE_SET) / SAMPLES_PER_SECOND);
+    if (stream_start.isZero() || stream_start + stream_length > now)
+      stream_start = now - stream_length;
 
     // Move the buffer forward by the number of bytes read
     buffer = boost::asio::buffer(buffer + bytes_read);
@@ -138,6 +504,10 @@ int main(int argc, char** argv)
   ros::NodeHandle nh;
   ros::NodeHandle private_nh("~");
 
+  // run() never returns to spin, so the diagnostics timer gets a thread of its own
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
   SylphaseSonarToRosNode node(nh, private_nh);
   node.run();
 }
@@ -0,0 +1,114 @@
+#ifndef GUARD_QFMZTRWCXJBLGUPA
+#define GUARD_QFMZTRWCXJBLGUPA
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <tf2_msgs/TFMessage.h>
+
+#include "odom_estimator/node_impl.h"
+
+namespace odom_estimator
+{
+// wraps one update of the node from a bag, which it must call. kind is imu,
+// mag, dvl or depth.
+typedef boost::function<void(std::string const &kind, boost::function<void()> const &update)> ReplayRunner;
+
+// feeds the IMU, magnetometer, DVL and depth messages of bag to node through
+// run as fast as it takes them, rather than at the rate they were recorded.
+// Topics are the nodelet's, resolved in nh, so remap them as usual. Static
+// transforms are loaded up front, and any other measurement is held until a
+// transform newer than it has been read, as tf::MessageFilter does. Messages
+// on extra_topics go to extra as they are read. Returns how many
+// measurements were skipped without a later transform.
+size_t replay_bag(rosbag::Bag &bag, ros::NodeHandle &nh, NodeImpl &node, ReplayRunner const &run,
+                  std::vector<std::string> const &extra_topics = std::vector<std::string>(),
+                  boost::function<void(rosbag::MessageInstance const &)> const &extra =
+                      boost::function<void(rosbag::MessageInstance const &)>())
+{
+  std::string const imu_topic = nh.resolveName("imu/data_raw");
+  std::string const mag_topic = nh.resolveName("imu/mag");
+  std::string const dvl_topic = nh.resolveName("dvl");
+  std::string const depth_topic = nh.resolveName("depth");
+
+  rosbag::View static_view(bag, rosbag::TopicQuery("/tf_static"));
+  for (rosbag::MessageInstance const &message : static_view)
+  {
+    tf2_msgs::TFMessageConstPtr transforms = message.instantiate<tf2_msgs::TFMessage>();
+    if (transforms)
+      for (geometry_msgs::TransformStamped const &transform : transforms->transforms)
+        node.add_transform(transform, true);
+  }
+  bool const dynamic_transforms = rosbag::View(bag, rosbag::TopicQuery("/tf")).size() > 0;
+
+  std::vector<std::string> topics = { "/tf", imu_topic, mag_topic, dvl_topic, depth_topic };
+  topics.insert(topics.end(), extra_topics.begin(), extra_topics.end());
+  rosbag::View view(bag, rosbag::TopicQuery(topics));
+
+  std::deque<std::pair<ros::Time, boost::function<void()>>> pending;
+  ros::Time latest_transform;
+  for (rosbag::MessageInstance const &message : view)
+  {
+    if (!ros::ok())
+      break;
+    std::string const &topic = message.getTopic();
+    if (topic == "/tf")
+    {
+      tf2_msgs::TFMessageConstPtr transforms = message.instantiate<tf2_msgs::TFMessage>();
+      if (!transforms)
+        continue;
+      for (geometry_msgs::TransformStamped const &transform : transforms->transforms)
+      {
+        node.add_transform(transform, false);
+        latest_transform = std::max(latest_transform, transform.header.stamp);
+      }
+    }
+    else if (topic == imu_topic)
+    {
+      sensor_msgs::ImuConstPtr msg = message.instantiate<sensor_msgs::Imu>();
+      if (msg)
+        pending.push_back(std::make_pair(
+            msg->header.stamp, [&node, &run, msg]() { run("imu", [&node, &msg]() { node.got_imu(msg); }); }));
+    }
+    else if (topic == mag_topic)
+    {
+      sensor_msgs::MagneticFieldConstPtr msg = message.instantiate<sensor_msgs::MagneticField>();
+      if (msg)
+        pending.push_back(std::make_pair(
+            msg->header.stamp, [&node, &run, msg]() { run("mag", [&node, &msg]() { node.got_mag(msg); }); }));
+    }
+    else if (topic == dvl_topic)
+    {
+      mil_msgs::VelocityMeasurementsConstPtr msg = message.instantiate<mil_msgs::VelocityMeasurements>();
+      if (msg)
+        pending.push_back(std::make_pair(
+            msg->header.stamp, [&node, &run, msg]() { run("dvl", [&node, &msg]() { node.got_dvl(msg); }); }));
+    }
+    else if (topic == depth_topic)
+    {
+      mil_msgs::DepthStampedConstPtr msg = message.instantiate<mil_msgs::DepthStamped>();
+      if (msg)
+        pending.push_back(std::make_pair(
+            msg->header.stamp, [&node, &run, msg]() { run("depth", [&node, &msg]() { node.got_depth(msg); }); }));
+    }
+    if (extra && std::find(extra_topics.begin(), extra_topics.end(), topic) != extra_topics.end())
+      extra(message);
+
+    while (!pending.empty() && (!dynamic_transforms || pending.front().first < latest_transform))
+    {
+      pending.front().second();
+      pending.pop_front();
+    }
+  }
+  return pending.size();
+}
+}
+
+#endif
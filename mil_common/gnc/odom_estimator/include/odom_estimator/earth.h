@@ -44,6 +44,63 @@ Vec<3> ecef_acc_from_inertial_acc(double t, Vec<3> eci_acc, Vec<3> eci_pos)
   return quat_from_rotvec(-w_E * t) * (eci_acc - w_E.cross(w_E.cross(eci_pos)));
 }
 
+// is the Earth's rotation at time t, for transforming many points at the same
+// time, such as every sigma point of a filter step, without recomputing it.
+// Gives exactly the results of the functions above.
+class EarthFrame
+{
+  double t_;
+  Quaternion inertial_from_ecef_;
+  Quaternion ecef_from_inertial_;
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  explicit EarthFrame(double t)
+    : t_(t), inertial_from_ecef_(quat_from_rotvec(w_E * t)), ecef_from_inertial_(quat_from_rotvec(-w_E * t))
+  {
+  }
+
+  double t() const
+  {
+    return t_;
+  }
+
+  Vec<3> inertial_from_ecef(Vec<3> ecef_pos) const
+  {
+    return inertial_from_ecef_ * ecef_pos;
+  }
+  Vec<3> inertial_vel_from_ecef_vel(Vec<3> ecef_vel, Vec<3> eci_pos) const
+  {
+    return inertial_from_ecef_ * ecef_vel + w_E.cross(eci_pos);
+  }
+  Quaternion inertial_orient_from_ecef_orient(Quaternion ecef_orient) const
+  {
+    return inertial_from_ecef_ * ecef_orient;
+  }
+  Vec<3> inertial_acc_from_ecef_acc(Vec<3> ecef_acc, Vec<3> eci_pos) const
+  {
+    return inertial_from_ecef_ * ecef_acc + w_E.cross(w_E.cross(eci_pos));
+  }
+
+  Vec<3> ecef_from_inertial(Vec<3> eci_pos) const
+  {
+    return ecef_from_inertial_ * eci_pos;
+  }
+  Vec<3> ecef_vel_from_inertial_vel(Vec<3> eci_vel, Vec<3> eci_pos) const
+  {
+    return ecef_from_inertial_ * (eci_vel - w_E.cross(eci_pos));
+  }
+  Quaternion ecef_orient_from_inertial_orient(Quaternion inertial_orient) const
+  {
+    return ecef_from_inertial_ * inertial_orient;
+  }
+  Vec<3> ecef_acc_from_inertial_acc(Vec<3> eci_acc, Vec<3> eci_pos) const
+  {
+    return ecef_from_inertial_ * (eci_acc - w_E.cross(w_E.cross(eci_pos)));
+  }
+};
+
 SqMat<3> enu_from_ecef_mat(Vec<3> zero_pos_ecef)
 {
   double x = zero_pos_ecef(0), y = zero_pos_ecef(1), z = zero_pos_ecef(2);
@@ -80,6 +137,27 @@ SqMat<3> enu_from_ecef_mat(Vec<3> zero_pos_ecef)
   Vec<3> north_ecef = (Vec<3>() << -sin_lat * cos_lon, -sin_lat * sin_lon, cos_lat).finished();
   return (SqMat<3>() << east_ecef, north_ecef, up_ecef).finished().transpose();
 }
+
+// is enu_from_ecef_mat with its value at origin_ecef computed up front. Most
+// of a filter step's sigma points leave the position at the mean's, so with
+// the mean as the origin they all share the one solution.
+class EnuFrame
+{
+  Vec<3> origin_ecef_;
+  SqMat<3> enu_from_ecef_origin_;
+
+public:
+  explicit EnuFrame(Vec<3> origin_ecef) : origin_ecef_(origin_ecef), enu_from_ecef_origin_(enu_from_ecef_mat(origin_ecef))
+  {
+  }
+
+  SqMat<3> enu_from_ecef(Vec<3> const &pos_ecef) const
+  {
+    if (pos_ecef == origin_ecef_)
+      return enu_from_ecef_origin_;
+    return enu_from_ecef_mat(pos_ecef);
+  }
+};
 }
 
 #endif
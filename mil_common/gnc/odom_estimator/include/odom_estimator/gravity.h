@@ -23,6 +23,57 @@ Vec<3> gravity(Vec<3> pos)
              pos_bar.cwiseProduct(
                  Vec<3>(1 - 5 * pow(pos_bar[2], 2), 1 - 5 * pow(pos_bar[2], 2), 3 - 5 * pow(pos_bar[2], 2)));
 }
+
+SqMat<3> gravity_jacobian(Vec<3> pos)
+{
+  // by central differences, whose error is far below the expansion's at the
+  // distances LocalGravity is used over
+  SqMat<3> res;
+  for (int i = 0; i < 3; i++)
+  {
+    Vec<3> step = Vec<3>::Unit(i) * 10;
+    res.col(i) = (gravity(pos + step) - gravity(pos - step)) / 20;
+  }
+  return res;
+}
+
+// evaluates gravity through a first order expansion about a reference point.
+// gravity() is symmetric about the Earth's axis, so in ECI it doesn't depend
+// on time, and the expansion only has to be redone once the position gets
+// more than max_distance meters from the point. The error grows with the
+// square of the distance, to about 1e-6 m/s^2 at 1 km (see test_gravity).
+// update() is called from one thread, between evaluations; operator() is
+// const and can be called concurrently.
+class LocalGravity
+{
+  double max_distance;
+  bool valid;
+  Vec<3> pos0;
+  Vec<3> gravity0;
+  SqMat<3> jacobian0;
+
+public:
+  explicit LocalGravity(double max_distance = 1000) : max_distance(max_distance), valid(false)
+  {
+  }
+
+  // expands about pos if it's too far from the last point expanded about
+  void update(Vec<3> const &pos)
+  {
+    if (valid && (pos - pos0).norm() <= max_distance)
+      return;
+    valid = true;
+    pos0 = pos;
+    gravity0 = gravity(pos);
+    jacobian0 = gravity_jacobian(pos);
+  }
+
+  Vec<3> operator()(Vec<3> const &pos) const
+  {
+    assert(valid);
+    return gravity0 + jacobian0 * (pos - pos0);
+  }
+};
 }
 }
 
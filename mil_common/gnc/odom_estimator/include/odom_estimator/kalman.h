@@ -6,16 +6,14 @@
 
 namespace odom_estimator
 {
-// does a kalman update given error function `df`, which should return the
-// distribution of the difference between predicted values and measured values
+// does the update of kalman_update given the distribution of the error and
+// its cross covariance with the state
 template <typename InType, typename ErrorType>
-GaussianDistribution<InType> kalman_update(IDistributionFunction<InType, ErrorType> const &df,
-                                           GaussianDistribution<InType> const &input)
+GaussianDistribution<InType> kalman_gain_update(GaussianDistributionWithCrossCov<ErrorType, InType> const &res,
+                                                GaussianDistribution<InType> const &input)
 {
-  GaussianDistributionWithCrossCov<ErrorType, InType> res = df(input);
-
-  Mat<InType::RowsAtCompileTime, res.mean.RowsAtCompileTime> P_xz = res.cross_cov.transpose();
-  Mat<res.mean.RowsAtCompileTime, res.mean.RowsAtCompileTime> P_zz = res.cov;
+  Mat<InType::RowsAtCompileTime, ErrorType::RowsAtCompileTime> P_xz = res.cross_cov.transpose();
+  Mat<ErrorType::RowsAtCompileTime, ErrorType::RowsAtCompileTime> P_zz = res.cov;
 
   // Mat<InType::RowsAtCompileTime, res.mean.RowsAtCompileTime> K =
   //  P_xz * P_zz.inverse();
@@ -29,7 +27,7 @@ GaussianDistribution<InType> kalman_update(IDistributionFunction<InType, ErrorTy
   {
     return input;  // Eigen::MatrixBase::ldlt() crashes for zero-sized matrices
   }
-  Mat<InType::RowsAtCompileTime, res.mean.RowsAtCompileTime> K =
+  Mat<InType::RowsAtCompileTime, ErrorType::RowsAtCompileTime> K =
       P_zz.transpose().ldlt().solve(P_xz.transpose()).transpose();
 
   InType new_mean = input.mean + K * -res.mean;
@@ -37,6 +35,99 @@ GaussianDistribution<InType> kalman_update(IDistributionFunction<InType, ErrorTy
 
   return GaussianDistribution<InType>(new_mean, new_cov);
 }
+
+// does a kalman update given error function `df`, which should return the
+// distribution of the difference between predicted values and measured values
+template <typename InType, typename ErrorType>
+GaussianDistribution<InType> kalman_update(IDistributionFunction<InType, ErrorType> const &df,
+                                           GaussianDistribution<InType> const &input)
+{
+  return kalman_gain_update(df(input), input);
+}
+
+// does a kalman update given `func`, the error as a function of the state
+// alone, and the covariance of a noise that adds to it. Only the state is
+// sampled, so there are fewer sigma points than with the noise augmented
+// into them, and when the state and error are sized at compile time, so is
+// all of the math.
+template <typename ErrorType, typename InType, typename Func>
+GaussianDistribution<InType> additive_kalman_update(Func const &func,
+                                                    SqMat<ErrorType::RowsAtCompileTime> const &noise_cov,
+                                                    GaussianDistribution<InType> const &input,
+                                                    ThreadPool *pool = nullptr)
+{
+  GaussianDistributionWithCrossCov<ErrorType, InType> res =
+      SigmaPoints<InType>(input).template transform<ErrorType>(func, pool);
+  res.cov += noise_cov;
+  return kalman_gain_update(res, input);
+}
+
+// does the update of sqrt_kalman_update given the distribution of the error
+// and its cross covariance with the state
+template <typename InType, typename ErrorType>
+SqrtGaussianDistribution<InType>
+sqrt_kalman_gain_update(SqrtGaussianDistributionWithCrossCov<ErrorType, InType> const &res,
+                        SqrtGaussianDistribution<InType> const &input)
+{
+  if (res.mean.rows() == 0)
+  {
+    return input;
+  }
+
+  // K = P_xz P_zz^-1, with P_zz = S_zz S_zz^T, so
+  // K^T = S_zz^-T (S_zz^-1 P_xz^T), and P_xz^T = res.cross_cov
+  Mat<ErrorType::RowsAtCompileTime, InType::RowsAtCompileTime> S_zz_inv_P_zx =
+      res.sqrt_cov.template triangularView<Eigen::Lower>().solve(res.cross_cov);
+  Mat<InType::RowsAtCompileTime, ErrorType::RowsAtCompileTime> K =
+      res.sqrt_cov.transpose().template triangularView<Eigen::Upper>().solve(S_zz_inv_P_zx).transpose();
+
+  InType new_mean = input.mean + K * -res.mean;
+
+  // new_cov = cov - K P_zz K^T = cov - U U^T, with U = K S_zz
+  Mat<InType::RowsAtCompileTime, ErrorType::RowsAtCompileTime> U = K * res.sqrt_cov;
+  SqMat<InType::RowsAtCompileTime> new_sqrt_cov = input.sqrt_cov;
+  for (unsigned int i = 0; i < U.cols(); i++)
+  {
+    if (!cholesky_rank_update<InType::RowsAtCompileTime>(new_sqrt_cov, U.col(i), -1))
+    {
+      // the downdate lost definiteness, so fall back to factoring the covariance
+      return SqrtGaussianDistribution<InType>(GaussianDistribution<InType>(
+          new_mean, input.sqrt_cov * input.sqrt_cov.transpose() - U * U.transpose()));
+    }
+  }
+
+  return SqrtGaussianDistribution<InType>(new_mean, new_sqrt_cov);
+}
+
+// is kalman_update for a square root filter, which never forms or refactors
+// the covariance. The gain comes from triangular solves with the square root
+// of the innovation covariance, and the state's square root is downdated by
+// one rank 1 update per measurement dimension.
+template <typename InType, typename ErrorType, typename ExtraType>
+SqrtGaussianDistribution<InType>
+sqrt_kalman_update(UnscentedTransformDistributionFunction<InType, ErrorType, ExtraType> const &df,
+                   SqrtGaussianDistribution<InType> const &input)
+{
+  return sqrt_kalman_gain_update(df.sqrt_transform(input), input);
+}
+
+// is additive_kalman_update for a square root filter, given the square root
+// of the noise covariance
+template <typename ErrorType, typename InType, typename Func>
+SqrtGaussianDistribution<InType>
+sqrt_additive_kalman_update(Func const &func, SqMat<ErrorType::RowsAtCompileTime> const &sqrt_noise_cov,
+                            SqrtGaussianDistribution<InType> const &input, ThreadPool *pool = nullptr)
+{
+  static const int N = ErrorType::RowsAtCompileTime;
+
+  SqrtGaussianDistributionWithCrossCov<ErrorType, InType> res =
+      SigmaPoints<InType>(input).template sqrt_transform<ErrorType>(func, pool);
+  // S_zz S_zz^T + R = [S_zz sqrt(R)] [S_zz sqrt(R)]^T
+  Mat<N, addRowsAtCompileTime(N, N)> stacked(res.sqrt_cov.rows(), 2 * res.sqrt_cov.rows());
+  stacked << res.sqrt_cov, sqrt_noise_cov;
+  res.sqrt_cov = lower_factor_from_qr(stacked.transpose());
+  return sqrt_kalman_gain_update(res, input);
+}
 }
 
 #endif
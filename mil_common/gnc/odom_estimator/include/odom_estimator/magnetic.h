@@ -5,6 +5,8 @@
 #include <sstream>
 
 #include <boost/foreach.hpp>
+#include <boost/optional.hpp>
+#include <boost/utility/in_place_factory.hpp>
 
 #include <Eigen/Dense>
 #include <unsupported/Eigen/AutoDiff>
@@ -99,6 +101,71 @@ Eigen::Matrix<T, Dynamic, Dynamic> semi_normalized_associated_legendre(int max_m
   return result;
 }
 
+// tabulates semi_normalized_associated_legendre with the factors of its
+// recurrence precomputed, as they only depend on the degree and order. This
+// leaves no square roots, besides sqrt(1 - arg^2), to take per evaluation.
+class LegendreRecurrence
+{
+  int max_m, max_n;
+  std::vector<double> start;  // start[m] = \tilde{P}_0^{(m,m)}
+  // \tilde{P}_k^{(m,m)}(x) = x a(m, k) \tilde{P}_{k-1}^{(m,m)}(x) - b(m, k) \tilde{P}_{k-2}^{(m,m)}(x)
+  Eigen::MatrixXd a, b;
+  Eigen::MatrixXd scale;  // from \tilde{P}_{n-m}^{(m,m)} sin^m to \breve{P}_n^m
+
+public:
+  LegendreRecurrence(int max_m, int max_n)
+    : max_m(max_m)
+    , max_n(max_n)
+    , start(max_m + 1)
+    , a(Eigen::MatrixXd::Zero(max_m + 1, max_n + 1))
+    , b(Eigen::MatrixXd::Zero(max_m + 1, max_n + 1))
+    , scale(Eigen::MatrixXd::Zero(max_m + 1, max_n + 1))
+  {
+    for (int m = 0; m <= max_m; m++)
+    {
+      start[m] = m == 0 ? 1 / sqrt(2) : start[m - 1] * sqrt(1 + 1 / (2. * m));
+      for (int k = 1; k <= max_n; k++)
+      {
+        a(m, k) = 2 * sqrt((1 + (m - 1. / 2) / k) * (1 - (m - 1. / 2) / (k + 2 * m)));
+        b(m, k) = k == 1 ? 0 : sqrt((1 + 4 / (2. * k + 2. * m - 3)) * (1 - 1. / k) * (1 - 1 / (k + 2. * m)));
+      }
+      for (int n = m; n <= max_n; n++)
+        scale(m, n) = sqrt(2 / (2. * n + 1)) * (m > 0 ? sqrt(2) : 1);
+    }
+  }
+
+  // returns the same table as semi_normalized_associated_legendre
+  template <typename T>
+  Eigen::Matrix<T, Dynamic, Dynamic> evaluate(T arg) const
+  {
+    Eigen::Matrix<T, Dynamic, Dynamic> result(max_m + 1, max_n + 1);
+    T sqrt1marg2 = sqrt(T(1) - arg * arg);
+    T pow_sqrt1marg2_m = T(1);
+    for (int m = 0; m <= max_m; m++)
+    {
+      for (int n = 0; n < m && n <= max_n; n++)
+        result(m, n) = T(NAN);
+      // the recurrence is linear, so carrying sin^m through it saves a
+      // multiplication per entry
+      T preprek = T(0);
+      T prek = T(start[m]) * pow_sqrt1marg2_m;
+      for (int n = m; n <= max_n; n++)
+      {
+        int k = n - m;
+        if (k > 0)
+        {
+          T p = T(a(m, k)) * arg * prek - T(b(m, k)) * preprek;
+          preprek = prek;
+          prek = p;
+        }
+        result(m, n) = prek * T(scale(m, n));
+      }
+      pow_sqrt1marg2_m *= sqrt1marg2;
+    }
+    return result;
+  }
+};
+
 struct Coeff
 {
   int n, m;
@@ -117,6 +184,7 @@ class MagneticModel
   std::vector<Coeff> coeffs;
   int max_n, max_m;
   double t0_year;
+  boost::optional<LegendreRecurrence> legendre;
 
 public:
   MagneticModel(std::string const &filename) : max_n(0), max_m(0)
@@ -141,6 +209,7 @@ public:
       max_n = std::max(max_n, coeff.n);
       max_m = std::max(max_m, coeff.m);
     }
+    legendre = boost::in_place(max_m, max_n);
   }
 
   template <typename T>
@@ -155,11 +224,11 @@ public:
     std::vector<std::pair<T, T> > cos_sin =
         compute_cos_sin<T>(pos_ecef(0) / Vec<2, T>(pos_ecef(0), pos_ecef(1)).norm(),
                            pos_ecef(1) / Vec<2, T>(pos_ecef(0), pos_ecef(1)).norm(), max_m);
-    Eigen::Matrix<T, Dynamic, Dynamic> p = semi_normalized_associated_legendre<T>(max_m, max_n, pos_ecef(2) / r);
+    Eigen::Matrix<T, Dynamic, Dynamic> p = legendre->evaluate<T>(pos_ecef(2) / r);
 
-    T pow_aoverr_n[max_n + 2];
+    std::vector<T> pow_aoverr_n(max_n + 2);
     pow_aoverr_n[0] = T(1);
-    for (unsigned int i = 1; i < max_n + 2; i++)
+    for (int i = 1; i < max_n + 2; i++)
     {
       pow_aoverr_n[i] = pow_aoverr_n[i - 1] * T(a / r);
     }
@@ -207,11 +276,50 @@ public:
     for (int i = 0; i < 3; i++)
     {
       y(i) = -x.derivatives()(i).value();
-      res.row(i) = x.derivatives()(i).derivatives();
+      res.row(i) = -x.derivatives()(i).derivatives();
     }
     return std::make_pair(y, res);
   }
 };
+
+// evaluates a MagneticModel through a first order expansion, in ECEF, about
+// the last point it was fully evaluated at. The field only changes by a few
+// pT per km, so this is redone only once the position gets more than
+// max_distance meters or the time more than max_age seconds away from it.
+class CachedMagneticModel
+{
+  MagneticModel const &model;
+  double const max_distance;
+  double const max_age;
+
+  bool valid;
+  Vec<3> pos0_ecef;
+  double t0;
+  Vec<3> field0_ecef;
+  SqMat<3> jacobian0_ecef;
+
+public:
+  CachedMagneticModel(MagneticModel const &model, double max_distance = 1000, double max_age = 3600)
+    : model(model), max_distance(max_distance), max_age(max_age), valid(false)
+  {
+  }
+
+  Vec<3> getField(Vec<3> pos_eci, double t)
+  {
+    Vec<3> pos_ecef = ecef_from_inertial(t, pos_eci);
+    if (!valid || (pos_ecef - pos0_ecef).norm() > max_distance || fabs(t - t0) > max_age)
+    {
+      std::pair<Vec<3>, SqMat<3> > field_and_jacobian = model.getFieldAndJacobian(pos_eci, t);
+      SqMat<3> ecef_from_eci = quat_from_rotvec(-w_E * t).toRotationMatrix();
+      valid = true;
+      pos0_ecef = pos_ecef;
+      t0 = t;
+      field0_ecef = ecef_from_eci * field_and_jacobian.first;
+      jacobian0_ecef = ecef_from_eci * field_and_jacobian.second * ecef_from_eci.transpose();
+    }
+    return inertial_from_ecef(t, field0_ecef + jacobian0_ecef * (pos_ecef - pos0_ecef));
+  }
+};
 }
 }
 
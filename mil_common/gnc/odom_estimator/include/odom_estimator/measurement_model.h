@@ -0,0 +1,173 @@
+#ifndef GUARD_MZDJWQHYRTXAPSLE
+#define GUARD_MZDJWQHYRTXAPSLE
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+
+#include <ros/ros.h>
+
+#include "odom_estimator/state.h"
+#include "odom_estimator/unscented_transform.h"
+#include "odom_estimator/util.h"
+
+namespace odom_estimator
+{
+// is one measurement, as the difference between the predicted and measured
+// values given the state, the frame terms of the filter step, the gyro
+// reading at the state, and a zero mean noise with covariance noise_cov
+//
+// A measurement whose noise only adds to the error sets additive_error
+// instead of error, writing the error without the noise to the
+// noise_cov.rows() values of out. Its noise then isn't sampled along with
+// the state, and a step of only such measurements is done with fewer sigma
+// points and, for up to 4 values, math sized at compile time.
+struct MeasurementError
+{
+  boost::function<Vec<Dynamic>(State const &state, StateFrame const &frame, Vec<3> const &gyro,
+                               Vec<Dynamic> const &noise)>
+      error;
+  boost::function<void(State const &state, StateFrame const &frame, Vec<3> const &gyro,
+                       Eigen::Ref<Vec<Dynamic> > out)>
+      additive_error;
+  SqMat<Dynamic> noise_cov;
+};
+
+// is where a sensor's frame is in the IMU's frame
+struct SensorPose
+{
+  Vec<3> pos;
+  Quaternion orient;
+};
+
+// is the error function of the measurements in [begin, end) stacked
+// together, with independent noises, so they can go through one Kalman update
+// of a state with the given mean
+class CombinedMeasurementFunction : public UnscentedTransformDistributionFunction<State, Vec<Dynamic>, Vec<Dynamic> >
+{
+  typedef std::vector<MeasurementError>::const_iterator Iterator;
+  Iterator const begin, end;
+  Vec<3> const gyro;
+  StateFrame const frame;
+  SqMat<Dynamic> noise_cov;
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  CombinedMeasurementFunction(Iterator begin, Iterator end, Vec<3> const &gyro, State const &mean,
+                              ThreadPool *thread_pool = nullptr)
+    : UnscentedTransformDistributionFunction<State, Vec<Dynamic>, Vec<Dynamic> >(thread_pool)
+    , begin(begin)
+    , end(end)
+    , gyro(gyro)
+    , frame(mean)
+  {
+    int rows = 0;
+    for (Iterator it = begin; it != end; ++it)
+      rows += it->noise_cov.rows();
+    noise_cov = SqMat<Dynamic>::Zero(rows, rows);
+    int row = 0;
+    for (Iterator it = begin; it != end; ++it)
+    {
+      int n = it->noise_cov.rows();
+      noise_cov.block(row, row, n, n) = it->noise_cov;
+      row += n;
+    }
+  }
+
+  GaussianDistribution<Vec<Dynamic> > get_extra_distribution() const override
+  {
+    return GaussianDistribution<Vec<Dynamic> >(Vec<Dynamic>::Zero(noise_cov.rows()), noise_cov);
+  }
+  Vec<Dynamic> apply(State const &state, Vec<Dynamic> const &noise) const override
+  {
+    std::vector<Vec<Dynamic> > errors;
+    errors.reserve(end - begin);
+    int rows = 0, noise_row = 0;
+    for (Iterator it = begin; it != end; ++it)
+    {
+      int n = it->noise_cov.rows();
+      if (it->additive_error)
+      {
+        Vec<Dynamic> error(n);
+        it->additive_error(state, frame, gyro, error);
+        errors.push_back(error + noise.segment(noise_row, n));
+      }
+      else
+      {
+        errors.push_back(it->error(state, frame, gyro, noise.segment(noise_row, n)));
+      }
+      noise_row += n;
+      rows += errors.back().rows();
+    }
+    Vec<Dynamic> res(rows);
+    int row = 0;
+    for (Vec<Dynamic> const &error : errors)
+    {
+      res.segment(row, error.rows()) = error;
+      row += error.rows();
+    }
+    return res;
+  }
+};
+
+// is a plugin adding a sensor to NodeImpl. Plugins are loaded through
+// pluginlib from the names listed in ~measurement_models, each with its
+// class in ~<name>/type and its own parameters under ~<name>.
+class MeasurementModel
+{
+public:
+  // takes the stamp of a measurement, the frame of its sensor, and a
+  // function making the measurement given where that frame is, or returning
+  // none to skip it
+  typedef boost::function<boost::optional<MeasurementError>(SensorPose const &pose)> MeasurementFactory;
+  typedef boost::function<void(ros::Time const &stamp, std::string const &frame_id, MeasurementFactory const &)>
+      Callback;
+
+  virtual ~MeasurementModel()
+  {
+  }
+
+  // subscribes to the sensor, calling callback for every measurement
+  virtual void initialize(ros::NodeHandle &nh, ros::NodeHandle &private_nh, Callback const &callback) = 0;
+};
+
+// is a MeasurementModel for a stamped message type on ~topic. The sensor
+// frame is ~frame_id if set, and the frame of each message otherwise.
+template <typename MessageType>
+class TopicMeasurementModel : public MeasurementModel
+{
+  ros::Subscriber sub;
+  Callback callback;
+  std::string frame_id;
+
+  void got_message(boost::shared_ptr<MessageType const> const &msg)
+  {
+    callback(msg->header.stamp, frame_id.empty() ? msg->header.frame_id : frame_id,
+             [this, &msg](SensorPose const &pose) { return measure(*msg, pose); });
+  }
+
+protected:
+  // reads any parameters of the model
+  virtual void configure(ros::NodeHandle &private_nh)
+  {
+  }
+  virtual boost::optional<MeasurementError> measure(MessageType const &msg, SensorPose const &pose) const = 0;
+
+public:
+  void initialize(ros::NodeHandle &nh, ros::NodeHandle &private_nh, Callback const &callback) override
+  {
+    this->callback = callback;
+    private_nh.getParam("frame_id", frame_id);
+    std::string topic;
+    if (!private_nh.getParam("topic", topic))
+      ROS_ERROR("%s/topic is not set", private_nh.getNamespace().c_str());
+    configure(private_nh);
+    sub = nh.subscribe<MessageType>(topic, 10, &TopicMeasurementModel::got_message, this);
+  }
+};
+}
+
+#endif
@@ -0,0 +1,976 @@
+#ifndef GUARD_KQZMWDTLEVOBNRJA
+#define GUARD_KQZMWDTLEVOBNRJA
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/math/constants/constants.hpp>
+#include <boost/utility/in_place_factory.hpp>
+
+#include <Eigen/StdDeque>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <eigen_conversions/eigen_msg.h>
+#include <geometry_msgs/TransformStamped.h>
+#include <message_filters/subscriber.h>
+#include <nav_msgs/Odometry.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_loader.h>
+#include <ros/ros.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/MagneticField.h>
+#include <tf/message_filter.h>
+#include <tf/transform_listener.h>
+#include <tf_conversions/tf_eigen.h>
+
+#include <mil_msgs/DepthStamped.h>
+#include <mil_msgs/VelocityMeasurements.h>
+#include <mil_tools/driver_diagnostics.hpp>
+#include <mil_tools/thread_policy.hpp>
+#include <mil_tools/trace.hpp>
+
+#include <odom_estimator/Info.h>
+#include <odom_estimator/SetIgnoreMagnetometer.h>
+
+#include "odom_estimator/earth.h"
+#include "odom_estimator/kalman.h"
+#include "odom_estimator/magnetic.h"
+#include "odom_estimator/measurement_model.h"
+#include "odom_estimator/odometry.h"
+#include "odom_estimator/smoother.h"
+#include "odom_estimator/state.h"
+#include "odom_estimator/thread_pool.h"
+#include "odom_estimator/unscented_transform.h"
+#include "odom_estimator/util.h"
+#include "odom_estimator/warm_start.h"
+
+namespace odom_estimator
+{
+static magnetic::MagneticModel const magnetic_model(ros::package::getPath("odom_estimator") + "/data/WMM.COF");
+
+// returns msg ready to be filled in and published again, reusing it unless a
+// subscriber in the same process still holds it from the last publish
+template <typename MessageType>
+boost::shared_ptr<MessageType> const &reusable(boost::shared_ptr<MessageType> &msg)
+{
+  if (!msg || !msg.unique())
+    msg = boost::make_shared<MessageType>();
+  return msg;
+}
+
+GaussianDistribution<State> init_state(sensor_msgs::Imu const &msg, Vec<3> last_mag, Vec<3> pos_ecef, Vec<3> vel_ecef,
+                                       Vec<3> rel_pos_ecef)
+{
+  Vec<3> pos_eci = inertial_from_ecef(msg.header.stamp.toSec(), pos_ecef);
+  Vec<3> vel_eci = inertial_vel_from_ecef_vel(msg.header.stamp.toSec(), vel_ecef, pos_eci);
+
+  Vec<3> mag_eci = magnetic_model.getField(pos_eci, msg.header.stamp.toSec());
+  Vec<3> predicted_acc_eci = inertial_acc_from_ecef_acc(msg.header.stamp.toSec(), Vec<3>::Zero(), pos_eci);
+  Vec<3> predicted_accelerometer_eci = predicted_acc_eci - gravity::gravity(pos_eci);
+  Vec<3> accel_body = xyz2vec(msg.linear_acceleration);
+  Quaternion orient_eci = triad(predicted_accelerometer_eci, mag_eci, accel_body, last_mag);
+
+  Vec<State::RowsAtCompileTime> stdev = (Vec<State::RowsAtCompileTime>(18) << 100, 100, 100, 100, 100, 100, .05, .05,
+                                         .05, 10, 10, 10, 1e-3, 1e-3, 1e-3, 1e-2, 1e-2, 1e-2)
+                                            .finished();
+  SqMat<State::RowsAtCompileTime> tmp = stdev.asDiagonal();
+
+  return GaussianDistribution<State>(State(msg.header.stamp, msg.header.stamp, pos_eci,
+                                           inertial_from_ecef(msg.header.stamp.toSec(), rel_pos_ecef), orient_eci,
+                                           vel_eci, Vec<3>::Zero(), Vec<3>::Zero()),
+                                     tmp * tmp);
+}
+
+// fills in the odometry of state in local_frame and its absolute odometry in
+// ECEF, with the body frame child_frame_id and gyro the sample at state. Both
+// are evaluated over the same sigma points, with the frame terms they share
+// computed once.
+void odom_msgs_from_state(GaussianDistribution<State> const &state, std::string const &local_frame,
+                          std::string const &child_frame_id, Vec<3> const &gyro, nav_msgs::Odometry &odom,
+                          nav_msgs::Odometry &absodom, ThreadPool *thread_pool = nullptr)
+{
+  SigmaPoints<State> sigma_points(state);
+  StateFrame const frame(state.mean);
+
+  msg_from_odom(sigma_points.transform<Odom>(
+                    [&local_frame, &child_frame_id, &gyro, &frame](State const &state) {
+                      SqMat<3> m = frame.enu.enu_from_ecef(state.getPosECEF(frame));
+                      Quaternion orient_ecef = state.getOrientECEF(frame);
+                      return Odom(state.t, local_frame, child_frame_id, m * state.getRelPosECEF(frame),
+                                  Quaternion(m) * orient_ecef,
+                                  orient_ecef.conjugate()._transformVector(state.getVelECEF(frame)),
+                                  gyro - state.gyro_bias);
+                    },
+                    thread_pool),
+                odom);
+
+  msg_from_odom(sigma_points.transform<Odom>(
+                    [&child_frame_id, &gyro, &frame](State const &state) {
+                      Quaternion orient_ecef = state.getOrientECEF(frame);
+                      return Odom(state.t, "/ecef", child_frame_id, state.getPosECEF(frame), orient_ecef,
+                                  orient_ecef.conjugate()._transformVector(state.getVelECEF(frame)),
+                                  gyro - state.gyro_bias);
+                    },
+                    thread_pool),
+                absodom);
+}
+
+// is the additive_error of a DVL ensemble of N good beams, with N fixed at
+// compile time for the usual 1 to 4, so each sigma point's error is a small
+// fixed size product
+template <int N>
+struct DvlBeamsError
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  Mat<N, 3> directions;  // of the beams in the DVL's frame, one per row
+  Vec<N> velocities;
+  SensorPose pose;
+
+  void operator()(State const &state, StateFrame const &frame, Vec<3> const &gyro, Eigen::Ref<Vec<Dynamic> > out) const
+  {
+    Vec<3> dvl_vel = pose.orient.inverse()._transformVector(
+        state.getOrientECEF(frame).inverse()._transformVector(state.getVelECEF(frame, pose.pos, gyro)));
+    out = directions * dvl_vel - velocities;
+  }
+};
+
+template <int N>
+MeasurementError dvl_beams_error(std::vector<mil_msgs::VelocityMeasurement const *> const &good,
+                                 SensorPose const &pose)
+{
+  DvlBeamsError<N> beams;
+  beams.directions.resize(good.size(), 3);
+  beams.velocities.resize(good.size());
+  for (unsigned int i = 0; i < good.size(); i++)
+  {
+    beams.directions.row(i) = xyz2vec(good[i]->direction).transpose();
+    beams.velocities(i) = good[i]->velocity;
+  }
+  beams.pose = pose;
+
+  MeasurementError measurement;
+  measurement.additive_error = beams;
+  measurement.noise_cov = pow(.05, 2) * SqMat<Dynamic>::Identity(good.size(), good.size());
+  return measurement;
+}
+
+// is the filter behind Nodelet, along with its subscriptions and publishers
+class NodeImpl
+{
+private:
+  boost::function<const std::string &()> getName;
+  ros::NodeHandle &nh;
+  ros::NodeHandle &private_nh;
+  double start_x_ecef, start_y_ecef, start_z_ecef;
+  std::string local_frame;
+  ros::ServiceServer set_ignore_magnetometer_srv;
+  bool ignoreMagnetometer;
+  Vec<3> last_rel_pos_ecef_;
+  // evaluates sigma points in parallel if sigma_point_threads > 1
+  boost::optional<ThreadPool> thread_pool;
+  // carries the square root of the state covariance through every step
+  // instead of the covariance itself
+  bool square_root_filter;
+  // number of IMU steps kept so late measurements can be inserted at their
+  // own stamp
+  int history_size;
+  // measurements older than this many seconds behind the state are dropped
+  double max_measurement_lag;
+  // is magnetic_model linearized about the recent position
+  magnetic::CachedMagneticModel magnetic_field;
+  // seconds of IMU samples preintegrated into each filter prediction, or 0
+  // to predict on every sample. Odometry is still published per sample.
+  double prediction_period;
+  // is gravity linearized about the recent position, unless
+  // local_gravity_distance is 0
+  boost::optional<gravity::LocalGravity> local_gravity;
+  // where the last good state is saved every warm_start_period seconds and
+  // loaded from at startup, or empty to keep it in memory only. Either way
+  // the filter restarts from it after a reset.
+  std::string warm_start_file;
+  double warm_start_period;
+  // warm starts older than this many seconds are ignored
+  double warm_start_max_age;
+  // standard deviations of what a warm start doesn't know: movement since it
+  // was taken, the velocity and, without a magnetometer sample, the heading
+  double warm_start_position_stddev, warm_start_velocity_stddev, warm_start_heading_stddev;
+  // starts the filter on the first IMU sample it can, without waiting for a
+  // DVL lock, and with a warm start, without waiting for the magnetometer
+  bool quick_align;
+
+public:
+  NodeImpl(boost::function<const std::string &()> getName, ros::NodeHandle *nh_, ros::NodeHandle *private_nh_)
+    : getName(getName)
+    , nh(*nh_)
+    , private_nh(*private_nh_)
+    , local_frame("/enu")
+    , ignoreMagnetometer(false)
+    , square_root_filter(false)
+    , history_size(500)
+    , max_measurement_lag(1.0)
+    , magnetic_field(magnetic_model)
+    , prediction_period(0)
+    , warm_start_period(5)
+    , warm_start_max_age(3600)
+    , warm_start_position_stddev(1)
+    , warm_start_velocity_stddev(1)
+    , warm_start_heading_stddev(.2)
+    , quick_align(false)
+    , mag_sub(nh, "imu/mag", 1)
+    , mag_filter(mag_sub, tf_listener, "", 10, nh)
+    , dvl_sub(nh, "dvl", 1)
+    , dvl_filter(dvl_sub, tf_listener, "", 10, nh)
+    , depth_sub(nh, "depth", 1)
+    , depth_filter(depth_sub, tf_listener, "", 10, nh)
+    , last_mag(boost::none)
+    , last_good_dvl(boost::none)
+    , state(boost::none)
+    , measurement_model_loader("odom_estimator", "odom_estimator::MeasurementModel")
+  {
+    mil_tools::Tracer::instance().configure(private_nh);
+    private_nh.getParam("start_x_ecef", start_x_ecef);
+    private_nh.getParam("start_y_ecef", start_y_ecef);
+    private_nh.getParam("start_z_ecef", start_z_ecef);
+    private_nh.getParam("local_frame", local_frame);
+    // the sigma point workers are scheduled like the thread the filter runs on
+    mil_tools::ThreadPolicy thread_policy = mil_tools::ThreadPolicy::from_params(private_nh, "thread_policy");
+    int sigma_point_threads = 1;
+    private_nh.getParam("sigma_point_threads", sigma_point_threads);
+    if (sigma_point_threads > 1)
+      thread_pool = boost::in_place(sigma_point_threads,
+                                    [thread_policy]() { thread_policy.apply("sigma point worker"); });
+    private_nh.getParam("square_root_filter", square_root_filter);
+    private_nh.getParam("history_size", history_size);
+    private_nh.getParam("max_measurement_lag", max_measurement_lag);
+    private_nh.getParam("prediction_period", prediction_period);
+    double local_gravity_distance = 1000;
+    private_nh.getParam("local_gravity_distance", local_gravity_distance);
+    if (local_gravity_distance > 0)
+      local_gravity = boost::in_place(local_gravity_distance);
+    private_nh.getParam("warm_start_file", warm_start_file);
+    private_nh.getParam("warm_start_period", warm_start_period);
+    private_nh.getParam("warm_start_max_age", warm_start_max_age);
+    private_nh.getParam("warm_start_position_stddev", warm_start_position_stddev);
+    private_nh.getParam("warm_start_velocity_stddev", warm_start_velocity_stddev);
+    private_nh.getParam("warm_start_heading_stddev", warm_start_heading_stddev);
+    private_nh.getParam("quick_align", quick_align);
+
+    // latency of imu is from each sample's stamp to the filter taking it up
+    diagnostics.reset(new mil_tools::DriverDiagnostics(nh, private_nh, getName(), "odom_estimator"));
+    imu_monitor = &diagnostics->stream("imu");
+    imu_sub = nh.subscribe<sensor_msgs::Imu>("imu/data_raw", 10, boost::bind(&NodeImpl::got_imu, this, _1));
+    mag_filter.registerCallback(boost::bind(&NodeImpl::got_mag, this, _1));
+    dvl_filter.registerCallback(boost::bind(&NodeImpl::got_dvl, this, _1));
+    depth_filter.registerCallback(boost::bind(&NodeImpl::got_depth, this, _1));
+    odom_pub = nh.advertise<nav_msgs::Odometry>("odom", 10);
+    absodom_pub = nh.advertise<nav_msgs::Odometry>("absodom", 10);
+    info_pub = private_nh.advertise<odom_estimator::Info>("info", 10);
+    set_ignore_magnetometer_srv =
+        private_nh.advertiseService("set_ignore_magnetometer", &NodeImpl::setIgnoreMagnetometer, this);
+
+    last_rel_pos_ecef_ = Vec<3>::Zero();
+    if (!warm_start_file.empty())
+    {
+      warm_start = WarmStart::load(warm_start_file);
+      if (warm_start)
+        last_rel_pos_ecef_ = warm_start->rel_pos_ecef;
+      else
+        NODELET_WARN("no warm start in %s, starting cold", warm_start_file.c_str());
+    }
+
+    std::vector<std::string> measurement_model_names;
+    private_nh.getParam("measurement_models", measurement_model_names);
+    for (std::string const &name : measurement_model_names)
+    {
+      ros::NodeHandle model_nh(private_nh, name);
+      std::string type;
+      if (!model_nh.getParam("type", type))
+      {
+        NODELET_ERROR("%s/type is not set", model_nh.getNamespace().c_str());
+        continue;
+      }
+      try
+      {
+        boost::shared_ptr<MeasurementModel> model = measurement_model_loader.createInstance(type);
+        model->initialize(nh, model_nh, boost::bind(&NodeImpl::got_plugin_measurement, this, _1, _2, _3));
+        measurement_models.push_back(model);
+      }
+      catch (pluginlib::PluginlibException const &ex)
+      {
+        NODELET_ERROR("could not load measurement model %s: %s", name.c_str(), ex.what());
+      }
+    }
+  }
+
+private:
+  // is one IMU step of recent history along with the measurements stamped
+  // between it and the next step, which go through one combined update
+  struct HistoryEntry
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    sensor_msgs::Imu imu;
+    GaussianDistribution<State> prior;  // after propagating to imu, before measurements
+    boost::optional<SqrtGaussianDistribution<State>> sqrt_prior;
+    std::vector<MeasurementError> measurements;
+    unsigned int applied;  // how many of measurements the state includes
+    // only kept with a step_callback: the state prior was propagated from and
+    // their cross covariance, none for the first step
+    boost::optional<GaussianDistribution<State>> previous;
+    boost::optional<SqMat<State::RowsAtCompileTime>> cross_cov;
+
+    HistoryEntry(sensor_msgs::Imu const &imu, GaussianDistribution<State> const &prior,
+                 boost::optional<SqrtGaussianDistribution<State>> const &sqrt_prior)
+      : imu(imu), prior(prior), sqrt_prior(sqrt_prior), applied(0)
+    {
+    }
+  };
+
+  // the steps still in history are dropped without going to step_callback, as
+  // the filter went wrong somewhere in them
+  void reset()
+  {
+    last_mag = boost::none;
+    state = boost::none;
+    sqrt_state = boost::none;
+    history.clear();
+    last_prediction_input = boost::none;
+    last_prediction_cross_cov = boost::none;
+  }
+
+  // starts the filter at msg, warm if there is a recent enough warm start.
+  // Returns false if it has to wait for more measurements.
+  bool init(sensor_msgs::Imu const &msg)
+  {
+    if (warm_start && (msg.header.stamp - warm_start->stamp).toSec() > warm_start_max_age)
+    {
+      NODELET_WARN("warm start is %f s old, starting cold", (msg.header.stamp - warm_start->stamp).toSec());
+      warm_start = boost::none;
+    }
+    if (!last_mag && !(quick_align && warm_start))
+    {
+      std::cout << "mag missing" << std::endl;
+      return false;
+    }
+    if (!quick_align && !(last_good_dvl && *last_good_dvl > msg.header.stamp - ros::Duration(1.5) &&
+                          *last_good_dvl < msg.header.stamp + ros::Duration(1.5)))
+    {
+      std::cout << "dvl missing" << std::endl;
+      return false;
+    }
+
+    if (warm_start)
+    {
+      WarmStart warm = *warm_start;
+      warm.age((msg.header.stamp - warm.stamp).toSec(), warm_start_position_stddev);
+      state = warm_init_state(msg, last_mag, magnetic_model, warm, last_rel_pos_ecef_, warm_start_velocity_stddev,
+                              warm_start_heading_stddev);
+      NODELET_INFO("warm started from a state %f s old", (msg.header.stamp - warm.stamp).toSec());
+    }
+    else
+    {
+      state = init_state(msg, *last_mag, Vec<3>(start_x_ecef, start_y_ecef, start_z_ecef), Vec<3>::Zero(),
+                         last_rel_pos_ecef_);
+    }
+    last_warm_start_save = msg.header.stamp;
+    return true;
+  }
+
+  // keeps the state as the warm start once it has run a warm_start_period
+  // past the last one, and saves it if there's a warm_start_file
+  void update_warm_start()
+  {
+    if (state->mean.t < last_warm_start_save + ros::Duration(warm_start_period))
+      return;
+    last_warm_start_save = state->mean.t;
+    warm_start = WarmStart::from_state(*state);
+    if (!warm_start_file.empty() && !warm_start->save(warm_start_file))
+      NODELET_WARN_THROTTLE(60, "could not save warm start to %s", warm_start_file.c_str());
+  }
+
+  // records the state as a new step of history, following imu, along with
+  // what the prediction to it started from if there was one
+  void push_history(sensor_msgs::Imu const &imu)
+  {
+    history.push_back(HistoryEntry(imu, *state, sqrt_state));
+    take_prediction(history.back());
+    while (history.size() > static_cast<size_t>(std::max(history_size, 1)))
+    {
+      // nothing can be inserted before the second step any more, so the
+      // first is final, and its posterior is what the second was predicted
+      // from
+      if (step_callback && history[1].previous)
+        emit_step(history[0], *history[1].previous);
+      history.pop_front();
+    }
+    preintegrator.reset(imu.header.stamp);
+  }
+
+  // moves the prediction statistics predict kept into entry
+  void take_prediction(HistoryEntry &entry)
+  {
+    entry.previous = last_prediction_input;
+    entry.cross_cov = last_prediction_cross_cov;
+    last_prediction_input = boost::none;
+    last_prediction_cross_cov = boost::none;
+  }
+
+  void emit_step(HistoryEntry const &entry, GaussianDistribution<State> const &posterior)
+  {
+    step_callback(FilterStep(entry.imu, entry.prior, entry.cross_cov, posterior));
+  }
+
+  // applies the measurements of entry that the state doesn't include yet,
+  // all in one update
+  void apply_measurements(HistoryEntry &entry)
+  {
+    if (entry.applied == entry.measurements.size())
+      return;
+    MeasurementIterator begin = entry.measurements.begin() + entry.applied;
+    MeasurementIterator end = entry.measurements.end();
+    Vec<3> gyro = xyz2vec(entry.imu.angular_velocity);
+    if (std::all_of(begin, end, [](MeasurementError const &measurement) { return bool(measurement.additive_error); }))
+      additive_update(begin, end, gyro);
+    else
+      update(CombinedMeasurementFunction(begin, end, gyro, state->mean, thread_pool.get_ptr()));
+    entry.applied = entry.measurements.size();
+  }
+
+  // does a filter step over the samples preintegrated so far, if any
+  void flush_preintegration()
+  {
+    if (!preintegrator.size())
+      return;
+    apply_measurements(history.back());
+    sensor_msgs::Imu imu = preintegrator.get_imu();
+    predict(StateUpdater(imu, thread_pool.get_ptr(), local_gravity.get_ptr()));
+    push_history(imu);
+  }
+
+  // queues a measurement at the IMU step its stamp falls in. Measurements in
+  // the newest step are applied together at the next IMU sample. For an
+  // older step, the state is rolled back to it and everything after it is
+  // replayed.
+  void add_measurement(ros::Time stamp, MeasurementError const &measurement)
+  {
+    if (!state || history.empty())
+      return;
+    if (preintegrator.size() && stamp >= history.back().imu.header.stamp)
+    {
+      // an aiding measurement ends the preintegration early, so it can go
+      // right after the samples before it instead of replaying a step
+      flush_preintegration();
+      stamp = std::max(stamp, history.back().imu.header.stamp);
+    }
+    if (stamp + ros::Duration(max_measurement_lag) < state->mean.t || stamp < history.front().imu.header.stamp)
+    {
+      NODELET_WARN("dropping measurement %f s behind the state", (state->mean.t - stamp).toSec());
+      return;
+    }
+
+    std::deque<HistoryEntry, Eigen::aligned_allocator<HistoryEntry>>::iterator entry = std::upper_bound(
+        history.begin(), history.end(), stamp,
+        [](ros::Time const &stamp, HistoryEntry const &entry) { return stamp < entry.imu.header.stamp; });
+    --entry;  // the last step at or before stamp
+    entry->measurements.push_back(measurement);
+    if (entry + 1 == history.end())
+      return;  // the usual case, where nothing has been propagated past it yet
+
+    state = entry->prior;
+    sqrt_state = entry->sqrt_prior;
+    entry->applied = 0;
+    apply_measurements(*entry);
+    for (++entry; entry != history.end(); ++entry)
+    {
+      predict(StateUpdater(entry->imu, thread_pool.get_ptr(), local_gravity.get_ptr()));
+      entry->prior = *state;
+      entry->sqrt_prior = sqrt_state;
+      take_prediction(*entry);
+      entry->applied = 0;
+      apply_measurements(*entry);
+    }
+  }
+
+  // looks up where a plugin measurement's sensor is and queues it
+  void got_plugin_measurement(ros::Time const &stamp, std::string const &frame_id,
+                              MeasurementModel::MeasurementFactory const &make)
+  {
+    tf::StampedTransform transform;
+    try
+    {
+      tf_listener.lookupTransform(local_frame_id, frame_id, stamp, transform);
+    }
+    catch (tf::TransformException ex)
+    {
+      NODELET_ERROR("Error in measurement from %s: %s", frame_id.c_str(), ex.what());
+      return;
+    }
+    SensorPose pose;
+    tf::vectorTFToEigen(transform.getOrigin(), pose.pos);
+    tf::quaternionTFToEigen(transform.getRotation(), pose.orient);
+
+    if (!state)
+      return;
+    boost::optional<MeasurementError> measurement = make(pose);
+    if (measurement)
+      add_measurement(stamp, *measurement);
+  }
+
+  // propagates the state, as its square root if square_root_filter is set.
+  // With a step_callback, what it started from and the cross covariance are
+  // kept for the step the result goes into.
+  void predict(StateUpdater const &updater)
+  {
+    // before the sigma points, which only read it
+    if (local_gravity)
+      local_gravity->update(state->mean.pos_eci);
+    if (step_callback)
+      last_prediction_input = *state;
+    if (square_root_filter)
+    {
+      if (!sqrt_state)
+        sqrt_state = SqrtGaussianDistribution<State>(*state);
+      SqrtGaussianDistributionWithCrossCov<State, State> res = updater.sqrt_transform(*sqrt_state);
+      if (step_callback)
+        last_prediction_cross_cov = res.cross_cov;
+      sqrt_state = res;
+      state = sqrt_state->distribution();
+    }
+    else
+    {
+      GaussianDistributionWithCrossCov<State, State> res = updater(*state);
+      if (step_callback)
+        last_prediction_cross_cov = res.cross_cov;
+      state = res;
+    }
+  }
+
+  // does a measurement update of the state, as its square root if
+  // square_root_filter is set
+  template <typename ErrorType, typename ExtraType>
+  void update(UnscentedTransformDistributionFunction<State, ErrorType, ExtraType> const &df)
+  {
+    if (square_root_filter)
+    {
+      if (!sqrt_state)
+        sqrt_state = SqrtGaussianDistribution<State>(*state);
+      sqrt_state = sqrt_kalman_update(df, *sqrt_state);
+      state = sqrt_state->distribution();
+    }
+    else
+    {
+      state = kalman_update(df, *state);
+    }
+  }
+
+  typedef std::vector<MeasurementError>::const_iterator MeasurementIterator;
+
+  // does one update with the measurements in [begin, end), which all have
+  // additive noise, so only the state is sampled
+  void additive_update(MeasurementIterator begin, MeasurementIterator end, Vec<3> const &gyro)
+  {
+    int rows = 0;
+    for (MeasurementIterator it = begin; it != end; ++it)
+      rows += it->noise_cov.rows();
+    // a single DVL ensemble or depth reading, the usual steps, gets math
+    // sized at compile time
+    switch (rows)
+    {
+      case 1:
+        return additive_update<1>(begin, end, gyro, rows);
+      case 2:
+        return additive_update<2>(begin, end, gyro, rows);
+      case 3:
+        return additive_update<3>(begin, end, gyro, rows);
+      case 4:
+        return additive_update<4>(begin, end, gyro, rows);
+      default:
+        return additive_update<Dynamic>(begin, end, gyro, rows);
+    }
+  }
+
+  template <int N>
+  void additive_update(MeasurementIterator begin, MeasurementIterator end, Vec<3> const &gyro, int rows)
+  {
+    StateFrame const frame(state->mean);
+    auto error = [begin, end, &frame, &gyro, rows](State const &state) {
+      Vec<N> res;
+      res.resize(rows);
+      int row = 0;
+      for (MeasurementIterator it = begin; it != end; ++it)
+      {
+        int n = it->noise_cov.rows();
+        it->additive_error(state, frame, gyro, res.segment(row, n));
+        row += n;
+      }
+      return res;
+    };
+    SqMat<N> noise_cov = SqMat<N>::Zero(rows, rows);
+    int row = 0;
+    for (MeasurementIterator it = begin; it != end; ++it)
+    {
+      int n = it->noise_cov.rows();
+      noise_cov.block(row, row, n, n) = it->noise_cov;
+      row += n;
+    }
+
+    if (square_root_filter)
+    {
+      if (!sqrt_state)
+        sqrt_state = SqrtGaussianDistribution<State>(*state);
+      sqrt_state = sqrt_additive_kalman_update<Vec<N>>(error, triangular_cholesky<N>(noise_cov), *sqrt_state,
+                                                       thread_pool.get_ptr());
+      state = sqrt_state->distribution();
+    }
+    else
+    {
+      state = additive_kalman_update<Vec<N>>(error, noise_cov, *state, thread_pool.get_ptr());
+    }
+  }
+
+  // is where a sensor rigidly mounted with the IMU is, looked up once per
+  // frame, as it can't move between messages
+  bool mounted_sensor_pose(std::string const &frame_id, SensorPose &pose)
+  {
+    SensorPoseMap::const_iterator it = mounted_sensor_poses.find(frame_id);
+    if (it != mounted_sensor_poses.end())
+    {
+      pose = it->second;
+      return true;
+    }
+    tf::StampedTransform transform;
+    try
+    {
+      tf_listener.lookupTransform(local_frame_id, frame_id, ros::Time(0), transform);
+    }
+    catch (tf::TransformException ex)
+    {
+      NODELET_ERROR("Error looking up %s: %s", frame_id.c_str(), ex.what());
+      return false;
+    }
+    tf::vectorTFToEigen(transform.getOrigin(), pose.pos);
+    tf::quaternionTFToEigen(transform.getRotation(), pose.orient);
+    mounted_sensor_poses.insert(std::make_pair(frame_id, pose));
+    return true;
+  }
+
+public:
+  // The callbacks and add_transform are public so benchmark_bag_replay can
+  // drive them straight from a bag, without message filters or ROS time.
+
+  void add_transform(geometry_msgs::TransformStamped const &transform, bool is_static)
+  {
+    tf_listener.getTF2BufferPtr()->setTransform(transform, "odom_estimator", is_static);
+  }
+
+  boost::optional<GaussianDistribution<State>> const &get_state() const
+  {
+    return state;
+  }
+
+  // calls callback with every filter step once no late measurement can change
+  // it any more, history_size steps behind the state, for smooth_bag. Set it
+  // before the first IMU sample.
+  void set_step_callback(boost::function<void(FilterStep const &)> const &callback)
+  {
+    step_callback = callback;
+  }
+
+  // does a last filter step over any preintegrated samples and passes the
+  // steps still in history to the step_callback, ending the run. The filter
+  // starts over on the next IMU sample.
+  void finish_steps()
+  {
+    if (state && !history.empty())
+    {
+      flush_preintegration();
+      apply_measurements(history.back());
+      for (size_t i = 0; step_callback && i + 1 < history.size(); i++)
+        if (history[i + 1].previous)
+          emit_step(history[i], *history[i + 1].previous);
+      if (step_callback)
+        emit_step(history.back(), *state);
+    }
+    reset();
+  }
+
+  void got_imu(const sensor_msgs::ImuConstPtr &msgp)
+  {
+    // odom is stamped with the IMU sample, which carries the trace on downstream
+    mil_tools::TraceSpan span("odom_estimator.imu", msgp->header.stamp);
+    imu_monitor->published(msgp->header.stamp);
+
+    // the covariances are overridden, so this needs a copy, into storage
+    // kept between calls
+    sensor_msgs::Imu &msg = imu_msg;
+    msg = *msgp;
+    Eigen::Map<SqMat<3>>(msg.angular_velocity_covariance.data()) = pow(0.02, 2) * SqMat<3>::Identity();
+    Eigen::Map<SqMat<3>>(msg.linear_acceleration_covariance.data()) = pow(0.06, 2) * SqMat<3>::Identity();
+
+    mag_filter.setTargetFrame(msg.header.frame_id);
+    dvl_filter.setTargetFrame(msg.header.frame_id);
+    depth_filter.setTargetFrame(msg.header.frame_id);
+    if (msg.header.frame_id != local_frame_id)
+      mounted_sensor_poses.clear();
+    local_frame_id = msg.header.frame_id;
+
+    if (state &&
+        (msg.header.stamp < preintegrator.get_end() || msg.header.stamp > preintegrator.get_end() + ros::Duration(2)))
+    {
+      NODELET_ERROR("reset due to invalid stamp");
+      reset();
+    }
+
+    // measurements since the last sample go through one combined update
+    if (state)
+      apply_measurements(history.back());
+
+    if (!state)
+    {
+      if (!init(msg))
+        return;
+      push_history(msg);
+    }
+    else if (prediction_period > 0)
+    {
+      preintegrator.add(msg);
+      if (preintegrator.duration() >= ros::Duration(prediction_period))
+        flush_preintegration();
+    }
+    else
+    {
+      predict(StateUpdater(msg, thread_pool.get_ptr(), local_gravity.get_ptr()));
+      push_history(msg);
+    }
+
+    // the biases are linear selections of the state, so need no sigma points
+    GaussianDistribution<Vec<3>> gyro_bias_dist =
+        linear_transform<Vec<3>>([](State const &state) { return state.gyro_bias; }, *state);
+    GaussianDistribution<Vec<3>> accel_bias_dist =
+        linear_transform<Vec<3>>([](State const &state) { return state.accel_bias; }, *state);
+
+    if (state->mean.gyro_bias.norm() > .5)
+    {
+      NODELET_ERROR("reset due to bad gyro biases");
+      reset();
+      return;
+    }
+
+    last_rel_pos_ecef_ = state->mean.getRelPosECEF();
+    update_warm_start();
+
+    // between filter steps, the outputs are forward integrated from the last
+    // one, keeping its covariance
+    if (local_gravity)
+      local_gravity->update(state->mean.pos_eci);
+    GaussianDistribution<State> output_state =
+        preintegrator.size() ?
+            GaussianDistribution<State>(
+                StateUpdater(preintegrator.get_imu(), nullptr, local_gravity.get_ptr()).predict_mean(state->mean),
+                state->cov) :
+            *state;
+
+    // published through shared pointers, so nodelets in the same manager get
+    // them without serialization
+    odom_msgs_from_state(output_state, local_frame, msg.header.frame_id, xyz2vec(msg.angular_velocity),
+                         *reusable(odom_msg), *reusable(absodom_msg), thread_pool.get_ptr());
+    odom_pub.publish(odom_msg);
+    absodom_pub.publish(absodom_msg);
+
+    {
+      odom_estimator::Info &output = *reusable(info_msg);
+      output.header.stamp = msg.header.stamp;
+
+      tf::vectorEigenToMsg(gyro_bias_dist.mean, output.gyro_bias);
+      tf::vectorEigenToMsg(gyro_bias_dist.cov.diagonal().array().sqrt().eval(), output.gyro_bias_stddev);
+
+      tf::vectorEigenToMsg(accel_bias_dist.mean, output.accel_bias);
+      tf::vectorEigenToMsg(accel_bias_dist.cov.diagonal().array().sqrt().eval(), output.accel_bias_stddev);
+
+      info_pub.publish(info_msg);
+    }
+  }
+
+  void got_mag(const sensor_msgs::MagneticFieldConstPtr &msgp)
+  {
+    const sensor_msgs::MagneticField &msg = *msgp;
+
+    tf::StampedTransform transform;
+    try
+    {
+      tf_listener.lookupTransform(local_frame_id, msg.header.frame_id, msg.header.stamp, transform);
+    }
+    catch (tf::TransformException ex)
+    {
+      NODELET_ERROR("Error in got_mag: %s", ex.what());
+      return;
+    }
+    Quaternion local_mag_orientation;
+    tf::quaternionTFToEigen(transform.getRotation(), local_mag_orientation);
+
+    last_mag = xyz2vec(msg.magnetic_field);
+
+    if (!state)
+      return;
+    if (ignoreMagnetometer)
+      return;
+
+    SqMat<3> cov = Eigen::Map<const SqMat<3>>(msg.magnetic_field_covariance.data());
+    if (cov == SqMat<3>::Zero())
+    {
+      Vec<3> stddev(2e-7, 2e-7, 2e-7);
+      stddev *= 100;
+      cov = stddev.cwiseProduct(stddev).asDiagonal();
+    }
+
+    // the field hardly changes over the lag of a measurement, so it's taken
+    // once at the current state rather than again on every replay
+    Vec<3> mag_eci = magnetic_field.getField(state->mean.pos_eci, state->mean.t.toSec());
+    Vec<3> measured = xyz2vec(msg.magnetic_field);
+    MeasurementError measurement;
+    measurement.error = [mag_eci, measured, local_mag_orientation](State const &state, StateFrame const &frame,
+                                                                   Vec<3> const &, Vec<Dynamic> const &measurement_noise) {
+      SqMat<3> enu_from_ecef = frame.enu.enu_from_ecef(state.getPosECEF(frame));
+      Quaternion orient_ecef = state.getOrientECEF(frame);
+      Vec<3> predicted = state.orient.conjugate()._transformVector(mag_eci) +
+                         local_mag_orientation._transformVector(Vec<3>(measurement_noise));
+      Vec<3> predicted_enu = enu_from_ecef * orient_ecef._transformVector(predicted);
+      double predicted_angle = atan2(predicted_enu(1), predicted_enu(0));
+      Vec<3> measured_enu =
+          enu_from_ecef * orient_ecef._transformVector(local_mag_orientation._transformVector(measured));
+      double measured_angle = atan2(measured_enu(1), measured_enu(0));
+      double error_angle = measured_angle - predicted_angle;
+      double pi = boost::math::constants::pi<double>();
+      while (error_angle < -pi)
+        error_angle += 2 * pi;
+      while (error_angle > pi)
+        error_angle -= 2 * pi;
+      return Vec<Dynamic>(scalar_matrix(error_angle));
+    };
+    measurement.noise_cov = cov;
+    add_measurement(msg.header.stamp, measurement);
+  }
+
+  void got_dvl(const mil_msgs::VelocityMeasurementsConstPtr &msgp)
+  {
+    mil_msgs::VelocityMeasurements const &msg = *msgp;
+
+    std::vector<mil_msgs::VelocityMeasurement const *> good;
+    good.reserve(msg.velocity_measurements.size());
+    for (mil_msgs::VelocityMeasurement const &vm : msg.velocity_measurements)
+    {
+      if (!std::isnan(vm.velocity))
+      {
+        good.push_back(&vm);
+      }
+    }
+
+    if (good.size() >= 3)
+    {
+      last_good_dvl = msg.header.stamp;
+      std::cout << "got dvl" << std::endl;
+    }
+    else
+    {
+      std::cout << "bad dvl" << std::endl;
+    }
+
+    if (!state || good.empty())
+      return;
+
+    SensorPose pose;
+    if (!mounted_sensor_pose(msg.header.frame_id, pose))
+      return;
+
+    switch (good.size())
+    {
+      case 1:
+        return add_measurement(msg.header.stamp, dvl_beams_error<1>(good, pose));
+      case 2:
+        return add_measurement(msg.header.stamp, dvl_beams_error<2>(good, pose));
+      case 3:
+        return add_measurement(msg.header.stamp, dvl_beams_error<3>(good, pose));
+      case 4:
+        return add_measurement(msg.header.stamp, dvl_beams_error<4>(good, pose));
+      default:
+        return add_measurement(msg.header.stamp, dvl_beams_error<Dynamic>(good, pose));
+    }
+  }
+
+  void got_depth(const mil_msgs::DepthStampedConstPtr &msgp)
+  {
+    mil_msgs::DepthStamped const &msg = *msgp;
+
+    if (!state)
+      return;
+
+    SensorPose pose;
+    if (!mounted_sensor_pose(msg.header.frame_id, pose))
+      return;
+    Vec<3> local_depth_pos = pose.pos;
+
+    double depth = msg.depth;
+    MeasurementError measurement;
+    measurement.additive_error = [depth, local_depth_pos](State const &state, StateFrame const &frame, Vec<3> const &,
+                                                          Eigen::Ref<Vec<Dynamic> > out) {
+      SqMat<3> m = frame.enu.enu_from_ecef(state.getPosECEF(frame));
+      out(0) = -(m * state.getRelPosECEF(frame, local_depth_pos))(2) - depth;
+    };
+    measurement.noise_cov = pow(.1, 2) * SqMat<Dynamic>::Identity(1, 1);
+    add_measurement(msg.header.stamp, measurement);
+  }
+
+private:
+  bool setIgnoreMagnetometer(SetIgnoreMagnetometer::Request &request, SetIgnoreMagnetometer::Response &response)
+  {
+    ignoreMagnetometer = request.ignore;
+    return true;
+  }
+
+  tf::TransformListener tf_listener;
+  ros::Subscriber imu_sub;
+  message_filters::Subscriber<sensor_msgs::MagneticField> mag_sub;
+  tf::MessageFilter<sensor_msgs::MagneticField> mag_filter;
+  message_filters::Subscriber<mil_msgs::VelocityMeasurements> dvl_sub;
+  tf::MessageFilter<mil_msgs::VelocityMeasurements> dvl_filter;
+  message_filters::Subscriber<mil_msgs::DepthStamped> depth_sub;
+  tf::MessageFilter<mil_msgs::DepthStamped> depth_filter;
+  ros::Publisher odom_pub;
+  ros::Publisher absodom_pub;
+  ros::Publisher info_pub;
+  sensor_msgs::Imu imu_msg;
+  nav_msgs::OdometryPtr odom_msg;
+  nav_msgs::OdometryPtr absodom_msg;
+  odom_estimator::InfoPtr info_msg;
+  std::unique_ptr<mil_tools::DriverDiagnostics> diagnostics;
+  mil_tools::StreamMonitor *imu_monitor;
+
+  boost::optional<Vec<3>> last_mag;
+  boost::optional<ros::Time> last_good_dvl;
+  boost::optional<WarmStart> warm_start;  // the last good state, once there is one
+  ros::Time last_warm_start_save;         // when warm_start was last taken, or the filter started
+  boost::optional<GaussianDistribution<State>> state;
+  boost::optional<SqrtGaussianDistribution<State>> sqrt_state;  // only used if square_root_filter is set
+  std::deque<HistoryEntry, Eigen::aligned_allocator<HistoryEntry>> history;  // oldest first
+  boost::function<void(FilterStep const &)> step_callback;
+  // what the last prediction started from, and its cross covariance, until
+  // they go into its step of history
+  boost::optional<GaussianDistribution<State>> last_prediction_input;
+  boost::optional<SqMat<State::RowsAtCompileTime>> last_prediction_cross_cov;
+  ImuPreintegrator preintegrator;  // samples since the last filter step
+  std::string local_frame_id;
+  typedef std::map<std::string, SensorPose, std::less<std::string>,
+                   Eigen::aligned_allocator<std::pair<std::string const, SensorPose>>>
+      SensorPoseMap;
+  SensorPoseMap mounted_sensor_poses;  // in local_frame_id
+
+  pluginlib::ClassLoader<MeasurementModel> measurement_model_loader;  // must outlive the models
+  std::vector<boost::shared_ptr<MeasurementModel>> measurement_models;
+};
+}
+
+#endif
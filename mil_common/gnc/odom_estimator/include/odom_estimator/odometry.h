@@ -34,9 +34,9 @@ GaussianDistribution<Odom> odom_from_msg(nav_msgs::Odometry const &msg)
                                         .finished());
 }
 
-nav_msgs::Odometry msg_from_odom(GaussianDistribution<Odom> const &res)
+// fills in result, reusing the storage it already has
+void msg_from_odom(GaussianDistribution<Odom> const &res, nav_msgs::Odometry &result)
 {
-  nav_msgs::Odometry result;
   result.header.stamp = res.mean.stamp;
   result.header.frame_id = res.mean.frame_id;
   result.child_frame_id = res.mean.child_frame_id;
@@ -48,7 +48,12 @@ nav_msgs::Odometry msg_from_odom(GaussianDistribution<Odom> const &res)
   tf::vectorEigenToMsg(res.mean.vel, result.twist.twist.linear);
   tf::vectorEigenToMsg(res.mean.ang_vel, result.twist.twist.angular);
   Eigen::Map<SqMat<6> >(result.twist.covariance.data()) = res.cov.block<6, 6>(6, 6);
+}
 
+nav_msgs::Odometry msg_from_odom(GaussianDistribution<Odom> const &res)
+{
+  nav_msgs::Odometry result;
+  msg_from_odom(res, result);
   return result;
 }
 }
@@ -0,0 +1,75 @@
+#ifndef GUARD_HVYQDKOMRCPBEWTJ
+#define GUARD_HVYQDKOMRCPBEWTJ
+
+#include <algorithm>
+#include <vector>
+
+#include <Eigen/StdVector>
+#include <boost/optional.hpp>
+
+#include <sensor_msgs/Imu.h>
+
+#include "odom_estimator/state.h"
+#include "odom_estimator/unscented_transform.h"
+#include "odom_estimator/util.h"
+
+namespace odom_estimator
+{
+// is one filter step as a Rauch-Tung-Striebel smoother needs it: the state
+// propagated to the step's IMU sample, its cross covariance with the
+// previous step's posterior that it was propagated from, and the state once
+// the step's measurements were applied. cross_cov is none for the first step
+// after the filter started, which the smoother doesn't look back past.
+struct FilterStep
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  sensor_msgs::Imu imu;
+  GaussianDistribution<State> prior;
+  boost::optional<SqMat<State::RowsAtCompileTime>> cross_cov;  // = E[(prior - prior.mean) (previous - previous.mean)^T]
+  GaussianDistribution<State> posterior;
+
+  FilterStep(sensor_msgs::Imu const &imu, GaussianDistribution<State> const &prior,
+             boost::optional<SqMat<State::RowsAtCompileTime>> const &cross_cov,
+             GaussianDistribution<State> const &posterior)
+    : imu(imu), prior(prior), cross_cov(cross_cov), posterior(posterior)
+  {
+  }
+};
+typedef std::vector<FilterStep, Eigen::aligned_allocator<FilterStep>> FilterSteps;
+typedef std::vector<GaussianDistribution<State>, Eigen::aligned_allocator<GaussianDistribution<State>>> States;
+
+// does the backward pass of the smoother over steps, returning the smoothed
+// state at each of them. The last step has nothing after it, so is left as
+// the filter had it, as is the last step before each restart of the filter.
+// The smoothed states are only exact given every later measurement, so a
+// run cut off early converges on them a few time constants of the filter
+// before where it was cut off.
+States rts_smooth(FilterSteps const &steps)
+{
+  static const int N = State::RowsAtCompileTime;
+
+  States res;
+  res.reserve(steps.size());
+  for (FilterSteps::const_reverse_iterator it = steps.rbegin(); it != steps.rend(); ++it)
+  {
+    if (it == steps.rbegin() || !(it - 1)->cross_cov)
+    {
+      res.push_back(it->posterior);
+      continue;
+    }
+    FilterStep const &next = *(it - 1);
+    GaussianDistribution<State> const &next_smoothed = res.back();
+    // G = C P_next^-1, with C = E[(x - x.mean) (next - next.mean)^T] = cross_cov^T
+    // and P_next symmetric, so G^T = solve(P_next, cross_cov)
+    SqMat<N> gain = next.prior.cov.ldlt().solve(*next.cross_cov).transpose();
+    res.push_back(GaussianDistribution<State>(
+        it->posterior.mean + Vec<N>(gain * (next_smoothed.mean - next.prior.mean)),
+        it->posterior.cov + gain * (next_smoothed.cov - next.prior.cov) * gain.transpose()));
+  }
+  std::reverse(res.begin(), res.end());
+  return res;
+}
+}
+
+#endif
@@ -14,6 +14,22 @@
 
 namespace odom_estimator
 {
+struct State;
+
+// is the frame terms shared by every sigma point of a filter step: the
+// Earth's rotation at the step's time and at its start, and the ENU basis at
+// the mean's position. Only for states at the same times as the mean.
+struct StateFrame
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  EarthFrame at_t;
+  EarthFrame at_t_start;
+  EnuFrame enu;
+
+  explicit StateFrame(State const &mean);
+};
+
 ODOM_ESTIMATOR_DEFINE_MANIFOLD_BEGIN(State, (ros::Time, t)(ros::Time, t_start),
                                      (Vec<3>, pos_eci)(Vec<3>, rel_pos_eci)(QuaternionManifold, orient)(Vec<3>, vel)(
                                          Vec<3>, gyro_bias)(Vec<3>, accel_bias))
@@ -48,14 +64,44 @@ Quaternion getOrientECEF() const
 {
   return ecef_orient_from_inertial_orient(t.toSec(), orient);
 }
+
+// are the above, taking the Earth's rotation from frame
+Vec<3> getPosECEF(StateFrame const &frame, Vec<3> body_point = Vec<3>::Zero()) const
+{
+  assert(frame.at_t.t() == t.toSec());
+  return frame.at_t.ecef_from_inertial(getPosECI(body_point));
+}
+Vec<3> getRelPosECEF(StateFrame const &frame, Vec<3> body_point = Vec<3>::Zero()) const
+{
+  assert(frame.at_t.t() == t.toSec() && frame.at_t_start.t() == t_start.toSec());
+  return frame.at_t.ecef_from_inertial(getPosECI(body_point)) -
+         frame.at_t_start.ecef_from_inertial(pos_eci - rel_pos_eci);
+}
+Vec<3> getVelECEF(StateFrame const &frame, Vec<3> body_point = Vec<3>::Zero(),
+                  boost::optional<Vec<3> > gyro = boost::none) const
+{
+  assert(frame.at_t.t() == t.toSec());
+  return frame.at_t.ecef_vel_from_inertial_vel(getVelECI(body_point, gyro), pos_eci);
+}
+Quaternion getOrientECEF(StateFrame const &frame) const
+{
+  assert(frame.at_t.t() == t.toSec());
+  return frame.at_t.ecef_orient_from_inertial_orient(orient);
+}
 ODOM_ESTIMATOR_DEFINE_MANIFOLD_END()
 
+inline StateFrame::StateFrame(State const &mean)
+  : at_t(mean.t.toSec()), at_t_start(mean.t_start.toSec()), enu(at_t.ecef_from_inertial(mean.getPosECI()))
+{
+}
+
 ODOM_ESTIMATOR_DEFINE_MANIFOLD_BEGIN(_PredictNoise, ,
                                      (Vec<3>, gyro)(Vec<3>, accel)(Vec<3>, gyro_bias_noise)(Vec<3>, accel_bias_noise))
 ODOM_ESTIMATOR_DEFINE_MANIFOLD_END()
 class StateUpdater : public UnscentedTransformDistributionFunction<State, State, _PredictNoise>
 {
   sensor_msgs::Imu const imu;
+  gravity::LocalGravity const *local_gravity;
 
   GaussianDistribution<_PredictNoise> get_extra_distribution() const
   {
@@ -78,7 +124,8 @@ class StateUpdater : public UnscentedTransformDistributionFunction<State, State,
     Vec<3> accelnograv_accelbody = extra.accel - state.accel_bias;
     Quaternion world_from_accelbody = Quaternion(state.orient);
     Vec<3> accelnograv_world = world_from_accelbody._transformVector(accelnograv_accelbody);
-    Vec<3> accel_world = accelnograv_world + gravity::gravity(state.pos_eci);
+    Vec<3> accel_world =
+        accelnograv_world + (local_gravity ? (*local_gravity)(state.pos_eci) : gravity::gravity(state.pos_eci));
 
     return State(imu.header.stamp, state.t_start, state.pos_eci + dt * state.vel + dt * dt / 2 * accel_world,
                  state.rel_pos_eci + dt * state.vel + dt * dt / 2 * accel_world, world_from_newbody,
@@ -87,8 +134,94 @@ class StateUpdater : public UnscentedTransformDistributionFunction<State, State,
   }
 
 public:
-  StateUpdater(sensor_msgs::Imu const &imu) : imu(imu)
+  // uses local_gravity, updated about the state, in place of the full
+  // gravity model if given
+  StateUpdater(sensor_msgs::Imu const &imu, ThreadPool *thread_pool = nullptr,
+               gravity::LocalGravity const *local_gravity = nullptr)
+    : UnscentedTransformDistributionFunction<State, State, _PredictNoise>(thread_pool)
+    , imu(imu)
+    , local_gravity(local_gravity)
+  {
+  }
+
+  // propagates only the mean, for outputs that don't need a new covariance
+  State predict_mean(State const &state) const
+  {
+    return apply(state, get_extra_distribution().mean);
+  }
+};
+
+// accumulates IMU samples following a filter step into one equivalent
+// sample, so a single StateUpdater can predict over all of them. Each sample
+// is held from the previous one's stamp until its own, as in StateUpdater.
+// The rotation and velocity change are exact barring the biases; the
+// position change treats the acceleration as constant over the interval.
+class ImuPreintegrator
+{
+  ros::Time start, end;
+  sensor_msgs::Imu last;
+  unsigned int count;
+  Quaternion delta_orient;  // current body from start body
+  Vec<3> delta_vel;         // in the start body frame, without gravity
+  SqMat<3> gyro_cov_sum, accel_cov_sum;
+
+public:
+  ImuPreintegrator()
+  {
+    reset(ros::Time());
+  }
+
+  // starts over after a filter step at stamp
+  void reset(ros::Time const &stamp)
+  {
+    start = end = stamp;
+    count = 0;
+    delta_orient = Quaternion::Identity();
+    delta_vel = Vec<3>::Zero();
+    gyro_cov_sum = accel_cov_sum = SqMat<3>::Zero();
+  }
+
+  void add(sensor_msgs::Imu const &msg)
+  {
+    double dt = (msg.header.stamp - end).toSec();
+    SqMat<3> start_from_body = delta_orient.toRotationMatrix();
+    delta_vel += dt * start_from_body * xyz2vec(msg.linear_acceleration);
+    delta_orient = delta_orient * quat_from_rotvec(dt * xyz2vec(msg.angular_velocity));
+    gyro_cov_sum += dt * dt * Eigen::Map<const SqMat<3> >(msg.angular_velocity_covariance.data());
+    SqMat<3> accel_cov = Eigen::Map<const SqMat<3> >(msg.linear_acceleration_covariance.data());
+    accel_cov_sum += dt * dt * start_from_body * accel_cov * start_from_body.transpose();
+    end = msg.header.stamp;
+    last = msg;
+    count++;
+  }
+
+  unsigned int size() const
+  {
+    return count;
+  }
+  ros::Time get_end() const
+  {
+    return end;
+  }
+  ros::Duration duration() const
+  {
+    return end - start;
+  }
+
+  // returns the sample that, held from start to end, has the same effect as
+  // the ones added. There must be at least one.
+  sensor_msgs::Imu get_imu() const
   {
+    assert(count);
+    double dt = duration().toSec();
+    sensor_msgs::Imu res = last;
+    if (dt <= 0)
+      return res;
+    tf::vectorEigenToMsg(rotvec_from_quat(delta_orient) / dt, res.angular_velocity);
+    tf::vectorEigenToMsg(delta_vel / dt, res.linear_acceleration);
+    Eigen::Map<SqMat<3> >(res.angular_velocity_covariance.data()) = gyro_cov_sum / (dt * dt);
+    Eigen::Map<SqMat<3> >(res.linear_acceleration_covariance.data()) = accel_cov_sum / (dt * dt);
+    return res;
   }
 };
 }
@@ -0,0 +1,123 @@
+#ifndef GUARD_QWHNUXKRBMTEPLCS
+#define GUARD_QWHNUXKRBMTEPLCS
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace odom_estimator
+{
+// is a small set of persistent worker threads used to evaluate sigma points in
+// parallel. The range of a parallel_for is split into one contiguous chunk per
+// thread, with the calling thread taking the first, so which thread handles an
+// index only depends on the range and the number of threads.
+class ThreadPool
+{
+public:
+  // starts `threads - 1` workers, as the calling thread also does a share.
+  // Each worker calls `on_start` first, if given, e.g. to set its scheduling.
+  explicit ThreadPool(unsigned int threads, std::function<void()> on_start = nullptr)
+    : threads(std::max(threads, 1u)), on_start(on_start), chunk_count(0), generation(0), pending(0), stopping(false)
+  {
+    for (unsigned int i = 1; i < this->threads; i++)
+      workers.emplace_back([this, i]() { work(i); });
+  }
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    start_cv.notify_all();
+    for (std::thread &worker : workers)
+      worker.join();
+  }
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  unsigned int size() const
+  {
+    return threads;
+  }
+
+  // calls `task(i)` for every i in [0, count) and returns once all have
+  // finished. Each index must only write to its own output.
+  template <typename Task>
+  void parallel_for(unsigned int count, Task const &task)
+  {
+    std::lock_guard<std::mutex> run_lock(run_mutex);  // one range at a time
+    auto run_chunk = [&task](unsigned int begin, unsigned int end) {
+      for (unsigned int i = begin; i < end; i++)
+        task(i);
+    };
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      chunk = run_chunk;
+      chunk_count = count;
+      pending = threads - 1;
+      generation++;
+    }
+    start_cv.notify_all();
+
+    run_chunk(chunk_begin(0, count), chunk_begin(1, count));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this]() { return pending == 0; });
+    chunk = nullptr;
+  }
+
+private:
+  unsigned int chunk_begin(unsigned int thread, unsigned int count) const
+  {
+    return static_cast<unsigned long>(count) * thread / threads;
+  }
+
+  void work(unsigned int thread)
+  {
+    if (on_start)
+      on_start();
+    unsigned long seen = 0;
+    while (true)
+    {
+      std::function<void(unsigned int, unsigned int)> my_chunk;
+      unsigned int count;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        start_cv.wait(lock, [this, seen]() { return stopping || generation != seen; });
+        if (stopping)
+          return;
+        seen = generation;
+        my_chunk = chunk;
+        count = chunk_count;
+      }
+
+      my_chunk(chunk_begin(thread, count), chunk_begin(thread + 1, count));
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending--;
+      }
+      done_cv.notify_one();
+    }
+  }
+
+  unsigned int const threads;
+  std::function<void()> const on_start;
+  std::vector<std::thread> workers;
+
+  std::mutex run_mutex;
+  std::mutex mutex;
+  std::condition_variable start_cv;
+  std::condition_variable done_cv;
+  std::function<void(unsigned int, unsigned int)> chunk;
+  unsigned int chunk_count;
+  unsigned long generation;
+  unsigned int pending;
+  bool stopping;
+};
+}
+
+#endif
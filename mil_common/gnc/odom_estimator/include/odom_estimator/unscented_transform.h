@@ -1,11 +1,16 @@
 #ifndef GUARD_ZDOCIICJDATIGJFB
 #define GUARD_ZDOCIICJDATIGJFB
 
+#include <type_traits>
+#include <vector>
+
 #include <Eigen/Dense>
+#include <Eigen/StdVector>
 #include <boost/function.hpp>
 #include <boost/optional.hpp>
 
 #include "odom_estimator/manifold.h"
+#include "odom_estimator/thread_pool.h"
 #include "odom_estimator/util.h"
 
 namespace odom_estimator
@@ -42,62 +47,295 @@ public:
   }
 };
 
-// approximately transforms a distribution, `in`, by a function, `func`,
-// resulting in a new distribution (along with the cross-correlation with the
-// original distribution)
-template <typename OutPointType, typename InPointType>
-GaussianDistributionWithCrossCov<OutPointType, InPointType>
-unscented_transform(boost::function<OutPointType(InPointType)> const &func, GaussianDistribution<InPointType> const &in,
-                    double alpha = 1e-3, double beta = 2, double kappa = 0)
+// is a gaussian distribution on an arbitrary manifold, represented by the
+// lower triangular square root of its covariance, cov = sqrt_cov sqrt_cov^T,
+// so that it can be propagated without refactoring the covariance
+template <typename PointType>
+struct SqrtGaussianDistribution
+{
+  PointType mean;
+  SqMat<PointType::RowsAtCompileTime> sqrt_cov;
+
+  SqrtGaussianDistribution(PointType const &mean, SqMat<PointType::RowsAtCompileTime> const &sqrt_cov)
+    : mean(mean), sqrt_cov(sqrt_cov)
+  {
+    assert(sqrt_cov.rows() == mean.rows());
+    assert(sqrt_cov.cols() == mean.rows());
+  }
+  explicit SqrtGaussianDistribution(GaussianDistribution<PointType> const &gd)
+    : mean(gd.mean), sqrt_cov(triangular_cholesky<PointType::RowsAtCompileTime>(gd.cov))
+  {
+  }
+
+  GaussianDistribution<PointType> distribution() const
+  {
+    return GaussianDistribution<PointType>(mean, sqrt_cov * sqrt_cov.transpose());
+  }
+};
+
+// is a SqrtGaussianDistribution that also has cross-covariance information
+// between this and another implied distribution
+template <typename PointType, typename CrossPointType>
+class SqrtGaussianDistributionWithCrossCov : public SqrtGaussianDistribution<PointType>
+{
+  typedef Mat<PointType::RowsAtCompileTime, CrossPointType::RowsAtCompileTime> CrossCovType;
+
+public:
+  CrossCovType cross_cov;  // = E[(this - this.mean) * (other - other.mean)^T]
+
+  SqrtGaussianDistributionWithCrossCov(SqrtGaussianDistribution<PointType> const &gd, CrossCovType const &cross_cov)
+    : SqrtGaussianDistribution<PointType>(gd), cross_cov(cross_cov)
+  {
+    assert(cross_cov.rows() == this->mean.rows());
+  }
+};
+
+// is the sigma points of the unscented transform of a distribution, `in`.
+// Several functions of the same distribution can be transformed with one
+// instance, so the covariance is only factored and the sigma points are only
+// generated once.
+// Functions are taken as template parameters so that they can be inlined, and
+// their outputs are stored in matrices sized at compile time when the point
+// types are, so the mean and covariance are a few fused matrix products.
+template <typename InPointType>
+class SigmaPoints
 {
-  static const int OutVecLen = OutPointType::RowsAtCompileTime;
   static const int InVecLen = InPointType::RowsAtCompileTime;
-  unsigned int in_vec_len = InVecLen != Dynamic ? InVecLen : in.cov.rows();
+  static const int PerturbedCount = addRowsAtCompileTime(InVecLen, InVecLen);
+  static const int PointCount = addRowsAtCompileTime(1, PerturbedCount);
 
-  unsigned int L = in_vec_len;
-  double lambda = pow(alpha, 2) * (L + kappa) - L;
+  unsigned int L;
+  double W_0_c;
+  double W_i;
+  // sqrt_cov = P^T lower, with lower triangular, so that the cross covariance
+  // can use it being triangular. For a GaussianDistribution, this is the same
+  // factorization as cholesky, with lower = L D^(1/2).
+  SqMat<InVecLen> lower;
+  Eigen::Transpositions<InVecLen> transpositions;  // = P
+  SqMat<InVecLen> sqrt_cov;
+  // point i is in.mean + dx_i, with dx_0 = 0, dx_i = sqrt_cov.col(i - 1) and
+  // dx_(L + i) = -dx_i
+  std::vector<InPointType, Eigen::aligned_allocator<InPointType> > points;
+
+  double init(unsigned int in_vec_len, double alpha, double beta, double kappa)
+  {
+    L = in_vec_len;
+    double lambda = pow(alpha, 2) * (L + kappa) - L;
+    W_0_c = lambda / (L + lambda) + (1 - pow(alpha, 2) + beta);
+    W_i = 1. / 2 / (L + lambda);
+    return L + lambda;
+  }
 
-  SqMat<InVecLen> sqrt_cov = cholesky<InVecLen>((L + lambda) * in.cov);
+  void generate(InPointType const &mean)
+  {
+    points.reserve(2 * L + 1);
+    points.push_back(mean);
+    for (unsigned int i = 0; i < L; i++)
+      points.push_back(mean + Vec<InVecLen>(sqrt_cov.col(i)));
+    for (unsigned int i = 0; i < L; i++)
+      points.push_back(mean + Vec<InVecLen>(-sqrt_cov.col(i)));
+  }
 
-  Vec<InVecLen> in_vecs[2 * L + 1];
-  boost::optional<OutPointType> out_points[2 * L + 1];
-  for (unsigned int i = 0; i <= 2 * L; i++)
+  // evaluates `func` at every sigma point, setting column i of `out_dxs` to
+  // the offset of the output at point i from the returned mean output
+  template <typename OutPointType, typename Func>
+  OutPointType evaluate(Func const &func, ThreadPool *pool,
+                        Mat<OutPointType::RowsAtCompileTime, PointCount> &out_dxs) const
   {
-    Vec<InVecLen> dx;
-    if (i == 0)
-      dx = Vec<InVecLen>::Zero(in_vec_len, 1);
-    else if (i <= L)
-      dx = sqrt_cov.col(i - 1);
+    static const int OutVecLen = OutPointType::RowsAtCompileTime;
+
+    // the outputs' offsets from the output at point 0 are kept first
+    OutPointType out_point_0(func(points[0]));
+    unsigned int out_vec_len = OutVecLen != Dynamic ? OutVecLen : (out_point_0 - out_point_0).rows();
+    out_dxs.resize(out_vec_len, 2 * L + 1);
+    out_dxs.col(0).setZero();
+    auto evaluate_point = [&](unsigned int i) { out_dxs.col(i) = OutPointType(func(points[i])) - out_point_0; };
+    if (pool && pool->size() > 1)
+      pool->parallel_for(2 * L, [&evaluate_point](unsigned int i) { evaluate_point(i + 1); });
     else
-      dx = -sqrt_cov.col(i - L - 1);
+      for (unsigned int i = 1; i <= 2 * L; i++)
+        evaluate_point(i);
+
+    // column 0 is zero, so the weight of point 0 drops out of the mean
+    Vec<OutVecLen> out_mean_minus_out_point_0 = W_i * out_dxs.rowwise().sum();
+    OutPointType out_mean = out_point_0 + out_mean_minus_out_point_0;
 
-    in_vecs[i] = dx;
-    out_points[i] = func(in.mean + dx);
+    // center the offsets on the mean, then all the weighted outer products are
+    // sums over columns. On a manifold, (p_i - p_0) - (mean - p_0) is not
+    // p_i - mean, so the points are recovered as p_0 + (p_i - p_0).
+    if (std::is_base_of<Eigen::MatrixBase<OutPointType>, OutPointType>::value)
+      out_dxs.colwise() -= out_mean_minus_out_point_0;
+    else
+      for (unsigned int i = 0; i <= 2 * L; i++)
+        out_dxs.col(i) = (out_point_0 + Vec<OutVecLen>(out_dxs.col(i))) - out_mean;
+    return out_mean;
   }
 
-  unsigned int out_vec_len = OutVecLen != Dynamic ? OutVecLen : (*out_points[0] - *out_points[0]).rows();
-  Vec<OutVecLen> out_mean_minus_out_points_0 = Vec<OutVecLen>::Zero(out_vec_len, 1);
-  for (unsigned int i = 0; i <= 2 * L; i++)
+  template <int OutVecLen>
+  Mat<OutVecLen, InVecLen> cross_cov(Mat<OutVecLen, PointCount> const &out_dxs) const
   {
-    double W_s = i == 0 ? lambda / (L + lambda) : 1. / 2 / (L + lambda);
-    out_mean_minus_out_points_0.noalias() += W_s * (*out_points[i] - *out_points[0]);
+    // dx_0 is zero and dx_(L + i) = -dx_i, so the cross terms of point 0
+    // vanish and the others pair up
+    auto out_dxs_plus = out_dxs.template block<OutVecLen, InVecLen>(0, 1, out_dxs.rows(), L);
+    auto out_dxs_minus = out_dxs.template block<OutVecLen, InVecLen>(0, 1 + L, out_dxs.rows(), L);
+    Mat<OutVecLen, InVecLen> out_dxs_paired = W_i * (out_dxs_plus - out_dxs_minus);
+    Mat<OutVecLen, InVecLen> res(out_dxs.rows(), L);
+    if (InVecLen != Dynamic && InVecLen <= 8)
+    {
+      // small fixed size products are unrolled, which beats exploiting structure
+      res.noalias() = out_dxs_paired * sqrt_cov.transpose();
+    }
+    else
+    {
+      // sqrt_cov^T = lower^T P, with lower^T triangular
+      Mat<OutVecLen, InVecLen> res_p(out_dxs.rows(), L);
+      res_p.noalias() = out_dxs_paired * lower.template triangularView<Eigen::Lower>().transpose();
+      res.noalias() = res_p * transpositions.transpose();
+    }
+    return res;
   }
-  OutPointType out_mean = *out_points[0] + out_mean_minus_out_points_0;
 
-  SqMat<OutVecLen> out_cov = SqMat<OutVecLen>::Zero(out_vec_len, out_vec_len);
-  Mat<OutVecLen, InVecLen> out_cross_cov = Mat<OutVecLen, InVecLen>::Zero(out_vec_len, in_vec_len);
-  for (unsigned int i = 0; i <= 2 * L; i++)
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  SigmaPoints(GaussianDistribution<InPointType> const &in, double alpha = 1e-3, double beta = 2, double kappa = 0)
   {
-    double W_c = i == 0 ? lambda / (L + lambda) + (1 - pow(alpha, 2) + beta) : 1. / 2 / (L + lambda);
-    Vec<OutVecLen> dx = *out_points[i] - out_mean;
-    out_cov.noalias() += W_c * dx * dx.transpose();
-    out_cross_cov.noalias() += W_c * dx * in_vecs[i].transpose();
+    double scale = init(InVecLen != Dynamic ? InVecLen : in.cov.rows(), alpha, beta, kappa);
+
+    Eigen::LDLT<SqMat<InVecLen> > ldlt(scale * in.cov);
+    lower = SqMat<InVecLen>(ldlt.matrixL()) * Vec<InVecLen>(ldlt.vectorD().array().sqrt()).asDiagonal();
+    transpositions = ldlt.transpositionsP();
+    sqrt_cov = transpositions.transpose() * lower;
+
+    generate(in.mean);
   }
 
+  // uses the square root of the covariance directly, so nothing is factored
+  SigmaPoints(SqrtGaussianDistribution<InPointType> const &in, double alpha = 1e-3, double beta = 2, double kappa = 0)
+  {
+    double scale = init(InVecLen != Dynamic ? InVecLen : in.sqrt_cov.rows(), alpha, beta, kappa);
+
+    lower = sqrt(scale) * in.sqrt_cov;
+    transpositions.resize(L);
+    transpositions.setIdentity();
+    sqrt_cov = lower;
+
+    generate(in.mean);
+  }
+
+  // approximately transforms the distribution by a function, `func`,
+  // resulting in a new distribution (along with the cross-correlation with
+  // the original distribution)
+  // If `pool` is given, `func` is evaluated at the sigma points across its
+  // threads, so it must be safe to call concurrently. Each sigma point still
+  // has its own output column and the sums are done serially, so the result
+  // is identical to the serial one.
+  template <typename OutPointType, typename Func>
+  GaussianDistributionWithCrossCov<OutPointType, InPointType> transform(Func const &func,
+                                                                        ThreadPool *pool = nullptr) const
+  {
+    static const int OutVecLen = OutPointType::RowsAtCompileTime;
+
+    Mat<OutVecLen, PointCount> out_dxs;
+    OutPointType out_mean = evaluate<OutPointType>(func, pool, out_dxs);
+    auto out_dx_0 = out_dxs.col(0);
+    auto out_dxs_perturbed = out_dxs.template block<OutVecLen, PerturbedCount>(0, 1, out_dxs.rows(), 2 * L);
+
+    SqMat<OutVecLen> out_cov(out_dxs.rows(), out_dxs.rows());
+    if (InVecLen != Dynamic && InVecLen <= 8)
+    {
+      out_cov.noalias() = W_0_c * out_dx_0 * out_dx_0.transpose();
+      out_cov.noalias() += W_i * out_dxs_perturbed * out_dxs_perturbed.transpose();
+    }
+    else
+    {
+      // the covariance is symmetric, so only accumulate its lower half
+      out_cov.setZero();
+      out_cov.template selfadjointView<Eigen::Lower>().rankUpdate(out_dx_0, W_0_c);
+      out_cov.template selfadjointView<Eigen::Lower>().rankUpdate(out_dxs_perturbed, W_i);
+      out_cov.template triangularView<Eigen::StrictlyUpper>() = out_cov.transpose();
+    }
+
+    return GaussianDistributionWithCrossCov<OutPointType, InPointType>(
+        GaussianDistribution<OutPointType>(out_mean, out_cov), cross_cov<OutVecLen>(out_dxs));
+  }
+
+  // is transform, but produces the square root of the covariance, from a QR
+  // decomposition of the perturbed points and a rank 1 update for point 0
+  template <typename OutPointType, typename Func>
+  SqrtGaussianDistributionWithCrossCov<OutPointType, InPointType> sqrt_transform(Func const &func,
+                                                                                 ThreadPool *pool = nullptr) const
+  {
+    static const int OutVecLen = OutPointType::RowsAtCompileTime;
+
+    Mat<OutVecLen, PointCount> out_dxs;
+    OutPointType out_mean = evaluate<OutPointType>(func, pool, out_dxs);
+    auto out_dxs_perturbed = out_dxs.template block<OutVecLen, PerturbedCount>(0, 1, out_dxs.rows(), 2 * L);
+
+    SqMat<OutVecLen> out_sqrt_cov = lower_factor_from_qr(sqrt(W_i) * out_dxs_perturbed.transpose());
+    SqMat<OutVecLen> updated = out_sqrt_cov;
+    if (cholesky_rank_update<OutVecLen>(updated, out_dxs.col(0), W_0_c))
+      out_sqrt_cov = updated;
+    else  // the update lost definiteness, so fall back to factoring the covariance
+      out_sqrt_cov = triangular_cholesky<OutVecLen>(out_sqrt_cov * out_sqrt_cov.transpose() +
+                                                    W_0_c * out_dxs.col(0) * out_dxs.col(0).transpose());
+
+    return SqrtGaussianDistributionWithCrossCov<OutPointType, InPointType>(
+        SqrtGaussianDistribution<OutPointType>(out_mean, out_sqrt_cov), cross_cov<OutVecLen>(out_dxs));
+  }
+};
+
+// approximately transforms a distribution, `in`, by a function, `func`,
+// resulting in a new distribution (along with the cross-correlation with the
+// original distribution)
+// If `pool` is given, `func` is evaluated across its threads, as in
+// SigmaPoints::transform.
+template <typename OutPointType, typename InPointType, typename Func>
+GaussianDistributionWithCrossCov<OutPointType, InPointType>
+unscented_transform(Func const &func, GaussianDistribution<InPointType> const &in, double alpha = 1e-3,
+                    double beta = 2, double kappa = 0, ThreadPool *pool = nullptr)
+{
+  return SigmaPoints<InPointType>(in, alpha, beta, kappa).template transform<OutPointType>(func, pool);
+}
+
+// exactly transforms a distribution, `in`, by a function, `func`, that is
+// linear on the tangent space of the input, such as one selecting some of the
+// fields of a state. Differencing along each axis then gives its Jacobian
+// exactly, so this needs only L + 1 evaluations and no factorization.
+template <typename OutPointType, typename InPointType, typename Func>
+GaussianDistributionWithCrossCov<OutPointType, InPointType>
+linear_transform(Func const &func, GaussianDistribution<InPointType> const &in)
+{
+  static const int OutVecLen = OutPointType::RowsAtCompileTime;
+  static const int InVecLen = InPointType::RowsAtCompileTime;
+  unsigned int in_vec_len = InVecLen != Dynamic ? InVecLen : in.cov.rows();
+
+  OutPointType out_mean(func(in.mean));
+  unsigned int out_vec_len = OutVecLen != Dynamic ? OutVecLen : (out_mean - out_mean).rows();
+  Mat<OutVecLen, InVecLen> jacobian(out_vec_len, in_vec_len);
+  for (unsigned int i = 0; i < in_vec_len; i++)
+  {
+    Vec<InVecLen> dx = Vec<InVecLen>::Unit(in_vec_len, i);
+    jacobian.col(i) = OutPointType(func(in.mean + dx)) - out_mean;
+  }
+
+  Mat<OutVecLen, InVecLen> out_cross_cov = jacobian * in.cov;
+  SqMat<OutVecLen> out_cov = out_cross_cov * jacobian.transpose();
   return GaussianDistributionWithCrossCov<OutPointType, InPointType>(
       GaussianDistribution<OutPointType>(out_mean, out_cov), out_cross_cov);
 }
 
+// is the unscented transform of a type erased function, kept for callers that
+// already have one
+template <typename OutPointType, typename InPointType>
+GaussianDistributionWithCrossCov<OutPointType, InPointType>
+unscented_transform(boost::function<OutPointType(InPointType)> const &func, GaussianDistribution<InPointType> const &in,
+                    double alpha = 1e-3, double beta = 2, double kappa = 0)
+{
+  return unscented_transform<OutPointType, InPointType, boost::function<OutPointType(InPointType)> >(func, in, alpha,
+                                                                                                      beta, kappa);
+}
+
 // is an interface describing functors that take a GaussianDistribution and
 // produce a GaussianDistributionWithCrossCov, possibly with distinct point
 // types
@@ -112,10 +350,17 @@ public:
 // is an implementation of IDistributionFunction that allows subclasses to
 // fill in a point propagation function and then uses it to transform
 // distributions using the unscented transform
+// If `thread_pool` is given, `apply` is called concurrently from its threads.
 template <typename InType, typename OutType, typename ExtraType>
 class UnscentedTransformDistributionFunction : public IDistributionFunction<InType, OutType>
 {
+  ThreadPool *thread_pool;
+
 public:
+  UnscentedTransformDistributionFunction(ThreadPool *thread_pool = nullptr) : thread_pool(thread_pool)
+  {
+  }
+
   virtual GaussianDistribution<ExtraType> get_extra_distribution() const = 0;
   virtual OutType apply(InType const &input, ExtraType const &extra) const = 0;
 
@@ -129,12 +374,34 @@ public:
     GaussianDistributionWithCrossCov<OutType, InAndExtraType> res = unscented_transform<OutType, InAndExtraType>(
         [this](InAndExtraType const &x) { return apply(x.first, x.second); },
         GaussianDistribution<InAndExtraType>(InAndExtraType(input.mean, extra.mean),
-                                             joinDiagonally(input.cov, extra.cov)));
+                                             joinDiagonally(input.cov, extra.cov)),
+        1e-3, 2, 0, thread_pool);
 
     return GaussianDistributionWithCrossCov<OutType, InType>(
         GaussianDistribution<OutType>(res.mean, res.cov),
         res.cross_cov.template topLeftCorner(res.mean.rows(), input.mean.rows()));
   }
+
+  // is operator(), but carries the square root of the covariance through, so
+  // only the extra distribution's covariance is factored
+  SqrtGaussianDistributionWithCrossCov<OutType, InType>
+  sqrt_transform(SqrtGaussianDistribution<InType> const &input) const
+  {
+    typedef ManifoldPair<InType, ExtraType> InAndExtraType;
+
+    SqrtGaussianDistribution<ExtraType> extra(get_extra_distribution());
+
+    SqrtGaussianDistributionWithCrossCov<OutType, InAndExtraType> res =
+        SigmaPoints<InAndExtraType>(SqrtGaussianDistribution<InAndExtraType>(InAndExtraType(input.mean, extra.mean),
+                                                                             joinDiagonally(input.sqrt_cov,
+                                                                                            extra.sqrt_cov)))
+            .template sqrt_transform<OutType>([this](InAndExtraType const &x) { return apply(x.first, x.second); },
+                                              thread_pool);
+
+    return SqrtGaussianDistributionWithCrossCov<OutType, InType>(
+        SqrtGaussianDistribution<OutType>(res.mean, res.sqrt_cov),
+        res.cross_cov.template topLeftCorner(res.mean.rows(), input.mean.rows()));
+  }
 };
 
 // is a specialization of UnscentedTransformDistributionFunction that allows
@@ -157,8 +424,11 @@ public:
   }
   EasyDistributionFunction(std::function<OutType(InType, ExtraType)> func,
                            ExtraDistributionType const &extra_distribution = ExtraDistributionType(ExtraType(),
-                                                                                                   SqMat<0>()))
-    : func(func), extra_distribution(extra_distribution)
+                                                                                                   SqMat<0>()),
+                           ThreadPool *thread_pool = nullptr)
+    : UnscentedTransformDistributionFunction<InType, OutType, ExtraType>(thread_pool)
+    , func(func)
+    , extra_distribution(extra_distribution)
   {
   }
 };
@@ -94,6 +94,58 @@ SqMat<N> cholesky(SqMat<N> x)
          Vec<N>(ldlt.vectorD().array().sqrt()).asDiagonal();
 }
 
+// returns the lower triangular S, with a nonnegative diagonal, such that
+// S S^T = a^T a, using only a QR decomposition of a
+template <typename Derived>
+SqMat<Derived::ColsAtCompileTime> lower_factor_from_qr(Eigen::MatrixBase<Derived> const &a)
+{
+  static const int N = Derived::ColsAtCompileTime;
+  SqMat<N> res = SqMat<N>::Zero(a.cols(), a.cols());
+  if (a.rows() == 0 || a.cols() == 0)
+    return res;
+  Eigen::HouseholderQR<Mat<Derived::RowsAtCompileTime, N> > qr(a);
+  unsigned int rank = std::min(a.rows(), a.cols());
+  res.leftCols(rank) = qr.matrixQR().topRows(rank).template triangularView<Eigen::Upper>().transpose();
+  for (unsigned int i = 0; i < rank; i++)
+    if (res(i, i) < 0)
+      res.col(i) = -res.col(i);
+  return res;
+}
+
+// returns the lower triangular S such that S S^T = x. Unlike cholesky, x
+// only needs to be positive semidefinite.
+template <int N>
+SqMat<N> triangular_cholesky(SqMat<N> const &x)
+{
+  if (x.rows() == 0)
+    return x;  // Eigen::LDLT crashes for zero-sized matrices
+  Eigen::LDLT<SqMat<N> > ldlt = x.ldlt();
+  SqMat<N> sqrt_x = ldlt.transpositionsP().transpose() * SqMat<N>(ldlt.matrixL()) *
+                    Vec<N>(ldlt.vectorD().array().max(0).sqrt()).asDiagonal();
+  return lower_factor_from_qr(sqrt_x.transpose());
+}
+
+// replaces the lower triangular s with the factor of s s^T + sigma v v^T.
+// Returns false, leaving s unusable, if that isn't positive definite.
+template <int N>
+bool cholesky_rank_update(SqMat<N> &s, Vec<N> v, double sigma)
+{
+  for (unsigned int k = 0; k < s.rows(); k++)
+  {
+    double r2 = s(k, k) * s(k, k) + sigma * v(k) * v(k);
+    if (!(r2 > 0) || !(s(k, k) > 0))
+      return false;
+    double r = sqrt(r2);
+    double c = r / s(k, k);
+    double sn = v(k) / s(k, k);
+    s(k, k) = r;
+    unsigned int rest = s.rows() - k - 1;
+    s.col(k).tail(rest) = (s.col(k).tail(rest) + sigma * sn * v.tail(rest)) / c;
+    v.tail(rest) = c * v.tail(rest) - sn * s.col(k).tail(rest);
+  }
+  return true;
+}
+
 inline Vec<3> xyz2vec(const geometry_msgs::Vector3 &msg)
 {
   Vec<3> res;
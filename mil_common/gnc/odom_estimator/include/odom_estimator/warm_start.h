@@ -0,0 +1,179 @@
+#ifndef GUARD_WSNQTLMXFAZRHEVC
+#define GUARD_WSNQTLMXFAZRHEVC
+
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+
+#include <boost/optional.hpp>
+
+#include <ros/time.h>
+#include <sensor_msgs/Imu.h>
+
+#include "odom_estimator/earth.h"
+#include "odom_estimator/magnetic.h"
+#include "odom_estimator/state.h"
+#include "odom_estimator/unscented_transform.h"
+#include "odom_estimator/util.h"
+
+namespace odom_estimator
+{
+// is the part of a converged state worth keeping over a restart or reset:
+// where the vehicle was, which way it faced and the IMU biases, along with
+// their covariances. It's kept in ECEF, so it doesn't depend on the time it's
+// used at, and is saved as text, so it can be looked at or removed by hand.
+struct WarmStart
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  ros::Time stamp;
+  Vec<3> pos_ecef;
+  Vec<3> rel_pos_ecef;
+  Quaternion orient_ecef;
+  Vec<3> gyro_bias;
+  Vec<3> accel_bias;
+  SqMat<6> pos_cov;   // of pos_ecef then rel_pos_ecef
+  SqMat<6> bias_cov;  // of gyro_bias then accel_bias
+
+  // takes the warm start from the state's mean and the blocks of its
+  // covariance for the positions and the biases
+  static WarmStart from_state(GaussianDistribution<State> const &state)
+  {
+    WarmStart res;
+    res.stamp = state.mean.t;
+    res.pos_ecef = state.mean.getPosECEF();
+    res.rel_pos_ecef = state.mean.getRelPosECEF();
+    res.orient_ecef = state.mean.getOrientECEF();
+    res.gyro_bias = state.mean.gyro_bias;
+    res.accel_bias = state.mean.accel_bias;
+    // the positions' covariance is rotated from ECI, the biases' is in the
+    // body frame either way
+    SqMat<6> ecef_from_eci = SqMat<6>::Zero();
+    ecef_from_eci.topLeftCorner<3, 3>() = ecef_from_eci.bottomRightCorner<3, 3>() =
+        quat_from_rotvec(-w_E * state.mean.t.toSec()).toRotationMatrix();
+    res.pos_cov = ecef_from_eci * state.cov.block<6, 6>(0, 0) * ecef_from_eci.transpose();
+    res.bias_cov = state.cov.block<6, 6>(12, 12);
+    return res;
+  }
+
+  // writes to a temporary file beside path and renames it over path, so a
+  // crash mid write never leaves a truncated warm start behind
+  bool save(std::string const &path) const
+  {
+    std::string const tmp_path = path + ".tmp";
+    {
+      std::ofstream out(tmp_path.c_str());
+      out.precision(std::numeric_limits<double>::max_digits10);
+      out << "odom_estimator_warm_start 1\n"
+          << stamp.sec << ' ' << stamp.nsec << '\n'
+          << pos_ecef.transpose() << '\n'
+          << rel_pos_ecef.transpose() << '\n'
+          << orient_ecef.coeffs().transpose() << '\n'
+          << gyro_bias.transpose() << '\n'
+          << accel_bias.transpose() << '\n'
+          << pos_cov << '\n'
+          << bias_cov << '\n';
+      out.close();
+      if (!out)
+        return false;
+    }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+  }
+
+  // reads what save wrote, or returns none if path is missing or malformed
+  static boost::optional<WarmStart> load(std::string const &path)
+  {
+    std::ifstream in(path.c_str());
+    std::string magic;
+    int version;
+    if (!(in >> magic >> version) || magic != "odom_estimator_warm_start" || version != 1)
+      return boost::none;
+    WarmStart res;
+    Vec<4> orient_coeffs;
+    in >> res.stamp.sec >> res.stamp.nsec;
+    read(in, res.pos_ecef);
+    read(in, res.rel_pos_ecef);
+    read(in, orient_coeffs);
+    read(in, res.gyro_bias);
+    read(in, res.accel_bias);
+    read(in, res.pos_cov);
+    read(in, res.bias_cov);
+    if (!in || !orient_coeffs.allFinite() || orient_coeffs.norm() < .5)
+      return boost::none;
+    res.orient_ecef = Quaternion(orient_coeffs).normalized();
+    return res;
+  }
+
+  // grows the covariances by the uncertainty added over age seconds: the
+  // biases' random walk as in StateUpdater, and pos_stddev of movement
+  // unaccounted for, in case the vehicle was moved while the filter was down
+  void age(double age, double pos_stddev)
+  {
+    bias_cov += std::max(age, 0.) * pow(1e-3, 2) * SqMat<6>::Identity();
+    pos_cov += pow(pos_stddev, 2) * SqMat<6>::Identity();
+  }
+
+private:
+  template <typename Derived>
+  static void read(std::istream &in, Eigen::MatrixBase<Derived> &m)
+  {
+    for (int i = 0; i < m.rows(); i++)
+      for (int j = 0; j < m.cols(); j++)
+        in >> m(i, j);
+  }
+};
+
+// is init_state, resuming from warm. The positions and biases are warm's, with
+// its covariances, the velocity is taken as zero with a standard deviation of
+// vel_stddev and rel_pos_ecef continues the local frame, as after a reset.
+// The orientation is levelled from the accelerometer alone, with the heading
+// taken from the magnetometer if there is a sample, else from warm with a
+// standard deviation of heading_stddev.
+GaussianDistribution<State> warm_init_state(sensor_msgs::Imu const &msg, boost::optional<Vec<3>> const &last_mag,
+                                            magnetic::MagneticModel const &magnetic_model, WarmStart const &warm,
+                                            Vec<3> rel_pos_ecef, double vel_stddev, double heading_stddev)
+{
+  double t = msg.header.stamp.toSec();
+  // the absolute position moves with the local one since warm was taken
+  Vec<3> pos_eci = inertial_from_ecef(t, warm.pos_ecef + (rel_pos_ecef - warm.rel_pos_ecef));
+
+  Vec<3> predicted_acc_eci = inertial_acc_from_ecef_acc(t, Vec<3>::Zero(), pos_eci);
+  Vec<3> predicted_accelerometer_eci = predicted_acc_eci - gravity::gravity(pos_eci);
+  Vec<3> accel_body = xyz2vec(msg.linear_acceleration);
+  Quaternion orient_eci;
+  double orient_stddev = .05;
+  if (last_mag)
+  {
+    orient_eci = triad(predicted_accelerometer_eci, magnetic_model.getField(pos_eci, t), accel_body, *last_mag);
+  }
+  else
+  {
+    // whatever way the body's x axis faced in warm
+    Vec<3> forward_eci = inertial_orient_from_ecef_orient(t, warm.orient_ecef)._transformVector(Vec<3>::UnitX());
+    orient_eci = triad(predicted_accelerometer_eci, forward_eci, accel_body, Vec<3>::UnitX());
+    orient_stddev = heading_stddev;
+  }
+
+  SqMat<State::RowsAtCompileTime> cov = SqMat<State::RowsAtCompileTime>::Zero();
+  SqMat<6> eci_from_ecef = SqMat<6>::Zero();
+  eci_from_ecef.topLeftCorner<3, 3>() = eci_from_ecef.bottomRightCorner<3, 3>() =
+      quat_from_rotvec(w_E * t).toRotationMatrix();
+  cov.block<6, 6>(0, 0) = eci_from_ecef * warm.pos_cov * eci_from_ecef.transpose();
+  // levelling fixes roll and pitch as well as the magnetometer would, the
+  // heading about the up axis may be worse
+  Vec<3> up_eci = predicted_accelerometer_eci.normalized();
+  cov.block<3, 3>(6, 6) =
+      pow(.05, 2) * SqMat<3>::Identity() + (pow(orient_stddev, 2) - pow(.05, 2)) * up_eci * up_eci.transpose();
+  cov.block<3, 3>(9, 9) = pow(vel_stddev, 2) * SqMat<3>::Identity();
+  cov.block<6, 6>(12, 12) = warm.bias_cov;
+
+  return GaussianDistribution<State>(State(msg.header.stamp, msg.header.stamp, pos_eci,
+                                           inertial_from_ecef(t, rel_pos_ecef), orient_eci,
+                                           inertial_vel_from_ecef_vel(t, Vec<3>::Zero(), pos_eci), warm.gyro_bias,
+                                           warm.accel_bias),
+                                     cov);
+}
+}
+
+#endif
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include "odom_estimator/bag_replay.h"
+
+using namespace odom_estimator;
+
+// Replays a bag through NodeImpl as fast as possible, rather than at the rate
+// it was recorded, and reports throughput, per update latency, and the error
+// of the trajectory against a reference. Used to compare filter changes and
+// check CPU headroom on the same data. Parameters are read from ~ as in the
+// nodelet, so load the same yaml to match the vehicle, and topics are the
+// nodelet's (remap them as usual).
+//
+// Usage: benchmark_bag_replay <bag> [reference nav_msgs/Odometry topic]
+//
+// The reference is compared against the absodom position if its frame is
+// ecef, and against the odom position otherwise.
+
+namespace
+{
+// is the latency of every call of one kind of update
+struct LatencyLog
+{
+  std::vector<double> us;
+
+  void print(std::string const &name) const
+  {
+    static double const edges[] = { 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000 };
+    unsigned int const bins = sizeof(edges) / sizeof(edges[0]) + 1;
+    std::vector<unsigned int> counts(bins, 0);
+    for (double x : us)
+      counts[std::upper_bound(edges, edges + bins - 1, x) - edges]++;
+
+    std::vector<double> sorted = us;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double x : sorted)
+      total += x;
+    std::cout << name << ": " << us.size() << " updates";
+    if (!sorted.empty())
+      std::cout << ", mean " << total / sorted.size() << " us, p50 " << sorted[sorted.size() / 2] << " us, p99 "
+                << sorted[sorted.size() * 99 / 100] << " us, max " << sorted.back() << " us";
+    std::cout << std::endl;
+    for (unsigned int i = 0; i < bins; i++)
+    {
+      if (!counts[i])
+        continue;
+      std::cout << "  " << std::setw(8) << (i == bins - 1 ? ">" : "<") << std::setw(6)
+                << edges[std::min(i, bins - 2)] << " us " << std::setw(8) << counts[i] << " ";
+      std::cout << std::string(60 * counts[i] / us.size(), '#') << std::endl;
+    }
+  }
+};
+
+// is a position of the estimate or the reference at a time
+struct TrajectoryPoint
+{
+  double t;
+  Vec<3> pos;
+};
+
+// linearly interpolates trajectory, sorted by time, at t if it covers t
+boost::optional<Vec<3>> interpolate(std::vector<TrajectoryPoint> const &trajectory, double t)
+{
+  std::vector<TrajectoryPoint>::const_iterator after =
+      std::lower_bound(trajectory.begin(), trajectory.end(), t,
+                       [](TrajectoryPoint const &point, double t) { return point.t < t; });
+  if (after == trajectory.end() || after == trajectory.begin())
+    return boost::none;
+  std::vector<TrajectoryPoint>::const_iterator before = after - 1;
+  double alpha = (t - before->t) / (after->t - before->t);
+  return Vec<3>((1 - alpha) * before->pos + alpha * after->pos);
+}
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "benchmark_bag_replay", ros::init_options::AnonymousName);
+  if (argc < 2)
+  {
+    std::cerr << "Usage: benchmark_bag_replay <bag> [reference nav_msgs/Odometry topic]" << std::endl;
+    return 1;
+  }
+  std::string const reference_topic = argc > 2 ? argv[2] : "";
+
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+  std::string const name = "benchmark_bag_replay";
+  NodeImpl node([&name]() -> std::string const & { return name; }, &nh, &private_nh);
+
+  rosbag::Bag bag(argv[1], rosbag::bagmode::Read);
+
+  std::map<std::string, LatencyLog> latencies;
+  double total_us = 0;
+  std::vector<TrajectoryPoint> estimate_ecef, estimate_odom, reference;
+  bool reference_is_ecef = false;
+  auto run = [&node, &latencies, &total_us, &estimate_ecef, &estimate_odom](
+                 std::string const &kind, boost::function<void()> const &update) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    update();
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    latencies[kind].us.push_back(elapsed.count());
+    total_us += elapsed.count();
+
+    boost::optional<GaussianDistribution<State>> const &state = node.get_state();
+    if (kind != "imu" || !state)
+      return;
+    double t = state->mean.t.toSec();
+    Vec<3> pos_ecef = state->mean.getPosECEF();
+    TrajectoryPoint ecef = { t, pos_ecef };
+    TrajectoryPoint odom = { t, enu_from_ecef_mat(pos_ecef) * state->mean.getRelPosECEF() };
+    estimate_ecef.push_back(ecef);
+    estimate_odom.push_back(odom);
+  };
+  auto got_reference = [&reference, &reference_is_ecef](rosbag::MessageInstance const &message) {
+    nav_msgs::OdometryConstPtr odom = message.instantiate<nav_msgs::Odometry>();
+    if (!odom)
+      return;
+    std::string const &frame = odom->header.frame_id;
+    reference_is_ecef = frame.size() >= 4 && frame.compare(frame.size() - 4, 4, "ecef") == 0;
+    TrajectoryPoint point = { odom->header.stamp.toSec(), point2vec(odom->pose.pose.position) };
+    reference.push_back(point);
+  };
+  std::vector<std::string> reference_topics;
+  if (!reference_topic.empty())
+    reference_topics.push_back(reference_topic);
+  size_t const skipped = replay_bag(bag, nh, node, run, reference_topics, got_reference);
+
+  size_t updates = 0;
+  for (std::pair<std::string const, LatencyLog> const &pair : latencies)
+    updates += pair.second.us.size();
+  std::cout << updates << " updates in " << total_us / 1000 << " ms";
+  if (updates)
+    std::cout << " (" << 1e6 * updates / total_us << " updates / s)";
+  std::cout << ", " << skipped << " skipped without a later transform" << std::endl;
+  for (std::pair<std::string const, LatencyLog> const &pair : latencies)
+    pair.second.print(pair.first);
+
+  if (reference_topic.empty())
+    return 0;
+
+  std::vector<TrajectoryPoint> const &estimate = reference_is_ecef ? estimate_ecef : estimate_odom;
+  double sum_squared = 0, max_error = 0, last_error = 0;
+  size_t compared = 0;
+  for (TrajectoryPoint const &point : reference)
+  {
+    boost::optional<Vec<3>> pos = interpolate(estimate, point.t);
+    if (!pos)
+      continue;
+    last_error = (*pos - point.pos).norm();
+    sum_squared += last_error * last_error;
+    max_error = std::max(max_error, last_error);
+    compared++;
+  }
+  std::cout << "position error against " << reference_topic << " (" << (reference_is_ecef ? "absodom" : "odom")
+            << "), over " << compared << " of " << reference.size() << " reference poses:";
+  if (compared)
+    std::cout << " rms " << sqrt(sum_squared / compared) << " m, max " << max_error << " m, final " << last_error
+              << " m";
+  std::cout << std::endl;
+  return 0;
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#include "odom_estimator/unscented_transform.h"
+
+using namespace odom_estimator;
+
+// is the unscented transform as it was before it took the function as a
+// template parameter, to compare against
+template <typename OutPointType, typename InPointType>
+GaussianDistributionWithCrossCov<OutPointType, InPointType>
+legacy_unscented_transform(boost::function<OutPointType(InPointType)> const &func,
+                           GaussianDistribution<InPointType> const &in, double alpha = 1e-3, double beta = 2,
+                           double kappa = 0)
+{
+  static const int OutVecLen = OutPointType::RowsAtCompileTime;
+  static const int InVecLen = InPointType::RowsAtCompileTime;
+  unsigned int in_vec_len = InVecLen != Dynamic ? InVecLen : in.cov.rows();
+
+  unsigned int L = in_vec_len;
+  double lambda = pow(alpha, 2) * (L + kappa) - L;
+
+  SqMat<InVecLen> sqrt_cov = cholesky<InVecLen>((L + lambda) * in.cov);
+
+  Vec<InVecLen> in_vecs[2 * L + 1];
+  boost::optional<OutPointType> out_points[2 * L + 1];
+  for (unsigned int i = 0; i <= 2 * L; i++)
+  {
+    Vec<InVecLen> dx;
+    if (i == 0)
+      dx = Vec<InVecLen>::Zero(in_vec_len, 1);
+    else if (i <= L)
+      dx = sqrt_cov.col(i - 1);
+    else
+      dx = -sqrt_cov.col(i - L - 1);
+
+    in_vecs[i] = dx;
+    out_points[i] = func(in.mean + dx);
+  }
+
+  unsigned int out_vec_len = OutVecLen != Dynamic ? OutVecLen : (*out_points[0] - *out_points[0]).rows();
+  Vec<OutVecLen> out_mean_minus_out_points_0 = Vec<OutVecLen>::Zero(out_vec_len, 1);
+  for (unsigned int i = 0; i <= 2 * L; i++)
+  {
+    double W_s = i == 0 ? lambda / (L + lambda) : 1. / 2 / (L + lambda);
+    out_mean_minus_out_points_0.noalias() += W_s * (*out_points[i] - *out_points[0]);
+  }
+  OutPointType out_mean = *out_points[0] + out_mean_minus_out_points_0;
+
+  SqMat<OutVecLen> out_cov = SqMat<OutVecLen>::Zero(out_vec_len, out_vec_len);
+  Mat<OutVecLen, InVecLen> out_cross_cov = Mat<OutVecLen, InVecLen>::Zero(out_vec_len, in_vec_len);
+  for (unsigned int i = 0; i <= 2 * L; i++)
+  {
+    double W_c = i == 0 ? lambda / (L + lambda) + (1 - pow(alpha, 2) + beta) : 1. / 2 / (L + lambda);
+    Vec<OutVecLen> dx = *out_points[i] - out_mean;
+    out_cov.noalias() += W_c * dx * dx.transpose();
+    out_cross_cov.noalias() += W_c * dx * in_vecs[i].transpose();
+  }
+
+  return GaussianDistributionWithCrossCov<OutPointType, InPointType>(
+      GaussianDistribution<OutPointType>(out_mean, out_cov), out_cross_cov);
+}
+
+// the function from test_unscented_transform
+Vec<4> small_func(Vec<3> p)
+{
+  return Vec<4>(exp(p(1)), p(0), -p(2), p(1) + p(2)) + Vec<4>(1, 2, 4, 3);
+}
+
+// has the dimensions of StateUpdater: an 18 dimensional state propagated with
+// 12 dimensions of noise
+Vec<18> state_func(Vec<30> p)
+{
+  Vec<18> res = p.head<18>();
+  res.segment<3>(0) += 0.01 * p.segment<3>(9) + 5e-5 * p.segment<3>(21);
+  res.segment<3>(6) += 0.01 * p.segment<3>(18).cross(p.segment<3>(6));
+  res.segment<3>(9) += 0.01 * (p.segment<3>(21) - p.segment<3>(15));
+  res.segment<3>(12) += 0.1 * p.segment<3>(24);
+  res.segment<3>(15) += 0.1 * p.segment<3>(27);
+  return res;
+}
+
+// prints the fastest of several runs, which is the least affected by
+// whatever else the machine is doing
+// is state_func with the cost of StateUpdater::apply, which builds rotations
+// and evaluates the gravity model for every sigma point
+Vec<18> expensive_state_func(Vec<30> p)
+{
+  Vec<18> res = state_func(p);
+  for (int i = 0; i < 8; i++)
+  {
+    Quaternion q = quat_from_rotvec(0.01 * p.segment<3>(18 + i % 3));
+    res.segment<3>(6) += 1e-3 * rotvec_from_quat(q * Quaternion(q.w(), 0, 0, q.z()));
+  }
+  return res;
+}
+
+template <typename Func>
+void benchmark(std::string const &name, int iterations, Func const &run)
+{
+  double checksum = 0;
+  double best = std::numeric_limits<double>::infinity();
+  for (int repeat = 0; repeat < 5; repeat++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+      checksum += run();
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / iterations);
+  }
+  std::cout << name << ": " << best << " us per transform (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+  unsigned int threads = argc > 1 ? std::atoi(argv[1]) : std::thread::hardware_concurrency();
+
+  GaussianDistribution<Vec<3> > small(Vec<3>(1, 2, 3), SqMat<3>::Identity());
+  Vec<30> mean = Vec<30>::LinSpaced(0.1, 3);
+  SqMat<30> cov = 1e-2 * SqMat<30>::Identity() + 1e-3 * SqMat<30>::Ones();
+  GaussianDistribution<Vec<30> > large(mean, cov);
+
+  std::cout << "3 -> 4 (test_unscented_transform)" << std::endl;
+  benchmark("  legacy", 100000,
+            [&]() { return legacy_unscented_transform<Vec<4>, Vec<3> >(small_func, small).cov(0, 0); });
+  benchmark("  templated", 100000, [&]() { return unscented_transform<Vec<4>, Vec<3> >(small_func, small).cov(0, 0); });
+  GaussianDistribution<Vec<Dynamic> > small_dynamic(small.mean, small.cov);
+  benchmark("  legacy, dynamic", 100000, [&]() {
+    return legacy_unscented_transform<Vec<Dynamic>, Vec<Dynamic> >(small_func, small_dynamic).cov(0, 0);
+  });
+  benchmark("  templated, dynamic", 100000, [&]() {
+    return unscented_transform<Vec<Dynamic>, Vec<Dynamic> >(small_func, small_dynamic).cov(0, 0);
+  });
+
+  std::cout << "30 -> 18 (StateUpdater)" << std::endl;
+  benchmark("  legacy", 10000,
+            [&]() { return legacy_unscented_transform<Vec<18>, Vec<30> >(state_func, large).cov(0, 0); });
+  benchmark("  templated", 10000,
+            [&]() { return unscented_transform<Vec<18>, Vec<30> >(state_func, large).cov(0, 0); });
+
+  // are the outputs got_imu derives from the 18 dimensional state: two odometry
+  // transforms and two bias selections
+  GaussianDistribution<Vec<18> > state(mean.head<18>(), cov.topLeftCorner<18, 18>());
+  auto odom_func = [](Vec<18> const &p) {
+    Quaternion q = quat_from_rotvec(p.segment<3>(6));
+    return (Vec<13>() << p.head<3>(), q.coeffs(), q.conjugate()._transformVector(p.segment<3>(9)), p.segment<3>(12))
+        .finished();
+  };
+  auto gyro_bias_func = [](Vec<18> const &p) { return Vec<3>(p.segment<3>(12)); };
+  auto accel_bias_func = [](Vec<18> const &p) { return Vec<3>(p.segment<3>(15)); };
+  std::cout << "18 -> 13, 13, 3, 3 (got_imu outputs)" << std::endl;
+  benchmark("  separate", 10000, [&]() {
+    return unscented_transform<Vec<13>, Vec<18> >(odom_func, state).cov(0, 0) +
+           unscented_transform<Vec<13>, Vec<18> >(odom_func, state).cov(0, 0) +
+           unscented_transform<Vec<3>, Vec<18> >(gyro_bias_func, state).cov(0, 0) +
+           unscented_transform<Vec<3>, Vec<18> >(accel_bias_func, state).cov(0, 0);
+  });
+  benchmark("  shared sigma points, linear biases", 10000, [&]() {
+    SigmaPoints<Vec<18> > sigma_points(state);
+    return sigma_points.transform<Vec<13> >(odom_func).cov(0, 0) +
+           sigma_points.transform<Vec<13> >(odom_func).cov(0, 0) +
+           linear_transform<Vec<3> >(gyro_bias_func, state).cov(0, 0) +
+           linear_transform<Vec<3> >(accel_bias_func, state).cov(0, 0);
+  });
+
+  std::cout << "30 -> 18 (StateUpdater), serial against " << threads << " threads" << std::endl;
+  ThreadPool pool(threads);
+  GaussianDistributionWithCrossCov<Vec<18>, Vec<30> > serial =
+      unscented_transform<Vec<18>, Vec<30> >(expensive_state_func, large);
+  GaussianDistributionWithCrossCov<Vec<18>, Vec<30> > parallel =
+      unscented_transform<Vec<18>, Vec<30> >(expensive_state_func, large, 1e-3, 2, 0, &pool);
+  std::cout << "  identical: " << (serial.mean == parallel.mean && serial.cov == parallel.cov &&
+                                   serial.cross_cov == parallel.cross_cov)
+            << std::endl;
+  benchmark("  serial", 10000,
+            [&]() { return unscented_transform<Vec<18>, Vec<30> >(expensive_state_func, large).cov(0, 0); });
+  benchmark("  parallel", 10000, [&]() {
+    return unscented_transform<Vec<18>, Vec<30> >(expensive_state_func, large, 1e-3, 2, 0, &pool).cov(0, 0);
+  });
+
+  return 0;
+}
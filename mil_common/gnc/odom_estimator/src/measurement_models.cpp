@@ -0,0 +1,36 @@
+#include <geometry_msgs/PointStamped.h>
+#include <pluginlib/class_list_macros.h>
+
+#include "odom_estimator/measurement_model.h"
+
+namespace odom_estimator
+{
+// is an absolute position fix, such as from a GPS, given in ECEF at the
+// origin of the message's frame, with independent noise of ~stddev on each
+// axis
+class PositionECEFModel : public TopicMeasurementModel<geometry_msgs::PointStamped>
+{
+  double stddev;
+
+protected:
+  void configure(ros::NodeHandle &private_nh) override
+  {
+    private_nh.param("stddev", stddev, 3.0);
+  }
+  boost::optional<MeasurementError> measure(geometry_msgs::PointStamped const &msg,
+                                            SensorPose const &pose) const override
+  {
+    Vec<3> measured = point2vec(msg.point);
+    MeasurementError res;
+    res.noise_cov = SqMat<Dynamic>::Identity(3, 3) * (stddev * stddev);
+    Vec<3> const pos = pose.pos;
+    res.additive_error = [measured, pos](State const &state, StateFrame const &frame, Vec<3> const &gyro,
+                                         Eigen::Ref<Vec<Dynamic> > out) {
+      out = state.getPosECEF(frame, pos) - measured;
+    };
+    return res;
+  }
+};
+}
+
+PLUGINLIB_EXPORT_CLASS(odom_estimator::PositionECEFModel, odom_estimator::MeasurementModel)
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "odom_estimator/bag_replay.h"
+#include "odom_estimator/smoother.h"
+
+using namespace odom_estimator;
+
+// Estimates the trajectory of a bag offline, with every state estimated from
+// the measurements after it as well as those before. The filter is run
+// forward over the bag as in benchmark_bag_replay, keeping each step's prior,
+// posterior and their cross covariance, and a Rauch-Tung-Striebel pass runs
+// backward over them. The smoothed odom and absodom are written to a new bag,
+// on the nodelet's topics, stamped with the IMU sample of each filter step.
+// Parameters are read from ~ as in the nodelet, so load the same yaml to match
+// the vehicle, and prediction_period thins out the steps on long logs.
+//
+// Usage: smooth_bag <input bag> <output bag>
+//
+// The forward pass has to go in order, but the backward pass and the
+// odometry outputs, most of the work, are done in chunks of
+// ~smoother_chunk_size steps across ~smoother_threads threads while it goes
+// on. Each chunk starts its backward pass from the filtered state
+// ~smoother_overlap steps past its end, which the smoothed states converge
+// from well before the chunk's own steps, so the chunks agree with one pass
+// over the whole bag. Only the chunks in flight are held in memory.
+
+namespace
+{
+// is the odom and absodom of each step a chunk outputs, in order
+typedef std::vector<std::pair<nav_msgs::Odometry, nav_msgs::Odometry>> ChunkOutputs;
+
+// smooths steps, outputting the first count of them
+ChunkOutputs smooth_chunk(FilterSteps const &steps, size_t count, std::string const &local_frame)
+{
+  States const smoothed = rts_smooth(steps);
+  ChunkOutputs res(count);
+  for (size_t i = 0; i < count; i++)
+    odom_msgs_from_state(smoothed[i], local_frame, steps[i].imu.header.frame_id,
+                         xyz2vec(steps[i].imu.angular_velocity), res[i].first, res[i].second);
+  return res;
+}
+}
+
+int main(int argc, char **argv)
+{
+  ros::init(argc, argv, "smooth_bag", ros::init_options::AnonymousName);
+  if (argc < 3)
+  {
+    std::cerr << "Usage: smooth_bag <input bag> <output bag>" << std::endl;
+    return 1;
+  }
+
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+  std::string const name = "smooth_bag";
+  NodeImpl node([&name]() -> std::string const & { return name; }, &nh, &private_nh);
+
+  std::string local_frame = "/enu";
+  private_nh.getParam("local_frame", local_frame);
+  int chunk_size = 2000, overlap = 1000, threads = std::max(std::thread::hardware_concurrency(), 1u);
+  private_nh.getParam("smoother_chunk_size", chunk_size);
+  private_nh.getParam("smoother_overlap", overlap);
+  private_nh.getParam("smoother_threads", threads);
+  chunk_size = std::max(chunk_size, 1);
+  overlap = std::max(overlap, 0);
+  threads = std::max(threads, 1);
+
+  rosbag::Bag in_bag(argv[1], rosbag::bagmode::Read);
+  rosbag::Bag out_bag(argv[2], rosbag::bagmode::Write);
+  std::string const odom_topic = nh.resolveName("odom");
+  std::string const absodom_topic = nh.resolveName("absodom");
+
+  size_t written = 0;
+  ros::Time first, last;
+  std::deque<std::future<ChunkOutputs>> in_flight;
+  // writes the oldest chunk in flight once it's done
+  auto write_oldest = [&]() {
+    ChunkOutputs const outputs = in_flight.front().get();
+    in_flight.pop_front();
+    for (std::pair<nav_msgs::Odometry, nav_msgs::Odometry> const &output : outputs)
+    {
+      out_bag.write(odom_topic, output.first.header.stamp, output.first);
+      out_bag.write(absodom_topic, output.second.header.stamp, output.second);
+      if (!written++)
+        first = output.first.header.stamp;
+      last = output.first.header.stamp;
+    }
+  };
+  // starts smoothing the first count of pending in the background, keeping
+  // the overlap after them for the next chunk
+  std::deque<FilterStep, Eigen::aligned_allocator<FilterStep>> pending;
+  auto start_chunk = [&](size_t count) {
+    if (in_flight.size() >= static_cast<size_t>(threads))
+      write_oldest();
+    FilterSteps steps(pending.begin(), pending.begin() + std::min(pending.size(), count + overlap));
+    in_flight.push_back(std::async(std::launch::async, smooth_chunk, std::move(steps), count, local_frame));
+    pending.erase(pending.begin(), pending.begin() + count);
+  };
+
+  std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+  node.set_step_callback([&](FilterStep const &step) {
+    pending.push_back(step);
+    if (pending.size() >= static_cast<size_t>(chunk_size + overlap))
+      start_chunk(chunk_size);
+  });
+  size_t const skipped = replay_bag(in_bag, nh, node, [](std::string const &, boost::function<void()> const &update) {
+    update();
+  });
+  node.finish_steps();
+  if (!pending.empty())
+    start_chunk(pending.size());
+  while (!in_flight.empty())
+    write_oldest();
+  out_bag.close();
+
+  std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "smoothed " << written << " steps in " << elapsed.count() << " s";
+  if (written > 1)
+    std::cout << " (" << (last - first).toSec() / elapsed.count() << " times real time)";
+  std::cout << ", " << skipped << " measurements skipped without a later transform" << std::endl;
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include <iostream>
+#include <vector>
+
+#include "odom_estimator/earth.h"
+#include "odom_estimator/gravity.h"
+
+using namespace odom_estimator;
+
+int main(int argc, char** argv)
+{
+  bool ok = true;
+
+  double t = 1262322000 + (365.25 * 86400) * 2.5;  // 2012.5
+  std::vector<Vec<3> > positions_ecef = {
+    Vec<3>(-555582.43540501, -962297.00591432, -6259542.96102869),  // as in test_mag
+    Vec<3>(742035.4, -5462186.9, 3198014.5),                          // Gainesville
+    Vec<3>(6378137.0, 0, 0),                                          // equator
+    Vec<3>(0, 0, 6356752.3),                                          // pole
+  };
+
+  for (Vec<3> const& pos_ecef : positions_ecef)
+  {
+    Vec<3> pos_eci = inertial_from_ecef(t, pos_ecef);
+
+    // Gravity has a potential and the Earth's mass is all below, so the
+    // Jacobian should be symmetric and traceless
+    SqMat<3> jacobian = gravity::gravity_jacobian(pos_eci);
+    double asymmetry = (jacobian - jacobian.transpose()).norm() / jacobian.norm();
+    double trace = fabs(jacobian.trace()) / jacobian.norm();
+    std::cout << "jacobian asymmetry: " << asymmetry << " trace: " << trace << std::endl;
+    ok = ok && asymmetry < 1e-6 && trace < 1e-6;
+
+    // The local model should stay within about 1e-6 m/s^2 of the full one
+    // over moves up to its refresh distance, in any direction
+    gravity::LocalGravity local;
+    double max_local_error = 0;
+    for (int i = 0; i <= 100; i++)
+    {
+      Vec<3> direction = Vec<3>(sin(i * 0.7) * cos(i * 1.3), sin(i * 0.7) * sin(i * 1.3), cos(i * 0.7));
+      Vec<3> pos = pos_eci + 9.99 * i * direction;
+      local.update(pos);
+      max_local_error = std::max(max_local_error, (local(pos) - gravity::gravity(pos)).norm());
+    }
+    std::cout << "local error (m/s^2): " << max_local_error << std::endl;
+    ok = ok && max_local_error < 1e-6;
+
+    // and keep to it when driven along far past the refresh distance, as the
+    // Earth's rotation carries the vehicle in ECI
+    double max_driven_error = 0;
+    for (int i = 0; i <= 3600; i++)
+    {
+      double dt = i;
+      Vec<3> pos = inertial_from_ecef(t + dt, pos_ecef + dt * Vec<3>(0.6, -0.48, 0.64));
+      local.update(pos);
+      max_driven_error = std::max(max_driven_error, (local(pos) - gravity::gravity(pos)).norm());
+    }
+    std::cout << "driven error (m/s^2): " << max_driven_error << std::endl;
+    ok = ok && max_driven_error < 1e-6;
+  }
+
+  std::cout << (ok ? "ok" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -26,5 +26,49 @@ int main(int argc, char** argv)
 
   std::cout << mm.getFieldAndJacobian(inertial_from_ecef(t, pos_ecef), t).second << std::endl;
 
-  return 0;
+  bool ok = true;
+
+  // The precomputed recurrence should match the reference one
+  double max_legendre_error = 0;
+  magnetic::LegendreRecurrence legendre(12, 12);
+  for (double x = -0.99; x < 1; x += 0.01)
+  {
+    Eigen::MatrixXd expected = magnetic::semi_normalized_associated_legendre<double>(12, 12, x);
+    Eigen::MatrixXd actual = legendre.evaluate<double>(x);
+    for (int m = 0; m <= 12; m++)
+      for (int n = m; n <= 12; n++)
+        max_legendre_error = std::max(max_legendre_error, fabs(actual(m, n) - expected(m, n)));
+  }
+  std::cout << "legendre error: " << max_legendre_error << std::endl;
+  ok = ok && max_legendre_error < 1e-12;
+
+  // The Jacobian should match central differences of the field
+  Vec<3> pos_eci = inertial_from_ecef(t, pos_ecef);
+  SqMat<3> numerical_jacobian;
+  for (int i = 0; i < 3; i++)
+  {
+    Vec<3> step = Vec<3>::Unit(i) * 10;
+    numerical_jacobian.col(i) = (mm.getField(pos_eci + step, t) - mm.getField(pos_eci - step, t)) / 20;
+  }
+  SqMat<3> jacobian = mm.getFieldAndJacobian(pos_eci, t).second;
+  double jacobian_error = (jacobian - numerical_jacobian).norm() / jacobian.norm();
+  std::cout << "jacobian relative error: " << jacobian_error << std::endl;
+  ok = ok && jacobian_error < 1e-6;
+
+  // The cached model should stay within a fraction of a nT of the full one
+  // over moves up to its refresh distance, and over time as the earth turns
+  magnetic::CachedMagneticModel cached(mm);
+  double max_cache_error = 0;
+  for (int i = 0; i <= 100; i++)
+  {
+    double dt = i * 10.;
+    Vec<3> offset_ecef = 9.99 * i * Vec<3>(0.6, -0.48, 0.64);
+    Vec<3> pos = inertial_from_ecef(t + dt, pos_ecef + offset_ecef);
+    max_cache_error = std::max(max_cache_error, (cached.getField(pos, t + dt) - mm.getField(pos, t + dt)).norm());
+  }
+  std::cout << "cache error (nT): " << 1e9 * max_cache_error << std::endl;
+  ok = ok && max_cache_error < 1e-11;
+
+  std::cout << (ok ? "ok" : "FAILED") << std::endl;
+  return ok ? 0 : 1;
 }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace mil_ogrid
+{
+/**
+ * Chessboard distance, in cells, from each cell of a grid to the nearest occupied cell, where everything outside the
+ * grid counts as occupied. So a footprint of half width r centered on a cell overlaps something occupied exactly when
+ * its distance is at most r.
+ *
+ * Distances are clamped to max_distance. A change to some cells can then only change distances within max_distance of
+ * them, so update() recomputes just that neighbourhood instead of the whole grid.
+ */
+class DistanceField
+{
+public:
+  DistanceField();
+
+  uint16_t max_distance() const
+  {
+    return max_distance_;
+  }
+
+  /// Compute for a grid of width x height cells, those equal to occupied being occupied
+  void compute(int8_t const* cells, int width, int height, int8_t occupied, uint16_t max_distance = 0xffff);
+
+  /// Recompute after the cells in changed did, for the same grid as the last compute
+  void update(int8_t const* cells, cv::Rect const& changed);
+
+  uint16_t at(cv::Point cell) const
+  {
+    return distance_[cell.x + size_t(cell.y) * width_];
+  }
+
+  int width() const
+  {
+    return width_;
+  }
+  int height() const
+  {
+    return height_;
+  }
+
+private:
+  /// Two pass chamfer transform of the cells in window, which is exact for the chessboard distance to the occupied
+  /// cells in it, copying the cells in write into distance_
+  void chamfer(int8_t const* cells, cv::Rect const& window, cv::Rect const& write);
+
+  uint16_t max_distance_;
+  int8_t occupied_;
+  int width_;
+  int height_;
+  std::vector<uint16_t> distance_;
+  /// Reused buffer for the window being recomputed
+  std::vector<uint16_t> scratch_;
+};
+
+}  // namespace mil_ogrid
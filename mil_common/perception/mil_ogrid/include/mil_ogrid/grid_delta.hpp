@@ -0,0 +1,28 @@
+#pragma once
+
+#include <map_msgs/OccupancyGridUpdate.h>
+#include <nav_msgs/OccupancyGrid.h>
+
+#include <opencv2/core/core.hpp>
+
+namespace mil_ogrid
+{
+/**
+ * Delta serialization of grids: a publisher sends the full grid as a keyframe now and then, and in between only the
+ * rectangles of cells that changed, as map_msgs/OccupancyGridUpdate on <grid topic>_updates. A subscriber applies
+ * them to its copy of the last keyframe, and only has to redo its own work over the changed cells.
+ */
+
+/// View of a grid message's cells as a CV_8U Mat, sharing its data, which must not be resized while in use
+inline cv::Mat as_mat(nav_msgs::OccupancyGrid& grid)
+{
+  return cv::Mat(grid.info.height, grid.info.width, CV_8UC1, grid.data.data());
+}
+
+/// Fill the position, size and data of update with the cells of a CV_8U grid in rect, leaving the header to the caller
+void make_update(cv::Mat const& grid, cv::Rect const& rect, map_msgs::OccupancyGridUpdate& update);
+
+/// Copy the cells of update into grid, returning the cells changed, or an empty rect if the update does not fit
+cv::Rect apply_update(nav_msgs::OccupancyGrid& grid, map_msgs::OccupancyGridUpdate const& update);
+
+}  // namespace mil_ogrid
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <nav_msgs/MapMetaData.h>
+
+#include <opencv2/core/core.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+
+namespace mil_ogrid
+{
+/// Values of nav_msgs::OccupancyGrid cells as MIL's nodes publish and read them
+enum CellValue : int8_t
+{
+  UNOCCUPIED = 0,
+  UNKNOWN = 50,
+  OCCUPIED = 99
+};
+
+/// Index of the cell holding (x, y) for cells of resolution meters starting at the origin. Rounds toward negative
+/// infinity, so points below or left of the origin are not folded into the first cell.
+inline cv::Point cell_of(double x, double y, double resolution)
+{
+  return cv::Point(std::floor(x / resolution), std::floor(y / resolution));
+}
+
+/// Hash of a cell or tile index
+struct CellHash
+{
+  size_t operator()(cv::Point const& key) const
+  {
+    return std::hash<uint64_t>()((uint64_t(uint32_t(key.x)) << 32) | uint32_t(key.y));
+  }
+};
+
+/// Where a bounded, unrotated grid lies in its frame, so every node converts between points and cells the same way
+struct GridGeometry
+{
+  double resolution = 1.;
+  double origin_x = 0.;
+  double origin_y = 0.;
+  int width = 0;
+  int height = 0;
+
+  GridGeometry() = default;
+  GridGeometry(double resolution, double origin_x, double origin_y, int width, int height)
+    : resolution(resolution), origin_x(origin_x), origin_y(origin_y), width(width), height(height)
+  {
+  }
+
+  /// Geometry of a grid message, ignoring the orientation of its origin
+  static GridGeometry from_info(nav_msgs::MapMetaData const& info)
+  {
+    return GridGeometry(info.resolution, info.origin.position.x, info.origin.position.y, info.width, info.height);
+  }
+
+  /// Set the resolution, size and origin of a grid message
+  void to_info(nav_msgs::MapMetaData& info) const
+  {
+    info.resolution = resolution;
+    info.width = width;
+    info.height = height;
+    info.origin.position.x = origin_x;
+    info.origin.position.y = origin_y;
+    info.origin.orientation.w = 1;
+  }
+
+  /// Cell holding the point (x, y), which may be outside the grid
+  cv::Point cell(double x, double y) const
+  {
+    return cell_of(x - origin_x, y - origin_y, resolution);
+  }
+
+  /// Center of a cell in the frame
+  cv::Point2d center(cv::Point cell) const
+  {
+    return cv::Point2d(origin_x + (cell.x + 0.5) * resolution, origin_y + (cell.y + 0.5) * resolution);
+  }
+
+  bool contains(cv::Point cell) const
+  {
+    return cell.x >= 0 && cell.y >= 0 && cell.x < width && cell.y < height;
+  }
+
+  cv::Rect rect() const
+  {
+    return cv::Rect(0, 0, width, height);
+  }
+
+  /// Index of a cell in the grid's row major data
+  size_t index(cv::Point cell) const
+  {
+    return cell.x + size_t(cell.y) * width;
+  }
+};
+
+}  // namespace mil_ogrid
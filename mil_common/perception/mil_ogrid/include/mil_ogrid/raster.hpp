@@ -0,0 +1,89 @@
+#pragma once
+
+#include <mil_ogrid/grid_geometry.hpp>
+
+#include <opencv2/core/core.hpp>
+
+namespace mil_ogrid
+{
+/**
+ * A filled disk of cells, such as the inflation drawn around each obstacle point. The disk is rasterized once, so
+ * drawing it is a max of whole rows into the grid, which OpenCV vectorizes, rather than a circle per point.
+ */
+class DiskStamp
+{
+public:
+  /// Disk of the given radius in cells, matching a filled cv::circle, with cells of value
+  explicit DiskStamp(int radius = 0, uchar value = uchar(OCCUPIED));
+
+  int radius() const
+  {
+    return radius_;
+  }
+
+  /// Cells drawing the disk at center covers, which may be outside the grid
+  cv::Rect bounds(cv::Point center) const
+  {
+    return cv::Rect(center.x - radius_, center.y - radius_, disk_.cols, disk_.rows);
+  }
+
+  /// Draw the disk at center into a CV_8U grid, keeping the larger value of each cell, only changing cells in clip
+  void draw(cv::Mat& grid, cv::Point center, cv::Rect const& clip) const;
+
+  /// Inflation layer: draw the disk around every cell of in which is at least threshold, writing the result to out
+  void inflate(cv::Mat const& in, cv::Mat& out, uchar threshold = uchar(OCCUPIED)) const;
+
+private:
+  int radius_;
+  cv::Mat disk_;
+};
+
+/// Fill a convex polygon of n cells into a CV_8U grid, only changing cells in clip
+void fill_convex_polygon(cv::Mat& grid, cv::Point const* points, int n, uchar value, cv::Rect const& clip);
+
+/**
+ * The cells of a ray from start to end, both included, in Bresenham order. Unlike cv::LineIterator this does not
+ * clip to an image, so it walks unbounded cell indices, such as those of a TiledGrid.
+ */
+class LineIterator
+{
+public:
+  LineIterator(cv::Point start, cv::Point end);
+
+  cv::Point pos() const
+  {
+    return p_;
+  }
+
+  bool at_end() const
+  {
+    return p_ == end_;
+  }
+
+  /// Step to the next cell, which there must be
+  void next()
+  {
+    int err2 = 2 * err_;
+    if (err2 >= dy_)
+    {
+      err_ += dy_;
+      p_.x += step_x_;
+    }
+    if (err2 <= dx_)
+    {
+      err_ += dx_;
+      p_.y += step_y_;
+    }
+  }
+
+private:
+  cv::Point p_;
+  cv::Point end_;
+  int dx_;
+  int dy_;
+  int step_x_;
+  int step_y_;
+  int err_;
+};
+
+}  // namespace mil_ogrid
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <mil_ogrid/grid_geometry.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace mil_ogrid
+{
+/*
+  Log-odds occupancy grid over the whole map frame, stored as square tiles of tile_size cells that are created when a
+  beam first reaches them. Cells are addressed by their index in the map frame, cell_of(x, y, resolution), so nothing
+  is lost when the vehicle moves.
+
+  A window of window_tiles x window_tiles tiles scrolls with the vehicle and is what gets published. Thresholding only
+  touches tiles in the window that changed since the last time, or the whole window after it scrolled. Tiles more
+  than a tile outside the window are written to tile_dir and loaded again when needed, or kept in memory if
+  tile_dir is empty.
+*/
+class TiledGrid
+{
+public:
+  // Log-odds added on a hit or a miss, the range cells are clamped to, and what a cell must be above to be occupied
+  // and below to be unoccupied
+  struct Update
+  {
+    float hit;
+    float miss;
+    float min;
+    float max;
+    float occupied;
+    float unoccupied;
+  };
+  // Called when a cell becomes occupied, with the height of the return that made it so, or stops being occupied
+  typedef std::function<void(cv::Point cell, bool occupied, float z)> FlipCallback;
+
+  TiledGrid();
+  TiledGrid(int tile_size, int window_tiles, Update const &update, std::string const &tile_dir);
+
+  void set_flip_callback(FlipCallback const &on_flip);
+
+  // Add a miss to every cell a beam crosses from start up to end, and a hit to end, at height z, if hit
+  void trace_beam(cv::Point start, cv::Point end, bool hit, float z);
+
+  // Scroll the window so cell is in its center tile
+  void center_window(cv::Point cell);
+  // Index of the first cell of the window
+  cv::Point window_origin() const;
+  // Width and height of the window in cells
+  int window_cells() const;
+
+  // Write the window into a window_cells() square CV_8U Mat as occupied, unoccupied or unknown, skipping tiles that
+  // have not changed since the last call. Returns whether the whole window was written, as after it scrolled, and
+  // otherwise adds the rects of the tiles written to changed, if given.
+  bool threshold_window(cv::Mat &out, std::vector<cv::Rect> *changed = nullptr);
+  // Make the next threshold_window write the whole window, as after it scrolled, such as when something else was
+  // drawn over it
+  void invalidate_window();
+
+  // Forget every cell, including those written to tile_dir
+  void clear();
+
+  // Tiles in memory, and the memory their cells take
+  size_t tiles() const
+  {
+    return tiles_.size();
+  }
+  size_t bytes() const
+  {
+    return tiles_.size() * tile_size_ * tile_size_ * sizeof(float);
+  }
+
+private:
+  struct Tile
+  {
+    cv::Mat log_odds;  // CV_32F, tile_size_ square
+    bool dirty;        // changed since the last threshold_window
+  };
+  typedef std::unordered_map<cv::Point, Tile, CellHash> TileMap;
+
+  // Key of the tile holding a cell
+  cv::Point tile_key(cv::Point cell) const;
+  // Find a tile, loading it if it was evicted, and creating it if it does not exist and create is set
+  Tile *get_tile(cv::Point key, bool create);
+  std::string tile_path(cv::Point key) const;
+  bool save_tile(cv::Point key, Tile const &tile) const;
+  bool load_tile(cv::Point key, Tile &tile) const;
+  // Write out and drop tiles well outside the window
+  void evict();
+
+  int tile_size_;
+  int window_tiles_;
+  Update update_;
+  std::string tile_dir_;
+  FlipCallback on_flip_;
+
+  TileMap tiles_;
+  std::unordered_set<cv::Point, CellHash> evicted_;
+  cv::Point window_tile_;  // key of the window's first tile
+  bool window_moved_;      // every tile of the window must be thresholded again
+};
+
+}  // namespace mil_ogrid
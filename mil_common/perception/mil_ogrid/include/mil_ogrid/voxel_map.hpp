@@ -0,0 +1,99 @@
+#pragma once
+
+#include <mil_ogrid/grid_geometry.hpp>
+#include <mil_ogrid/tiled_grid.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+namespace mil_ogrid
+{
+/// Hash of a voxel or block index
+struct VoxelHash
+{
+  size_t operator()(cv::Point3i const& key) const
+  {
+    return std::hash<uint64_t>()((uint64_t(uint32_t(key.x) & 0x1fffff) << 42) |
+                                 (uint64_t(uint32_t(key.y) & 0x1fffff) << 21) | (uint32_t(key.z) & 0x1fffff));
+  }
+};
+
+/*
+  Log-odds occupancy map over the whole map frame in three dimensions, for sensors that see at more than one height,
+  such as sonar pings taken at the vehicle's actual depth and attitude. Voxels are kept in blocks of BLOCK_SIZE^3
+  voxels that are created when a ray first reaches them, so memory only grows with the space that was observed.
+
+  Voxels are addressed by their index in the map frame, floor(point / resolution). column and slice flatten a range
+  of heights the way TiledGrid thresholds its window, so a node that checks a 2D ogrid can check only the heights the
+  vehicle will be at.
+*/
+class VoxelMap
+{
+public:
+  static const int BLOCK_SIZE = 8;
+  typedef TiledGrid::Update Update;
+
+  VoxelMap();
+  VoxelMap(float resolution, Update const& update);
+
+  float resolution() const
+  {
+    return resolution_;
+  }
+
+  /// Index of the voxel holding a point
+  cv::Point3i voxel_of(cv::Point3f const& point) const;
+
+  /// Add a miss to every voxel a ray crosses from start up to end, and a hit to end, if hit
+  void trace_ray(cv::Point3f const& start, cv::Point3f const& end, bool hit);
+  /// Add a hit to the voxel holding point, for a return without a ray worth tracing to it
+  void add_hit(cv::Point3f const& point);
+
+  /// Log-odds of a voxel, 0 if it was never observed
+  float log_odds(cv::Point3i const& voxel) const;
+
+  /// The voxels from z_min to z_max above (x, y): OCCUPIED if any of them is, otherwise UNOCCUPIED if any of them is,
+  /// otherwise UNKNOWN
+  CellValue column(float x, float y, float z_min, float z_max) const;
+  /// Set z to the top of the highest occupied voxel from z_min to z_max above (x, y), returning false if there is none
+  bool highest_occupied(float x, float y, float z_min, float z_max, float& z) const;
+
+  /// Fill a CV_8U grid of geometry with the column from z_min to z_max of every cell, where a cell covers the voxel
+  /// columns whose centers are in it. Only looks up the blocks under the grid.
+  void slice(GridGeometry const& geometry, float z_min, float z_max, cv::Mat& out) const;
+
+  /// Blocks allocated, and the memory they take
+  size_t blocks() const
+  {
+    return blocks_.size();
+  }
+  size_t bytes() const
+  {
+    return blocks_.size() * sizeof(Block);
+  }
+
+  /// Forget the blocks farthest from center until the rest take at most max_bytes, for a map that outgrew its memory
+  void evict_far(cv::Point3f const& center, size_t max_bytes);
+  /// Forget every voxel
+  void clear();
+
+private:
+  typedef std::array<float, BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE> Block;
+  typedef std::unordered_map<cv::Point3i, Block, VoxelHash> BlockMap;
+
+  /// Key of the block holding a voxel, and the voxel's index in it
+  static cv::Point3i block_key(cv::Point3i const& voxel);
+  static int block_index(cv::Point3i const& voxel, cv::Point3i const& key);
+  Block& get_block(cv::Point3i const& key);
+  Block const* find_block(cv::Point3i const& key) const;
+  CellValue value(float log_odds) const;
+
+  float resolution_;
+  Update update_;
+  BlockMap blocks_;
+};
+
+}  // namespace mil_ogrid
@@ -0,0 +1,102 @@
+#include <mil_ogrid/distance_field.hpp>
+
+#include <algorithm>
+
+namespace mil_ogrid
+{
+namespace
+{
+cv::Rect grow(cv::Rect const& rect, int margin)
+{
+  return cv::Rect(rect.x - margin, rect.y - margin, rect.width + 2 * margin, rect.height + 2 * margin);
+}
+}  // anonymous namespace
+
+DistanceField::DistanceField() : max_distance_(0xffff), occupied_(0), width_(0), height_(0)
+{
+}
+
+void DistanceField::compute(int8_t const* cells, int width, int height, int8_t occupied, uint16_t max_distance)
+{
+  width_ = width;
+  height_ = height;
+  occupied_ = occupied;
+  max_distance_ = max_distance;
+  distance_.resize(size_t(width) * height);
+  cv::Rect grid(0, 0, width, height);
+  chamfer(cells, grid, grid);
+}
+
+void DistanceField::update(int8_t const* cells, cv::Rect const& changed)
+{
+  cv::Rect grid(0, 0, width_, height_);
+  // Only cells within max_distance of a changed cell can have a new distance. Any occupied cell within max_distance
+  // of one of those is in window, and the chessboard path to it stays inside window's bounding box, so the window's
+  // own transform is exact over write.
+  int margin = std::min<int>(max_distance_, std::max(width_, height_));
+  cv::Rect write = grow(changed, margin) & grid;
+  if (write.empty())
+    return;
+  cv::Rect window = grow(write, margin) & grid;
+  chamfer(cells, window, write);
+}
+
+void DistanceField::chamfer(int8_t const* cells, cv::Rect const& window, cv::Rect const& write)
+{
+  const int width = window.width;
+  const int height = window.height;
+  scratch_.resize(size_t(width) * height);
+  for (int y = 0; y < height; ++y)
+  {
+    const int gy = window.y + y;
+    const int8_t* in = cells + size_t(gy) * width_ + window.x;
+    uint16_t* row = &scratch_[size_t(y) * width];
+    const uint16_t* above = y > 0 ? row - width : nullptr;
+    for (int x = 0; x < width; ++x)
+    {
+      const int gx = window.x + x;
+      int d = in[x] == occupied_ ?
+                  0 :
+                  std::min<int>(max_distance_, std::min(std::min(gx + 1, width_ - gx), std::min(gy + 1, height_ - gy)));
+      if (x > 0)
+        d = std::min(d, row[x - 1] + 1);
+      if (above)
+      {
+        d = std::min(d, above[x] + 1);
+        if (x > 0)
+          d = std::min(d, above[x - 1] + 1);
+        if (x + 1 < width)
+          d = std::min(d, above[x + 1] + 1);
+      }
+      row[x] = d;
+    }
+  }
+  for (int y = height - 1; y >= 0; --y)
+  {
+    uint16_t* row = &scratch_[size_t(y) * width];
+    const uint16_t* below = y + 1 < height ? row + width : nullptr;
+    for (int x = width - 1; x >= 0; --x)
+    {
+      int d = row[x];
+      if (x + 1 < width)
+        d = std::min(d, row[x + 1] + 1);
+      if (below)
+      {
+        d = std::min(d, below[x] + 1);
+        if (x > 0)
+          d = std::min(d, below[x - 1] + 1);
+        if (x + 1 < width)
+          d = std::min(d, below[x + 1] + 1);
+      }
+      row[x] = d;
+    }
+  }
+
+  for (int y = write.y; y < write.y + write.height; ++y)
+  {
+    const uint16_t* src = &scratch_[size_t(y - window.y) * width + (write.x - window.x)];
+    std::copy(src, src + write.width, &distance_[size_t(y) * width_ + write.x]);
+  }
+}
+
+}  // namespace mil_ogrid
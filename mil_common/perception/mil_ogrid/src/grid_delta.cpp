@@ -0,0 +1,31 @@
+#include <mil_ogrid/grid_delta.hpp>
+
+#include <algorithm>
+
+namespace mil_ogrid
+{
+void make_update(cv::Mat const& grid, cv::Rect const& rect, map_msgs::OccupancyGridUpdate& update)
+{
+  update.x = rect.x;
+  update.y = rect.y;
+  update.width = rect.width;
+  update.height = rect.height;
+  update.data.resize(rect.area());
+  cv::Mat dst(rect.size(), CV_8UC1, update.data.data());
+  grid(rect).copyTo(dst);
+}
+
+cv::Rect apply_update(nav_msgs::OccupancyGrid& grid, map_msgs::OccupancyGridUpdate const& update)
+{
+  if (update.x + update.width > grid.info.width || update.y + update.height > grid.info.height ||
+      update.data.size() != size_t(update.width) * update.height)
+    return cv::Rect();
+  for (uint32_t row = 0; row < update.height; ++row)
+  {
+    std::copy(update.data.begin() + size_t(row) * update.width, update.data.begin() + size_t(row + 1) * update.width,
+              grid.data.begin() + size_t(update.y + row) * grid.info.width + update.x);
+  }
+  return cv::Rect(update.x, update.y, update.width, update.height);
+}
+
+}  // namespace mil_ogrid
@@ -0,0 +1,58 @@
+#include <mil_ogrid/raster.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+namespace mil_ogrid
+{
+DiskStamp::DiskStamp(int radius, uchar value) : radius_(radius)
+{
+  disk_ = cv::Mat::zeros(2 * radius + 1, 2 * radius + 1, CV_8UC1);
+  cv::circle(disk_, cv::Point(radius, radius), radius, cv::Scalar(value), -1);
+}
+
+void DiskStamp::draw(cv::Mat& grid, cv::Point center, cv::Rect const& clip) const
+{
+  cv::Rect stamp = bounds(center);
+  cv::Rect visible = stamp & clip;
+  if (visible.empty())
+    return;
+  cv::Mat dst = grid(visible);
+  cv::max(dst, disk_(visible - stamp.tl()), dst);
+}
+
+void DiskStamp::inflate(cv::Mat const& in, cv::Mat& out, uchar threshold) const
+{
+  // Dilating the occupied cells by the disk's shape is drawing the disk around each of them
+  cv::Mat inflated;
+  cv::threshold(in, inflated, threshold - 1, disk_.at<uchar>(radius_, radius_), cv::THRESH_BINARY);
+  cv::dilate(inflated, inflated, disk_ != 0);
+  cv::max(inflated, in, out);
+}
+
+void fill_convex_polygon(cv::Mat& grid, cv::Point const* points, int n, uchar value, cv::Rect const& clip)
+{
+  cv::Rect visible = clip & cv::Rect(0, 0, grid.cols, grid.rows);
+  if (visible.empty())
+    return;
+  std::vector<cv::Point> shifted(points, points + n);
+  for (cv::Point& p : shifted)
+    p -= visible.tl();
+  cv::Mat roi = grid(visible);
+  cv::fillConvexPoly(roi, shifted.data(), n, cv::Scalar(value));
+}
+
+LineIterator::LineIterator(cv::Point start, cv::Point end)
+  : p_(start)
+  , end_(end)
+  , dx_(std::abs(end.x - start.x))
+  , dy_(-std::abs(end.y - start.y))
+  , step_x_(start.x < end.x ? 1 : -1)
+  , step_y_(start.y < end.y ? 1 : -1)
+  , err_(dx_ + dy_)
+{
+}
+
+}  // namespace mil_ogrid
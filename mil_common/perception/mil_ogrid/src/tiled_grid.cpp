@@ -0,0 +1,225 @@
+#include <mil_ogrid/raster.hpp>
+#include <mil_ogrid/tiled_grid.hpp>
+
+#include <ros/console.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+namespace mil_ogrid
+{
+namespace
+{
+// Division rounding toward negative infinity, so negative cells land in the right tile
+int floor_div(int a, int b)
+{
+  return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+}  // anonymous namespace
+
+TiledGrid::TiledGrid() : TiledGrid(64, 1, Update{ 0, 0, 0, 0, 0, 0 }, "")
+{
+}
+
+TiledGrid::TiledGrid(int tile_size, int window_tiles, Update const &update, std::string const &tile_dir)
+  : tile_size_(tile_size)
+  , window_tiles_(window_tiles)
+  , update_(update)
+  , tile_dir_(tile_dir)
+  , window_tile_(-window_tiles / 2, -window_tiles / 2)
+  , window_moved_(true)
+{
+}
+
+cv::Point TiledGrid::tile_key(cv::Point cell) const
+{
+  return cv::Point(floor_div(cell.x, tile_size_), floor_div(cell.y, tile_size_));
+}
+
+TiledGrid::Tile *TiledGrid::get_tile(cv::Point key, bool create)
+{
+  TileMap::iterator it = tiles_.find(key);
+  if (it != tiles_.end())
+    return &it->second;
+  bool on_disk = evicted_.erase(key);
+  if (!on_disk && !create)
+    return nullptr;
+  Tile &tile = tiles_[key];
+  tile.dirty = true;
+  if (!on_disk || !load_tile(key, tile))
+    tile.log_odds = cv::Mat::zeros(tile_size_, tile_size_, CV_32FC1);
+  return &tile;
+}
+
+void TiledGrid::set_flip_callback(FlipCallback const &on_flip)
+{
+  on_flip_ = on_flip;
+}
+
+void TiledGrid::trace_beam(cv::Point start, cv::Point end, bool hit, float z)
+{
+  // Bresenham line in map cells, only looking up the tile again when the line leaves the current one
+  LineIterator line(start, end);
+  cv::Point key = tile_key(start);
+  Tile *tile = get_tile(key, true);
+  tile->dirty = true;
+  for (;; line.next())
+  {
+    cv::Point p = line.pos();
+    cv::Point next_key = tile_key(p);
+    if (next_key != key)
+    {
+      key = next_key;
+      tile = get_tile(key, true);
+      tile->dirty = true;
+    }
+    float &val = tile->log_odds.at<float>(p.y - key.y * tile_size_, p.x - key.x * tile_size_);
+    bool was_occupied = val > update_.occupied;
+    if (line.at_end())
+    {
+      if (hit)
+      {
+        val = std::min(val + update_.hit, update_.max);
+        if (!was_occupied && val > update_.occupied && on_flip_)
+          on_flip_(p, true, z);
+      }
+      return;
+    }
+    val = std::max(val + update_.miss, update_.min);
+    if (was_occupied && val <= update_.occupied && on_flip_)
+      on_flip_(p, false, 0);
+  }
+}
+
+void TiledGrid::center_window(cv::Point cell)
+{
+  cv::Point window_tile = tile_key(cell) - cv::Point(window_tiles_ / 2, window_tiles_ / 2);
+  if (window_tile == window_tile_)
+    return;
+  window_tile_ = window_tile;
+  window_moved_ = true;
+  evict();
+}
+
+cv::Point TiledGrid::window_origin() const
+{
+  return window_tile_ * tile_size_;
+}
+
+int TiledGrid::window_cells() const
+{
+  return window_tiles_ * tile_size_;
+}
+
+bool TiledGrid::threshold_window(cv::Mat &out, std::vector<cv::Rect> *changed)
+{
+  const float occupied = update_.occupied;
+  const float unoccupied = update_.unoccupied;
+  const uchar occupied_value = uchar(OCCUPIED);
+  const uchar unoccupied_value = uchar(UNOCCUPIED);
+  const uchar unknown_value = uchar(UNKNOWN);
+  for (int tile_y = 0; tile_y < window_tiles_; ++tile_y)
+  {
+    for (int tile_x = 0; tile_x < window_tiles_; ++tile_x)
+    {
+      cv::Rect out_rect(tile_x * tile_size_, tile_y * tile_size_, tile_size_, tile_size_);
+      cv::Mat out_tile = out(out_rect);
+      Tile *tile = get_tile(window_tile_ + cv::Point(tile_x, tile_y), false);
+      if (!tile)
+      {
+        if (window_moved_)
+          out_tile = unknown_value;
+        continue;
+      }
+      if (!tile->dirty && !window_moved_)
+        continue;
+      tile->dirty = false;
+      if (changed && !window_moved_)
+        changed->push_back(out_rect);
+      // Each tile row is contiguous, and the loop is branchless so the compiler can vectorize it
+      for (int row = 0; row < tile_size_; ++row)
+      {
+        const float *__restrict__ in = tile->log_odds.ptr<float>(row);
+        uchar *__restrict__ cells = out_tile.ptr(row);
+        for (int col = 0; col < tile_size_; ++col)
+        {
+          float val = in[col];
+          uchar cell = val < unoccupied ? unoccupied_value : unknown_value;
+          cells[col] = val > occupied ? occupied_value : cell;
+        }
+      }
+    }
+  }
+  bool whole = window_moved_;
+  window_moved_ = false;
+  return whole;
+}
+
+void TiledGrid::invalidate_window()
+{
+  window_moved_ = true;
+}
+
+void TiledGrid::clear()
+{
+  for (cv::Point const &key : evicted_)
+    std::remove(tile_path(key).c_str());
+  evicted_.clear();
+  tiles_.clear();
+  window_moved_ = true;
+}
+
+void TiledGrid::evict()
+{
+  if (tile_dir_.empty())
+    return;
+  cv::Rect keep(window_tile_ - cv::Point(1, 1), cv::Size(window_tiles_ + 2, window_tiles_ + 2));
+  for (TileMap::iterator it = tiles_.begin(); it != tiles_.end();)
+  {
+    if (keep.contains(it->first) || !save_tile(it->first, it->second))
+    {
+      ++it;
+      continue;
+    }
+    evicted_.insert(it->first);
+    it = tiles_.erase(it);
+  }
+}
+
+std::string TiledGrid::tile_path(cv::Point key) const
+{
+  return tile_dir_ + "/" + std::to_string(key.x) + "_" + std::to_string(key.y) + ".tile";
+}
+
+bool TiledGrid::save_tile(cv::Point key, Tile const &tile) const
+{
+  std::string path = tile_path(key);
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<char const *>(tile.log_odds.data), tile.log_odds.total() * tile.log_odds.elemSize());
+  file.close();
+  if (!file)
+  {
+    ROS_WARN_STREAM_THROTTLE(10, "Could not write ogrid tile to " << path << ", keeping it in memory");
+    return false;
+  }
+  return true;
+}
+
+bool TiledGrid::load_tile(cv::Point key, Tile &tile) const
+{
+  std::string path = tile_path(key);
+  tile.log_odds = cv::Mat(tile_size_, tile_size_, CV_32FC1);
+  std::ifstream file(path, std::ios::binary);
+  file.read(reinterpret_cast<char *>(tile.log_odds.data), tile.log_odds.total() * tile.log_odds.elemSize());
+  if (!file)
+  {
+    ROS_WARN_STREAM("Could not read ogrid tile from " << path << ", treating it as unknown");
+    return false;
+  }
+  std::remove(path.c_str());
+  return true;
+}
+
+}  // namespace mil_ogrid
@@ -0,0 +1,286 @@
+#include <mil_ogrid/voxel_map.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace mil_ogrid
+{
+namespace
+{
+// Division rounding toward negative infinity, so negative voxels land in the right block
+int floor_div(int a, int b)
+{
+  return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+int clamp(int cell, int size)
+{
+  return std::min(std::max(cell, 0), size - 1);
+}
+
+// Keep the most important of what is known about a cell: occupied, then unoccupied, then unknown
+void merge(uchar& cell, uchar value)
+{
+  if (value == uchar(OCCUPIED) || (value == uchar(UNOCCUPIED) && cell == uchar(UNKNOWN)))
+    cell = value;
+}
+}  // anonymous namespace
+
+const int VoxelMap::BLOCK_SIZE;
+
+VoxelMap::VoxelMap() : VoxelMap(0.1, Update{ 0, 0, 0, 0, 0, 0 })
+{
+}
+
+VoxelMap::VoxelMap(float resolution, Update const& update) : resolution_(resolution), update_(update)
+{
+}
+
+cv::Point3i VoxelMap::voxel_of(cv::Point3f const& point) const
+{
+  return cv::Point3i(std::floor(point.x / resolution_), std::floor(point.y / resolution_),
+                     std::floor(point.z / resolution_));
+}
+
+cv::Point3i VoxelMap::block_key(cv::Point3i const& voxel)
+{
+  return cv::Point3i(floor_div(voxel.x, BLOCK_SIZE), floor_div(voxel.y, BLOCK_SIZE), floor_div(voxel.z, BLOCK_SIZE));
+}
+
+int VoxelMap::block_index(cv::Point3i const& voxel, cv::Point3i const& key)
+{
+  cv::Point3i in_block = voxel - key * BLOCK_SIZE;
+  return in_block.x + BLOCK_SIZE * (in_block.y + BLOCK_SIZE * in_block.z);
+}
+
+VoxelMap::Block& VoxelMap::get_block(cv::Point3i const& key)
+{
+  BlockMap::iterator it = blocks_.find(key);
+  if (it != blocks_.end())
+    return it->second;
+  Block& block = blocks_[key];
+  block.fill(0.f);
+  return block;
+}
+
+VoxelMap::Block const* VoxelMap::find_block(cv::Point3i const& key) const
+{
+  BlockMap::const_iterator it = blocks_.find(key);
+  return it == blocks_.end() ? nullptr : &it->second;
+}
+
+CellValue VoxelMap::value(float log_odds) const
+{
+  if (log_odds > update_.occupied)
+    return OCCUPIED;
+  return log_odds < update_.unoccupied ? UNOCCUPIED : UNKNOWN;
+}
+
+void VoxelMap::trace_ray(cv::Point3f const& start, cv::Point3f const& end, bool hit)
+{
+  // Walk the voxels the ray crosses in order (Amanatides and Woo), stepping along whichever axis reaches its next
+  // voxel boundary first. An axis stops once it reaches the end voxel, so rounding can't walk past it.
+  cv::Point3i first = voxel_of(start);
+  cv::Point3i last = voxel_of(end);
+  int voxel[3] = { first.x, first.y, first.z };
+  const int target[3] = { last.x, last.y, last.z };
+  const float origin[3] = { start.x / resolution_, start.y / resolution_, start.z / resolution_ };
+  const float direction[3] = { (end.x - start.x) / resolution_, (end.y - start.y) / resolution_,
+                               (end.z - start.z) / resolution_ };
+  const float infinity = std::numeric_limits<float>::infinity();
+  int step[3];
+  float t_max[3], t_delta[3];
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    step[axis] = target[axis] > voxel[axis] ? 1 : (target[axis] < voxel[axis] ? -1 : 0);
+    if (step[axis] == 0)
+    {
+      t_max[axis] = t_delta[axis] = infinity;
+      continue;
+    }
+    float boundary = step[axis] > 0 ? voxel[axis] + 1 : voxel[axis];
+    t_delta[axis] = std::abs(1 / direction[axis]);
+    t_max[axis] = (boundary - origin[axis]) / direction[axis];
+  }
+
+  // Only look up the block again when the ray leaves the current one
+  cv::Point3i key = block_key(first);
+  Block* block = &get_block(key);
+  int steps = std::abs(last.x - first.x) + std::abs(last.y - first.y) + std::abs(last.z - first.z);
+  for (int n = 0;; ++n)
+  {
+    cv::Point3i p(voxel[0], voxel[1], voxel[2]);
+    cv::Point3i next_key = block_key(p);
+    if (next_key != key)
+    {
+      key = next_key;
+      block = &get_block(key);
+    }
+    float& val = (*block)[block_index(p, key)];
+    if (n == steps)
+    {
+      if (hit)
+        val = std::min(val + update_.hit, update_.max);
+      return;
+    }
+    val = std::max(val + update_.miss, update_.min);
+
+    int axis = -1;
+    for (int a = 0; a < 3; ++a)
+    {
+      if (voxel[a] != target[a] && (axis < 0 || t_max[a] < t_max[axis]))
+        axis = a;
+    }
+    voxel[axis] += step[axis];
+    t_max[axis] += t_delta[axis];
+  }
+}
+
+void VoxelMap::add_hit(cv::Point3f const& point)
+{
+  cv::Point3i voxel = voxel_of(point);
+  cv::Point3i key = block_key(voxel);
+  float& val = get_block(key)[block_index(voxel, key)];
+  val = std::min(val + update_.hit, update_.max);
+}
+
+float VoxelMap::log_odds(cv::Point3i const& voxel) const
+{
+  cv::Point3i key = block_key(voxel);
+  Block const* block = find_block(key);
+  return block ? (*block)[block_index(voxel, key)] : 0.f;
+}
+
+CellValue VoxelMap::column(float x, float y, float z_min, float z_max) const
+{
+  cv::Point3i bottom = voxel_of(cv::Point3f(x, y, z_min));
+  int k_max = std::floor(z_max / resolution_);
+  uchar cell = uchar(UNKNOWN);
+  for (cv::Point3i voxel = bottom; voxel.z <= k_max; ++voxel.z)
+  {
+    cv::Point3i key = block_key(voxel);
+    Block const* block = find_block(key);
+    if (!block)
+    {
+      // Skip the rest of a block that was never observed
+      voxel.z = (key.z + 1) * BLOCK_SIZE - 1;
+      continue;
+    }
+    merge(cell, value((*block)[block_index(voxel, key)]));
+    if (cell == uchar(OCCUPIED))
+      break;
+  }
+  return CellValue(cell);
+}
+
+bool VoxelMap::highest_occupied(float x, float y, float z_min, float z_max, float& z) const
+{
+  cv::Point3i top = voxel_of(cv::Point3f(x, y, z_max));
+  int k_min = std::floor(z_min / resolution_);
+  for (cv::Point3i voxel = top; voxel.z >= k_min; --voxel.z)
+  {
+    cv::Point3i key = block_key(voxel);
+    Block const* block = find_block(key);
+    if (!block)
+    {
+      voxel.z = key.z * BLOCK_SIZE;
+      continue;
+    }
+    if ((*block)[block_index(voxel, key)] > update_.occupied)
+    {
+      z = (voxel.z + 1) * resolution_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void VoxelMap::slice(GridGeometry const& geometry, float z_min, float z_max, cv::Mat& out) const
+{
+  out.create(geometry.height, geometry.width, CV_8UC1);
+  out = uchar(UNKNOWN);
+  if (blocks_.empty() || geometry.width <= 0 || geometry.height <= 0)
+    return;
+
+  // Voxel columns whose centers are in the grid, and the voxels from z_min to z_max
+  const cv::Point3i min(std::ceil(geometry.origin_x / resolution_ - 0.5),
+                        std::ceil(geometry.origin_y / resolution_ - 0.5), std::floor(z_min / resolution_));
+  const cv::Point3i max(
+      std::ceil((geometry.origin_x + geometry.width * geometry.resolution) / resolution_ - 0.5) - 1,
+      std::ceil((geometry.origin_y + geometry.height * geometry.resolution) / resolution_ - 0.5) - 1,
+      std::floor(z_max / resolution_));
+  const cv::Point3i min_key = block_key(min);
+  const cv::Point3i max_key = block_key(max);
+
+  int cell_x[BLOCK_SIZE], cell_y[BLOCK_SIZE];
+  for (int key_y = min_key.y; key_y <= max_key.y; ++key_y)
+  {
+    for (int key_x = min_key.x; key_x <= max_key.x; ++key_x)
+    {
+      const cv::Point3i base(key_x * BLOCK_SIZE, key_y * BLOCK_SIZE, 0);
+      const int x_begin = std::max(min.x - base.x, 0), x_end = std::min(max.x - base.x + 1, BLOCK_SIZE);
+      const int y_begin = std::max(min.y - base.y, 0), y_end = std::min(max.y - base.y + 1, BLOCK_SIZE);
+      bool cells_found = false;
+      for (int key_z = min_key.z; key_z <= max_key.z; ++key_z)
+      {
+        Block const* block = find_block(cv::Point3i(key_x, key_y, key_z));
+        if (!block)
+          continue;
+        // Every block of this column of blocks covers the same cells. Clamped, in case rounding puts a center on
+        // the far side of the grid's edge.
+        if (!cells_found)
+        {
+          for (int x = x_begin; x < x_end; ++x)
+            cell_x[x] = clamp(geometry.cell((base.x + x + 0.5) * resolution_, 0).x, geometry.width);
+          for (int y = y_begin; y < y_end; ++y)
+            cell_y[y] = clamp(geometry.cell(0, (base.y + y + 0.5) * resolution_).y, geometry.height);
+          cells_found = true;
+        }
+        const int z_begin = std::max(min.z - key_z * BLOCK_SIZE, 0);
+        const int z_end = std::min(max.z - key_z * BLOCK_SIZE + 1, BLOCK_SIZE);
+        for (int z = z_begin; z < z_end; ++z)
+        {
+          for (int y = y_begin; y < y_end; ++y)
+          {
+            uchar* row = out.ptr(cell_y[y]);
+            float const* voxels = &(*block)[BLOCK_SIZE * (y + BLOCK_SIZE * z)];
+            for (int x = x_begin; x < x_end; ++x)
+              merge(row[cell_x[x]], value(voxels[x]));
+          }
+        }
+      }
+    }
+  }
+}
+
+void VoxelMap::evict_far(cv::Point3f const& center, size_t max_bytes)
+{
+  size_t keep = max_bytes / sizeof(Block);
+  if (blocks_.size() <= keep)
+    return;
+  const cv::Point3i center_key = block_key(voxel_of(center));
+  std::vector<std::pair<int64_t, cv::Point3i>> by_distance;
+  by_distance.reserve(blocks_.size());
+  for (BlockMap::value_type const& block : blocks_)
+  {
+    cv::Point3i d = block.first - center_key;
+    by_distance.emplace_back(int64_t(d.x) * d.x + int64_t(d.y) * d.y + int64_t(d.z) * d.z, block.first);
+  }
+  std::nth_element(by_distance.begin(), by_distance.begin() + keep, by_distance.end(),
+                   [](std::pair<int64_t, cv::Point3i> const& a, std::pair<int64_t, cv::Point3i> const& b) {
+                     return a.first < b.first;
+                   });
+  for (size_t i = keep; i < by_distance.size(); ++i)
+    blocks_.erase(by_distance[i].second);
+}
+
+void VoxelMap::clear()
+{
+  blocks_.clear();
+}
+
+}  // namespace mil_ogrid
@@ -0,0 +1,233 @@
+#include <gtest/gtest.h>
+
+#include <mil_ogrid/distance_field.hpp>
+#include <mil_ogrid/grid_delta.hpp>
+#include <mil_ogrid/grid_geometry.hpp>
+#include <mil_ogrid/raster.hpp>
+#include <mil_ogrid/tiled_grid.hpp>
+#include <mil_ogrid/voxel_map.hpp>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace mil_ogrid;
+
+TEST(GridGeometry, CellsRoundTowardNegativeInfinity)
+{
+  GridGeometry geometry(0.5, -10., -5., 40, 20);
+  EXPECT_EQ(geometry.cell(-10., -5.), cv::Point(0, 0));
+  EXPECT_EQ(geometry.cell(-10.1, -5.1), cv::Point(-1, -1));
+  EXPECT_EQ(geometry.cell(9.9, 4.9), cv::Point(39, 19));
+  EXPECT_FALSE(geometry.contains(geometry.cell(10., 0.)));
+  cv::Point2d center = geometry.center(cv::Point(3, 4));
+  EXPECT_EQ(geometry.cell(center.x, center.y), cv::Point(3, 4));
+
+  nav_msgs::MapMetaData info;
+  geometry.to_info(info);
+  GridGeometry back = GridGeometry::from_info(info);
+  EXPECT_EQ(back.width, 40);
+  EXPECT_EQ(back.height, 20);
+  EXPECT_DOUBLE_EQ(back.origin_x, -10.);
+}
+
+TEST(LineIterator, VisitsEveryCellOnce)
+{
+  cv::Point start(-3, 7), end(12, -2);
+  int cells = 1;
+  for (LineIterator line(start, end); !line.at_end(); line.next())
+    ++cells;
+  // A Bresenham line has one cell per step along its major axis
+  EXPECT_EQ(cells, 16);
+}
+
+// Brute force chessboard distance, with outside the grid occupied
+static int brute_distance(std::vector<int8_t> const& cells, int width, int height, int x, int y)
+{
+  int best = std::min(std::min(x + 1, width - x), std::min(y + 1, height - y));
+  for (int oy = 0; oy < height; ++oy)
+    for (int ox = 0; ox < width; ++ox)
+      if (cells[ox + oy * width] == OCCUPIED)
+        best = std::min(best, std::max(std::abs(ox - x), std::abs(oy - y)));
+  return best;
+}
+
+TEST(DistanceField, UpdateMatchesRecompute)
+{
+  const int width = 37, height = 23;
+  const uint16_t max_distance = 4;
+  std::vector<int8_t> cells(width * height, UNOCCUPIED);
+  std::srand(1);
+  for (int8_t& cell : cells)
+    cell = std::rand() % 30 == 0 ? OCCUPIED : UNOCCUPIED;
+
+  DistanceField field;
+  field.compute(cells.data(), width, height, OCCUPIED, max_distance);
+  for (int i = 0; i < 50; ++i)
+  {
+    cv::Rect changed(std::rand() % width, std::rand() % height, 1 + std::rand() % 5, 1 + std::rand() % 5);
+    changed &= cv::Rect(0, 0, width, height);
+    for (int y = changed.y; y < changed.y + changed.height; ++y)
+      for (int x = changed.x; x < changed.x + changed.width; ++x)
+        cells[x + y * width] = std::rand() % 3 == 0 ? OCCUPIED : UNOCCUPIED;
+    field.update(cells.data(), changed);
+  }
+  for (int y = 0; y < height; ++y)
+    for (int x = 0; x < width; ++x)
+      ASSERT_EQ(field.at(cv::Point(x, y)), std::min<int>(max_distance, brute_distance(cells, width, height, x, y)))
+          << "at " << x << ", " << y;
+}
+
+TEST(GridDelta, UpdateRoundTrip)
+{
+  nav_msgs::OccupancyGrid source, copy;
+  GridGeometry(1., 0., 0., 16, 8).to_info(source.info);
+  source.data.assign(16 * 8, UNKNOWN);
+  copy = source;
+
+  cv::Mat grid = as_mat(source);
+  cv::Rect rect(3, 2, 5, 4);
+  grid(rect) = cv::Scalar(OCCUPIED);
+
+  map_msgs::OccupancyGridUpdate update;
+  make_update(grid, rect, update);
+  EXPECT_EQ(apply_update(copy, update), rect);
+  EXPECT_EQ(copy.data, source.data);
+
+  update.width = 20;
+  EXPECT_TRUE(apply_update(copy, update).empty());
+}
+
+TEST(DiskStamp, InflateMatchesDrawingEachCell)
+{
+  cv::Mat grid = cv::Mat::zeros(30, 30, CV_8UC1);
+  grid.at<uchar>(4, 5) = OCCUPIED;
+  grid.at<uchar>(20, 22) = OCCUPIED;
+  grid.at<uchar>(29, 0) = OCCUPIED;
+
+  DiskStamp disk(3);
+  cv::Mat inflated;
+  disk.inflate(grid, inflated);
+
+  cv::Mat drawn = grid.clone();
+  cv::Rect all(0, 0, grid.cols, grid.rows);
+  disk.draw(drawn, cv::Point(5, 4), all);
+  disk.draw(drawn, cv::Point(22, 20), all);
+  disk.draw(drawn, cv::Point(0, 29), all);
+  EXPECT_EQ(cv::countNonZero(inflated != drawn), 0);
+}
+
+TEST(TiledGrid, BeamsMarkHitsAndMisses)
+{
+  TiledGrid::Update update{ 1., -0.5, -2., 2., 0.5, -0.25 };
+  TiledGrid grid(8, 3, update, "");
+  grid.center_window(cv::Point(0, 0));
+  grid.trace_beam(cv::Point(0, 0), cv::Point(5, 2), true, 0.);
+
+  cv::Mat out(grid.window_cells(), grid.window_cells(), CV_8UC1);
+  EXPECT_TRUE(grid.threshold_window(out));
+  cv::Point origin = grid.window_origin();
+  EXPECT_EQ(out.at<uchar>(cv::Point(5, 2) - origin), uchar(OCCUPIED));
+  EXPECT_EQ(out.at<uchar>(cv::Point(0, 0) - origin), uchar(UNOCCUPIED));
+  EXPECT_EQ(out.at<uchar>(cv::Point(0, 5) - origin), uchar(UNKNOWN));
+
+  // Only the tile the next beam touches is written again
+  std::vector<cv::Rect> changed;
+  grid.trace_beam(cv::Point(1, 1), cv::Point(3, 1), false, 0.);
+  EXPECT_FALSE(grid.threshold_window(out, &changed));
+  ASSERT_EQ(changed.size(), 1u);
+  EXPECT_TRUE(changed[0].contains(cv::Point(3, 1) - origin));
+}
+
+TEST(VoxelMap, RaysMarkHitsAndMisses)
+{
+  VoxelMap::Update update{ 1., -0.5, -2., 2., 0.5, -0.25 };
+  VoxelMap map(0.1, update);
+  // A slanted ray across block boundaries, including negative ones
+  cv::Point3f start(-0.35, 0.05, -1.95), end(0.72, -0.43, -1.21);
+  map.trace_ray(start, end, true);
+
+  EXPECT_FLOAT_EQ(map.log_odds(map.voxel_of(end)), 1.);
+  EXPECT_FLOAT_EQ(map.log_odds(map.voxel_of(start)), -0.5);
+  EXPECT_FLOAT_EQ(map.log_odds(cv::Point3i(10, 10, 10)), 0.);
+  // The voxels crossed are face neighbours, one per step from start to end
+  cv::Point3i first = map.voxel_of(start), last = map.voxel_of(end);
+  int steps = std::abs(last.x - first.x) + std::abs(last.y - first.y) + std::abs(last.z - first.z);
+  int misses = 0;
+  for (int x = -10; x <= 10; ++x)
+    for (int y = -10; y <= 10; ++y)
+      for (int z = -25; z <= -5; ++z)
+        misses += map.log_odds(cv::Point3i(x, y, z)) < 0;
+  EXPECT_EQ(misses, steps);
+  EXPECT_LE(map.blocks(), 8u);
+
+  EXPECT_EQ(map.column(end.x, end.y, -2., 0.), OCCUPIED);
+  EXPECT_EQ(map.column(end.x, end.y, -1., 0.), UNKNOWN);
+  EXPECT_EQ(map.column(start.x, start.y, -2., -1.), UNOCCUPIED);
+  float z;
+  ASSERT_TRUE(map.highest_occupied(end.x, end.y, -5., 5., z));
+  EXPECT_NEAR(z, -1.2, 1e-5);
+  EXPECT_FALSE(map.highest_occupied(start.x, start.y, -5., 5., z));
+}
+
+TEST(VoxelMap, SliceMatchesColumns)
+{
+  VoxelMap::Update update{ 1., -0.5, -2., 2., 0.5, -0.25 };
+  VoxelMap map(0.1, update);
+  std::srand(7);
+  for (int i = 0; i < 200; ++i)
+  {
+    cv::Point3f end(std::rand() % 400 / 100. - 2., std::rand() % 400 / 100. - 2., std::rand() % 200 / 100. - 2.);
+    map.trace_ray(cv::Point3f(0.01, 0.01, -1.), end, std::rand() % 2);
+  }
+
+  // Cells of two voxels a side, starting off the voxel grid
+  GridGeometry geometry(0.2, -1.5, -1.7, 15, 17);
+  cv::Mat slice;
+  map.slice(geometry, -1.5, -0.6, slice);
+  ASSERT_EQ(slice.rows, 17);
+  ASSERT_EQ(slice.cols, 15);
+  for (int y = 0; y < geometry.height; ++y)
+  {
+    for (int x = 0; x < geometry.width; ++x)
+    {
+      uchar expected = uchar(UNKNOWN);
+      for (int dy = 0; dy < 2; ++dy)
+      {
+        for (int dx = 0; dx < 2; ++dx)
+        {
+          cv::Point2d center = geometry.center(cv::Point(x, y));
+          uchar column = map.column(center.x + (dx - 0.5) * 0.1, center.y + (dy - 0.5) * 0.1, -1.5, -0.6);
+          if (column == uchar(OCCUPIED) || (column == uchar(UNOCCUPIED) && expected == uchar(UNKNOWN)))
+            expected = column;
+        }
+      }
+      EXPECT_EQ(slice.at<uchar>(y, x), expected) << "cell " << x << ", " << y;
+    }
+  }
+}
+
+TEST(VoxelMap, EvictFarKeepsNearestBlocks)
+{
+  VoxelMap::Update update{ 1., -0.5, -2., 2., 0.5, -0.25 };
+  VoxelMap map(0.1, update);
+  // One block every 0.8 m along x
+  for (int i = 0; i < 10; ++i)
+    map.add_hit(cv::Point3f(0.05 + 0.8 * i, 0.05, 0.05));
+  ASSERT_EQ(map.blocks(), 10u);
+  size_t block_bytes = map.bytes() / map.blocks();
+
+  map.evict_far(cv::Point3f(0.05, 0.05, 0.05), 4 * block_bytes);
+  EXPECT_EQ(map.blocks(), 4u);
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(map.log_odds(map.voxel_of(cv::Point3f(0.05 + 0.8 * i, 0.05, 0.05))) > 0, i < 4) << "block " << i;
+
+  // Already small enough
+  map.evict_far(cv::Point3f(0.05, 0.05, 0.05), 4 * block_bytes);
+  EXPECT_EQ(map.blocks(), 4u);
+}
+
+int main(int argc, char** argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,9 +1,8 @@
 #pragma once
 #include <geometry_msgs/Vector3Stamped.h>
 #include <image_geometry/pinhole_camera_model.h>
-#include <message_filters/cache.h>
-#include <message_filters/subscriber.h>
 #include <mil_msgs/CameraToLidarTransform.h>
+#include <mil_msgs/CameraToLidarTransformBatch.h>
 #include <pcl/features/integral_image_normal.h>
 #include <pcl/features/normal_3d.h>
 #include <pcl/io/io.h>
@@ -13,6 +12,7 @@
 #include <pcl_conversions/pcl_conversions.h>
 #include <pcl_conversions/pcl_conversions.h>
 #include <pcl_ros/point_cloud.h>
+#include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <sensor_msgs/CameraInfo.h>
 #include <sensor_msgs/PointCloud2.h>
@@ -24,7 +24,11 @@
 #include <visualization_msgs/MarkerArray.h>
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #define DO_ROS_DEBUG
 
@@ -35,31 +39,75 @@
 #include "opencv2/opencv.hpp"
 #endif
 
+// A lidar cloud in the camera frame, keeping only the points that project into the image, sorted by the pixel they
+// project to so the points near a pixel can be found without going over the whole cloud
+struct ProjectedCloud
+{
+  ros::Time cloud_stamp;
+  int width;
+  int height;
+  // Camera frame position and pixel of each point
+  std::vector<float> x, y, z;
+  std::vector<float> u, v;
+  // The points projecting to image row r are [row_start[r], row_start[r + 1]), in order of their column
+  std::vector<int> row_start;
+};
+
 class CameraLidarTransformer
 {
 private:
   std::string camera_info_topic;
   ros::NodeHandle nh;
   ros::ServiceServer transformServiceServer;
+  ros::ServiceServer batchServiceServer;
   tf2_ros::Buffer tfBuffer;
   tf2_ros::TransformListener tfListener;
-  message_filters::Subscriber<sensor_msgs::PointCloud2> lidarSub;
-  message_filters::Cache<sensor_msgs::PointCloud2> lidarCache;
+  ros::Subscriber lidarSub;
   ros::Subscriber cameraInfoSub;
   image_geometry::PinholeCameraModel cam_model;
   bool camera_info_received;
   sensor_msgs::CameraInfo camera_info;
   bool inCameraFrame(cv::Point2d& p);
-  void cameraInfoCallback(const sensor_msgs::CameraInfo info);
+  // Projected clouds in stamp order, guarded by cacheMutex along with camera_info and transform_missing
+  std::deque<std::shared_ptr<const ProjectedCloud>> projectedCache;
+  static const size_t PROJECTED_CACHE_SIZE = 100;
+  std::mutex cacheMutex;
+  bool transform_missing;  // the last cloud could not be transformed into the camera frame
+  // Buffers of projectCloud, reused from one cloud to the next
+  std::vector<float> gather_x, gather_y, gather_z, gather_u, gather_v;
+  std::vector<int> gather_pixel, gather_pixel_start;
+  // The cached cloud closest in time to stamp, if one is within MAX_TIME_ERR
+  std::shared_ptr<const ProjectedCloud> closestCloud(const ros::Time& stamp);
+  // Transform a cloud into the camera frame, cull it to the image and project it
+  std::shared_ptr<const ProjectedCloud> projectCloud(const sensor_msgs::PointCloud2& cloud,
+                                                     const geometry_msgs::TransformStamped& transform);
+  void cameraInfoCallback(const sensor_msgs::CameraInfoConstPtr& info);
+  // Project each cloud into the camera frame as it arrives, so requests only have to look up points
+  void lidarCallback(const sensor_msgs::PointCloud2ConstPtr& cloud);
   void drawPoint(cv::Mat& mat, cv::Point2d& p, cv::Scalar color = cv::Scalar(0, 0, 255));
+  // The cloud closest to a request from the subscribed camera, or null with error set if there is none
+  std::shared_ptr<const ProjectedCloud> requestCloud(const std_msgs::Header& header, std::string& error);
+  // Find the points of projected within tolerance pixels of point, filling in result, and put the index of each one
+  // found in near
+  void findPoints(const ProjectedCloud& projected, const geometry_msgs::Point& point, double tolerance,
+                  mil_msgs::CameraToLidarResult& result, std::vector<int>& near) const;
   bool transformServiceCallback(mil_msgs::CameraToLidarTransform::Request& req,
                                 mil_msgs::CameraToLidarTransform::Response& res);
+  // Many points against the same stamp, all looked up in the one cloud closest to it
+  bool batchServiceCallback(mil_msgs::CameraToLidarTransformBatch::Request& req,
+                            mil_msgs::CameraToLidarTransformBatch::Response& res);
   static ros::Duration MAX_TIME_ERR;
 #ifdef DO_ROS_DEBUG
+  // Marker for a point of the cloud, red if it is near the requested point and green if not
+  visualization_msgs::Marker pointMarker(const std_msgs::Header& header, int id, double x, double y, double z,
+                                         bool near);
   ros::Publisher pubMarkers;
   image_transport::ImageTransport image_transport;
   image_transport::Publisher points_debug_publisher;
 #endif
+  // Queue and thread for the lidar and camera info callbacks, last so they stop before anything they use goes away
+  ros::CallbackQueue lidarQueue;
+  ros::AsyncSpinner lidarSpinner;
 public:
   CameraLidarTransformer();
 };
@@ -2,12 +2,14 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
@@ -21,22 +23,80 @@ class ClosedCurve;
 
 namespace Perturbations
 {
-static std::map<std::pair<uint8_t, uint8_t>, std::vector<std::vector<uint8_t>>> perturbation_cache;
-void initPerturbationCache();
+/*
+  Curves are stored as chain codes, the direction of the step from each point to the next one. Code k steps by
+  (CHAIN_DX[k], CHAIN_DY[k]), counterclockwise from +x in image coordinates. Reversing a step adds 4 to its code.
+*/
+constexpr int8_t CHAIN_DX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+constexpr int8_t CHAIN_DY[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+constexpr uint8_t NO_CODE = 8;
+
+// Chain code of the step (dx, dy), both in [-1, 1], or NO_CODE for (0, 0)
+constexpr uint8_t getChainCode(int dx, int dy)
+{
+  return dy < 0 ? uint8_t(2 - dx) : dy > 0 ? uint8_t(6 + dx) : dx > 0 ? 0 : dx < 0 ? 4 : NO_CODE;
+}
+
+/*
+  The 16 points on the border of the 5x5 neighborhood of a point, numbered clockwise from its top left corner, are
+  where a perturbation of the curve enters and leaves the neighborhood.
+*/
+constexpr uint8_t RING_SIZE = 16;
+constexpr uint8_t NOT_ON_RING = RING_SIZE;
+
+// Ring position of the offset (dx, dy) from the center of the neighborhood, or NOT_ON_RING if it is not on the border
+constexpr uint8_t getRingPosition(int dx, int dy)
+{
+  // top row, right column, bottom row, then left column
+  return (dy == -2 && dx >= -2 && dx <= 2) ? uint8_t(dx + 2) :
+         (dx == 2 && dy > -2 && dy <= 2) ? uint8_t(dy + 6) :
+         (dy == 2 && dx >= -2 && dx < 2) ? uint8_t(10 - dx) :
+         (dx == -2 && dy > -2 && dy < 2) ? uint8_t(14 - dy) : NOT_ON_RING;
+}
+
+/*
+  A route from an entry point on the border of a neighborhood to an exit point on it, through new points inside it.
+  Routes are stored in a precomputed table, see active_contours_routes.hpp.
+*/
+struct Route
+{
+  uint8_t length;    // number of steps, one more than the number of new points
+  uint8_t codes[6];  // chain code of the steps from the entry, through the new points, to the exit
+};
+
+typedef std::pair<const Route*, const Route*> RouteRange;  // [first, second)
+
+// Routes between two ring positions, empty if either is NOT_ON_RING or they are next to each other on the ring
+RouteRange getRoutes(uint8_t entry_ring_pos, uint8_t exit_ring_pos);
+
+/*
+  Points of the 5x5 neighborhood are also indexed as y * 8 + x, (2, 2) being its center. Routes between the
+  neighborhood indices entry and exit, as lists of the neighborhood indices of their new points.
+*/
 std::vector<std::vector<uint8_t>> getPerturbations(uint8_t entry, uint8_t exit);
 uint8_t getIdxFromPoint(cv::Point2i hood_point);
 cv::Point2i getPointFromIdx(uint8_t idx);
 std::vector<cv::Point2i> getPointList(std::vector<uint8_t>& idx_list);
 std::vector<uint8_t> getHoodIdxs(uint8_t idx, bool include_border);
 bool isNeighbor(uint8_t idx1, uint8_t idx2);
+// True if the points are different and 8-connected
 bool isNeighborPoint(const cv::Point2i& pt1, const cv::Point2i& pt2);
-void growRoute(const std::vector<uint8_t>& partial, const std::vector<uint8_t>& occupied, uint8_t entry, uint8_t exit);
-std::vector<cv::Point2i> perturb(const std::vector<cv::Point2i>& src_curve, std::vector<uint8_t> perturbation, int idx);
 }  // namespace Perturbations
 
+/*
+  Closed 8-connected curve, stored as its first point and the chain code of its steps, the last one going back to the
+  first point. Perturbations replace the three points around one of the curve's points with the new points of a
+  route, in place and without allocating once the chain code has grown to its largest size.
+*/
 class ClosedCurve
 {
-  std::vector<cv::Point2i> _curve_points;
+  cv::Point2i _start;
+  std::vector<uint8_t> _codes;
+
+  // Offsets of points idx - 2 and idx + 2 from point idx
+  void _endOffsets(size_t idx, cv::Point2i& entry, cv::Point2i& exit) const;
+  // Replaces the four steps from point idx - 2 to point idx + 2 with count others
+  void _replaceSteps(size_t idx, const uint8_t* codes, size_t count);
 
 public:
   struct Perturbation
@@ -47,10 +107,50 @@ public:
     std::vector<uint8_t> route;
   };
 
-  ClosedCurve(std::vector<cv::Point2i> points);
+  // points have to form a valid curve, see validateCurve
+  ClosedCurve(const std::vector<cv::Point2i>& points);
+
+  size_t size() const
+  {
+    return _codes.size();
+  }
+
+  const cv::Point2i& start() const
+  {
+    return _start;
+  }
+
+  const std::vector<uint8_t>& chainCode() const
+  {
+    return _codes;
+  }
+
+  // Points of the curve, written into points to reuse its storage
+  void getPoints(std::vector<cv::Point2i>& points) const;
+  std::vector<cv::Point2i> points() const;
+
+  /*
+    Routes that the three points around point idx can be replaced with, empty if the points two steps before and after
+    it are not on the border of its 5x5 neighborhood. Curves need at least 5 points to be perturbed.
+  */
+  Perturbations::RouteRange getPerturbations(size_t idx) const;
+
+  /*
+    Replaces the three points around point idx with the new points of route, which has to be one of those
+    getPerturbations(idx) gives. When those points wrap around the end of the chain code, the curve is rotated first,
+    so the points may be numbered from a different start afterwards.
+  */
+  void applyPerturbation(const Perturbations::Route& route, size_t idx);
+
+  // Same, with the route as the neighborhood indices of its new points, as Perturbations::getPerturbations gives
   void applyPerturbation(const std::vector<uint8_t>& perturbation, int idx);
-  ClosedCurve perturb(const std::vector<uint8_t>& perturbation, int idx);
-  static bool validateCurve(std::vector<cv::Point2i>& curve);
+  ClosedCurve perturb(const std::vector<uint8_t>& perturbation, int idx) const;
+
+  /*
+    Checks that consecutive points, the last and first included, are 8-connected and that points that are not
+    consecutive never are.
+  */
+  static bool validateCurve(const std::vector<cv::Point2i>& curve);
   /* NOT IMPLEMENTED
   std::vector<float> calcCosts(const cv::Mat& img, std::vector<Perturbation> candidate_perturbs,
                                std::function<float(const cv::Mat&, Perturbation)> cb);
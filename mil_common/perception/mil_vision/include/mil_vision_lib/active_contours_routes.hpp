@@ -0,0 +1,346 @@
+#pragma once
+
+#include <mil_vision_lib/active_contours.hpp>
+
+namespace mil_vision
+{
+namespace Perturbations
+{
+/*
+  Every route a curve can take through the inner 3x3 of the 5x5 neighborhood of one of its points, between the two
+  points of the curve on the border of that neighborhood. These are the routes that used to be enumerated at startup
+  by growing them one point at a time from the entry to the exit. benchmark_active_contours checks they still match.
+  The routes from ring position a to ring position b are ROUTES[ROUTE_OFFSETS[a * 16 + b]] up to, not including,
+  ROUTES[ROUTE_OFFSETS[a * 16 + b + 1]].
+*/
+constexpr size_t NUM_ROUTES = 1216;
+
+constexpr uint16_t ROUTE_OFFSETS[RING_SIZE * RING_SIZE + 1] = {
+  0, 0, 0, 1, 4, 7, 12, 19, 24, 27, 32, 39, 44, 47, 50, 51,
+  51, 51, 51, 51, 54, 57, 62, 71, 78, 83, 91, 103, 112, 117, 122, 126,
+  128, 129, 129, 129, 129, 130, 134, 142, 151, 158, 170, 187, 199, 206, 215, 223,
+  227, 230, 233, 233, 233, 233, 235, 239, 244, 249, 258, 270, 278, 283, 290, 299,
+  304, 307, 310, 311, 311, 311, 311, 312, 315, 318, 323, 330, 335, 338, 343, 350,
+  355, 360, 365, 369, 371, 371, 371, 371, 374, 377, 382, 391, 398, 403, 411, 423,
+  432, 439, 448, 456, 460, 461, 461, 461, 461, 462, 466, 474, 483, 490, 502, 519,
+  531, 536, 543, 552, 557, 560, 563, 563, 563, 563, 565, 569, 574, 579, 588, 600,
+  608, 611, 616, 623, 628, 631, 634, 635, 635, 635, 635, 636, 639, 642, 647, 654,
+  659, 664, 672, 684, 693, 698, 703, 707, 709, 709, 709, 709, 712, 715, 720, 729,
+  736, 743, 755, 772, 784, 791, 800, 808, 812, 813, 813, 813, 813, 814, 818, 826,
+  835, 840, 849, 861, 869, 874, 881, 890, 895, 898, 901, 901, 901, 901, 903, 907,
+  912, 915, 920, 927, 932, 935, 940, 947, 952, 955, 958, 959, 959, 959, 959, 960,
+  963, 966, 971, 980, 987, 992, 1000, 1012, 1021, 1026, 1031, 1035, 1037, 1037, 1037, 1037,
+  1040, 1041, 1045, 1053, 1062, 1069, 1081, 1098, 1110, 1117, 1126, 1134, 1138, 1139, 1139, 1139,
+  1139, 1139, 1141, 1145, 1150, 1155, 1164, 1176, 1184, 1189, 1196, 1205, 1210, 1213, 1216, 1216,
+  1216
+};
+
+constexpr Route ROUTES[NUM_ROUTES] = {
+  { 2, { 7, 1, 0, 0, 0, 0 } }, { 3, { 7, 0, 1, 0, 0, 0 } }, { 6, { 7, 6, 7, 1, 2, 2 } }, { 4, { 7, 7, 1, 2, 0, 0 } },
+  { 4, { 7, 0, 0, 1, 0, 0 } }, { 6, { 7, 6, 7, 1, 2, 1 } }, { 4, { 7, 7, 1, 1, 0, 0 } }, { 4, { 7, 0, 0, 0, 0, 0 } },
+  { 4, { 7, 0, 7, 1, 0, 0 } }, { 5, { 7, 6, 7, 1, 1, 0 } }, { 4, { 7, 7, 1, 0, 0, 0 } }, { 4, { 7, 7, 0, 1, 0, 0 } },
+  { 4, { 7, 0, 0, 7, 0, 0 } }, { 4, { 7, 0, 7, 0, 0, 0 } }, { 5, { 7, 6, 7, 1, 0, 0 } }, { 5, { 7, 6, 7, 0, 1, 0 } },
+  { 4, { 7, 7, 1, 7, 0, 0 } }, { 4, { 7, 7, 0, 0, 0, 0 } }, { 4, { 7, 7, 7, 1, 0, 0 } }, { 4, { 7, 0, 7, 7, 0, 0 } },
+  { 5, { 7, 6, 7, 1, 7, 0 } }, { 5, { 7, 6, 7, 0, 0, 0 } }, { 4, { 7, 7, 0, 7, 0, 0 } }, { 4, { 7, 7, 7, 0, 0, 0 } },
+  { 5, { 7, 0, 7, 6, 7, 0 } }, { 5, { 7, 6, 7, 0, 7, 0 } }, { 4, { 7, 7, 7, 7, 0, 0 } }, { 5, { 7, 0, 7, 5, 7, 0 } },
+  { 5, { 7, 0, 7, 6, 6, 0 } }, { 4, { 7, 6, 7, 7, 0, 0 } }, { 4, { 7, 7, 6, 7, 0, 0 } }, { 4, { 7, 7, 7, 6, 0, 0 } },
+  { 5, { 7, 0, 7, 5, 6, 0 } }, { 5, { 7, 0, 7, 6, 5, 0 } }, { 4, { 7, 6, 6, 7, 0, 0 } }, { 4, { 7, 6, 7, 6, 0, 0 } },
+  { 4, { 7, 7, 5, 7, 0, 0 } }, { 4, { 7, 7, 6, 6, 0, 0 } }, { 4, { 7, 7, 7, 5, 0, 0 } }, { 5, { 7, 0, 7, 5, 5, 0 } },
+  { 4, { 7, 6, 6, 6, 0, 0 } }, { 4, { 7, 6, 7, 5, 0, 0 } }, { 4, { 7, 7, 5, 6, 0, 0 } }, { 4, { 7, 7, 6, 5, 0, 0 } },
+  { 6, { 7, 0, 7, 5, 4, 5 } }, { 4, { 7, 6, 6, 5, 0, 0 } }, { 4, { 7, 7, 5, 5, 0, 0 } }, { 6, { 7, 0, 7, 5, 4, 4 } },
+  { 3, { 7, 6, 5, 0, 0, 0 } }, { 4, { 7, 7, 5, 4, 0, 0 } }, { 2, { 7, 5, 0, 0, 0, 0 } }, { 6, { 6, 6, 7, 1, 2, 2 } },
+  { 4, { 6, 7, 1, 2, 0, 0 } }, { 2, { 7, 1, 0, 0, 0, 0 } }, { 6, { 6, 6, 7, 1, 2, 1 } }, { 4, { 6, 7, 1, 1, 0, 0 } },
+  { 3, { 7, 0, 1, 0, 0, 0 } }, { 5, { 6, 6, 7, 1, 1, 0 } }, { 4, { 6, 7, 1, 0, 0, 0 } }, { 4, { 6, 7, 0, 1, 0, 0 } },
+  { 3, { 7, 0, 0, 0, 0, 0 } }, { 3, { 7, 7, 1, 0, 0, 0 } }, { 5, { 6, 6, 7, 1, 0, 0 } }, { 5, { 6, 6, 7, 0, 1, 0 } },
+  { 4, { 6, 7, 1, 7, 0, 0 } }, { 4, { 6, 7, 0, 0, 0, 0 } }, { 4, { 6, 7, 7, 1, 0, 0 } }, { 3, { 7, 0, 7, 0, 0, 0 } },
+  { 5, { 7, 5, 7, 0, 1, 0 } }, { 4, { 7, 6, 7, 1, 0, 0 } }, { 3, { 7, 7, 0, 0, 0, 0 } }, { 5, { 6, 6, 7, 1, 7, 0 } },
+  { 5, { 6, 6, 7, 0, 0, 0 } }, { 4, { 6, 7, 0, 7, 0, 0 } }, { 4, { 6, 7, 7, 0, 0, 0 } }, { 5, { 7, 5, 7, 0, 0, 0 } },
+  { 4, { 7, 6, 7, 0, 0, 0 } }, { 3, { 7, 7, 7, 0, 0, 0 } }, { 5, { 6, 6, 7, 0, 7, 0 } }, { 4, { 6, 7, 7, 7, 0, 0 } },
+  { 5, { 7, 5, 7, 0, 7, 0 } }, { 4, { 7, 6, 7, 7, 0, 0 } }, { 4, { 7, 7, 6, 7, 0, 0 } }, { 4, { 6, 6, 7, 7, 0, 0 } },
+  { 4, { 6, 7, 6, 7, 0, 0 } }, { 4, { 6, 7, 7, 6, 0, 0 } }, { 4, { 7, 5, 7, 7, 0, 0 } }, { 4, { 7, 6, 6, 7, 0, 0 } },
+  { 4, { 7, 6, 7, 6, 0, 0 } }, { 4, { 7, 7, 5, 7, 0, 0 } }, { 4, { 7, 7, 6, 6, 0, 0 } }, { 4, { 6, 6, 6, 7, 0, 0 } },
+  { 4, { 6, 6, 7, 6, 0, 0 } }, { 4, { 6, 7, 5, 7, 0, 0 } }, { 4, { 6, 7, 6, 6, 0, 0 } }, { 4, { 6, 7, 7, 5, 0, 0 } },
+  { 4, { 7, 5, 6, 7, 0, 0 } }, { 4, { 7, 5, 7, 6, 0, 0 } }, { 4, { 7, 6, 5, 7, 0, 0 } }, { 4, { 7, 6, 6, 6, 0, 0 } },
+  { 4, { 7, 6, 7, 5, 0, 0 } }, { 4, { 7, 7, 5, 6, 0, 0 } }, { 4, { 7, 7, 6, 5, 0, 0 } }, { 4, { 6, 6, 6, 6, 0, 0 } },
+  { 4, { 6, 6, 7, 5, 0, 0 } }, { 4, { 6, 7, 5, 6, 0, 0 } }, { 4, { 6, 7, 6, 5, 0, 0 } }, { 4, { 7, 5, 6, 6, 0, 0 } },
+  { 4, { 7, 5, 7, 5, 0, 0 } }, { 4, { 7, 6, 5, 6, 0, 0 } }, { 4, { 7, 6, 6, 5, 0, 0 } }, { 4, { 7, 7, 5, 5, 0, 0 } },
+  { 4, { 6, 6, 6, 5, 0, 0 } }, { 4, { 6, 7, 5, 5, 0, 0 } }, { 4, { 7, 5, 6, 5, 0, 0 } }, { 4, { 7, 6, 5, 5, 0, 0 } },
+  { 5, { 7, 7, 5, 4, 5, 0 } }, { 3, { 6, 6, 5, 0, 0, 0 } }, { 4, { 6, 7, 5, 4, 0, 0 } }, { 3, { 7, 5, 5, 0, 0, 0 } },
+  { 4, { 7, 6, 5, 4, 0, 0 } }, { 5, { 7, 7, 5, 4, 4, 0 } }, { 2, { 6, 5, 0, 0, 0, 0 } }, { 3, { 7, 5, 4, 0, 0, 0 } },
+  { 4, { 7, 6, 5, 3, 0, 0 } }, { 5, { 7, 7, 5, 4, 3, 0 } }, { 2, { 6, 4, 0, 0, 0, 0 } }, { 3, { 7, 5, 3, 0, 0, 0 } },
+  { 2, { 5, 3, 0, 0, 0, 0 } }, { 2, { 7, 1, 0, 0, 0, 0 } }, { 5, { 5, 6, 7, 1, 1, 0 } }, { 4, { 5, 7, 0, 1, 0, 0 } },
+  { 3, { 6, 7, 1, 0, 0, 0 } }, { 2, { 7, 0, 0, 0, 0, 0 } }, { 5, { 5, 6, 7, 1, 0, 0 } }, { 5, { 5, 6, 7, 0, 1, 0 } },
+  { 4, { 5, 7, 0, 0, 0, 0 } }, { 4, { 5, 7, 7, 1, 0, 0 } }, { 5, { 6, 5, 7, 0, 1, 0 } }, { 4, { 6, 6, 7, 1, 0, 0 } },
+  { 3, { 6, 7, 0, 0, 0, 0 } }, { 2, { 7, 7, 0, 0, 0, 0 } }, { 5, { 5, 6, 7, 1, 7, 0 } }, { 5, { 5, 6, 7, 0, 0, 0 } },
+  { 4, { 5, 7, 0, 7, 0, 0 } }, { 4, { 5, 7, 7, 0, 0, 0 } }, { 5, { 6, 5, 7, 0, 0, 0 } }, { 4, { 6, 6, 7, 0, 0, 0 } },
+  { 3, { 6, 7, 7, 0, 0, 0 } }, { 4, { 7, 5, 7, 0, 0, 0 } }, { 3, { 7, 6, 7, 0, 0, 0 } }, { 5, { 5, 6, 7, 0, 7, 0 } },
+  { 4, { 5, 7, 7, 7, 0, 0 } }, { 5, { 6, 5, 7, 0, 7, 0 } }, { 4, { 6, 6, 7, 7, 0, 0 } }, { 4, { 6, 7, 6, 7, 0, 0 } },
+  { 4, { 7, 5, 7, 7, 0, 0 } }, { 4, { 7, 6, 6, 7, 0, 0 } }, { 4, { 5, 6, 7, 7, 0, 0 } }, { 4, { 5, 7, 6, 7, 0, 0 } },
+  { 4, { 5, 7, 7, 6, 0, 0 } }, { 4, { 6, 5, 7, 7, 0, 0 } }, { 4, { 6, 6, 6, 7, 0, 0 } }, { 4, { 6, 6, 7, 6, 0, 0 } },
+  { 4, { 6, 7, 5, 7, 0, 0 } }, { 4, { 6, 7, 6, 6, 0, 0 } }, { 4, { 7, 5, 6, 7, 0, 0 } }, { 4, { 7, 5, 7, 6, 0, 0 } },
+  { 4, { 7, 6, 5, 7, 0, 0 } }, { 4, { 7, 6, 6, 6, 0, 0 } }, { 4, { 5, 6, 6, 7, 0, 0 } }, { 4, { 5, 6, 7, 6, 0, 0 } },
+  { 4, { 5, 7, 5, 7, 0, 0 } }, { 4, { 5, 7, 6, 6, 0, 0 } }, { 4, { 5, 7, 7, 5, 0, 0 } }, { 4, { 6, 5, 6, 7, 0, 0 } },
+  { 4, { 6, 5, 7, 6, 0, 0 } }, { 4, { 6, 6, 5, 7, 0, 0 } }, { 4, { 6, 6, 6, 6, 0, 0 } }, { 4, { 6, 6, 7, 5, 0, 0 } },
+  { 4, { 6, 7, 5, 6, 0, 0 } }, { 4, { 6, 7, 6, 5, 0, 0 } }, { 4, { 7, 5, 5, 7, 0, 0 } }, { 4, { 7, 5, 6, 6, 0, 0 } },
+  { 4, { 7, 5, 7, 5, 0, 0 } }, { 4, { 7, 6, 5, 6, 0, 0 } }, { 4, { 7, 6, 6, 5, 0, 0 } }, { 4, { 5, 6, 6, 6, 0, 0 } },
+  { 4, { 5, 6, 7, 5, 0, 0 } }, { 4, { 5, 7, 5, 6, 0, 0 } }, { 4, { 5, 7, 6, 5, 0, 0 } }, { 4, { 6, 5, 6, 6, 0, 0 } },
+  { 4, { 6, 5, 7, 5, 0, 0 } }, { 4, { 6, 6, 5, 6, 0, 0 } }, { 4, { 6, 6, 6, 5, 0, 0 } }, { 4, { 6, 7, 5, 5, 0, 0 } },
+  { 4, { 7, 5, 5, 6, 0, 0 } }, { 4, { 7, 5, 6, 5, 0, 0 } }, { 4, { 7, 6, 5, 5, 0, 0 } }, { 4, { 5, 6, 6, 5, 0, 0 } },
+  { 4, { 5, 7, 5, 5, 0, 0 } }, { 4, { 6, 5, 6, 5, 0, 0 } }, { 4, { 6, 6, 5, 5, 0, 0 } }, { 5, { 6, 7, 5, 4, 5, 0 } },
+  { 4, { 7, 5, 5, 5, 0, 0 } }, { 5, { 7, 6, 5, 4, 5, 0 } }, { 3, { 5, 6, 5, 0, 0, 0 } }, { 4, { 5, 7, 5, 4, 0, 0 } },
+  { 3, { 6, 5, 5, 0, 0, 0 } }, { 4, { 6, 6, 5, 4, 0, 0 } }, { 5, { 6, 7, 5, 4, 4, 0 } }, { 4, { 7, 5, 4, 5, 0, 0 } },
+  { 4, { 7, 5, 5, 4, 0, 0 } }, { 5, { 7, 6, 5, 3, 5, 0 } }, { 5, { 7, 6, 5, 4, 4, 0 } }, { 2, { 5, 5, 0, 0, 0, 0 } },
+  { 3, { 6, 5, 4, 0, 0, 0 } }, { 4, { 6, 6, 5, 3, 0, 0 } }, { 5, { 6, 7, 5, 4, 3, 0 } }, { 4, { 7, 5, 4, 4, 0, 0 } },
+  { 4, { 7, 5, 5, 3, 0, 0 } }, { 5, { 7, 6, 5, 3, 4, 0 } }, { 5, { 7, 6, 5, 4, 3, 0 } }, { 2, { 5, 4, 0, 0, 0, 0 } },
+  { 3, { 6, 5, 3, 0, 0, 0 } }, { 4, { 7, 5, 4, 3, 0, 0 } }, { 5, { 7, 6, 5, 3, 3, 0 } }, { 3, { 5, 4, 3, 0, 0, 0 } },
+  { 6, { 6, 6, 5, 3, 2, 3 } }, { 4, { 6, 5, 3, 3, 0, 0 } }, { 6, { 6, 6, 5, 3, 2, 2 } }, { 4, { 6, 5, 3, 2, 0, 0 } },
+  { 2, { 5, 3, 0, 0, 0, 0 } }, { 3, { 5, 7, 1, 0, 0, 0 } }, { 2, { 6, 0, 0, 0, 0, 0 } }, { 5, { 5, 5, 7, 0, 1, 0 } },
+  { 4, { 5, 6, 7, 1, 0, 0 } }, { 3, { 5, 7, 0, 0, 0, 0 } }, { 2, { 6, 7, 0, 0, 0, 0 } }, { 5, { 5, 5, 7, 0, 0, 0 } },
+  { 4, { 5, 6, 7, 0, 0, 0 } }, { 3, { 5, 7, 7, 0, 0, 0 } }, { 4, { 6, 5, 7, 0, 0, 0 } }, { 3, { 6, 6, 7, 0, 0, 0 } },
+  { 5, { 5, 5, 7, 0, 7, 0 } }, { 4, { 5, 6, 7, 7, 0, 0 } }, { 4, { 5, 7, 6, 7, 0, 0 } }, { 4, { 6, 5, 7, 7, 0, 0 } },
+  { 4, { 6, 6, 6, 7, 0, 0 } }, { 4, { 5, 5, 7, 7, 0, 0 } }, { 4, { 5, 6, 6, 7, 0, 0 } }, { 4, { 5, 6, 7, 6, 0, 0 } },
+  { 4, { 5, 7, 5, 7, 0, 0 } }, { 4, { 5, 7, 6, 6, 0, 0 } }, { 4, { 6, 5, 6, 7, 0, 0 } }, { 4, { 6, 5, 7, 6, 0, 0 } },
+  { 4, { 6, 6, 5, 7, 0, 0 } }, { 4, { 6, 6, 6, 6, 0, 0 } }, { 4, { 5, 5, 6, 7, 0, 0 } }, { 4, { 5, 5, 7, 6, 0, 0 } },
+  { 4, { 5, 6, 5, 7, 0, 0 } }, { 4, { 5, 6, 6, 6, 0, 0 } }, { 4, { 5, 6, 7, 5, 0, 0 } }, { 4, { 5, 7, 5, 6, 0, 0 } },
+  { 4, { 5, 7, 6, 5, 0, 0 } }, { 4, { 6, 5, 5, 7, 0, 0 } }, { 4, { 6, 5, 6, 6, 0, 0 } }, { 4, { 6, 5, 7, 5, 0, 0 } },
+  { 4, { 6, 6, 5, 6, 0, 0 } }, { 4, { 6, 6, 6, 5, 0, 0 } }, { 4, { 5, 5, 6, 6, 0, 0 } }, { 4, { 5, 5, 7, 5, 0, 0 } },
+  { 4, { 5, 6, 5, 6, 0, 0 } }, { 4, { 5, 6, 6, 5, 0, 0 } }, { 4, { 5, 7, 5, 5, 0, 0 } }, { 4, { 6, 5, 5, 6, 0, 0 } },
+  { 4, { 6, 5, 6, 5, 0, 0 } }, { 4, { 6, 6, 5, 5, 0, 0 } }, { 4, { 5, 5, 6, 5, 0, 0 } }, { 4, { 5, 6, 5, 5, 0, 0 } },
+  { 5, { 5, 7, 5, 4, 5, 0 } }, { 4, { 6, 5, 5, 5, 0, 0 } }, { 5, { 6, 6, 5, 4, 5, 0 } }, { 3, { 5, 5, 5, 0, 0, 0 } },
+  { 4, { 5, 6, 5, 4, 0, 0 } }, { 5, { 5, 7, 5, 4, 4, 0 } }, { 4, { 6, 5, 4, 5, 0, 0 } }, { 4, { 6, 5, 5, 4, 0, 0 } },
+  { 5, { 6, 6, 5, 3, 5, 0 } }, { 5, { 6, 6, 5, 4, 4, 0 } }, { 3, { 5, 4, 5, 0, 0, 0 } }, { 3, { 5, 5, 4, 0, 0, 0 } },
+  { 4, { 5, 6, 5, 3, 0, 0 } }, { 5, { 5, 7, 5, 4, 3, 0 } }, { 4, { 6, 5, 3, 5, 0, 0 } }, { 4, { 6, 5, 4, 4, 0, 0 } },
+  { 4, { 6, 5, 5, 3, 0, 0 } }, { 5, { 6, 6, 5, 3, 4, 0 } }, { 5, { 6, 6, 5, 4, 3, 0 } }, { 3, { 5, 4, 4, 0, 0, 0 } },
+  { 3, { 5, 5, 3, 0, 0, 0 } }, { 4, { 6, 5, 3, 4, 0, 0 } }, { 4, { 6, 5, 4, 3, 0, 0 } }, { 5, { 6, 6, 5, 3, 3, 0 } },
+  { 4, { 5, 4, 4, 3, 0, 0 } }, { 6, { 5, 6, 5, 3, 2, 3 } }, { 4, { 5, 5, 3, 3, 0, 0 } }, { 6, { 5, 6, 5, 3, 2, 2 } },
+  { 4, { 5, 5, 3, 2, 0, 0 } }, { 3, { 5, 4, 3, 0, 0, 0 } }, { 2, { 5, 3, 0, 0, 0, 0 } }, { 2, { 5, 7, 0, 0, 0, 0 } },
+  { 6, { 5, 4, 5, 7, 0, 0 } }, { 4, { 5, 5, 7, 0, 0, 0 } }, { 3, { 5, 6, 7, 0, 0, 0 } }, { 6, { 5, 4, 5, 7, 0, 7 } },
+  { 4, { 5, 5, 7, 7, 0, 0 } }, { 4, { 5, 6, 6, 7, 0, 0 } }, { 5, { 5, 4, 5, 7, 7, 0 } }, { 4, { 5, 5, 6, 7, 0, 0 } },
+  { 4, { 5, 5, 7, 6, 0, 0 } }, { 4, { 5, 6, 5, 7, 0, 0 } }, { 4, { 5, 6, 6, 6, 0, 0 } }, { 5, { 5, 4, 5, 6, 7, 0 } },
+  { 5, { 5, 4, 5, 7, 6, 0 } }, { 4, { 5, 5, 5, 7, 0, 0 } }, { 4, { 5, 5, 6, 6, 0, 0 } }, { 4, { 5, 5, 7, 5, 0, 0 } },
+  { 4, { 5, 6, 5, 6, 0, 0 } }, { 4, { 5, 6, 6, 5, 0, 0 } }, { 5, { 5, 4, 5, 6, 6, 0 } }, { 5, { 5, 4, 5, 7, 5, 0 } },
+  { 4, { 5, 5, 5, 6, 0, 0 } }, { 4, { 5, 5, 6, 5, 0, 0 } }, { 4, { 5, 6, 5, 5, 0, 0 } }, { 5, { 5, 4, 5, 6, 5, 0 } },
+  { 4, { 5, 5, 5, 5, 0, 0 } }, { 5, { 5, 6, 5, 4, 5, 0 } }, { 4, { 5, 4, 5, 5, 0, 0 } }, { 4, { 5, 5, 4, 5, 0, 0 } },
+  { 4, { 5, 5, 5, 4, 0, 0 } }, { 5, { 5, 6, 5, 3, 5, 0 } }, { 5, { 5, 6, 5, 4, 4, 0 } }, { 4, { 5, 4, 4, 5, 0, 0 } },
+  { 4, { 5, 4, 5, 4, 0, 0 } }, { 4, { 5, 5, 3, 5, 0, 0 } }, { 4, { 5, 5, 4, 4, 0, 0 } }, { 4, { 5, 5, 5, 3, 0, 0 } },
+  { 5, { 5, 6, 5, 3, 4, 0 } }, { 5, { 5, 6, 5, 4, 3, 0 } }, { 4, { 5, 4, 4, 4, 0, 0 } }, { 4, { 5, 4, 5, 3, 0, 0 } },
+  { 4, { 5, 5, 3, 4, 0, 0 } }, { 4, { 5, 5, 4, 3, 0, 0 } }, { 5, { 5, 6, 5, 3, 3, 0 } }, { 4, { 4, 4, 4, 3, 0, 0 } },
+  { 4, { 5, 3, 4, 3, 0, 0 } }, { 5, { 5, 5, 3, 2, 3, 0 } }, { 4, { 4, 5, 3, 3, 0, 0 } }, { 4, { 5, 4, 3, 3, 0, 0 } },
+  { 5, { 5, 5, 3, 2, 2, 0 } }, { 4, { 4, 5, 3, 2, 0, 0 } }, { 4, { 5, 4, 3, 2, 0, 0 } }, { 3, { 4, 4, 3, 0, 0, 0 } },
+  { 3, { 5, 3, 3, 0, 0, 0 } }, { 5, { 5, 5, 3, 2, 1, 0 } }, { 4, { 5, 4, 3, 1, 0, 0 } }, { 3, { 5, 3, 2, 0, 0, 0 } },
+  { 2, { 4, 3, 0, 0, 0, 0 } }, { 3, { 5, 3, 1, 0, 0, 0 } }, { 2, { 4, 2, 0, 0, 0, 0 } }, { 6, { 4, 4, 5, 7, 0, 0 } },
+  { 4, { 4, 5, 7, 0, 0, 0 } }, { 2, { 5, 7, 0, 0, 0, 0 } }, { 6, { 4, 4, 5, 7, 0, 7 } }, { 4, { 4, 5, 7, 7, 0, 0 } },
+  { 3, { 5, 6, 7, 0, 0, 0 } }, { 5, { 4, 4, 5, 7, 7, 0 } }, { 4, { 4, 5, 6, 7, 0, 0 } }, { 4, { 4, 5, 7, 6, 0, 0 } },
+  { 3, { 5, 5, 7, 0, 0, 0 } }, { 3, { 5, 6, 6, 0, 0, 0 } }, { 5, { 4, 4, 5, 6, 7, 0 } }, { 5, { 4, 4, 5, 7, 6, 0 } },
+  { 4, { 4, 5, 5, 7, 0, 0 } }, { 4, { 4, 5, 6, 6, 0, 0 } }, { 4, { 4, 5, 7, 5, 0, 0 } }, { 5, { 5, 3, 5, 6, 7, 0 } },
+  { 4, { 5, 4, 5, 7, 0, 0 } }, { 3, { 5, 5, 6, 0, 0, 0 } }, { 3, { 5, 6, 5, 0, 0, 0 } }, { 5, { 4, 4, 5, 6, 6, 0 } },
+  { 5, { 4, 4, 5, 7, 5, 0 } }, { 4, { 4, 5, 5, 6, 0, 0 } }, { 4, { 4, 5, 6, 5, 0, 0 } }, { 5, { 5, 3, 5, 6, 6, 0 } },
+  { 4, { 5, 4, 5, 6, 0, 0 } }, { 3, { 5, 5, 5, 0, 0, 0 } }, { 5, { 4, 4, 5, 6, 5, 0 } }, { 4, { 4, 5, 5, 5, 0, 0 } },
+  { 5, { 5, 3, 5, 6, 5, 0 } }, { 4, { 5, 4, 5, 5, 0, 0 } }, { 4, { 5, 5, 4, 5, 0, 0 } }, { 4, { 4, 4, 5, 5, 0, 0 } },
+  { 4, { 4, 5, 4, 5, 0, 0 } }, { 4, { 4, 5, 5, 4, 0, 0 } }, { 4, { 5, 3, 5, 5, 0, 0 } }, { 4, { 5, 4, 4, 5, 0, 0 } },
+  { 4, { 5, 4, 5, 4, 0, 0 } }, { 4, { 5, 5, 3, 5, 0, 0 } }, { 4, { 5, 5, 4, 4, 0, 0 } }, { 4, { 4, 4, 4, 5, 0, 0 } },
+  { 4, { 4, 4, 5, 4, 0, 0 } }, { 4, { 4, 5, 3, 5, 0, 0 } }, { 4, { 4, 5, 4, 4, 0, 0 } }, { 4, { 4, 5, 5, 3, 0, 0 } },
+  { 4, { 5, 3, 4, 5, 0, 0 } }, { 4, { 5, 3, 5, 4, 0, 0 } }, { 4, { 5, 4, 3, 5, 0, 0 } }, { 4, { 5, 4, 4, 4, 0, 0 } },
+  { 4, { 5, 4, 5, 3, 0, 0 } }, { 4, { 5, 5, 3, 4, 0, 0 } }, { 4, { 5, 5, 4, 3, 0, 0 } }, { 4, { 4, 4, 4, 4, 0, 0 } },
+  { 4, { 4, 4, 5, 3, 0, 0 } }, { 4, { 4, 5, 3, 4, 0, 0 } }, { 4, { 4, 5, 4, 3, 0, 0 } }, { 4, { 5, 3, 4, 4, 0, 0 } },
+  { 4, { 5, 3, 5, 3, 0, 0 } }, { 4, { 5, 4, 3, 4, 0, 0 } }, { 4, { 5, 4, 4, 3, 0, 0 } }, { 4, { 5, 5, 3, 3, 0, 0 } },
+  { 4, { 3, 4, 4, 3, 0, 0 } }, { 4, { 4, 3, 4, 3, 0, 0 } }, { 5, { 4, 5, 3, 2, 3, 0 } }, { 5, { 5, 4, 3, 2, 3, 0 } },
+  { 4, { 3, 5, 3, 3, 0, 0 } }, { 4, { 4, 4, 3, 3, 0, 0 } }, { 4, { 5, 3, 3, 3, 0, 0 } }, { 5, { 4, 5, 3, 2, 2, 0 } },
+  { 5, { 5, 4, 3, 2, 2, 0 } }, { 4, { 3, 5, 3, 2, 0, 0 } }, { 4, { 4, 4, 3, 2, 0, 0 } }, { 4, { 5, 3, 3, 2, 0, 0 } },
+  { 3, { 3, 4, 3, 0, 0, 0 } }, { 5, { 5, 4, 3, 1, 3, 0 } }, { 4, { 5, 3, 2, 3, 0, 0 } }, { 3, { 4, 3, 3, 0, 0, 0 } },
+  { 5, { 4, 5, 3, 2, 1, 0 } }, { 5, { 5, 4, 3, 2, 1, 0 } }, { 4, { 4, 4, 3, 1, 0, 0 } }, { 4, { 5, 3, 3, 1, 0, 0 } },
+  { 5, { 5, 4, 3, 1, 2, 0 } }, { 4, { 5, 3, 2, 2, 0, 0 } }, { 3, { 4, 3, 2, 0, 0, 0 } }, { 2, { 3, 3, 0, 0, 0, 0 } },
+  { 5, { 5, 4, 3, 1, 1, 0 } }, { 4, { 5, 3, 2, 1, 0, 0 } }, { 3, { 4, 3, 1, 0, 0, 0 } }, { 2, { 3, 2, 0, 0, 0, 0 } },
+  { 2, { 3, 1, 0, 0, 0, 0 } }, { 2, { 5, 7, 0, 0, 0, 0 } }, { 5, { 3, 4, 5, 7, 7, 0 } }, { 4, { 3, 5, 6, 7, 0, 0 } },
+  { 3, { 4, 5, 7, 0, 0, 0 } }, { 2, { 5, 6, 0, 0, 0, 0 } }, { 5, { 3, 4, 5, 6, 7, 0 } }, { 5, { 3, 4, 5, 7, 6, 0 } },
+  { 4, { 3, 5, 5, 7, 0, 0 } }, { 4, { 3, 5, 6, 6, 0, 0 } }, { 5, { 4, 3, 5, 6, 7, 0 } }, { 4, { 4, 4, 5, 7, 0, 0 } },
+  { 3, { 4, 5, 6, 0, 0, 0 } }, { 2, { 5, 5, 0, 0, 0, 0 } }, { 5, { 3, 4, 5, 6, 6, 0 } }, { 5, { 3, 4, 5, 7, 5, 0 } },
+  { 4, { 3, 5, 5, 6, 0, 0 } }, { 4, { 3, 5, 6, 5, 0, 0 } }, { 5, { 4, 3, 5, 6, 6, 0 } }, { 4, { 4, 4, 5, 6, 0, 0 } },
+  { 3, { 4, 5, 5, 0, 0, 0 } }, { 4, { 5, 3, 5, 6, 0, 0 } }, { 3, { 5, 4, 5, 0, 0, 0 } }, { 5, { 3, 4, 5, 6, 5, 0 } },
+  { 4, { 3, 5, 5, 5, 0, 0 } }, { 5, { 4, 3, 5, 6, 5, 0 } }, { 4, { 4, 4, 5, 5, 0, 0 } }, { 4, { 4, 5, 4, 5, 0, 0 } },
+  { 4, { 5, 3, 5, 5, 0, 0 } }, { 4, { 5, 4, 4, 5, 0, 0 } }, { 4, { 3, 4, 5, 5, 0, 0 } }, { 4, { 3, 5, 4, 5, 0, 0 } },
+  { 4, { 3, 5, 5, 4, 0, 0 } }, { 4, { 4, 3, 5, 5, 0, 0 } }, { 4, { 4, 4, 4, 5, 0, 0 } }, { 4, { 4, 4, 5, 4, 0, 0 } },
+  { 4, { 4, 5, 3, 5, 0, 0 } }, { 4, { 4, 5, 4, 4, 0, 0 } }, { 4, { 5, 3, 4, 5, 0, 0 } }, { 4, { 5, 3, 5, 4, 0, 0 } },
+  { 4, { 5, 4, 3, 5, 0, 0 } }, { 4, { 5, 4, 4, 4, 0, 0 } }, { 4, { 3, 4, 4, 5, 0, 0 } }, { 4, { 3, 4, 5, 4, 0, 0 } },
+  { 4, { 3, 5, 3, 5, 0, 0 } }, { 4, { 3, 5, 4, 4, 0, 0 } }, { 4, { 3, 5, 5, 3, 0, 0 } }, { 4, { 4, 3, 4, 5, 0, 0 } },
+  { 4, { 4, 3, 5, 4, 0, 0 } }, { 4, { 4, 4, 3, 5, 0, 0 } }, { 4, { 4, 4, 4, 4, 0, 0 } }, { 4, { 4, 4, 5, 3, 0, 0 } },
+  { 4, { 4, 5, 3, 4, 0, 0 } }, { 4, { 4, 5, 4, 3, 0, 0 } }, { 4, { 5, 3, 3, 5, 0, 0 } }, { 4, { 5, 3, 4, 4, 0, 0 } },
+  { 4, { 5, 3, 5, 3, 0, 0 } }, { 4, { 5, 4, 3, 4, 0, 0 } }, { 4, { 5, 4, 4, 3, 0, 0 } }, { 4, { 3, 4, 4, 4, 0, 0 } },
+  { 4, { 3, 4, 5, 3, 0, 0 } }, { 4, { 3, 5, 3, 4, 0, 0 } }, { 4, { 3, 5, 4, 3, 0, 0 } }, { 4, { 4, 3, 4, 4, 0, 0 } },
+  { 4, { 4, 3, 5, 3, 0, 0 } }, { 4, { 4, 4, 3, 4, 0, 0 } }, { 4, { 4, 4, 4, 3, 0, 0 } }, { 4, { 4, 5, 3, 3, 0, 0 } },
+  { 4, { 5, 3, 3, 4, 0, 0 } }, { 4, { 5, 3, 4, 3, 0, 0 } }, { 4, { 5, 4, 3, 3, 0, 0 } }, { 4, { 3, 3, 4, 3, 0, 0 } },
+  { 5, { 3, 5, 3, 2, 3, 0 } }, { 5, { 4, 4, 3, 2, 3, 0 } }, { 4, { 3, 4, 3, 3, 0, 0 } }, { 4, { 4, 3, 3, 3, 0, 0 } },
+  { 5, { 3, 5, 3, 2, 2, 0 } }, { 5, { 4, 4, 3, 2, 2, 0 } }, { 4, { 3, 4, 3, 2, 0, 0 } }, { 4, { 4, 3, 3, 2, 0, 0 } },
+  { 5, { 4, 4, 3, 1, 3, 0 } }, { 4, { 4, 3, 2, 3, 0, 0 } }, { 3, { 3, 3, 3, 0, 0, 0 } }, { 5, { 3, 5, 3, 2, 1, 0 } },
+  { 5, { 4, 4, 3, 2, 1, 0 } }, { 4, { 3, 4, 3, 1, 0, 0 } }, { 4, { 4, 3, 3, 1, 0, 0 } }, { 5, { 4, 4, 3, 1, 2, 0 } },
+  { 4, { 4, 3, 2, 2, 0, 0 } }, { 3, { 3, 3, 2, 0, 0, 0 } }, { 4, { 4, 3, 1, 3, 0, 0 } }, { 3, { 3, 2, 3, 0, 0, 0 } },
+  { 5, { 4, 4, 3, 1, 1, 0 } }, { 4, { 4, 3, 2, 1, 0, 0 } }, { 3, { 3, 3, 1, 0, 0, 0 } }, { 4, { 4, 3, 1, 2, 0, 0 } },
+  { 3, { 3, 2, 2, 0, 0, 0 } }, { 6, { 4, 4, 3, 1, 0, 1 } }, { 4, { 4, 3, 1, 1, 0, 0 } }, { 3, { 3, 2, 1, 0, 0, 0 } },
+  { 6, { 4, 4, 3, 1, 0, 0 } }, { 4, { 4, 3, 1, 0, 0, 0 } }, { 2, { 3, 1, 0, 0, 0, 0 } }, { 3, { 3, 5, 7, 0, 0, 0 } },
+  { 2, { 4, 6, 0, 0, 0, 0 } }, { 5, { 3, 3, 5, 6, 7, 0 } }, { 4, { 3, 4, 5, 7, 0, 0 } }, { 3, { 3, 5, 6, 0, 0, 0 } },
+  { 2, { 4, 5, 0, 0, 0, 0 } }, { 5, { 3, 3, 5, 6, 6, 0 } }, { 4, { 3, 4, 5, 6, 0, 0 } }, { 3, { 3, 5, 5, 0, 0, 0 } },
+  { 4, { 4, 3, 5, 6, 0, 0 } }, { 3, { 4, 4, 5, 0, 0, 0 } }, { 5, { 3, 3, 5, 6, 5, 0 } }, { 4, { 3, 4, 5, 5, 0, 0 } },
+  { 4, { 3, 5, 4, 5, 0, 0 } }, { 4, { 4, 3, 5, 5, 0, 0 } }, { 4, { 4, 4, 4, 5, 0, 0 } }, { 4, { 3, 3, 5, 5, 0, 0 } },
+  { 4, { 3, 4, 4, 5, 0, 0 } }, { 4, { 3, 4, 5, 4, 0, 0 } }, { 4, { 3, 5, 3, 5, 0, 0 } }, { 4, { 3, 5, 4, 4, 0, 0 } },
+  { 4, { 4, 3, 4, 5, 0, 0 } }, { 4, { 4, 3, 5, 4, 0, 0 } }, { 4, { 4, 4, 3, 5, 0, 0 } }, { 4, { 4, 4, 4, 4, 0, 0 } },
+  { 4, { 3, 3, 4, 5, 0, 0 } }, { 4, { 3, 3, 5, 4, 0, 0 } }, { 4, { 3, 4, 3, 5, 0, 0 } }, { 4, { 3, 4, 4, 4, 0, 0 } },
+  { 4, { 3, 4, 5, 3, 0, 0 } }, { 4, { 3, 5, 3, 4, 0, 0 } }, { 4, { 3, 5, 4, 3, 0, 0 } }, { 4, { 4, 3, 3, 5, 0, 0 } },
+  { 4, { 4, 3, 4, 4, 0, 0 } }, { 4, { 4, 3, 5, 3, 0, 0 } }, { 4, { 4, 4, 3, 4, 0, 0 } }, { 4, { 4, 4, 4, 3, 0, 0 } },
+  { 4, { 3, 3, 4, 4, 0, 0 } }, { 4, { 3, 3, 5, 3, 0, 0 } }, { 4, { 3, 4, 3, 4, 0, 0 } }, { 4, { 3, 4, 4, 3, 0, 0 } },
+  { 4, { 3, 5, 3, 3, 0, 0 } }, { 4, { 4, 3, 3, 4, 0, 0 } }, { 4, { 4, 3, 4, 3, 0, 0 } }, { 4, { 4, 4, 3, 3, 0, 0 } },
+  { 5, { 3, 2, 3, 4, 3, 0 } }, { 5, { 3, 4, 3, 2, 3, 0 } }, { 4, { 3, 3, 3, 3, 0, 0 } }, { 5, { 3, 4, 3, 2, 2, 0 } },
+  { 4, { 3, 3, 3, 2, 0, 0 } }, { 5, { 3, 4, 3, 1, 3, 0 } }, { 4, { 3, 3, 2, 3, 0, 0 } }, { 4, { 3, 2, 3, 3, 0, 0 } },
+  { 5, { 3, 4, 3, 2, 1, 0 } }, { 4, { 3, 3, 3, 1, 0, 0 } }, { 5, { 3, 4, 3, 1, 2, 0 } }, { 4, { 3, 3, 2, 2, 0, 0 } },
+  { 4, { 3, 2, 3, 2, 0, 0 } }, { 4, { 3, 3, 1, 3, 0, 0 } }, { 4, { 3, 2, 2, 3, 0, 0 } }, { 5, { 3, 4, 3, 1, 1, 0 } },
+  { 4, { 3, 3, 2, 1, 0, 0 } }, { 4, { 3, 2, 3, 1, 0, 0 } }, { 4, { 3, 3, 1, 2, 0, 0 } }, { 4, { 3, 2, 2, 2, 0, 0 } },
+  { 6, { 3, 4, 3, 1, 0, 1 } }, { 4, { 3, 3, 1, 1, 0, 0 } }, { 4, { 3, 2, 2, 1, 0, 0 } }, { 6, { 3, 4, 3, 1, 0, 0 } },
+  { 4, { 3, 3, 1, 0, 0, 0 } }, { 3, { 3, 2, 1, 0, 0, 0 } }, { 2, { 3, 1, 0, 0, 0, 0 } }, { 2, { 3, 5, 0, 0, 0, 0 } },
+  { 4, { 3, 3, 5, 6, 0, 0 } }, { 6, { 3, 2, 3, 5, 6, 6 } }, { 3, { 3, 4, 5, 0, 0, 0 } }, { 4, { 3, 3, 5, 5, 0, 0 } },
+  { 6, { 3, 2, 3, 5, 6, 5 } }, { 4, { 3, 4, 4, 5, 0, 0 } }, { 4, { 3, 3, 4, 5, 0, 0 } }, { 4, { 3, 3, 5, 4, 0, 0 } },
+  { 5, { 3, 2, 3, 5, 5, 0 } }, { 4, { 3, 4, 3, 5, 0, 0 } }, { 4, { 3, 4, 4, 4, 0, 0 } }, { 4, { 3, 3, 3, 5, 0, 0 } },
+  { 4, { 3, 3, 4, 4, 0, 0 } }, { 4, { 3, 3, 5, 3, 0, 0 } }, { 5, { 3, 2, 3, 4, 5, 0 } }, { 5, { 3, 2, 3, 5, 4, 0 } },
+  { 4, { 3, 4, 3, 4, 0, 0 } }, { 4, { 3, 4, 4, 3, 0, 0 } }, { 4, { 3, 3, 3, 4, 0, 0 } }, { 4, { 3, 3, 4, 3, 0, 0 } },
+  { 5, { 3, 2, 3, 4, 4, 0 } }, { 5, { 3, 2, 3, 5, 3, 0 } }, { 4, { 3, 4, 3, 3, 0, 0 } }, { 5, { 3, 1, 3, 4, 3, 0 } },
+  { 5, { 2, 2, 3, 4, 3, 0 } }, { 4, { 3, 3, 2, 3, 0, 0 } }, { 4, { 3, 2, 3, 3, 0, 0 } }, { 4, { 2, 3, 3, 3, 0, 0 } },
+  { 4, { 3, 3, 2, 2, 0, 0 } }, { 4, { 3, 2, 3, 2, 0, 0 } }, { 4, { 2, 3, 3, 2, 0, 0 } }, { 4, { 3, 3, 1, 3, 0, 0 } },
+  { 4, { 3, 2, 2, 3, 0, 0 } }, { 4, { 2, 3, 2, 3, 0, 0 } }, { 4, { 3, 1, 3, 3, 0, 0 } }, { 4, { 2, 2, 3, 3, 0, 0 } },
+  { 4, { 3, 3, 2, 1, 0, 0 } }, { 4, { 3, 2, 3, 1, 0, 0 } }, { 4, { 2, 3, 3, 1, 0, 0 } }, { 4, { 3, 3, 1, 2, 0, 0 } },
+  { 4, { 3, 2, 2, 2, 0, 0 } }, { 4, { 2, 3, 2, 2, 0, 0 } }, { 4, { 3, 1, 3, 2, 0, 0 } }, { 4, { 2, 2, 3, 2, 0, 0 } },
+  { 4, { 3, 2, 1, 3, 0, 0 } }, { 4, { 2, 3, 1, 3, 0, 0 } }, { 4, { 3, 1, 2, 3, 0, 0 } }, { 4, { 2, 2, 2, 3, 0, 0 } },
+  { 4, { 3, 3, 1, 1, 0, 0 } }, { 4, { 3, 2, 2, 1, 0, 0 } }, { 4, { 2, 3, 2, 1, 0, 0 } }, { 4, { 3, 1, 3, 1, 0, 0 } },
+  { 4, { 2, 2, 3, 1, 0, 0 } }, { 4, { 3, 2, 1, 2, 0, 0 } }, { 4, { 2, 3, 1, 2, 0, 0 } }, { 4, { 3, 1, 2, 2, 0, 0 } },
+  { 4, { 2, 2, 2, 2, 0, 0 } }, { 5, { 3, 3, 1, 0, 1, 0 } }, { 4, { 3, 2, 1, 1, 0, 0 } }, { 4, { 2, 3, 1, 1, 0, 0 } },
+  { 4, { 3, 1, 2, 1, 0, 0 } }, { 4, { 2, 2, 2, 1, 0, 0 } }, { 5, { 3, 3, 1, 0, 0, 0 } }, { 4, { 3, 2, 1, 0, 0, 0 } },
+  { 4, { 2, 3, 1, 0, 0, 0 } }, { 3, { 3, 1, 1, 0, 0, 0 } }, { 3, { 2, 2, 1, 0, 0, 0 } }, { 5, { 3, 3, 1, 0, 7, 0 } },
+  { 4, { 3, 2, 1, 7, 0, 0 } }, { 3, { 3, 1, 0, 0, 0, 0 } }, { 2, { 2, 1, 0, 0, 0, 0 } }, { 3, { 3, 1, 7, 0, 0, 0 } },
+  { 2, { 2, 0, 0, 0, 0, 0 } }, { 2, { 3, 5, 0, 0, 0, 0 } }, { 4, { 2, 3, 5, 6, 0, 0 } }, { 6, { 2, 2, 3, 5, 6, 6 } },
+  { 3, { 3, 4, 5, 0, 0, 0 } }, { 4, { 2, 3, 5, 5, 0, 0 } }, { 6, { 2, 2, 3, 5, 6, 5 } }, { 3, { 3, 3, 5, 0, 0, 0 } },
+  { 3, { 3, 4, 4, 0, 0, 0 } }, { 4, { 2, 3, 4, 5, 0, 0 } }, { 4, { 2, 3, 5, 4, 0, 0 } }, { 5, { 2, 2, 3, 5, 5, 0 } },
+  { 3, { 3, 3, 4, 0, 0, 0 } }, { 4, { 3, 2, 3, 5, 0, 0 } }, { 5, { 3, 1, 3, 4, 5, 0 } }, { 3, { 3, 4, 3, 0, 0, 0 } },
+  { 4, { 2, 3, 3, 5, 0, 0 } }, { 4, { 2, 3, 4, 4, 0, 0 } }, { 4, { 2, 3, 5, 3, 0, 0 } }, { 5, { 2, 2, 3, 4, 5, 0 } },
+  { 5, { 2, 2, 3, 5, 4, 0 } }, { 3, { 3, 3, 3, 0, 0, 0 } }, { 4, { 3, 2, 3, 4, 0, 0 } }, { 5, { 3, 1, 3, 4, 4, 0 } },
+  { 4, { 2, 3, 3, 4, 0, 0 } }, { 4, { 2, 3, 4, 3, 0, 0 } }, { 5, { 2, 2, 3, 4, 4, 0 } }, { 5, { 2, 2, 3, 5, 3, 0 } },
+  { 5, { 2, 1, 3, 4, 3, 0 } }, { 5, { 1, 2, 3, 4, 3, 0 } }, { 4, { 3, 2, 2, 3, 0, 0 } }, { 4, { 2, 3, 2, 3, 0, 0 } },
+  { 4, { 3, 1, 3, 3, 0, 0 } }, { 4, { 2, 2, 3, 3, 0, 0 } }, { 4, { 1, 3, 3, 3, 0, 0 } }, { 4, { 3, 2, 2, 2, 0, 0 } },
+  { 4, { 2, 3, 2, 2, 0, 0 } }, { 4, { 3, 1, 3, 2, 0, 0 } }, { 4, { 2, 2, 3, 2, 0, 0 } }, { 4, { 1, 3, 3, 2, 0, 0 } },
+  { 4, { 3, 2, 1, 3, 0, 0 } }, { 4, { 2, 3, 1, 3, 0, 0 } }, { 4, { 3, 1, 2, 3, 0, 0 } }, { 4, { 2, 2, 2, 3, 0, 0 } },
+  { 4, { 1, 3, 2, 3, 0, 0 } }, { 4, { 2, 1, 3, 3, 0, 0 } }, { 4, { 1, 2, 3, 3, 0, 0 } }, { 4, { 3, 2, 2, 1, 0, 0 } },
+  { 4, { 2, 3, 2, 1, 0, 0 } }, { 4, { 3, 1, 3, 1, 0, 0 } }, { 4, { 2, 2, 3, 1, 0, 0 } }, { 4, { 1, 3, 3, 1, 0, 0 } },
+  { 4, { 3, 2, 1, 2, 0, 0 } }, { 4, { 2, 3, 1, 2, 0, 0 } }, { 4, { 3, 1, 2, 2, 0, 0 } }, { 4, { 2, 2, 2, 2, 0, 0 } },
+  { 4, { 1, 3, 2, 2, 0, 0 } }, { 4, { 2, 1, 3, 2, 0, 0 } }, { 4, { 1, 2, 3, 2, 0, 0 } }, { 4, { 3, 1, 1, 3, 0, 0 } },
+  { 4, { 2, 2, 1, 3, 0, 0 } }, { 4, { 1, 3, 1, 3, 0, 0 } }, { 4, { 2, 1, 2, 3, 0, 0 } }, { 4, { 1, 2, 2, 3, 0, 0 } },
+  { 4, { 3, 2, 1, 1, 0, 0 } }, { 4, { 2, 3, 1, 1, 0, 0 } }, { 4, { 3, 1, 2, 1, 0, 0 } }, { 4, { 2, 2, 2, 1, 0, 0 } },
+  { 4, { 1, 3, 2, 1, 0, 0 } }, { 4, { 2, 1, 3, 1, 0, 0 } }, { 4, { 1, 2, 3, 1, 0, 0 } }, { 4, { 3, 1, 1, 2, 0, 0 } },
+  { 4, { 2, 2, 1, 2, 0, 0 } }, { 4, { 1, 3, 1, 2, 0, 0 } }, { 4, { 2, 1, 2, 2, 0, 0 } }, { 4, { 1, 2, 2, 2, 0, 0 } },
+  { 5, { 3, 2, 1, 0, 1, 0 } }, { 5, { 2, 3, 1, 0, 1, 0 } }, { 4, { 3, 1, 1, 1, 0, 0 } }, { 4, { 2, 2, 1, 1, 0, 0 } },
+  { 4, { 1, 3, 1, 1, 0, 0 } }, { 4, { 2, 1, 2, 1, 0, 0 } }, { 4, { 1, 2, 2, 1, 0, 0 } }, { 5, { 3, 2, 1, 0, 0, 0 } },
+  { 5, { 2, 3, 1, 0, 0, 0 } }, { 4, { 3, 1, 1, 0, 0, 0 } }, { 4, { 2, 2, 1, 0, 0, 0 } }, { 4, { 1, 3, 1, 0, 0, 0 } },
+  { 5, { 3, 2, 1, 7, 1, 0 } }, { 4, { 3, 1, 0, 1, 0, 0 } }, { 3, { 2, 1, 1, 0, 0, 0 } }, { 3, { 1, 2, 1, 0, 0, 0 } },
+  { 5, { 3, 2, 1, 0, 7, 0 } }, { 5, { 2, 3, 1, 0, 7, 0 } }, { 4, { 3, 1, 1, 7, 0, 0 } }, { 4, { 2, 2, 1, 7, 0, 0 } },
+  { 5, { 3, 2, 1, 7, 0, 0 } }, { 4, { 3, 1, 0, 0, 0, 0 } }, { 3, { 2, 1, 0, 0, 0, 0 } }, { 2, { 1, 1, 0, 0, 0, 0 } },
+  { 5, { 3, 2, 1, 7, 7, 0 } }, { 4, { 3, 1, 0, 7, 0, 0 } }, { 3, { 2, 1, 7, 0, 0, 0 } }, { 2, { 1, 0, 0, 0, 0, 0 } },
+  { 2, { 1, 7, 0, 0, 0, 0 } }, { 2, { 3, 5, 0, 0, 0, 0 } }, { 2, { 3, 4, 0, 0, 0, 0 } }, { 3, { 2, 3, 5, 0, 0, 0 } },
+  { 4, { 1, 3, 4, 5, 0, 0 } }, { 5, { 1, 2, 3, 5, 5, 0 } }, { 2, { 3, 3, 0, 0, 0, 0 } }, { 3, { 2, 3, 4, 0, 0, 0 } },
+  { 4, { 2, 2, 3, 5, 0, 0 } }, { 5, { 2, 1, 3, 4, 5, 0 } }, { 4, { 1, 3, 3, 5, 0, 0 } }, { 4, { 1, 3, 4, 4, 0, 0 } },
+  { 5, { 1, 2, 3, 4, 5, 0 } }, { 5, { 1, 2, 3, 5, 4, 0 } }, { 3, { 3, 2, 3, 0, 0, 0 } }, { 4, { 3, 1, 3, 4, 0, 0 } },
+  { 3, { 2, 3, 3, 0, 0, 0 } }, { 4, { 2, 2, 3, 4, 0, 0 } }, { 5, { 2, 1, 3, 4, 4, 0 } }, { 4, { 1, 3, 3, 4, 0, 0 } },
+  { 4, { 1, 3, 4, 3, 0, 0 } }, { 5, { 1, 2, 3, 4, 4, 0 } }, { 5, { 1, 2, 3, 5, 3, 0 } }, { 5, { 1, 1, 3, 4, 3, 0 } },
+  { 4, { 2, 2, 2, 3, 0, 0 } }, { 4, { 1, 3, 2, 3, 0, 0 } }, { 4, { 2, 1, 3, 3, 0, 0 } }, { 4, { 1, 2, 3, 3, 0, 0 } },
+  { 4, { 2, 2, 2, 2, 0, 0 } }, { 4, { 1, 3, 2, 2, 0, 0 } }, { 4, { 2, 1, 3, 2, 0, 0 } }, { 4, { 1, 2, 3, 2, 0, 0 } },
+  { 4, { 2, 2, 1, 3, 0, 0 } }, { 4, { 1, 3, 1, 3, 0, 0 } }, { 4, { 2, 1, 2, 3, 0, 0 } }, { 4, { 1, 2, 2, 3, 0, 0 } },
+  { 4, { 1, 1, 3, 3, 0, 0 } }, { 4, { 2, 2, 2, 1, 0, 0 } }, { 4, { 1, 3, 2, 1, 0, 0 } }, { 4, { 2, 1, 3, 1, 0, 0 } },
+  { 4, { 1, 2, 3, 1, 0, 0 } }, { 4, { 2, 2, 1, 2, 0, 0 } }, { 4, { 1, 3, 1, 2, 0, 0 } }, { 4, { 2, 1, 2, 2, 0, 0 } },
+  { 4, { 1, 2, 2, 2, 0, 0 } }, { 4, { 1, 1, 3, 2, 0, 0 } }, { 4, { 2, 1, 1, 3, 0, 0 } }, { 4, { 1, 2, 1, 3, 0, 0 } },
+  { 4, { 1, 1, 2, 3, 0, 0 } }, { 4, { 2, 2, 1, 1, 0, 0 } }, { 4, { 1, 3, 1, 1, 0, 0 } }, { 4, { 2, 1, 2, 1, 0, 0 } },
+  { 4, { 1, 2, 2, 1, 0, 0 } }, { 4, { 1, 1, 3, 1, 0, 0 } }, { 4, { 2, 1, 1, 2, 0, 0 } }, { 4, { 1, 2, 1, 2, 0, 0 } },
+  { 4, { 1, 1, 2, 2, 0, 0 } }, { 5, { 2, 2, 1, 0, 1, 0 } }, { 5, { 1, 3, 1, 0, 1, 0 } }, { 4, { 2, 1, 1, 1, 0, 0 } },
+  { 4, { 1, 2, 1, 1, 0, 0 } }, { 4, { 1, 1, 2, 1, 0, 0 } }, { 5, { 2, 2, 1, 0, 0, 0 } }, { 5, { 1, 3, 1, 0, 0, 0 } },
+  { 4, { 2, 1, 1, 0, 0, 0 } }, { 4, { 1, 2, 1, 0, 0, 0 } }, { 5, { 2, 2, 1, 7, 1, 0 } }, { 4, { 2, 1, 0, 1, 0, 0 } },
+  { 3, { 1, 1, 1, 0, 0, 0 } }, { 5, { 2, 2, 1, 0, 7, 0 } }, { 5, { 1, 3, 1, 0, 7, 0 } }, { 4, { 2, 1, 1, 7, 0, 0 } },
+  { 4, { 1, 2, 1, 7, 0, 0 } }, { 5, { 2, 2, 1, 7, 0, 0 } }, { 4, { 2, 1, 0, 0, 0, 0 } }, { 3, { 1, 1, 0, 0, 0, 0 } },
+  { 4, { 2, 1, 7, 1, 0, 0 } }, { 3, { 1, 0, 1, 0, 0, 0 } }, { 5, { 2, 2, 1, 7, 7, 0 } }, { 4, { 2, 1, 0, 7, 0, 0 } },
+  { 3, { 1, 1, 7, 0, 0, 0 } }, { 4, { 2, 1, 7, 0, 0, 0 } }, { 3, { 1, 0, 0, 0, 0, 0 } }, { 4, { 2, 1, 7, 7, 0, 0 } },
+  { 6, { 2, 2, 1, 7, 6, 7 } }, { 3, { 1, 0, 7, 0, 0, 0 } }, { 2, { 1, 7, 0, 0, 0, 0 } }, { 4, { 2, 1, 7, 6, 0, 0 } },
+  { 6, { 2, 2, 1, 7, 6, 6 } }, { 2, { 2, 4, 0, 0, 0, 0 } }, { 3, { 1, 3, 5, 0, 0, 0 } }, { 2, { 2, 3, 0, 0, 0, 0 } },
+  { 3, { 1, 3, 4, 0, 0, 0 } }, { 4, { 1, 2, 3, 5, 0, 0 } }, { 5, { 1, 1, 3, 4, 5, 0 } }, { 3, { 2, 2, 3, 0, 0, 0 } },
+  { 4, { 2, 1, 3, 4, 0, 0 } }, { 3, { 1, 3, 3, 0, 0, 0 } }, { 4, { 1, 2, 3, 4, 0, 0 } }, { 5, { 1, 1, 3, 4, 4, 0 } },
+  { 6, { 1, 0, 1, 3, 4, 3 } }, { 4, { 1, 2, 2, 3, 0, 0 } }, { 4, { 1, 1, 3, 3, 0, 0 } }, { 4, { 1, 2, 2, 2, 0, 0 } },
+  { 4, { 1, 1, 3, 2, 0, 0 } }, { 4, { 1, 2, 1, 3, 0, 0 } }, { 4, { 1, 1, 2, 3, 0, 0 } }, { 5, { 1, 0, 1, 3, 3, 0 } },
+  { 4, { 1, 2, 2, 1, 0, 0 } }, { 4, { 1, 1, 3, 1, 0, 0 } }, { 4, { 1, 2, 1, 2, 0, 0 } }, { 4, { 1, 1, 2, 2, 0, 0 } },
+  { 5, { 1, 0, 1, 3, 2, 0 } }, { 4, { 1, 1, 1, 3, 0, 0 } }, { 5, { 1, 0, 1, 2, 3, 0 } }, { 4, { 1, 2, 1, 1, 0, 0 } },
+  { 4, { 1, 1, 2, 1, 0, 0 } }, { 5, { 1, 0, 1, 3, 1, 0 } }, { 4, { 1, 1, 1, 2, 0, 0 } }, { 5, { 1, 0, 1, 2, 2, 0 } },
+  { 5, { 1, 2, 1, 0, 1, 0 } }, { 4, { 1, 1, 1, 1, 0, 0 } }, { 5, { 1, 0, 1, 2, 1, 0 } }, { 5, { 1, 2, 1, 0, 0, 0 } },
+  { 4, { 1, 1, 1, 0, 0, 0 } }, { 5, { 1, 2, 1, 7, 1, 0 } }, { 4, { 1, 1, 0, 1, 0, 0 } }, { 4, { 1, 0, 1, 1, 0, 0 } },
+  { 5, { 1, 2, 1, 0, 7, 0 } }, { 4, { 1, 1, 1, 7, 0, 0 } }, { 5, { 1, 2, 1, 7, 0, 0 } }, { 4, { 1, 1, 0, 0, 0, 0 } },
+  { 4, { 1, 0, 1, 0, 0, 0 } }, { 4, { 1, 1, 7, 1, 0, 0 } }, { 4, { 1, 0, 0, 1, 0, 0 } }, { 5, { 1, 2, 1, 7, 7, 0 } },
+  { 4, { 1, 1, 0, 7, 0, 0 } }, { 4, { 1, 0, 1, 7, 0, 0 } }, { 4, { 1, 1, 7, 0, 0, 0 } }, { 4, { 1, 0, 0, 0, 0, 0 } },
+  { 4, { 1, 1, 7, 7, 0, 0 } }, { 6, { 1, 2, 1, 7, 6, 7 } }, { 4, { 1, 0, 0, 7, 0, 0 } }, { 3, { 1, 0, 7, 0, 0, 0 } },
+  { 4, { 1, 1, 7, 6, 0, 0 } }, { 6, { 1, 2, 1, 7, 6, 6 } }, { 2, { 1, 7, 0, 0, 0, 0 } }, { 2, { 1, 3, 0, 0, 0, 0 } },
+  { 3, { 1, 2, 3, 0, 0, 0 } }, { 4, { 1, 1, 3, 4, 0, 0 } }, { 6, { 1, 0, 1, 3, 4, 4 } }, { 6, { 0, 0, 1, 3, 4, 3 } },
+  { 3, { 1, 2, 3, 0, 0, 0 } }, { 4, { 0, 1, 3, 3, 0, 0 } }, { 3, { 1, 2, 2, 0, 0, 0 } }, { 4, { 0, 1, 3, 2, 0, 0 } },
+  { 3, { 1, 1, 3, 0, 0, 0 } }, { 4, { 0, 1, 2, 3, 0, 0 } }, { 5, { 0, 0, 1, 3, 3, 0 } }, { 3, { 1, 2, 1, 0, 0, 0 } },
+  { 4, { 0, 1, 3, 1, 0, 0 } }, { 3, { 1, 1, 2, 0, 0, 0 } }, { 4, { 0, 1, 2, 2, 0, 0 } }, { 5, { 0, 0, 1, 3, 2, 0 } },
+  { 4, { 1, 0, 1, 3, 0, 0 } }, { 4, { 0, 1, 1, 3, 0, 0 } }, { 5, { 1, 7, 1, 2, 3, 0 } }, { 5, { 0, 0, 1, 2, 3, 0 } },
+  { 3, { 1, 1, 1, 0, 0, 0 } }, { 4, { 0, 1, 2, 1, 0, 0 } }, { 5, { 0, 0, 1, 3, 1, 0 } }, { 4, { 1, 0, 1, 2, 0, 0 } },
+  { 4, { 0, 1, 1, 2, 0, 0 } }, { 5, { 1, 7, 1, 2, 2, 0 } }, { 5, { 0, 0, 1, 2, 2, 0 } }, { 4, { 1, 1, 0, 1, 0, 0 } },
+  { 4, { 1, 0, 1, 1, 0, 0 } }, { 4, { 0, 1, 1, 1, 0, 0 } }, { 5, { 1, 7, 1, 2, 1, 0 } }, { 5, { 0, 0, 1, 2, 1, 0 } },
+  { 4, { 1, 1, 0, 0, 0, 0 } }, { 4, { 1, 0, 1, 0, 0, 0 } }, { 4, { 0, 1, 1, 0, 0, 0 } }, { 4, { 1, 1, 7, 1, 0, 0 } },
+  { 4, { 1, 0, 0, 1, 0, 0 } }, { 4, { 0, 1, 0, 1, 0, 0 } }, { 4, { 1, 7, 1, 1, 0, 0 } }, { 4, { 0, 0, 1, 1, 0, 0 } },
+  { 4, { 1, 1, 0, 7, 0, 0 } }, { 4, { 1, 0, 1, 7, 0, 0 } }, { 4, { 0, 1, 1, 7, 0, 0 } }, { 4, { 1, 1, 7, 0, 0, 0 } },
+  { 4, { 1, 0, 0, 0, 0, 0 } }, { 4, { 0, 1, 0, 0, 0, 0 } }, { 4, { 1, 7, 1, 0, 0, 0 } }, { 4, { 0, 0, 1, 0, 0, 0 } },
+  { 4, { 1, 0, 7, 1, 0, 0 } }, { 4, { 0, 1, 7, 1, 0, 0 } }, { 4, { 1, 7, 0, 1, 0, 0 } }, { 4, { 0, 0, 0, 1, 0, 0 } },
+  { 4, { 1, 1, 7, 7, 0, 0 } }, { 4, { 1, 0, 0, 7, 0, 0 } }, { 4, { 0, 1, 0, 7, 0, 0 } }, { 4, { 1, 7, 1, 7, 0, 0 } },
+  { 4, { 0, 0, 1, 7, 0, 0 } }, { 4, { 1, 0, 7, 0, 0, 0 } }, { 4, { 0, 1, 7, 0, 0, 0 } }, { 4, { 1, 7, 0, 0, 0, 0 } },
+  { 4, { 0, 0, 0, 0, 0, 0 } }, { 4, { 1, 0, 7, 7, 0, 0 } }, { 4, { 0, 1, 7, 7, 0, 0 } }, { 5, { 1, 1, 7, 6, 7, 0 } },
+  { 4, { 1, 7, 0, 7, 0, 0 } }, { 4, { 0, 0, 0, 7, 0, 0 } }, { 3, { 1, 7, 7, 0, 0, 0 } }, { 3, { 0, 0, 7, 0, 0, 0 } },
+  { 4, { 1, 0, 7, 6, 0, 0 } }, { 4, { 0, 1, 7, 6, 0, 0 } }, { 5, { 1, 1, 7, 6, 6, 0 } }, { 2, { 0, 7, 0, 0, 0, 0 } },
+  { 3, { 1, 7, 6, 0, 0, 0 } }, { 4, { 1, 0, 7, 5, 0, 0 } }, { 5, { 1, 1, 7, 6, 5, 0 } }, { 2, { 0, 6, 0, 0, 0, 0 } },
+  { 3, { 1, 7, 5, 0, 0, 0 } }, { 2, { 1, 3, 0, 0, 0, 0 } }, { 4, { 0, 1, 3, 4, 0, 0 } }, { 6, { 0, 0, 1, 3, 4, 4 } },
+  { 2, { 1, 3, 0, 0, 0, 0 } }, { 2, { 1, 2, 0, 0, 0, 0 } }, { 3, { 0, 1, 3, 0, 0, 0 } }, { 4, { 7, 1, 2, 3, 0, 0 } },
+  { 5, { 7, 0, 1, 3, 3, 0 } }, { 2, { 1, 1, 0, 0, 0, 0 } }, { 3, { 0, 1, 2, 0, 0, 0 } }, { 4, { 7, 1, 2, 2, 0, 0 } },
+  { 5, { 7, 0, 1, 3, 2, 0 } }, { 4, { 0, 0, 1, 3, 0, 0 } }, { 4, { 7, 1, 1, 3, 0, 0 } }, { 5, { 0, 7, 1, 2, 3, 0 } },
+  { 5, { 7, 0, 1, 2, 3, 0 } }, { 3, { 1, 0, 1, 0, 0, 0 } }, { 3, { 0, 1, 1, 0, 0, 0 } }, { 4, { 7, 1, 2, 1, 0, 0 } },
+  { 5, { 7, 0, 1, 3, 1, 0 } }, { 4, { 1, 7, 1, 2, 0, 0 } }, { 4, { 0, 0, 1, 2, 0, 0 } }, { 4, { 7, 1, 1, 2, 0, 0 } },
+  { 5, { 0, 7, 1, 2, 2, 0 } }, { 5, { 7, 0, 1, 2, 2, 0 } }, { 4, { 1, 0, 0, 1, 0, 0 } }, { 4, { 0, 1, 0, 1, 0, 0 } },
+  { 4, { 1, 7, 1, 1, 0, 0 } }, { 4, { 0, 0, 1, 1, 0, 0 } }, { 4, { 7, 1, 1, 1, 0, 0 } }, { 5, { 0, 7, 1, 2, 1, 0 } },
+  { 5, { 7, 0, 1, 2, 1, 0 } }, { 4, { 1, 0, 0, 0, 0, 0 } }, { 4, { 0, 1, 0, 0, 0, 0 } }, { 4, { 1, 7, 1, 0, 0, 0 } },
+  { 4, { 0, 0, 1, 0, 0, 0 } }, { 4, { 7, 1, 1, 0, 0, 0 } }, { 4, { 1, 0, 7, 1, 0, 0 } }, { 4, { 0, 1, 7, 1, 0, 0 } },
+  { 4, { 1, 7, 0, 1, 0, 0 } }, { 4, { 0, 0, 0, 1, 0, 0 } }, { 4, { 7, 1, 0, 1, 0, 0 } }, { 4, { 0, 7, 1, 1, 0, 0 } },
+  { 4, { 7, 0, 1, 1, 0, 0 } }, { 4, { 1, 0, 0, 7, 0, 0 } }, { 4, { 0, 1, 0, 7, 0, 0 } }, { 4, { 1, 7, 1, 7, 0, 0 } },
+  { 4, { 0, 0, 1, 7, 0, 0 } }, { 4, { 7, 1, 1, 7, 0, 0 } }, { 4, { 1, 0, 7, 0, 0, 0 } }, { 4, { 0, 1, 7, 0, 0, 0 } },
+  { 4, { 1, 7, 0, 0, 0, 0 } }, { 4, { 0, 0, 0, 0, 0, 0 } }, { 4, { 7, 1, 0, 0, 0, 0 } }, { 4, { 0, 7, 1, 0, 0, 0 } },
+  { 4, { 7, 0, 1, 0, 0, 0 } }, { 4, { 1, 7, 7, 1, 0, 0 } }, { 4, { 0, 0, 7, 1, 0, 0 } }, { 4, { 7, 1, 7, 1, 0, 0 } },
+  { 4, { 0, 7, 0, 1, 0, 0 } }, { 4, { 7, 0, 0, 1, 0, 0 } }, { 4, { 1, 0, 7, 7, 0, 0 } }, { 4, { 0, 1, 7, 7, 0, 0 } },
+  { 4, { 1, 7, 0, 7, 0, 0 } }, { 4, { 0, 0, 0, 7, 0, 0 } }, { 4, { 7, 1, 0, 7, 0, 0 } }, { 4, { 0, 7, 1, 7, 0, 0 } },
+  { 4, { 7, 0, 1, 7, 0, 0 } }, { 4, { 1, 7, 7, 0, 0, 0 } }, { 4, { 0, 0, 7, 0, 0, 0 } }, { 4, { 7, 1, 7, 0, 0, 0 } },
+  { 4, { 0, 7, 0, 0, 0, 0 } }, { 4, { 7, 0, 0, 0, 0, 0 } }, { 4, { 1, 7, 7, 7, 0, 0 } }, { 4, { 0, 0, 7, 7, 0, 0 } },
+  { 4, { 7, 1, 7, 7, 0, 0 } }, { 5, { 1, 0, 7, 6, 7, 0 } }, { 5, { 0, 1, 7, 6, 7, 0 } }, { 4, { 0, 7, 0, 7, 0, 0 } },
+  { 4, { 7, 0, 0, 7, 0, 0 } }, { 3, { 0, 7, 7, 0, 0, 0 } }, { 4, { 1, 7, 6, 7, 0, 0 } }, { 5, { 1, 0, 7, 5, 7, 0 } },
+  { 3, { 7, 0, 7, 0, 0, 0 } }, { 4, { 1, 7, 7, 6, 0, 0 } }, { 4, { 0, 0, 7, 6, 0, 0 } }, { 4, { 7, 1, 7, 6, 0, 0 } },
+  { 5, { 1, 0, 7, 6, 6, 0 } }, { 5, { 0, 1, 7, 6, 6, 0 } }, { 2, { 7, 7, 0, 0, 0, 0 } }, { 3, { 0, 7, 6, 0, 0, 0 } },
+  { 4, { 1, 7, 6, 6, 0, 0 } }, { 5, { 1, 0, 7, 5, 6, 0 } }, { 4, { 1, 7, 7, 5, 0, 0 } }, { 4, { 0, 0, 7, 5, 0, 0 } },
+  { 5, { 1, 0, 7, 6, 5, 0 } }, { 5, { 0, 1, 7, 6, 5, 0 } }, { 2, { 7, 6, 0, 0, 0, 0 } }, { 3, { 0, 7, 5, 0, 0, 0 } },
+  { 4, { 1, 7, 6, 5, 0, 0 } }, { 5, { 1, 0, 7, 5, 5, 0 } }, { 2, { 7, 5, 0, 0, 0, 0 } }, { 2, { 0, 2, 0, 0, 0, 0 } },
+  { 3, { 7, 1, 3, 0, 0, 0 } }, { 2, { 0, 1, 0, 0, 0, 0 } }, { 3, { 7, 1, 2, 0, 0, 0 } }, { 4, { 7, 0, 1, 3, 0, 0 } },
+  { 5, { 7, 7, 1, 2, 3, 0 } }, { 3, { 0, 0, 1, 0, 0, 0 } }, { 3, { 7, 1, 1, 0, 0, 0 } }, { 4, { 0, 7, 1, 2, 0, 0 } },
+  { 4, { 7, 0, 1, 2, 0, 0 } }, { 5, { 7, 7, 1, 2, 2, 0 } }, { 4, { 0, 0, 0, 1, 0, 0 } }, { 4, { 7, 1, 0, 1, 0, 0 } },
+  { 4, { 0, 7, 1, 1, 0, 0 } }, { 4, { 7, 0, 1, 1, 0, 0 } }, { 5, { 7, 7, 1, 2, 1, 0 } }, { 4, { 0, 0, 0, 0, 0, 0 } },
+  { 4, { 7, 1, 0, 0, 0, 0 } }, { 4, { 0, 7, 1, 0, 0, 0 } }, { 4, { 7, 0, 1, 0, 0, 0 } }, { 4, { 0, 0, 7, 1, 0, 0 } },
+  { 4, { 7, 1, 7, 1, 0, 0 } }, { 4, { 0, 7, 0, 1, 0, 0 } }, { 4, { 7, 0, 0, 1, 0, 0 } }, { 4, { 7, 7, 1, 1, 0, 0 } },
+  { 4, { 0, 0, 0, 7, 0, 0 } }, { 4, { 7, 1, 0, 7, 0, 0 } }, { 4, { 0, 7, 1, 7, 0, 0 } }, { 4, { 7, 0, 1, 7, 0, 0 } },
+  { 4, { 0, 0, 7, 0, 0, 0 } }, { 4, { 7, 1, 7, 0, 0, 0 } }, { 4, { 0, 7, 0, 0, 0, 0 } }, { 4, { 7, 0, 0, 0, 0, 0 } },
+  { 4, { 7, 7, 1, 0, 0, 0 } }, { 4, { 0, 7, 7, 1, 0, 0 } }, { 4, { 7, 0, 7, 1, 0, 0 } }, { 4, { 7, 7, 0, 1, 0, 0 } },
+  { 4, { 0, 0, 7, 7, 0, 0 } }, { 4, { 7, 1, 7, 7, 0, 0 } }, { 4, { 0, 7, 0, 7, 0, 0 } }, { 4, { 7, 0, 0, 7, 0, 0 } },
+  { 4, { 7, 7, 1, 7, 0, 0 } }, { 4, { 0, 7, 7, 0, 0, 0 } }, { 4, { 7, 0, 7, 0, 0, 0 } }, { 4, { 7, 7, 0, 0, 0, 0 } },
+  { 4, { 0, 7, 7, 7, 0, 0 } }, { 4, { 7, 0, 7, 7, 0, 0 } }, { 5, { 0, 0, 7, 6, 7, 0 } }, { 5, { 7, 1, 7, 6, 7, 0 } },
+  { 4, { 7, 7, 0, 7, 0, 0 } }, { 3, { 7, 7, 7, 0, 0, 0 } }, { 4, { 0, 7, 6, 7, 0, 0 } }, { 5, { 0, 0, 7, 5, 7, 0 } },
+  { 4, { 0, 7, 7, 6, 0, 0 } }, { 4, { 7, 0, 7, 6, 0, 0 } }, { 5, { 0, 0, 7, 6, 6, 0 } }, { 5, { 7, 1, 7, 6, 6, 0 } },
+  { 3, { 7, 6, 7, 0, 0, 0 } }, { 4, { 0, 7, 5, 7, 0, 0 } }, { 3, { 7, 7, 6, 0, 0, 0 } }, { 4, { 0, 7, 6, 6, 0, 0 } },
+  { 5, { 0, 0, 7, 5, 6, 0 } }, { 4, { 0, 7, 7, 5, 0, 0 } }, { 4, { 7, 0, 7, 5, 0, 0 } }, { 5, { 0, 0, 7, 6, 5, 0 } },
+  { 5, { 7, 1, 7, 6, 5, 0 } }, { 3, { 7, 6, 6, 0, 0, 0 } }, { 4, { 0, 7, 5, 6, 0, 0 } }, { 3, { 7, 7, 5, 0, 0, 0 } },
+  { 4, { 0, 7, 6, 5, 0, 0 } }, { 5, { 0, 0, 7, 5, 5, 0 } }, { 3, { 7, 6, 5, 0, 0, 0 } }, { 4, { 0, 7, 5, 5, 0, 0 } },
+  { 6, { 0, 0, 7, 5, 4, 5 } }, { 2, { 7, 5, 0, 0, 0, 0 } }, { 4, { 0, 7, 5, 4, 0, 0 } }, { 6, { 0, 0, 7, 5, 4, 4 } }
+};
+
+}  // namespace Perturbations
+}  // namespace mil_vision
@@ -10,6 +10,12 @@ namespace mil_vision
 {
 class CameraObserver
 {
+  /*
+    Makes color observations of the points of a cloud from the frame of one camera closest in time to the cloud.
+    Points hidden behind closer ones are left out. Only one thread may use an observer at a time, but different
+    observers can be used in parallel.
+  */
+
   using CamStream = ROSCameraStream<cv::Vec3b>;
 
   ros::NodeHandle _nh;
@@ -17,6 +23,15 @@ class CameraObserver
   ROSCameraStream<cv::Vec3b> _cam_stream;
   tf::TransformListener _tf_listener;
 
+  // Kept between clouds so their buffers are reused
+  ColorObservation::Vec _projected;  // in the order of the cloud
+  ColorObservationImg _obs_img;
+  UnoccludedPointsImg _unoccluded_img;
+
+  // Occlusion parameters, see UnoccludedPointsImg
+  int _occlusion_radius{ 3 };
+  float _occlusion_tolerance{ 0.05 };
+
   std::string _err_msg{ "" };
   bool _ok{ false };
 
@@ -28,9 +43,11 @@ public:
     return _cam_stream.getCameraModelPtr();
   }
 
-  std::vector<ColorObservation> operator()(const PCD<pcl::PointXYZ>::ConstPtr &pcd)
+  // Observes the points of pcd, returns false if there is no frame or transform for the cloud. The observations that
+  // are not occluded are then the visible ones.
+  bool operator()(const PCD<pcl::PointXYZ>::ConstPtr &pcd)
   {
-    return std::vector<ColorObservation>{};
+    return get_color_observations(pcd);
   }
 
   bool ok() const
@@ -38,7 +55,18 @@ public:
     return _ok && ros::ok();
   }
 
-  ColorObservation::VecImg get_color_observations(const PCD<pcl::PointXYZ>::ConstPtr &pcd);
+  // Fills the observation image and the occlusion image for pcd, returns false if that can not be done
+  bool get_color_observations(const PCD<pcl::PointXYZ>::ConstPtr &pcd);
+
+  const ColorObservationImg &observations() const
+  {
+    return _obs_img;
+  }
+
+  const UnoccludedPointsImg &unoccludedImg() const
+  {
+    return _unoccluded_img;
+  }
 };
 
 }  // namespace mil_vision
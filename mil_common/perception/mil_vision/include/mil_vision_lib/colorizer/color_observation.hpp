@@ -10,10 +10,56 @@ namespace mil_vision
 struct alignas(16) ColorObservation
 {
   using Vec = std::vector<ColorObservation>;
-  using VecImg = cv::Mat_<Vec>;
   // float tstamp;   // seconds
-  float xyz[3];
+  float xyz[3];    // in the frame of the cloud
   uint8_t bgr[3];
+  int idx;         // of the point in the cloud
+  int pixel;       // row major index of the pixel it was seen in
+  float distance;  // from the camera center
+  float weight;    // larger for closer points and ones nearer the center of the image
+};
+
+class ColorObservationImg
+{
+  /* Observations of each pixel of an image, all in one array in row major pixel order, with the offset in it of
+     each pixel's first observation. The observations of a pixel are [begin(pixel), end(pixel)). It is built with
+     one pass counting the observations in each pixel and one filling them in, and building it again for an image
+     of the same size reuses all of its memory.
+   */
+
+  int _rows = 0;
+  int _cols = 0;
+  std::vector<int> _offsets;  // rows * cols + 1 of them
+  std::vector<int> _fill;
+  ColorObservation::Vec _obs;
+
+public:
+  // Builds from observations in any order, using their pixel
+  void build(int rows, int cols, const ColorObservation::Vec &observations);
+
+  int rows() const
+  {
+    return _rows;
+  }
+  int cols() const
+  {
+    return _cols;
+  }
+
+  const ColorObservation *begin(int pixel) const
+  {
+    return _obs.data() + _offsets[pixel];
+  }
+  const ColorObservation *end(int pixel) const
+  {
+    return _obs.data() + _offsets[pixel + 1];
+  }
+
+  // Every observation, in pixel order
+  const ColorObservation::Vec &all() const
+  {
+    return _obs;
+  }
 };
 
 class UnoccludedPointsImg
@@ -22,14 +68,30 @@ class UnoccludedPointsImg
      from a given camera view. It quantizes the projection of the point cloud points
      into the image plane into pixel bins and selects the point closest to the center
      of projection to be the only visible one for a given image pixel.
+
+     Lidar returns are much sparser than pixels, so the closest distance is spread over
+     a window of pixels around each one. A point is visible if it is no further than
+     relative_tolerance past the closest point in its window, so a far surface seen
+     through the gaps between the returns of a near one still counts as occluded.
    */
 
-  ColorObservation::VecImg unouccluded_pt_idxs;
-  cv::Mat_<float> distance_image;
-  PCDPtr<pcl::PointXYZ> cloud_ptr;
+  cv::Mat_<float> distance_image;  // closest distance within the window of each pixel
+  float _relative_tolerance = 0.05;
 
 public:
   UnoccludedPointsImg();
+
+  void build(const ColorObservationImg &obs_img, int window_radius, float relative_tolerance);
+
+  bool unoccluded(const ColorObservation &obs) const
+  {
+    return obs.distance <= distance_image.ptr<float>()[obs.pixel] * (1 + _relative_tolerance);
+  }
+
+  const cv::Mat_<float> &distanceImage() const
+  {
+    return distance_image;
+  }
 };
 
 struct PointColorStats
@@ -40,4 +102,4 @@ struct PointColorStats
   int n;
 };
 
-}  // namespace mil_vision
\ No newline at end of file
+}  // namespace mil_vision
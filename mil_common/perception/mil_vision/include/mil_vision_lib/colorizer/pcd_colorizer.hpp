@@ -48,22 +48,13 @@ private:
   // Subscribing and storing input
   std::string _input_pcd_topic;
   ros::Subscriber _cloud_sub;
-  PCD<>::ConstPtr _current_color_pcd;  // Template default argument is in common.hpp
 
   // Storing result and publishing
   std::string _output_pcd_topic;
   ros::Publisher _cloud_pub;
-  PCD<>::ConstPtr _output_pcd;
-
-  // SPtrVector<CamStream> _ros_cam_ptrs;
-  // SPtrVector<PointCloud> _transformed_cloud_ptrs;
-  // SPtrVector<ColorObservation::VecImg> _obs_vec_img_ptrs;
-  // PCD<pcl::PointXYZRGBA> color_permanence_pcd;
+  PCD<pcl::PointXYZRGB>::ConstPtr _output_pcd;
 
   void _cloud_cb(const PCD<>::ConstPtr &cloud_in);
-  // void _process_pcd(const PointCloud::ConstPtr &cloud_in);
-  // void _combine_pcd();
-  // tf::TransformListener _tf_listener;
 
 };  // end class PcdColorizer
 
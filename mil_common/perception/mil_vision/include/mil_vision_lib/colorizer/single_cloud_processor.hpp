@@ -7,19 +7,41 @@
 #include <mil_vision_lib/colorizer/common.hpp>
 #include <mil_vision_lib/image_acquisition/ros_camera_stream.hpp>
 
+#include <condition_variable>
+
 namespace mil_vision
 {
 class SingleCloudProcessor
 {
+  /*
+    Colors one cloud at a time from every camera that is up. Each camera has a worker thread that makes its
+    observations of the cloud, then the observations of each point from all cameras are merged into one color,
+    weighted by ColorObservation::weight.
+  */
+
 public:
   SingleCloudProcessor(ros::NodeHandle nh, std::string &in_pcd_topic, size_t hist_size);
-  void operator()(const PCD<pcl::PointXYZ>::ConstPtr &pcd);
+  ~SingleCloudProcessor();
+
+  // Returns the points of pcd that at least one camera saw, colored, or nullptr if processor is not ok
+  PCD<pcl::PointXYZRGB>::Ptr operator()(const PCD<pcl::PointXYZ>::ConstPtr &pcd);
+
   bool ok() const
   {
     return _ok && ros::ok();
   }
 
+  // Color statistics of the points of the last cloud, one per point of it. n is 0 for points no camera saw.
+  const std::vector<PointColorStats> &stats() const
+  {
+    return _stats;
+  }
+
 private:
+  void _work(size_t observer_idx);
+  // Fills _stats for a cloud of points points from the visible observations of each observer
+  void _merge(size_t points);
+
   ros::NodeHandle _nh;
   std::string in_pcd_topic;
   size_t _hist_size;  // image history buffer size
@@ -27,11 +49,27 @@ private:
   // CameraObserver creates point color observations for a specific camera
   UPtrVector<CameraObserver> _camera_observers;
 
-  // Inter-thread communication
-  std::promise<void> _start_work_prom;
-  std::shared_future<void> _start_work_fut{ _start_work_prom.get_future() };
-  std::vector<std::promise<void>> _worker_done_proms;
-  std::vector<std::future<void>> _worker_done_futs;
+  // Inter-thread communication. Workers wait for seq to pass the last cloud they did, then count themselves into
+  // _workers_done.
+  std::vector<std::thread> _workers;
+  std::mutex _work_mtx;
+  std::condition_variable _start_work_cv;
+  std::condition_variable _worker_done_cv;
+  PCD<pcl::PointXYZ>::ConstPtr _pcd;
+  std::vector<char> _observed;  // whether each observer could observe _pcd
+  size_t _workers_done = 0;
+  bool _stop = false;
+
+  // Weighted sums of the observations of each point, kept to reuse their memory
+  struct ColorSums
+  {
+    float weight;
+    float bgr[3];
+    float bgr_sq[3];
+    int n;
+  };
+  std::vector<ColorSums> _sums;
+  std::vector<PointColorStats> _stats;
 
   int seq = 0;
 
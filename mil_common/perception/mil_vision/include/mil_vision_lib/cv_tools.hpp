@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <sstream>
 #include <string>
@@ -15,6 +16,7 @@
 #include <boost/foreach.hpp>
 
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/cuda.hpp>
 
 #include <image_geometry/pinhole_camera_model.h>
 #include <image_transport/image_transport.h>
@@ -86,6 +88,98 @@ void statistical_image_segmentation(const cv::Mat &src, cv::Mat &dest, cv::Mat &
                                     bool ret_dbg_img = false, const float sigma = 1.5,
                                     const float low_thresh_gain = 0.5, const float high_thresh_gain = 0.5);
 
+class StatisticalImageSegmenter
+{
+  /**
+          Stateful statistical_image_segmentation() for segmenting one channel of a stream of
+     frames. The smoothing kernel and structuring element are made once and every buffer is kept
+     between frames. It can also track what it segments: the histogram is then taken over only the
+     bounding box of the previous frame's segmentation plus a padding, blended with the previous
+     histogram, and taken over the whole frame again every full_frame_interval frames or when nothing
+     was segmented. With tracking and memory off, which is the default, the results are the same as
+     statistical_image_segmentation().
+  */
+public:
+  // Milliseconds the last call to segment() spent in each stage
+  struct Timing
+  {
+    double histogram_ms = 0;
+    double thresholds_ms = 0;
+    double threshold_ms = 0;
+    double morphology_ms = 0;
+    double total_ms = 0;
+  };
+
+  StatisticalImageSegmenter(int hist_size, const float *range, float sigma = 1.5, int kernel_size = 11);
+
+  // A negative padding takes every histogram over the whole frame
+  void set_roi_tracking(int padding, int full_frame_interval = 30);
+  // How much of the previous histogram is kept in each new one, in [0, 1)
+  void set_histogram_memory(float decay);
+  // Forgets the tracked box and histogram
+  void reset();
+
+  // src must be 8 bit single channel
+  void segment(const cv::Mat &src, cv::Mat &dest, int target, float low_thresh_gain = 0.5,
+               float high_thresh_gain = 0.5);
+
+  // Draws the histogram, its derivative, the thresholds and the last segmentation dest
+  void draw_debug_image(const cv::Mat &dest, cv::Mat &debug_img, const std::string &image_name) const;
+
+  const Timing &last_timing() const
+  {
+    return _timing;
+  }
+  int low_thresh() const
+  {
+    return _low_thresh;
+  }
+  int high_thresh() const
+  {
+    return _high_thresh;
+  }
+  int target_mode() const
+  {
+    return _target_mode;
+  }
+  const cv::Mat &histogram() const
+  {
+    return _hist;
+  }
+
+  // Sets dest to 255 where low <= src <= high and mask is not 0, like cv::inRange followed by a mask, in one
+  // vectorized pass. src and mask are 8 bit single channel, mask may be empty.
+  static void threshold_range(const cv::Mat &src, int low, int high, cv::Mat &dest, const cv::Mat &mask = cv::Mat());
+
+private:
+  // same as smooth_histogram, but with the kernel made once
+  void _smooth(cv::Mat &hist) const;
+  void _select_thresholds(int target, float low_thresh_gain, float high_thresh_gain);
+  void _track(const cv::Mat &dest);
+
+  int _hist_size;
+  float _range[2];
+  float _sigma;
+  int _kernel_size;
+  std::vector<float> _kernel;
+  cv::Mat _structuring_element;
+
+  // Tracking
+  int _roi_padding = -1;
+  int _full_frame_interval = 30;
+  float _decay = 0;
+  cv::Rect _roi;  // empty when nothing is tracked
+  int _frames_since_full_frame = 0;
+  double _hist_pixels = 0;  // pixels the blended histogram stands for
+
+  cv::Mat _frame_hist, _hist, _hist_smooth, _hist_derivative, _row_max, _col_max;
+  std::vector<cv::Point> _modes, _derivative_maxima, _derivative_minima;
+  int _target_mode = 0;
+  int _low_thresh = 0;
+  int _high_thresh = 0;
+  Timing _timing;
+};
+
 cv::Mat triangulate_Linear_LS(cv::Mat mat_P_l, cv::Mat mat_P_r, cv::Mat undistorted_l, cv::Mat undistorted_r);
 
 Eigen::Vector3d kanatani_triangulation(const cv::Point2d &pt1, const cv::Point2d &pt2, const Eigen::Matrix3d &essential,
@@ -94,6 +188,26 @@ Eigen::Vector3d kanatani_triangulation(const cv::Point2d &pt1, const cv::Point2d
 Eigen::Vector3d lindstrom_triangulation(const cv::Point2d &pt1, const cv::Point2d &pt2,
                                         const Eigen::Matrix3d &essential, const Eigen::Matrix3d &R);
 
+/*
+  Batch versions of the triangulations above, for count correspondences pts1[i] <-> pts2[i] between the same pair of
+  cameras. The terms that only depend on the cameras are computed once, and no cv::Mat is made per point.
+  reprojection_errors may be NULL, otherwise it gets an error for each point:
+    triangulate_Linear_LS: RMS over both images of the pixel distance from the observed points to the reprojected one
+    kanatani/lindstrom: RMS over both images of the distance from the observed points to the corrected ones, in the
+                        normalized image coordinates the points are given in
+*/
+void triangulate_Linear_LS(const cv::Matx34d &P_l, const cv::Matx34d &P_r, const cv::Point2d *pts_l,
+                           const cv::Point2d *pts_r, size_t count, Eigen::Vector3d *points,
+                           double *reprojection_errors = NULL);
+
+void kanatani_triangulation(const cv::Point2d *pts1, const cv::Point2d *pts2, size_t count,
+                            const Eigen::Matrix3d &essential, const Eigen::Matrix3d &R, Eigen::Vector3d *points,
+                            double *reprojection_errors = NULL);
+
+void lindstrom_triangulation(const cv::Point2d *pts1, const cv::Point2d *pts2, size_t count,
+                             const Eigen::Matrix3d &essential, const Eigen::Matrix3d &R, Eigen::Vector3d *points,
+                             double *reprojection_errors = NULL);
+
 struct ImageWithCameraInfo
 {
   /**
@@ -125,22 +239,153 @@ class FrameHistory
           number of ImageWithCameraInfo objects. The frame history can then be
      retrieved
           in whole or just a portion.
+
+          The frames are kept in a ring in time order, so the ranges returned by frames(),
+     last_frames() and frames_since() iterate over the ring itself without copying or allocating.
+     A range stays valid until the next frame is added, which happens in ROS callbacks, so it should
+     be used within a callback or between spins.
   */
 public:
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = ImageWithCameraInfo;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ImageWithCameraInfo *;
+    using reference = const ImageWithCameraInfo &;
+
+    const_iterator() = default;
+    const_iterator(const FrameHistory *history, size_t i) : _history(history), _i(i)
+    {
+    }
+
+    reference operator*() const
+    {
+      return _history->_at(_i);
+    }
+    pointer operator->() const
+    {
+      return &_history->_at(_i);
+    }
+    reference operator[](difference_type n) const
+    {
+      return _history->_at(_i + n);
+    }
+    const_iterator &operator++()
+    {
+      ++_i;
+      return *this;
+    }
+    const_iterator operator++(int)
+    {
+      const_iterator it = *this;
+      ++_i;
+      return it;
+    }
+    const_iterator &operator--()
+    {
+      --_i;
+      return *this;
+    }
+    const_iterator operator--(int)
+    {
+      const_iterator it = *this;
+      --_i;
+      return it;
+    }
+    const_iterator &operator+=(difference_type n)
+    {
+      _i += n;
+      return *this;
+    }
+    const_iterator &operator-=(difference_type n)
+    {
+      _i -= n;
+      return *this;
+    }
+    const_iterator operator+(difference_type n) const
+    {
+      return const_iterator(_history, _i + n);
+    }
+    const_iterator operator-(difference_type n) const
+    {
+      return const_iterator(_history, _i - n);
+    }
+    difference_type operator-(const const_iterator &other) const
+    {
+      return difference_type(_i) - difference_type(other._i);
+    }
+    bool operator==(const const_iterator &other) const
+    {
+      return _i == other._i;
+    }
+    bool operator!=(const const_iterator &other) const
+    {
+      return _i != other._i;
+    }
+    bool operator<(const const_iterator &other) const
+    {
+      return _i < other._i;
+    }
+
+  private:
+    const FrameHistory *_history = nullptr;
+    size_t _i = 0;  // in time order, 0 being the oldest frame
+  };
+
+  // Frames from begin() to end(), oldest first
+  struct FrameRange
+  {
+    const_iterator first, last;
+    const_iterator begin() const
+    {
+      return first;
+    }
+    const_iterator end() const
+    {
+      return last;
+    }
+    size_t size() const
+    {
+      return last - first;
+    }
+    bool empty() const
+    {
+      return first == last;
+    }
+  };
+
   FrameHistory(std::string img_topic, unsigned int hist_size);
   ~FrameHistory();
   void image_callback(const sensor_msgs::ImageConstPtr &image_msg, const sensor_msgs::CameraInfoConstPtr &info_msg);
+  // Copies of the last frames_requested frames, oldest first, or none if there are not that many
   std::vector<ImageWithCameraInfo> get_frame_history(unsigned int frames_requested);
   int frames_available();
+  // Bytes of image data the history holds, for memory accounting
+  size_t bytes() const;
+
+  // Every frame, oldest first
+  FrameRange frames() const;
+  // The last n frames, or all of them if there are fewer, oldest first
+  FrameRange last_frames(size_t n) const;
+  // Frames stamped after stamp, oldest first. Passing the stamp of the last frame used gets just the new ones.
+  FrameRange frames_since(const ros::Time &stamp) const;
 
   const std::string topic_name;
   const size_t history_size;
 
 private:
+  const ImageWithCameraInfo &_at(size_t i) const
+  {
+    return _frame_history_ring_buffer[(_oldest + i) % _frame_history_ring_buffer.size()];
+  }
+
   ros::NodeHandle nh;
   image_transport::CameraSubscriber _image_sub;
   image_transport::ImageTransport _image_transport;
   std::vector<ImageWithCameraInfo> _frame_history_ring_buffer;
+  size_t _oldest = 0;  // index of the oldest frame in the ring buffer
   size_t frame_count;
 };
 
@@ -156,4 +401,7 @@ void range_from_param(std::string &param_root, Range &range);
 
 void inParamRange(cv::Mat &src, Range &range, cv::Mat &dest);
 
+// inParamRange on the GPU, returns false if mil_vision::gpuAvailable() is false
+bool inParamRange(const cv::cuda::GpuMat &src, Range &range, cv::cuda::GpuMat &dest);
+
 }  // namespace sub
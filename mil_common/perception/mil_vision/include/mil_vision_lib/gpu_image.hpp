@@ -0,0 +1,45 @@
+#pragma once
+
+#include <image_geometry/pinhole_camera_model.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/cuda.hpp>
+
+namespace mil_vision
+{
+/*
+  GPU versions of the image operations done on every frame, for images already uploaded with CameraFrame::gpuImage.
+  They need OpenCV built with its CUDA modules, which mil_vision_lib is built against when they are found. Otherwise
+  or with no CUDA device, gpuAvailable is false and each of these does nothing and returns false, so callers can fall
+  back to the CPU.
+*/
+
+// True if mil_vision_lib was built with CUDA and there is a device to use
+bool gpuAvailable();
+
+// Rectifies images of one camera with maps computed once per camera model and kept on the GPU
+class GpuRectifier
+{
+public:
+  // Computes the maps for model, if they were not already computed for it
+  bool init(const image_geometry::PinholeCameraModel &model);
+
+  bool rectify(const cv::cuda::GpuMat &raw, cv::cuda::GpuMat &rectified,
+               cv::cuda::Stream &stream = cv::cuda::Stream::Null()) const;
+
+private:
+  // Camera info the maps were made for
+  sensor_msgs::CameraInfo info;
+  cv::cuda::GpuMat map_x;
+  cv::cuda::GpuMat map_y;
+};
+
+// cv::cvtColor on the GPU
+bool gpuCvtColor(const cv::cuda::GpuMat &src, cv::cuda::GpuMat &dest, int code,
+                 cv::cuda::Stream &stream = cv::cuda::Stream::Null());
+
+// cv::inRange on the GPU
+bool gpuInRange(const cv::cuda::GpuMat &src, const cv::Scalar &lower, const cv::Scalar &upper,
+                cv::cuda::GpuMat &dest, cv::cuda::Stream &stream = cv::cuda::Stream::Null());
+
+}  // namespace mil_vision
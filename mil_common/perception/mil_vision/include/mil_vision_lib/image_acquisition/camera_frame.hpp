@@ -5,9 +5,12 @@
 #include <image_geometry/pinhole_camera_model.h>
 #include <ros/ros.h>
 #include <opencv2/core/core.hpp>
+#include <opencv2/core/cuda.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 
 #include <exception>
 #include <memory>
+#include <mutex>
 #include <string>
 
 namespace mil_vision
@@ -79,13 +82,62 @@ public:
     this->_seq = other._seq;
     this->_stamp = other._stamp;
     this->_image = other._image.clone();  // Object will have unoque copy of image data
-    this->_cam_model_ptr = other.cam_model_ptr;
+    this->_cam_model_ptr = other._cam_model_ptr;
+    this->_rectified = other._rectified;
+    this->_img_scale = other._img_scale;
   }
 
   // From ROS img msg
   CameraFrame(const sensor_msgs::ImageConstPtr &image_msg_ptr, cam_model_ptr_t &cam_model_ptr,
+              bool is_rectified = false, float_t store_at_scale = 1.0)
+  {
+    assign(image_msg_ptr, cam_model_ptr, is_rectified, store_at_scale);
+  }
+
+  // Reuses this frame for a new ROS img msg. At a scale of 1 the image is not copied, it points into the message
+  // data, which the frame keeps alive until it is reused or destroyed.
+  void assign(const sensor_msgs::ImageConstPtr &image_msg_ptr, const cam_model_ptr_t &cam_model_ptr,
               bool is_rectified = false, float_t store_at_scale = 1.0);
 
+  // Reuses this frame for an image that fill writes into the frame's own buffer, which is only reallocated when the
+  // image size or type changes. For images made from a ROS img msg, like rectified ones.
+  template <typename fill_t>
+  void assign(const std_msgs::Header &header, const cam_model_ptr_t &cam_model_ptr, bool is_rectified, fill_t fill)
+  {
+    if (_ros_img_bridge || _image_owner)
+    {
+      // _image points into a message or someone else's memory, which must not be written to
+      _image.release();
+      _ros_img_bridge.reset();
+      _image_owner.reset();
+    }
+    fill(_image);
+    _gpu_uploaded = false;
+    _gray_made = _hsv_made = false;
+    this->_img_scale = 1.0;
+    this->_cam_model_ptr = cam_model_ptr;
+    this->_rectified = is_rectified;
+    _seq = header.seq;
+    _stamp = header.stamp;
+  }
+
+  // Reuses this frame for an image in memory owned by something else, like a shared memory ring, without copying
+  // it. The frame keeps owner until it is reused or destroyed, which must keep the image data valid.
+  void assign(const std_msgs::Header &header, const cam_model_ptr_t &cam_model_ptr, bool is_rectified,
+              const cv::Mat_<img_scalar_t> &image, const std::shared_ptr<const void> &owner)
+  {
+    _ros_img_bridge.reset();
+    _image = image;
+    _image_owner = owner;
+    _gpu_uploaded = false;
+    _gray_made = _hsv_made = false;
+    this->_img_scale = 1.0;
+    this->_cam_model_ptr = cam_model_ptr;
+    this->_rectified = is_rectified;
+    _seq = header.seq;
+    _stamp = header.stamp;
+  }
+
   ///////////////////////////////////////////////////////////////////////////////////////////////
   // Public Methods /////////////////////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -110,6 +162,48 @@ public:
     return _image;
   }
 
+  // The image on the GPU, uploaded the first time it is asked for and shared by everyone reading this frame after
+  // that. The GPU buffer is kept when the frame is reused. Only call this if gpuAvailable() in gpu_image.hpp, as
+  // OpenCV throws without CUDA.
+  const cv::cuda::GpuMat &gpuImage() const
+  {
+    std::lock_guard<std::mutex> lock(_gpu_mtx);
+    if (!_gpu_uploaded)
+    {
+      _gpu_image.upload(_image);
+      _gpu_uploaded = true;
+    }
+    return _gpu_image;
+  }
+
+  // The image in grayscale and in HSV, converted from BGR the first time each is asked for and shared by everyone
+  // reading this frame after that, so detectors sharing a stream convert each frame once. The buffers are kept when
+  // the frame is reused. A frame that is already gray is its own grayscale image, and has no HSV one.
+  const cv::Mat &grayImage() const
+  {
+    if (_image.channels() != 3)
+      return _image;
+    std::lock_guard<std::mutex> lock(_derived_mtx);
+    if (!_gray_made)
+    {
+      cv::cvtColor(_image, _gray_image, cv::COLOR_BGR2GRAY);
+      _gray_made = true;
+    }
+    return _gray_image;
+  }
+
+  const cv::Mat &hsvImage() const
+  {
+    CV_Assert(_image.channels() == 3);
+    std::lock_guard<std::mutex> lock(_derived_mtx);
+    if (!_hsv_made)
+    {
+      cv::cvtColor(_image, _hsv_image, cv::COLOR_BGR2HSV);
+      _hsv_made = true;
+    }
+    return _hsv_image;
+  }
+
   bool rectified() const
   {
     return _rectified;
@@ -141,9 +235,28 @@ private:
   // Time that this image was taken
   time_t_ _stamp;
 
-  // Stores the image data (not a cv:Mat header pointing to shared image data)
+  // Stores the image data. At a scale of 1 this is a header pointing into the ROS image message, otherwise it owns
+  // its data
   cv::Mat_<img_scalar_t> _image;
 
+  // Keeps the ROS image message that _image may point into alive
+  cv_bridge::CvImageConstPtr _ros_img_bridge;
+
+  // Keeps other memory _image may point into valid
+  std::shared_ptr<const void> _image_owner;
+
+  // Copy of _image on the GPU if _gpu_uploaded, made by gpuImage for the readers of a const frame
+  mutable std::mutex _gpu_mtx;
+  mutable cv::cuda::GpuMat _gpu_image;
+  mutable bool _gpu_uploaded = false;
+
+  // Conversions of _image made by grayImage and hsvImage, if _gray_made and _hsv_made
+  mutable std::mutex _derived_mtx;
+  mutable cv::Mat _gray_image;
+  mutable cv::Mat _hsv_image;
+  mutable bool _gray_made = false;
+  mutable bool _hsv_made = false;
+
   // Points to a camera model object (shared ownership) that stores information about the intrinsic
   // and extrinsic geometry of the camera used to take this image
   cam_model_ptr_t _cam_model_ptr = nullptr;
@@ -170,24 +283,36 @@ private:
 ////// Templated function implementations /////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-// Constructor from ROS image message and ROS pinhole camera model
+// Assignment from ROS image message and ROS pinhole camera model
 template <typename cam_model_ptr_t, typename time_t_, typename img_scalar_t, typename float_t>
-CameraFrame<cam_model_ptr_t, time_t_, img_scalar_t, float_t>::CameraFrame(
-    const sensor_msgs::ImageConstPtr &image_msg_ptr, cam_model_ptr_t &cam_model_ptr, bool is_rectified,
+void CameraFrame<cam_model_ptr_t, time_t_, img_scalar_t, float_t>::assign(
+    const sensor_msgs::ImageConstPtr &image_msg_ptr, const cam_model_ptr_t &cam_model_ptr, bool is_rectified,
     float_t store_at_scale) try
 {
-  // ROS image message decoding
-  cv_bridge::CvImageConstPtr _ros_img_bridge;
+  // A resize must not write into memory _image may share with a message or someone else
+  if (_ros_img_bridge || _image_owner)
+  {
+    _image.release();
+    _image_owner.reset();
+  }
+
+  // ROS image message decoding, sharing the message data since the encoding is the message's own
   std::string encoding = image_msg_ptr->encoding;
   _ros_img_bridge = cv_bridge::toCvShare(image_msg_ptr, encoding);
-  _ros_img_bridge->image.copyTo(_image);
 
-  // Resize image as requested
+  // Resize image as requested, which leaves the message data alone
   if (store_at_scale != 1.0)
   {
-    cv::resize(_image, _image, cv::Size(0, 0), store_at_scale, store_at_scale);
-    this->_img_scale = store_at_scale;
+    cv::resize(_ros_img_bridge->image, _image, cv::Size(0, 0), store_at_scale, store_at_scale);
+    _ros_img_bridge.reset();
+  }
+  else
+  {
+    _image = _ros_img_bridge->image;
   }
+  _gpu_uploaded = false;
+  _gray_made = _hsv_made = false;
+  this->_img_scale = store_at_scale;
 
   // Store ptr to cam model object
   this->_cam_model_ptr = cam_model_ptr;
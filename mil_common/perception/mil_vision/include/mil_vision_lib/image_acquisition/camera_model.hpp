@@ -1,7 +1,13 @@
 #pragma once
 
+#include <image_geometry/pinhole_camera_model.h>
 #include <ros/ros.h>
+#include <sensor_msgs/CameraInfo.h>
 #include <Eigen/Core>
+#include <opencv2/core/core.hpp>
+
+#include <memory>
+#include <vector>
 
 namespace mil_vision
 {
@@ -54,4 +60,45 @@ Eigen::Matrix<T, 3, 4> CameraModel<T>::get_projection_matrix()
   return K * R * aug;
 }
 
+/*
+  Rectification of whole images and of points for one camera, with everything it needs computed once per CameraInfo
+  instead of on every call. Images are remapped with fixed point (CV_16SC2) maps, the fastest cv::remap takes. Points
+  are rectified and unrectified in batches, one OpenCV call for all of them rather than a PinholeCameraModel call per
+  point.
+*/
+class CameraRectifier
+{
+public:
+  // Makes the camera model and maps again if info differs from the one they were made for. Returns true if it did.
+  bool update(const sensor_msgs::CameraInfo &info);
+
+  bool initialized() const
+  {
+    return model_ != nullptr;
+  }
+
+  // A new model is made on each change rather than updating this one, so frames that point to it stay valid
+  const std::shared_ptr<image_geometry::PinholeCameraModel> &model() const
+  {
+    return model_;
+  }
+
+  // raw must be the full resolution of the camera. Reuses rectified's buffer if it is the right size and type.
+  void rectifyImage(const cv::Mat &raw, cv::Mat &rectified, int interpolation = cv::INTER_LINEAR) const;
+
+  // Pixels of the raw image to pixels of the rectified image, like PinholeCameraModel::rectifyPoint
+  void rectifyPoints(const std::vector<cv::Point2f> &raw, std::vector<cv::Point2f> &rectified) const;
+
+  // Pixels of the rectified image to pixels of the raw image, like PinholeCameraModel::unrectifyPoint
+  void unrectifyPoints(const std::vector<cv::Point2f> &rectified, std::vector<cv::Point2f> &raw) const;
+
+private:
+  sensor_msgs::CameraInfo info_;
+  std::shared_ptr<image_geometry::PinholeCameraModel> model_;
+  cv::Mat map1_;
+  cv::Mat map2_;
+  // Rotation from the rectified to the raw camera frame, as a Rodrigues vector for cv::projectPoints
+  cv::Mat unrectify_rotation_;
+};
+
 }  // namespace mil_vision
\ No newline at end of file
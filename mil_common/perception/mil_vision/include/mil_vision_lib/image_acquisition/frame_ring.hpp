@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mil_vision
+{
+template <typename frame_t>
+class FrameRing
+{
+  /*
+      Fixed capacity history of frames, added by a single thread and read by any number of threads without locks.
+      Slots are written in order around the ring. The writer counts the frames it has started adding before it
+      writes a slot, and the frames it has finished adding after. A reader notes how many were finished, reads what
+      it needs, then checks the writer has not started on any slot it used, and tries again if it has. The ring has
+      SPARE_SLOTS more slots than it exposes, so that only happens when the writer gets that many frames ahead of a
+      reader.
+
+      Stamps are kept in their own array, in nanoseconds and in the order the frames were added, so finding a frame
+      by time is a binary search that never touches the frames. Frames must be added in stamp order, and frame_t's
+      stamp() must have toNSec(), like ros::Time.
+  */
+
+public:
+  using FramePtr = std::shared_ptr<frame_t>;
+  using FrameConstPtr = std::shared_ptr<frame_t const>;
+
+  explicit FrameRing(size_t history)
+    : _history(history), _slots(history + SPARE_SLOTS), _stamps(new std::atomic<int64_t>[history + SPARE_SLOTS])
+  {
+  }
+
+  FrameRing(const FrameRing &) = delete;
+
+  // Number of frames that can be read
+  size_t size() const
+  {
+    return std::min<uint64_t>(_finished.load(std::memory_order_acquire), _history);
+  }
+
+  // Number of frames the ring holds on to, including those that can no longer be read
+  size_t slots() const
+  {
+    return _slots.size();
+  }
+
+  // Only to be called from the writing thread
+  void push(const FramePtr &frame)
+  {
+    uint64_t index = _finished.load(std::memory_order_relaxed);
+    _started.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    size_t slot = index % _slots.size();
+    _stamps[slot].store(frame->stamp().toNSec(), std::memory_order_relaxed);
+    std::atomic_store(&_slots[slot], frame);
+    _finished.store(index + 1, std::memory_order_release);
+  }
+
+  // Returns the ith most recent frame, or nullptr if there are not that many
+  FrameConstPtr at(size_t i) const
+  {
+    for (;;)
+    {
+      uint64_t finished = _finished.load(std::memory_order_acquire);
+      if (i >= std::min<uint64_t>(finished, _history))
+        return nullptr;
+      uint64_t index = finished - 1 - i;
+      FrameConstPtr frame = std::atomic_load(&_slots[index % _slots.size()]);
+      if (_unchangedSince(index))
+        return frame;
+    }
+  }
+
+  // Returns the frame with the stamp closest to stamp_ns, preferring the newer one on a tie, or nullptr if there
+  // are no frames. in_range is set to whether stamp_ns is between the oldest and newest stamps.
+  FrameConstPtr closest(int64_t stamp_ns, bool &in_range) const
+  {
+    for (;;)
+    {
+      uint64_t finished = _finished.load(std::memory_order_acquire);
+      uint64_t count = std::min<uint64_t>(finished, _history);
+      if (count == 0)
+      {
+        in_range = false;
+        return nullptr;
+      }
+      uint64_t oldest = finished - count;
+
+      // First frame at or after stamp_ns
+      uint64_t lo = oldest;
+      uint64_t hi = finished;
+      while (lo < hi)
+      {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (_stamp(mid) < stamp_ns)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      uint64_t best = std::min(lo, finished - 1);
+      if (lo > oldest && (lo == finished || stamp_ns - _stamp(lo - 1) < _stamp(lo) - stamp_ns))
+        best = lo - 1;
+      bool range = stamp_ns >= _stamp(oldest) && stamp_ns <= _stamp(finished - 1);
+
+      FrameConstPtr frame = std::atomic_load(&_slots[best % _slots.size()]);
+      if (_unchangedSince(oldest))
+      {
+        in_range = range;
+        return frame;
+      }
+    }
+  }
+
+private:
+  static constexpr size_t SPARE_SLOTS = 4;
+
+  int64_t _stamp(uint64_t index) const
+  {
+    return _stamps[index % _slots.size()].load(std::memory_order_relaxed);
+  }
+
+  // Whether the writer has not started overwriting the frame at index, or any newer one, since they were read
+  bool _unchangedSince(uint64_t index) const
+  {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return _started.load(std::memory_order_relaxed) <= index + _slots.size();
+  }
+
+  size_t _history;
+  std::vector<FramePtr> _slots;
+  std::unique_ptr<std::atomic<int64_t>[]> _stamps;
+
+  // Frames the writer started and finished adding, ever
+  std::atomic<uint64_t> _started{ 0 };
+  std::atomic<uint64_t> _finished{ 0 };
+};
+
+}  // namespace mil_vision
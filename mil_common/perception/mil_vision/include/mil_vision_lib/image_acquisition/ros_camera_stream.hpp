@@ -1,8 +1,13 @@
 #pragma once
 
-#include <boost/circular_buffer.hpp>
+#include <mil_tools/concurrency.hpp>
 #include <mil_tools/mil_tools.hpp>
+#include <mil_tools/trace.hpp>
 #include <mil_vision_lib/image_acquisition/camera_frame_sequence.hpp>
+#include <mil_vision_lib/image_acquisition/frame_ring.hpp>
+#include <mil_vision_lib/image_acquisition/shm_image_ring.hpp>
+
+#include <mil_msgs/ShmImage.h>
 
 #include <image_geometry/pinhole_camera_model.h>
 #include <image_transport/image_transport.h>
@@ -11,8 +16,9 @@
 #include <ros/ros.h>
 
 #include <cmath>
-#include <mutex>
+#include <memory>
 #include <string>
+#include <vector>
 
 // DBG
 #include <iostream>
@@ -32,14 +38,15 @@ public:
   using CamFramePtr = std::shared_ptr<CamFrame>;
   using CamFrameConstPtr = std::shared_ptr<CamFrame const>;
   using CamFrameSequence = CameraFrameSequence<cam_model_ptr_t, img_scalar_t, time_t_, float_t>;
-  using CircularBuffer = boost::circular_buffer<CamFramePtr>;
+  using Ring = FrameRing<CamFrame>;
 
   ///////////////////////////////////////////////////////////////////////////////////////////////
   // Constructors and Destructors ///////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////////////////////////////////////
 
   // Default Constructor
-  ROSCameraStream(ros::NodeHandle nh, size_t buffer_size) : _frame_ptr_circular_buffer(buffer_size), _nh(nh), _it(_nh)
+  ROSCameraStream(ros::NodeHandle nh, size_t buffer_size)
+    : _frame_ring(buffer_size), _frame_pool(_frame_ring.slots() + POOL_SPARE_FRAMES), _nh(nh), _it(_nh)
   {
   }
 
@@ -49,8 +56,10 @@ public:
   // Public Methods /////////////////////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////////////////////////////////////
 
-  // Returns true if the camera stream object has been successfully initialized
-  bool init(std::string &camera_topic);
+  // Returns true if the camera stream object has been successfully initialized. With shared_memory, frames are read
+  // in place from the ring of a publisher on this host using the shm image transport, instead of being sent over
+  // the network. Each frame held then leases a slot of that ring.
+  bool init(std::string &camera_topic, bool shared_memory = false);
 
   // Returns false if an internal error has ocurred or ROS is in the process of shutting down the
   // enclosing node
@@ -59,19 +68,19 @@ public:
     return _ok && ros::ok();
   };
 
-  typename CircularBuffer::iterator begin() const
-  {
-    return _frame_ptr_circular_buffer.begin();
-  }
-
-  typename CircularBuffer::iterator end() const
+  size_t size() const
   {
-    return _frame_ptr_circular_buffer.end();
+    return _frame_ring.size();
   }
 
-  size_t size() const
+  // Bytes of image data held by the ring and its pool, estimated from the latest frame since every pooled frame
+  // keeps a buffer of its size. With shared_memory, most of it is in the publisher's ring.
+  size_t bytes() const
   {
-    return _frame_ptr_circular_buffer.size();
+    CamFrameConstPtr latest = _frame_ring.at(0);
+    if (!latest)
+      return 0;
+    return latest->image().total() * latest->image().elemSize() * _frame_pool.capacity();
   }
 
   cam_model_ptr_t getCameraModelPtr() const
@@ -110,31 +119,34 @@ private:
 
   void _addFrame(CamFramePtr &new_frame_ptr);
 
+  // Returns a frame from the pool, or a new one if the buffer and readers hold every pooled frame
+  CamFramePtr _getPooledFrame();
+
   void _newFrameCb(const sensor_msgs::ImageConstPtr &image_msg_ptr);
 
+  void _newShmFrameCb(const mil_msgs::ShmImageConstPtr &descriptor_ptr);
+
   ///////////////////////////////////////////////////////////////////////////////////////////////
   // Private Members ////////////////////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////////////////////////////////////
 
-  // Container for all included CameraFrame objects
-  CircularBuffer _frame_ptr_circular_buffer;
+  // Container for all included CameraFrame objects, written by the callback thread and read without locks
+  Ring _frame_ring;
+
+  // Frames that go back to the pool, from whichever thread drops them last, to be reused. One more than the ring
+  // holds is needed to add a frame before the oldest is dropped, the rest are for frames readers keep for a while.
+  static constexpr size_t POOL_SPARE_FRAMES = 3;
+  mil_tools::ObjectPool<CamFrame> _frame_pool;
 
   // cv::Ptr to a shared CameraInfo object for all frames in the sequence. If null, it indicates
   // that the Frames have different CameraInfo objects which should be examined individually
   cam_model_ptr_t _cam_model_ptr = nullptr;
 
-  // Time bounds of buffer
-  time_t_ _start_time{};
-  time_t_ _end_time{};
-
   // Shared CameraFrame properties if camera geometry is constant
   int COLS = -1;
   int ROWS = -1;
   mil_vision::PixelType TYPE = mil_vision::PixelType::_UNKNOWN;
 
-  // Mutex for multithreaded access to camera frame data
-  std::mutex _mtx;
-
   // ROS node handle
   ros::NodeHandle _nh;
 
@@ -147,6 +159,10 @@ private:
   // Flexible topic subscription with potential for filtering and chaining
   message_filters::Subscriber<sensor_msgs::Image> img_sub;
 
+  // Subscription to the descriptors of the shm transport, and the ring they describe frames in
+  ros::Subscriber _shm_sub;
+  std::shared_ptr<ShmImageRing> _shm_ring;
+
   // ROS spinner to handle callbacks in a background thread
   ros::AsyncSpinner async_spinner{ 1, &_cb_queue };
 
@@ -166,10 +182,11 @@ private:
 
 // Initializer for when there is an image msg being published w/ a corresponding camera info msg
 template <typename img_scalar_t, typename float_t>
-bool ROSCameraStream<img_scalar_t, float_t>::init(std::string &camera_topic)
+bool ROSCameraStream<img_scalar_t, float_t>::init(std::string &camera_topic, bool shared_memory)
 {
   using mil_tools::operator"" _s;  // convert raw string literal to std::string
   _img_topic = camera_topic;
+  mil_tools::Tracer::instance().configure(ros::NodeHandle("~"));
   bool success = false;
   image_transport::CameraSubscriber cam_sub;
 
@@ -193,7 +210,8 @@ bool ROSCameraStream<img_scalar_t, float_t>::init(std::string &camera_topic)
   };
 
   // Subscribe to both camera topic and camera info topic
-  cam_sub = _it.subscribeCamera(_img_topic, 100, init_lambda);
+  cam_sub = _it.subscribeCamera(_img_topic, 100, init_lambda, ros::VoidPtr(),
+                                image_transport::TransportHints(shared_memory ? "shm" : "raw"));
 
   // The amount of time that we will try to wait for a cb from cam_sub
   ros::WallDuration timeout{ 5, 0 };
@@ -206,12 +224,22 @@ bool ROSCameraStream<img_scalar_t, float_t>::init(std::string &camera_topic)
     ros::spinOnce();
     if (success)
     {
-      // Subscribe to ROS image topic
-      img_sub.subscribe(_nh, _img_topic, 100, ros::TransportHints(), &_cb_queue);
-
-      // Register callback to process frames published on camera img topic
-      auto img_cb = [this](const sensor_msgs::ImageConstPtr &image_msg_ptr) { _newFrameCb(image_msg_ptr); };
-      img_sub.registerCallback(img_cb);
+      if (shared_memory)
+      {
+        // Subscribe to the descriptors the shm image transport publishes
+        _shm_sub = _nh.subscribe(ros::SubscribeOptions::create<mil_msgs::ShmImage>(
+            _img_topic + "/shm", 100, boost::bind(&ROSCameraStream::_newShmFrameCb, this, _1), ros::VoidPtr(),
+            &_cb_queue));
+      }
+      else
+      {
+        // Subscribe to ROS image topic
+        img_sub.subscribe(_nh, _img_topic, 100, ros::TransportHints(), &_cb_queue);
+
+        // Register callback to process frames published on camera img topic
+        auto img_cb = [this](const sensor_msgs::ImageConstPtr &image_msg_ptr) { _newFrameCb(image_msg_ptr); };
+        img_sub.registerCallback(img_cb);
+      }
 
       // Start listening for image messages in a background thread
       async_spinner.start();
@@ -236,28 +264,16 @@ template <typename img_scalar_t, typename float_t>
 typename ROSCameraStream<img_scalar_t, float_t>::CamFrameConstPtr
 ROSCameraStream<img_scalar_t, float_t>::getFrameFromTime(ros::Time desired_time)
 {
-  using mil_tools::operator"" _s;
+  bool in_range = false;
+  CamFrameConstPtr closest_in_time = _frame_ring.closest(desired_time.toNSec(), in_range);
 
   // Check bounds on time
-  if (desired_time < this->_start_time || desired_time > this->_end_time)
+  if (!in_range)
   {
     ROS_WARN_STREAM_THROTTLE_NAMED(1, "ROSCameraStream", "ROSCameraStream: The camera frame you requested is outside "
                                                          "the time range of the buffer.");
     return nullptr;
   }
-
-  CamFrameConstPtr closest_in_time = this->operator[](0);
-  double min_abs_nsec_time_diff = fabs((this->operator[](0)->stamp() - desired_time).toNSec());
-  double abs_nsec_time_diff = -1;
-  for (CamFrameConstPtr frame_ptr : this->_frame_ptr_circular_buffer)
-  {
-    abs_nsec_time_diff = fabs((frame_ptr->stamp() - desired_time).toNSec());
-    if (abs_nsec_time_diff < min_abs_nsec_time_diff)
-    {
-      closest_in_time = frame_ptr;
-      min_abs_nsec_time_diff = abs_nsec_time_diff;
-    }
-  }
   return closest_in_time;
 }
 
@@ -268,45 +284,33 @@ template <typename img_scalar_t, typename float_t>
 typename ROSCameraStream<img_scalar_t, float_t>::CamFrameConstPtr ROSCameraStream<img_scalar_t, float_t>::
 operator[](int i)
 {
-  using mil_tools::operator"" _s;
-
-  // Prevent adding new frames while frames are being accessed
-  _mtx.lock();
-
-  // shared_ptr to a dynamically allocated reference frame object
+  // reverse access for negative indices (ex. [-1] refers to the last element)
+  int size = _frame_ring.size();
   CamFrameConstPtr shared_ptr_to_const_frame;
-
-  try
-  {
-    if (i >= 0)  // regular access for non-negative indices
-    {
-      shared_ptr_to_const_frame = this->_frame_ptr_circular_buffer[i];
-    }
-    else
-    {  // reverse access for negative indices (ex. [-1] refers to the last element)
-      size_t past_last_idx = this->_frame_ptr_circular_buffer.end() - this->_frame_ptr_circular_buffer.begin();  // DBG
-      shared_ptr_to_const_frame = this->_frame_ptr_circular_buffer[past_last_idx + i];                           // DBG
-    }
-  }
-  catch (std::exception &e)
-  {
-    auto err = "ROSCameraStream: The circular buffer index you are trying to acess is out of bounds:\n"_s + e.what();
-    ROS_WARN_THROTTLE_NAMED(1, "ROSCameraStream", err.c_str());
-    _mtx.unlock();
-    return nullptr;
-  }
-
-  _mtx.unlock();
+  if (i >= -size && i < size)
+    shared_ptr_to_const_frame = _frame_ring.at(i >= 0 ? i : size + i);
+  if (!shared_ptr_to_const_frame)
+    ROS_WARN_THROTTLE_NAMED(1, "ROSCameraStream", "ROSCameraStream: The frame index you are trying to acess is out of "
+                                                  "bounds");
   return shared_ptr_to_const_frame;
 }
 
 template <typename img_scalar_t, typename float_t>
 void ROSCameraStream<img_scalar_t, float_t>::_addFrame(CamFramePtr &new_frame_ptr)
 {
-  // Prevent accessing frames while new frames are being added
-  _mtx.lock();
-  this->_frame_ptr_circular_buffer.push_front(new_frame_ptr);
-  _mtx.unlock();
+  // Readers never block this, they retry if it overwrote what they were reading
+  _frame_ring.push(new_frame_ptr);
+}
+
+template <typename img_scalar_t, typename float_t>
+typename ROSCameraStream<img_scalar_t, float_t>::CamFramePtr ROSCameraStream<img_scalar_t, float_t>::_getPooledFrame()
+{
+  CamFramePtr frame_ptr = _frame_pool.acquireShared();
+  if (frame_ptr)
+    return frame_ptr;
+  ROS_WARN_THROTTLE_NAMED(10, "ROSCameraStream", "ROSCameraStream: Readers are holding on to every pooled frame, "
+                                                 "allocating a new one");
+  return std::make_shared<CamFrame>();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -315,23 +319,68 @@ void ROSCameraStream<img_scalar_t, float_t>::_addFrame(CamFramePtr &new_frame_pt
 template <typename img_scalar_t, typename float_t>
 void ROSCameraStream<img_scalar_t, float_t>::_newFrameCb(const sensor_msgs::ImageConstPtr &image_msg_ptr)
 {
+  mil_tools::TraceSpan span("vision.frame", image_msg_ptr->header.stamp);
+
   // Check if the topic name contains the string "rect"
   bool rectified = _img_topic.find(std::string("rect")) != std::string::npos;
 
-  // Create shared pointer to dynamically allocated Camera Frame object constructed from ros img msg
-  CamFramePtr new_frame_ptr{ new CamFrame(image_msg_ptr, this->_cam_model_ptr, rectified, 1.0) };
+  // Reuse a Camera Frame object for the ros img msg, which it shares rather than copies
+  CamFramePtr new_frame_ptr = _getPooledFrame();
+  new_frame_ptr->assign(image_msg_ptr, this->_cam_model_ptr, rectified, 1.0);
 
-  // Add shared pointer to CameraFrame object to the circular buffer
+  // Add shared pointer to CameraFrame object to the ring
   _addFrame(new_frame_ptr);
+}
 
-  // Update the bounding timestamps for the frame sequence
-  this->_start_time = image_msg_ptr->header.stamp;
-  this->_end_time = this->_frame_ptr_circular_buffer.back()->stamp();
+template <typename img_scalar_t, typename float_t>
+void ROSCameraStream<img_scalar_t, float_t>::_newShmFrameCb(const mil_msgs::ShmImageConstPtr &descriptor_ptr)
+{
+  mil_tools::TraceSpan span("vision.frame", descriptor_ptr->header.stamp);
+
+  // A publisher makes a new ring when its images get bigger
+  if (!_shm_ring || _shm_ring->name() != descriptor_ptr->segment)
+  {
+    _shm_ring = ShmImageRing::open(descriptor_ptr->segment);
+    if (!_shm_ring)
+    {
+      ROS_WARN_THROTTLE_NAMED(1, "ROSCameraStream", "ROSCameraStream: Could not open the shared memory ring of %s, "
+                                                    "its publisher must be on this host",
+                              _img_topic.c_str());
+      return;
+    }
+  }
+
+  // Only the encoding the stream's own pixel type has can be used in place
+  int type = cv_bridge::getCvType(descriptor_ptr->encoding);
+  if (type != cv::DataType<img_scalar_t>::type)
+  {
+    ROS_WARN_THROTTLE_NAMED(1, "ROSCameraStream", "ROSCameraStream: Images on %s are %s, which shared memory "
+                                                  "frames can not be converted from",
+                            _img_topic.c_str(), descriptor_ptr->encoding.c_str());
+    return;
+  }
+
+  std::shared_ptr<const uint8_t> data = _shm_ring->acquire(descriptor_ptr->slot, descriptor_ptr->seq);
+  if (!data || size_t(descriptor_ptr->step) * descriptor_ptr->height > _shm_ring->bytes(descriptor_ptr->slot))
+  {
+    ROS_WARN_THROTTLE_NAMED(1, "ROSCameraStream", "ROSCameraStream: A frame was overwritten before it could be read");
+    return;
+  }
+
+  // The frame points into the ring, holding its lease
+  bool rectified = _img_topic.find(std::string("rect")) != std::string::npos;
+  cv::Mat_<img_scalar_t> image(descriptor_ptr->height, descriptor_ptr->width,
+                               reinterpret_cast<img_scalar_t *>(const_cast<uint8_t *>(data.get())),
+                               descriptor_ptr->step);
+  CamFramePtr new_frame_ptr = _getPooledFrame();
+  new_frame_ptr->assign(descriptor_ptr->header, this->_cam_model_ptr, rectified, image, data);
+  _addFrame(new_frame_ptr);
 }
 
 template <typename img_scalar_t, typename float_t>
 ROSCameraStream<img_scalar_t, float_t>::~ROSCameraStream()
 {
+  _shm_sub.shutdown();
   img_sub.unsubscribe();
   _cb_queue.clear();
   _cb_queue.disable();
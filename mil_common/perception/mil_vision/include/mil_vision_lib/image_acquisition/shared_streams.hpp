@@ -0,0 +1,41 @@
+#pragma once
+
+#include <mil_vision_lib/image_acquisition/stereo_camera_stream.hpp>
+
+#include <ros/ros.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <typeinfo>
+
+namespace mil_vision
+{
+/*
+  Streams shared by every detector of a process that reads the same cameras, so that detectors loaded into one
+  perception host subscribe to, rectify and convert each frame once rather than once each. A stream is made by the
+  first detector to ask for it and lives as long as any detector holds it, so unloading the last one using a camera
+  drops its subscriptions. Frames are shared read-only, along with what CameraFrame derives from them.
+*/
+
+// The object registered under key in this process, or the one make returns, registered under key until it is freed
+std::shared_ptr<void> sharedObject(const std::string &key, const std::function<std::shared_ptr<void>()> &make);
+
+// The stream of the pair of image topics, resolved in nh. One made here keeps the history and max_sync_error of the
+// first caller, and subscribes with its nh.
+template <typename img_scalar_t = uint8_t, typename float_t = float>
+std::shared_ptr<StereoCameraStream<img_scalar_t, float_t>>
+sharedStereoCameraStream(ros::NodeHandle nh, const std::string &left_image_topic, const std::string &right_image_topic,
+                         double max_sync_error, size_t history)
+{
+  using Stream = StereoCameraStream<img_scalar_t, float_t>;
+  const std::string key = std::string(typeid(Stream).name()) + " " + nh.resolveName(left_image_topic) + " " +
+                          nh.resolveName(right_image_topic);
+  return std::static_pointer_cast<Stream>(sharedObject(key, [&]() {
+    std::shared_ptr<Stream> stream = std::make_shared<Stream>(nh, history);
+    stream->init(left_image_topic, right_image_topic, max_sync_error);
+    return std::shared_ptr<void>(stream);
+  }));
+}
+
+}  // namespace mil_vision
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+namespace mil_vision
+{
+class ShmImageRing : public std::enable_shared_from_this<ShmImageRing>
+{
+  /*
+      Ring of image buffers in a shared memory segment, written by one publishing process and read in place by any
+      number of processes on the same host. Only a small descriptor of each image has to be sent to subscribers.
+
+      Each slot has a count of the images written to the ring before the one it holds, and a count of the readers
+      leasing it. A reader adds itself to the readers, then checks the slot still holds the image it was told about.
+      The writer marks a slot as being written, then checks nobody leases it, and skips it if someone does. Both
+      store before they load, so either the reader sees the slot changed or the writer sees the lease. A leased slot
+      is never overwritten, so leases should be given back, as the shared_ptrs acquire returns do when the last copy
+      of one goes. A slot leased by a process that died stays leased until the publisher makes a new ring.
+  */
+
+public:
+  // Publisher side. Makes a new segment, replacing one of the same name.
+  static std::shared_ptr<ShmImageRing> create(const std::string &name, uint32_t slots, size_t slot_bytes)
+  {
+    using namespace boost::interprocess;
+    shared_memory_object::remove(name.c_str());
+    std::shared_ptr<ShmImageRing> ring(new ShmImageRing(name, true));
+    ring->_shm = shared_memory_object(create_only, name.c_str(), read_write);
+    ring->_shm.truncate(segmentBytes(slots, slot_bytes));
+    ring->_region = mapped_region(ring->_shm, read_write);
+    Header *header = new (ring->_region.get_address()) Header;
+    header->slots = slots;
+    header->slot_bytes = slot_bytes;
+    for (uint32_t i = 0; i < slots; i++)
+      new (ring->_slot(i)) Slot{ { EMPTY }, { 0 }, 0 };
+    header->magic.store(MAGIC, std::memory_order_release);
+    return ring;
+  }
+
+  // Subscriber side. Returns nullptr if there is no such ring.
+  static std::shared_ptr<ShmImageRing> open(const std::string &name)
+  {
+    using namespace boost::interprocess;
+    try
+    {
+      std::shared_ptr<ShmImageRing> ring(new ShmImageRing(name, false));
+      ring->_shm = shared_memory_object(open_only, name.c_str(), read_write);
+      ring->_region = mapped_region(ring->_shm, read_write);
+      const Header *header = ring->_header();
+      if (ring->_region.get_size() < sizeof(Header) || header->magic.load(std::memory_order_acquire) != MAGIC ||
+          ring->_region.get_size() < segmentBytes(header->slots, header->slot_bytes))
+        return nullptr;
+      return ring;
+    }
+    catch (interprocess_exception &e)
+    {
+      return nullptr;
+    }
+  }
+
+  // Name for a ring of images published on a topic by this process, different for every generation of it
+  static std::string segmentName(const std::string &topic, unsigned int generation)
+  {
+    std::string name = "mil_shm_image";
+    for (char c : topic)
+      name += (c == '/') ? '_' : c;
+    return name + "_" + std::to_string(getpid()) + "_" + std::to_string(generation);
+  }
+
+  ShmImageRing(const ShmImageRing &) = delete;
+
+  ~ShmImageRing()
+  {
+    if (_owner)
+      boost::interprocess::shared_memory_object::remove(_name.c_str());
+  }
+
+  const std::string &name() const
+  {
+    return _name;
+  }
+
+  uint32_t slots() const
+  {
+    return _header()->slots;
+  }
+
+  size_t slotBytes() const
+  {
+    return _header()->slot_bytes;
+  }
+
+  // Publisher side. Copies an image into a slot nobody leases, setting the slot and seq to describe it with.
+  // Returns false if the image does not fit or every slot is leased.
+  bool write(const uint8_t *data, size_t bytes, uint32_t &slot, uint64_t &seq)
+  {
+    Header *header = _header();
+    if (bytes > header->slot_bytes)
+      return false;
+    const uint64_t written = header->written.load(std::memory_order_relaxed);
+    for (uint32_t tried = 0; tried < header->slots; tried++)
+    {
+      uint32_t index = (_next_slot + tried) % header->slots;
+      Slot *s = _slot(index);
+      if (s->readers.load() != 0)
+        continue;
+      uint64_t previous = s->seq.load(std::memory_order_relaxed);
+      s->seq.store(WRITING);
+      if (s->readers.load() != 0)
+      {
+        s->seq.store(previous);
+        continue;
+      }
+      std::memcpy(_data(index), data, bytes);
+      s->bytes = bytes;
+      s->seq.store(written, std::memory_order_release);
+      header->written.store(written + 1, std::memory_order_relaxed);
+      _next_slot = (index + 1) % header->slots;
+      slot = index;
+      seq = written;
+      return true;
+    }
+    return false;
+  }
+
+  // Subscriber side. Leases the slot if it still holds image seq, returning its data, or nullptr if it does not.
+  // The lease, and this ring's mapping, are kept until the last copy of the returned pointer goes.
+  std::shared_ptr<const uint8_t> acquire(uint32_t slot, uint64_t seq)
+  {
+    if (slot >= _header()->slots)
+      return nullptr;
+    Slot *s = _slot(slot);
+    s->readers.fetch_add(1);
+    if (s->seq.load() != seq)
+    {
+      s->readers.fetch_sub(1);
+      return nullptr;
+    }
+    std::shared_ptr<ShmImageRing> self = shared_from_this();
+    return std::shared_ptr<const uint8_t>(_data(slot), [self, s](const uint8_t *) { s->readers.fetch_sub(1); });
+  }
+
+  // Bytes of the image in a slot, valid while it is leased
+  size_t bytes(uint32_t slot) const
+  {
+    return _slot(slot)->bytes;
+  }
+
+private:
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+                "Atomics shared between processes have to be lock free");
+
+  static constexpr uint32_t MAGIC = 0x53484d49;  // "SHMI"
+  static constexpr uint64_t EMPTY = UINT64_MAX;
+  static constexpr uint64_t WRITING = UINT64_MAX - 1;
+  static constexpr size_t ALIGN = 64;
+
+  struct Header
+  {
+    std::atomic<uint32_t> magic{ 0 };  // set last, once the rest is ready
+    uint32_t slots;
+    uint64_t slot_bytes;
+    std::atomic<uint64_t> written{ 0 };
+  };
+
+  struct Slot
+  {
+    std::atomic<uint64_t> seq;  // of the image held, or EMPTY or WRITING
+    std::atomic<int32_t> readers;
+    uint64_t bytes;
+  };
+
+  static size_t aligned(size_t bytes)
+  {
+    return (bytes + ALIGN - 1) / ALIGN * ALIGN;
+  }
+
+  static size_t slotStride(size_t slot_bytes)
+  {
+    return aligned(sizeof(Slot)) + aligned(slot_bytes);
+  }
+
+  static size_t segmentBytes(uint32_t slots, size_t slot_bytes)
+  {
+    return aligned(sizeof(Header)) + slots * slotStride(slot_bytes);
+  }
+
+  ShmImageRing(const std::string &name, bool owner) : _name(name), _owner(owner)
+  {
+  }
+
+  Header *_header() const
+  {
+    return static_cast<Header *>(_region.get_address());
+  }
+
+  Slot *_slot(uint32_t index) const
+  {
+    uint8_t *base = static_cast<uint8_t *>(_region.get_address()) + aligned(sizeof(Header));
+    return reinterpret_cast<Slot *>(base + index * slotStride(_header()->slot_bytes));
+  }
+
+  uint8_t *_data(uint32_t index) const
+  {
+    return reinterpret_cast<uint8_t *>(_slot(index)) + aligned(sizeof(Slot));
+  }
+
+  std::string _name;
+  bool _owner;
+  boost::interprocess::shared_memory_object _shm;
+  boost::interprocess::mapped_region _region;
+  uint32_t _next_slot = 0;  // publisher side
+};
+
+}  // namespace mil_vision
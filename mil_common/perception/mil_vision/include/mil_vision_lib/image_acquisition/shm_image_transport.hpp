@@ -0,0 +1,57 @@
+#pragma once
+
+#include <mil_msgs/ShmImage.h>
+#include <mil_vision_lib/image_acquisition/shm_image_ring.hpp>
+
+#include <image_transport/simple_publisher_plugin.h>
+#include <image_transport/simple_subscriber_plugin.h>
+
+#include <memory>
+#include <string>
+
+namespace mil_vision
+{
+/*
+    image_transport plugins for the "shm" transport, for publishers and subscribers on the same host. Images go
+    into a ShmImageRing and only a mil_msgs/ShmImage descriptor of each is sent, so publishing big images to many
+    subscribers costs a single copy. Subscribers use it by setting their ~image_transport parameter to shm.
+
+    The publisher's ~<topic>/shm/slots parameter sets how many images the ring holds (default 32). That has to be
+    more than all subscribers on the host lease at once, or images are dropped until leases are given back.
+*/
+
+class ShmPublisher : public image_transport::SimplePublisherPlugin<mil_msgs::ShmImage>
+{
+public:
+  virtual std::string getTransportName() const
+  {
+    return "shm";
+  }
+
+protected:
+  virtual void publish(const sensor_msgs::Image &message, const PublishFn &publish_fn) const;
+
+private:
+  // Made on the first image and again for a bigger one, so plugin's const publish has to change them
+  mutable std::shared_ptr<ShmImageRing> _ring;
+  mutable unsigned int _generation = 0;
+};
+
+class ShmSubscriber : public image_transport::SimpleSubscriberPlugin<mil_msgs::ShmImage>
+{
+public:
+  virtual std::string getTransportName() const
+  {
+    return "shm";
+  }
+
+protected:
+  // Copies each image out of the ring once, since image_transport hands subscribers sensor_msgs::Images.
+  // ROSCameraStream can instead use the ring in place.
+  virtual void internalCallback(const mil_msgs::ShmImageConstPtr &message, const Callback &user_cb);
+
+private:
+  std::shared_ptr<ShmImageRing> _ring;
+};
+
+}  // namespace mil_vision
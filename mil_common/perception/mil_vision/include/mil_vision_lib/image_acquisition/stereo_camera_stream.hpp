@@ -0,0 +1,296 @@
+#pragma once
+
+#include <mil_vision_lib/image_acquisition/camera_frame.hpp>
+#include <mil_vision_lib/image_acquisition/camera_model.hpp>
+
+#include <image_geometry/pinhole_camera_model.h>
+#include <image_transport/camera_common.h>
+#include <message_filters/subscriber.h>
+#include <message_filters/sync_policies/approximate_time.h>
+#include <message_filters/synchronizer.h>
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <boost/circular_buffer.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mil_vision
+{
+template <typename img_scalar_t = uint8_t, typename float_t = float>
+class StereoCameraStream
+{
+  /*
+      Frames from the left and right cameras of a stereo pair, matched as they arrive by approximate time
+      synchronization of both image and camera info topics. Unless the image topics are already rectified, images are
+      rectified with maps that are computed once per camera info, so every pair is ready to use. The most recent pairs
+      are kept, and callers can wait for the next one instead of polling two streams and discarding frames that
+      don't match.
+  */
+  using cam_model_ptr_t = std::shared_ptr<image_geometry::PinholeCameraModel>;
+  using time_t_ = ros::Time;
+
+public:
+  // Type aliases
+  using CamFrame = CameraFrame<cam_model_ptr_t, img_scalar_t, time_t_, float_t>;
+  using CamFramePtr = std::shared_ptr<CamFrame>;
+  using CamFrameConstPtr = std::shared_ptr<CamFrame const>;
+
+  // Rectified frames from both cameras, taken within max_sync_error of each other, or two nullptrs
+  struct StereoPair
+  {
+    CamFrameConstPtr left;
+    CamFrameConstPtr right;
+
+    time_t_ stamp() const
+    {
+      return left->stamp();
+    }
+  };
+
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+  // Constructors and Destructors ///////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+
+  StereoCameraStream(ros::NodeHandle nh, size_t history) : _pairs(history), _nh(nh)
+  {
+    _frame_pool.reserve(2 * (history + POOL_SPARE_PAIRS));
+  }
+
+  ~StereoCameraStream();
+
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+  // Public Methods /////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+
+  // Subscribes to both image topics and the camera info topics next to them. Pairs are made in a background thread
+  // from then on. max_sync_error is the most, in seconds, that the stamps of a pair may differ by.
+  bool init(const std::string &left_image_topic, const std::string &right_image_topic, double max_sync_error);
+
+  // Returns false if not initialized or ROS is in the process of shutting down the enclosing node
+  bool ok()
+  {
+    return _ok && ros::ok();
+  }
+
+  size_t size()
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    return _pairs.size();
+  }
+
+  // Returns the ith most recent pair, so stereo_stream[0] is the newest
+  StereoPair operator[](size_t i);
+
+  // Blocks until there is a pair stamped after the given time, or timeout passes. Returns false on timeout.
+  bool waitForPair(StereoPair &pair, time_t_ after, ros::WallDuration timeout);
+
+private:
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+  // Private Types and Methods //////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+
+  using SyncPolicy = message_filters::sync_policies::ApproximateTime<sensor_msgs::Image, sensor_msgs::CameraInfo,
+                                                                      sensor_msgs::Image, sensor_msgs::CameraInfo>;
+
+  CamFramePtr _makeFrame(const sensor_msgs::ImageConstPtr &image_msg_ptr, const CameraRectifier &rectifier);
+
+  void _pairCb(const sensor_msgs::ImageConstPtr &left_image, const sensor_msgs::CameraInfoConstPtr &left_info,
+               const sensor_msgs::ImageConstPtr &right_image, const sensor_msgs::CameraInfoConstPtr &right_info);
+
+  // Returns a frame from the pool that no pair still holds, creating one if the pool is not full yet
+  CamFramePtr _getPooledFrame();
+
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+  // Private Members ////////////////////////////////////////////////////////////////////////////
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+
+  // Most recent pairs first, and the mutex and condition readers wait on for new ones
+  boost::circular_buffer<StereoPair> _pairs;
+  std::mutex _mtx;
+  std::condition_variable _new_pair;
+
+  // Frames of both cameras, reused once no pair holds them anymore
+  static constexpr size_t POOL_SPARE_PAIRS = 3;
+  std::vector<CamFramePtr> _frame_pool;
+
+  // Camera model and rectification maps of each camera, for the last camera info that differed from the one before
+  CameraRectifier _left_rectifier;
+  CameraRectifier _right_rectifier;
+
+  // Set if the image topics are already rectified
+  bool _rectified = false;
+
+  // ROS node handle
+  ros::NodeHandle _nh;
+
+  // Custom ROS Callback Queue, and the spinner that handles it in a background thread
+  ros::CallbackQueue _cb_queue;
+  ros::AsyncSpinner async_spinner{ 1, &_cb_queue };
+
+  message_filters::Subscriber<sensor_msgs::Image> _left_image_sub;
+  message_filters::Subscriber<sensor_msgs::CameraInfo> _left_info_sub;
+  message_filters::Subscriber<sensor_msgs::Image> _right_image_sub;
+  message_filters::Subscriber<sensor_msgs::CameraInfo> _right_info_sub;
+  std::unique_ptr<message_filters::Synchronizer<SyncPolicy>> _sync;
+
+  // Status Flag
+  bool _ok = false;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+////// Templated function implementations /////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename img_scalar_t, typename float_t>
+bool StereoCameraStream<img_scalar_t, float_t>::init(const std::string &left_image_topic,
+                                                     const std::string &right_image_topic, double max_sync_error)
+{
+  // Same convention as ROSCameraStream
+  _rectified = left_image_topic.find("rect") != std::string::npos;
+
+  _left_image_sub.subscribe(_nh, left_image_topic, 10, ros::TransportHints(), &_cb_queue);
+  _left_info_sub.subscribe(_nh, image_transport::getCameraInfoTopic(left_image_topic), 10, ros::TransportHints(),
+                           &_cb_queue);
+  _right_image_sub.subscribe(_nh, right_image_topic, 10, ros::TransportHints(), &_cb_queue);
+  _right_info_sub.subscribe(_nh, image_transport::getCameraInfoTopic(right_image_topic), 10, ros::TransportHints(),
+                            &_cb_queue);
+
+  SyncPolicy policy(10);
+  policy.setMaxIntervalDuration(ros::Duration(max_sync_error));
+  _sync.reset(new message_filters::Synchronizer<SyncPolicy>(policy, _left_image_sub, _left_info_sub,
+                                                            _right_image_sub, _right_info_sub));
+  _sync->registerCallback(boost::bind(&StereoCameraStream::_pairCb, this, _1, _2, _3, _4));
+
+  // Start pairing frames in a background thread
+  async_spinner.start();
+  _ok = true;
+  return _ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename img_scalar_t, typename float_t>
+typename StereoCameraStream<img_scalar_t, float_t>::StereoPair StereoCameraStream<img_scalar_t, float_t>::
+operator[](size_t i)
+{
+  std::lock_guard<std::mutex> lock(_mtx);
+  if (i >= _pairs.size())
+  {
+    ROS_WARN_THROTTLE_NAMED(1, "StereoCameraStream", "StereoCameraStream: The pair index you are trying to acess is "
+                                                     "out of bounds");
+    return StereoPair();
+  }
+  return _pairs[i];
+}
+
+template <typename img_scalar_t, typename float_t>
+bool StereoCameraStream<img_scalar_t, float_t>::waitForPair(StereoPair &pair, time_t_ after,
+                                                            ros::WallDuration timeout)
+{
+  std::unique_lock<std::mutex> lock(_mtx);
+  bool got_pair = _new_pair.wait_for(lock, std::chrono::nanoseconds(timeout.toNSec()),
+                                     [&] { return !_pairs.empty() && _pairs.front().stamp() > after; });
+  if (got_pair)
+    pair = _pairs.front();
+  return got_pair;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename img_scalar_t, typename float_t>
+typename StereoCameraStream<img_scalar_t, float_t>::CamFramePtr
+StereoCameraStream<img_scalar_t, float_t>::_makeFrame(const sensor_msgs::ImageConstPtr &image_msg_ptr,
+                                                      const CameraRectifier &rectifier)
+{
+  CamFramePtr frame_ptr = _getPooledFrame();
+  if (_rectified)
+  {
+    // Already rectified, so the frame can share the message data
+    frame_ptr->assign(image_msg_ptr, rectifier.model(), true, 1.0);
+    return frame_ptr;
+  }
+  try
+  {
+    cv_bridge::CvImageConstPtr raw = cv_bridge::toCvShare(image_msg_ptr, image_msg_ptr->encoding);
+    frame_ptr->assign(image_msg_ptr->header, rectifier.model(), true,
+                      [&](cv::Mat_<img_scalar_t> &out) { rectifier.rectifyImage(raw->image, out); });
+  }
+  catch (cv_bridge::Exception &e)
+  {
+    ROS_WARN_THROTTLE_NAMED(1, "StereoCameraStream", "Error converting sensor_msgs::ImageConstPtr to cv::Mat.");
+    return nullptr;
+  }
+  catch (cv::Exception &e)
+  {
+    ROS_WARN_THROTTLE_NAMED(1, "StereoCameraStream", "Error rectifying image: %s", e.what());
+    return nullptr;
+  }
+  return frame_ptr;
+}
+
+template <typename img_scalar_t, typename float_t>
+void StereoCameraStream<img_scalar_t, float_t>::_pairCb(const sensor_msgs::ImageConstPtr &left_image,
+                                                        const sensor_msgs::CameraInfoConstPtr &left_info,
+                                                        const sensor_msgs::ImageConstPtr &right_image,
+                                                        const sensor_msgs::CameraInfoConstPtr &right_info)
+{
+  _left_rectifier.update(*left_info);
+  _right_rectifier.update(*right_info);
+
+  StereoPair pair;
+  pair.left = _makeFrame(left_image, _left_rectifier);
+  pair.right = _makeFrame(right_image, _right_rectifier);
+  if (!pair.left || !pair.right)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _pairs.push_front(pair);
+  }
+  _new_pair.notify_all();
+}
+
+template <typename img_scalar_t, typename float_t>
+typename StereoCameraStream<img_scalar_t, float_t>::CamFramePtr
+StereoCameraStream<img_scalar_t, float_t>::_getPooledFrame()
+{
+  // Frames only get into pairs from this thread and readers only get them from pairs, so a frame held by the pool
+  // alone stays that way until it is used again
+  for (CamFramePtr &frame_ptr : _frame_pool)
+  {
+    if (frame_ptr.use_count() == 1)
+      return frame_ptr;
+  }
+  CamFramePtr new_frame_ptr = std::make_shared<CamFrame>();
+  if (_frame_pool.size() < _frame_pool.capacity())
+    _frame_pool.push_back(new_frame_ptr);
+  else
+    ROS_WARN_THROTTLE_NAMED(10, "StereoCameraStream", "StereoCameraStream: Readers are holding on to every pooled "
+                                                      "frame, allocating a new one");
+  return new_frame_ptr;
+}
+
+template <typename img_scalar_t, typename float_t>
+StereoCameraStream<img_scalar_t, float_t>::~StereoCameraStream()
+{
+  async_spinner.stop();
+  _left_image_sub.unsubscribe();
+  _left_info_sub.unsubscribe();
+  _right_image_sub.unsubscribe();
+  _right_info_sub.unsubscribe();
+  _cb_queue.clear();
+  _cb_queue.disable();
+}
+
+}  // namespace mil_vision
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <vector>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -38,4 +39,63 @@ cv::Mat makeRotInvariant(const cv::Mat &kernel, int rotations = 8);
 */
 float getRadialSymmetryAngle(const cv::Mat &kernel, float ang_res = 0.1, bool deg = false);
 
+/*
+  Rotated versions of a kernel for a fixed set of angles, made once so that orientation hypotheses can be evaluated
+  without warping a kernel for each one. Every rotation is kept as CV_32F on the same square canvas, big enough for
+  the kernel at any angle, as rotateKernel makes without no_expand.
+  kernel - original kernel
+  rotations - number of angles, uniformly spread over [0, max_angle). Positive angles --> counterclockwise.
+  max_angle - OPTIONAL. In radians, for kernels with a radial symmetry angle smaller than a full turn.
+*/
+class RotatedKernelBank
+{
+public:
+  RotatedKernelBank(const cv::Mat &kernel, int rotations, float max_angle = 2 * mil_tools::PI);
+
+  size_t size() const
+  {
+    return _kernels.size();
+  }
+
+  // Angle in radians of rotation i
+  float angle(size_t i) const
+  {
+    return _angles[i];
+  }
+
+  const cv::Mat &kernel(size_t i) const
+  {
+    return _kernels[i];
+  }
+
+  // Index of the rotation closest to theta radians
+  size_t nearest(float theta) const;
+
+  // Average of all the rotations, invariant to rotations by multiples of max_angle / rotations
+  cv::Mat mean() const;
+
+  /*
+    Correlates src with every rotation, as cv::filter2D would with each kernel, into CV_32F responses[i].
+    use_dft - OPTIONAL. Transforms src once and multiplies its spectrum by the cached spectrum of each rotation,
+      instead of filtering spatially with each one. Much faster once kernels are more than a few pixels across.
+    The spectra are cached for the last padded image size, so apply should not be called on one bank from several
+    threads at once.
+  */
+  void apply(const cv::Mat &src, std::vector<cv::Mat> &responses, bool use_dft = true) const;
+
+  /*
+    Strongest response over all the rotations at each pixel, into CV_32F max_response, and the index of the rotation
+    it came from into CV_32S best_rotation.
+  */
+  void applyMax(const cv::Mat &src, cv::Mat &max_response, cv::Mat &best_rotation, bool use_dft = true) const;
+
+private:
+  std::vector<cv::Mat> _kernels;
+  std::vector<float> _angles;
+  float _max_angle;
+
+  mutable cv::Size _spectra_size;
+  mutable std::vector<cv::Mat> _spectra;
+};
+
 }  // namespace mil_vision
@@ -3,8 +3,14 @@
 #include <pcl/point_types.h>
 #include <pcl_ros/point_cloud.h>
 #include <ros/ros.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 
 namespace mil_vision
 {
@@ -14,6 +20,10 @@ class PcdSubPubAlgorithm
   /*
     virtual base class for algorithms that subscribe to point cloud ROS topics,
     operate on the clouds and publish output clouds to a different topic
+
+    By default _cloud_cb runs on the subscriber callback. After startWorker it runs on a thread of its own instead,
+    fed by a bounded queue, so spinning is never blocked by an algorithm and clouds that arrive while it is busy are
+    queued rather than lost, up to the queue size.
   */
 
 public:
@@ -21,18 +31,41 @@ public:
   template <typename T = pcl::PointXYZ>
   using PCD = pcl::PointCloud<T>;
 
+  // What to do with a cloud that arrives while the worker's queue is full
+  enum class DropPolicy
+  {
+    DROP_OLDEST,  // discard the oldest queued cloud, so the latest cloud is always processed
+    DROP_NEWEST   // discard the arriving cloud, processing clouds in the order they came
+  };
+
+  // Per-cloud timing, over every cloud since the algorithm started
+  struct Stats
+  {
+    size_t processed = 0;
+    size_t dropped = 0;
+    double mean_process_ms = 0;  // time spent in _cloud_cb
+    double max_process_ms = 0;
+    double mean_wait_ms = 0;  // time from arrival to _cloud_cb, only non zero with a worker
+    double max_wait_ms = 0;
+  };
+
   // Constructors and Destructors
 
   PcdSubPubAlgorithm(ros::NodeHandle nh, std::string input_pcd_topic, std::string output_pcd_topic)
     : _nh(nh), _input_pcd_topic(input_pcd_topic), _output_pcd_topic(output_pcd_topic)
   {
     // Subscribe to point cloud topic
-    _cloud_sub = _nh.subscribe<PCD<input_T>>(_input_pcd_topic, 1, &PcdSubPubAlgorithm::_cloud_cb, this);
+    _cloud_sub = _nh.subscribe<PCD<input_T>>(_input_pcd_topic, 1, &PcdSubPubAlgorithm::_receive, this);
 
     // Advertise output topic
     _cloud_pub = _nh.advertise<PCD<output_T>>(_output_pcd_topic, 1, true);
   }
 
+  virtual ~PcdSubPubAlgorithm()
+  {
+    stopWorker();
+  }
+
   // Check status methods
 
   bool activated()
@@ -45,6 +78,12 @@ public:
     return _ok && ros::ok();
   }
 
+  Stats stats()
+  {
+    std::lock_guard<std::mutex> lock(_queue_mtx);
+    return _stats;
+  }
+
   // Set status methods
 
   void switchActivation()
@@ -52,12 +91,46 @@ public:
     _active = !_active;
   }
 
+  // Runs _cloud_cb on a worker thread from now on, with up to queue_size clouds waiting for it
+  void startWorker(size_t queue_size = 1, DropPolicy drop_policy = DropPolicy::DROP_OLDEST)
+  {
+    stopWorker();
+    std::lock_guard<std::mutex> lock(_queue_mtx);
+    _queue_size = std::max<size_t>(queue_size, 1);
+    _drop_policy = drop_policy;
+    _stop_worker = false;
+    _worker_running = true;
+    _worker = std::thread(&PcdSubPubAlgorithm::_work, this);
+  }
+
+  // Waits for the cloud being processed and drops the queued ones. The worker calls into the derived class, so a
+  // derived class that started it must stop it in its own destructor.
+  void stopWorker()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_queue_mtx);
+      _stop_worker = true;
+      _worker_running = false;
+      _stats.dropped += _queue.size();
+      _queue.clear();
+    }
+    _queue_cv.notify_all();
+    if (_worker.joinable())
+      _worker.join();
+  }
+
 protected:
   // runs algorithm pipeline when a new pcd msg is received
   // virtual void cloud_cb(const typename PCD<input_T>::ConstPtr &cloud_msg) = 0;  // runs algorithm pipeline when a new
   // pcd msg is received
   virtual void _cloud_cb(const typename PCD<input_T>::ConstPtr &cloud_msg) = 0;
 
+  // Publishes _output_pcd2, which keeps its buffers for the next cloud as long as it is cleared rather than replaced
+  void _publishOutput()
+  {
+    _cloud_pub.publish(_output_pcd2);
+  }
+
   // Subscribing and storing input
   ros::NodeHandle _nh;
   std::string _input_pcd_topic;
@@ -75,6 +148,81 @@ protected:
   // Error flag
   bool _ok = false;
   std::string _err_msg;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Queued
+  {
+    typename PCD<input_T>::ConstPtr cloud;
+    Clock::time_point arrival;
+  };
+
+  void _receive(const typename PCD<input_T>::ConstPtr &cloud_msg)
+  {
+    Queued queued{ cloud_msg, Clock::now() };
+    {
+      std::lock_guard<std::mutex> lock(_queue_mtx);
+      if (_worker_running)
+      {
+        if (_queue.size() >= _queue_size)
+        {
+          ++_stats.dropped;
+          if (_drop_policy == DropPolicy::DROP_NEWEST)
+            return;
+          _queue.pop_front();
+        }
+        _queue.push_back(queued);
+        _queue_cv.notify_one();
+        return;
+      }
+    }
+    _process(queued);
+  }
+
+  void _work()
+  {
+    std::unique_lock<std::mutex> lock(_queue_mtx);
+    while (true)
+    {
+      _queue_cv.wait(lock, [this] { return _stop_worker || !_queue.empty(); });
+      if (_stop_worker)
+        return;
+      Queued queued = _queue.front();
+      _queue.pop_front();
+      lock.unlock();
+      _process(queued);
+      lock.lock();
+    }
+  }
+
+  void _process(const Queued &queued)
+  {
+    Clock::time_point start = Clock::now();
+    _cloud_cb(queued.cloud);
+    Clock::time_point end = Clock::now();
+
+    double wait_ms = std::chrono::duration<double, std::milli>(start - queued.arrival).count();
+    double process_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::lock_guard<std::mutex> lock(_queue_mtx);
+    ++_stats.processed;
+    _stats.mean_process_ms += (process_ms - _stats.mean_process_ms) / _stats.processed;
+    _stats.max_process_ms = std::max(_stats.max_process_ms, process_ms);
+    _stats.mean_wait_ms += (wait_ms - _stats.mean_wait_ms) / _stats.processed;
+    _stats.max_wait_ms = std::max(_stats.max_wait_ms, wait_ms);
+  }
+
+  // Clouds waiting for the worker, guarded by _queue_mtx along with the settings of the worker and _stats
+  std::deque<Queued> _queue;
+  std::mutex _queue_mtx;
+  std::condition_variable _queue_cv;
+  size_t _queue_size = 1;
+  DropPolicy _drop_policy = DropPolicy::DROP_OLDEST;
+  bool _stop_worker = false;
+  bool _worker_running = false;
+  // Only started and joined by startWorker and stopWorker
+  std::thread _worker;
+  Stats _stats;
 };
 
-}  // namespace mil_vision
\ No newline at end of file
+}  // namespace mil_vision
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+#include <image_geometry/stereo_camera_model.h>
+#include <pcl/point_cloud.h>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/cuda.hpp>
+
+namespace mil_vision
+{
+/*
+  Dense stereo by block matching of only chosen regions of a rectified pair, for a detector that needs depth around
+  what it found rather than a point cloud of the whole image. Each region is cropped with the margins block matching
+  needs and matched on its own, so the cost grows with the region and the disparity range, not the image.
+
+  With OpenCV's cudastereo module and a CUDA device the regions are matched on the GPU, otherwise by cv::StereoBM on
+  the CPU, which also refines disparities to a sixteenth of a pixel.
+*/
+class RoiStereoMatcher
+{
+public:
+  struct Params
+  {
+    // Disparities searched, from 0, a multiple of 16
+    int num_disparities = 128;
+    // Side of the matched blocks, odd
+    int block_size = 15;
+    // Blocks with less texture than this are left without a match
+    int texture_threshold = 10;
+    // Percent the best match must be better than the next by
+    int uniqueness_ratio = 10;
+    bool use_gpu = true;
+  };
+
+  // The image a region is in, and whose pixels the disparities are of
+  enum class Reference
+  {
+    LEFT,
+    RIGHT
+  };
+
+  RoiStereoMatcher();
+  explicit RoiStereoMatcher(Params const &params);
+
+  /*
+    Finds the disparity, left x - right x, of each pixel of roi in the reference image.
+    left, right - rectified images, CV_8UC1 or CV_8UC3 (BGR)
+    roi - clipped to the image, returning false if nothing is left of it
+    disparity - CV_32FC1 of roi's size, NaN where there is no reliable match
+  */
+  bool disparity(const cv::Mat &left, const cv::Mat &right, cv::Rect &roi, Reference reference, cv::Mat &disparity);
+
+  /*
+    Organized cloud of the pixels of roi in the reference image, in that camera's rectified frame, with NaN
+    coordinates where there is no match. Only the coordinates of the points are set.
+  */
+  template <typename PointT>
+  bool cloud(const image_geometry::StereoCameraModel &model, const cv::Mat &left, const cv::Mat &right, cv::Rect roi,
+             Reference reference, pcl::PointCloud<PointT> &cloud);
+
+  bool usingGpu() const
+  {
+    return !gpu_matcher_.empty();
+  }
+
+  Params const &params() const
+  {
+    return params_;
+  }
+
+private:
+  Params params_;
+  cv::Ptr<cv::StereoBM> cpu_matcher_;
+  // A cv::cuda::StereoBM, only made when it can be used
+  cv::Ptr<cv::StereoMatcher> gpu_matcher_;
+  // Grayscale crops of the pair as matched, their raw disparities and the last disparities cloud() converted, reused
+  // between regions. The crops are small, so are made on the CPU and only the matching is done on the GPU.
+  cv::Mat left_crop_, right_crop_, scratch_, raw_disparity_, disparity_;
+  cv::cuda::GpuMat gpu_left_, gpu_right_, gpu_disparity_;
+};
+
+template <typename PointT>
+bool RoiStereoMatcher::cloud(const image_geometry::StereoCameraModel &model, const cv::Mat &left,
+                             const cv::Mat &right, cv::Rect roi, Reference reference, pcl::PointCloud<PointT> &cloud)
+{
+  if (!disparity(left, right, roi, reference, disparity_))
+    return false;
+
+  const image_geometry::PinholeCameraModel &camera = reference == Reference::LEFT ? model.left() : model.right();
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  cloud.width = roi.width;
+  cloud.height = roi.height;
+  cloud.is_dense = false;
+  cloud.points.resize(roi.area());
+  for (int v = 0; v < roi.height; ++v)
+  {
+    const float *d = disparity_.ptr<float>(v);
+    PointT *point = &cloud.points[v * roi.width];
+    for (int u = 0; u < roi.width; ++u, ++point)
+    {
+      const double z = std::isnan(d[u]) ? -1 : model.getZ(d[u]);
+      if (!(z > 0))
+      {
+        point->x = point->y = point->z = nan;
+        continue;
+      }
+      point->x = (roi.x + u - camera.cx()) * z / camera.fx();
+      point->y = (roi.y + v - camera.cy()) * z / camera.fy();
+      point->z = z;
+    }
+  }
+  return true;
+}
+
+}  // namespace mil_vision
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace mil_vision
+{
+/*
+  A correspondence between points of a rectified stereo pair.
+  left - the point in the left image
+  right - its match in the right image, on the same row to within the matcher's row tolerance
+  cost - matching cost, lower is better, or -1 if the point has no reliable match
+*/
+struct SparseStereoMatch
+{
+  cv::Point2f left;
+  cv::Point2f right;
+  int cost = -1;
+
+  bool valid() const
+  {
+    return cost >= 0;
+  }
+  float disparity() const
+  {
+    return left.x - right.x;
+  }
+};
+
+/*
+  Finds depth only at chosen points of a rectified stereo pair, rather than over the whole image like
+  cv::StereoBM does, so it runs at camera rate on full resolution images.
+*/
+class SparseStereoMatcher
+{
+public:
+  virtual ~SparseStereoMatcher() = default;
+
+  /*
+    Finds the match of each of left_points in right. matches gets one entry per point, in the same order, invalid for
+    the points without a reliable match.
+    left, right - rectified images, CV_8UC1 or CV_8UC3 (BGR)
+  */
+  virtual void match(const cv::Mat &left, const cv::Mat &right, const std::vector<cv::Point2f> &left_points,
+                     std::vector<SparseStereoMatch> &matches) = 0;
+
+  /*
+    Picks points of left that can be matched reliably and matches them, for a sparse depth map of the whole pair.
+    Only the valid matches are returned.
+  */
+  virtual void detect_and_match(const cv::Mat &left, const cv::Mat &right, std::vector<SparseStereoMatch> &matches) = 0;
+};
+
+/*
+  Sparse stereo matching by the hamming distance of 5x5 census transforms, as in Schauwecker, Klette and Zell, "A New
+  Feature Detector and Stereo Matching Method for Accurate High-Performance Sparse Stereo Matching", IROS 2012.
+
+  Each point is compared with every candidate on its row of the other image within max_disparity. The census
+  transform makes the cost robust to the two cameras' exposure differing. A match is kept only if it is unique in
+  both directions: no other candidate for the point, nor any other point of the left row for the match, may cost
+  less than the best cost / uniqueness. The disparity is refined to sub-pixel by fitting a parabola to the costs
+  around the best one.
+
+  Census descriptors are only computed for the rows that are matched on, so the cost grows with the number of rows
+  with points rather than with the image size.
+*/
+class CensusStereoMatcher : public SparseStereoMatcher
+{
+public:
+  struct Params
+  {
+    int max_disparity = 128;
+    // Rows above and below a point's own that its match may be on, for a pair that is not perfectly rectified
+    int row_tolerance = 0;
+    // In (0, 1], the smaller the more a match must stand out from the other candidates
+    float uniqueness = 0.7;
+    // Largest hamming distance, out of 24 bits, of a match
+    int max_cost = 8;
+    // cv::FAST threshold for detect_and_match, and the most features it keeps, strongest first
+    int fast_threshold = 20;
+    int max_features = 2000;
+  };
+
+  CensusStereoMatcher();
+  explicit CensusStereoMatcher(Params const &params);
+
+  void match(const cv::Mat &left, const cv::Mat &right, const std::vector<cv::Point2f> &left_points,
+             std::vector<SparseStereoMatch> &matches) override;
+
+  void detect_and_match(const cv::Mat &left, const cv::Mat &right, std::vector<SparseStereoMatch> &matches) override;
+
+  Params const &params() const
+  {
+    return params_;
+  }
+
+private:
+  // Census descriptors of the rows of an image computed so far, for one pair
+  struct CensusImage
+  {
+    cv::Mat gray;
+    cv::Mat_<uint32_t> census;
+    std::vector<uint8_t> computed;
+
+    void reset(const cv::Mat &image);
+    // Descriptors of row y, computing them if needed. Zero within 2 pixels of the image border.
+    const uint32_t *row(int y);
+  };
+
+  void match_points(const std::vector<cv::Point2f> &left_points, std::vector<SparseStereoMatch> &matches);
+  // Matches a point, returning false if it has no reliable match
+  bool match_point(cv::Point const &point, SparseStereoMatch &match);
+
+  Params params_;
+  CensusImage left_;
+  CensusImage right_;
+  // Best cost of each disparity for the point being matched, and the row of the right image it is on
+  std::vector<int> costs_;
+  std::vector<int> cost_rows_;
+};
+
+}  // namespace mil_vision
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <ros/time.h>
+#include <opencv2/core/core.hpp>
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mil_vision
+{
+/*
+  Helpers for benchmarking vision algorithms on recorded images, repeatably and without a running pipeline. A sequence
+  is decoded into memory up front, so reading and decoding are not timed, and the algorithm is driven directly on
+  every frame. VisionBenchmark records how long each named stage of each frame took and writes the per-stage and
+  per-frame statistics, throughput and memory as JSON, so runs can be compared across changes and hardware.
+*/
+
+// Frames of a recorded sequence, in the order they were recorded
+struct ImageSequence
+{
+  std::vector<cv::Mat> frames;
+  std::vector<ros::Time> stamps;
+
+  // Memory the decoded frames take up
+  size_t bytes() const;
+};
+
+// Loads every image of a directory, sorted by file name, or every image on topic of a bag, converted to encoding.
+// At most max_frames are loaded, 0 for all of them. Returns false if no image was loaded.
+bool loadImageSequence(const std::string &path, const std::string &topic, ImageSequence &sequence,
+                       size_t max_frames = 0, const std::string &encoding = "bgr8");
+
+class VisionBenchmark
+{
+public:
+  explicit VisionBenchmark(const std::string &name);
+
+  void startFrame();
+
+  // Runs f as the named stage of the current frame, timing it
+  template <typename F>
+  void stage(const std::string &name, F f)
+  {
+    Clock::time_point start = Clock::now();
+    f();
+    record(name, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+  }
+
+  // Records a stage timed by the algorithm itself, e.g. from StatisticalImageSegmenter::last_timing()
+  void record(const std::string &name, double ms);
+
+  // Ends the current frame, recording the time since startFrame
+  void endFrame();
+
+  // Size of the input, reported alongside the peak memory of the process
+  void setInputBytes(size_t bytes)
+  {
+    _input_bytes = bytes;
+  }
+
+  // Frames, frames per second and mean, median, 95th percentile and max milliseconds of the frames and of each
+  // stage, in the order the stages were first run, and the peak resident memory of the process
+  void writeJson(std::ostream &out) const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Stage
+  {
+    std::string name;
+    std::vector<double> ms;
+  };
+
+  std::string _name;
+  std::vector<Stage> _stages;
+  std::vector<double> _frame_ms;
+  Clock::time_point _frame_start;
+  size_t _input_bytes = 0;
+};
+
+}  // namespace mil_vision
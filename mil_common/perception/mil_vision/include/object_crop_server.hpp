@@ -0,0 +1,83 @@
+#pragma once
+#include <mil_msgs/ObjectCrops.h>
+#include <mil_msgs/PerceptionObjectArray.h>
+#include <mil_vision_lib/image_acquisition/ros_camera_stream.hpp>
+#include <ros/ros.h>
+#include <tf2_ros/transform_listener.h>
+
+#include <Eigen/Geometry>
+#include <opencv2/core/core.hpp>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+  Crops every PCODAR object out of the images of one or more cameras, so a classifier can run on all of them in one
+  batch rather than mission code asking camera_lidar_transformer about each object and cropping images itself.
+
+  Each time the objects are published, the bounding box of every object is projected into the frame of each camera
+  taken closest to the objects' stamp. The bounding rectangle of the projection, padded, is cropped, resized to
+  crop_size x crop_size and stacked with the other crops into one image, published on object_crops with the region
+  and projected hull of each crop. Only objects that moved or changed size since they were last cropped from a camera
+  are cropped from it again, so unchanged objects are not classified over and over.
+
+  Params, in the node's namespace:
+    cameras: rectified image topics, each with its camera_info beside it (["/camera/front/right/image_rect_color"])
+    objects_topic: PerceptionObjectArray topic ("/pcodar/objects")
+    crop_size: side of each crop in pixels (64)
+    padding: fraction of its size added around each object's projection (0.1)
+    min_pixels: projections smaller than this many pixels on a side are skipped (8)
+    pose_tolerance: meters an object must move or change size by to be cropped again (0.2)
+    refresh_period: seconds after which an object is cropped again even if it did not change, 0 for never (0)
+*/
+class ObjectCropServer
+{
+public:
+  ObjectCropServer();
+
+private:
+  using CameraStream = mil_vision::ROSCameraStream<cv::Vec3b>;
+  // An object's position and size when it was last cropped from a camera
+  struct Cropped
+  {
+    Eigen::Vector3d position;
+    Eigen::Vector3d scale;
+    ros::Time stamp;
+    // Objects update counter it was last seen on, to forget removed objects
+    uint64_t seen;
+  };
+  struct Camera
+  {
+    std::string topic;
+    std::unique_ptr<CameraStream> stream;
+    std::unordered_map<uint32_t, Cropped> cropped;
+  };
+
+  void objectsCallback(const mil_msgs::PerceptionObjectArrayConstPtr& objects);
+  // Crop the objects that changed out of camera's frame closest to the objects' stamp, publishing them if any are seen
+  void cropFrom(Camera& camera, const mil_msgs::PerceptionObjectArray& objects);
+  // True if object should be cropped from camera again
+  bool changed(const Camera& camera, const mil_msgs::PerceptionObject& object, const ros::Time& stamp) const;
+  // Project object's bounding box into the image, setting its padded bounding rectangle (clipped to the image) and
+  // convex hull. Returns false if it is behind the camera or too small.
+  bool project(const mil_msgs::PerceptionObject& object, const Eigen::Isometry3d& to_camera,
+               const image_geometry::PinholeCameraModel& model, float image_scale, const cv::Size& image_size,
+               cv::Rect& roi, std::vector<cv::Point2f>& hull) const;
+
+  ros::NodeHandle nh;
+  tf2_ros::Buffer tfBuffer;
+  tf2_ros::TransformListener tfListener;
+  ros::Subscriber objectsSub;
+  ros::Publisher cropsPub;
+  std::vector<Camera> cameras;
+  int crop_size;
+  double padding;
+  int min_pixels;
+  double pose_tolerance;
+  ros::Duration refresh_period;
+  uint64_t updates;
+  // Reused from one update to the next
+  cv::Mat_<cv::Vec3b> batch;
+};
@@ -0,0 +1,259 @@
+#include <mil_vision_lib/active_contours.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace mil_vision;
+
+// Checks the precomputed perturbation routes against the recursive enumeration they replaced, then times evaluating
+// every perturbation of the contours of random synthetic blobs with the chain code curves, against the point list
+// curves they replaced.
+//
+// Usage: benchmark_active_contours [blobs] [seed]
+
+namespace
+{
+typedef map<pair<uint8_t, uint8_t>, vector<vector<uint8_t>>> LegacyCache;
+
+// Border of the 5x5 neighborhood in ring order, as neighborhood indices
+const uint8_t RING_IDXS[Perturbations::RING_SIZE] = { 0, 1, 2, 3, 4, 12, 20, 28, 36, 35, 34, 33, 32, 24, 16, 8 };
+
+// is Perturbations::growRoute as it was before the routes were precomputed, to compare against
+void legacy_grow_route(LegacyCache& cache, const vector<uint8_t>& partial, const vector<uint8_t>& occupied,
+                       uint8_t entry, uint8_t exit)
+{
+  uint8_t tail = (partial.size() == 0) ? entry : partial.back();
+  auto candidates = Perturbations::getHoodIdxs(tail, false);
+  candidates =
+      vector<uint8_t>(candidates.begin(), remove_if(candidates.begin(), candidates.end(), [&occupied](uint8_t x) {
+                        return find(occupied.begin(), occupied.end(), x) != occupied.end();
+                      }));
+
+  auto next_occupied = occupied;
+  for (auto cand : candidates)
+    next_occupied.push_back(cand);
+
+  for (auto new_elem : candidates)
+  {
+    auto next_partial = partial;
+    next_partial.push_back(new_elem);
+
+    auto next_tails = Perturbations::getHoodIdxs(new_elem, true);
+    auto find_exit_itr = find(next_tails.begin(), next_tails.end(), exit);
+    if (find_exit_itr != next_tails.end() && *find_exit_itr != tail)
+    {
+      pair<uint8_t, uint8_t> key;
+      if (entry <= exit)
+        key = make_pair(entry, exit);
+      else
+      {
+        key = make_pair(exit, entry);
+        reverse(next_partial.begin(), next_partial.end());
+      }
+      cache[key].push_back(next_partial);
+    }
+    else
+      legacy_grow_route(cache, next_partial, next_occupied, entry, exit);
+  }
+}
+
+// is initPerturbationCache, for the pairs of ring positions that are not next to each other
+void legacy_init_cache(LegacyCache& cache)
+{
+  for (uint8_t entry = 0; entry < Perturbations::RING_SIZE; entry++)
+  {
+    for (uint8_t exit = entry + 2; exit < Perturbations::RING_SIZE; exit++)
+    {
+      if (exit - entry == Perturbations::RING_SIZE - 1)
+        continue;
+      legacy_grow_route(cache, vector<uint8_t>(), vector<uint8_t>(), RING_IDXS[entry], RING_IDXS[exit]);
+    }
+  }
+}
+
+// is getPerturbations with the cache passed in
+vector<vector<uint8_t>> legacy_get_perturbations(LegacyCache& cache, uint8_t entry, uint8_t exit)
+{
+  auto key = entry <= exit ? make_pair(entry, exit) : make_pair(exit, entry);
+  auto perturbations = cache[key];
+  if (exit < entry)
+    for (auto& route : perturbations)
+      reverse(route.begin(), route.end());
+  return perturbations;
+}
+
+// is Perturbations::perturb, which made a new point list for each perturbation
+vector<cv::Point2i> legacy_perturb(const vector<cv::Point2i>& src_curve, vector<uint8_t> perturbation, int idx)
+{
+  auto pt = src_curve[idx];
+  auto pt_list = Perturbations::getPointList(perturbation);
+  for (auto& pt_elem : pt_list)
+  {
+    pt_elem.x += pt.x;
+    pt_elem.y += pt.y;
+  }
+
+  vector<cv::Point2i> dest(src_curve.begin(), src_curve.begin() + idx - 1);
+  for (auto& pert : pt_list)
+    dest.push_back(pert);
+  auto it = src_curve.begin() + idx + 2;
+  while (it != src_curve.end())
+  {
+    dest.push_back(*it);
+    it++;
+  }
+  return dest;
+}
+
+// Neighborhood index of the offset of a point from the center of the neighborhood, or -1 if it is outside of it
+int hood_idx(const cv::Point2i& offset)
+{
+  if (abs(offset.x) > 2 || abs(offset.y) > 2)
+    return -1;
+  return Perturbations::getIdxFromPoint(offset + cv::Point2i(2, 2));
+}
+
+// Outer contour of a random star shaped blob
+vector<cv::Point2i> make_blob(mt19937& rng)
+{
+  uniform_real_distribution<double> amplitude(0.0, 0.2), phase(0, 2 * M_PI), radius(60, 200);
+  uniform_int_distribution<int> lobes(2, 7);
+  const double r = radius(rng);
+  const double a1 = amplitude(rng), a2 = amplitude(rng), p1 = phase(rng), p2 = phase(rng);
+  const int k1 = lobes(rng), k2 = lobes(rng);
+
+  vector<cv::Point> polygon;
+  for (int i = 0; i < 720; i++)
+  {
+    double theta = i * M_PI / 360;
+    double rho = r * (1 + a1 * sin(k1 * theta + p1) + a2 * sin(k2 * theta + p2));
+    polygon.push_back(cv::Point(256 + rho * cos(theta), 256 + rho * sin(theta)));
+  }
+  cv::Mat mask = cv::Mat::zeros(512, 512, CV_8U);
+  vector<vector<cv::Point>> polygons(1, polygon);
+  cv::fillPoly(mask, polygons, cv::Scalar(255));
+
+  vector<vector<cv::Point>> contours;
+  cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_NONE);
+  if (contours.empty())
+    return vector<cv::Point2i>();
+  return *max_element(contours.begin(), contours.end(), [](const vector<cv::Point>& a, const vector<cv::Point>& b) {
+    return a.size() < b.size();
+  });
+}
+
+double seconds_since(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  const int blobs = argc > 1 ? atoi(argv[1]) : 50;
+  mt19937 rng(argc > 2 ? atoi(argv[2]) : 1);
+
+  // The table has to hold exactly the routes the enumeration made, in the same order
+  auto start = chrono::steady_clock::now();
+  LegacyCache cache;
+  legacy_init_cache(cache);
+  const double init_time = seconds_since(start);
+  int mismatched_pairs = 0;
+  for (uint8_t entry = 0; entry < Perturbations::RING_SIZE; entry++)
+  {
+    for (uint8_t exit = 0; exit < Perturbations::RING_SIZE; exit++)
+    {
+      int ring_distance = min((entry - exit + 16) % 16, (exit - entry + 16) % 16);
+      auto expected = ring_distance < 2 ? vector<vector<uint8_t>>() :
+                                          legacy_get_perturbations(cache, RING_IDXS[entry], RING_IDXS[exit]);
+      if (Perturbations::getPerturbations(RING_IDXS[entry], RING_IDXS[exit]) != expected)
+        mismatched_pairs++;
+    }
+  }
+  cout << "Route enumeration at startup took " << init_time * 1e3 << " ms, "
+       << (mismatched_pairs ? to_string(mismatched_pairs) + " pairs of ring positions differ from the table" :
+                              "the table matches it")
+       << endl;
+
+  size_t curves = 0, perturbations = 0, mismatched = 0;
+  size_t legacy_checksum = 0, checksum = 0;
+  double legacy_time = 0, chain_code_time = 0;
+  for (int blob = 0; blob < blobs; blob++)
+  {
+    vector<cv::Point2i> points = make_blob(rng);
+    if (points.size() < 5 || !ClosedCurve::validateCurve(points))
+      continue;
+    curves++;
+
+    // Point lists, with the routes looked up in the cache and a new curve made for each one. The old perturb only
+    // worked away from the ends of the list, so both only perturb the points there.
+    start = chrono::steady_clock::now();
+    for (size_t idx = 2; idx + 2 < points.size(); idx++)
+    {
+      int entry = hood_idx(points[idx - 2] - points[idx]);
+      int exit = hood_idx(points[idx + 2] - points[idx]);
+      if (entry < 0 || exit < 0)
+        continue;
+      for (auto& route : legacy_get_perturbations(cache, entry, exit))
+        legacy_checksum += legacy_perturb(points, route, idx).size();
+    }
+    legacy_time += seconds_since(start);
+
+    // Chain codes, with the routes looked up in the table and applied in place to a scratch copy
+    ClosedCurve curve(points);
+    ClosedCurve scratch = curve;
+    start = chrono::steady_clock::now();
+    for (size_t idx = 2; idx + 2 < curve.size(); idx++)
+    {
+      Perturbations::RouteRange routes = curve.getPerturbations(idx);
+      for (const Perturbations::Route* route = routes.first; route != routes.second; route++)
+      {
+        scratch = curve;
+        scratch.applyPerturbation(*route, idx);
+        checksum += scratch.size();
+        perturbations++;
+      }
+    }
+    chain_code_time += seconds_since(start);
+
+    // Both have to make the same curves
+    vector<cv::Point2i> perturbed;
+    for (size_t idx = 2; idx + 2 < curve.size(); idx++)
+    {
+      int entry = hood_idx(points[idx - 2] - points[idx]);
+      int exit = hood_idx(points[idx + 2] - points[idx]);
+      auto routes = curve.getPerturbations(idx);
+      auto legacy_routes = entry < 0 || exit < 0 ? vector<vector<uint8_t>>() :
+                                                   legacy_get_perturbations(cache, entry, exit);
+      if (size_t(routes.second - routes.first) != legacy_routes.size())
+      {
+        mismatched++;
+        continue;
+      }
+      for (size_t i = 0; i < legacy_routes.size(); i++)
+      {
+        scratch = curve;
+        scratch.applyPerturbation(routes.first[i], idx);
+        scratch.getPoints(perturbed);
+        if (perturbed != legacy_perturb(points, legacy_routes[i], idx))
+          mismatched++;
+      }
+    }
+  }
+
+  cout << curves << " blob contours, " << perturbations << " perturbations" << endl;
+  cout << "point lists: " << legacy_time * 1e3 << " ms, " << legacy_time / max<size_t>(perturbations, 1) * 1e9
+       << " ns per perturbation" << endl;
+  cout << "chain codes: " << chain_code_time * 1e3 << " ms, " << chain_code_time / max<size_t>(perturbations, 1) * 1e9
+       << " ns per perturbation (" << legacy_time / chain_code_time << "x)" << endl;
+  cout << (mismatched == 0 && checksum == legacy_checksum ? "The perturbed curves match" :
+                                                            to_string(mismatched) + " perturbed curves differ")
+       << endl;
+  return mismatched == 0 && mismatched_pairs == 0 ? 0 : 1;
+}
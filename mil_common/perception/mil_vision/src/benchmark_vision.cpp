@@ -0,0 +1,115 @@
+#include <mil_vision_lib/cv_tools.hpp>
+#include <mil_vision_lib/vision_benchmark.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+using namespace mil_vision;
+
+// Times the segmentation the torpedo board detector runs on every frame over a recorded image sequence: the
+// stateless statistical_image_segmentation and the StatisticalImageSegmenter, on the hue and saturation channels
+// with the detector's targets and gains. Frames are decoded into memory before anything is timed. Writes one JSON
+// object per algorithm, with per-stage and per-frame timings, throughput and peak memory.
+//
+// Usage: benchmark_vision <bag or directory> [image topic] [max frames] [json file]
+
+namespace
+{
+// The torpedo board detector's segmentation parameters
+const int HIST_SIZE = 256;
+const float RANGE[] = { 0, 255 };
+const int TARGET_HUE = 20;
+const int TARGET_SATURATION = 180;
+
+void split_hsv(const cv::Mat& bgr, cv::Mat& hsv, vector<cv::Mat>& channels)
+{
+  cv::cvtColor(bgr, hsv, CV_BGR2HSV);
+  cv::split(hsv, channels);
+}
+
+// The segmenter times its own stages, the total of which stands for the segmentation as a whole
+void record_timing(VisionBenchmark& benchmark, const string& name, const StatisticalImageSegmenter::Timing& timing)
+{
+  benchmark.record(name, timing.total_ms);
+  benchmark.record(name + "/histogram", timing.histogram_ms);
+  benchmark.record(name + "/thresholds", timing.thresholds_ms);
+  benchmark.record(name + "/threshold", timing.threshold_ms);
+  benchmark.record(name + "/morphology", timing.morphology_ms);
+}
+
+void benchmark_stateless(const ImageSequence& sequence, ostream& out)
+{
+  VisionBenchmark benchmark("statistical_image_segmentation");
+  benchmark.setInputBytes(sequence.bytes());
+  const float* ranges[] = { RANGE };
+  cv::Mat hsv, hue, sat, debug;
+  vector<cv::Mat> channels;
+  for (const cv::Mat& frame : sequence.frames)
+  {
+    benchmark.startFrame();
+    benchmark.stage("hsv", [&] { split_hsv(frame, hsv, channels); });
+    benchmark.stage("hue", [&] {
+      statistical_image_segmentation(channels[0], hue, debug, HIST_SIZE, ranges, TARGET_HUE, "Hue", false, 6, 3.0, 3.0);
+    });
+    benchmark.stage("saturation", [&] {
+      statistical_image_segmentation(channels[1], sat, debug, HIST_SIZE, ranges, TARGET_SATURATION, "Saturation",
+                                     false, 6, 0.1, 0.1);
+    });
+    benchmark.endFrame();
+  }
+  benchmark.writeJson(out);
+}
+
+void benchmark_segmenter(const ImageSequence& sequence, ostream& out)
+{
+  VisionBenchmark benchmark("StatisticalImageSegmenter");
+  benchmark.setInputBytes(sequence.bytes());
+  StatisticalImageSegmenter hue_segmenter(HIST_SIZE, RANGE, 6);
+  StatisticalImageSegmenter sat_segmenter(HIST_SIZE, RANGE, 6);
+  cv::Mat hsv, hue, sat;
+  vector<cv::Mat> channels;
+  for (const cv::Mat& frame : sequence.frames)
+  {
+    benchmark.startFrame();
+    benchmark.stage("hsv", [&] { split_hsv(frame, hsv, channels); });
+    hue_segmenter.segment(channels[0], hue, TARGET_HUE, 3.0, 3.0);
+    record_timing(benchmark, "hue", hue_segmenter.last_timing());
+    sat_segmenter.segment(channels[1], sat, TARGET_SATURATION, 0.1, 0.1);
+    record_timing(benchmark, "saturation", sat_segmenter.last_timing());
+    benchmark.endFrame();
+  }
+  benchmark.writeJson(out);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    cerr << "Usage: " << argv[0] << " <bag or directory> [image topic] [max frames] [json file]" << endl;
+    return 1;
+  }
+  string topic = argc > 2 ? argv[2] : "/camera/front/left/image_rect_color";
+  size_t max_frames = argc > 3 ? strtoul(argv[3], nullptr, 10) : 0;
+
+  ImageSequence sequence;
+  if (!loadImageSequence(argv[1], topic, sequence, max_frames))
+  {
+    cerr << "No images in " << argv[1] << " on " << topic << endl;
+    return 1;
+  }
+  cerr << "Loaded " << sequence.frames.size() << " frames" << endl;
+
+  ofstream file;
+  if (argc > 4)
+    file.open(argv[4]);
+  ostream& out = file.is_open() ? file : cout;
+  benchmark_stateless(sequence, out);
+  benchmark_segmenter(sequence, out);
+  return 0;
+}
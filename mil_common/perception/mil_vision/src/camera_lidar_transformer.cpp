@@ -1,172 +1,390 @@
 #include "camera_lidar_transformer.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
 // ros::Duration CameraLidarTransformer::MAX_TIME_ERR = ros::Duration(0, 6E7);
 ros::Duration CameraLidarTransformer::MAX_TIME_ERR = ros::Duration(5);
 CameraLidarTransformer::CameraLidarTransformer()
   : nh(ros::this_node::getName())
   , tfBuffer()
   , tfListener(tfBuffer, nh)
-  , lidarSub(nh, "/velodyne_points", 10)
-  , lidarCache(lidarSub, 100)
   , camera_info_received(false)
+  , transform_missing(false)
 #ifdef DO_ROS_DEBUG
   , image_transport(nh)
 #endif
+  , lidarSpinner(1, &lidarQueue)
 {
 #ifdef DO_ROS_DEBUG
   points_debug_publisher = image_transport.advertise("points_debug", 1);
   pubMarkers = nh.advertise<visualization_msgs::MarkerArray>("markers_debug", 10);
 #endif
   nh.param<std::string>("camera_info_topic", camera_info_topic, "/right/right/camera_info");
-  cameraInfoSub = nh.subscribe(camera_info_topic, 1, &CameraLidarTransformer::cameraInfoCallback, this);
+  cameraInfoSub = nh.subscribe(ros::SubscribeOptions::create<sensor_msgs::CameraInfo>(
+      camera_info_topic, 1, boost::bind(&CameraLidarTransformer::cameraInfoCallback, this, _1), ros::VoidPtr(),
+      &lidarQueue));
+  lidarSub = nh.subscribe(ros::SubscribeOptions::create<sensor_msgs::PointCloud2>(
+      "/velodyne_points", 10, boost::bind(&CameraLidarTransformer::lidarCallback, this, _1), ros::VoidPtr(),
+      &lidarQueue));
+  lidarSpinner.start();
   std::string camera_to_lidar_transform_topic;
   nh.param<std::string>("camera_to_lidar_transform_topic", camera_to_lidar_transform_topic, "transform_camera");
   transformServiceServer =
       nh.advertiseService(camera_to_lidar_transform_topic, &CameraLidarTransformer::transformServiceCallback, this);
+  batchServiceServer = nh.advertiseService(camera_to_lidar_transform_topic + "_batch",
+                                           &CameraLidarTransformer::batchServiceCallback, this);
 }
 
-void CameraLidarTransformer::cameraInfoCallback(sensor_msgs::CameraInfo info)
+void CameraLidarTransformer::cameraInfoCallback(const sensor_msgs::CameraInfoConstPtr& info)
 {
-  camera_info = info;
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  // Projections are only good for the camera geometry they were made with
+  if (info->width != camera_info.width || info->height != camera_info.height || info->P != camera_info.P)
+    projectedCache.clear();
+  camera_info = *info;
   cam_model.fromCameraInfo(camera_info);
   camera_info_received = true;
 }
 
+void CameraLidarTransformer::lidarCallback(const sensor_msgs::PointCloud2ConstPtr& cloud)
+{
+  // camera_info and cam_model are only written from this thread, so they can be read here without the lock
+  if (!camera_info_received)
+    return;
+  geometry_msgs::TransformStamped transform;
+  try
+  {
+    transform = tfBuffer.lookupTransform(camera_info.header.frame_id, "velodyne", ros::Time(0));
+  }
+  catch (tf2::TransformException& ex)
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    transform_missing = true;
+    return;
+  }
+  std::shared_ptr<const ProjectedCloud> projected = projectCloud(*cloud, transform);
+  if (!projected)
+    return;
+
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  transform_missing = false;
+  // Keep the cache in stamp order for closestCloud, dropping a cloud that arrives out of order
+  if (!projectedCache.empty() && projectedCache.back()->cloud_stamp >= projected->cloud_stamp)
+    return;
+  projectedCache.push_back(projected);
+  if (projectedCache.size() > PROJECTED_CACHE_SIZE)
+    projectedCache.pop_front();
+}
+
+std::shared_ptr<const ProjectedCloud> CameraLidarTransformer::closestCloud(const ros::Time& stamp)
+{
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  auto after = std::lower_bound(
+      projectedCache.begin(), projectedCache.end(), stamp,
+      [](const std::shared_ptr<const ProjectedCloud>& cloud, const ros::Time& t) { return cloud->cloud_stamp < t; });
+  std::shared_ptr<const ProjectedCloud> closest;
+  ros::Duration minErr = MAX_TIME_ERR;
+  if (after != projectedCache.end() && (*after)->cloud_stamp - stamp <= minErr)
+  {
+    closest = *after;
+    minErr = (*after)->cloud_stamp - stamp;
+  }
+  if (after != projectedCache.begin() && stamp - (*(after - 1))->cloud_stamp <= minErr)
+    closest = *(after - 1);
+  return closest;
+}
+
 bool CameraLidarTransformer::inCameraFrame(cv::Point2d& point)
 {
   return point.x > 0 && point.x < camera_info.width && point.y > 0 && point.y < camera_info.height;
 }
 
+#ifdef DO_ROS_DEBUG
+visualization_msgs::Marker CameraLidarTransformer::pointMarker(const std_msgs::Header& header, int id, double x,
+                                                               double y, double z, bool near)
+{
+  visualization_msgs::Marker marker_point;
+  marker_point.header = header;
+  marker_point.header.seq = 0;
+  marker_point.id = id;
+  marker_point.type = visualization_msgs::Marker::CUBE;
+  marker_point.pose.position.x = x;
+  marker_point.pose.position.y = y;
+  marker_point.pose.position.z = z;
+  marker_point.scale.x = 0.1;
+  marker_point.scale.y = 0.1;
+  marker_point.scale.z = 0.1;
+  marker_point.color.a = 1.0;
+  marker_point.color.r = near ? 1.0 : 0.0;
+  marker_point.color.g = near ? 0.0 : 1.0;
+  marker_point.color.b = 0.0;
+  return marker_point;
+}
+#endif
+
 void CameraLidarTransformer::drawPoint(cv::Mat& mat, cv::Point2d& point, cv::Scalar color)
 {
   if (point.x - 20 > 0 && point.x + 20 < mat.cols && point.y - 20 > 0 && point.y + 20 < mat.rows)
     cv::circle(mat, point, 3, color, -1);
 }
 
-bool CameraLidarTransformer::transformServiceCallback(mil_msgs::CameraToLidarTransform::Request& req,
-                                                      mil_msgs::CameraToLidarTransform::Response& res)
+std::shared_ptr<const ProjectedCloud>
+CameraLidarTransformer::projectCloud(const sensor_msgs::PointCloud2& cloud,
+                                     const geometry_msgs::TransformStamped& transform)
 {
-  if (!camera_info_received)
+  int offsets[3] = { -1, -1, -1 };
+  for (const sensor_msgs::PointField& field : cloud.fields)
   {
-    res.success = false;
-    res.error = "NO CAMERA INFO";
-    return true;
+    if (field.datatype != sensor_msgs::PointField::FLOAT32)
+      continue;
+    if (field.name == "x")
+      offsets[0] = field.offset;
+    else if (field.name == "y")
+      offsets[1] = field.offset;
+    else if (field.name == "z")
+      offsets[2] = field.offset;
   }
+  if (offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0)
+    return nullptr;
 
-  if (camera_info.header.frame_id != req.header.frame_id)
+  // Gather the points into one array per coordinate
+  const size_t n = size_t(cloud.width) * cloud.height;
+  gather_x.resize(n);
+  gather_y.resize(n);
+  gather_z.resize(n);
+  gather_u.resize(n);
+  gather_v.resize(n);
+  gather_pixel.resize(n);
+  for (size_t i = 0; i < n; i++)
   {
-    res.success = false;
-    res.error = "DIFFERENT FRAME ID THAN SUBSCRIBED CAMERA";
-    return true;
+    const uint8_t* point = &cloud.data[i * cloud.point_step];
+    std::memcpy(&gather_x[i], point + offsets[0], sizeof(float));
+    std::memcpy(&gather_y[i], point + offsets[1], sizeof(float));
+    std::memcpy(&gather_z[i], point + offsets[2], sizeof(float));
   }
 
-  visualization_msgs::MarkerArray markers;
-  std::vector<sensor_msgs::PointCloud2ConstPtr> nearbyLidar =
-      lidarCache.getInterval(req.header.stamp - MAX_TIME_ERR, req.header.stamp + MAX_TIME_ERR);
-  sensor_msgs::PointCloud2ConstPtr scloud;
-  ros::Duration minErr = ros::Duration(5000, 0);
-  for (auto& pc : nearbyLidar)
-  {
-    ros::Duration thisErr = pc->header.stamp - req.header.stamp;
-    if (thisErr < minErr)
-    {
-      scloud = pc;
-      minErr = thisErr;
-    }
+  // Transform, cull and project in one branchless pass, so the compiler can vectorize it
+  Eigen::Matrix3f R = Eigen::Quaternionf(transform.transform.rotation.w, transform.transform.rotation.x,
+                                         transform.transform.rotation.y, transform.transform.rotation.z)
+                          .toRotationMatrix();
+  const float t0 = transform.transform.translation.x, t1 = transform.transform.translation.y,
+              t2 = transform.transform.translation.z;
+  const float r00 = R(0, 0), r01 = R(0, 1), r02 = R(0, 2), r10 = R(1, 0), r11 = R(1, 1), r12 = R(1, 2),
+              r20 = R(2, 0), r21 = R(2, 1), r22 = R(2, 2);
+  const cv::Matx34d P = cam_model.projectionMatrix();
+  const float p00 = P(0, 0), p01 = P(0, 1), p02 = P(0, 2), p03 = P(0, 3), p10 = P(1, 0), p11 = P(1, 1),
+              p12 = P(1, 2), p13 = P(1, 3), p20 = P(2, 0), p21 = P(2, 1), p22 = P(2, 2), p23 = P(2, 3);
+  const int width = camera_info.width;
+  const int height = camera_info.height;
+  const float fwidth = width, fheight = height;
+  float* __restrict__ xs = gather_x.data();
+  float* __restrict__ ys = gather_y.data();
+  float* __restrict__ zs = gather_z.data();
+  float* __restrict__ us = gather_u.data();
+  float* __restrict__ vs = gather_v.data();
+  int* __restrict__ pixels = gather_pixel.data();
+  for (size_t i = 0; i < n; i++)
+  {
+    const float x = r00 * xs[i] + r01 * ys[i] + r02 * zs[i] + t0;
+    const float y = r10 * xs[i] + r11 * ys[i] + r12 * zs[i] + t1;
+    const float z = r20 * xs[i] + r21 * ys[i] + r22 * zs[i] + t2;
+    const float w = 1.0f / (p20 * x + p21 * y + p22 * z + p23);
+    const float u = (p00 * x + p01 * y + p02 * z + p03) * w;
+    const float v = (p10 * x + p11 * y + p12 * z + p13) * w;
+    // Same as the z range and inCameraFrame, NaN points fail every comparison
+    const bool keep = (z >= 0) & (z <= 30) & (u > 0) & (u < fwidth) & (v > 0) & (v < fheight);
+    xs[i] = x;
+    ys[i] = y;
+    zs[i] = z;
+    us[i] = u;
+    vs[i] = v;
+    pixels[i] = keep ? int(v) * width + int(u) : -1;
   }
-  if (!scloud)
+
+  // Counting sort of the kept points by pixel
+  std::shared_ptr<ProjectedCloud> projected = std::make_shared<ProjectedCloud>();
+  projected->cloud_stamp = cloud.header.stamp;
+  projected->width = width;
+  projected->height = height;
+  std::vector<int>& start = gather_pixel_start;
+  start.assign(size_t(width) * height + 1, 0);
+  for (size_t i = 0; i < n; i++)
   {
-    res.success = false;
-    res.error = mil_msgs::CameraToLidarTransform::Response::CLOUD_NOT_FOUND;
-    return true;
+    if (pixels[i] >= 0)
+      start[pixels[i] + 1]++;
   }
-  if (!tfBuffer.canTransform(req.header.frame_id, "velodyne", ros::Time(0), ros::Duration(1)))
+  for (size_t p = 1; p < start.size(); p++)
+    start[p] += start[p - 1];
+  const size_t kept = start.back();
+  projected->x.resize(kept);
+  projected->y.resize(kept);
+  projected->z.resize(kept);
+  projected->u.resize(kept);
+  projected->v.resize(kept);
+  std::vector<int> next(start.begin(), start.end() - 1);
+  for (size_t i = 0; i < n; i++)
   {
-    res.success = false;
-    res.error = "NO TRANSFORM";
-    return true;
+    if (pixels[i] < 0)
+      continue;
+    int j = next[pixels[i]]++;
+    projected->x[j] = xs[i];
+    projected->y[j] = ys[i];
+    projected->z[j] = zs[i];
+    projected->u[j] = us[i];
+    projected->v[j] = vs[i];
   }
-  geometry_msgs::TransformStamped transform = tfBuffer.lookupTransform(req.header.frame_id, "velodyne", ros::Time(0));
-  sensor_msgs::PointCloud2 cloud_transformed;
-  tf2::doTransform(*scloud, cloud_transformed, transform);
+  projected->row_start.resize(height + 1);
+  for (int row = 0; row <= height; row++)
+    projected->row_start[row] = start[size_t(row) * width];
+  return projected;
+}
 
-#ifdef DO_ROS_DEBUG
-  cv::Mat debug_image(camera_info.height, camera_info.width, CV_8UC3, cv::Scalar(0));
-  cv::circle(debug_image, cv::Point(req.point.x, req.point.y), 8, cv::Scalar(255, 0, 0), -1);
-#endif
+std::shared_ptr<const ProjectedCloud> CameraLidarTransformer::requestCloud(const std_msgs::Header& header,
+                                                                          std::string& error)
+{
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (!camera_info_received)
+    {
+      error = "NO CAMERA INFO";
+      return nullptr;
+    }
+
+    if (camera_info.header.frame_id != header.frame_id)
+    {
+      error = "DIFFERENT FRAME ID THAN SUBSCRIBED CAMERA";
+      return nullptr;
+    }
+  }
 
+  std::shared_ptr<const ProjectedCloud> projected = closestCloud(header.stamp);
+  if (!projected)
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    error = transform_missing ? "NO TRANSFORM" : mil_msgs::CameraToLidarTransform::Response::CLOUD_NOT_FOUND;
+  }
+  return projected;
+}
+
+void CameraLidarTransformer::findPoints(const ProjectedCloud& projected, const geometry_msgs::Point& point,
+                                        double tolerance, mil_msgs::CameraToLidarResult& result,
+                                        std::vector<int>& near) const
+{
+  // Only the pixels within tolerance of the requested point can have points within tolerance of it, and in each row
+  // they are one contiguous range of points, found by binary search on the columns
   double minDistance = std::numeric_limits<double>::max();
   pcl::PointCloud<pcl::PointXYZ> cloud;
-  pcl::fromROSMsg(cloud_transformed, cloud);
-  std::vector<int> indices;
-  for (unsigned index = 0; index < cloud.size(); index++)
+  near.clear();
+  const int col_begin = std::max(0, int(std::floor(point.x - tolerance)));
+  const int col_end = std::min(projected.width - 1, int(std::floor(point.x + tolerance)));
+  const int row_begin = std::max(0, int(std::floor(point.y - tolerance)));
+  const int row_end = std::min(projected.height - 1, int(std::floor(point.y + tolerance)));
+  for (int row = row_begin; row <= row_end && col_begin <= col_end; row++)
   {
-    pcl::PointXYZ& p = cloud[index];
-    if (p.z < 0 || p.z > 30)
-      continue;
-    cv::Point2d point = cam_model.project3dToPixel(cv::Point3d(p.x, p.y, p.z));
-    if (inCameraFrame(point))
+    // Points are in order of the integer part of u, so u >= col is in order for any integer col
+    auto row_begin_it = projected.u.begin() + projected.row_start[row];
+    auto row_end_it = projected.u.begin() + projected.row_start[row + 1];
+    auto first_it = std::lower_bound(row_begin_it, row_end_it, float(col_begin));
+    const int first = first_it - projected.u.begin();
+    const int last = std::lower_bound(first_it, row_end_it, float(col_end + 1)) - projected.u.begin();
+    for (int index = first; index < last; index++)
     {
-#ifdef DO_ROS_DEBUG
-      visualization_msgs::Marker marker_point;
-      marker_point.header = req.header;
-      marker_point.header.seq = 0;
-      marker_point.header.frame_id = req.header.frame_id;
-      marker_point.id = index;
-      marker_point.type = visualization_msgs::Marker::CUBE;
-      marker_point.pose.position.x = p.x;
-      marker_point.pose.position.y = p.y;
-      marker_point.pose.position.z = p.z;
-      marker_point.scale.x = 0.1;
-      marker_point.scale.y = 0.1;
-      marker_point.scale.z = 0.1;
-      marker_point.color.a = 1.0;
-      marker_point.color.r = 0.0;
-      marker_point.color.g = 1.0;
-      marker_point.color.b = 0.0;
-      drawPoint(debug_image, point);
-#endif
-      double distance = sqrt(pow(point.x - req.point.x, 2) + pow(point.y - req.point.y, 2));  // Distance (2D) from
-                                                                                              // request point to
-                                                                                              // projected lidar point
-      if (distance < req.tolerance)
+      double distance = sqrt(pow(projected.u[index] - point.x, 2) +
+                             pow(projected.v[index] - point.y, 2));  // Distance (2D) from request point to
+                                                                     // projected lidar point
+      if (distance >= tolerance)
+        continue;
+      geometry_msgs::Point geo_point;
+      geo_point.x = projected.x[index];
+      geo_point.y = projected.y[index];
+      geo_point.z = projected.z[index];
+      if (distance < minDistance)
       {
-        geometry_msgs::Point geo_point;
-        geo_point.x = p.x;
-        geo_point.y = p.y;
-        geo_point.z = p.z;
-        if (distance < minDistance)
-        {
-          res.closest = geo_point;
-          minDistance = distance;
-        }
-        indices.push_back(index);
-
-        res.transformed.push_back(geo_point);
-
-#ifdef DO_ROS_DEBUG
-        drawPoint(debug_image, point, cv::Scalar(0, 255, 0));
-        marker_point.color.r = 1.0;
-        marker_point.color.g = 0.0;
-        marker_point.color.b = 0.0;
-#endif
+        result.closest = geo_point;
+        minDistance = distance;
       }
-#ifdef DO_ROS_DEBUG
-      markers.markers.push_back(marker_point);
-#endif
+      cloud.push_back(pcl::PointXYZ(geo_point.x, geo_point.y, geo_point.z));
+
+      result.transformed.push_back(geo_point);
+      near.push_back(index);
     }
   }
-  if (res.transformed.size() > 0)
+  if (result.transformed.size() > 0)
   {
     float x, y, z, n;
+    std::vector<int> indices(cloud.size());
+    std::iota(indices.begin(), indices.end(), 0);
     pcl::NormalEstimation<pcl::PointXYZ, pcl::Normal> ne;
     ne.computePointNormal(cloud, indices, x, y, z, n);
     Eigen::Vector3d normal_vector = Eigen::Vector3d(x, y, z).normalized();
-    res.normal.x = -normal_vector(0, 0);
-    res.normal.y = -normal_vector(1, 0);
-    res.normal.z = -normal_vector(2, 0);
+    result.normal.x = -normal_vector(0, 0);
+    result.normal.y = -normal_vector(1, 0);
+    result.normal.z = -normal_vector(2, 0);
+    result.distance = result.closest.z;
+    result.success = true;
+  }
+  else
+  {
+    result.error = mil_msgs::CameraToLidarTransform::Response::NO_POINTS_FOUND;
+    result.success = false;
+  }
+}
 
+bool CameraLidarTransformer::transformServiceCallback(mil_msgs::CameraToLidarTransform::Request& req,
+                                                      mil_msgs::CameraToLidarTransform::Response& res)
+{
+  std::shared_ptr<const ProjectedCloud> projected = requestCloud(req.header, res.error);
+  if (!projected)
+  {
+    res.success = false;
+    return true;
+  }
+
+  visualization_msgs::MarkerArray markers;
 #ifdef DO_ROS_DEBUG
+  bool debug = pubMarkers.getNumSubscribers() > 0 || points_debug_publisher.getNumSubscribers() > 0;
+  cv::Mat debug_image;
+  if (debug)
+  {
+    debug_image = cv::Mat(projected->height, projected->width, CV_8UC3, cv::Scalar(0));
+    cv::circle(debug_image, cv::Point(req.point.x, req.point.y), 8, cv::Scalar(255, 0, 0), -1);
+    // Every point in the image, the ones near the requested point are drawn over below
+    for (size_t index = 0; index < projected->u.size(); index++)
+    {
+      cv::Point2d point(projected->u[index], projected->v[index]);
+      drawPoint(debug_image, point);
+      markers.markers.push_back(pointMarker(req.header, index, projected->x[index], projected->y[index],
+                                            projected->z[index], false));
+    }
+  }
+#endif
+
+  mil_msgs::CameraToLidarResult result;
+  std::vector<int> near;
+  findPoints(*projected, req.point, req.tolerance, result, near);
+  res.success = result.success;
+  res.transformed = std::move(result.transformed);
+  res.closest = result.closest;
+  res.normal = result.normal;
+  res.distance = result.distance;
+  res.error = result.error;
+
+#ifdef DO_ROS_DEBUG
+  if (debug)
+  {
+    for (int index : near)
+    {
+      cv::Point2d point(projected->u[index], projected->v[index]);
+      drawPoint(debug_image, point, cv::Scalar(0, 255, 0));
+      markers.markers[index] =
+          pointMarker(req.header, index, projected->x[index], projected->y[index], projected->z[index], true);
+    }
+  }
+  if (res.success)
+  {
     // Add a marker for the normal to the plane
     geometry_msgs::Point sdp_normalvec_ros;
     sdp_normalvec_ros.x = res.closest.x + res.normal.x;
@@ -188,27 +406,47 @@ bool CameraLidarTransformer::transformServiceCallback(mil_msgs::CameraToLidarTra
     marker_normal.color.g = 0.0;
     marker_normal.color.b = 1.0;
     markers.markers.push_back(marker_normal);
+  }
+
+  if (debug)
+  {
+    // Publish 3D debug market
+    pubMarkers.publish(markers);
+    // Publish debug image
+    cv_bridge::CvImage ros_debug_image;
+    ros_debug_image.encoding = "bgr8";
+    ros_debug_image.image = debug_image;
+    points_debug_publisher.publish(ros_debug_image.toImageMsg());
+  }
 #endif
 
-    res.distance = res.closest.z;
-    res.success = true;
+  return true;
+}
+
+bool CameraLidarTransformer::batchServiceCallback(mil_msgs::CameraToLidarTransformBatch::Request& req,
+                                                  mil_msgs::CameraToLidarTransformBatch::Response& res)
+{
+  if (req.tolerances.size() != 1 && req.tolerances.size() != req.points.size())
+  {
+    res.success = false;
+    res.error = mil_msgs::CameraToLidarTransformBatch::Response::BAD_TOLERANCES;
+    return true;
   }
-  else
+  std::shared_ptr<const ProjectedCloud> projected = requestCloud(req.header, res.error);
+  if (!projected)
   {
-    res.error = mil_msgs::CameraToLidarTransform::Response::NO_POINTS_FOUND;
     res.success = false;
+    return true;
   }
 
-#ifdef DO_ROS_DEBUG
-  // Publish 3D debug market
-  pubMarkers.publish(markers);
-  // Publish debug image
-  cv_bridge::CvImage ros_debug_image;
-  ros_debug_image.encoding = "bgr8";
-  ros_debug_image.image = debug_image.clone();
-  points_debug_publisher.publish(ros_debug_image.toImageMsg());
-#endif
-
+  res.results.resize(req.points.size());
+  std::vector<int> near;
+  for (size_t i = 0; i < req.points.size(); i++)
+  {
+    const double tolerance = req.tolerances.size() == 1 ? req.tolerances[0] : req.tolerances[i];
+    findPoints(*projected, req.points[i], tolerance, res.results[i], near);
+  }
+  res.success = true;
   return true;
 }
 
@@ -1,4 +1,5 @@
 #include <mil_vision_lib/active_contours.hpp>
+#include <mil_vision_lib/active_contours_routes.hpp>
 
 using namespace std;
 using namespace cv;
@@ -7,47 +8,33 @@ namespace mil_vision
 {
 namespace Perturbations
 {
-void initPerturbationCache()
+RouteRange getRoutes(uint8_t entry_ring_pos, uint8_t exit_ring_pos)
 {
-  std::unordered_map<uint8_t, uint8_t> seq_to_mod_border_idxs;
-  seq_to_mod_border_idxs[0] = 0;
-  seq_to_mod_border_idxs[1] = 1;
-  seq_to_mod_border_idxs[2] = 2;
-  seq_to_mod_border_idxs[3] = 3;
-  seq_to_mod_border_idxs[4] = 4;
-  seq_to_mod_border_idxs[5] = 12;
-  seq_to_mod_border_idxs[6] = 20;
-  seq_to_mod_border_idxs[7] = 28;
-  seq_to_mod_border_idxs[8] = 36;
-  seq_to_mod_border_idxs[9] = 35;
-  seq_to_mod_border_idxs[10] = 34;
-  seq_to_mod_border_idxs[11] = 33;
-  seq_to_mod_border_idxs[12] = 32;
-  seq_to_mod_border_idxs[13] = 24;
-  seq_to_mod_border_idxs[14] = 16;
-  seq_to_mod_border_idxs[15] = 8;
-  for (uint8_t entry = 0; entry < 25; entry++)
-  {
-    for (uint8_t exit = 0; exit < 25; exit++)
-    {
-      if (entry > exit || exit - entry == 1 || (exit + 16) - entry == 1)
-        continue;
-      vector<uint8_t> perturbation_list;
-      vector<uint8_t> occupied_squares;
-      auto in = seq_to_mod_border_idxs[entry];
-      auto out = seq_to_mod_border_idxs[exit];
-      growRoute(perturbation_list, occupied_squares, in, out);  // Appends all possible paths from entry point to
-    }                                                           // exit point at the corresponding cache position
-  }
+  if (entry_ring_pos >= RING_SIZE || exit_ring_pos >= RING_SIZE)
+    return RouteRange(ROUTES, ROUTES);
+  size_t pair = entry_ring_pos * RING_SIZE + exit_ring_pos;
+  return RouteRange(ROUTES + ROUTE_OFFSETS[pair], ROUTES + ROUTE_OFFSETS[pair + 1]);
 }
 
 vector<vector<uint8_t>> getPerturbations(uint8_t entry, uint8_t exit)
 {
-  auto key = entry <= exit ? make_pair(entry, exit) : make_pair(exit, entry);
-  auto perturbations = perturbation_cache[key];
-  if (exit < entry)
-    for (auto& route : perturbations)
-      reverse(route.begin(), route.end());
+  const Point2i center(2, 2);
+  Point2i entry_pt = getPointFromIdx(entry) - center;
+  Point2i exit_pt = getPointFromIdx(exit) - center;
+  RouteRange routes = getRoutes(getRingPosition(entry_pt.x, entry_pt.y), getRingPosition(exit_pt.x, exit_pt.y));
+
+  vector<vector<uint8_t>> perturbations;
+  for (const Route* route = routes.first; route != routes.second; route++)
+  {
+    vector<uint8_t> idxs;
+    Point2i pt = getPointFromIdx(entry);
+    for (uint8_t step = 0; step + 1 < route->length; step++)
+    {
+      pt += Point2i(CHAIN_DX[route->codes[step]], CHAIN_DY[route->codes[step]]);
+      idxs.push_back(getIdxFromPoint(pt));
+    }
+    perturbations.push_back(idxs);
+  }
   return perturbations;
 }
 
@@ -111,138 +98,144 @@ bool isNeighbor(uint8_t idx1, uint8_t idx2)
 
 bool isNeighborPoint(const Point2i& pt1, const Point2i& pt2)
 {
-  return abs(pt1.x - pt2.x) == 1 && abs(pt1.y - pt2.y) == 1;
+  return pt1 != pt2 && abs(pt1.x - pt2.x) <= 1 && abs(pt1.y - pt2.y) <= 1;
 }
 
-void growRoute(const vector<uint8_t>& partial, const vector<uint8_t>& occupied, uint8_t entry, uint8_t exit)
-{
-  uint8_t tail = (partial.size() == 0) ? entry : partial.back();
-  auto candidates = getHoodIdxs(tail, false);
-
-  // remove candidates that were neighbors of prev tail
-  candidates =
-      vector<uint8_t>(candidates.begin(), remove_if(candidates.begin(), candidates.end(), [&occupied](uint8_t x) {
-                        return find(occupied.begin(), occupied.end(), x) != occupied.end();
-                      }));
-
-  auto next_occupied = occupied;  // neighbors of current tailed should be blacklisted for next route growth
-  for (auto cand : candidates)
-    next_occupied.push_back(cand);
+}  // namespace Perturbations
 
-  for (auto new_elem : candidates)
+ClosedCurve::ClosedCurve(const vector<Point2i>& points) : _start(points.empty() ? Point2i() : points[0])
+{
+  // Perturbations grow the curve by at most two points at a time
+  _codes.reserve(points.size() * 2);
+  for (size_t i = 0; i < points.size(); i++)
   {
-    auto next_partial = partial;
-    next_partial.push_back(new_elem);
-
-    auto next_tails = getHoodIdxs(new_elem, true);  // true --> include border
-    auto find_exit_itr = find(next_tails.begin(), next_tails.end(), exit);
-    if (find_exit_itr != next_tails.end() && *find_exit_itr != tail)  // add to cache if exit is a possible next tail
-    {
-      pair<uint8_t, uint8_t> key;
-
-      if (entry <= exit)
-        key = make_pair(entry, exit);
-      else
-      {
-        key = make_pair(exit, entry);
-        reverse(next_partial.begin(), next_partial.end());
-      }
-      perturbation_cache[key].push_back(next_partial);
-    }
-    else
-      growRoute(next_partial, next_occupied, entry, exit);
+    const Point2i& next = points[(i + 1) % points.size()];
+    _codes.push_back(Perturbations::getChainCode(next.x - points[i].x, next.y - points[i].y));
   }
-
-  return;  // No viable growth candidates
 }
 
-vector<Point2i> perturb(const vector<Point2i>& src_curve, vector<uint8_t> perturbation, int idx)
+void ClosedCurve::getPoints(vector<Point2i>& points) const
 {
-  auto pt = src_curve[idx];
-  auto pt_list = getPointList(perturbation);
-  for (auto& pt_elem : pt_list)
+  points.resize(_codes.size());
+  Point2i pt = _start;
+  for (size_t i = 0; i < _codes.size(); i++)
   {
-    pt_elem.x += pt.x;
-    pt_elem.y += pt.y;
+    points[i] = pt;
+    pt.x += Perturbations::CHAIN_DX[_codes[i]];
+    pt.y += Perturbations::CHAIN_DY[_codes[i]];
   }
+}
 
-  vector<Point2i> dest(src_curve.begin(), src_curve.begin() + idx - 1);
-  for (auto& pert : pt_list)
-    dest.push_back(pert);
-  auto it = src_curve.begin() + idx + 2;
-  while (it != src_curve.end())
-  {
-    dest.push_back(*it);
-    it++;
-  }
+vector<Point2i> ClosedCurve::points() const
+{
+  vector<Point2i> pts;
+  getPoints(pts);
+  return pts;
+}
 
-  return dest;
+void ClosedCurve::_endOffsets(size_t idx, Point2i& entry, Point2i& exit) const
+{
+  using Perturbations::CHAIN_DX;
+  using Perturbations::CHAIN_DY;
+  const size_t n = _codes.size();
+  uint8_t before[2] = { _codes[(idx + n - 2) % n], _codes[(idx + n - 1) % n] };
+  uint8_t after[2] = { _codes[idx], _codes[(idx + 1) % n] };
+  entry = Point2i(-CHAIN_DX[before[0]] - CHAIN_DX[before[1]], -CHAIN_DY[before[0]] - CHAIN_DY[before[1]]);
+  exit = Point2i(CHAIN_DX[after[0]] + CHAIN_DX[after[1]], CHAIN_DY[after[0]] + CHAIN_DY[after[1]]);
 }
 
-}  // namespace Perturbations
+Perturbations::RouteRange ClosedCurve::getPerturbations(size_t idx) const
+{
+  using namespace Perturbations;
+  if (_codes.size() < 5)
+    return getRoutes(NOT_ON_RING, NOT_ON_RING);
+  Point2i entry, exit;
+  _endOffsets(idx, entry, exit);
+  return getRoutes(getRingPosition(entry.x, entry.y), getRingPosition(exit.x, exit.y));
+}
+
+void ClosedCurve::_replaceSteps(size_t idx, const uint8_t* codes, size_t count)
+{
+  const size_t n = _codes.size();
+  size_t first = (idx + n - 2) % n;  // step out of point idx - 2
+  if (first + 4 > n)
+  {
+    // Start the curve at point idx - 2 instead, so the steps do not wrap around the end
+    for (size_t i = 0; i < first; i++)
+    {
+      _start.x += Perturbations::CHAIN_DX[_codes[i]];
+      _start.y += Perturbations::CHAIN_DY[_codes[i]];
+    }
+    std::rotate(_codes.begin(), _codes.begin() + first, _codes.end());
+    first = 0;
+  }
+  if (count > 4)
+    _codes.insert(_codes.begin() + first + 4, count - 4, uint8_t(0));
+  else if (count < 4)
+    _codes.erase(_codes.begin() + first + count, _codes.begin() + first + 4);
+  std::copy(codes, codes + count, _codes.begin() + first);
+}
 
-ClosedCurve::ClosedCurve(vector<Point2i> points)
+void ClosedCurve::applyPerturbation(const Perturbations::Route& route, size_t idx)
 {
-  _curve_points = points;
+  _replaceSteps(idx, route.codes, route.length);
 }
 
 void ClosedCurve::applyPerturbation(const vector<uint8_t>& perturbation, int idx)
 {
-  _curve_points = Perturbations::perturb(_curve_points, perturbation, idx);
+  using namespace Perturbations;
+  // Steps from point idx - 2, through the new points, to point idx + 2, all relative to point idx
+  Point2i pt, exit;
+  _endOffsets(idx, pt, exit);
+  vector<uint8_t> codes;
+  for (uint8_t hood_idx : perturbation)
+  {
+    Point2i next = getPointFromIdx(hood_idx) - Point2i(2, 2);
+    codes.push_back(getChainCode(next.x - pt.x, next.y - pt.y));
+    pt = next;
+  }
+  codes.push_back(getChainCode(exit.x - pt.x, exit.y - pt.y));
+  _replaceSteps(idx, codes.data(), codes.size());
 }
 
-ClosedCurve ClosedCurve::perturb(const std::vector<uint8_t>& perturbation, int idx)
+ClosedCurve ClosedCurve::perturb(const vector<uint8_t>& perturbation, int idx) const
 {
-  return ClosedCurve(Perturbations::perturb(_curve_points, perturbation, idx));
+  ClosedCurve perturbed = *this;
+  perturbed.applyPerturbation(perturbation, idx);
+  return perturbed;
 }
 
-bool ClosedCurve::validateCurve(std::vector<cv::Point2i>& curve)
+bool ClosedCurve::validateCurve(const vector<Point2i>& curve)
 {
+  const size_t n = curve.size();
+  auto key = [](const Point2i& pt) { return (uint64_t(uint32_t(pt.x)) << 32) | uint32_t(pt.y); };
+
   // Make sure that all consecutive points are 8-connected
-  auto eight_connected = [](Point2i a, Point2i b) { return abs(a.x - b.x) <= 1 && abs(a.y - b.y) <= 1; };
-  if (!eight_connected(curve[0], curve.back()))
-    return false;
-  cout << "Checking for unconnected consecutive pts" << endl;
-  for (size_t i = 1; i < curve.size(); i++)
-    if (!eight_connected(curve[i - 1], curve[i]))
-    {
-      cout << "failure pts: " << curve[i - 1] << "\t" << curve[i] << endl;
+  unordered_map<uint64_t, size_t> point_idxs(n * 2);
+  for (size_t i = 0; i < n; i++)
+  {
+    const Point2i& next = curve[(i + 1) % n];
+    if (abs(next.x - curve[i].x) > 1 || abs(next.y - curve[i].y) > 1)
       return false;
-    }
+    if (!point_idxs.insert(make_pair(key(curve[i]), i)).second && n > 1)
+      return false;  // Same point twice
+  }
 
   // Make sure that points that are not adjacent are never 8-connected
-  vector<Point2i> forbidden_neighbors;
-  forbidden_neighbors.push_back(curve.back());
-  cout << "Checking for non-adjacent neighbors" << endl;
-  for (size_t i = 1; i < curve.size(); i++)
+  for (size_t i = 0; i < n; i++)
   {
-    auto& pt = curve[i];
-    auto count = count_if(forbidden_neighbors.begin(), forbidden_neighbors.end(),
-                          [pt](const Point2i& test_pt) { return Perturbations::isNeighborPoint(pt, test_pt); });
-    forbidden_neighbors.push_back(curve[i - 1]);
-
-    if (i > curve.size() - 2)  // Should be neighbor with first one added only
-    {
-      if (count > 1)
-      {
-        auto conflict_pt = find_if(forbidden_neighbors.begin(), forbidden_neighbors.end(), [pt](Point2i test_pt) {
-          return mil_vision::Perturbations::isNeighborPoint(pt, test_pt);
-        });
-        cout << "failure pts: " << curve[1] << "\t"
-             << (conflict_pt != forbidden_neighbors.end() ? Point2i(0, 0) : *conflict_pt) << endl;
-        return false;
-      }
-    }
-    else
+    for (int dy = -1; dy <= 1; dy++)
     {
-      if (count > 0)
+      for (int dx = -1; dx <= 1; dx++)
       {
-        auto conflict_pt = find_if(forbidden_neighbors.begin(), forbidden_neighbors.end(), [pt](Point2i test_pt) {
-          return mil_vision::Perturbations::isNeighborPoint(pt, test_pt);
-        });
-        cout << "failure pts: " << curve[1] << "\t"
-             << (conflict_pt != forbidden_neighbors.end() ? Point2i(0, 0) : *conflict_pt) << endl;
-        return false;
+        if (dx == 0 && dy == 0)
+          continue;
+        auto neighbor = point_idxs.find(key(curve[i] + Point2i(dx, dy)));
+        if (neighbor == point_idxs.end())
+          continue;
+        size_t j = neighbor->second;
+        if (j != (i + 1) % n && i != (j + 1) % n)
+          return false;
       }
     }
   }
@@ -0,0 +1,56 @@
+#include <mil_vision_lib/image_acquisition/camera_model.hpp>
+
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace mil_vision
+{
+bool CameraRectifier::update(const sensor_msgs::CameraInfo &info)
+{
+  if (model_ && info.width == info_.width && info.height == info_.height && info.D == info_.D && info.K == info_.K &&
+      info.R == info_.R && info.P == info_.P && info.distortion_model == info_.distortion_model)
+    return false;
+
+  info_ = info;
+  model_ = std::make_shared<image_geometry::PinholeCameraModel>();
+  model_->fromCameraInfo(info);
+  cv::initUndistortRectifyMap(model_->intrinsicMatrix(), model_->distortionCoeffs(), model_->rotationMatrix(),
+                              model_->projectionMatrix(), model_->fullResolution(), CV_16SC2, map1_, map2_);
+  cv::Rodrigues(cv::Mat(model_->rotationMatrix().t()), unrectify_rotation_);
+  return true;
+}
+
+void CameraRectifier::rectifyImage(const cv::Mat &raw, cv::Mat &rectified, int interpolation) const
+{
+  cv::remap(raw, rectified, map1_, map2_, interpolation);
+}
+
+void CameraRectifier::rectifyPoints(const std::vector<cv::Point2f> &raw, std::vector<cv::Point2f> &rectified) const
+{
+  if (raw.empty())
+  {
+    rectified.clear();
+    return;
+  }
+  cv::undistortPoints(raw, rectified, model_->intrinsicMatrix(), model_->distortionCoeffs(),
+                      model_->rotationMatrix(), model_->projectionMatrix());
+}
+
+void CameraRectifier::unrectifyPoints(const std::vector<cv::Point2f> &rectified, std::vector<cv::Point2f> &raw) const
+{
+  if (rectified.empty())
+  {
+    raw.clear();
+    return;
+  }
+  // Each rectified pixel back to its ray in the rectified frame, which is rotated into the raw frame and distorted
+  std::vector<cv::Point3f> rays(rectified.size());
+  const double fx = model_->fx(), fy = model_->fy(), cx = model_->cx(), cy = model_->cy();
+  const double tx = model_->Tx(), ty = model_->Ty();
+  for (size_t i = 0; i < rectified.size(); i++)
+    rays[i] = cv::Point3f((rectified[i].x - cx - tx) / fx, (rectified[i].y - cy - ty) / fy, 1.0f);
+  cv::projectPoints(rays, unrectify_rotation_, cv::Mat::zeros(3, 1, CV_64F), model_->intrinsicMatrix(),
+                    model_->distortionCoeffs(), raw);
+}
+
+}  // namespace mil_vision
@@ -1,5 +1,7 @@
 #include <colorizer/camera_observer.hpp>
 
+#include <pcl_conversions/pcl_conversions.h>
+
 namespace mil_vision
 {
 using mil_tools::operator"" _s;  // converts to std::string
@@ -18,16 +20,26 @@ CameraObserver::CameraObserver(ros::NodeHandle &nh, std::string &pcd_in_topic, s
   catch (std::exception &e)
   {
     std::cout << __PRETTY_FUNCTION__ << " exception caught: " << e.what() << std::endl;
+    return;
   }
 
+  _nh.param<int>("occlusion_radius", _occlusion_radius, _occlusion_radius);
+  _nh.param<float>("occlusion_tolerance", _occlusion_tolerance, _occlusion_tolerance);
+
   // Check that tf for this camera is up (default template arg is pcl::PointXYZ)
   auto velodyne_msg = ros::topic::waitForMessage<PCD<>>(pcd_in_topic, _nh, ros::Duration{ 3, 0 });
+  if (!velodyne_msg)
+  {
+    _err_msg = "COLORIZER: no point cloud received on "_s + pcd_in_topic + " to check tf with"_s;
+    ROS_ERROR(_err_msg.c_str());
+    return;
+  }
   std::string src_frame_id = velodyne_msg->header.frame_id;
-  std::string target_frame_id;
+  std::string target_frame_id = _cam_stream.getCameraModelPtr()->tfFrame();
   ros::Duration tf_timeout{ 5, 0 };  // Wait 5 seconds max for each TF
   std::string err = "COLORIZER: waiting for tf between "_s + src_frame_id + " and "_s + target_frame_id + ": "_s;
-  if (_tf_listener.waitForTransform(_cam_stream.getCameraModelPtr()->tfFrame(), src_frame_id, ros::Time(0), tf_timeout,
-                                    ros::Duration(0.05), &err))
+  if (_tf_listener.waitForTransform(target_frame_id, src_frame_id, ros::Time(0), tf_timeout, ros::Duration(0.05),
+                                    &err))
   {
     _ok = true;
     return;  // Ideal return point
@@ -36,36 +48,82 @@ CameraObserver::CameraObserver(ros::NodeHandle &nh, std::string &pcd_in_topic, s
     ROS_ERROR(err.c_str());  // TF not available
 }
 
-ColorObservation::VecImg CameraObserver::get_color_observations(const PCD<pcl::PointXYZ>::ConstPtr &pcd)
+bool CameraObserver::get_color_observations(const PCD<pcl::PointXYZ>::ConstPtr &pcd)
 {
-  using std::vector;
-  using std::cout;
-  using std::endl;
-  cout << __PRETTY_FUNCTION__ << endl;
+  ros::Time stamp = pcl_conversions::fromPCL(pcd->header).stamp;
+  auto frame = _cam_stream.getFrameFromTime(stamp);
+  if (!frame)
+    return false;
+  auto cam_model = frame->getCameraModelPtr();
+  if (!cam_model)
+    cam_model = _cam_stream.getCameraModelPtr();
+
+  // Transforming each point into the frame of the camera as it is projected saves copying the cloud
+  tf::StampedTransform transform;
+  try
+  {
+    _tf_listener.lookupTransform(cam_model->tfFrame(), pcd->header.frame_id, ros::Time(0), transform);
+  }
+  catch (tf::TransformException &e)
+  {
+    ROS_WARN_THROTTLE_NAMED(1, "COLORIZER", "COLORIZER: %s", e.what());
+    return false;
+  }
+  Eigen::Matrix3f R;
+  Eigen::Vector3f t;
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 3; j++)
+      R(i, j) = transform.getBasis()[i][j];
+    t(i) = transform.getOrigin()[i];
+  }
 
-  // Structre: Image pixels are lists of ColorObservations for the respective pixels in the image that have
-  // pcd points that would be imaged there
-  auto obs_img = vector<vector<ColorObservation>>{ size_t(_cam_stream.rows()),
-                                                   vector<ColorObservation>{ size_t(_cam_stream.cols()) } };
-  PCD<pcl::PointXYZ> pcd_cam{};  // _cam indicates the reference frame
-  auto cam_model = _cam_stream.getCameraModelPtr();
+  // The images are rectified, so the projection matrix takes points straight to pixels
+  Eigen::Matrix<float, 3, 4> P;
+  cv::cv2eigen(cv::Mat(cam_model->projectionMatrix()), P);
+  P.topRows<2>() *= frame->getImageScale();  // Frames may be stored at a smaller scale than the camera model
 
-  // We will first transform the pcd from lidar frame into the frame of the camera so that we may project
-  // it into the image with just the camera intrinsics
-  pcl_ros::transformPointCloud<pcl::PointXYZ>(cam_model->tfFrame(), *pcd, pcd_cam, _tf_listener);
+  const cv::Mat_<cv::Vec3b> &image = frame->image();
+  const int rows = image.rows;
+  const int cols = image.cols;
 
-  cv::Matx33d K_cv = cam_model->fullIntrinsicMatrix();
-  Eigen::Matrix3d K_eigen;
-  cv::cv2eigen(K_cv, K_eigen);
+  // Structure: Image pixels are lists of ColorObservations for the respective pixels in the image that have
+  // pcd points that would be imaged there. They are projected in cloud order first, then sorted into pixels.
+  _projected.clear();
 
-  for (auto pt : pcd_cam)
+  for (size_t idx = 0; idx < pcd->size(); idx++)
   {
-    cout << "Pt: " << pt << endl;
-    auto imaged_pt = K_eigen * Eigen::Matrix<double, 3, 1>{ pt.x, pt.y, pt.z };
-    cout << "Imaged pt: " << imaged_pt << endl;
-    pt = pcl::PointXYZ(imaged_pt[0], imaged_pt[1], imaged_pt[2]);
+    const pcl::PointXYZ &pt = pcd->points[idx];
+    Eigen::Vector3f pt_cam = R * Eigen::Vector3f(pt.x, pt.y, pt.z) + t;
+    if (!(pt_cam.z() > 0))  // Behind the camera, or NaN
+      continue;
+    Eigen::Vector3f imaged_pt = P.leftCols<3>() * pt_cam + P.col(3);
+    float x = imaged_pt[0] / imaged_pt[2];
+    float y = imaged_pt[1] / imaged_pt[2];
+    if (!(x >= 0 && x < cols && y >= 0 && y < rows))
+      continue;
+    int col = int(x);
+    int row = int(y);
+
+    ColorObservation obs;
+    obs.xyz[0] = pt.x;
+    obs.xyz[1] = pt.y;
+    obs.xyz[2] = pt.z;
+    const cv::Vec3b &bgr = image(row, col);
+    obs.bgr[0] = bgr[0];
+    obs.bgr[1] = bgr[1];
+    obs.bgr[2] = bgr[2];
+    obs.idx = idx;
+    obs.pixel = row * cols + col;
+    obs.distance = pt_cam.norm();
+    // Near points are seen in more detail, and points near the edges of the image have more lens error
+    obs.weight = (pt_cam.z() / obs.distance) / (1 + obs.distance);
+    _projected.push_back(obs);
   }
-  return ColorObservation::VecImg();
+
+  _obs_img.build(rows, cols, _projected);
+  _unoccluded_img.build(_obs_img, _occlusion_radius, _occlusion_tolerance);
+  return true;
 }
 
 }  // namespace mil_vision
@@ -1,12 +1,50 @@
 #include <colorizer/color_observation.hpp>
 
+#include <limits>
+
 namespace mil_vision
 {
+void ColorObservationImg::build(int rows, int cols, const ColorObservation::Vec &observations)
+{
+  _rows = rows;
+  _cols = cols;
+  const int pixels = rows * cols;
+
+  // Count, then turn the counts into offsets
+  _offsets.assign(pixels + 1, 0);
+  for (const ColorObservation &obs : observations)
+    _offsets[obs.pixel + 1]++;
+  for (int pixel = 0; pixel < pixels; pixel++)
+    _offsets[pixel + 1] += _offsets[pixel];
+
+  // Fill
+  _fill.assign(_offsets.begin(), _offsets.end() - 1);
+  _obs.resize(observations.size());
+  for (const ColorObservation &obs : observations)
+    _obs[_fill[obs.pixel]++] = obs;
+}
+
 UnoccludedPointsImg::UnoccludedPointsImg()
-// : frame_ptr(frame_ptr),
-//   cloud_ptr(cloud_ptr)
 {
-  // auto cam_model = frame_ptr->getCameraModelPtr();
 }
 
-}  // namespace mil_vision
\ No newline at end of file
+void UnoccludedPointsImg::build(const ColorObservationImg &obs_img, int window_radius, float relative_tolerance)
+{
+  _relative_tolerance = relative_tolerance;
+
+  // Closest observation in each pixel
+  distance_image.create(obs_img.rows(), obs_img.cols());
+  distance_image.setTo(std::numeric_limits<float>::infinity());
+  float *distances = distance_image.ptr<float>();
+  for (const ColorObservation &obs : obs_img.all())
+    distances[obs.pixel] = std::min(distances[obs.pixel], obs.distance);
+
+  // Spread over the window, erosion being a min filter
+  if (window_radius > 0)
+  {
+    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2 * window_radius + 1, 2 * window_radius + 1));
+    cv::erode(distance_image, distance_image, kernel);
+  }
+}
+
+}  // namespace mil_vision
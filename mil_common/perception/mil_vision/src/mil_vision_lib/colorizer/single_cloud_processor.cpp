@@ -35,22 +35,135 @@ SingleCloudProcessor::SingleCloudProcessor(ros::NodeHandle nh, std::string& in_p
   {
     _err_msg = "SingleCloudProcessor: No ROSCameraStreams could be initialized.";
     ROS_ERROR_NAMED("COLORIZER", _err_msg.c_str());
+    return;
   }
-  else
-    _ok = true;
+
+  _observed.resize(_camera_observers.size());
+  for (size_t i = 0; i < _camera_observers.size(); i++)
+    _workers.emplace_back(&SingleCloudProcessor::_work, this, i);
+  _ok = true;
   return;
 }
 
-void SingleCloudProcessor::operator()(const PCD<pcl::PointXYZ>::ConstPtr& pcd)
+SingleCloudProcessor::~SingleCloudProcessor()
+{
+  {
+    std::lock_guard<std::mutex> lock{ _work_mtx };
+    _stop = true;
+  }
+  _start_work_cv.notify_all();
+  for (std::thread& worker : _workers)
+    worker.join();
+}
+
+void SingleCloudProcessor::_work(size_t observer_idx)
 {
-  std::cout << "Called the single cloud processor operator()" << std::endl;
-  std::cout << "pcd: " << pcd->header << std::endl;
+  int done_seq = 0;
+  for (;;)
+  {
+    PCD<pcl::PointXYZ>::ConstPtr pcd;
+    {
+      std::unique_lock<std::mutex> lock{ _work_mtx };
+      _start_work_cv.wait(lock, [&] { return _stop || seq != done_seq; });
+      if (_stop)
+        return;
+      done_seq = seq;
+      pcd = _pcd;
+    }
+
+    // Each worker only touches its own observer and its own flag, so this needs no lock
+    _observed[observer_idx] = (*_camera_observers[observer_idx])(pcd);
 
-  // Get color observation list from each of the observers
+    {
+      std::lock_guard<std::mutex> lock{ _work_mtx };
+      _workers_done++;
+    }
+    _worker_done_cv.notify_one();
+  }
+}
+
+PCD<pcl::PointXYZRGB>::Ptr SingleCloudProcessor::operator()(const PCD<pcl::PointXYZ>::ConstPtr& pcd)
+{
+  if (!_ok)
+    return nullptr;
+
+  // Get color observation list from each of the observers, in parallel
+  {
+    std::unique_lock<std::mutex> lock{ _work_mtx };
+    _pcd = pcd;
+    _workers_done = 0;
+    seq++;
+    _start_work_cv.notify_all();
+    _worker_done_cv.wait(lock, [this] { return _workers_done == _workers.size(); });
+    _pcd = nullptr;
+  }
 
   // Merge lists from all of the observers
+  _merge(pcd->size());
 
   // Summarize Confidence in each point color observation
+  PCD<pcl::PointXYZRGB>::Ptr colored{ new PCD<pcl::PointXYZRGB>() };
+  colored->header = pcd->header;
+  for (const PointColorStats& stats : _stats)
+  {
+    if (stats.n == 0)
+      continue;
+    pcl::PointXYZRGB pt;
+    pt.x = stats.xyz[0];
+    pt.y = stats.xyz[1];
+    pt.z = stats.xyz[2];
+    pt.b = stats.bgr[0];
+    pt.g = stats.bgr[1];
+    pt.r = stats.bgr[2];
+    colored->push_back(pt);
+  }
+  return colored;
+}
+
+void SingleCloudProcessor::_merge(size_t points)
+{
+  _sums.assign(points, ColorSums{ 0, { 0, 0, 0 }, { 0, 0, 0 }, 0 });
+  _stats.resize(points);
+
+  // Straight from the observation image of each camera, in pixel order
+  for (size_t i = 0; i < _camera_observers.size(); i++)
+  {
+    if (!_observed[i])
+      continue;
+    const UnoccludedPointsImg& unoccluded_img = _camera_observers[i]->unoccludedImg();
+    for (const ColorObservation& obs : _camera_observers[i]->observations().all())
+    {
+      if (!unoccluded_img.unoccluded(obs))
+        continue;
+      ColorSums& sums = _sums[obs.idx];
+      sums.weight += obs.weight;
+      for (int c = 0; c < 3; c++)
+      {
+        sums.bgr[c] += obs.weight * obs.bgr[c];
+        sums.bgr_sq[c] += obs.weight * obs.bgr[c] * obs.bgr[c];
+      }
+      sums.n++;
+      std::copy(obs.xyz, obs.xyz + 3, _stats[obs.idx].xyz);
+    }
+  }
+
+  for (size_t idx = 0; idx < points; idx++)
+  {
+    const ColorSums& sums = _sums[idx];
+    PointColorStats& stats = _stats[idx];
+    stats.n = sums.n;
+    if (sums.n == 0 || !(sums.weight > 0))
+    {
+      stats.n = 0;
+      continue;
+    }
+    for (int c = 0; c < 3; c++)
+    {
+      float mean = sums.bgr[c] / sums.weight;
+      stats.bgr[c] = uint8_t(std::min(255.f, std::max(0.f, std::round(mean))));
+      stats.var[c] = std::max(0.f, sums.bgr_sq[c] / sums.weight - mean * mean);
+    }
+  }
 }
 
 }  // namespace mil_vision
@@ -1,5 +1,7 @@
 #include <mil_vision_lib/cv_tools.hpp>
 
+#include <chrono>
+
 namespace mil_vision
 {
 cv::Point contour_centroid(Contour &contour)
@@ -201,192 +203,348 @@ void statistical_image_segmentation(const cv::Mat &src, cv::Mat &dest, cv::Mat &
                                     const float **ranges, const int target, std::string image_name, bool ret_dbg_img,
                                     const float sigma, const float low_thresh_gain, const float high_thresh_gain)
 {
-  std::stringstream ros_log;
-  ros_log << "\x1b[1;31m"
-          << "statistical_image_segmentation"
-          << "\x1b[0m" << std::endl;
+  StatisticalImageSegmenter segmenter(hist_size, ranges[0], sigma);
+  segmenter.segment(src, dest, target, low_thresh_gain, high_thresh_gain);
+
+#ifdef SEGMENTATION_DEBUG
+  ROS_INFO("statistical_image_segmentation: target=%d mode=%d low=%d high=%d", target, segmenter.target_mode(),
+           segmenter.low_thresh(), segmenter.high_thresh());
+  cv::imshow("src" + image_name, src);
+  cv::waitKey(1);
+#endif
+
+  if (ret_dbg_img)
+    segmenter.draw_debug_image(dest, debug_img, image_name);
+}
+
+namespace
+{
+// find_local_maxima and find_local_minima without the logging, into a reused vector
+void find_local_extrema(const cv::Mat &histogram, float thresh_multiplier, bool maxima,
+                        std::vector<cv::Point> &extrema)
+{
+  extrema.clear();
+  float global_extremum = maxima ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+  const float *h = histogram.ptr<float>();
+  for (size_t idx = 1; idx < histogram.total() - 1; idx++)
+  {
+    float current_value = h[idx];
+    bool extremum = maxima ? (h[idx - 1] < current_value && h[idx + 1] <= current_value) :
+                             (h[idx - 1] >= current_value && h[idx + 1] > current_value);
+    if (extremum)
+    {
+      extrema.push_back(cv::Point(idx, current_value));
+      global_extremum = maxima ? std::max(global_extremum, current_value) : std::min(global_extremum, current_value);
+    }
+  }
+  const float thresh = global_extremum * thresh_multiplier;
+  extrema.erase(std::remove_if(extrema.begin(), extrema.end(),
+                               [&](const cv::Point &pt) { return maxima ? !(pt.y > thresh) : !(pt.y < thresh); }),
+                extrema.end());
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point &since)
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  double ms = std::chrono::duration<double, std::milli>(now - since).count();
+  since = now;
+  return ms;
+}
+}  // namespace
+
+StatisticalImageSegmenter::StatisticalImageSegmenter(int hist_size, const float *range, float sigma, int kernel_size)
+  : _hist_size(hist_size)
+  , _range{ range[0], range[1] }
+  , _sigma(sigma)
+  , _kernel_size(kernel_size)
+  , _kernel(generate_gaussian_kernel_1D(kernel_size, sigma))
+{
+  int dilation_size = 2;
+  _structuring_element =
+      cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(2 * dilation_size + 1, 2 * dilation_size + 1),
+                                cv::Point(dilation_size, dilation_size));
+}
+
+void StatisticalImageSegmenter::set_roi_tracking(int padding, int full_frame_interval)
+{
+  _roi_padding = padding;
+  _full_frame_interval = full_frame_interval;
+  reset();
+}
+
+void StatisticalImageSegmenter::set_histogram_memory(float decay)
+{
+  _decay = std::min(std::max(decay, 0.f), 0.99f);
+}
+
+void StatisticalImageSegmenter::reset()
+{
+  _roi = cv::Rect();
+  _frames_since_full_frame = 0;
+  _hist_pixels = 0;
+}
+
+void StatisticalImageSegmenter::_smooth(cv::Mat &hist) const
+{
+  // Convolved in place with an integer sum, exactly as smooth_histogram does, so thresholds do not change
+  float *h = hist.ptr<float>();
+  const int hist_size = hist.total();
+  const int offset = (_kernel_size - 1) / 2;
+  for (int i = offset; i < hist_size - offset; i++)
+  {
+    int sum = 0;
+    for (int k = 0; k < _kernel_size; k++)
+      sum += h[i - offset + k] * _kernel[k];
+    h[i] = sum;
+  }
+  for (int i = 0; i < offset && i < hist_size; ++i)
+  {
+    h[i] = 0;
+    h[hist_size - 1 - i] = 0;
+  }
+}
+
+void StatisticalImageSegmenter::segment(const cv::Mat &src, cv::Mat &dest, int target, float low_thresh_gain,
+                                        float high_thresh_gain)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point stage = start;
+
+  // Histogram, of the tracked box when there is one
+  bool full_frame = _roi_padding < 0 || _roi.area() == 0 || _frames_since_full_frame >= _full_frame_interval;
+  cv::Mat region = full_frame ? src : src(_roi);
+  _frames_since_full_frame = full_frame ? 0 : _frames_since_full_frame + 1;
+  const float *ranges[] = { _range };
+  cv::calcHist(&region, 1, 0, cv::Mat(), _frame_hist, 1, &_hist_size, ranges, true, false);
+  const double pixels = region.total();
+  if (_decay > 0 && _hist_pixels > 0 && _hist.size() == _frame_hist.size())
+  {
+    // The previous histogram stands for a different number of pixels, scale it to this one's before blending
+    cv::addWeighted(_hist, _decay * pixels / _hist_pixels, _frame_hist, 1 - _decay, 0, _hist);
+  }
+  else
+  {
+    _frame_hist.copyTo(_hist);
+  }
+  _hist_pixels = pixels;
+  _timing.histogram_ms = elapsed_ms(stage);
+
+  _select_thresholds(target, low_thresh_gain, high_thresh_gain);
+  _timing.thresholds_ms = elapsed_ms(stage);
+
+  threshold_range(src, _low_thresh, _high_thresh, dest);
+  _timing.threshold_ms = elapsed_ms(stage);
 
-  // Calculate histogram
-  cv::MatND hist, hist_smooth, hist_derivative;
-  cv::calcHist(&src, 1, 0, cv::Mat(), hist, 1, &hist_size, ranges, true, false);
+  // Closing Morphology operation
+  cv::dilate(dest, dest, _structuring_element);
+  cv::erode(dest, dest, _structuring_element);
+  _timing.morphology_ms = elapsed_ms(stage);
+
+  if (_roi_padding >= 0)
+    _track(dest);
+  _timing.total_ms = elapsed_ms(start);
+}
 
+void StatisticalImageSegmenter::_select_thresholds(int target, float low_thresh_gain, float high_thresh_gain)
+{
   // Smooth histogram
-  const int kernel_size = 11;
-  hist_smooth = mil_vision::smooth_histogram(hist, kernel_size, sigma);
+  _hist.copyTo(_hist_smooth);
+  _smooth(_hist_smooth);
 
   // Calculate histogram derivative (central finite difference)
-  hist_derivative = hist_smooth.clone();
-  hist_derivative.at<float>(0) = 0;
-  hist_derivative.at<float>(hist_size - 1) = 0;
-  for (int i = 1; i < hist_size - 1; ++i)
+  _hist_smooth.copyTo(_hist_derivative);
+  float *derivative = _hist_derivative.ptr<float>();
+  const float *smooth = _hist_smooth.ptr<float>();
+  derivative[0] = 0;
+  derivative[_hist_size - 1] = 0;
+  for (int i = 1; i < _hist_size - 1; ++i)
+    derivative[i] = (smooth[i + 1] - smooth[i - 1]) / 2.0;
+  _smooth(_hist_derivative);
+
+  // Find target mode, the last of the closest ones like select_hist_mode
+  find_local_extrema(_hist_smooth, 0.1, true, _modes);
+  _target_mode = 0;
+  int min_distance = std::numeric_limits<int>::max();
+  for (const cv::Point &mode : _modes)
   {
-    hist_derivative.at<float>(i) = (hist_smooth.at<float>(i + 1) - hist_smooth.at<float>(i - 1)) / 2.0;
+    if (std::abs(mode.x - target) <= min_distance)
+    {
+      min_distance = std::abs(mode.x - target);
+      _target_mode = mode.x;
+    }
   }
-  hist_derivative = mil_vision::smooth_histogram(hist_derivative, kernel_size, sigma);
-
-  // Find target mode
-  std::vector<cv::Point> histogram_modes = mil_vision::find_local_maxima(hist_smooth, 0.1);
-  int target_mode = mil_vision::select_hist_mode(histogram_modes, target);
-  ros_log << "Target: " << target << std::endl;
-  ros_log << "Mode Selected: " << target_mode << std::endl;
 
-  // Calculate std dev of histogram slopes
+  // Determine thresholds using the std dev of histogram slopes times a gain as a cutoff heuristic
   cv::Scalar hist_deriv_mean, hist_deriv_stddev;
-  cv::meanStdDev(hist_derivative, hist_deriv_mean, hist_deriv_stddev);
-
-  // Determine thresholds for cv::inRange() using the std dev of histogram
-  // slopes times a gain as a cutoff heuristic
+  cv::meanStdDev(_hist_derivative, hist_deriv_mean, hist_deriv_stddev);
   int high_abs_derivative_thresh = std::abs(hist_deriv_stddev[0] * high_thresh_gain);
   int low_abs_derivative_thresh = std::abs(hist_deriv_stddev[0] * low_thresh_gain);
-  std::vector<cv::Point> derivative_maxima = mil_vision::find_local_maxima(hist_derivative, 0.01);
-  std::vector<cv::Point> derivative_minima = mil_vision::find_local_minima(hist_derivative, 0.01);
-  int high_thresh_search_start = target_mode;
-  int low_thresh_search_start = target_mode;
-  ros_log << "high_thresh_search_start: " << target_mode << std::endl;
-  ros_log << "Looking for the local minimum of the derivative of the histogram "
-             "immediately to the right of the selected mode."
-          << std::endl;
-
-  for (size_t i = 0; i < derivative_minima.size(); i++)
-  {
-    ros_log << "\tderivative_minima[" << i << "].x = " << derivative_minima[i].x << std::endl;
-    if (derivative_minima[i].x > target_mode)
+  find_local_extrema(_hist_derivative, 0.01, true, _derivative_maxima);
+  find_local_extrema(_hist_derivative, 0.01, false, _derivative_minima);
+
+  // Start from the local minimum of the derivative right of the mode, and the local maximum left of it
+  int high_thresh_search_start = _target_mode;
+  int low_thresh_search_start = _target_mode;
+  for (const cv::Point &minimum : _derivative_minima)
+  {
+    if (minimum.x > _target_mode)
     {
-      high_thresh_search_start = derivative_minima[i].x;
-      ros_log << "Done: The upper threshold will be no less than " << high_thresh_search_start << std::endl;
+      high_thresh_search_start = minimum.x;
       break;
     }
   }
-  ros_log << "low_thresh_search_start: " << target_mode << std::endl;
-  ros_log << "Looking for the local maximum of the derivative of the histogram "
-             "immediately to the left of the selected mode."
-          << std::endl;
-  for (int i = derivative_maxima.size() - 1; i >= 0; i--)
+  for (int i = _derivative_maxima.size() - 1; i >= 0; i--)
   {
-    ros_log << "\tderivative_maxima[" << i << "].x = " << derivative_maxima[i].x << std::endl;
-    if (derivative_maxima[i].x < target_mode)
+    if (_derivative_maxima[i].x < _target_mode)
     {
-      low_thresh_search_start = derivative_maxima[i].x;
-      ros_log << "Done: The lower threshold will be no greater than " << low_thresh_search_start << std::endl;
+      low_thresh_search_start = _derivative_maxima[i].x;
       break;
     }
   }
-  int high_thresh = high_thresh_search_start;
-  int low_thresh = low_thresh_search_start;
-  ros_log << "high_deriv_thresh: " << hist_deriv_stddev[0] << " * " << high_thresh_gain << " = "
-          << high_abs_derivative_thresh << std::endl;
-  ros_log << "abs(high_deriv_thresh) - abs(slope) = slope_error" << std::endl;
-  ros_log << "i: potential upper threshold" << std::endl;
-  ros_log << "Looking for first i such that slope_error >= 0" << std::endl;
-  for (int i = high_thresh_search_start; i < hist_size; i++)
-  {
-    int abs_slope = std::abs(hist_derivative.at<float>(i));
-    ros_log << "\ti = " << i << "  :  " << high_abs_derivative_thresh << " - " << abs_slope << " = "
-            << high_abs_derivative_thresh - abs_slope << std::endl;
+
+  // Then out to where the slope flattens
+  _high_thresh = high_thresh_search_start;
+  _low_thresh = low_thresh_search_start;
+  for (int i = high_thresh_search_start; i < _hist_size; i++)
+  {
+    int abs_slope = std::abs(derivative[i]);
     if (abs_slope <= high_abs_derivative_thresh)
     {
-      high_thresh = i;
+      _high_thresh = i;
       break;
     }
   }
-  ros_log << "high_thresh = " << high_thresh << std::endl;
-  ros_log << "low_deriv_thresh: " << hist_deriv_stddev[0] << " * " << low_thresh_gain << " = "
-          << low_abs_derivative_thresh << std::endl;
-  ros_log << "abs(low_deriv_thresh) - abs(slope) = slope_error" << std::endl;
-  ros_log << "i: potential lower threshold" << std::endl;
-  ros_log << "Looking for first i such that slope_error <= 0" << std::endl;
   for (int i = low_thresh_search_start; i > 0; i--)
   {
-    int abs_slope = std::abs(hist_derivative.at<float>(i));
-    ros_log << "\ti = " << i << "  :  " << low_abs_derivative_thresh << " - " << abs_slope << " = "
-            << high_abs_derivative_thresh - abs_slope << std::endl;
-
+    int abs_slope = std::abs(derivative[i]);
     if (abs_slope <= low_abs_derivative_thresh)
     {
-      low_thresh = i;
+      _low_thresh = i;
       break;
     }
   }
+}
 
-  ros_log << "low_thresh = " << low_thresh << std::endl;
-  ros_log << "\x1b[1;37mTarget: " << target << "\nClosest distribution mode: " << target_mode
-          << "\nThresholds selected:  low=" << low_thresh << "  high=" << high_thresh << "\x1b[0m" << std::endl;
-
-  // Threshold image
-  cv::inRange(src, low_thresh, high_thresh, dest);
-
-#ifdef SEGMENTATION_DEBUG
-  ROS_INFO(ros_log.str().c_str());
-  cv::imshow("src" + image_name, src);
-  cv::waitKey(1);
-#endif
+void StatisticalImageSegmenter::_track(const cv::Mat &dest)
+{
+  // Bounding box of the segmentation, from the maximum of each row and column
+  cv::reduce(dest, _row_max, 1, CV_REDUCE_MAX);
+  cv::reduce(dest, _col_max, 0, CV_REDUCE_MAX);
+  const uint8_t *rows = _row_max.ptr<uint8_t>();
+  const uint8_t *cols = _col_max.ptr<uint8_t>();
+  int top = 0, bottom = dest.rows - 1, left = 0, right = dest.cols - 1;
+  while (top < dest.rows && !rows[top])
+    top++;
+  if (top == dest.rows)
+  {
+    _roi = cv::Rect();
+    return;
+  }
+  while (!rows[bottom])
+    bottom--;
+  while (!cols[left])
+    left++;
+  while (!cols[right])
+    right--;
+  cv::Rect box(left - _roi_padding, top - _roi_padding, right - left + 1 + 2 * _roi_padding,
+               bottom - top + 1 + 2 * _roi_padding);
+  _roi = box & cv::Rect(0, 0, dest.cols, dest.rows);
+}
 
-  // Closing Morphology operation
-  int dilation_size = 2;
-  cv::Mat structuring_element =
-      cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(2 * dilation_size + 1, 2 * dilation_size + 1),
-                                cv::Point(dilation_size, dilation_size));
-  cv::dilate(dest, dest, structuring_element);
-  cv::erode(dest, dest, structuring_element);
+void StatisticalImageSegmenter::threshold_range(const cv::Mat &src, int low, int high, cv::Mat &dest,
+                                                const cv::Mat &mask)
+{
+  CV_Assert(src.type() == CV_8UC1 && (mask.empty() || (mask.type() == CV_8UC1 && mask.size() == src.size())));
+  dest.create(src.size(), CV_8UC1);
+  low = std::max(low, 0);
+  high = std::min(high, 255);
+  if (low > high)
+  {
+    dest.setTo(0);
+    return;
+  }
 
-  if (ret_dbg_img)
+  // low <= v <= high as one unsigned compare, and 0 or 255 from it without branches, so the loops vectorize
+  const uint8_t lo = low;
+  const uint8_t span = high - low;
+  for (int row = 0; row < src.rows; row++)
   {
-    try
+    const uint8_t *__restrict__ s = src.ptr<uint8_t>(row);
+    uint8_t *__restrict__ d = dest.ptr<uint8_t>(row);
+    if (mask.empty())
     {
-      // Prepare to draw graph of histogram and derivative
-      int hist_w = src.cols;
-      int hist_h = src.rows;
-      int bin_w = hist_w / hist_size;
-      cv::Mat histImage(hist_h, hist_w, CV_8UC1, cv::Scalar(0, 0, 0));
-      cv::Mat histDerivImage(hist_h, hist_w, CV_8UC1, cv::Scalar(0, 0, 0));
-      cv::normalize(hist_smooth, hist_smooth, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat());
-      cv::normalize(hist_derivative, hist_derivative, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat());
-
-      // Draw Graphs
-      for (int i = 1; i < hist_size; i++)
-      {
-        // Plot image histogram
-        cv::line(histImage, cv::Point(bin_w * (i - 1), hist_h - cvRound(hist_smooth.at<float>(i - 1))),
-                 cv::Point(bin_w * (i), hist_h - cvRound(hist_smooth.at<float>(i))), cv::Scalar(255, 0, 0), 2, 8, 0);
-        // Plot image histogram derivative
-        cv::line(histDerivImage, cv::Point(bin_w * (i - 1), hist_h - cvRound(hist_derivative.at<float>(i - 1))),
-                 cv::Point(bin_w * (i), hist_h - cvRound(hist_derivative.at<float>(i))), cv::Scalar(122, 0, 0), 1, 8,
-                 0);
-      }
-
-      // Shade in area being segmented under histogram curve
-      cv::line(histImage, cv::Point(bin_w * low_thresh, hist_h - cvRound(hist_smooth.at<float>(low_thresh))),
-               cv::Point(bin_w * low_thresh, hist_h), cv::Scalar(255, 255, 0), 2);
-      cv::line(histImage, cv::Point(bin_w * high_thresh, hist_h - cvRound(hist_smooth.at<float>(high_thresh))),
-               cv::Point(bin_w * high_thresh, hist_h), cv::Scalar(255, 255, 0), 2);
-      cv::floodFill(histImage, cv::Point(bin_w * cvRound(float(low_thresh + high_thresh) / 2.0), hist_h - 1),
-                    cv::Scalar(155));
-
-      // Combine graphs into one image and display results
-      cv::Mat segmentation_channel = cv::Mat::zeros(histImage.size(), CV_8UC1);
-      std::vector<cv::Mat> debug_img_channels;
-      debug_img_channels.push_back(histImage);
-      debug_img_channels.push_back(histDerivImage);
-      debug_img_channels.push_back(dest * 0.25);
-      cv::merge(debug_img_channels, debug_img);
-      cv::Point text_upper_left(debug_img.cols / 2.0, debug_img.rows / 10.0);
-      std::string text_ln1 = image_name;
-      std::stringstream text_ln2;
-      text_ln2 << "low = " << low_thresh;
-      std::stringstream text_ln3;
-      text_ln3 << "high = " << high_thresh;
-      int font = cv::FONT_HERSHEY_SIMPLEX;
-      double font_scale = 0.0015 * debug_img.rows;
-      cv::Point vert_offset = cv::Point(0, debug_img.rows / 15.0);
-      cv::Scalar text_color(255, 255, 0);
-      cv::putText(debug_img, text_ln1, text_upper_left, font, font_scale, text_color);
-      cv::putText(debug_img, text_ln2.str(), text_upper_left + vert_offset, font, font_scale, text_color);
-      cv::putText(debug_img, text_ln3.str(), text_upper_left + vert_offset + vert_offset, font, font_scale, text_color);
+      for (int col = 0; col < src.cols; col++)
+        d[col] = uint8_t(-uint8_t(uint8_t(s[col] - lo) <= span));
+    }
+    else
+    {
+      const uint8_t *__restrict__ m = mask.ptr<uint8_t>(row);
+      for (int col = 0; col < src.cols; col++)
+        d[col] = uint8_t(-uint8_t(uint8_t(s[col] - lo) <= span)) & uint8_t(-uint8_t(m[col] != 0));
     }
-    catch (std::exception &e)
+  }
+}
+
+void StatisticalImageSegmenter::draw_debug_image(const cv::Mat &dest, cv::Mat &debug_img,
+                                                 const std::string &image_name) const
+{
+  try
+  {
+    // Prepare to draw graph of histogram and derivative
+    int hist_w = dest.cols;
+    int hist_h = dest.rows;
+    int bin_w = hist_w / _hist_size;
+    const int low_thresh = _low_thresh;
+    const int high_thresh = _high_thresh;
+    cv::Mat histImage(hist_h, hist_w, CV_8UC1, cv::Scalar(0, 0, 0));
+    cv::Mat histDerivImage(hist_h, hist_w, CV_8UC1, cv::Scalar(0, 0, 0));
+    cv::Mat hist_smooth, hist_derivative;
+    cv::normalize(_hist_smooth, hist_smooth, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat());
+    cv::normalize(_hist_derivative, hist_derivative, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat());
+
+    // Draw Graphs
+    for (int i = 1; i < _hist_size; i++)
     {
-      ROS_INFO(e.what());
+      // Plot image histogram
+      cv::line(histImage, cv::Point(bin_w * (i - 1), hist_h - cvRound(hist_smooth.at<float>(i - 1))),
+               cv::Point(bin_w * (i), hist_h - cvRound(hist_smooth.at<float>(i))), cv::Scalar(255, 0, 0), 2, 8, 0);
+      // Plot image histogram derivative
+      cv::line(histDerivImage, cv::Point(bin_w * (i - 1), hist_h - cvRound(hist_derivative.at<float>(i - 1))),
+               cv::Point(bin_w * (i), hist_h - cvRound(hist_derivative.at<float>(i))), cv::Scalar(122, 0, 0), 1, 8,
+               0);
     }
+
+    // Shade in area being segmented under histogram curve
+    cv::line(histImage, cv::Point(bin_w * low_thresh, hist_h - cvRound(hist_smooth.at<float>(low_thresh))),
+             cv::Point(bin_w * low_thresh, hist_h), cv::Scalar(255, 255, 0), 2);
+    cv::line(histImage, cv::Point(bin_w * high_thresh, hist_h - cvRound(hist_smooth.at<float>(high_thresh))),
+             cv::Point(bin_w * high_thresh, hist_h), cv::Scalar(255, 255, 0), 2);
+    cv::floodFill(histImage, cv::Point(bin_w * cvRound(float(low_thresh + high_thresh) / 2.0), hist_h - 1),
+                  cv::Scalar(155));
+
+    // Combine graphs into one image and display results
+    std::vector<cv::Mat> debug_img_channels;
+    debug_img_channels.push_back(histImage);
+    debug_img_channels.push_back(histDerivImage);
+    debug_img_channels.push_back(dest * 0.25);
+    cv::merge(debug_img_channels, debug_img);
+    cv::Point text_upper_left(debug_img.cols / 2.0, debug_img.rows / 10.0);
+    std::string text_ln1 = image_name;
+    std::stringstream text_ln2;
+    text_ln2 << "low = " << low_thresh;
+    std::stringstream text_ln3;
+    text_ln3 << "high = " << high_thresh;
+    int font = cv::FONT_HERSHEY_SIMPLEX;
+    double font_scale = 0.0015 * debug_img.rows;
+    cv::Point vert_offset = cv::Point(0, debug_img.rows / 15.0);
+    cv::Scalar text_color(255, 255, 0);
+    cv::putText(debug_img, text_ln1, text_upper_left, font, font_scale, text_color);
+    cv::putText(debug_img, text_ln2.str(), text_upper_left + vert_offset, font, font_scale, text_color);
+    cv::putText(debug_img, text_ln3.str(), text_upper_left + vert_offset + vert_offset, font, font_scale, text_color);
+  }
+  catch (std::exception &e)
+  {
+    ROS_INFO(e.what());
   }
 }
 
@@ -431,6 +589,100 @@ cv::Mat triangulate_Linear_LS(cv::Mat mat_P_l, cv::Mat mat_P_r, cv::Mat undistor
   return X_homogeneous;
 }
 
+void triangulate_Linear_LS(const cv::Matx34d &P_l, const cv::Matx34d &P_r, const cv::Point2d *pts_l,
+                           const cv::Point2d *pts_r, size_t count, Eigen::Vector3d *points, double *reprojection_errors)
+{
+  Eigen::Matrix<double, 3, 4> P[2];
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < 4; j++)
+    {
+      P[0](i, j) = P_l(i, j);
+      P[1](i, j) = P_r(i, j);
+    }
+  }
+
+  // Each image point (x, y) adds the rows x * P.row(2) - P.row(0) and y * P.row(2) - P.row(1) to [A | -b]
+  Eigen::Matrix<double, 4, 4> Ab;
+  Eigen::Matrix3d AtA;
+  Eigen::Vector3d Atb;
+  for (size_t n = 0; n < count; n++)
+  {
+    const cv::Point2d *pts[2] = { &pts_l[n], &pts_r[n] };
+    for (int cam = 0; cam < 2; cam++)
+    {
+      Ab.row(2 * cam) = pts[cam]->x * P[cam].row(2) - P[cam].row(0);
+      Ab.row(2 * cam + 1) = pts[cam]->y * P[cam].row(2) - P[cam].row(1);
+    }
+    // Least squares through the normal equations, 3x3 and well conditioned for cameras of a stereo pair
+    AtA.noalias() = Ab.leftCols<3>().transpose() * Ab.leftCols<3>();
+    Atb.noalias() = -Ab.leftCols<3>().transpose() * Ab.col(3);
+    points[n] = AtA.ldlt().solve(Atb);
+
+    if (reprojection_errors == NULL)
+      continue;
+    double sq_error = 0;
+    for (int cam = 0; cam < 2; cam++)
+    {
+      Eigen::Vector3d imaged = P[cam].leftCols<3>() * points[n] + P[cam].col(3);
+      sq_error += (imaged.head<2>() / imaged(2) - Eigen::Vector2d(pts[cam]->x, pts[cam]->y)).squaredNorm();
+    }
+    reprojection_errors[n] = std::sqrt(sq_error / 2);
+  }
+}
+
+namespace
+{
+enum class EpipolarCorrection
+{
+  KANATANI,
+  LINDSTROM
+};
+
+void epipolar_triangulation(EpipolarCorrection method, const cv::Point2d *pts1, const cv::Point2d *pts2, size_t count,
+                            const Eigen::Matrix3d &essential, const Eigen::Matrix3d &R, Eigen::Vector3d *points,
+                            double *reprojection_errors)
+{
+  const unsigned int max_iterations = 7;
+  const Eigen::Matrix3d essential_t = essential.transpose();
+  const Eigen::Matrix2d essential_bar = essential.topLeftCorner<2, 2>();
+  for (size_t n = 0; n < count; n++)
+  {
+    const Eigen::Vector3d p1_0(pts1[n].x, pts1[n].y, 1.0);
+    const Eigen::Vector3d p2_0(pts2[n].x, pts2[n].y, 1.0);
+    Eigen::Vector3d p1 = p1_0, p2 = p2_0;
+    Eigen::Vector2d n1, n2, delta_p1(0, 0), delta_p2(0, 0);
+    const double c = p1_0.dot(essential * p2_0);
+    for (unsigned int i = 0; i < max_iterations; i++)
+    {
+      n1 = (essential * p2).head<2>();
+      n2 = (essential_t * p1).head<2>();
+      double lambda;
+      if (method == EpipolarCorrection::KANATANI)
+      {
+        lambda = (c - delta_p1.dot(essential_bar * delta_p2)) / (n1.squaredNorm() + n2.squaredNorm());
+      }
+      else
+      {
+        double a = n1.dot(essential_bar * n2);
+        double b = 0.5 * (n1.squaredNorm() + n2.squaredNorm());
+        double d = sqrt(b * b - a * c);
+        double signum_b = (b > 0) ? 1 : ((b < 0) ? -1 : 0);
+        lambda = c / (b + signum_b * d);
+      }
+      delta_p1 = lambda * n1;
+      delta_p2 = lambda * n2;
+      p1.head<2>() = p1_0.head<2>() - delta_p1;
+      p2.head<2>() = p2_0.head<2>() - delta_p2;
+    }
+    Eigen::Vector3d z = p1.cross(R * p2);
+    points[n] = (z.dot(essential * p2) / z.squaredNorm()) * p1;
+    if (reprojection_errors != NULL)
+      reprojection_errors[n] = std::sqrt((delta_p1.squaredNorm() + delta_p2.squaredNorm()) / 2);
+  }
+}
+}  // namespace
+
 Eigen::Vector3d kanatani_triangulation(const cv::Point2d &pt1, const cv::Point2d &pt2, const Eigen::Matrix3d &essential,
                                        const Eigen::Matrix3d &R)
 {
@@ -439,42 +691,18 @@ Eigen::Vector3d kanatani_triangulation(const cv::Point2d &pt1, const cv::Point2d
      revisited: Hartley-Sturm vs. optimal
           correction. In British Machine Vision Conference, page 55, 2008.
   */
-  // std::cout << "ptL_noisy: " << pt1 << " ptR_noisy: " << pt2 << std::endl;
-  const unsigned int max_iterations = 7;
-  Eigen::Vector3d p1_old(pt1.x, pt1.y, 1.0);
-  Eigen::Vector3d p2_old(pt2.x, pt2.y, 1.0);
-  const Eigen::Vector3d p1_0(pt1.x, pt1.y, 1.0);
-  const Eigen::Vector3d p2_0(pt2.x, pt2.y, 1.0);
-  Eigen::Vector3d p1, p2;
-  Eigen::Vector2d n1, n2, delta_p1, delta_p2, delta_p1_old, delta_p2_old;
-  delta_p1_old << 0.0, 0.0;
-  delta_p2_old << 0.0, 0.0;
-  Eigen::Matrix<double, 2, 3> S;
-  S << 1, 0, 0, 0, 1, 0;
-  Eigen::Matrix2d essential_bar = essential.topLeftCorner(2, 2);
-  double lambda;
-  for (unsigned int i = 0; i < max_iterations; i++)
-  {
-    n1 = S * (essential * p2_old);
-    n2 = S * (essential.transpose() * p1_old);
-    lambda = ((p1_0.transpose() * essential * p2_0)(0) - (delta_p1_old.transpose() * essential_bar * delta_p2_old)(0)) /
-             (n1.transpose() * n1 + n2.transpose() * n2)(0);
-    delta_p1 = lambda * n1;
-    delta_p2 = lambda * n2;
-    p1 = p1_0 - (S.transpose() * delta_p1);
-    p2 = p2_0 - (S.transpose() * delta_p2);
-    p1_old = p1;
-    p2_old = p2;
-    delta_p1_old = delta_p1;
-    delta_p2_old = delta_p2;
-    // std::cout << "ptL_est: [" << p1.transpose() << "] ptR_est: [" <<
-    // p2.transpose() << "]" << std::endl;
-  }
-  Eigen::Vector3d z = p1.cross(R * p2);
-  Eigen::Vector3d X = ((z.transpose() * (essential * p2))(0) / (z.transpose() * z)(0)) * p1;
+  Eigen::Vector3d X;
+  kanatani_triangulation(&pt1, &pt2, 1, essential, R, &X);
   return X;
 }
 
+void kanatani_triangulation(const cv::Point2d *pts1, const cv::Point2d *pts2, size_t count,
+                            const Eigen::Matrix3d &essential, const Eigen::Matrix3d &R, Eigen::Vector3d *points,
+                            double *reprojection_errors)
+{
+  epipolar_triangulation(EpipolarCorrection::KANATANI, pts1, pts2, count, essential, R, points, reprojection_errors);
+}
+
 Eigen::Vector3d lindstrom_triangulation(const cv::Point2d &pt1, const cv::Point2d &pt2,
                                         const Eigen::Matrix3d &essential, const Eigen::Matrix3d &R)
 {
@@ -484,42 +712,18 @@ Eigen::Vector3d lindstrom_triangulation(const cv::Point2d &pt1, const cv::Point2
           Based of off this paper by Peter Lindstrom:
      https://e-reports-ext.llnl.gov/pdf/384387.pdf  **Listing 2**
   */
-  // std::cout << "ptL_noisy: " << pt1 << " ptR_noisy: " << pt2 << std::endl;
-  const unsigned int max_iterations = 7;
-  Eigen::Vector3d p1_old(pt1.x, pt1.y, 1.0);
-  Eigen::Vector3d p2_old(pt2.x, pt2.y, 1.0);
-  const Eigen::Vector3d p1_0(pt1.x, pt1.y, 1.0);
-  const Eigen::Vector3d p2_0(pt2.x, pt2.y, 1.0);
-  Eigen::Vector3d p1, p2;
-  Eigen::Vector2d n1, n2, delta_p1, delta_p2;
-  Eigen::Matrix<double, 2, 3> S;
-  S << 1, 0, 0, 0, 1, 0;
-  Eigen::Matrix2d essential_bar = essential.topLeftCorner(2, 2);
-  double a, b, c, d, lambda;
-  c = p1_0.transpose() * (essential * p2_0);
-  for (unsigned int i = 0; i < max_iterations; i++)
-  {
-    n1 = S * (essential * p2_old);
-    n2 = S * (essential.transpose() * p1_old);
-    a = n1.transpose() * (essential_bar * n2);
-    b = (0.5 * ((n1.transpose() * n1) + (n2.transpose() * n2)))(0);
-    d = sqrt(b * b - a * c);
-    double signum_b = (b > 0) ? 1 : ((b < 0) ? -1 : 0);
-    lambda = c / (b + signum_b * d);
-    delta_p1 = lambda * n1;
-    delta_p2 = lambda * n2;
-    p1 = p1_0 - (S.transpose() * delta_p1);
-    p2 = p2_0 - (S.transpose() * delta_p2);
-    p1_old = p1;
-    p2_old = p2;
-    // std::cout << "ptL_est: [" << p1.transpose() << "] ptR_est: [" <<
-    // p2.transpose() << "]" << std::endl;
-  }
-  Eigen::Vector3d z = p1.cross(R * p2);
-  Eigen::Vector3d X = ((z.transpose() * (essential * p2))(0) / (z.transpose() * z)(0)) * p1;
+  Eigen::Vector3d X;
+  lindstrom_triangulation(&pt1, &pt2, 1, essential, R, &X);
   return X;
 }
 
+void lindstrom_triangulation(const cv::Point2d *pts1, const cv::Point2d *pts2, size_t count,
+                             const Eigen::Matrix3d &essential, const Eigen::Matrix3d &R, Eigen::Vector3d *points,
+                             double *reprojection_errors)
+{
+  epipolar_triangulation(EpipolarCorrection::LINDSTROM, pts1, pts2, count, essential, R, points, reprojection_errors);
+}
+
 ImageWithCameraInfo::ImageWithCameraInfo(sensor_msgs::ImageConstPtr _image_msg_ptr,
                                          sensor_msgs::CameraInfoConstPtr _info_msg_ptr)
   : image_msg_ptr(_image_msg_ptr), info_msg_ptr(_info_msg_ptr), image_time(_image_msg_ptr->header.stamp)
@@ -557,20 +761,24 @@ void FrameHistory::image_callback(const sensor_msgs::ImageConstPtr &image_msg,
           Adds an  ImageWithCameraInfo object to the frame history ring buffer
   */
   ImageWithCameraInfo current_frame(image_msg, info_msg);
+  if (!_frame_history_ring_buffer.empty() && current_frame.image_time < _at(frames_available() - 1).image_time)
+  {
+    ROS_WARN_THROTTLE(1, "[FrameHistory] dropping a frame older than the newest one on %s", topic_name.c_str());
+    return;
+  }
   bool full = _frame_history_ring_buffer.size() >= history_size;
-  std::stringstream debug_msg;
-  debug_msg << "Adding frame to ring buffer "
-            << "[frame=" << frame_count << ","
-            << "full=" << (full ? "true" : "false") << ",frames_available=" << _frame_history_ring_buffer.size() << "]"
-            << std::endl;
-  ROS_DEBUG(debug_msg.str().c_str());
+  ROS_DEBUG("Adding frame to ring buffer [frame=%zu,full=%s,frames_available=%zu]", frame_count,
+            full ? "true" : "false", _frame_history_ring_buffer.size());
   if (!full)
   {
+    _frame_history_ring_buffer.reserve(history_size);
     _frame_history_ring_buffer.push_back(current_frame);
   }
   else
   {
-    _frame_history_ring_buffer[frame_count % history_size] = current_frame;
+    // Overwrite the oldest frame, making the next one the oldest
+    _frame_history_ring_buffer[_oldest] = current_frame;
+    _oldest = (_oldest + 1) % history_size;
   }
   frame_count++;
 }
@@ -581,25 +789,50 @@ std::vector<ImageWithCameraInfo> FrameHistory::get_frame_history(unsigned int fr
           Returns a vector with the last <num_frames> ImageWithCameraInfo
      objects
   */
-  std::vector<ImageWithCameraInfo> frame_history;
-  std::vector<ImageWithCameraInfo> sorted_frame_history = _frame_history_ring_buffer;
   if (_frame_history_ring_buffer.size() < frames_requested)
   {
     ROS_WARN("get_frame_history(%d): %d frames were requested, but there are "
-             "%d frames available",
+             "%zu frames available",
              frames_requested, frames_requested, _frame_history_ring_buffer.size());
+    return std::vector<ImageWithCameraInfo>();
   }
-  else
-  {
-    std::sort(sorted_frame_history.begin(), sorted_frame_history.end());
-    for (size_t i = 0; i < frames_requested; i++)
-    {
-      frame_history.push_back(sorted_frame_history[i]);
-      if (i == frames_requested - 1)
-        break;
-    }
-  }
-  return frame_history;
+  FrameRange range = last_frames(frames_requested);
+  return std::vector<ImageWithCameraInfo>(range.begin(), range.end());
+}
+
+int FrameHistory::frames_available()
+{
+  return _frame_history_ring_buffer.size();
+}
+
+size_t FrameHistory::bytes() const
+{
+  size_t total = 0;
+  for (const ImageWithCameraInfo &frame : _frame_history_ring_buffer)
+    if (frame.image_msg_ptr)
+      total += frame.image_msg_ptr->data.size();
+  return total;
+}
+
+FrameHistory::FrameRange FrameHistory::frames() const
+{
+  return FrameRange{ const_iterator(this, 0), const_iterator(this, _frame_history_ring_buffer.size()) };
+}
+
+FrameHistory::FrameRange FrameHistory::last_frames(size_t n) const
+{
+  FrameRange range = frames();
+  if (n < range.size())
+    range.first = range.last - n;
+  return range;
+}
+
+FrameHistory::FrameRange FrameHistory::frames_since(const ros::Time &stamp) const
+{
+  FrameRange range = frames();
+  auto stamped_before = [](const ros::Time &t, const ImageWithCameraInfo &frame) { return t < frame.image_time; };
+  range.first = std::upper_bound(range.first, range.last, stamp, stamped_before);
+  return range;
 }
 
 }  // namespace mil_vision
@@ -0,0 +1,94 @@
+#include <mil_vision_lib/gpu_image.hpp>
+
+#ifdef MIL_VISION_CUDA
+#include <opencv2/cudaarithm.hpp>
+#include <opencv2/cudaimgproc.hpp>
+#include <opencv2/cudawarping.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#endif
+
+namespace mil_vision
+{
+#ifdef MIL_VISION_CUDA
+
+bool gpuAvailable()
+{
+  static const bool available = cv::cuda::getCudaEnabledDeviceCount() > 0;
+  return available;
+}
+
+bool GpuRectifier::init(const image_geometry::PinholeCameraModel &model)
+{
+  if (!gpuAvailable())
+    return false;
+  const sensor_msgs::CameraInfo &new_info = model.cameraInfo();
+  if (!map_x.empty() && new_info.width == info.width && new_info.height == info.height && new_info.D == info.D &&
+      new_info.K == info.K && new_info.R == info.R && new_info.P == info.P)
+    return true;
+  info = new_info;
+
+  // Float maps, as the GPU remap does not take the fixed point ones cv::remap is fastest with
+  cv::Mat cpu_map_x, cpu_map_y;
+  cv::initUndistortRectifyMap(model.intrinsicMatrix(), model.distortionCoeffs(), model.rotationMatrix(),
+                              model.projectionMatrix(), model.fullResolution(), CV_32FC1, cpu_map_x, cpu_map_y);
+  map_x.upload(cpu_map_x);
+  map_y.upload(cpu_map_y);
+  return true;
+}
+
+bool GpuRectifier::rectify(const cv::cuda::GpuMat &raw, cv::cuda::GpuMat &rectified, cv::cuda::Stream &stream) const
+{
+  if (map_x.empty() || raw.size() != map_x.size())
+    return false;
+  cv::cuda::remap(raw, rectified, map_x, map_y, cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(), stream);
+  return true;
+}
+
+bool gpuCvtColor(const cv::cuda::GpuMat &src, cv::cuda::GpuMat &dest, int code, cv::cuda::Stream &stream)
+{
+  if (!gpuAvailable())
+    return false;
+  cv::cuda::cvtColor(src, dest, code, 0, stream);
+  return true;
+}
+
+bool gpuInRange(const cv::cuda::GpuMat &src, const cv::Scalar &lower, const cv::Scalar &upper, cv::cuda::GpuMat &dest,
+                cv::cuda::Stream &stream)
+{
+  if (!gpuAvailable())
+    return false;
+  cv::cuda::inRange(src, lower, upper, dest, stream);
+  return true;
+}
+
+#else
+
+bool gpuAvailable()
+{
+  return false;
+}
+
+bool GpuRectifier::init(const image_geometry::PinholeCameraModel &)
+{
+  return false;
+}
+
+bool GpuRectifier::rectify(const cv::cuda::GpuMat &, cv::cuda::GpuMat &, cv::cuda::Stream &) const
+{
+  return false;
+}
+
+bool gpuCvtColor(const cv::cuda::GpuMat &, cv::cuda::GpuMat &, int, cv::cuda::Stream &)
+{
+  return false;
+}
+
+bool gpuInRange(const cv::cuda::GpuMat &, const cv::Scalar &, const cv::Scalar &, cv::cuda::GpuMat &,
+                cv::cuda::Stream &)
+{
+  return false;
+}
+
+#endif
+
+}  // namespace mil_vision
@@ -36,33 +36,8 @@ cv::Mat rotateKernel(const cv::Mat &kernel, float theta, bool deg, bool no_expan
 
 cv::Mat makeRotInvariant(const cv::Mat &kernel, int rotations)
 {
-  // Get angles of rotation
-  std::vector<float> rotation_angles;
-  float delta_theta = 360.0f / rotations;
-  float theta = 0.0f;
-  while (true)
-  {
-    theta += delta_theta;
-    if (theta < 360.0f)
-      rotation_angles.push_back(theta);
-    else
-      break;
-  }
-
-  // Incrementally rotate and save versions of original kernel
-  std::vector<cv::Mat> kernel_rotations;
-  cv::Mat dest = rotateKernel(kernel, 0.0f);
-  kernel_rotations.push_back(dest);
-  cv::Point2f c_dest{ dest.cols * 0.5f, dest.rows * 0.5f };
-  for (auto theta : rotation_angles)
-    kernel_rotations.push_back(rotateKernel(dest, theta, true, true));
-
-  // Average all rotated versions
-  cv::Mat sum = cv::Mat::zeros(dest.size(), CV_32S);
-  for (auto &rot_kernel : kernel_rotations)
-    cv::add(sum, rot_kernel, sum, cv::Mat(), CV_32S);
-  cv::Mat result = sum / float(kernel_rotations.size());
-  result.convertTo(result, kernel.type());
+  cv::Mat result;
+  RotatedKernelBank(kernel, rotations).mean().convertTo(result, kernel.type());
   return result;
 }
 
@@ -108,4 +83,107 @@ float getRadialSymmetryAngle(const cv::Mat &kernel, float ang_res, bool deg)
   return result;
 }
 
+RotatedKernelBank::RotatedKernelBank(const cv::Mat &kernel, int rotations, float max_angle) : _max_angle(max_angle)
+{
+  cv::Mat kernel_f;
+  kernel.convertTo(kernel_f, CV_32F);
+
+  // Same canvas as rotateKernel, with the kernel moved to its center and rotated in one warp
+  cv::Point2f c_org{ kernel.cols * 0.5f, kernel.rows * 0.5f };
+  float hypot = std::hypot(c_org.x, c_org.y);
+  cv::Point2f c_dest{ hypot, hypot };
+  cv::Size canvas(hypot * 2, hypot * 2);
+
+  for (int i = 0; i < rotations; i++)
+  {
+    float theta = i * max_angle / rotations;
+    cv::Mat rot_mat = cv::getRotationMatrix2D(c_dest, theta * 180.0f / mil_tools::PI, 1.0);
+    cv::Mat translation = rot_mat.col(2);
+    translation += rot_mat.colRange(0, 2) * cv::Mat(cv::Vec2d(c_dest.x - c_org.x, c_dest.y - c_org.y));
+    cv::Mat rotated;
+    cv::warpAffine(kernel_f, rotated, rot_mat, canvas, cv::INTER_LINEAR, cv::BORDER_CONSTANT, 0);
+    _kernels.push_back(rotated);
+    _angles.push_back(theta);
+  }
+}
+
+size_t RotatedKernelBank::nearest(float theta) const
+{
+  float step = _max_angle / _angles.size();
+  float wrapped = std::fmod(theta, _max_angle);
+  if (wrapped < 0)
+    wrapped += _max_angle;
+  return size_t(std::round(wrapped / step)) % _angles.size();
+}
+
+cv::Mat RotatedKernelBank::mean() const
+{
+  cv::Mat sum = cv::Mat::zeros(_kernels[0].size(), CV_32F);
+  for (auto &rot_kernel : _kernels)
+    sum += rot_kernel;
+  return sum / float(_kernels.size());
+}
+
+void RotatedKernelBank::apply(const cv::Mat &src, std::vector<cv::Mat> &responses, bool use_dft) const
+{
+  cv::Mat src_f;
+  src.convertTo(src_f, CV_32F);
+  responses.resize(_kernels.size());
+  if (!use_dft)
+  {
+    for (size_t i = 0; i < _kernels.size(); i++)
+      cv::filter2D(src_f, responses[i], CV_32F, _kernels[i]);
+    return;
+  }
+
+  // Pad the way filter2D extends the border, so correlating the padded image gives the same responses. The
+  // transform only has to be as big as the padded image for its circular correlation not to wrap into them.
+  const cv::Size ksize = _kernels[0].size();
+  const cv::Point anchor(ksize.width / 2, ksize.height / 2);
+  const cv::Size padded_size(src.cols + ksize.width - 1, src.rows + ksize.height - 1);
+  const cv::Size dft_size(cv::getOptimalDFTSize(padded_size.width), cv::getOptimalDFTSize(padded_size.height));
+  cv::Mat padded = cv::Mat::zeros(dft_size, CV_32F);
+  cv::Mat padded_roi = padded(cv::Rect(cv::Point(0, 0), padded_size));
+  cv::copyMakeBorder(src_f, padded_roi, anchor.y, ksize.height - 1 - anchor.y, anchor.x, ksize.width - 1 - anchor.x,
+                     cv::BORDER_REFLECT_101);
+  cv::Mat src_spectrum;
+  cv::dft(padded, src_spectrum, 0, padded_size.height);
+
+  if (_spectra_size != dft_size)
+  {
+    _spectra.resize(_kernels.size());
+    for (size_t i = 0; i < _kernels.size(); i++)
+    {
+      cv::Mat kernel_padded = cv::Mat::zeros(dft_size, CV_32F);
+      _kernels[i].copyTo(kernel_padded(cv::Rect(cv::Point(0, 0), ksize)));
+      cv::dft(kernel_padded, _spectra[i], 0, ksize.height);
+    }
+    _spectra_size = dft_size;
+  }
+
+  cv::Mat product, response;
+  for (size_t i = 0; i < _kernels.size(); i++)
+  {
+    // Multiplying by the conjugate correlates instead of convolving
+    cv::mulSpectrums(src_spectrum, _spectra[i], product, 0, true);
+    cv::idft(product, response, cv::DFT_SCALE | cv::DFT_REAL_OUTPUT, src.rows);
+    response(cv::Rect(0, 0, src.cols, src.rows)).copyTo(responses[i]);
+  }
+}
+
+void RotatedKernelBank::applyMax(const cv::Mat &src, cv::Mat &max_response, cv::Mat &best_rotation, bool use_dft) const
+{
+  std::vector<cv::Mat> responses;
+  apply(src, responses, use_dft);
+  responses[0].copyTo(max_response);
+  best_rotation = cv::Mat::zeros(src.size(), CV_32S);
+  cv::Mat stronger;
+  for (size_t i = 1; i < responses.size(); i++)
+  {
+    cv::compare(responses[i], max_response, stronger, cv::CMP_GT);
+    responses[i].copyTo(max_response, stronger);
+    best_rotation.setTo(int(i), stronger);
+  }
+}
+
 }  // namespace mil_vision
@@ -0,0 +1,123 @@
+#include <mil_vision_lib/roi_stereo.hpp>
+
+#include <mil_vision_lib/gpu_image.hpp>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <utility>
+
+#ifdef MIL_VISION_CUDA_STEREO
+#include <opencv2/cudastereo.hpp>
+#endif
+
+namespace mil_vision
+{
+namespace
+{
+// Grayscale copy of crop of image, mirrored left to right if mirror
+void gray_crop(const cv::Mat &image, cv::Rect const &crop, bool mirror, cv::Mat &out, cv::Mat &scratch)
+{
+  const cv::Mat region = image(crop);
+  if (region.channels() == 3)
+  {
+    cv::cvtColor(region, mirror ? scratch : out, cv::COLOR_BGR2GRAY);
+    if (mirror)
+      cv::flip(scratch, out, 1);
+  }
+  else if (mirror)
+  {
+    cv::flip(region, out, 1);
+  }
+  else
+  {
+    region.copyTo(out);
+  }
+}
+}  // namespace
+
+RoiStereoMatcher::RoiStereoMatcher() : RoiStereoMatcher(Params())
+{
+}
+
+RoiStereoMatcher::RoiStereoMatcher(Params const &params) : params_(params)
+{
+  params_.num_disparities = std::max(16, (params_.num_disparities + 15) / 16 * 16);
+  params_.block_size = std::max(5, params_.block_size | 1);
+  cpu_matcher_ = cv::StereoBM::create(params_.num_disparities, params_.block_size);
+  cpu_matcher_->setTextureThreshold(params_.texture_threshold);
+  cpu_matcher_->setUniquenessRatio(params_.uniqueness_ratio);
+#ifdef MIL_VISION_CUDA_STEREO
+  if (params_.use_gpu && gpuAvailable())
+  {
+    cv::Ptr<cv::cuda::StereoBM> gpu_matcher = cv::cuda::createStereoBM(params_.num_disparities, params_.block_size);
+    gpu_matcher->setTextureThreshold(params_.texture_threshold);
+    gpu_matcher->setUniquenessRatio(params_.uniqueness_ratio);
+    gpu_matcher_ = gpu_matcher;
+  }
+#endif
+}
+
+bool RoiStereoMatcher::disparity(const cv::Mat &left, const cv::Mat &right, cv::Rect &roi, Reference reference,
+                                 cv::Mat &disparity)
+{
+  CV_Assert(left.size() == right.size() && left.type() == right.type() && left.depth() == CV_8U);
+  const cv::Rect image(0, 0, left.cols, left.rows);
+  roi &= image;
+  if (roi.empty())
+    return false;
+
+  // Block matching searches the right image to the left of each pixel of the left one. Matching from the right image
+  // is the same with both mirrored, and the right one in place of the left.
+  const bool mirror = reference == Reference::RIGHT;
+  const int half = params_.block_size / 2;
+  // Margins for the blocks around the region's pixels, and for their matches on the side they are searched
+  const int before = half + (mirror ? 0 : params_.num_disparities);
+  const int after = half + (mirror ? params_.num_disparities : 0);
+  const cv::Rect crop =
+      cv::Rect(roi.x - before, roi.y - half, roi.width + before + after, roi.height + 2 * half) & image;
+  gray_crop(mirror ? right : left, crop, mirror, left_crop_, scratch_);
+  gray_crop(mirror ? left : right, crop, mirror, right_crop_, scratch_);
+
+  if (!gpu_matcher_.empty())
+  {
+    gpu_left_.upload(left_crop_);
+    gpu_right_.upload(right_crop_);
+    gpu_matcher_->compute(gpu_left_, gpu_right_, gpu_disparity_);
+    gpu_disparity_.download(raw_disparity_);
+  }
+  else
+  {
+    cpu_matcher_->compute(left_crop_, right_crop_, raw_disparity_);
+  }
+  if (mirror)
+  {
+    cv::flip(raw_disparity_, scratch_, 1);
+    std::swap(raw_disparity_, scratch_);
+  }
+
+  const cv::Mat raw = raw_disparity_(cv::Rect(roi.x - crop.x, roi.y - crop.y, roi.width, roi.height));
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  disparity.create(roi.size(), CV_32FC1);
+  for (int y = 0; y < roi.height; ++y)
+  {
+    float *out = disparity.ptr<float>(y);
+    if (raw.type() == CV_16SC1)
+    {
+      // Sixteenths of a pixel, negative without a match
+      const int16_t *in = raw.ptr<int16_t>(y);
+      for (int x = 0; x < roi.width; ++x)
+        out[x] = in[x] < 0 ? nan : in[x] * (1.f / 16);
+    }
+    else
+    {
+      // The GPU's whole pixels, 0 without a match
+      const uint8_t *in = raw.ptr<uint8_t>(y);
+      for (int x = 0; x < roi.width; ++x)
+        out[x] = in[x] ? in[x] : nan;
+    }
+  }
+  return true;
+}
+
+}  // namespace mil_vision
@@ -0,0 +1,25 @@
+#include <mil_vision_lib/image_acquisition/shared_streams.hpp>
+
+#include <map>
+#include <mutex>
+
+namespace mil_vision
+{
+std::shared_ptr<void> sharedObject(const std::string &key, const std::function<std::shared_ptr<void>()> &make)
+{
+  // In the library rather than a template's static, so plugins loaded separately all see the same objects
+  static std::mutex mtx;
+  static std::map<std::string, std::weak_ptr<void>> objects;
+
+  std::lock_guard<std::mutex> lock(mtx);
+  std::weak_ptr<void> &registered = objects[key];
+  std::shared_ptr<void> object = registered.lock();
+  if (!object)
+  {
+    object = make();
+    registered = object;
+  }
+  return object;
+}
+
+}  // namespace mil_vision
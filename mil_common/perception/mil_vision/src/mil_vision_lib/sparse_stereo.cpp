@@ -0,0 +1,186 @@
+#include <mil_vision_lib/sparse_stereo.hpp>
+
+#include <opencv2/features2d/features2d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace mil_vision
+{
+namespace
+{
+// Half the census window
+const int RADIUS = 2;
+// Cost of a disparity that was not compared
+const int NO_COST = std::numeric_limits<int>::max();
+
+inline int hamming(uint32_t a, uint32_t b)
+{
+  return __builtin_popcount(a ^ b);
+}
+}  // namespace
+
+void CensusStereoMatcher::CensusImage::reset(const cv::Mat &image)
+{
+  CV_Assert(image.depth() == CV_8U && (image.channels() == 1 || image.channels() == 3));
+  if (image.channels() == 3)
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+  else
+    gray = image;
+  census.create(gray.rows, gray.cols);
+  computed.assign(gray.rows, 0);
+}
+
+const uint32_t *CensusStereoMatcher::CensusImage::row(int y)
+{
+  uint32_t *out = census[y];
+  if (computed[y])
+    return out;
+  computed[y] = 1;
+
+  const int cols = gray.cols;
+  std::fill(out, out + cols, 0);
+  if (y < RADIUS || y >= gray.rows - RADIUS)
+    return out;
+
+  // One pass over the row per neighbour, so each loop is a plain compare and shift the compiler vectorizes
+  const uint8_t *center = gray.ptr<uint8_t>(y);
+  int bit = 0;
+  for (int dy = -RADIUS; dy <= RADIUS; ++dy)
+  {
+    const uint8_t *neighbour = gray.ptr<uint8_t>(y + dy);
+    for (int dx = -RADIUS; dx <= RADIUS; ++dx)
+    {
+      if (dy == 0 && dx == 0)
+        continue;
+      for (int x = RADIUS; x < cols - RADIUS; ++x)
+        out[x] |= uint32_t(center[x] > neighbour[x + dx]) << bit;
+      ++bit;
+    }
+  }
+  return out;
+}
+
+CensusStereoMatcher::CensusStereoMatcher() : CensusStereoMatcher(Params())
+{
+}
+
+CensusStereoMatcher::CensusStereoMatcher(Params const &params) : params_(params)
+{
+  CV_Assert(params_.max_disparity > 0 && params_.row_tolerance >= 0 && params_.uniqueness > 0 &&
+            params_.uniqueness <= 1);
+}
+
+void CensusStereoMatcher::match(const cv::Mat &left, const cv::Mat &right, const std::vector<cv::Point2f> &left_points,
+                                std::vector<SparseStereoMatch> &matches)
+{
+  CV_Assert(left.size() == right.size());
+  left_.reset(left);
+  right_.reset(right);
+  match_points(left_points, matches);
+}
+
+void CensusStereoMatcher::detect_and_match(const cv::Mat &left, const cv::Mat &right,
+                                           std::vector<SparseStereoMatch> &matches)
+{
+  CV_Assert(left.size() == right.size());
+  left_.reset(left);
+  right_.reset(right);
+
+  std::vector<cv::KeyPoint> keypoints;
+  cv::FAST(left_.gray, keypoints, params_.fast_threshold, true);
+  if (int(keypoints.size()) > params_.max_features)
+    cv::KeyPointsFilter::retainBest(keypoints, params_.max_features);
+
+  std::vector<cv::Point2f> points;
+  cv::KeyPoint::convert(keypoints, points);
+  match_points(points, matches);
+  matches.erase(std::remove_if(matches.begin(), matches.end(),
+                               [](SparseStereoMatch const &match) { return !match.valid(); }),
+                matches.end());
+}
+
+void CensusStereoMatcher::match_points(const std::vector<cv::Point2f> &left_points,
+                                       std::vector<SparseStereoMatch> &matches)
+{
+  matches.resize(left_points.size());
+  for (size_t i = 0; i < left_points.size(); ++i)
+  {
+    SparseStereoMatch &match = matches[i];
+    match.left = left_points[i];
+    if (!match_point(cv::Point(cvRound(match.left.x), cvRound(match.left.y)), match))
+    {
+      match.right = match.left;
+      match.cost = -1;
+    }
+  }
+}
+
+bool CensusStereoMatcher::match_point(cv::Point const &point, SparseStereoMatch &match)
+{
+  const int rows = left_.gray.rows;
+  const int cols = left_.gray.cols;
+  if (point.x < RADIUS || point.x >= cols - RADIUS || point.y < RADIUS || point.y >= rows - RADIUS)
+    return false;
+
+  // Best cost of each disparity over the rows searched
+  const int max_disparity = std::min(params_.max_disparity, point.x - RADIUS);
+  costs_.assign(max_disparity + 1, NO_COST);
+  cost_rows_.assign(max_disparity + 1, point.y);
+  const uint32_t descriptor = left_.row(point.y)[point.x];
+  for (int y = std::max(RADIUS, point.y - params_.row_tolerance);
+       y <= std::min(rows - RADIUS - 1, point.y + params_.row_tolerance); ++y)
+  {
+    const uint32_t *candidates = right_.row(y);
+    for (int d = 0; d <= max_disparity; ++d)
+    {
+      int cost = hamming(descriptor, candidates[point.x - d]);
+      if (cost < costs_[d])
+      {
+        costs_[d] = cost;
+        cost_rows_[d] = y;
+      }
+    }
+  }
+
+  const int best_disparity = std::min_element(costs_.begin(), costs_.end()) - costs_.begin();
+  const int best = costs_[best_disparity];
+  if (best > params_.max_cost)
+    return false;
+
+  // Unique among the candidates for the point, other than the best's neighbours, which are the same feature
+  for (int d = 0; d <= max_disparity; ++d)
+  {
+    if (std::abs(d - best_disparity) > 1 && costs_[d] * params_.uniqueness <= best)
+      return false;
+  }
+
+  // And the point unique among the left row's candidates for the match
+  const int match_x = point.x - best_disparity;
+  const int match_y = cost_rows_[best_disparity];
+  const uint32_t match_descriptor = right_.row(match_y)[match_x];
+  const uint32_t *left_row = left_.row(point.y);
+  for (int x = match_x; x <= std::min(cols - RADIUS - 1, match_x + params_.max_disparity); ++x)
+  {
+    if (std::abs(x - point.x) > 1 && hamming(match_descriptor, left_row[x]) * params_.uniqueness <= best)
+      return false;
+  }
+
+  // Vertex of the parabola through the costs around the best
+  float disparity = best_disparity;
+  if (best_disparity > 0 && best_disparity < max_disparity)
+  {
+    const int before = costs_[best_disparity - 1];
+    const int after = costs_[best_disparity + 1];
+    const int curvature = before - 2 * best + after;
+    if (curvature > 0)
+      disparity += 0.5f * (before - after) / curvature;
+  }
+
+  match.right = cv::Point2f(match.left.x - disparity, match.left.y + (match_y - point.y));
+  match.cost = best;
+  return true;
+}
+
+}  // namespace mil_vision
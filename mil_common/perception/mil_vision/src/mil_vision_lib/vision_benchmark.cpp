@@ -0,0 +1,154 @@
+#include <mil_vision_lib/vision_benchmark.hpp>
+
+#include <cv_bridge/cv_bridge.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/Image.h>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <numeric>
+
+namespace mil_vision
+{
+namespace
+{
+// Mean, median, 95th percentile and max of ms as a JSON object
+void writeStatistics(std::ostream &out, std::vector<double> ms)
+{
+  if (ms.empty())
+  {
+    out << "{}";
+    return;
+  }
+  std::sort(ms.begin(), ms.end());
+  double mean = std::accumulate(ms.begin(), ms.end(), 0.) / ms.size();
+  out << "{\"mean_ms\": " << mean << ", \"median_ms\": " << ms[ms.size() / 2]
+      << ", \"p95_ms\": " << ms[std::min(ms.size() - 1, ms.size() * 95 / 100)] << ", \"max_ms\": " << ms.back()
+      << "}";
+}
+
+bool loadBag(const std::string &path, const std::string &topic, ImageSequence &sequence, size_t max_frames,
+             const std::string &encoding)
+{
+  try
+  {
+    rosbag::Bag bag(path, rosbag::bagmode::Read);
+    rosbag::View view(bag, rosbag::TopicQuery(topic));
+    for (const rosbag::MessageInstance &message : view)
+    {
+      sensor_msgs::ImageConstPtr image = message.instantiate<sensor_msgs::Image>();
+      if (!image)
+        continue;
+      sequence.frames.push_back(cv_bridge::toCvCopy(image, encoding)->image);
+      sequence.stamps.push_back(image->header.stamp);
+      if (max_frames && sequence.frames.size() >= max_frames)
+        break;
+    }
+  }
+  catch (const rosbag::BagException &e)
+  {
+    ROS_ERROR("Could not read images from %s: %s", path.c_str(), e.what());
+    return false;
+  }
+  catch (const cv_bridge::Exception &e)
+  {
+    ROS_ERROR("Could not convert images on %s to %s: %s", topic.c_str(), encoding.c_str(), e.what());
+    return false;
+  }
+  return !sequence.frames.empty();
+}
+
+bool loadDirectory(const std::string &path, ImageSequence &sequence, size_t max_frames, const std::string &encoding)
+{
+  std::vector<std::string> files;
+  for (boost::filesystem::directory_iterator it(path); it != boost::filesystem::directory_iterator(); ++it)
+  {
+    if (boost::filesystem::is_regular_file(it->status()))
+      files.push_back(it->path().string());
+  }
+  std::sort(files.begin(), files.end());
+
+  const int flags = encoding == "mono8" ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR;
+  for (const std::string &file : files)
+  {
+    cv::Mat image = cv::imread(file, flags);
+    if (image.empty())
+      continue;
+    if (encoding == "rgb8")
+      cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
+    sequence.frames.push_back(image);
+    // Images in a directory are treated as taken at 30 fps
+    sequence.stamps.push_back(ros::Time(0) + ros::Duration(sequence.stamps.size() / 30.));
+    if (max_frames && sequence.frames.size() >= max_frames)
+      break;
+  }
+  return !sequence.frames.empty();
+}
+}  // namespace
+
+size_t ImageSequence::bytes() const
+{
+  size_t total = 0;
+  for (const cv::Mat &frame : frames)
+    total += frame.total() * frame.elemSize();
+  return total;
+}
+
+bool loadImageSequence(const std::string &path, const std::string &topic, ImageSequence &sequence, size_t max_frames,
+                       const std::string &encoding)
+{
+  sequence.frames.clear();
+  sequence.stamps.clear();
+  if (boost::filesystem::is_directory(path))
+    return loadDirectory(path, sequence, max_frames, encoding);
+  return loadBag(path, topic, sequence, max_frames, encoding);
+}
+
+VisionBenchmark::VisionBenchmark(const std::string &name) : _name(name)
+{
+}
+
+void VisionBenchmark::startFrame()
+{
+  _frame_start = Clock::now();
+}
+
+void VisionBenchmark::record(const std::string &name, double ms)
+{
+  auto it = std::find_if(_stages.begin(), _stages.end(), [&](const Stage &stage) { return stage.name == name; });
+  if (it == _stages.end())
+    it = _stages.insert(_stages.end(), Stage{ name, {} });
+  it->ms.push_back(ms);
+}
+
+void VisionBenchmark::endFrame()
+{
+  _frame_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - _frame_start).count());
+}
+
+void VisionBenchmark::writeJson(std::ostream &out) const
+{
+  double total_ms = std::accumulate(_frame_ms.begin(), _frame_ms.end(), 0.);
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  out << "{\"benchmark\": \"" << _name << "\", \"frames\": " << _frame_ms.size()
+      << ", \"fps\": " << (total_ms > 0 ? 1000. * _frame_ms.size() / total_ms : 0.) << ", \"frame\": ";
+  writeStatistics(out, _frame_ms);
+  out << ", \"stages\": {";
+  for (size_t i = 0; i < _stages.size(); ++i)
+  {
+    out << (i ? ", " : "") << "\"" << _stages[i].name << "\": ";
+    writeStatistics(out, _stages[i].ms);
+  }
+  // ru_maxrss is in kilobytes on Linux
+  out << "}, \"input_bytes\": " << _input_bytes << ", \"peak_rss_bytes\": " << size_t(usage.ru_maxrss) * 1024 << "}"
+      << std::endl;
+}
+
+}  // namespace mil_vision
@@ -0,0 +1,207 @@
+#include "object_crop_server.hpp"
+
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+
+namespace
+{
+// Corners closer to the camera than this are treated as behind it
+const double MIN_DEPTH = 0.1;
+// Frames buffered per camera, enough to cover the objects lagging the cameras by a couple of seconds
+const size_t FRAMES_PER_CAMERA = 60;
+
+Eigen::Isometry3d toEigen(const geometry_msgs::Transform& transform)
+{
+  return Eigen::Translation3d(transform.translation.x, transform.translation.y, transform.translation.z) *
+         Eigen::Quaterniond(transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z);
+}
+}  // namespace
+
+ObjectCropServer::ObjectCropServer() : nh(ros::this_node::getName()), tfListener(tfBuffer, nh), updates(0)
+{
+  std::vector<std::string> topics;
+  nh.param<std::vector<std::string>>("cameras", topics, { "/camera/front/right/image_rect_color" });
+  std::string objects_topic;
+  nh.param<std::string>("objects_topic", objects_topic, "/pcodar/objects");
+  nh.param<int>("crop_size", crop_size, 64);
+  nh.param<double>("padding", padding, 0.1);
+  nh.param<int>("min_pixels", min_pixels, 8);
+  nh.param<double>("pose_tolerance", pose_tolerance, 0.2);
+  double refresh = 0.;
+  nh.param<double>("refresh_period", refresh, refresh);
+  refresh_period = ros::Duration(refresh);
+  crop_size = std::max(crop_size, 1);
+
+  for (std::string& topic : topics)
+  {
+    Camera camera;
+    camera.topic = topic;
+    camera.stream.reset(new CameraStream(nh, FRAMES_PER_CAMERA));
+    if (!camera.stream->init(topic))
+    {
+      ROS_ERROR("Not cropping from %s, it could not be subscribed to", topic.c_str());
+      continue;
+    }
+    cameras.push_back(std::move(camera));
+  }
+
+  cropsPub = nh.advertise<mil_msgs::ObjectCrops>("object_crops", 10);
+  objectsSub = nh.subscribe(objects_topic, 1, &ObjectCropServer::objectsCallback, this);
+}
+
+void ObjectCropServer::objectsCallback(const mil_msgs::PerceptionObjectArrayConstPtr& objects)
+{
+  ++updates;
+  for (Camera& camera : cameras)
+  {
+    cropFrom(camera, *objects);
+    // Forget objects which were removed, in case their ids are reused after a reset
+    for (auto it = camera.cropped.begin(); it != camera.cropped.end();)
+    {
+      if (it->second.seen != updates)
+        it = camera.cropped.erase(it);
+      else
+        ++it;
+    }
+  }
+}
+
+bool ObjectCropServer::changed(const Camera& camera, const mil_msgs::PerceptionObject& object,
+                               const ros::Time& stamp) const
+{
+  auto it = camera.cropped.find(object.id);
+  if (it == camera.cropped.end())
+    return true;
+  Eigen::Vector3d position(object.pose.position.x, object.pose.position.y, object.pose.position.z);
+  Eigen::Vector3d scale(object.scale.x, object.scale.y, object.scale.z);
+  return (position - it->second.position).norm() > pose_tolerance ||
+         (scale - it->second.scale).cwiseAbs().maxCoeff() > pose_tolerance ||
+         (!refresh_period.isZero() && stamp - it->second.stamp > refresh_period);
+}
+
+bool ObjectCropServer::project(const mil_msgs::PerceptionObject& object, const Eigen::Isometry3d& to_camera,
+                               const image_geometry::PinholeCameraModel& model, float image_scale,
+                               const cv::Size& image_size, cv::Rect& roi, std::vector<cv::Point2f>& hull) const
+{
+  Eigen::Isometry3d pose =
+      Eigen::Translation3d(object.pose.position.x, object.pose.position.y, object.pose.position.z) *
+      Eigen::Quaterniond(object.pose.orientation.w, object.pose.orientation.x, object.pose.orientation.y,
+                         object.pose.orientation.z);
+  Eigen::Vector3d half(object.scale.x / 2., object.scale.y / 2., object.scale.z / 2.);
+
+  // Corners of the bounding box in the image. The whole box must be in front of the camera, as a box partly behind
+  // it does not project to a bounded region.
+  std::vector<cv::Point2f> corners;
+  corners.reserve(8);
+  for (int i = 0; i < 8; ++i)
+  {
+    Eigen::Vector3d corner = to_camera * pose *
+                             Eigen::Vector3d(i & 1 ? half.x() : -half.x(), i & 2 ? half.y() : -half.y(),
+                                             i & 4 ? half.z() : -half.z());
+    if (corner.z() < MIN_DEPTH)
+      return false;
+    cv::Point2d pixel = model.project3dToPixel(cv::Point3d(corner.x(), corner.y(), corner.z()));
+    corners.emplace_back(pixel.x * image_scale, pixel.y * image_scale);
+  }
+  cv::convexHull(corners, hull);
+
+  cv::Rect bounds = cv::boundingRect(corners);
+  float pad_x = bounds.width * padding;
+  float pad_y = bounds.height * padding;
+  cv::Rect padded(std::floor(bounds.x - pad_x), std::floor(bounds.y - pad_y), std::ceil(bounds.width + 2 * pad_x),
+                  std::ceil(bounds.height + 2 * pad_y));
+  roi = padded & cv::Rect(cv::Point(0, 0), image_size);
+  return roi.width >= min_pixels && roi.height >= min_pixels;
+}
+
+void ObjectCropServer::cropFrom(Camera& camera, const mil_msgs::PerceptionObjectArray& objects)
+{
+  if (objects.objects.empty())
+    return;
+  ros::Time stamp = objects.objects.front().header.stamp;
+  CameraStream::CamFrameConstPtr frame = camera.stream->getFrameFromTime(stamp);
+  if (!frame)
+    return;
+  auto model = frame->getCameraModelPtr();
+  if (!model)
+    return;
+
+  // One transform for every object, from the objects' frame into the camera when the image was taken
+  Eigen::Isometry3d to_camera;
+  try
+  {
+    to_camera =
+        toEigen(tfBuffer.lookupTransform(model->tfFrame(), objects.objects.front().header.frame_id, frame->stamp())
+                    .transform);
+  }
+  catch (tf2::TransformException& ex)
+  {
+    ROS_WARN_THROTTLE(5., "Not cropping from %s: %s", camera.topic.c_str(), ex.what());
+    return;
+  }
+
+  const cv::Mat_<cv::Vec3b>& image = frame->image();
+  mil_msgs::ObjectCrops msg;
+  msg.header.stamp = frame->stamp();
+  msg.header.seq = frame->seq();
+  msg.header.frame_id = model->tfFrame();
+  msg.crop_size = crop_size;
+  std::vector<cv::Rect> rois;
+  std::vector<cv::Point2f> hull;
+  for (const mil_msgs::PerceptionObject& object : objects.objects)
+  {
+    auto it = camera.cropped.find(object.id);
+    if (it != camera.cropped.end())
+      it->second.seen = updates;
+    cv::Rect roi;
+    if (!changed(camera, object, stamp) ||
+        !project(object, to_camera, *model, frame->getImageScale(), image.size(), roi, hull))
+      continue;
+
+    mil_msgs::ObjectCrop crop;
+    crop.id = object.id;
+    crop.labeled_classification = object.labeled_classification;
+    crop.roi.x_offset = roi.x;
+    crop.roi.y_offset = roi.y;
+    crop.roi.width = roi.width;
+    crop.roi.height = roi.height;
+    for (const cv::Point2f& point : hull)
+    {
+      mil_msgs::Point2D vertex;
+      vertex.x = point.x;
+      vertex.y = point.y;
+      crop.hull.push_back(vertex);
+    }
+    msg.crops.push_back(crop);
+    rois.push_back(roi);
+
+    Cropped& cropped = camera.cropped[object.id];
+    cropped.position = Eigen::Vector3d(object.pose.position.x, object.pose.position.y, object.pose.position.z);
+    cropped.scale = Eigen::Vector3d(object.scale.x, object.scale.y, object.scale.z);
+    cropped.stamp = stamp;
+    cropped.seen = updates;
+  }
+  if (rois.empty())
+    return;
+
+  // Every crop resized straight into its place in the batch
+  batch.create(crop_size * static_cast<int>(rois.size()), crop_size);
+  for (size_t i = 0; i < rois.size(); ++i)
+  {
+    cv::Mat_<cv::Vec3b> slot = batch.rowRange(i * crop_size, (i + 1) * crop_size);
+    cv::resize(image(rois[i]), slot, slot.size(), 0., 0., cv::INTER_AREA);
+  }
+  cv_bridge::CvImage(msg.header, sensor_msgs::image_encodings::BGR8, batch).toImageMsg(msg.image);
+  cropsPub.publish(msg);
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "object_crop_server");
+  ObjectCropServer server;
+  ros::spin();
+}
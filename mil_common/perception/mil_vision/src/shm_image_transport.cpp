@@ -0,0 +1,83 @@
+#include <mil_vision_lib/image_acquisition/shm_image_transport.hpp>
+
+#include <pluginlib/class_list_macros.h>
+
+namespace mil_vision
+{
+void ShmPublisher::publish(const sensor_msgs::Image &message, const PublishFn &publish_fn) const
+{
+  const size_t bytes = message.data.size();
+  if (!_ring || bytes > _ring->slotBytes())
+  {
+    int slots = 32;
+    nh().param<int>("slots", slots, slots);
+    try
+    {
+      // A new name, since subscribers may still have the old ring mapped
+      _ring = ShmImageRing::create(ShmImageRing::segmentName(getTopic(), _generation++), std::max(slots, 1), bytes);
+    }
+    catch (boost::interprocess::interprocess_exception &e)
+    {
+      _ring.reset();
+      ROS_ERROR_THROTTLE_NAMED(1, "ShmPublisher", "ShmPublisher: could not make a shared memory ring for %s: %s",
+                               getTopic().c_str(), e.what());
+      return;
+    }
+  }
+
+  mil_msgs::ShmImage descriptor;
+  if (!_ring->write(message.data.data(), bytes, descriptor.slot, descriptor.seq))
+  {
+    ROS_WARN_THROTTLE_NAMED(1, "ShmPublisher", "ShmPublisher: every slot of the ring for %s is leased, dropping "
+                                               "an image",
+                            getTopic().c_str());
+    return;
+  }
+  descriptor.header = message.header;
+  descriptor.height = message.height;
+  descriptor.width = message.width;
+  descriptor.encoding = message.encoding;
+  descriptor.is_bigendian = message.is_bigendian;
+  descriptor.step = message.step;
+  descriptor.segment = _ring->name();
+  publish_fn(descriptor);
+}
+
+void ShmSubscriber::internalCallback(const mil_msgs::ShmImageConstPtr &message, const Callback &user_cb)
+{
+  if (!_ring || _ring->name() != message->segment)
+  {
+    _ring = ShmImageRing::open(message->segment);
+    if (!_ring)
+    {
+      ROS_WARN_THROTTLE_NAMED(1, "ShmSubscriber", "ShmSubscriber: could not open shared memory ring %s, the shm "
+                                                  "transport only works on the publisher's host",
+                              message->segment.c_str());
+      return;
+    }
+  }
+
+  std::shared_ptr<const uint8_t> data = _ring->acquire(message->slot, message->seq);
+  const size_t bytes = size_t(message->step) * message->height;
+  if (!data || bytes > _ring->bytes(message->slot))
+  {
+    ROS_WARN_THROTTLE_NAMED(1, "ShmSubscriber", "ShmSubscriber: an image was overwritten before it could be read");
+    return;
+  }
+
+  sensor_msgs::ImagePtr image = boost::make_shared<sensor_msgs::Image>();
+  image->header = message->header;
+  image->height = message->height;
+  image->width = message->width;
+  image->encoding = message->encoding;
+  image->is_bigendian = message->is_bigendian;
+  image->step = message->step;
+  image->data.assign(data.get(), data.get() + bytes);
+  data.reset();
+  user_cb(image);
+}
+
+}  // namespace mil_vision
+
+PLUGINLIB_EXPORT_CLASS(mil_vision::ShmPublisher, image_transport::PublisherPlugin)
+PLUGINLIB_EXPORT_CLASS(mil_vision::ShmSubscriber, image_transport::SubscriberPlugin)
@@ -0,0 +1,20 @@
+#include <ros/ros.h>
+#include <mil_vision_lib/colorizer/pcd_colorizer.hpp>
+
+int main(int argc, char** argv)
+{
+  // Init ROS
+  ros::init(argc, argv, "velodyne_pcd_colorizer");
+  ros::NodeHandle nh{ "~" };
+
+  // Create PcdColorizer active object
+  std::string input_pcd_topic = "/velodyne_points";
+  nh.param<std::string>("input_pcd_topic", input_pcd_topic, input_pcd_topic);
+  mil_vision::PcdColorizer colorizer{ nh, input_pcd_topic };
+  if (!colorizer.ok())
+    return 1;
+
+  // Clouds are colored in the callback, while the camera streams fill their buffers on their own threads
+  ros::spin();
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <point_cloud_object_detection_and_recognition/clustering_backend.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace
+{
+/// Clusters as sets of indices, ignoring the order of equally sized clusters
+std::vector<std::vector<int>> canonical(pcodar::clusters_t const& clusters)
+{
+  std::vector<std::vector<int>> sets;
+  for (auto const& cluster : clusters)
+    sets.push_back(cluster.indices);
+  std::sort(sets.begin(), sets.end());
+  return sets;
+}
+
+}  // anonymous namespace
+
+/**
+ * Compares the runtime of each clustering backend on a random cloud of objects similar to an accumulated
+ * Velodyne cloud, and checks that the exact ones find the same clusters as PCL.
+ *
+ * Usage: clustering_benchmark [points] [iterations] [tolerance]
+ */
+int main(int argc, char* argv[])
+{
+  size_t num_points = argc > 1 ? std::stoul(argv[1]) : 200000;
+  size_t iterations = argc > 2 ? std::stoul(argv[2]) : 10;
+  double tolerance = argc > 3 ? std::stod(argv[3]) : 4.4;
+  const int MIN_POINTS = 20;
+
+  // Random blobs of points scattered around a course, plus sparse noise
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> course(-150., 150.);
+  std::normal_distribution<float> blob(0., 1.5);
+  auto cloud = boost::make_shared<pcodar::point_cloud>();
+  std::vector<pcodar::point_t> centers;
+  for (size_t i = 0; i < 200; ++i)
+    centers.emplace_back(course(generator), course(generator), 0.);
+  for (size_t i = 0; i < num_points; ++i)
+  {
+    if (i % 50 == 0)
+    {
+      cloud->push_back(pcodar::point_t(course(generator), course(generator), blob(generator)));
+      continue;
+    }
+    pcodar::point_t const& center = centers[i % centers.size()];
+    cloud->push_back(pcodar::point_t(center.x + blob(generator), center.y + blob(generator), blob(generator)));
+  }
+
+  pcodar::PclClusteringBackend pcl_backend;
+  pcodar::GridClusteringBackend grid_backend;
+  pcodar::CudaClusteringBackend cuda_backend;
+  pcodar::ColumnClusteringBackend column_backend;
+  std::vector<std::pair<std::string, pcodar::ClusteringBackend*>> backends = {
+    { "PCL", &pcl_backend }, { "Grid", &grid_backend }, { "CUDA", &cuda_backend }, { "Columns", &column_backend }
+  };
+
+  std::cout << num_points << " points, " << iterations << " iterations, tolerance " << tolerance << std::endl;
+  std::vector<std::vector<int>> expected;
+  bool equivalent = true;
+  for (auto const& backend : backends)
+  {
+    pcodar::clusters_t clusters;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+      backend.second->cluster(cloud, tolerance, MIN_POINTS, clusters);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto sets = canonical(clusters);
+    if (backend.second == &pcl_backend)
+      expected = sets;
+    bool same = sets == expected;
+    // Columns is approximate, so only reported
+    bool exact = backend.second != &column_backend;
+    if (exact)
+      equivalent = equivalent && same;
+    std::cout << backend.first << ": " << elapsed.count() / iterations << " ms, " << clusters.size() << " clusters"
+              << (same ? "" : exact ? " (DIFFERENT FROM PCL)" : " (approximate)") << std::endl;
+  }
+  return equivalent ? 0 : 1;
+}
@@ -0,0 +1,57 @@
+#include <point_cloud_object_detection_and_recognition/input_cloud_filter.hpp>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+
+/**
+ * Compares the runtime of InputCloudFilter's batched filter with the PCL CropHull + CropBox chain it replaced,
+ * on a random cloud similar in size to a Velodyne scan.
+ *
+ * Usage: input_cloud_filter_benchmark [points] [iterations]
+ */
+int main(int argc, char* argv[])
+{
+  size_t num_points = argc > 1 ? std::stoul(argv[1]) : 100000;
+  size_t iterations = argc > 2 ? std::stoul(argv[2]) : 100;
+
+  pcodar::InputCloudFilter filter;
+
+  // Footprint / pose / bounds similar to NaviGator on a course
+  filter.set_robot_footprint(Eigen::Vector4f(-3.3, -2.4, -5., 1.), Eigen::Vector4f(3.3, 2.4, 5., 1.));
+  Eigen::Affine3d pose = Eigen::Translation3d(10., 5., 0.) * Eigen::AngleAxisd(0.7, Eigen::Vector3d::UnitZ());
+  filter.set_robot_pose(pose);
+  auto bounds = boost::make_shared<pcodar::point_cloud>();
+  bounds->push_back(pcodar::point_t(-50., -40., 0.));
+  bounds->push_back(pcodar::point_t(-50., 60., 0.));
+  bounds->push_back(pcodar::point_t(70., 50., 0.));
+  bounds->push_back(pcodar::point_t(60., -45., 0.));
+  filter.set_bounds(bounds);
+
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<float> horizontal(-100., 100.);
+  std::uniform_real_distribution<float> vertical(-2., 5.);
+  auto cloud = boost::make_shared<pcodar::point_cloud>();
+  for (size_t i = 0; i < num_points; ++i)
+    cloud->push_back(pcodar::point_t(horizontal(generator), horizontal(generator), vertical(generator)));
+
+  pcodar::point_cloud out;
+  auto time = [&](std::function<void()> const& function) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+      function();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+  };
+
+  double pcl_ms = time([&]() { filter.filter_pcl(cloud, out); });
+  size_t pcl_size = out.size();
+  double batched_ms = time([&]() { filter.filter(cloud, out); });
+  size_t batched_size = out.size();
+
+  std::cout << num_points << " points, " << iterations << " iterations" << std::endl;
+  std::cout << "PCL CropHull + CropBox: " << pcl_ms << " ms, " << pcl_size << " points kept" << std::endl;
+  std::cout << "Batched half-planes:    " << batched_ms << " ms, " << batched_size << " points kept" << std::endl;
+  return pcl_size == batched_size ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+#include <point_cloud_object_detection_and_recognition/pcodar_controller.hpp>
+
+#include <mil_msgs/CompressedPointCloud2.h>
+#include <mil_tools/point_cloud_codec.hpp>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+
+/**
+ * Replays a recorded bag through pcodar::Node as fast as possible, rather than at the rate it was recorded,
+ * and reports throughput and per stage latency. Used to compare configurations and commits on the same data.
+ * Parameters are read from the ~ namespace as in pcodar_node, so load the same yaml to match the field.
+ * Clouds recorded compressed by record_compressed_cloud, on <pointcloud topic>/compressed, are decompressed first,
+ * which is timed on its own.
+ *
+ * Usage: pcodar_bag_benchmark <bag> [pointcloud topic]
+ */
+int main(int argc, char* argv[])
+{
+  ros::init(argc, argv, "pcodar_bag_benchmark", ros::init_options::AnonymousName);
+  if (argc < 2)
+  {
+    std::cerr << "Usage: pcodar_bag_benchmark <bag> [pointcloud topic]" << std::endl;
+    return 1;
+  }
+  std::string cloud_topic = argc > 2 ? argv[2] : "/velodyne_points";
+  std::string compressed_topic = cloud_topic + "/compressed";
+
+  // Scans are processed one at a time on this thread so each is timed in full
+  ros::NodeHandle nh("~");
+  nh.setParam("pipelined", false);
+  pcodar::Node node(nh);
+  node.initialize();
+
+  rosbag::Bag bag(argv[1], rosbag::bagmode::Read);
+  rosbag::View view(bag, rosbag::TopicQuery({ "/tf", "/tf_static", cloud_topic, compressed_topic }));
+
+  size_t scans = 0;
+  double total_ms = 0.;
+  size_t decoded = 0, compressed_bytes = 0, decoded_bytes = 0;
+  double decode_ms = 0.;
+  auto run = [&](sensor_msgs::PointCloud2ConstPtr const& cloud) {
+    auto start = std::chrono::steady_clock::now();
+    node.velodyne_cb(cloud);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    total_ms += elapsed.count();
+    ++scans;
+  };
+
+  // Hold each scan until a transform newer than it has been read, so its pose can be interpolated
+  std::deque<sensor_msgs::PointCloud2ConstPtr> pending;
+  ros::Time latest_transform;
+  for (rosbag::MessageInstance const& message : view)
+  {
+    if (!ros::ok())
+      break;
+    if (message.getTopic() == cloud_topic)
+    {
+      auto cloud = message.instantiate<sensor_msgs::PointCloud2>();
+      if (cloud)
+        pending.push_back(cloud);
+    }
+    else if (message.getTopic() == compressed_topic)
+    {
+      auto compressed = message.instantiate<mil_msgs::CompressedPointCloud2>();
+      if (!compressed)
+        continue;
+      sensor_msgs::PointCloud2Ptr cloud(new sensor_msgs::PointCloud2());
+      auto start = std::chrono::steady_clock::now();
+      if (!mil_tools::decode_point_cloud(*compressed, *cloud))
+      {
+        std::cerr << "skipping malformed compressed cloud " << compressed->header.seq << std::endl;
+        continue;
+      }
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      decode_ms += elapsed.count();
+      ++decoded;
+      compressed_bytes += compressed->data.size();
+      decoded_bytes += cloud->data.size();
+      pending.push_back(cloud);
+    }
+    else
+    {
+      auto transforms = message.instantiate<tf2_msgs::TFMessage>();
+      if (!transforms)
+        continue;
+      bool is_static = message.getTopic() == "/tf_static";
+      for (auto const& transform : transforms->transforms)
+      {
+        node.add_transform(transform, is_static);
+        if (!is_static)
+          latest_transform = std::max(latest_transform, transform.header.stamp);
+      }
+    }
+
+    while (!pending.empty() && pending.front()->header.stamp < latest_transform)
+    {
+      run(pending.front());
+      pending.pop_front();
+    }
+  }
+
+  std::cout << scans << " scans in " << total_ms << " ms";
+  if (scans)
+    std::cout << " (" << total_ms / scans << " ms / scan, " << 1000. * scans / total_ms << " scans / s)";
+  std::cout << ", " << pending.size() << " scans skipped without a later transform" << std::endl;
+  if (decoded)
+    std::cout << decoded << " compressed scans decoded in " << decode_ms / decoded << " ms / scan, "
+              << static_cast<double>(decoded_bytes) / compressed_bytes << " times smaller than their points"
+              << std::endl;
+
+  auto const& timers = node.get_stage_timers();
+  std::cout << std::left << std::setw(16) << "stage" << std::setw(10) << "count" << std::setw(12) << "min (ms)"
+            << std::setw(12) << "mean (ms)" << std::setw(12) << "p99 (ms)" << std::endl;
+  for (size_t i = 0; i < pcodar::StageTimers::NUM_STAGES; ++i)
+  {
+    auto stage = static_cast<pcodar::StageTimers::Stage>(i);
+    auto summary = timers.summarize(stage);
+    if (!summary.count)
+      continue;
+    std::cout << std::left << std::setw(16) << pcodar::StageTimers::name(stage) << std::setw(10) << summary.count
+              << std::setw(12) << summary.min_ms << std::setw(12) << summary.mean_ms << std::setw(12)
+              << summary.p99_ms << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include <point_cloud_object_detection_and_recognition/persistent_cloud_filter.hpp>
+
+#include <pcl/common/transforms.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <tf2_eigen/tf2_eigen.h>
+#include <tf2_msgs/TFMessage.h>
+#include <tf2_ros/buffer.h>
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+
+/**
+ * Compares the runtime of PersistentCloudFilter's voxel backend with pcl::RadiusOutlierRemoval on recorded scans, and
+ * checks that both keep the same points. Like the accumulator, each frame filters the last [scans] scans in the enu
+ * frame, so the bag needs TF from the lidar to enu.
+ *
+ * Usage: persistent_cloud_filter_benchmark <bag> [pointcloud topic] [scans] [radius] [min neighbors]
+ */
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: persistent_cloud_filter_benchmark <bag> [pointcloud topic] [scans] [radius] [min neighbors]"
+              << std::endl;
+    return 1;
+  }
+  std::string cloud_topic = argc > 2 ? argv[2] : "/velodyne_points";
+  size_t num_scans = argc > 3 ? std::stoul(argv[3]) : 15;
+  double radius = argc > 4 ? std::stod(argv[4]) : 0.25;
+  int min_neighbors = argc > 5 ? std::stoi(argv[5]) : 20;
+
+  pcodar::PersistentCloudFilter pcl_filter;
+  pcl_filter.set_params(pcodar::PersistentCloudFilter::BACKEND_PCL, radius, min_neighbors);
+  pcodar::PersistentCloudFilter voxel_filter;
+  voxel_filter.set_params(pcodar::PersistentCloudFilter::BACKEND_VOXEL, radius, min_neighbors);
+
+  rosbag::Bag bag(argv[1], rosbag::bagmode::Read);
+  rosbag::View view(bag, rosbag::TopicQuery({ "/tf", "/tf_static", cloud_topic }));
+  tf2_ros::Buffer tf_buffer(ros::Duration(3600.));
+
+  std::deque<pcodar::point_cloud_ptr> scans;
+  auto accumulated = boost::make_shared<pcodar::point_cloud>();
+  pcodar::point_cloud pcl_out, voxel_out;
+  size_t frames = 0, points = 0, mismatches = 0;
+  double pcl_ms = 0., voxel_ms = 0.;
+  auto frame = [&](sensor_msgs::PointCloud2ConstPtr const& msg) {
+    geometry_msgs::TransformStamped transform;
+    try
+    {
+      transform = tf_buffer.lookupTransform("enu", msg->header.frame_id, msg->header.stamp);
+    }
+    catch (tf2::TransformException&)
+    {
+      return;
+    }
+    Eigen::Affine3d pose = tf2::transformToEigen(transform);
+    auto scan = boost::make_shared<pcodar::point_cloud>();
+    pcl::fromROSMsg(*msg, *scan);
+    pcl::transformPointCloud(*scan, *scan, pose.cast<float>());
+    scans.push_back(scan);
+    if (scans.size() > num_scans)
+      scans.pop_front();
+
+    accumulated->clear();
+    for (auto const& previous : scans)
+      *accumulated += *previous;
+
+    auto start = std::chrono::steady_clock::now();
+    pcl_filter.filter(accumulated, pcl_out);
+    auto middle = std::chrono::steady_clock::now();
+    voxel_filter.filter(accumulated, voxel_out);
+    auto end = std::chrono::steady_clock::now();
+    pcl_ms += std::chrono::duration<double, std::milli>(middle - start).count();
+    voxel_ms += std::chrono::duration<double, std::milli>(end - middle).count();
+
+    bool same = pcl_out.size() == voxel_out.size();
+    for (size_t i = 0; same && i < pcl_out.size(); ++i)
+      same = pcl_out[i].getVector3fMap() == voxel_out[i].getVector3fMap();
+    mismatches += !same;
+    points += accumulated->size();
+    ++frames;
+  };
+
+  // Hold each scan until a transform newer than it has been read, so its pose can be interpolated
+  std::deque<sensor_msgs::PointCloud2ConstPtr> pending;
+  ros::Time latest_transform;
+  for (rosbag::MessageInstance const& message : view)
+  {
+    if (message.getTopic() == cloud_topic)
+    {
+      auto cloud = message.instantiate<sensor_msgs::PointCloud2>();
+      if (cloud)
+        pending.push_back(cloud);
+    }
+    else
+    {
+      auto transforms = message.instantiate<tf2_msgs::TFMessage>();
+      if (!transforms)
+        continue;
+      bool is_static = message.getTopic() == "/tf_static";
+      for (auto const& transform : transforms->transforms)
+      {
+        tf_buffer.setTransform(transform, "bag", is_static);
+        if (!is_static)
+          latest_transform = std::max(latest_transform, transform.header.stamp);
+      }
+    }
+
+    while (!pending.empty() && pending.front()->header.stamp < latest_transform)
+    {
+      frame(pending.front());
+      pending.pop_front();
+    }
+  }
+
+  if (!frames)
+  {
+    std::cerr << "No scans on " << cloud_topic << " could be transformed into enu" << std::endl;
+    return 1;
+  }
+  std::cout << frames << " frames of up to " << num_scans << " scans, " << points / frames
+            << " points on average, radius " << radius << ", " << min_neighbors << " neighbors" << std::endl;
+  std::cout << "PCL RadiusOutlierRemoval: " << pcl_ms / frames << " ms / frame" << std::endl;
+  std::cout << "Voxel hashing:            " << voxel_ms / frames << " ms / frame" << std::endl;
+  std::cout << mismatches << " frames with different points kept" << std::endl;
+  return mismatches ? 1 : 0;
+}
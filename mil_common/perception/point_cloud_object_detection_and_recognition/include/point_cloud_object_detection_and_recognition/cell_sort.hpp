@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pcodar
+{
+/// Counting sort of points by the cell each is in, used by the grid based filters and clustering so each cell's
+/// points are contiguous. @point_cells is the cell of each point, numbered from 0 up to @num_cells. Fills
+/// @sorted_points with the indices of the points in cell order, keeping their order within a cell, and @cell_starts
+/// so the points of cell i are [cell_starts[i], cell_starts[i + 1]) of it.
+void sort_by_cell(std::vector<uint32_t> const& point_cells, size_t num_cells, std::vector<uint32_t>& cell_starts,
+                  std::vector<uint32_t>& sorted_points);
+
+}  // namespace pcodar
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pcodar_types.hpp"
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * Tells whether the scene changed in a frame, so clustering and association can be skipped while the robot holds
+ * station in front of a scene where nothing moves.
+ *
+ * The points of each frame are hashed into coarse voxels in the global frame, its occupancy signature, which is
+ * compared with the voxels occupied in the frames of a recent window. Voxels occupied now and in none of the window
+ * have appeared, and voxels occupied in none of the window since the frame leaving it have disappeared. The frame
+ * changed if together they are more than a fraction of its voxels. Comparing against a few frames rather than the last
+ * one keeps voxels the lidar only hits on some sweeps from counting as changes, at the cost of seeing a voxel empty
+ * that many frames late.
+ *
+ * Slow changes, a little each frame, add up without ever being more than the fraction, so a frame is reported changed
+ * anyway after a number of unchanged ones in a row.
+ */
+class ChangeDetector
+{
+public:
+  ChangeDetector();
+  /// Update the dynamic reconfigure parameters associated with this class
+  void update_config(Config const& config);
+  /// Add the points of a scan (in the global frame) to the frame being accumulated
+  void add(point_cloud const& pc);
+  /// End the frame being accumulated, returning false if it is unchanged and detection can be skipped. Always true
+  /// when disabled.
+  bool end_frame();
+  /// Forget every frame, so the next one changed
+  void clear();
+
+private:
+  /// Voxel coordinates packed into 21 bits each
+  using Key = uint64_t;
+  Key key_for(point_t const& point) const;
+
+  /// Frame each voxel in the window was last occupied in
+  std::unordered_map<Key, uint64_t> last_seen_;
+  /// Voxels occupied in each frame of the window, oldest first, ending with the frame being accumulated
+  std::deque<std::vector<Key>> history_;
+  /// Number of the frame being accumulated
+  uint64_t frame_;
+  /// Voxels of the frame being accumulated which are in none of the window
+  size_t appeared_;
+  /// Unchanged frames in a row
+  size_t skips_;
+
+  bool enabled_;
+  double resolution_;
+  size_t window_;
+  double threshold_;
+  size_t max_skips_;
+};
+
+}  // namespace pcodar
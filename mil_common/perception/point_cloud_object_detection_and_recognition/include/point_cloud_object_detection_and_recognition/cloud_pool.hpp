@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pcodar_types.hpp"
+
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * Pool of pointclouds and search trees from erased objects, recycled for new objects so their storage does not need to
+ * be allocated again each scan.
+ */
+class CloudPool
+{
+public:
+  /// Create a pool which holds at most @max_size clouds
+  explicit CloudPool(size_t max_size = 64);
+  /// Get a cloud containing a copy of @points and a search tree over it, reusing pooled storage if available
+  void acquire(point_cloud const& points, point_cloud_ptr& cloud, KdTreePtr& search_tree);
+  /// Get a cloud and search tree to fill, reusing pooled storage if available. Their contents are unspecified.
+  void acquire(point_cloud_ptr& cloud, KdTreePtr& search_tree);
+  /// Return a cloud and search tree to the pool. Ignored if they are still in use elsewhere or the pool is full.
+  void release(point_cloud_ptr const& cloud, KdTreePtr const& search_tree);
+  /// Free all pooled storage
+  void clear();
+  /// Number of pooled clouds
+  size_t size() const;
+  /// Bytes held by pooled clouds and search trees, see cloud_memory_usage
+  size_t memory_usage() const;
+
+private:
+  size_t max_size_;
+  std::vector<std::pair<point_cloud_ptr, KdTreePtr>> free_;
+};
+
+/// Bytes held by the points of @cloud and, estimated, by @search_tree, either of which may be null. A search tree keeps
+/// its own copy of the points and an index over them, about as big again as the cloud.
+size_t cloud_memory_usage(point_cloud const* cloud, KdTree const* search_tree);
+
+}  // namespace pcodar
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "pcodar_types.hpp"
+
+#include <pcl/segmentation/extract_clusters.h>
+
+#include <memory>
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * Finds Euclidean clusters in a pointcloud: two points are in the same cluster if they are connected by a chain of
+ * points each closer than the tolerance to the next. Implementations must produce the same clusters as
+ * pcl::EuclideanClusterExtraction, with indices sorted within each cluster and clusters sorted largest first, unless
+ * documented as approximate.
+ */
+class ClusteringBackend
+{
+public:
+  virtual ~ClusteringBackend() = default;
+  /// Fill @clusters with the clusters in @pc of at least @min_points points
+  virtual void cluster(point_cloud_const_ptr const& pc, double tolerance, int min_points, clusters_t& clusters) = 0;
+  /// Update the dynamic reconfigure parameters specific to this backend
+  virtual void update_config(Config const& config)
+  {
+  }
+  /// Fill @features with the features of the clusters found by the last call to cluster, in the same order. Returns
+  /// false if this backend does not compute them while clustering.
+  virtual bool get_features(cluster_features_t& features) const
+  {
+    return false;
+  }
+};
+
+/**
+ * Clusters using pcl::EuclideanClusterExtraction with a kd-tree.
+ */
+class PclClusteringBackend : public ClusteringBackend
+{
+public:
+  void cluster(point_cloud_const_ptr const& pc, double tolerance, int min_points, clusters_t& clusters) override;
+
+private:
+  pcl::EuclideanClusterExtraction<point_t> cluster_extractor_;
+};
+
+/**
+ * Clusters by hashing points into cells small enough that all points in a cell are within the tolerance, then
+ * joining neighboring cells containing any pair of points within the tolerance with union-find.
+ */
+class GridClusteringBackend : public ClusteringBackend
+{
+public:
+  void cluster(point_cloud_const_ptr const& pc, double tolerance, int min_points, clusters_t& clusters) override;
+
+private:
+  /// Union find parent of each cell
+  std::vector<uint32_t> parent_;
+  uint32_t find(uint32_t cell);
+  /// Cell of each point
+  std::vector<uint32_t> point_cells_;
+  /// Points sorted by cell, and the range of cell i in it is [cell_starts_[i], cell_starts_[i + 1])
+  std::vector<uint32_t> sorted_points_;
+  std::vector<uint32_t> cell_starts_;
+  std::vector<int> labels_;
+};
+
+/**
+ * Same algorithm as GridClusteringBackend, run on a CUDA device. Falls back to PclClusteringBackend if PCODAR was
+ * built without CUDA or no device is available.
+ */
+class CudaClusteringBackend : public ClusteringBackend
+{
+public:
+  void cluster(point_cloud_const_ptr const& pc, double tolerance, int min_points, clusters_t& clusters) override;
+
+private:
+  std::vector<float> xyz_;
+  std::vector<int> labels_;
+  PclClusteringBackend fallback_;
+};
+
+/**
+ * Approximate 2.5-D clustering, after navigator_lidar_oa's ConnectedComponents: points are binned into vertical
+ * columns of a grid over the x / y plane, and two columns are connected if their centers are within the tolerance,
+ * whatever the heights of their points. Objects floating on the water are rarely stacked, so this finds the same
+ * objects as Euclidean clustering in a fraction of the time, only joining clusters at different heights over the same
+ * spot (ex: a bridge over a buoy) and rounding the tolerance to the grid.
+ *
+ * The volume features of each cluster are accumulated per column while binning, so they cost nothing per point.
+ */
+class ColumnClusteringBackend : public ClusteringBackend
+{
+public:
+  ColumnClusteringBackend();
+  void cluster(point_cloud_const_ptr const& pc, double tolerance, int min_points, clusters_t& clusters) override;
+  void update_config(Config const& config) override;
+  bool get_features(cluster_features_t& features) const override;
+
+private:
+  /// Points in a column of the grid
+  struct Column
+  {
+    /// Cell of the column in grid_
+    int x;
+    int y;
+    uint32_t points;
+    Eigen::Vector3f min;
+    Eigen::Vector3f max;
+    Eigen::Vector3f sum;
+  };
+
+  /// Edge length of each column. Clouds spanning more than MAX_CELLS columns use larger ones.
+  double resolution_;
+  /// Index + 1 of the column in each cell of the grid over the cloud's bounding box, or 0 if it has no points. Kept
+  /// zeroed between calls, so only the cells with points are written each call.
+  std::vector<uint32_t> grid_;
+  std::vector<Column> columns_;
+  /// Column of each point
+  std::vector<uint32_t> point_columns_;
+  /// Index + 1 of the first column in each block of the grid, or 0 if it has none, kept zeroed like grid_
+  std::vector<uint32_t> block_heads_;
+  /// Index + 1 of the next column in the same block as each column, or 0 if it is the last
+  std::vector<uint32_t> next_in_block_;
+  /// Blocks with columns
+  std::vector<uint32_t> blocks_;
+  /// Union find parent of each column
+  std::vector<uint32_t> parent_;
+  uint32_t find(uint32_t column);
+  /// Cluster of each column, or -1 if its cluster is too small
+  std::vector<int> column_clusters_;
+  cluster_features_t features_;
+};
+
+/// Group points by cluster label into @clusters, dropping clusters with less than @min_points points. Indices are
+/// sorted within each cluster and clusters are sorted largest first, matching pcl::EuclideanClusterExtraction.
+void labels_to_clusters(std::vector<int> const& labels, int min_points, clusters_t& clusters);
+
+}  // namespace pcodar
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "pcodar_types.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * Pointcloud quantized to 16 bit offsets from the center of its bounding box, 6 bytes per point instead of the 16 of
+ * point_t. Offsets are in steps of 1cm, or coarser for clouds over 655m across so that every offset fits.
+ *
+ * Used to keep the points of objects which have not been seen in a while, which are read far less often than they are
+ * kept around.
+ */
+class CompactCloud
+{
+public:
+  /// Step of the offsets of clouds small enough to use it
+  static constexpr float MIN_STEP = 0.01;
+
+  CompactCloud();
+  /// Replace the points with a quantized copy of @pc
+  void assign(point_cloud const& pc);
+  /// Decode every point into @pc, replacing its points
+  void decode(point_cloud& pc) const;
+  /// Decode @count points starting at @begin into @out
+  void decode(size_t begin, size_t count, point_t* out) const;
+  void clear();
+  size_t size() const;
+  bool empty() const;
+  /// Bytes used to store the points
+  size_t memory_usage() const;
+  /// Largest distance from a point to its decoded value
+  float max_error() const;
+
+private:
+  Eigen::Vector3f origin_;
+  float step_;
+  /// x, y, and z offset of each point
+  std::vector<int16_t> offsets_;
+};
+
+}  // namespace pcodar
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "pcodar_types.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace pcodar
+{
+/**
+ * Dynamic reconfigure configs handed to the threads which use them, so a stage is never reconfigured by another
+ * thread in the middle of a scan.
+ *
+ * The reconfigure callback publishes each config as an immutable, versioned snapshot, replacing the current one with
+ * an atomic store of its pointer. A thread using the stages takes the current snapshot with an atomic load when it
+ * starts a scan, and applies it there, between scans, if it is newer than the one it last applied. Old snapshots are
+ * freed when the last thread holding one lets go of it. Readers never wait for a reconfigure, and a stage sees one
+ * whole config for a whole scan.
+ *
+ * Each snapshot records the version at which every level bit last changed, so a reader which missed several
+ * reconfigures still updates everything that changed in any of them.
+ */
+class ConfigSnapshots
+{
+public:
+  struct Snapshot
+  {
+    Config config;
+    uint64_t version;
+    std::array<uint64_t, 32> level_versions;
+
+    /// Level bits which changed after @version
+    uint32_t changed_since(uint64_t version) const;
+  };
+  using SnapshotPtr = std::shared_ptr<Snapshot const>;
+
+  /// Publish @config, with the bits of @level changed, or all of them if it is 0
+  void publish(Config const& config, uint32_t level);
+  /// The latest snapshot, or null before the first publish
+  SnapshotPtr load() const;
+
+  /**
+   * The snapshot one thread last applied. Only used from that thread.
+   */
+  class Reader
+  {
+  public:
+    /// If @snapshots has a newer snapshot than the last one taken, take it into @snapshot, set @level to the bits
+    /// changed since, and return true
+    bool update(ConfigSnapshots const& snapshots, SnapshotPtr& snapshot, uint32_t& level);
+
+  private:
+    uint64_t version_ = 0;
+  };
+
+private:
+  SnapshotPtr current_;
+  /// Only orders publishers, readers never take it
+  std::mutex publish_mutex_;
+};
+
+}  // namespace pcodar
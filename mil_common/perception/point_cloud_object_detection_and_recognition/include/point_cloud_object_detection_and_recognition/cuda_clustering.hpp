@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace pcodar
+{
+namespace cuda
+{
+/**
+ * Label the Euclidean clusters of @count points on a CUDA device. @xyz contains the x, y, z of each point in order
+ * and @min, @max are the corners of their bounding box. Points in the same cluster get the same label in @labels.
+ * Returns false, with why in @error, if no device is available, the cloud is too large for the cell size or the device
+ * fails, so the caller can fall back. Kept free of PCL so it can be compiled by nvcc.
+ */
+bool euclidean_cluster_labels(float const* xyz, size_t count, float const min[3], float const max[3], float tolerance,
+                              std::vector<int>& labels, std::string& error);
+
+}  // namespace cuda
+}  // namespace pcodar
@@ -11,13 +11,32 @@ namespace pcodar
 /**
  * Filters a single incoming pointcloud after it has been transformed into global frame.
  * Removes points outside of a specified "bounds" polygon and points inside a specified robot footprint polygon.
+ *
+ * When the bounds polygon is convex (always the case for the 4 vertex bounds from mil_bounds), it is stored as a set
+ * of edge half-planes so the whole filter is a handful of multiply-adds per point, evaluated over batches of
+ * points at once so the compiler can vectorize it.
  */
 class InputCloudFilter
 {
 public:
+  /// A batch of points, one per row. Column major so each coordinate is contiguous.
+  using PointBatch = Eigen::Matrix<float, Eigen::Dynamic, 3>;
+  /// Mask of which rows of a PointBatch are kept
+  using BatchMask = Eigen::Array<bool, Eigen::Dynamic, 1>;
+  /// Number of points evaluated together by @filter
+  static constexpr size_t BATCH_SIZE = 256;
+
   InputCloudFilter();
   /// Filters @in, storing resulting pointcloud into @pc
-  void filter(point_cloud_const_ptr in, point_cloud& pc);
+  void filter(point_cloud_const_ptr in, point_cloud& pc) const;
+  /// Filters @in with PCL's CropHull and CropBox filters, storing resulting pointcloud into @pc. Produces the same
+  /// results as @filter, but slower. Kept as a reference for benchmarking.
+  void filter_pcl(point_cloud_const_ptr in, point_cloud& pc);
+  /// Returns true if a single point (in the global frame) would be kept by @filter. Used to filter points
+  /// as they are converted so no intermediate pointcloud is needed.
+  bool accept(point_t const& point) const;
+  /// Sets @keep to whether each point in @points would be kept by @filter
+  void accept(Eigen::Ref<const PointBatch> const& points, BatchMask& keep) const;
   /// Sets the bounds with a pointcloud where each point is a verticie of the bounds polygon
   void set_bounds(point_cloud_ptr bounds);
   /// Set the robot footprint with a pointcloud in the robot's local frame where each point is a verticie of the
@@ -27,7 +46,20 @@ public:
   void set_robot_pose(Eigen::Affine3d const& transform);
 
 private:
+  /// Even-odd crossing test for non-convex bounds
+  bool inside_bounds_polygon(float x, float y) const;
+
   point_cloud robot_footprint_;
+  /// Vertices of the bounds polygon in the global frame, empty if bounds have not been set
+  std::vector<Eigen::Vector2f> bounds_;
+  /// If bounds are convex, each edge as (a, b, c) such that a * x + b * y + c >= 0 for points inside
+  std::vector<Eigen::Vector3f> half_planes_;
+  bool bounds_convex_;
+  /// Transform from the global frame to the robot
+  Eigen::Affine3f robot_inverse_;
+  /// Corners of the robot footprint in the robot's frame
+  Eigen::Vector3f footprint_min_;
+  Eigen::Vector3f footprint_max_;
   pcl::CropHull<pcl::PointXYZ> bounds_filter_;
   pcl::CropBox<pcl::PointXYZ> robot_filter_;
 };
@@ -15,6 +15,8 @@
 #include <pcl/point_types.h>
 
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace pcodar
 {
@@ -27,7 +29,7 @@ class MarkerManager
 public:
   /// Initialize the marker manager with a nodehandle in the namespace of where the markers will be publishedj
   void initialize(ros::NodeHandle& nh, std::shared_ptr<ObjectMap> objects_);
-  /// Update the interactive markers
+  /// Update the interactive markers, at most at the configured rate. The caller must hold the object map's mutex.
   void update_markers();
   /// Reset
   void reset();
@@ -35,6 +37,8 @@ public:
 private:
   /// Update/Create the interactive marker for one object
   void update_interactive_marker(mil_msgs::PerceptionObject const& object);
+  /// Update the markers of objects which changed since they were last sent, or all objects if not diffing
+  void update_changed_markers();
   /// Called when user selects new classification in rviz
   void feedbackCb(const visualization_msgs::InteractiveMarkerFeedbackConstPtr& feedback);
 
@@ -44,6 +48,23 @@ private:
   std::vector<std::string> classifications_;
   /// Pointer to PCODAR object map
   std::shared_ptr<ObjectMap> objects_;
+  /// Classifications selected in rviz since the last update, as (id, classification). Applied in update_markers so
+  /// the feedback callback never needs to lock the object map while the marker server is locked.
+  std::vector<std::pair<uint, std::string>> pending_classifications_;
+  std::mutex pending_classifications_mutex_;
+
+  /// What was last sent to the marker server for an object, to detect changes
+  struct Sent
+  {
+    uint64_t version;
+    std::string labeled_classification;
+  };
+  std::unordered_map<uint, Sent> sent_;
+  /// If true, only send markers for objects which changed
+  bool diff_;
+  /// Minimum time between updates sent to RVIZ, regardless of how often update_markers is called
+  ros::Duration period_;
+  ros::Time last_update_;
 };
 
 }  // namespace pcodar
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "compact_cloud.hpp"
+#include "object_track.hpp"
 #include "pcodar_types.hpp"
 
+#include <atomic>
+
 namespace mil_gazebo
 {
 class PCODARGazebo;
@@ -16,30 +20,110 @@ namespace pcodar
 class Object
 {
 public:
+  /// Which of the object's points are included in its message
+  enum MsgPoints
+  {
+    MSG_POINTS_FULL,
+    MSG_POINTS_DECIMATED,
+    MSG_POINTS_HULL
+  };
+
   /// Create an object from a pointcloud of points associated with
   Object(point_cloud_ptr const& pc, uint id, KdTreePtr const& search_tree);
   /// Update the points associated with an object
   void update_points(point_cloud_ptr const& pc, KdTreePtr const& search_tree);
+  /// Update the points associated with an object by copying @pc, reusing the existing cloud and search tree when the
+  /// number of points is similar to what it can already hold
+  void update_points(point_cloud const& pc);
+  /// The object's points and a search tree over them. Only for objects which are not compact.
   point_cloud const& get_points() const;
   point_cloud_ptr get_points_ptr() const;
   KdTreePtr get_search_tree() const;
+  /// The object's points, decoded into @buffer if the object is compact
+  point_cloud const& get_points(point_cloud& buffer) const;
+  size_t num_points() const;
+  /// Bytes held by the object's points and search tree, or its compact points
+  size_t memory_usage() const;
+  /// Move the points into a CompactCloud, handing back the cloud and search tree they were in through @pc and
+  /// @search_tree so they can be reused. The points lose precision, see CompactCloud.
+  void compact(point_cloud_ptr& pc, KdTreePtr& search_tree);
+  /// Move the points of a compact object back into @pc and build @search_tree over them
+  void expand(point_cloud_ptr const& pc, KdTreePtr const& search_tree);
+  /// If set, the points are only kept in a CompactCloud, and must be expanded before their search tree is used
+  bool is_compact() const;
+  /// ROS message representing the object, rebuilt only if the object has changed since it was last requested
   mil_msgs::PerceptionObject const& as_msg() const;
   point_t const& get_center() const;
+  /// Minimum corner of the axis aligned bounding box around the object's points
+  point_t const& get_min() const;
+  /// Maximum corner of the axis aligned bounding box around the object's points
+  point_t const& get_max() const;
+  /// Set the volume features of the cluster the object's points were last updated from
+  void set_features(ClusterFeatures const& features);
+  /// Volume features of the object's points, or nullptr if the clustering backend does not compute them
+  ClusterFeatures const* get_features() const;
   void set_classification(std::string const& classification);
+  /// Labeled classification, without building the message
+  std::string const& get_classification() const;
   void set_id(uint id);
+  /// Unique value which changes whenever the object's points change
+  uint64_t get_version() const;
+  /// Set which points are included in the message. If decimated, at most @max_points are included.
+  void set_msg_points(MsgPoints mode, size_t max_points);
+  /// Record that the object was associated with a cluster in association step @step, raising its confidence by
+  /// @gain (up to 1). Only the first call for a step counts.
+  void hit(uint64_t step, float gain);
+  /// Record that the object was not associated with any cluster, lowering its confidence by @decay (down to 0)
+  void miss(float decay);
+  /// Keep the best track state of this object and @other, which is being merged into it
+  void merge_track(Object const& other);
+  /// Restore the confidence and hits saved in a snapshot. The object counts as not seen since.
+  void restore_track(float confidence, uint32_t hits);
+  /// Confidence from 0-1 that the object still exists, from its recent hits and misses
+  float get_confidence() const;
+  /// Number of association steps the object has been associated in
+  uint32_t get_hits() const;
+  /// Association step the object was last associated in
+  uint64_t get_last_seen() const;
+  /// Estimated motion of the object, only maintained when the associator is tracking
+  ObjectTrack const& get_track() const;
+  ObjectTrack& get_track();
 
 private:
-  /// ROS message representing the object, automaticly kept up to date
+  /// ROS message representing the object, built on request by update_msg
   /// TODO: make private
-  mil_msgs::PerceptionObject msg_;
-  /// The points associated with this object
+  mutable mil_msgs::PerceptionObject msg_;
+  /// If set, msg_ and center_ are out of date
+  mutable bool msg_dirty_;
+  MsgPoints msg_points_;
+  size_t msg_max_points_;
+  /// The points associated with this object, null while it is compact
   point_cloud_ptr points_;
   /// Search tree, always kept up to date
   KdTreePtr search_tree_;
+  /// The points while the object is compact
+  CompactCloud compact_points_;
   /// The center of the minimum area bounding box aroudn the objet
-  point_t center_;
-  /// Update points_ and center_, called after a call to update_points
-  void update_msg();
+  mutable point_t center_;
+  /// Corners of the axis aligned bounding box around the points
+  point_t min_;
+  point_t max_;
+  /// Features from set_features, valid until the points are next updated
+  ClusterFeatures features_;
+  bool has_features_;
+  /// Value of version_counter_ when the points were last updated
+  uint64_t version_;
+  /// Track state, see hit and miss
+  float confidence_;
+  uint32_t hits_;
+  uint64_t last_seen_;
+  ObjectTrack track_;
+  /// Incremented every time any object's points are updated, so copies or new objects never share a version
+  static std::atomic<uint64_t> version_counter_;
+  /// Update the bounding box and mark the message out of date, called after a call to update_points
+  void update_bounds();
+  /// Update msg_ and center_, called when they are requested after the object changes
+  void update_msg() const;
 
   friend class mil_gazebo::PCODARGazebo;
 };
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "object_map.hpp"
+#include "object_track.hpp"
 #include "pcodar_types.hpp"
+#include "spatial_grid.hpp"
 
 #include <mil_msgs/PerceptionObject.h>
 
 #include <limits>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
 
 namespace pcodar
 {
@@ -13,19 +18,146 @@ namespace pcodar
  * Associates recently identified objects with previous objects so they persist over time.
  * This is acomplished by finding the nearest neighbor point, creating a new object if this is
  * greater than a maximum distance.
+ *
+ * Before any point level search, candidate objects are pruned with a grid of object bounding boxes
+ * and a bounding box distance check, so only objects within the maximum distance of a cluster are searched.
+ *
+ * In parallel mode, without tracking, the work for each cluster (copying out its points, building its search tree and
+ * searching the objects near it) is done on several threads with OpenMP, against the objects as they were before the
+ * step. The results are then applied to the map one cluster at a time, only searching again the objects changed by
+ * earlier clusters in the step, so the associations are the same as in serial mode.
+ *
+ * Objects not associated in a number of steps are compacted (see Object::compact) to save memory, and expanded again
+ * when a cluster reaches the narrow phase with them.
+ *
+ * Each object's confidence rises when it is associated and decays when it is not. Objects are forgotten when their
+ * confidence reaches zero unless they are stable (associated in enough steps). If there are more than a maximum
+ * number of objects, the least recently seen are forgotten, unstable ones first.
+ *
+ * If tracking is enabled, each object instead has a constant velocity track. Tracks are predicted to the time of the
+ * clusters, each cluster's center is gated against the predicted positions by Mahalanobis distance, and clusters are
+ * assigned one to one to objects greedily or optimally (Hungarian algorithm). Clusters outside every gate fall back
+ * to the nearest point rule against the objects left unassigned.
  */
 class Associator
 {
 public:
+  /// How gated clusters are assigned to objects when tracking
+  enum Assignment
+  {
+    ASSIGNMENT_GREEDY,
+    ASSIGNMENT_HUNGARIAN
+  };
+
   /// Update the dynamic reconfigure parameters associated with this class
   void update_config(Config const& config);
-  /// Associate old objects with newly identified clusters. @prev_objects is updated + appended in place for new
-  /// associations
-  void associate(ObjectMap& prev_objects, point_cloud const& pc, clusters_t clusters);
+  /// Associate old objects with newly identified clusters, observed at @stamp (seconds). @prev_objects is updated +
+  /// appended in place for new associations. If given, @features are the features of each cluster, and are kept by
+  /// the objects they are associated with.
+  void associate(ObjectMap& prev_objects, point_cloud const& pc, clusters_t const& clusters, double stamp = 0.,
+                 cluster_features_t const* features = nullptr);
+  /// Repeat the last association step without clusters, for a frame in which nothing changed. Objects associated in
+  /// the last step are again and the others are not, so confidence and forgetting carry on as if it had been run.
+  void repeat(ObjectMap& prev_objects);
 
 private:
+  /// Decay and forget the objects not in @seen, evict and compact, ending an association step
+  void end_step(ObjectMap& prev_objects, std::unordered_set<uint> const& seen);
+  /// Associate each cluster with every object it has a point near, merging them
+  void associate_nearest(ObjectMap& objects, point_cloud const& pc, clusters_t const& clusters,
+                         std::unordered_set<uint>& seen);
+  /// Same as associate_nearest, doing the work for each cluster in parallel
+  void associate_nearest_parallel(ObjectMap& objects, point_cloud const& pc, clusters_t const& clusters,
+                                  std::unordered_set<uint>& seen);
+  /// Associate clusters one to one with the objects whose predicted positions they are gated with
+  void associate_tracked(ObjectMap& objects, point_cloud const& pc, clusters_t const& clusters, double stamp,
+                         std::unordered_set<uint>& seen);
+  /// Copy a cluster's points into cluster_pc_, returning false if it is empty
+  bool load_cluster(point_cloud const& pc, cluster_t const& cluster, point_t& min, point_t& max);
+  /// Fill @matches with the objects in index_ with any point within max_distance_ of cluster_pc_
+  void find_nearby(ObjectMap& objects, point_t const& min, point_t const& max,
+                   std::vector<ObjectMap::Iterator>& matches);
+  /// Add cluster_pc_ as a new object, returning its id
+  uint add_cluster(ObjectMap& objects);
+  /// Give @object the features of cluster @cluster, if there are any
+  void set_features(Object& object, size_t cluster) const;
+  /// Covariance of the center of a bounding box as a measurement of an object's position
+  ObjectTrack::Matrix2 measurement_noise(point_t const& min, point_t const& max) const;
+  /// Returns true if any point in @points is within max_distance_ of a point in @search_tree
+  bool any_within_distance(point_cloud const& points, KdTree& search_tree) const;
+  /// Insert / update an object's bounding box in the broad phase index
+  void index_object(uint id, Object const& object);
+  /// Returns true if @object has been associated in enough steps to be kept when its confidence decays
+  bool is_stable(Object const& object) const;
+  /// Forget the least recently seen objects until at most max_objects_ remain
+  void evict(ObjectMap& objects);
+
   double max_distance_;
-  bool forget_unseen_;
+  /// Confidence gained by an object each step it is associated / lost each step it is not
+  float hit_gain_;
+  float miss_decay_;
+  /// Objects associated in at least this many steps are stable, 0 to disable
+  uint32_t stable_hits_;
+  /// Maximum objects to keep, 0 for no limit
+  size_t max_objects_;
+  /// Objects not associated in this many steps are compacted, 0 to disable
+  uint64_t compact_after_steps_ = 0;
+  /// If set, use associate_nearest_parallel instead of associate_nearest
+  bool parallel_ = false;
+  /// Number of calls to associate
+  uint64_t step_ = 0;
+  /// If set, use associate_tracked
+  bool tracking_;
+  /// Squared Mahalanobis distance of the gate around each predicted position
+  double gate_;
+  Assignment assignment_;
+  /// Standard deviations of track acceleration, of cluster centers (before adding object extent), and of the
+  /// velocity of new tracks
+  double accel_std_;
+  double measurement_std_;
+  double initial_velocity_std_;
+  /// Broad phase index of object bounding boxes, rebuilt at the start of each association
+  SpatialGrid index_;
+  /// Reused buffer for broad phase query results
+  std::vector<uint> candidates_;
+  /// Objects which reached the narrow phase with some cluster this step
+  std::unordered_set<uint> narrow_phase_;
+  /// Reused buffer for the points of the cluster being associated
+  point_cloud cluster_pc_;
+  /// Features of the clusters being associated, only set during associate
+  cluster_features_t const* features_ = nullptr;
+  /// Reused buffer of eviction candidates, as (unstable, last seen, id) ordered oldest first
+  std::vector<std::tuple<bool, uint64_t, uint>> eviction_;
+  /// Reused buffers for tracking: each cluster's bounds and assigned object, the gated (distance, cluster, object)
+  /// pairs, and the Hungarian cost matrix and result
+  struct TrackedCluster
+  {
+    point_t min;
+    point_t max;
+    bool valid;
+    bool assigned;
+    uint object;
+  };
+  std::vector<TrackedCluster> tracked_clusters_;
+  /// Reused buffers for parallel association: each cluster's points and search tree, its bounds, and the objects it
+  /// could be near and is near, by ascending id, before any cluster was applied. Also the objects changed so far in
+  /// the step, and the objects a cluster is near as it is applied.
+  struct ParallelCluster
+  {
+    point_cloud_ptr cloud;
+    KdTreePtr search_tree;
+    point_t min;
+    point_t max;
+    bool valid;
+    std::vector<uint> candidates;
+    std::vector<uint> matches;
+  };
+  std::vector<ParallelCluster> parallel_clusters_;
+  std::unordered_set<uint> changed_;
+  std::vector<uint> match_ids_;
+  std::vector<std::tuple<double, size_t, uint>> gated_;
+  std::vector<double> cost_;
+  std::vector<int> row_to_col_;
 };
 
 }  // namespace pcodar
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "object_map.hpp"
+#include "pcodar_types.hpp"
+
+#include <mil_msgs/PerceptionObjectDelta.h>
+
+#include <unordered_map>
+
+namespace pcodar
+{
+/**
+ * Encodes changes to an @ObjectMap as PerceptionObjectDelta messages, remembering what was last sent for each object
+ * so only added, changed, and removed objects are included.
+ */
+class ObjectDeltaEncoder
+{
+public:
+  ObjectDeltaEncoder();
+  /// Fill @msg with the changes to @objects since the last call. If @keyframe is true, or this is the first call since
+  /// a reset, every object is sent.
+  void encode(ObjectMap const& objects, bool keyframe, mil_msgs::PerceptionObjectDelta& msg);
+  /// Forget what was previously sent, so the next call to @encode produces a keyframe
+  void reset();
+
+private:
+  /// State of an object when it was last sent
+  struct Sent
+  {
+    uint64_t version;
+    std::string labeled_classification;
+  };
+  std::unordered_map<uint, Sent> sent_;
+  uint32_t sequence_;
+  bool needs_keyframe_;
+};
+
+}  // namespace pcodar
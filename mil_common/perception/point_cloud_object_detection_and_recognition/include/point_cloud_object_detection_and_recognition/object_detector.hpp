@@ -1,26 +1,73 @@
 #pragma once
 
+#include "clustering_backend.hpp"
 #include "pcodar_types.hpp"
 
 #include <mil_msgs/PerceptionObjectArray.h>
 
-#include <pcl/kdtree/kdtree.h>
-#include <pcl/segmentation/extract_clusters.h>
+#include <Eigen/Core>
+
+#include <memory>
+#include <vector>
 
 namespace pcodar
 {
 /**
  * Detects objects in a pointcloud by clustering points that are nearby.
+ *
+ * Returns from a lidar spread apart with range, so with one tolerance, distant objects with sparse returns fragment
+ * into several clusters which the associator then has to merge. In range adaptive mode, the tolerance at a range r
+ * from the sensor is max(cluster_tolerance_m, factor * r * angular resolution), a multiple of the gap between
+ * neighboring returns there. Points are binned by range and each bin clustered by the backend with the tolerance at its
+ * far edge, along with the points of nearer bins within that tolerance of it, so pairs across a bin edge are still
+ * joined. Clusters sharing points are then merged with union-find. The backend's features are not used in this mode,
+ * as they are of the pieces clustered in each bin.
  */
 class ObjectDetector
 {
 public:
+  ObjectDetector();
   /// Returns an array of clusters found in @pc
   clusters_t get_clusters(point_cloud_const_ptr pc);
+  /// Fills @clusters with the clusters found in @pc, reusing its storage
+  void detect(point_cloud const& pc, clusters_t& clusters);
+  /// Features of the clusters returned by the last call to get_clusters, in the same order, or empty if the backend
+  /// does not compute them
+  cluster_features_t const& get_features() const;
   /// Update the dynamic reconfigure parameters associated with this class
   void update_config(Config const& config);
+  /// Position of the sensor in the frame of the clouds, which ranges are measured from in range adaptive mode
+  void set_sensor_position(Eigen::Vector3f const& position);
 
 private:
-  pcl::EuclideanClusterExtraction<point_t> cluster_extractor_;
+  /// Tolerance for points at @range from the sensor
+  double tolerance_at(double range) const;
+  /// Cluster each range bin separately, see the class comment
+  void detect_range_adaptive(point_cloud const& pc, clusters_t& clusters);
+  uint32_t find(uint32_t point);
+
+  /// Selected from config, see ClusteringBackend
+  std::unique_ptr<ClusteringBackend> backend_;
+  int backend_type_;
+  double cluster_tolerance_;
+  int cluster_min_points_;
+  cluster_features_t features_;
+
+  bool range_adaptive_;
+  double angular_resolution_;
+  double range_factor_;
+  double range_bin_;
+  Eigen::Vector3f sensor_position_;
+  /// Range of each point, and the range bin it is in
+  std::vector<float> ranges_;
+  std::vector<uint32_t> bins_;
+  /// Points clustered with each bin, its own and those of nearer bins within its tolerance
+  std::vector<std::vector<uint32_t>> bin_points_;
+  /// Reused cloud of the points of a bin, and the clusters found in it
+  point_cloud_ptr bin_cloud_;
+  clusters_t bin_clusters_;
+  /// Union find parent of each point
+  std::vector<uint32_t> parent_;
+  std::vector<int> labels_;
 };
 }
@@ -1,24 +1,35 @@
 #pragma once
 
+#include "cloud_pool.hpp"
 #include "object.hpp"
 #include "pcodar_types.hpp"
+#include "region.hpp"
+#include "spatial_grid.hpp"
 
 #include <mil_msgs/ObjectDBQuery.h>
 #include <mil_msgs/PerceptionObjectArray.h>
 
+#include <mutex>
+#include <unordered_set>
+
 namespace pcodar
 {
 /**
- * Contains a map of unique integer identifiers to objects (point clusters).
+ * Contains a map of unique integer identifiers to objects (point clusters). Objects are also indexed by
+ * labeled classification and location for database queries, so objects should only be added, modified, or removed
+ * through the functions of this class.
  */
 class ObjectMap
 {
 public:
   ObjectMap();
-  /// Creates a ROS message of the objects to publish / use for markers
-  mil_msgs::PerceptionObjectArray to_msg();
+  /// ROS message of the objects to publish / use for markers. Only the entries of objects which changed since the
+  /// last call are rebuilt, and the previous message is shared if nothing changed.
+  mil_msgs::PerceptionObjectArrayConstPtr to_msg();
   /// Processes a database query service request
   bool DatabaseQuery(mil_msgs::ObjectDBQuery::Request& req, mil_msgs::ObjectDBQuery::Response& res);
+  /// Fill @ids with the objects labeled @name (or any, if empty or "all") whose center is in @region, in order of id
+  void query_region(std::string const& name, Region const& region, std::vector<uint>& ids);
   /// Internal map of id's to objects
   /// TODO: make private and provide function interfaces
   std::unordered_map<uint, Object> objects_;
@@ -27,10 +38,61 @@ public:
   std::vector<uint> just_removed_;
   /// Add a new object by its pointcloud, given it a new unique id
   uint add_object(point_cloud_ptr const& pc, KdTreePtr const& search_tree);
-  /// Erase an object
+  /// Erase an object, returning its storage to pool_
   Iterator erase_object(Iterator const& it);
+  /// Erase all objects
+  void clear();
+  /// Bytes held by the points and search trees of every object, not counting pool_
+  size_t memory_usage() const;
+  /// Add or replace an object with a specific id, for when ids are assigned elsewhere (such as in simulation)
+  void set_object(uint id, Object const& object);
+  /// Replace the points of an object with a copy of @pc
+  void update_points(Iterator const& it, point_cloud const& pc);
+  /// Replace the points and search tree of an object with @pc and @search_tree, returning the old ones to pool_
+  void update_points(Iterator const& it, point_cloud_ptr const& pc, KdTreePtr const& search_tree);
+  /// Compact an object's points, returning their storage to pool_. See Object::compact.
+  void compact_object(Iterator const& it);
+  /// Expand a compact object's points into storage from pool_, so its search tree can be used
+  void expand_object(Iterator const& it);
+  /// Change the labeled classification of an object
+  void set_classification(Iterator const& it, std::string const& classification);
+  /// Set which points are included in the message of every object, see Object::set_msg_points
+  void set_msg_points(Object::MsgPoints mode, size_t max_points);
+  /// If set, to_msg rebuilds the messages of changed objects on several threads
+  void set_parallel_msgs(bool parallel);
+  /// Storage from erased objects, reused for new ones
+  CloudPool pool_;
   /// The id that will be assigned to the next new object, starting at 0
   size_t highest_id_;
+  /// Guards the map when it is shared between threads. Functions of this class do not lock it themselves.
+  std::mutex mutex_;
+
+private:
+  /// Add an object to the classification and spatial indexes
+  void index(uint id, Object const& object);
+  /// Remove an object from the classification and spatial indexes
+  void unindex(uint id, Object const& object);
+  /// Fill @ids with objects labeled @name (or any, if "all") near @position, nearest first. See ObjectDBQuery.srv.
+  void query_nearby(std::string const& name, point_t const& position, double radius, size_t max_results,
+                    std::vector<uint>& ids);
+
+  /// Ids of the objects with each labeled classification
+  std::unordered_map<std::string, std::unordered_set<uint>> by_classification_;
+  /// Bounding box of each object
+  SpatialGrid grid_;
+  /// Reused buffer for grid queries
+  std::vector<uint> candidates_;
+  /// Cached result of to_msg, copied before modifying if still referenced elsewhere (such as by a publisher)
+  mil_msgs::PerceptionObjectArrayPtr msg_;
+  /// Index of each object in msg_
+  std::unordered_map<uint, size_t> msg_index_;
+  /// Objects added, changed, or removed since msg_ was last updated
+  std::unordered_set<uint> msg_dirty_ids_;
+  Object::MsgPoints msg_points_;
+  size_t msg_max_points_;
+  bool parallel_msgs_;
+  /// Reused buffer of the objects whose messages to_msg rebuilds
+  std::vector<Object const*> msg_rebuild_;
 };
 
 }  // namespace pcodar
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "object_map.hpp"
+
+#include <string>
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * Compact binary snapshot of an ObjectMap (ids, classifications, confidence, and points), so a restarted node can
+ * start from a previously built map instead of rebuilding it from fresh scans.
+ *
+ * The format is native endian: a header of the magic "PCODARSN", a uint32 version, a uint32 object count, and the
+ * uint64 next id, followed by each object as uint32 id, uint32 hits, float32 confidence, uint32 classification
+ * length, uint32 point count, the classification padded to a multiple of 4 bytes, and float32 x, y, z per point.
+ */
+/// Serialize @objects into @out, reusing its storage. Only this needs the map's lock, so writing can happen after.
+void serialize_snapshot(ObjectMap const& objects, std::vector<uint8_t>& out);
+/// Write a serialized snapshot to @path, replacing any existing file only once the new one is complete
+bool write_snapshot(std::vector<uint8_t> const& data, std::string const& path, std::string& error);
+/// Replace the contents of @objects with the snapshot at @path, reading it through a memory map. @objects is left
+/// unchanged if the snapshot is invalid.
+bool load_snapshot(std::string const& path, ObjectMap& objects, std::string& error);
+
+}  // namespace pcodar
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Eigen/Core>
+
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * Constant velocity Kalman filter of an object's position in the x / y plane, with state (x, y, vx, vy).
+ * Unaligned Eigen types are used so objects can be stored in standard containers.
+ */
+class ObjectTrack
+{
+public:
+  using Vector2 = Eigen::Matrix<double, 2, 1, Eigen::DontAlign>;
+  using Matrix2 = Eigen::Matrix<double, 2, 2, Eigen::DontAlign>;
+
+  ObjectTrack();
+  /// If false, @initialize must be called before the track is used
+  bool initialized() const;
+  /// Start tracking at @position at time @stamp, with unknown velocity of standard deviation @velocity_std
+  void initialize(Vector2 const& position, double stamp, Matrix2 const& position_covariance, double velocity_std);
+  /// Predict the state at @stamp, with white noise acceleration of standard deviation @accel_std
+  void predict(double stamp, double accel_std);
+  /// Correct the state with a measured position of covariance @noise
+  void update(Vector2 const& measured, Matrix2 const& noise);
+  /// Squared Mahalanobis distance of a measured position of covariance @noise from the predicted position
+  double mahalanobis_squared(Vector2 const& measured, Matrix2 const& noise) const;
+  /// Covariance of the innovation of a measured position of covariance @noise
+  Matrix2 innovation_covariance(Matrix2 const& noise) const;
+  Vector2 get_position() const;
+  Vector2 get_velocity() const;
+  /// Time the state was last predicted to
+  double get_stamp() const;
+
+private:
+  using Vector4 = Eigen::Matrix<double, 4, 1, Eigen::DontAlign>;
+  using Matrix4 = Eigen::Matrix<double, 4, 4, Eigen::DontAlign>;
+
+  bool initialized_;
+  double stamp_;
+  Vector4 state_;
+  Matrix4 covariance_;
+};
+
+/// Solve the rectangular assignment problem for @cost (rows x cols, row major), minimizing total cost with each row
+/// and column used at most once. Sets @row_to_col to the column assigned to each row, -1 if none.
+void solve_assignment(std::vector<double> const& cost, size_t rows, size_t cols, std::vector<int>& row_to_col);
+
+}  // namespace pcodar
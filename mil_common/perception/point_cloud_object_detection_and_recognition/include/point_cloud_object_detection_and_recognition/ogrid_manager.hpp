@@ -2,7 +2,9 @@
 
 #include "object_map.hpp"
 #include "pcodar_types.hpp"
+#include "region.hpp"
 
+#include <map_msgs/OccupancyGridUpdate.h>
 #include <mil_msgs/PerceptionObject.h>
 #include <mil_msgs/PerceptionObjectArray.h>
 #include <nav_msgs/OccupancyGrid.h>
@@ -10,33 +12,102 @@
 
 #include <ros/ros.h>
 
+#include <mil_ogrid/grid_geometry.hpp>
+#include <mil_ogrid/raster.hpp>
+
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include <opencv2/highgui/highgui.hpp>
 
+#include <unordered_map>
+
 namespace pcodar
 {
+/**
+ * Rasterizes objects into an occupancy grid, published on /ogrid.
+ *
+ * In incremental mode, the grid is not cleared each update. Instead, only the regions covered by objects which were
+ * added, removed, or had their points changed since the last update are cleared and redrawn. These regions are also
+ * published as map_msgs/OccupancyGridUpdate messages on /ogrid_updates for subscribers which only want changes.
+ * The full grid on /ogrid can then be throttled to a keyframe period, so subscribers using the updates can still
+ * synchronize after joining late or missing an update.
+ */
 class OgridManager
 {
 public:
   OgridManager();
   void initialize(ros::NodeHandle& nh);
-  void update_ogrid(ObjectMap const& objects);
+  /// Redraw the grid from objects, which are as of the sensor data stamped origin
+  void update_ogrid(ObjectMap const& objects, ros::Time const& origin = ros::Time());
   void draw_boundary();
+
+  /// Everything about the grid a config sets, built by prepare_config without touching the grid, so the allocation
+  /// is done outside of the object map's lock, then swapped in by apply_config
+  struct Layout
+  {
+    double resolution_meters_per_cell;
+    uint32_t width_meters;
+    uint32_t height_meters;
+    uint32_t inflation_cells;
+    bool incremental;
+    mil_ogrid::GridGeometry geometry;
+    mil_ogrid::DiskStamp inflation;
+    /// Cells of the grid, already allocated. After apply_config, the old cells, to be freed by the caller.
+    std::vector<int8_t> data;
+  };
+  static Layout prepare_config(Config const& config);
+  /// Switch to @layout, redrawing the grid on the next update
+  void apply_config(Layout& layout);
+  /// Both of the above at once
   void update_config(Config const& config);
   void set_bounds(point_cloud_ptr pc);
+  /// Copy the cells of the grid in @region's bounding box into @out, with those outside the region unknown. Returns
+  /// false if the region does not overlap the grid.
+  bool crop(Region const& region, nav_msgs::OccupancyGrid& out) const;
 
 private:
+  /// Region of the grid an object was last drawn in, and which version of the object was drawn
+  struct DrawnObject
+  {
+    uint64_t version;
+    cv::Rect rect;
+  };
+
   cv::Point point_in_ogrid(point_t point);
+  /// Region of the grid which drawing @object would change
+  cv::Rect object_rect(Object const& object);
+  /// Draw @object into the grid, only changing cells within @clip
+  void draw_object(Object const& object, cv::Rect const& clip);
+  /// Clear and redraw the entire grid
+  void redraw_all(ObjectMap const& objects);
+  /// Publish the cells within @rect to /ogrid_updates
+  void publish_update(cv::Rect const& rect);
+
   double resolution_meters_per_cell_;
   uint32_t width_meters_;
   uint32_t height_meters_;
   uint32_t inflation_cells_;
+  bool incremental_;
+  /// Set when the grid must be fully redrawn on the next update, such as after it is resized
+  bool needs_redraw_;
+  /// In incremental mode, minimum time between publishing the full grid on /ogrid. Zero publishes it every update.
+  ros::Duration keyframe_period_;
+  ros::Time last_keyframe_;
   ros::Publisher pub_ogrid_;
+  ros::Publisher pub_ogrid_updates_;
   cv::Mat ogrid_mat_;
+  mil_ogrid::GridGeometry geometry_;
+  /// Filled disk with radius inflation_cells_, stamped around each object point
+  mil_ogrid::DiskStamp inflation_;
   nav_msgs::OccupancyGrid ogrid_;
   point_cloud_ptr bounds_;
+  /// Where each object was drawn during the last update
+  std::unordered_map<uint, DrawnObject> drawn_;
+  /// Reused buffer of regions changed during an update
+  std::vector<cv::Rect> dirty_;
+  /// Reused buffer for the points of compact objects being drawn
+  point_cloud decoded_;
 };
 
 }  // namespace pcodar
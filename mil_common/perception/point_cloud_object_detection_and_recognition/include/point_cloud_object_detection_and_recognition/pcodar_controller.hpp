@@ -1,31 +1,59 @@
 #pragma once
 
+#include "change_detector.hpp"
+#include "config_snapshots.hpp"
 #include "input_cloud_filter.hpp"
 #include "marker_manager.hpp"
 #include "object_associator.hpp"
+#include "object_delta.hpp"
 #include "object_detector.hpp"
 #include "object_map.hpp"
+#include "object_map_snapshot.hpp"
 #include "ogrid_manager.hpp"
 #include "pcodar_types.hpp"
-#include "persistent_cloud_filter.hpp"
-#include "point_cloud_builder.hpp"
+#include "pipeline.hpp"
+#include "range_image_filter.hpp"
+#include "region.hpp"
+#include "scan_deskewer.hpp"
+#include "stage_timers.hpp"
+#include "voxel_map.hpp"
 
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <dynamic_reconfigure/client.h>
 #include <mil_bounds/BoundsConfig.h>
 #include <mil_msgs/ObjectDBQuery.h>
+#include <mil_msgs/RegionQuery.h>
+#include <mil_msgs/RegionSubscribe.h>
+#include <message_filters/subscriber.h>
+#include <mil_tools/concurrency.hpp>
+#include <mil_tools/debug_publisher.hpp>
+#include <mil_tools/memory_budget.hpp>
+#include <mil_tools/trace.hpp>
+#include <mil_tools/transform_cache.hpp>
 #include <nav_msgs/Odometry.h>
+#include <ros/callback_queue_interface.h>
 #include <ros/ros.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <std_srvs/Trigger.h>
 #include <tf2/convert.h>
 #include <tf2_eigen/tf2_eigen.h>
 #include <tf2_msgs/TFMessage.h>
+#include <tf2_ros/message_filter.h>
 #include <tf2_ros/transform_listener.h>
 
 #include <dynamic_reconfigure/server.h>
 
 #include <boost/circular_buffer.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace pcodar
 {
 /**
@@ -36,46 +64,138 @@ namespace pcodar
 class NodeBase
 {
 public:
-  /// Create a NodeBase in the namespace of nh
-  NodeBase(ros::NodeHandle nh);
+  /// Create a NodeBase in the namespace of nh. Services and periodic diagnostics / snapshots are served from
+  /// bulk_queue if given, so a slow query or save never holds up processing on nh's queue.
+  NodeBase(ros::NodeHandle nh, ros::CallbackQueueInterface* bulk_queue = nullptr);
   /// Initialize ROS communication
   virtual void initialize();
   /// Update markers, ogrid, and publish the internal object map to ROS interfaces. Call after updating objects.
   void UpdateObjects();
+  /// Stamp of the sensor data the objects were last updated from, which the ogrid carries on as its map_load_time
+  void set_origin(ros::Time const& origin);
+  /// Insert a transform directly into the TF buffer, used when replaying recorded data without ROS
+  void add_transform(geometry_msgs::TransformStamped const& transform, bool is_static);
+  /// Latency of each processing stage
+  StageTimers const& get_stage_timers() const;
 
 protected:
   /// Process a database query ROS service
   bool DBQuery_cb(mil_msgs::ObjectDBQuery::Request& req, mil_msgs::ObjectDBQuery::Response& res);
+  /// Objects and ogrid cells in a region, and subscriptions to them
+  bool region_query_cb(mil_msgs::RegionQuery::Request& req, mil_msgs::RegionQuery::Response& res);
+  bool region_subscribe_cb(mil_msgs::RegionSubscribe::Request& req, mil_msgs::RegionSubscribe::Response& res);
+  /// Transform @msg into the global frame, with its latest transform, as regions often follow the boat
+  bool resolve_region(mil_msgs::Region const& msg, Region& region, std::string& error);
+  /// Fill @ogrid and @objects with what is in @region, returning false if it is outside the ogrid. Call with
+  /// objects_->mutex_ locked.
+  bool query_region(Region const& region, std::string const& name, nav_msgs::OccupancyGrid& ogrid,
+                    std::vector<mil_msgs::PerceptionObject>& objects);
+  /// Publish each region subscription with subscribers, from UpdateObjects
+  void publish_regions();
   /// Reset PCODAR
   virtual bool Reset(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res);
-  /// Transform
+  /// Save / load the object map to / from snapshot_path_
+  bool save_snapshot_cb(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res);
+  bool load_snapshot_cb(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res);
+  bool save_snapshot(std::string& error);
+  bool load_snapshot(std::string& error);
+  /// Periodically save a snapshot
+  void snapshot_timer_cb(ros::TimerEvent const&);
+  /// Transform from @frame to the global frame at @time, waiting up to @timeout for it. By default only transforms
+  /// already in the buffer are used, so ROS callbacks are never blocked on TF.
   bool transform_to_global(std::string const& frame, ros::Time const& time, Eigen::Affine3d& out,
-                           ros::Duration timeout = ros::Duration(1, 0));
-  /// Transform a pointcloud ROS message into a PCL pointcloud in the global frame
-  bool transform_point_cloud(const sensor_msgs::PointCloud2& pcloud2, point_cloud& out);
-  virtual bool bounds_update_cb(const mil_bounds::BoundsConfig& config);
+                           ros::Duration timeout = ros::Duration(0));
+  /// Transform a pointcloud ROS message into a PCL pointcloud in the global frame, reading points directly from the
+  /// message buffer. If @filter is set, only points accepted by it are stored in @out. @out's storage is reused.
+  bool transform_point_cloud(const sensor_msgs::PointCloud2& pcloud2, point_cloud& out,
+                             InputCloudFilter const* filter = nullptr);
+  /// Same as above with a known transform to the global frame. If @mask is set, only points (in row major order)
+  /// with a non zero entry in it are read. If @deskew is set, @transform is the one at the start of the sweep and
+  /// each point is moved by the motion of the sensor until it was measured.
+  void transform_point_cloud(const sensor_msgs::PointCloud2& pcloud2, Eigen::Affine3d const& transform,
+                             point_cloud& out, InputCloudFilter const* filter = nullptr,
+                             std::vector<uint8_t> const* mask = nullptr, ScanDeskewer const* deskew = nullptr);
+  /// Apply new bounds, or if their frame can not be transformed into the global frame yet, retry until it can
+  bool bounds_update_cb(const mil_bounds::BoundsConfig& config);
+  void bounds_timer_cb(ros::TimerEvent const&);
+  /// Transform @config into the global frame and use it as the bounds, returning false if the transform is not
+  /// available yet
+  virtual bool apply_bounds(const mil_bounds::BoundsConfig& config);
   virtual void ConfigCallback(Config const& config, uint32_t level);
+  /// Publish stage latencies on /diagnostics
+  void publish_diagnostics(ros::TimerEvent const&);
+  /// Add statuses to the periodic diagnostics message, after the stage latencies
+  virtual void add_diagnostics(diagnostic_msgs::DiagnosticArray& msg);
 
 public:
   std::shared_ptr<ObjectMap> objects_;
 
 protected:
   ros::NodeHandle nh_;
+  /// nh_ with the bulk queue, for requests and periodic work which may run alongside processing. Its callbacks may
+  /// run concurrently with each other and with those of nh_, so only touch state behind the mutexes below.
+  ros::NodeHandle bulk_nh_;
   dynamic_reconfigure::Client<mil_bounds::BoundsConfig> bounds_client_;
   dynamic_reconfigure::Server<Config> config_server_;
 
   ros::ServiceServer modify_classification_service_;
   ros::ServiceServer reset_service_;
+  ros::ServiceServer save_snapshot_service_;
+  ros::ServiceServer load_snapshot_service_;
+  /// Where object map snapshots are saved and loaded from
+  std::string snapshot_path_;
+  ros::Timer snapshot_timer_;
+  /// Reused buffer a snapshot is serialized into while the object map is locked
+  std::vector<uint8_t> snapshot_buffer_;
+  std::mutex snapshot_mutex_;
 
   std::string global_frame_;
 
   tf2_ros::Buffer tf_buffer_;
   tf2_ros::TransformListener tf_listener;
+  /// Lookups from sensor frames, which keep each sensor's mounting on base_link rather than looking it up every scan
+  mil_tools::TransformCache tf_cache_;
+
+  /// Published the objects and ogrid cells in its region after every update, see RegionSubscribe.srv
+  struct RegionSubscription
+  {
+    mil_msgs::Region region;
+    std::string name;
+    ros::Publisher pub_ogrid;
+    ros::Publisher pub_objects;
+  };
+  ros::ServiceServer region_query_service_;
+  ros::ServiceServer region_subscribe_service_;
+  /// Subscriptions by topic, guarded by regions_mutex_, which is locked before objects_->mutex_ if both are
+  std::map<std::string, RegionSubscription> region_subscriptions_;
+  std::mutex regions_mutex_;
+  /// Reused buffer of the ids of the objects in a region, guarded by objects_->mutex_
+  std::vector<uint> region_ids_;
 
   // Publishers
   ros::Publisher pub_objects_;
+  /// Publishes only changes to objects, with periodic keyframes
+  ros::Publisher pub_objects_delta_;
+  ObjectDeltaEncoder delta_encoder_;
+  /// Time between keyframes (full object lists) on pub_objects_delta_
+  ros::Duration delta_keyframe_period_;
+  ros::Time last_delta_keyframe_;
+  /// Publishes stage_timers_ periodically
+  ros::Publisher pub_diagnostics_;
+  ros::Timer diagnostics_timer_;
+  /// Memory held by the object map and accumulated clouds, published with the diagnostics
+  mil_tools::MemoryBudget memory_;
 
+  StageTimers stage_timers_;
+  /// See set_origin, in ns, as it is set on the worker thread and read on the publisher's
+  std::atomic<int64_t> origin_{ 0 };
+
+  /// Bounds in the global frame. Replaced whole, never changed in place, with atomic_store, so the threads filtering
+  /// scans take the latest with atomic_load.
   point_cloud_ptr bounds_;
+  /// Bounds waiting for their transform, retried by bounds_timer_
+  mil_bounds::BoundsConfig pending_bounds_;
+  ros::Timer bounds_timer_;
 
   // Visualization
   MarkerManager marker_manager_;
@@ -85,30 +205,140 @@ protected:
 class Node : public NodeBase
 {
 public:
-  Node(ros::NodeHandle nh);
+  Node(ros::NodeHandle nh, ros::CallbackQueueInterface* bulk_queue = nullptr);
+  ~Node();
 
+  /// Process a scan from the first input source
   void velodyne_cb(const sensor_msgs::PointCloud2ConstPtr& pcloud);
+  /// Process a scan from input source @index
+  void source_cb(const sensor_msgs::PointCloud2ConstPtr& pcloud, size_t index);
 
   void initialize() override;
 
 private:
-  bool bounds_update_cb(const mil_bounds::BoundsConfig& config) override;
+  /// Publishes the config for the stages, which apply it between scans
   void ConfigCallback(Config const& config, uint32_t level) override;
+  /// Apply a newer config to the stages used by ingest, on the callback thread, or by process, on the worker thread
+  void apply_ingest_config();
+  void apply_process_config();
   /// Reset PCODAR
   bool Reset(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res) override;
 
+  void add_diagnostics(diagnostic_msgs::DiagnosticArray& msg) override;
+
+  /// A lidar publishing scans to be merged into the object map
+  struct Source
+  {
+    std::string topic;
+    /// Holds scans until their transform into the global frame is in the TF buffer, so it is never waited on
+    message_filters::Subscriber<sensor_msgs::PointCloud2> subscriber;
+    std::unique_ptr<tf2_ros::MessageFilter<sensor_msgs::PointCloud2>> tf_filter;
+    /// Transform from base_link to the scans' frame, looked up once as lidars are rigidly mounted. Only used on the
+    /// callback thread.
+    std::string sensor_frame;
+    Eigen::Affine3d sensor_from_base;
+    /// Removes points outside bounds and inside this source's view of the robot. Only used on the callback thread.
+    InputCloudFilter filter;
+    /// The bounds_ last given to filter
+    point_cloud_ptr bounds;
+    /// Scans received, dropped because the worker was busy, and frames processed without a scan from this source
+    std::atomic<uint64_t> received{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint64_t> missed{ 0 };
+    /// Scans dropped by tf_filter, as their transform did not arrive before its queue filled
+    std::atomic<uint64_t> no_transform{ 0 };
+    /// Time from a scan's stamp until it is transformed into the global frame
+    LatencyWindow latency;
+  };
+  /// Add an input source from an element of the input_sources param
+  void add_source(XmlRpc::XmlRpcValue& param);
+
+  /// A scan transformed into the global frame, with points outside bounds / inside the robot removed
+  struct Scan
+  {
+    point_cloud_ptr cloud;
+    /// Stamp of the message the scan came from
+    ros::Time stamp;
+    /// Position of the lidar in the global frame when the scan was taken
+    Eigen::Vector3f sensor;
+    /// If set, this is the last scan of a frame, so the object map should be updated after it is accumulated
+    bool complete;
+  };
+  /// Recycled through scan_pool_, so a scan's cloud keeps its storage
+  using ScanPtr = mil_tools::ObjectPool<Scan>::Ptr;
+  /// Cache the transform from base_link to @frame in @source if it is not already, without waiting for it
+  bool lookup_mounting(std::string const& frame, Source& source);
+  /// Transform a pointcloud message into the global frame, filtering it with the source's filter
+  bool ingest(const sensor_msgs::PointCloud2& pcloud, Source& source, Scan& scan);
+  /// Record that @source contributed a scan to the current frame, returning true if that ends the frame
+  bool close_frame(size_t source);
+  /// Filter, accumulate, cluster, and associate a transformed scan into the object map
+  void process(Scan const& scan);
+  /// Ends the frame in the change detector. If nothing changed in it, refreshes the objects instead of clustering and
+  /// returns false.
+  bool detect_changes();
+  /// In pipelined mode, runs process on scans handed off by source_cb
+  void worker_loop();
+  /// In pipelined mode, runs UpdateObjects after the worker has processed a scan
+  void publish_loop();
+
 private:
-  ros::Publisher pub_pcl_;
+  /// The filtered persistent cloud, or the clustered voxels, only sent while someone listens
+  mil_tools::DebugPublisher<> pub_pcl_;
 
-  // Subscriber
-  ros::Subscriber pc_sub;
+  /// Lidars to merge scans from
+  std::vector<std::unique_ptr<Source>> sources_;
+  /// Scans each source holds while waiting for their transform
+  int transform_queue_size_;
+  /// Which sources have contributed a scan to the frame being accumulated. Only used on the callback thread.
+  std::vector<bool> frame_sources_;
+  /// Set if a scan ending a frame was dropped in pipelined mode, so the next scan handed off ends it instead
+  bool complete_pending_;
 
   // Model (It eventually will be obeject tracker, but for now just detections)
-  InputCloudFilter input_cloud_filter_;
-  PersistentCloudFilter persistent_cloud_filter_;
-  PointCloudCircularBuffer persistent_cloud_builder_;
-  ObjectDetector detector_;
-  Associator ass;
+  /// Only used on the subscriber callback thread, along with the mask it produces
+  RangeImageFilter range_image_filter_;
+  std::vector<uint8_t> range_image_keep_;
+  /// Only used on the subscriber callback thread
+  ScanDeskewer deskewer_;
+  /// Accumulates, filters, clusters and associates scans. Its associator is also used with the voxel map.
+  CloudPipeline pipeline_;
+  /// Used instead of pipeline_'s accumulate, filter, and detect stages when use_voxel_map_ is set
+  VoxelMap voxel_map_;
+  bool use_voxel_map_;
+  /// Skips clustering and association of frames in which nothing changed
+  ChangeDetector change_detector_;
+  /// Scan reused between callbacks when not pipelined
+  Scan scan_;
+
+  /// If true, process and publish scans on separate threads from the subscriber callback
+  bool pipelined_;
+  /// Guards the processing stages above, which are used by the worker thread but reset and trimmed from others
+  std::mutex stages_mutex_;
+  /// Configs for the stages, and the ones ingest and process last applied
+  ConfigSnapshots config_snapshots_;
+  ConfigSnapshots::Reader ingest_config_;
+  ConfigSnapshots::Reader process_config_;
+  /// Scans for the pipeline, two more than the queue holds: one being filled by the callback and one being processed by
+  /// the worker, so it never runs out
+  std::unique_ptr<mil_tools::ObjectPool<Scan>> scan_pool_;
+  /// Transformed scans waiting for the worker thread
+  std::unique_ptr<mil_tools::SpscQueue<ScanPtr>> scan_queue_;
+  std::thread worker_thread_;
+  std::thread publish_thread_;
+  std::atomic<bool> running_;
+  /// Set by the worker when objects have changed and should be published
+  std::atomic<bool> update_pending_;
+  /// Used only to sleep the worker / publisher threads until there is work
+  std::mutex wake_mutex_;
+  std::condition_variable worker_wake_;
+  std::condition_variable publish_wake_;
+  /// Scans received, scans dropped because the worker was busy, object updates merged because the publisher was
+  /// busy, and frames not clustered because nothing changed in them
+  std::atomic<uint64_t> received_scans_;
+  std::atomic<uint64_t> dropped_scans_;
+  std::atomic<uint64_t> coalesced_updates_;
+  std::atomic<uint64_t> unchanged_frames_;
 };
 
 }  // namespace pcodar
@@ -23,6 +23,45 @@ using point_cloud = pcl::PointCloud<point_t>;
 using point_cloud_ptr = point_cloud::Ptr;
 /// Constant poitner to PCODAR's pointclouds
 using point_cloud_const_ptr = point_cloud::ConstPtr;
+/// Pointer to @cloud which does not own it, for PCL interfaces taking shared pointers, without allocating or counting
+/// references. Only valid as long as @cloud is.
+inline point_cloud_const_ptr borrow_cloud(point_cloud const& cloud)
+{
+  return point_cloud_const_ptr(point_cloud_const_ptr(), &cloud);
+}
+/// The points [begin, begin + size) of @cloud, so a stage can be handed part of a buffer without copying it out. Only
+/// valid as long as @cloud is and its points are not moved.
+struct CloudView
+{
+  point_cloud const* cloud = nullptr;
+  size_t begin = 0;
+  size_t size = 0;
+  /// Whether every point of the range is finite
+  bool is_dense = true;
+
+  CloudView() = default;
+  /// All of @cloud
+  CloudView(point_cloud const& cloud) : cloud(&cloud), size(cloud.size()), is_dense(cloud.is_dense)
+  {
+  }
+  CloudView(point_cloud const& cloud, size_t begin, size_t size, bool is_dense)
+    : cloud(&cloud), begin(begin), size(size), is_dense(is_dense)
+  {
+  }
+
+  bool empty() const
+  {
+    return size == 0;
+  }
+  point_t const* points() const
+  {
+    return size ? cloud->points.data() + begin : nullptr;
+  }
+  point_t const& operator[](size_t i) const
+  {
+    return cloud->points[begin + i];
+  }
+};
 using KdTree = pcl::search::KdTree<point_t>;
 using KdTreePtr = KdTree::Ptr;
 
@@ -31,4 +70,23 @@ using cluster_t = pcl::PointIndices;
 /// Vector of clusters
 using clusters_t = std::vector<cluster_t>;
 
+/// Shape of the volume a cluster occupies, for classifying it by size without going back over its points
+struct ClusterFeatures
+{
+  /// Corners of the axis aligned bounding box around the cluster's points
+  point_t min;
+  point_t max;
+  /// Mean of the cluster's points
+  point_t centroid;
+  uint32_t points;
+  /// Number of vertical grid columns containing the cluster's points, and the area in m^2 they cover from above
+  uint32_t columns;
+  float footprint_area;
+  /// Mean over those columns of the height from their lowest to their highest point, which is small for flat or
+  /// sparse objects and close to the bounding box height for solid ones
+  float mean_column_height;
+};
+/// Features of each cluster in a clusters_t, in the same order
+using cluster_features_t = std::vector<ClusterFeatures>;
+
 }  // namespace pcodar
@@ -7,15 +7,59 @@
 
 namespace pcodar
 {
+/**
+ * Removes points of the accumulated cloud with fewer than min_neighbors other points within radius of them.
+ *
+ * The voxel backend hashes points into cubes with the radius as their edge, so each point's neighbors are all in the
+ * 27 cubes around its own. Cubes are sorted by key so the 3 of each column along z hold a contiguous range of points.
+ * Every point of a cube whose neighborhood holds too few points is removed without looking at it, and the rest are
+ * counted exactly, stopping as soon as there are enough. It keeps the same points as pcl::RadiusOutlierRemoval,
+ * which does a kd-tree radius search per point, in time linear in the points and n log n in the occupied cubes.
+ */
 class PersistentCloudFilter
 {
 public:
+  /// How outliers are found, matching the persistant_cloud_filter_backend enum in PCODAR.cfg
+  enum Backend
+  {
+    BACKEND_PCL,
+    BACKEND_VOXEL
+  };
+
   PersistentCloudFilter();
+  /// Filters @in with the configured backend, storing the points kept into @pc
   void filter(point_cloud_const_ptr in, point_cloud& pc);
+  void filter(CloudView const& in, point_cloud& pc);
+  /// Filters @in with pcl::RadiusOutlierRemoval. Kept as a reference for benchmarking.
+  void filter_pcl(point_cloud_const_ptr in, point_cloud& pc);
+  void filter_pcl(CloudView const& in, point_cloud& pc);
+  /// Filters @in with the voxel hash, in parallel over its cells
+  void filter_voxel(CloudView const& in, point_cloud& pc);
   void update_config(Config const& config);
+  /// Set the parameters without a Config, for benchmarking
+  void set_params(Backend backend, double radius, int min_neighbors);
 
 private:
   pcl::RadiusOutlierRemoval<point_t> outlier_filter_;
+  /// Indices of the range of its input cloud outlier_filter_ filters
+  pcl::IndicesPtr range_indices_;
+  Backend backend_;
+  double radius_;
+  int min_neighbors_;
+
+  /// Sorted keys of the occupied cells, and the cell of each point
+  std::vector<uint64_t> cell_keys_;
+  std::vector<uint32_t> point_cells_;
+  /// Cells in key order, and each cell's position in it, while renumbering cells
+  std::vector<uint32_t> cell_order_;
+  std::vector<uint32_t> cell_ranks_;
+  /// Points sorted by cell, and the range of cell i in it is [cell_starts_[i], cell_starts_[i + 1])
+  std::vector<uint32_t> sorted_points_;
+  std::vector<uint32_t> cell_starts_;
+  /// Coordinates of sorted_points_, contiguous so each neighborhood is scanned linearly
+  std::vector<Eigen::Vector3f> sorted_xyz_;
+  /// Non zero for the points of the input to keep
+  std::vector<uint8_t> keep_;
 };
 
 }  // namespace pcodar
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "object_associator.hpp"
+#include "object_detector.hpp"
+#include "object_map.hpp"
+#include "pcodar_types.hpp"
+#include "persistent_cloud_filter.hpp"
+#include "point_cloud_builder.hpp"
+#include "stage_timers.hpp"
+
+namespace pcodar
+{
+/**
+ * The stages turning scans in the global frame into objects, composed at compile time from policy types, so a variant
+ * (another clusterer, a filter for another lidar, a GPU stage) is a new type rather than a runtime switch. Stages are
+ * called directly, not through virtual functions, and hand off through references to buffers the pipeline keeps and
+ * reuses, so a frame allocates nothing once the buffers have grown to its size.
+ *
+ * Each frame, add is called with every scan of the frame, then detect and associate once it is complete. The stages
+ * must provide, along with update_config(Config const&):
+ *
+ *   Accumulate: void add(point_cloud const& scan)
+ *               CloudView cloud() const, the accumulated scans, valid until the next add
+ *               void clear()
+ *   Filter:     void filter(CloudView const& in, point_cloud& out)
+ *   Detect:     void detect(point_cloud const& pc, clusters_t& clusters)
+ *               cluster_features_t const& get_features() const, of the last clusters, or empty
+ *   Associate:  void associate(ObjectMap& objects, point_cloud const& pc, clusters_t const& clusters, double stamp,
+ *                              cluster_features_t const* features)
+ *
+ * The stages are configured at the dynamic reconfigure levels Node has always used for them: 1 for accumulate, 2 for
+ * filter, 4 for detect and 8 for associate.
+ */
+template <typename Accumulate = PointCloudCircularBuffer, typename Filter = PersistentCloudFilter,
+          typename Detect = ObjectDetector, typename Associate = Associator>
+class Pipeline
+{
+public:
+  /// Update the stages whose bits are set in @level, or all of them if it is 0
+  void update_config(Config const& config, uint32_t level)
+  {
+    if (!level || level & 1)
+      accumulate_.update_config(config);
+    if (!level || level & 2)
+      filter_.update_config(config);
+    if (!level || level & 4)
+      detect_.update_config(config);
+    if (!level || level & 8)
+      associate_.update_config(config);
+  }
+
+  /// Accumulate a scan of the frame
+  void add(point_cloud const& scan, StageTimers& timers)
+  {
+    StageTimers::Scope timer(timers, StageTimers::ACCUMULATION);
+    accumulate_.add(scan);
+  }
+
+  /// Filter the accumulated scans and cluster what is left, returning the filtered cloud the clusters index into. It
+  /// is only valid until the next call.
+  point_cloud& detect(StageTimers& timers)
+  {
+    {
+      StageTimers::Scope timer(timers, StageTimers::OUTLIER_FILTER);
+      filter_.filter(accumulate_.cloud(), filtered_);
+    }
+    StageTimers::Scope timer(timers, StageTimers::CLUSTERING);
+    detect_.detect(filtered_, clusters_);
+    return filtered_;
+  }
+
+  /// Associate the clusters found by the last detect with @objects, observed at @stamp (seconds)
+  void associate(ObjectMap& objects, double stamp, StageTimers& timers)
+  {
+    StageTimers::Scope timer(timers, StageTimers::ASSOCIATION);
+    associate_.associate(objects, filtered_, clusters_, stamp, &detect_.get_features());
+  }
+
+  /// Forget the accumulated scans
+  void clear()
+  {
+    accumulate_.clear();
+  }
+
+  Accumulate& accumulator()
+  {
+    return accumulate_;
+  }
+  Detect& detector()
+  {
+    return detect_;
+  }
+  Associate& associator()
+  {
+    return associate_;
+  }
+
+private:
+  Accumulate accumulate_;
+  Filter filter_;
+  Detect detect_;
+  Associate associate_;
+  /// Output of filter_, and the clusters detect_ found in it
+  point_cloud filtered_;
+  clusters_t clusters_;
+};
+
+/// The stages PCODAR runs on lidar scans
+using CloudPipeline = Pipeline<>;
+
+}  // namespace pcodar
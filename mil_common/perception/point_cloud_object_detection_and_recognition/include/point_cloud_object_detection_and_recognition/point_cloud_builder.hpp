@@ -13,26 +13,62 @@ namespace pcodar
 /**
  * Buffer of n most recently added pointclouds, used to assemble a persistent pointcloud of pointclouds accumulated over
  * time.
+ *
+ * The accumulated cloud is maintained incrementally: points are stored in one buffer ordered from oldest to newest
+ * scan, and the accumulated cloud is the live range of it from head_ to its end. Adding a cloud evicts the oldest slice
+ * by moving head_ past it and appends the new points to the back, so neither copies the buffered history. The dead
+ * points before head_ are only dropped, by moving the live range to the front, when the back reaches the buffer's
+ * capacity, which is kept at least twice the live range so that happens a bounded number of times per point.
  */
 class PointCloudCircularBuffer
 {
 public:
   PointCloudCircularBuffer();
-  /// Get accumulated pointcloud from buffered pointclouds, or nullptr if N pointclouds have not yet been added
-  point_cloud_ptr get_point_cloud();
+  /// Copy of the accumulated pointcloud, or an empty cloud if N pointclouds have not yet been added
+  point_cloud_const_ptr get_point_cloud() const;
+  /// The accumulated pointcloud as a view of the internal buffer, or an empty view if N pointclouds have not yet been
+  /// added. Only valid until the next call to add_point_cloud.
+  CloudView cloud() const;
   /// Add a pointcloud to the back of the buffer, deleting the oldest if it is full.
   void add_point_cloud(const point_cloud_ptr& pc);
+  /// Same as add_point_cloud, copying from a reference
+  void add(point_cloud const& pc);
   /// Update the number of pointclouds from the dynamic reconfigure object
   void update_config(Config const& config);
   /// Clear buffer
   void clear();
+  /// Bytes held by the accumulated cloud, including storage kept for reuse
+  size_t memory_usage() const;
+  /// Accumulate fewer clouds, but at least one, until the accumulated points take at most @max_bytes, then free
+  /// storage beyond that. Lasts until the next update_config.
+  void trim(size_t max_bytes);
 
 private:
-  /// Accumulated pointcloud kept up to date with each call to add_point_cloud
+  /// Points and whether all of them are finite, of one buffered pointcloud
+  struct Slice
+  {
+    size_t size;
+    bool is_dense;
+  };
+
+  /// Drop the points of the oldest buffered pointcloud from the front of the live range
+  void evict_oldest();
+  /// Move the live range to the front of the buffer, dropping the evicted points before it
+  void compact();
+  size_t live_size() const
+  {
+    return mega_cloud_->points.size() - head_;
+  }
+
+  /// Buffer the accumulated points are the live range of, kept up to date with each call to add_point_cloud
   point_cloud_ptr mega_cloud_;
-  /// Internal buffer of pointclouds
-  /// @TODO consider more efficent implementation, like storing indicies of older pointclouds so
-  ///       the accumulated cloud is not reassembled on each addition
-  boost::circular_buffer<point_cloud_ptr> prev_clouds_;
+  /// Index of the first point of the oldest buffered pointcloud in mega_cloud_
+  size_t head_ = 0;
+  /// Returned by cloud until the buffer is full
+  point_cloud empty_cloud_;
+  /// Each buffered pointcloud's slice of the live range, oldest first
+  boost::circular_buffer<Slice> slices_;
+  /// Buffered pointclouds which are not dense, so the live range is dense if there are none
+  size_t sparse_slices_ = 0;
 };
 }  // pcodar namespace
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "pcodar_types.hpp"
+
+#include <sensor_msgs/PointCloud2.h>
+#include <Eigen/Geometry>
+
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * Removes water surface returns and spray from a raw lidar scan before it is transformed, using the scan's own
+ * structure as a range image (ring by azimuth) so no search tree is needed.
+ *
+ * Each column is walked from the lowest ring (ring 0, as published by velodyne_pointcloud) upward. A return is
+ * surface if it is below a height in the global frame and the slope from the previous surface return in the column
+ * is shallow. A return is speckle if too few of the neighboring cells in the image have a similar range.
+ */
+class RangeImageFilter
+{
+public:
+  RangeImageFilter();
+  /// Update the dynamic reconfigure parameters associated with this class
+  void update_config(Config const& config);
+  /// If false, @filter should not be called
+  bool enabled() const;
+  /// Sets @keep to whether each point of @msg (in row major order) should be kept, given the transform from the
+  /// message's frame to the global frame. Returns false if the message has no ring structure to filter with.
+  bool filter(sensor_msgs::PointCloud2 const& msg, Eigen::Affine3d const& transform, std::vector<uint8_t>& keep);
+
+private:
+  bool enabled_;
+  size_t columns_;
+  /// Surface returns are below this height in the global frame
+  float surface_max_z_;
+  /// Tangent of the steepest slope between surface returns
+  float surface_max_slope_;
+  /// Neighbors within this range of a return support it
+  float speckle_tolerance_;
+  /// Returns supported by fewer neighbors are removed, 0 to disable
+  int speckle_min_neighbors_;
+
+  /// Point in each cell of the image, -1 if empty. If several points fall in a cell, the last one is used.
+  std::vector<int> image_;
+  /// Cell of each point, -1 if invalid
+  std::vector<int> point_cells_;
+  /// Number of points in each cell
+  std::vector<uint16_t> counts_;
+  /// Range of the point in each cell
+  std::vector<float> ranges_;
+  /// Points in each cell, rotated into the global frame orientation but relative to the sensor
+  std::vector<Eigen::Vector3f> rotated_;
+  /// Whether each cell is kept
+  std::vector<uint8_t> keep_cells_;
+};
+
+}  // namespace pcodar
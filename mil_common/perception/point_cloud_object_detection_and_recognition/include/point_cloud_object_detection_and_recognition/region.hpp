@@ -0,0 +1,47 @@
+#pragma once
+
+#include "pcodar_types.hpp"
+
+#include <mil_msgs/Region.h>
+
+#include <Eigen/Geometry>
+
+#include <string>
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * A region of interest on the x / y plane of the global frame, a disk or a convex polygon, for consumers which only
+ * need the objects and ogrid cells around the boat or a target. See mil_msgs/Region.msg.
+ */
+class Region
+{
+public:
+  Region();
+  /// Set from a message, with @transform from its frame into the global frame. Returns false, with @error set, if the
+  /// message has neither a radius nor a polygon of at least 3 vertices, or the polygon is not convex.
+  bool from_msg(mil_msgs::Region const& msg, Eigen::Affine3d const& transform, std::string& error);
+  /// If the point (x, y) is in the region, ignoring z
+  bool contains(double x, double y) const;
+  /// Corners of the region's bounding box, with z unbounded
+  point_t const& min() const
+  {
+    return min_;
+  }
+  point_t const& max() const
+  {
+    return max_;
+  }
+
+private:
+  point_t center_;
+  /// If > 0, the region is the disk around center_, otherwise polygon_
+  double radius_;
+  /// Vertices in counterclockwise order
+  std::vector<point_t> polygon_;
+  point_t min_;
+  point_t max_;
+};
+
+}  // namespace pcodar
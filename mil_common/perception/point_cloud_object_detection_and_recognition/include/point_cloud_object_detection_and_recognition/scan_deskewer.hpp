@@ -0,0 +1,78 @@
+#pragma once
+
+#include "input_cloud_filter.hpp"
+#include "pcodar_types.hpp"
+
+#include <sensor_msgs/PointCloud2.h>
+#include <Eigen/Geometry>
+
+namespace pcodar
+{
+/**
+ * Removes the motion of the robot during a lidar sweep from a scan, so each point is placed where it was when it was
+ * measured rather than where it would be at the scan's stamp.
+ *
+ * Each point's time in the sweep comes from its time field (time in seconds or t in nanoseconds, relative to the
+ * stamp) or, if there is none, from its azimuth relative to the first point. The pose of the sensor is interpolated
+ * between the start and end of the sweep, with a second order expansion of the rotation so batches of points are
+ * corrected together.
+ */
+class ScanDeskewer
+{
+public:
+  using PointBatch = InputCloudFilter::PointBatch;
+  /// Fraction of the sweep elapsed for each row of a PointBatch
+  using BatchFractions = Eigen::Array<float, Eigen::Dynamic, 1>;
+
+  ScanDeskewer();
+  /// Update the dynamic reconfigure parameters associated with this class
+  void update_config(Config const& config);
+  /// If false, @prepare should not be called
+  bool enabled() const;
+  /// Find how each point's time is read from @msg, setting when its sweep begins and ends in seconds relative to its
+  /// stamp. Returns false if the sweep has no duration.
+  bool prepare(sensor_msgs::PointCloud2 const& msg, double& begin, double& end);
+  /// Set the transforms from the message's frame to the global frame at the beginning and end of the sweep
+  void set_motion(Eigen::Affine3d const& begin, Eigen::Affine3d const& end);
+  /// Fraction of the sweep elapsed when the point at @data, at @xyz in the message frame, was measured
+  float fraction(uint8_t const* data, float const* xyz) const;
+  /// Sets @out to how far each of @points moved, in the message frame at the start of the sweep, between then and
+  /// when it was measured. Adding them and then applying the begin transform places the points in the global frame.
+  void offsets(Eigen::Ref<const PointBatch> const& points, Eigen::Ref<const BatchFractions> const& fractions,
+               Eigen::Ref<PointBatch> out) const;
+
+private:
+  enum TimeType
+  {
+    TIME_AZIMUTH,
+    TIME_FLOAT32,
+    TIME_FLOAT64,
+    TIME_UINT32_NS
+  };
+
+  /// Read the time of the point at @data relative to the stamp
+  double read_time(uint8_t const* data) const;
+
+  bool enabled_;
+  /// If false, always use azimuth even if the points have times
+  bool use_point_time_;
+  /// Duration of a sweep ending at the stamp, when using azimuth
+  double sweep_duration_;
+  /// If true the sensor spins clockwise seen from above, so azimuth decreases during the sweep
+  bool clockwise_;
+
+  TimeType time_type_;
+  int time_offset_;
+  /// Times used for fractions of 0 and 1
+  double begin_;
+  double end_;
+  /// Azimuth of the first point, when using azimuth
+  float start_azimuth_;
+
+  /// Rotation vector and translation from the sensor pose at the start of the sweep to the pose at the end, in the
+  /// frame at the start
+  Eigen::Vector3f rotation_;
+  Eigen::Vector3f translation_;
+};
+
+}  // namespace pcodar
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "pcodar_types.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * Uniform 2D (x / y) grid of axis aligned bounding boxes, used to quickly find which objects may be near a region
+ * without checking every object. Each entry is stored in every cell its bounding box overlaps.
+ */
+class SpatialGrid
+{
+public:
+  SpatialGrid();
+  /// Set the edge length of each cell. Clears the grid if it changes.
+  void set_cell_size(double cell_size);
+  /// Insert an entry with the bounding box @min, @max, replacing any existing entry with the same id
+  void insert(uint id, point_t const& min, point_t const& max);
+  /// Remove an entry, if it exists
+  void remove(uint id);
+  /// Remove all entries
+  void clear();
+  /// Fill @ids with every entry whose cells overlap the bounding box @min, @max, sorted and without duplicates.
+  /// Entries are not guaranteed to actually overlap the box.
+  void query(point_t const& min, point_t const& max, std::vector<uint>& ids) const;
+
+private:
+  /// Range of cells (inclusive) an entry is stored in
+  struct Range
+  {
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+  };
+  Range range_for(point_t const& min, point_t const& max) const;
+  static int64_t cell_key(int x, int y);
+
+  double cell_size_;
+  /// Ids of the entries overlapping each non-empty cell
+  std::unordered_map<int64_t, std::vector<uint>> cells_;
+  /// Cells each entry is currently stored in
+  std::unordered_map<uint, Range> ranges_;
+};
+
+/// Squared distance between two axis aligned bounding boxes, 0 if they overlap
+float bounding_box_distance_squared(point_t const& a_min, point_t const& a_max, point_t const& b_min,
+                                    point_t const& b_max);
+
+}  // namespace pcodar
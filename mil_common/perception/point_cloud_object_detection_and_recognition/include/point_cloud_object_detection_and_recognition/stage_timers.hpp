@@ -0,0 +1,98 @@
+#pragma once
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+#include <boost/circular_buffer.hpp>
+
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace pcodar
+{
+/**
+ * Window of recent latency samples, summarized as min / mean / p99. Safe to record from multiple threads.
+ */
+class LatencyWindow
+{
+public:
+  struct Summary
+  {
+    size_t count;
+    double min_ms;
+    double mean_ms;
+    double p99_ms;
+  };
+
+  /// Create a window of the last @window samples
+  explicit LatencyWindow(size_t window = 1000);
+  /// Change the number of samples kept, dropping the oldest if needed
+  void set_window(size_t window);
+  /// Record a sample of @ms milliseconds
+  void record(double ms);
+  /// Summarize the recorded samples
+  Summary summarize() const;
+  /// Add the summary to a diagnostic status as "<prefix> min (ms)" and so on, if there are samples
+  void to_msg(std::string const& prefix, diagnostic_msgs::DiagnosticStatus& status) const;
+  /// Forget all samples
+  void clear();
+
+private:
+  mutable std::mutex mutex_;
+  boost::circular_buffer<double> samples_;
+};
+
+/**
+ * Records how long each stage of PCODAR takes over a window of recent scans, summarized as min / mean / p99.
+ * Safe to record from multiple threads, as stages run on different threads in pipelined mode.
+ */
+class StageTimers
+{
+public:
+  enum Stage
+  {
+    RANGE_IMAGE,
+    TRANSFORM,
+    ACCUMULATION,
+    OUTLIER_FILTER,
+    CLUSTERING,
+    VOXEL_MAP,
+    ASSOCIATION,
+    OGRID,
+    MARKERS,
+    NUM_STAGES
+  };
+
+  using Summary = LatencyWindow::Summary;
+
+  /// Times from construction to destruction, recording it to a stage
+  class Scope
+  {
+  public:
+    Scope(StageTimers& timers, Stage stage);
+    ~Scope();
+
+  private:
+    StageTimers& timers_;
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  /// Create timers which summarize the last @window samples of each stage
+  explicit StageTimers(size_t window = 1000);
+  /// Record that @stage took @ms milliseconds
+  void record(Stage stage, double ms);
+  /// Summarize the recorded samples for a stage
+  Summary summarize(Stage stage) const;
+  /// Fill a diagnostic status with the summary of each stage which has samples
+  void to_msg(diagnostic_msgs::DiagnosticStatus& status) const;
+  /// Forget all samples
+  void clear();
+  /// Name of a stage, used in diagnostics
+  static const char* name(Stage stage);
+
+private:
+  std::array<LatencyWindow, NUM_STAGES> samples_;
+};
+
+}  // namespace pcodar
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "pcodar_types.hpp"
+
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pcodar
+{
+/**
+ * Persistent sparse voxel map of the environment in the global (ENU) frame.
+ *
+ * Points from each new scan are hashed into fixed size voxels which remember how often and how recently they were
+ * observed. Voxels which are not observed for a configurable number of scans decay out of the map. Connected
+ * components of voxels (voxels whose centers are within the cluster tolerance of each other) are kept labeled between
+ * scans in a union-find over their labels. A voxel which becomes usable for clustering only looks at its neighbors,
+ * merging their components. A component which loses voxels is searched from the neighbors of those voxels, one step
+ * of each search in turn, only until every search but one has met another or run out of voxels, and the pieces that
+ * ran out become components of their own. So a scan costs time proportional to its points, plus, where a component
+ * loses voxels, the number of their neighbors times the size of the pieces cut off (or of the area around them
+ * searched before the searches meet), rather than the size of the components touched.
+ *
+ * Used as an alternative to accumulating scans in @PointCloudCircularBuffer and then running radius outlier removal and
+ * euclidean clustering over the whole accumulated cloud.
+ */
+class VoxelMap
+{
+public:
+  VoxelMap();
+  /// Update the dynamic reconfigure parameters associated with this class
+  void update_config(Config const& config);
+  /// Add the points of a new scan (in the global frame) to the map
+  void insert(point_cloud const& pc);
+  /// Remove voxels not seen recently and re-label connected components affected by the last insert / decay
+  void update();
+  /// Fills @pc with the centroid of each voxel which belongs to a cluster and @clusters with the indices of each
+  /// cluster
+  void get_clusters(point_cloud& pc, clusters_t& clusters) const;
+  /// Remove every voxel from the map
+  void clear();
+  /// Number of voxels currently in the map
+  size_t size() const;
+
+private:
+  /// Integer coordinates of a voxel
+  struct Key
+  {
+    int x;
+    int y;
+    int z;
+    bool operator==(Key const& other) const
+    {
+      return x == other.x && y == other.y && z == other.z;
+    }
+  };
+  struct KeyHash
+  {
+    size_t operator()(Key const& key) const
+    {
+      return (static_cast<size_t>(key.x) * 73856093) ^ (static_cast<size_t>(key.y) * 19349663) ^
+             (static_cast<size_t>(key.z) * 83492791);
+    }
+  };
+  /// Label of a voxel which does not yet belong to a component
+  static constexpr uint32_t UNLABELED = 0;
+  struct Voxel
+  {
+    /// Sum of the points which fell in this voxel, used to compute centroid
+    Eigen::Vector3f sum;
+    /// Number of points which fell in this voxel
+    uint32_t hits;
+    /// Scan number this voxel was last observed in
+    uint64_t last_seen;
+    /// Connected component this voxel is part of
+    uint32_t label;
+  };
+
+  /// Node of the union-find over labels. A voxel keeps the label it was given, and its component is that label's root.
+  struct Label
+  {
+    uint32_t parent;
+    /// Number of voxels in the component, only kept up to date for roots
+    uint32_t size;
+  };
+
+  Key key_for(point_t const& point) const;
+  Key cell_for(Key const& key) const;
+  Eigen::Vector3f center_of(Key const& key) const;
+  void erase_voxel(Key const& key);
+  /// Remove voxels which have not been observed in the last decay_scans_ scans
+  void evict_expired();
+  /// Call @visit with each voxel usable for clustering within the cluster tolerance of the voxel at @key, which need
+  /// not be in the map
+  template <typename Visit>
+  void for_each_neighbor(Key const& key, Visit visit);
+  /// Root of @label, shortening the path to it on the way
+  uint32_t find(uint32_t label);
+  uint32_t find(uint32_t label) const;
+  /// Start a new component with no voxels
+  uint32_t new_label();
+  /// Merge the components of roots @a and @b, returning the root of the result
+  uint32_t unite(uint32_t a, uint32_t b);
+  /// Label the voxel at @key, which just became usable, merging the components of its neighbors
+  void join(Key const& key);
+  /// Give the pieces of component @root which are no longer connected to each other labels of their own, searching
+  /// from @seeds, the voxels of it next to those it lost
+  void split(uint32_t root, std::vector<Key> const& seeds);
+  /// Point every voxel straight at its root and drop the labels no longer used
+  void compact_labels();
+
+  /// All voxels in the map
+  std::unordered_map<Key, Voxel, KeyHash> voxels_;
+  /// Voxels grouped into cells the size of the cluster tolerance, used to find neighbors
+  std::unordered_map<Key, std::vector<Key>, KeyHash> cells_;
+  /// Union-find over every label given to a voxel
+  std::unordered_map<uint32_t, Label> labels_;
+  /// Voxels observed in each of the most recent scans, oldest first, used to find voxels which should decay
+  std::deque<std::vector<Key>> history_;
+  /// Voxels added or observed since the last call to update
+  std::vector<Key> touched_;
+  /// Voxels removed from a component since the last call to update, and the root of that component
+  std::vector<std::pair<Key, uint32_t>> removed_;
+
+  /// Number of scans inserted so far
+  uint64_t scan_;
+  /// Next label given to a new component
+  uint32_t next_label_;
+
+  double resolution_;
+  double cluster_tolerance_;
+  double cell_size_;
+  size_t decay_scans_;
+  uint32_t min_hits_;
+  size_t min_cluster_voxels_;
+};
+
+}  // namespace pcodar
@@ -0,0 +1,35 @@
+/* ROS node to republish point clouds recorded by record_compressed_cloud as sensor_msgs/PointCloud2, e.g. to run
+ * pcodar_node on a bag of them. Subscribes to <cloud>/compressed and publishes on cloud.
+ */
+#include <mil_msgs/CompressedPointCloud2.h>
+#include <mil_tools/point_cloud_codec.hpp>
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <algorithm>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "decompress_cloud");
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+  int threads = 0;
+  private_nh.param<int>("decode_threads", threads, threads);
+  threads = std::max(threads, 0);
+
+  ros::Publisher pub = nh.advertise<sensor_msgs::PointCloud2>("cloud", 1);
+  ros::Subscriber sub = nh.subscribe<mil_msgs::CompressedPointCloud2>(
+      nh.resolveName("cloud") + "/compressed", 1,
+      [&pub, threads](const mil_msgs::CompressedPointCloud2ConstPtr& compressed) {
+        if (!pub.getNumSubscribers())
+          return;
+        sensor_msgs::PointCloud2Ptr cloud(new sensor_msgs::PointCloud2());
+        if (!mil_tools::decode_point_cloud(*compressed, *cloud, threads))
+        {
+          ROS_WARN_STREAM_THROTTLE(1.0, "Dropping malformed compressed cloud " << compressed->header.seq);
+          return;
+        }
+        pub.publish(cloud);
+      });
+  ros::spin();
+}
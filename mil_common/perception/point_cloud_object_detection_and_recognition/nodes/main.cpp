@@ -1,11 +1,23 @@
 #include <point_cloud_object_detection_and_recognition/pcodar_controller.hpp>
+#include <ros/callback_queue.h>
+
+#include <algorithm>
 
 int main(int argc, char* argv[])
 {
   ros::init(argc, argv, "point_cloud_object_detector");
   ros::NodeHandle nh(ros::this_node::getName());
-  pcodar::Node c(nh);
+
+  // Scans are processed on the main thread, while services and periodic diagnostics / snapshots are served by threads
+  // of their own, so neither waits behind the other
+  ros::CallbackQueue bulk_queue;
+  pcodar::Node c(nh, &bulk_queue);
   c.initialize();
+  int bulk_threads = 1;
+  nh.param<int>("bulk_threads", bulk_threads, bulk_threads);
+  ros::AsyncSpinner bulk_spinner(std::max(bulk_threads, 1), &bulk_queue);
+  bulk_spinner.start();
   ros::spin();
+  bulk_spinner.stop();
   return 0;
 }
@@ -0,0 +1,26 @@
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.hpp>
+#include <point_cloud_object_detection_and_recognition/pcodar_controller.hpp>
+
+#include <memory>
+
+namespace pcodar
+{
+/// pcodar::Node as a nodelet, with the same topics and params as pcodar_node under the nodelet's name. Scans are
+/// processed in order on the nodelet's queue, services and periodic work on its multi-threaded one.
+class Nodelet : public nodelet::Nodelet
+{
+public:
+  virtual void onInit()
+  {
+    node_.reset(new Node(getPrivateNodeHandle(), getMTPrivateNodeHandle().getCallbackQueue()));
+    node_->initialize();
+  }
+
+private:
+  std::unique_ptr<Node> node_;
+};
+
+}  // namespace pcodar
+
+PLUGINLIB_EXPORT_CLASS(pcodar::Nodelet, nodelet::Nodelet);
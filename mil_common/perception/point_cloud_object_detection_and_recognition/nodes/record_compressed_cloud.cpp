@@ -0,0 +1,17 @@
+/* ROS node to record point clouds compressed to a bag while enabled, e.g. /velodyne_points or PCODAR's persist_pcl
+ * (with ~reorder), at a fifth to a tenth of their size. See mil_tools/point_cloud_recorder.hpp for its params and
+ * mil_tools/topic_recorder.hpp for its enable service. Clouds are compressed on the recorder's writer thread, so
+ * ~async_write is on unless set.
+ */
+#include <mil_tools/point_cloud_recorder.hpp>
+#include <ros/ros.h>
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "record_compressed_cloud");
+  ros::NodeHandle nh("~");
+  if (!nh.hasParam("async_write"))
+    nh.setParam("async_write", true);
+  mil_tools::PointCloudRecorder recorder(&nh);
+  ros::spin();
+}
@@ -0,0 +1,19 @@
+#include <point_cloud_object_detection_and_recognition/cell_sort.hpp>
+
+namespace pcodar
+{
+void sort_by_cell(std::vector<uint32_t> const& point_cells, size_t num_cells, std::vector<uint32_t>& cell_starts,
+                  std::vector<uint32_t>& sorted_points)
+{
+  cell_starts.assign(num_cells + 1, 0);
+  for (uint32_t cell : point_cells)
+    ++cell_starts[cell + 1];
+  for (size_t i = 0; i < num_cells; ++i)
+    cell_starts[i + 1] += cell_starts[i];
+  sorted_points.resize(point_cells.size());
+  std::vector<uint32_t> next(cell_starts.begin(), cell_starts.end() - 1);
+  for (size_t i = 0; i < point_cells.size(); ++i)
+    sorted_points[next[point_cells[i]]++] = i;
+}
+
+}  // namespace pcodar
@@ -0,0 +1,105 @@
+#include <point_cloud_object_detection_and_recognition/change_detector.hpp>
+
+#include <cmath>
+
+namespace pcodar
+{
+ChangeDetector::ChangeDetector()
+  : frame_(0), appeared_(0), skips_(0), enabled_(false), resolution_(1.), window_(3), threshold_(0.02), max_skips_(10)
+{
+  clear();
+}
+
+void ChangeDetector::update_config(Config const& config)
+{
+  // Changing the geometry or the window invalidates every stored frame
+  if (config.change_detection_resolution_m != resolution_ ||
+      static_cast<size_t>(config.change_detection_window) != window_ || !config.change_detection_enabled)
+    clear();
+
+  enabled_ = config.change_detection_enabled;
+  resolution_ = config.change_detection_resolution_m;
+  window_ = config.change_detection_window;
+  threshold_ = config.change_detection_threshold;
+  max_skips_ = config.change_detection_max_skips;
+}
+
+ChangeDetector::Key ChangeDetector::key_for(point_t const& point) const
+{
+  // Wraps every 2^21 voxels, which only ever aliases voxels that far apart
+  auto coordinate = [this](float value) {
+    return static_cast<Key>(static_cast<int64_t>(std::floor(value / resolution_))) & 0x1fffff;
+  };
+  return coordinate(point.x) | coordinate(point.y) << 21 | coordinate(point.z) << 42;
+}
+
+void ChangeDetector::add(point_cloud const& pc)
+{
+  if (!enabled_)
+    return;
+
+  std::vector<Key>& occupied = history_.back();
+  for (point_t const& point : pc)
+  {
+    if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+      continue;
+
+    auto result = last_seen_.insert({ key_for(point), frame_ });
+    if (result.second)
+      ++appeared_;
+    else if (result.first->second == frame_)
+      continue;
+    result.first->second = frame_;
+    occupied.push_back(result.first->first);
+  }
+}
+
+bool ChangeDetector::end_frame()
+{
+  if (!enabled_)
+    return true;
+
+  size_t voxels = history_.back().size();
+  size_t changed = appeared_;
+  // Until the window is full, a frame can not be compared with a whole window
+  bool full = history_.size() > window_;
+
+  // Voxels of the frame leaving the window which were not occupied since are gone
+  if (full)
+  {
+    uint64_t leaving = frame_ - window_;
+    for (Key key : history_.front())
+    {
+      auto it = last_seen_.find(key);
+      if (it != last_seen_.end() && it->second == leaving)
+      {
+        last_seen_.erase(it);
+        ++changed;
+      }
+    }
+    history_.pop_front();
+  }
+
+  ++frame_;
+  appeared_ = 0;
+  history_.emplace_back();
+
+  if (full && changed <= threshold_ * voxels && skips_ < max_skips_)
+  {
+    ++skips_;
+    return false;
+  }
+  skips_ = 0;
+  return true;
+}
+
+void ChangeDetector::clear()
+{
+  last_seen_.clear();
+  history_.clear();
+  history_.emplace_back();
+  appeared_ = 0;
+  skips_ = 0;
+}
+
+}  // namespace pcodar
@@ -0,0 +1,74 @@
+#include <point_cloud_object_detection_and_recognition/cloud_pool.hpp>
+
+namespace pcodar
+{
+CloudPool::CloudPool(size_t max_size) : max_size_(max_size)
+{
+}
+
+void CloudPool::acquire(point_cloud const& points, point_cloud_ptr& cloud, KdTreePtr& search_tree)
+{
+  acquire(cloud, search_tree);
+  cloud->points.assign(points.begin(), points.end());
+  cloud->width = cloud->points.size();
+  cloud->height = 1;
+  cloud->header = points.header;
+  search_tree->setInputCloud(cloud);
+}
+
+void CloudPool::acquire(point_cloud_ptr& cloud, KdTreePtr& search_tree)
+{
+  if (free_.empty())
+  {
+    cloud = boost::make_shared<point_cloud>();
+    search_tree = boost::make_shared<KdTree>();
+  }
+  else
+  {
+    cloud = free_.back().first;
+    search_tree = free_.back().second;
+    free_.pop_back();
+  }
+}
+
+void CloudPool::release(point_cloud_ptr const& cloud, KdTreePtr const& search_tree)
+{
+  if (!cloud || !search_tree || free_.size() >= max_size_)
+    return;
+  // The caller and the search tree's reference to its input are expected, anything more means it is still in use
+  if (cloud.use_count() > 2 || search_tree.use_count() > 1)
+    return;
+  free_.emplace_back(cloud, search_tree);
+}
+
+void CloudPool::clear()
+{
+  free_.clear();
+}
+
+size_t CloudPool::size() const
+{
+  return free_.size();
+}
+
+size_t CloudPool::memory_usage() const
+{
+  size_t bytes = free_.capacity() * sizeof(free_[0]);
+  for (auto const& pooled : free_)
+    bytes += cloud_memory_usage(pooled.first.get(), pooled.second.get());
+  return bytes;
+}
+
+size_t cloud_memory_usage(point_cloud const* cloud, KdTree const* search_tree)
+{
+  // FLANN copies the points as floats and keeps two indices into them, plus about one node per leaf of 15 points
+  const size_t SEARCH_TREE_BYTES_PER_POINT = 3 * sizeof(float) + 2 * sizeof(int) + 4;
+  size_t bytes = 0;
+  if (cloud)
+    bytes += sizeof(*cloud) + cloud->points.capacity() * sizeof(point_t);
+  if (search_tree && search_tree->getInputCloud())
+    bytes += search_tree->getInputCloud()->size() * SEARCH_TREE_BYTES_PER_POINT;
+  return bytes;
+}
+
+}  // namespace pcodar
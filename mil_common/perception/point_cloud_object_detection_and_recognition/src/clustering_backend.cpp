@@ -0,0 +1,406 @@
+#include <point_cloud_object_detection_and_recognition/clustering_backend.hpp>
+#include <point_cloud_object_detection_and_recognition/cell_sort.hpp>
+#include <point_cloud_object_detection_and_recognition/cuda_clustering.hpp>
+
+#include <pcl/common/common.h>
+#include <ros/console.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace pcodar
+{
+namespace
+{
+/// Cells are slightly smaller than tolerance / sqrt(3), so every pair of points in a cell is within the tolerance
+/// and cells up to 2 away in each direction may contain neighbors
+const double CELL_SCALE = 0.999 / std::sqrt(3.);
+const int NEIGHBOR_REACH = 2;
+/// Most cells in ColumnClusteringBackend's grid, 64MB of them
+const double MAX_CELLS = 16 * 1024 * 1024;
+
+struct Key
+{
+  int x;
+  int y;
+  int z;
+  bool operator==(Key const& other) const
+  {
+    return x == other.x && y == other.y && z == other.z;
+  }
+};
+struct KeyHash
+{
+  size_t operator()(Key const& key) const
+  {
+    return (static_cast<size_t>(key.x) * 73856093) ^ (static_cast<size_t>(key.y) * 19349663) ^
+           (static_cast<size_t>(key.z) * 83492791);
+  }
+};
+
+}  // anonymous namespace
+
+void PclClusteringBackend::cluster(point_cloud_const_ptr const& pc, double tolerance, int min_points,
+                                   clusters_t& clusters)
+{
+  clusters.clear();
+  if (pc->empty())
+    return;
+
+  // Creating the KdTree object for the search method of the extraction
+  pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
+  tree->setInputCloud(pc);
+
+  cluster_extractor_.setClusterTolerance(tolerance);
+  cluster_extractor_.setMinClusterSize(min_points);
+  cluster_extractor_.setSearchMethod(tree);
+  cluster_extractor_.setInputCloud(pc);
+  cluster_extractor_.extract(clusters);
+}
+
+uint32_t GridClusteringBackend::find(uint32_t cell)
+{
+  while (parent_[cell] != cell)
+  {
+    parent_[cell] = parent_[parent_[cell]];
+    cell = parent_[cell];
+  }
+  return cell;
+}
+
+void GridClusteringBackend::cluster(point_cloud_const_ptr const& pc, double tolerance, int min_points,
+                                    clusters_t& clusters)
+{
+  clusters.clear();
+  point_cloud const& points = *pc;
+  if (points.empty())
+    return;
+
+  // Hash each point into a cell
+  double cell_size = tolerance * CELL_SCALE;
+  std::unordered_map<Key, uint32_t, KeyHash> cell_ids;
+  std::vector<Key> cell_keys;
+  point_cells_.resize(points.size());
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    Key key{ static_cast<int>(std::floor(points[i].x / cell_size)),
+             static_cast<int>(std::floor(points[i].y / cell_size)),
+             static_cast<int>(std::floor(points[i].z / cell_size)) };
+    auto it = cell_ids.emplace(key, cell_keys.size()).first;
+    if ((*it).second == cell_keys.size())
+      cell_keys.push_back(key);
+    point_cells_[i] = (*it).second;
+  }
+
+  // Sort points by cell, so each cell's points are contiguous
+  size_t num_cells = cell_keys.size();
+  sort_by_cell(point_cells_, num_cells, cell_starts_, sorted_points_);
+
+  // Points in a cell are all connected, so only cells need to be joined. Each pair of cells is checked once by only
+  // looking at neighbors in one direction.
+  parent_.resize(num_cells);
+  for (size_t i = 0; i < num_cells; ++i)
+    parent_[i] = i;
+  float tolerance_squared = tolerance * tolerance;
+  auto any_within = [&](uint32_t a, uint32_t b) {
+    for (uint32_t i = cell_starts_[a]; i < cell_starts_[a + 1]; ++i)
+    {
+      point_t const& p = points[sorted_points_[i]];
+      for (uint32_t j = cell_starts_[b]; j < cell_starts_[b + 1]; ++j)
+      {
+        point_t const& q = points[sorted_points_[j]];
+        float dx = p.x - q.x, dy = p.y - q.y, dz = p.z - q.z;
+        if (dx * dx + dy * dy + dz * dz < tolerance_squared)
+          return true;
+      }
+    }
+    return false;
+  };
+  for (uint32_t cell = 0; cell < num_cells; ++cell)
+  {
+    Key const& key = cell_keys[cell];
+    for (int dx = -NEIGHBOR_REACH; dx <= NEIGHBOR_REACH; ++dx)
+      for (int dy = -NEIGHBOR_REACH; dy <= NEIGHBOR_REACH; ++dy)
+        for (int dz = -NEIGHBOR_REACH; dz <= NEIGHBOR_REACH; ++dz)
+        {
+          // Only offsets lexicographically after (0, 0, 0)
+          if (dx < 0 || (dx == 0 && (dy < 0 || (dy == 0 && dz <= 0))))
+            continue;
+          auto neighbor = cell_ids.find(Key{ key.x + dx, key.y + dy, key.z + dz });
+          if (neighbor == cell_ids.end())
+            continue;
+          uint32_t a = find(cell);
+          uint32_t b = find((*neighbor).second);
+          if (a != b && any_within(cell, (*neighbor).second))
+            parent_[std::max(a, b)] = std::min(a, b);
+        }
+  }
+
+  labels_.resize(points.size());
+  for (size_t i = 0; i < points.size(); ++i)
+    labels_[i] = find(point_cells_[i]);
+  labels_to_clusters(labels_, min_points, clusters);
+}
+
+void CudaClusteringBackend::cluster(point_cloud_const_ptr const& pc, double tolerance, int min_points,
+                                    clusters_t& clusters)
+{
+#ifdef PCODAR_CUDA
+  clusters.clear();
+  if (pc->empty())
+    return;
+
+  point_t min, max;
+  pcl::getMinMax3D(*pc, min, max);
+  float min_xyz[3] = { min.x, min.y, min.z };
+  float max_xyz[3] = { max.x, max.y, max.z };
+  xyz_.resize(pc->size() * 3);
+  for (size_t i = 0; i < pc->size(); ++i)
+  {
+    xyz_[3 * i] = (*pc)[i].x;
+    xyz_[3 * i + 1] = (*pc)[i].y;
+    xyz_[3 * i + 2] = (*pc)[i].z;
+  }
+  std::string error;
+  if (cuda::euclidean_cluster_labels(xyz_.data(), pc->size(), min_xyz, max_xyz, tolerance, labels_, error))
+  {
+    labels_to_clusters(labels_, min_points, clusters);
+    return;
+  }
+  ROS_WARN_THROTTLE(10., "CUDA clustering failed, falling back to PCL: %s", error.c_str());
+#else
+  ROS_WARN_ONCE("PCODAR was built without CUDA, falling back to PCL clustering");
+#endif
+  fallback_.cluster(pc, tolerance, min_points, clusters);
+}
+
+ColumnClusteringBackend::ColumnClusteringBackend() : resolution_(0.3)
+{
+}
+
+void ColumnClusteringBackend::update_config(Config const& config)
+{
+  resolution_ = config.cluster_column_resolution_m;
+}
+
+uint32_t ColumnClusteringBackend::find(uint32_t column)
+{
+  while (parent_[column] != column)
+  {
+    parent_[column] = parent_[parent_[column]];
+    column = parent_[column];
+  }
+  return column;
+}
+
+void ColumnClusteringBackend::cluster(point_cloud_const_ptr const& pc, double tolerance, int min_points,
+                                      clusters_t& clusters)
+{
+  clusters.clear();
+  features_.clear();
+  point_cloud const& points = *pc;
+  if (points.empty())
+    return;
+
+  // Grid over the cloud's footprint, coarser if the cloud is too spread out for the configured resolution
+  point_t min, max;
+  pcl::getMinMax3D(points, min, max);
+  double resolution = resolution_;
+  double area = (max.x - min.x) * (max.y - min.y);
+  if (area / (resolution * resolution) > MAX_CELLS)
+  {
+    resolution = std::sqrt(area / MAX_CELLS) * 1.01;
+    ROS_WARN_THROTTLE(10., "Cloud spans %.0f m^2, clustering in %.2f m columns instead of %.2f m", area, resolution,
+                      resolution_);
+  }
+  const int width = static_cast<int>((max.x - min.x) / resolution) + 1;
+  const int height = static_cast<int>((max.y - min.y) / resolution) + 1;
+  if (grid_.size() < static_cast<size_t>(width) * height)
+    grid_.resize(static_cast<size_t>(width) * height, 0);
+
+  // Bin each point into its column, accumulating the column's shape as it goes
+  columns_.clear();
+  point_columns_.resize(points.size());
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    Eigen::Vector3f point = points[i].getVector3fMap();
+    int x = std::min(static_cast<int>((point.x() - min.x) / resolution), width - 1);
+    int y = std::min(static_cast<int>((point.y() - min.y) / resolution), height - 1);
+    uint32_t& column = grid_[static_cast<size_t>(y) * width + x];
+    if (!column)
+    {
+      columns_.push_back(Column{ x, y, 0, point, point, Eigen::Vector3f::Zero() });
+      column = columns_.size();
+    }
+    Column& c = columns_[column - 1];
+    ++c.points;
+    c.min = c.min.cwiseMin(point);
+    c.max = c.max.cwiseMax(point);
+    c.sum += point;
+    point_columns_[i] = column - 1;
+  }
+
+  // Columns are numbered in the order of their first point and parents are always the lower column, so the root of
+  // each cluster is the column of its first point.
+  parent_.resize(columns_.size());
+  for (size_t i = 0; i < columns_.size(); ++i)
+    parent_[i] = i;
+  auto join = [this](uint32_t a, uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a != b)
+      parent_[std::max(a, b)] = std::min(a, b);
+  };
+
+  // Group the columns into square blocks small enough that every pair of columns in a block is within the tolerance,
+  // as linked lists, so only blocks need to be joined
+  const int reach = static_cast<int>(tolerance / resolution);
+  const double reach_squared = (tolerance / resolution) * (tolerance / resolution);
+  const int block_size = static_cast<int>(reach / std::sqrt(2.)) + 1;
+  const int blocks_width = (width - 1) / block_size + 1;
+  const int blocks_height = (height - 1) / block_size + 1;
+  if (block_heads_.size() < static_cast<size_t>(blocks_width) * blocks_height)
+    block_heads_.resize(static_cast<size_t>(blocks_width) * blocks_height, 0);
+  blocks_.clear();
+  next_in_block_.resize(columns_.size());
+  for (uint32_t column = columns_.size(); column-- > 0;)
+  {
+    Column const& c = columns_[column];
+    uint32_t block = (c.y / block_size) * blocks_width + c.x / block_size;
+    uint32_t& head = block_heads_[block];
+    if (head)
+      join(column, head - 1);
+    else
+      blocks_.push_back(block);
+    next_in_block_[column] = head;
+    head = column + 1;
+  }
+
+  // Join each block with the blocks which could have columns within the tolerance of its own, only looking at
+  // offsets in one direction so each pair is checked once
+  auto any_within = [this, reach_squared](uint32_t a, uint32_t b) {
+    for (uint32_t i = a; i; i = next_in_block_[i - 1])
+      for (uint32_t j = b; j; j = next_in_block_[j - 1])
+      {
+        int dx = columns_[i - 1].x - columns_[j - 1].x;
+        int dy = columns_[i - 1].y - columns_[j - 1].y;
+        if (dx * dx + dy * dy <= reach_squared)
+          return true;
+      }
+    return false;
+  };
+  const int block_reach = reach > 0 ? (reach - 1) / block_size + 1 : 0;
+  for (uint32_t block : blocks_)
+  {
+    const int bx = block % blocks_width;
+    const int by = block / blocks_width;
+    const uint32_t head = block_heads_[block];
+    for (int dy = 0; dy <= std::min(block_reach, blocks_height - 1 - by); ++dy)
+      for (int dx = std::max(-block_reach, -bx); dx <= std::min(block_reach, blocks_width - 1 - bx); ++dx)
+      {
+        if (dy == 0 && dx <= 0)
+          continue;
+        // Closest the columns of the two blocks can be
+        int gap_x = std::max(0, std::abs(dx) * block_size - (block_size - 1));
+        int gap_y = std::max(0, dy * block_size - (block_size - 1));
+        if (gap_x * gap_x + gap_y * gap_y > reach_squared)
+          continue;
+        uint32_t neighbor = block_heads_[block + dy * blocks_width + dx];
+        if (neighbor && find(head - 1) != find(neighbor - 1) && any_within(head, neighbor))
+          join(head - 1, neighbor - 1);
+      }
+  }
+  for (uint32_t block : blocks_)
+    block_heads_[block] = 0;
+
+  // Total up each cluster's columns, dropping the small ones
+  column_clusters_.assign(columns_.size(), -1);
+  std::vector<uint32_t> roots;
+  std::vector<ClusterFeatures> totals;
+  for (uint32_t column = 0; column < columns_.size(); ++column)
+  {
+    Column const& c = columns_[column];
+    uint32_t root = find(column);
+    if (root == column)
+    {
+      column_clusters_[root] = totals.size();
+      roots.push_back(root);
+      totals.push_back(ClusterFeatures{ point_t(c.min.x(), c.min.y(), c.min.z()),
+                                        point_t(c.max.x(), c.max.y(), c.max.z()), point_t(0., 0., 0.), 0, 0, 0., 0. });
+    }
+    ClusterFeatures& total = totals[column_clusters_[root]];
+    total.min.getVector3fMap() = total.min.getVector3fMap().cwiseMin(c.min);
+    total.max.getVector3fMap() = total.max.getVector3fMap().cwiseMax(c.max);
+    total.centroid.getVector3fMap() += c.sum;
+    total.points += c.points;
+    ++total.columns;
+    total.mean_column_height += c.max.z() - c.min.z();
+    grid_[static_cast<size_t>(c.y) * width + c.x] = 0;
+  }
+
+  // Clusters largest first, ties in the order of their first point, matching labels_to_clusters
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < totals.size(); ++i)
+    if (totals[i].points >= static_cast<uint32_t>(min_points))
+      order.push_back(i);
+  std::stable_sort(order.begin(), order.end(),
+                   [&totals](uint32_t a, uint32_t b) { return totals[a].points > totals[b].points; });
+  std::fill(column_clusters_.begin(), column_clusters_.end(), -1);
+  clusters.resize(order.size());
+  features_.resize(order.size());
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    ClusterFeatures& features = features_[i];
+    features = totals[order[i]];
+    features.centroid.getVector3fMap() /= features.points;
+    features.footprint_area = features.columns * resolution * resolution;
+    features.mean_column_height /= features.columns;
+    column_clusters_[roots[order[i]]] = i;
+    clusters[i].indices.reserve(features.points);
+  }
+
+  // Roots come before the rest of their cluster's columns
+  for (uint32_t column = 0; column < columns_.size(); ++column)
+    column_clusters_[column] = column_clusters_[find(column)];
+
+  // Points are visited in order, so indices are sorted within each cluster
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    int cluster = column_clusters_[point_columns_[i]];
+    if (cluster >= 0)
+      clusters[cluster].indices.push_back(i);
+  }
+}
+
+bool ColumnClusteringBackend::get_features(cluster_features_t& features) const
+{
+  features = features_;
+  return true;
+}
+
+void labels_to_clusters(std::vector<int> const& labels, int min_points, clusters_t& clusters)
+{
+  clusters.clear();
+
+  // Points are visited in order, so indices are sorted within each cluster
+  std::unordered_map<int, size_t> label_clusters;
+  for (size_t i = 0; i < labels.size(); ++i)
+  {
+    auto it = label_clusters.emplace(labels[i], clusters.size()).first;
+    if ((*it).second == clusters.size())
+      clusters.emplace_back();
+    clusters[(*it).second].indices.push_back(i);
+  }
+
+  clusters.erase(std::remove_if(clusters.begin(), clusters.end(),
+                                [min_points](cluster_t const& cluster) {
+                                  return cluster.indices.size() < static_cast<size_t>(min_points);
+                                }),
+                 clusters.end());
+  std::stable_sort(clusters.begin(), clusters.end(), [](cluster_t const& a, cluster_t const& b) {
+    return a.indices.size() > b.indices.size();
+  });
+}
+
+}  // namespace pcodar
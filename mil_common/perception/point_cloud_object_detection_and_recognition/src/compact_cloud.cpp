@@ -0,0 +1,92 @@
+#include <point_cloud_object_detection_and_recognition/compact_cloud.hpp>
+
+#include <pcl/common/common.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace pcodar
+{
+namespace
+{
+const float MAX_OFFSET = std::numeric_limits<int16_t>::max();
+
+}  // anonymous namespace
+
+constexpr float CompactCloud::MIN_STEP;
+
+CompactCloud::CompactCloud() : origin_(Eigen::Vector3f::Zero()), step_(MIN_STEP)
+{
+}
+
+void CompactCloud::assign(point_cloud const& pc)
+{
+  offsets_.clear();
+  if (pc.empty())
+    return;
+
+  point_t min, max;
+  pcl::getMinMax3D(pc, min, max);
+  origin_ = (min.getVector3fMap() + max.getVector3fMap()) / 2.;
+  float half_extent = ((max.getVector3fMap() - min.getVector3fMap()) / 2.).maxCoeff();
+  step_ = std::max(MIN_STEP, half_extent / MAX_OFFSET);
+
+  offsets_.resize(3 * pc.size());
+  offsets_.shrink_to_fit();
+  int16_t* offset = offsets_.data();
+  float scale = 1. / step_;
+  for (point_t const& point : pc)
+  {
+    Eigen::Vector3f quantized = ((point.getVector3fMap() - origin_) * scale).array().round();
+    for (int i = 0; i < 3; ++i)
+      *offset++ = static_cast<int16_t>(std::max(-MAX_OFFSET, std::min(MAX_OFFSET, quantized[i])));
+  }
+}
+
+void CompactCloud::decode(point_cloud& pc) const
+{
+  pc.points.resize(size());
+  pc.width = pc.points.size();
+  pc.height = 1;
+  pc.is_dense = true;
+  decode(0, size(), pc.points.data());
+}
+
+void CompactCloud::decode(size_t begin, size_t count, point_t* out) const
+{
+  static_assert(sizeof(point_t) == 4 * sizeof(float), "point_t must be x, y, z and padding");
+  // One expression over the whole range, so Eigen converts and scales several offsets at once
+  Eigen::Map<const Eigen::Matrix<int16_t, 3, Eigen::Dynamic>> offsets(offsets_.data() + 3 * begin, 3, count);
+  Eigen::Map<Eigen::Matrix<float, 3, Eigen::Dynamic>, Eigen::Unaligned, Eigen::OuterStride<4>> points(&out->x, 3,
+                                                                                                       count);
+  points = (offsets.cast<float>() * step_).colwise() + origin_;
+}
+
+void CompactCloud::clear()
+{
+  offsets_.clear();
+  offsets_.shrink_to_fit();
+}
+
+size_t CompactCloud::size() const
+{
+  return offsets_.size() / 3;
+}
+
+bool CompactCloud::empty() const
+{
+  return offsets_.empty();
+}
+
+size_t CompactCloud::memory_usage() const
+{
+  return offsets_.capacity() * sizeof(int16_t);
+}
+
+float CompactCloud::max_error() const
+{
+  return step_ * std::sqrt(3.f) / 2.;
+}
+
+}  // namespace pcodar
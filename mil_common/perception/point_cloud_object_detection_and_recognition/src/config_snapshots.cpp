@@ -0,0 +1,45 @@
+#include <point_cloud_object_detection_and_recognition/config_snapshots.hpp>
+
+namespace pcodar
+{
+uint32_t ConfigSnapshots::Snapshot::changed_since(uint64_t version) const
+{
+  uint32_t level = 0;
+  for (size_t bit = 0; bit < level_versions.size(); ++bit)
+    if (level_versions[bit] > version)
+      level |= uint32_t(1) << bit;
+  return level;
+}
+
+void ConfigSnapshots::publish(Config const& config, uint32_t level)
+{
+  std::lock_guard<std::mutex> lock(publish_mutex_);
+  SnapshotPtr last = std::atomic_load(&current_);
+  auto next = std::make_shared<Snapshot>();
+  next->config = config;
+  next->version = last ? last->version + 1 : 1;
+  for (size_t bit = 0; bit < next->level_versions.size(); ++bit)
+  {
+    bool changed = !last || !level || level & (uint32_t(1) << bit);
+    next->level_versions[bit] = changed ? next->version : last->level_versions[bit];
+  }
+  std::atomic_store(&current_, SnapshotPtr(std::move(next)));
+}
+
+ConfigSnapshots::SnapshotPtr ConfigSnapshots::load() const
+{
+  return std::atomic_load(&current_);
+}
+
+bool ConfigSnapshots::Reader::update(ConfigSnapshots const& snapshots, SnapshotPtr& snapshot, uint32_t& level)
+{
+  SnapshotPtr latest = snapshots.load();
+  if (!latest || latest->version == version_)
+    return false;
+  level = latest->changed_since(version_);
+  version_ = latest->version;
+  snapshot = std::move(latest);
+  return true;
+}
+
+}  // namespace pcodar
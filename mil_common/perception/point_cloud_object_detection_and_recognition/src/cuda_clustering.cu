@@ -0,0 +1,244 @@
+#include <point_cloud_object_detection_and_recognition/cuda_clustering.hpp>
+
+#include <thrust/binary_search.h>
+#include <thrust/copy.h>
+#include <thrust/device_vector.h>
+#include <thrust/gather.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/iterator/transform_iterator.h>
+#include <thrust/scan.h>
+#include <thrust/sequence.h>
+#include <thrust/sort.h>
+#include <thrust/system_error.h>
+#include <thrust/transform.h>
+#include <thrust/unique.h>
+
+#include <cmath>
+#include <cstdint>
+#include <new>
+
+namespace pcodar
+{
+namespace cuda
+{
+namespace
+{
+/// Cells are slightly smaller than tolerance / sqrt(3), so every pair of points in a cell is within the tolerance
+/// and cells up to 2 away in each direction may contain neighbors. Matches GridClusteringBackend.
+const double CELL_SCALE = 0.999 / 1.7320508075688772;
+/// Cell coordinates are packed into 21 bits each of a 64 bit key
+const int KEY_BITS = 21;
+const int64_t KEY_MAX = (int64_t(1) << KEY_BITS) - 1;
+/// Neighbor offsets in [-2, 2]^3 lexicographically after (0, 0, 0), so each pair of cells is checked once
+const int NUM_OFFSETS = 62;
+
+__host__ __device__ inline uint64_t pack_key(int64_t x, int64_t y, int64_t z)
+{
+  return (uint64_t(x) << (2 * KEY_BITS)) | (uint64_t(y) << KEY_BITS) | uint64_t(z);
+}
+
+struct CellKey
+{
+  float3 min;
+  float inverse_cell_size;
+  __host__ __device__ uint64_t operator()(float3 const& point) const
+  {
+    return pack_key(int64_t((point.x - min.x) * inverse_cell_size), int64_t((point.y - min.y) * inverse_cell_size),
+                    int64_t((point.z - min.z) * inverse_cell_size));
+  }
+};
+
+__device__ int find(int* parent, int x)
+{
+  // Path halving, racing writes only ever shorten paths
+  while (true)
+  {
+    int p = parent[x];
+    if (p == x)
+      return x;
+    int gp = parent[p];
+    if (p != gp)
+      atomicCAS(&parent[x], p, gp);
+    x = p;
+  }
+}
+
+__device__ void unite(int* parent, int a, int b)
+{
+  while (true)
+  {
+    a = find(parent, a);
+    b = find(parent, b);
+    if (a == b)
+      return;
+    // Always link the larger root to the smaller, so links can never form a cycle
+    if (a < b)
+    {
+      int t = a;
+      a = b;
+      b = t;
+    }
+    if (atomicCAS(&parent[a], a, b) == a)
+      return;
+  }
+}
+
+/// One thread per (cell, neighbor offset): join the cells if any pair of their points is within the tolerance
+__global__ void link_cells(uint64_t const* cell_keys, int const* cell_starts, int num_cells, float3 const* points,
+                           float tolerance_squared, int* parent)
+{
+  int thread = blockIdx.x * blockDim.x + threadIdx.x;
+  if (thread >= num_cells * NUM_OFFSETS)
+    return;
+  int cell = thread / NUM_OFFSETS;
+  int offset = thread % NUM_OFFSETS + NUM_OFFSETS + 1;
+
+  uint64_t key = cell_keys[cell];
+  int64_t x = int64_t(key >> (2 * KEY_BITS)) + offset / 25 - 2;
+  int64_t y = int64_t((key >> KEY_BITS) & KEY_MAX) + (offset / 5) % 5 - 2;
+  int64_t z = int64_t(key & KEY_MAX) + offset % 5 - 2;
+  if (x < 0 || y < 0 || z < 0 || x > KEY_MAX || y > KEY_MAX || z > KEY_MAX)
+    return;
+  uint64_t neighbor_key = pack_key(x, y, z);
+
+  // Binary search the sorted cell keys for the neighbor
+  int low = 0, high = num_cells;
+  while (low < high)
+  {
+    int middle = (low + high) / 2;
+    if (cell_keys[middle] < neighbor_key)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  if (low == num_cells || cell_keys[low] != neighbor_key)
+    return;
+  int neighbor = low;
+  if (find(parent, cell) == find(parent, neighbor))
+    return;
+
+  for (int i = cell_starts[cell]; i < cell_starts[cell + 1]; ++i)
+    for (int j = cell_starts[neighbor]; j < cell_starts[neighbor + 1]; ++j)
+    {
+      float dx = points[i].x - points[j].x, dy = points[i].y - points[j].y, dz = points[i].z - points[j].z;
+      if (dx * dx + dy * dy + dz * dz < tolerance_squared)
+      {
+        unite(parent, cell, neighbor);
+        return;
+      }
+    }
+}
+
+/// Label each point by the root of its cell, in the original point order
+__global__ void label_points(int const* sorted_cells, int const* order, int count, int* parent, int* labels)
+{
+  int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= count)
+    return;
+  labels[order[i]] = find(parent, sorted_cells[i]);
+}
+
+struct IsNewCell
+{
+  uint64_t const* keys;
+  __host__ __device__ int operator()(int i) const
+  {
+    return i > 0 && keys[i] != keys[i - 1];
+  }
+};
+
+int blocks(int threads, int block_size)
+{
+  return (threads + block_size - 1) / block_size;
+}
+
+}  // anonymous namespace
+
+bool euclidean_cluster_labels(float const* xyz, size_t count, float const min[3], float const max[3], float tolerance,
+                              std::vector<int>& labels, std::string& error)
+{
+  labels.clear();
+  if (!count)
+    return true;
+
+  // The cloud must fit in the key's range of cells
+  double cell_size = tolerance * CELL_SCALE;
+  for (int i = 0; i < 3; ++i)
+    if ((max[i] - min[i]) / cell_size >= KEY_MAX)
+    {
+      error = "cloud spans too many cells";
+      return false;
+    }
+
+  int device_count = 0;
+  if (cudaGetDeviceCount(&device_count) != cudaSuccess || !device_count)
+  {
+    error = "no CUDA device";
+    return false;
+  }
+
+  try
+  {
+    const int BLOCK_SIZE = 256;
+    int n = count;
+    thrust::device_vector<float3> points(reinterpret_cast<float3 const*>(xyz),
+                                         reinterpret_cast<float3 const*>(xyz) + count);
+
+    // Sort points by cell key
+    CellKey cell_key{ make_float3(min[0], min[1], min[2]), float(1. / cell_size) };
+    thrust::device_vector<uint64_t> keys(count);
+    thrust::transform(points.begin(), points.end(), keys.begin(), cell_key);
+    thrust::device_vector<int> order(count);
+    thrust::sequence(order.begin(), order.end());
+    thrust::sort_by_key(keys.begin(), keys.end(), order.begin());
+    thrust::device_vector<float3> sorted_points(count);
+    thrust::gather(order.begin(), order.end(), points.begin(), sorted_points.begin());
+
+    // Cell of each sorted point, and the start of each cell in the sorted points
+    thrust::device_vector<int> sorted_cells(count);
+    IsNewCell is_new_cell{ thrust::raw_pointer_cast(keys.data()) };
+    thrust::inclusive_scan(thrust::make_transform_iterator(thrust::counting_iterator<int>(0), is_new_cell),
+                           thrust::make_transform_iterator(thrust::counting_iterator<int>(n), is_new_cell),
+                           sorted_cells.begin());
+    int num_cells = int(sorted_cells.back()) + 1;
+    thrust::device_vector<uint64_t> cell_keys(keys);
+    cell_keys.erase(thrust::unique(cell_keys.begin(), cell_keys.end()), cell_keys.end());
+    thrust::device_vector<int> cell_starts(num_cells + 1);
+    thrust::lower_bound(keys.begin(), keys.end(), cell_keys.begin(), cell_keys.end(), cell_starts.begin());
+    cell_starts[num_cells] = n;
+
+    // Join neighboring cells, then label points by their cell's root
+    thrust::device_vector<int> parent(num_cells);
+    thrust::sequence(parent.begin(), parent.end());
+    link_cells<<<blocks(num_cells * NUM_OFFSETS, BLOCK_SIZE), BLOCK_SIZE>>>(
+        thrust::raw_pointer_cast(cell_keys.data()), thrust::raw_pointer_cast(cell_starts.data()), num_cells,
+        thrust::raw_pointer_cast(sorted_points.data()), tolerance * tolerance, thrust::raw_pointer_cast(parent.data()));
+    thrust::device_vector<int> device_labels(count);
+    label_points<<<blocks(n, BLOCK_SIZE), BLOCK_SIZE>>>(
+        thrust::raw_pointer_cast(sorted_cells.data()), thrust::raw_pointer_cast(order.data()), n,
+        thrust::raw_pointer_cast(parent.data()), thrust::raw_pointer_cast(device_labels.data()));
+    cudaError_t status = cudaDeviceSynchronize();
+    if (status != cudaSuccess)
+    {
+      error = cudaGetErrorString(status);
+      return false;
+    }
+
+    labels.resize(count);
+    thrust::copy(device_labels.begin(), device_labels.end(), labels.begin());
+  }
+  catch (thrust::system_error const& e)
+  {
+    error = e.what();
+    return false;
+  }
+  catch (std::bad_alloc const& e)
+  {
+    error = e.what();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace cuda
+}  // namespace pcodar
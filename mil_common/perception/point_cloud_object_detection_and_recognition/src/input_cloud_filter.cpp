@@ -1,8 +1,16 @@
 #include <point_cloud_object_detection_and_recognition/input_cloud_filter.hpp>
 
+#include <algorithm>
+
 namespace pcodar
 {
+constexpr size_t InputCloudFilter::BATCH_SIZE;
+
 InputCloudFilter::InputCloudFilter()
+  : bounds_convex_(false)
+  , robot_inverse_(Eigen::Affine3f::Identity())
+  , footprint_min_(Eigen::Vector3f::Zero())
+  , footprint_max_(Eigen::Vector3f::Zero())
 {
   bounds_filter_.setDim(2);
   bounds_filter_.setCropOutside(true);
@@ -10,7 +18,34 @@ InputCloudFilter::InputCloudFilter()
   robot_filter_.setNegative(true);
 }
 
-void InputCloudFilter::filter(point_cloud_const_ptr in, point_cloud& pc)
+void InputCloudFilter::filter(point_cloud_const_ptr in, point_cloud& pc) const
+{
+  pc.clear();
+  pc.reserve(in->size());
+
+  // View the xyz of each point as a row, skipping the padding PCL stores with each point
+  using PointsMap = Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>, Eigen::Unaligned,
+                               Eigen::OuterStride<>>;
+  const Eigen::Index stride = sizeof(point_t) / sizeof(float);
+
+  PointBatch batch(BATCH_SIZE, 3);
+  BatchMask keep(BATCH_SIZE);
+  for (size_t start = 0; start < in->size(); start += BATCH_SIZE)
+  {
+    size_t count = std::min(BATCH_SIZE, in->size() - start);
+    PointsMap points(&in->points[start].x, count, 3, Eigen::OuterStride<>(stride));
+    batch.topRows(count) = points;
+    accept(batch.topRows(count), keep);
+    for (size_t i = 0; i < count; ++i)
+      if (keep[i])
+        pc.points.push_back(in->points[start + i]);
+  }
+  pc.width = pc.points.size();
+  pc.height = 1;
+  pc.header = in->header;
+}
+
+void InputCloudFilter::filter_pcl(point_cloud_const_ptr in, point_cloud& pc)
 {
   // Filter out bounds
   point_cloud_ptr tmp(boost::make_shared<point_cloud>());
@@ -21,8 +56,107 @@ void InputCloudFilter::filter(point_cloud_const_ptr in, point_cloud& pc)
   robot_filter_.filter(pc);
 }
 
+bool InputCloudFilter::inside_bounds_polygon(float x, float y) const
+{
+  bool inside = false;
+  for (size_t i = 0, j = bounds_.size() - 1; i < bounds_.size(); j = i++)
+  {
+    Eigen::Vector2f const& a = bounds_[i];
+    Eigen::Vector2f const& b = bounds_[j];
+    if ((a.y() > y) != (b.y() > y) && x < (b.x() - a.x()) * (y - a.y()) / (b.y() - a.y()) + a.x())
+      inside = !inside;
+  }
+  return inside;
+}
+
+bool InputCloudFilter::accept(point_t const& point) const
+{
+  // Reject points inside the robot footprint
+  Eigen::Vector3f local = robot_inverse_ * point.getVector3fMap();
+  if ((local.array() >= footprint_min_.array()).all() && (local.array() <= footprint_max_.array()).all())
+    return false;
+
+  // Accept everything if bounds have not been set yet
+  if (bounds_.empty())
+    return true;
+
+  if (!bounds_convex_)
+    return inside_bounds_polygon(point.x, point.y);
+
+  for (Eigen::Vector3f const& plane : half_planes_)
+    if (plane.x() * point.x + plane.y() * point.y + plane.z() < 0.f)
+      return false;
+  return true;
+}
+
+void InputCloudFilter::accept(Eigen::Ref<const PointBatch> const& points, BatchMask& keep) const
+{
+  auto x = points.col(0).array();
+  auto y = points.col(1).array();
+  auto z = points.col(2).array();
+
+  // Reject points inside the robot footprint, testing each row of the transform into the robot frame
+  Eigen::Matrix3f const& r = robot_inverse_.linear();
+  Eigen::Vector3f const& t = robot_inverse_.translation();
+  keep.setConstant(points.rows(), false);
+  for (int i = 0; i < 3; ++i)
+  {
+    Eigen::ArrayXf local = r(i, 0) * x + r(i, 1) * y + r(i, 2) * z + t(i);
+    keep = keep || (local < footprint_min_(i)) || (local > footprint_max_(i));
+  }
+
+  // Accept everything if bounds have not been set yet
+  if (bounds_.empty())
+    return;
+
+  if (!bounds_convex_)
+  {
+    for (Eigen::Index i = 0; i < points.rows(); ++i)
+      keep[i] = keep[i] && inside_bounds_polygon(points(i, 0), points(i, 1));
+    return;
+  }
+
+  for (Eigen::Vector3f const& plane : half_planes_)
+    keep = keep && (plane.x() * x + plane.y() * y + plane.z() >= 0.f);
+}
+
 void InputCloudFilter::set_bounds(point_cloud_ptr bounds)
 {
+  bounds_.clear();
+  for (point_t const& point : *bounds)
+    bounds_.emplace_back(point.x, point.y);
+
+  // Precompute edge half-planes if the polygon is convex, oriented so the inside is non-negative
+  half_planes_.clear();
+  bounds_convex_ = bounds_.size() >= 3;
+  float orientation = 0.f;
+  for (size_t i = 0; i < bounds_.size() && bounds_convex_; ++i)
+  {
+    Eigen::Vector2f const& a = bounds_[i];
+    Eigen::Vector2f const& b = bounds_[(i + 1) % bounds_.size()];
+    Eigen::Vector2f const& c = bounds_[(i + 2) % bounds_.size()];
+    float cross = (b.x() - a.x()) * (c.y() - b.y()) - (b.y() - a.y()) * (c.x() - b.x());
+    if (cross == 0.f)
+      continue;
+    if (orientation == 0.f)
+      orientation = cross > 0.f ? 1.f : -1.f;
+    else if (cross * orientation < 0.f)
+      bounds_convex_ = false;
+  }
+  bounds_convex_ = bounds_convex_ && orientation != 0.f;
+  if (bounds_convex_)
+  {
+    for (size_t i = 0; i < bounds_.size(); ++i)
+    {
+      Eigen::Vector2f const& a = bounds_[i];
+      Eigen::Vector2f const& b = bounds_[(i + 1) % bounds_.size()];
+      // Inside is to the left of each edge for counter clockwise polygons
+      float nx = -(b.y() - a.y()) * orientation;
+      float ny = (b.x() - a.x()) * orientation;
+      half_planes_.emplace_back(nx, ny, -(nx * a.x() + ny * a.y()));
+    }
+  }
+
   pcl::Vertices indicies;
   indicies.vertices.reserve(bounds->size());
   for (size_t i = 0; i < bounds->size(); ++i)
@@ -37,12 +171,15 @@ void InputCloudFilter::set_robot_footprint(Eigen::Vector4f const& min, Eigen::Ve
 {
   robot_filter_.setMin(min);
   robot_filter_.setMax(max);
+  footprint_min_ = min.head<3>();
+  footprint_max_ = max.head<3>();
 }
 
 void InputCloudFilter::set_robot_pose(Eigen::Affine3d const& transform)
 {
   Eigen::Affine3f transform_float = transform.inverse().cast<float>();
   robot_filter_.setTransform(transform_float);
+  robot_inverse_ = transform_float;
 }
 
 }  // namespace pcodar
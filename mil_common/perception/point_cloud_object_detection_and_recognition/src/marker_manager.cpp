@@ -21,12 +21,18 @@ void MarkerManager::initialize(ros::NodeHandle& nh, std::shared_ptr<ObjectMap> _
 {
   this->objects_ = _objects;
   nh.getParam("classifications", classifications_);
+  diff_ = true;
+  nh.param<bool>("marker_diff", diff_, diff_);
+  double rate = 5.;
+  nh.param<double>("marker_rate", rate, rate);
+  period_ = rate > 0. ? ros::Duration(1. / rate) : ros::Duration(0.);
   interactive_marker_server_.reset(new interactive_markers::InteractiveMarkerServer("pcodar_objects", "", false));
 }
 
 void MarkerManager::reset()
 {
   interactive_marker_server_->clear();
+  sent_.clear();
 }
 
 void MarkerManager::feedbackCb(const visualization_msgs::InteractiveMarkerFeedbackConstPtr& feedback)
@@ -41,14 +47,10 @@ void MarkerManager::feedbackCb(const visualization_msgs::InteractiveMarkerFeedba
     return;
   std::string new_classification = classifications_.at(classification_idx);
 
-  // Find the object with this name in the database
+  // Queue the change for the object with this name, applied on the next update
   int id = std::stoi((*feedback).marker_name.substr(6));
-  auto it = objects_->objects_.find(id);
-  if (it == objects_->objects_.end())
-    return;
-
-  // Update the classification
-  (*it).second.set_classification(new_classification);
+  std::lock_guard<std::mutex> lock(pending_classifications_mutex_);
+  pending_classifications_.emplace_back(id, new_classification);
 }
 
 void MarkerManager::update_interactive_marker(mil_msgs::PerceptionObject const& object)
@@ -136,23 +138,55 @@ void MarkerManager::update_interactive_marker(mil_msgs::PerceptionObject const&
 
 void MarkerManager::update_markers()
 {
-  // Update / add markers for each object in database
-  for (const auto& pair : objects_->objects_)
+  // Apply classifications selected in rviz since last update
   {
-    mil_msgs::PerceptionObject const& msg = pair.second.as_msg();
-    update_interactive_marker(msg);
+    std::lock_guard<std::mutex> lock(pending_classifications_mutex_);
+    for (auto const& pending : pending_classifications_)
+    {
+      auto it = objects_->objects_.find(pending.first);
+      if (it != objects_->objects_.end())
+        objects_->set_classification(it, pending.second);
+    }
+    pending_classifications_.clear();
   }
 
+  // Changes are sent on a later update if this one is too soon after the last (unless time jumped backwards)
+  ros::Time now = ros::Time::now();
+  if (now >= last_update_ && now - last_update_ < period_)
+    return;
+  last_update_ = now;
+
   // Remove and objects that were deleted from the marker server
   for (auto id : objects_->just_removed_)
   {
     std::string name = marker_name(id);
     interactive_marker_server_->erase(name);
+    sent_.erase(id);
   }
   objects_->just_removed_.clear();
 
+  update_changed_markers();
+
   // Publish marker changes to RVIZ clients
   interactive_marker_server_->applyChanges();
 }
 
+void MarkerManager::update_changed_markers()
+{
+  // Update / add markers for each object in database which changed since it was last sent
+  for (const auto& pair : objects_->objects_)
+  {
+    Object const& object = pair.second;
+    if (diff_)
+    {
+      auto sent = sent_.find(pair.first);
+      if (sent != sent_.end() && (*sent).second.version == object.get_version() &&
+          (*sent).second.labeled_classification == object.get_classification())
+        continue;
+      sent_[pair.first] = Sent{ object.get_version(), object.get_classification() };
+    }
+    update_interactive_marker(object.as_msg());
+  }
+}
+
 }  // pcodar namespace
@@ -1,13 +1,27 @@
 #include <point_cloud_object_detection_and_recognition/object.hpp>
+#include <point_cloud_object_detection_and_recognition/cloud_pool.hpp>
+
+#include <mil_tools/msg_helpers.hpp>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include <tf2/LinearMath/Quaternion.h>
 
+#include <algorithm>
+
 namespace pcodar
 {
+std::atomic<uint64_t> Object::version_counter_(0);
+
 Object::Object(point_cloud_ptr const& _pc, uint id, KdTreePtr const& search_tree)
+  : msg_dirty_(true)
+  , msg_points_(MSG_POINTS_FULL)
+  , msg_max_points_(0)
+  , has_features_(false)
+  , confidence_(0.)
+  , hits_(0)
+  , last_seen_(0)
 {
   set_id(id);
   set_classification("UNKNOWN");
@@ -18,7 +32,30 @@ void Object::update_points(point_cloud_ptr const& pc, KdTree::Ptr const& search_
 {
   points_ = pc;
   search_tree_ = search_tree;
-  update_msg();
+  compact_points_.clear();
+  version_ = ++version_counter_;
+  update_bounds();
+}
+
+void Object::update_points(point_cloud const& pc)
+{
+  // Reuse storage if nothing else references it (besides the search tree) and it would not be mostly unused
+  size_t capacity = points_ ? points_->points.capacity() : 0;
+  bool reuse = points_ && points_.use_count() <= 2 && pc.size() <= capacity && pc.size() * 4 >= capacity;
+  if (!reuse)
+    points_ = boost::make_shared<point_cloud>();
+  if (!search_tree_ || !search_tree_.unique())
+    search_tree_ = boost::make_shared<KdTree>();
+
+  points_->points.assign(pc.begin(), pc.end());
+  points_->width = points_->points.size();
+  points_->height = 1;
+  points_->header = pc.header;
+  search_tree_->setInputCloud(points_);
+  compact_points_.clear();
+
+  version_ = ++version_counter_;
+  update_bounds();
 }
 
 KdTree::Ptr Object::get_search_tree() const
@@ -36,58 +73,244 @@ point_cloud_ptr Object::get_points_ptr() const
   return points_;
 }
 
+point_cloud const& Object::get_points(point_cloud& buffer) const
+{
+  if (points_)
+    return *points_;
+  compact_points_.decode(buffer);
+  return buffer;
+}
+
+size_t Object::num_points() const
+{
+  return points_ ? points_->size() : compact_points_.size();
+}
+
+void Object::compact(point_cloud_ptr& pc, KdTreePtr& search_tree)
+{
+  pc.reset();
+  search_tree.reset();
+  if (!points_ || points_->empty())
+    return;
+  compact_points_.assign(*points_);
+  pc.swap(points_);
+  search_tree.swap(search_tree_);
+}
+
+void Object::expand(point_cloud_ptr const& pc, KdTreePtr const& search_tree)
+{
+  if (points_)
+    return;
+  compact_points_.decode(*pc);
+  search_tree->setInputCloud(pc);
+  points_ = pc;
+  search_tree_ = search_tree;
+  compact_points_.clear();
+}
+
+bool Object::is_compact() const
+{
+  return !points_;
+}
+
+size_t Object::memory_usage() const
+{
+  return cloud_memory_usage(points_.get(), search_tree_.get()) + compact_points_.memory_usage();
+}
+
 mil_msgs::PerceptionObject const& Object::as_msg() const
 {
+  if (msg_dirty_)
+    update_msg();
   return msg_;
 }
 
 point_t const& Object::get_center() const
 {
+  if (msg_dirty_)
+    update_msg();
   return center_;
 }
 
+point_t const& Object::get_min() const
+{
+  return min_;
+}
+
+point_t const& Object::get_max() const
+{
+  return max_;
+}
+
+uint64_t Object::get_version() const
+{
+  return version_;
+}
+
+void Object::hit(uint64_t step, float gain)
+{
+  // Several clusters in one step only count once
+  if (hits_ && last_seen_ == step)
+    return;
+  confidence_ = std::min(confidence_ + gain, 1.f);
+  ++hits_;
+  last_seen_ = step;
+}
+
+void Object::miss(float decay)
+{
+  confidence_ = std::max(confidence_ - decay, 0.f);
+}
+
+void Object::merge_track(Object const& other)
+{
+  confidence_ = std::max(confidence_, other.confidence_);
+  hits_ = std::max(hits_, other.hits_);
+  last_seen_ = std::max(last_seen_, other.last_seen_);
+}
+
+void Object::restore_track(float confidence, uint32_t hits)
+{
+  confidence_ = confidence;
+  hits_ = hits;
+  last_seen_ = 0;
+}
+
+float Object::get_confidence() const
+{
+  return confidence_;
+}
+
+uint32_t Object::get_hits() const
+{
+  return hits_;
+}
+
+uint64_t Object::get_last_seen() const
+{
+  return last_seen_;
+}
+
+ObjectTrack const& Object::get_track() const
+{
+  return track_;
+}
+
+ObjectTrack& Object::get_track()
+{
+  return track_;
+}
+
+void Object::set_msg_points(MsgPoints mode, size_t max_points)
+{
+  if (mode == msg_points_ && max_points == msg_max_points_)
+    return;
+  msg_points_ = mode;
+  msg_max_points_ = max_points;
+  // The message's points change, so consumers tracking versions need to resend it
+  version_ = ++version_counter_;
+  msg_dirty_ = true;
+}
+
 void Object::set_classification(std::string const& classification)
 {
   msg_.labeled_classification = classification;
 }
 
+std::string const& Object::get_classification() const
+{
+  return msg_.labeled_classification;
+}
+
 void Object::set_id(uint id)
 {
   msg_.id = id;
 }
 
-void Object::update_msg()
+void Object::set_features(ClusterFeatures const& features)
 {
+  features_ = features;
+  has_features_ = true;
+}
+
+ClusterFeatures const* Object::get_features() const
+{
+  return has_features_ ? &features_ : nullptr;
+}
+
+void Object::update_bounds()
+{
+  msg_dirty_ = true;
+  has_features_ = false;
+  if (!points_ || points_->empty())
+    return;
+  min_ = point_t(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                 std::numeric_limits<float>::max());
+  max_ = point_t(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                 -std::numeric_limits<float>::max());
+  for (point_t const& point : *points_)
+  {
+    min_.x = std::min(min_.x, point.x);
+    min_.y = std::min(min_.y, point.y);
+    min_.z = std::min(min_.z, point.z);
+    max_.x = std::max(max_.x, point.x);
+    max_.y = std::max(max_.y, point.y);
+    max_.z = std::max(max_.z, point.z);
+  }
+}
+
+void Object::update_msg() const
+{
+  msg_dirty_ = false;
+
   // Classification field is unused, always set to empty string
   msg_.classification = "";
   msg_.header.frame_id = "enu";
   msg_.header.stamp = ros::Time();
   msg_.points.clear();
 
-  if (points_->empty())
+  point_cloud decoded;
+  point_cloud const& points = get_points(decoded);
+  if (points.empty())
     return;
   std::vector<cv::Point2f> cv_points;
-  double min_z = std::numeric_limits<double>::max();
-  double max_z = -std::numeric_limits<double>::max();
-  for (point_t const& point : *points_)
-  {
+  cv_points.reserve(points.size());
+  for (point_t const& point : points)
     cv_points.emplace_back(point.x, point.y);
-    if (point.z > max_z)
-    {
-      max_z = point.z;
-    }
-
-    if (point.z < min_z)
-    {
-      min_z = point.z;
-    }
+
+  auto add_point = [this](point_t const& point) {
     geometry_msgs::Point32 g_point;
     g_point.x = point.x;
     g_point.y = point.y;
     g_point.z = point.z;
-
     msg_.points.emplace_back(g_point);
+  };
+  if (MSG_POINTS_HULL == msg_points_)
+  {
+    // Only the points on the convex hull of the object from above
+    std::vector<int> hull;
+    cv::convexHull(cv_points, hull, false, false);
+    msg_.points.reserve(hull.size());
+    for (int index : hull)
+      add_point(points[index]);
+  }
+  else if (MSG_POINTS_DECIMATED == msg_points_ && msg_max_points_ && points.size() > msg_max_points_)
+  {
+    // Every nth point, so that at most msg_max_points_ are included
+    size_t stride = (points.size() + msg_max_points_ - 1) / msg_max_points_;
+    msg_.points.reserve(msg_max_points_);
+    for (size_t i = 0; i < points.size(); i += stride)
+      add_point(points[i]);
   }
+  else
+  {
+    // Every point, copied in one go
+    msg_.points.resize(points.size());
+    mil_tools::xyz_map(msg_.points) = points.getMatrixXfMap(3, sizeof(point_t) / sizeof(float), 0);
+  }
+
+  double min_z = min_.z;
+  double max_z = max_.z;
   cv::RotatedRect rect = cv::minAreaRect(cv_points);
   center_.x = rect.center.x;
   center_.y = rect.center.y;
@@ -1,69 +1,525 @@
 #include <point_cloud_object_detection_and_recognition/object_associator.hpp>
 
 #include <mil_msgs/PerceptionObject.h>
-#include <pcl/registration/correspondence_estimation.h>
-#include <pcl/registration/correspondence_rejection_trimmed.h>
-#include <pcl/search/octree.h>
+#include <pcl/common/common.h>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace pcodar
 {
-void Associator::associate(ObjectMap& prev_objects, point_cloud const& pc, clusters_t clusters)
+namespace
 {
-  // Tracks which clusters have been seen
-  std::unordered_set<uint> seen;
+/// Center of a bounding box in the x / y plane, used as the measured position of a cluster or object
+ObjectTrack::Vector2 box_center(point_t const& min, point_t const& max)
+{
+  return ObjectTrack::Vector2((min.x + max.x) / 2., (min.y + max.y) / 2.);
+}
 
-  // Iterate through each new cluster, finding which persistent cluster(s) it matches
-  for (cluster_t const& cluster : clusters)
+}  // anonymous namespace
+
+bool Associator::any_within_distance(point_cloud const& points, KdTree& search_tree) const
+{
+  std::vector<int> indices(1);
+  std::vector<float> distances(1);
+  for (point_t const& point : points)
   {
-    // Make pointcloud from this pointcloud
-    point_cloud_ptr cluster_pc = boost::make_shared<point_cloud>(pc, cluster.indices);
-    KdTreePtr cluster_search_tree = boost::make_shared<KdTree>();
-    cluster_search_tree->setInputCloud(cluster_pc);
+    // Stop at the first correspondence, any one is enough to associate
+    if (search_tree.radiusSearch(point, max_distance_, indices, distances, 1) > 0)
+      return true;
+  }
+  return false;
+}
 
-    using CorrespondenceEstimation = pcl::registration::CorrespondenceEstimation<point_t, point_t>;
-    CorrespondenceEstimation ce;
-    ce.setSearchMethodTarget(cluster_search_tree, true);
-    ce.setInputTarget(cluster_pc);
+void Associator::index_object(uint id, Object const& object)
+{
+  // Objects without points (ex: from simulation) never associate
+  if (!object.num_points())
+    return;
+  index_.insert(id, object.get_min(), object.get_max());
+}
 
-    using ObjectMapIt = decltype(prev_objects.objects_.begin());
-    std::vector<ObjectMapIt> matches;
-    for (auto pair = prev_objects.objects_.begin(); pair != prev_objects.objects_.end(); ++pair)
-    {
-      ce.setSearchMethodSource((*pair).second.get_search_tree(), true);
-      ce.setInputSource((*pair).second.get_points_ptr());
+bool Associator::is_stable(Object const& object) const
+{
+  return stable_hits_ > 0 && object.get_hits() >= stable_hits_;
+}
 
-      pcl::CorrespondencesPtr correspondences = boost::make_shared<pcl::Correspondences>();
-      ce.determineCorrespondences(*correspondences, max_distance_);
+void Associator::evict(ObjectMap& objects)
+{
+  if (!max_objects_ || objects.objects_.size() <= max_objects_)
+    return;
 
-      if (correspondences->size() > 0)
-        matches.push_back(pair);
-    }
+  // Order objects so unstable ones come first, then the least recently seen. Objects without points (ex: from
+  // simulation) are never evicted.
+  eviction_.clear();
+  for (auto const& pair : objects.objects_)
+    if (pair.second.num_points())
+      eviction_.emplace_back(!is_stable(pair.second), pair.second.get_last_seen(), pair.first);
+  size_t count = std::min(objects.objects_.size() - max_objects_, eviction_.size());
+  if (!count)
+    return;
+  auto older = [](std::tuple<bool, uint64_t, uint> const& a, std::tuple<bool, uint64_t, uint> const& b) {
+    if (std::get<0>(a) != std::get<0>(b))
+      return std::get<0>(a);
+    return std::get<1>(a) < std::get<1>(b);
+  };
+  std::nth_element(eviction_.begin(), eviction_.begin() + (count - 1), eviction_.end(), older);
+  for (size_t i = 0; i < count; ++i)
+  {
+    uint id = std::get<2>(eviction_[i]);
+    index_.remove(id);
+    objects.erase_object(objects.objects_.find(id));
+  }
+}
+
+bool Associator::load_cluster(point_cloud const& pc, cluster_t const& cluster, point_t& min, point_t& max)
+{
+  // Copy cluster's points into reused buffer
+  cluster_pc_.points.clear();
+  for (int index : cluster.indices)
+    cluster_pc_.points.push_back(pc.points[index]);
+  cluster_pc_.width = cluster_pc_.points.size();
+  cluster_pc_.height = 1;
+  if (cluster_pc_.empty())
+    return false;
+  pcl::getMinMax3D(cluster_pc_, min, max);
+  return true;
+}
+
+void Associator::find_nearby(ObjectMap& objects, point_t const& min, point_t const& max,
+                             std::vector<ObjectMap::Iterator>& matches)
+{
+  matches.clear();
+
+  // Broad phase: only consider objects whose bounding box is within the max distance of the cluster's
+  point_t query_min(min.x - max_distance_, min.y - max_distance_, min.z - max_distance_);
+  point_t query_max(max.x + max_distance_, max.y + max_distance_, max.z + max_distance_);
+  index_.query(query_min, query_max, candidates_);
+
+  double max_distance_squared = max_distance_ * max_distance_;
+  for (uint id : candidates_)
+  {
+    auto pair = objects.objects_.find(id);
+    if (pair == objects.objects_.end())
+      continue;
+    Object const& object = (*pair).second;
+
+    if (bounding_box_distance_squared(min, max, object.get_min(), object.get_max()) > max_distance_squared)
+      continue;
+
+    // Narrow phase: search the object's existing tree for any cluster point near the object
+    objects.expand_object(pair);
+    narrow_phase_.insert(id);
+    if (any_within_distance(cluster_pc_, *object.get_search_tree()))
+      matches.push_back(pair);
+  }
+}
+
+uint Associator::add_cluster(ObjectMap& objects)
+{
+  // Add to object, recycling storage from previously erased objects
+  point_cloud_ptr cluster_cloud;
+  KdTreePtr cluster_search_tree;
+  objects.pool_.acquire(cluster_pc_, cluster_cloud, cluster_search_tree);
+  auto id = objects.add_object(cluster_cloud, cluster_search_tree);
+  objects.objects_.at(id).hit(step_, hit_gain_);
+  return id;
+}
+
+ObjectTrack::Matrix2 Associator::measurement_noise(point_t const& min, point_t const& max) const
+{
+  // The visible part of a large object changes, moving its center by up to half its size
+  ObjectTrack::Matrix2 noise = ObjectTrack::Matrix2::Zero();
+  double half_x = (max.x - min.x) / 2.;
+  double half_y = (max.y - min.y) / 2.;
+  noise(0, 0) = measurement_std_ * measurement_std_ + half_x * half_x;
+  noise(1, 1) = measurement_std_ * measurement_std_ + half_y * half_y;
+  return noise;
+}
+
+void Associator::set_features(Object& object, size_t cluster) const
+{
+  if (features_ && cluster < features_->size())
+    object.set_features((*features_)[cluster]);
+}
+
+void Associator::associate_nearest(ObjectMap& objects, point_cloud const& pc, clusters_t const& clusters,
+                                   std::unordered_set<uint>& seen)
+{
+  // Index every existing object by its bounding box. Cells at least as large as the max distance mean
+  // a query only needs to grow by one cell in each direction.
+  index_.clear();
+  for (auto const& pair : objects.objects_)
+    index_object(pair.first, pair.second);
+
+  // Iterate through each new cluster, finding which persistent cluster(s) it matches
+  std::vector<ObjectMap::Iterator> matches;
+  for (size_t c = 0; c < clusters.size(); ++c)
+  {
+    point_t min, max;
+    if (!load_cluster(pc, clusters[c], min, max))
+      continue;
+    find_nearby(objects, min, max, matches);
 
     if (matches.size() == 0)
     {
-      // Add to object
-      auto id = prev_objects.add_object(cluster_pc, cluster_search_tree);
+      auto id = add_cluster(objects);
+      set_features(objects.objects_.at(id), c);
+      index_object(id, objects.objects_.at(id));
       seen.insert(id);
     }
     else
     {
       seen.insert((*matches.at(0)).first);
-      (*matches.at(0)).second.update_points(cluster_pc, cluster_search_tree);
+      objects.update_points(matches.at(0), cluster_pc_);
+      Object& object = (*matches.at(0)).second;
+      set_features(object, c);
+      object.hit(step_, hit_gain_);
+      index_object((*matches.at(0)).first, object);
       for (size_t i = 1; i < matches.size(); ++i)
       {
-        prev_objects.erase_object(matches.at(i));
+        object.merge_track((*matches.at(i)).second);
+        index_.remove((*matches.at(i)).first);
+        objects.erase_object(matches.at(i));
       }
     }
   }
+}
+
+void Associator::associate_nearest_parallel(ObjectMap& objects, point_cloud const& pc, clusters_t const& clusters,
+                                            std::unordered_set<uint>& seen)
+{
+  index_.clear();
+  for (auto const& pair : objects.objects_)
+    index_object(pair.first, pair.second);
+
+  // The pool is not thread safe, so take storage for every cluster up front
+  parallel_clusters_.resize(clusters.size());
+  for (ParallelCluster& work : parallel_clusters_)
+    objects.pool_.acquire(work.cloud, work.search_tree);
+
+  // Copy out each cluster, build its search tree, and find the objects whose bounding box is near it
+  double max_distance_squared = max_distance_ * max_distance_;
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < clusters.size(); ++i)
+  {
+    ParallelCluster& work = parallel_clusters_[i];
+    point_cloud& cloud = *work.cloud;
+    cloud.points.clear();
+    for (int index : clusters[i].indices)
+      cloud.points.push_back(pc.points[index]);
+    cloud.width = cloud.points.size();
+    cloud.height = 1;
+    work.candidates.clear();
+    work.matches.clear();
+    work.valid = !cloud.empty();
+    if (!work.valid)
+      continue;
+    pcl::getMinMax3D(cloud, work.min, work.max);
+    work.search_tree->setInputCloud(work.cloud);
+
+    point_t query_min(work.min.x - max_distance_, work.min.y - max_distance_, work.min.z - max_distance_);
+    point_t query_max(work.max.x + max_distance_, work.max.y + max_distance_, work.max.z + max_distance_);
+    std::vector<uint> candidates;
+    index_.query(query_min, query_max, candidates);
+    for (uint id : candidates)
+    {
+      Object const& object = objects.objects_.at(id);
+      if (bounding_box_distance_squared(work.min, work.max, object.get_min(), object.get_max()) <=
+          max_distance_squared)
+        work.candidates.push_back(id);
+    }
+  }
+
+  // Compact objects change the map when expanded, so are expanded before searching them
+  for (ParallelCluster const& work : parallel_clusters_)
+    for (uint id : work.candidates)
+    {
+      objects.expand_object(objects.objects_.find(id));
+      narrow_phase_.insert(id);
+    }
+
+  // Search the trees of the candidates for any cluster point near them
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < clusters.size(); ++i)
+  {
+    ParallelCluster& work = parallel_clusters_[i];
+    for (uint id : work.candidates)
+      if (any_within_distance(*work.cloud, *objects.objects_.at(id).get_search_tree()))
+        work.matches.push_back(id);
+  }
 
-  // forget any objects that we didn't see, if that functionality is enabled
-  if (forget_unseen_)
+  // Apply each cluster in order, as associate_nearest would. Only the objects which earlier clusters changed need to
+  // be searched again, the rest are as they were when matched above.
+  changed_.clear();
+  std::vector<ObjectMap::Iterator> matches;
+  for (size_t i = 0; i < clusters.size(); ++i)
+  {
+    ParallelCluster& work = parallel_clusters_[i];
+    if (!work.valid)
+    {
+      objects.pool_.release(work.cloud, work.search_tree);
+      work.cloud.reset();
+      work.search_tree.reset();
+      continue;
+    }
+
+    match_ids_.clear();
+    for (uint id : work.matches)
+      if (!changed_.count(id) && objects.objects_.count(id))
+        match_ids_.push_back(id);
+    for (uint id : changed_)
+    {
+      auto pair = objects.objects_.find(id);
+      if (pair == objects.objects_.end())
+        continue;
+      Object const& object = (*pair).second;
+      if (bounding_box_distance_squared(work.min, work.max, object.get_min(), object.get_max()) <=
+              max_distance_squared &&
+          any_within_distance(*work.cloud, *object.get_search_tree()))
+        match_ids_.push_back(id);
+    }
+    std::sort(match_ids_.begin(), match_ids_.end());
+    matches.clear();
+    for (uint id : match_ids_)
+      matches.push_back(objects.objects_.find(id));
+
+    if (matches.empty())
+    {
+      auto id = objects.add_object(work.cloud, work.search_tree);
+      Object& object = objects.objects_.at(id);
+      object.hit(step_, hit_gain_);
+      set_features(object, i);
+      index_object(id, object);
+      seen.insert(id);
+      changed_.insert(id);
+    }
+    else
+    {
+      uint id = (*matches.at(0)).first;
+      seen.insert(id);
+      changed_.insert(id);
+      objects.update_points(matches.at(0), work.cloud, work.search_tree);
+      Object& object = (*matches.at(0)).second;
+      set_features(object, i);
+      object.hit(step_, hit_gain_);
+      index_object(id, object);
+      for (size_t j = 1; j < matches.size(); ++j)
+      {
+        object.merge_track((*matches.at(j)).second);
+        index_.remove((*matches.at(j)).first);
+        objects.erase_object(matches.at(j));
+      }
+    }
+    // The object owns them now
+    work.cloud.reset();
+    work.search_tree.reset();
+  }
+}
+
+void Associator::associate_tracked(ObjectMap& objects, point_cloud const& pc, clusters_t const& clusters,
+                                   double stamp, std::unordered_set<uint>& seen)
+{
+  // Predict every track to the time of the clusters, indexing each object by the bounding box of its gate
+  index_.clear();
+  for (auto& pair : objects.objects_)
+  {
+    Object& object = pair.second;
+    if (!object.num_points())
+      continue;
+    ObjectTrack& track = object.get_track();
+    ObjectTrack::Matrix2 noise = measurement_noise(object.get_min(), object.get_max());
+    if (!track.initialized())
+      track.initialize(box_center(object.get_min(), object.get_max()), stamp, noise, initial_velocity_std_);
+    else
+      track.predict(stamp, accel_std_);
+    ObjectTrack::Matrix2 innovation = track.innovation_covariance(noise);
+    ObjectTrack::Vector2 predicted = track.get_position();
+    double reach_x = std::sqrt(gate_ * innovation(0, 0));
+    double reach_y = std::sqrt(gate_ * innovation(1, 1));
+    index_.insert(pair.first, point_t(predicted.x() - reach_x, predicted.y() - reach_y, object.get_min().z),
+                  point_t(predicted.x() + reach_x, predicted.y() + reach_y, object.get_max().z));
+  }
+
+  // Gate each cluster's center against the objects whose gate could contain it
+  tracked_clusters_.resize(clusters.size());
+  gated_.clear();
+  for (size_t i = 0; i < clusters.size(); ++i)
+  {
+    TrackedCluster& tracked = tracked_clusters_[i];
+    tracked.assigned = false;
+    tracked.valid = load_cluster(pc, clusters[i], tracked.min, tracked.max);
+    if (!tracked.valid)
+      continue;
+    ObjectTrack::Vector2 center = box_center(tracked.min, tracked.max);
+    point_t query(center.x(), center.y(), (tracked.min.z + tracked.max.z) / 2.);
+    index_.query(query, query, candidates_);
+    for (uint id : candidates_)
+    {
+      auto pair = objects.objects_.find(id);
+      if (pair == objects.objects_.end())
+        continue;
+      Object const& object = (*pair).second;
+      double distance =
+          object.get_track().mahalanobis_squared(center, measurement_noise(object.get_min(), object.get_max()));
+      if (distance <= gate_)
+        gated_.emplace_back(distance, i, id);
+    }
+  }
+
+  // Assign gated pairs one to one
+  if (assignment_ == ASSIGNMENT_HUNGARIAN && !gated_.empty())
+  {
+    std::unordered_map<size_t, size_t> rows;
+    std::unordered_map<uint, size_t> cols;
+    std::vector<size_t> row_clusters;
+    std::vector<uint> col_objects;
+    for (auto const& pair : gated_)
+    {
+      if (rows.emplace(std::get<1>(pair), rows.size()).second)
+        row_clusters.push_back(std::get<1>(pair));
+      if (cols.emplace(std::get<2>(pair), cols.size()).second)
+        col_objects.push_back(std::get<2>(pair));
+    }
+    // Pairs outside the gate cost more than any combination of pairs inside it, so are only used when unavoidable
+    double outside = gate_ * (gated_.size() + 1) + 1.;
+    cost_.assign(rows.size() * cols.size(), outside);
+    for (auto const& pair : gated_)
+      cost_[rows[std::get<1>(pair)] * cols.size() + cols[std::get<2>(pair)]] = std::get<0>(pair);
+    solve_assignment(cost_, rows.size(), cols.size(), row_to_col_);
+    for (size_t row = 0; row < rows.size(); ++row)
+    {
+      int col = row_to_col_[row];
+      if (col < 0 || cost_[row * cols.size() + col] >= outside)
+        continue;
+      TrackedCluster& tracked = tracked_clusters_[row_clusters[row]];
+      tracked.assigned = true;
+      tracked.object = col_objects[col];
+      seen.insert(tracked.object);
+    }
+  }
+  else
+  {
+    std::sort(gated_.begin(), gated_.end());
+    for (auto const& pair : gated_)
+    {
+      TrackedCluster& tracked = tracked_clusters_[std::get<1>(pair)];
+      if (tracked.assigned || seen.count(std::get<2>(pair)))
+        continue;
+      tracked.assigned = true;
+      tracked.object = std::get<2>(pair);
+      seen.insert(tracked.object);
+    }
+  }
+
+  // Correct the tracks of assigned objects with their cluster
+  for (size_t i = 0; i < clusters.size(); ++i)
+  {
+    TrackedCluster const& tracked = tracked_clusters_[i];
+    if (!tracked.assigned)
+      continue;
+    point_t min, max;
+    load_cluster(pc, clusters[i], min, max);
+    auto pair = objects.objects_.find(tracked.object);
+    objects.update_points(pair, cluster_pc_);
+    Object& object = (*pair).second;
+    set_features(object, i);
+    object.get_track().update(box_center(min, max), measurement_noise(min, max));
+    object.hit(step_, hit_gain_);
+  }
+
+  // Clusters outside every gate (ex: a large object whose visible part moved) fall back to the nearest point rule
+  // against the remaining objects, otherwise they become new objects
+  index_.clear();
+  for (auto const& pair : objects.objects_)
+    if (!seen.count(pair.first))
+      index_object(pair.first, pair.second);
+  std::vector<ObjectMap::Iterator> matches;
+  for (size_t i = 0; i < clusters.size(); ++i)
+  {
+    TrackedCluster const& tracked = tracked_clusters_[i];
+    if (!tracked.valid || tracked.assigned)
+      continue;
+    point_t min, max;
+    load_cluster(pc, clusters[i], min, max);
+    find_nearby(objects, min, max, matches);
+    if (matches.empty())
+    {
+      auto id = add_cluster(objects);
+      set_features(objects.objects_.at(id), i);
+      objects.objects_.at(id).get_track().initialize(box_center(min, max), stamp, measurement_noise(min, max),
+                                                     initial_velocity_std_);
+      seen.insert(id);
+      continue;
+    }
+    auto pair = matches.front();
+    index_.remove((*pair).first);
+    seen.insert((*pair).first);
+    objects.update_points(pair, cluster_pc_);
+    Object& object = (*pair).second;
+    set_features(object, i);
+    object.get_track().update(box_center(min, max), measurement_noise(min, max));
+    object.hit(step_, hit_gain_);
+  }
+}
+
+void Associator::associate(ObjectMap& prev_objects, point_cloud const& pc, clusters_t const& clusters, double stamp,
+                           cluster_features_t const* features)
+{
+  ++step_;
+  features_ = features;
+  narrow_phase_.clear();
+
+  // Tracks which objects have been seen
+  std::unordered_set<uint> seen;
+
+  index_.set_cell_size(std::max(max_distance_, 1.));
+  if (tracking_)
+    associate_tracked(prev_objects, pc, clusters, stamp, seen);
+  else if (parallel_)
+    associate_nearest_parallel(prev_objects, pc, clusters, seen);
+  else
+    associate_nearest(prev_objects, pc, clusters, seen);
+
+  end_step(prev_objects, seen);
+}
+
+void Associator::repeat(ObjectMap& prev_objects)
+{
+  // Objects associated in the last step would be again, as would the clusters near the others, so those stay expanded
+  uint64_t last_step = step_++;
+  std::unordered_set<uint> seen;
+  for (auto& pair : prev_objects.objects_)
+  {
+    Object& object = pair.second;
+    if (object.num_points() && object.get_hits() && object.get_last_seen() == last_step)
+    {
+      object.hit(step_, hit_gain_);
+      seen.insert(pair.first);
+    }
+  }
+  end_step(prev_objects, seen);
+}
+
+void Associator::end_step(ObjectMap& prev_objects, std::unordered_set<uint> const& seen)
+{
+  // Decay confidence of objects that were not seen, forgetting them when it runs out unless they are stable
+  if (miss_decay_ > 0.)
   {
     for (auto pair = prev_objects.objects_.begin(); pair != prev_objects.objects_.end();)
     {
-      if (seen.find((*pair).first) == seen.end())
+      Object& object = (*pair).second;
+      // Objects without points (ex: from simulation) are never associated, so never decay
+      if (!object.num_points() || seen.find((*pair).first) != seen.end())
       {
+        ++pair;
+        continue;
+      }
+      object.miss(miss_decay_);
+      if (object.get_confidence() <= 0. && !is_stable(object))
+      {
+        index_.remove((*pair).first);
         pair = prev_objects.erase_object(pair);
       }
       else
@@ -72,12 +528,39 @@ void Associator::associate(ObjectMap& prev_objects, point_cloud const& pc, clust
       }
     }
   }
+
+  evict(prev_objects);
+  features_ = nullptr;
+
+  // Objects not seen in a while only need their bounds until they are near a cluster again. Those which were near one
+  // this step are left expanded, as they are likely to be again next step.
+  if (compact_after_steps_)
+  {
+    for (auto pair = prev_objects.objects_.begin(); pair != prev_objects.objects_.end(); ++pair)
+    {
+      Object const& object = (*pair).second;
+      if (!object.is_compact() && object.num_points() && step_ - object.get_last_seen() >= compact_after_steps_ &&
+          !narrow_phase_.count((*pair).first))
+        prev_objects.compact_object(pair);
+    }
+  }
 }
 
 void Associator::update_config(Config const& config)
 {
   max_distance_ = config.associator_max_distance;
-  forget_unseen_ = config.associator_forget_unseen;
+  hit_gain_ = config.associator_hit_gain;
+  miss_decay_ = config.associator_miss_decay;
+  stable_hits_ = config.associator_stable_hits;
+  max_objects_ = config.associator_max_objects;
+  tracking_ = config.associator_tracking;
+  gate_ = config.associator_gate_mahalanobis * config.associator_gate_mahalanobis;
+  assignment_ = static_cast<Assignment>(config.associator_assignment);
+  accel_std_ = config.associator_track_accel_std;
+  measurement_std_ = config.associator_track_measurement_std;
+  initial_velocity_std_ = config.associator_track_initial_velocity_std;
+  compact_after_steps_ = config.associator_compact_after_steps;
+  parallel_ = config.associator_parallel;
 }
 
 }  // namespace pcodar
@@ -0,0 +1,87 @@
+#include <point_cloud_object_detection_and_recognition/object_delta.hpp>
+
+namespace pcodar
+{
+ObjectDeltaEncoder::ObjectDeltaEncoder() : sequence_(0), needs_keyframe_(true)
+{
+}
+
+void ObjectDeltaEncoder::reset()
+{
+  sent_.clear();
+  needs_keyframe_ = true;
+}
+
+void ObjectDeltaEncoder::encode(ObjectMap const& objects, bool keyframe, mil_msgs::PerceptionObjectDelta& msg)
+{
+  msg.header.frame_id = "enu";
+  msg.header.stamp = ros::Time::now();
+  msg.sequence = sequence_++;
+  msg.keyframe = keyframe || needs_keyframe_;
+  msg.added.clear();
+  msg.updated.clear();
+  msg.updated_fields.clear();
+  msg.removed.clear();
+  needs_keyframe_ = false;
+
+  // Objects which were sent before but no longer exist
+  for (auto it = sent_.begin(); it != sent_.end();)
+  {
+    if (objects.objects_.find(it->first) == objects.objects_.end())
+    {
+      if (!msg.keyframe)
+        msg.removed.push_back(it->first);
+      it = sent_.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  for (auto const& pair : objects.objects_)
+  {
+    Object const& object = pair.second;
+    mil_msgs::PerceptionObject const& object_msg = object.as_msg();
+    auto sent = sent_.find(pair.first);
+
+    // New objects, or every object in a keyframe, are sent in full
+    if (msg.keyframe || sent == sent_.end())
+    {
+      msg.added.push_back(object_msg);
+      sent_[pair.first] = Sent{ object.get_version(), object_msg.labeled_classification };
+      continue;
+    }
+
+    uint8_t fields = 0;
+    if (sent->second.version != object.get_version())
+      fields |= mil_msgs::PerceptionObjectDelta::FIELD_GEOMETRY;
+    if (sent->second.labeled_classification != object_msg.labeled_classification)
+      fields |= mil_msgs::PerceptionObjectDelta::FIELD_CLASSIFICATION;
+    if (!fields)
+      continue;
+
+    // Only copy the fields which changed
+    mil_msgs::PerceptionObject update;
+    update.id = object_msg.id;
+    if (fields & mil_msgs::PerceptionObjectDelta::FIELD_GEOMETRY)
+    {
+      update.header = object_msg.header;
+      update.pose = object_msg.pose;
+      update.scale = object_msg.scale;
+      update.points = object_msg.points;
+    }
+    if (fields & mil_msgs::PerceptionObjectDelta::FIELD_CLASSIFICATION)
+    {
+      update.classification = object_msg.classification;
+      update.labeled_classification = object_msg.labeled_classification;
+      update.confidence = object_msg.confidence;
+      update.classification_confidence = object_msg.classification_confidence;
+    }
+    msg.updated.push_back(update);
+    msg.updated_fields.push_back(fields);
+    sent->second = Sent{ object.get_version(), object_msg.labeled_classification };
+  }
+}
+
+}  // namespace pcodar
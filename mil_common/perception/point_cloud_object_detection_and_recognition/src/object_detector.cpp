@@ -1,29 +1,163 @@
 #include <tf/transform_datatypes.h>
 #include <point_cloud_object_detection_and_recognition/object_detector.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 namespace pcodar
 {
+ObjectDetector::ObjectDetector()
+  : backend_(new PclClusteringBackend())
+  , backend_type_(0)
+  , cluster_tolerance_(0.)
+  , cluster_min_points_(1)
+  , range_adaptive_(false)
+  , angular_resolution_(0.)
+  , range_factor_(1.)
+  , range_bin_(10.)
+  , sensor_position_(Eigen::Vector3f::Zero())
+  , bin_cloud_(boost::make_shared<point_cloud>())
+{
+}
+
 clusters_t ObjectDetector::get_clusters(point_cloud_const_ptr pc)
 {
   clusters_t cluster_indices;
-  if (pc->empty())
-    return cluster_indices;
+  detect(*pc, cluster_indices);
+  return cluster_indices;
+}
+
+void ObjectDetector::detect(point_cloud const& pc, clusters_t& clusters)
+{
+  clusters.clear();
+  features_.clear();
+  if (pc.empty())
+    return;
 
-  // Creating the KdTree object for the search method of the extraction
-  pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
-  tree->setInputCloud(pc);
+  if (range_adaptive_)
+  {
+    detect_range_adaptive(pc, clusters);
+    return;
+  }
 
-  cluster_extractor_.setSearchMethod(tree);
-  cluster_extractor_.setInputCloud(pc);
-  cluster_extractor_.extract(cluster_indices);
+  backend_->cluster(borrow_cloud(pc), cluster_tolerance_, cluster_min_points_, clusters);
+  if (!backend_->get_features(features_))
+    features_.clear();
+}
 
-  return cluster_indices;
+double ObjectDetector::tolerance_at(double range) const
+{
+  return std::max(cluster_tolerance_, range_factor_ * range * angular_resolution_);
+}
+
+uint32_t ObjectDetector::find(uint32_t point)
+{
+  while (parent_[point] != point)
+  {
+    parent_[point] = parent_[parent_[point]];
+    point = parent_[point];
+  }
+  return point;
+}
+
+void ObjectDetector::detect_range_adaptive(point_cloud const& pc, clusters_t& clusters)
+{
+  // Bins past the last are clustered with it, at the tolerance of its furthest point
+  static const size_t MAX_BINS = 64;
+
+  ranges_.resize(pc.size());
+  bins_.resize(pc.size());
+  float max_range = 0.;
+  for (size_t i = 0; i < pc.size(); ++i)
+  {
+    ranges_[i] = (pc[i].getVector3fMap() - sensor_position_).norm();
+    bins_[i] = std::min<size_t>(ranges_[i] / range_bin_, MAX_BINS - 1);
+    max_range = std::max(max_range, ranges_[i]);
+  }
+  size_t num_bins = std::min<size_t>(max_range / range_bin_, MAX_BINS - 1) + 1;
+  auto far_edge = [&](size_t bin) { return bin + 1 == num_bins ? max_range : (bin + 1) * range_bin_; };
+
+  // Each point is clustered in its own bin and in every further bin whose tolerance reaches back to it. The near
+  // edge less the tolerance only grows with each bin, as the tolerance grows slower than the bins, so the first bin
+  // which does not reach the point ends the search.
+  if (bin_points_.size() < num_bins)
+    bin_points_.resize(num_bins);
+  for (size_t bin = 0; bin < num_bins; ++bin)
+    bin_points_[bin].clear();
+  for (uint32_t i = 0; i < pc.size(); ++i)
+  {
+    bin_points_[bins_[i]].push_back(i);
+    for (size_t bin = bins_[i] + 1; bin < num_bins && bin * range_bin_ - tolerance_at(far_edge(bin)) <= ranges_[i];
+         ++bin)
+      bin_points_[bin].push_back(i);
+  }
+
+  parent_.resize(pc.size());
+  for (uint32_t i = 0; i < pc.size(); ++i)
+    parent_[i] = i;
+  for (size_t bin = 0; bin < num_bins; ++bin)
+  {
+    std::vector<uint32_t> const& points = bin_points_[bin];
+    if (points.empty())
+      continue;
+    bin_cloud_->resize(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+      (*bin_cloud_)[i] = pc[points[i]];
+    // Every point is kept in a cluster, as a piece too small here may be part of a cluster joined across bins
+    backend_->cluster(bin_cloud_, tolerance_at(far_edge(bin)), 1, bin_clusters_);
+    for (cluster_t const& cluster : bin_clusters_)
+    {
+      uint32_t root = find(points[cluster.indices.front()]);
+      for (int index : cluster.indices)
+        parent_[find(points[index])] = root;
+    }
+  }
+
+  labels_.resize(pc.size());
+  for (uint32_t i = 0; i < pc.size(); ++i)
+    labels_[i] = find(i);
+  labels_to_clusters(labels_, cluster_min_points_, clusters);
+}
+
+cluster_features_t const& ObjectDetector::get_features() const
+{
+  return features_;
 }
 
 void ObjectDetector::update_config(Config const& config)
 {
-  cluster_extractor_.setClusterTolerance(config.cluster_tolerance_m);
-  cluster_extractor_.setMinClusterSize(config.cluster_min_points);
+  cluster_tolerance_ = config.cluster_tolerance_m;
+  cluster_min_points_ = config.cluster_min_points;
+  range_adaptive_ = config.cluster_range_adaptive;
+  angular_resolution_ = config.cluster_angular_resolution_deg * M_PI / 180.;
+  range_factor_ = config.cluster_range_tolerance_factor;
+  range_bin_ = config.cluster_range_bin_m;
+
+  if (config.cluster_backend != backend_type_)
+  {
+    backend_type_ = config.cluster_backend;
+    switch (backend_type_)
+    {
+      case 1:
+        backend_.reset(new GridClusteringBackend());
+        break;
+      case 2:
+        backend_.reset(new CudaClusteringBackend());
+        break;
+      case 3:
+        backend_.reset(new ColumnClusteringBackend());
+        break;
+      default:
+        backend_.reset(new PclClusteringBackend());
+        break;
+    }
+  }
+  backend_->update_config(config);
+}
+
+void ObjectDetector::set_sensor_position(Eigen::Vector3f const& position)
+{
+  sensor_position_ = position;
 }
 
 }  // namespace pcodar
@@ -1,34 +1,299 @@
 #include <mil_msgs/PerceptionObject.h>
 #include <point_cloud_object_detection_and_recognition/object_map.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 namespace pcodar
 {
-ObjectMap::ObjectMap() : highest_id_(0)
+namespace
+{
+/// Edge length of the cells objects are indexed into for spatial queries
+const double GRID_CELL_SIZE = 10.;
+/// Nearest object queries give up past this distance
+const double MAX_SEARCH_DISTANCE = 1e5;
+
+double distance(mil_msgs::PerceptionObject const& object, point_t const& position)
 {
+  double dx = object.pose.position.x - position.x;
+  double dy = object.pose.position.y - position.y;
+  double dz = object.pose.position.z - position.z;
+  return std::sqrt(dx * dx + dy * dy + dz * dz);
 }
 
-mil_msgs::PerceptionObjectArray ObjectMap::to_msg()
+}  // anonymous namespace
+
+ObjectMap::ObjectMap()
+  : highest_id_(0)
+  , msg_(boost::make_shared<mil_msgs::PerceptionObjectArray>())
+  , msg_points_(Object::MSG_POINTS_FULL)
+  , msg_max_points_(0)
+  , parallel_msgs_(false)
 {
-  mil_msgs::PerceptionObjectArray msg;
-  msg.objects.reserve(objects_.size());
-  for (auto& pair : objects_)
+  grid_.set_cell_size(GRID_CELL_SIZE);
+}
+
+mil_msgs::PerceptionObjectArrayConstPtr ObjectMap::to_msg()
+{
+  if (msg_dirty_ids_.empty())
+    return msg_;
+  if (!msg_.unique())
+    msg_ = boost::make_shared<mil_msgs::PerceptionObjectArray>(*msg_);
+
+  // Messages are built lazily by each object, independently of the others
+  if (parallel_msgs_)
   {
-    msg.objects.push_back(pair.second.as_msg());
+    msg_rebuild_.clear();
+    for (uint id : msg_dirty_ids_)
+    {
+      auto object = objects_.find(id);
+      if (object != objects_.end())
+        msg_rebuild_.push_back(&(*object).second);
+    }
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < msg_rebuild_.size(); ++i)
+      msg_rebuild_[i]->as_msg();
   }
-  return msg;
+
+  auto& objects = msg_->objects;
+  for (uint id : msg_dirty_ids_)
+  {
+    auto object = objects_.find(id);
+    auto index = msg_index_.find(id);
+    if (object != objects_.end())
+    {
+      // Add or replace the entry for an object
+      if (index == msg_index_.end())
+      {
+        msg_index_[id] = objects.size();
+        objects.push_back((*object).second.as_msg());
+      }
+      else
+      {
+        objects[(*index).second] = (*object).second.as_msg();
+      }
+    }
+    else if (index != msg_index_.end())
+    {
+      // Remove the entry for an erased object by moving the last entry into its place
+      size_t i = (*index).second;
+      msg_index_.erase(index);
+      if (i != objects.size() - 1)
+      {
+        objects[i] = std::move(objects.back());
+        msg_index_[objects[i].id] = i;
+      }
+      objects.pop_back();
+    }
+  }
+  msg_dirty_ids_.clear();
+  return msg_;
 }
 
 uint ObjectMap::add_object(point_cloud_ptr const& pc, KdTreePtr const& search_tree)
 {
   auto id = highest_id_++;
-  objects_.insert({ id, Object(pc, id, search_tree) });
+  auto it = objects_.insert({ id, Object(pc, id, search_tree) }).first;
+  (*it).second.set_msg_points(msg_points_, msg_max_points_);
+  index(id, (*it).second);
   return id;
 }
 
 ObjectMap::Iterator ObjectMap::erase_object(Iterator const& it)
 {
   just_removed_.push_back((*it).first);
-  return objects_.erase(it);
+  unindex((*it).first, (*it).second);
+  point_cloud_ptr points = (*it).second.get_points_ptr();
+  KdTreePtr search_tree = (*it).second.get_search_tree();
+  auto next = objects_.erase(it);
+  pool_.release(points, search_tree);
+  return next;
+}
+
+void ObjectMap::clear()
+{
+  for (auto it = objects_.begin(); it != objects_.end();)
+    it = erase_object(it);
+}
+
+size_t ObjectMap::memory_usage() const
+{
+  size_t bytes = 0;
+  for (auto const& object : objects_)
+    bytes += object.second.memory_usage();
+  return bytes;
+}
+
+void ObjectMap::set_object(uint id, Object const& object)
+{
+  auto it = objects_.find(id);
+  if (it == objects_.end())
+  {
+    it = objects_.insert({ id, object }).first;
+  }
+  else
+  {
+    unindex(id, (*it).second);
+    (*it).second = object;
+  }
+  (*it).second.set_msg_points(msg_points_, msg_max_points_);
+  index(id, (*it).second);
+}
+
+void ObjectMap::update_points(Iterator const& it, point_cloud const& pc)
+{
+  (*it).second.update_points(pc);
+  // Classification is unchanged, so only the spatial index needs updating
+  index((*it).first, (*it).second);
+}
+
+void ObjectMap::update_points(Iterator const& it, point_cloud_ptr const& pc, KdTreePtr const& search_tree)
+{
+  point_cloud_ptr old_points = (*it).second.get_points_ptr();
+  KdTreePtr old_search_tree = (*it).second.get_search_tree();
+  (*it).second.update_points(pc, search_tree);
+  pool_.release(old_points, old_search_tree);
+  index((*it).first, (*it).second);
+}
+
+void ObjectMap::compact_object(Iterator const& it)
+{
+  point_cloud_ptr points;
+  KdTreePtr search_tree;
+  (*it).second.compact(points, search_tree);
+  pool_.release(points, search_tree);
+}
+
+void ObjectMap::expand_object(Iterator const& it)
+{
+  if (!(*it).second.is_compact())
+    return;
+  point_cloud_ptr points;
+  KdTreePtr search_tree;
+  pool_.acquire(points, search_tree);
+  (*it).second.expand(points, search_tree);
+}
+
+void ObjectMap::set_classification(Iterator const& it, std::string const& classification)
+{
+  unindex((*it).first, (*it).second);
+  (*it).second.set_classification(classification);
+  index((*it).first, (*it).second);
+}
+
+void ObjectMap::set_msg_points(Object::MsgPoints mode, size_t max_points)
+{
+  msg_points_ = mode;
+  msg_max_points_ = max_points;
+  for (auto& pair : objects_)
+  {
+    pair.second.set_msg_points(mode, max_points);
+    msg_dirty_ids_.insert(pair.first);
+  }
+}
+
+void ObjectMap::set_parallel_msgs(bool parallel)
+{
+  parallel_msgs_ = parallel;
+}
+
+void ObjectMap::index(uint id, Object const& object)
+{
+  by_classification_[object.get_classification()].insert(id);
+  msg_dirty_ids_.insert(id);
+
+  // Objects without points (such as from simulation) are indexed by their pose and scale instead
+  if (object.num_points())
+  {
+    grid_.insert(id, object.get_min(), object.get_max());
+  }
+  else
+  {
+    mil_msgs::PerceptionObject const& msg = object.as_msg();
+    point_t center(msg.pose.position.x, msg.pose.position.y, msg.pose.position.z);
+    float radius = std::max(msg.scale.x, msg.scale.y) / 2.;
+    grid_.insert(id, point_t(center.x - radius, center.y - radius, center.z),
+                 point_t(center.x + radius, center.y + radius, center.z));
+  }
+}
+
+void ObjectMap::unindex(uint id, Object const& object)
+{
+  auto it = by_classification_.find(object.get_classification());
+  if (it != by_classification_.end())
+  {
+    (*it).second.erase(id);
+    if ((*it).second.empty())
+      by_classification_.erase(it);
+  }
+  grid_.remove(id);
+  msg_dirty_ids_.insert(id);
+}
+
+void ObjectMap::query_region(std::string const& name, Region const& region, std::vector<uint>& ids)
+{
+  ids.clear();
+  bool all = name.empty() || "all" == name;
+  grid_.query(region.min(), region.max(), candidates_);
+  for (uint id : candidates_)
+  {
+    Object const& object = objects_.at(id);
+    if (!all && object.get_classification() != name)
+      continue;
+    auto const& position = object.as_msg().pose.position;
+    if (region.contains(position.x, position.y))
+      ids.push_back(id);
+  }
+}
+
+void ObjectMap::query_nearby(std::string const& name, point_t const& position, double radius, size_t max_results,
+                             std::vector<uint>& ids)
+{
+  ids.clear();
+  bool all = "all" == name;
+  size_t total = objects_.size();
+  if (!all)
+  {
+    auto it = by_classification_.find(name);
+    total = it == by_classification_.end() ? 0 : (*it).second.size();
+  }
+  if (!total)
+    return;
+
+  // Search a growing box around position until it contains enough objects, or a box of the given radius
+  std::vector<std::pair<double, uint>> found;
+  double search = radius > 0. ? radius : GRID_CELL_SIZE;
+  while (true)
+  {
+    grid_.query(point_t(position.x - search, position.y - search, position.z),
+                point_t(position.x + search, position.y + search, position.z), candidates_);
+    found.clear();
+    size_t within = 0;
+    for (uint id : candidates_)
+    {
+      Object const& object = objects_.at(id);
+      if (!all && object.get_classification() != name)
+        continue;
+      double d = distance(object.as_msg(), position);
+      found.emplace_back(d, id);
+      if (d <= search)
+        ++within;
+    }
+    // Any object not yet found is further than search from position, so the nearest are known
+    if (radius > 0. || within >= max_results || found.size() == total || search > MAX_SEARCH_DISTANCE)
+      break;
+    search *= 2.;
+  }
+
+  std::sort(found.begin(), found.end());
+  for (auto const& pair : found)
+  {
+    if (radius > 0. && pair.first > radius)
+      break;
+    if (max_results && ids.size() >= max_results)
+      break;
+    ids.push_back(pair.second);
+  }
 }
 
 bool ObjectMap::DatabaseQuery(mil_msgs::ObjectDBQuery::Request& req, mil_msgs::ObjectDBQuery::Response& res)
@@ -49,17 +314,14 @@ bool ObjectMap::DatabaseQuery(mil_msgs::ObjectDBQuery::Request& req, mil_msgs::O
         return true;
       }
 
-      for (auto pair = objects_.begin(); pair != objects_.end(); ++pair)
+      auto it = objects_.find(id);
+      if (objects_.end() == it)
       {
-        if ((*pair).first == id)
-        {
-          erase_object(pair);
-          res.found = true;
-          return true;
-        }
+        res.found = false;
+        return true;
       }
-
-      res.found = false;
+      erase_object(it);
+      res.found = true;
       return true;
     }
 
@@ -83,30 +345,42 @@ bool ObjectMap::DatabaseQuery(mil_msgs::ObjectDBQuery::Request& req, mil_msgs::O
     }
     else
     {
-      it->second.set_classification(cmd);
+      set_classification(it, cmd);
       res.found = true;
     }
     return true;
   }
 
+  // Handle nearest / within radius requests
+  if (req.radius > 0. || req.max_results > 0)
+  {
+    point_t position(req.position.x, req.position.y, req.position.z);
+    std::vector<uint> ids;
+    query_nearby(req.name, position, req.radius, req.max_results, ids);
+    res.found = !ids.empty();
+    res.objects.reserve(ids.size());
+    for (uint id : ids)
+      res.objects.push_back(objects_.at(id).as_msg());
+    return true;
+  }
+
   // Handle request all command
   if ("all" == req.name)
   {
     res.found = true;
-    res.objects = to_msg().objects;
+    res.objects = to_msg()->objects;
     return true;
   }
 
   // Handle request particular
   res.found = false;
-  for (auto const& pair : objects_)
-  {
-    if (pair.second.as_msg().labeled_classification == req.name)
-    {
-      res.found = true;
-      res.objects.emplace_back(pair.second.as_msg());
-    }
-  }
+  auto it = by_classification_.find(req.name);
+  if (it == by_classification_.end())
+    return true;
+  res.found = true;
+  res.objects.reserve((*it).second.size());
+  for (uint id : (*it).second)
+    res.objects.push_back(objects_.at(id).as_msg());
 
   return true;
 }
@@ -0,0 +1,214 @@
+#include <point_cloud_object_detection_and_recognition/object_map_snapshot.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace pcodar
+{
+namespace
+{
+const char MAGIC[8] = { 'P', 'C', 'O', 'D', 'A', 'R', 'S', 'N' };
+const uint32_t VERSION = 1;
+
+template <typename T>
+void append(std::vector<uint8_t>& out, T const& value)
+{
+  size_t offset = out.size();
+  out.resize(offset + sizeof(T));
+  std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+/// Reads values from a buffer, failing instead of reading past its end
+class Reader
+{
+public:
+  Reader(uint8_t const* data, size_t size) : data_(data), size_(size), offset_(0)
+  {
+  }
+  template <typename T>
+  bool read(T& value)
+  {
+    if (size_ - offset_ < sizeof(T))
+      return false;
+    std::memcpy(&value, data_ + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+  /// Skip @size bytes, setting @start to the first of them
+  bool skip(size_t size, uint8_t const*& start)
+  {
+    if (size_ - offset_ < size)
+      return false;
+    start = data_ + offset_;
+    offset_ += size;
+    return true;
+  }
+
+private:
+  uint8_t const* data_;
+  size_t size_;
+  size_t offset_;
+};
+
+/// An object parsed from a snapshot, pointing into the mapped file
+struct SnapshotObject
+{
+  uint32_t id;
+  uint32_t hits;
+  float confidence;
+  std::string classification;
+  uint8_t const* points;
+  uint32_t num_points;
+};
+
+size_t padded(size_t size)
+{
+  return (size + 3) & ~static_cast<size_t>(3);
+}
+
+}  // anonymous namespace
+
+void serialize_snapshot(ObjectMap const& objects, std::vector<uint8_t>& out)
+{
+  out.assign(MAGIC, MAGIC + sizeof(MAGIC));
+  append(out, VERSION);
+  append(out, static_cast<uint32_t>(objects.objects_.size()));
+  append(out, static_cast<uint64_t>(objects.highest_id_));
+  point_cloud decoded;
+  for (auto const& pair : objects.objects_)
+  {
+    Object const& object = pair.second;
+    std::string const& classification = object.get_classification();
+    point_cloud const& points = object.get_points(decoded);
+    append(out, static_cast<uint32_t>(pair.first));
+    append(out, object.get_hits());
+    append(out, object.get_confidence());
+    append(out, static_cast<uint32_t>(classification.size()));
+    append(out, static_cast<uint32_t>(points.size()));
+    out.insert(out.end(), classification.begin(), classification.end());
+    out.resize(padded(out.size()));
+    for (point_t const& point : points)
+    {
+      append(out, point.x);
+      append(out, point.y);
+      append(out, point.z);
+    }
+  }
+}
+
+bool write_snapshot(std::vector<uint8_t> const& data, std::string const& path, std::string& error)
+{
+  // Write next to the destination then rename over it, so a crash never leaves a partial snapshot
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const*>(data.data()), data.size());
+    file.close();
+    if (!file)
+    {
+      error = "could not write " + tmp_path;
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+  {
+    error = "could not rename " + tmp_path + ": " + std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool load_snapshot(std::string const& path, ObjectMap& objects, std::string& error)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    error = "could not open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0)
+  {
+    close(fd);
+    error = path + " is empty";
+    return false;
+  }
+  size_t size = info.st_size;
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED)
+  {
+    error = "could not map " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  // Parse and validate everything before touching the map
+  Reader reader(static_cast<uint8_t const*>(mapped), size);
+  char magic[sizeof(MAGIC)];
+  uint32_t version = 0, count = 0;
+  uint64_t next_id = 0;
+  bool valid = reader.read(magic) && std::equal(magic, magic + sizeof(MAGIC), MAGIC) && reader.read(version) &&
+               version == VERSION && reader.read(count) && reader.read(next_id);
+  std::vector<SnapshotObject> parsed;
+  if (valid)
+    parsed.reserve(count);
+  for (uint32_t i = 0; valid && i < count; ++i)
+  {
+    SnapshotObject object;
+    uint32_t classification_size = 0;
+    uint8_t const* classification = nullptr;
+    valid = reader.read(object.id) && reader.read(object.hits) && reader.read(object.confidence) &&
+            reader.read(classification_size) && reader.read(object.num_points) &&
+            reader.skip(padded(classification_size), classification) &&
+            reader.skip(static_cast<size_t>(object.num_points) * 3 * sizeof(float), object.points);
+    if (!valid)
+      break;
+    object.classification.assign(reinterpret_cast<char const*>(classification), classification_size);
+    parsed.push_back(std::move(object));
+  }
+  if (!valid)
+  {
+    munmap(mapped, size);
+    error = path + " is not a valid snapshot";
+    return false;
+  }
+
+  // Replace the map, keeping ids so anything holding one still refers to the same object
+  objects.clear();
+  size_t highest_id = next_id;
+  for (SnapshotObject const& snapshot : parsed)
+  {
+    point_cloud_ptr cloud = boost::make_shared<point_cloud>();
+    cloud->points.resize(snapshot.num_points);
+    for (uint32_t i = 0; i < snapshot.num_points; ++i)
+    {
+      float xyz[3];
+      std::memcpy(xyz, snapshot.points + i * sizeof(xyz), sizeof(xyz));
+      cloud->points[i] = point_t(xyz[0], xyz[1], xyz[2]);
+    }
+    cloud->width = cloud->points.size();
+    cloud->height = 1;
+    KdTreePtr search_tree = boost::make_shared<KdTree>();
+    if (!cloud->empty())
+      search_tree->setInputCloud(cloud);
+
+    Object object(cloud, snapshot.id, search_tree);
+    object.set_classification(snapshot.classification);
+    object.restore_track(snapshot.confidence, snapshot.hits);
+    objects.set_object(snapshot.id, object);
+    highest_id = std::max(highest_id, static_cast<size_t>(snapshot.id) + 1);
+  }
+  objects.highest_id_ = highest_id;
+  munmap(mapped, size);
+  return true;
+}
+
+}  // namespace pcodar
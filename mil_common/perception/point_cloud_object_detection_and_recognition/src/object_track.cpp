@@ -0,0 +1,169 @@
+#include <point_cloud_object_detection_and_recognition/object_track.hpp>
+
+#include <Eigen/LU>
+
+#include <algorithm>
+#include <limits>
+
+namespace pcodar
+{
+ObjectTrack::ObjectTrack()
+  : initialized_(false), stamp_(0.), state_(Vector4::Zero()), covariance_(Matrix4::Identity())
+{
+}
+
+bool ObjectTrack::initialized() const
+{
+  return initialized_;
+}
+
+void ObjectTrack::initialize(Vector2 const& position, double stamp, Matrix2 const& position_covariance,
+                             double velocity_std)
+{
+  initialized_ = true;
+  stamp_ = stamp;
+  state_ << position, 0., 0.;
+  covariance_.setZero();
+  covariance_.topLeftCorner<2, 2>() = position_covariance;
+  covariance_.bottomRightCorner<2, 2>() = Eigen::Matrix2d::Identity() * velocity_std * velocity_std;
+}
+
+void ObjectTrack::predict(double stamp, double accel_std)
+{
+  double dt = stamp - stamp_;
+  if (dt <= 0.)
+    return;
+  stamp_ = stamp;
+
+  Matrix4 transition = Matrix4::Identity();
+  transition.topRightCorner<2, 2>() = Eigen::Matrix2d::Identity() * dt;
+
+  // Discrete white noise acceleration
+  double q = accel_std * accel_std;
+  Matrix4 noise = Matrix4::Zero();
+  noise.topLeftCorner<2, 2>() = Eigen::Matrix2d::Identity() * q * dt * dt * dt / 3.;
+  noise.topRightCorner<2, 2>() = Eigen::Matrix2d::Identity() * q * dt * dt / 2.;
+  noise.bottomLeftCorner<2, 2>() = noise.topRightCorner<2, 2>();
+  noise.bottomRightCorner<2, 2>() = Eigen::Matrix2d::Identity() * q * dt;
+
+  state_ = transition * state_;
+  covariance_ = transition * covariance_ * transition.transpose() + noise;
+}
+
+ObjectTrack::Matrix2 ObjectTrack::innovation_covariance(Matrix2 const& noise) const
+{
+  return covariance_.topLeftCorner<2, 2>() + noise;
+}
+
+double ObjectTrack::mahalanobis_squared(Vector2 const& measured, Matrix2 const& noise) const
+{
+  Eigen::Vector2d innovation = measured - state_.head<2>();
+  return innovation.dot(innovation_covariance(noise).inverse() * innovation);
+}
+
+void ObjectTrack::update(Vector2 const& measured, Matrix2 const& noise)
+{
+  Eigen::Vector2d innovation = measured - state_.head<2>();
+  Eigen::Matrix<double, 4, 2> gain = covariance_.leftCols<2>() * innovation_covariance(noise).inverse();
+  state_ += gain * innovation;
+  Matrix4 correction = Matrix4::Identity();
+  correction.leftCols<2>() -= gain;
+  covariance_ = correction * covariance_;
+}
+
+ObjectTrack::Vector2 ObjectTrack::get_position() const
+{
+  return state_.head<2>();
+}
+
+ObjectTrack::Vector2 ObjectTrack::get_velocity() const
+{
+  return state_.tail<2>();
+}
+
+double ObjectTrack::get_stamp() const
+{
+  return stamp_;
+}
+
+void solve_assignment(std::vector<double> const& cost, size_t rows, size_t cols, std::vector<int>& row_to_col)
+{
+  row_to_col.assign(rows, -1);
+  if (!rows || !cols)
+    return;
+
+  // Hungarian algorithm with potentials, which needs at least as many columns as rows, so transpose if needed
+  bool transposed = rows > cols;
+  size_t n = transposed ? cols : rows;
+  size_t m = transposed ? rows : cols;
+  auto at = [&](size_t i, size_t j) { return transposed ? cost[j * cols + i] : cost[i * cols + j]; };
+
+  const double INF = std::numeric_limits<double>::infinity();
+  // 1-indexed, with row / column 0 as a sentinel
+  std::vector<double> u(n + 1, 0.), v(m + 1, 0.), min_to(m + 1);
+  std::vector<size_t> col_row(m + 1, 0), way(m + 1, 0);
+  std::vector<bool> used(m + 1);
+  for (size_t i = 1; i <= n; ++i)
+  {
+    col_row[0] = i;
+    size_t j0 = 0;
+    std::fill(min_to.begin(), min_to.end(), INF);
+    std::fill(used.begin(), used.end(), false);
+    do
+    {
+      used[j0] = true;
+      size_t i0 = col_row[j0], j1 = 0;
+      double delta = INF;
+      for (size_t j = 1; j <= m; ++j)
+      {
+        if (used[j])
+          continue;
+        double reduced = at(i0 - 1, j - 1) - u[i0] - v[j];
+        if (reduced < min_to[j])
+        {
+          min_to[j] = reduced;
+          way[j] = j0;
+        }
+        if (min_to[j] < delta)
+        {
+          delta = min_to[j];
+          j1 = j;
+        }
+      }
+      for (size_t j = 0; j <= m; ++j)
+      {
+        if (used[j])
+        {
+          u[col_row[j]] += delta;
+          v[j] -= delta;
+        }
+        else
+        {
+          min_to[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (col_row[j0] != 0);
+
+    // Walk back along the augmenting path
+    do
+    {
+      size_t j1 = way[j0];
+      col_row[j0] = col_row[j1];
+      j0 = j1;
+    } while (j0);
+  }
+
+  for (size_t j = 1; j <= m; ++j)
+  {
+    if (!col_row[j])
+      continue;
+    size_t row = col_row[j] - 1, col = j - 1;
+    if (transposed)
+      row_to_col[col] = row;
+    else
+      row_to_col[row] = col;
+  }
+}
+
+}  // namespace pcodar
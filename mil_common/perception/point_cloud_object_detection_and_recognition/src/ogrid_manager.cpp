@@ -2,15 +2,24 @@
 #include <tf2/utils.h>
 #include <point_cloud_object_detection_and_recognition/ogrid_manager.hpp>
 
+#include <mil_ogrid/grid_delta.hpp>
+
+#include <boost/make_shared.hpp>
+
 namespace pcodar
 {
-OgridManager::OgridManager()
+OgridManager::OgridManager() : incremental_(false), needs_redraw_(true)
 {
 }
 
 void OgridManager::initialize(ros::NodeHandle& nh)
 {
   pub_ogrid_ = nh.advertise<nav_msgs::OccupancyGrid>("/ogrid", 5);
+  pub_ogrid_updates_ = nh.advertise<map_msgs::OccupancyGridUpdate>("/ogrid_updates", 5);
+
+  double keyframe_period = 0.;
+  nh.param<double>("ogrid_keyframe_period", keyframe_period, keyframe_period);
+  keyframe_period_ = ros::Duration(keyframe_period);
 }
 
 void OgridManager::draw_boundary()
@@ -39,12 +48,62 @@ void OgridManager::set_bounds(point_cloud_ptr pc)
 
 cv::Point OgridManager::point_in_ogrid(point_t point)
 {
-  double x = (point.x - ogrid_.info.origin.position.x) / resolution_meters_per_cell_;
-  double y = (point.y - ogrid_.info.origin.position.y) / resolution_meters_per_cell_;
-  return cv::Point(x, y);
+  return geometry_.cell(point.x, point.y);
+}
+
+/// Corners of the rotated bounding box of a simulated object in the grid
+static void box_vertices(mil_msgs::PerceptionObject const& msg, cv::Point2f vertices[4])
+{
+  tf2::Quaternion quat(msg.pose.orientation.x, msg.pose.orientation.y, msg.pose.orientation.z, msg.pose.orientation.w);
+  double pitch, roll, yaw;
+  tf2::getEulerYPR(quat, yaw, pitch, roll);
+  cv::RotatedRect rect(cv::Point2f(msg.pose.position.x, msg.pose.position.y), cv::Size2f(msg.scale.x, msg.scale.y),
+                       yaw);
+  rect.points(vertices);
 }
 
-void OgridManager::update_ogrid(ObjectMap const& objects)
+cv::Rect OgridManager::object_rect(Object const& object)
+{
+  cv::Rect grid = geometry_.rect();
+
+  // In simulation, use bounding box
+  if (!object.num_points())
+  {
+    cv::Point2f vertices[4];
+    box_vertices(object.as_msg(), vertices);
+    std::vector<cv::Point> fixed;
+    for (size_t i = 0; i < 4; ++i)
+      fixed.push_back(point_in_ogrid(point_t(vertices[i].x, vertices[i].y, 0)));
+    return cv::boundingRect(fixed) & grid;
+  }
+
+  // Otherwise, the inflated extent of the points
+  cv::Point min = point_in_ogrid(object.get_min());
+  cv::Point max = point_in_ogrid(object.get_max());
+  int r = inflation_cells_;
+  return cv::Rect(cv::Point(min.x - r, min.y - r), cv::Point(max.x + r + 1, max.y + r + 1)) & grid;
+}
+
+void OgridManager::draw_object(Object const& object, cv::Rect const& clip)
+{
+  // In simulation, use bounding box
+  if (!object.num_points())
+  {
+    cv::Point2f vertices[4];
+    box_vertices(object.as_msg(), vertices);
+    cv::Point vertices_fixed[4];
+    for (size_t i = 0; i < 4; ++i)
+      vertices_fixed[i] = point_in_ogrid(point_t(vertices[i].x, vertices[i].y, 0));
+    mil_ogrid::fill_convex_polygon(ogrid_mat_, vertices_fixed, 4, mil_ogrid::OCCUPIED, clip);
+    return;
+  }
+
+  // Otherwise stamp the inflation disk around each point
+  for (const auto& point : object.get_points(decoded_))
+    inflation_.draw(ogrid_mat_, point_in_ogrid(point), clip);
+}
+
+void OgridManager::redraw_all(ObjectMap const& objects)
 {
   // Clear ogrid
   ogrid_mat_ = cv::Scalar(0);
@@ -52,61 +111,170 @@ void OgridManager::update_ogrid(ObjectMap const& objects)
   // Draw border on ogrid
   draw_boundary();
 
+  cv::Rect grid = geometry_.rect();
+  drawn_.clear();
   for (auto const& pair : objects.objects_)
   {
-    Object const& object = pair.second;
-    mil_msgs::PerceptionObject const& msg = object.as_msg();
+    draw_object(pair.second, grid);
+    drawn_[pair.first] = DrawnObject{ pair.second.get_version(), object_rect(pair.second) };
+  }
+  needs_redraw_ = false;
+}
 
-    // In simulation, use bounding box
-    if (object.get_points().empty())
+void OgridManager::update_ogrid(ObjectMap const& objects, ros::Time const& origin)
+{
+  if (!incremental_ || needs_redraw_)
+  {
+    redraw_all(objects);
+    publish_update(geometry_.rect());
+  }
+  else
+  {
+    // Find regions which changed: where removed objects were and where changed objects were / are now
+    dirty_.clear();
+    for (auto it = drawn_.begin(); it != drawn_.end();)
+    {
+      if (objects.objects_.find(it->first) == objects.objects_.end())
+      {
+        dirty_.push_back(it->second.rect);
+        it = drawn_.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+    for (auto const& pair : objects.objects_)
     {
-      tf2::Quaternion quat(msg.pose.orientation.x, msg.pose.orientation.y, msg.pose.orientation.z,
-                           msg.pose.orientation.w);
-      double pitch, roll, yaw;
-      tf2::getEulerYPR(quat, yaw, pitch, roll);
-      cv::RotatedRect rect(cv::Point2f(msg.pose.position.x, msg.pose.position.y), cv::Size2f(msg.scale.x, msg.scale.y),
-                           yaw);
-      cv::Point2f vertices[4];
-      cv::Point vertices_fixed[4];
-      rect.points(vertices);
-      for (size_t i = 0; i < 4; ++i)
-        vertices_fixed[i] = point_in_ogrid(point_t(vertices[i].x, vertices[i].y, 0));
-      cv::fillConvexPoly(ogrid_mat_, vertices_fixed, 4, cv::Scalar(99));
+      auto drawn = drawn_.find(pair.first);
+      if (drawn != drawn_.end() && drawn->second.version == pair.second.get_version())
+        continue;
+      cv::Rect rect = object_rect(pair.second);
+      if (drawn != drawn_.end())
+        dirty_.push_back(drawn->second.rect);
+      dirty_.push_back(rect);
+      drawn_[pair.first] = DrawnObject{ pair.second.get_version(), rect };
     }
 
-    // Otherwise draw individual points
-    else
+    // Clear each changed region and redraw every object overlapping it
+    for (cv::Rect const& rect : dirty_)
     {
-      for (const auto& point : object.get_points())
+      if (rect.empty())
+        continue;
+      ogrid_mat_(rect) = cv::Scalar(0);
+      for (auto const& pair : objects.objects_)
       {
-        cv::Point center(point_in_ogrid(point));
-        cv::circle(ogrid_mat_, center, inflation_cells_, cv::Scalar(99), -1);
+        cv::Rect overlap = drawn_[pair.first].rect & rect;
+        if (!overlap.empty())
+          draw_object(pair.second, overlap);
       }
     }
+    for (cv::Rect const& rect : dirty_)
+      if (!rect.empty())
+        publish_update(rect);
   }
 
   ogrid_.header.stamp = ros::Time::now();
+  // Carries the stamp of the data behind the grid on to subscribers, for latency tracing
+  ogrid_.info.map_load_time = origin;
 
-  pub_ogrid_.publish(ogrid_);
+  // Subscribers using /ogrid_updates only need the full grid occasionally
+  if (!incremental_ || ogrid_.header.stamp - last_keyframe_ >= keyframe_period_)
+  {
+    // ogrid_ is drawn into in place, so subscribers get a copy. Published as a pointer, a subscriber in the same
+    // nodelet manager shares it rather than deserializing its own.
+    pub_ogrid_.publish(nav_msgs::OccupancyGridConstPtr(boost::make_shared<nav_msgs::OccupancyGrid>(ogrid_)));
+    last_keyframe_ = ogrid_.header.stamp;
+  }
 }
 
-void OgridManager::update_config(Config const& config)
+void OgridManager::publish_update(cv::Rect const& rect)
 {
-  width_meters_ = config.ogrid_width_meters;
-  height_meters_ = config.ogrid_height_meters;
-  resolution_meters_per_cell_ = config.ogrid_resolution_meters_per_cell;
-  inflation_cells_ = config.ogrid_inflation_meters / resolution_meters_per_cell_;
+  if (pub_ogrid_updates_.getNumSubscribers() == 0 || rect.empty())
+    return;
+
+  boost::shared_ptr<map_msgs::OccupancyGridUpdate> update = boost::make_shared<map_msgs::OccupancyGridUpdate>();
+  update->header.frame_id = ogrid_.header.frame_id;
+  update->header.stamp = ros::Time::now();
+  mil_ogrid::make_update(ogrid_mat_, rect, *update);
+  pub_ogrid_updates_.publish(update);
+}
+
+bool OgridManager::crop(Region const& region, nav_msgs::OccupancyGrid& out) const
+{
+  cv::Point min = geometry_.cell(region.min().x, region.min().y);
+  cv::Point max = geometry_.cell(region.max().x, region.max().y);
+  cv::Rect rect = cv::Rect(min, cv::Point(max.x + 1, max.y + 1)) & geometry_.rect();
+  if (rect.empty())
+    return false;
+
+  out.header = ogrid_.header;
+  out.info = ogrid_.info;
+  mil_ogrid::GridGeometry(geometry_.resolution, geometry_.origin_x + rect.x * geometry_.resolution,
+                          geometry_.origin_y + rect.y * geometry_.resolution, rect.width, rect.height)
+      .to_info(out.info);
+  out.data.resize(rect.area());
+  cv::Mat tile = mil_ogrid::as_mat(out);
+  ogrid_mat_(rect).copyTo(tile);
+
+  // Tiles are small, so each cell's center is tested rather than rasterizing the region
+  for (int y = 0; y < rect.height; ++y)
+  {
+    uchar* row = tile.ptr<uchar>(y);
+    for (int x = 0; x < rect.width; ++x)
+    {
+      cv::Point2d center = geometry_.center(cv::Point(rect.x + x, rect.y + y));
+      if (!region.contains(center.x, center.y))
+        row[x] = uchar(mil_ogrid::UNKNOWN);
+    }
+  }
+  return true;
+}
+
+OgridManager::Layout OgridManager::prepare_config(Config const& config)
+{
+  Layout layout;
+  layout.width_meters = config.ogrid_width_meters;
+  layout.height_meters = config.ogrid_height_meters;
+  layout.resolution_meters_per_cell = config.ogrid_resolution_meters_per_cell;
+  layout.inflation_cells = config.ogrid_inflation_meters / layout.resolution_meters_per_cell;
+  layout.incremental = config.ogrid_incremental;
+
+  // Centered on the origin of enu
+  layout.geometry = mil_ogrid::GridGeometry(
+      layout.resolution_meters_per_cell, -1. * layout.width_meters / 2., -1. * layout.height_meters / 2.,
+      layout.width_meters / layout.resolution_meters_per_cell, layout.height_meters / layout.resolution_meters_per_cell);
+  nav_msgs::MapMetaData info;
+  layout.geometry.to_info(info);
+  layout.data.resize(info.width * info.height);
+
+  layout.inflation = mil_ogrid::DiskStamp(layout.inflation_cells);
+  return layout;
+}
+
+void OgridManager::apply_config(Layout& layout)
+{
+  width_meters_ = layout.width_meters;
+  height_meters_ = layout.height_meters;
+  resolution_meters_per_cell_ = layout.resolution_meters_per_cell;
+  inflation_cells_ = layout.inflation_cells;
+  incremental_ = layout.incremental;
 
   ogrid_.header.frame_id = "enu";
-  ogrid_.info.resolution = resolution_meters_per_cell_;
-  ogrid_.info.width = width_meters_ / resolution_meters_per_cell_;
-  ogrid_.info.height = height_meters_ / resolution_meters_per_cell_;
-  ogrid_.info.origin.position.x = -1. * width_meters_ / 2.;  //-1. * width_meters_ * resolution_meters_per_cell_ / 2.;
-  ogrid_.info.origin.position.y =
-      -1. * height_meters_ / 2.;  // -1. * height_meters_ * resolution_meters_per_cell_ / 2.;
-  ogrid_.info.origin.orientation.w = 1;
-  ogrid_.data.resize(ogrid_.info.width * ogrid_.info.height);
-  ogrid_mat_ = cv::Mat(cv::Size(ogrid_.info.width, ogrid_.info.height), CV_8UC1, ogrid_.data.data());
+  geometry_ = layout.geometry;
+  geometry_.to_info(ogrid_.info);
+  ogrid_.data.swap(layout.data);
+  ogrid_mat_ = mil_ogrid::as_mat(ogrid_);
+
+  inflation_ = layout.inflation;
+
+  needs_redraw_ = true;
+}
+
+void OgridManager::update_config(Config const& config)
+{
+  Layout layout = prepare_config(config);
+  apply_config(layout);
 }
 
 }  // namespace pcodar
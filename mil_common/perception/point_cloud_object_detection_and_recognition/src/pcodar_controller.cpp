@@ -2,149 +2,627 @@
 #include <pcl_conversions/pcl_conversions.h>
 #include <pcl_ros/point_cloud.h>
 #include <pcl_ros/transforms.h>
-#include <boost/scope_exit.hpp>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <functional>
 #include <point_cloud_object_detection_and_recognition/pcodar_controller.hpp>
 
 namespace pcodar
 {
-NodeBase::NodeBase(ros::NodeHandle _nh)
+NodeBase::NodeBase(ros::NodeHandle _nh, ros::CallbackQueueInterface* bulk_queue)
   : nh_(_nh)
+  , bulk_nh_(_nh)
   , bounds_client_("/bounds_server", std::bind(&NodeBase::bounds_update_cb, this, std::placeholders::_1))
   , tf_listener(tf_buffer_, nh_)
+  , tf_cache_(tf_buffer_, "base_link")
+  , memory_(_nh)
   , global_frame_("enu")
   , config_server_(_nh)
   , objects_(std::make_shared<ObjectMap>())
 {
+  if (bulk_queue)
+    bulk_nh_.setCallbackQueue(bulk_queue);
   config_server_.setCallback(std::bind(&NodeBase::ConfigCallback, this, std::placeholders::_1, std::placeholders::_2));
 }
 
 void NodeBase::ConfigCallback(Config const& config, uint32_t level)
 {
   if (!level || level & 16)
-    ogrid_manager_.update_config(config);
+  {
+    // The grid is allocated here, and only swapped in under the lock, between updates. Its old cells are freed after.
+    OgridManager::Layout layout = OgridManager::prepare_config(config);
+    std::lock_guard<std::mutex> lock(objects_->mutex_);
+    ogrid_manager_.apply_config(layout);
+  }
+  if (!level || level & 64)
+  {
+    std::lock_guard<std::mutex> lock(objects_->mutex_);
+    objects_->set_msg_points(static_cast<Object::MsgPoints>(config.object_msg_points), config.object_msg_max_points);
+    objects_->set_parallel_msgs(config.object_msg_parallel);
+  }
+}
+
+void NodeBase::set_origin(ros::Time const& origin)
+{
+  origin_.store(origin.toNSec(), std::memory_order_relaxed);
 }
 
 void NodeBase::UpdateObjects()
 {
-  ogrid_manager_.update_ogrid(*objects_);
-  auto objects_msg = objects_->to_msg();
-  marker_manager_.update_markers();
+  ros::Time origin = ros::Time().fromNSec(origin_.load(std::memory_order_relaxed));
+  mil_tools::TraceSpan span("pcodar.update_objects", origin);
+  mil_msgs::PerceptionObjectArrayConstPtr objects_msg;
+  mil_msgs::PerceptionObjectDelta delta_msg;
+  bool publish_delta = pub_objects_delta_.getNumSubscribers() > 0;
+  {
+    std::lock_guard<std::mutex> lock(objects_->mutex_);
+    {
+      StageTimers::Scope timer(stage_timers_, StageTimers::OGRID);
+      ogrid_manager_.update_ogrid(*objects_, origin);
+    }
+    objects_msg = objects_->to_msg();
+    {
+      StageTimers::Scope timer(stage_timers_, StageTimers::MARKERS);
+      marker_manager_.update_markers();
+    }
+
+    // Only track changes while someone is listening, starting with a keyframe when they join
+    if (publish_delta)
+    {
+      ros::Time now = ros::Time::now();
+      bool keyframe = now - last_delta_keyframe_ >= delta_keyframe_period_;
+      delta_encoder_.encode(*objects_, keyframe, delta_msg);
+      if (delta_msg.keyframe)
+        last_delta_keyframe_ = now;
+    }
+    else
+    {
+      delta_encoder_.reset();
+    }
+  }
   pub_objects_.publish(objects_msg);
+  if (publish_delta)
+    pub_objects_delta_.publish(delta_msg);
+  publish_regions();
 }
 
 void NodeBase::initialize()
 {
+  mil_tools::Tracer::instance().configure(nh_);
   marker_manager_.initialize(nh_, objects_);
   ogrid_manager_.initialize(nh_);
 
-  modify_classification_service_ = nh_.advertiseService("/database/requests", &NodeBase::DBQuery_cb, this);
+  modify_classification_service_ = bulk_nh_.advertiseService("/database/requests", &NodeBase::DBQuery_cb, this);
+  // Reset stays on the processing queue, so it never lands between the scans of a frame
   reset_service_ = nh_.advertiseService("reset", &NodeBase::Reset, this);
 
+  // Only what is around the boat or a target, for consumers which do not need the whole map
+  region_query_service_ = bulk_nh_.advertiseService("region_query", &NodeBase::region_query_cb, this);
+  region_subscribe_service_ = bulk_nh_.advertiseService("region_subscribe", &NodeBase::region_subscribe_cb, this);
+
   // Publish PerceptionObjects
   pub_objects_ = nh_.advertise<mil_msgs::PerceptionObjectArray>("objects", 1);
+
+  // Publish changes to PerceptionObjects, for bandwidth limited consumers
+  double keyframe_period = 5.;
+  nh_.param<double>("delta_keyframe_period", keyframe_period, keyframe_period);
+  delta_keyframe_period_ = ros::Duration(keyframe_period);
+  pub_objects_delta_ = nh_.advertise<mil_msgs::PerceptionObjectDelta>("objects_delta", 10);
+
+  // Periodically publish how long each stage is taking
+  double diagnostics_period = 1.;
+  nh_.param<double>("diagnostics_period", diagnostics_period, diagnostics_period);
+  pub_diagnostics_ = nh_.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+  diagnostics_timer_ = bulk_nh_.createTimer(ros::Duration(diagnostics_period), &NodeBase::publish_diagnostics, this);
+
+  // Objects are what PCODAR is for, so only the storage pooled for reuse is freed when over the limit
+  memory_.add("object_map", [this] {
+    std::lock_guard<std::mutex> lock(objects_->mutex_);
+    return objects_->memory_usage();
+  });
+  memory_.add("object_pool",
+              [this] {
+                std::lock_guard<std::mutex> lock(objects_->mutex_);
+                return objects_->pool_.memory_usage();
+              },
+              [this](size_t) {
+                std::lock_guard<std::mutex> lock(objects_->mutex_);
+                objects_->pool_.clear();
+              });
+
+  // Object map snapshots, optionally loaded at startup and saved periodically, for a warm start after a restart
+  nh_.param<std::string>("snapshot_path", snapshot_path_, "pcodar_snapshot.bin");
+  save_snapshot_service_ = bulk_nh_.advertiseService("save_snapshot", &NodeBase::save_snapshot_cb, this);
+  load_snapshot_service_ = bulk_nh_.advertiseService("load_snapshot", &NodeBase::load_snapshot_cb, this);
+  bool load_on_start = false;
+  nh_.param<bool>("snapshot_load_on_start", load_on_start, load_on_start);
+  std::string error;
+  if (load_on_start && !load_snapshot(error))
+    ROS_WARN("Starting with an empty object map: %s", error.c_str());
+  double snapshot_period = 0.;
+  nh_.param<double>("snapshot_period", snapshot_period, snapshot_period);
+  if (snapshot_period > 0.)
+    snapshot_timer_ = bulk_nh_.createTimer(ros::Duration(snapshot_period), &NodeBase::snapshot_timer_cb, this);
 }
 
-bool NodeBase::transform_to_global(std::string const& frame, ros::Time const& time, Eigen::Affine3d& out,
-                                   ros::Duration timeout)
+bool NodeBase::save_snapshot(std::string& error)
 {
-  geometry_msgs::TransformStamped transform;
-  try
+  // Only serializing needs the object map locked, the slower write can overlap processing
+  std::lock_guard<std::mutex> snapshot_lock(snapshot_mutex_);
   {
-    transform = tf_buffer_.lookupTransform("enu", frame, time, timeout);
+    std::lock_guard<std::mutex> lock(objects_->mutex_);
+    serialize_snapshot(*objects_, snapshot_buffer_);
   }
-  catch (tf2::TransformException& ex)
+  return write_snapshot(snapshot_buffer_, snapshot_path_, error);
+}
+
+bool NodeBase::load_snapshot(std::string& error)
+{
   {
-    ROS_ERROR("%s", ex.what());
-    return false;
+    std::lock_guard<std::mutex> lock(objects_->mutex_);
+    if (!pcodar::load_snapshot(snapshot_path_, *objects_, error))
+      return false;
+    marker_manager_.reset();
   }
-  out = tf2::transformToEigen(transform);
+  UpdateObjects();
+  return true;
+}
+
+bool NodeBase::save_snapshot_cb(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res)
+{
+  std::string error;
+  res.success = save_snapshot(error);
+  res.message = res.success ? "Saved to " + snapshot_path_ : error;
+  return true;
+}
+
+bool NodeBase::load_snapshot_cb(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res)
+{
+  std::string error;
+  res.success = load_snapshot(error);
+  res.message = res.success ? "Loaded from " + snapshot_path_ : error;
   return true;
 }
 
+void NodeBase::snapshot_timer_cb(ros::TimerEvent const&)
+{
+  std::string error;
+  if (!save_snapshot(error))
+    ROS_ERROR_THROTTLE(60., "Failed to save object map snapshot: %s", error.c_str());
+}
+
+void NodeBase::publish_diagnostics(ros::TimerEvent const&)
+{
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = ros::Time::now();
+  diagnostic_msgs::DiagnosticStatus status;
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.name = ros::this_node::getName() + ": stage latency";
+  status.hardware_id = "pcodar";
+  stage_timers_.to_msg(status);
+  status.message = status.values.empty() ? "No scans processed" : "OK";
+  msg.status.push_back(status);
+
+  mil_tools::TransformCache::Stats tf_stats = tf_cache_.stats();
+  diagnostic_msgs::DiagnosticStatus tf_status;
+  tf_status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  tf_status.name = ros::this_node::getName() + ": tf lookups";
+  tf_status.hardware_id = "pcodar";
+  tf_status.message = tf_stats.lookups ? "OK" : "No lookups made";
+  auto add = [&](std::string const& key, std::string const& value) {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = key;
+    key_value.value = value;
+    tf_status.values.push_back(key_value);
+  };
+  add("lookups", std::to_string(tf_stats.lookups));
+  add("failures", std::to_string(tf_stats.failures));
+  add("mountings looked up", std::to_string(tf_stats.mount_lookups));
+  add("mountings reused", std::to_string(tf_stats.mount_hits));
+  add("mean lookup (us)", std::to_string(tf_stats.mean_lookup_us));
+  add("max lookup (us)", std::to_string(tf_stats.max_lookup_us));
+  msg.status.push_back(tf_status);
+
+  diagnostic_msgs::DiagnosticStatus memory_status;
+  memory_status.name = ros::this_node::getName() + ": memory";
+  memory_status.hardware_id = "pcodar";
+  memory_.to_msg(memory_status);
+  msg.status.push_back(memory_status);
+
+  add_diagnostics(msg);
+  pub_diagnostics_.publish(msg);
+}
+
+void NodeBase::add_diagnostics(diagnostic_msgs::DiagnosticArray& msg)
+{
+}
+
+void NodeBase::add_transform(geometry_msgs::TransformStamped const& transform, bool is_static)
+{
+  tf_buffer_.setTransform(transform, "pcodar", is_static);
+}
+
+StageTimers const& NodeBase::get_stage_timers() const
+{
+  return stage_timers_;
+}
+
+bool NodeBase::transform_to_global(std::string const& frame, ros::Time const& time, Eigen::Affine3d& out,
+                                   ros::Duration timeout)
+{
+  return tf_cache_.lookup(global_frame_, frame, time, out, timeout);
+}
+
 bool NodeBase::bounds_update_cb(const mil_bounds::BoundsConfig& config)
 {
+  bounds_timer_.stop();
+  if (apply_bounds(config))
+    return true;
+  ROS_WARN("Waiting for a transform from %s to %s to apply the new bounds", config.frame.c_str(),
+           global_frame_.c_str());
+  pending_bounds_ = config;
+  bounds_timer_ = nh_.createTimer(ros::Duration(0.5), &NodeBase::bounds_timer_cb, this);
+  return false;
+}
+
+void NodeBase::bounds_timer_cb(ros::TimerEvent const&)
+{
+  if (apply_bounds(pending_bounds_))
+    bounds_timer_.stop();
+}
+
+bool NodeBase::apply_bounds(const mil_bounds::BoundsConfig& config)
+{
+  // The latest transform, as bounds are usually in a fixed frame
   Eigen::Affine3d transform;
-  if (!transform_to_global(config.frame, ros::Time::now(), transform, ros::Duration(10)))
+  if (!transform_to_global(config.frame, ros::Time(0), transform))
     return false;
 
-  bounds_ = boost::make_shared<point_cloud>();
-  bounds_->push_back(point_t(config.x1, config.y1, config.z1));
-  bounds_->push_back(point_t(config.x2, config.y2, config.z2));
-  bounds_->push_back(point_t(config.x3, config.y3, config.z3));
-  bounds_->push_back(point_t(config.x4, config.y4, config.z4));
+  point_cloud_ptr bounds = boost::make_shared<point_cloud>();
+  bounds->push_back(point_t(config.x1, config.y1, config.z1));
+  bounds->push_back(point_t(config.x2, config.y2, config.z2));
+  bounds->push_back(point_t(config.x3, config.y3, config.z3));
+  bounds->push_back(point_t(config.x4, config.y4, config.z4));
+  pcl::transformPointCloud(*bounds, *bounds, transform);
 
-  pcl::transformPointCloud(*bounds_, *bounds_, transform);
-  ogrid_manager_.set_bounds(bounds_);
+  // Scans are filtered on other threads, which pick the new bounds up from here. The ogrid is drawn under the
+  // objects' lock.
+  atomic_store(&bounds_, bounds);
+  std::lock_guard<std::mutex> lock(objects_->mutex_);
+  ogrid_manager_.set_bounds(bounds);
 
   return true;
 }
 
 bool NodeBase::DBQuery_cb(mil_msgs::ObjectDBQuery::Request& req, mil_msgs::ObjectDBQuery::Response& res)
 {
+  std::lock_guard<std::mutex> lock(objects_->mutex_);
   return objects_->DatabaseQuery(req, res);
 }
 
+bool NodeBase::resolve_region(mil_msgs::Region const& msg, Region& region, std::string& error)
+{
+  std::string const& frame = msg.frame_id.empty() ? global_frame_ : msg.frame_id;
+  Eigen::Affine3d transform;
+  if (!transform_to_global(frame, ros::Time(0), transform))
+  {
+    error = "no transform from " + frame + " to " + global_frame_;
+    return false;
+  }
+  return region.from_msg(msg, transform, error);
+}
+
+bool NodeBase::query_region(Region const& region, std::string const& name, nav_msgs::OccupancyGrid& ogrid,
+                            std::vector<mil_msgs::PerceptionObject>& objects)
+{
+  objects_->query_region(name, region, region_ids_);
+  objects.reserve(region_ids_.size());
+  for (uint id : region_ids_)
+    objects.push_back(objects_->objects_.at(id).as_msg());
+  return ogrid_manager_.crop(region, ogrid);
+}
+
+bool NodeBase::region_query_cb(mil_msgs::RegionQuery::Request& req, mil_msgs::RegionQuery::Response& res)
+{
+  Region region;
+  if (!resolve_region(req.region, region, res.message))
+    return true;
+  std::lock_guard<std::mutex> lock(objects_->mutex_);
+  if (!query_region(region, req.name, res.ogrid, res.objects))
+    res.message = "region is outside the ogrid";
+  res.success = true;
+  return true;
+}
+
+bool NodeBase::region_subscribe_cb(mil_msgs::RegionSubscribe::Request& req, mil_msgs::RegionSubscribe::Response& res)
+{
+  std::lock_guard<std::mutex> lock(regions_mutex_);
+  if (req.region.radius <= 0. && req.region.polygon.empty())
+  {
+    res.success = region_subscriptions_.erase(req.topic) > 0;
+    if (!res.success)
+      res.message = "no subscription " + req.topic;
+    return true;
+  }
+
+  // Check the shape now, as the frame may only be transformed later
+  Region region;
+  if (!region.from_msg(req.region, Eigen::Affine3d::Identity(), res.message))
+    return true;
+
+  auto it = region_subscriptions_.find(req.topic);
+  if (it == region_subscriptions_.end())
+  {
+    RegionSubscription subscription;
+    try
+    {
+      subscription.pub_ogrid = nh_.advertise<nav_msgs::OccupancyGrid>("roi/" + req.topic + "/ogrid", 1);
+      subscription.pub_objects = nh_.advertise<mil_msgs::PerceptionObjectArray>("roi/" + req.topic + "/objects", 1);
+    }
+    catch (ros::InvalidNameException const& err)
+    {
+      res.message = err.what();
+      return true;
+    }
+    it = region_subscriptions_.emplace(req.topic, std::move(subscription)).first;
+  }
+  it->second.region = req.region;
+  it->second.name = req.name;
+  res.success = true;
+  return true;
+}
+
+void NodeBase::publish_regions()
+{
+  std::lock_guard<std::mutex> regions_lock(regions_mutex_);
+  for (auto& pair : region_subscriptions_)
+  {
+    RegionSubscription& subscription = pair.second;
+    bool publish_ogrid = subscription.pub_ogrid.getNumSubscribers() > 0;
+    bool publish_objects = subscription.pub_objects.getNumSubscribers() > 0;
+    if (!publish_ogrid && !publish_objects)
+      continue;
+
+    Region region;
+    std::string error;
+    if (!resolve_region(subscription.region, region, error))
+    {
+      ROS_WARN_THROTTLE(5., "Not publishing region %s: %s", pair.first.c_str(), error.c_str());
+      continue;
+    }
+    auto ogrid = boost::make_shared<nav_msgs::OccupancyGrid>();
+    auto objects = boost::make_shared<mil_msgs::PerceptionObjectArray>();
+    {
+      std::lock_guard<std::mutex> lock(objects_->mutex_);
+      publish_ogrid &= query_region(region, subscription.name, *ogrid, objects->objects);
+    }
+    if (publish_ogrid)
+      subscription.pub_ogrid.publish(nav_msgs::OccupancyGridConstPtr(ogrid));
+    if (publish_objects)
+      subscription.pub_objects.publish(mil_msgs::PerceptionObjectArrayConstPtr(objects));
+  }
+}
+
 bool NodeBase::Reset(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& res)
 {
+  std::lock_guard<std::mutex> lock(objects_->mutex_);
   marker_manager_.reset();
-  objects_->objects_.clear();
+  objects_->clear();
   return true;
 }
 
-bool NodeBase::transform_point_cloud(const sensor_msgs::PointCloud2& pc_msg, point_cloud& out)
+bool NodeBase::transform_point_cloud(const sensor_msgs::PointCloud2& pc_msg, point_cloud& out,
+                                     InputCloudFilter const* filter)
 {
   Eigen::Affine3d transform;
   if (!transform_to_global(pc_msg.header.frame_id, pc_msg.header.stamp, transform))
     return false;
+  transform_point_cloud(pc_msg, transform, out, filter);
+  return true;
+}
 
-  // Transform from PCL2
-  pcl::PCLPointCloud2 pcl_pc2;
-  pcl_conversions::toPCL(pc_msg, pcl_pc2);
-  point_cloud pcloud;
-  pcl::fromPCLPointCloud2(pcl_pc2, pcloud);
-
+void NodeBase::transform_point_cloud(const sensor_msgs::PointCloud2& pc_msg, Eigen::Affine3d const& transform,
+                                     point_cloud& out, InputCloudFilter const* filter,
+                                     std::vector<uint8_t> const* mask, ScanDeskewer const* deskew)
+{
   out.clear();
-  pcl::transformPointCloud(pcloud, out, transform);
-  return true;
+
+  // Find x, y, z fields so they can be read directly from the message buffer
+  int offsets[3] = { -1, -1, -1 };
+  const char* names[3] = { "x", "y", "z" };
+  for (auto const& field : pc_msg.fields)
+    for (size_t i = 0; i < 3; ++i)
+      if (field.name == names[i] && field.datatype == sensor_msgs::PointField::FLOAT32 && field.count == 1)
+        offsets[i] = field.offset;
+
+  // Fall back to PCL conversions for unusual layouts, which are not deskewed
+  if (offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0 || pc_msg.is_bigendian)
+  {
+    pcl::PCLPointCloud2 pcl_pc2;
+    pcl_conversions::toPCL(pc_msg, pcl_pc2);
+    point_cloud pcloud;
+    pcl::fromPCLPointCloud2(pcl_pc2, pcloud);
+    pcl::transformPointCloud(pcloud, out, transform);
+    if (filter)
+    {
+      auto end = std::remove_if(out.points.begin(), out.points.end(),
+                                [filter](point_t const& point) { return !filter->accept(point); });
+      out.points.erase(end, out.points.end());
+      out.width = out.points.size();
+      out.height = 1;
+    }
+    return;
+  }
+
+  // Read, transform, and filter points in batches so the transform and filter are evaluated over many points at once
+  const size_t BATCH_SIZE = InputCloudFilter::BATCH_SIZE;
+  Eigen::Matrix3f rotation = transform.rotation().cast<float>();
+  Eigen::RowVector3f translation = transform.translation().cast<float>().transpose();
+  InputCloudFilter::PointBatch batch(BATCH_SIZE, 3);
+  InputCloudFilter::PointBatch transformed(BATCH_SIZE, 3);
+  InputCloudFilter::BatchMask keep(BATCH_SIZE);
+  ScanDeskewer::BatchFractions fractions(deskew ? BATCH_SIZE : 0);
+  InputCloudFilter::PointBatch offsets(deskew ? BATCH_SIZE : 0, 3);
+  out.reserve(static_cast<size_t>(pc_msg.width) * pc_msg.height);
+
+  auto flush = [&](size_t count) {
+    if (deskew)
+    {
+      deskew->offsets(batch.topRows(count), fractions.head(count), offsets.topRows(count));
+      batch.topRows(count) += offsets.topRows(count);
+    }
+    transformed.topRows(count).noalias() = batch.topRows(count) * rotation.transpose();
+    transformed.topRows(count).rowwise() += translation;
+    if (filter)
+      filter->accept(transformed.topRows(count), keep);
+    for (size_t i = 0; i < count; ++i)
+      if (!filter || keep[i])
+        out.points.push_back(point_t(transformed(i, 0), transformed(i, 1), transformed(i, 2)));
+  };
+
+  size_t count = 0;
+  for (uint32_t row = 0; row < pc_msg.height; ++row)
+  {
+    const uint8_t* data = pc_msg.data.data() + row * pc_msg.row_step;
+    for (uint32_t col = 0; col < pc_msg.width; ++col, data += pc_msg.point_step)
+    {
+      if (mask && !(*mask)[static_cast<size_t>(row) * pc_msg.width + col])
+        continue;
+      float xyz[3];
+      for (size_t i = 0; i < 3; ++i)
+        std::memcpy(&xyz[i], data + offsets[i], sizeof(float));
+      if (!std::isfinite(xyz[0]) || !std::isfinite(xyz[1]) || !std::isfinite(xyz[2]))
+        continue;
+      batch.row(count) << xyz[0], xyz[1], xyz[2];
+      if (deskew)
+        fractions[count] = deskew->fraction(data, xyz);
+      if (++count == BATCH_SIZE)
+      {
+        flush(count);
+        count = 0;
+      }
+    }
+  }
+  if (count)
+    flush(count);
+
+  out.width = out.points.size();
+  out.height = 1;
+  out.is_dense = true;
 }
 
-Node::Node(ros::NodeHandle _nh) : NodeBase(_nh)
+Node::Node(ros::NodeHandle _nh, ros::CallbackQueueInterface* bulk_queue)
+  : NodeBase(_nh, bulk_queue)
+  , transform_queue_size_(5)
+  , use_voxel_map_(false)
+  , pipelined_(false)
+  , running_(false)
+  , update_pending_(false)
+  , received_scans_(0)
+  , dropped_scans_(0)
+  , coalesced_updates_(0)
+  , unchanged_frames_(0)
+  , complete_pending_(false)
 {
   config_server_.setCallback(std::bind(&Node::ConfigCallback, this, std::placeholders::_1, std::placeholders::_2));
+}
 
-  // TODO: pull from params (currently misleading)
-  // Currently based on WAMv in VRX, inflated x 1.2 for safety factor
-  const double HALF_LENGTH = 2.739625 * 1.2;
-  const double HALF_WIDTH = 2.02589 * 1.2;
-  const double BOTTOM = -5.;
-  const double TOP = 5.;
-  Eigen::Vector4f min(-HALF_LENGTH, -HALF_WIDTH, BOTTOM, 1.);
-  Eigen::Vector4f max(HALF_LENGTH, HALF_WIDTH, TOP, 1.);
-
-  // Give the filter the footprint of the robot to remove from pointcloud
-  input_cloud_filter_.set_robot_footprint(min, max);
+Node::~Node()
+{
+  running_ = false;
+  worker_wake_.notify_all();
+  publish_wake_.notify_all();
+  if (worker_thread_.joinable())
+    worker_thread_.join();
+  if (publish_thread_.joinable())
+    publish_thread_.join();
 }
 
 void Node::ConfigCallback(Config const& config, uint32_t level)
 {
   NodeBase::ConfigCallback(config, level);
-  if (!level || level & 1)
-    persistent_cloud_builder_.update_config(config);
-  if (!level || level & 2)
-    persistent_cloud_filter_.update_config(config);
-  if (!level || level & 4)
-    detector_.update_config(config);
-  if (!level || level & 8)
-    ass.update_config(config);
+  // The stages pick it up at their next scan, on their own threads
+  config_snapshots_.publish(config, level);
+}
+
+void Node::apply_ingest_config()
+{
+  ConfigSnapshots::SnapshotPtr snapshot;
+  uint32_t level;
+  if (!ingest_config_.update(config_snapshots_, snapshot, level))
+    return;
+  if (level & 128)
+    range_image_filter_.update_config(snapshot->config);
+  if (level & 256)
+    deskewer_.update_config(snapshot->config);
+}
+
+void Node::apply_process_config()
+{
+  ConfigSnapshots::SnapshotPtr snapshot;
+  uint32_t level;
+  if (!process_config_.update(config_snapshots_, snapshot, level))
+    return;
+  Config const& config = snapshot->config;
+  pipeline_.update_config(config, level);
+  if (level & (4 | 32))
+  {
+    voxel_map_.update_config(config);
+    use_voxel_map_ = config.voxel_map_enabled;
+  }
+  if (level & 512)
+    change_detector_.update_config(config);
 }
 
 void Node::initialize()
 {
   NodeBase::initialize();
 
-  // Subscribe pointcloud
-  pc_sub = nh_.subscribe("/velodyne_points", 1, &Node::velodyne_cb, this);
+  // Optionally run processing and publishing on their own threads so the subscriber is never blocked
+  nh_.param<bool>("pipelined", pipelined_, false);
+  if (pipelined_)
+  {
+    int queue_size = 2;
+    nh_.param<int>("pipeline_queue_size", queue_size, queue_size);
+    queue_size = std::max(queue_size, 1);
+    scan_pool_.reset(new mil_tools::ObjectPool<Scan>(queue_size + 2));
+    scan_queue_.reset(new mil_tools::SpscQueue<ScanPtr>(queue_size));
+    running_ = true;
+    worker_thread_ = std::thread(&Node::worker_loop, this);
+    publish_thread_ = std::thread(&Node::publish_loop, this);
+  }
+
+  // Over its limit, fewer scans are accumulated until the next reconfigure
+  memory_.add("persistent_cloud",
+              [this] {
+                std::lock_guard<std::mutex> lock(stages_mutex_);
+                return pipeline_.accumulator().memory_usage();
+              },
+              [this](size_t max_bytes) {
+                std::lock_guard<std::mutex> lock(stages_mutex_);
+                pipeline_.accumulator().trim(max_bytes);
+              });
+
+  // Scans are held until the transform at their stamp is available, rather than blocking the callback on TF
+  nh_.param<int>("transform_queue_size", transform_queue_size_, transform_queue_size_);
+  transform_queue_size_ = std::max(transform_queue_size_, 1);
+
+  // Subscribe to each lidar, either a topic name or a struct with a topic and optionally the footprint of the robot
+  // to remove from its scans
+  XmlRpc::XmlRpcValue sources;
+  if (nh_.getParam("input_sources", sources) && sources.getType() == XmlRpc::XmlRpcValue::TypeArray &&
+      sources.size() > 0)
+  {
+    for (int i = 0; i < sources.size(); ++i)
+      add_source(sources[i]);
+  }
+  else
+  {
+    add_source(XmlRpc::XmlRpcValue("/velodyne_points"));
+  }
+  frame_sources_.assign(sources_.size(), false);
 
   // Publish occupancy grid and visualization markers
   pub_pcl_ = nh_.advertise<point_cloud>("persist_pcl", 1);
@@ -154,65 +632,356 @@ bool Node::Reset(std_srvs::Trigger::Request& req, std_srvs::Trigger::Response& r
 {
   if (!NodeBase::Reset(req, res))
     return false;
-  persistent_cloud_builder_.clear();
+  std::lock_guard<std::mutex> lock(stages_mutex_);
+  pipeline_.clear();
+  voxel_map_.clear();
   res.success = true;
   return true;
 }
 
-void Node::velodyne_cb(const sensor_msgs::PointCloud2ConstPtr& pcloud)
+void Node::add_source(XmlRpc::XmlRpcValue& param)
+{
+  // Footprint used only when the source gives no footprint_min / footprint_max in input_sources. Based on the WAMv in
+  // VRX, inflated x 1.2 for safety factor
+  const double HALF_LENGTH = 2.739625 * 1.2;
+  const double HALF_WIDTH = 2.02589 * 1.2;
+  const double BOTTOM = -5.;
+  const double TOP = 5.;
+  Eigen::Vector4f min(-HALF_LENGTH, -HALF_WIDTH, BOTTOM, 1.);
+  Eigen::Vector4f max(HALF_LENGTH, HALF_WIDTH, TOP, 1.);
+
+  auto to_double = [](XmlRpc::XmlRpcValue& value) {
+    return value.getType() == XmlRpc::XmlRpcValue::TypeInt ? static_cast<double>(static_cast<int>(value)) :
+                                                             static_cast<double>(value);
+  };
+  auto read_corner = [&](char const* name, Eigen::Vector4f& corner) {
+    if (!param.hasMember(name) || param[name].getType() != XmlRpc::XmlRpcValue::TypeArray || param[name].size() != 3)
+      return;
+    for (int i = 0; i < 3; ++i)
+      corner[i] = to_double(param[name][i]);
+  };
+
+  std::unique_ptr<Source> source(new Source);
+  if (param.getType() == XmlRpc::XmlRpcValue::TypeString)
+  {
+    source->topic = static_cast<std::string>(param);
+  }
+  else if (param.getType() == XmlRpc::XmlRpcValue::TypeStruct && param.hasMember("topic"))
+  {
+    source->topic = static_cast<std::string>(param["topic"]);
+    read_corner("footprint_min", min);
+    read_corner("footprint_max", max);
+  }
+  else
+  {
+    ROS_ERROR("Ignoring input source %lu, it must be a topic or have a topic member", sources_.size());
+    return;
+  }
+
+  // Give the filter the footprint of the robot to remove from pointcloud
+  source->filter.set_robot_footprint(min, max);
+
+  size_t index = sources_.size();
+  Source* raw = source.get();
+  source->subscriber.subscribe(nh_, source->topic, 1);
+  source->tf_filter.reset(new tf2_ros::MessageFilter<sensor_msgs::PointCloud2>(source->subscriber, tf_buffer_,
+                                                                             global_frame_, transform_queue_size_, nh_));
+  source->tf_filter->registerCallback(
+      [this, index](const sensor_msgs::PointCloud2ConstPtr& pcloud) { source_cb(pcloud, index); });
+  source->tf_filter->registerFailureCallback(
+      [raw](const sensor_msgs::PointCloud2ConstPtr& pcloud, tf2_ros::FilterFailureReason) {
+        ++raw->no_transform;
+        ROS_WARN_THROTTLE(5., "Dropped a scan from %s with no transform from %s at %f", raw->topic.c_str(),
+                          pcloud->header.frame_id.c_str(), pcloud->header.stamp.toSec());
+      });
+  sources_.push_back(std::move(source));
+}
+
+bool Node::lookup_mounting(std::string const& frame, Source& source)
+{
+  if (source.sensor_frame == frame)
+    return true;
+  // Sensors are bolted to the boat, so every later lookup from this frame only needs the pose of base_link
+  tf_cache_.addMount(frame);
+  Eigen::Affine3d base_from_sensor;
+  if (!tf_cache_.mounting(frame, base_from_sensor))
+  {
+    ROS_WARN_THROTTLE(5., "Skipping scans from %s until it is mounted on base_link", source.topic.c_str());
+    return false;
+  }
+  source.sensor_from_base = base_from_sensor.inverse();
+  source.sensor_frame = frame;
+  return true;
+}
+
+bool Node::ingest(const sensor_msgs::PointCloud2& pcloud, Source& source, Scan& scan)
 {
-  BOOST_SCOPE_EXIT(this_)
+  mil_tools::TraceSpan span("pcodar.ingest", pcloud.header.stamp);
+  apply_ingest_config();
+  // The one lookup per scan, which tf_filter has already waited for
+  Eigen::Affine3d transform;
+  if (!lookup_mounting(pcloud.header.frame_id, source) ||
+      !transform_to_global(pcloud.header.frame_id, pcloud.header.stamp, transform))
+    return false;
+  // Pose of robot to filter nearby points, from the pose of the sensor on it
+  source.filter.set_robot_pose(transform * source.sensor_from_base);
+  // Bounds are set on the reconfigure and timer threads, so the filter is only given them here
+  point_cloud_ptr bounds = atomic_load(&bounds_);
+  if (bounds != source.bounds)
   {
-    this_->UpdateObjects();
+    source.filter.set_bounds(bounds);
+    source.bounds = bounds;
   }
-  BOOST_SCOPE_EXIT_END
 
-  point_cloud_ptr pc = boost::make_shared<point_cloud>();
-  // Transform new pointcloud to ENU
-  if (!transform_point_cloud(*pcloud, *pc))
+  if (!scan.cloud)
+    scan.cloud = boost::make_shared<point_cloud>();
+  scan.stamp = pcloud.header.stamp;
+  scan.sensor = transform.translation().cast<float>();
+
+  // Remove water surface and spray using the scan's ring structure, before transforming it
+  std::vector<uint8_t> const* mask = nullptr;
+  if (range_image_filter_.enabled())
+  {
+    StageTimers::Scope timer(stage_timers_, StageTimers::RANGE_IMAGE);
+    if (range_image_filter_.filter(pcloud, transform, range_image_keep_))
+      mask = &range_image_keep_;
+    else
+      ROS_WARN_THROTTLE(10., "Pointcloud has no ring field and is not organized, skipping range image filter");
+  }
+
+  // Place each point where the sensor was when it was measured, interpolating between the poses at the start and
+  // end of the sweep
+  ScanDeskewer const* deskew = nullptr;
+  double begin, end;
+  if (deskewer_.enabled() && deskewer_.prepare(pcloud, begin, end))
+  {
+    mil_tools::TransformInterval sweep;
+    if (tf_cache_.lookupInterval(global_frame_, pcloud.header.frame_id, pcloud.header.stamp + ros::Duration(begin),
+                                 pcloud.header.stamp + ros::Duration(end), sweep))
+    {
+      transform = sweep.at(0.);
+      deskewer_.set_motion(transform, sweep.at(1.));
+      deskew = &deskewer_;
+    }
+  }
+
+  // Transform new pointcloud to ENU, filtering out bounds / robot in the same pass
+  {
+    StageTimers::Scope timer(stage_timers_, StageTimers::TRANSFORM);
+    transform_point_cloud(pcloud, transform, *scan.cloud, &source.filter, mask, deskew);
+  }
+  source.latency.record((ros::Time::now() - pcloud.header.stamp).toSec() * 1000.);
+  return true;
+}
+
+bool Node::close_frame(size_t source)
+{
+  // Scans are grouped into frames with one scan from each source, so the later stages run once per frame rather
+  // than once per scan. A frame also ends early if a source sends a second scan before the others have sent one.
+  bool complete = frame_sources_[source];
+  frame_sources_[source] = true;
+  if (!complete)
+    complete = std::find(frame_sources_.begin(), frame_sources_.end(), false) == frame_sources_.end();
+  if (!complete)
+    return false;
+  for (size_t i = 0; i < sources_.size(); ++i)
+    if (!frame_sources_[i])
+      ++sources_[i]->missed;
+  frame_sources_.assign(sources_.size(), false);
+  return true;
+}
+
+void Node::velodyne_cb(const sensor_msgs::PointCloud2ConstPtr& pcloud)
+{
+  source_cb(pcloud, 0);
+}
+
+void Node::source_cb(const sensor_msgs::PointCloud2ConstPtr& pcloud, size_t index)
+{
+  ++received_scans_;
+  Source& source = *sources_.at(index);
+  ++source.received;
+
+  // In pipelined mode, only transform here and hand off to the worker thread
+  if (pipelined_)
+  {
+    ScanPtr scan = scan_pool_->acquire();
+    if (!ingest(*pcloud, source, *scan))
+      return;
+    // If a scan ending a frame is dropped, the next scan that is handed off ends it instead
+    scan->complete = close_frame(index) || complete_pending_;
+    if (!scan_queue_->push(std::move(scan)))
+    {
+      ++dropped_scans_;
+      ++source.dropped;
+      complete_pending_ = scan->complete;
+      ROS_WARN_THROTTLE(5., "PCODAR worker busy, dropped %lu of %lu scans so far", dropped_scans_.load(),
+                        received_scans_.load());
+      return;
+    }
+    complete_pending_ = false;
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    worker_wake_.notify_one();
     return;
+  }
 
-  // Get current pose of robot to filter neaby points
-  Eigen::Affine3d robot_transform;
-  if (!transform_to_global("base_link", pcloud->header.stamp, robot_transform))
+  // Reuse the same cloud each scan, as it is not needed after process
+  if (!ingest(*pcloud, source, scan_))
     return;
-  input_cloud_filter_.set_robot_pose(robot_transform);
+  scan_.complete = close_frame(index);
+  process(scan_);
+  if (scan_.complete)
+    UpdateObjects();
+}
 
-  // Filter out bounds / robot
-  point_cloud_ptr filtered_pc = boost::make_shared<point_cloud>();
-  input_cloud_filter_.filter(pc, *filtered_pc);
+void Node::worker_loop()
+{
+  while (running_)
+  {
+    ScanPtr scan;
+    if (!scan_queue_->pop(scan))
+    {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      worker_wake_.wait_for(lock, std::chrono::milliseconds(100),
+                            [this] { return !running_ || !scan_queue_->empty(); });
+      continue;
+    }
+
+    process(*scan);
+    if (!scan->complete)
+      continue;
+
+    // Wake the publisher. If it has not picked up the last update yet, both are published together.
+    if (update_pending_.exchange(true))
+    {
+      ++coalesced_updates_;
+      ROS_DEBUG_THROTTLE(5., "PCODAR publisher busy, merged %lu object updates so far", coalesced_updates_.load());
+    }
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    publish_wake_.notify_one();
+  }
+}
 
-  // Add pointcloud to persistent cloud
-  persistent_cloud_builder_.add_point_cloud(filtered_pc);
+void Node::publish_loop()
+{
+  while (running_)
+  {
+    if (!update_pending_.exchange(false))
+    {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      publish_wake_.wait_for(lock, std::chrono::milliseconds(100),
+                             [this] { return !running_ || update_pending_.load(); });
+      continue;
+    }
+    UpdateObjects();
+  }
+}
 
-  // Get persistent cloud and publish for debug
-  auto accrued = persistent_cloud_builder_.get_point_cloud();
+void Node::process(Scan const& scan)
+{
+  mil_tools::TraceSpan span("pcodar.process", scan.stamp);
+  if (scan.complete)
+    set_origin(scan.stamp);
+  std::lock_guard<std::mutex> stages_lock(stages_mutex_);
+  apply_process_config();
+  point_cloud_ptr const& filtered_pc = scan.cloud;
+  change_detector_.add(*filtered_pc);
+
+  // Update persistent voxel map, only re-clustering the parts of it touched by this frame
+  if (use_voxel_map_)
+  {
+    {
+      StageTimers::Scope timer(stage_timers_, StageTimers::ACCUMULATION);
+      voxel_map_.insert(*filtered_pc);
+    }
+    if (!scan.complete || !detect_changes())
+      return;
+
+    point_cloud_ptr voxels = boost::make_shared<point_cloud>();
+    clusters_t clusters;
+    {
+      StageTimers::Scope timer(stage_timers_, StageTimers::VOXEL_MAP);
+      voxel_map_.update();
+      voxel_map_.get_clusters(*voxels, clusters);
+    }
+
+    // Publish clustered voxels for debug
+    if (pub_pcl_.wanted())
+    {
+      (*voxels).header.frame_id = "enu";
+      pub_pcl_.publish(voxels);
+    }
+
+    std::lock_guard<std::mutex> objects_lock(objects_->mutex_);
+    StageTimers::Scope timer(stage_timers_, StageTimers::ASSOCIATION);
+    pipeline_.associator().associate(*objects_, *voxels, clusters, scan.stamp.toSec());
+    return;
+  }
+
+  // Add pointcloud to persistent cloud, each source's scans directly rather than merged first
+  pipeline_.add(*filtered_pc, stage_timers_);
+  if (!scan.complete || !detect_changes())
+    return;
 
-  // Filter out outliers
-  point_cloud_ptr filtered_accrued = boost::make_shared<point_cloud>();
-  persistent_cloud_filter_.filter(accrued, *filtered_accrued);
+  // Filter out outliers and cluster what is left, widening the tolerance with range from where the lidar is now
+  pipeline_.detector().set_sensor_position(scan.sensor);
+  point_cloud& filtered_accrued = pipeline_.detect(stage_timers_);
 
-  // Publish accrued cloud
-  (*filtered_accrued).header.frame_id = "enu";
-  pub_pcl_.publish(filtered_accrued);
+  // Publish accrued cloud, by reference so it is serialized before the pipeline reuses it
+  if (pub_pcl_.wanted())
+  {
+    filtered_accrued.header.frame_id = "enu";
+    pub_pcl_.publish(filtered_accrued);
+  }
 
-  // Skip object detection if all points where filtered out
-  if ((*filtered_accrued).empty())
+  if (filtered_accrued.empty())
     ROS_WARN_ONCE("Filtered pointcloud had no points. Consider changing filter parameters.");
 
-  // Get object clusters from persistent pointcloud
-  clusters_t clusters = detector_.get_clusters(filtered_accrued);
+  // Associate current clusters with old ones, only locking the object map while it is modified
+  std::lock_guard<std::mutex> objects_lock(objects_->mutex_);
+  pipeline_.associate(*objects_, scan.stamp.toSec(), stage_timers_);
+}
 
-  // Associate current clusters with old ones
-  ass.associate(*objects_, *filtered_accrued, clusters);
+bool Node::detect_changes()
+{
+  if (change_detector_.end_frame())
+    return true;
+
+  // Nothing moved, so the objects are as they were last frame, but their confidence still has to be kept up
+  ++unchanged_frames_;
+  ROS_DEBUG_THROTTLE(5., "PCODAR scene unchanged, skipped clustering %lu frames so far", unchanged_frames_.load());
+  std::lock_guard<std::mutex> objects_lock(objects_->mutex_);
+  StageTimers::Scope timer(stage_timers_, StageTimers::ASSOCIATION);
+  pipeline_.associator().repeat(*objects_);
+  return false;
 }
 
-bool Node::bounds_update_cb(const mil_bounds::BoundsConfig& config)
+void Node::add_diagnostics(diagnostic_msgs::DiagnosticArray& msg)
 {
-  if (!NodeBase::bounds_update_cb(config))
-    return false;
-  input_cloud_filter_.set_bounds(bounds_);
-  return true;
+  for (auto const& source : sources_)
+  {
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = ros::this_node::getName() + ": source " + source->topic;
+    status.hardware_id = "pcodar";
+    status.message = source->received ? "OK" : "No scans received";
+    auto add = [&](std::string const& key, uint64_t value) {
+      diagnostic_msgs::KeyValue key_value;
+      key_value.key = key;
+      key_value.value = std::to_string(value);
+      status.values.push_back(key_value);
+    };
+    add("received", source->received);
+    add("dropped", source->dropped);
+    add("missed frames", source->missed);
+    add("dropped without transform", source->no_transform);
+    source->latency.to_msg("latency", status);
+    msg.status.push_back(status);
+  }
 }
 
 }  // namespace pcodar
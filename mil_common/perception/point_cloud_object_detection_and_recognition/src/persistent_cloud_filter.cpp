@@ -1,26 +1,253 @@
 #include <point_cloud_object_detection_and_recognition/persistent_cloud_filter.hpp>
 
+#include <point_cloud_object_detection_and_recognition/cell_sort.hpp>
+
+#include <ros/console.h>
+
+#include <algorithm>
+#include <unordered_map>
+
 namespace pcodar
 {
-PersistentCloudFilter::PersistentCloudFilter() : outlier_filter_(false)
+namespace
+{
+/// Cell coordinates are packed into 21 bits each of a 64 bit key, x most significant, as in cuda_clustering.cu. The
+/// cells of a column along z are then adjacent once sorted by key.
+const int KEY_BITS = 21;
+const int64_t KEY_MAX = (int64_t(1) << KEY_BITS) - 1;
+
+inline uint64_t pack_key(int64_t x, int64_t y, int64_t z)
+{
+  return (uint64_t(x) << (2 * KEY_BITS)) | (uint64_t(y) << KEY_BITS) | uint64_t(z);
+}
+
+}  // anonymous namespace
+
+PersistentCloudFilter::PersistentCloudFilter()
+  : outlier_filter_(false)
+  , range_indices_(new std::vector<int>())
+  , backend_(BACKEND_PCL)
+  , radius_(0.)
+  , min_neighbors_(0)
 {
 }
 
 void PersistentCloudFilter::filter(point_cloud_const_ptr in, point_cloud& pc)
 {
-  if (in->empty())
+  if (backend_ == BACKEND_VOXEL)
+    filter_voxel(*in, pc);
+  else
+    filter_pcl(in, pc);
+}
+
+void PersistentCloudFilter::filter(CloudView const& in, point_cloud& pc)
+{
+  if (backend_ == BACKEND_VOXEL)
+    filter_voxel(in, pc);
+  else
+    filter_pcl(in, pc);
+}
+
+void PersistentCloudFilter::filter_pcl(point_cloud_const_ptr in, point_cloud& pc)
+{
+  filter_pcl(CloudView(*in), pc);
+}
+
+void PersistentCloudFilter::filter_pcl(CloudView const& in, point_cloud& pc)
+{
+  if (in.empty())
   {
     pc.clear();
     return;
   }
-  outlier_filter_.setInputCloud(in);
+  // The range is given to PCL as indices into the whole cloud, rather than copied out of it
+  range_indices_->resize(in.size);
+  for (size_t i = 0; i < in.size; ++i)
+    (*range_indices_)[i] = static_cast<int>(in.begin + i);
+  outlier_filter_.setInputCloud(borrow_cloud(*in.cloud));
+  outlier_filter_.setIndices(range_indices_);
   outlier_filter_.filter(pc);
 }
 
+void PersistentCloudFilter::filter_voxel(CloudView const& in, point_cloud& pc)
+{
+  pc.clear();
+  if (in.cloud)
+    pc.header = in.cloud->header;
+  if (in.empty() || min_neighbors_ <= 0 || radius_ <= 0.)
+  {
+    // Every point is its own neighbor, so with no neighbors needed all are kept
+    if (min_neighbors_ <= 0)
+      pc.points.assign(in.points(), in.points() + in.size);
+    pc.width = pc.points.size();
+    pc.height = 1;
+    pc.is_dense = true;
+    return;
+  }
+
+  // Cells relative to the cloud's min corner, so keys are non negative. A cloud too large for the keys would be
+  // kilometers across, so is left to PCL.
+  point_t const* const points = in.points();
+  const size_t num_points = in.size;
+  Eigen::Vector3f min = points[0].getVector3fMap();
+  Eigen::Vector3f max = min;
+  for (size_t i = 0; i < num_points; ++i)
+  {
+    min = min.cwiseMin(points[i].getVector3fMap());
+    max = max.cwiseMax(points[i].getVector3fMap());
+  }
+  const float inverse_radius = 1. / radius_;
+  if (((max - min) * inverse_radius).maxCoeff() >= KEY_MAX - 1)
+  {
+    ROS_WARN_THROTTLE(10., "Cloud too large for the voxel outlier filter, using PCL's");
+    filter_pcl(in, pc);
+    return;
+  }
+
+  // Number cells in the order they are first seen, checking the last cell first as consecutive points of a scan are
+  // usually in the same one
+  std::unordered_map<uint64_t, uint32_t> cell_ids;
+  cell_keys_.clear();
+  point_cells_.resize(num_points);
+  uint64_t last_key = ~uint64_t(0);
+  uint32_t last_cell = 0;
+  for (size_t i = 0; i < num_points; ++i)
+  {
+    Eigen::Vector3f cell = (points[i].getVector3fMap() - min) * inverse_radius;
+    uint64_t key = pack_key(int64_t(cell.x()), int64_t(cell.y()), int64_t(cell.z()));
+    if (key != last_key)
+    {
+      auto it = cell_ids.emplace(key, cell_keys_.size()).first;
+      if ((*it).second == cell_keys_.size())
+        cell_keys_.push_back(key);
+      last_key = key;
+      last_cell = (*it).second;
+    }
+    point_cells_[i] = last_cell;
+  }
+
+  // Renumber cells in key order, so any run of cells along z is a contiguous range of cells, and of their points
+  size_t num_cells = cell_keys_.size();
+  cell_order_.resize(num_cells);
+  for (uint32_t i = 0; i < num_cells; ++i)
+    cell_order_[i] = i;
+  std::sort(cell_order_.begin(), cell_order_.end(),
+            [this](uint32_t a, uint32_t b) { return cell_keys_[a] < cell_keys_[b]; });
+  cell_ranks_.resize(num_cells);
+  for (uint32_t i = 0; i < num_cells; ++i)
+    cell_ranks_[cell_order_[i]] = i;
+  std::sort(cell_keys_.begin(), cell_keys_.end());
+
+  // Sort points by cell, so each cell's points are contiguous
+  for (uint32_t& cell : point_cells_)
+    cell = cell_ranks_[cell];
+  sort_by_cell(point_cells_, num_cells, cell_starts_, sorted_points_);
+  sorted_xyz_.resize(num_points);
+  for (size_t i = 0; i < num_points; ++i)
+    sorted_xyz_[i] = points[sorted_points_[i]].getVector3fMap();
+
+  // Compared in float like the kd-tree, and strictly within the radius, so the same points are kept as PCL's filter
+  const float radius_squared = static_cast<float>(radius_ * radius_);
+  const int min_neighbors = min_neighbors_;
+  keep_.assign(num_points, 0);
+#pragma omp parallel
+  {
+    // First cell of each of the 9 columns around the previous cell from the bottom of its neighborhood, if known.
+    // Cells of a chunk are visited in key order, which those only ever move forward in, so once found they are
+    // searched for linearly from where they were rather than binary searched.
+    size_t columns[9];
+    bool known[9];
+    int64_t previous = -2;
+#pragma omp for schedule(dynamic, 64)
+    for (int64_t cell = 0; cell < static_cast<int64_t>(num_cells); ++cell)
+    {
+      if (cell != previous + 1)
+        std::fill(known, known + 9, false);
+      previous = cell;
+
+      // Points of the 3 cells along z of each column, which all the cell's points' neighbors are in
+      uint64_t key = cell_keys_[cell];
+      int64_t x = int64_t(key >> (2 * KEY_BITS));
+      int64_t y = int64_t((key >> KEY_BITS) & KEY_MAX);
+      int64_t z = int64_t(key & KEY_MAX);
+      uint32_t begins[9], ends[9];
+      int num_ranges = 0;
+      uint32_t total = 0;
+      for (int column = 0; column < 9; ++column)
+      {
+        int64_t nx = x + column / 3 - 1;
+        int64_t ny = y + column % 3 - 1;
+        if (nx < 0 || ny < 0)
+          continue;
+        uint64_t bottom = pack_key(nx, ny, std::max<int64_t>(z - 1, 0));
+        uint64_t top = pack_key(nx, ny, z + 1);
+        size_t& first = columns[column];
+        if (known[column])
+        {
+          while (first < num_cells && cell_keys_[first] < bottom)
+            ++first;
+        }
+        else
+        {
+          first = std::lower_bound(cell_keys_.begin(), cell_keys_.end(), bottom) - cell_keys_.begin();
+          known[column] = true;
+        }
+        size_t last = first;
+        while (last < num_cells && cell_keys_[last] <= top)
+          ++last;
+        if (first == last)
+          continue;
+        begins[num_ranges] = cell_starts_[first];
+        ends[num_ranges] = cell_starts_[last];
+        total += ends[num_ranges] - begins[num_ranges];
+        ++num_ranges;
+      }
+      // Too few points around the cell for any of its own to have enough neighbors
+      if (total <= static_cast<uint32_t>(min_neighbors))
+        continue;
+
+      for (uint32_t i = cell_starts_[cell]; i < cell_starts_[cell + 1]; ++i)
+      {
+        Eigen::Vector3f const& p = sorted_xyz_[i];
+        // Counts the point itself, as the kd-tree's search does
+        int count = 0;
+        for (int range = 0; range < num_ranges && count <= min_neighbors; ++range)
+        {
+          for (uint32_t j = begins[range]; j < ends[range]; ++j)
+          {
+            if ((sorted_xyz_[j] - p).squaredNorm() < radius_squared && ++count > min_neighbors)
+              break;
+          }
+        }
+        keep_[sorted_points_[i]] = count > min_neighbors;
+      }
+    }
+  }
+
+  // Kept points in their original order
+  for (size_t i = 0; i < num_points; ++i)
+  {
+    if (keep_[i])
+      pc.points.push_back(points[i]);
+  }
+  pc.width = pc.points.size();
+  pc.height = 1;
+  pc.is_dense = true;
+}
+
 void PersistentCloudFilter::update_config(Config const& config)
 {
-  outlier_filter_.setRadiusSearch(config.persistant_cloud_filter_radius);
-  outlier_filter_.setMinNeighborsInRadius(config.persistant_cloud_filter_min_neighbors);
+  set_params(static_cast<Backend>(config.persistant_cloud_filter_backend), config.persistant_cloud_filter_radius,
+             config.persistant_cloud_filter_min_neighbors);
+}
+
+void PersistentCloudFilter::set_params(Backend backend, double radius, int min_neighbors)
+{
+  backend_ = backend;
+  radius_ = radius;
+  min_neighbors_ = min_neighbors;
+  outlier_filter_.setRadiusSearch(radius);
+  outlier_filter_.setMinNeighborsInRadius(min_neighbors);
 }
 
 }  // namespace pcodar
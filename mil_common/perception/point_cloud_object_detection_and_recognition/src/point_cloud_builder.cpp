@@ -1,42 +1,122 @@
 #include <point_cloud_object_detection_and_recognition/point_cloud_builder.hpp>
 
+#include <algorithm>
+
 namespace pcodar
 {
 PointCloudCircularBuffer::PointCloudCircularBuffer() : mega_cloud_(boost::make_shared<point_cloud>())
 {
 }
 
+void PointCloudCircularBuffer::evict_oldest()
+{
+  head_ += slices_.front().size;
+  if (!slices_.front().is_dense)
+    --sparse_slices_;
+  slices_.pop_front();
+}
+
+void PointCloudCircularBuffer::compact()
+{
+  auto& points = mega_cloud_->points;
+  points.erase(points.begin(), points.begin() + head_);
+  head_ = 0;
+  mega_cloud_->width = points.size();
+  mega_cloud_->height = 1;
+}
+
 void PointCloudCircularBuffer::add_point_cloud(const point_cloud_ptr& pc)
 {
-  // Add new cloud to buffer
-  prev_clouds_.push_back(pc);
+  add(*pc);
+}
 
-  // Don't contruct mega cloud until buffer of recent clouds is full
-  if (!prev_clouds_.full())
+void PointCloudCircularBuffer::add(point_cloud const& pc)
+{
+  if (slices_.capacity() == 0)
     return;
 
-  //  Assemple cloud as union of buffered clouds
-  mega_cloud_->clear();
-  for (const auto& cloud : prev_clouds_)
+  // Make room for the new cloud by dropping the oldest one's slice
+  if (slices_.full())
+    evict_oldest();
+
+  auto& points = mega_cloud_->points;
+  if (points.size() + pc.size() > points.capacity())
   {
-    *mega_cloud_ += *cloud;
+    // Only here, at the end of the buffer, are evicted points dropped. Growing it to twice what is live means each
+    // point is moved by this at most a few times while it is buffered.
+    compact();
+    if (2 * (points.size() + pc.size()) > points.capacity())
+      points.reserve(2 * (points.size() + pc.size()));
   }
+
+  // Append new points to the back of the accumulated cloud, reusing its existing storage
+  points.insert(points.end(), pc.points.begin(), pc.points.end());
+  slices_.push_back(Slice{ pc.size(), static_cast<bool>(pc.is_dense) });
+  if (!pc.is_dense)
+    ++sparse_slices_;
+
+  mega_cloud_->width = points.size();
+  mega_cloud_->height = 1;
 }
 
 void PointCloudCircularBuffer::clear()
 {
   mega_cloud_->clear();
-  prev_clouds_.clear();
+  head_ = 0;
+  slices_.clear();
+  sparse_slices_ = 0;
+}
+
+size_t PointCloudCircularBuffer::memory_usage() const
+{
+  return mega_cloud_->points.capacity() * sizeof(point_t) + slices_.capacity() * sizeof(Slice);
+}
+
+void PointCloudCircularBuffer::trim(size_t max_bytes)
+{
+  if (live_size() * sizeof(point_t) > max_bytes && slices_.size() > 1)
+  {
+    while (live_size() * sizeof(point_t) > max_bytes && slices_.size() > 1)
+      evict_oldest();
+    // Stay full, so cloud keeps returning the accumulated cloud
+    slices_.set_capacity(slices_.size());
+  }
+  auto& points = mega_cloud_->points;
+  if (points.capacity() * sizeof(point_t) > max_bytes)
+  {
+    compact();
+    points.shrink_to_fit();
+  }
 }
 
 void PointCloudCircularBuffer::update_config(Config const& config)
 {
-  prev_clouds_.set_capacity(config.accumulator_number_persistant_clouds);
+  size_t capacity = config.accumulator_number_persistant_clouds;
+
+  // Drop the oldest clouds if the buffer is shrinking, so the newest data is kept
+  while (slices_.size() > capacity)
+    evict_oldest();
+  slices_.set_capacity(capacity);
+}
+
+point_cloud_const_ptr PointCloudCircularBuffer::get_point_cloud() const
+{
+  auto copy = boost::make_shared<point_cloud>();
+  CloudView const view = cloud();
+  copy->header = mega_cloud_->header;
+  copy->points.assign(view.points(), view.points() + view.size);
+  copy->width = view.size;
+  copy->height = 1;
+  copy->is_dense = view.is_dense;
+  return copy;
 }
 
-point_cloud_ptr PointCloudCircularBuffer::get_point_cloud()
+CloudView PointCloudCircularBuffer::cloud() const
 {
-  return mega_cloud_;
+  // Don't expose accumulated cloud until buffer of recent clouds is full
+  if (!slices_.full())
+    return CloudView(empty_cloud_);
+  return CloudView(*mega_cloud_, head_, live_size(), sparse_slices_ == 0);
 }
 
 }  // pcodar namespace
@@ -0,0 +1,207 @@
+#include <point_cloud_object_detection_and_recognition/range_image_filter.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace pcodar
+{
+namespace
+{
+/// Read an integer field of any type from a point
+bool read_ring(uint8_t const* data, sensor_msgs::PointField const& field, int& ring)
+{
+  switch (field.datatype)
+  {
+    case sensor_msgs::PointField::UINT8:
+      ring = *data;
+      return true;
+    case sensor_msgs::PointField::UINT16:
+    {
+      uint16_t value;
+      std::memcpy(&value, data, sizeof(value));
+      ring = value;
+      return true;
+    }
+    case sensor_msgs::PointField::INT32:
+    case sensor_msgs::PointField::UINT32:
+    {
+      int32_t value;
+      std::memcpy(&value, data, sizeof(value));
+      ring = value;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+}  // anonymous namespace
+
+RangeImageFilter::RangeImageFilter()
+  : enabled_(false)
+  , columns_(1800)
+  , surface_max_z_(0.)
+  , surface_max_slope_(std::tan(10. * M_PI / 180.))
+  , speckle_tolerance_(0.5)
+  , speckle_min_neighbors_(1)
+{
+}
+
+void RangeImageFilter::update_config(Config const& config)
+{
+  enabled_ = config.range_image_enabled;
+  columns_ = config.range_image_columns;
+  surface_max_z_ = config.range_image_surface_max_z;
+  surface_max_slope_ = std::tan(config.range_image_surface_max_slope_deg * M_PI / 180.);
+  speckle_tolerance_ = config.range_image_speckle_tolerance_m;
+  speckle_min_neighbors_ = config.range_image_speckle_min_neighbors;
+}
+
+bool RangeImageFilter::enabled() const
+{
+  return enabled_;
+}
+
+bool RangeImageFilter::filter(sensor_msgs::PointCloud2 const& msg, Eigen::Affine3d const& transform,
+                              std::vector<uint8_t>& keep)
+{
+  // Find x, y, z and ring fields
+  int offsets[3] = { -1, -1, -1 };
+  const char* names[3] = { "x", "y", "z" };
+  sensor_msgs::PointField const* ring_field = nullptr;
+  for (auto const& field : msg.fields)
+  {
+    for (size_t i = 0; i < 3; ++i)
+      if (field.name == names[i] && field.datatype == sensor_msgs::PointField::FLOAT32 && field.count == 1)
+        offsets[i] = field.offset;
+    if (field.name == "ring")
+      ring_field = &field;
+  }
+  if (offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0 || msg.is_bigendian)
+    return false;
+
+  // Rows of the image are rings if there is a ring field, otherwise the rows of an organized cloud
+  size_t rows = 0;
+  if (ring_field)
+  {
+    for (uint32_t row = 0; row < msg.height; ++row)
+    {
+      const uint8_t* data = msg.data.data() + row * msg.row_step + ring_field->offset;
+      for (uint32_t col = 0; col < msg.width; ++col, data += msg.point_step)
+      {
+        int ring;
+        if (!read_ring(data, *ring_field, ring) || ring < 0)
+          return false;
+        rows = std::max(rows, static_cast<size_t>(ring) + 1);
+      }
+    }
+  }
+  else if (msg.height > 1)
+  {
+    rows = msg.height;
+  }
+  else
+  {
+    return false;
+  }
+
+  size_t num_points = static_cast<size_t>(msg.width) * msg.height;
+  size_t num_cells = rows * columns_;
+  image_.assign(num_cells, -1);
+  counts_.assign(num_cells, 0);
+  ranges_.resize(num_cells);
+  rotated_.resize(num_cells);
+  keep_cells_.assign(num_cells, 1);
+  point_cells_.assign(num_points, -1);
+
+  // Build the image in the sensor frame
+  Eigen::Matrix3f rotation = transform.rotation().cast<float>();
+  float sensor_z = transform.translation().z();
+  const float COLUMN_SCALE = columns_ / (2. * M_PI);
+  for (uint32_t row = 0; row < msg.height; ++row)
+  {
+    const uint8_t* data = msg.data.data() + row * msg.row_step;
+    for (uint32_t col = 0; col < msg.width; ++col, data += msg.point_step)
+    {
+      float xyz[3];
+      for (size_t i = 0; i < 3; ++i)
+        std::memcpy(&xyz[i], data + offsets[i], sizeof(float));
+      if (!std::isfinite(xyz[0]) || !std::isfinite(xyz[1]) || !std::isfinite(xyz[2]))
+        continue;
+
+      int ring = row;
+      if (ring_field)
+        read_ring(data + ring_field->offset, *ring_field, ring);
+      size_t column = static_cast<size_t>((std::atan2(xyz[1], xyz[0]) + M_PI) * COLUMN_SCALE) % columns_;
+      size_t cell = ring * columns_ + column;
+
+      size_t index = static_cast<size_t>(row) * msg.width + col;
+      point_cells_[index] = cell;
+      image_[cell] = index;
+      ++counts_[cell];
+      Eigen::Vector3f point(xyz[0], xyz[1], xyz[2]);
+      ranges_[cell] = point.norm();
+      rotated_[cell] = rotation * point;
+    }
+  }
+
+  // Walk up each column, removing returns that continue a low, shallow surface from the ring below
+  for (size_t column = 0; column < columns_; ++column)
+  {
+    int last_surface = -1;
+    for (size_t ring = 0; ring < rows; ++ring)
+    {
+      size_t cell = ring * columns_ + column;
+      if (image_[cell] < 0)
+        continue;
+      Eigen::Vector3f const& point = rotated_[cell];
+      if (sensor_z + point.z() >= surface_max_z_)
+        continue;
+      if (last_surface >= 0)
+      {
+        Eigen::Vector3f delta = point - rotated_[last_surface];
+        if (std::abs(delta.z()) > surface_max_slope_ * delta.head<2>().norm())
+          continue;
+      }
+      keep_cells_[cell] = 0;
+      last_surface = cell;
+    }
+  }
+
+  // Remove remaining returns without enough neighbors at a similar range, such as spray
+  if (speckle_min_neighbors_ > 0)
+  {
+    for (size_t ring = 0; ring < rows; ++ring)
+      for (size_t column = 0; column < columns_; ++column)
+      {
+        size_t cell = ring * columns_ + column;
+        if (image_[cell] < 0 || !keep_cells_[cell])
+          continue;
+        int neighbors = counts_[cell] - 1;
+        for (int dr = -1; dr <= 1 && neighbors < speckle_min_neighbors_; ++dr)
+        {
+          int r = static_cast<int>(ring) + dr;
+          if (r < 0 || r >= static_cast<int>(rows))
+            continue;
+          for (int dc = -1; dc <= 1; ++dc)
+          {
+            if (!dr && !dc)
+              continue;
+            size_t neighbor = r * columns_ + (column + columns_ + dc) % columns_;
+            if (image_[neighbor] >= 0 && std::abs(ranges_[neighbor] - ranges_[cell]) < speckle_tolerance_)
+              ++neighbors;
+          }
+        }
+        if (neighbors < speckle_min_neighbors_)
+          keep_cells_[cell] = 0;
+      }
+  }
+
+  keep.resize(num_points);
+  for (size_t i = 0; i < num_points; ++i)
+    keep[i] = point_cells_[i] >= 0 && keep_cells_[point_cells_[i]];
+  return true;
+}
+
+}  // namespace pcodar
@@ -0,0 +1,91 @@
+#include <point_cloud_object_detection_and_recognition/region.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace pcodar
+{
+namespace
+{
+/// z component of (b - a) x (c - a), positive if a, b, c turn counterclockwise
+double cross(point_t const& a, point_t const& b, point_t const& c)
+{
+  return (double(b.x) - a.x) * (double(c.y) - a.y) - (double(b.y) - a.y) * (double(c.x) - a.x);
+}
+}  // namespace
+
+Region::Region() : radius_(0.)
+{
+}
+
+bool Region::from_msg(mil_msgs::Region const& msg, Eigen::Affine3d const& transform, std::string& error)
+{
+  polygon_.clear();
+  radius_ = msg.radius;
+  if (radius_ > 0.)
+  {
+    Eigen::Vector3d center = transform * Eigen::Vector3d(msg.center.x, msg.center.y, msg.center.z);
+    center_ = point_t(center.x(), center.y(), center.z());
+    min_ = point_t(center_.x - radius_, center_.y - radius_, -std::numeric_limits<float>::infinity());
+    max_ = point_t(center_.x + radius_, center_.y + radius_, std::numeric_limits<float>::infinity());
+    return true;
+  }
+
+  if (msg.polygon.size() < 3)
+  {
+    error = "region has neither a radius nor a polygon";
+    return false;
+  }
+  min_ = point_t(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+                 -std::numeric_limits<float>::infinity());
+  max_ = point_t(-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                 std::numeric_limits<float>::infinity());
+  for (auto const& vertex : msg.polygon)
+  {
+    Eigen::Vector3d p = transform * Eigen::Vector3d(vertex.x, vertex.y, vertex.z);
+    polygon_.emplace_back(p.x(), p.y(), p.z());
+    min_.x = std::min<float>(min_.x, p.x());
+    min_.y = std::min<float>(min_.y, p.y());
+    max_.x = std::max<float>(max_.x, p.x());
+    max_.y = std::max<float>(max_.y, p.y());
+  }
+
+  // Convex if every corner turns the same way, which is made counterclockwise so contains only checks one side
+  bool left = false;
+  bool right = false;
+  size_t n = polygon_.size();
+  for (size_t i = 0; i < n; ++i)
+  {
+    double turn = cross(polygon_[i], polygon_[(i + 1) % n], polygon_[(i + 2) % n]);
+    left |= turn > 0.;
+    right |= turn < 0.;
+  }
+  if (left == right)
+  {
+    error = left ? "region polygon is not convex" : "region polygon has no area";
+    polygon_.clear();
+    return false;
+  }
+  if (right)
+    std::reverse(polygon_.begin(), polygon_.end());
+  return true;
+}
+
+bool Region::contains(double x, double y) const
+{
+  if (radius_ > 0.)
+  {
+    double dx = x - center_.x;
+    double dy = y - center_.y;
+    return dx * dx + dy * dy <= radius_ * radius_;
+  }
+
+  point_t point(x, y, 0.);
+  size_t n = polygon_.size();
+  for (size_t i = 0; i < n; ++i)
+    if (cross(polygon_[i], polygon_[(i + 1) % n], point) < 0.)
+      return false;
+  return n != 0;
+}
+
+}  // namespace pcodar
@@ -0,0 +1,183 @@
+#include <point_cloud_object_detection_and_recognition/scan_deskewer.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace pcodar
+{
+ScanDeskewer::ScanDeskewer()
+  : enabled_(false)
+  , use_point_time_(true)
+  , sweep_duration_(0.1)
+  , clockwise_(true)
+  , time_type_(TIME_AZIMUTH)
+  , time_offset_(-1)
+  , begin_(0.)
+  , end_(0.)
+  , start_azimuth_(0.)
+  , rotation_(Eigen::Vector3f::Zero())
+  , translation_(Eigen::Vector3f::Zero())
+{
+}
+
+void ScanDeskewer::update_config(Config const& config)
+{
+  enabled_ = config.deskew_enabled;
+  use_point_time_ = config.deskew_use_point_time;
+  sweep_duration_ = config.deskew_sweep_duration;
+  clockwise_ = config.deskew_clockwise;
+}
+
+bool ScanDeskewer::enabled() const
+{
+  return enabled_;
+}
+
+double ScanDeskewer::read_time(uint8_t const* data) const
+{
+  switch (time_type_)
+  {
+    case TIME_FLOAT32:
+    {
+      float value;
+      std::memcpy(&value, data + time_offset_, sizeof(value));
+      return value;
+    }
+    case TIME_FLOAT64:
+    {
+      double value;
+      std::memcpy(&value, data + time_offset_, sizeof(value));
+      return value;
+    }
+    case TIME_UINT32_NS:
+    {
+      uint32_t value;
+      std::memcpy(&value, data + time_offset_, sizeof(value));
+      return value * 1e-9;
+    }
+    default:
+      return 0.;
+  }
+}
+
+bool ScanDeskewer::prepare(sensor_msgs::PointCloud2 const& msg, double& begin, double& end)
+{
+  if (msg.is_bigendian)
+    return false;
+
+  // Find x, y and time fields
+  int offsets[2] = { -1, -1 };
+  const char* names[2] = { "x", "y" };
+  time_type_ = TIME_AZIMUTH;
+  for (auto const& field : msg.fields)
+  {
+    for (size_t i = 0; i < 2; ++i)
+      if (field.name == names[i] && field.datatype == sensor_msgs::PointField::FLOAT32 && field.count == 1)
+        offsets[i] = field.offset;
+    if (!use_point_time_ || field.count != 1)
+      continue;
+    if (field.name == "time" && field.datatype == sensor_msgs::PointField::FLOAT32)
+      time_type_ = TIME_FLOAT32;
+    else if (field.name == "time" && field.datatype == sensor_msgs::PointField::FLOAT64)
+      time_type_ = TIME_FLOAT64;
+    else if (field.name == "t" && field.datatype == sensor_msgs::PointField::UINT32)
+      time_type_ = TIME_UINT32_NS;
+    else
+      continue;
+    time_offset_ = field.offset;
+  }
+
+  // Find the span of the point times, or the azimuth the sweep starts at
+  if (time_type_ != TIME_AZIMUTH)
+  {
+    begin_ = std::numeric_limits<double>::infinity();
+    end_ = -std::numeric_limits<double>::infinity();
+    for (uint32_t row = 0; row < msg.height; ++row)
+    {
+      const uint8_t* data = msg.data.data() + row * msg.row_step;
+      for (uint32_t col = 0; col < msg.width; ++col, data += msg.point_step)
+      {
+        double time = read_time(data);
+        begin_ = std::min(begin_, time);
+        end_ = std::max(end_, time);
+      }
+    }
+  }
+  else
+  {
+    if (offsets[0] < 0 || offsets[1] < 0)
+      return false;
+    bool found = false;
+    for (uint32_t row = 0; row < msg.height && !found; ++row)
+    {
+      const uint8_t* data = msg.data.data() + row * msg.row_step;
+      for (uint32_t col = 0; col < msg.width && !found; ++col, data += msg.point_step)
+      {
+        float xy[2];
+        for (size_t i = 0; i < 2; ++i)
+          std::memcpy(&xy[i], data + offsets[i], sizeof(float));
+        if (!std::isfinite(xy[0]) || !std::isfinite(xy[1]))
+          continue;
+        start_azimuth_ = std::atan2(xy[1], xy[0]);
+        found = true;
+      }
+    }
+    if (!found)
+      return false;
+
+    // Drivers such as velodyne_pointcloud stamp a scan with the time of its last packet
+    begin_ = -sweep_duration_;
+    end_ = 0.;
+  }
+
+  begin = begin_;
+  end = end_;
+  return end_ - begin_ > 1e-6;
+}
+
+void ScanDeskewer::set_motion(Eigen::Affine3d const& begin, Eigen::Affine3d const& end)
+{
+  Eigen::Matrix3d begin_rotation = begin.rotation();
+  Eigen::AngleAxisd delta(begin_rotation.transpose() * end.rotation());
+  rotation_ = (delta.angle() * delta.axis()).cast<float>();
+  translation_ = (begin_rotation.transpose() * (end.translation() - begin.translation())).cast<float>();
+}
+
+float ScanDeskewer::fraction(uint8_t const* data, float const* xyz) const
+{
+  if (time_type_ == TIME_AZIMUTH)
+  {
+    float turned = std::atan2(xyz[1], xyz[0]) - start_azimuth_;
+    if (clockwise_)
+      turned = -turned;
+    if (turned < 0.)
+      turned += 2. * M_PI;
+    return turned / (2. * M_PI);
+  }
+  float fraction = (read_time(data) - begin_) / (end_ - begin_);
+  return std::min(std::max(fraction, 0.f), 1.f);
+}
+
+void ScanDeskewer::offsets(Eigen::Ref<const PointBatch> const& points,
+                           Eigen::Ref<const BatchFractions> const& fractions, Eigen::Ref<PointBatch> out) const
+{
+  // The pose at fraction s of the sweep is the start pose moved by s * translation_ and rotated by
+  // exp(s * rotation_), where exp(w) p ~= p + w x p + w x (w x p) / 2 for the small rotations within one sweep
+  auto x = points.col(0).array();
+  auto y = points.col(1).array();
+  auto z = points.col(2).array();
+  float const wx = rotation_.x();
+  float const wy = rotation_.y();
+  float const wz = rotation_.z();
+  auto cx = wy * z - wz * y;
+  auto cy = wz * x - wx * z;
+  auto cz = wx * y - wy * x;
+  auto half_s2 = 0.5f * fractions.square();
+  out.col(0).array() = fractions * (cx + translation_.x()) + half_s2 * (wy * cz - wz * cy);
+  out.col(1).array() = fractions * (cy + translation_.y()) + half_s2 * (wz * cx - wx * cz);
+  out.col(2).array() = fractions * (cz + translation_.z()) + half_s2 * (wx * cy - wy * cx);
+}
+
+}  // namespace pcodar
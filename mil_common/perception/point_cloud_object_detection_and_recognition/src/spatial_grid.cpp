@@ -0,0 +1,91 @@
+#include <point_cloud_object_detection_and_recognition/spatial_grid.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace pcodar
+{
+SpatialGrid::SpatialGrid() : cell_size_(1.)
+{
+}
+
+void SpatialGrid::set_cell_size(double cell_size)
+{
+  if (cell_size == cell_size_)
+    return;
+  clear();
+  cell_size_ = cell_size;
+}
+
+int64_t SpatialGrid::cell_key(int x, int y)
+{
+  return (static_cast<int64_t>(x) << 32) | static_cast<uint32_t>(y);
+}
+
+SpatialGrid::Range SpatialGrid::range_for(point_t const& min, point_t const& max) const
+{
+  return Range{ static_cast<int>(std::floor(min.x / cell_size_)), static_cast<int>(std::floor(min.y / cell_size_)),
+                static_cast<int>(std::floor(max.x / cell_size_)), static_cast<int>(std::floor(max.y / cell_size_)) };
+}
+
+void SpatialGrid::insert(uint id, point_t const& min, point_t const& max)
+{
+  remove(id);
+  Range range = range_for(min, max);
+  for (int x = range.min_x; x <= range.max_x; ++x)
+    for (int y = range.min_y; y <= range.max_y; ++y)
+      cells_[cell_key(x, y)].push_back(id);
+  ranges_[id] = range;
+}
+
+void SpatialGrid::remove(uint id)
+{
+  auto it = ranges_.find(id);
+  if (it == ranges_.end())
+    return;
+  Range const& range = it->second;
+  for (int x = range.min_x; x <= range.max_x; ++x)
+    for (int y = range.min_y; y <= range.max_y; ++y)
+    {
+      auto cell = cells_.find(cell_key(x, y));
+      if (cell == cells_.end())
+        continue;
+      std::vector<uint>& ids = cell->second;
+      ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+      if (ids.empty())
+        cells_.erase(cell);
+    }
+  ranges_.erase(it);
+}
+
+void SpatialGrid::clear()
+{
+  cells_.clear();
+  ranges_.clear();
+}
+
+void SpatialGrid::query(point_t const& min, point_t const& max, std::vector<uint>& ids) const
+{
+  ids.clear();
+  Range range = range_for(min, max);
+  for (int x = range.min_x; x <= range.max_x; ++x)
+    for (int y = range.min_y; y <= range.max_y; ++y)
+    {
+      auto cell = cells_.find(cell_key(x, y));
+      if (cell != cells_.end())
+        ids.insert(ids.end(), cell->second.begin(), cell->second.end());
+    }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+float bounding_box_distance_squared(point_t const& a_min, point_t const& a_max, point_t const& b_min,
+                                    point_t const& b_max)
+{
+  float dx = std::max(0.f, std::max(a_min.x - b_max.x, b_min.x - a_max.x));
+  float dy = std::max(0.f, std::max(a_min.y - b_max.y, b_min.y - a_max.y));
+  float dz = std::max(0.f, std::max(a_min.z - b_max.z, b_min.z - a_max.z));
+  return dx * dx + dy * dy + dz * dz;
+}
+
+}  // namespace pcodar
@@ -0,0 +1,135 @@
+#include <point_cloud_object_detection_and_recognition/stage_timers.hpp>
+
+#include <diagnostic_msgs/KeyValue.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace pcodar
+{
+LatencyWindow::LatencyWindow(size_t window) : samples_(window)
+{
+}
+
+void LatencyWindow::set_window(size_t window)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  samples_.set_capacity(window);
+}
+
+void LatencyWindow::record(double ms)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  samples_.push_back(ms);
+}
+
+LatencyWindow::Summary LatencyWindow::summarize() const
+{
+  std::vector<double> samples;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    samples.assign(samples_.begin(), samples_.end());
+  }
+
+  Summary summary{ samples.size(), 0., 0., 0. };
+  if (samples.empty())
+    return summary;
+
+  summary.min_ms = *std::min_element(samples.begin(), samples.end());
+  summary.mean_ms = std::accumulate(samples.begin(), samples.end(), 0.) / samples.size();
+  size_t p99_index = std::min(samples.size() - 1, static_cast<size_t>(std::ceil(0.99 * samples.size())) - 1);
+  std::nth_element(samples.begin(), samples.begin() + p99_index, samples.end());
+  summary.p99_ms = samples[p99_index];
+  return summary;
+}
+
+void LatencyWindow::to_msg(std::string const& prefix, diagnostic_msgs::DiagnosticStatus& status) const
+{
+  Summary summary = summarize();
+  if (!summary.count)
+    return;
+  auto add = [&](std::string const& key, double value) {
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = prefix + " " + key;
+    key_value.value = std::to_string(value);
+    status.values.push_back(key_value);
+  };
+  add("min (ms)", summary.min_ms);
+  add("mean (ms)", summary.mean_ms);
+  add("p99 (ms)", summary.p99_ms);
+}
+
+void LatencyWindow::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  samples_.clear();
+}
+
+StageTimers::Scope::Scope(StageTimers& timers, Stage stage)
+  : timers_(timers), stage_(stage), start_(std::chrono::steady_clock::now())
+{
+}
+
+StageTimers::Scope::~Scope()
+{
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start_;
+  timers_.record(stage_, elapsed.count());
+}
+
+StageTimers::StageTimers(size_t window)
+{
+  for (auto& samples : samples_)
+    samples.set_window(window);
+}
+
+void StageTimers::record(Stage stage, double ms)
+{
+  samples_[stage].record(ms);
+}
+
+StageTimers::Summary StageTimers::summarize(Stage stage) const
+{
+  return samples_[stage].summarize();
+}
+
+void StageTimers::to_msg(diagnostic_msgs::DiagnosticStatus& status) const
+{
+  status.values.clear();
+  for (size_t i = 0; i < NUM_STAGES; ++i)
+    samples_[i].to_msg(name(static_cast<Stage>(i)), status);
+}
+
+void StageTimers::clear()
+{
+  for (auto& samples : samples_)
+    samples.clear();
+}
+const char* StageTimers::name(Stage stage)
+{
+  switch (stage)
+  {
+    case RANGE_IMAGE:
+      return "range_image";
+    case TRANSFORM:
+      return "transform";
+    case ACCUMULATION:
+      return "accumulation";
+    case OUTLIER_FILTER:
+      return "outlier_filter";
+    case CLUSTERING:
+      return "clustering";
+    case VOXEL_MAP:
+      return "voxel_map";
+    case ASSOCIATION:
+      return "association";
+    case OGRID:
+      return "ogrid";
+    case MARKERS:
+      return "markers";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace pcodar
@@ -0,0 +1,411 @@
+#include <point_cloud_object_detection_and_recognition/voxel_map.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace pcodar
+{
+constexpr uint32_t VoxelMap::UNLABELED;
+
+VoxelMap::VoxelMap()
+  : scan_(0)
+  , next_label_(UNLABELED + 1)
+  , resolution_(0.3)
+  , cluster_tolerance_(1.)
+  , cell_size_(1.)
+  , decay_scans_(15)
+  , min_hits_(1)
+  , min_cluster_voxels_(1)
+{
+}
+
+void VoxelMap::update_config(Config const& config)
+{
+  double resolution = config.voxel_map_resolution_m;
+  // Tolerance must cover at least the diagonal neighbors or every voxel would be its own component
+  double tolerance = std::max(config.cluster_tolerance_m, resolution * std::sqrt(3.));
+
+  // Changing the geometry of the map invalidates every stored key
+  if (resolution != resolution_ || tolerance != cluster_tolerance_)
+    clear();
+
+  resolution_ = resolution;
+  cluster_tolerance_ = tolerance;
+  // Round the cell size up to a whole number of voxels so each voxel lies in exactly one cell
+  cell_size_ = std::ceil(cluster_tolerance_ / resolution_) * resolution_;
+  decay_scans_ = config.voxel_map_decay_scans;
+  min_hits_ = config.voxel_map_min_hits;
+  min_cluster_voxels_ = config.voxel_map_min_cluster_voxels;
+
+  // A shorter decay window may expire voxels immediately
+  evict_expired();
+}
+
+VoxelMap::Key VoxelMap::key_for(point_t const& point) const
+{
+  return Key{ static_cast<int>(std::floor(point.x / resolution_)), static_cast<int>(std::floor(point.y / resolution_)),
+              static_cast<int>(std::floor(point.z / resolution_)) };
+}
+
+VoxelMap::Key VoxelMap::cell_for(Key const& key) const
+{
+  Eigen::Vector3f center = center_of(key);
+  return Key{ static_cast<int>(std::floor(center.x() / cell_size_)),
+              static_cast<int>(std::floor(center.y() / cell_size_)),
+              static_cast<int>(std::floor(center.z() / cell_size_)) };
+}
+
+Eigen::Vector3f VoxelMap::center_of(Key const& key) const
+{
+  return Eigen::Vector3f((key.x + 0.5) * resolution_, (key.y + 0.5) * resolution_, (key.z + 0.5) * resolution_);
+}
+
+void VoxelMap::insert(point_cloud const& pc)
+{
+  ++scan_;
+  history_.emplace_back();
+  std::vector<Key>& seen = history_.back();
+
+  for (point_t const& point : pc)
+  {
+    if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+      continue;
+
+    Key key = key_for(point);
+    auto result = voxels_.insert({ key, Voxel{ Eigen::Vector3f::Zero(), 0, 0, UNLABELED } });
+    Voxel& voxel = result.first->second;
+    if (result.second)
+    {
+      cells_[cell_for(key)].push_back(key);
+      touched_.push_back(key);
+    }
+    // Record each voxel only once per scan
+    if (voxel.last_seen != scan_)
+      seen.push_back(key);
+    voxel.sum += point.getVector3fMap();
+    uint32_t hits = voxel.hits++;
+    // A voxel becoming usable for clustering changes the components around it. Several points of a scan may fall in
+    // it, so this is the point that reaches min_hits_ rather than the scan's first.
+    if (!result.second && hits < min_hits_ && voxel.hits >= min_hits_)
+      touched_.push_back(key);
+    voxel.last_seen = scan_;
+  }
+}
+
+void VoxelMap::erase_voxel(Key const& key)
+{
+  auto it = voxels_.find(key);
+  if (it == voxels_.end())
+    return;
+
+  // The component may have come apart, which is checked on the next update
+  if (it->second.label != UNLABELED)
+  {
+    uint32_t root = find(it->second.label);
+    --labels_[root].size;
+    removed_.push_back({ key, root });
+  }
+
+  auto cell = cells_.find(cell_for(key));
+  if (cell != cells_.end())
+  {
+    std::vector<Key>& keys = cell->second;
+    auto pos = std::find(keys.begin(), keys.end(), key);
+    if (pos != keys.end())
+    {
+      *pos = keys.back();
+      keys.pop_back();
+    }
+    if (keys.empty())
+      cells_.erase(cell);
+  }
+
+  voxels_.erase(it);
+}
+
+void VoxelMap::evict_expired()
+{
+  // Only voxels observed in scans which have left the decay window can have expired
+  while (history_.size() > decay_scans_)
+  {
+    for (Key const& key : history_.front())
+    {
+      auto it = voxels_.find(key);
+      if (it != voxels_.end() && scan_ - it->second.last_seen >= decay_scans_)
+        erase_voxel(key);
+    }
+    history_.pop_front();
+  }
+}
+
+template <typename Visit>
+void VoxelMap::for_each_neighbor(Key const& key, Visit visit)
+{
+  double tolerance_squared = cluster_tolerance_ * cluster_tolerance_;
+  Eigen::Vector3f center = center_of(key);
+  Key cell = cell_for(key);
+
+  // Voxels within the tolerance must lie in this cell or one of its 26 neighbors
+  for (int dx = -1; dx <= 1; ++dx)
+    for (int dy = -1; dy <= 1; ++dy)
+      for (int dz = -1; dz <= 1; ++dz)
+      {
+        auto neighbor_cell = cells_.find(Key{ cell.x + dx, cell.y + dy, cell.z + dz });
+        if (neighbor_cell == cells_.end())
+          continue;
+        for (Key const& neighbor : neighbor_cell->second)
+        {
+          if (neighbor == key)
+            continue;
+          Voxel& voxel = voxels_.find(neighbor)->second;
+          if (voxel.hits < min_hits_ || (center_of(neighbor) - center).squaredNorm() > tolerance_squared)
+            continue;
+          visit(neighbor, voxel);
+        }
+      }
+}
+
+uint32_t VoxelMap::find(uint32_t label)
+{
+  // Path halving: point every other label on the way at its grandparent
+  while (true)
+  {
+    Label& node = labels_.find(label)->second;
+    if (node.parent == label)
+      return label;
+    node.parent = labels_.find(node.parent)->second.parent;
+    label = node.parent;
+  }
+}
+
+uint32_t VoxelMap::find(uint32_t label) const
+{
+  uint32_t parent;
+  while ((parent = labels_.at(label).parent) != label)
+    label = parent;
+  return label;
+}
+
+uint32_t VoxelMap::new_label()
+{
+  uint32_t label = next_label_++;
+  if (next_label_ == UNLABELED)
+    ++next_label_;
+  labels_[label] = Label{ label, 0 };
+  return label;
+}
+
+uint32_t VoxelMap::unite(uint32_t a, uint32_t b)
+{
+  Label* big = &labels_[a];
+  Label* small = &labels_[b];
+  if (big->size < small->size)
+  {
+    std::swap(a, b);
+    std::swap(big, small);
+  }
+  small->parent = a;
+  big->size += small->size;
+  return a;
+}
+
+void VoxelMap::join(Key const& key)
+{
+  uint32_t root = UNLABELED;
+  for_each_neighbor(key, [&](Key const&, Voxel& neighbor) {
+    if (neighbor.label == UNLABELED)
+      return;
+    uint32_t other = find(neighbor.label);
+    if (root == UNLABELED)
+      root = other;
+    else if (other != root)
+      root = unite(root, other);
+  });
+  if (root == UNLABELED)
+    root = new_label();
+
+  voxels_.find(key)->second.label = root;
+  ++labels_[root].size;
+}
+
+void VoxelMap::split(uint32_t root, std::vector<Key> const& seeds)
+{
+  // One search per seed over the voxels still in the component. Searches which reach each other's voxels are grouped,
+  // and a group all of whose searches ran out of voxels is a piece cut off from the rest.
+  struct Search
+  {
+    /// Voxels found, in the order they are expanded
+    std::vector<Key> found;
+    size_t next;
+  };
+  std::vector<Search> searches;
+  std::unordered_map<Key, size_t, KeyHash> found_by;
+  for (Key const& seed : seeds)
+    if (found_by.insert({ seed, searches.size() }).second)
+      searches.push_back(Search{ { seed }, 0 });
+  if (searches.size() < 2)
+    return;
+
+  // Union-find over the searches, each root having the number of its group's searches with voxels left to expand
+  std::vector<size_t> group(searches.size());
+  std::vector<size_t> pending(searches.size(), 1);
+  for (size_t i = 0; i < searches.size(); ++i)
+    group[i] = i;
+  auto group_of = [&](size_t i) {
+    while (group[i] != i)
+      i = group[i] = group[group[i]];
+    return i;
+  };
+  size_t live = searches.size();
+
+  // Expand one voxel of each search in turn until at most one group may still be connected to others
+  while (live > 1)
+    for (size_t i = 0; i < searches.size() && live > 1; ++i)
+    {
+      Search& search = searches[i];
+      if (search.next == search.found.size())
+        continue;
+      Key current = search.found[search.next++];
+      for_each_neighbor(current, [&](Key const& neighbor, Voxel& voxel) {
+        if (voxel.label == UNLABELED || find(voxel.label) != root)
+          return;
+        auto result = found_by.insert({ neighbor, i });
+        if (result.second)
+        {
+          searches[i].found.push_back(neighbor);
+          return;
+        }
+        size_t a = group_of(i);
+        size_t b = group_of(result.first->second);
+        if (a != b)
+        {
+          group[b] = a;
+          pending[a] += pending[b];
+          --live;
+        }
+      });
+      if (searches[i].next == searches[i].found.size())
+      {
+        size_t g = group_of(i);
+        if (--pending[g] == 0)
+          --live;
+      }
+    }
+
+  // The group still searching keeps root, and every other group is a piece of its own which was searched in full
+  size_t kept = searches.size();
+  for (size_t i = 0; i < searches.size(); ++i)
+    if (pending[group_of(i)] > 0)
+      kept = group_of(i);
+  std::unordered_map<size_t, uint32_t> piece_labels;
+  for (size_t i = 0; i < searches.size(); ++i)
+  {
+    size_t g = group_of(i);
+    if (g == kept)
+      continue;
+    auto result = piece_labels.insert({ g, UNLABELED });
+    if (result.second)
+      result.first->second = new_label();
+    uint32_t label = result.first->second;
+    for (Key const& key : searches[i].found)
+      voxels_.find(key)->second.label = label;
+    labels_[label].size += searches[i].found.size();
+    labels_[root].size -= searches[i].found.size();
+  }
+}
+
+void VoxelMap::compact_labels()
+{
+  std::unordered_map<uint32_t, Label> roots;
+  for (auto& pair : voxels_)
+  {
+    Voxel& voxel = pair.second;
+    if (voxel.label == UNLABELED)
+      continue;
+    voxel.label = find(voxel.label);
+    roots.insert({ voxel.label, labels_[voxel.label] });
+  }
+  labels_.swap(roots);
+}
+
+void VoxelMap::update()
+{
+  evict_expired();
+
+  // Split the components which lost voxels, searching from the voxels that were next to them
+  std::sort(removed_.begin(), removed_.end(),
+            [](std::pair<Key, uint32_t> const& a, std::pair<Key, uint32_t> const& b) { return a.second < b.second; });
+  std::vector<Key> seeds;
+  for (auto begin = removed_.begin(); begin != removed_.end();)
+  {
+    uint32_t root = begin->second;
+    seeds.clear();
+    auto end = begin;
+    for (; end != removed_.end() && end->second == root; ++end)
+      for_each_neighbor(end->first, [&](Key const& neighbor, Voxel& voxel) {
+        if (voxel.label != UNLABELED && find(voxel.label) == root)
+          seeds.push_back(neighbor);
+      });
+    split(root, seeds);
+    begin = end;
+  }
+  removed_.clear();
+
+  // Label each voxel which became usable, merging the components it connects
+  for (Key const& key : touched_)
+  {
+    auto it = voxels_.find(key);
+    if (it != voxels_.end() && it->second.label == UNLABELED && it->second.hits >= min_hits_)
+      join(key);
+  }
+  touched_.clear();
+
+  // Labels of merged and emptied components pile up, so drop them once they outnumber the voxels
+  if (labels_.size() > 2 * voxels_.size() + 64)
+    compact_labels();
+}
+
+void VoxelMap::get_clusters(point_cloud& pc, clusters_t& clusters) const
+{
+  pc.clear();
+  clusters.clear();
+  std::unordered_map<uint32_t, size_t> cluster_of;
+  for (auto const& pair : voxels_)
+  {
+    Voxel const& voxel = pair.second;
+    if (voxel.label == UNLABELED)
+      continue;
+    uint32_t root = find(voxel.label);
+    uint32_t size = labels_.at(root).size;
+    if (size < min_cluster_voxels_)
+      continue;
+
+    auto result = cluster_of.insert({ root, clusters.size() });
+    if (result.second)
+    {
+      clusters.emplace_back();
+      clusters.back().indices.reserve(size);
+    }
+    Eigen::Vector3f centroid = voxel.sum / voxel.hits;
+    clusters[result.first->second].indices.push_back(pc.size());
+    pc.push_back(point_t(centroid.x(), centroid.y(), centroid.z()));
+  }
+}
+
+void VoxelMap::clear()
+{
+  voxels_.clear();
+  cells_.clear();
+  labels_.clear();
+  history_.clear();
+  touched_.clear();
+  removed_.clear();
+}
+
+size_t VoxelMap::size() const
+{
+  return voxels_.size();
+}
+
+}  // namespace pcodar
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+#include <ros_alarms/Alarm.h>
+#include <ros_alarms/shared_alarms.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ros_alarms
+{
+// Process wide cache of alarm states, kept up to date by a single subscription to '/alarm/updates'
+// shared by every AlarmListener in the process. The state of each alarm is held in atomics, so
+// listeners read it without locking or allocating, however often they poll.
+class AlarmCache
+{
+public:
+  using Observer = std::function<void(ros_alarms::Alarm const &)>;
+
+  // State of one alarm. Entries are created on first use and live as long as the process, so
+  // listeners keep a reference to theirs.
+  struct Entry
+  {
+    std::atomic<bool> synced{ false };  // state has come from the server at least once
+    std::atomic<bool> raised{ false };
+    std::atomic<int> severity{ 0 };
+    std::atomic<uint64_t> sequence{ 0 };  // updates pushed by the server since the process started
+    std::atomic<int64_t> stamp{ 0 };      // ros::Time of the last update, in nanoseconds
+
+    // The alarm's slot in SharedAlarms, or nullptr without one, the sequence number of the last
+    // write to it the server has caught up with, and of the last one the server disagreed with
+    SharedAlarms::Slot *shared = nullptr;
+    std::atomic<uint64_t> shared_seen{ 0 };
+    std::atomic<uint64_t> shared_contested{ 0 };
+
+    // The shared state if a broadcaster on this host wrote it since the server last caught up,
+    // unless the server has disagreed with it for longer than SharedAlarms::contest_ns, else the
+    // state from the server
+    bool isRaised() const
+    {
+      if (shared)
+      {
+        uint64_t state = shared->state.load(std::memory_order_acquire);
+        uint64_t sequence = SharedAlarms::sequence(state);
+        if (sequence > shared_seen.load(std::memory_order_acquire) &&
+            (sequence != shared_contested.load(std::memory_order_acquire) ||
+             SharedAlarms::age(*shared) < SharedAlarms::contest_ns))
+          return SharedAlarms::raised(state);
+      }
+      return raised.load(std::memory_order_acquire);
+    }
+
+    // Full message, for the rarely needed strings
+    std::mutex mutex;
+    ros_alarms::Alarm msg;
+  };
+
+  // Subscribes on first use, so only call once ros::init has been
+  static AlarmCache &instance();
+
+  Entry &entry(std::string const &alarm_name);
+
+  // Records the state of an alarm as of stamp, from a push if pushed, else from a server query
+  void update(ros_alarms::Alarm const &msg, ros::Time stamp, bool pushed);
+
+  // Observers are called from the cache's thread on every pushed update to an alarm, and should
+  // only hand it off to be handled elsewhere
+  int addObserver(std::string const &alarm_name, Observer observer);
+  void removeObserver(int id);
+
+  int getNumPublishers() const
+  {
+    return update_subscriber_.getNumPublishers();
+  }
+
+  // Last time the subscription was seen connected to the server, which pushes every change while it is
+  ros::Time getLastConnected() const
+  {
+    return ros::Time().fromNSec(last_connected_.load(std::memory_order_acquire));
+  }
+
+private:
+  AlarmCache();
+  void updateCb(ros_alarms::Alarm const &msg);
+  void checkConnection(ros::WallTimerEvent const &);
+
+  ros::CallbackQueue cb_queue_;
+  ros::NodeHandle nh_;
+  ros::AsyncSpinner async_spinner_;
+  ros::Subscriber update_subscriber_;
+  ros::WallTimer connection_timer_;
+  std::atomic<int64_t> last_connected_{ 0 };
+
+  std::mutex mutex_;  // guards entries_ and observers_
+  std::map<std::string, std::unique_ptr<Entry>> entries_;
+  struct ObserverEntry
+  {
+    int id;
+    std::string alarm_name;
+    Observer observer;
+  };
+  std::vector<ObserverEntry> observers_;
+  int next_observer_ = 0;
+};
+
+}  // namespace ros_alarms
@@ -5,11 +5,48 @@
 #include <ros_alarms/AlarmSet.h>
 
 #include <ros_alarms/alarm_proxy.hpp>
+#include <ros_alarms/shared_alarms.hpp>
 
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 
 namespace ros_alarms
 {
+// Sends alarms to the server from a background thread, shared by the process' broadcasters, so
+// raising or clearing never waits on the server. Only the latest state of each alarm is kept
+// queued, so a raise and clear queued before the first is sent are sent as just the clear.
+// Failed sends are retried, backing off up to 2s between attempts, until they succeed or a newer
+// state of the alarm replaces them.
+class AlarmSender
+{
+public:
+  static AlarmSender& instance();
+
+  // Queues the alarm to be sent, returning false if max_pending other alarms are already waiting
+  bool send(ros_alarms::Alarm const& alarm);
+
+  // Waits until everything queued has been sent, returning false if timeout passed first
+  bool flush(ros::WallDuration timeout);
+
+  static const size_t max_pending = 256;
+
+private:
+  AlarmSender();
+  void run();
+
+  std::mutex __mutex;
+  std::condition_variable __queued;  // Signalled when an alarm is queued
+  std::condition_variable __idle;    // Signalled when nothing is queued or being sent
+  std::map<std::string, ros_alarms::Alarm> __pending;
+  std::deque<std::string> __order;  // Names of pending alarms, in the order they were queued
+  bool __sending = false;
+  std::thread __sender_thread;
+};
+
 class AlarmBroadcaster
 {
 public:
@@ -37,9 +74,20 @@ public:
     raise();
   }
 
-  // Publishes current state of the AlarmProxy to the server
+  // Publishes current state of the AlarmProxy to the server, asynchronously if setAsync(true).
+  // Listeners on this host see it first through SharedAlarms, before the server has it.
   bool publish();
 
+  // Queues the current state of the AlarmProxy with the AlarmSender and returns without waiting
+  // for the server, for hot paths. Returns false if the queue is full.
+  bool publishAsync();
+
+  // Makes publish(), and so raise(), clear() and updateSeverity(), asynchronous
+  void setAsync(bool async)
+  {
+    __async = async;
+  }
+
   // Handle to update the AlarmProxy (if this is an externally managed AlPxy, then modifying
   // could potentially have side effects for other broadcasters that may use it. Exert Caution!)
   AlarmProxy& getAlarm()
@@ -52,6 +100,9 @@ private:
   AlarmProxy* __alarm_ptr;   // All code should refer to the proxy via ptr
   AlarmProxy __alarm_proxy;  // This allows internal management of the alarm proxy
   ros::ServiceClient __set_alarm;
+  bool __async = false;
+  ros_alarms::Alarm __asMsg() const;
+  void __publishShared();
 };
 
 }  // namespace ros_alarms
@@ -76,6 +76,7 @@ private:
   std::string __object_name;
   void __heardHeartbeat(msg_t beat_msg);                    // Callback for heartbeat topic subscriber
   void __checkForHeartbeatLoss(const ros::TimerEvent &te);  // Callback for __status_checker
+  void __setJsonParameters();                               // Only done when the alarm is published
 };
 
 template <typename msg_t>
@@ -101,8 +102,9 @@ HeartbeatMonitor<msg_t>::HeartbeatMonitor(ros::NodeHandle nh, std::string alarm_
   __heartbeat_listener = __nh.subscribe(__heartbeat_topic, 10, &HeartbeatMonitor::__heardHeartbeat, this);
   __status_checker = __nh.createTimer(__period, &HeartbeatMonitor::__checkForHeartbeatLoss, this);
 
-  // Register cleared alarm w/ alarm server
+  // Register cleared alarm w/ alarm server, then raise and clear without blocking the callbacks
   __alarm_broadcaster.clear();
+  __alarm_broadcaster.setAsync(true);
 
   // For better error msgs
   std::stringstream obj;
@@ -142,12 +144,6 @@ void HeartbeatMonitor<msg_t>::__heardHeartbeat(msg_t beat_msg)
   __last_beat = receipt_time;  // update __last_beat
   auto time_since_prev_beat = receipt_time - last_beat_time;
 
-  // Set the last healthy beat time as a json param on the alarm proxy
-  std::stringstream json;
-  // not exactly sure if this will work with json.loads()
-  json << "{\"last_heathy_beat\" : " << __last_beat.toSec() << "}";
-  __alarm_proxy.json_parameters = json.str();
-
   if (__healthy)  // We're done if the heartbeat is healthy
     return;
 
@@ -166,6 +162,7 @@ void HeartbeatMonitor<msg_t>::__heardHeartbeat(msg_t beat_msg)
         __recovering = false;
 
         // Clear heartbeat-loss alarm
+        __setJsonParameters();
         __alarm_broadcaster.clear();
       }
     }
@@ -192,6 +189,7 @@ void HeartbeatMonitor<msg_t>::__checkForHeartbeatLoss(const ros::TimerEvent &te)
   if (time_since_last_beat > __time_to_raise)  // Raise heartbeat-loss alarm
   {
     __alarm_proxy.raised = true;
+    __setJsonParameters();
     __alarm_broadcaster.raise();
     __healthy = false;
   }
@@ -199,6 +197,16 @@ void HeartbeatMonitor<msg_t>::__checkForHeartbeatLoss(const ros::TimerEvent &te)
   //   heartbeat has been lost?
 }
 
+template <typename msg_t>
+void HeartbeatMonitor<msg_t>::__setJsonParameters()
+{
+  // Set the last healthy beat time as a json param on the alarm proxy
+  std::stringstream json;
+  // not exactly sure if this will work with json.loads()
+  json << "{\"last_heathy_beat\" : " << __last_beat.toSec() << "}";
+  __alarm_proxy.json_parameters = json.str();
+}
+
 template <typename msg_t>
 void HeartbeatMonitor<msg_t>::startMonitoring()
 {
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+#include <std_msgs/Header.h>
+
+#include <ros_alarms/broadcaster.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ros_alarms
+{
+// Monitors many heartbeats at once, raising each one's alarm when its heartbeat is lost and
+// clearing it when it recovers, with the same behaviour as a HeartbeatMonitor per heartbeat.
+//
+// Rather than a timer per heartbeat, a single timer turns a hashed timer wheel of the deadlines
+// by which each heartbeat must next beat. A beat only records its time, in a flat array indexed by
+// monitor; a deadline found to have been pushed back by later beats when its slot comes round is
+// just moved to its new slot. The subscribers and the timer share one callback thread.
+class HeartbeatMonitorGroup
+{
+public:
+  // Deadlines are checked every resolution, so alarms are raised up to resolution late. The wheel
+  // has a slot per resolution for slots resolutions, so time_to_raise is best kept below that.
+  HeartbeatMonitorGroup(ros::NodeHandle nh, ros::Duration resolution = ros::Duration(0.02), size_t slots = 256);
+  ~HeartbeatMonitorGroup();
+
+  // Adds a heartbeat, returning the monitor's index. Monitors have to be added before startMonitoring().
+  template <typename msg_t = std_msgs::Header>
+  size_t add(std::string alarm_name, std::string heartbeat_topic,
+             std::function<bool(msg_t)> predicate = [](msg_t) { return true; },
+             ros::Duration time_to_raise = ros::Duration(0.1), ros::Duration time_to_clear = ros::Duration(0.1));
+
+  size_t size() const
+  {
+    return __monitors.size();
+  }
+  std::string alarm_name(size_t monitor) const
+  {
+    return __monitors[monitor]->alarm_proxy.alarm_name;
+  }
+  std::string heartbeat_name(size_t monitor) const
+  {
+    return __monitors[monitor]->heartbeat_topic;
+  }
+  bool healthy(size_t monitor) const
+  {
+    return __state[monitor] == State::healthy;
+  }
+  ros::Time getLastBeatTime(size_t monitor) const
+  {
+    return ros::Time().fromNSec(__last_beat[monitor]);
+  }
+  int getNumConnections(size_t monitor) const
+  {
+    return __monitors[monitor]->heartbeat_listener.getNumPublishers();
+  }
+
+  void startMonitoring();
+  void stopMonitoring()
+  {
+    __async_spinner.stop();
+  }
+
+private:
+  enum class State : uint8_t
+  {
+    healthy,
+    lost,
+    recovering
+  };
+
+  // What is only needed to set up a monitor or when its alarm changes
+  struct Monitor
+  {
+    std::string heartbeat_topic;
+    int64_t time_to_raise;
+    int64_t time_to_clear;
+    AlarmProxy alarm_proxy;
+    std::unique_ptr<AlarmBroadcaster> alarm_broadcaster;
+    ros::Subscriber heartbeat_listener;
+  };
+
+  ros::NodeHandle __nh;
+  ros::CallbackQueue __cb_queue;
+  ros::AsyncSpinner __async_spinner;
+  ros::Timer __wheel_timer;
+  std::vector<std::unique_ptr<Monitor>> __monitors;
+
+  // Per monitor state, indexed by monitor
+  std::vector<int64_t> __last_beat;        // ns of the last healthy beat
+  std::vector<int64_t> __time_recovering;  // ns beating healthily since the heartbeat was lost
+  std::vector<int64_t> __due_tick;         // tick the monitor's deadline is in
+  std::vector<State> __state;
+
+  // Timer wheel of monitors by deadline tick, slot tick % slots
+  int64_t __resolution;
+  std::vector<std::vector<size_t>> __wheel;
+  int64_t __tick = 0;  // last tick turned
+
+  size_t __addMonitor(std::string const &alarm_name, std::string const &heartbeat_topic, ros::Duration time_to_raise,
+                      ros::Duration time_to_clear);
+  void __heardHeartbeat(size_t monitor);              // Called with the beats that pass the predicate
+  void __turnWheel(const ros::TimerEvent &te);        // Callback for __wheel_timer
+  void __schedule(size_t monitor, int64_t deadline);  // Puts the monitor in its deadline's slot
+  void __setAlarm(size_t monitor, bool raised);       // Publishes the alarm with its json parameters
+};
+
+template <typename msg_t>
+size_t HeartbeatMonitorGroup::add(std::string alarm_name, std::string heartbeat_topic,
+                                  std::function<bool(msg_t)> predicate, ros::Duration time_to_raise,
+                                  ros::Duration time_to_clear)
+{
+  size_t monitor = __addMonitor(alarm_name, heartbeat_topic, time_to_raise, time_to_clear);
+  std::string object_name = "HeartbeatMonitorGroup[heartbeat_name=" + heartbeat_topic + "]";
+  boost::function<void(const boost::shared_ptr<msg_t const> &)> cb = [this, monitor, predicate,
+                                                                       object_name](
+      const boost::shared_ptr<msg_t const> &beat_msg) {
+    bool valid_beat = false;
+    try
+    {
+      valid_beat = predicate(*beat_msg);
+    }
+    catch (std::exception &e)
+    {
+      ROS_WARN("%s - Predicate function threw an exception: %s", object_name.c_str(), e.what());
+    }
+    if (valid_beat)
+      __heardHeartbeat(monitor);
+  };
+  __monitors[monitor]->heartbeat_listener = __nh.subscribe<msg_t>(heartbeat_topic, 10, cb);
+  return monitor;
+}
+
+}  // namespace ros_alarms
@@ -4,14 +4,19 @@
  */
 #pragma once
 
+#include <boost/make_shared.hpp>
 #include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <ros_alarms/Alarm.h>
 #include <ros_alarms/AlarmGet.h>
 
+#include <ros_alarms/alarm_cache.hpp>
 #include <ros_alarms/alarm_proxy.hpp>
 
+#include <algorithm>
+#include <array>
 #include <functional>
+#include <mutex>
 #include <string>
 
 namespace ros_alarms
@@ -30,6 +35,7 @@ struct ListenerCb
   int severity_hi = 5;  // highest priority
   int severity_lo = 0;  // lowest priority
   CallScenario call_scenario = CallScenario::always;
+  bool on_executor = false;  // run on the listener's executor thread rather than its spinner
 
   // Compares alarm severity against the action_required range for this callback
   bool severity_check(int severity)
@@ -56,6 +62,25 @@ struct ListenerCb
   }
 };
 
+// Runs an alarm update through a listener's callbacks when its callback queue gets to it
+class AlarmUpdateCallback : public ros::CallbackInterface
+{
+public:
+  AlarmUpdateCallback(std::function<void()> func) : __func(func)
+  {
+  }
+  CallResult call() override
+  {
+    __func();
+    return Success;
+  }
+
+private:
+  std::function<void()> __func;
+};
+
+// Listens to an alarm through the process wide AlarmCache, so every listener in a process shares
+// one subscription to '/alarm/updates', and isRaised() is a lock free read however often it is polled
 template <typename callable_t = std::function<void(AlarmProxy)>>
 class AlarmListener
 {
@@ -63,6 +88,7 @@ class AlarmListener
 
 public:
   AlarmListener(ros::NodeHandle &nh, std::string alarm_name);
+  ~AlarmListener();
 
   // Return status of listener
   bool ok() const
@@ -71,42 +97,69 @@ public:
   }
   int getNumConnections()
   {
-    return __update_subscriber.getNumPublishers();
+    return AlarmCache::instance().getNumPublishers();
   }
 
   // Returns true if a connection was detected before timing out, else false
   bool waitForConnection(ros::Duration timeout = { -1.0 });
 
-  // Start and stop spinner (start processing subscriber callbacks)
+  // Start and stop spinner (start processing update callbacks)
   void start()
   {
     __async_spinner.start();
+    __executor_spinner.start();
   }
   void stop()
   {
     __async_spinner.stop();
+    __executor_spinner.stop();
   }
 
-  // Functions that return the status of the alarm at time of last update
+  // Callbacks registered while this is set run on a dedicated executor thread, so slow ones
+  // (logging, service calls) never hold up the callbacks acting on the alarm, which still run on
+  // the listener's spinner as each update arrives
+  void setUseExecutor(bool use_executor)
+  {
+    __use_executor = use_executor;
+  }
+
+  // Functions that return the status of the alarm at time of last update, from a broadcaster on
+  // this host through shared memory if it is newer than the server's (see SharedAlarms)
   bool isRaised() const
   {
-    return __last_alarm.raised;
+    return __entry.isRaised();
   }
   bool isCleared() const
   {
     return !isRaised();
   }
 
-  // Functions that query the server before returning the latest status of the alarm
+  // Functions that query the server before returning the latest status of the alarm, unless the
+  // cached status is within the staleness bound
   bool queryRaised()
   {
-    getAlarm();
-    return __last_alarm.raised;
+    if (!__isFresh())
+      getAlarm();
+    return isRaised();
   }
   bool queryCleared()
   {
-    getAlarm();
-    return !isRaised();
+    return !queryRaised();
+  }
+
+  // Lets query* functions answer from the cache, without a round trip to the server, while it is
+  // connected to '/alarm/updates' (checked every 0.1s) or was within bound of a query or update.
+  // Negative (the default) always queries the server.
+  void setStalenessBound(ros::Duration bound)
+  {
+    __staleness_bound = bound;
+  }
+
+  // Number of updates to the alarm pushed to this process. A poller which sees it go up by more
+  // than one between two polls missed a raise or clear in between, even if isRaised() reads the same.
+  uint64_t getSequence() const
+  {
+    return __entry.sequence.load(std::memory_order_acquire);
   }
 
   // Queries server and parses response into an AlarmProxy
@@ -115,7 +168,8 @@ public:
   // Returns AlarmProxy for last alarm of this name published to '/alarm/updates'
   AlarmProxy getCachedAlarm()
   {
-    return __last_alarm;
+    std::lock_guard<std::mutex> lock(__entry.mutex);
+    return AlarmProxy(__entry.msg);
   }
 
   // Registers a callback to be invoked on both raise and clear
@@ -136,13 +190,13 @@ public:
   // Returns the last time the alarm was updated
   ros::Time getLastUpdateTime() const
   {
-    return __last_update;
+    return ros::Time().fromNSec(__entry.stamp.load(std::memory_order_acquire));
   }
 
   // Returns the time since last update
   ros::Duration getTimeSinceUpdate() const
   {
-    return ros::Time::now() - __last_update;
+    return ros::Time::now() - getLastUpdateTime();
   }
 
   // Waits for an update to the alarm via '/alarm/udates' with timeout
@@ -151,6 +205,9 @@ public:
   void clearCallbacks()
   {
     __callbacks.clear();
+    for (auto &table : __raise_dispatch)
+      table.clear();
+    __clear_dispatch.clear();
   }
 
 private:
@@ -160,13 +217,22 @@ private:
   ros::ServiceClient __get_alarm;
   ros::CallbackQueue __cb_queue;
   ros::AsyncSpinner __async_spinner;
-  ros::Subscriber __update_subscriber;
+  ros::CallbackQueue __executor_queue;
+  ros::AsyncSpinner __executor_spinner;
+  AlarmCache::Entry &__entry;
+  int __observer;
+  ros::Duration __staleness_bound{ -1.0 };
   std::vector<ListenerCb<callable_t>> __callbacks;
-  AlarmProxy __last_alarm;
-  ros::Time __last_update{ 0, 0 };
+  // Indices into __callbacks of the callbacks to call for a raise at each severity, and for a
+  // clear, in the order they were added, so updates never test callbacks they do not match
+  std::array<std::vector<size_t>, 6> __raise_dispatch;
+  std::vector<size_t> __clear_dispatch;
+  bool __use_executor = false;
   std::string __object_name;
   void __addCb(callable_t cb, int severity_lo, int severity_hi, CallScenario call_scenario);
   void __alarmUpdate(ros_alarms::Alarm);
+  void __invoke(ListenerCb<callable_t> &cb, ros_alarms::Alarm const &alarm_msg);
+  bool __isFresh() const;
 };
 
 template <typename callable_t>
@@ -174,16 +240,20 @@ AlarmListener<callable_t>::AlarmListener(ros::NodeHandle &nh, std::string alarm_
     : __nh(nh),
       __alarm_name(alarm_name),
       __get_alarm(__nh.serviceClient<ros_alarms::AlarmGet>("/alarm/get")),
-      __async_spinner(1, &__cb_queue)
+      __async_spinner(1, &__cb_queue),
+      __executor_spinner(1, &__executor_queue),
+      __entry(AlarmCache::instance().entry(alarm_name))
 
 {
   std::stringstream obj_name;  // For better error msgs
   obj_name << "AlarmListener[alarm_name=" << __alarm_name << ", node_name=" << ros::this_node::getName() << "]";
   __object_name = obj_name.str();
 
-  // Use owned callback queue
-  __nh.setCallbackQueue(&__cb_queue);
-  __update_subscriber = __nh.subscribe("/alarm/updates", 1000, &AlarmListener::__alarmUpdate, this);
+  // The cache keeps the alarm's state, updates are only queued here to run the callbacks, in the
+  // owned callback queue
+  __observer = AlarmCache::instance().addObserver(__alarm_name, [this](ros_alarms::Alarm const &msg) {
+    __cb_queue.addCallback(boost::make_shared<AlarmUpdateCallback>([this, msg]() { __alarmUpdate(msg); }));
+  });
 
   // Service to query alarm server
   bool service_exists = __get_alarm.waitForExistence(ros::Duration(1.0));
@@ -214,6 +284,13 @@ catch (std::exception &e)
   ROS_ERROR("%s", msg.str().c_str());
 }
 
+template <typename callable_t>
+AlarmListener<callable_t>::~AlarmListener()
+{
+  AlarmCache::instance().removeObserver(__observer);
+  stop();
+}
+
 template <typename callable_t>
 bool AlarmListener<callable_t>::waitForConnection(ros::Duration timeout)
 {
@@ -236,12 +313,23 @@ AlarmProxy AlarmListener<callable_t>::getAlarm()
 
   // Query alarm server
   if (!__get_alarm.call(alarm_query))
+  {
     ROS_INFO("%s: %s", __object_name.c_str(), "Alarm server query was unsuccessful.");
+    return getCachedAlarm();
+  }
 
-  // Update internal alarm data
-  __last_update = alarm_query.response.header.stamp;
-  __last_alarm = AlarmProxy(alarm_query.response.alarm);
-  return __last_alarm;
+  // Update the process wide alarm data
+  AlarmCache::instance().update(alarm_query.response.alarm, alarm_query.response.header.stamp, false);
+  return AlarmProxy(alarm_query.response.alarm);
+}
+
+template <typename callable_t>
+bool AlarmListener<callable_t>::__isFresh() const
+{
+  if (__staleness_bound < ros::Duration(0) || !__entry.synced.load(std::memory_order_acquire))
+    return false;
+  ros::Time confirmed = std::max(getLastUpdateTime(), AlarmCache::instance().getLastConnected());
+  return ros::Time::now() - confirmed <= __staleness_bound;
 }
 
 template <typename callable_t>
@@ -294,32 +382,73 @@ void AlarmListener<callable_t>::__addCb(callable_t cb, int severity_lo, int seve
   l_cb.severity_lo = severity_lo;
   l_cb.severity_hi = severity_hi;
   l_cb.call_scenario = call_scenario;
+  l_cb.on_executor = __use_executor;
 
+  size_t index = __callbacks.size();
   __callbacks.push_back(l_cb);
+
+  // Raises at severities past the tables scan __callbacks instead
+  int table_hi = __raise_dispatch.size() - 1;
+  if (call_scenario != CallScenario::clear)
+  {
+    bool any_severity = call_scenario == CallScenario::always;
+    for (int severity = any_severity ? 0 : std::max(severity_lo, 0);
+         severity <= (any_severity ? table_hi : std::min(severity_hi, table_hi)); ++severity)
+      __raise_dispatch[severity].push_back(index);
+  }
+  if (call_scenario != CallScenario::raise)
+    __clear_dispatch.push_back(index);
 }
 
 template <typename callable_t>
 void AlarmListener<callable_t>::__alarmUpdate(ros_alarms::Alarm alarm_msg)
 {
-  if (alarm_msg.alarm_name == __alarm_name)
-  {
-    // Update internal alarm data
-    __last_alarm = alarm_msg;
-    __last_update = ros::Time::now();
+  if (alarm_msg.alarm_name != __alarm_name)
+    return;
 
-    // Invoke callbacks if necessary
+  // Invoke the callbacks bucketed under the update
+  if (!alarm_msg.raised)
+  {
+    for (size_t index : __clear_dispatch)
+      __invoke(__callbacks[index], alarm_msg);
+  }
+  else if (alarm_msg.severity < __raise_dispatch.size())
+  {
+    for (size_t index : __raise_dispatch[alarm_msg.severity])
+      __invoke(__callbacks[index], alarm_msg);
+  }
+  else
+  {
     for (auto &cb : __callbacks)
-      try
-      {
-        cb(alarm_msg);
-      }
-      catch (std::exception &e)
-      {
-        std::stringstream msg;
-        msg << __object_name << ": callback threw an exception: " << e.what();
-        ROS_ERROR("%s", msg.str().c_str());
-      }
+      __invoke(cb, alarm_msg);
+  }
+}
+
+template <typename callable_t>
+void AlarmListener<callable_t>::__invoke(ListenerCb<callable_t> &cb, ros_alarms::Alarm const &alarm_msg)
+{
+  auto call = [this](ListenerCb<callable_t> &cb, ros_alarms::Alarm const &alarm_msg) {
+    try
+    {
+      cb(alarm_msg);
+    }
+    catch (std::exception &e)
+    {
+      std::stringstream msg;
+      msg << __object_name << ": callback threw an exception: " << e.what();
+      ROS_ERROR("%s", msg.str().c_str());
+    }
+  };
+
+  if (!cb.on_executor)
+  {
+    call(cb, alarm_msg);
+    return;
   }
+  // A copy, as callbacks may be cleared before the executor gets to it
+  ListenerCb<callable_t> copy = cb;
+  __executor_queue.addCallback(
+      boost::make_shared<AlarmUpdateCallback>([call, copy, alarm_msg]() mutable { call(copy, alarm_msg); }));
 }
 
 }  // namespace ros_alarms
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace ros_alarms
+{
+// Same host fast path for alarms, alongside the server. Broadcasters write each raise or clear into a
+// table in POSIX shared memory before sending it to the server, and listeners in any process on the
+// host read it from there with one atomic load, so a kill reaches them in well under a millisecond
+// and without the master or the server.
+//
+// The table has one slot per alarm name, claimed by whichever broadcaster or listener uses it first.
+// A slot's state is a single 64 bit word of the raised flag, the severity and a sequence number
+// counting its writes, so it is never read torn. The segment is named after the ROS master URI, so
+// separate ROS systems on one host (e.g. a simulation next to the vehicle) do not share alarms.
+//
+// The server stays the authority. A listener takes the shared state over the server's only from a
+// write until the server agrees with it, or until the server disagrees and the write is more than
+// contest_ns old (see AlarmCache::Entry::isRaised). So a server update that was sent before the
+// write and arrives after it does not undo it, alarms changed through the server alone, by Python
+// nodes or the command line, still read correctly, and with no server the shared state holds.
+class SharedAlarms
+{
+public:
+  static const size_t max_alarms = 256;
+  static const size_t max_name = 63;
+  // How long a write holds against a server that disagrees with it
+  static const int64_t contest_ns = 500000000;
+
+  struct Slot
+  {
+    std::atomic<uint64_t> key;    // hash of the name, 0 while free
+    std::atomic<uint64_t> state;  // sequence << 16 | severity << 1 | raised
+    std::atomic<int64_t> stamp;   // wall time of the last write, in nanoseconds
+    char name[max_name + 1];      // for inspecting the segment, set by whoever claimed the slot
+  };
+
+  // Maps the segment on first use. If it can not be, slot() returns nullptr and alarms only go
+  // through the server.
+  static SharedAlarms &instance();
+
+  bool ok() const
+  {
+    return slots_ != nullptr;
+  }
+
+  // The alarm's slot, claimed if no one has yet, or nullptr if the segment is unavailable or full
+  Slot *slot(std::string const &alarm_name);
+
+  // Records a raise or clear, bumping the sequence number
+  static void write(Slot &slot, bool raised, int severity);
+  // Nanoseconds since the slot was last written
+  static int64_t age(Slot const &slot);
+
+  static bool raised(uint64_t state)
+  {
+    return state & 1;
+  }
+  static int severity(uint64_t state)
+  {
+    return (state >> 1) & 0x7fff;
+  }
+  static uint64_t sequence(uint64_t state)
+  {
+    return state >> 16;
+  }
+
+private:
+  SharedAlarms();
+
+  Slot *slots_ = nullptr;
+};
+
+}  // namespace ros_alarms
@@ -0,0 +1,106 @@
+#include <ros_alarms/alarm_cache.hpp>
+
+namespace ros_alarms
+{
+AlarmCache &AlarmCache::instance()
+{
+  // Never destroyed, so the spinner is not torn down after roscpp during static destruction
+  static AlarmCache *cache = new AlarmCache();
+  return *cache;
+}
+
+AlarmCache::AlarmCache() : async_spinner_(1, &cb_queue_)
+{
+  nh_.setCallbackQueue(&cb_queue_);
+  update_subscriber_ = nh_.subscribe("/alarm/updates", 1000, &AlarmCache::updateCb, this);
+  connection_timer_ = nh_.createWallTimer(ros::WallDuration(0.1), &AlarmCache::checkConnection, this);
+  async_spinner_.start();
+}
+
+AlarmCache::Entry &AlarmCache::entry(std::string const &alarm_name)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<Entry> &entry = entries_[alarm_name];
+  if (!entry)
+  {
+    entry.reset(new Entry());
+    entry->msg.alarm_name = alarm_name;
+    // Only writes from now on are newer than what the server has, the segment outlives processes
+    entry->shared = SharedAlarms::instance().slot(alarm_name);
+    if (entry->shared)
+      entry->shared_seen.store(SharedAlarms::sequence(entry->shared->state.load(std::memory_order_acquire)));
+  }
+  return *entry;
+}
+
+void AlarmCache::update(ros_alarms::Alarm const &msg, ros::Time stamp, bool pushed)
+{
+  Entry *entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(msg.alarm_name);
+    if (it == entries_.end())  // No listener in this process cares about it
+      return;
+    entry = it->second.get();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    entry->msg = msg;
+    entry->raised.store(msg.raised, std::memory_order_relaxed);
+    entry->severity.store(msg.severity, std::memory_order_relaxed);
+    entry->stamp.store(stamp.toNSec(), std::memory_order_relaxed);
+    // The server has caught up with the last write to the shared state if it agrees with it, or
+    // overrides it if the write is too old to still be on its way to the server. Otherwise this
+    // may be an update sent before the write, so the write holds for now.
+    if (entry->shared)
+    {
+      uint64_t state = entry->shared->state.load(std::memory_order_acquire);
+      if (SharedAlarms::raised(state) == msg.raised || SharedAlarms::age(*entry->shared) > SharedAlarms::contest_ns)
+        entry->shared_seen.store(SharedAlarms::sequence(state), std::memory_order_release);
+      else
+        entry->shared_contested.store(SharedAlarms::sequence(state), std::memory_order_release);
+    }
+    entry->synced.store(true, std::memory_order_release);
+    // Published last, so a reader seeing the new sequence number sees the state it numbers
+    if (pushed)
+      entry->sequence.fetch_add(1, std::memory_order_release);
+  }
+}
+
+int AlarmCache::addObserver(std::string const &alarm_name, Observer observer)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  observers_.push_back({ next_observer_, alarm_name, observer });
+  return next_observer_++;
+}
+
+void AlarmCache::removeObserver(int id)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = observers_.begin(); it != observers_.end(); ++it)
+    if (it->id == id)
+    {
+      observers_.erase(it);
+      return;
+    }
+}
+
+void AlarmCache::updateCb(ros_alarms::Alarm const &msg)
+{
+  update(msg, ros::Time::now(), true);
+
+  // Under the lock, so an observer is never called once removeObserver has returned
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto const &observer : observers_)
+    if (observer.alarm_name == msg.alarm_name)
+      observer.observer(msg);
+}
+
+void AlarmCache::checkConnection(ros::WallTimerEvent const &)
+{
+  if (update_subscriber_.getNumPublishers() > 0)
+    last_connected_.store(ros::Time::now().toNSec(), std::memory_order_release);
+}
+
+}  // namespace ros_alarms
@@ -1,5 +1,8 @@
 #include <ros_alarms/broadcaster.hpp>
 
+#include <algorithm>
+#include <chrono>
+
 namespace ros_alarms
 {
 using namespace std;
@@ -21,14 +24,29 @@ AlarmBroadcaster::AlarmBroadcaster(ros::NodeHandle& nh, AlarmProxy* alarm)
   ROS_INFO("%s", msg.str().c_str());
 }
 
+ros_alarms::Alarm AlarmBroadcaster::__asMsg() const
+{
+  return AlarmProxy(__alarm_ptr->alarm_name, __alarm_ptr->raised, __alarm_ptr->node_name,
+                    __alarm_ptr->problem_description, __alarm_ptr->json_parameters, __alarm_ptr->severity)
+      .as_msg();
+}
+
+void AlarmBroadcaster::__publishShared()
+{
+  // Looked up every time, as the proxy, and so the alarm's name, may change between publishes
+  SharedAlarms::Slot* slot = SharedAlarms::instance().slot(__alarm_ptr->alarm_name);
+  if (slot)
+    SharedAlarms::write(*slot, __alarm_ptr->raised, __alarm_ptr->severity);
+}
+
 bool AlarmBroadcaster::publish()
 {
-  ros_alarms::Alarm a =
-      AlarmProxy(__alarm_ptr->alarm_name, __alarm_ptr->raised, __alarm_ptr->node_name, __alarm_ptr->problem_description,
-                 __alarm_ptr->json_parameters, __alarm_ptr->severity)
-          .as_msg();
+  if (__async)
+    return publishAsync();
+
+  __publishShared();
   ros_alarms::AlarmSet srv;
-  srv.request.alarm = a;
+  srv.request.alarm = __asMsg();
   bool success = __set_alarm.call(srv);
   if (!success)
   {
@@ -38,4 +56,99 @@ bool AlarmBroadcaster::publish()
   return success;
 }
 
+bool AlarmBroadcaster::publishAsync()
+{
+  __publishShared();
+  bool queued = AlarmSender::instance().send(__asMsg());
+  if (!queued)
+    ROS_WARN_THROTTLE(1.0, "Dropped %s, too many alarms are waiting to be sent", __alarm_ptr->str().c_str());
+  return queued;
+}
+
+AlarmSender& AlarmSender::instance()
+{
+  // Never destroyed, so the thread is not joined during static destruction
+  static AlarmSender* sender = new AlarmSender();
+  return *sender;
+}
+
+AlarmSender::AlarmSender() : __sender_thread(&AlarmSender::run, this)
+{
+}
+
+bool AlarmSender::send(ros_alarms::Alarm const& alarm)
+{
+  {
+    std::lock_guard<std::mutex> lock(__mutex);
+    auto it = __pending.find(alarm.alarm_name);
+    if (it != __pending.end())  // Replaces the state still waiting to be sent
+    {
+      it->second = alarm;
+      return true;
+    }
+    if (__pending.size() >= max_pending)
+      return false;
+    __pending.emplace(alarm.alarm_name, alarm);
+    __order.push_back(alarm.alarm_name);
+  }
+  __queued.notify_one();
+  return true;
+}
+
+bool AlarmSender::flush(ros::WallDuration timeout)
+{
+  std::unique_lock<std::mutex> lock(__mutex);
+  return __idle.wait_for(lock, std::chrono::nanoseconds(timeout.toNSec()),
+                         [this] { return __pending.empty() && !__sending; });
+}
+
+void AlarmSender::run()
+{
+  ros::NodeHandle nh;
+  // Persistent, so sends do not look up and connect to the service every time
+  ros::ServiceClient set_alarm = nh.serviceClient<ros_alarms::AlarmSet>("/alarm/set", true);
+  const double min_backoff = 0.05, max_backoff = 2.0;
+  double backoff = min_backoff;
+
+  std::unique_lock<std::mutex> lock(__mutex);
+  while (true)
+  {
+    __queued.wait(lock, [this] { return !__order.empty(); });
+    std::string name = __order.front();
+    __order.pop_front();
+    ros_alarms::AlarmSet srv;
+    srv.request.alarm = __pending[name];
+    __pending.erase(name);
+    __sending = true;
+    lock.unlock();
+
+    if (!set_alarm.isValid())
+      set_alarm = nh.serviceClient<ros_alarms::AlarmSet>("/alarm/set", true);
+    bool success = set_alarm.call(srv);
+
+    lock.lock();
+    __sending = false;
+    if (success)
+    {
+      backoff = min_backoff;
+    }
+    else
+    {
+      ROS_WARN_THROTTLE(5.0, "Failed to send alarm %s to the alarm server, retrying in %.2fs", name.c_str(), backoff);
+      // Retried first, unless a newer state has been queued in the meantime
+      if (__pending.find(name) == __pending.end())
+      {
+        __pending.emplace(name, srv.request.alarm);
+        __order.push_front(name);
+      }
+      lock.unlock();
+      std::this_thread::sleep_for(std::chrono::duration<double>(backoff));
+      lock.lock();
+      backoff = std::min(2 * backoff, max_backoff);
+    }
+    if (__pending.empty())
+      __idle.notify_all();
+  }
+}
+
 }  // namespace ros_alarms
@@ -0,0 +1,156 @@
+#include <ros_alarms/heartbeat_monitor_group.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+namespace ros_alarms
+{
+HeartbeatMonitorGroup::HeartbeatMonitorGroup(ros::NodeHandle nh, ros::Duration resolution, size_t slots)
+  : __nh(nh), __async_spinner(1, &__cb_queue), __resolution(resolution.toNSec()), __wheel(std::max<size_t>(slots, 1))
+{
+  // The subscribers and the wheel's timer all run in the privately owned CallbackQueue
+  __nh.setCallbackQueue(&__cb_queue);
+  __wheel_timer = __nh.createTimer(resolution, &HeartbeatMonitorGroup::__turnWheel, this);
+}
+
+HeartbeatMonitorGroup::~HeartbeatMonitorGroup()
+{
+  __async_spinner.stop();
+}
+
+size_t HeartbeatMonitorGroup::__addMonitor(std::string const &alarm_name, std::string const &heartbeat_topic,
+                                           ros::Duration time_to_raise, ros::Duration time_to_clear)
+{
+  std::unique_ptr<Monitor> monitor(new Monitor());
+  monitor->heartbeat_topic = heartbeat_topic;
+  monitor->time_to_raise = time_to_raise.toNSec();
+  monitor->time_to_clear = time_to_clear.toNSec();
+  monitor->alarm_proxy = AlarmProxy(alarm_name, false, "", "", 5);
+  monitor->alarm_broadcaster.reset(new AlarmBroadcaster(__nh, &monitor->alarm_proxy));
+
+  // Register cleared alarm w/ alarm server, then raise and clear without blocking the wheel
+  monitor->alarm_broadcaster->clear();
+  monitor->alarm_broadcaster->setAsync(true);
+
+  __monitors.push_back(std::move(monitor));
+  __last_beat.push_back(ros::Time::now().toNSec());
+  __time_recovering.push_back(0);
+  __due_tick.push_back(0);
+  __state.push_back(State::healthy);
+  return __monitors.size() - 1;
+}
+
+void HeartbeatMonitorGroup::startMonitoring()
+{
+  // Comparisons for time_to_raise and time_to_clear will be based off this time
+  int64_t now = ros::Time::now().toNSec();
+  __tick = now / __resolution;
+  for (auto &slot : __wheel)
+    slot.clear();
+  for (size_t monitor = 0; monitor < __monitors.size(); ++monitor)
+  {
+    __last_beat[monitor] = now;
+    __time_recovering[monitor] = 0;
+    __state[monitor] = __monitors[monitor]->alarm_proxy.raised ? State::lost : State::healthy;
+    if (__state[monitor] == State::healthy)
+      __schedule(monitor, now + __monitors[monitor]->time_to_raise);
+  }
+  __cb_queue.clear();
+  __async_spinner.start();
+}
+
+void HeartbeatMonitorGroup::__heardHeartbeat(size_t monitor)
+{
+  int64_t now = ros::Time::now().toNSec();
+  int64_t time_since_prev_beat = now - __last_beat[monitor];
+  __last_beat[monitor] = now;
+
+  // We're done if the heartbeat is healthy, the wheel will find its deadline has moved
+  if (__state[monitor] == State::healthy)
+    return;
+
+  Monitor const &m = *__monitors[monitor];
+  if (__state[monitor] == State::recovering)  // Either increase recovery time or reset it
+  {
+    if (time_since_prev_beat < m.time_to_raise)
+    {
+      __time_recovering[monitor] += time_since_prev_beat;
+      if (__time_recovering[monitor] > m.time_to_clear)
+      {
+        __state[monitor] = State::healthy;
+        __setAlarm(monitor, false);
+        __schedule(monitor, now + m.time_to_raise);
+      }
+    }
+    else
+    {
+      __time_recovering[monitor] = 0;
+    }
+  }
+  else  // Set flag for recovery mode
+  {
+    __state[monitor] = State::recovering;
+    __time_recovering[monitor] = 0;
+  }
+}
+
+void HeartbeatMonitorGroup::__turnWheel(const ros::TimerEvent &te)
+{
+  int64_t now = ros::Time::now().toNSec();
+  int64_t tick = now / __resolution;
+  int64_t slots = __wheel.size();
+
+  // Each slot once at most, which after a stall is every deadline that could be due
+  for (int64_t t = std::max(__tick + 1, tick - slots + 1); t <= tick; ++t)
+  {
+    __tick = t;
+    std::vector<size_t> &slot = __wheel[t % slots];
+    for (size_t i = 0; i < slot.size();)
+    {
+      size_t monitor = slot[i];
+      if (__due_tick[monitor] > tick)  // Due on a later turn of the wheel
+      {
+        ++i;
+        continue;
+      }
+      slot[i] = slot.back();
+      slot.pop_back();
+
+      int64_t deadline = __last_beat[monitor] + __monitors[monitor]->time_to_raise;
+      if (now > deadline)  // Raise heartbeat-loss alarm
+      {
+        __state[monitor] = State::lost;
+        __setAlarm(monitor, true);
+      }
+      else  // Beaten since it was scheduled
+      {
+        __schedule(monitor, deadline);
+      }
+    }
+  }
+  __tick = std::max(__tick, tick);
+}
+
+void HeartbeatMonitorGroup::__schedule(size_t monitor, int64_t deadline)
+{
+  int64_t tick = std::max((deadline + __resolution - 1) / __resolution, __tick + 1);
+  __due_tick[monitor] = tick;
+  __wheel[tick % __wheel.size()].push_back(monitor);
+}
+
+void HeartbeatMonitorGroup::__setAlarm(size_t monitor, bool raised)
+{
+  Monitor &m = *__monitors[monitor];
+
+  // Set the last healthy beat time as a json param on the alarm proxy, only when it is published
+  std::stringstream json;
+  json << "{\"last_heathy_beat\" : " << getLastBeatTime(monitor).toSec() << "}";
+  m.alarm_proxy.json_parameters = json.str();
+
+  if (raised)
+    m.alarm_broadcaster->raise();
+  else
+    m.alarm_broadcaster->clear();
+}
+
+}  // namespace ros_alarms
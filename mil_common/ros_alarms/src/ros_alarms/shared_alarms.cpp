@@ -0,0 +1,116 @@
+#include <ros_alarms/shared_alarms.hpp>
+
+#include <ros/master.h>
+#include <ros/ros.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace ros_alarms
+{
+namespace
+{
+// Every word is used as is from a fresh, zeroed segment, which needs atomics that are plain words
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared alarms need lock free 64 bit atomics");
+
+uint64_t fnv1a(std::string const &text)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : text)
+    hash = (hash ^ c) * 1099511628211ull;
+  return hash;
+}
+}  // namespace
+
+const size_t SharedAlarms::max_alarms;
+const size_t SharedAlarms::max_name;
+const int64_t SharedAlarms::contest_ns;
+
+SharedAlarms &SharedAlarms::instance()
+{
+  // Never destroyed, so slots handed out stay mapped through static destruction
+  static SharedAlarms *alarms = new SharedAlarms();
+  return *alarms;
+}
+
+SharedAlarms::SharedAlarms()
+{
+  char name[64];
+  std::snprintf(name, sizeof(name), "/ros_alarms_%016llx",
+                static_cast<unsigned long long>(fnv1a(ros::master::getURI())));
+  size_t size = max_alarms * sizeof(Slot);
+
+  // Whoever opens it first creates it, zeroed, which is an empty table, so there is nothing to set up
+  int fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+  if (fd < 0)
+  {
+    ROS_WARN("Alarms only go through the server, can not open shared memory %s: %s", name, std::strerror(errno));
+    return;
+  }
+  // Open to every user on the host, whatever the umask of the process that created it
+  fchmod(fd, 0666);
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (static_cast<size_t>(st.st_size) < size && ftruncate(fd, size) != 0))
+  {
+    ROS_WARN("Alarms only go through the server, can not size shared memory %s: %s", name, std::strerror(errno));
+    close(fd);
+    return;
+  }
+  void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    ROS_WARN("Alarms only go through the server, can not map shared memory %s: %s", name, std::strerror(errno));
+    return;
+  }
+  slots_ = static_cast<Slot *>(map);
+}
+
+SharedAlarms::Slot *SharedAlarms::slot(std::string const &alarm_name)
+{
+  if (!slots_)
+    return nullptr;
+  uint64_t key = fnv1a(alarm_name);
+  if (key == 0)
+    key = 1;
+
+  // Open addressing, and slots are never freed, so the first free slot probed ends the search
+  for (size_t i = 0; i < max_alarms; ++i)
+  {
+    Slot &slot = slots_[(key + i) % max_alarms];
+    uint64_t found = slot.key.load(std::memory_order_acquire);
+    if (found == 0 && slot.key.compare_exchange_strong(found, key, std::memory_order_acq_rel))
+    {
+      std::strncpy(slot.name, alarm_name.c_str(), max_name);
+      return &slot;
+    }
+    if (found == key)
+      return &slot;
+  }
+  ROS_WARN_ONCE("Alarm %s only goes through the server, the shared memory table is full", alarm_name.c_str());
+  return nullptr;
+}
+
+void SharedAlarms::write(Slot &slot, bool raised, int severity)
+{
+  slot.stamp.store(ros::WallTime::now().toNSec(), std::memory_order_relaxed);
+  uint64_t state = slot.state.load(std::memory_order_relaxed);
+  uint64_t next;
+  do
+  {
+    next = ((sequence(state) + 1) << 16) | (static_cast<uint64_t>(severity & 0x7fff) << 1) | (raised ? 1 : 0);
+  } while (!slot.state.compare_exchange_weak(state, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+int64_t SharedAlarms::age(Slot const &slot)
+{
+  return ros::WallTime::now().toNSec() - slot.stamp.load(std::memory_order_relaxed);
+}
+
+}  // namespace ros_alarms
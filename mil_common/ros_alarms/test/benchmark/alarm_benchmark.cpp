@@ -0,0 +1,421 @@
+#include <ros/ros.h>
+#include <std_msgs/Header.h>
+
+#include <ros_alarms/broadcaster.hpp>
+#include <ros_alarms/heartbeat_monitor.hpp>
+#include <ros_alarms/heartbeat_monitor_group.hpp>
+#include <ros_alarms/listener.hpp>
+#include <ros_alarms/shared_alarms.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Measures the alarm system end to end against a running alarm server, to track the latency of the
+ * kill switch and regressions from the async broadcaster and the listener cache:
+ *   - raise to callback latency, AlarmBroadcaster -> server -> AlarmListener callback, sync and async
+ *   - raise to isRaised() latency through SharedAlarms, for a listener polling on another thread
+ *   - cost of polling a listener with isRaised() and queryRaised()
+ *   - delay past time_to_raise in detecting a lost heartbeat, by HeartbeatMonitor and HeartbeatMonitorGroup
+ *   - raising hundreds of alarms at once, each with its own listener
+ *
+ * Run with the server: roslaunch ros_alarms alarm_benchmark.launch
+ * Private params: iterations (200), trials (20), alarms (200)
+ */
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double ms(Clock::duration d)
+{
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void report(std::string const& name, std::vector<double> samples, std::string const& unit = "ms")
+{
+  std::cout << std::left << std::setw(36) << name;
+  if (samples.empty())
+  {
+    std::cout << "no samples" << std::endl;
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  auto at = [&](double q) { return samples[std::min(samples.size() - 1, size_t(q * samples.size()))]; };
+  std::cout << std::fixed << std::setprecision(3) << std::setw(8) << samples.size() << std::setw(10) << samples.front()
+            << std::setw(10) << at(0.5) << std::setw(10) << at(0.9) << std::setw(10) << at(0.99) << std::setw(10)
+            << samples.back() << unit << std::endl;
+}
+
+void header(std::string const& title)
+{
+  std::cout << std::endl
+            << title << std::endl
+            << std::left << std::setw(36) << "" << std::setw(8) << "count" << std::setw(10) << "min" << std::setw(10)
+            << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+}
+
+// Times from a broadcast until the listener's callback sees the alarm in the expected state
+class Stopwatch
+{
+public:
+  void arm(bool raised)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    expected_ = raised;
+    fired_ = false;
+  }
+  void fire(bool raised)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (raised != expected_ || fired_)
+      return;
+    stamp_ = Clock::now();
+    fired_ = true;
+    cv_.notify_all();
+  }
+  bool wait(Clock::time_point& stamp, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000))
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cv_.wait_for(lock, timeout, [this] { return fired_; }))
+      return false;
+    stamp = stamp_;
+    return true;
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool expected_ = false;
+  bool fired_ = false;
+  Clock::time_point stamp_;
+};
+
+void benchmarkLatency(ros::NodeHandle& nh, int iterations)
+{
+  header("raise/clear to listener callback");
+  for (bool async : { false, true })
+  {
+    std::string alarm_name = async ? "benchmark_latency_async" : "benchmark_latency";
+    ros_alarms::AlarmBroadcaster broadcaster(nh);
+    broadcaster.getAlarm() = ros_alarms::AlarmProxy(alarm_name, false, "", "", 5);
+    broadcaster.clear();
+    broadcaster.setAsync(async);
+
+    Stopwatch stopwatch;
+    ros_alarms::AlarmListener<> listener(nh, alarm_name);
+    listener.addCb([&stopwatch](ros_alarms::AlarmProxy alarm) { stopwatch.fire(alarm.raised); });
+    listener.waitForConnection(ros::Duration(2.0));
+    listener.start();
+
+    std::vector<double> latency;
+    int missed = 0;
+    for (int i = 0; i < iterations && ros::ok(); ++i)
+    {
+      bool raise = i % 2 == 0;
+      stopwatch.arm(raise);
+      Clock::time_point start = Clock::now(), stamp;
+      if (raise)
+        broadcaster.raise();
+      else
+        broadcaster.clear();
+      if (stopwatch.wait(stamp))
+        latency.push_back(ms(stamp - start));
+      else
+        ++missed;
+    }
+    listener.stop();
+    report(async ? "async broadcaster" : "sync broadcaster", latency);
+    if (missed)
+      std::cout << "  " << missed << " updates never reached the callback" << std::endl;
+  }
+}
+
+void benchmarkShared(ros::NodeHandle& nh, int iterations)
+{
+  header("raise/clear to a polling listener");
+  if (!ros_alarms::SharedAlarms::instance().ok())
+  {
+    std::cout << "no shared memory, polls only see the server" << std::endl;
+    return;
+  }
+  ros_alarms::AlarmBroadcaster broadcaster(nh);
+  broadcaster.getAlarm() = ros_alarms::AlarmProxy("benchmark_shared", false, "", "", 5);
+  broadcaster.setAsync(true);
+  broadcaster.clear();
+  ros_alarms::AlarmListener<> listener(nh, "benchmark_shared");
+
+  // The poller stamps the first poll that sees each raise or clear, as a thruster driver or
+  // controller polling the kill alarm would
+  std::atomic<bool> expected{ false }, armed{ false }, done{ false };
+  std::atomic<Clock::rep> seen{ 0 };
+  std::thread poller([&] {
+    while (!done)
+      if (armed && listener.isRaised() == expected)
+      {
+        seen = Clock::now().time_since_epoch().count();
+        armed = false;
+      }
+  });
+
+  std::vector<double> latency;
+  int missed = 0;
+  for (int i = 0; i < iterations && ros::ok(); ++i)
+  {
+    bool raise = i % 2 == 0;
+    expected = raise;
+    Clock::time_point start = Clock::now();
+    armed = true;
+    if (raise)
+      broadcaster.raise();
+    else
+      broadcaster.clear();
+    Clock::time_point deadline = start + std::chrono::seconds(1);
+    while (armed && Clock::now() < deadline)
+      std::this_thread::yield();
+    if (armed.exchange(false))
+      ++missed;
+    else
+      latency.push_back(ms(Clock::time_point(Clock::duration(seen)) - start));
+    // Lets the server catch up, so each iteration starts from where it agrees
+    ros_alarms::AlarmSender::instance().flush(ros::WallDuration(1.0));
+    ros::WallDuration(0.01).sleep();
+  }
+  done = true;
+  poller.join();
+  report("isRaised() through shared memory", latency);
+  if (missed)
+    std::cout << "  " << missed << " updates were never seen by the poller" << std::endl;
+}
+
+void benchmarkPolling(ros::NodeHandle& nh, int iterations)
+{
+  header("polling a listener");
+  ros_alarms::AlarmListener<> listener(nh, "benchmark_latency");
+  listener.waitForConnection(ros::Duration(2.0));
+
+  const int reads = 1000000;
+  std::atomic<int> raised{ 0 };
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < reads; ++i)
+    raised += listener.isRaised();
+  report("isRaised()", { 1e6 * ms(Clock::now() - start) / reads }, "ns");
+
+  std::vector<double> query;
+  for (int i = 0; i < iterations && ros::ok(); ++i)
+  {
+    start = Clock::now();
+    listener.queryRaised();
+    query.push_back(ms(Clock::now() - start));
+  }
+  report("queryRaised(), server", query);
+
+  query.clear();
+  listener.setStalenessBound(ros::Duration(0.5));
+  for (int i = 0; i < iterations && ros::ok(); ++i)
+  {
+    start = Clock::now();
+    listener.queryRaised();
+    query.push_back(1e6 * ms(Clock::now() - start));
+  }
+  report("queryRaised(), cache fresh", query, "ns");
+}
+
+// Beats on a topic until stopped, remembering when the last beat was sent
+class Heart
+{
+public:
+  Heart(ros::NodeHandle& nh, std::string const& topic, double rate)
+    : pub_(nh.advertise<std_msgs::Header>(topic, 10)), period_(std::chrono::duration<double>(1. / rate))
+  {
+    thread_ = std::thread([this] {
+      while (!done_)
+      {
+        if (beating_)
+        {
+          pub_.publish(std_msgs::Header());
+          last_beat_ = Clock::now().time_since_epoch().count();
+        }
+        std::this_thread::sleep_for(period_);
+      }
+    });
+  }
+  ~Heart()
+  {
+    done_ = true;
+    thread_.join();
+  }
+  void beat(bool beating)
+  {
+    beating_ = beating;
+  }
+  Clock::time_point lastBeat() const
+  {
+    return Clock::time_point(Clock::duration(last_beat_.load()));
+  }
+  int getNumSubscribers() const
+  {
+    return pub_.getNumSubscribers();
+  }
+
+private:
+  ros::Publisher pub_;
+  std::chrono::duration<double> period_;
+  std::atomic<bool> beating_{ false };
+  std::atomic<bool> done_{ false };
+  std::atomic<Clock::rep> last_beat_{ 0 };
+  std::thread thread_;
+};
+
+// Stops the heart once it is healthy, and times from its last beat until the alarm is raised
+std::vector<double> heartbeatLossDelays(ros::NodeHandle& nh, Heart& heart, std::string const& alarm_name,
+                                        std::function<bool()> healthy, ros::Duration time_to_raise, int trials)
+{
+  Stopwatch stopwatch;
+  ros_alarms::AlarmListener<> listener(nh, alarm_name);
+  listener.addRaiseCb([&stopwatch](ros_alarms::AlarmProxy) { stopwatch.fire(true); });
+  listener.start();
+
+  std::vector<double> delays;
+  for (int i = 0; i < trials && ros::ok(); ++i)
+  {
+    heart.beat(true);
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while ((!healthy() || listener.isRaised()) && Clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    stopwatch.arm(true);
+    heart.beat(false);
+    Clock::time_point stamp;
+    if (stopwatch.wait(stamp, std::chrono::milliseconds(5000)))
+      delays.push_back(ms(stamp - heart.lastBeat()) - 1e3 * time_to_raise.toSec());
+  }
+  listener.stop();
+  heart.beat(false);
+  return delays;
+}
+
+void benchmarkHeartbeats(ros::NodeHandle& nh, int trials)
+{
+  header("heartbeat loss detected past time_to_raise");
+  ros::Duration time_to_raise(0.2), time_to_clear(0.2);
+  {
+    Heart heart(nh, "benchmark_heartbeat", 100);
+    ros_alarms::HeartbeatMonitor<std_msgs::Header> monitor(nh, "benchmark_heartbeat", "benchmark_heartbeat",
+                                                           [](std_msgs::Header) { return true; }, time_to_raise,
+                                                           time_to_clear);
+    monitor.waitForConnection(ros::Duration(2.0));
+    monitor.startMonitoring();
+    report("HeartbeatMonitor",
+           heartbeatLossDelays(nh, heart, "benchmark_heartbeat", [&] { return monitor.healthy(); }, time_to_raise,
+                               trials));
+  }
+  {
+    Heart heart(nh, "benchmark_heartbeat_group", 100);
+    ros_alarms::HeartbeatMonitorGroup group(nh);
+    size_t monitor = group.add<std_msgs::Header>("benchmark_heartbeat_group", "benchmark_heartbeat_group",
+                                                 [](std_msgs::Header) { return true; }, time_to_raise,
+                                                 time_to_clear);
+    ros::Time start = ros::Time::now();
+    while (group.getNumConnections(monitor) < 1 && ros::Time::now() - start < ros::Duration(2.0))
+      ros::Duration(0.01).sleep();
+    group.startMonitoring();
+    report("HeartbeatMonitorGroup", heartbeatLossDelays(nh, heart, "benchmark_heartbeat_group",
+                                                        [&] { return group.healthy(monitor); }, time_to_raise,
+                                                        trials));
+  }
+}
+
+void benchmarkScale(ros::NodeHandle& nh, int alarms)
+{
+  header("raising " + std::to_string(alarms) + " alarms, a listener each");
+  for (bool async : { false, true })
+  {
+    std::vector<std::unique_ptr<ros_alarms::AlarmBroadcaster>> broadcasters;
+    std::vector<std::unique_ptr<ros_alarms::AlarmListener<>>> listeners;
+    std::vector<Clock::time_point> sent(alarms), heard(alarms);
+    std::mutex mutex;
+    std::condition_variable cv;
+    int count = 0;
+
+    Clock::time_point setup = Clock::now();
+    for (int i = 0; i < alarms; ++i)
+    {
+      std::string alarm_name = "benchmark_scale_" + std::to_string(i);
+      broadcasters.emplace_back(new ros_alarms::AlarmBroadcaster(nh));
+      broadcasters.back()->getAlarm() = ros_alarms::AlarmProxy(alarm_name, false, "", "", 5);
+      broadcasters.back()->clear();
+      broadcasters.back()->setAsync(async);
+      listeners.emplace_back(new ros_alarms::AlarmListener<>(nh, alarm_name));
+      listeners.back()->addRaiseCb([&, i](ros_alarms::AlarmProxy) {
+        std::lock_guard<std::mutex> lock(mutex);
+        heard[i] = Clock::now();
+        ++count;
+        cv.notify_all();
+      });
+      listeners.back()->start();
+    }
+    double setup_ms = ms(Clock::now() - setup);
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < alarms; ++i)
+    {
+      sent[i] = Clock::now();
+      broadcasters[i]->raise();
+    }
+    double raise_ms = ms(Clock::now() - start);
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait_for(lock, std::chrono::seconds(30), [&] { return count == alarms; });
+    }
+    double total_ms = ms(Clock::now() - start);
+
+    std::vector<double> latency;
+    for (int i = 0; i < alarms; ++i)
+      if (heard[i] != Clock::time_point())
+        latency.push_back(ms(heard[i] - sent[i]));
+    report(async ? "async, raise to callback" : "sync, raise to callback", latency);
+    std::cout << "  " << count << "/" << alarms << " heard, raising took " << raise_ms << " ms, all heard in "
+              << total_ms << " ms, setting up took " << setup_ms << " ms" << std::endl;
+
+    for (auto& listener : listeners)
+      listener->stop();
+    for (auto& broadcaster : broadcasters)
+      broadcaster->clear();
+    ros_alarms::AlarmSender::instance().flush(ros::WallDuration(10.0));
+  }
+}
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  ros::init(argc, argv, "alarm_benchmark", ros::init_options::AnonymousName);
+  ros::NodeHandle nh;
+  ros::NodeHandle private_nh("~");
+  int iterations = private_nh.param("iterations", 200);
+  int trials = private_nh.param("trials", 20);
+  int alarms = private_nh.param("alarms", 200);
+
+  if (!ros::service::waitForService("/alarm/set", ros::Duration(5.0)))
+  {
+    std::cerr << "No alarm server, run with roslaunch ros_alarms alarm_benchmark.launch" << std::endl;
+    return 1;
+  }
+
+  benchmarkLatency(nh, iterations);
+  benchmarkShared(nh, iterations);
+  benchmarkPolling(nh, iterations);
+  benchmarkHeartbeats(nh, trials);
+  benchmarkScale(nh, alarms);
+  return 0;
+}
@@ -53,18 +53,18 @@ TEST(ListenerTest, listenerTest)
   // Last update time happened wehen we called ab.clear()
   auto first_query = listener.getLastUpdateTime();
 
+  auto first_sequence = listener.getSequence();
   ab.updateSeverity(5);  // This is an update to the alarm
 
   // The listener isn't querying the server before returning the status on these next
-  //   two lines, It is returning the current status of the internal AlarmProxy object,
-  //   which is not updated by these calls.
-  listener.isRaised();
-  listener.isCleared();
-
-  // Last update time should not have changed because of calls to isRaised() or isCleared()
-  //   unless you are unlucky enough to have an update cb in that short time
-  EXPECT_EQ(first_query, listener.getLastUpdateTime());
+  //   two lines, It is returning the status in the process wide alarm cache, which the
+  //   update is pushed to whether or not the listener has been started.
+  for (int i = 0; i < 1000 && !listener.isRaised(); i++)
+    ros::Duration(1E-3).sleep();
+  EXPECT_TRUE(listener.isRaised());
+  EXPECT_FALSE(listener.isCleared());
   EXPECT_EQ(listener.getCachedAlarm().raised, listener.isRaised());
+  EXPECT_LT(first_sequence, listener.getSequence());
 
   // The following query_* functions query the server before reporting the status, so the
   //   last update time should have changed
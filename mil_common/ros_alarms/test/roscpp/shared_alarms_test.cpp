@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include <ros_alarms/broadcaster.hpp>
+#include <ros_alarms/listener.hpp>
+#include <ros_alarms/shared_alarms.hpp>
+
+using ros_alarms::AlarmBroadcaster;
+using ros_alarms::AlarmListener;
+using ros_alarms::AlarmProxy;
+using ros_alarms::SharedAlarms;
+
+TEST(SharedAlarmsTest, slotPerName)
+{
+  ros::NodeHandle nh;
+  SharedAlarms& shared = SharedAlarms::instance();
+  ASSERT_TRUE(shared.ok()) << "no shared memory segment";
+
+  SharedAlarms::Slot* slot = shared.slot("shared_test_alarm");
+  ASSERT_NE(nullptr, slot);
+  EXPECT_EQ(slot, shared.slot("shared_test_alarm"));
+  EXPECT_NE(slot, shared.slot("shared_test_other_alarm"));
+  EXPECT_STREQ("shared_test_alarm", slot->name);
+
+  uint64_t before = SharedAlarms::sequence(slot->state.load());
+  SharedAlarms::write(*slot, true, 3);
+  uint64_t state = slot->state.load();
+  EXPECT_EQ(before + 1, SharedAlarms::sequence(state));
+  EXPECT_TRUE(SharedAlarms::raised(state));
+  EXPECT_EQ(3, SharedAlarms::severity(state));
+  EXPECT_LT(SharedAlarms::age(*slot), SharedAlarms::contest_ns);
+}
+
+TEST(SharedAlarmsTest, listenerSeesWritesBeforeServer)
+{
+  ros::NodeHandle nh;
+  AlarmBroadcaster ab(nh);
+  ab.getAlarm() = AlarmProxy("shared_fast_alarm", false, "shared_alarms_test", "", "", 5);
+  ab.clear();
+  AlarmListener<> listener(nh, "shared_fast_alarm");
+  ASSERT_FALSE(listener.queryRaised());
+
+  // Written only to shared memory, as a broadcaster does before it sends to the server, so the
+  // listener sees it with no update from the server
+  SharedAlarms::Slot* slot = SharedAlarms::instance().slot("shared_fast_alarm");
+  ASSERT_NE(nullptr, slot);
+  SharedAlarms::write(*slot, true, 5);
+  EXPECT_TRUE(listener.isRaised());
+
+  // Cleared through the server alone, as from Python, the server wins once the write is too old
+  // to still be on its way to it
+  ros_alarms::AlarmSet srv;
+  srv.request.alarm = AlarmProxy("shared_fast_alarm", false, "shared_alarms_test", "", "", 0).as_msg();
+  ASSERT_TRUE(ros::service::call("/alarm/set", srv));
+  for (int i = 0; i < 2000 && listener.isRaised(); i++)
+    ros::Duration(1E-3).sleep();
+  EXPECT_FALSE(listener.isRaised());
+
+  // The broadcaster's own raise is seen at once, and stays raised as the server catches up
+  ab.raise();
+  EXPECT_TRUE(listener.isRaised());
+  ros::Duration(0.1).sleep();
+  EXPECT_TRUE(listener.isRaised());
+  ab.clear();
+}
@@ -0,0 +1,89 @@
+#ifndef MIL_GAZEBO_HYDROPHONE_SYNTHESIZER_HPP
+#define MIL_GAZEBO_HYDROPHONE_SYNTHESIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace mil_gazebo
+{
+/**
+ * Synthesizes the raw samples of a hydrophone array hearing a pinger, as the sylphase board
+ * produces them: blocks of frames of one int16 sample per channel, interleaved.
+ *
+ * The pinger emits a burst of a sinusoid every ping period, starting at time 0. Each channel
+ * hears it along one or more paths (direct, and reflected off the surface or bottom), each a
+ * delay and a gain, so per hydrophone time differences and multipath come from the geometry
+ * the caller works out. Gaussian noise is added to every sample.
+ *
+ * Blocks are computed a channel at a time in loops the compiler vectorizes: the burst's
+ * sinusoid and envelope are tabulated once, a path's fractional sample delay being a phase
+ * shift of the tables, and the noise is copied from a table of Gaussian samples at a random
+ * offset rather than drawn per sample.
+ */
+class HydrophoneSynthesizer
+{
+public:
+  struct Config
+  {
+    size_t channels = 4;
+    double sample_rate = 1.2e6;
+    size_t frames_per_block = 120000;
+    /// Hz of the pinger
+    double frequency = 37000;
+    /// Seconds from the start of one burst to the next
+    double ping_period = 1.;
+    /// Seconds of each burst
+    double ping_duration = 0.004;
+    /// Standard deviation of the noise, in counts
+    double noise = 0;
+    unsigned int seed = 0;
+  };
+
+  /// How one channel hears the pinger along one path
+  struct Arrival
+  {
+    /// Seconds from emission to arrival
+    double delay;
+    /// Counts of the burst's peak as it arrives
+    double gain;
+  };
+
+  explicit HydrophoneSynthesizer(Config const& config);
+
+  Config const& config() const
+  {
+    return config_;
+  }
+
+  /// Seconds of sim time the start of a block is at
+  double BlockStart(uint64_t block) const
+  {
+    return static_cast<double>(block * config_.frames_per_block) / config_.sample_rate;
+  }
+
+  /**
+   * Synthesizes a block
+   *
+   * @param block: index of the block, which starts at BlockStart(block)
+   * @param arrivals: paths of each channel, channel major, arrivals.size() / channels of them per channel
+   * @param out: channels * frames_per_block samples, interleaved by frame
+   */
+  void Synthesize(uint64_t block, std::vector<Arrival> const& arrivals, int16_t* out);
+
+private:
+  /// Adds the bursts heard along one path to channel_
+  void AddArrival(double start, Arrival const& arrival);
+
+  Config config_;
+  /// sin and cos of the burst's phase, and its envelope, at each sample from its start
+  std::vector<float> sin_, cos_, envelope_;
+  std::vector<float> noise_;
+  std::mt19937 rng_;
+  /// The channel being synthesized
+  std::vector<float> channel_;
+};
+}
+
+#endif  // MIL_GAZEBO_HYDROPHONE_SYNTHESIZER_HPP
@@ -0,0 +1,86 @@
+#ifndef MIL_BLUEVIEW_GAZEBO_HPP
+#define MIL_BLUEVIEW_GAZEBO_HPP
+
+#include <blueview_range_profile.hpp>
+#include <mil_blueview_driver/BlueViewHead.h>
+#include <mil_blueview_driver/BlueViewPing.h>
+#include <mil_blueview_driver/BlueViewRangeProfile.h>
+#include <ros/ros.h>
+#include <gazebo/common/common.hh>
+#include <gazebo/sensors/sensors.hh>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace mil_gazebo
+{
+/**
+ * Simulates a BlueView imaging sonar on a gpu_ray (or ray) sensor, publishing each scan as the blueview_driver's
+ * range profile: a BlueViewPing on <namespace>/ranges and, with <compact> set, a BlueViewHead and
+ * BlueViewRangeProfile on <namespace>/head and <namespace>/range_profile.
+ *
+ * The sensor's horizontal samples are the beams, at the bearing of their ray in the sensor frame. Its vertical
+ * samples span the head's vertical beam width, the nearest of them being the beam's return. Returns are scaled by
+ * two way absorption and speckle, and their ranges blurred, by the noise model in the plugin's sdf:
+ *   <namespace>blueview_driver</namespace>
+ *   <frame_id>blueview</frame_id>
+ *   <intensity>0.5</intensity>          mean return, as a fraction of the full scale uint16
+ *   <absorption>0.02</absorption>       1/m, each return scaled by exp(-2 absorption range)
+ *   <speckle>0.5</speckle>              standard deviation of the multiplicative intensity noise, 0 for none
+ *   <range_noise>0.02</range_noise>     m, standard deviation of the range noise
+ *   <background>0.02</background>       mean intensity of beams without a return
+ *   <seed>0</seed>                      noise seed, so runs are repeatable
+ *   <compact>false</compact>
+ *   <range_scale>0.002</range_scale>    m per count of the compact range profile
+ */
+class MilBlueViewGazebo : public gazebo::SensorPlugin
+{
+public:
+  MilBlueViewGazebo();
+  ~MilBlueViewGazebo();
+
+  void Load(gazebo::sensors::SensorPtr _parent, sdf::ElementPtr _sdf);
+
+private:
+  void OnUpdate();
+  /// Reads the ranges and geometry of either kind of ray sensor
+  template <typename Sensor>
+  void ReadSensor(Sensor& sensor);
+  /// Fills ping_ from ranges_, one beam per horizontal sample
+  void MakePing();
+
+  ros::NodeHandle nh_;
+  ros::Publisher ping_pub_;
+  ros::Publisher head_pub_;
+  ros::Publisher range_profile_pub_;
+  gazebo::sensors::GpuRaySensorPtr gpu_sensor_;
+  gazebo::sensors::RaySensorPtr sensor_;
+  gazebo::event::ConnectionPtr update_connection_;
+  std::string frame_name_;
+
+  double intensity_ = 0.5;
+  double absorption_ = 0.02;
+  double speckle_ = 0.5;
+  double range_noise_ = 0.02;
+  double background_ = 0.02;
+  std::mt19937 rng_;
+
+  /// Latest scan, vertical sample major
+  std::vector<double> ranges_;
+  int beams_ = 0;
+  int vertical_ = 0;
+  double angle_min_ = 0;
+  double angle_max_ = 0;
+  double range_min_ = 0;
+  double range_max_ = 0;
+  gazebo::common::Time stamp_;
+
+  /// Reused between pings, so the only allocation is the first ping's
+  mil_blueview_driver::BlueViewPing ping_;
+  std::unique_ptr<BlueViewRangeProfileEncoder> encoder_;
+  mil_blueview_driver::BlueViewRangeProfile range_profile_;
+};
+}
+
+#endif
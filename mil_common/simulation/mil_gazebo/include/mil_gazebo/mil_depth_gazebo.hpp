@@ -6,6 +6,7 @@
 #include <ros/ros.h>
 #include <gazebo/common/common.hh>
 #include <gazebo/physics/physics.hh>
+#include <mil_gazebo/mil_gazebo_utils.hpp>
 
 namespace mil_gazebo
 {
@@ -28,11 +29,8 @@ public:
 private:
   void OnUpdate(const gazebo::common::UpdateInfo& info);
 
-  gazebo::common::Time last_pub_time_;
-
-  double update_period_ = 1. / 10.;
   ros::NodeHandle nh_;
-  ros::Publisher depth_pub_;
+  ThrottledPublisher<mil_msgs::DepthStamped> depth_pub_;
   ignition::math::Pose3d offset_;
   gazebo::physics::ModelPtr model_;
   std::string frame_name_;
@@ -2,8 +2,11 @@
 #ifndef MIL_DRAG_GAZEBO_HPP
 #define MIL_DRAG_GAZEBO_HPP
 
+#include <geometry_msgs/WrenchStamped.h>
+#include <ros/ros.h>
 #include <gazebo/common/common.hh>
 #include <gazebo/physics/physics.hh>
+#include <mil_gazebo/mil_gazebo_utils.hpp>
 
 namespace mil_gazebo
 {
@@ -30,6 +33,11 @@ private:
   ignition::math::Vector3d linear_coeffs_;
   ignition::math::Vector3d angular_coeffs_;
   gazebo::event::ConnectionPtr update_connection_;
+
+  /// Drag applied, in the link's frame, if debug_topic is set
+  bool debug_ = false;
+  ros::NodeHandle nh_;
+  ThrottledPublisher<geometry_msgs::WrenchStamped> debug_pub_;
 };
 }
 
@@ -8,9 +8,16 @@
 #include <gazebo/common/common.hh>
 #include <gazebo/sensors/sensors.hh>
 
+#include <array>
+
 namespace mil_gazebo
 {
 /// \brief Plugin to simulate a DVL
+///
+/// Each of the four beams is one of the ray sensor's rays, which gazebo casts together in one batch, so a beam
+/// only measures velocity while it has bottom lock, and the range is the mean height of the beams which do. The
+/// sensor's rays should be a 3x3 scan spanning the beam tilt both ways, as dvl.xacro sets up; a sensor of a single
+/// ray pointing down is used for the range of every beam instead.
 class MilDVLGazebo : public gazebo::SensorPlugin
 {
   /// Constructor
@@ -30,6 +37,10 @@ public:
 private:
   void OnUpdate();
 
+  /// Find the ray of the sensor along each beam
+private:
+  void FindBeamRays();
+
   /// \brief pointer to ros node
 private:
   ros::NodeHandle nh_;
@@ -55,6 +66,20 @@ private:
 private:
   gazebo::physics::LinkPtr parent_;
 
+  /// Direction of each beam in the DVL frame, and the ray along it, or -1 if the sensor has none
+private:
+  std::array<ignition::math::Vector3d, 4> beams_;
+
+private:
+  std::array<int, 4> beam_rays_;
+
+  /// Reused every update, so the only allocation is the first one's
+private:
+  mil_msgs::VelocityMeasurements vel_msg_;
+
+private:
+  mil_msgs::RangeStamped range_msg_;
+
   // Pointer to the update event connection
 private:
   gazebo::event::ConnectionPtr update_connection_;
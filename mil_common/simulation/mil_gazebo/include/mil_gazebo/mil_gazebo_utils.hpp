@@ -2,8 +2,17 @@
 #define MIL_GAZEBO_UTILS_H
 
 #include <geometry_msgs/Vector3.h>
+#include <ros/ros.h>
 #include <gazebo/common/common.hh>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
 namespace mil_gazebo
 {
 void Convert(ignition::math::Vector3d const& _in, geometry_msgs::Vector3& _out);
@@ -33,6 +42,138 @@ bool GetFromSDFOrRosParam(sdf::ElementPtr _sdf, std::string const& tag, double&
  *
  */
 bool GetFromSDFOrRosParam(sdf::ElementPtr _sdf, std::string const& tag, ignition::math::Vector3d& val);
+
+/**
+ * Decides which world updates to act on, so a plugin connected to every physics step
+ * can run at most at a given rate of sim time
+ */
+class UpdateThrottle
+{
+public:
+  /// @param rate: updates per second of sim time, or 0 to act on every one
+  explicit UpdateThrottle(double rate = 0.);
+
+  void SetRate(double rate);
+
+  /**
+   * @return true if the period has passed since the last update acted on, or sim time
+   *         went backwards because the world was reset
+   */
+  bool Due(gazebo::common::Time const& time);
+
+private:
+  double period_;
+  gazebo::common::Time last_;
+  bool started_ = false;
+};
+
+/**
+ * Publishes messages filled in world update callbacks from a thread of its own, so the
+ * physics thread only computes. Each message is filled in place in one of three
+ * preallocated ones, which the two threads trade by swapping an index, so neither waits
+ * on the other. A message not yet published when the next is handed over is replaced.
+ *
+ * On the physics thread:
+ *   if (!pub_.Due(info.simTime)) return;
+ *   M& msg = pub_.Message();
+ *   ...fill msg...
+ *   pub_.Publish();
+ */
+template <typename M>
+class ThrottledPublisher
+{
+public:
+  ThrottledPublisher() = default;
+  ~ThrottledPublisher()
+  {
+    Shutdown();
+  }
+  ThrottledPublisher(ThrottledPublisher const&) = delete;
+  ThrottledPublisher& operator=(ThrottledPublisher const&) = delete;
+
+  /**
+   * Advertises topic and starts the publishing thread
+   *
+   * @param rate: messages per second of sim time, or 0 to publish on every update
+   */
+  void Advertise(ros::NodeHandle& nh, std::string const& topic, uint32_t queue_size, double rate)
+  {
+    Shutdown();
+    throttle_.SetRate(rate);
+    pub_ = nh.advertise<M>(topic, queue_size);
+    stop_ = false;
+    thread_ = std::thread(&ThrottledPublisher::Run, this);
+  }
+
+  /// Whether a message should be published at sim time, see UpdateThrottle::Due
+  bool Due(gazebo::common::Time const& time)
+  {
+    return throttle_.Due(time);
+  }
+
+  /// The message to fill next. It still holds what it was filled with three messages ago.
+  M& Message()
+  {
+    return slots_[write_];
+  }
+
+  /// Hands Message() to the publishing thread and moves on to another
+  void Publish()
+  {
+    write_ = ready_.exchange(write_ | FRESH) & ~FRESH;
+    cv_.notify_one();
+  }
+
+  /// Stops the publishing thread, dropping a message it has not published
+  void Shutdown()
+  {
+    if (!thread_.joinable())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+    pub_.shutdown();
+  }
+
+private:
+  static const unsigned FRESH = 4;
+
+  void Run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_)
+    {
+      if (ready_.load() & FRESH)
+      {
+        read_ = ready_.exchange(read_) & ~FRESH;
+        lock.unlock();
+        pub_.publish(slots_[read_]);
+        lock.lock();
+        continue;
+      }
+      // Publish() notifies without the lock, so a wakeup can be missed, which the timeout
+      // bounds to a late message rather than a lost one
+      cv_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+  }
+
+  UpdateThrottle throttle_;
+  ros::Publisher pub_;
+  std::array<M, 3> slots_;
+  unsigned write_ = 0;  // filled by the physics thread
+  unsigned read_ = 1;   // being published
+  std::atomic<unsigned> ready_{ 2 };  // last handed over, with FRESH if not yet published
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+template <typename M>
+const unsigned ThrottledPublisher<M>::FRESH;
 }
 
 #endif  // MIL_GAZEBO_UTILS_H
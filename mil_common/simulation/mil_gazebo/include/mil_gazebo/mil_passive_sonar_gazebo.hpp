@@ -1,29 +1,73 @@
 #include <geometry_msgs/Vector3Stamped.h>
+#include <mil_passive_sonar/HydrophoneSamplesStamped.h>
+#include <mil_passive_sonar/ProcessedPing.h>
 #include <ros/ros.h>
 #include "gazebo/common/common.hh"
 #include "gazebo/gazebo.hh"
 #include "gazebo/physics/physics.hh"
+#include "mil_gazebo/hydrophone_synthesizer.hpp"
+#include "mil_gazebo/mil_gazebo_utils.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace mil_gazebo
 {
-/// Gazebo plugin to publish a heading from one object to another
+/**
+ * Gazebo plugin to publish a heading from one object to another
+ *
+ * With a <samples> element, it also synthesizes the raw samples the sylphase board would
+ * record of the pinger, as HydrophoneSamplesStamped like sylphase_sonar_ros_bridge's, so the
+ * whole passive sonar pipeline can run in sim. A block is synthesized from the geometry at
+ * the end of its span of sim time, on a thread of the plugin's own:
+ *   <samples>
+ *     <topic>/hydrophones/samples</topic>
+ *     <sample_rate>1200000</sample_rate>
+ *     <seconds_per_message>0.1</seconds_per_message>
+ *     <ping_duration>0.004</ping_duration>       seconds of each ping
+ *     <source_level>10000</source_level>        counts a meter from the pinger, falling off as 1/range
+ *     <noise>20</noise>                         standard deviation, in counts
+ *     <speed_of_sound>1482</speed_of_sound>
+ *     <dist_h>0.02286</dist_h>                  hydrophones arranged as the ping_locator assumes,
+ *     <dist_h4>0.02286</dist_h4>                unless <hydrophone_positions> gives x y z of each
+ *     <surface_z>0</surface_z>                  world z of the surface the ping reflects off
+ *     <surface_reflection>-0.9</surface_reflection>  0 for no reflection
+ *     <bottom_z>-5</bottom_z>                   only reflects off the bottom if set
+ *     <bottom_reflection>0.5</bottom_reflection>
+ *     <seed>0</seed>
+ *   </samples>
+ */
 class MilPassiveSonarGazebo : public gazebo::ModelPlugin
 {
 public:
+  ~MilPassiveSonarGazebo();
   /// Load plugin
   void Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf);
-  ///
-  void TimerCb(const ros::TimerEvent&);
+  /// Publish the heading when due, timed and stamped in sim time so it does not depend on the real time factor
+  void OnUpdate(const gazebo::common::UpdateInfo& info);
   /// Convert a gazebo math vector to a geometry msg
   static void GazeboVectorToRosMsg(ignition::math::Vector3d const& in, geometry_msgs::Vector3& out);
 
 private:
+  /// Reads the <samples> element and starts synthesizing
+  void LoadSynthesis(sdf::ElementPtr _sdf);
+  /// Queues the blocks whose span of sim time has passed
+  void QueueBlocks(gazebo::common::Time const& time);
+  /// Synthesizes and publishes queued blocks until stopped
+  void SynthesisThread();
+
   /// Node handle used for ros interactions
   ros::NodeHandle nh_;
   /// Publish to publish vector
-  ros::Publisher vector_pub_;
+  ThrottledPublisher<geometry_msgs::Vector3Stamped> vector_pub_;
   /// Publish processed ping
-  ros::Publisher processed_ping_pub_;
+  ThrottledPublisher<mil_passive_sonar::ProcessedPing> processed_ping_pub_;
+  /// Seconds of sim time between pings
+  UpdateThrottle throttle_;
   /// Frame of point to publish from
   std::string frame_;
   /// Offset from model to where origin is
@@ -32,12 +76,39 @@ private:
   gazebo::physics::ModelPtr origin_;
   /// Pointer to model to get heading to
   gazebo::physics::ModelPtr model_;
-  /// Timer to update ogrid, markers
-  ros::Timer timer_;
+  gazebo::event::ConnectionPtr update_connection_;
   // Frequency
   double freq_ = 37000;
   // Amplitude
   // This default value is entirely guessed at
   double amplitude_ = 1000;
+
+  /// A block of samples to synthesize, with the paths the ping took to each hydrophone
+  struct SynthesisJob
+  {
+    uint64_t block;
+    std::vector<HydrophoneSynthesizer::Arrival> arrivals;
+  };
+  std::unique_ptr<HydrophoneSynthesizer> synthesizer_;
+  ros::Publisher samples_pub_;
+  /// Hydrophone positions in the sensor frame
+  std::vector<ignition::math::Vector3d> hydrophones_;
+  double speed_of_sound_ = 1482;
+  double source_level_ = 10000;
+  double surface_z_ = 0;
+  double surface_reflection_ = -0.9;
+  bool has_bottom_ = false;
+  double bottom_z_ = 0;
+  double bottom_reflection_ = 0.5;
+  /// Next block to queue, accessed only by the physics thread
+  uint64_t next_block_ = 0;
+  bool started_ = false;
+  std::deque<SynthesisJob> jobs_;
+  std::mutex jobs_mutex_;
+  std::condition_variable jobs_cv_;
+  bool stop_ = false;
+  std::thread synthesis_thread_;
+  /// Published by the synthesis thread, so its data is allocated once
+  mil_passive_sonar::HydrophoneSamplesStamped samples_msg_;
 };
 }
@@ -2,6 +2,8 @@
 #include <geometry_msgs/Vector3.h>
 #include <ros/ros.h>
 #include <map>
+#include <mutex>
+#include <vector>
 #include <point_cloud_object_detection_and_recognition/object.hpp>
 #include <point_cloud_object_detection_and_recognition/pcodar_controller.hpp>
 #include "gazebo/common/common.hh"
@@ -10,7 +12,18 @@
 
 namespace mil_gazebo
 {
-/// Gazebo plugin to pretend to be the PCODAR object database, delivering
+/**
+ * Gazebo plugin to pretend to be the PCODAR object database, delivering the models and links named in the
+ * /gazebo/name_map param as objects of the classification they map to.
+ *
+ * By default the world is walked once when loaded and the result published every 5 seconds. With
+ *   <indexed>true</indexed>
+ *   <update_rate>10</update_rate>     Hz the tracked entities are checked at
+ *   <tolerance>0.01</tolerance>       m / rad an entity must move or turn for its object to be updated
+ * the matching entities are resolved once and kept in an index, which models added to or deleted from the world
+ * are added to or removed from as they are. Only entities which moved are updated in the database, so moving
+ * obstacles can be tracked without walking the world.
+ */
 class PCODARGazebo : public gazebo::WorldPlugin
 {
 public:
@@ -31,7 +44,39 @@ public:
   /// Called regularly to publish latest PCDOAR info
   void TimerCb(const ros::TimerEvent&);
 
+  /// Add matching entities of a model, its submodels, and its links to the index
+  void IndexModel(gazebo::physics::ModelPtr _model, std::string const& _root);
+  /// In indexed mode, apply added / deleted models and update the objects of entities which moved
+  void IndexedTimerCb(const ros::TimerEvent&);
+  /// Called by gazebo when a model is added to or deleted from the world
+  void OnAddEntity(std::string const& _name);
+  void OnDeleteEntity(std::string const& _name);
+
 private:
+  /// An entity of the index and the object it appears as
+  struct Tracked
+  {
+    gazebo::physics::EntityPtr entity;
+    /// Name of the top level model the entity is part of, so it can be removed with it
+    std::string root;
+    pcodar::Object object;
+    /// Pose and bounding box size last put in the database
+    ignition::math::Pose3d pose;
+    ignition::math::Vector3d size;
+    bool published;
+  };
+  std::vector<Tracked> tracked_;
+  /// Models added / deleted since the last update, from gazebo's thread
+  std::vector<std::string> added_;
+  std::vector<std::string> deleted_;
+  std::mutex pending_mutex_;
+  gazebo::event::ConnectionPtr add_connection_;
+  gazebo::event::ConnectionPtr delete_connection_;
+  double tolerance_ = 0.01;
+  /// Objects are republished this often even if none moved, for late subscribers
+  ros::Duration republish_period_ = ros::Duration(5.0);
+  ros::Time last_publish_;
+
   /// Node handle used for ros interactions
   ros::NodeHandle nh_;
   // PCODAR controller
@@ -0,0 +1,93 @@
+#include <mil_gazebo/hydrophone_synthesizer.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mil_gazebo
+{
+HydrophoneSynthesizer::HydrophoneSynthesizer(Config const& config) : config_(config), rng_(config.seed)
+{
+  const double w = 2 * M_PI * config_.frequency / config_.sample_rate;
+  const size_t length = std::max<size_t>(std::ceil(config_.ping_duration * config_.sample_rate), 1);
+  // Tapered by a tenth of the burst at each end, as the transducer rings up and down
+  const size_t ramp = std::max<size_t>(length / 10, 1);
+  sin_.resize(length);
+  cos_.resize(length);
+  envelope_.resize(length);
+  for (size_t m = 0; m < length; ++m)
+  {
+    sin_[m] = std::sin(w * m);
+    cos_[m] = std::cos(w * m);
+    size_t edge = std::min(m, length - 1 - m);
+    envelope_[m] = edge < ramp ? 0.5 * (1 - std::cos(M_PI * edge / ramp)) : 1.;
+  }
+
+  // Long enough that blocks start at many different offsets into it
+  if (config_.noise > 0)
+  {
+    noise_.resize(std::max<size_t>(4 * config_.frames_per_block, 1 << 18));
+    std::normal_distribution<float> normal(0., config_.noise);
+    for (float& sample : noise_)
+      sample = normal(rng_);
+  }
+  channel_.resize(config_.frames_per_block);
+}
+
+void HydrophoneSynthesizer::Synthesize(uint64_t block, std::vector<Arrival> const& arrivals, int16_t* out)
+{
+  const size_t channels = config_.channels;
+  const size_t frames = config_.frames_per_block;
+  const size_t paths = arrivals.size() / channels;
+  const double start = BlockStart(block);
+  const float max = std::numeric_limits<int16_t>::max();
+  std::uniform_int_distribution<size_t> offset(0, noise_.size() > frames ? noise_.size() - frames : 0);
+
+  for (size_t c = 0; c < channels; ++c)
+  {
+    if (noise_.empty())
+      std::fill(channel_.begin(), channel_.end(), 0.f);
+    else
+      std::copy_n(noise_.begin() + offset(rng_), frames, channel_.begin());
+
+    for (size_t p = 0; p < paths; ++p)
+      AddArrival(start, arrivals[c * paths + p]);
+
+    for (size_t n = 0; n < frames; ++n)
+      out[n * channels + c] = std::lrint(std::max(-max, std::min(max, channel_[n])));
+  }
+}
+
+void HydrophoneSynthesizer::AddArrival(double start, Arrival const& arrival)
+{
+  const double rate = config_.sample_rate;
+  const double period = config_.ping_period;
+  const int64_t frames = config_.frames_per_block;
+  const int64_t length = envelope_.size();
+  const double end = start + frames / rate;
+  const double w = 2 * M_PI * config_.frequency;
+
+  // Bursts which are heard at some point of the block
+  int64_t first = std::max(0., std::ceil((start - arrival.delay - length / rate) / period));
+  int64_t last = std::floor((end - arrival.delay) / period);
+  for (int64_t k = first; k <= last; ++k)
+  {
+    // First sample at or after the burst arrives, and the seconds between the two
+    double at = (k * period + arrival.delay - start) * rate;
+    int64_t n0 = std::ceil(at);
+    double shift = w * (n0 - at) / rate;
+    // sin(w m + shift) = sin(w m) cos(shift) + cos(w m) sin(shift)
+    const float a = arrival.gain * std::cos(shift);
+    const float b = arrival.gain * std::sin(shift);
+
+    int64_t begin = std::max<int64_t>(0, -n0);
+    int64_t stop = std::min(length, frames - n0);
+    float* out = channel_.data();
+    const float* s = sin_.data();
+    const float* co = cos_.data();
+    const float* e = envelope_.data();
+    for (int64_t m = begin; m < stop; ++m)
+      out[n0 + m] += e[m] * (a * s[m] + b * co[m]);
+  }
+}
+}
@@ -0,0 +1,149 @@
+#include <mil_gazebo/mil_blueview_gazebo.hpp>
+#include <mil_gazebo/mil_gazebo_utils.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mil_gazebo
+{
+GZ_REGISTER_SENSOR_PLUGIN(MilBlueViewGazebo)
+
+MilBlueViewGazebo::MilBlueViewGazebo() : SensorPlugin()
+{
+}
+
+MilBlueViewGazebo::~MilBlueViewGazebo()
+{
+}
+
+void MilBlueViewGazebo::Load(gazebo::sensors::SensorPtr _parent, sdf::ElementPtr _sdf)
+{
+  gpu_sensor_ = std::dynamic_pointer_cast<gazebo::sensors::GpuRaySensor>(_parent);
+  sensor_ = std::dynamic_pointer_cast<gazebo::sensors::RaySensor>(_parent);
+  if (!gpu_sensor_ && !sensor_)
+  {
+    ROS_ERROR_NAMED("MilBlueViewGazebo", "Parent sensor is not a gpu_ray or ray sensor");
+    return;
+  }
+
+  if (_sdf->HasElement("frame_id"))
+    frame_name_ = _sdf->GetElement("frame_id")->Get<std::string>();
+  else
+    frame_name_ = _parent->ParentName();
+
+  auto get = [&_sdf](std::string const& tag, double& value) {
+    if (_sdf->HasElement(tag))
+      value = _sdf->GetElement(tag)->Get<double>();
+  };
+  get("intensity", intensity_);
+  get("absorption", absorption_);
+  get("speckle", speckle_);
+  get("range_noise", range_noise_);
+  get("background", background_);
+  if (_sdf->HasElement("seed"))
+    rng_.seed(_sdf->GetElement("seed")->Get<unsigned int>());
+
+  std::string ns = "blueview_driver";
+  if (_sdf->HasElement("namespace"))
+    ns = _sdf->GetElement("namespace")->Get<std::string>();
+  nh_ = ros::NodeHandle(ns);
+
+  ping_.header.frame_id = frame_name_;
+  ping_pub_ = nh_.advertise<mil_blueview_driver::BlueViewPing>("ranges", 5);
+  if (_sdf->HasElement("compact") && _sdf->GetElement("compact")->Get<bool>())
+  {
+    double range_scale = 0.002;
+    get("range_scale", range_scale);
+    encoder_.reset(new BlueViewRangeProfileEncoder(range_scale));
+    head_pub_ = nh_.advertise<mil_blueview_driver::BlueViewHead>("head", 1, true);
+    range_profile_pub_ = nh_.advertise<mil_blueview_driver::BlueViewRangeProfile>("range_profile", 5);
+  }
+
+  update_connection_ = _parent->ConnectUpdated(boost::bind(&MilBlueViewGazebo::OnUpdate, this));
+  _parent->SetActive(true);
+}
+
+template <typename Sensor>
+void MilBlueViewGazebo::ReadSensor(Sensor& sensor)
+{
+  beams_ = sensor.RangeCount();
+  vertical_ = std::max(1, sensor.VerticalRangeCount());
+  angle_min_ = sensor.AngleMin().Radian();
+  angle_max_ = sensor.AngleMax().Radian();
+  range_min_ = sensor.RangeMin();
+  range_max_ = sensor.RangeMax();
+  sensor.Ranges(ranges_);
+  stamp_ = sensor.LastMeasurementTime();
+}
+
+void MilBlueViewGazebo::OnUpdate()
+{
+  bool compact = encoder_ && range_profile_pub_.getNumSubscribers() > 0;
+  if (!compact && !ping_pub_.getNumSubscribers())
+    return;
+
+  if (gpu_sensor_)
+    ReadSensor(*gpu_sensor_);
+  else
+    ReadSensor(*sensor_);
+  if (beams_ <= 0 || ranges_.size() < static_cast<size_t>(beams_ * vertical_))
+    return;
+
+  MakePing();
+  if (ping_pub_.getNumSubscribers())
+    ping_pub_.publish(ping_);
+  if (compact)
+  {
+    if (encoder_->encode(ping_.header, ping_.bearings, ping_.ranges, ping_.intensities, range_profile_))
+      head_pub_.publish(encoder_->head());
+    range_profile_pub_.publish(range_profile_);
+  }
+}
+
+void MilBlueViewGazebo::MakePing()
+{
+  Convert(stamp_, ping_.header.stamp);
+  ping_.bearings.resize(beams_);
+  ping_.ranges.resize(beams_);
+  ping_.intensities.resize(beams_);
+
+  // The bearings only change if the sensor does, but are cheap next to the noise
+  double step = beams_ > 1 ? (angle_max_ - angle_min_) / (beams_ - 1) : 0.;
+  for (int i = 0; i < beams_; ++i)
+    ping_.bearings[i] = angle_min_ + i * step;
+
+  // Nearest return across the vertical beam width
+  const double infinity = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < beams_; ++i)
+  {
+    double nearest = infinity;
+    for (int j = 0; j < vertical_; ++j)
+    {
+      double range = ranges_[j * beams_ + i];
+      if (std::isfinite(range) && range >= range_min_ && range < range_max_)
+        nearest = std::min(nearest, range);
+    }
+    ping_.ranges[i] = nearest;
+  }
+
+  std::normal_distribution<double> normal(0., 1.);
+  std::exponential_distribution<double> floor(1.);
+  const double full_scale = std::numeric_limits<uint16_t>::max();
+  for (int i = 0; i < beams_; ++i)
+  {
+    double range = ping_.ranges[i];
+    double intensity;
+    if (std::isfinite(range))
+    {
+      intensity = intensity_ * std::exp(-2. * absorption_ * range) * std::max(0., 1. + speckle_ * normal(rng_));
+      range = std::max(0., range + range_noise_ * normal(rng_));
+      ping_.ranges[i] = range;
+    }
+    else
+      intensity = background_ * floor(rng_);
+    ping_.intensities[i] = static_cast<uint16_t>(std::min(1., intensity) * full_scale);
+  }
+}
+
+}  // namespace mil_gazebo
@@ -35,12 +35,13 @@ void MilDepthGazebo::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sd
     offset_ = _sdf->GetElement("offset")->Get<ignition::math::Pose3d>();
   }
 
+  double update_rate = 10.;
   if (_sdf->HasElement("update_rate"))
   {
-    update_period_ = 1.0 / _sdf->GetElement("update_rate")->Get<double>();
+    update_rate = _sdf->GetElement("update_rate")->Get<double>();
   }
 
-  depth_pub_ = nh_.advertise<mil_msgs::DepthStamped>("/depth", 20);
+  depth_pub_.Advertise(nh_, "/depth", 20, update_rate);
 
   update_connection_ =
       gazebo::event::Events::ConnectWorldUpdateBegin(std::bind(&MilDepthGazebo::OnUpdate, this, std::placeholders::_1));
@@ -48,30 +49,18 @@ void MilDepthGazebo::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sd
 
 void MilDepthGazebo::OnUpdate(const gazebo::common::UpdateInfo& info)
 {
-  auto time = info.simTime;
-  if (info.simTime < last_pub_time_)
-  {
-    last_pub_time_ = info.simTime;
+  if (!depth_pub_.Due(info.simTime))
     return;
-  }
-
-  if ((time - last_pub_time_) < update_period_)
-  {
-    return;
-  }
-
-  last_pub_time_ = time;
 
-  // TODO: limit publish frequency
   auto pose = model_->WorldPose() + offset_;
   double depth = -pose.Pos().Z();
   if (depth < 0.)
     depth = 0.;
 
-  mil_msgs::DepthStamped msg;
+  mil_msgs::DepthStamped& msg = depth_pub_.Message();
   msg.header.frame_id = frame_name_;
-  Convert(time, msg.header.stamp);
+  Convert(info.simTime, msg.header.stamp);
   msg.depth = depth;
-  depth_pub_.publish(msg);
+  depth_pub_.Publish();
 }
 }
@@ -43,6 +43,15 @@ void MilDragGazebo::Load(gazebo::physics::ModelPtr _parent, sdf::ElementPtr _sdf
     return;
   }
 
+  if (_sdf->HasElement("debug_topic"))
+  {
+    double debug_rate = 10.;
+    if (_sdf->HasElement("debug_rate"))
+      debug_rate = _sdf->GetElement("debug_rate")->Get<double>();
+    debug_pub_.Advertise(nh_, _sdf->GetElement("debug_topic")->Get<std::string>(), 10, debug_rate);
+    debug_ = true;
+  }
+
   update_connection_ =
       gazebo::event::Events::ConnectWorldUpdateBegin(std::bind(&MilDragGazebo::OnUpdate, this, std::placeholders::_1));
 }
@@ -55,14 +64,17 @@ void MilDragGazebo::OnUpdate(const gazebo::common::UpdateInfo& info)
   ignition::math::Vector3d force = -linear_coeffs_ * linear_vel;
   ignition::math::Vector3d torque = -angular_coeffs_ * angular_vel;
 
-  /*
-    gzerr << "Vel " << linear_vel
-          << "Ang " << angular_vel
-          << "Force " << force
-          << "Torque " << torque;
-  */
-
   link_->AddRelativeForce(force);
   link_->AddRelativeTorque(torque);
+
+  if (debug_ && debug_pub_.Due(info.simTime))
+  {
+    geometry_msgs::WrenchStamped& msg = debug_pub_.Message();
+    msg.header.frame_id = link_->GetName();
+    Convert(info.simTime, msg.header.stamp);
+    Convert(force, msg.wrench.force);
+    Convert(torque, msg.wrench.torque);
+    debug_pub_.Publish();
+  }
 }
 }
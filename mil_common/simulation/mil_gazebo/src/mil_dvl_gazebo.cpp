@@ -1,6 +1,8 @@
 #include <mil_gazebo/mil_dvl_gazebo.hpp>
 #include <mil_gazebo/mil_gazebo_utils.hpp>
 
+#include <cmath>
+
 namespace mil_gazebo
 {
 // Register this plugin
@@ -48,29 +50,110 @@ void MilDVLGazebo::Load(gazebo::sensors::SensorPtr _parent, sdf::ElementPtr _sdf
   else
     frame_name_ = sensor_->ParentName();
 
+  // Janus configuration, each beam 30 degrees from down, as the real DVL reports them
+  double tilt = 30 * ignition::math::Angle::Pi.Radian() / 180;
+  double x = sin(tilt);
+  double z = cos(tilt);
+  beams_ = { ignition::math::Vector3d(-x, 0., -z), ignition::math::Vector3d(x, 0., -z),
+             ignition::math::Vector3d(0., x, -z), ignition::math::Vector3d(0., -x, -z) };
+  FindBeamRays();
+
+  vel_msg_.header.frame_id = frame_name_;
+  vel_msg_.velocity_measurements.resize(beams_.size());
+  for (size_t i = 0; i < beams_.size(); ++i)
+  {
+    Convert(beams_[i], vel_msg_.velocity_measurements[i].direction);
+    vel_msg_.velocity_measurements[i].correlation = ignition::math::NAN_D;
+  }
+  range_msg_.header.frame_id = frame_name_;
+
   vel_pub_ = nh_.advertise<mil_msgs::VelocityMeasurements>("/dvl", 20);
   range_pub_ = nh_.advertise<mil_msgs::RangeStamped>("/dvl/range", 20);
 
   update_connection_ = sensor_->ConnectUpdated(boost::bind(&MilDVLGazebo::OnUpdate, this));
 }
 
+void MilDVLGazebo::FindBeamRays()
+{
+  beam_rays_.fill(-1);
+  int horizontal = sensor_->RayCount();
+  int vertical = std::max(1, sensor_->VerticalRayCount());
+  if (horizontal * vertical < static_cast<int>(beams_.size()))
+    return;
+
+  double yaw_min = sensor_->AngleMin().Radian();
+  double yaw_step = horizontal > 1 ? (sensor_->AngleMax().Radian() - yaw_min) / (horizontal - 1) : 0.;
+  double pitch_min = sensor_->VerticalAngleMin().Radian();
+  double pitch_step = vertical > 1 ? (sensor_->VerticalAngleMax().Radian() - pitch_min) / (vertical - 1) : 0.;
+  std::array<double, 4> best;
+  best.fill(cos(ignition::math::Angle::Pi.Radian() / 90));  // within 2 degrees
+  for (int j = 0; j < vertical; ++j)
+    for (int i = 0; i < horizontal; ++i)
+    {
+      // Rays are along the sensor's x, which Load pointed down the DVL's -z
+      double yaw = horizontal > 1 ? yaw_min + i * yaw_step : 0.;
+      double pitch = vertical > 1 ? pitch_min + j * pitch_step : 0.;
+      ignition::math::Vector3d ray(sin(pitch), cos(pitch) * sin(yaw), -cos(pitch) * cos(yaw));
+      for (size_t b = 0; b < beams_.size(); ++b)
+      {
+        double alignment = ray.Dot(beams_[b]);
+        if (alignment > best[b])
+        {
+          best[b] = alignment;
+          beam_rays_[b] = j * horizontal + i;
+        }
+      }
+    }
+
+  for (int ray : beam_rays_)
+    if (ray < 0)
+    {
+      ROS_WARN_NAMED("MILDVLGazebo", "Sensor has no ray along each beam, using the first ray's range for all of them");
+      beam_rays_.fill(-1);
+      return;
+    }
+}
+
 void MilDVLGazebo::OnUpdate()
 {
-  if (range_pub_.getNumSubscribers())
+  bool publish_range = range_pub_.getNumSubscribers() > 0;
+  bool publish_vel = vel_pub_.getNumSubscribers() > 0;
+  if (!publish_range && !publish_vel)
+    return;
+
+  // Height of each beam's return below the DVL, or NaN if the beam lost bottom lock
+  const double max_range = sensor_->RangeMax();
+  std::array<double, 4> heights;
+  for (size_t i = 0; i < beams_.size(); ++i)
+  {
+    int ray = beam_rays_[i] < 0 ? 0 : beam_rays_[i];
+    double cos_tilt = beam_rays_[i] < 0 ? 1. : -beams_[i].Z();
+    double range = sensor_->Range(ray);
+    heights[i] = std::isfinite(range) && range < max_range ? range * cos_tilt - offset_.Z() : ignition::math::NAN_D;
+  }
+
+  if (publish_range)
   {
-    double range = sensor_->Range(0) - offset_.Z();
-    mil_msgs::RangeStamped range_msg;
-    range_msg.header.frame_id = frame_name_;
-    Convert(sensor_->LastMeasurementTime(), range_msg.header.stamp);
-    range_msg.range = range;
-    range_pub_.publish(range_msg);
+    double sum = 0;
+    int locked = 0;
+    for (double height : heights)
+      if (!std::isnan(height))
+      {
+        sum += height;
+        ++locked;
+      }
+    // Like the real DVL, no range without a return
+    if (locked)
+    {
+      Convert(sensor_->LastMeasurementTime(), range_msg_.header.stamp);
+      range_msg_.range = sum / locked;
+      range_pub_.publish(range_msg_);
+    }
   }
 
-  if (vel_pub_.getNumSubscribers())
+  if (publish_vel)
   {
-    mil_msgs::VelocityMeasurements vel_msg;
-    vel_msg.header.frame_id = frame_name_;
-    Convert(sensor_->LastMeasurementTime(), vel_msg.header.stamp);
+    Convert(sensor_->LastMeasurementTime(), vel_msg_.header.stamp);
 
     auto vel_world = parent_->WorldLinearVel(pose_.Pos());
     auto world_from_parent = parent_->WorldPose().Rot();
@@ -78,25 +161,11 @@ void MilDVLGazebo::OnUpdate()
     auto parent_from_local = pose_.Rot();
     auto vel_local = parent_from_local.Inverse().RotateVector(vel_parent);
 
-    double tilt = 30 * ignition::math::Angle::Pi.Radian() / 180;
-    double x = sin(tilt);
-    double z = cos(tilt);
-
-    std::array<ignition::math::Vector3d, 4> directions = {
-      ignition::math::Vector3d(-x, 0., -z), ignition::math::Vector3d(x, 0., -z), ignition::math::Vector3d(0., x, -z),
-      ignition::math::Vector3d(0., -x, -z),
-    };
-
-    for (auto dir : directions)
-    {
-      mil_msgs::VelocityMeasurement measurement;
-      Convert(dir, measurement.direction);
-      measurement.velocity = vel_local.Dot(dir);
-      measurement.correlation = ignition::math::NAN_D;
-      vel_msg.velocity_measurements.push_back(measurement);
-    }
+    for (size_t i = 0; i < beams_.size(); ++i)
+      vel_msg_.velocity_measurements[i].velocity =
+          std::isnan(heights[i]) ? ignition::math::NAN_D : vel_local.Dot(beams_[i]);
 
-    vel_pub_.publish(vel_msg);
+    vel_pub_.publish(vel_msg_);
   }
 }
 }
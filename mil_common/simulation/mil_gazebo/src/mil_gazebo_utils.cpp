@@ -80,4 +80,23 @@ bool GetFromSDFOrRosParam(sdf::ElementPtr _sdf, std::string const& tag, ignition
   else
     return false;
 }
+
+UpdateThrottle::UpdateThrottle(double rate)
+{
+  SetRate(rate);
+}
+
+void UpdateThrottle::SetRate(double rate)
+{
+  period_ = rate > 0. ? 1. / rate : 0.;
+}
+
+bool UpdateThrottle::Due(gazebo::common::Time const& time)
+{
+  if (started_ && time >= last_ && (time - last_).Double() < period_)
+    return false;
+  started_ = true;
+  last_ = time;
+  return true;
+}
 }
@@ -1,9 +1,30 @@
 #include <mil_msgs/PerceptionObject.h>
-#include <mil_passive_sonar/ProcessedPing.h>
 #include <mil_gazebo/mil_passive_sonar_gazebo.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
 namespace mil_gazebo
 {
+namespace
+{
+/// Blocks queued beyond this are dropped, so a synthesis thread that can not keep up does not grow the queue forever
+const size_t MAX_QUEUED_BLOCKS = 50;
+}
+
+MilPassiveSonarGazebo::~MilPassiveSonarGazebo()
+{
+  if (!synthesis_thread_.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    stop_ = true;
+  }
+  jobs_cv_.notify_one();
+  synthesis_thread_.join();
+}
+
 void MilPassiveSonarGazebo::Load(gazebo::physics::ModelPtr _model, sdf::ElementPtr _sdf)
 {
   origin_ = _model;
@@ -36,19 +57,177 @@ void MilPassiveSonarGazebo::Load(gazebo::physics::ModelPtr _model, sdf::ElementP
     return;
   }
 
+  // Despite the name, seconds between pings
   double rate = 1.0;
   if (_sdf->HasElement("rate"))
     rate = _sdf->GetElement("rate")->Get<double>();
+  throttle_.SetRate(1.0 / rate);
 
   nh_ = ros::NodeHandle("mil_model_heading");
-  vector_pub_ = nh_.advertise<geometry_msgs::Vector3Stamped>("/hydrophones/direction", 1);
-  processed_ping_pub_ = nh_.advertise<mil_passive_sonar::ProcessedPing>("/hydrophones/processed", 1);
-  timer_ =
-      nh_.createTimer(ros::Duration(rate), std::bind(&MilPassiveSonarGazebo::TimerCb, this, std::placeholders::_1));
+  vector_pub_.Advertise(nh_, "/hydrophones/direction", 1, 0.);
+  processed_ping_pub_.Advertise(nh_, "/hydrophones/processed", 1, 0.);
+  if (_sdf->HasElement("samples"))
+    LoadSynthesis(_sdf);
+  update_connection_ = gazebo::event::Events::ConnectWorldUpdateBegin(
+      std::bind(&MilPassiveSonarGazebo::OnUpdate, this, std::placeholders::_1));
+}
+
+void MilPassiveSonarGazebo::LoadSynthesis(sdf::ElementPtr _sdf)
+{
+  sdf::ElementPtr samples = _sdf->GetElement("samples");
+  auto get = [&samples](std::string const& tag, double& value) {
+    if (samples->HasElement(tag))
+      value = samples->GetElement(tag)->Get<double>();
+  };
+
+  HydrophoneSynthesizer::Config config;
+  config.frequency = freq_;
+  config.ping_period = 1.0;
+  if (_sdf->HasElement("rate"))
+    config.ping_period = _sdf->GetElement("rate")->Get<double>();
+  get("sample_rate", config.sample_rate);
+  double seconds_per_message = 0.1;
+  get("seconds_per_message", seconds_per_message);
+  config.frames_per_block = std::max<size_t>(std::round(seconds_per_message * config.sample_rate), 1);
+  get("ping_duration", config.ping_duration);
+  config.noise = 20;
+  get("noise", config.noise);
+  if (samples->HasElement("seed"))
+    config.seed = samples->GetElement("seed")->Get<unsigned int>();
+
+  get("source_level", source_level_);
+  get("speed_of_sound", speed_of_sound_);
+  get("surface_z", surface_z_);
+  get("surface_reflection", surface_reflection_);
+  has_bottom_ = samples->HasElement("bottom_z");
+  get("bottom_z", bottom_z_);
+  get("bottom_reflection", bottom_reflection_);
+
+  // Same arrangement as the ping_locator node assumes, unless every position is given as x, y, z of each hydrophone
+  double dist_h = 2.286E-2;
+  get("dist_h", dist_h);
+  double dist_h4 = dist_h;
+  get("dist_h4", dist_h4);
+  hydrophones_ = { ignition::math::Vector3d(0, 0, 0), ignition::math::Vector3d(dist_h, 0, 0),
+                   ignition::math::Vector3d(-dist_h, 0, 0), ignition::math::Vector3d(0, dist_h4, 0) };
+  if (samples->HasElement("hydrophone_positions"))
+  {
+    std::istringstream stream(samples->GetElement("hydrophone_positions")->Get<std::string>());
+    std::vector<double> positions;
+    double value;
+    while (stream >> value)
+      positions.push_back(value);
+    if (positions.size() >= 3 && positions.size() % 3 == 0)
+    {
+      hydrophones_.clear();
+      for (size_t i = 0; i < positions.size(); i += 3)
+        hydrophones_.emplace_back(positions[i], positions[i + 1], positions[i + 2]);
+    }
+    else
+      ROS_ERROR_NAMED("MilPassiveSonarGazebo", "<hydrophone_positions> needs x y z of each hydrophone, ignoring it");
+  }
+  config.channels = hydrophones_.size();
+
+  synthesizer_.reset(new HydrophoneSynthesizer(config));
+  samples_msg_.header.frame_id = frame_;
+  samples_msg_.hydrophone_samples.channels = config.channels;
+  samples_msg_.hydrophone_samples.samples = config.frames_per_block;
+  samples_msg_.hydrophone_samples.sample_rate = config.sample_rate;
+  samples_msg_.hydrophone_samples.data.resize(config.channels * config.frames_per_block);
+
+  std::string topic = "/hydrophones/samples";
+  if (samples->HasElement("topic"))
+    topic = samples->GetElement("topic")->Get<std::string>();
+  samples_pub_ = nh_.advertise<mil_passive_sonar::HydrophoneSamplesStamped>(topic, 10);
+  synthesis_thread_ = std::thread(&MilPassiveSonarGazebo::SynthesisThread, this);
+}
+
+void MilPassiveSonarGazebo::QueueBlocks(gazebo::common::Time const& time)
+{
+  const double now = time.Double();
+  const double block_seconds = synthesizer_->BlockStart(1);
+  // Start at the block sim time is in, also when it went backwards because the world was reset
+  if (!started_ || now < synthesizer_->BlockStart(next_block_))
+  {
+    started_ = true;
+    next_block_ = std::floor(now / block_seconds);
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    jobs_.clear();
+  }
+  if (now < synthesizer_->BlockStart(next_block_ + 1))
+    return;
+
+  bool subscribed = samples_pub_.getNumSubscribers() > 0;
+  SynthesisJob job;
+  if (subscribed)
+  {
+    auto world_from_parent = origin_->WorldPose();
+    auto sensor_position_world = world_from_parent.Pos() + world_from_parent.Rot() * parent_from_sensor_.Pos();
+    auto sensor_from_world = parent_from_sensor_.Rot().Inverse() * world_from_parent.Rot().Inverse();
+    auto pinger = model_->WorldPose().Pos();
+
+    // The pinger, and its images in the surface and bottom for the paths reflected off them
+    std::vector<std::pair<ignition::math::Vector3d, double>> sources = { { pinger, 1. } };
+    if (surface_reflection_ != 0)
+      sources.emplace_back(ignition::math::Vector3d(pinger.X(), pinger.Y(), 2 * surface_z_ - pinger.Z()),
+                           surface_reflection_);
+    if (has_bottom_ && bottom_reflection_ != 0)
+      sources.emplace_back(ignition::math::Vector3d(pinger.X(), pinger.Y(), 2 * bottom_z_ - pinger.Z()),
+                           bottom_reflection_);
+
+    for (auto const& hydrophone : hydrophones_)
+      for (auto const& source : sources)
+      {
+        double range = (sensor_from_world * (source.first - sensor_position_world) - hydrophone).Length();
+        job.arrivals.push_back({ range / speed_of_sound_, source.second * source_level_ / std::max(range, 1.) });
+      }
+  }
+
+  // Usually one block, more if a step of sim time spans several
+  for (; now >= synthesizer_->BlockStart(next_block_ + 1); ++next_block_)
+  {
+    if (!subscribed)
+      continue;
+    job.block = next_block_;
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    if (jobs_.size() >= MAX_QUEUED_BLOCKS)
+    {
+      ROS_WARN_THROTTLE_NAMED(5, "MilPassiveSonarGazebo", "hydrophone synthesis is behind sim time, dropping samples");
+      continue;
+    }
+    jobs_.push_back(job);
+  }
+  jobs_cv_.notify_one();
 }
 
-void MilPassiveSonarGazebo::TimerCb(const ros::TimerEvent&)
+void MilPassiveSonarGazebo::SynthesisThread()
 {
+  std::unique_lock<std::mutex> lock(jobs_mutex_);
+  while (true)
+  {
+    jobs_cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+    if (stop_)
+      return;
+    SynthesisJob job = std::move(jobs_.front());
+    jobs_.pop_front();
+    lock.unlock();
+
+    synthesizer_->Synthesize(job.block, job.arrivals, samples_msg_.hydrophone_samples.data.data());
+    samples_msg_.header.stamp = ros::Time(synthesizer_->BlockStart(job.block));
+    samples_pub_.publish(samples_msg_);
+
+    lock.lock();
+  }
+}
+
+void MilPassiveSonarGazebo::OnUpdate(const gazebo::common::UpdateInfo& info)
+{
+  if (synthesizer_)
+    QueueBlocks(info.simTime);
+
+  if (!throttle_.Due(info.simTime))
+    return;
+
   // Calculate direction to model
   auto world_from_parent = origin_->WorldPose();
   auto sensor_position_world = world_from_parent.Pos() + world_from_parent.Rot() * parent_from_sensor_.Pos();
@@ -59,14 +238,13 @@ void MilPassiveSonarGazebo::TimerCb(const ros::TimerEvent&)
   heading_sensor = heading_sensor.Normalize();
 
   // Send direction msg
-  geometry_msgs::Vector3Stamped vec;
+  geometry_msgs::Vector3Stamped& vec = vector_pub_.Message();
   GazeboVectorToRosMsg(heading_sensor, vec.vector);
   vec.header.frame_id = frame_;
-  vec.header.stamp = ros::Time::now();
-  vector_pub_.publish(vec);
+  Convert(info.simTime, vec.header.stamp);
 
   // Send processed ping
-  mil_passive_sonar::ProcessedPing processed_ping_msg;
+  mil_passive_sonar::ProcessedPing& processed_ping_msg = processed_ping_pub_.Message();
   processed_ping_msg.header = vec.header;
   processed_ping_msg.position.x = vec.vector.x;
   processed_ping_msg.position.y = vec.vector.y;
@@ -75,7 +253,9 @@ void MilPassiveSonarGazebo::TimerCb(const ros::TimerEvent&)
   processed_ping_msg.freq = freq_;
   processed_ping_msg.amplitude = amplitude_;
   processed_ping_msg.valid = true;
-  processed_ping_pub_.publish(processed_ping_msg);
+
+  vector_pub_.Publish();
+  processed_ping_pub_.Publish();
 }
 
 void MilPassiveSonarGazebo::GazeboVectorToRosMsg(ignition::math::Vector3d const& in, geometry_msgs::Vector3& out)
@@ -1,6 +1,9 @@
 #include <mil_msgs/PerceptionObject.h>
 #include <mil_gazebo/pcodar_gazebo.hpp>
 
+#include <algorithm>
+#include <cmath>
+
 namespace mil_gazebo
 {
 void PCODARGazebo::Load(gazebo::physics::WorldPtr _world, sdf::ElementPtr _sdf)
@@ -14,8 +17,28 @@ void PCODARGazebo::Load(gazebo::physics::WorldPtr _world, sdf::ElementPtr _sdf)
   {
     ROS_DEBUG("MAPPING %s to %s", it.first.c_str(), it.second.c_str());
   }
-  UpdateEntities();
-  timer_ = nh_.createTimer(ros::Duration(5.0), std::bind(&PCODARGazebo::TimerCb, this, std::placeholders::_1));
+
+  if (!_sdf->HasElement("indexed") || !_sdf->GetElement("indexed")->Get<bool>())
+  {
+    UpdateEntities();
+    timer_ = nh_.createTimer(ros::Duration(5.0), std::bind(&PCODARGazebo::TimerCb, this, std::placeholders::_1));
+    return;
+  }
+
+  double update_rate = 10.;
+  if (_sdf->HasElement("update_rate"))
+    update_rate = _sdf->GetElement("update_rate")->Get<double>();
+  if (_sdf->HasElement("tolerance"))
+    tolerance_ = _sdf->GetElement("tolerance")->Get<double>();
+
+  for (auto model : world_->Models())
+    IndexModel(model, model->GetName());
+  add_connection_ =
+      gazebo::event::Events::ConnectAddEntity(std::bind(&PCODARGazebo::OnAddEntity, this, std::placeholders::_1));
+  delete_connection_ =
+      gazebo::event::Events::ConnectDeleteEntity(std::bind(&PCODARGazebo::OnDeleteEntity, this, std::placeholders::_1));
+  timer_ = nh_.createTimer(ros::Duration(1.0 / update_rate),
+                           std::bind(&PCODARGazebo::IndexedTimerCb, this, std::placeholders::_1));
 }
 
 void PCODARGazebo::TimerCb(const ros::TimerEvent&)
@@ -78,16 +101,116 @@ void PCODARGazebo::UpdateEntity(gazebo::physics::EntityPtr _entity)
   GazeboVectorToRosMsg(box.Size(), object.msg_.scale);
 
   // Add or update object
-  auto existing_object = pcodar_->objects_->objects_.find(id);
-  if (existing_object == pcodar_->objects_->objects_.end())
+  object.set_id(id);
+  pcodar_->objects_->set_object(id, object);
+}
+
+void PCODARGazebo::IndexModel(gazebo::physics::ModelPtr _model, std::string const& _root)
+{
+  std::vector<gazebo::physics::EntityPtr> entities = { _model };
+  for (auto link : _model->GetLinks())
+    entities.push_back(link);
+  for (auto entity : entities)
   {
-    object.set_id(id);
-    pcodar_->objects_->objects_.insert({ id, object });
+    auto it = name_map_.find(entity->GetName());
+    if (it == name_map_.end())
+      continue;
+    uint id = entity->GetId();
+    // A model loaded with the world can also be announced as added
+    if (std::any_of(tracked_.begin(), tracked_.end(), [id](Tracked const& t) { return t.object.msg_.id == id; }))
+      continue;
+    pcodar::Object object(boost::make_shared<pcodar::point_cloud>(), id, boost::make_shared<pcodar::KdTree>());
+    object.msg_.labeled_classification = (*it).second;
+    tracked_.push_back({ entity, _root, object, ignition::math::Pose3d(), ignition::math::Vector3d(), false });
   }
-  else
+
+  for (auto model : _model->NestedModels())
+    IndexModel(model, _root);
+}
+
+void PCODARGazebo::OnAddEntity(std::string const& _name)
+{
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  added_.push_back(_name);
+}
+
+void PCODARGazebo::OnDeleteEntity(std::string const& _name)
+{
+  std::lock_guard<std::mutex> lock(pending_mutex_);
+  added_.erase(std::remove(added_.begin(), added_.end(), _name), added_.end());
+  deleted_.push_back(_name);
+}
+
+void PCODARGazebo::IndexedTimerCb(const ros::TimerEvent&)
+{
+  std::vector<std::string> added, deleted;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    deleted.swap(deleted_);
+    // Models are announced before they are loaded, so ones not yet in the world are tried again next time
+    for (auto it = added_.begin(); it != added_.end();)
+    {
+      gazebo::physics::ModelPtr model = world_->ModelByName(*it);
+      if (!model)
+      {
+        ++it;
+        continue;
+      }
+      IndexModel(model, *it);
+      it = added_.erase(it);
+    }
+  }
+
+  bool changed = false;
+  {
+    std::lock_guard<std::mutex> lock(pcodar_->objects_->mutex_);
+    for (std::string const& name : deleted)
+    {
+      for (auto it = tracked_.begin(); it != tracked_.end();)
+      {
+        if ((*it).root != name)
+        {
+          ++it;
+          continue;
+        }
+        auto object = pcodar_->objects_->objects_.find((*it).object.msg_.id);
+        if (object != pcodar_->objects_->objects_.end())
+          pcodar_->objects_->erase_object(object);
+        it = tracked_.erase(it);
+        changed = true;
+      }
+    }
+
+    for (Tracked& tracked : tracked_)
+    {
+      ignition::math::Pose3d pose = tracked.entity->WorldPose();
+      ignition::math::Box box = tracked.entity->BoundingBox();
+      pose.Set(box.Center(), pose.Rot());
+      ignition::math::Vector3d size = box.Size();
+      if (tracked.published)
+      {
+        // Angle between the orientations, from the dot product of their quaternions
+        double dot = std::abs(pose.Rot().Dot(tracked.pose.Rot()));
+        double turned = 2 * std::acos(std::min(dot, 1.));
+        if (pose.Pos().Distance(tracked.pose.Pos()) < tolerance_ && turned < tolerance_ &&
+            (size - tracked.size).Length() < tolerance_)
+          continue;
+      }
+      tracked.pose = pose;
+      tracked.size = size;
+      tracked.published = true;
+      GazeboPoseToRosMsg(pose, tracked.object.msg_.pose);
+      GazeboVectorToRosMsg(size, tracked.object.msg_.scale);
+      pcodar_->objects_->set_object(tracked.object.msg_.id, tracked.object);
+      changed = true;
+    }
+  }
+
+  ros::Time now = ros::Time::now();
+  if (changed || now - last_publish_ >= republish_period_ || now < last_publish_)
   {
-    object.set_id((*existing_object).first);
-    (*existing_object).second = object;
+    pcodar_->UpdateObjects();
+    last_publish_ = now;
   }
 }
 
@@ -0,0 +1,317 @@
+#include <mil_tools/concurrency.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Compares each of mil_tools' lock-free concurrency primitives with the mutex-based version it replaces, passing
+ * numbered items between threads and checking none are lost, duplicated or torn.
+ *
+ * Usage: concurrency_benchmark [items] [producers]
+ */
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Items lost, duplicated or torn, counted from any thread
+std::atomic<size_t> failures{ 0 };
+
+void check(bool ok)
+{
+  if (!ok)
+    ++failures;
+}
+
+double seconds_since(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(char const* name, size_t items, double seconds)
+{
+  std::cout << "  " << name << ": " << seconds * 1e9 / items << " ns per item, " << items / seconds / 1e6
+            << " M items/s" << std::endl;
+}
+
+// Bounded queue of the kind nodes use today
+template <typename T>
+class LockedQueue
+{
+public:
+  explicit LockedQueue(size_t capacity) : capacity_(capacity)
+  {
+  }
+  bool push(T value)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (items_.size() == capacity_)
+      return false;
+    items_.push_back(std::move(value));
+    return true;
+  }
+  bool pop(T& out)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (items_.empty())
+      return false;
+    out = std::move(items_.front());
+    items_.pop_front();
+    return true;
+  }
+
+private:
+  size_t capacity_;
+  std::mutex mutex_;
+  std::deque<T> items_;
+};
+
+// Sends 1..items from each producer to one consumer, spinning while the queue is full or empty. Returns false if the
+// sum received is not the sum sent.
+template <typename Queue>
+bool run_queue(char const* name, Queue& queue, size_t items, size_t producers)
+{
+  auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < producers; ++p)
+    threads.emplace_back([&] {
+      for (uint64_t i = 1; i <= items; ++i)
+        while (!queue.push(i))
+          std::this_thread::yield();
+    });
+  uint64_t sum = 0;
+  for (size_t received = 0; received < items * producers;)
+  {
+    uint64_t value;
+    if (queue.pop(value))
+    {
+      sum += value;
+      ++received;
+    }
+  }
+  for (auto& thread : threads)
+    thread.join();
+  report(name, items * producers, seconds_since(start));
+  return sum == producers * items * (items + 1) / 2;
+}
+
+// An image-sized value whose words all hold the same number, so a torn read is caught
+struct Frame
+{
+  std::vector<uint64_t> words = std::vector<uint64_t>(1024);
+  bool consistent() const
+  {
+    for (uint64_t word : words)
+      if (word != words[0])
+        return false;
+    return true;
+  }
+};
+
+struct Pose
+{
+  double position[3];
+  double orientation[4];
+  bool consistent() const
+  {
+    for (double value : orientation)
+      if (value != position[0])
+        return false;
+    return position[1] == position[0] && position[2] == position[0];
+  }
+};
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  size_t items = argc > 1 ? std::stoul(argv[1]) : 1000000;
+  size_t producers = argc > 2 ? std::stoul(argv[2]) : 4;
+
+  std::cout << "Queues, capacity 1024, " << items << " items per producer" << std::endl;
+  {
+    mil_tools::SpscQueue<uint64_t> spsc(1024);
+    check(run_queue("SpscQueue, 1 producer", spsc, items, 1));
+    mil_tools::MpmcQueue<uint64_t> mpmc(1024);
+    check(run_queue("MpmcQueue, 1 producer", mpmc, items, 1));
+    LockedQueue<uint64_t> locked(1024);
+    check(run_queue("mutex + deque, 1 producer", locked, items, 1));
+    mil_tools::MpmcQueue<uint64_t> mpmc_many(1024);
+    check(run_queue("MpmcQueue, many producers", mpmc_many, items, producers));
+    LockedQueue<uint64_t> locked_many(1024);
+    check(run_queue("mutex + deque, many producers", locked_many, items, producers));
+  }
+
+  // The consumer takes the latest of a stream of 8 KiB frames, as a detector does from a camera
+  size_t frames = items / 10;
+  std::cout << "Latest value, " << frames << " 8 KiB frames" << std::endl;
+  {
+    mil_tools::Mailbox<Frame> mailbox;
+    std::atomic<bool> done{ false };
+    size_t taken = 0;
+    auto start = Clock::now();
+    std::thread consumer([&] {
+      Frame frame;
+      while (!done)
+        if (mailbox.take(frame))
+        {
+          check(frame.consistent());
+          ++taken;
+        }
+    });
+    Frame frame;
+    for (uint64_t i = 1; i <= frames; ++i)
+    {
+      std::fill(frame.words.begin(), frame.words.end(), i);
+      mailbox.put(frame);
+    }
+    double seconds = seconds_since(start);
+    done = true;
+    consumer.join();
+    report("Mailbox put", frames, seconds);
+    std::cout << "    " << taken << " taken" << std::endl;
+  }
+  {
+    std::mutex mutex;
+    Frame shared;
+    bool fresh = false;
+    std::atomic<bool> done{ false };
+    size_t taken = 0;
+    auto start = Clock::now();
+    std::thread consumer([&] {
+      Frame frame;
+      while (!done)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fresh)
+          continue;
+        frame = shared;
+        fresh = false;
+        check(frame.consistent());
+        ++taken;
+      }
+    });
+    Frame frame;
+    for (uint64_t i = 1; i <= frames; ++i)
+    {
+      std::fill(frame.words.begin(), frame.words.end(), i);
+      std::lock_guard<std::mutex> lock(mutex);
+      shared = frame;
+      fresh = true;
+    }
+    double seconds = seconds_since(start);
+    done = true;
+    consumer.join();
+    report("mutex put", frames, seconds);
+    std::cout << "    " << taken << " taken" << std::endl;
+  }
+
+  // One writer updates a pose while readers poll it
+  std::cout << "Shared pose, " << items << " writes, " << producers << " readers" << std::endl;
+  {
+    auto run = [&](char const* name, std::function<void(Pose const&)> store, std::function<Pose()> load) {
+      std::atomic<bool> done{ false };
+      std::atomic<size_t> reads{ 0 };
+      std::vector<std::thread> readers;
+      for (size_t r = 0; r < producers; ++r)
+        readers.emplace_back([&] {
+          size_t count = 0;
+          while (!done)
+          {
+            check(load().consistent());
+            ++count;
+          }
+          reads += count;
+        });
+      auto start = Clock::now();
+      for (size_t i = 1; i <= items; ++i)
+      {
+        double value = i;
+        store(Pose{ { value, value, value }, { value, value, value, value } });
+      }
+      double seconds = seconds_since(start);
+      done = true;
+      for (auto& reader : readers)
+        reader.join();
+      report(name, items, seconds);
+      std::cout << "    " << reads / seconds / 1e6 << " M reads/s" << std::endl;
+    };
+    mil_tools::SeqLock<Pose> seqlock;
+    run("SeqLock store", [&](Pose const& pose) { seqlock.store(pose); }, [&] { return seqlock.load(); });
+    std::mutex mutex;
+    Pose locked = {};
+    run("mutex store",
+        [&](Pose const& pose) {
+          std::lock_guard<std::mutex> lock(mutex);
+          locked = pose;
+        },
+        [&] {
+          std::lock_guard<std::mutex> lock(mutex);
+          return locked;
+        });
+  }
+
+  // Buffers for a point cloud of 100k points, handed to a worker and dropped there
+  size_t buffers = items / 100;
+  std::cout << "Buffers, " << buffers << " of 1.6 MB" << std::endl;
+  {
+    using Buffer = std::vector<float>;
+    mil_tools::ObjectPool<Buffer> pool(8, 400000);
+    mil_tools::SpscQueue<mil_tools::ObjectPool<Buffer>::Ptr> queue(4);
+    auto start = Clock::now();
+    std::thread worker([&] {
+      mil_tools::ObjectPool<Buffer>::Ptr buffer;
+      for (size_t received = 0; received < buffers;)
+        if (queue.pop(buffer))
+        {
+          check(buffer->size() == 400000);
+          buffer.reset();
+          ++received;
+        }
+    });
+    for (size_t i = 0; i < buffers; ++i)
+    {
+      auto buffer = pool.acquire();
+      while (!buffer)
+        buffer = pool.acquire();
+      (*buffer)[i % buffer->size()] = i;
+      while (!queue.push(std::move(buffer)))
+        std::this_thread::yield();
+    }
+    worker.join();
+    report("ObjectPool", buffers, seconds_since(start));
+  }
+  {
+    using Buffer = std::vector<float>;
+    mil_tools::SpscQueue<std::shared_ptr<Buffer>> queue(4);
+    auto start = Clock::now();
+    std::thread worker([&] {
+      std::shared_ptr<Buffer> buffer;
+      for (size_t received = 0; received < buffers;)
+        if (queue.pop(buffer))
+        {
+          check(buffer->size() == 400000);
+          buffer.reset();
+          ++received;
+        }
+    });
+    for (size_t i = 0; i < buffers; ++i)
+    {
+      auto buffer = std::make_shared<Buffer>(400000);
+      (*buffer)[i % buffer->size()] = i;
+      while (!queue.push(std::move(buffer)))
+        std::this_thread::yield();
+    }
+    worker.join();
+    report("make_shared", buffers, seconds_since(start));
+  }
+
+  if (failures)
+    std::cout << failures << " checks failed, items were lost, duplicated or torn" << std::endl;
+  return failures ? 1 : 0;
+}
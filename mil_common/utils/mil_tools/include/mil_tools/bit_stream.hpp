@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mil_tools
+{
+/*
+Writing and reading a stream of bit fields, MSB first, for the entropy coders of the compressed recordings
+(point_cloud_codec.hpp and mil_passive_sonar's sample codec).
+
+  std::vector<uint8_t> out;
+  mil_tools::BitWriter writer(out);
+  writer.put(k, 5);
+  writer.flush();
+  ...
+  mil_tools::BitReader reader(out.data(), out.size());
+  uint32_t k;
+  if (!reader.get(5, k))
+    return false;  // truncated
+*/
+
+// Appends bit fields to a byte vector
+class BitWriter
+{
+public:
+  explicit BitWriter(std::vector<uint8_t>& out) : out_(out)
+  {
+  }
+
+  /// Append the low bits of value, which must be no more than 32 and have nothing above them set
+  void put(uint32_t value, uint32_t bits)
+  {
+    acc_ = (acc_ << bits) | value;
+    count_ += bits;
+    while (count_ >= 8)
+    {
+      count_ -= 8;
+      out_.push_back(static_cast<uint8_t>(acc_ >> count_));
+    }
+  }
+
+  /// Pad the last byte with zeros
+  void flush()
+  {
+    if (count_)
+      out_.push_back(static_cast<uint8_t>(acc_ << (8 - count_)));
+    count_ = 0;
+  }
+
+private:
+  std::vector<uint8_t>& out_;
+  uint64_t acc_ = 0;
+  uint32_t count_ = 0;  // bits of acc_ not written yet, at its bottom
+};
+
+// Reads the bit fields a BitWriter wrote
+class BitReader
+{
+public:
+  BitReader(const uint8_t* data, size_t size) : data_(data), size_(size)
+  {
+  }
+
+  /// Read bits, no more than 32, returning false at the end of the data
+  bool get(uint32_t bits, uint32_t& value)
+  {
+    while (count_ < bits)
+    {
+      if (pos_ == size_)
+        return false;
+      acc_ = (acc_ << 8) | data_[pos_++];
+      count_ += 8;
+    }
+    count_ -= bits;
+    value = static_cast<uint32_t>((acc_ >> count_) & ((uint64_t(1) << bits) - 1));
+    return true;
+  }
+
+private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_ = 0;
+  uint64_t acc_ = 0;
+  uint32_t count_ = 0;
+};
+
+}  // namespace mil_tools
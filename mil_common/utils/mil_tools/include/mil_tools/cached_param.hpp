@@ -0,0 +1,215 @@
+#pragma once
+
+#include <ros/ros.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mil_tools
+{
+/*
+Parameters declared once and read for free after, for hot loops.
+
+Each declared parameter is read through ros::NodeHandle::getParamCached, which subscribes the node to updates
+of it from the master, so refreshing it only reads roscpp's local copy. A timer refreshes every parameter in the
+set, and calls a parameter's callbacks when its value has changed. Reading a CachedParam of an arithmetic type
+is an atomic load; other types (std::string, std::vector) are copied under a lock.
+
+  mil_tools::ParamSet params(nh);
+  auto& hit = params.declare<double>("hit_prob", 0.7, [](double p) { ROS_INFO("hit_prob now %f", p); });
+  ...
+  double p = hit;  // in the hot loop
+
+Callbacks are called from the node handle's callback queue, or from whichever thread calls refresh(), and must
+not declare parameters.
+*/
+namespace detail
+{
+// Value of a parameter, atomic where it can be
+template <typename T, bool = std::is_arithmetic<T>::value>
+class ParamValue
+{
+public:
+  explicit ParamValue(T const &value) : value_(value)
+  {
+  }
+  T load() const
+  {
+    return value_.load(std::memory_order_acquire);
+  }
+  void store(T const &value)
+  {
+    value_.store(value, std::memory_order_release);
+  }
+
+private:
+  std::atomic<T> value_;
+};
+template <typename T>
+class ParamValue<T, false>
+{
+public:
+  explicit ParamValue(T const &value) : value_(value)
+  {
+  }
+  T load() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return value_;
+  }
+  void store(T const &value)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_ = value;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  T value_;
+};
+
+// unsigned int and ros::Duration are not types the parameter server holds, so are read as what they are held as
+template <typename T>
+bool getParamCached(ros::NodeHandle &nh, std::string const &name, T &res)
+{
+  return nh.getParamCached(name, res);
+}
+template <>
+inline bool getParamCached(ros::NodeHandle &nh, std::string const &name, unsigned int &res)
+{
+  int x;
+  if (!nh.getParamCached(name, x) || x < 0)
+    return false;
+  res = static_cast<unsigned int>(x);
+  return true;
+}
+template <>
+inline bool getParamCached(ros::NodeHandle &nh, std::string const &name, ros::Duration &res)
+{
+  double x;
+  if (!nh.getParamCached(name, x))
+    return false;
+  res = ros::Duration(x);
+  return true;
+}
+}  // namespace detail
+
+class ParamSet;
+
+class CachedParamBase
+{
+public:
+  virtual ~CachedParamBase() = default;
+  std::string const &name() const
+  {
+    return name_;
+  }
+
+protected:
+  explicit CachedParamBase(std::string const &name) : name_(name)
+  {
+  }
+  // Rereads the parameter, returning whether it has changed
+  virtual bool refresh(ros::NodeHandle &nh) = 0;
+  virtual void notify() = 0;
+
+private:
+  friend class ParamSet;
+  std::string name_;
+};
+
+template <typename T>
+class CachedParam : public CachedParamBase
+{
+public:
+  using Callback = std::function<void(T const &)>;
+
+  CachedParam(std::string const &name, T const &default_value)
+    : CachedParamBase(name), default_(default_value), value_(default_value)
+  {
+  }
+  T get() const
+  {
+    return value_.load();
+  }
+  operator T() const
+  {
+    return get();
+  }
+  // Called with the new value whenever it changes
+  void onChange(Callback cb)
+  {
+    std::lock_guard<std::mutex> lock(callbacks_mutex_);
+    callbacks_.push_back(std::move(cb));
+  }
+
+protected:
+  bool refresh(ros::NodeHandle &nh) override
+  {
+    T value;
+    // A parameter deleted, or set to the wrong type, goes back to its default
+    if (!detail::getParamCached(nh, name(), value))
+      value = default_;
+    if (value == last_)
+      return false;
+    last_ = value;
+    value_.store(value);
+    return true;
+  }
+  void notify() override
+  {
+    T value = last_;
+    std::lock_guard<std::mutex> lock(callbacks_mutex_);
+    for (auto const &cb : callbacks_)
+      cb(value);
+  }
+
+private:
+  T const default_;
+  T last_ = default_;  // only touched by refresh and notify, which the ParamSet serializes
+  detail::ParamValue<T> value_;
+  std::mutex callbacks_mutex_;
+  std::vector<Callback> callbacks_;
+};
+
+class ParamSet
+{
+public:
+  // Parameters are relative to nh, and refreshed every refresh_period, or never if it is zero
+  explicit ParamSet(ros::NodeHandle nh, ros::WallDuration refresh_period = ros::WallDuration(1.));
+
+  // Declares a parameter, reading it right away. The reference lives as long as the set.
+  template <typename T>
+  CachedParam<T> &declare(std::string const &name, T const &default_value,
+                          typename CachedParam<T>::Callback on_change = nullptr)
+  {
+    std::unique_ptr<CachedParam<T>> param(new CachedParam<T>(name, default_value));
+    CachedParam<T> &ref = *param;
+    std::lock_guard<std::mutex> lock(mutex_);
+    static_cast<CachedParamBase &>(ref).refresh(nh_);
+    if (on_change)
+      ref.onChange(std::move(on_change));
+    params_.push_back(std::move(param));
+    return ref;
+  }
+
+  // Rereads every parameter, calling the callbacks of those that changed
+  void refresh();
+
+private:
+  void refreshCb(ros::WallTimerEvent const &)
+  {
+    refresh();
+  }
+
+  ros::NodeHandle nh_;
+  ros::WallTimer timer_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<CachedParamBase>> params_;
+};
+}  // namespace mil_tools
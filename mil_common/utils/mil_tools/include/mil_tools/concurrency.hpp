@@ -0,0 +1,431 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mil_tools
+{
+/*
+Lock-free building blocks for handing data between threads, so nodes stop growing their own mutexes and buffers.
+
+  SpscQueue<T>    bounded FIFO from one producer thread to one consumer thread
+  MpmcQueue<T>    bounded FIFO from any number of producers to any number of consumers, for several sensor
+                  callbacks feeding one worker
+  Mailbox<T>      the latest value from one producer to one consumer, which never waits and never queues old values,
+                  for a detector that only wants the newest image
+  ObjectPool<T>   fixed set of objects that are handed out and come back when their handle is dropped, on any thread,
+                  so big buffers like point clouds and images are reused rather than allocated per message
+  SeqLock<T>      small trivially copyable value written by one thread and read by any number without ever blocking
+                  the writer, for state like the latest pose
+
+None of them allocate after construction, and push / pop / put / take / store / load never block. Queues that are full
+and pools that are empty say so instead, so the caller decides whether to drop, count or wait. Waiting, where it is
+wanted, is left to a condition variable around them, as in PCODAR's worker.
+
+  mil_tools::SpscQueue<mil_tools::ObjectPool<Scan>::Ptr> queue(4);
+  mil_tools::ObjectPool<Scan> scans(6);
+  ...
+  auto scan = scans.acquire();  // callback thread
+  if (!scan || !queue.push(std::move(scan)))
+    ++dropped;
+  ...
+  mil_tools::ObjectPool<Scan>::Ptr scan;  // worker thread
+  if (queue.pop(scan))
+    process(*scan);  // back in the pool when scan is reset or reassigned
+
+concurrency_benchmark compares each against the mutex-based version it replaces.
+*/
+
+namespace detail
+{
+// Keeps members written by different threads out of each other's cache lines
+constexpr size_t CACHE_LINE = 64;
+
+inline size_t roundUpToPowerOfTwo(size_t n)
+{
+  size_t power = 1;
+  while (power < n)
+    power <<= 1;
+  return power;
+}
+}  // namespace detail
+
+// Bounded FIFO queue between exactly one producer thread and one consumer thread
+template <typename T>
+class SpscQueue
+{
+public:
+  explicit SpscQueue(size_t capacity)
+    : capacity_(capacity ? capacity : 1), mask_(detail::roundUpToPowerOfTwo(capacity_) - 1), slots_(mask_ + 1)
+  {
+  }
+
+  SpscQueue(SpscQueue const &) = delete;
+  SpscQueue &operator=(SpscQueue const &) = delete;
+
+  // Producer only. Returns false, leaving value alone, if the queue is full.
+  template <typename U>
+  bool push(U &&value)
+  {
+    size_t tail = tail_.next.load(std::memory_order_relaxed);
+    if (tail - tail_.other == capacity_)
+    {
+      tail_.other = head_.next.load(std::memory_order_acquire);
+      if (tail - tail_.other == capacity_)
+        return false;
+    }
+    slots_[tail & mask_] = std::forward<U>(value);
+    tail_.next.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. Returns false if the queue is empty.
+  bool pop(T &out)
+  {
+    size_t head = head_.next.load(std::memory_order_relaxed);
+    if (head == head_.other)
+    {
+      head_.other = tail_.next.load(std::memory_order_acquire);
+      if (head == head_.other)
+        return false;
+    }
+    out = std::move(slots_[head & mask_]);
+    head_.next.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Only exact from the producer or consumer, and only while the other is not using the queue
+  size_t size() const
+  {
+    return tail_.next.load(std::memory_order_acquire) - head_.next.load(std::memory_order_acquire);
+  }
+  bool empty() const
+  {
+    return size() == 0;
+  }
+  size_t capacity() const
+  {
+    return capacity_;
+  }
+
+private:
+  // Next slot one thread pops or pushes, and the other thread's as it last saw it, so it only reads the other's cache
+  // line when the queue looks empty or full
+  struct Index
+  {
+    std::atomic<size_t> next{ 0 };
+    size_t other = 0;
+    char pad[detail::CACHE_LINE];
+  };
+
+  size_t const capacity_;
+  size_t const mask_;
+  std::vector<T> slots_;
+  Index head_;  // consumer's
+  Index tail_;  // producer's
+};
+
+// Bounded FIFO queue between any number of producer and consumer threads (Vyukov's). The capacity is rounded up to a
+// power of two.
+template <typename T>
+class MpmcQueue
+{
+public:
+  explicit MpmcQueue(size_t capacity)
+    : mask_(detail::roundUpToPowerOfTwo(capacity < 2 ? 2 : capacity) - 1), cells_(new Cell[mask_ + 1])
+  {
+    for (size_t i = 0; i <= mask_; ++i)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  MpmcQueue(MpmcQueue const &) = delete;
+  MpmcQueue &operator=(MpmcQueue const &) = delete;
+
+  // Returns false, leaving value alone, if the queue is full
+  template <typename U>
+  bool push(U &&value)
+  {
+    size_t position = enqueue_.next.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;)
+    {
+      cell = &cells_[position & mask_];
+      // A cell is free to push into when its sequence is the position, and holds a value to pop at position + 1
+      intptr_t diff = intptr_t(cell->sequence.load(std::memory_order_acquire)) - intptr_t(position);
+      if (diff == 0)
+      {
+        if (enqueue_.next.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;
+      else
+        position = enqueue_.next.load(std::memory_order_relaxed);
+    }
+    cell->value = std::forward<U>(value);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the queue is empty
+  bool pop(T &out)
+  {
+    size_t position = dequeue_.next.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;)
+    {
+      cell = &cells_[position & mask_];
+      intptr_t diff = intptr_t(cell->sequence.load(std::memory_order_acquire)) - intptr_t(position + 1);
+      if (diff == 0)
+      {
+        if (dequeue_.next.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;
+      else
+        position = dequeue_.next.load(std::memory_order_relaxed);
+    }
+    out = std::move(cell->value);
+    cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate while other threads are using the queue
+  size_t size() const
+  {
+    size_t enqueued = enqueue_.next.load(std::memory_order_acquire);
+    size_t dequeued = dequeue_.next.load(std::memory_order_acquire);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+  bool empty() const
+  {
+    return size() == 0;
+  }
+  size_t capacity() const
+  {
+    return mask_ + 1;
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  // Next position pushed or popped
+  struct Position
+  {
+    std::atomic<size_t> next{ 0 };
+    char pad[detail::CACHE_LINE];
+  };
+
+  size_t const mask_;
+  std::unique_ptr<Cell[]> cells_;
+  Position enqueue_;
+  Position dequeue_;
+};
+
+// The latest value from one producer thread to one consumer thread, through three buffers: the producer's, the
+// consumer's, and the newest finished one, which they swap theirs with. Neither ever waits on the other, and values
+// the consumer did not take in time are overwritten rather than queued.
+template <typename T>
+class Mailbox
+{
+public:
+  Mailbox() : middle_(2), write_(0), read_(1)
+  {
+  }
+
+  Mailbox(Mailbox const &) = delete;
+  Mailbox &operator=(Mailbox const &) = delete;
+
+  // Producer only. Replaces any value the consumer has not taken yet.
+  template <typename U>
+  void put(U &&value)
+  {
+    buffers_[write_] = std::forward<U>(value);
+    write_ = middle_.exchange(write_ | NEW, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Consumer only. If there is a value newer than the last one taken, swaps it into out and returns true. The value
+  // swapped out of out is given back to the producer to be overwritten, so buffers like images are reused.
+  bool take(T &out)
+  {
+    if (!(middle_.load(std::memory_order_relaxed) & NEW))
+      return false;
+    read_ = middle_.exchange(read_, std::memory_order_acq_rel) & INDEX;
+    using std::swap;
+    swap(out, buffers_[read_]);
+    return true;
+  }
+
+  // Whether a value was put since the last take, from either thread
+  bool hasNew() const
+  {
+    return middle_.load(std::memory_order_acquire) & NEW;
+  }
+
+private:
+  static constexpr uint8_t INDEX = 3;
+  static constexpr uint8_t NEW = 4;
+
+  T buffers_[3];
+  // Index of the newest finished buffer, with NEW set until the consumer takes it
+  std::atomic<uint8_t> middle_;
+  uint8_t write_;  // producer's
+  uint8_t read_;   // consumer's
+};
+
+// Fixed set of objects handed out by acquire, which go back to the pool when the handle is destroyed, from any
+// thread. Objects keep whatever they held when they come back, so reused buffers keep their allocations. Handles keep
+// the pool's objects alive, so the pool itself can go away first.
+template <typename T>
+class ObjectPool
+{
+  struct Shared
+  {
+    explicit Shared(size_t capacity) : free(capacity)
+    {
+    }
+    std::vector<std::unique_ptr<T>> objects;
+    MpmcQueue<T *> free;
+  };
+
+public:
+  struct Recycler
+  {
+    std::shared_ptr<Shared> shared;
+    void operator()(T *object) const
+    {
+      // Never full, as there is room for every object
+      shared->free.push(object);
+    }
+  };
+  using Ptr = std::unique_ptr<T, Recycler>;
+
+  // Constructs capacity objects from args
+  template <typename... Args>
+  explicit ObjectPool(size_t capacity, Args const &... args) : shared_(std::make_shared<Shared>(capacity))
+  {
+    shared_->objects.reserve(capacity);
+    for (size_t i = 0; i < capacity; ++i)
+    {
+      shared_->objects.emplace_back(new T(args...));
+      shared_->free.push(shared_->objects.back().get());
+    }
+  }
+
+  ObjectPool(ObjectPool const &) = delete;
+  ObjectPool &operator=(ObjectPool const &) = delete;
+
+  // An object no one else holds, or null if they are all in use
+  Ptr acquire()
+  {
+    T *object;
+    if (!shared_->free.pop(object))
+      return Ptr();
+    return Ptr(object, Recycler{ shared_ });
+  }
+
+  // As acquire, for objects that will be held in several places. Only the shared_ptr's control block is allocated.
+  std::shared_ptr<T> acquireShared()
+  {
+    Ptr object = acquire();
+    if (!object)
+      return nullptr;
+    return std::shared_ptr<T>(std::move(object));
+  }
+
+  size_t capacity() const
+  {
+    return shared_->objects.size();
+  }
+  // Approximate while other threads are acquiring or releasing objects
+  size_t available() const
+  {
+    return shared_->free.size();
+  }
+
+private:
+  std::shared_ptr<Shared> shared_;
+};
+
+// A trivially copyable value written by one thread at a time and read by any number without locks. The writer never
+// waits. Readers copy the value and try again if the writer changed it meanwhile, so it should be small, like a pose.
+template <typename T>
+class SeqLock
+{
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock values are copied a word at a time");
+
+public:
+  SeqLock() : SeqLock(T())
+  {
+  }
+
+  explicit SeqLock(T const &value)
+  {
+    sequence_.store(0, std::memory_order_relaxed);
+    write(value);
+  }
+
+  SeqLock(SeqLock const &) = delete;
+  SeqLock &operator=(SeqLock const &) = delete;
+
+  // Only one thread may store at a time
+  void store(T const &value)
+  {
+    uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    write(value);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  T load() const
+  {
+    T value;
+    uint64_t before, after;
+    do
+    {
+      before = sequence_.load(std::memory_order_acquire);
+      uint64_t words[WORDS];
+      for (size_t i = 0; i < WORDS; ++i)
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence_.load(std::memory_order_relaxed);
+      std::memcpy(&value, words, sizeof(T));
+    } while ((before & 1) || before != after);
+    return value;
+  }
+
+  // Number of stores so far, to tell whether the value changed since it was last loaded
+  uint64_t version() const
+  {
+    return sequence_.load(std::memory_order_acquire) / 2;
+  }
+
+private:
+  static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  // Copied through atomic words, so a read that races a store is retried rather than undefined
+  void write(T const &value)
+  {
+    uint64_t words[WORDS] = {};
+    std::memcpy(words, &value, sizeof(T));
+    for (size_t i = 0; i < WORDS; ++i)
+      words_[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> sequence_;
+  std::atomic<uint64_t> words_[WORDS];
+};
+
+}  // namespace mil_tools
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <ros/ros.h>
+
+#include <utility>
+
+namespace mil_tools
+{
+/*
+Debug outputs that are only produced while someone listens.
+
+roscpp already skips serializing a message nobody subscribes to, but by then the node has built it: drawn the
+image, copied the cloud, filled the grid. A DebugPublisher is asked whether its output is wanted before any of that
+is done, and answers from the publisher's subscriber count, which is a lock and a sum over its links.
+
+  mil_tools::DebugPublisher<> pub_cloud_ = nh.advertise<pcl::PointCloud<pcl::PointXYZ>>("debug_cloud", 1);
+  ...
+  if (pub_cloud_.wanted())
+  {
+    build_debug_cloud(cloud);
+    pub_cloud_.publish(cloud);
+  }
+
+Publisher is anything with getNumSubscribers() and publish(), so image_transport::Publisher and CameraPublisher work
+too. Those count the subscribers of every transport, so a viewer of only the compressed stream still gets images.
+A DebugPublisher can also be disabled outright, e.g. from a node's debug parameter, when it is never wanted.
+*/
+template <typename Publisher = ros::Publisher>
+class DebugPublisher
+{
+public:
+  DebugPublisher() : enabled_(true)
+  {
+  }
+  DebugPublisher(Publisher const &publisher, bool enabled = true) : publisher_(publisher), enabled_(enabled)
+  {
+  }
+
+  /// Whether the output is worth producing: enabled, advertised and subscribed to
+  bool wanted() const
+  {
+    return enabled_ && publisher_ && publisher_.getNumSubscribers() > 0;
+  }
+
+  /// Publishes message, which should only have been produced if wanted()
+  template <typename Message>
+  void publish(Message const &message) const
+  {
+    publisher_.publish(message);
+  }
+
+  void set_enabled(bool enabled)
+  {
+    enabled_ = enabled;
+  }
+  bool enabled() const
+  {
+    return enabled_;
+  }
+
+  Publisher &publisher()
+  {
+    return publisher_;
+  }
+  Publisher const &publisher() const
+  {
+    return publisher_;
+  }
+
+private:
+  Publisher publisher_;
+  bool enabled_;
+};
+
+/// Whether any of the outputs is wanted, for a debug product several of them are made from
+template <typename... Publishers>
+bool any_wanted(Publishers const &... publishers)
+{
+  bool wanted[] = { false, publishers.wanted()... };
+  for (bool w : wanted)
+    if (w)
+      return true;
+  return false;
+}
+
+}  // namespace mil_tools
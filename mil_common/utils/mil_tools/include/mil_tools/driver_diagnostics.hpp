@@ -0,0 +1,121 @@
+#pragma once
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+#include <ros/ros.h>
+
+#include <mil_tools/framed_serial.hpp>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mil_tools
+{
+/*
+Counts of durations in buckets spaced four to an octave from 10 microseconds up to about 10 seconds, so percentiles
+are known to within a fifth without keeping every sample. Not thread safe.
+*/
+class DurationHistogram
+{
+public:
+  DurationHistogram();
+
+  /// Records a duration in seconds, anything under 10 microseconds or negative going in the first bucket
+  void record(double seconds);
+  /// Samples recorded since the last clear
+  uint64_t count() const
+  {
+    return count_;
+  }
+  /// Mean, standard deviation and largest of the samples, in seconds, or 0 without any
+  double mean() const;
+  double stddev() const;
+  double max() const;
+  /// Upper edge of the bucket the fraction quantile falls in, at most max()
+  double percentile(double fraction) const;
+  void clear();
+
+private:
+  static const size_t BUCKETS = 82;
+  std::array<uint64_t, BUCKETS> counts_;
+  uint64_t count_;
+  double sum_;
+  double sum_sq_;
+  double max_;
+};
+
+/*
+Timing of one stream of messages a driver publishes: how late each is when published, how evenly they are published,
+and how many were lost. Safe to record from any thread.
+*/
+class StreamMonitor
+{
+public:
+  /// @param sporadic if the stream may go quiet without anything being wrong, like pings or bottom lock
+  explicit StreamMonitor(bool sporadic = false);
+
+  /// Records a message published now, whose data arrived or was sampled at stamp
+  void published(const ros::Time& stamp);
+  void published(const ros::Time& stamp, const ros::Time& now);
+  /// Records messages lost before they could be published, e.g. frames missing from the stream or overrun buffers
+  void dropped(uint64_t count = 1);
+  /// Records messages that were received but could not be used
+  void errors(uint64_t count = 1);
+
+  /// Fills status with the latency and interval percentiles since the last call and the total counts, warning if
+  /// anything was lost or nothing published, then starts over
+  void to_msg(diagnostic_msgs::DiagnosticStatus& status, double period);
+
+private:
+  const bool sporadic_;
+  std::mutex mutex_;
+  DurationHistogram latency_;
+  DurationHistogram interval_;
+  ros::Time last_published_;
+  uint64_t messages_ = 0;
+  uint64_t dropped_ = 0;
+  uint64_t errors_ = 0;
+  uint64_t period_dropped_ = 0;
+  uint64_t period_errors_ = 0;
+};
+
+/*
+Publishes the timing of a driver's streams on /diagnostics every ~diagnostics_period seconds, one status per stream
+named "<driver>: <stream>" with the device as its hardware_id, followed by any statuses added with add_status.
+*/
+class DriverDiagnostics
+{
+public:
+  typedef std::function<void(diagnostic_msgs::DiagnosticStatus&)> StatusFiller;
+
+  DriverDiagnostics(ros::NodeHandle nh, ros::NodeHandle private_nh, const std::string& name,
+                    const std::string& hardware_id);
+
+  /// Monitor of the named stream, made on first use. It lives as long as this does.
+  StreamMonitor& stream(const std::string& name, bool sporadic = false);
+  /// Adds a status filled by fill each period, on the timer's thread
+  void add_status(const std::string& name, StatusFiller fill);
+
+private:
+  void publish(const ros::TimerEvent& event);
+
+  std::string name_;
+  std::string hardware_id_;
+  std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<StreamMonitor> > streams_;
+  std::vector<std::pair<std::string, StatusFiller> > statuses_;
+  ros::Publisher pub_;
+  ros::Timer timer_;
+  ros::Time last_publish_;
+};
+
+/// Status filler for the stats of a FramedSerialPort, warning on errors since the period before
+DriverDiagnostics::StatusFiller serial_port_status(std::function<FramedSerialPort::Stats()> stats);
+
+}  // namespace mil_tools
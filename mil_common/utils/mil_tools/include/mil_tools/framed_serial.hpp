@@ -0,0 +1,142 @@
+#pragma once
+
+#include <ros/ros.h>
+
+#include <mil_tools/raw_capture.hpp>
+#include <mil_tools/thread_policy.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mil_tools
+{
+/*
+Splits the bytes received from a FramedSerialPort into frames.
+
+parse is called on the I/O thread with the bytes received and not consumed yet, whenever more come in, until it finds
+no more frames in them. It should say how many bytes it is done with even when it finds no frame, so the garbage
+before a frame does not pile up.
+*/
+class FrameParser
+{
+public:
+  struct Match
+  {
+    size_t start = 0;     // offset of the first byte of the frame, to stamp it by
+    size_t consumed = 0;  // bytes that will not be looked at again, up to the end of the frame if there is one
+    // The frame, either in the received bytes or in the parser's own buffer, e.g. after unescaping. Only valid until
+    // parse is called again.
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    size_t errors = 0;  // candidate frames rejected, e.g. by their checksum
+  };
+
+  virtual ~FrameParser()
+  {
+  }
+
+  /// Looks for the next frame in [begin, end), returning whether it found one
+  virtual bool parse(const uint8_t* begin, const uint8_t* end, Match& match) = 0;
+
+  /// Forgets any state kept between calls, when the port is reopened
+  virtual void reset()
+  {
+  }
+};
+
+/// Frames of a fixed size, back to back from the start of the stream
+class FixedSizeFrameParser : public FrameParser
+{
+public:
+  explicit FixedSizeFrameParser(size_t frame_size) : frame_size_(frame_size)
+  {
+  }
+
+  bool parse(const uint8_t* begin, const uint8_t* end, Match& match) override
+  {
+    if (size_t(end - begin) < frame_size_)
+      return false;
+    match.start = 0;
+    match.consumed = match.size = frame_size_;
+    match.data = begin;
+    return true;
+  }
+
+private:
+  size_t frame_size_;
+};
+
+struct SerialFrame
+{
+  const uint8_t* data;  // only valid in the handler
+  size_t size;
+  uint64_t offset;  // of the frame's first byte in the stream since the port was last opened
+  ros::Time stamp;  // time the frame's first byte came in, from when its read finished less its time on the wire
+};
+
+/*
+Reads and writes a serial port, or any other character device or FIFO, asynchronously on an I/O thread shared by
+every FramedSerialPort in the process, and hands each frame its parser finds in the stream to a handler, also on that
+thread. The port is opened on construction and reopened a second after any error, without blocking anything.
+
+Everything received in one read is framed in place in a buffer that is compacted when the room after the unparsed
+bytes runs low, so a frame is never split and is only copied if its parser has to.
+
+Every read can be written to a raw capture, and a capture replayed in place of the port, feeding the parser the same
+chunks with the same arrival times, so the frames and their stamps are those the live port gave. Writes are dropped
+while replaying.
+*/
+class FramedSerialPort
+{
+public:
+  typedef std::function<void(const SerialFrame&)> Handler;
+
+  static const size_t DEFAULT_MAX_FRAME_SIZE = 1 << 16;
+
+  struct Stats
+  {
+    uint64_t bytes = 0;
+    uint64_t frames = 0;
+    uint64_t parse_errors = 0;
+    uint64_t read_errors = 0;  // each of which reopened the port
+    uint64_t open_errors = 0;
+    // From a frame's stamp to its handler being called, the time it waited to be read and framed
+    double mean_latency = 0;
+    double max_latency = 0;
+  };
+
+  /**
+   * @param baudrate of the serial port, or 0 for devices that are not serial ports, like a FIFO
+   * @param max_frame_size largest frame the parser can find, the buffer holds twice this
+   * @param capture raw capture to write the reads to, or to replay instead of opening the port
+   */
+  FramedSerialPort(const std::string& port, int baudrate, std::unique_ptr<FrameParser> parser, Handler handler,
+                   size_t max_frame_size = DEFAULT_MAX_FRAME_SIZE,
+                   const RawCaptureOptions& capture = RawCaptureOptions());
+  /// Closes the port. No handler is running or will be called once this returns, so it can not be called from one.
+  ~FramedSerialPort();
+
+  /// Queues bytes to be written, from any thread. They are dropped if the port is not open.
+  void write(const std::vector<uint8_t>& bytes);
+  void write(const std::string& bytes);
+
+  /// Applies policy to the I/O thread, which every port in the process shares, so the last policy applied holds for
+  /// all of them. Returns false if any of it could not be applied.
+  bool applyThreadPolicy(const ThreadPolicy& policy);
+
+  Stats stats() const;
+  const std::string& port() const
+  {
+    return port_;
+  }
+
+private:
+  class Impl;
+  std::shared_ptr<Impl> impl_;
+  std::string port_;
+};
+
+}  // namespace mil_tools
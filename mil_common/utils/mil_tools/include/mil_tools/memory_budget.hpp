@@ -0,0 +1,64 @@
+#pragma once
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+#include <ros/ros.h>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mil_tools
+{
+/*
+Accounting of the memory a node's large buffers hold, such as accumulated point clouds, object maps, grids and frame
+histories, so a node that grows over a long day shows which of them is responsible.
+
+Each buffer is added with a function counting the bytes it holds and, optionally, one that evicts from it down to a
+number of bytes. to_msg counts every buffer and the resident memory of the whole process into a diagnostic status,
+and calls the evictor of any buffer over its soft limit, warning that it did. Limits are read from the
+memory_limit_mb/<buffer name> param of the node handle when the buffer is added, with no limit if it is not set.
+
+  mil_tools::MemoryBudget memory(private_nh);
+  memory.add("point_buffer", [this] { return point_buffer_.capacity() * sizeof(Point); },
+             [this](size_t bytes) { point_buffer_.rset_capacity(bytes / sizeof(Point)); });
+  ...
+  diagnostics.add_status("memory", [&](diagnostic_msgs::DiagnosticStatus& status) { memory.to_msg(status); });
+
+Counters and evictors are called from whichever thread calls to_msg, so they must lock what they touch.
+*/
+class MemoryBudget
+{
+public:
+  typedef std::function<size_t()> Counter;
+  /// Frees what it can of a buffer so it holds at most the given bytes
+  typedef std::function<void(size_t)> Evictor;
+
+  explicit MemoryBudget(ros::NodeHandle nh);
+
+  void add(const std::string& name, Counter bytes, Evictor evict = Evictor());
+
+  /// Counts every buffer, evicting from those over their limit, and adds the counts to status, warning if any was
+  /// over its limit
+  void to_msg(diagnostic_msgs::DiagnosticStatus& status);
+
+  /// Bytes of the process resident in memory, or 0 if unknown
+  static size_t resident_bytes();
+
+private:
+  struct Buffer
+  {
+    std::string name;
+    Counter bytes;
+    Evictor evict;
+    size_t limit;  // 0 for none
+    uint64_t evictions;
+  };
+
+  ros::NodeHandle nh_;
+  std::mutex mutex_;
+  std::vector<Buffer> buffers_;
+};
+
+}  // namespace mil_tools
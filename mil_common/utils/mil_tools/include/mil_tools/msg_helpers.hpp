@@ -1,8 +1,13 @@
 #pragma once
 
 #include <tf/tf.h>
+#include <boost/array.hpp>
 #include <Eigen/Dense>
 
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
 namespace mil_tools
 {
 template <class T>
@@ -94,4 +99,90 @@ inline T quat2xyzw(Eigen::Quaterniond q)
 {
   return make_xyzw<T>(q.x(), q.y(), q.z(), q.w());
 }
+/// Scalar type of the x, y and z fields of a message such as geometry_msgs::Point, Point32 or Vector3
+template <class T>
+using XYZScalar = typename std::remove_cv<typename std::remove_reference<decltype(T::x)>::type>::type;
+
+/// Column-per-element view of an array of T, see xyz_map
+template <class T>
+using XYZMap = Eigen::Map<Eigen::Matrix<XYZScalar<T>, 3, Eigen::Dynamic>>;
+template <class T>
+using ConstXYZMap = Eigen::Map<const Eigen::Matrix<XYZScalar<T>, 3, Eigen::Dynamic>>;
+
+namespace detail
+{
+/// Checks T is x, y and z packed in that order and nothing else, so an array of them is a 3xN matrix
+template <class T>
+inline void check_xyz_layout()
+{
+  using Scalar = XYZScalar<T>;
+  static_assert(std::is_standard_layout<T>::value, "xyz_map needs a standard layout message");
+  static_assert(sizeof(T) == 3 * sizeof(Scalar), "xyz_map needs a message of only x, y and z");
+  static_assert(offsetof(T, x) == 0 && offsetof(T, y) == sizeof(Scalar) && offsetof(T, z) == 2 * sizeof(Scalar),
+                "xyz_map needs x, y and z packed in that order");
+}
+}  // namespace detail
+
+/// Views an array of geometry_msgs::Point, Point32 or Vector3 as a 3xN matrix, one column per element, without
+/// copying. So a whole array is transformed or copied from a cloud or matrix in one vectorized expression, e.g.
+///   msg.points.resize(cloud.size());
+///   xyz_map(msg.points) = cloud.getMatrixXfMap(3, sizeof(pcl::PointXYZ) / sizeof(float), 0);
+///   xyz_map(poses) = transform.linear() * xyz_map(poses);
+/// The view is invalidated by anything that reallocates the vector.
+template <class T, class Alloc>
+inline XYZMap<T> xyz_map(std::vector<T, Alloc>& v)
+{
+  detail::check_xyz_layout<T>();
+  return XYZMap<T>(reinterpret_cast<XYZScalar<T>*>(v.data()), 3, v.size());
+}
+template <class T, class Alloc>
+inline ConstXYZMap<T> xyz_map(std::vector<T, Alloc> const& v)
+{
+  detail::check_xyz_layout<T>();
+  return ConstXYZMap<T>(reinterpret_cast<XYZScalar<T> const*>(v.data()), 3, v.size());
+}
+
+/// Views a single geometry_msgs::Point, Point32 or Vector3 as a vector, without copying
+template <class T>
+inline Eigen::Map<Eigen::Matrix<XYZScalar<T>, 3, 1>> xyz_map(T& m)
+{
+  detail::check_xyz_layout<T>();
+  return Eigen::Map<Eigen::Matrix<XYZScalar<T>, 3, 1>>(&m.x);
+}
+template <class T>
+inline Eigen::Map<const Eigen::Matrix<XYZScalar<T>, 3, 1>> xyz_map(T const& m)
+{
+  detail::check_xyz_layout<T>();
+  return Eigen::Map<const Eigen::Matrix<XYZScalar<T>, 3, 1>>(&m.x);
+}
+
+/// Sets @out to the columns of the 3xN matrix @m, converting to the message's scalar type
+template <class T, class Alloc, class Derived>
+inline void assign_xyz(std::vector<T, Alloc>& out, Eigen::MatrixBase<Derived> const& m)
+{
+  static_assert(Derived::RowsAtCompileTime == 3 || Derived::RowsAtCompileTime == Eigen::Dynamic,
+                "assign_xyz needs a matrix of 3 rows");
+  eigen_assert(m.rows() == 3);
+  out.resize(m.cols());
+  xyz_map(out) = m.template cast<XYZScalar<T>>();
+}
+
+/// Views the row major covariance of a message (e.g. PoseWithCovariance, TwistWithCovariance, Imu or NavSatFix) as a
+/// matrix, without copying
+inline Eigen::Map<Eigen::Matrix<double, 6, 6, Eigen::RowMajor>> covariance_map(boost::array<double, 36>& c)
+{
+  return Eigen::Map<Eigen::Matrix<double, 6, 6, Eigen::RowMajor>>(c.data());
+}
+inline Eigen::Map<const Eigen::Matrix<double, 6, 6, Eigen::RowMajor>> covariance_map(boost::array<double, 36> const& c)
+{
+  return Eigen::Map<const Eigen::Matrix<double, 6, 6, Eigen::RowMajor>>(c.data());
+}
+inline Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> covariance_map(boost::array<double, 9>& c)
+{
+  return Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(c.data());
+}
+inline Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>> covariance_map(boost::array<double, 9> const& c)
+{
+  return Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(c.data());
+}
 }
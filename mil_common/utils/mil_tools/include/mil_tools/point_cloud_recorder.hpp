@@ -0,0 +1,44 @@
+#pragma once
+
+#include <mil_msgs/CompressedPointCloud2.h>
+#include <mil_tools/point_cloud_codec.hpp>
+#include <mil_tools/topic_recorder.hpp>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <string>
+
+namespace mil_tools
+{
+/*
+TopicRecorder of point clouds that records them compressed, as mil_msgs/CompressedPointCloud2 on
+<record_topic>/compressed, at a fifth to a tenth of their size (see mil_tools/point_cloud_codec.hpp).
+decode_point_cloud gives the clouds back.
+
+Clouds are compressed where they are written, so with async_write the subscriber's callbacks only queue them and
+compressing takes the writer thread's time instead.
+
+ros params, besides TopicRecorder's:
+  resolution: step x, y and z are quantized to, m (0.001)
+  field_resolutions: steps of other fields to quantize, by name, e.g. {time: 1.0e-6}, else they are kept exactly
+  block_size: points compressed together (8192)
+  reorder: put points in octree order, for clouds whose order does not matter like PCODAR's persistent cloud (false)
+  encode_threads: threads a cloud is compressed on, 0 for one per core (0)
+*/
+class PointCloudRecorder : public TopicRecorder<sensor_msgs::PointCloud2>
+{
+public:
+  PointCloudRecorder(ros::NodeHandle* _nh);
+  ~PointCloudRecorder();
+
+protected:
+  void WriteToBag(const ros::Time& _time, const sensor_msgs::PointCloud2& _msg) override;
+
+private:
+  static PointCloudEncoder::Params LoadParams(ros::NodeHandle* _nh);
+
+  PointCloudEncoder encoder_;
+  // Reused between clouds, only touched where they are written
+  mil_msgs::CompressedPointCloud2 compressed_;
+  std::string compressed_topic_;
+};
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <ros/ros.h>
+
+#include <cstdint>
+#include <string>
+
+namespace mil_tools
+{
+/*
+Raw captures are the bytes a driver read, in the chunks it read them, each with the time its read finished. The file is
+the 8 byte magic "MILRAW01" and then one record per read: the ROS time's seconds and nanoseconds and the number of bytes
+as uint32s in host byte order, followed by the bytes. A record of no bytes ends the file early, as the zeros after the
+last record of a capture that was not closed do.
+*/
+
+/// Which capture to write, or replay instead of reading the device, from ~capture_file, ~replay_file, ~replay_speed
+struct RawCaptureOptions
+{
+  std::string capture_file;  // empty to not capture
+  std::string replay_file;   // empty to read the device
+  double replay_speed = 1;   // times the rate bytes were captured at, or 0 for as fast as they are consumed
+
+  static RawCaptureOptions from_params(const ros::NodeHandle& private_nh);
+};
+
+/// Appends records to a capture through a memory map, growing the file a chunk at a time
+class RawCaptureWriter
+{
+public:
+  /// Truncates or creates the file, throwing std::runtime_error if it can not
+  explicit RawCaptureWriter(const std::string& path);
+  /// Trims the file to the records written
+  ~RawCaptureWriter();
+  RawCaptureWriter(const RawCaptureWriter&) = delete;
+  RawCaptureWriter& operator=(const RawCaptureWriter&) = delete;
+
+  /// Appends bytes read at stamp, throwing std::runtime_error if the file can not grow
+  void append(const ros::Time& stamp, const uint8_t* data, size_t size);
+
+  const std::string& path() const
+  {
+    return path_;
+  }
+
+private:
+  void grow(size_t size);
+
+  std::string path_;
+  int fd_ = -1;
+  uint8_t* map_ = nullptr;
+  size_t mapped_ = 0;
+  size_t size_ = 0;
+};
+
+/// Reads the records of a capture in place, from a read only memory map
+class RawCaptureReader
+{
+public:
+  struct Record
+  {
+    ros::Time stamp;
+    const uint8_t* data;  // valid while the reader is
+    size_t size;
+  };
+
+  /// Maps the file, throwing std::runtime_error if it can not or it is not a capture
+  explicit RawCaptureReader(const std::string& path);
+  ~RawCaptureReader();
+  RawCaptureReader(const RawCaptureReader&) = delete;
+  RawCaptureReader& operator=(const RawCaptureReader&) = delete;
+
+  /// The next record, or false at the end of the capture, including a record cut short
+  bool next(Record& record);
+  /// Starts over from the first record
+  void rewind();
+
+private:
+  const uint8_t* map_ = nullptr;
+  size_t size_ = 0;
+  size_t offset_ = 0;
+};
+
+/*
+Plays a capture back as a stream of bytes, paced by the stamps of its records. Records larger than a caller's buffer are
+handed out over several reads, each with the record's stamp.
+*/
+class RawCaptureReplay
+{
+public:
+  /// @param speed times the rate the bytes were captured at, or 0 to have every read due immediately
+  RawCaptureReplay(const std::string& path, double speed);
+
+  /// Wall time the next bytes are due, or false at the end of the capture
+  bool next_due(ros::WallTime& due);
+  /// Copies up to size of the next bytes to data, returning how many and setting stamp to when they were captured
+  size_t read(uint8_t* data, size_t size, ros::Time& stamp);
+
+private:
+  RawCaptureReader reader_;
+  double speed_;
+  bool started_ = false;
+  ros::Time start_stamp_;
+  ros::WallTime start_wall_;
+  bool has_record_ = false;
+  RawCaptureReader::Record record_;
+  size_t record_offset_ = 0;
+};
+
+}  // namespace mil_tools
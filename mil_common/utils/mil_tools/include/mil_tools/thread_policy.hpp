@@ -0,0 +1,91 @@
+#pragma once
+
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mil_tools
+{
+/*
+Scheduling for threads that have to wake up on time, such as driver I/O and control loops, so they are not held up
+by perception nodes sharing their cores. Read from params under a name, all optional:
+
+  <name>/priority:    SCHED_FIFO priority, 1 to 99, or 0 to stay at the default SCHED_OTHER
+  <name>/cpus:        cores the thread may run on, e.g. [2, 3], or empty for any
+  <name>/lock_memory: lock every page of the process in memory, so page faults can not stall it
+
+  mil_tools::ThreadPolicy policy = mil_tools::ThreadPolicy::from_params(private_nh, "thread_policy");
+  std::thread worker([policy] {
+    policy.apply("worker");
+    ...
+  });
+
+SCHED_FIFO needs CAP_SYS_NICE or an rtprio limit, and locking memory CAP_IPC_LOCK or a memlock limit, e.g. from
+/etc/security/limits.conf. Without them apply warns and the thread carries on as it was. Locking memory applies to
+the whole process, not just the thread.
+
+To see the effect, compare the latency a node reports on diagnostics, such as a timer's from its expected time or a
+serial port's from a frame arriving to it being handled, with and without the policy.
+*/
+struct ThreadPolicy
+{
+  int priority = 0;
+  std::vector<int> cpus;
+  bool lock_memory = false;
+
+  static ThreadPolicy from_params(const ros::NodeHandle& nh, const std::string& name);
+
+  /// True if the policy leaves the thread as it is
+  bool empty() const
+  {
+    return priority <= 0 && cpus.empty() && !lock_memory;
+  }
+
+  /// Applies the policy to the calling thread, warning with the thread's name and returning false for any part that
+  /// could not be applied
+  bool apply(const std::string& thread) const;
+
+  /// e.g. "SCHED_FIFO 80 on cpus 2 3, memory locked"
+  std::string describe() const;
+};
+
+/*
+A thread of its own that calls the callbacks of its queue under a ThreadPolicy, for a nodelet whose callbacks have to
+run on time rather than take their turn on the manager's workers. Give the queue to the node handles the nodelet
+subscribes and creates timers with:
+
+  thread_.reset(new mil_tools::CallbackThread(getName(), policy));
+  nh.setCallbackQueue(thread_->queue());
+
+Callbacks of the one queue are called in order on the one thread, as a nodelet's are by default. Stop the thread
+before destroying what its callbacks use, and only destroy it once nothing subscribed with its queue is left.
+*/
+class CallbackThread
+{
+public:
+  CallbackThread(const std::string& name, const ThreadPolicy& policy);
+  ~CallbackThread();
+  CallbackThread(const CallbackThread&) = delete;
+  CallbackThread& operator=(const CallbackThread&) = delete;
+
+  ros::CallbackQueue* queue()
+  {
+    return &queue_;
+  }
+
+  /// Waits for the callback being called, if any, and calls no more
+  void stop();
+
+private:
+  void run(const std::string& name, const ThreadPolicy& policy);
+
+  ros::CallbackQueue queue_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+};
+
+}  // namespace mil_tools
@@ -8,14 +8,35 @@
 #include <rosbag/view.h>
 #include <std_srvs/SetBool.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
 namespace mil_tools
 {
-/*Utility that publishes the contents of a bag assuming that bag has ONE topic recorded on it.*/
+/*Utility that publishes the contents of a bag assuming that bag has ONE topic recorded on it.
+
+Messages are published at the times they were recorded at, each against an absolute wall clock deadline from the
+start of playback so sleep and publish times do not accumulate, on a thread of its own. Another thread reads ahead
+of it, so reading and decompressing chunks of the bag is off the timed path.
+
+ros params (on the node handle passed in):
+  play_topic, file_name: required
+  rate: multiple of the recorded rate to play at, 0 for as fast as possible (1)
+  start_time: seconds into the bag to start playing from, found through the bag's index (0)
+  read_ahead: messages read ahead of playback (100)
+*/
 template <class MSG>
 class TopicPlayer
 {
 public:
   TopicPlayer(ros::NodeHandle* _nh);
+  virtual ~TopicPlayer();
   virtual bool Enable(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res);
 
 protected:
@@ -29,8 +50,28 @@ protected:
   ros::ServiceServer enable_service_;
 
   ros::Timer start_timer_;
+  // Starts the playback threads
   virtual void Play(const ros::TimerEvent& event);
   ros::Publisher pub_;
+
+private:
+  // Stops the playback threads and closes the bag
+  void Stop();
+  void ReadLoop();
+  void PlayLoop();
+
+  double rate_ = 1.;
+  double start_time_ = 0.;
+  size_t read_ahead_ = 100;
+
+  std::atomic<bool> playing_{ false };
+  std::thread reader_thread_;
+  std::thread player_thread_;
+  // Messages read ahead, with the times they were recorded at
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cv_;
+  std::deque<std::pair<ros::Time, boost::shared_ptr<MSG>>> queue_;
+  bool read_done_ = false;
 };
 }
 
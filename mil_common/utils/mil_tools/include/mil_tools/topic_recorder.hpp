@@ -7,6 +7,16 @@
 #include <rosbag/bag.h>
 #include <std_srvs/SetBool.h>
 
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
 namespace mil_tools
 {
 /*
@@ -21,6 +31,17 @@ ie:
   time:record every so many seconds(periodic) or location: every 1 m change in location(spacial).
 
 see indyav_path path_recorder.cpp for an implemenation example
+
+ros params (on the node handle passed in):
+  file_name, record_topic: required
+  async_write: write from a dedicated thread, fed by a lock free queue, so disk stalls never block the
+    subscriber's callbacks (false). Messages are dropped when the queue is full. The subscriber's callbacks
+    must all run on one thread, as the queue has a single producer.
+  write_queue_size: messages the async queue holds (1000)
+  compression: none, lz4 or bz2 chunk compression (none)
+  chunk_size: bytes of messages per bag chunk (768 KB, as rosbag)
+
+The Enable service's response message reports the messages written, dropped and still queued.
 */
 
 template <class MSG>
@@ -28,10 +49,20 @@ class TopicRecorder
 {
 public:
   TopicRecorder(ros::NodeHandle* _nh);
+  virtual ~TopicRecorder();
   virtual void CallBack(const MSG& _msg);
   virtual bool Enable(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res);
 
 protected:
+  // Records a message, on the writer thread if async_write, else right away
+  void Write(const ros::Time& _time, const MSG& _msg);
+  // Writes a message to the bag, on the writer thread if async_write. Override to record something in its place,
+  // such as a compressed copy, without holding up the subscriber's callbacks.
+  virtual void WriteToBag(const ros::Time& _time, const MSG& _msg);
+  // Waits for the writer thread to write everything queued. A subclass overriding WriteToBag must call it in its
+  // destructor, as the writer thread would otherwise call WriteToBag on what is left of it.
+  void StopWriter();
+
   ros::NodeHandle* nh_;
 
   ros::Subscriber sub_;
@@ -46,6 +77,26 @@ protected:
 
   bool enabled_ = false;
   rosbag::Bag bag_;
+
+private:
+  struct Entry
+  {
+    ros::Time time;
+    MSG msg;
+  };
+
+  void OpenBag();
+  void StartWriter();
+  void WriterLoop();
+
+  bool async_ = false;
+  std::unique_ptr<boost::lockfree::spsc_queue<Entry>> queue_;
+  std::thread writer_thread_;
+  std::atomic<bool> writing_{ false };
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::atomic<uint64_t> written_{ 0 };
+  std::atomic<uint64_t> dropped_{ 0 };
 };
 }
 #include "../../src/mil_tools/topic_recorder.cpp"
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <ros/ros.h>
+#include <std_srvs/Trigger.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mil_tools
+{
+/*
+Latency tracing from sensor data to actuation, across nodes.
+
+Every piece of work a node does on behalf of some sensor data is a span: what it was, when it ran, and the origin
+stamp of the sensor data behind it. The origin stamp is also the span's trace id, so the spans of every node working
+on the same scan or sample line up as one trace. Nodes pass the origin on with their output, in its header stamp or
+as the map_load_time of an ogrid.
+
+Spans go into a fixed size ring buffer, overwriting the oldest, at the cost of an atomic increment and a copy, and of
+a load when tracing is off. Each process writes its spans in Chrome trace format (chrome://tracing, ui.perfetto.dev)
+when the dump_trace service of the node handle given to Tracer::configure is called. Spans are placed by wall time
+and each process is its own row, so the files of every node, merged with mil_tools' merge_traces, show every hop of a
+trace, with the age of its data when each started.
+
+  mil_tools::Tracer::instance().configure(private_nh);
+  ...
+  void cloud_cb(sensor_msgs::PointCloud2ConstPtr const& cloud)
+  {
+    mil_tools::TraceSpan span("pcodar.ingest", cloud->header.stamp);
+    ...
+  }
+
+Params, relative to the node handle:
+  trace_enabled: whether spans are recorded (false)
+  trace_capacity: spans kept, rounded up to a power of two (65536)
+  trace_file: where dump_trace writes, or /tmp/mil_trace_<node name>_<pid>.json if empty ("")
+*/
+class Tracer
+{
+public:
+  // Never destroyed, so spans can be recorded from any thread until the process exits
+  static Tracer &instance();
+
+  // Reads the params and advertises dump_trace. Only the first call in a process does anything.
+  void configure(ros::NodeHandle nh);
+
+  bool enabled() const
+  {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // Records a span. name must outlive the tracer, like a string literal.
+  void record(char const *name, ros::Time const &origin, ros::WallTime const &start, ros::WallTime const &end,
+              ros::Time const &start_ros);
+
+  // Writes the spans in the buffer in Chrome trace format, returning false with error set if it could not
+  bool write(std::string const &path, std::string &error) const;
+
+  // Spans recorded since tracing was enabled, including those overwritten
+  uint64_t recorded() const
+  {
+    return next_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Span
+  {
+    // Index + 1 of the span in the slot once it is written, or 0 while it is being written
+    std::atomic<uint64_t> sequence{ 0 };
+    char const *name;
+    int64_t origin;  // ros::Time ns
+    int64_t start;   // ros::WallTime ns
+    int64_t end;
+    int64_t age;  // ros::Time ns from origin to the start
+    int32_t thread;
+  };
+
+  Tracer() = default;
+  bool dump_cb(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res);
+
+  std::atomic<bool> enabled_{ false };
+  std::atomic<bool> configured_{ false };
+  std::unique_ptr<Span[]> spans_;
+  size_t mask_ = 0;
+  std::atomic<uint64_t> next_{ 0 };
+  std::string file_;
+  ros::ServiceServer dump_service_;
+};
+
+// Records the span from its construction to its destruction with the given origin, if tracing is enabled
+class TraceSpan
+{
+public:
+  TraceSpan(char const *name, ros::Time const &origin)
+    : name_(name), origin_(origin), active_(Tracer::instance().enabled())
+  {
+    if (active_)
+    {
+      start_ = ros::WallTime::now();
+      start_ros_ = ros::Time::now();
+    }
+  }
+  ~TraceSpan()
+  {
+    if (active_)
+      Tracer::instance().record(name_, origin_, start_, ros::WallTime::now(), start_ros_);
+  }
+  TraceSpan(TraceSpan const &) = delete;
+  TraceSpan &operator=(TraceSpan const &) = delete;
+
+  // For when which data the work is for is only known part way through it
+  void set_origin(ros::Time const &origin)
+  {
+    origin_ = origin;
+  }
+
+private:
+  char const *name_;
+  ros::Time origin_;
+  bool active_;
+  ros::WallTime start_;
+  ros::Time start_ros_;
+};
+}  // namespace mil_tools
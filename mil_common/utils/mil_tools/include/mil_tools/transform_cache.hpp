@@ -0,0 +1,112 @@
+#pragma once
+
+#include <ros/ros.h>
+#include <tf2_ros/buffer.h>
+
+#include <Eigen/Geometry>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mil_tools
+{
+/*
+TF lookups for hot callbacks, on messages from sensors bolted to the robot.
+
+The transform from such a sensor's frame to a fixed frame is the pose of the robot, which changes with every odom
+message, composed with where the sensor is mounted on the robot, which never does. For each frame added with
+addMount, TransformCache looks the mounting up once and keeps it, so every lookup from that frame only asks tf for
+the pose of the robot. Other frames are looked up in full every time.
+
+For points measured over an interval, such as a spinning lidar's sweep or a sonar ping, lookupInterval only looks
+up the robot's pose at both ends, and TransformInterval interpolates between them for each point's own stamp.
+
+Every lookup is timed, so stats() gives how many were made, how many failed and how long they took.
+
+  mil_tools::TransformCache tf_cache(tf_buffer, "base_link");
+  tf_cache.addMount("velodyne");
+  ...
+  Eigen::Affine3d map_from_velodyne;
+  if (tf_cache.lookup("map", cloud->header.frame_id, cloud->header.stamp, map_from_velodyne))
+    ...
+
+Safe to use from several threads.
+*/
+
+// Transforms from one frame over an interval of time, for data measured at different times within it
+struct TransformInterval
+{
+  ros::Time start;
+  ros::Time end;
+  Eigen::Affine3d start_pose;  // target from body at start
+  Eigen::Affine3d end_pose;    // target from body at end
+  Eigen::Affine3d mounting;    // body from source
+
+  // Transform at a fraction of the way through the interval, clamped to [0, 1], interpolating the position linearly
+  // and the rotation spherically
+  Eigen::Affine3d at(double fraction) const;
+  Eigen::Affine3d at(ros::Time const &time) const;
+};
+
+class TransformCache
+{
+public:
+  struct Stats
+  {
+    uint64_t lookups = 0;        // asked of tf, mountings included
+    uint64_t failures = 0;       // of those, that had no transform
+    uint64_t mount_lookups = 0;  // mountings looked up, once per frame unless clear() was called
+    uint64_t mount_hits = 0;     // lookups that used a kept mounting rather than looking it up again
+    double mean_lookup_us = 0;
+    double max_lookup_us = 0;
+  };
+
+  // Frames are mounted on body_frame. buffer must outlive the cache.
+  TransformCache(tf2_ros::Buffer const &buffer, std::string const &body_frame);
+
+  std::string const &bodyFrame() const
+  {
+    return body_frame_;
+  }
+
+  // Declares that frame never moves relative to the body, so its mounting can be kept
+  void addMount(std::string const &frame);
+  bool isMount(std::string const &frame) const;
+
+  // Transform from source to target at time, waiting up to timeout for it. By default only transforms already in the
+  // buffer are used, so callbacks are never blocked on TF.
+  bool lookup(std::string const &target, std::string const &source, ros::Time const &time, Eigen::Affine3d &out,
+              ros::Duration const &timeout = ros::Duration(0));
+
+  // Transforms from source to target over [start, end], from two lookups of the body's pose. A source that is not a
+  // mount gets an identity mounting and the full transforms as its poses.
+  bool lookupInterval(std::string const &target, std::string const &source, ros::Time const &start,
+                      ros::Time const &end, TransformInterval &out, ros::Duration const &timeout = ros::Duration(0));
+
+  // Body from a mounted frame, looking it up only the first time
+  bool mounting(std::string const &frame, Eigen::Affine3d &out);
+
+  // Forgets every mounting, as after the robot's description changed. Mounts stay declared.
+  void clear();
+
+  Stats stats() const;
+
+private:
+  // A timed lookup in the buffer
+  bool lookupTf(std::string const &target, std::string const &source, ros::Time const &time,
+                ros::Duration const &timeout, Eigen::Affine3d &out);
+
+  tf2_ros::Buffer const &buffer_;
+  std::string body_frame_;
+
+  mutable std::mutex mutex_;
+  // Declared mounts, and their mounting once it was looked up
+  std::unordered_set<std::string> mounts_;
+  std::unordered_map<std::string, Eigen::Affine3d> mountings_;
+  Stats stats_;
+};
+
+}  // namespace mil_tools
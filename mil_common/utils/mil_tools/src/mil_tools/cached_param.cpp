@@ -0,0 +1,22 @@
+#include <mil_tools/cached_param.hpp>
+
+namespace mil_tools
+{
+ParamSet::ParamSet(ros::NodeHandle nh, ros::WallDuration refresh_period) : nh_(nh)
+{
+  if (!refresh_period.isZero())
+    timer_ = nh_.createWallTimer(refresh_period, &ParamSet::refreshCb, this);
+}
+
+void ParamSet::refresh()
+{
+  std::vector<CachedParamBase *> changed;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto const &param : params_)
+    if (param->refresh(nh_))
+      changed.push_back(param.get());
+  // After every value is updated, so callbacks see the set as a whole
+  for (auto *param : changed)
+    param->notify();
+}
+}  // namespace mil_tools
@@ -0,0 +1,259 @@
+#include <mil_tools/driver_diagnostics.hpp>
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <diagnostic_msgs/KeyValue.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace mil_tools
+{
+namespace
+{
+const double MIN_BUCKET = 1e-5;
+const double BUCKETS_PER_OCTAVE = 4;
+
+void add(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, const std::string& value)
+{
+  diagnostic_msgs::KeyValue key_value;
+  key_value.key = key;
+  key_value.value = value;
+  status.values.push_back(key_value);
+}
+
+void add(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, double value)
+{
+  add(status, key, std::to_string(value));
+}
+
+void add(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, uint64_t value)
+{
+  add(status, key, std::to_string(value));
+}
+}  // namespace
+
+DurationHistogram::DurationHistogram()
+{
+  clear();
+}
+
+void DurationHistogram::record(double seconds)
+{
+  size_t bucket = 0;
+  if (seconds >= MIN_BUCKET)
+    bucket = std::min<double>(BUCKETS - 1, 1 + std::floor(BUCKETS_PER_OCTAVE * std::log2(seconds / MIN_BUCKET)));
+  ++counts_[bucket];
+  ++count_;
+  sum_ += seconds;
+  sum_sq_ += seconds * seconds;
+  max_ = count_ == 1 ? seconds : std::max(max_, seconds);
+}
+
+double DurationHistogram::mean() const
+{
+  return count_ ? sum_ / count_ : 0;
+}
+
+double DurationHistogram::stddev() const
+{
+  if (!count_)
+    return 0;
+  double m = mean();
+  return std::sqrt(std::max(0., sum_sq_ / count_ - m * m));
+}
+
+double DurationHistogram::max() const
+{
+  return max_;
+}
+
+double DurationHistogram::percentile(double fraction) const
+{
+  if (!count_)
+    return 0;
+  uint64_t rank = std::max<uint64_t>(1, std::ceil(fraction * count_));
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < BUCKETS - 1; ++bucket)
+  {
+    seen += counts_[bucket];
+    if (seen >= rank)
+      return std::min(max_, MIN_BUCKET * std::exp2(bucket / BUCKETS_PER_OCTAVE));
+  }
+  return max_;
+}
+
+void DurationHistogram::clear()
+{
+  counts_.fill(0);
+  count_ = 0;
+  sum_ = sum_sq_ = max_ = 0;
+}
+
+StreamMonitor::StreamMonitor(bool sporadic) : sporadic_(sporadic)
+{
+}
+
+void StreamMonitor::published(const ros::Time& stamp)
+{
+  published(stamp, ros::Time::now());
+}
+
+void StreamMonitor::published(const ros::Time& stamp, const ros::Time& now)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  latency_.record((now - stamp).toSec());
+  if (!last_published_.isZero())
+    interval_.record((now - last_published_).toSec());
+  last_published_ = now;
+  ++messages_;
+}
+
+void StreamMonitor::dropped(uint64_t count)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  dropped_ += count;
+  period_dropped_ += count;
+}
+
+void StreamMonitor::errors(uint64_t count)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  errors_ += count;
+  period_errors_ += count;
+}
+
+void StreamMonitor::to_msg(diagnostic_msgs::DiagnosticStatus& status, double period)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t period_messages = latency_.count();
+  add(status, "rate (Hz)", period > 0 ? period_messages / period : 0.);
+  if (period_messages)
+  {
+    // From the data's stamp to its message being published
+    add(status, "latency mean (ms)", 1e3 * latency_.mean());
+    add(status, "latency p50 (ms)", 1e3 * latency_.percentile(0.5));
+    add(status, "latency p99 (ms)", 1e3 * latency_.percentile(0.99));
+    add(status, "latency max (ms)", 1e3 * latency_.max());
+  }
+  if (interval_.count())
+  {
+    // Between messages being published, its deviation being the jitter
+    add(status, "interval mean (ms)", 1e3 * interval_.mean());
+    add(status, "interval stddev (ms)", 1e3 * interval_.stddev());
+    add(status, "interval p99 (ms)", 1e3 * interval_.percentile(0.99));
+    add(status, "interval max (ms)", 1e3 * interval_.max());
+  }
+  add(status, "messages", messages_);
+  add(status, "dropped", dropped_);
+  add(status, "errors", errors_);
+
+  std::ostringstream message;
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  if (!period_messages && !sporadic_)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    message << "no messages";
+  }
+  if (period_dropped_ || period_errors_)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    message << (message.tellp() ? ", " : "") << period_dropped_ << " dropped, " << period_errors_ << " errors";
+  }
+  status.message = status.level == diagnostic_msgs::DiagnosticStatus::OK ? "ok" : message.str();
+
+  latency_.clear();
+  interval_.clear();
+  period_dropped_ = period_errors_ = 0;
+}
+
+DriverDiagnostics::DriverDiagnostics(ros::NodeHandle nh, ros::NodeHandle private_nh, const std::string& name,
+                                     const std::string& hardware_id)
+  : name_(name), hardware_id_(hardware_id)
+{
+  double period = private_nh.param<double>("diagnostics_period", 1.);
+  pub_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+  last_publish_ = ros::Time::now();
+  timer_ = nh.createTimer(ros::Duration(period), &DriverDiagnostics::publish, this);
+}
+
+StreamMonitor& DriverDiagnostics::stream(const std::string& name, bool sporadic)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<StreamMonitor>& monitor = streams_[name];
+  if (!monitor)
+    monitor.reset(new StreamMonitor(sporadic));
+  return *monitor;
+}
+
+void DriverDiagnostics::add_status(const std::string& name, StatusFiller fill)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  statuses_.push_back(std::make_pair(name, std::move(fill)));
+}
+
+void DriverDiagnostics::publish(const ros::TimerEvent&)
+{
+  ros::Time now = ros::Time::now();
+  double period = (now - last_publish_).toSec();
+  last_publish_ = now;
+
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = now;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& stream : streams_)
+    {
+      diagnostic_msgs::DiagnosticStatus status;
+      status.name = name_ + ": " + stream.first;
+      status.hardware_id = hardware_id_;
+      stream.second->to_msg(status, period);
+      msg.status.push_back(status);
+    }
+    for (auto& filler : statuses_)
+    {
+      diagnostic_msgs::DiagnosticStatus status;
+      status.name = name_ + ": " + filler.first;
+      status.hardware_id = hardware_id_;
+      status.level = diagnostic_msgs::DiagnosticStatus::OK;
+      status.message = "ok";
+      filler.second(status);
+      msg.status.push_back(status);
+    }
+  }
+  pub_.publish(msg);
+}
+
+DriverDiagnostics::StatusFiller serial_port_status(std::function<FramedSerialPort::Stats()> stats)
+{
+  std::shared_ptr<FramedSerialPort::Stats> last = std::make_shared<FramedSerialPort::Stats>();
+  return [stats, last](diagnostic_msgs::DiagnosticStatus& status) {
+    FramedSerialPort::Stats now = stats();
+    add(status, "bytes", now.bytes);
+    add(status, "frames", now.frames);
+    add(status, "parse errors", now.parse_errors);
+    add(status, "read errors", now.read_errors);
+    add(status, "open errors", now.open_errors);
+    // From each frame's first byte arriving to it being framed
+    add(status, "framing latency mean (ms)", 1e3 * now.mean_latency);
+    add(status, "framing latency max (ms)", 1e3 * now.max_latency);
+    if (now.open_errors > last->open_errors || now.read_errors > last->read_errors)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+      status.message = "port failed and is being reopened";
+    }
+    else if (now.parse_errors > last->parse_errors)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = std::to_string(now.parse_errors - last->parse_errors) + " parse errors";
+    }
+    else if (now.bytes == last->bytes)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "no bytes received";
+    }
+    *last = now;
+  };
+}
+
+}  // namespace mil_tools
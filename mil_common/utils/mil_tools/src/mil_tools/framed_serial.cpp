@@ -0,0 +1,491 @@
+#include <mil_tools/framed_serial.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/serial_port.hpp>
+#include <boost/asio/write.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace mil_tools
+{
+namespace
+{
+// Start, data, stop bits of each byte on the wire
+const int BITS_PER_BYTE = 10;
+
+// Runs the io_service of every FramedSerialPort in the process on one thread, for as long as there are any
+class IoThread
+{
+public:
+  static std::shared_ptr<IoThread> get()
+  {
+    static std::mutex mutex;
+    static std::weak_ptr<IoThread> instance;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<IoThread> thread = instance.lock();
+    if (!thread)
+    {
+      thread.reset(new IoThread());
+      instance = thread;
+    }
+    return thread;
+  }
+
+  ~IoThread()
+  {
+    work_.reset();
+    io.stop();
+    thread_.join();
+  }
+
+  /// Runs f on the thread and waits for it to finish
+  void run_and_wait(const std::function<void()>& f)
+  {
+    std::promise<void> done;
+    io.post([&f, &done]() {
+      f();
+      done.set_value();
+    });
+    done.get_future().wait();
+  }
+
+  boost::asio::io_service io;
+
+private:
+  IoThread() : work_(new boost::asio::io_service::work(io)), thread_([this]() { io.run(); })
+  {
+  }
+
+  std::unique_ptr<boost::asio::io_service::work> work_;
+  std::thread thread_;
+};
+}  // namespace
+
+// Everything but the constructor and stats() runs on the I/O thread. The handlers of pending operations hold a
+// shared_ptr to it, so it lives until they are done.
+class FramedSerialPort::Impl : public std::enable_shared_from_this<FramedSerialPort::Impl>
+{
+public:
+  Impl(const std::string& port, int baudrate, std::unique_ptr<FrameParser> parser, Handler handler,
+       size_t max_frame_size, const RawCaptureOptions& capture)
+    : io_thread(IoThread::get())
+    , port_(port)
+    , baudrate_(baudrate)
+    , parser_(std::move(parser))
+    , handler_(std::move(handler))
+    , max_frame_size_(max_frame_size)
+    , serial_(io_thread->io)
+    , descriptor_(io_thread->io)
+    , timer_(io_thread->io)
+    , buffer_(2 * max_frame_size)
+    , replay_file_(capture.replay_file)
+    , replay_speed_(capture.replay_speed)
+  {
+    if (!capture.capture_file.empty() && replay_file_.empty())
+    {
+      try
+      {
+        capture_.reset(new RawCaptureWriter(capture.capture_file));
+      }
+      catch (const std::exception& e)
+      {
+        ROS_ERROR("not capturing %s: %s", port_.c_str(), e.what());
+      }
+    }
+  }
+
+  void open()
+  {
+    if (closed_)
+      return;
+    head_ = tail_ = 0;
+    base_ = 0;
+    arrivals_.clear();
+    parser_->reset();
+
+    if (!replay_file_.empty())
+    {
+      open_replay();
+      return;
+    }
+
+    boost::system::error_code error;
+    if (baudrate_ > 0)
+    {
+      serial_.open(port_, error);
+      if (!error)
+        serial_.set_option(boost::asio::serial_port::baud_rate(baudrate_), error);
+    }
+    else
+    {
+      // Opened for writing too, so a FIFO is never at its end while nothing writes to it
+      int fd = ::open(port_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+      if (fd < 0)
+        error = boost::system::error_code(errno, boost::system::system_category());
+      else if (descriptor_.assign(fd, error))
+        ::close(fd);
+    }
+    if (error)
+    {
+      ROS_ERROR_THROTTLE(1, "error on open(%s): %s; reopening after delay", port_.c_str(), error.message().c_str());
+      close_port();
+      reopen_after_delay();
+      return;
+    }
+    open_ = true;
+    start_read();
+  }
+
+  void close()
+  {
+    closed_ = true;
+    boost::system::error_code ignored;
+    timer_.cancel(ignored);
+    close_port();
+  }
+
+  void write(const std::shared_ptr<std::vector<uint8_t> >& bytes)
+  {
+    if (!open_ || bytes->empty())
+      return;
+    writes_.push_back(bytes);
+    if (writes_.size() == 1)
+      start_write();
+  }
+
+  FramedSerialPort::Stats stats() const
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+  }
+
+  std::shared_ptr<IoThread> io_thread;
+
+private:
+  void reopen_after_delay()
+  {
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      ++stats_.open_errors;
+    }
+    std::shared_ptr<Impl> self = shared_from_this();
+    timer_.expires_from_now(boost::posix_time::seconds(1));
+    timer_.async_wait([self](const boost::system::error_code& e) {
+      if (!e)
+        self->open();
+    });
+  }
+
+  // Replays the capture in place of the port, leaving open_ unset so writes are dropped
+  void open_replay()
+  {
+    try
+    {
+      replay_.reset(new RawCaptureReplay(replay_file_, replay_speed_));
+    }
+    catch (const std::exception& e)
+    {
+      ROS_ERROR_THROTTLE(1, "error replaying %s in place of %s: %s; retrying after delay", replay_file_.c_str(),
+                         port_.c_str(), e.what());
+      reopen_after_delay();
+      return;
+    }
+    ROS_INFO("replaying %s in place of %s", replay_file_.c_str(), port_.c_str());
+    schedule_replay();
+  }
+
+  void schedule_replay()
+  {
+    ros::WallTime due;
+    if (!replay_->next_due(due))
+    {
+      ROS_INFO("finished replaying %s", replay_file_.c_str());
+      replay_.reset();
+      return;
+    }
+    // Even when it is due now, it waits its turn on the I/O thread behind the other ports
+    int64_t wait_us = std::max<int64_t>(0, (due - ros::WallTime::now()).toNSec() / 1000);
+    std::shared_ptr<Impl> self = shared_from_this();
+    timer_.expires_from_now(boost::posix_time::microseconds(wait_us));
+    timer_.async_wait([self](const boost::system::error_code& e) {
+      if (!e && !self->closed_)
+        self->replay_read();
+    });
+  }
+
+  void replay_read()
+  {
+    make_room();
+    ros::Time stamp;
+    size_t bytes_read = replay_->read(buffer_.data() + tail_, buffer_.size() - tail_, stamp);
+    received(bytes_read, stamp);
+    schedule_replay();
+  }
+
+  void close_port()
+  {
+    open_ = false;
+    writes_.clear();
+    boost::system::error_code ignored;
+    if (serial_.is_open())
+      serial_.close(ignored);
+    if (descriptor_.is_open())
+      descriptor_.close(ignored);
+  }
+
+  // Room for the largest frame after the bytes not parsed yet
+  void make_room()
+  {
+    if (buffer_.size() - tail_ < max_frame_size_)
+    {
+      std::memmove(buffer_.data(), buffer_.data() + head_, tail_ - head_);
+      base_ += head_;
+      tail_ -= head_;
+      head_ = 0;
+    }
+  }
+
+  void start_read()
+  {
+    make_room();
+
+    std::shared_ptr<Impl> self = shared_from_this();
+    auto handler = [self](const boost::system::error_code& error, size_t bytes_read) {
+      self->on_read(error, bytes_read);
+    };
+    auto buffer = boost::asio::buffer(buffer_.data() + tail_, buffer_.size() - tail_);
+    if (baudrate_ > 0)
+      serial_.async_read_some(buffer, handler);
+    else
+      descriptor_.async_read_some(buffer, handler);
+  }
+
+  void on_read(const boost::system::error_code& error, size_t bytes_read)
+  {
+    ros::Time now = ros::Time::now();
+    if (closed_ || error == boost::asio::error::operation_aborted)
+      return;
+    if (error)
+    {
+      ROS_ERROR_THROTTLE(1, "error on read(%s): %s; reopening", port_.c_str(), error.message().c_str());
+      {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        ++stats_.read_errors;
+      }
+      close_port();
+      open();
+      return;
+    }
+
+    if (capture_)
+    {
+      try
+      {
+        capture_->append(now, buffer_.data() + tail_, bytes_read);
+      }
+      catch (const std::exception& e)
+      {
+        ROS_ERROR("stopped capturing %s: %s", port_.c_str(), e.what());
+        capture_.reset();
+      }
+    }
+    received(bytes_read, now);
+    start_read();
+  }
+
+  // Frames bytes_read more bytes, put after the unparsed ones by a read that finished at stamp
+  void received(size_t bytes_read, const ros::Time& stamp)
+  {
+    tail_ += bytes_read;
+    arrivals_.push_back(std::make_pair(base_ + tail_, stamp));
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      stats_.bytes += bytes_read;
+    }
+    dispatch_frames();
+  }
+
+  void dispatch_frames()
+  {
+    while (!closed_)
+    {
+      FrameParser::Match match;
+      bool found = parser_->parse(buffer_.data() + head_, buffer_.data() + tail_, match);
+      match.consumed = std::min(match.consumed, tail_ - head_);
+      if (!found && !match.consumed && tail_ - head_ == buffer_.size())
+      {
+        // There is no room to wait for the rest of a frame longer than max_frame_size
+        ++match.errors;
+        match.consumed = tail_ - head_;
+      }
+
+      SerialFrame frame;
+      if (found)
+      {
+        frame.data = match.data;
+        frame.size = match.size;
+        frame.offset = base_ + head_ + match.start;
+        frame.stamp = arrival_time(frame.offset);
+      }
+      head_ += match.consumed;
+      while (!arrivals_.empty() && arrivals_.front().first <= base_ + head_)
+        arrivals_.pop_front();
+      if (match.errors || found)
+      {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.parse_errors += match.errors;
+        // A replayed frame's stamp is from when it was captured, so its latency means nothing
+        if (found && replay_)
+          ++stats_.frames;
+        else if (found)
+        {
+          double latency = (ros::Time::now() - frame.stamp).toSec();
+          ++stats_.frames;
+          stats_.mean_latency += (latency - stats_.mean_latency) / stats_.frames;
+          stats_.max_latency = std::max(stats_.max_latency, latency);
+        }
+      }
+      if (!found)
+        return;
+
+      try
+      {
+        handler_(frame);
+      }
+      catch (const std::exception& e)
+      {
+        ROS_ERROR_THROTTLE(1, "error handling a frame from %s: %s", port_.c_str(), e.what());
+      }
+    }
+  }
+
+  // Time the byte at offset came in, from the time the read of it finished, less the time to send the bytes after it
+  // in the same read
+  ros::Time arrival_time(uint64_t offset) const
+  {
+    auto arrival = std::upper_bound(arrivals_.begin(), arrivals_.end(), offset,
+                                    [](uint64_t o, const std::pair<uint64_t, ros::Time>& a) { return o < a.first; });
+    if (arrival == arrivals_.end())  // can not happen while the parser stays in the bytes it was given
+      return arrivals_.back().second;
+    if (baudrate_ <= 0)
+      return arrival->second;
+    return arrival->second - ros::Duration(double((arrival->first - offset - 1) * BITS_PER_BYTE) / baudrate_);
+  }
+
+  void start_write()
+  {
+    std::shared_ptr<Impl> self = shared_from_this();
+    auto handler = [self](const boost::system::error_code& error, size_t) { self->on_write(error); };
+    auto buffer = boost::asio::buffer(*writes_.front());
+    if (baudrate_ > 0)
+      boost::asio::async_write(serial_, buffer, handler);
+    else
+      boost::asio::async_write(descriptor_, buffer, handler);
+  }
+
+  void on_write(const boost::system::error_code& error)
+  {
+    if (closed_ || error == boost::asio::error::operation_aborted || writes_.empty())
+      return;
+    if (error)
+    {
+      ROS_ERROR_THROTTLE(1, "error on write(%s): %s; dropping", port_.c_str(), error.message().c_str());
+      writes_.clear();
+      return;
+    }
+    writes_.pop_front();
+    if (!writes_.empty())
+      start_write();
+  }
+
+  const std::string port_;
+  const int baudrate_;
+  std::unique_ptr<FrameParser> parser_;
+  Handler handler_;
+  const size_t max_frame_size_;
+
+  boost::asio::serial_port serial_;
+  boost::asio::posix::stream_descriptor descriptor_;
+  boost::asio::deadline_timer timer_;
+  bool open_ = false;
+  bool closed_ = false;
+  std::deque<std::shared_ptr<std::vector<uint8_t> > > writes_;
+
+  // Bytes received and not consumed by the parser yet are buffer_[head_, tail_). That is bytes
+  // [base_ + head_, base_ + tail_) of the stream. Each read that put them there is kept in arrivals_ as the offset of
+  // its end and the time it finished, to stamp the frames by.
+  std::vector<uint8_t> buffer_;
+  size_t head_ = 0;
+  size_t tail_ = 0;
+  uint64_t base_ = 0;
+  std::deque<std::pair<uint64_t, ros::Time> > arrivals_;
+
+  // Every read is appended to capture_ if it is set. If replay_file_ is set, it is replayed instead of opening the port.
+  std::unique_ptr<RawCaptureWriter> capture_;
+  const std::string replay_file_;
+  const double replay_speed_;
+  std::unique_ptr<RawCaptureReplay> replay_;
+
+  mutable std::mutex stats_mutex_;
+  FramedSerialPort::Stats stats_;
+};
+
+const size_t FramedSerialPort::DEFAULT_MAX_FRAME_SIZE;
+
+FramedSerialPort::FramedSerialPort(const std::string& port, int baudrate, std::unique_ptr<FrameParser> parser,
+                                   Handler handler, size_t max_frame_size, const RawCaptureOptions& capture)
+  : impl_(std::make_shared<Impl>(port, baudrate, std::move(parser), std::move(handler), max_frame_size, capture))
+  , port_(port)
+{
+  std::shared_ptr<Impl> impl = impl_;
+  impl_->io_thread->io.post([impl]() { impl->open(); });
+}
+
+FramedSerialPort::~FramedSerialPort()
+{
+  std::shared_ptr<IoThread> io_thread = impl_->io_thread;
+  Impl* impl = impl_.get();
+  io_thread->run_and_wait([impl]() { impl->close(); });
+  // The handlers of the operations closing the port cancelled are queued, and let go of it once they have run
+  while (!impl_.unique())
+    io_thread->run_and_wait([]() {});
+  impl_.reset();
+}
+
+void FramedSerialPort::write(const std::vector<uint8_t>& bytes)
+{
+  std::shared_ptr<Impl> impl = impl_;
+  std::shared_ptr<std::vector<uint8_t> > copy = std::make_shared<std::vector<uint8_t> >(bytes);
+  impl_->io_thread->io.post([impl, copy]() { impl->write(copy); });
+}
+
+void FramedSerialPort::write(const std::string& bytes)
+{
+  write(std::vector<uint8_t>(bytes.begin(), bytes.end()));
+}
+
+bool FramedSerialPort::applyThreadPolicy(const ThreadPolicy& policy)
+{
+  bool ok = false;
+  impl_->io_thread->run_and_wait([&policy, &ok]() { ok = policy.apply("serial I/O thread"); });
+  return ok;
+}
+
+FramedSerialPort::Stats FramedSerialPort::stats() const
+{
+  return impl_->stats();
+}
+
+}  // namespace mil_tools
@@ -0,0 +1,95 @@
+#include <mil_tools/memory_budget.hpp>
+
+#include <diagnostic_msgs/KeyValue.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace mil_tools
+{
+namespace
+{
+const double MB = 1024. * 1024.;
+
+void add(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, const std::string& value)
+{
+  diagnostic_msgs::KeyValue key_value;
+  key_value.key = key;
+  key_value.value = value;
+  status.values.push_back(key_value);
+}
+
+std::string megabytes(size_t bytes)
+{
+  std::ostringstream out;
+  out.precision(1);
+  out << std::fixed << bytes / MB << " MB";
+  return out.str();
+}
+}  // namespace
+
+MemoryBudget::MemoryBudget(ros::NodeHandle nh) : nh_(nh)
+{
+}
+
+void MemoryBudget::add(const std::string& name, Counter bytes, Evictor evict)
+{
+  double limit_mb = nh_.param<double>("memory_limit_mb/" + name, 0.);
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffers_.push_back(Buffer{ name, std::move(bytes), std::move(evict), size_t(std::max(limit_mb, 0.) * MB), 0 });
+}
+
+void MemoryBudget::to_msg(diagnostic_msgs::DiagnosticStatus& status)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string over;
+  size_t total = 0;
+  for (Buffer& buffer : buffers_)
+  {
+    size_t bytes = buffer.bytes();
+    if (buffer.limit && bytes > buffer.limit)
+    {
+      over += (over.empty() ? "" : ", ") + buffer.name;
+      if (buffer.evict)
+      {
+        buffer.evict(buffer.limit);
+        ++buffer.evictions;
+        bytes = buffer.bytes();
+      }
+    }
+    total += bytes;
+    std::string value = megabytes(bytes);
+    if (buffer.limit)
+      value += " of " + megabytes(buffer.limit);
+    if (buffer.evictions)
+      value += ", evicted " + std::to_string(buffer.evictions) + " times";
+    add(status, buffer.name, value);
+  }
+  add(status, "buffers", megabytes(total));
+  add(status, "process resident", megabytes(resident_bytes()));
+
+  if (over.empty())
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "ok";
+    return;
+  }
+  status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+  status.message = "over soft limit: " + over;
+  ROS_WARN_THROTTLE(60., "Buffers over their memory limit, evicting: %s", over.c_str());
+}
+
+size_t MemoryBudget::resident_bytes()
+{
+  // Size and resident set of the process, in pages
+  std::ifstream statm("/proc/self/statm");
+  size_t size = 0, resident = 0;
+  if (!(statm >> size >> resident))
+    return 0;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+}  // namespace mil_tools
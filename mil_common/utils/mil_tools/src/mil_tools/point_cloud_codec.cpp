@@ -0,0 +1,781 @@
+#include <mil_tools/point_cloud_codec.hpp>
+
+#include <mil_tools/bit_stream.hpp>
+
+#include <sensor_msgs/PointField.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <thread>
+
+namespace mil_tools
+{
+namespace
+{
+const uint32_t MAX_RICE = 31;
+// Quotients from here on are escaped, and the residual written in full
+const uint32_t ESCAPE = 24;
+// Residuals coded with one Rice parameter
+const size_t RUN = 256;
+// Points are only predicted from the last point of their laser for rings below this
+const uint32_t MAX_RINGS = 4096;
+// Largest magnitude of a float coded as an integer
+const double MAX_INTEGER = 2147483000.;
+
+enum Mode
+{
+  EXACT = 0,
+  WHOLE = 1,
+  QUANTIZED = 2
+};
+
+enum Predictor
+{
+  NONE = 0,
+  PREVIOUS = 1,
+  NEIGHBOUR = 2,
+  REVOLUTION = 3,
+  NUM_PREDICTORS = 4
+};
+
+void write_residuals(BitWriter& writer, const uint32_t* residuals, size_t n)
+{
+  for (size_t start = 0; start < n; start += RUN)
+  {
+    const size_t end = std::min(n, start + RUN);
+    uint64_t sum = 0;
+    for (size_t i = start; i < end; ++i)
+      sum += residuals[i];
+    // The log of the mean residual, about the best parameter for the two sided geometric distribution of steps
+    const uint64_t mean = sum / (end - start);
+    uint32_t k = 0;
+    while (k < MAX_RICE && (uint64_t(2) << k) <= mean)
+      ++k;
+    writer.put(k, 5);
+    const uint32_t low = static_cast<uint32_t>((uint64_t(1) << k) - 1);
+    for (size_t i = start; i < end; ++i)
+    {
+      const uint32_t quotient = residuals[i] >> k;
+      if (quotient >= ESCAPE)
+      {
+        writer.put((1u << ESCAPE) - 1, ESCAPE);
+        writer.put(residuals[i], 32);
+        continue;
+      }
+      writer.put(((1u << quotient) - 1) << 1, quotient + 1);
+      writer.put(residuals[i] & low, k);
+    }
+  }
+}
+
+bool read_residuals(BitReader& reader, uint32_t* residuals, size_t n)
+{
+  for (size_t start = 0; start < n; start += RUN)
+  {
+    const size_t end = std::min(n, start + RUN);
+    uint32_t k;
+    if (!reader.get(5, k))
+      return false;
+    for (size_t i = start; i < end; ++i)
+    {
+      uint32_t quotient = 0, bit;
+      do
+      {
+        if (!reader.get(1, bit))
+          return false;
+      } while (bit && ++quotient < ESCAPE);
+      uint32_t value;
+      if (quotient == ESCAPE)
+      {
+        if (!reader.get(32, value))
+          return false;
+      }
+      else
+      {
+        if (!reader.get(k, value))
+          return false;
+        value |= static_cast<uint32_t>(uint64_t(quotient) << k);
+      }
+      residuals[i] = value;
+    }
+  }
+  return true;
+}
+
+inline uint32_t zigzag(uint32_t difference)
+{
+  const int32_t r = static_cast<int32_t>(difference);
+  return (static_cast<uint32_t>(r) << 1) ^ static_cast<uint32_t>(r >> 31);
+}
+
+inline uint32_t unzigzag(uint32_t u)
+{
+  return (u >> 1) ^ (0u - (u & 1));
+}
+
+inline float to_float(uint32_t bits)
+{
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+inline uint32_t to_bits(float f)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+// Up to 4 bytes of a field of a point
+struct Channel
+{
+  uint32_t offset;
+  uint32_t bytes;
+  bool is_signed;
+  // A float32 that can be coded as whole numbers or quantized
+  bool is_float;
+  // Quantized to this if above 0
+  float resolution;
+  // x, y or z, only coded for points with a position
+  bool position;
+};
+
+// The channels of a cloud's fields, with the ring's first, and the offsets of its x, y and z if it has them all as
+// float32s. Fields of 8 bytes are split into two channels of 4. Returns false if a field is not inside the point.
+struct Layout
+{
+  std::vector<Channel> channels;
+  bool ring = false;
+  bool positions = false;
+  uint32_t xyz[3];
+
+  bool make(const std::vector<sensor_msgs::PointField>& fields, uint32_t point_step, bool is_bigendian,
+            const std::vector<float>& resolutions)
+  {
+    static const uint32_t SIZES[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+    channels.clear();
+    ring = positions = false;
+    bool found[3] = { false, false, false };
+    for (size_t f = 0; f < fields.size(); ++f)
+    {
+      const sensor_msgs::PointField& field = fields[f];
+      if (field.datatype < sensor_msgs::PointField::INT8 || field.datatype > sensor_msgs::PointField::FLOAT64)
+        return false;
+      const uint32_t size = SIZES[field.datatype];
+      if (uint64_t(field.offset) + uint64_t(size) * field.count > point_step)
+        return false;
+      const bool is_float = field.datatype == sensor_msgs::PointField::FLOAT32 && !is_bigendian;
+      const float resolution = is_float && f < resolutions.size() ? resolutions[f] : 0.f;
+      const int axis = field.name == "x" ? 0 : field.name == "y" ? 1 : field.name == "z" ? 2 : -1;
+      const bool single = field.count == 1;
+      if (axis >= 0 && is_float && single)
+      {
+        found[axis] = true;
+        xyz[axis] = field.offset;
+      }
+      const bool is_ring = field.name == "ring" && single && !ring && field.datatype <= sensor_msgs::PointField::UINT32;
+      for (uint32_t element = 0; element < field.count; ++element)
+      {
+        const uint32_t offset = field.offset + element * size;
+        for (uint32_t word = 0; word < (size == 8 ? 2u : 1u); ++word)
+        {
+          Channel channel{ offset + 4 * word, std::min(size, 4u),
+                           field.datatype == sensor_msgs::PointField::INT8 ||
+                               field.datatype == sensor_msgs::PointField::INT16,
+                           is_float, resolution, axis >= 0 && is_float && single };
+          if (is_ring)
+            channels.insert(channels.begin(), channel);
+          else
+            channels.push_back(channel);
+        }
+      }
+      ring = ring || is_ring;
+    }
+    positions = found[0] && found[1] && found[2];
+    if (!positions)
+      for (Channel& channel : channels)
+        channel.position = false;
+    return true;
+  }
+};
+
+inline uint32_t load(const uint8_t* point, const Channel& channel)
+{
+  if (channel.bytes == 4)
+  {
+    uint32_t value;
+    std::memcpy(&value, point + channel.offset, 4);
+    return value;
+  }
+  if (channel.bytes == 2)
+  {
+    uint16_t value;
+    std::memcpy(&value, point + channel.offset, 2);
+    return channel.is_signed ? static_cast<uint32_t>(static_cast<int16_t>(value)) : value;
+  }
+  const uint8_t value = point[channel.offset];
+  return channel.is_signed ? static_cast<uint32_t>(static_cast<int8_t>(value)) : value;
+}
+
+inline void store(uint8_t* point, const Channel& channel, uint32_t value)
+{
+  if (channel.bytes == 4)
+  {
+    std::memcpy(point + channel.offset, &value, 4);
+  }
+  else if (channel.bytes == 2)
+  {
+    const uint16_t half = static_cast<uint16_t>(value);
+    std::memcpy(point + channel.offset, &half, 2);
+  }
+  else
+  {
+    point[channel.offset] = static_cast<uint8_t>(value);
+  }
+}
+
+inline bool has_position(const uint8_t* point, const Layout& layout)
+{
+  float xyz[3];
+  for (int axis = 0; axis < 3; ++axis)
+    std::memcpy(&xyz[axis], point + layout.xyz[axis], 4);
+  return std::isfinite(xyz[0]) && std::isfinite(xyz[1]) && std::isfinite(xyz[2]);
+}
+
+}  // namespace
+
+struct PointCloudEncoder::Scratch
+{
+  std::vector<uint32_t> rings, values, residuals, runs;
+  std::vector<uint8_t> valid;
+  // Index of each point among those with a position, or -1
+  std::vector<int32_t> position_index;
+  // The point each point is predicted from by each predictor, or -1 for none, for all points and for those with a
+  // position. Empty for a predictor that can not be used.
+  std::vector<int32_t> refs[NUM_PREDICTORS], position_refs[NUM_PREDICTORS];
+  // The last point of each ring
+  std::vector<int32_t> last, last_position;
+
+  /// Predictors of n points from the rings, with period points a revolution (0 for none) and row points a row (0
+  /// for an unorganized cloud). Only the ring's own channel is coded before its values are known, and it can not be
+  /// predicted from them, so it is given the rest.
+  void make_refs(size_t n, bool has_rings, uint32_t period, uint32_t row, size_t positions)
+  {
+    for (int p = 0; p < NUM_PREDICTORS; ++p)
+    {
+      refs[p].clear();
+      position_refs[p].clear();
+    }
+    refs[NONE].assign(n, -1);
+    refs[PREVIOUS].resize(n);
+    for (size_t i = 0; i < n; ++i)
+      refs[PREVIOUS][i] = static_cast<int32_t>(i) - 1;
+    if (period)
+    {
+      refs[REVOLUTION].resize(n);
+      for (size_t i = 0; i < n; ++i)
+        refs[REVOLUTION][i] = static_cast<int32_t>(i) - static_cast<int32_t>(i >= period ? period : 1);
+    }
+    position_refs[NONE].assign(positions, -1);
+    position_refs[PREVIOUS].resize(positions);
+    for (size_t j = 0; j < positions; ++j)
+      position_refs[PREVIOUS][j] = static_cast<int32_t>(j) - 1;
+
+    if (has_rings && period)
+    {
+      refs[NEIGHBOUR].resize(n);
+      position_refs[NEIGHBOUR].resize(positions);
+      last.assign(period, -1);
+      last_position.assign(period, -1);
+      for (size_t i = 0; i < n; ++i)
+      {
+        const uint32_t ring = rings[i];
+        const int32_t j = position_index.empty() ? -1 : position_index[i];
+        if (ring >= period)
+        {
+          refs[NEIGHBOUR][i] = static_cast<int32_t>(i) - 1;
+          if (j >= 0)
+            position_refs[NEIGHBOUR][j] = j - 1;
+          continue;
+        }
+        refs[NEIGHBOUR][i] = last[ring] >= 0 ? last[ring] : static_cast<int32_t>(i) - 1;
+        last[ring] = static_cast<int32_t>(i);
+        if (j >= 0)
+        {
+          position_refs[NEIGHBOUR][j] = last_position[ring] >= 0 ? last_position[ring] : j - 1;
+          last_position[ring] = j;
+        }
+      }
+    }
+    else if (row)
+    {
+      refs[NEIGHBOUR].resize(n);
+      position_refs[NEIGHBOUR].resize(positions);
+      for (size_t i = 0; i < n; ++i)
+      {
+        const int32_t above = static_cast<int32_t>(i >= row ? i - row : i - 1);
+        refs[NEIGHBOUR][i] = above;
+        const int32_t j = position_index.empty() ? -1 : position_index[i];
+        if (j >= 0)
+          position_refs[NEIGHBOUR][j] = above >= 0 && position_index[above] >= 0 ? position_index[above] : j - 1;
+      }
+    }
+  }
+};
+
+namespace
+{
+// A cloud being coded: the bytes of point i of a block are at data + offset(start + i)
+struct Source
+{
+  const uint8_t* data;
+  uint32_t width, point_step, row_step;
+  // Order points are coded in, or empty to keep theirs
+  const std::vector<uint32_t>* order;
+
+  const uint8_t* point(size_t i) const
+  {
+    const size_t index = order->empty() ? i : (*order)[i];
+    return data + (index / width) * row_step + (index % width) * point_step;
+  }
+};
+
+// Mode of a channel's values and them as integers, so they can be predicted
+uint32_t make_values(const Source& source, size_t start, const Channel& channel, const std::vector<uint8_t>& valid,
+                     size_t n, std::vector<uint32_t>& values)
+{
+  values.clear();
+  for (size_t i = 0; i < n; ++i)
+    if (!channel.position || valid[i])
+      values.push_back(load(source.point(start + i), channel));
+  if (!channel.is_float)
+    return EXACT;
+
+  if (channel.resolution > 0)
+  {
+    const double scale = 1. / channel.resolution;
+    bool fits = true;
+    for (uint32_t value : values)
+      fits = fits && std::abs(to_float(value) * scale) < MAX_INTEGER;
+    if (fits)
+    {
+      for (uint32_t& value : values)
+        value = static_cast<uint32_t>(static_cast<int32_t>(std::llrint(to_float(value) * scale)));
+      return QUANTIZED;
+    }
+  }
+
+  // Negative zero is not a whole number, so it comes back
+  bool whole = true;
+  for (uint32_t value : values)
+  {
+    const float f = to_float(value);
+    whole = whole && std::abs(f) < MAX_INTEGER && f == static_cast<float>(static_cast<int32_t>(f)) &&
+            value != 0x80000000u;
+  }
+  if (!whole)
+    return EXACT;
+  for (uint32_t& value : values)
+    value = static_cast<uint32_t>(static_cast<int32_t>(to_float(value)));
+  return WHOLE;
+}
+
+uint32_t from_value(uint32_t mode, const Channel& channel, uint32_t value)
+{
+  if (mode == WHOLE)
+    return to_bits(static_cast<float>(static_cast<int32_t>(value)));
+  if (mode == QUANTIZED)
+    return to_bits(static_cast<float>(static_cast<int32_t>(value) * static_cast<double>(channel.resolution)));
+  return value;
+}
+
+void encode_channel(BitWriter& writer, uint32_t mode, const std::vector<uint32_t>& values,
+                    const std::vector<int32_t>* refs, std::vector<uint32_t>& residuals)
+{
+  const size_t n = values.size();
+  // The predictor leaving the smallest residuals
+  uint32_t best = NONE;
+  uint64_t best_sum = std::numeric_limits<uint64_t>::max();
+  for (uint32_t p = 0; p < NUM_PREDICTORS; ++p)
+  {
+    if (refs[p].size() != n)
+      continue;
+    const int32_t* ref = refs[p].data();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+      sum += zigzag(values[i] - (ref[i] >= 0 ? values[ref[i]] : 0));
+    if (sum < best_sum)
+    {
+      best_sum = sum;
+      best = p;
+    }
+  }
+
+  residuals.resize(n);
+  const int32_t* ref = refs[best].data();
+  for (size_t i = 0; i < n; ++i)
+    residuals[i] = zigzag(values[i] - (ref[i] >= 0 ? values[ref[i]] : 0));
+  writer.put(mode, 2);
+  writer.put(best, 2);
+  write_residuals(writer, residuals.data(), n);
+}
+
+bool decode_channel(BitReader& reader, const std::vector<int32_t>* refs, size_t n, std::vector<uint32_t>& values,
+                    uint32_t& mode)
+{
+  uint32_t predictor;
+  if (!reader.get(2, mode) || mode > QUANTIZED || !reader.get(2, predictor) || refs[predictor].size() != n)
+    return false;
+  values.resize(n);
+  if (!read_residuals(reader, values.data(), n))
+    return false;
+  const int32_t* ref = refs[predictor].data();
+  for (size_t i = 0; i < n; ++i)
+    values[i] = unzigzag(values[i]) + (ref[i] >= 0 ? values[ref[i]] : 0);
+  return true;
+}
+
+void encode_block(const Source& source, const Layout& layout, size_t start, size_t n, uint32_t row,
+                  PointCloudEncoder::Scratch& scratch, std::vector<uint8_t>& out)
+{
+  out.clear();
+  BitWriter writer(out);
+
+  // A revolution of the lasers is as many points as there are rings
+  uint32_t period = 0;
+  if (layout.ring)
+  {
+    scratch.rings.resize(n);
+    uint32_t max_ring = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      scratch.rings[i] = load(source.point(start + i), layout.channels.front());
+      max_ring = std::max(max_ring, scratch.rings[i]);
+    }
+    period = max_ring < MAX_RINGS ? max_ring + 1 : 0;
+  }
+  writer.put(period, 16);
+
+  size_t positions = 0;
+  scratch.valid.assign(n, 1);
+  scratch.position_index.clear();
+  if (layout.positions)
+  {
+    scratch.position_index.resize(n);
+    scratch.runs.clear();
+    uint8_t run_valid = 1;
+    uint32_t run = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      const uint8_t valid = has_position(source.point(start + i), layout);
+      scratch.valid[i] = valid;
+      scratch.position_index[i] = valid ? static_cast<int32_t>(positions++) : -1;
+      if (valid != run_valid)
+      {
+        scratch.runs.push_back(run);
+        run_valid = valid;
+        run = 0;
+      }
+      ++run;
+    }
+    scratch.runs.push_back(run);
+    writer.put(positions != n, 1);
+    if (positions != n)
+    {
+      writer.put(static_cast<uint32_t>(scratch.runs.size()), 24);
+      write_residuals(writer, scratch.runs.data(), scratch.runs.size());
+    }
+  }
+  else
+  {
+    writer.put(0, 1);
+  }
+
+  // The ring is coded before the predictors which depend on it are known
+  scratch.make_refs(n, false, period, layout.ring ? 0 : row, positions);
+  for (size_t c = 0; c < layout.channels.size(); ++c)
+  {
+    if (c == 1 && layout.ring)
+      scratch.make_refs(n, true, period, row, positions);
+    const Channel& channel = layout.channels[c];
+    const uint32_t mode = make_values(source, start, channel, scratch.valid, n, scratch.values);
+    encode_channel(writer, mode, scratch.values, channel.position ? scratch.position_refs : scratch.refs,
+                   scratch.residuals);
+  }
+  writer.flush();
+}
+
+bool decode_block(const uint8_t* data, size_t size, const Layout& layout, uint8_t* out, uint32_t point_step,
+                  size_t n, uint32_t row, PointCloudEncoder::Scratch& scratch)
+{
+  BitReader reader(data, size);
+  uint32_t period, any_invalid;
+  if (!reader.get(16, period) || !reader.get(1, any_invalid))
+    return false;
+  scratch.valid.assign(n, 1);
+  scratch.position_index.clear();
+  size_t positions = layout.positions ? n : 0;
+  if (any_invalid)
+  {
+    uint32_t count;
+    if (!layout.positions || !reader.get(24, count) || count > n + 1)
+      return false;
+    scratch.runs.resize(count);
+    if (!read_residuals(reader, scratch.runs.data(), count))
+      return false;
+    size_t i = 0;
+    for (size_t r = 0; r < count; ++r)
+    {
+      if (scratch.runs[r] > n - i)
+        return false;
+      if (r % 2)
+        std::fill(scratch.valid.begin() + i, scratch.valid.begin() + i + scratch.runs[r], 0);
+      i += scratch.runs[r];
+    }
+    if (i != n)
+      return false;
+  }
+  if (layout.positions)
+  {
+    scratch.position_index.resize(n);
+    positions = 0;
+    for (size_t i = 0; i < n; ++i)
+      scratch.position_index[i] = scratch.valid[i] ? static_cast<int32_t>(positions++) : -1;
+  }
+
+  scratch.make_refs(n, false, period, layout.ring ? 0 : row, positions);
+  const uint32_t nan = to_bits(std::numeric_limits<float>::quiet_NaN());
+  for (size_t c = 0; c < layout.channels.size(); ++c)
+  {
+    if (c == 1 && layout.ring)
+      scratch.make_refs(n, true, period, row, positions);
+    const Channel& channel = layout.channels[c];
+    uint32_t mode;
+    if (!decode_channel(reader, channel.position ? scratch.position_refs : scratch.refs,
+                        channel.position ? positions : n, scratch.values, mode) ||
+        (mode != EXACT && !channel.is_float) || (mode == QUANTIZED && !(channel.resolution > 0)))
+      return false;
+    if (c == 0 && layout.ring)
+      scratch.rings = scratch.values;
+    for (size_t i = 0, j = 0; i < n; ++i)
+    {
+      uint8_t* point = out + i * point_step;
+      if (channel.position && !scratch.valid[i])
+        store(point, channel, nan);
+      else
+        store(point, channel, from_value(mode, channel, scratch.values[j++]));
+    }
+  }
+  return true;
+}
+
+// Runs work(thread, block) for every block, spread over threads threads
+void for_each_block(size_t blocks, size_t threads, const std::function<void(size_t, size_t)>& work)
+{
+  std::atomic<size_t> next(0);
+  auto worker = [&](size_t thread) {
+    for (size_t block; (block = next++) < blocks;)
+      work(thread, block);
+  };
+  std::vector<std::thread> workers;
+  for (size_t thread = 1; thread < threads; ++thread)
+    workers.emplace_back(worker, thread);
+  worker(0);
+  for (std::thread& thread : workers)
+    thread.join();
+}
+
+size_t thread_count(size_t threads, size_t blocks)
+{
+  if (!threads)
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  return std::max<size_t>(std::min(threads, blocks), 1);
+}
+
+// Points of a block, a whole number of rows of an organized cloud
+size_t block_points(size_t block_size, uint32_t row)
+{
+  block_size = std::max<size_t>(block_size, 1);
+  return row ? std::max<size_t>(block_size / row, 1) * row : block_size;
+}
+
+// Order of the points along a Morton curve through the cells of resolution they are in, with those without a
+// position last, so that points close to each other are mostly coded one after another
+void octree_order(const Source& source, const Layout& layout, size_t count, float resolution,
+                  std::vector<uint32_t>& order)
+{
+  std::vector<std::pair<uint64_t, uint32_t>> keys(count);
+  std::vector<int64_t> cells(3 * count);
+  int64_t min[3] = { std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max(),
+                     std::numeric_limits<int64_t>::max() };
+  int64_t max[3] = { std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::min(),
+                     std::numeric_limits<int64_t>::min() };
+  const double scale = 1. / resolution;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const uint8_t* point = source.point(i);
+    if (!has_position(point, layout))
+      continue;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      float value;
+      std::memcpy(&value, point + layout.xyz[axis], 4);
+      const double cell = std::max(std::min(std::floor(value * scale), 4e18), -4e18);
+      cells[3 * i + axis] = static_cast<int64_t>(cell);
+      min[axis] = std::min(min[axis], cells[3 * i + axis]);
+      max[axis] = std::max(max[axis], cells[3 * i + axis]);
+    }
+  }
+  // Coarsen the cells until the cloud spans at most 2^21 of them, the bits of each axis in a key
+  int shift = 0;
+  for (int axis = 0; axis < 3; ++axis)
+    while (max[axis] >= min[axis] && ((max[axis] - min[axis]) >> shift) >= (int64_t(1) << 21))
+      ++shift;
+  for (size_t i = 0; i < count; ++i)
+  {
+    keys[i].second = static_cast<uint32_t>(i);
+    if (!has_position(source.point(i), layout))
+    {
+      keys[i].first = std::numeric_limits<uint64_t>::max();
+      continue;
+    }
+    uint64_t key = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      const uint64_t cell = static_cast<uint64_t>((cells[3 * i + axis] - min[axis]) >> shift);
+      for (int bit = 0; bit < 21; ++bit)
+        key |= ((cell >> bit) & 1) << (3 * bit + axis);
+    }
+    keys[i].first = key;
+  }
+  std::sort(keys.begin(), keys.end());
+  order.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    order[i] = keys[i].second;
+}
+
+}  // namespace
+
+PointCloudEncoder::PointCloudEncoder() : PointCloudEncoder(Params())
+{
+}
+
+PointCloudEncoder::PointCloudEncoder(const Params& params) : params_(params)
+{
+}
+
+PointCloudEncoder::~PointCloudEncoder()
+{
+}
+
+bool PointCloudEncoder::encode(const sensor_msgs::PointCloud2& cloud, mil_msgs::CompressedPointCloud2& compressed)
+{
+  const size_t count = size_t(cloud.width) * cloud.height;
+  if (cloud.point_step == 0 || uint64_t(cloud.row_step) * cloud.height > cloud.data.size() ||
+      uint64_t(cloud.point_step) * cloud.width > cloud.row_step)
+    return false;
+
+  compressed.resolutions.assign(cloud.fields.size(), 0.f);
+  for (size_t f = 0; f < cloud.fields.size(); ++f)
+  {
+    const std::string& name = cloud.fields[f].name;
+    if (name == "x" || name == "y" || name == "z")
+    {
+      compressed.resolutions[f] = params_.resolution;
+    }
+    else
+    {
+      const auto resolution = params_.field_resolutions.find(name);
+      if (resolution != params_.field_resolutions.end())
+        compressed.resolutions[f] = resolution->second;
+    }
+  }
+  Layout layout;
+  if (!layout.make(cloud.fields, cloud.point_step, cloud.is_bigendian, compressed.resolutions))
+    return false;
+
+  order_.clear();
+  Source source{ cloud.data.data(), cloud.width, cloud.point_step, cloud.row_step, &order_ };
+  compressed.reordered = params_.reorder && layout.positions && params_.resolution > 0;
+  if (compressed.reordered)
+    octree_order(source, layout, count, params_.resolution, order_);
+
+  compressed.header = cloud.header;
+  compressed.height = compressed.reordered ? 1 : cloud.height;
+  compressed.width = compressed.reordered ? static_cast<uint32_t>(count) : cloud.width;
+  compressed.fields = cloud.fields;
+  compressed.is_bigendian = cloud.is_bigendian;
+  compressed.point_step = cloud.point_step;
+  compressed.is_dense = cloud.is_dense;
+
+  const uint32_t row = compressed.height > 1 ? compressed.width : 0;
+  const size_t block_size = block_points(params_.block_size, row);
+  const size_t blocks = (count + block_size - 1) / block_size;
+  const size_t threads = thread_count(params_.threads, blocks);
+  compressed.block_size = static_cast<uint32_t>(block_size);
+  if (scratch_.size() < threads)
+    scratch_.resize(threads);
+  blocks_.resize(blocks);
+  for_each_block(blocks, threads, [&](size_t thread, size_t block) {
+    const size_t start = block * block_size;
+    encode_block(source, layout, start, std::min(block_size, count - start), row, scratch_[thread], blocks_[block]);
+  });
+
+  compressed.block_ends.resize(blocks);
+  compressed.data.clear();
+  for (size_t block = 0; block < blocks; ++block)
+  {
+    compressed.data.insert(compressed.data.end(), blocks_[block].begin(), blocks_[block].end());
+    compressed.block_ends[block] = static_cast<uint32_t>(compressed.data.size());
+  }
+  return true;
+}
+
+bool decode_point_cloud(const mil_msgs::CompressedPointCloud2& compressed, sensor_msgs::PointCloud2& cloud,
+                        size_t threads)
+{
+  const size_t count = size_t(compressed.width) * compressed.height;
+  const uint32_t row = compressed.height > 1 ? compressed.width : 0;
+  const size_t block_size = compressed.block_size;
+  Layout layout;
+  if (!block_size || compressed.point_step == 0 || compressed.resolutions.size() != compressed.fields.size() ||
+      compressed.block_ends.size() != (count + block_size - 1) / block_size ||
+      !layout.make(compressed.fields, compressed.point_step, compressed.is_bigendian, compressed.resolutions))
+    return false;
+  for (size_t block = 0; block < compressed.block_ends.size(); ++block)
+    if (compressed.block_ends[block] > compressed.data.size() ||
+        (block && compressed.block_ends[block] < compressed.block_ends[block - 1]))
+      return false;
+
+  cloud.header = compressed.header;
+  cloud.height = compressed.height;
+  cloud.width = compressed.width;
+  cloud.fields = compressed.fields;
+  cloud.is_bigendian = compressed.is_bigendian;
+  cloud.point_step = compressed.point_step;
+  cloud.row_step = compressed.width * compressed.point_step;
+  cloud.is_dense = compressed.is_dense;
+  cloud.data.assign(count * compressed.point_step, 0);
+
+  const size_t blocks = compressed.block_ends.size();
+  threads = thread_count(threads, blocks);
+  std::vector<PointCloudEncoder::Scratch> scratch(threads);
+  std::atomic<bool> ok(true);
+  for_each_block(blocks, threads, [&](size_t thread, size_t block) {
+    const size_t start = block * block_size;
+    const size_t begin = block ? compressed.block_ends[block - 1] : 0;
+    if (!decode_block(compressed.data.data() + begin, compressed.block_ends[block] - begin, layout,
+                      cloud.data.data() + start * compressed.point_step, compressed.point_step,
+                      std::min(block_size, count - start), row, scratch[thread]))
+      ok = false;
+  });
+  return ok;
+}
+
+}  // namespace mil_tools
@@ -0,0 +1,48 @@
+#include <mil_tools/point_cloud_recorder.hpp>
+
+#include <algorithm>
+#include <map>
+
+namespace mil_tools
+{
+PointCloudRecorder::PointCloudRecorder(ros::NodeHandle* _nh)
+  : TopicRecorder<sensor_msgs::PointCloud2>(_nh), encoder_(LoadParams(_nh)), compressed_topic_(topic_ + "/compressed")
+{
+}
+
+PointCloudRecorder::~PointCloudRecorder()
+{
+  StopWriter();
+}
+
+PointCloudEncoder::Params PointCloudRecorder::LoadParams(ros::NodeHandle* _nh)
+{
+  PointCloudEncoder::Params params;
+  double resolution = params.resolution;
+  _nh->param<double>("resolution", resolution, resolution);
+  params.resolution = static_cast<float>(std::max(resolution, 0.));
+  std::map<std::string, double> field_resolutions;
+  _nh->getParam("field_resolutions", field_resolutions);
+  for (const auto& field : field_resolutions)
+    params.field_resolutions[field.first] = static_cast<float>(std::max(field.second, 0.));
+  int block_size = static_cast<int>(params.block_size);
+  _nh->param<int>("block_size", block_size, block_size);
+  params.block_size = static_cast<size_t>(std::max(block_size, 1));
+  _nh->param<bool>("reorder", params.reorder, params.reorder);
+  int threads = 0;
+  _nh->param<int>("encode_threads", threads, threads);
+  params.threads = static_cast<size_t>(std::max(threads, 0));
+  return params;
+}
+
+void PointCloudRecorder::WriteToBag(const ros::Time& _time, const sensor_msgs::PointCloud2& _msg)
+{
+  if (!encoder_.encode(_msg, compressed_))
+  {
+    ROS_WARN_THROTTLE(5., "point cloud recorder skipping a cloud on %s whose fields do not fit its points",
+                      topic_.c_str());
+    return;
+  }
+  bag_.write(compressed_topic_, _time, compressed_);
+}
+}
@@ -0,0 +1,190 @@
+#include <mil_tools/raw_capture.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace mil_tools
+{
+namespace
+{
+const char MAGIC[8] = { 'M', 'I', 'L', 'R', 'A', 'W', '0', '1' };
+const size_t RECORD_HEADER_SIZE = 3 * sizeof(uint32_t);
+// The file grows by at least this much at a time, so remapping is rare
+const size_t CHUNK_SIZE = 16 << 20;
+
+std::runtime_error error(const std::string& what, const std::string& path)
+{
+  return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+}  // namespace
+
+RawCaptureOptions RawCaptureOptions::from_params(const ros::NodeHandle& private_nh)
+{
+  RawCaptureOptions options;
+  private_nh.param<std::string>("capture_file", options.capture_file, "");
+  private_nh.param<std::string>("replay_file", options.replay_file, "");
+  private_nh.param<double>("replay_speed", options.replay_speed, 1.);
+  return options;
+}
+
+RawCaptureWriter::RawCaptureWriter(const std::string& path) : path_(path)
+{
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0)
+    throw error("can not create capture", path);
+  try
+  {
+    grow(CHUNK_SIZE);
+  }
+  catch (...)
+  {
+    ::close(fd_);
+    throw;
+  }
+  std::memcpy(map_, MAGIC, sizeof(MAGIC));
+  size_ = sizeof(MAGIC);
+}
+
+RawCaptureWriter::~RawCaptureWriter()
+{
+  if (map_)
+    ::munmap(map_, mapped_);
+  if (::ftruncate(fd_, size_) != 0)
+    ROS_ERROR("can not trim capture %s: %s", path_.c_str(), std::strerror(errno));
+  ::close(fd_);
+}
+
+void RawCaptureWriter::append(const ros::Time& stamp, const uint8_t* data, size_t size)
+{
+  if (!size)
+    return;
+  size_t record_size = RECORD_HEADER_SIZE + size;
+  if (size_ + record_size > mapped_)
+    grow(std::max(2 * mapped_, size_ + record_size + CHUNK_SIZE));
+  uint32_t header[3] = { stamp.sec, stamp.nsec, static_cast<uint32_t>(size) };
+  std::memcpy(map_ + size_, header, RECORD_HEADER_SIZE);
+  std::memcpy(map_ + size_ + RECORD_HEADER_SIZE, data, size);
+  size_ += record_size;
+}
+
+void RawCaptureWriter::grow(size_t size)
+{
+  if (map_)
+  {
+    ::munmap(map_, mapped_);
+    map_ = nullptr;
+  }
+  if (::ftruncate(fd_, size) != 0)
+    throw error("can not grow capture", path_);
+  void* map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED)
+    throw error("can not map capture", path_);
+  map_ = static_cast<uint8_t*>(map);
+  mapped_ = size;
+}
+
+RawCaptureReader::RawCaptureReader(const std::string& path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw error("can not open capture", path);
+  struct stat st;
+  if (::fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    throw error("can not stat capture", path);
+  }
+  size_ = st.st_size;
+  if (size_ < sizeof(MAGIC))
+  {
+    ::close(fd);
+    throw std::runtime_error(path + " is not a raw capture");
+  }
+  void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    throw error("can not map capture", path);
+  map_ = static_cast<const uint8_t*>(map);
+  if (std::memcmp(map_, MAGIC, sizeof(MAGIC)) != 0)
+  {
+    ::munmap(const_cast<uint8_t*>(map_), size_);
+    throw std::runtime_error(path + " is not a raw capture");
+  }
+  // Sequential reads, so the kernel can read ahead
+  ::madvise(const_cast<uint8_t*>(map_), size_, MADV_SEQUENTIAL);
+  rewind();
+}
+
+RawCaptureReader::~RawCaptureReader()
+{
+  ::munmap(const_cast<uint8_t*>(map_), size_);
+}
+
+bool RawCaptureReader::next(Record& record)
+{
+  if (size_ - offset_ < RECORD_HEADER_SIZE)
+    return false;
+  uint32_t header[3];
+  std::memcpy(header, map_ + offset_, RECORD_HEADER_SIZE);
+  if (!header[2] || size_ - offset_ - RECORD_HEADER_SIZE < header[2])
+    return false;
+  record.stamp = ros::Time(header[0], header[1]);
+  record.data = map_ + offset_ + RECORD_HEADER_SIZE;
+  record.size = header[2];
+  offset_ += RECORD_HEADER_SIZE + header[2];
+  return true;
+}
+
+void RawCaptureReader::rewind()
+{
+  offset_ = sizeof(MAGIC);
+}
+
+RawCaptureReplay::RawCaptureReplay(const std::string& path, double speed) : reader_(path), speed_(speed)
+{
+}
+
+bool RawCaptureReplay::next_due(ros::WallTime& due)
+{
+  if (!has_record_)
+  {
+    if (!reader_.next(record_))
+      return false;
+    has_record_ = true;
+    record_offset_ = 0;
+  }
+  ros::WallTime now = ros::WallTime::now();
+  if (!started_)
+  {
+    started_ = true;
+    start_stamp_ = record_.stamp;
+    start_wall_ = now;
+  }
+  if (speed_ <= 0)
+    due = now;
+  else
+    due = start_wall_ + ros::WallDuration((record_.stamp - start_stamp_).toSec() / speed_);
+  return true;
+}
+
+size_t RawCaptureReplay::read(uint8_t* data, size_t size, ros::Time& stamp)
+{
+  if (!has_record_)
+    return 0;
+  size_t count = std::min(size, record_.size - record_offset_);
+  std::memcpy(data, record_.data + record_offset_, count);
+  stamp = record_.stamp;
+  record_offset_ += count;
+  if (record_offset_ == record_.size)
+    has_record_ = false;
+  return count;
+}
+
+}  // namespace mil_tools
@@ -0,0 +1,112 @@
+#include <mil_tools/thread_policy.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+namespace mil_tools
+{
+ThreadPolicy ThreadPolicy::from_params(const ros::NodeHandle& nh, const std::string& name)
+{
+  ThreadPolicy policy;
+  nh.param<int>(name + "/priority", policy.priority, 0);
+  nh.param<std::vector<int>>(name + "/cpus", policy.cpus, std::vector<int>());
+  nh.param<bool>(name + "/lock_memory", policy.lock_memory, false);
+  return policy;
+}
+
+bool ThreadPolicy::apply(const std::string& thread) const
+{
+  bool ok = true;
+  if (lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+  {
+    ROS_WARN("%s: can not lock memory (needs CAP_IPC_LOCK or a memlock limit): %s", thread.c_str(),
+             std::strerror(errno));
+    ok = false;
+  }
+
+  if (!cpus.empty())
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+      if (cpu >= 0 && cpu < CPU_SETSIZE)
+        CPU_SET(cpu, &set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error)
+    {
+      ROS_WARN("%s: can not pin to cpus: %s", thread.c_str(), std::strerror(error));
+      ok = false;
+    }
+  }
+
+  if (priority > 0)
+  {
+    sched_param param;
+    param.sched_priority =
+        std::min(std::max(priority, sched_get_priority_min(SCHED_FIFO)), sched_get_priority_max(SCHED_FIFO));
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error)
+    {
+      ROS_WARN("%s: can not run at SCHED_FIFO priority %d (needs CAP_SYS_NICE or an rtprio limit): %s",
+               thread.c_str(), param.sched_priority, std::strerror(error));
+      ok = false;
+    }
+  }
+
+  if (ok && !empty())
+    ROS_INFO("%s: %s", thread.c_str(), describe().c_str());
+  return ok;
+}
+
+std::string ThreadPolicy::describe() const
+{
+  std::ostringstream out;
+  if (priority > 0)
+    out << "SCHED_FIFO " << priority;
+  else
+    out << "SCHED_OTHER";
+  if (!cpus.empty())
+  {
+    out << " on cpus";
+    for (int cpu : cpus)
+      out << " " << cpu;
+  }
+  if (lock_memory)
+    out << ", memory locked";
+  return out.str();
+}
+
+CallbackThread::CallbackThread(const std::string& name, const ThreadPolicy& policy)
+  : running_(true), thread_([this, name, policy]() { run(name, policy); })
+{
+}
+
+CallbackThread::~CallbackThread()
+{
+  stop();
+}
+
+void CallbackThread::stop()
+{
+  running_ = false;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void CallbackThread::run(const std::string& name, const ThreadPolicy& policy)
+{
+  // Shows in top -H and gdb, where the name fits in 15 characters
+  std::string short_name = name.substr(name.find_last_of('/') + 1).substr(0, 15);
+  pthread_setname_np(pthread_self(), short_name.c_str());
+  policy.apply(name);
+  while (running_ && ros::ok())
+    queue_.callAvailable(ros::WallDuration(0.1));
+}
+
+}  // namespace mil_tools
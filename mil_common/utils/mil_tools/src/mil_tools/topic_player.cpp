@@ -15,46 +15,117 @@ mil_tools::TopicPlayer<MSG>::TopicPlayer(ros::NodeHandle* _nh)
   return;
 }
 
+template <class MSG>
+mil_tools::TopicPlayer<MSG>::~TopicPlayer()
+{
+  Stop();
+}
+
 template <class MSG>
 void mil_tools::TopicPlayer<MSG>::Play(const ros::TimerEvent& event)
 {
-  auto start = ros::Time::now();
-  rosbag::View view(bag_);
-  // check type in first msg, make sure is correct
-  if (view.begin()->instantiate<MSG>() == nullptr)
-  {
-    ROS_FATAL("topic player, wrong type in bag file");
+  if (!enabled_ || playing_)
     return;
+  queue_.clear();
+  read_done_ = false;
+  playing_ = true;
+  reader_thread_ = std::thread(&TopicPlayer<MSG>::ReadLoop, this);
+  player_thread_ = std::thread(&TopicPlayer<MSG>::PlayLoop, this);
+}
+
+template <class MSG>
+void mil_tools::TopicPlayer<MSG>::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    playing_ = false;
   }
-  // get the time of the first message
-  ros::Time prev_msg_stamp = view.begin()->instantiate<MSG>()->header.stamp;
-  ROS_INFO("Playing");
-  for (rosbag::MessageInstance const m : view)
+  queue_cv_.notify_all();
+  if (reader_thread_.joinable())
+    reader_thread_.join();
+  if (player_thread_.joinable())
+    player_thread_.join();
+  bag_.close();
+}
+
+template <class MSG>
+void mil_tools::TopicPlayer<MSG>::ReadLoop()
+{
+  // Seek through the bag's index, rather than reading up to the start
+  ros::Time begin = rosbag::View(bag_).getBeginTime() + ros::Duration(start_time_);
+  rosbag::View view(bag_, begin);
+  if (view.size() == 0)
+    ROS_WARN("topic player, nothing in the bag after %f s", start_time_);
+
+  for (rosbag::MessageInstance const& m : view)
   {
-    if (!enabled_)
-      break;
     auto msg = m.instantiate<MSG>();
-    // if encounter wrong msg types later on, do not publish them and print warn
-    if (msg != nullptr)
+    // if encounter wrong msg types, do not publish them and print warn
+    if (msg == nullptr)
     {
-      auto now = ros::Time::now();
-      ros::Duration sleep_for = msg->header.stamp - prev_msg_stamp;
-      sleep_for.sleep();
-      prev_msg_stamp = msg->header.stamp;
-      pub_.publish(*msg);
+      ROS_WARN("topic player, wrong messgae type in bag file, skipping");
+      continue;
     }
-    else
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    queue_cv_.wait(lock, [this] { return !playing_ || queue_.size() < read_ahead_; });
+    if (!playing_)
+      return;
+    queue_.emplace_back(m.getTime(), msg);
+    queue_cv_.notify_all();
+  }
+
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  read_done_ = true;
+  queue_cv_.notify_all();
+}
+
+template <class MSG>
+void mil_tools::TopicPlayer<MSG>::PlayLoop()
+{
+  using Clock = std::chrono::steady_clock;
+  ROS_INFO("Playing");
+
+  Clock::time_point start;
+  ros::Time first;
+  size_t published = 0;
+  double max_late = 0.;
+  while (true)
+  {
+    std::pair<ros::Time, boost::shared_ptr<MSG>> next;
     {
-      ROS_WARN("topic player, wrong messgae type in bag file, skipping");
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_cv_.wait(lock, [this] { return !playing_ || !queue_.empty() || read_done_; });
+      if (!playing_ || queue_.empty())
+        break;
+      next = std::move(queue_.front());
+      queue_.pop_front();
+      queue_cv_.notify_all();
+
+      if (published == 0)
+      {
+        start = Clock::now();
+        first = next.first;
+      }
+      else if (rate_ > 0)
+      {
+        // Deadlines are from the start, so lateness on one message is not carried to the next
+        auto deadline = start + std::chrono::duration_cast<Clock::duration>(
+                                    std::chrono::duration<double>((next.first - first).toSec() / rate_));
+        if (queue_cv_.wait_until(lock, deadline, [this] { return !playing_.load(); }))
+          break;
+        max_late = std::max(max_late, std::chrono::duration<double>(Clock::now() - deadline).count());
+      }
     }
+    pub_.publish(*next.second);
+    ++published;
   }
-  bag_.close();
-  return;
+  ROS_INFO("topic player published %lu messages, at most %f ms late", published, 1e3 * max_late);
 }
 
 template <class MSG>
 bool mil_tools::TopicPlayer<MSG>::Enable(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res)
 {
+  Stop();
   enabled_ = req.data;
   if (enabled_)
   {
@@ -66,6 +137,11 @@ bool mil_tools::TopicPlayer<MSG>::Enable(std_srvs::SetBool::Request& req, std_sr
       res.success = false;
       return true;
     }
+    nh_->param<double>("rate", rate_, 1.);
+    nh_->param<double>("start_time", start_time_, 0.);
+    int read_ahead = 100;
+    nh_->param<int>("read_ahead", read_ahead, read_ahead);
+    read_ahead_ = std::max(read_ahead, 1);
 
     bag_.open(file_name, rosbag::bagmode::Read);
 
@@ -9,7 +9,16 @@ mil_tools::TopicRecorder<MSG>::TopicRecorder(ros::NodeHandle* _nh)
     return;
   }
 
-  bag_.open(file_name_, rosbag::bagmode::Write);
+  OpenBag();
+
+  nh_->param<bool>("async_write", async_, false);
+  if (async_)
+  {
+    int queue_size = 1000;
+    nh_->param<int>("write_queue_size", queue_size, queue_size);
+    queue_.reset(new boost::lockfree::spsc_queue<Entry>(std::max(queue_size, 1)));
+    StartWriter();
+  }
 
   if (!nh_->getParam("record_topic", topic_))
   {
@@ -20,13 +29,119 @@ mil_tools::TopicRecorder<MSG>::TopicRecorder(ros::NodeHandle* _nh)
   enable_service_ = nh_->advertiseService("enable", &TopicRecorder<MSG>::Enable, this);
 }
 
+template <class MSG>
+mil_tools::TopicRecorder<MSG>::~TopicRecorder()
+{
+  StopWriter();
+  bag_.close();
+}
+
+template <class MSG>
+void mil_tools::TopicRecorder<MSG>::OpenBag()
+{
+  bag_.open(file_name_, rosbag::bagmode::Write);
+
+  std::string compression = "none";
+  nh_->param<std::string>("compression", compression, compression);
+  if (compression == "lz4")
+    bag_.setCompression(rosbag::compression::LZ4);
+  else if (compression == "bz2")
+    bag_.setCompression(rosbag::compression::BZ2);
+  else if (compression != "none")
+    ROS_WARN("topic recorder compression %s unknown, not compressing", compression.c_str());
+
+  int chunk_size = 0;
+  if (nh_->getParam("chunk_size", chunk_size) && chunk_size > 0)
+    bag_.setChunkThreshold(chunk_size);
+}
+
 template <class MSG>
 void mil_tools::TopicRecorder<MSG>::CallBack(const MSG& _msg)
 {
   if (!enabled_)
     return;
+  Write(ros::Time::now(), _msg);
+}
+
+template <class MSG>
+void mil_tools::TopicRecorder<MSG>::Write(const ros::Time& _time, const MSG& _msg)
+{
   ++message_count_;
-  bag_.write(topic_, ros::Time::now(), _msg);
+  if (!async_)
+  {
+    WriteToBag(_time, _msg);
+    ++written_;
+    return;
+  }
+
+  if (!queue_->push(Entry{ _time, _msg }))
+  {
+    ++dropped_;
+    ROS_WARN_THROTTLE(5., "topic recorder writer behind, dropped %lu messages so far", dropped_.load());
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+  }
+  wake_.notify_one();
+}
+
+template <class MSG>
+void mil_tools::TopicRecorder<MSG>::WriteToBag(const ros::Time& _time, const MSG& _msg)
+{
+  bag_.write(topic_, _time, _msg);
+}
+
+template <class MSG>
+void mil_tools::TopicRecorder<MSG>::StartWriter()
+{
+  if (writing_)
+    return;
+  writing_ = true;
+  writer_thread_ = std::thread(&TopicRecorder<MSG>::WriterLoop, this);
+}
+
+template <class MSG>
+void mil_tools::TopicRecorder<MSG>::StopWriter()
+{
+  if (!writing_)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    writing_ = false;
+  }
+  wake_.notify_one();
+  writer_thread_.join();
+}
+
+template <class MSG>
+void mil_tools::TopicRecorder<MSG>::WriterLoop()
+{
+  Entry entry;
+  while (true)
+  {
+    if (!queue_->pop(entry))
+    {
+      // Only stops once everything queued has been written
+      if (!writing_)
+        return;
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_.wait_for(lock, std::chrono::milliseconds(100),
+                     [this] { return !writing_ || queue_->read_available() > 0; });
+      continue;
+    }
+
+    try
+    {
+      WriteToBag(entry.time, entry.msg);
+      ++written_;
+    }
+    catch (rosbag::BagException const& e)
+    {
+      ++dropped_;
+      ROS_ERROR_THROTTLE(5., "topic recorder failed to write to %s: %s", file_name_.c_str(), e.what());
+    }
+  }
 }
 
 template <class MSG>
@@ -35,7 +150,8 @@ bool mil_tools::TopicRecorder<MSG>::Enable(std_srvs::SetBool::Request& req, std_
   enabled_ = req.data;
   if (!enabled_)
   {
-    ROS_INFO("%d messages written to %s", message_count_, file_name_.c_str());
+    StopWriter();
+    ROS_INFO("%lu messages written to %s, %lu dropped", written_.load(), file_name_.c_str(), dropped_.load());
     bag_.close();
   }
   if (!nh_->getParam("file_name", file_name_))
@@ -44,6 +160,18 @@ bool mil_tools::TopicRecorder<MSG>::Enable(std_srvs::SetBool::Request& req, std_
     res.success = false;
     return false;
   }
+  if (enabled_)
+  {
+    if (!bag_.isOpen())
+      OpenBag();
+    if (async_)
+      StartWriter();
+  }
+
+  std::stringstream counts;
+  counts << written_ << " written, " << dropped_ << " dropped, " << (async_ ? queue_->read_available() : 0)
+         << " queued";
+  res.message = counts.str();
   res.success = true;
   return true;
 }
@@ -0,0 +1,170 @@
+#include <mil_tools/trace.hpp>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+namespace mil_tools
+{
+namespace
+{
+int32_t thread_id()
+{
+  thread_local int32_t id = syscall(SYS_gettid);
+  return id;
+}
+
+size_t round_up_pow2(size_t n)
+{
+  size_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+// Microseconds, as Chrome trace timestamps are
+void write_us(std::ostream &out, int64_t ns)
+{
+  out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << std::abs(ns % 1000);
+}
+
+void write_string(std::ostream &out, std::string const &s)
+{
+  out << '"';
+  for (char c : s)
+  {
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20)
+      out << ' ';
+    else
+      out << c;
+  }
+  out << '"';
+}
+}  // namespace
+
+Tracer &Tracer::instance()
+{
+  static Tracer *tracer = new Tracer();
+  return *tracer;
+}
+
+void Tracer::configure(ros::NodeHandle nh)
+{
+  if (configured_.exchange(true))
+    return;
+
+  int capacity = nh.param<int>("trace_capacity", 65536);
+  mask_ = round_up_pow2(std::max(capacity, 1)) - 1;
+  spans_.reset(new Span[mask_ + 1]);
+
+  file_ = nh.param<std::string>("trace_file", "");
+  if (file_.empty())
+  {
+    std::string node = ros::this_node::getName();
+    std::replace(node.begin(), node.end(), '/', '_');
+    file_ = "/tmp/mil_trace" + node + "_" + std::to_string(getpid()) + ".json";
+  }
+  dump_service_ = nh.advertiseService("dump_trace", &Tracer::dump_cb, this);
+
+  // Only once the buffer is there to record into
+  enabled_.store(nh.param<bool>("trace_enabled", false), std::memory_order_release);
+}
+
+void Tracer::record(char const *name, ros::Time const &origin, ros::WallTime const &start, ros::WallTime const &end,
+                    ros::Time const &start_ros)
+{
+  uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+  Span &span = spans_[index & mask_];
+  // Marked as being written first, so write() skips a span it sees change under it
+  span.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  span.name = name;
+  span.origin = origin.toNSec();
+  span.start = start.toNSec();
+  span.end = end.toNSec();
+  span.age = origin.isZero() ? 0 : (start_ros - origin).toNSec();
+  span.thread = thread_id();
+  span.sequence.store(index + 1, std::memory_order_release);
+}
+
+bool Tracer::write(std::string const &path, std::string &error) const
+{
+  if (!spans_)
+  {
+    error = "tracing was never configured";
+    return false;
+  }
+
+  std::ofstream out(path);
+  if (!out)
+  {
+    error = "could not open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+
+  int pid = getpid();
+  out << "{\"traceEvents\":[\n";
+  out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"args\":{\"name\":";
+  write_string(out, ros::this_node::getName());
+  out << "}}";
+
+  // Oldest first, only those not overwritten since
+  uint64_t end = next_.load(std::memory_order_acquire);
+  uint64_t begin = end > mask_ + 1 ? end - (mask_ + 1) : 0;
+  for (uint64_t index = begin; index < end; ++index)
+  {
+    Span const &slot = spans_[index & mask_];
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    char const *name = slot.name;
+    int64_t origin = slot.origin;
+    int64_t start = slot.start;
+    int64_t finish = slot.end;
+    int64_t age = slot.age;
+    int32_t thread = slot.thread;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence != index + 1 || slot.sequence.load(std::memory_order_relaxed) != sequence)
+      continue;
+
+    out << ",\n{\"name\":\"" << name << "\",\"cat\":\"mil\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << thread
+        << ",\"ts\":";
+    write_us(out, start);
+    out << ",\"dur\":";
+    write_us(out, finish - start);
+    if (origin != 0)
+    {
+      // Flows join the spans of a trace in order, across every merged process. The id is a string, as origin
+      // stamps in ns are too large for a JSON number.
+      char id[32];
+      std::snprintf(id, sizeof(id), "0x%llx", static_cast<unsigned long long>(origin));
+      out << ",\"bind_id\":\"" << id << "\",\"flow_in\":true,\"flow_out\":true";
+      out << ",\"args\":{\"trace_id\":\"" << id << "\",\"origin_age_ms\":" << age / 1e6 << "}";
+    }
+    out << "}";
+  }
+  out << "\n]}\n";
+
+  if (!out)
+  {
+    error = "could not write " + path;
+    return false;
+  }
+  return true;
+}
+
+bool Tracer::dump_cb(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
+{
+  std::string error;
+  res.success = write(file_, error);
+  res.message = res.success ? file_ : error;
+  return true;
+}
+}  // namespace mil_tools
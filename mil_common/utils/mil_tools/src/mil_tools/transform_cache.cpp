@@ -0,0 +1,159 @@
+#include <mil_tools/transform_cache.hpp>
+
+#include <tf2/exceptions.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace mil_tools
+{
+namespace
+{
+Eigen::Affine3d toEigen(geometry_msgs::Transform const &transform)
+{
+  Eigen::Quaterniond rotation(transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z);
+  return Eigen::Translation3d(transform.translation.x, transform.translation.y, transform.translation.z) * rotation;
+}
+}  // namespace
+
+Eigen::Affine3d TransformInterval::at(double fraction) const
+{
+  fraction = std::min(std::max(fraction, 0.), 1.);
+  Eigen::Quaterniond start_rotation(start_pose.linear());
+  Eigen::Quaterniond end_rotation(end_pose.linear());
+  Eigen::Vector3d translation = (1 - fraction) * start_pose.translation() + fraction * end_pose.translation();
+  return Eigen::Translation3d(translation) * start_rotation.slerp(fraction, end_rotation) * mounting;
+}
+
+Eigen::Affine3d TransformInterval::at(ros::Time const &time) const
+{
+  double length = (end - start).toSec();
+  return at(length > 0 ? (time - start).toSec() / length : 0.);
+}
+
+TransformCache::TransformCache(tf2_ros::Buffer const &buffer, std::string const &body_frame)
+  : buffer_(buffer), body_frame_(body_frame)
+{
+}
+
+void TransformCache::addMount(std::string const &frame)
+{
+  if (frame == body_frame_)
+    return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  mounts_.insert(frame);
+}
+
+bool TransformCache::isMount(std::string const &frame) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return mounts_.count(frame);
+}
+
+bool TransformCache::lookupTf(std::string const &target, std::string const &source, ros::Time const &time,
+                              ros::Duration const &timeout, Eigen::Affine3d &out)
+{
+  auto start = std::chrono::steady_clock::now();
+  bool found = true;
+  try
+  {
+    out = toEigen(buffer_.lookupTransform(target, source, time, timeout).transform);
+  }
+  catch (tf2::TransformException const &e)
+  {
+    ROS_WARN_THROTTLE(1.0, "No transform from %s to %s: %s", source.c_str(), target.c_str(), e.what());
+    found = false;
+  }
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.lookups;
+  if (!found)
+    ++stats_.failures;
+  stats_.mean_lookup_us += (us - stats_.mean_lookup_us) / stats_.lookups;
+  stats_.max_lookup_us = std::max(stats_.max_lookup_us, us);
+  return found;
+}
+
+bool TransformCache::mounting(std::string const &frame, Eigen::Affine3d &out)
+{
+  if (frame == body_frame_)
+  {
+    out = Eigen::Affine3d::Identity();
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = mountings_.find(frame);
+    if (it != mountings_.end())
+    {
+      ++stats_.mount_hits;
+      out = it->second;
+      return true;
+    }
+  }
+
+  // Mountings never change, so the latest one will do
+  if (!lookupTf(body_frame_, frame, ros::Time(0), ros::Duration(0), out))
+    return false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.mount_lookups;
+  mountings_[frame] = out;
+  return true;
+}
+
+bool TransformCache::lookup(std::string const &target, std::string const &source, ros::Time const &time,
+                            Eigen::Affine3d &out, ros::Duration const &timeout)
+{
+  if (target == source)
+  {
+    out = Eigen::Affine3d::Identity();
+    return true;
+  }
+  if (!isMount(source))
+    return lookupTf(target, source, time, timeout, out);
+
+  Eigen::Affine3d mount;
+  if (!mounting(source, mount) || !lookupTf(target, body_frame_, time, timeout, out))
+    return false;
+  out = out * mount;
+  return true;
+}
+
+bool TransformCache::lookupInterval(std::string const &target, std::string const &source, ros::Time const &start,
+                                    ros::Time const &end, TransformInterval &out, ros::Duration const &timeout)
+{
+  out.start = start;
+  out.end = end;
+  out.mounting = Eigen::Affine3d::Identity();
+  std::string const &frame = isMount(source) ? body_frame_ : source;
+  if (frame != source && !mounting(source, out.mounting))
+    return false;
+  if (frame == target)
+  {
+    out.start_pose = out.end_pose = Eigen::Affine3d::Identity();
+    return true;
+  }
+  if (!lookupTf(target, frame, start, timeout, out.start_pose))
+    return false;
+  if (end == start)
+  {
+    out.end_pose = out.start_pose;
+    return true;
+  }
+  return lookupTf(target, frame, end, timeout, out.end_pose);
+}
+
+void TransformCache::clear()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  mountings_.clear();
+}
+
+TransformCache::Stats TransformCache::stats() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace mil_tools